@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstdio>
 #include <fstream>
 #include <iterator>
 #include <string>
@@ -6,6 +8,8 @@
 #include "caffe2/core/init.h"
 #include "caffe2/core/logging.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/core/operator_schema.h"
+#include "caffe2/core/timer.h"
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/utils/proto_utils.h"
 #include "caffe2/utils/string_utils.h"
@@ -64,6 +68,19 @@ CAFFE2_DEFINE_bool(
     run_individual,
     false,
     "Whether to benchmark individual operators.");
+CAFFE2_DEFINE_bool(
+    roofline,
+    false,
+    "Whether to time every operator and report its achieved GFLOP/s and "
+    "GB/s from the cost inference of its schema, against the device peaks.");
+CAFFE2_DEFINE_double(
+    peak_gflops,
+    0,
+    "The peak GFLOP/s of the device, for --roofline.");
+CAFFE2_DEFINE_double(
+    peak_gbps,
+    0,
+    "The peak memory bandwidth of the device in GB/s, for --roofline.");
 CAFFE2_DEFINE_bool(
     text_output,
     false,
@@ -111,6 +128,80 @@ static void writeTextOutput(
   std::copy(data.begin(), data.end(), output_iterator);
 }
 
+// Times every operator of the net on its own and prints the GFLOP/s and
+// GB/s it achieves and its arithmetic intensity. With the peaks given, an
+// op is memory bound if its intensity is under the ridge point
+// peak_gflops / peak_gbps, and the roof is the GFLOP/s it could reach.
+static void reportRoofline(caffe2::NetBase* net) {
+  const bool has_peaks =
+      caffe2::FLAGS_peak_gflops > 0 && caffe2::FLAGS_peak_gbps > 0;
+  const double ridge = has_peaks
+      ? caffe2::FLAGS_peak_gflops / caffe2::FLAGS_peak_gbps
+      : 0;
+  const int iter = std::max(caffe2::FLAGS_iter, 1);
+  double total_ms = 0;
+  double total_gflop = 0;
+  double total_gb = 0;
+  int idx = 0;
+  for (auto* op : net->GetOperators()) {
+    const auto& def = op->debug_def();
+    const auto* schema = caffe2::OpSchemaRegistry::Schema(def.type());
+    caffe2::OpSchema::Cost cost{0, 0, 0};
+    if (schema && schema->HasCostInferenceFunction()) {
+      try {
+        cost = schema->InferCost(def, op->InputTensorShapes());
+      } catch (const std::exception& e) {
+        LOG(WARNING) << "No cost for " << def.type() << ": " << e.what();
+      }
+    }
+    caffe2::Timer timer;
+    for (int i = 0; i < iter; ++i) {
+      op->ResetEvent();
+      CAFFE_ENFORCE(op->Run(), "Operator ", def.type(), " has failed.");
+    }
+    const double ms = timer.MilliSeconds() / iter;
+    const double gflop = 1e-9 * cost.flops;
+    const double gb = 1e-9 * (cost.bytes_moved + cost.params_bytes);
+    total_ms += ms;
+    total_gflop += gflop;
+    total_gb += gb;
+    const string& print_name = def.name().size()
+        ? def.name()
+        : (def.output_size() ? def.output(0) : "NO_OUTPUT");
+    printf(
+        "Operator #%d (%s, %s) %.3f ms",
+        idx,
+        print_name.c_str(),
+        def.type().c_str(),
+        ms);
+    if (cost.flops || gb > 0) {
+      const double gflops = gflop / ms * 1e3;
+      const double intensity = gb > 0 ? gflop / gb : 0;
+      printf(
+          ": %.2f GFLOP/s, %.2f GB/s, %.2f FLOP/byte",
+          gflops,
+          gb / ms * 1e3,
+          intensity);
+      if (has_peaks) {
+        const double roof = std::min(
+            caffe2::FLAGS_peak_gflops, intensity * caffe2::FLAGS_peak_gbps);
+        printf(
+            ", %s bound, %.1f%% of roof",
+            intensity < ridge ? "memory" : "compute",
+            roof > 0 ? 100. * gflops / roof : 0.);
+      }
+    }
+    printf("\n");
+    ++idx;
+  }
+  printf(
+      "Total %.3f ms: %.2f GFLOP/s, %.2f GB/s\n",
+      total_ms,
+      total_ms > 0 ? total_gflop / total_ms * 1e3 : 0.,
+      total_ms > 0 ? total_gb / total_ms * 1e3 : 0.);
+  fflush(stdout);
+}
+
 int main(int argc, char** argv) {
   caffe2::GlobalInit(&argc, &argv);
   caffe2::ShowLogInfoToStderr();
@@ -213,6 +304,10 @@ int main(int argc, char** argv) {
     }
   }
 
+  if (caffe2::FLAGS_roofline) {
+    reportRoofline(net);
+  }
+
   string output_prefix = caffe2::FLAGS_output_folder.size()
       ? caffe2::FLAGS_output_folder + "/"
       : "";
@@ -0,0 +1,242 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/conversions.h"
+#include "caffe2/utils/math.h"
+
+#define CAFFE2_SKIP_IF_NO_GPU                                      \
+  if (!caffe2::NumCudaDevices()) {                                 \
+    state.SkipWithError("No CUDA available, skipping benchmark."); \
+    return;                                                        \
+  }
+
+using namespace caffe2;
+
+namespace {
+
+// The cudnn ops of an I3D ResNet-50 stage on a batch of 8 clips, in
+// NCHW (N x C x T x H x W) against NHWC (N x T x H x W x C), the latter
+// being the layout the tensor cores compute in.
+struct Stage {
+  int channels;
+  int length;
+  int size;
+};
+
+// the bottleneck width of res2 to res5 at 8 frames in, 224 x 224
+const Stage kStages[] = {{64, 8, 56}, {128, 4, 28}, {256, 4, 14}, {512, 4, 7}};
+constexpr int kBatch = 8;
+
+std::vector<TIndex> Shape(
+    const bool nhwc,
+    const int n,
+    const int c,
+    const int t,
+    const int h,
+    const int w) {
+  return nhwc ? std::vector<TIndex>{n, t, h, w, c}
+              : std::vector<TIndex>{n, c, t, h, w};
+}
+
+template <typename T>
+void FillCUDA(
+    Workspace* ws,
+    const string& name,
+    const std::vector<TIndex>& dims) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCUDA>();
+  tensor->Resize(dims);
+  CUDAContext context;
+  math::Set<T, CUDAContext>(
+      tensor->size(),
+      convert::To<float, T>(0.01f),
+      tensor->template mutable_data<T>(),
+      &context);
+  context.FinishDeviceComputation();
+}
+
+void AddArg(OperatorDef* def, const string& name, const string& value) {
+  auto* arg = def->add_arg();
+  arg->set_name(name);
+  arg->set_s(value);
+}
+
+void AddArg(OperatorDef* def, const string& name, const int value) {
+  auto* arg = def->add_arg();
+  arg->set_name(name);
+  arg->set_i(value);
+}
+
+void AddArgs(
+    OperatorDef* def,
+    const string& name,
+    const std::vector<int>& values) {
+  auto* arg = def->add_arg();
+  arg->set_name(name);
+  for (const int v : values) {
+    arg->add_ints(v);
+  }
+}
+
+OperatorDef CuDNNOpDef(
+    const string& type,
+    const std::vector<string>& inputs,
+    const bool nhwc) {
+  OperatorDef def;
+  def.set_type(type);
+  def.set_engine("CUDNN");
+  def.mutable_device_option()->set_device_type(CUDA);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  def.add_output("Y");
+  AddArg(&def, "order", nhwc ? "NHWC" : "NCHW");
+  return def;
+}
+
+// runs the op once to let it pick its algorithms, then times it
+void RunOp(benchmark::State& state, Workspace* ws, const OperatorDef& def) {
+  auto op = CreateOperator(def, ws);
+  CHECK(op->Run());
+  CUDA_ENFORCE(cudaDeviceSynchronize());
+  while (state.KeepRunning()) {
+    op->Run();
+    CUDA_ENFORCE(cudaDeviceSynchronize());
+  }
+}
+
+// range(0): stage, range(1): 0 for a 3x1x1, 1 for a 1x3x3 kernel,
+// range(2): NHWC, range(3): float16
+void BM_Conv3d(benchmark::State& state) {
+  CAFFE2_SKIP_IF_NO_GPU;
+  const Stage& stage = kStages[state.range(0)];
+  const bool temporal = state.range(1) == 0;
+  const bool nhwc = state.range(2);
+  const bool fp16 = state.range(3);
+  const int C = stage.channels;
+  const std::vector<int> kernel =
+      temporal ? std::vector<int>{3, 1, 1} : std::vector<int>{1, 3, 3};
+  const std::vector<int> pads = temporal ? std::vector<int>{1, 0, 0, 1, 0, 0}
+                                         : std::vector<int>{0, 1, 1, 0, 1, 1};
+
+  Workspace ws;
+  const auto x_dims =
+      Shape(nhwc, kBatch, C, stage.length, stage.size, stage.size);
+  const auto w_dims = Shape(nhwc, C, C, kernel[0], kernel[1], kernel[2]);
+  if (fp16) {
+    FillCUDA<float16>(&ws, "X", x_dims);
+    FillCUDA<float16>(&ws, "W", w_dims);
+  } else {
+    FillCUDA<float>(&ws, "X", x_dims);
+    FillCUDA<float>(&ws, "W", w_dims);
+  }
+  OperatorDef def = CuDNNOpDef("Conv", {"X", "W"}, nhwc);
+  AddArgs(&def, "kernels", kernel);
+  AddArgs(&def, "pads", pads);
+  AddArgs(&def, "strides", {1, 1, 1});
+  AddArg(&def, "no_bias", 1);
+  AddArg(&def, "enable_tensor_core", 1);
+  AddArg(&def, "exhaustive_search", 1);
+  RunOp(state, &ws, def);
+}
+void Conv3dArgs(benchmark::internal::Benchmark* b) {
+  for (int stage = 0; stage < 4; ++stage) {
+    for (int kernel = 0; kernel < 2; ++kernel) {
+      for (int nhwc = 0; nhwc < 2; ++nhwc) {
+        for (int fp16 = 0; fp16 < 2; ++fp16) {
+          b->Args({stage, kernel, nhwc, fp16});
+        }
+      }
+    }
+  }
+}
+BENCHMARK(BM_Conv3d)->Apply(Conv3dArgs)->Unit(benchmark::kMicrosecond);
+
+// range(0): stage, range(1): NHWC, range(2): float16
+void BM_SpatialBN3d(benchmark::State& state) {
+  CAFFE2_SKIP_IF_NO_GPU;
+  const Stage& stage = kStages[state.range(0)];
+  const bool nhwc = state.range(1);
+  const bool fp16 = state.range(2);
+  const int C = stage.channels;
+
+  Workspace ws;
+  const auto x_dims =
+      Shape(nhwc, kBatch, C, stage.length, stage.size, stage.size);
+  if (fp16) {
+    FillCUDA<float16>(&ws, "X", x_dims);
+  } else {
+    FillCUDA<float>(&ws, "X", x_dims);
+  }
+  for (const string& name : {"scale", "bias", "mean", "var"}) {
+    FillCUDA<float>(&ws, name, {C});
+  }
+  // test mode, as the frozen BN of fine-tuning
+  OperatorDef def =
+      CuDNNOpDef("SpatialBN", {"X", "scale", "bias", "mean", "var"}, nhwc);
+  AddArg(&def, "is_test", 1);
+  RunOp(state, &ws, def);
+}
+void SpatialBN3dArgs(benchmark::internal::Benchmark* b) {
+  for (int stage = 0; stage < 4; ++stage) {
+    for (int nhwc = 0; nhwc < 2; ++nhwc) {
+      for (int fp16 = 0; fp16 < 2; ++fp16) {
+        b->Args({stage, nhwc, fp16});
+      }
+    }
+  }
+}
+BENCHMARK(BM_SpatialBN3d)
+    ->Apply(SpatialBN3dArgs)
+    ->Unit(benchmark::kMicrosecond);
+
+// pool1 of the net: 1x3x3, stride 1x2x2 on the 64 x 8 x 112 x 112 output of
+// conv1; range(0): NHWC, range(1): float16
+void BM_MaxPool3d(benchmark::State& state) {
+  CAFFE2_SKIP_IF_NO_GPU;
+  const bool nhwc = state.range(0);
+  const bool fp16 = state.range(1);
+
+  Workspace ws;
+  const auto x_dims = Shape(nhwc, kBatch, 64, 8, 112, 112);
+  if (fp16) {
+    FillCUDA<float16>(&ws, "X", x_dims);
+  } else {
+    FillCUDA<float>(&ws, "X", x_dims);
+  }
+  OperatorDef def = CuDNNOpDef("MaxPool", {"X"}, nhwc);
+  AddArgs(&def, "kernels", {1, 3, 3});
+  AddArgs(&def, "pads", {0, 1, 1, 0, 1, 1});
+  AddArgs(&def, "strides", {1, 2, 2});
+  RunOp(state, &ws, def);
+}
+BENCHMARK(BM_MaxPool3d)
+    ->Args({0, 0})
+    ->Args({0, 1})
+    ->Args({1, 0})
+    ->Args({1, 1})
+    ->Unit(benchmark::kMicrosecond);
+
+} // namespace
+
+BENCHMARK_MAIN()
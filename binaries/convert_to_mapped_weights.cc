@@ -0,0 +1,61 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "caffe2/core/flags.h"
+#include "caffe2/core/init.h"
+#include "caffe2/core/mapped_weights.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/proto_utils.h"
+
+CAFFE2_DEFINE_string(init_net, "", "The given path to the init protobuffer.");
+CAFFE2_DEFINE_string(output, "", "The mapped weights file to write.");
+
+namespace caffe2 {
+
+// Runs an init net, e.g. the init_net.pb of a predictor, and writes the CPU
+// tensors it creates to a mapped weights file for Predictor(weights_file,
+// run_net).
+void run() {
+  if (FLAGS_init_net.empty()) {
+    LOG(FATAL) << "No init net specified. Use --init_net=/path/to/net.";
+  }
+  if (FLAGS_output.empty()) {
+    LOG(FATAL) << "No output specified. Use --output=/path/to/weights.";
+  }
+  NetDef init_net;
+  CAFFE_ENFORCE(ReadProtoFromFile(FLAGS_init_net, &init_net));
+  Workspace ws;
+  CAFFE_ENFORCE(ws.RunNetOnce(init_net));
+  std::vector<string> blobs;
+  for (const auto& name : ws.Blobs()) {
+    if (ws.GetBlob(name)->IsType<TensorCPU>()) {
+      blobs.push_back(name);
+    } else {
+      LOG(WARNING) << "Skipping " << name << ", which is not a CPU tensor";
+    }
+  }
+  SaveMappedWeights(FLAGS_output, ws, blobs);
+  LOG(INFO) << "Wrote " << blobs.size() << " tensors to " << FLAGS_output;
+}
+}
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  caffe2::run();
+  caffe2::ShutdownProtobufLibrary();
+  return 0;
+}
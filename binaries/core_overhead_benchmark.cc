@@ -18,7 +18,9 @@
 
 #include "caffe2/core/context.h"
 #include "caffe2/core/context_gpu.h"
+#include "caffe2/core/net.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/utils/proto_utils.h"
 
 #define CAFFE2_SKIP_IF_NO_GPU                                      \
   if (!caffe2::NumCudaDevices()) {                                 \
@@ -220,4 +222,68 @@ static void BM_TensorAllocDeallocCUDA(benchmark::State& state) {
 }
 BENCHMARK(BM_TensorAllocDeallocCUDA);
 
+namespace {
+// A net of num_ops tiny ops, as the BN, affine, reshape and per-param update
+// ops that make up most of the ops of the video train nets: chains of Scale,
+// Relu and Add on 64 floats, whose run time is the overhead of the net and of
+// the ops. Compares the simple net against the compiled one.
+void RunTinyOpsNet(
+    benchmark::State& state,
+    const string& net_type,
+    DeviceType device_type) {
+  const int num_ops = state.range(0);
+  Workspace ws;
+  DeviceOption option;
+  option.set_device_type(device_type);
+
+  NetDef init_net;
+  {
+    auto* op = init_net.add_op();
+    op->set_type("ConstantFill");
+    op->add_output("x0");
+    AddArgument("shape", vector<int>{64}, op);
+    AddArgument("value", 1.0f, op);
+  }
+  init_net.mutable_device_option()->CopyFrom(option);
+  CAFFE_ENFORCE(ws.RunNetOnce(init_net));
+
+  NetDef net_def;
+  net_def.set_name("tiny_ops_" + net_type);
+  net_def.set_type(net_type);
+  net_def.add_external_input("x0");
+  const char* types[] = {"Scale", "Relu", "Add"};
+  for (int i = 0; i < num_ops; ++i) {
+    auto* op = net_def.add_op();
+    op->set_type(types[i % 3]);
+    op->add_input("x" + caffe2::to_string(i));
+    if (i % 3 == 2) {
+      op->add_input("x0");
+    }
+    op->add_output("x" + caffe2::to_string(i + 1));
+  }
+  net_def.mutable_device_option()->CopyFrom(option);
+  NetBase* net = ws.CreateNet(net_def);
+  CAFFE_ENFORCE(net);
+  // the first run plans the compiled net
+  CAFFE_ENFORCE(net->Run());
+  while (state.KeepRunning()) {
+    CAFFE_ENFORCE(net->Run());
+  }
+  state.SetItemsProcessed(state.iterations() * num_ops);
+}
+}  // namespace
+
+static void BM_TinyOpsNetCPU(benchmark::State& state, const string& net_type) {
+  RunTinyOpsNet(state, net_type, CPU);
+}
+BENCHMARK_CAPTURE(BM_TinyOpsNetCPU, simple, string("simple"))->Arg(1000);
+BENCHMARK_CAPTURE(BM_TinyOpsNetCPU, compiled, string("compiled"))->Arg(1000);
+
+static void BM_TinyOpsNetCUDA(benchmark::State& state, const string& net_type) {
+  CAFFE2_SKIP_IF_NO_GPU;
+  RunTinyOpsNet(state, net_type, CUDA);
+}
+BENCHMARK_CAPTURE(BM_TinyOpsNetCUDA, simple, string("simple"))->Arg(1000);
+BENCHMARK_CAPTURE(BM_TinyOpsNetCUDA, compiled, string("compiled"))->Arg(1000);
+
 BENCHMARK_MAIN()
@@ -0,0 +1,646 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// This tool converts a video dataset to a database of the header records of
+// caffe2/video/video_record.h, which the video input op reads without
+// protobuf. It replaces process_data/kinetics/create_video_lmdb.py and
+// downscale_video_joblib.py with one pass over the list in a thread pool.
+//
+// caffe2::FLAGS_list_file holds a video and its comma separated labels per
+// line, as the lists of create_video_lmdb.py:
+//
+//   abseiling/0347ZoDXyP0_000095_000105.mp4 0
+//   air_drumming/03V2idM7_KY_000003_000013.mp4 1,4
+//   ...
+//
+// With caffe2::FLAGS_transcode_folder, every video is first re-encoded with
+// its short side scaled to caffe2::FLAGS_short_side and a key frame every
+// caffe2::FLAGS_gop_size frames, to the same relative path under that
+// folder; the records then point to (or hold) the transcoded videos. With
+// caffe2::FLAGS_with_meta, the records also carry the frame count, fps,
+// frame size and key frame indices of their video ("VRMF" records), as
+// create_video_meta_index.py probes them.
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/db.h"
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/video/video_record.h"
+
+CAFFE2_DEFINE_string(
+    list_file,
+    "",
+    "The text file of videos and their comma separated labels.");
+CAFFE2_DEFINE_string(input_folder, "", "The folder the videos are under.");
+CAFFE2_DEFINE_string(output_db_name, "", "The output db name.");
+CAFFE2_DEFINE_string(db, "lmdb", "The db type.");
+CAFFE2_DEFINE_bool(shuffle, false, "Randomly shuffle the order of the videos");
+CAFFE2_DEFINE_bool(
+    store_video,
+    false,
+    "If set, the records hold the encoded videos instead of their paths.");
+CAFFE2_DEFINE_bool(
+    with_meta,
+    true,
+    "If set, the records carry the meta data and key frames of the videos.");
+CAFFE2_DEFINE_string(
+    transcode_folder,
+    "",
+    "If set, re-encode the videos to this folder first.");
+CAFFE2_DEFINE_int(
+    short_side,
+    256,
+    "The short side of the transcoded videos, 0 to keep their size.");
+CAFFE2_DEFINE_int(
+    gop_size,
+    0,
+    "Frames between two key frames of the transcoded videos, 0 for the "
+    "encoder default.");
+CAFFE2_DEFINE_string(codec, "libx264", "The encoder of the transcoded videos.");
+CAFFE2_DEFINE_string(crf, "18", "The constant rate factor of libx264.");
+CAFFE2_DEFINE_int(
+    codec_threads,
+    1,
+    "Threads of the decoder and the encoder of each video.");
+CAFFE2_DEFINE_int(num_threads, -1, "Number of video conversion threads.");
+CAFFE2_DEFINE_int(
+    batch_size,
+    1000,
+    "Number of records written in one db transaction.");
+
+namespace caffe2 {
+
+namespace {
+
+struct VideoItem {
+  std::string path;
+  std::vector<int32_t> labels;
+};
+
+struct VideoMeta {
+  int num_frames = 0;
+  float fps = 0;
+  int width = 0;
+  int height = 0;
+  std::vector<int32_t> key_frames;
+};
+
+std::string AvError(const int ret) {
+  char buf[256];
+  av_strerror(ret, buf, sizeof(buf));
+  return buf;
+}
+
+// the folders of path, as mkdir -p
+void MakeParentDirs(const std::string& path) {
+  for (size_t pos = path.find('/', 1); pos != std::string::npos;
+       pos = path.find('/', pos + 1)) {
+    mkdir(path.substr(0, pos).c_str(), 0755);
+  }
+}
+
+// Frame count, fps, frame size and key frame indices of the first video
+// stream of path, from its packets, without decoding: the same as
+// probe_video_meta of create_video_meta_index.py.
+bool ProbeVideoMeta(
+    const std::string& path,
+    VideoMeta* meta,
+    std::string* error) {
+  AVFormatContext* input = nullptr;
+  int ret = avformat_open_input(&input, path.c_str(), nullptr, nullptr);
+  if (ret < 0) {
+    *error = "cannot open: " + AvError(ret);
+    return false;
+  }
+  ret = avformat_find_stream_info(input, nullptr);
+  const int index = ret < 0
+      ? ret
+      : av_find_best_stream(input, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  if (index < 0) {
+    *error = "no video stream: " + AvError(index);
+    avformat_close_input(&input);
+    return false;
+  }
+  const AVStream* stream = input->streams[index];
+  meta->fps = stream->avg_frame_rate.den > 0 ? av_q2d(stream->avg_frame_rate)
+                                              : 0;
+  meta->width = stream->codecpar->width;
+  meta->height = stream->codecpar->height;
+  meta->num_frames = 0;
+  meta->key_frames.clear();
+
+  AVPacket packet;
+  av_init_packet(&packet);
+  packet.data = nullptr;
+  packet.size = 0;
+  while (av_read_frame(input, &packet) >= 0) {
+    if (packet.stream_index == index) {
+      if (packet.flags & AV_PKT_FLAG_KEY) {
+        meta->key_frames.push_back(meta->num_frames);
+      }
+      ++meta->num_frames;
+    }
+    av_packet_unref(&packet);
+  }
+  avformat_close_input(&input);
+  if (meta->num_frames == 0) {
+    *error = "no video frames";
+    return false;
+  }
+  return true;
+}
+
+// Re-encodes the first video stream of a file; the audio is dropped, as the
+// input ops only read the video. The frames keep their order and get the
+// constant frame rate of the input.
+class Transcoder {
+ public:
+  ~Transcoder() {
+    sws_freeContext(scaler_);
+    av_frame_free(&frame_);
+    av_frame_free(&scaled_);
+    avcodec_free_context(&decoder_);
+    avcodec_free_context(&encoder_);
+    avformat_close_input(&input_);
+    if (output_) {
+      if (!(output_->oformat->flags & AVFMT_NOFILE)) {
+        avio_closep(&output_->pb);
+      }
+      avformat_free_context(output_);
+    }
+  }
+
+  bool Run(const std::string& src, const std::string& dst, std::string* e) {
+    return Open(src, dst, e) && Transcode(e) && Finish(e);
+  }
+
+ private:
+  bool Check(const int ret, const char* what, std::string* error) {
+    if (ret < 0) {
+      *error = std::string(what) + ": " + AvError(ret);
+      return false;
+    }
+    return true;
+  }
+
+  bool Open(const std::string& src, const std::string& dst, std::string* e) {
+    if (!Check(
+            avformat_open_input(&input_, src.c_str(), nullptr, nullptr),
+            "cannot open",
+            e) ||
+        !Check(avformat_find_stream_info(input_, nullptr), "cannot probe", e)) {
+      return false;
+    }
+    AVCodec* decoder = nullptr;
+    index_ =
+        av_find_best_stream(input_, AVMEDIA_TYPE_VIDEO, -1, -1, &decoder, 0);
+    if (!Check(index_, "no video stream", e)) {
+      return false;
+    }
+    AVStream* in = input_->streams[index_];
+    decoder_ = avcodec_alloc_context3(decoder);
+    if (!Check(
+            avcodec_parameters_to_context(decoder_, in->codecpar),
+            "cannot copy the codec parameters",
+            e)) {
+      return false;
+    }
+    decoder_->thread_count = FLAGS_codec_threads;
+    if (!Check(
+            avcodec_open2(decoder_, decoder, nullptr),
+            "cannot open the decoder",
+            e)) {
+      return false;
+    }
+
+    // the short side scaled, the sizes even for yuv420p
+    int width = decoder_->width;
+    int height = decoder_->height;
+    if (FLAGS_short_side > 0) {
+      const double scale =
+          double(FLAGS_short_side) / std::min(decoder_->width, decoder_->height);
+      width = int(decoder_->width * scale / 2 + 0.5) * 2;
+      height = int(decoder_->height * scale / 2 + 0.5) * 2;
+    } else {
+      width -= width % 2;
+      height -= height % 2;
+    }
+
+    if (!Check(
+            avformat_alloc_output_context2(
+                &output_, nullptr, nullptr, dst.c_str()),
+            "cannot create the output",
+            e)) {
+      return false;
+    }
+    AVCodec* encoder = avcodec_find_encoder_by_name(FLAGS_codec.c_str());
+    if (!encoder) {
+      *e = "no encoder " + FLAGS_codec;
+      return false;
+    }
+    encoder_ = avcodec_alloc_context3(encoder);
+    AVRational rate = av_guess_frame_rate(input_, in, nullptr);
+    if (rate.num <= 0 || rate.den <= 0) {
+      rate = AVRational{25, 1};
+    }
+    encoder_->width = width;
+    encoder_->height = height;
+    encoder_->pix_fmt = AV_PIX_FMT_YUV420P;
+    encoder_->sample_aspect_ratio = decoder_->sample_aspect_ratio;
+    encoder_->time_base = av_inv_q(rate);
+    encoder_->framerate = rate;
+    encoder_->thread_count = FLAGS_codec_threads;
+    if (FLAGS_gop_size > 0) {
+      encoder_->gop_size = FLAGS_gop_size;
+      encoder_->keyint_min = FLAGS_gop_size;
+    }
+    if (output_->oformat->flags & AVFMT_GLOBALHEADER) {
+      encoder_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    AVDictionary* options = nullptr;
+    if (FLAGS_codec == "libx264") {
+      av_dict_set(&options, "crf", FLAGS_crf.c_str(), 0);
+      if (FLAGS_gop_size > 0) {
+        // no scene cut key frames in between
+        av_dict_set(&options, "x264-params", "scenecut=0", 0);
+      }
+    }
+    const int ret = avcodec_open2(encoder_, encoder, &options);
+    av_dict_free(&options);
+    if (!Check(ret, "cannot open the encoder", e)) {
+      return false;
+    }
+
+    out_ = avformat_new_stream(output_, nullptr);
+    if (!out_) {
+      *e = "cannot create the output stream";
+      return false;
+    }
+    out_->time_base = encoder_->time_base;
+    if (!Check(
+            avcodec_parameters_from_context(out_->codecpar, encoder_),
+            "cannot copy the encoder parameters",
+            e)) {
+      return false;
+    }
+    if (!(output_->oformat->flags & AVFMT_NOFILE) &&
+        !Check(
+            avio_open(&output_->pb, dst.c_str(), AVIO_FLAG_WRITE),
+            "cannot write",
+            e)) {
+      return false;
+    }
+    if (!Check(
+            avformat_write_header(output_, nullptr),
+            "cannot write the header",
+            e)) {
+      return false;
+    }
+
+    frame_ = av_frame_alloc();
+    scaled_ = av_frame_alloc();
+    scaled_->format = encoder_->pix_fmt;
+    scaled_->width = width;
+    scaled_->height = height;
+    return Check(av_frame_get_buffer(scaled_, 32), "cannot allocate", e);
+  }
+
+  bool Transcode(std::string* e) {
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = nullptr;
+    packet.size = 0;
+    bool ok = true;
+    while (ok && av_read_frame(input_, &packet) >= 0) {
+      if (packet.stream_index == index_) {
+        ok = Decode(&packet, e);
+      }
+      av_packet_unref(&packet);
+    }
+    // flush the decoder, then the encoder
+    return ok && Decode(nullptr, e) && Encode(nullptr, e);
+  }
+
+  bool Decode(const AVPacket* packet, std::string* e) {
+    int ret = avcodec_send_packet(decoder_, packet);
+    if (ret == AVERROR_EOF) {
+      return true;
+    }
+    if (!Check(ret, "cannot decode", e)) {
+      return false;
+    }
+    while ((ret = avcodec_receive_frame(decoder_, frame_)) >= 0) {
+      if (!scaler_) {
+        scaler_ = sws_getContext(
+            frame_->width,
+            frame_->height,
+            static_cast<AVPixelFormat>(frame_->format),
+            scaled_->width,
+            scaled_->height,
+            encoder_->pix_fmt,
+            SWS_AREA,
+            nullptr,
+            nullptr,
+            nullptr);
+        if (!scaler_) {
+          *e = "cannot scale";
+          return false;
+        }
+      }
+      if (!Check(av_frame_make_writable(scaled_), "cannot allocate", e)) {
+        return false;
+      }
+      sws_scale(
+          scaler_,
+          frame_->data,
+          frame_->linesize,
+          0,
+          frame_->height,
+          scaled_->data,
+          scaled_->linesize);
+      scaled_->pts = numFrames_++;
+      av_frame_unref(frame_);
+      if (!Encode(scaled_, e)) {
+        return false;
+      }
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ||
+        Check(ret, "cannot decode", e);
+  }
+
+  bool Encode(const AVFrame* frame, std::string* e) {
+    if (!Check(avcodec_send_frame(encoder_, frame), "cannot encode", e)) {
+      return false;
+    }
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = nullptr;
+    packet.size = 0;
+    int ret;
+    while ((ret = avcodec_receive_packet(encoder_, &packet)) >= 0) {
+      av_packet_rescale_ts(&packet, encoder_->time_base, out_->time_base);
+      packet.stream_index = out_->index;
+      ret = av_interleaved_write_frame(output_, &packet);
+      av_packet_unref(&packet);
+      if (!Check(ret, "cannot write", e)) {
+        return false;
+      }
+    }
+    return ret == AVERROR(EAGAIN) || ret == AVERROR_EOF ||
+        Check(ret, "cannot encode", e);
+  }
+
+  bool Finish(std::string* e) {
+    if (numFrames_ == 0) {
+      *e = "no video frames";
+      return false;
+    }
+    return Check(av_write_trailer(output_), "cannot write the trailer", e);
+  }
+
+  AVFormatContext* input_ = nullptr;
+  AVFormatContext* output_ = nullptr;
+  AVCodecContext* decoder_ = nullptr;
+  AVCodecContext* encoder_ = nullptr;
+  AVStream* out_ = nullptr;
+  SwsContext* scaler_ = nullptr;
+  AVFrame* frame_ = nullptr;
+  AVFrame* scaled_ = nullptr;
+  int index_ = -1;
+  int64_t numFrames_ = 0;
+};
+
+// Converts the videos queued to it in its own thread, handing out their
+// records in order; an empty record for a video that failed.
+class Converter {
+ public:
+  ~Converter() {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  void queue(const VideoItem* item) {
+    in_.push(item);
+  }
+
+  void start() {
+    thread_ = std::thread(&Converter::run, this);
+  }
+
+  std::string get() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (out_.empty()) {
+      cv_.wait(lock);
+    }
+    auto value = std::move(out_.front());
+    out_.pop();
+    cv_.notify_one();
+    return value;
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!in_.empty()) {
+      const VideoItem* item = in_.front();
+      in_.pop();
+      lock.unlock();
+
+      std::string value;
+      std::string error;
+      if (!convert(*item, &value, &error)) {
+        LOG(ERROR) << "Skipping " << item->path << ": " << error;
+        value.clear();
+      }
+
+      // let the converter run a few videos ahead of the db writes
+      lock.lock();
+      while (out_.size() >= kMaxAhead) {
+        cv_.wait(lock);
+      }
+      out_.push(std::move(value));
+      cv_.notify_one();
+    }
+  }
+
+ private:
+  static constexpr size_t kMaxAhead = 4;
+
+  bool convert(const VideoItem& item, std::string* value, std::string* e) {
+    std::string path = FLAGS_input_folder + item.path;
+    if (!FLAGS_transcode_folder.empty()) {
+      const std::string dst = FLAGS_transcode_folder + "/" + item.path;
+      MakeParentDirs(dst);
+      Transcoder transcoder;
+      if (!transcoder.Run(path, dst, e)) {
+        return false;
+      }
+      path = dst;
+    }
+
+    VideoMeta meta;
+    if (FLAGS_with_meta && !ProbeVideoMeta(path, &meta, e)) {
+      return false;
+    }
+    std::string video;
+    if (FLAGS_store_video) {
+      std::ifstream file(path, std::ios::binary);
+      if (!file) {
+        *e = "cannot read";
+        return false;
+      }
+      video.assign(
+          std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>());
+    } else {
+      video = path;
+    }
+
+    VideoRecord record;
+    record.payload = video.data();
+    record.payload_size = video.size();
+    record.label_data = reinterpret_cast<const char*>(item.labels.data());
+    record.num_labels = item.labels.size();
+    record.start_frm = -1;
+    record.spatial_pos = -1;
+    record.num_frames = FLAGS_with_meta ? meta.num_frames : -1;
+    record.fps = FLAGS_with_meta ? meta.fps : -1;
+    record.width = FLAGS_with_meta ? meta.width : -1;
+    record.height = FLAGS_with_meta ? meta.height : -1;
+    record.key_frame_data =
+        reinterpret_cast<const char*>(meta.key_frames.data());
+    record.num_key_frames = meta.key_frames.size();
+    *value = SerializeVideoRecord(record);
+    return true;
+  }
+
+  std::queue<const VideoItem*> in_;
+  std::queue<std::string> out_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+};
+
+constexpr size_t Converter::kMaxAhead;
+
+std::vector<VideoItem> ReadList(const std::string& list_filename) {
+  std::ifstream list_file(list_filename);
+  CAFFE_ENFORCE(list_file, "Cannot open ", list_filename);
+  std::vector<VideoItem> items;
+  std::string line;
+  while (std::getline(list_file, line)) {
+    std::istringstream tokens(line);
+    VideoItem item;
+    std::string labels;
+    if (!(tokens >> item.path >> labels)) {
+      continue;
+    }
+    std::istringstream label_tokens(labels);
+    std::string label;
+    while (std::getline(label_tokens, label, ',')) {
+      item.labels.push_back(std::stoi(label));
+    }
+    items.push_back(std::move(item));
+  }
+  return items;
+}
+
+} // namespace
+
+void ConvertVideoDataset(
+    const string& list_filename,
+    const string& output_db_name) {
+  auto items = ReadList(list_filename);
+  if (FLAGS_shuffle) {
+    LOG(INFO) << "Shuffling data";
+    std::shuffle(items.begin(), items.end(), std::default_random_engine(1701));
+  }
+
+  av_register_all();
+  avcodec_register_all();
+  av_log_set_level(AV_LOG_ERROR);
+
+  auto num_threads = FLAGS_num_threads;
+  if (num_threads < 1) {
+    num_threads = std::thread::hardware_concurrency();
+  }
+
+  LOG(INFO) << "Processing " << items.size() << " videos...";
+  LOG(INFO) << "Opening DB " << output_db_name;
+  auto db = db::CreateDB(FLAGS_db, output_db_name, db::NEW);
+  auto transaction = db->NewTransaction();
+
+  LOG(INFO) << "Using " << num_threads << " processing threads...";
+  std::vector<Converter> converters(num_threads);
+  for (auto i = 0; i < items.size(); i++) {
+    converters[i % converters.size()].queue(&items[i]);
+  }
+  for (auto& converter : converters) {
+    converter.start();
+  }
+
+  // the keys of create_video_lmdb.py, numbering the converted videos
+  char key[16];
+  int count = 0;
+  int skipped = 0;
+  for (auto i = 0; i < items.size(); i++) {
+    const auto value = converters[i % converters.size()].get();
+    if (value.empty()) {
+      ++skipped;
+      continue;
+    }
+    snprintf(key, sizeof(key), "%09d", count);
+    transaction->Put(string(key), value);
+    if (++count % FLAGS_batch_size == 0) {
+      transaction->Commit();
+      LOG(INFO) << "Processed " << count << " videos.";
+    }
+  }
+
+  transaction->Commit();
+  LOG(INFO) << "Processed " << count << " videos, skipped " << skipped << ".";
+}
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  caffe2::ConvertVideoDataset(
+      caffe2::FLAGS_list_file, caffe2::FLAGS_output_db_name);
+  return 0;
+}
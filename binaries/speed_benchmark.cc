@@ -70,6 +70,14 @@ CAFFE2_DEFINE_bool(
     false,
     "Whether to benchmark individual operators.");
 
+CAFFE2_DEFINE_bool(
+    video,
+    false,
+    "Whether the first input is a video clip of N x C x T x H x W. Also "
+    "reports the time per clip and the frames per second of the main runs. "
+    "Use with --input_dims (e.g. 1,3,8,224,224) and --engine MOBILE for the "
+    "ARM 3D convs.");
+
 CAFFE2_DEFINE_bool(force_engine, false, "Force engine field for all operators");
 CAFFE2_DEFINE_string(engine, "", "Forced engine field value");
 CAFFE2_DEFINE_bool(force_algo, false, "Force algo arg for all operators");
@@ -167,8 +175,19 @@ int main(int argc, char** argv) {
   }
   caffe2::NetBase* net = workspace->CreateNet(net_def);
   CHECK_NOTNULL(net);
-  net->TEST_Benchmark(
+  const vector<float> millis = net->TEST_Benchmark(
       caffe2::FLAGS_warmup, caffe2::FLAGS_iter, caffe2::FLAGS_run_individual);
+  if (caffe2::FLAGS_video && millis.size()) {
+    CAFFE_ENFORCE(caffe2::FLAGS_input.size(), "Video mode needs the input.");
+    const string clip_name = caffe2::split(',', caffe2::FLAGS_input)[0];
+    const auto& clip = workspace->GetBlob(clip_name)->Get<caffe2::TensorCPU>();
+    CAFFE_ENFORCE_EQ(clip.ndim(), 5, "Video clips are N x C x T x H x W.");
+    const float millis_per_clip = millis[0] / clip.dim32(0);
+    // Use std::cout because logging may be disabled
+    std::cout << "Milliseconds per clip: " << millis_per_clip
+              << ". Frames per second: "
+              << 1000.0 * clip.dim32(2) / millis_per_clip << std::endl;
+  }
 
   string output_prefix = caffe2::FLAGS_output_folder.size()
       ? caffe2::FLAGS_output_folder + "/"
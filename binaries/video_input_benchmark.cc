@@ -0,0 +1,228 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Runs the CustomizedVideoInput op on the CPU against a db, for every
+// combination of the comma separated values of the sweep flags, and reports
+// the clips per second, the p50 and p99 time of a batch and the time of the
+// stages of a clip. The stage times are thread time, summed over the decode
+// threads, so clips/s of a GPU times the stage sum is the CPU time the GPU
+// needs. Arguments of the op that are not swept go to --args, e.g.
+//
+//   video_input_benchmark --input_db=kinetics/train --use_local_file \
+//       --decode_threads=4,8,16 --lengths=8,32 --sampling_rates=8,2 \
+//       --args=use_decoder_scaling=1,use_selective_decoding=1
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/stats.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(input_db, "", "The input db.");
+CAFFE2_DEFINE_string(input_db_type, "lmdb", "The input db type.");
+CAFFE2_DEFINE_bool(
+    use_local_file,
+    false,
+    "If set, the records hold the paths of the videos.");
+CAFFE2_DEFINE_string(decode_threads, "4", "Decode threads to sweep.");
+CAFFE2_DEFINE_string(batch_sizes, "8", "Batch sizes to sweep.");
+CAFFE2_DEFINE_string(lengths, "32", "Clip lengths to sweep.");
+CAFFE2_DEFINE_string(sampling_rates, "2", "Sampling rates to sweep.");
+CAFFE2_DEFINE_string(
+    scales,
+    "256-320",
+    "Ranges of the short side scaled to, as min_size-max_size, to sweep.");
+CAFFE2_DEFINE_string(crops, "224", "Crop sizes to sweep.");
+CAFFE2_DEFINE_string(
+    args,
+    "",
+    "Integer arguments of the op for all runs, as name=value,...");
+CAFFE2_DEFINE_int(warmup, 10, "Batches run before the timing starts.");
+CAFFE2_DEFINE_int(iterations, 50, "Batches timed per run.");
+
+namespace caffe2 {
+
+namespace {
+
+struct BenchmarkConfig {
+  int decode_threads;
+  int batch_size;
+  int length;
+  int sampling_rate;
+  int min_size;
+  int max_size;
+  int crop;
+};
+
+std::vector<int> ParseInts(const string& values) {
+  std::vector<int> ints;
+  for (const auto& value : split(',', values)) {
+    ints.push_back(std::stoi(value));
+  }
+  CAFFE_ENFORCE(!ints.empty(), "No values in ", values);
+  return ints;
+}
+
+std::vector<BenchmarkConfig> SweepConfigs() {
+  std::vector<std::pair<int, int>> scales;
+  for (const auto& scale : split(',', FLAGS_scales)) {
+    const auto sizes = split('-', scale);
+    CAFFE_ENFORCE_EQ(sizes.size(), 2, "Scales are min_size-max_size.");
+    scales.emplace_back(std::stoi(sizes[0]), std::stoi(sizes[1]));
+  }
+  std::vector<BenchmarkConfig> configs;
+  for (const int threads : ParseInts(FLAGS_decode_threads)) {
+    for (const int batch_size : ParseInts(FLAGS_batch_sizes)) {
+      for (const int length : ParseInts(FLAGS_lengths)) {
+        for (const int rate : ParseInts(FLAGS_sampling_rates)) {
+          for (const auto& scale : scales) {
+            for (const int crop : ParseInts(FLAGS_crops)) {
+              configs.push_back(BenchmarkConfig{threads,
+                                                batch_size,
+                                                length,
+                                                rate,
+                                                scale.first,
+                                                scale.second,
+                                                crop});
+            }
+          }
+        }
+      }
+    }
+  }
+  return configs;
+}
+
+OperatorDef VideoInputDef(const BenchmarkConfig& config) {
+  std::vector<Argument> args{
+      MakeArgument<int>("batch_size", config.batch_size),
+      MakeArgument<int>("decode_threads", config.decode_threads),
+      MakeArgument<int>("length", config.length),
+      MakeArgument<int>("sampling_rate", config.sampling_rate),
+      MakeArgument<int>("use_scale_augmentaiton", 1),
+      MakeArgument<int>("min_size", config.min_size),
+      MakeArgument<int>("max_size", config.max_size),
+      MakeArgument<int>("crop", config.crop),
+      MakeArgument<int>("mirror", 1),
+      MakeArgument<int>("use_local_file", FLAGS_use_local_file)};
+  bool output_clip_index = false;
+  if (!FLAGS_args.empty()) {
+    for (const auto& arg : split(',', FLAGS_args)) {
+      const auto name_value = split('=', arg);
+      CAFFE_ENFORCE_EQ(name_value.size(), 2, "Arguments are name=value.");
+      const int value = std::stoi(name_value[1]);
+      args.push_back(MakeArgument<int>(name_value[0], value));
+      output_clip_index |= name_value[0] == "output_clip_index" && value;
+    }
+  }
+  std::vector<string> outputs{"data", "label"};
+  if (output_clip_index) {
+    outputs.push_back("video_id");
+    outputs.push_back("clip_index");
+  }
+  return CreateOperatorDef(
+      "CustomizedVideoInput", "", std::vector<string>{"reader"}, outputs, args);
+}
+
+// ms per clip of the stage from the /sum of its exported stat
+double StageMs(
+    const ExportedStatMap& stats,
+    const string& name,
+    const int64_t clips) {
+  const auto it = stats.find(name + "/sum");
+  return it == stats.end() || clips == 0 ? 0 : it->second / 1e6 / clips;
+}
+
+void RunConfig(const BenchmarkConfig& config) {
+  Workspace ws;
+  auto create_db = CreateOperator(
+      CreateOperatorDef(
+          "CreateDB",
+          "",
+          std::vector<string>{},
+          std::vector<string>{"reader"},
+          std::vector<Argument>{MakeArgument<string>("db", FLAGS_input_db),
+                                MakeArgument<string>(
+                                    "db_type", FLAGS_input_db_type)}),
+      &ws);
+  CAFFE_ENFORCE(create_db->Run());
+  auto op = CreateOperator(VideoInputDef(config), &ws);
+
+  for (int i = 0; i < FLAGS_warmup; ++i) {
+    CAFFE_ENFORCE(op->Run());
+  }
+  StatRegistry::get().publish(true);
+  std::vector<float> batch_ms;
+  Timer total;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    Timer timer;
+    CAFFE_ENFORCE(op->Run());
+    batch_ms.push_back(timer.MilliSeconds());
+  }
+  const double seconds = total.Seconds();
+  const auto stats = toMap(StatRegistry::get().publish(true));
+  // the prefetch thread runs ahead of the timed batches, so the stages are
+  // averaged over the clips they ran on in the meantime
+  const auto parsed = stats.find("data/parse_time_ns/count");
+  const int64_t clips = parsed == stats.end() ? 0 : parsed->second;
+
+  std::sort(batch_ms.begin(), batch_ms.end());
+  const size_t p99 = std::min(batch_ms.size() * 99 / 100, batch_ms.size() - 1);
+  const double decode = StageMs(stats, "data/decode_time_ns", clips);
+  const double sws = StageMs(stats, "video_decoder/sws_time_ns", clips);
+  printf(
+      "threads %3d batch %3d length %3d rate %2d scale %d-%d crop %3d: "
+      "%8.2f clips/s, batch p50 %8.2f ms p99 %8.2f ms; per clip: "
+      "db read %6.2f ms, parse %6.2f ms, decode %7.2f ms, sws %6.2f ms, "
+      "resize+crop %6.2f ms\n",
+      config.decode_threads,
+      config.batch_size,
+      config.length,
+      config.sampling_rate,
+      config.min_size,
+      config.max_size,
+      config.crop,
+      FLAGS_iterations * config.batch_size / seconds,
+      batch_ms[batch_ms.size() / 2],
+      batch_ms[p99],
+      StageMs(stats, "data/db_read_time_ns", clips),
+      StageMs(stats, "data/parse_time_ns", clips),
+      decode - sws,
+      sws,
+      StageMs(stats, "data/transform_time_ns", clips));
+  fflush(stdout);
+}
+
+} // namespace
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  CAFFE_ENFORCE(!caffe2::FLAGS_input_db.empty(), "Provide --input_db.");
+  CAFFE_ENFORCE_GT(caffe2::FLAGS_iterations, 0);
+  for (const auto& config : caffe2::SweepConfigs()) {
+    caffe2::RunConfig(config);
+  }
+  return 0;
+}
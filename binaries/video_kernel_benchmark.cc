@@ -0,0 +1,271 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/video/customized_video_io.h"
+#include "caffe2/video/nonlocal_attention.h"
+
+using namespace caffe2;
+
+namespace {
+
+// The CPU kernels of the video input and of the non-local net at the shapes
+// they run at in training and testing. The SIMD perfkernels they call are
+// compared against their scalar paths in video_transform_benchmark.
+constexpr int kChannels = 3;
+constexpr float kMean = 114.75f;
+constexpr float kStd = 57.375f;
+
+// a clip short side scaled to 256 and cropped to 224 for training, or
+// scaled to 320 and cropped to 256 for testing
+struct Crop {
+  int height;
+  int width;
+  int crop;
+};
+const Crop kCrops[] = {{256, 340, 224}, {320, 427, 256}};
+// the frames of a raw 360p decode, before the scale augmentation
+constexpr int kRawHeight = 360;
+constexpr int kRawWidth = 480;
+
+std::vector<unsigned char> RandomClip(
+    const int length,
+    const int height,
+    const int width) {
+  std::vector<unsigned char> clip(kChannels * length * height * width);
+  std::mt19937 randgen(0);
+  std::uniform_int_distribution<int> dist(0, 255);
+  for (auto& x : clip) {
+    x = dist(randgen);
+  }
+  return clip;
+}
+
+// range(0): frames, range(1): index of the crop in kCrops,
+// range(2): center crop without mirroring (testing) or random (training)
+void BM_ClipTransformFlex(benchmark::State& state) {
+  const int length = state.range(0);
+  const Crop& crop = kCrops[state.range(1)];
+  const bool center = state.range(2);
+  const auto clip = RandomClip(length, crop.height, crop.width);
+  std::vector<float> out(kChannels * length * crop.crop * crop.crop);
+  std::mt19937 randgen(0);
+  std::bernoulli_distribution mirror_this_clip(0.5);
+  while (state.KeepRunning()) {
+    ClipTransformFlex(
+        clip.data(), kChannels, length, crop.height, crop.width, crop.crop,
+        crop.crop, !center, kMean, kStd, out.data(), &randgen,
+        &mirror_this_clip, center, true, -1);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * out.size());
+}
+void ClipTransformFlexArgs(benchmark::internal::Benchmark* b) {
+  for (const int length : {8, 32, 128}) {
+    b->Args({length, 0, 0});
+    b->Args({length, 1, 1});
+  }
+}
+BENCHMARK(BM_ClipTransformFlex)
+    ->Apply(ClipTransformFlexArgs)
+    ->Unit(benchmark::kMicrosecond);
+
+// range(0): frames, range(1): short side the raw frames are scaled to
+void BM_ScaleTransform(benchmark::State& state) {
+  const int length = state.range(0);
+  const int scale = state.range(1);
+  const auto clip = RandomClip(length, kRawHeight, kRawWidth);
+  std::vector<unsigned char> buffer;
+  std::mt19937 randgen(0);
+  int new_height = 0;
+  int new_width = 0;
+  while (state.KeepRunning()) {
+    ScaleTransform(
+        clip.data(), kChannels, length, kRawHeight, kRawWidth, scale, scale,
+        buffer, &randgen, new_height, new_width);
+    benchmark::DoNotOptimize(buffer.data());
+  }
+  state.SetItemsProcessed(state.iterations() * buffer.size());
+}
+
+// the scale of BM_ScaleTransform fused with a 224 center crop and the
+// normalization; only the crop window is interpolated
+void BM_ScaleCropNormalizeTransform(benchmark::State& state) {
+  const int length = state.range(0);
+  const int scale = state.range(1);
+  const int scaled_width = scale * kRawWidth / kRawHeight;
+  constexpr int kCrop = 224;
+  const auto clip = RandomClip(length, kRawHeight, kRawWidth);
+  std::vector<float> out(kChannels * length * kCrop * kCrop);
+  std::mt19937 randgen(0);
+  std::bernoulli_distribution mirror_this_clip(0.5);
+  while (state.KeepRunning()) {
+    ScaleCropNormalizeTransform(
+        clip.data(), kChannels, length, kRawHeight, kRawWidth, scale,
+        scaled_width, kCrop, kCrop, false, kMean, kStd, out.data(), &randgen,
+        &mirror_this_clip, true, true, -1);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * out.size());
+}
+void ScaleArgs(benchmark::internal::Benchmark* b) {
+  for (const int length : {8, 32}) {
+    for (const int scale : {256, 320, 480}) {
+      b->Args({length, scale});
+    }
+  }
+}
+BENCHMARK(BM_ScaleTransform)->Apply(ScaleArgs)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ScaleCropNormalizeTransform)
+    ->Apply(ScaleArgs)
+    ->Unit(benchmark::kMicrosecond);
+
+// range(0): short side of the decoded RGB24 frame, split into its three
+// planes one channel at a time
+template <typename T>
+void BM_ImageDataToBuffer(benchmark::State& state) {
+  const int height = state.range(0);
+  const int width = height * 4 / 3;
+  auto frame = RandomClip(1, height, width);
+  std::vector<T> out(kChannels * height * width);
+  while (state.KeepRunning()) {
+    for (int c = 0; c < kChannels; ++c) {
+      ImageDataToBuffer(
+          frame.data(), height, width, out.data() + c * height * width, c);
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * height * width);
+}
+BENCHMARK_TEMPLATE(BM_ImageDataToBuffer, float)->Arg(256)->Arg(320)->Arg(480);
+BENCHMARK_TEMPLATE(BM_ImageDataToBuffer, unsigned char)
+    ->Arg(256)
+    ->Arg(320)
+    ->Arg(480);
+
+// The non-local blocks of res3 (256 embedding channels over 28x28) and of
+// res4 (512 over 14x14), with the keys max-pooled 2x2 in space. The
+// temporal length at res3 and res4 is a quarter of the input frames.
+struct NonLocalBlock {
+  int channels;
+  int size;
+};
+const NonLocalBlock kBlocks[] = {{256, 28}, {512, 14}};
+
+void RandomFill(const int size, float* data) {
+  CPUContext context;
+  math::RandGaussian<float, CPUContext>(size, 0.f, 1.f, data, &context);
+}
+
+// range(0): index of the block in kBlocks, range(1): frames of the clip;
+// the items are the flops of the two matrix products of one clip
+void BM_NonLocalAttention(benchmark::State& state) {
+  const NonLocalBlock& block = kBlocks[state.range(0)];
+  const int T = state.range(1) / 4;
+  const int C = block.channels;
+  const int Lq = T * block.size * block.size;
+  const int Lk = Lq / 4;
+  std::vector<float> theta(C * Lq);
+  std::vector<float> phi(C * Lk);
+  std::vector<float> g(C * Lk);
+  std::vector<float> Y(C * Lq);
+  std::vector<float> lse(Lq);
+  RandomFill(theta.size(), theta.data());
+  RandomFill(phi.size(), phi.data());
+  RandomFill(g.size(), g.data());
+  const float scale = 1.f / std::sqrt(static_cast<float>(C));
+  while (state.KeepRunning()) {
+    NonLocalAttentionCPU(
+        1, C, C, Lq, Lk, scale, theta.data(), phi.data(), g.data(), Y.data(),
+        lse.data());
+    benchmark::DoNotOptimize(Y.data());
+  }
+  state.SetItemsProcessed(
+      state.iterations() * 4 * static_cast<int64_t>(C) * Lq * Lk);
+}
+// res3 at 128 frames is left to the GPU benchmark
+BENCHMARK(BM_NonLocalAttention)
+    ->Args({0, 8})
+    ->Args({0, 32})
+    ->Args({1, 8})
+    ->Args({1, 32})
+    ->Args({1, 128})
+    ->Unit(benchmark::kMillisecond);
+
+// the output channels of the res2 to res5 bottlenecks of an I3D ResNet-50
+// on an 8 frame clip at 224x224
+struct Stage {
+  int channels;
+  int length;
+  int size;
+};
+const Stage kStages[] = {{256, 8, 56}, {512, 4, 28}, {1024, 4, 14}, {2048, 4, 7}};
+
+// range(0): stage, range(1): NHWC; the frozen BN of one clip
+void BM_AffineNd(benchmark::State& state) {
+  const Stage& stage = kStages[state.range(0)];
+  const bool nhwc = state.range(1);
+  Workspace ws;
+  auto* X = ws.CreateBlob("X")->GetMutable<TensorCPU>();
+  X->Resize(
+      nhwc ? std::vector<TIndex>{1, stage.length, stage.size, stage.size,
+                                 stage.channels}
+           : std::vector<TIndex>{1, stage.channels, stage.length, stage.size,
+                                 stage.size});
+  RandomFill(X->size(), X->mutable_data<float>());
+  for (const string& name : {"scale", "bias"}) {
+    auto* param = ws.CreateBlob(name)->GetMutable<TensorCPU>();
+    param->Resize(stage.channels);
+    RandomFill(param->size(), param->mutable_data<float>());
+  }
+  OperatorDef def;
+  def.set_type("AffineNd");
+  def.add_input("X");
+  def.add_input("scale");
+  def.add_input("bias");
+  def.add_output("Y");
+  auto* order = def.add_arg();
+  order->set_name("order");
+  order->set_s(nhwc ? "NHWC" : "NCHW");
+  auto op = CreateOperator(def, &ws);
+  CHECK(op->Run());
+  while (state.KeepRunning()) {
+    op->Run();
+  }
+  state.SetItemsProcessed(state.iterations() * X->size());
+}
+void AffineNdArgs(benchmark::internal::Benchmark* b) {
+  for (int stage = 0; stage < 4; ++stage) {
+    for (int nhwc = 0; nhwc < 2; ++nhwc) {
+      b->Args({stage, nhwc});
+    }
+  }
+}
+BENCHMARK(BM_AffineNd)->Apply(AffineNdArgs)->Unit(benchmark::kMicrosecond);
+
+} // namespace
+
+BENCHMARK_MAIN()
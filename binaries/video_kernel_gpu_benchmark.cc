@@ -0,0 +1,262 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/conversions.h"
+#include "caffe2/video/customized_video_transform_gpu.h"
+
+#define CAFFE2_SKIP_IF_NO_GPU                                      \
+  if (!caffe2::NumCudaDevices()) {                                 \
+    state.SkipWithError("No CUDA available, skipping benchmark."); \
+    return;                                                        \
+  }
+
+using namespace caffe2;
+
+namespace {
+
+// The CUDA kernels of the video input and of the non-local net, on the
+// batch of 8 clips per GPU of training; the CPU kernels are timed in
+// video_kernel_benchmark.
+constexpr int kBatch = 8;
+constexpr int kChannels = 3;
+
+// random values, uploaded rather than generated on the device so that
+// every type gets the same ones
+template <typename T>
+void FillCUDA(TensorCUDA* tensor, const std::vector<TIndex>& dims) {
+  TensorCPU cpu(dims);
+  std::mt19937 randgen(0);
+  std::normal_distribution<float> dist;
+  T* data = cpu.mutable_data<T>();
+  for (TIndex i = 0; i < cpu.size(); ++i) {
+    data[i] = convert::To<float, T>(dist(randgen));
+  }
+  CUDAContext context;
+  tensor->CopyFrom(cpu, &context);
+  context.FinishDeviceComputation();
+}
+
+template <typename T>
+void FillCUDA(
+    Workspace* ws,
+    const string& name,
+    const std::vector<TIndex>& dims) {
+  FillCUDA<T>(ws->CreateBlob(name)->GetMutable<TensorCUDA>(), dims);
+}
+
+void AddArg(OperatorDef* def, const string& name, const string& value) {
+  auto* arg = def->add_arg();
+  arg->set_name(name);
+  arg->set_s(value);
+}
+
+void AddArg(OperatorDef* def, const string& name, const int value) {
+  auto* arg = def->add_arg();
+  arg->set_name(name);
+  arg->set_i(value);
+}
+
+void AddArg(OperatorDef* def, const string& name, const float value) {
+  auto* arg = def->add_arg();
+  arg->set_name(name);
+  arg->set_f(value);
+}
+
+OperatorDef CUDAOpDef(const string& type, const std::vector<string>& inputs) {
+  OperatorDef def;
+  def.set_type(type);
+  def.mutable_device_option()->set_device_type(CUDA);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  def.add_output("Y");
+  return def;
+}
+
+// runs the op once to allocate its outputs, then times it
+void RunOp(benchmark::State& state, Workspace* ws, const OperatorDef& def) {
+  auto op = CreateOperator(def, ws);
+  CHECK(op->Run());
+  CUDA_ENFORCE(cudaDeviceSynchronize());
+  while (state.KeepRunning()) {
+    op->Run();
+    CUDA_ENFORCE(cudaDeviceSynchronize());
+  }
+}
+
+// range(0): frames, range(1): crop size, range(2): channels last; the
+// normalization of the uint8 crops copied to the GPU, every other clip
+// mirrored and the channels reversed to BGR
+template <typename T>
+void BM_TransformClipsOnGPU(benchmark::State& state) {
+  CAFFE2_SKIP_IF_NO_GPU;
+  const int length = state.range(0);
+  const int crop = state.range(1);
+  const bool channels_last = state.range(2);
+  TensorCUDA X;
+  {
+    TensorCPU cpu(std::vector<TIndex>{kBatch, kChannels, length, crop, crop});
+    std::mt19937 randgen(0);
+    std::uniform_int_distribution<int> dist(0, 255);
+    auto* data = cpu.mutable_data<uint8_t>();
+    for (TIndex i = 0; i < cpu.size(); ++i) {
+      data[i] = dist(randgen);
+    }
+    CUDAContext context;
+    X.CopyFrom(cpu, &context);
+    context.FinishDeviceComputation();
+  }
+  TensorCUDA mirror;
+  {
+    TensorCPU cpu(std::vector<TIndex>{kBatch});
+    for (int n = 0; n < kBatch; ++n) {
+      cpu.mutable_data<int>()[n] = n % 2;
+    }
+    CUDAContext context;
+    mirror.CopyFrom(cpu, &context);
+    context.FinishDeviceComputation();
+  }
+  TensorCUDA Y;
+  CUDAContext context;
+  while (state.KeepRunning()) {
+    TransformClipsOnGPU<uint8_t, T, CUDAContext>(
+        X, mirror, &Y, 114.75f, 1.f / 57.375f, true, channels_last, &context);
+    context.FinishDeviceComputation();
+  }
+  state.SetItemsProcessed(state.iterations() * X.size());
+}
+void TransformClipsArgs(benchmark::internal::Benchmark* b) {
+  for (const int length : {8, 32, 128}) {
+    for (const int crop : {224, 256}) {
+      for (int channels_last = 0; channels_last < 2; ++channels_last) {
+        b->Args({length, crop, channels_last});
+      }
+    }
+  }
+}
+BENCHMARK_TEMPLATE(BM_TransformClipsOnGPU, float)
+    ->Apply(TransformClipsArgs)
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK_TEMPLATE(BM_TransformClipsOnGPU, float16)
+    ->Apply(TransformClipsArgs)
+    ->Unit(benchmark::kMicrosecond);
+
+// the output channels of the res2 to res5 bottlenecks of an I3D ResNet-50
+// on 8 frame clips at 224x224
+struct Stage {
+  int channels;
+  int length;
+  int size;
+};
+const Stage kStages[] = {{256, 8, 56}, {512, 4, 28}, {1024, 4, 14}, {2048, 4, 7}};
+
+// range(0): stage, range(1): NHWC, range(2): float16; the frozen BN
+void BM_AffineNd(benchmark::State& state) {
+  CAFFE2_SKIP_IF_NO_GPU;
+  const Stage& stage = kStages[state.range(0)];
+  const bool nhwc = state.range(1);
+  const bool fp16 = state.range(2);
+  const std::vector<TIndex> x_dims = nhwc
+      ? std::vector<TIndex>{kBatch, stage.length, stage.size, stage.size,
+                            stage.channels}
+      : std::vector<TIndex>{kBatch, stage.channels, stage.length, stage.size,
+                            stage.size};
+  const std::vector<TIndex> c_dims{stage.channels};
+  Workspace ws;
+  if (fp16) {
+    FillCUDA<float16>(&ws, "X", x_dims);
+    FillCUDA<float16>(&ws, "scale", c_dims);
+    FillCUDA<float16>(&ws, "bias", c_dims);
+  } else {
+    FillCUDA<float>(&ws, "X", x_dims);
+    FillCUDA<float>(&ws, "scale", c_dims);
+    FillCUDA<float>(&ws, "bias", c_dims);
+  }
+  OperatorDef def = CUDAOpDef("AffineNd", {"X", "scale", "bias"});
+  AddArg(&def, "order", nhwc ? "NHWC" : "NCHW");
+  RunOp(state, &ws, def);
+  state.SetItemsProcessed(
+      state.iterations() * kBatch * stage.channels * stage.length *
+      stage.size * stage.size);
+}
+void AffineNdArgs(benchmark::internal::Benchmark* b) {
+  for (int stage = 0; stage < 4; ++stage) {
+    for (int nhwc = 0; nhwc < 2; ++nhwc) {
+      for (int fp16 = 0; fp16 < 2; ++fp16) {
+        b->Args({stage, nhwc, fp16});
+      }
+    }
+  }
+}
+BENCHMARK(BM_AffineNd)->Apply(AffineNdArgs)->Unit(benchmark::kMicrosecond);
+
+// The non-local blocks of res3 (256 embedding channels over 28x28) and of
+// res4 (512 over 14x14), with the keys max-pooled 2x2 in space. The
+// temporal length at res3 and res4 is a quarter of the input frames.
+struct NonLocalBlock {
+  int channels;
+  int size;
+};
+const NonLocalBlock kBlocks[] = {{256, 28}, {512, 14}};
+
+// range(0): index of the block in kBlocks, range(1): frames of the clips,
+// range(2): affinity_tile, 0 for the fused kernel; the items are the flops
+// of the two matrix products
+void BM_NonLocalAttention(benchmark::State& state) {
+  CAFFE2_SKIP_IF_NO_GPU;
+  const NonLocalBlock& block = kBlocks[state.range(0)];
+  const int T = state.range(1) / 4;
+  const int C = block.channels;
+  const int Lq = T * block.size * block.size;
+  const int Lk = Lq / 4;
+  Workspace ws;
+  FillCUDA<float>(&ws, "theta", {kBatch, C, Lq});
+  FillCUDA<float>(&ws, "phi", {kBatch, C, Lk});
+  FillCUDA<float>(&ws, "g", {kBatch, C, Lk});
+  OperatorDef def = CUDAOpDef("NonLocalAttention", {"theta", "phi", "g"});
+  def.add_output("lse");
+  AddArg(&def, "scale", 1.f / std::sqrt(static_cast<float>(C)));
+  AddArg(&def, "affinity_tile", static_cast<int>(state.range(2)));
+  RunOp(state, &ws, def);
+  state.SetItemsProcessed(
+      state.iterations() * 4 * static_cast<int64_t>(kBatch) * C * Lq * Lk);
+}
+void NonLocalAttentionArgs(benchmark::internal::Benchmark* b) {
+  for (int block = 0; block < 2; ++block) {
+    for (const int length : {8, 32, 128}) {
+      for (const int tile : {0, 512}) {
+        b->Args({block, length, tile});
+      }
+    }
+  }
+}
+BENCHMARK(BM_NonLocalAttention)
+    ->Apply(NonLocalAttentionArgs)
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+BENCHMARK_MAIN()
@@ -0,0 +1,422 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times the train net of a data_parallel_model over N GPUs, e.g. the
+// .pbtxt nets train_net_video.py saves with misc.save_net_proto, and reports
+// clips/s, the step time of every GPU and the share of the allreduce ops.
+// With --synthetic_input the input ops are replaced by blobs filled once,
+// which takes decoding out of the runs. For multi-process training, run it
+// in every process with the nets of that process; the rendezvous ops of the
+// init net run as they are.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <mutex> // NOLINT
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/core/init.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/observers/operator_attaching_net_observer.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/conversions.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/utils/string_utils.h"
+
+CAFFE2_DEFINE_string(init_net, "", "The init net of the train net.");
+CAFFE2_DEFINE_string(net, "", "The train net to benchmark.");
+CAFFE2_DEFINE_int(iter, 20, "The number of timed iterations.");
+CAFFE2_DEFINE_int(warmup, 5, "The number of iterations to warm up.");
+CAFFE2_DEFINE_bool(
+    synthetic_input,
+    false,
+    "Whether to replace the input ops by their outputs, filled once with "
+    "random clips of the shape of their batch_size, length, crop, order and "
+    "output_type arguments on their device, so that no clip is decoded. The "
+    "init net ops that only create the readers of the input ops are dropped.");
+CAFFE2_DEFINE_string(
+    input_ops,
+    "CustomizedVideoInput,SyntheticVideoInput",
+    "The types of the input ops, comma separated.");
+CAFFE2_DEFINE_int(
+    batch_size,
+    0,
+    "The clips of an iteration over all GPUs, if not the sum of the "
+    "batch_size arguments of the input ops.");
+
+using std::string;
+using std::vector;
+
+namespace caffe2 {
+
+namespace {
+
+bool IsAllreduce(const string& type) {
+  return type.find("Allreduce") != string::npos ||
+      type.find("NCCL") != string::npos || type.find("Broadcast") == 0;
+}
+
+class StepTimeObserver;
+
+// the span of an op from the start of the iteration, given to the net
+// observer with the GPU of the op (-1 for a CPU op)
+class StepOperatorObserver final : public ObserverBase<OperatorBase> {
+ public:
+  StepOperatorObserver(OperatorBase* subject, StepTimeObserver* net);
+
+ private:
+  void Start() override;
+  void Stop() override;
+
+  StepTimeObserver* net_;
+  int gpu_ = -1;
+  bool allreduce_ = false;
+  double start_ms_ = 0;
+};
+
+// Keeps per iteration the wall time, the time the last op of every GPU
+// ended at and the summed time of the ops and of the allreduce ops. The ops
+// of the CUDA executors wait for their kernels, so the op spans are close to
+// the device times.
+class StepTimeObserver final
+    : public OperatorAttachingNetObserver<StepOperatorObserver,
+                                          StepTimeObserver> {
+ public:
+  struct Step {
+    double wall_ms = 0;
+    double op_ms = 0;
+    double allreduce_ms = 0;
+    // gpu -> end of its last op
+    std::map<int, double> gpu_end_ms;
+  };
+
+  explicit StepTimeObserver(NetBase* subject)
+      : OperatorAttachingNetObserver<StepOperatorObserver, StepTimeObserver>(
+            subject,
+            this) {}
+
+  void set_recording(bool recording) {
+    recording_ = recording;
+  }
+  const vector<Step>& steps() const {
+    return steps_;
+  }
+
+  double ElapsedMs() {
+    return timer_.MilliSeconds();
+  }
+
+  void RecordOp(int gpu, bool allreduce, double start_ms, double end_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const double ms = end_ms - start_ms;
+    step_.op_ms += ms;
+    if (allreduce) {
+      step_.allreduce_ms += ms;
+    }
+    // the allreduce ops run on one GPU for all of them
+    if (gpu >= 0 && !allreduce) {
+      auto& end = step_.gpu_end_ms[gpu];
+      end = std::max(end, end_ms);
+    }
+  }
+
+ private:
+  void Start() override {
+    step_ = Step();
+    timer_.Start();
+  }
+
+  void Stop() override {
+    step_.wall_ms = timer_.MilliSeconds();
+    if (recording_) {
+      steps_.push_back(step_);
+    }
+  }
+
+  Timer timer_;
+  std::mutex mutex_;
+  Step step_;
+  bool recording_ = false;
+  vector<Step> steps_;
+};
+
+StepOperatorObserver::StepOperatorObserver(
+    OperatorBase* subject,
+    StepTimeObserver* net)
+    : ObserverBase<OperatorBase>(subject), net_(net) {
+  if (subject->device_option().device_type() == CUDA) {
+    gpu_ = subject->device_option().cuda_gpu_id();
+  }
+  if (subject->has_debug_def()) {
+    allreduce_ = IsAllreduce(subject->debug_def().type());
+  }
+}
+
+void StepOperatorObserver::Start() {
+  start_ms_ = net_->ElapsedMs();
+}
+
+void StepOperatorObserver::Stop() {
+  net_->RecordOp(gpu_, allreduce_, start_ms_, net_->ElapsedMs());
+}
+
+template <typename T>
+void FillRandom(TensorCPU* tensor, const float low, const float high) {
+  std::mt19937 randgen(0);
+  std::uniform_real_distribution<float> dist(low, high);
+  T* data = tensor->mutable_data<T>();
+  for (TIndex i = 0; i < tensor->size(); ++i) {
+    data[i] = convert::To<float, T>(dist(randgen));
+  }
+}
+
+// the outputs of an input op: the clips, the labels and the int outputs
+// that follow them (video ids, clip indices, mirror flags)
+void CreateSyntheticOutputs(const OperatorDef& def, Workspace* ws) {
+  ArgumentHelper args(def);
+  const int batch_size = args.GetSingleArgument<int>("batch_size", 0);
+  const int length = args.GetSingleArgument<int>("length", 0);
+  const int crop = args.GetSingleArgument<int>("crop", 0);
+  CAFFE_ENFORCE(
+      batch_size > 0 && length > 0 && crop > 0,
+      "The synthetic input of ",
+      def.type(),
+      " needs its batch_size, length and crop.");
+  const bool nhwc = args.GetSingleArgument<string>("order", "NCHW") == "NHWC";
+  const string type = args.GetSingleArgument<string>("output_type", "float");
+  const int labels = args.GetSingleArgument<int>("multiple_label", 0)
+      ? args.GetSingleArgument<int>("num_of_labels", 1)
+      : 1;
+  const bool on_gpu = def.device_option().device_type() == CUDA;
+  CUDAContext context(on_gpu ? def.device_option().cuda_gpu_id() : 0);
+
+  for (int i = 0; i < def.output_size(); ++i) {
+    TensorCPU cpu;
+    if (i == 0) {
+      cpu.Resize(
+          nhwc ? vector<TIndex>{batch_size, length, crop, crop, 3}
+               : vector<TIndex>{batch_size, 3, length, crop, crop});
+      if (type == "float16") {
+        FillRandom<float16>(&cpu, -2, 2);
+      } else if (type == "uint8") {
+        FillRandom<uint8_t>(&cpu, 0, 255);
+      } else {
+        FillRandom<float>(&cpu, -2, 2);
+      }
+    } else {
+      cpu.Resize(
+          i == 1 && labels > 1 ? vector<TIndex>{batch_size, labels}
+                               : vector<TIndex>{batch_size});
+      std::fill(
+          cpu.mutable_data<int>(), cpu.mutable_data<int>() + cpu.size(), 0);
+    }
+    auto* blob = ws->CreateBlob(def.output(i));
+    if (on_gpu) {
+      blob->GetMutable<TensorCUDA>()->CopyFrom(cpu, &context);
+    } else {
+      blob->GetMutable<TensorCPU>()->CopyFrom(cpu);
+    }
+  }
+  context.FinishDeviceComputation();
+}
+
+// removes the input ops from the net, and the ops of the init net that only
+// create their inputs (the readers); returns the removed input ops
+vector<OperatorDef> RemoveInputOps(NetDef* init_net, NetDef* net) {
+  const auto types = split(',', FLAGS_input_ops);
+  const std::set<string> input_types(types.begin(), types.end());
+  vector<OperatorDef> input_ops;
+  NetDef kept = *net;
+  kept.clear_op();
+  for (const auto& op : net->op()) {
+    if (input_types.count(op.type())) {
+      input_ops.push_back(op);
+    } else {
+      *kept.add_op() = op;
+    }
+  }
+  *net = kept;
+
+  std::set<string> used;
+  for (const auto& op : net->op()) {
+    used.insert(op.input().begin(), op.input().end());
+  }
+  std::set<string> readers;
+  for (const auto& op : input_ops) {
+    for (const auto& input : op.input()) {
+      if (!used.count(input)) {
+        readers.insert(input);
+      }
+    }
+  }
+  NetDef kept_init = *init_net;
+  kept_init.clear_op();
+  for (const auto& op : init_net->op()) {
+    const bool only_readers = op.output_size() > 0 &&
+        std::all_of(op.output().begin(),
+                    op.output().end(),
+                    [&](const string& output) {
+                      return readers.count(output) > 0;
+                    });
+    if (!only_readers) {
+      *kept_init.add_op() = op;
+    }
+  }
+  *init_net = kept_init;
+  return input_ops;
+}
+
+void MeanAndStddev(
+    const vector<double>& values,
+    double* mean,
+    double* stddev) {
+  *mean = 0;
+  *stddev = 0;
+  if (values.empty()) {
+    return;
+  }
+  for (const double v : values) {
+    *mean += v;
+  }
+  *mean /= values.size();
+  for (const double v : values) {
+    *stddev += (v - *mean) * (v - *mean);
+  }
+  *stddev = std::sqrt(*stddev / values.size());
+}
+
+void Report(const vector<StepTimeObserver::Step>& steps, int batch_size) {
+  vector<double> wall;
+  double op_ms = 0;
+  double allreduce_ms = 0;
+  std::map<int, vector<double>> gpu_steps;
+  vector<double> spreads;
+  for (const auto& step : steps) {
+    wall.push_back(step.wall_ms);
+    op_ms += step.op_ms;
+    allreduce_ms += step.allreduce_ms;
+    double first = 0;
+    double last = 0;
+    for (const auto& gpu : step.gpu_end_ms) {
+      gpu_steps[gpu.first].push_back(gpu.second);
+      first = first == 0 ? gpu.second : std::min(first, gpu.second);
+      last = std::max(last, gpu.second);
+    }
+    spreads.push_back(last - first);
+  }
+  double mean = 0;
+  double stddev = 0;
+  MeanAndStddev(wall, &mean, &stddev);
+  printf(
+      "%d iterations: %.2f ms +- %.2f ms per iteration",
+      static_cast<int>(steps.size()),
+      mean,
+      stddev);
+  if (batch_size > 0 && mean > 0) {
+    printf(", %d clips, %.2f clips/s", batch_size, batch_size / mean * 1e3);
+  }
+  printf("\n");
+  for (const auto& gpu : gpu_steps) {
+    MeanAndStddev(gpu.second, &mean, &stddev);
+    printf(
+        "gpu %d: step %.2f ms +- %.2f ms (variance %.3f ms^2)\n",
+        gpu.first,
+        mean,
+        stddev,
+        stddev * stddev);
+  }
+  if (gpu_steps.size() > 1) {
+    MeanAndStddev(spreads, &mean, &stddev);
+    printf(
+        "slowest - fastest gpu: %.2f ms +- %.2f ms per iteration\n",
+        mean,
+        stddev);
+  }
+  printf(
+      "allreduce ops: %.2f ms per iteration, %.1f%% of the op time\n",
+      steps.empty() ? 0. : allreduce_ms / steps.size(),
+      op_ms > 0 ? 100. * allreduce_ms / op_ms : 0.);
+  fflush(stdout);
+}
+
+} // namespace
+
+} // namespace caffe2
+
+int main(int argc, char** argv) {
+  caffe2::GlobalInit(&argc, &argv);
+  caffe2::ShowLogInfoToStderr();
+  caffe2::Workspace workspace;
+
+  caffe2::NetDef init_net_def;
+  CAFFE_ENFORCE(ReadProtoFromFile(caffe2::FLAGS_init_net, &init_net_def));
+  caffe2::NetDef net_def;
+  CAFFE_ENFORCE(ReadProtoFromFile(caffe2::FLAGS_net, &net_def));
+
+  vector<caffe2::OperatorDef> input_ops;
+  if (caffe2::FLAGS_synthetic_input) {
+    input_ops = caffe2::RemoveInputOps(&init_net_def, &net_def);
+    LOG(INFO) << "Replaced " << input_ops.size() << " input ops.";
+  } else {
+    const auto types = caffe2::split(',', caffe2::FLAGS_input_ops);
+    for (const auto& op : net_def.op()) {
+      if (std::find(types.begin(), types.end(), op.type()) != types.end()) {
+        input_ops.push_back(op);
+      }
+    }
+  }
+  int batch_size = caffe2::FLAGS_batch_size;
+  if (batch_size == 0) {
+    for (const auto& op : input_ops) {
+      batch_size += caffe2::ArgumentHelper(op).GetSingleArgument<int>(
+          "batch_size", 0);
+    }
+  }
+
+  CAFFE_ENFORCE(workspace.RunNetOnce(init_net_def));
+  if (caffe2::FLAGS_synthetic_input) {
+    for (const auto& op : input_ops) {
+      caffe2::CreateSyntheticOutputs(op, &workspace);
+    }
+  }
+
+  caffe2::NetBase* net = workspace.CreateNet(net_def);
+  CHECK_NOTNULL(net);
+  auto step_observer = caffe2::make_unique<caffe2::StepTimeObserver>(net);
+  auto* steps = step_observer.get();
+  net->AttachObserver(std::move(step_observer));
+
+  LOG(INFO) << "Running warmup runs.";
+  for (int i = 0; i < caffe2::FLAGS_warmup; ++i) {
+    CAFFE_ENFORCE(net->Run(), "Warmup run ", i, " has failed.");
+  }
+  LOG(INFO) << "Main runs.";
+  steps->set_recording(true);
+  for (int i = 0; i < caffe2::FLAGS_iter; ++i) {
+    CAFFE_ENFORCE(net->Run(), "Main run ", i, " has failed.");
+  }
+  steps->set_recording(false);
+  caffe2::Report(steps->steps(), batch_size);
+  return 0;
+}
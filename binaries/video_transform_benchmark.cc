@@ -0,0 +1,242 @@
+/**
+ * Copyright (c) 2016-present, Facebook, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include "caffe2/perfkernels/clip_transform.h"
+
+namespace caffe2 {
+// scalar reference path of the perfkernel, bypassing the cpu dispatch
+void ClipTransformUint8__base(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int h_off,
+    const int w_off,
+    const int h_crop,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool mirror,
+    const bool reverse_channels,
+    float* transformed_clip);
+void BilinearClipTransformUint8__base(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int* y0,
+    const int* y1,
+    const float* fy,
+    const int h_crop,
+    const int* x0,
+    const int* x1,
+    const float* fx,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool mirror,
+    const bool reverse_channels,
+    float* transformed_clip);
+void PackedRGBToPlanarFloat__base(
+    const std::uint8_t* packed,
+    const int num_pixels,
+    const int plane_stride,
+    float* planar);
+} // namespace caffe2
+
+using namespace caffe2;
+
+namespace {
+
+// the frame sizes the clips are decoded and scaled to: the short side at
+// 256 (Kinetics pre-scaled to 256x340), 320 and 480 (scale augmentation)
+struct Frame {
+  int height;
+  int width;
+};
+const Frame kFrames[] = {{256, 340}, {320, 427}, {480, 640}};
+constexpr int kChannels = 3;
+
+std::vector<std::uint8_t> RandomClip(const int length, const Frame& frame) {
+  std::vector<std::uint8_t> clip(
+      kChannels * length * frame.height * frame.width);
+  std::mt19937 randgen(0);
+  std::uniform_int_distribution<int> dist(0, 255);
+  for (auto& x : clip) {
+    x = dist(randgen);
+  }
+  return clip;
+}
+
+// range(0): mirror, range(1): reverse the channels, range(2): frames,
+// range(3): crop size, range(4): index of the frame size in kFrames
+template <bool kDispatch>
+void BM_ClipTransformUint8(benchmark::State& state) {
+  const bool mirror = state.range(0);
+  const bool reverse_channels = state.range(1);
+  const int length = state.range(2);
+  const int crop = state.range(3);
+  const Frame& frame = kFrames[state.range(4)];
+  const int h_off = (frame.height - crop) / 2;
+  const int w_off = (frame.width - crop) / 2;
+  std::vector<std::uint8_t> clip = RandomClip(length, frame);
+  std::vector<float> out(kChannels * length * crop * crop);
+  while (state.KeepRunning()) {
+    if (kDispatch) {
+      ClipTransformUint8(
+          clip.data(), kChannels, length, frame.height, frame.width, h_off,
+          w_off, crop, crop, 114.75f, 1.f / 57.375f, mirror,
+          reverse_channels, out.data());
+    } else {
+      ClipTransformUint8__base(
+          clip.data(), kChannels, length, frame.height, frame.width, h_off,
+          w_off, crop, crop, 114.75f, 1.f / 57.375f, mirror,
+          reverse_channels, out.data());
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * out.size());
+  state.SetBytesProcessed(
+      state.iterations() * out.size() * (sizeof(std::uint8_t) + sizeof(float)));
+}
+void ClipTransformArgs(benchmark::internal::Benchmark* b) {
+  // the flags at the training shape: 32 frames, 224 crop of 256x340
+  for (int mirror = 0; mirror < 2; ++mirror) {
+    for (int reverse = 0; reverse < 2; ++reverse) {
+      b->Args({mirror, reverse, 32, 224, 0});
+    }
+  }
+  // the 8 and 128 frame models, and the 256 crop of testing
+  b->Args({1, 1, 8, 224, 0});
+  b->Args({1, 1, 128, 224, 0});
+  for (const int length : {8, 32, 128}) {
+    b->Args({0, 1, length, 256, 1});
+  }
+}
+
+// the bilinear taps of cv::resize INTER_LINEAR, as ScaleCropNormalizeTransform
+// computes them
+void LinearTaps(
+    const int src_size,
+    const int dst_size,
+    const int dst_off,
+    const int dst_len,
+    std::vector<int>* idx0,
+    std::vector<int>* idx1,
+    std::vector<float>* frac) {
+  const double scale = (double)src_size / dst_size;
+  for (int d = 0; d < dst_len; ++d) {
+    float f = (float)((dst_off + d + 0.5) * scale - 0.5);
+    int s = (int)floorf(f);
+    f -= s;
+    if (s < 0 || s >= src_size - 1) {
+      s = std::min(std::max(s, 0), src_size - 1);
+      f = 0;
+    }
+    idx0->push_back(s);
+    idx1->push_back(std::min(s + 1, src_size - 1));
+    frac->push_back(f);
+  }
+}
+
+// range(0): mirror, range(1): frames, range(2): crop size, range(3): index
+// of the decoded frame size in kFrames, scaled to a short side of 256 first
+template <bool kDispatch>
+void BM_BilinearClipTransformUint8(benchmark::State& state) {
+  const bool mirror = state.range(0);
+  const int length = state.range(1);
+  const int crop = state.range(2);
+  const Frame& frame = kFrames[state.range(3)];
+  const int scaled_height = 256;
+  const int scaled_width = frame.width * 256 / frame.height;
+  std::vector<int> y0, y1, x0, x1;
+  std::vector<float> fy, fx;
+  LinearTaps(
+      frame.height, scaled_height, (scaled_height - crop) / 2, crop, &y0, &y1,
+      &fy);
+  LinearTaps(
+      frame.width, scaled_width, (scaled_width - crop) / 2, crop, &x0, &x1,
+      &fx);
+  std::vector<std::uint8_t> clip = RandomClip(length, frame);
+  std::vector<float> out(kChannels * length * crop * crop);
+  while (state.KeepRunning()) {
+    if (kDispatch) {
+      BilinearClipTransformUint8(
+          clip.data(), kChannels, length, frame.height, frame.width,
+          y0.data(), y1.data(), fy.data(), crop, x0.data(), x1.data(),
+          fx.data(), crop, 114.75f, 1.f / 57.375f, mirror, true, out.data());
+    } else {
+      BilinearClipTransformUint8__base(
+          clip.data(), kChannels, length, frame.height, frame.width,
+          y0.data(), y1.data(), fy.data(), crop, x0.data(), x1.data(),
+          fx.data(), crop, 114.75f, 1.f / 57.375f, mirror, true, out.data());
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * out.size());
+}
+void BilinearClipTransformArgs(benchmark::internal::Benchmark* b) {
+  // 32 frames of 320 and 480 decodes scaled to 256, and the 8 frame model
+  for (int mirror = 0; mirror < 2; ++mirror) {
+    b->Args({mirror, 32, 224, 1});
+    b->Args({mirror, 32, 224, 2});
+  }
+  b->Args({1, 8, 224, 2});
+}
+
+// range(0): index of the frame size in kFrames; one decoded RGB24 frame
+// split into float planes
+template <bool kDispatch>
+void BM_PackedRGBToPlanarFloat(benchmark::State& state) {
+  const Frame& frame = kFrames[state.range(0)];
+  const int num_pixels = frame.height * frame.width;
+  std::vector<std::uint8_t> packed(RandomClip(1, frame));
+  std::vector<float> out(kChannels * num_pixels);
+  while (state.KeepRunning()) {
+    if (kDispatch) {
+      PackedRGBToPlanarFloat(packed.data(), num_pixels, num_pixels, out.data());
+    } else {
+      PackedRGBToPlanarFloat__base(
+          packed.data(), num_pixels, num_pixels, out.data());
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetItemsProcessed(state.iterations() * num_pixels);
+}
+
+} // namespace
+
+BENCHMARK_TEMPLATE(BM_ClipTransformUint8, false)->Apply(ClipTransformArgs);
+BENCHMARK_TEMPLATE(BM_ClipTransformUint8, true)->Apply(ClipTransformArgs);
+
+BENCHMARK_TEMPLATE(BM_BilinearClipTransformUint8, false)
+    ->Apply(BilinearClipTransformArgs);
+BENCHMARK_TEMPLATE(BM_BilinearClipTransformUint8, true)
+    ->Apply(BilinearClipTransformArgs);
+
+BENCHMARK_TEMPLATE(BM_PackedRGBToPlanarFloat, false)->DenseRange(0, 2);
+BENCHMARK_TEMPLATE(BM_PackedRGBToPlanarFloat, true)->DenseRange(0, 2);
+
+BENCHMARK_MAIN()
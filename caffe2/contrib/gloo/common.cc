@@ -3,6 +3,9 @@
 #include "caffe2/core/logging.h"
 #include "caffe2/core/tensor.h"
 
+#include <mutex>
+#include <unordered_map>
+
 #include <gloo/transport/tcp/device.h>
 #if defined(GLOO_USE_IBVERBS) && GLOO_USE_IBVERBS
 #include <gloo/transport/ibverbs/device.h>
@@ -44,5 +47,54 @@ std::shared_ptr<::gloo::transport::Device> createDevice(
   CAFFE_THROW("Invalid transport: ", attr.transport);
 }
 
+namespace {
+
+std::mutex& commonWorldsMutex() {
+  static std::mutex m;
+  return m;
+}
+
+std::unordered_map<std::string, std::weak_ptr<::gloo::Context>>&
+commonWorlds() {
+  static std::unordered_map<std::string, std::weak_ptr<::gloo::Context>> m;
+  return m;
+}
+
+} // namespace
+
+std::shared_ptr<::gloo::Context> getCachedCommonWorld(const std::string& key) {
+  std::lock_guard<std::mutex> lock(commonWorldsMutex());
+  auto& worlds = commonWorlds();
+  auto it = worlds.find(key);
+  if (it == worlds.end()) {
+    return nullptr;
+  }
+  auto context = it->second.lock();
+  if (!context) {
+    worlds.erase(it);
+  }
+  return context;
+}
+
+void cacheCommonWorld(
+    const std::string& key,
+    const std::shared_ptr<::gloo::Context>& context) {
+  std::lock_guard<std::mutex> lock(commonWorldsMutex());
+  commonWorlds()[key] = context;
+}
+
+void evictCommonWorld(const ::gloo::Context* context) {
+  std::lock_guard<std::mutex> lock(commonWorldsMutex());
+  auto& worlds = commonWorlds();
+  for (auto it = worlds.begin(); it != worlds.end();) {
+    auto cached = it->second.lock();
+    if (!cached || cached.get() == context) {
+      it = worlds.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
 } // namespace gloo
 } // namespace caffe2
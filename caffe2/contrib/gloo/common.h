@@ -25,6 +25,19 @@ struct createDeviceAttr {
 std::shared_ptr<::gloo::transport::Device> createDevice(
     const createDeviceAttr attr);
 
+// A process-wide cache of the common worlds of CreateCommonWorld with
+// reuse_cached set, so that the nets created again in a process, e.g. the
+// test net or the precise BN net next to the train net, reuse the connected
+// contexts instead of a rendezvous per net. The key names the store prefix,
+// the transport device and the rank and size of the common world. A context
+// stays cached while a blob holds it.
+std::shared_ptr<::gloo::Context> getCachedCommonWorld(const std::string& key);
+void cacheCommonWorld(
+    const std::string& key,
+    const std::shared_ptr<::gloo::Context>& context);
+// Drops a closed context from the cache.
+void evictCommonWorld(const ::gloo::Context* context);
+
 // Captures the parameters passed to Gloo.
 struct GlooParameters {
   std::shared_ptr<::gloo::Context> context;
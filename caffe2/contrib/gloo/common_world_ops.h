@@ -38,6 +38,9 @@ class CreateCommonWorld final : public Operator<Context> {
         status_blob_(
             OperatorBase::GetSingleArgument<std::string>("status_blob", "")),
         timeout_ms_(OperatorBase::GetSingleArgument<int>("timeout_ms", -1)),
+        reuse_cached_(OperatorBase::template GetSingleArgument<bool>(
+            "reuse_cached",
+            false)),
         ws_(ws) {
     CAFFE_ENFORCE(
         operator_def.has_name(), "CreateCommonWorld operator requires name");
@@ -81,6 +84,14 @@ class CreateCommonWorld final : public Operator<Context> {
   }
 
   bool RunOnDevice() override {
+    if (reuse_cached_) {
+      auto cached = getCachedCommonWorld(cacheKey());
+      if (cached) {
+        VLOG(1) << "Reusing the cached common world " << name_;
+        *OperatorBase::Output<CommonWorld>(COMM) = std::move(cached);
+        return true;
+      }
+    }
     try {
       CommonWorld context;
       if (mpi_rendezvous_) {
@@ -102,6 +113,9 @@ class CreateCommonWorld final : public Operator<Context> {
         }
       }
 
+      if (reuse_cached_) {
+        cacheCommonWorld(cacheKey(), context);
+      }
       *OperatorBase::Output<CommonWorld>(COMM) = std::move(context);
     } catch (::gloo::IoException& ioe) {
       LOG(ERROR) << "Caught gloo IO exception: " << ioe.what();
@@ -123,6 +137,16 @@ class CreateCommonWorld final : public Operator<Context> {
     }
   }
 
+  // The op name is the prefix of the rendezvous in the store, so the common
+  // worlds of the ops of the same name, rank and size in the nets of a
+  // process are one.
+  std::string cacheKey() const {
+    return name_ + "/" + (mpi_rendezvous_ ? "mpi" : transport_) + ":" +
+        interface_ + "/" + caffe2::to_string(rank_) + ":" +
+        caffe2::to_string(size_) + "/" + (sync_ ? "sync" : "async") + "/" +
+        caffe2::to_string(timeout_ms_);
+  }
+
   void initialize() {
     // Share single device between all common worlds.
     static std::once_flag once;
@@ -149,6 +173,7 @@ class CreateCommonWorld final : public Operator<Context> {
   const bool mpi_rendezvous_;
   const std::string status_blob_;
   const int timeout_ms_;
+  const bool reuse_cached_;
   Workspace* ws_;
 
   std::string name_;
@@ -235,6 +260,8 @@ class DestroyCommonWorld final : public Operator<CPUContext> {
         OperatorBase::Input<std::shared_ptr<::gloo::Context>>(0);
 
     if (context) {
+      // the closed context is no use to the nets created later
+      evictCommonWorld(context.get());
       LOG(INFO) << "Closing connections: " << cw_name_;
       context->closeConnections();
     }
@@ -14,7 +14,9 @@ import os
 import pickle
 import tempfile
 import shutil
+import unittest
 
+from caffe2.proto import caffe2_pb2
 from caffe2.python import core, workspace, dyndep
 import caffe2.python.hypothesis_test_util as hu
 from gloo.python import IoError
@@ -347,6 +349,74 @@ class TestCase(hu.HypothesisTestCase):
                     tmpdir=tmpdir,
                     use_float16=use_float16)
 
+    def _test_hierarchical_allreduce(self,
+                                     comm_rank=None,
+                                     comm_size=None,
+                                     blob_size=None,
+                                     tmpdir=None
+                                     ):
+        store_handler, common_world = self.create_common_world(
+            comm_rank=comm_rank,
+            comm_size=comm_size,
+            tmpdir=tmpdir)
+
+        blob_size = self.synchronize(
+            store_handler,
+            blob_size,
+            comm_rank=comm_rank)
+
+        num_gpus = workspace.NumCudaDevices()
+        blobs = []
+        for gpu in range(num_gpus):
+            blob = "gpu_{}/blob".format(gpu)
+            value = np.full(blob_size, (comm_rank * num_gpus) + gpu,
+                            np.float32)
+            workspace.FeedBlob(
+                blob, value, core.DeviceOption(caffe2_pb2.CUDA, gpu))
+            blobs.append(blob)
+
+        net = core.Net("hierarchical_allreduce")
+        net.Allreduce(
+            [common_world] + blobs,
+            blobs,
+            engine='GLOO_HIERARCHICAL',
+            device_option=core.DeviceOption(caffe2_pb2.CUDA, 0))
+
+        workspace.CreateNet(net)
+        # the second runs reuse the shards and algorithms of the first
+        for _tmp in range(3):
+            for gpu in range(num_gpus):
+                workspace.FeedBlob(
+                    blobs[gpu],
+                    np.full(blob_size, (comm_rank * num_gpus) + gpu,
+                            np.float32),
+                    core.DeviceOption(caffe2_pb2.CUDA, gpu))
+            workspace.RunNet(net.Name())
+            for gpu in range(num_gpus):
+                result = workspace.FetchBlob(blobs[gpu])
+                self.assertEqual(result.shape, (blob_size,))
+                np.testing.assert_array_equal(
+                    result,
+                    (num_gpus * comm_size) * (num_gpus * comm_size - 1) / 2)
+
+    # sizes that do and do not split evenly over the gpus
+    @unittest.skipIf(not workspace.has_gpu_support, "No gpu support")
+    @given(comm_size=st.integers(min_value=2, max_value=4),
+           blob_size=st.integers(min_value=1e3, max_value=1e5))
+    def test_hierarchical_allreduce(self, comm_size, blob_size):
+        TestCase.test_counter += 1
+        if os.getenv('COMM_RANK') is not None:
+            self.run_test_distributed(
+                self._test_hierarchical_allreduce,
+                blob_size=blob_size)
+        else:
+            with TemporaryDirectory() as tmpdir:
+                self.run_test_locally(
+                    self._test_hierarchical_allreduce,
+                    comm_size=comm_size,
+                    blob_size=blob_size,
+                    tmpdir=tmpdir)
+
     def _test_reduce_scatter(self,
                              comm_rank=None,
                              comm_size=None,
@@ -530,6 +600,62 @@ class TestCase(hu.HypothesisTestCase):
                     device_option=device_option,
                     tmpdir=tmpdir)
 
+    def _test_reuse_cached_cw(self,
+                              comm_rank=None,
+                              comm_size=None,
+                              tmpdir=None
+                              ):
+        def create_common_world(store_path, common_world):
+            workspace.RunOperatorOnce(
+                core.CreateOperator(
+                    "FileStoreHandlerCreate",
+                    [],
+                    ["store_handler"],
+                    path=store_path))
+            workspace.RunOperatorOnce(
+                core.CreateOperator(
+                    "CreateCommonWorld",
+                    ["store_handler"],
+                    [common_world],
+                    name="reused_cw",
+                    size=comm_size,
+                    rank=comm_rank,
+                    reuse_cached=True,
+                    timeout_ms=1000,
+                    engine=op_engine))
+
+        create_common_world(tmpdir, "common_world")
+        # A store of its own per rank: a rendezvous through it times out, so
+        # the second op has to reuse the common world of the first.
+        own_store = os.path.join(tmpdir, str(comm_rank))
+        os.mkdir(own_store)
+        create_common_world(own_store, "common_world_reused")
+
+        blob = "blob"
+        workspace.FeedBlob(blob, np.full(4, comm_rank, np.float32))
+        net = core.Net("allreduce_reused")
+        net.Allreduce(
+            ["common_world_reused", blob],
+            [blob],
+            engine=op_engine)
+        workspace.RunNetOnce(net)
+        np.testing.assert_array_equal(
+            workspace.FetchBlob(blob),
+            comm_size * (comm_size - 1) / 2)
+
+    @given(comm_size=st.integers(min_value=2, max_value=4),
+           device_option=st.sampled_from([hu.cpu_do]))
+    def test_reuse_cached_cw(self, comm_size, device_option):
+        TestCase.test_counter += 1
+        if os.getenv('COMM_RANK') is not None:
+            return
+        with TemporaryDirectory() as tmpdir:
+            self.run_test_locally(
+                self._test_reuse_cached_cw,
+                comm_size=comm_size,
+                device_option=device_option,
+                tmpdir=tmpdir)
+
     def _test_barrier(
         self,
         comm_rank=None,
@@ -678,5 +804,4 @@ class TestCase(hu.HypothesisTestCase):
                         tmpdir=tmpdir)
 
 if __name__ == "__main__":
-    import unittest
     unittest.main()
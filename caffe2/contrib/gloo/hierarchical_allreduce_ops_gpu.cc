@@ -0,0 +1,222 @@
+#include "common.h"
+
+#include "caffe2/contrib/nccl/cuda_nccl_gpu.h"
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/core/operator.h"
+
+#include <gloo/common/error.h>
+#include <gloo/cuda_allreduce_halving_doubling.h>
+#include <gloo/types.h>
+
+namespace caffe2 {
+namespace gloo {
+
+namespace {
+
+template <typename T>
+struct GlooType {
+  typedef T type;
+};
+
+template <>
+struct GlooType<float16> {
+  typedef ::gloo::float16 type;
+};
+
+} // namespace
+
+/**
+ * Allreduce of the tensors of the local gpus across the nodes of the common
+ * world, in three steps: an NCCL reduce-scatter over the local gpus, a gloo
+ * allreduce of the shard of every gpu with the same shard of the other
+ * nodes, and an NCCL allgather of the reduced shards. Only 1 / (local gpus)
+ * of the tensor goes over the network per gpu, and the local traffic stays
+ * on NVLink / PCIe, instead of one ring over the gpus of all the nodes.
+ *
+ * It takes the inputs of the GLOO Allreduce: the common world, with one
+ * rank per node, and the tensors of the local gpus, which are reduced in
+ * place.
+ */
+class HierarchicalAllreduceOp final : public Operator<CUDAContext> {
+ public:
+  USE_OPERATOR_FUNCTIONS(CUDAContext);
+
+  HierarchicalAllreduceOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CUDAContext>(operator_def, ws),
+        ws_(ws),
+        status_blob_(
+            OperatorBase::GetSingleArgument<std::string>("status_blob", "")),
+        gpu_direct_(
+            OperatorBase::GetSingleArgument<bool>("gpu_direct", false)) {
+    if (status_blob_ != "") {
+      ws_->CreateBlob(status_blob_);
+    }
+  }
+
+  bool RunOnDevice() override {
+    CAFFE_ENFORCE_EQ(InputSize(), OutputSize() + 1);
+    for (int i = 0; i < OutputSize(); ++i) {
+      CAFFE_ENFORCE(&Input(i + 1) == Output(i), "Allreduce is in place");
+    }
+    try {
+      if (Input(1).IsType<float>()) {
+        return DoRunWithType<float>();
+      } else if (Input(1).IsType<float16>()) {
+        return DoRunWithType<float16>();
+      }
+      CAFFE_THROW("Unhandled type: ", Input(1).meta().name());
+    } catch (::gloo::IoException& ioe) {
+      LOG(ERROR) << "Caught gloo IO exception: " << ioe.what();
+      if (status_blob_ != "") {
+        signalFailure(ws_->GetBlob(status_blob_), ioe);
+        return false;
+      } else {
+        throw ioe;
+      }
+    }
+  }
+
+ private:
+  template <typename T>
+  bool DoRunWithType() {
+    const int n = OutputSize();
+    const TIndex size = Input(1).size();
+    for (int i = 2; i < InputSize(); ++i) {
+      CAFFE_ENFORCE_EQ(Input(i).size(), size);
+      CAFFE_ENFORCE(Input(i).IsType<T>());
+    }
+    // the tensors are padded to n shards, unless they split evenly
+    const TIndex shard_size = (size + n - 1) / n;
+    const bool padded = shard_size * n != size;
+
+    padded_.resize(n);
+    shards_.resize(n);
+    gathered_.resize(n);
+    nccl::NCCLExecution scatter;
+    scatter.stream_gpu_id = context_.cuda_gpu_id();
+    scatter.stream = context_.cuda_stream();
+    nccl::NCCLExecution gather = scatter;
+    for (int i = 0; i < n; ++i) {
+      auto* X = Output(i);
+      const int device = GetGPUIDForPointer(X->raw_data());
+      DeviceGuard g(device);
+      padded_[i].Resize(n, shard_size);
+      if (padded) {
+        // the padding is reduced with the rest but never copied back
+        CUDA_ENFORCE(cudaMemcpyAsync(
+            padded_[i].template mutable_data<T>(),
+            X->template data<T>(),
+            X->nbytes(),
+            cudaMemcpyDefault,
+            context_.cuda_stream()));
+      } else {
+        padded_[i].ShareData(*X);
+      }
+      nccl::NCCLElement scatter_element;
+      scatter_element.src = &padded_[i];
+      scatter_element.dst = &shards_[i];
+      scatter_element.device = device;
+      scatter.elements.push_back(scatter_element);
+      nccl::NCCLElement gather_element;
+      gather_element.src = &shards_[i];
+      gather_element.dst = padded ? &gathered_[i] : X;
+      gather_element.device = device;
+      gather.elements.push_back(gather_element);
+    }
+
+    nccl::NCCL<T>::ReduceScatter(scatter);
+    // gloo runs on streams of its own
+    context_.FinishDeviceComputation();
+    InitializeAlgorithms<T>(shard_size);
+    for (auto& algorithm : algorithms_) {
+      algorithm->run();
+    }
+
+    // the allgather resizes its outputs to (n, shard_size)
+    dims_.resize(n);
+    for (int i = 0; i < n; ++i) {
+      dims_[i] = Output(i)->dims();
+    }
+    nccl::NCCL<T>::AllGather(gather);
+    for (int i = 0; i < n; ++i) {
+      auto* X = Output(i);
+      DeviceGuard g(gather.elements[i].device);
+      if (padded) {
+        CUDA_ENFORCE(cudaMemcpyAsync(
+            X->template mutable_data<T>(),
+            gathered_[i].template data<T>(),
+            X->nbytes(),
+            cudaMemcpyDefault,
+            context_.cuda_stream()));
+      } else {
+        X->Resize(dims_[i]);
+      }
+    }
+    return true;
+  }
+
+  // The gloo algorithms register the shards with the other nodes, so they
+  // are created once; like the GLOO Allreduce, the inputs cannot change
+  // from run to run.
+  template <typename T>
+  void InitializeAlgorithms(const TIndex shard_size) {
+    typedef typename GlooType<T>::type G;
+    const auto& context =
+        OperatorBase::Input<std::shared_ptr<::gloo::Context>>(0);
+    std::vector<void*> shards;
+    for (auto& shard : shards_) {
+      shards.push_back(shard.raw_mutable_data());
+    }
+    if (!algorithms_.empty()) {
+      CAFFE_ENFORCE(
+          context == context_ptr_ && shards == shard_ptrs_,
+          "Inputs/outputs have changed");
+      return;
+    }
+    context_ptr_ = context;
+    shard_ptrs_ = shards;
+    const bool gpu_direct =
+        gpu_direct_ && context->getDevice()->hasGPUDirect();
+    if (gpu_direct_ && !gpu_direct) {
+      LOG(WARNING) << "GPUDirect not available; "
+                   << "Gloo communication will go through system memory "
+                   << "instead.";
+    }
+    for (auto* shard : shards) {
+      std::vector<G*> ptrs = {static_cast<G*>(shard)};
+      if (gpu_direct) {
+        algorithms_.emplace_back(new ::gloo::CudaAllreduceHalvingDoubling<
+                                 G,
+                                 ::gloo::CudaDeviceWorkspace<G>>(
+            context, ptrs, shard_size));
+      } else {
+        algorithms_.emplace_back(new ::gloo::CudaAllreduceHalvingDoubling<
+                                 G,
+                                 ::gloo::CudaHostWorkspace<G>>(
+            context, ptrs, shard_size));
+      }
+    }
+  }
+
+  Workspace* ws_;
+  std::string status_blob_;
+  const bool gpu_direct_;
+  std::vector<TensorCUDA> padded_;
+  std::vector<TensorCUDA> shards_;
+  std::vector<TensorCUDA> gathered_;
+  std::vector<std::vector<TIndex>> dims_;
+  std::shared_ptr<::gloo::Context> context_ptr_;
+  std::vector<void*> shard_ptrs_;
+  std::vector<std::unique_ptr<::gloo::Algorithm>> algorithms_;
+};
+
+namespace {
+
+REGISTER_CUDA_OPERATOR_WITH_ENGINE(
+    Allreduce,
+    GLOO_HIERARCHICAL,
+    HierarchicalAllreduceOp);
+
+} // namespace
+} // namespace gloo
+} // namespace caffe2
@@ -64,7 +64,8 @@ class NCCLContext {
 };
 
 // We share the contexts across multiple operators, hence the
-// thread-local cache
+// process-wide cache: the NCCL ops of the nets created again, e.g. the test
+// net next to the train net, reuse the communicators of the same devices.
 static std::mutex& gContextsMutex() {
   static std::mutex m;
   return m;
@@ -76,17 +77,19 @@ std::unordered_map<std::string, std::unique_ptr<NCCLContext>>& gContexts() {
   return m;
 }
 
+// The context records its master event on the stream device, so the key is
+// the stream device and the device set, not the device current in the thread
+// that happens to run the op.
 std::string ncclKey(const NCCLExecution& ex) {
   std::string result;
-  int curr_device;
-  CUDA_CHECK(cudaGetDevice(&curr_device));
-  result += to_string(curr_device) + ":";
+  result += to_string(ex.stream_gpu_id) + ":";
   for (const auto& el : ex.elements) {
     result += to_string(el.device) + ",";
   }
   return result;
 }
 
+// Call with gContextsMutex() held.
 NCCLContext* getNCCLContext(const NCCLExecution& ex) {
   auto& contexts = gContexts();
   const auto key = ncclKey(ex);
@@ -0,0 +1,451 @@
+#include <NvInfer.h>
+#include <NvOnnxParser.h>
+
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/onnx/onnx_exporter.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+namespace {
+
+class TensorRTLogger : public nvinfer1::ILogger {
+ public:
+  void log(Severity severity, const char* msg) override {
+    switch (severity) {
+      case Severity::kINTERNAL_ERROR:
+      case Severity::kERROR:
+        LOG(ERROR) << msg;
+        break;
+      case Severity::kWARNING:
+        LOG(WARNING) << msg;
+        break;
+      default:
+        VLOG(1) << msg;
+    }
+  }
+};
+
+TensorRTLogger& Logger() {
+  static TensorRTLogger logger;
+  return logger;
+}
+
+// the TensorRT objects are released with destroy()
+struct TensorRTDeleter {
+  template <typename T>
+  void operator()(T* object) const {
+    if (object) {
+      object->destroy();
+    }
+  }
+};
+
+template <typename T>
+using TensorRTPtr = std::unique_ptr<T, TensorRTDeleter>;
+
+// Calibrates an int8 engine on the batch it is built on: the first batch of
+// every input shape, whose engine is then cached.
+class FirstBatchCalibrator : public nvinfer1::IInt8EntropyCalibrator2 {
+ public:
+  FirstBatchCalibrator(const int batch_size, std::map<string, void*> inputs)
+      : batch_size_(batch_size), inputs_(std::move(inputs)) {}
+
+  int getBatchSize() const override {
+    return batch_size_;
+  }
+
+  bool getBatch(void* bindings[], const char* names[], int nbBindings)
+      override {
+    if (done_) {
+      return false;
+    }
+    for (int i = 0; i < nbBindings; ++i) {
+      bindings[i] = inputs_.at(names[i]);
+    }
+    done_ = true;
+    return true;
+  }
+
+  const void* readCalibrationCache(size_t& length) override {
+    length = 0;
+    return nullptr;
+  }
+
+  void writeCalibrationCache(const void*, size_t) override {}
+
+ private:
+  const int batch_size_;
+  const std::map<string, void*> inputs_;
+  bool done_ = false;
+};
+
+// args of the cuDNN convs, which mean nothing to ONNX
+const std::set<string> kEngineArgs{"exhaustive_search",
+                                   "ws_nbytes_limit",
+                                   "shared_buffer"};
+
+} // namespace
+
+// Runs the ops of backup_net, which TensorRTTransform replaced, as one
+// TensorRT engine per shape of the inputs that are not weights. The first
+// batch of a shape runs the ops themselves, which also give the shapes of
+// every blob for the ONNX model of the engine; the engine is read from
+// cache_dir, or built and written there. Shapes whose engine can not be
+// built keep running the ops.
+class TensorRTOp final : public Operator<CUDAContext> {
+ public:
+  USE_OPERATOR_FUNCTIONS(CUDAContext);
+
+  TensorRTOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CUDAContext>(operator_def, ws),
+        ws_(ws),
+        precision_(
+            OperatorBase::GetSingleArgument<string>("precision", "fp16")),
+        cache_dir_(OperatorBase::GetSingleArgument<string>("cache_dir", "")),
+        max_workspace_mb_(
+            OperatorBase::GetSingleArgument<int>("max_workspace_mb", 1024)) {
+    CAFFE_ENFORCE(
+        precision_ == "fp32" || precision_ == "fp16" || precision_ == "int8",
+        "Unknown TensorRT precision ",
+        precision_);
+    CAFFE_ENFORCE(
+        backup_net_.ParseFromString(
+            OperatorBase::GetSingleArgument<string>("backup_net", "")),
+        "No backup_net for ",
+        def().name());
+    for (const auto& name :
+         OperatorBase::GetRepeatedArgument<string>("weights")) {
+      weights_.insert(name);
+    }
+    for (int i = 0; i < InputSize(); ++i) {
+      if (!weights_.count(def().input(i))) {
+        data_inputs_.push_back(i);
+      }
+    }
+    CAFFE_ENFORCE(!data_inputs_.empty(), "TensorRT op without data inputs");
+    for (const auto& op : backup_net_.op()) {
+      backup_ops_.push_back(CreateOperator(op, ws));
+    }
+  }
+
+  bool RunOnDevice() override {
+    ShapeKey key;
+    for (const int i : data_inputs_) {
+      key.push_back(Input(i).dims());
+    }
+    const auto it = engines_.find(key);
+    if (it == engines_.end()) {
+      if (!RunBackup()) {
+        return false;
+      }
+      engines_[key] = GetEngine();
+      return true;
+    }
+    if (!it->second.context) {
+      return RunBackup();
+    }
+    return RunEngine(it->second);
+  }
+
+ private:
+  using ShapeKey = std::vector<std::vector<TIndex>>;
+
+  struct Engine {
+    TensorRTPtr<nvinfer1::ICudaEngine> engine;
+    TensorRTPtr<nvinfer1::IExecutionContext> context;
+    // of the data inputs and the outputs
+    std::vector<int> input_bindings;
+    std::vector<int> output_bindings;
+    std::vector<std::vector<TIndex>> output_dims;
+  };
+
+  bool RunBackup() {
+    for (auto& op : backup_ops_) {
+      if (!op->Run()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool RunEngine(Engine& engine) {
+    std::vector<void*> bindings(engine.engine->getNbBindings(), nullptr);
+    for (int j = 0; j < data_inputs_.size(); ++j) {
+      bindings[engine.input_bindings[j]] =
+          const_cast<void*>(Input(data_inputs_[j]).raw_data());
+    }
+    for (int i = 0; i < OutputSize(); ++i) {
+      auto* output = Output(i);
+      output->Resize(engine.output_dims[i]);
+      bindings[engine.output_bindings[i]] = output->mutable_data<float>();
+    }
+    return engine.context->enqueue(
+        Input(data_inputs_[0]).dim32(0),
+        bindings.data(),
+        context_.cuda_stream(),
+        nullptr);
+  }
+
+  const std::vector<TIndex>& BlobDims(const string& name) {
+    return ws_->GetBlob(name)->Get<TensorCUDA>().dims();
+  }
+
+  // The ONNX model of the backup ops on the shapes of their last run.
+  // ONNX values are written once, so the blobs written again (in place)
+  // get new names; engine_outputs_ are the names of the outputs of the op.
+  string ExportOnnxModel() {
+    using ::ONNX_NAMESPACE::ModelProto;
+    using ::ONNX_NAMESPACE::TensorProto;
+    using ::ONNX_NAMESPACE::ValueInfoProto;
+
+    ModelProto model;
+    model.set_ir_version(::ONNX_NAMESPACE::IR_VERSION);
+    model.set_producer_name("caffe2-tensorrt");
+    auto* opset = model.add_opset_import();
+    opset->set_domain("");
+    // the semantics of the exporter, as the python frontend
+    opset->set_version(6);
+    auto* graph = model.mutable_graph();
+    graph->set_name(def().name().empty() ? "tensorrt" : def().name());
+
+    const auto add_value_info = [](const string& name,
+                                   const std::vector<TIndex>& dims,
+                                   ValueInfoProto* info) {
+      info->set_name(name);
+      auto* type = info->mutable_type()->mutable_tensor_type();
+      type->set_elem_type(TensorProto::FLOAT);
+      for (const auto d : dims) {
+        type->mutable_shape()->add_dim()->set_dim_value(d);
+      }
+    };
+
+    std::unordered_map<string, string> versions;
+    std::unordered_map<string, int> writes;
+    for (int i = 0; i < InputSize(); ++i) {
+      const string& name = def().input(i);
+      versions[name] = name;
+      add_value_info(name, Input(i).dims(), graph->add_input());
+      if (!weights_.count(name)) {
+        continue;
+      }
+      TensorCPU weight(Input(i), &context_);
+      context_.FinishDeviceComputation();
+      auto* initializer = graph->add_initializer();
+      initializer->set_name(name);
+      initializer->set_data_type(TensorProto::FLOAT);
+      for (const auto d : weight.dims()) {
+        initializer->add_dims(d);
+      }
+      initializer->set_raw_data(weight.raw_data(), weight.nbytes());
+    }
+
+    onnx::OnnxExporter exporter;
+    for (const auto& op : backup_net_.op()) {
+      OperatorDef ssa_op = op;
+      ssa_op.clear_device_option();
+      auto* args = ssa_op.mutable_arg();
+      for (int j = args->size() - 1; j >= 0; --j) {
+        if (kEngineArgs.count(args->Get(j).name())) {
+          args->DeleteSubrange(j, 1);
+        }
+      }
+      std::unordered_map<string, TensorShape> shapes;
+      for (int j = 0; j < op.input_size(); ++j) {
+        ssa_op.set_input(j, versions.at(op.input(j)));
+        shapes[ssa_op.input(j)] = CreateTensorShape(
+            BlobDims(op.input(j)), TensorProto_DataType_FLOAT);
+      }
+      for (int j = 0; j < op.output_size(); ++j) {
+        const string& name = op.output(j);
+        if (versions.count(name)) {
+          versions[name] = name + "__" + caffe2::to_string(++writes[name]);
+        } else {
+          versions[name] = name;
+        }
+        ssa_op.set_output(j, versions[name]);
+        shapes[ssa_op.output(j)] =
+            CreateTensorShape(BlobDims(name), TensorProto_DataType_FLOAT);
+      }
+      const auto converted = exporter.Caffe2OpToOnnxNodes(ssa_op, shapes);
+      for (const auto& node : converted.first) {
+        graph->add_node()->CopyFrom(node);
+      }
+      for (const auto& tensor : converted.second) {
+        graph->add_initializer()->CopyFrom(tensor);
+        std::vector<TIndex> dims(tensor.dims().begin(), tensor.dims().end());
+        add_value_info(tensor.name(), dims, graph->add_input());
+        graph->mutable_input()
+            ->rbegin()
+            ->mutable_type()
+            ->mutable_tensor_type()
+            ->set_elem_type(tensor.data_type());
+      }
+    }
+
+    engine_outputs_.clear();
+    for (int i = 0; i < OutputSize(); ++i) {
+      engine_outputs_.push_back(versions.at(def().output(i)));
+      add_value_info(
+          engine_outputs_.back(),
+          BlobDims(def().output(i)),
+          graph->add_output());
+    }
+    return model.SerializeAsString();
+  }
+
+  string CachePath(const string& onnx_model) {
+    if (cache_dir_.empty()) {
+      return "";
+    }
+    // engines are only valid for the GPU and TensorRT they are built with
+    std::ostringstream key;
+    key << onnx_model << precision_ << max_workspace_mb_
+        << GetDeviceProperty(context_.cuda_gpu_id()).name
+        << getInferLibVersion();
+    std::ostringstream path;
+    path << cache_dir_ << "/tensorrt_" << std::hex
+         << std::hash<string>()(key.str()) << ".engine";
+    return path.str();
+  }
+
+  TensorRTPtr<nvinfer1::ICudaEngine> BuildEngine(const string& onnx_model) {
+    TensorRTPtr<nvinfer1::IBuilder> builder(
+        nvinfer1::createInferBuilder(Logger()));
+    TensorRTPtr<nvinfer1::INetworkDefinition> network(
+        builder->createNetwork());
+    TensorRTPtr<nvonnxparser::IParser> parser(
+        nvonnxparser::createParser(*network, Logger()));
+    if (!parser->parse(onnx_model.data(), onnx_model.size())) {
+      for (int i = 0; i < parser->getNbErrors(); ++i) {
+        LOG(WARNING) << "TensorRT ONNX parser: " << parser->getError(i)->desc();
+      }
+      return nullptr;
+    }
+    const int batch_size = Input(data_inputs_[0]).dim32(0);
+    builder->setMaxBatchSize(batch_size);
+    builder->setMaxWorkspaceSize(static_cast<size_t>(max_workspace_mb_) << 20);
+    std::unique_ptr<FirstBatchCalibrator> calibrator;
+    if (precision_ == "fp16" && builder->platformHasFastFp16()) {
+      builder->setFp16Mode(true);
+    } else if (precision_ == "int8" && builder->platformHasFastInt8()) {
+      std::map<string, void*> inputs;
+      for (const int i : data_inputs_) {
+        inputs[def().input(i)] = const_cast<void*>(Input(i).raw_data());
+      }
+      calibrator.reset(new FirstBatchCalibrator(batch_size, inputs));
+      builder->setInt8Mode(true);
+      builder->setInt8Calibrator(calibrator.get());
+    } else if (precision_ != "fp32") {
+      LOG(WARNING) << "No fast " << precision_ << " on this GPU, building "
+                   << def().name() << " in fp32";
+    }
+    return TensorRTPtr<nvinfer1::ICudaEngine>(
+        builder->buildCudaEngine(*network));
+  }
+
+  // The engine of the shapes of the last run, or one without a context if
+  // there is none.
+  Engine GetEngine() {
+    Engine engine;
+    const string onnx_model = ExportOnnxModel();
+    const string path = CachePath(onnx_model);
+    if (!path.empty()) {
+      std::ifstream file(path, std::ios::binary);
+      if (file) {
+        std::stringstream serialized;
+        serialized << file.rdbuf();
+        const string data = serialized.str();
+        TensorRTPtr<nvinfer1::IRuntime> runtime(
+            nvinfer1::createInferRuntime(Logger()));
+        engine.engine.reset(runtime->deserializeCudaEngine(
+            data.data(), data.size(), nullptr));
+      }
+    }
+    if (!engine.engine) {
+      engine.engine = BuildEngine(onnx_model);
+      if (engine.engine && !path.empty()) {
+        TensorRTPtr<nvinfer1::IHostMemory> serialized(
+            engine.engine->serialize());
+        std::ofstream file(path, std::ios::binary);
+        file.write(
+            static_cast<const char*>(serialized->data()), serialized->size());
+        VLOG(1) << "TensorRT engine of " << def().name() << " written to "
+                << path;
+      }
+    }
+    if (!engine.engine) {
+      LOG(WARNING) << "No TensorRT engine for " << def().name()
+                   << ", running its " << backup_ops_.size() << " ops";
+      return engine;
+    }
+
+    for (const int i : data_inputs_) {
+      engine.input_bindings.push_back(
+          engine.engine->getBindingIndex(def().input(i).c_str()));
+    }
+    for (int i = 0; i < OutputSize(); ++i) {
+      engine.output_bindings.push_back(
+          engine.engine->getBindingIndex(engine_outputs_[i].c_str()));
+      engine.output_dims.push_back(Output(i)->dims());
+    }
+    for (const int binding : engine.input_bindings) {
+      CAFFE_ENFORCE_GE(binding, 0, "TensorRT engine without an input");
+    }
+    for (const int binding : engine.output_bindings) {
+      CAFFE_ENFORCE_GE(binding, 0, "TensorRT engine without an output");
+    }
+    engine.context.reset(engine.engine->createExecutionContext());
+    return engine;
+  }
+
+  Workspace* ws_;
+  const string precision_;
+  const string cache_dir_;
+  const int max_workspace_mb_;
+  NetDef backup_net_;
+  std::set<string> weights_;
+  std::vector<int> data_inputs_;
+  std::vector<std::unique_ptr<OperatorBase>> backup_ops_;
+  std::vector<string> engine_outputs_;
+  std::map<ShapeKey, Engine> engines_;
+};
+
+REGISTER_CUDA_OPERATOR(TensorRT, TensorRTOp);
+
+OPERATOR_SCHEMA(TensorRT)
+    .NumInputs(1, INT_MAX)
+    .NumOutputs(1, INT_MAX)
+    .SetDoc(R"DOC(
+Runs the ops of a subgraph, replaced by the TensorRT transform, as TensorRT
+engines: one per shape of its data inputs, built from the ONNX model of the
+ops in fp32, fp16 or int8, and cached on disk. Int8 engines are calibrated
+on the first batch of their shape. The first batch of every shape, and all
+the batches of shapes TensorRT can not build an engine for, run the ops
+themselves.
+)DOC")
+    .Arg("backup_net", "Serialized NetDef of the ops of the subgraph")
+    .Arg(
+        "weights",
+        "Inputs that are params, built into the engines; the other inputs "
+        "are the data, whose first dim is the batch")
+    .Arg("precision", "fp32, fp16 (default) or int8")
+    .Arg(
+        "cache_dir",
+        "Directory of the serialized engines, keyed by the model, its "
+        "shapes, the precision, the GPU and the TensorRT version")
+    .Arg("max_workspace_mb", "Scratch memory of the engine layers (1024)");
+
+SHOULD_NOT_DO_GRADIENT(TensorRT);
+
+} // namespace caffe2
@@ -0,0 +1,231 @@
+#include "caffe2/contrib/tensorrt/tensorrt_transform.h"
+
+#include <set>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/flags.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+CAFFE2_DEFINE_string(
+    caffe2_tensorrt_precision,
+    "fp16",
+    "Precision of the TensorRT engines: fp32, fp16 or int8. Falls back to "
+    "fp32 on GPUs without fast fp16 / int8.");
+CAFFE2_DEFINE_string(
+    caffe2_tensorrt_cache_dir,
+    "",
+    "Directory of the serialized TensorRT engines, one per subgraph, input "
+    "shape and precision, reused by later runs. Empty to build them every "
+    "run.");
+CAFFE2_DEFINE_int(
+    caffe2_tensorrt_max_workspace_mb,
+    1024,
+    "Scratch memory the TensorRT builder may give the layers of an engine");
+
+namespace caffe2 {
+
+using transform::Graph;
+
+namespace {
+
+// the ops that the ONNX exporter converts and TensorRT runs
+bool IsSupported(const OperatorDef& op) {
+  static const std::set<string> kTypes{"Add",
+                                       "AffineNd",
+                                       "AveragePool",
+                                       "BatchMatMul",
+                                       "Concat",
+                                       "Conv",
+                                       "MaxPool",
+                                       "Mul",
+                                       "Relu",
+                                       "Reshape",
+                                       "Sigmoid",
+                                       "Softmax",
+                                       "SpatialBN",
+                                       "Sum",
+                                       "Transpose"};
+  if (!kTypes.count(op.type()) || op.device_option().device_type() != CUDA) {
+    return false;
+  }
+  ArgumentHelper args(op);
+  if (args.GetSingleArgument<string>("order", "NCHW") != "NCHW") {
+    return false;
+  }
+  if (op.type() == "SpatialBN") {
+    return args.GetSingleArgument<int>("is_test", 0);
+  }
+  if (op.type() == "Reshape") {
+    // the new shape is a constant of the engine
+    return op.input_size() == 1;
+  }
+  if (op.type() == "Conv") {
+    return args.GetRepeatedArgument<int>("kernels", {1, 1}).size() <= 3;
+  }
+  return true;
+}
+
+} // namespace
+
+bool TensorRTTransform::PatternRule(
+    const Graph& g,
+    const std::vector<int>& subgraph,
+    int idx) {
+  const OperatorDef& op = g.node(idx).op;
+  if (!ws_ || !IsSupported(op)) {
+    return false;
+  }
+  // the inputs of the run stay as they are, for the engines built on them
+  std::set<string> inputs;
+  std::set<string> written;
+  for (const int i : subgraph) {
+    for (const auto& input : g.node(i).op.input()) {
+      if (!written.count(input)) {
+        inputs.insert(input);
+      }
+    }
+    for (const auto& output : g.node(i).op.output()) {
+      written.insert(output);
+    }
+  }
+  for (const auto& input : op.input()) {
+    if (!written.count(input)) {
+      inputs.insert(input);
+    }
+  }
+  for (const auto& output : op.output()) {
+    if (inputs.count(output)) {
+      return false;
+    }
+  }
+  if (subgraph.size() == 0) {
+    return true;
+  }
+  // a run of consecutive ops on one GPU, which thus take their inputs from
+  // the ops before the run only
+  return idx == subgraph.back() + 1 &&
+      op.device_option().cuda_gpu_id() ==
+      g.node(subgraph[0]).op.device_option().cuda_gpu_id();
+}
+
+bool TensorRTTransform::ValidatorRule(
+    const Graph& g,
+    const std::vector<int>& subgraph) {
+  // engines are worth it from the first conv on
+  for (const int idx : subgraph) {
+    if (g.node(idx).op.type() == "Conv") {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool TensorRTTransform::ReplaceRule(
+    const std::vector<int>& subgraph,
+    Graph* g_ptr) {
+  CHECK(g_ptr);
+  auto& g = *g_ptr;
+  const std::set<int> members(subgraph.begin(), subgraph.end());
+
+  // the blobs that the run reads before writing them, and that it writes
+  NetDef backup_net;
+  std::vector<string> inputs;
+  std::set<string> read;
+  std::set<string> written;
+  for (const int idx : subgraph) {
+    const OperatorDef& op = g.node(idx).op;
+    backup_net.add_op()->CopyFrom(op);
+    for (const auto& input : op.input()) {
+      if (!written.count(input) && read.insert(input).second) {
+        inputs.push_back(input);
+      }
+    }
+    for (int i = 0; i < op.output_size(); ++i) {
+      // the old shapes of the Reshapes are not kept
+      if (op.type() != "Reshape" || i == 0) {
+        written.insert(op.output(i));
+      }
+    }
+  }
+
+  // the params: blobs of the workspace that no op of the net writes
+  std::set<string> net_outputs;
+  for (int idx = 0; idx < g.size(); ++idx) {
+    for (const auto& output : g.node(idx).op.output()) {
+      net_outputs.insert(output);
+    }
+  }
+  std::vector<string> weights;
+  for (const auto& input : inputs) {
+    if (!net_outputs.count(input) && ws_->HasBlob(input)) {
+      weights.push_back(input);
+    }
+  }
+
+  // the blobs read after the run, and those nothing reads
+  std::map<int, std::vector<string>> parents;
+  std::map<int, std::vector<string>> children;
+  std::vector<string> outputs;
+  std::set<string> seen;
+  for (const int idx : subgraph) {
+    for (const auto& edge : g.node(idx).parents) {
+      if (!members.count(edge.first)) {
+        auto& blobs = parents[edge.first];
+        blobs.insert(blobs.end(), edge.second.begin(), edge.second.end());
+      }
+    }
+    for (const auto& edge : g.node(idx).children) {
+      if (!members.count(edge.first)) {
+        auto& blobs = children[edge.first];
+        blobs.insert(blobs.end(), edge.second.begin(), edge.second.end());
+        for (const auto& blob : edge.second) {
+          if (seen.insert(blob).second) {
+            outputs.push_back(blob);
+          }
+        }
+      }
+    }
+  }
+  for (const auto& blob : written) {
+    if (g.external_output().count(blob) && seen.insert(blob).second) {
+      outputs.push_back(blob);
+    }
+  }
+
+  const int first = subgraph[0];
+  const OperatorDef& first_op = g.node(first).op;
+  OperatorDef trt_op = CreateOperatorDef(
+      "TensorRT",
+      "",
+      inputs,
+      outputs,
+      std::vector<Argument>{
+          MakeArgument<string>("backup_net", backup_net.SerializeAsString()),
+          MakeArgument<std::vector<string>>("weights", weights),
+          MakeArgument<string>("precision", FLAGS_caffe2_tensorrt_precision),
+          MakeArgument<string>("cache_dir", FLAGS_caffe2_tensorrt_cache_dir),
+          MakeArgument<int>(
+              "max_workspace_mb", FLAGS_caffe2_tensorrt_max_workspace_mb)},
+      first_op.device_option());
+  trt_op.set_name(first_op.name());
+
+  // the TensorRT op takes the place of the first op of the run, with the
+  // edges of the whole run
+  g.DeactivateSubgraph(subgraph);
+  auto& node = g.node(first);
+  node.op = trt_op;
+  node.active = true;
+  node.parents = parents;
+  node.children = children;
+  for (const auto& edge : parents) {
+    g.node(edge.first).children[first] = edge.second;
+  }
+  for (const auto& edge : children) {
+    g.node(edge.first).parents[first] = edge.second;
+  }
+  return true;
+}
+
+REGISTER_TRANSFORM(TensorRT, TensorRTTransform);
+
+} // namespace caffe2
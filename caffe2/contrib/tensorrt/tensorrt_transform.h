@@ -0,0 +1,43 @@
+#pragma once
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/transform.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+/**
+ * TensorRT
+ *
+ * Replaces every run of consecutive CUDA ops that TensorRT can run (the
+ * convs, pools, norms, activations and non-local products of a backbone)
+ * with one TensorRT op. The op builds an engine of the run per input shape,
+ * cached on disk (--caffe2_tensorrt_cache_dir), in the precision of
+ * --caffe2_tensorrt_precision, and runs the original ops, kept as its
+ * "backup_net", for the shapes it has no engine for.
+ *
+ * The params of the run are read for the engine from the workspace of the
+ * transform (SetWorkspace), so apply it once they are loaded; nothing is
+ * replaced without a workspace. Apply it before the Caffe2 fusion passes,
+ * whose fused ops TensorRT does not know and does better itself.
+ */
+class TensorRTTransform : public Transform {
+ public:
+  TensorRTTransform() {
+    SetPatternMatchType(SORTED_WRT_EXECUTION_ORDER);
+  }
+
+ protected:
+  bool PatternRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph,
+      int idx) override;
+  bool ValidatorRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph) override;
+  bool ReplaceRule(const std::vector<int>& subgraph, transform::Graph* g_ptr)
+      override;
+};
+
+} // namespace caffe2
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include "caffe2/contrib/tensorrt/tensorrt_transform.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+
+namespace caffe2 {
+
+namespace {
+
+using transform::Graph;
+
+OperatorDef* AddCudaOp(
+    NetDef* netdef,
+    const string& type,
+    const std::vector<string>& inputs,
+    const std::vector<string>& outputs) {
+  auto* op = AddOp(netdef, type, inputs, outputs);
+  op->mutable_device_option()->set_device_type(CUDA);
+  return op;
+}
+
+// the blobs of the params, which the transform only checks for
+void AddParams(Workspace* ws, const std::vector<string>& names) {
+  for (const auto& name : names) {
+    ws->CreateBlob(name);
+  }
+}
+
+TEST(TensorRTTransformTest, TestReplace) {
+  Workspace ws;
+  AddParams(&ws, {"W1", "b1", "W2"});
+  NetDef netdef;
+  netdef.add_external_output("out");
+  AddCudaOp(&netdef, "Conv", {"data", "W1", "b1"}, {"conv1"});
+  AddCudaOp(&netdef, "Relu", {"conv1"}, {"conv1"}); // in place
+  AddCudaOp(&netdef, "MaxPool", {"conv1"}, {"pool1"});
+  AddCudaOp(&netdef, "Conv", {"pool1", "W2"}, {"conv2"});
+  // not run by TensorRT
+  AddCudaOp(&netdef, "Dropout", {"conv2"}, {"drop", "mask"});
+  AddCudaOp(&netdef, "Sum", {"drop", "pool1"}, {"out"});
+
+  NetDef transformed_netdef = ApplyTransform("TensorRT", netdef, &ws);
+  ASSERT_EQ(transformed_netdef.op_size(), 3);
+  const auto& trt = transformed_netdef.op(0);
+  EXPECT_EQ(trt.type(), "TensorRT");
+  EXPECT_EQ(trt.device_option().device_type(), CUDA);
+  EXPECT_EQ(
+      std::vector<string>(trt.input().begin(), trt.input().end()),
+      (std::vector<string>{"data", "W1", "b1", "W2"}));
+  // pool1 is also read after the run
+  EXPECT_EQ(
+      std::vector<string>(trt.output().begin(), trt.output().end()),
+      (std::vector<string>{"pool1", "conv2"}));
+  ArgumentHelper args(trt);
+  EXPECT_EQ(
+      args.GetRepeatedArgument<string>("weights"),
+      (std::vector<string>{"W1", "b1", "W2"}));
+  NetDef backup_net;
+  ASSERT_TRUE(backup_net.ParseFromString(
+      args.GetSingleArgument<string>("backup_net", "")));
+  ASSERT_EQ(backup_net.op_size(), 4);
+  EXPECT_EQ(backup_net.op(1).type(), "Relu");
+  EXPECT_EQ(transformed_netdef.op(1).type(), "Dropout");
+  EXPECT_EQ(transformed_netdef.op(2).type(), "Sum");
+}
+
+TEST(TensorRTTransformTest, TestExternalOutput) {
+  Workspace ws;
+  AddParams(&ws, {"W"});
+  NetDef netdef;
+  netdef.add_external_output("out");
+  AddCudaOp(&netdef, "Conv", {"data", "W"}, {"conv"});
+  AddCudaOp(&netdef, "Relu", {"conv"}, {"out"});
+
+  NetDef transformed_netdef = ApplyTransform("TensorRT", netdef, &ws);
+  ASSERT_EQ(transformed_netdef.op_size(), 1);
+  const auto& trt = transformed_netdef.op(0);
+  EXPECT_EQ(trt.type(), "TensorRT");
+  ASSERT_EQ(trt.output_size(), 1);
+  EXPECT_EQ(trt.output(0), "out");
+}
+
+TEST(TensorRTTransformTest, TestNoReplace) {
+  Workspace ws;
+  AddParams(&ws, {"W"});
+  NetDef netdef;
+  // no conv in the run
+  AddCudaOp(&netdef, "Relu", {"data"}, {"relu"});
+  AddCudaOp(&netdef, "MaxPool", {"relu"}, {"pool"});
+  AddCudaOp(&netdef, "Dropout", {"pool"}, {"drop", "mask"});
+  // on CPU
+  AddOp(&netdef, "Conv", {"drop", "W"}, {"conv1"});
+  // another order
+  AddCudaOp(&netdef, "Conv", {"conv1", "W"}, {"conv2"})
+      ->add_arg()
+      ->CopyFrom(MakeArgument<string>("order", "NHWC"));
+  // written in place of the input of the run
+  AddCudaOp(&netdef, "Conv", {"conv2", "W"}, {"conv2"});
+
+  EXPECT_EQ(ApplyTransform("TensorRT", netdef, &ws).op_size(), 6);
+  // without the params
+  NetDef conv_netdef;
+  AddCudaOp(&conv_netdef, "Conv", {"data", "W"}, {"conv"});
+  EXPECT_EQ(ApplyTransform("TensorRT", conv_netdef).op_size(), 1);
+  EXPECT_EQ(
+      ApplyTransform("TensorRT", conv_netdef, &ws).op(0).type(), "TensorRT");
+}
+
+} // namespace
+
+} // namespace caffe2
@@ -26,6 +26,15 @@ void SetCPUAllocator(CPUAllocator* alloc) {
   g_cpu_allocator.reset(alloc);
 }
 
+static std::atomic<MemoryAllocationListener*> g_memory_listener(nullptr);
+MemoryAllocationListener* GetMemoryAllocationListener() {
+  return g_memory_listener.load(std::memory_order_acquire);
+}
+
+void SetMemoryAllocationListener(MemoryAllocationListener* listener) {
+  g_memory_listener.store(listener, std::memory_order_release);
+}
+
 MemoryAllocationReporter CPUContext::reporter_;
 
 void MemoryAllocationReporter::New(void* ptr, size_t nbytes) {
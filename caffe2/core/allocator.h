@@ -1,10 +1,12 @@
 #ifndef CAFFE2_CORE_ALLOCATOR_H_
 #define CAFFE2_CORE_ALLOCATOR_H_
 
+#include <atomic>
 #include <unordered_map>
 
 #include "caffe2/core/logging.h"
 #include "caffe2/core/numa.h"
+#include "caffe2/core/static_tracepoint.h"
 
 CAFFE2_DECLARE_bool(caffe2_report_cpu_memory_usage);
 CAFFE2_DECLARE_bool(caffe2_cpu_allocator_do_zero_fill);
@@ -41,6 +43,23 @@ class MemoryAllocationReporter {
   size_t allocated_;
 };
 
+// Gets the allocations and deallocations of the CPU and CUDA contexts while
+// it is set, with the device of the memory: the GPU id, or -1 for the CPU.
+// Memory allocated before the listener was set may be deleted without a
+// call. The calls come from any thread, with the CUDA allocation lock held.
+class MemoryAllocationListener {
+ public:
+  virtual ~MemoryAllocationListener() noexcept {}
+  virtual void New(int device, void* ptr, size_t nbytes) = 0;
+  virtual void Delete(void* ptr) = 0;
+};
+
+// Gets the listener of the allocations, nullptr if there is none.
+MemoryAllocationListener* GetMemoryAllocationListener();
+// Sets the listener of the allocations: the listener is not owned and has to
+// outlive the allocations it was set for, nullptr unsets it.
+void SetMemoryAllocationListener(MemoryAllocationListener* listener);
+
 struct DefaultCPUAllocator final : CPUAllocator {
   DefaultCPUAllocator() {}
   ~DefaultCPUAllocator() override {}
@@ -59,15 +78,18 @@ struct DefaultCPUAllocator final : CPUAllocator {
     if (FLAGS_caffe2_cpu_allocator_do_zero_fill) {
       memset(data, 0, nbytes);
     }
+    CAFFE_HOT_SDT(cpu_alloc, data, nbytes);
     return {data, Delete};
   }
 
 #ifdef _MSC_VER
   static void Delete(void* data) {
+    CAFFE_HOT_SDT(cpu_free, data);
     _aligned_free(data);
   }
 #else
   static void Delete(void* data) {
+    CAFFE_HOT_SDT(cpu_free, data);
     free(data);
   }
 #endif
@@ -0,0 +1,194 @@
+#include "caffe2/core/batching_predictor.h"
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+BatchingPredictor::BatchingPredictor(
+    const NetDef& init_net,
+    const NetDef& run_net,
+    const Options& options)
+    : options_(options) {
+  CAFFE_ENFORCE_GT(options.num_workers, 0);
+  CAFFE_ENFORCE(weights_.RunNetOnce(init_net));
+  for (int i = 0; i < options.num_workers; ++i) {
+    predictors_.emplace_back(new Predictor(run_net, &weights_));
+  }
+  Start();
+}
+
+BatchingPredictor::BatchingPredictor(
+    std::vector<std::unique_ptr<Predictor>> predictors,
+    const Options& options)
+    : options_(options), predictors_(std::move(predictors)) {
+  CAFFE_ENFORCE(!predictors_.empty());
+  Start();
+}
+
+void BatchingPredictor::Start() {
+  CAFFE_ENFORCE_GT(options_.max_batch_size, 0);
+  for (auto& predictor : predictors_) {
+    workers_.emplace_back(&BatchingPredictor::Work, this, predictor.get());
+  }
+}
+
+BatchingPredictor::~BatchingPredictor() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+std::future<BatchingPredictor::Outputs> BatchingPredictor::run(
+    std::vector<TensorCPU> inputs) {
+  CAFFE_ENFORCE(!inputs.empty());
+  std::unique_ptr<Request> request(new Request);
+  BucketKey key;
+  for (const auto& input : inputs) {
+    CAFFE_ENFORCE_GT(input.ndim(), 0);
+    CAFFE_ENFORCE_EQ(
+        input.dim(0), inputs[0].dim(0), "inputs of a request of other sizes");
+    key.push_back(input.ndim());
+    key.insert(key.end(), input.dims().begin() + 1, input.dims().end());
+  }
+  request->items = inputs[0].dim32(0);
+  request->inputs = std::move(inputs);
+  request->deadline = Clock::now() + options_.max_wait;
+  auto future = request->promise.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CAFFE_ENFORCE(!stop_, "the predictor is stopping");
+    auto& bucket = buckets_[key];
+    bucket.items += request->items;
+    bucket.requests.push_back(std::move(request));
+  }
+  cv_.notify_all();
+  return future;
+}
+
+void BatchingPredictor::Work(Predictor* predictor) {
+  std::vector<std::unique_ptr<Request>> batch;
+  while (TakeBatch(&batch)) {
+    RunBatch(predictor, &batch);
+    batch.clear();
+  }
+}
+
+bool BatchingPredictor::TakeBatch(
+    std::vector<std::unique_ptr<Request>>* batch) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    if (stop_ && buckets_.empty()) {
+      return false;
+    }
+    // the full bucket, or the one whose oldest request is due first; once
+    // stopping all of them are due
+    const auto now = Clock::now();
+    auto next = buckets_.end();
+    for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+      if (next == buckets_.end() ||
+          it->second.requests.front()->deadline <
+              next->second.requests.front()->deadline) {
+        next = it;
+      }
+      if (it->second.items >= options_.max_batch_size) {
+        next = it;
+        break;
+      }
+    }
+    if (next == buckets_.end()) {
+      cv_.wait(lock);
+      continue;
+    }
+    auto& bucket = next->second;
+    if (bucket.items < options_.max_batch_size && !stop_ &&
+        now < bucket.requests.front()->deadline) {
+      cv_.wait_until(lock, bucket.requests.front()->deadline);
+      continue;
+    }
+    // at least one request, and as many as fit
+    int items = 0;
+    while (!bucket.requests.empty() &&
+           (batch->empty() ||
+            items + bucket.requests.front()->items <=
+                options_.max_batch_size)) {
+      items += bucket.requests.front()->items;
+      batch->push_back(std::move(bucket.requests.front()));
+      bucket.requests.pop_front();
+    }
+    bucket.items -= items;
+    if (bucket.requests.empty()) {
+      buckets_.erase(next);
+    }
+    return true;
+  }
+}
+
+void BatchingPredictor::RunBatch(
+    Predictor* predictor,
+    std::vector<std::unique_ptr<Request>>* batch) {
+  try {
+    CPUContext context;
+    int items = 0;
+    for (const auto& request : *batch) {
+      items += request->items;
+    }
+    // the inputs of the requests one after the other
+    const auto& first = (*batch)[0]->inputs;
+    std::vector<TensorCPU> inputs(first.size());
+    Predictor::TensorVector input_ptrs;
+    for (size_t j = 0; j < first.size(); ++j) {
+      std::vector<TIndex> dims = first[j].dims();
+      dims[0] = items;
+      inputs[j].Resize(dims);
+      char* dst =
+          static_cast<char*>(inputs[j].raw_mutable_data(first[j].meta()));
+      for (const auto& request : *batch) {
+        const auto& input = request->inputs[j];
+        context.CopyItems<CPUContext, CPUContext>(
+            input.meta(), input.size(), input.raw_data(), dst);
+        dst += input.nbytes();
+      }
+      input_ptrs.push_back(&inputs[j]);
+    }
+
+    Predictor::TensorVector outputs;
+    CAFFE_ENFORCE(predictor->run(input_ptrs, &outputs), "the net failed");
+    ++num_batches_;
+
+    // and the items of each request back
+    std::vector<Outputs> results(batch->size());
+    for (const auto* output : outputs) {
+      CAFFE_ENFORCE_GT(output->ndim(), 0);
+      CAFFE_ENFORCE_EQ(
+          output->dim(0), items, "an output is not of the items of the batch");
+      const char* src = static_cast<const char*>(output->raw_data());
+      for (size_t r = 0; r < batch->size(); ++r) {
+        std::vector<TIndex> dims = output->dims();
+        dims[0] = (*batch)[r]->items;
+        results[r].emplace_back(dims);
+        auto& result = results[r].back();
+        context.CopyItems<CPUContext, CPUContext>(
+            output->meta(),
+            result.size(),
+            src,
+            result.raw_mutable_data(output->meta()));
+        src += result.nbytes();
+      }
+    }
+    for (size_t r = 0; r < batch->size(); ++r) {
+      (*batch)[r]->promise.set_value(std::move(results[r]));
+    }
+  } catch (...) {
+    for (auto& request : *batch) {
+      request->promise.set_exception(std::current_exception());
+    }
+  }
+}
+
+} // namespace caffe2
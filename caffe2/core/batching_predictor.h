@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/predictor.h"
+
+namespace caffe2 {
+
+// Serves requests from many threads by batching them: the requests waiting
+// are concatenated along their first dim (the batch, e.g. one clip each),
+// run as one net on the first free predictor of a pool (one per workspace,
+// e.g. one per GPU), and the outputs split back to the requests. A batch
+// is run once it holds max_batch_size items, or once its oldest request has
+// waited max_wait. Requests whose inputs differ in more than the first dim,
+// e.g. clips of other spatial sizes, wait in buckets of their own.
+class BatchingPredictor {
+ public:
+  using Outputs = std::vector<TensorCPU>;
+
+  struct Options {
+    int max_batch_size = 8;
+    std::chrono::microseconds max_wait{2000};
+    // predictors created by the constructor from nets
+    int num_workers = 1;
+  };
+
+  // num_workers predictors of run_net, each with a workspace of its own for
+  // the activations, sharing the weights of one run of init_net
+  BatchingPredictor(
+      const NetDef& init_net,
+      const NetDef& run_net,
+      const Options& options);
+
+  // one worker per predictor, e.g. of nets set up for another GPU each. All
+  // the outputs must have the items of the batch along their first dim.
+  BatchingPredictor(
+      std::vector<std::unique_ptr<Predictor>> predictors,
+      const Options& options);
+
+  // Runs the requests waiting, then stops the workers.
+  ~BatchingPredictor();
+
+  // Queues a request: the inputs of the predictors, all with the same first
+  // dim. The future gets the outputs of the request, or the error of its
+  // batch.
+  std::future<Outputs> run(std::vector<TensorCPU> inputs);
+
+  int64_t num_batches() const {
+    return num_batches_;
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  struct Request {
+    std::vector<TensorCPU> inputs;
+    int items;
+    Clock::time_point deadline;
+    std::promise<Outputs> promise;
+  };
+
+  // the dims of the inputs past the first one
+  using BucketKey = std::vector<TIndex>;
+
+  struct Bucket {
+    std::deque<std::unique_ptr<Request>> requests;
+    int items = 0;
+  };
+
+  void Start();
+  void Work(Predictor* predictor);
+  // Waits for a bucket to be ready and takes a batch off it; false once
+  // stopped with nothing left.
+  bool TakeBatch(std::vector<std::unique_ptr<Request>>* batch);
+  void RunBatch(
+      Predictor* predictor,
+      std::vector<std::unique_ptr<Request>>* batch);
+
+  const Options options_;
+  // the weights of the predictors created from nets
+  Workspace weights_;
+  std::vector<std::unique_ptr<Predictor>> predictors_;
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::map<BucketKey, Bucket> buckets_;
+  bool stop_ = false;
+  std::atomic<int64_t> num_batches_{0};
+};
+
+} // namespace caffe2
@@ -0,0 +1,122 @@
+#include "caffe2/core/batching_predictor.h"
+#include "caffe2/core/context.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/utils/proto_utils.h"
+
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+const char* predictSpec = R"DOC(
+        name: "predict"
+        external_input: "data"
+        external_output: "y"
+        op {
+          input: "data"
+          output: "y"
+          type: "Scale"
+          arg { name: "scale" f: 2.0 }
+        }
+)DOC";
+
+NetDef parseNetDef(const std::string& value) {
+  NetDef def;
+  CAFFE_ENFORCE(
+      TextFormat::ParseFromString(value, &def),
+      "Failed to parse NetDef with value: ",
+      value);
+  return def;
+}
+
+std::vector<TensorCPU> randomClip(
+    const std::vector<TIndex>& dims,
+    CPUContext* ctx) {
+  std::vector<TensorCPU> inputs;
+  inputs.emplace_back(dims);
+  math::RandUniform<float, CPUContext>(
+      inputs[0].size(), -1.0, 1.0, inputs[0].mutable_data<float>(), ctx);
+  return inputs;
+}
+
+void expectScaled(
+    const TensorCPU& clip,
+    const BatchingPredictor::Outputs& outputs) {
+  ASSERT_EQ(outputs.size(), 1);
+  ASSERT_EQ(outputs[0].dims(), clip.dims());
+  for (int i = 0; i < clip.size(); ++i) {
+    EXPECT_EQ(outputs[0].data<float>()[i], 2 * clip.data<float>()[i]);
+  }
+}
+
+} // namespace
+
+TEST(BatchingPredictorTest, ManyThreads) {
+  BatchingPredictor::Options options;
+  options.max_batch_size = 4;
+  options.num_workers = 2;
+  BatchingPredictor p(NetDef(), parseNetDef(predictSpec), options);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&p, t]() {
+      DeviceOption option;
+      option.set_random_seed(t);
+      CPUContext ctx(option);
+      for (int i = 0; i < 10; ++i) {
+        auto inputs = randomClip({1, 3, 2, 4, 4}, &ctx);
+        TensorCPU clip(inputs[0]);
+        expectScaled(clip, p.run(std::move(inputs)).get());
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_LE(p.num_batches(), 80);
+}
+
+TEST(BatchingPredictorTest, FullBatch) {
+  BatchingPredictor::Options options;
+  options.max_batch_size = 4;
+  // only a full batch runs before the requests are done
+  options.max_wait = std::chrono::seconds(60);
+  BatchingPredictor p(NetDef(), parseNetDef(predictSpec), options);
+  CPUContext ctx;
+  std::vector<TensorCPU> clips;
+  std::vector<std::future<BatchingPredictor::Outputs>> results;
+  for (int i = 0; i < 4; ++i) {
+    auto inputs = randomClip({1, 3, 2, 4, 4}, &ctx);
+    clips.emplace_back(inputs[0]);
+    results.push_back(p.run(std::move(inputs)));
+  }
+  for (int i = 0; i < 4; ++i) {
+    expectScaled(clips[i], results[i].get());
+  }
+  EXPECT_EQ(p.num_batches(), 1);
+}
+
+TEST(BatchingPredictorTest, ShapeBuckets) {
+  BatchingPredictor::Options options;
+  options.max_batch_size = 4;
+  options.max_wait = std::chrono::milliseconds(10);
+  BatchingPredictor p(NetDef(), parseNetDef(predictSpec), options);
+  CPUContext ctx;
+  std::vector<TensorCPU> clips;
+  std::vector<std::future<BatchingPredictor::Outputs>> results;
+  // two clips of each size, and one of two items
+  for (const int size : {4, 5, 4, 5}) {
+    auto inputs = randomClip({1, 3, 2, size, size}, &ctx);
+    clips.emplace_back(inputs[0]);
+    results.push_back(p.run(std::move(inputs)));
+  }
+  auto inputs = randomClip({2, 3, 2, 4, 4}, &ctx);
+  clips.emplace_back(inputs[0]);
+  results.push_back(p.run(std::move(inputs)));
+  for (int i = 0; i < clips.size(); ++i) {
+    expectScaled(clips[i], results[i].get());
+  }
+  EXPECT_EQ(p.num_batches(), 2);
+}
+
+} // namespace caffe2
@@ -21,6 +21,12 @@ CAFFE2_DEFINE_bool(
     false,
     "Serialize FLOAT16 tensors using byte_data field");
 
+CAFFE2_DEFINE_bool(
+    caffe2_serialize_as_bytes,
+    false,
+    "Serialize tensors of numeric types as their raw bytes in the byte_data "
+    "field, instead of one repeated field element per item");
+
 namespace caffe2 {
 /**
  * @brief StringSerializer is the serializer for String.
@@ -16,6 +16,7 @@
 CAFFE2_DECLARE_int(caffe2_tensor_chunk_size);
 CAFFE2_DECLARE_int(caffe2_max_tensor_serializer_threads);
 CAFFE2_DECLARE_bool(caffe2_serialize_fp16_as_bytes);
+CAFFE2_DECLARE_bool(caffe2_serialize_as_bytes);
 
 namespace caffe2 {
 
@@ -120,10 +121,7 @@ inline void CopyToProtoAsIs(
       sizeof(SrcType) == sizeof(DstType),
       "The source type and dest type cannot be copied as-is. Did "
       "you mean CopyToProtoWithCast?");
-  field->Reserve(size);
-  for (int i = 0; i < size; ++i) {
-    field->Add(0);
-  }
+  field->Resize(size, 0);
   context->template Copy<SrcType, Context, CPUContext>(
       size, src, reinterpret_cast<SrcType*>(field->mutable_data()));
   // Make sure that we finish the copy into the protobuf.
@@ -180,6 +178,59 @@ inline void CopyFromProtoWithCast(
   context->template Copy<DstType, CPUContext, Context>(size, buffer.get(), dst);
 }
 
+// The types whose items are stored as their raw bytes in byte_data, which
+// are copied as a whole instead of item by item into a repeated field.
+inline bool IsRawBytesType(const TensorProto::DataType data_type) {
+  switch (data_type) {
+    case TensorProto_DataType_FLOAT:
+    case TensorProto_DataType_INT32:
+    case TensorProto_DataType_BOOL:
+    case TensorProto_DataType_UINT8:
+    case TensorProto_DataType_INT8:
+    case TensorProto_DataType_UINT16:
+    case TensorProto_DataType_INT16:
+    case TensorProto_DataType_INT64:
+    case TensorProto_DataType_FLOAT16:
+    case TensorProto_DataType_DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+inline void EnforceLittleEndian() {
+  const int kValue = 1;
+  CAFFE_ENFORCE_EQ(
+      reinterpret_cast<const char*>(&kValue)[0],
+      1,
+      "Serialization as bytes on big endian platform is not written yet.");
+}
+
+template <class Context>
+inline void CopyToBytes(
+    const size_t nbytes,
+    const void* src,
+    string* bytes,
+    Context* context) {
+  EnforceLittleEndian();
+  bytes->resize(nbytes);
+  context->template Copy<char, Context, CPUContext>(
+      nbytes, static_cast<const char*>(src), &(*bytes)[0]);
+  context->FinishDeviceComputation();
+}
+
+template <class Context>
+inline void CopyFromBytes(
+    const size_t nbytes,
+    const string& bytes,
+    void* dst,
+    Context* context) {
+  EnforceLittleEndian();
+  CAFFE_ENFORCE_EQ(nbytes, bytes.size(), "Incorrect proto field size.");
+  context->template Copy<char, CPUContext, Context>(
+      nbytes, bytes.data(), static_cast<char*>(dst));
+}
+
 }  // namespace detail
 
 template <class Context>
@@ -228,7 +279,11 @@ void TensorSerializer<Context>::SerializeWithChunkSize(
     }
   };
   if (tensor.size() > chunk_size) {
-    for (int i = 0; i < FLAGS_caffe2_max_tensor_serializer_threads; ++i) {
+    // no more threads than chunks, the caller serializes one of them
+    const int64_t num_chunks = (tensor.size() + chunk_size - 1) / chunk_size;
+    const int num_threads = std::min<int64_t>(
+        FLAGS_caffe2_max_tensor_serializer_threads, num_chunks - 1);
+    for (int i = 0; i < num_threads; ++i) {
       futures.emplace_back(std::async(std::launch::async, task));
     }
   }
@@ -297,6 +352,19 @@ void TensorSerializer<Context>::Serialize(
   proto.set_data_type(data_type);
   StoreDeviceDetail(input, &proto);
 
+  if (detail::IsRawBytesType(data_type) &&
+      (FLAGS_caffe2_serialize_as_bytes ||
+       (data_type == TensorProto_DataType_FLOAT16 &&
+        FLAGS_caffe2_serialize_fp16_as_bytes))) {
+    detail::CopyToBytes(
+        chunkSize * input.itemsize(),
+        static_cast<const char*>(input.raw_data()) +
+            chunkBegin * input.itemsize(),
+        proto.mutable_byte_data(),
+        &this->context_);
+    return;
+  }
+
   // A lot of copypaste is error prone. Should we create a macro for this?
   switch (data_type) {
   case TensorProto_DataType_FLOAT:
@@ -368,31 +436,14 @@ void TensorSerializer<Context>::Serialize(
         proto.mutable_int64_data(),
         &this->context_);
     break;
-  case TensorProto_DataType_FLOAT16: {
-    if (FLAGS_caffe2_serialize_fp16_as_bytes) {
-      const int kValue = 1;
-      CAFFE_ENFORCE_EQ(
-          reinterpret_cast<const char*>(&kValue)[0],
-          1,
-          "Serialization of FLOAT16 on big endian platform "
-          "is not written yet.");
-      unique_ptr<char[]> buffer(new char[2 * chunkSize]);
-      this->context_.template Copy<char, Context, CPUContext>(
-          2 * chunkSize,
-          reinterpret_cast<const char*>(
-              input.template data<float16>() + chunkBegin),
-          buffer.get());
-      this->context_.FinishDeviceComputation();
-      proto.set_byte_data(buffer.release(), 2 * chunkSize);
-    } else {
-      detail::CopyToProtoWithCast(
-          chunkSize,
-          reinterpret_cast<const uint16_t*>(input.template data<float16>()) +
-              chunkBegin,
-          proto.mutable_int32_data(),
-          &this->context_);
-    }
-  } break;
+  case TensorProto_DataType_FLOAT16:
+    detail::CopyToProtoWithCast(
+        chunkSize,
+        reinterpret_cast<const uint16_t*>(input.template data<float16>()) +
+            chunkBegin,
+        proto.mutable_int32_data(),
+        &this->context_);
+    break;
   case TensorProto_DataType_DOUBLE:
     detail::CopyToProtoAsIs(
         chunkSize,
@@ -452,6 +503,18 @@ void TensorDeserializer<Context>::Deserialize(
       tensor->size());
   auto chunkSize = chunkEnd - chunkBegin;
 
+  if (detail::IsRawBytesType(proto.data_type()) && proto.has_byte_data()) {
+    const TypeMeta& meta = DataTypeToTypeMeta(proto.data_type());
+    detail::CopyFromBytes(
+        chunkSize * meta.itemsize(),
+        proto.byte_data(),
+        static_cast<char*>(tensor->raw_mutable_data(meta)) +
+            chunkBegin * meta.itemsize(),
+        &context);
+    context.FinishDeviceComputation();
+    return;
+  }
+
   switch (proto.data_type()) {
     case TensorProto_DataType_FLOAT:
       detail::CopyFromProtoAsIs(
@@ -529,31 +592,14 @@ void TensorDeserializer<Context>::Deserialize(
           &context);
       break;
     case TensorProto_DataType_FLOAT16:
-      if (proto.has_byte_data()) {
-        const int kValue = 1;
-        CAFFE_ENFORCE_EQ(
-            reinterpret_cast<const char*>(&kValue)[0],
-            1,
-            "Serialization of FLOAT16 on big endian platform "
-            "is not written yet.");
-        CAFFE_ENFORCE_EQ(
-            2 * chunkSize,
-            proto.byte_data().size(),
-            "Incorrect proto field size.");
-        context.template Copy<float16, Context, CPUContext>(
-            chunkSize,
-            reinterpret_cast<const float16*>(proto.byte_data().data()),
-            tensor->template mutable_data<float16>() + chunkBegin);
-      } else {
-        // Backward compatibility with models which used int32_data field
-        detail::CopyFromProtoWithCast(
-            chunkSize,
-            proto.int32_data(),
-            reinterpret_cast<uint16_t*>(
-                tensor->template mutable_data<float16>()) +
-                chunkBegin,
-            &context);
-      }
+      // Backward compatibility with models which used int32_data field
+      detail::CopyFromProtoWithCast(
+          chunkSize,
+          proto.int32_data(),
+          reinterpret_cast<uint16_t*>(
+              tensor->template mutable_data<float16>()) +
+              chunkBegin,
+          &context);
       break;
     case TensorProto_DataType_DOUBLE:
       detail::CopyFromProtoAsIs(
@@ -21,6 +21,7 @@
 CAFFE2_DEFINE_int64(caffe2_test_big_tensor_size, 100000000, "");
 CAFFE2_DECLARE_int(caffe2_tensor_chunk_size);
 CAFFE2_DECLARE_bool(caffe2_serialize_fp16_as_bytes);
+CAFFE2_DECLARE_bool(caffe2_serialize_as_bytes);
 
 namespace caffe2 {
 using namespace ::caffe2::db;
@@ -478,6 +479,58 @@ TYPED_TEST(TensorCPUTest, MaxKeepOnShrink) {
   FLAGS_caffe2_max_keep_on_shrink_memory = LLONG_MAX;
 }
 
+TYPED_TEST(TensorCPUTest, GrowthPolicySettlesAtHighWater) {
+  // also without keep on shrink
+  FLAGS_caffe2_keep_on_shrink = false;
+  TensorGrowthPolicy policy;
+  policy.factor = 1.5f;
+  TensorGrowthGuard guard(policy);
+  ASSERT_EQ(CurrentTensorGrowthPolicy(), &policy);
+
+  const vector<int> sizes{30, 100, 60, 200, 90};
+  TensorCPU tensor(vector<int>{1, 10});
+  tensor.mutable_data<TypeParam>();
+  for (const int size : sizes) {
+    tensor.Resize(1, size);
+    tensor.mutable_data<TypeParam>();
+    EXPECT_GE(tensor.capacity_nbytes(), tensor.nbytes());
+  }
+  // the runs after the warmup reuse the high-water capacity
+  const TypeParam* ptr = tensor.data<TypeParam>();
+  const size_t capacity = tensor.capacity_nbytes();
+  for (const int size : sizes) {
+    tensor.Resize(1, size);
+    EXPECT_EQ(tensor.mutable_data<TypeParam>(), ptr);
+    EXPECT_EQ(tensor.capacity_nbytes(), capacity);
+  }
+  FLAGS_caffe2_keep_on_shrink = true;
+}
+
+TEST(TensorGrowthPolicyTest, GrowsToSizeClasses) {
+  TensorGrowthPolicy policy;
+  policy.factor = 1.5f;
+  // 4 classes per power of 2
+  EXPECT_EQ(policy.GrowTo(0, 1000), 1024);
+  EXPECT_EQ(policy.GrowTo(0, 1100), 1280);
+  // by the factor at least
+  EXPECT_EQ(policy.GrowTo(1024, 1100), 1536);
+  EXPECT_EQ(policy.GrowTo(1024, 4000), 4096);
+}
+
+TEST(TensorGrowthPolicyTest, GuardRestoresThePolicy) {
+  EXPECT_EQ(CurrentTensorGrowthPolicy(), nullptr);
+  TensorGrowthPolicy policy;
+  policy.factor = 2.f;
+  {
+    TensorGrowthGuard guard(policy);
+    EXPECT_EQ(CurrentTensorGrowthPolicy(), &policy);
+    // a disabled policy keeps the current one
+    TensorGrowthGuard disabled{TensorGrowthPolicy()};
+    EXPECT_EQ(CurrentTensorGrowthPolicy(), &policy);
+  }
+  EXPECT_EQ(CurrentTensorGrowthPolicy(), nullptr);
+}
+
 TYPED_TEST(TensorCPUDeathTest, CannotAccessRawDataWhenEmpty) {
   TensorCPU tensor;
   EXPECT_EQ(tensor.ndim(), 0);
@@ -692,6 +745,46 @@ TEST(TensorTest, float16) {
   }
 }
 
+TEST(TensorTest, SerializationAsBytes) {
+  const TIndex kSize = 1000;
+  Blob blob;
+  TensorCPU* tensor = blob.GetMutable<TensorCPU>();
+  tensor->Resize(2, kSize / 2);
+  for (int i = 0; i < kSize; ++i) {
+    tensor->mutable_data<float>()[i] = i * 0.5f;
+  }
+  const bool serialize_as_bytes = FLAGS_caffe2_serialize_as_bytes;
+  FLAGS_caffe2_serialize_as_bytes = true;
+  std::mutex mutex;
+  std::vector<string> chunks;
+  auto acceptor = [&](const std::string& /*key*/, const std::string& value) {
+    std::lock_guard<std::mutex> guard(mutex);
+    chunks.push_back(value);
+  };
+  blob.Serialize("test", acceptor, kSize / 4 + 1);
+  FLAGS_caffe2_serialize_as_bytes = serialize_as_bytes;
+  EXPECT_EQ(chunks.size(), 4);
+
+  Blob new_blob;
+  for (const auto& chunk : chunks) {
+    BlobProto proto;
+    CHECK(proto.ParseFromString(chunk));
+    const TensorProto& tensor_proto = proto.tensor();
+    EXPECT_EQ(tensor_proto.data_type(), TensorProto_DataType_FLOAT);
+    EXPECT_EQ(tensor_proto.float_data_size(), 0);
+    EXPECT_EQ(
+        tensor_proto.byte_data().size(),
+        sizeof(float) *
+            (tensor_proto.segment().end() - tensor_proto.segment().begin()));
+    EXPECT_NO_THROW(new_blob.Deserialize(chunk));
+  }
+  const TensorCPU& new_tensor = new_blob.Get<TensorCPU>();
+  EXPECT_EQ(new_tensor.dims(), tensor->dims());
+  for (int i = 0; i < kSize; ++i) {
+    EXPECT_EQ(new_tensor.data<float>()[i], i * 0.5f);
+  }
+}
+
 TEST(QTensorTest, QTensorSerialization) {
   Blob blob;
   QTensor<CPUContext>* qtensor = blob.GetMutable<QTensor<CPUContext>>();
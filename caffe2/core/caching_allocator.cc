@@ -0,0 +1,186 @@
+#include "caffe2/core/caching_allocator.h"
+
+#include <algorithm>
+#include <tuple>
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+constexpr size_t CachingAllocator::kRoundBytes;
+constexpr size_t CachingAllocator::kSmallBytes;
+constexpr size_t CachingAllocator::kSmallSegmentBytes;
+
+struct CachingAllocator::Block {
+  const void* stream;
+  size_t size;
+  char* ptr;
+  // the free list of the segment of the block
+  FreeBlocks* pool;
+  bool allocated = false;
+  // neighbours in the segment
+  Block* prev = nullptr;
+  Block* next = nullptr;
+
+  Block(const void* stream, size_t size, char* ptr, FreeBlocks* pool)
+      : stream(stream), size(size), ptr(ptr), pool(pool) {}
+};
+
+bool CachingAllocator::BlockOrder::operator()(
+    const Block* a,
+    const Block* b) const {
+  return std::make_tuple(a->stream, a->size, a->ptr) <
+      std::make_tuple(b->stream, b->size, b->ptr);
+}
+
+CachingAllocator::CachingAllocator(RawAlloc raw_alloc, RawFree raw_free)
+    : raw_alloc_(raw_alloc), raw_free_(raw_free) {}
+
+CachingAllocator::~CachingAllocator() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ReleaseFreeSegments();
+}
+
+CachingAllocator::Block* CachingAllocator::RawAllocate(
+    size_t nbytes,
+    const void* stream,
+    FreeBlocks* pool) {
+  void* ptr = raw_alloc_(nbytes);
+  if (ptr == nullptr) {
+    ReleaseFreeSegments();
+    ptr = raw_alloc_(nbytes);
+  }
+  if (ptr == nullptr) {
+    return nullptr;
+  }
+  ++stats_.num_raw_allocs;
+  stats_.cached_bytes += nbytes;
+  stats_.peak_cached_bytes =
+      std::max(stats_.peak_cached_bytes, stats_.cached_bytes);
+  return new Block(stream, nbytes, static_cast<char*>(ptr), pool);
+}
+
+void* CachingAllocator::Allocate(size_t nbytes, const void* stream) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t size =
+      (std::max(nbytes, size_t(1)) + kRoundBytes - 1) / kRoundBytes *
+      kRoundBytes;
+  FreeBlocks* pool = size <= kSmallBytes ? &small_blocks_ : &large_blocks_;
+
+  Block key(stream, size, nullptr, pool);
+  Block* block = nullptr;
+  auto it = pool->lower_bound(&key);
+  if (it != pool->end() && (*it)->stream == stream) {
+    block = *it;
+    pool->erase(it);
+  } else {
+    block = RawAllocate(
+        pool == &small_blocks_ ? kSmallSegmentBytes : size, stream, pool);
+    CAFFE_ENFORCE(
+        block,
+        "Out of memory allocating ",
+        nbytes,
+        " bytes, with ",
+        stats_.allocated_bytes,
+        " bytes allocated and ",
+        stats_.cached_bytes,
+        " bytes cached");
+  }
+
+  // split off the rest of the block, unless it is too small to serve a
+  // request of its pool
+  const size_t rest = block->size - size;
+  if (rest >= (pool == &small_blocks_ ? kRoundBytes : kSmallBytes + 1)) {
+    Block* remaining = new Block(stream, rest, block->ptr + size, pool);
+    remaining->prev = block;
+    remaining->next = block->next;
+    if (block->next) {
+      block->next->prev = remaining;
+    }
+    block->next = remaining;
+    block->size = size;
+    pool->insert(remaining);
+  }
+
+  block->allocated = true;
+  allocated_[block->ptr] = block;
+  stats_.allocated_bytes += block->size;
+  stats_.peak_allocated_bytes =
+      std::max(stats_.peak_allocated_bytes, stats_.allocated_bytes);
+  return block->ptr;
+}
+
+void CachingAllocator::Free(void* ptr) {
+  if (ptr == nullptr) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = allocated_.find(ptr);
+  CAFFE_ENFORCE(it != allocated_.end(), "Freeing an unknown pointer ", ptr);
+  Block* block = it->second;
+  allocated_.erase(it);
+  block->allocated = false;
+  stats_.allocated_bytes -= block->size;
+
+  // merge with the free neighbours in the segment
+  FreeBlocks* pool = block->pool;
+  if (block->prev && !block->prev->allocated) {
+    Block* prev = block->prev;
+    pool->erase(prev);
+    prev->size += block->size;
+    prev->next = block->next;
+    if (block->next) {
+      block->next->prev = prev;
+    }
+    delete block;
+    block = prev;
+  }
+  if (block->next && !block->next->allocated) {
+    Block* next = block->next;
+    pool->erase(next);
+    block->size += next->size;
+    block->next = next->next;
+    if (next->next) {
+      next->next->prev = block;
+    }
+    delete next;
+  }
+  pool->insert(block);
+}
+
+void CachingAllocator::ReleaseFreeSegments() {
+  for (FreeBlocks* pool : {&small_blocks_, &large_blocks_}) {
+    for (auto it = pool->begin(); it != pool->end();) {
+      Block* block = *it;
+      if (block->prev || block->next) {
+        ++it;
+        continue;
+      }
+      raw_free_(block->ptr);
+      ++stats_.num_raw_frees;
+      stats_.cached_bytes -= block->size;
+      it = pool->erase(it);
+      delete block;
+    }
+  }
+}
+
+void CachingAllocator::EmptyCache() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ReleaseFreeSegments();
+}
+
+CachingAllocatorStats CachingAllocator::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  CachingAllocatorStats stats = stats_;
+  stats.largest_free_bytes = 0;
+  for (const FreeBlocks* pool : {&small_blocks_, &large_blocks_}) {
+    for (const Block* block : *pool) {
+      stats.largest_free_bytes =
+          std::max(stats.largest_free_bytes, block->size);
+    }
+  }
+  return stats;
+}
+
+} // namespace caffe2
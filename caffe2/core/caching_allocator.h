@@ -0,0 +1,92 @@
+#ifndef CAFFE2_CORE_CACHING_ALLOCATOR_H_
+#define CAFFE2_CORE_CACHING_ALLOCATOR_H_
+
+#include <functional>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
+#include "caffe2/core/common.h"
+
+namespace caffe2 {
+
+struct CachingAllocatorStats {
+  // bytes of the blocks handed out
+  size_t allocated_bytes = 0;
+  // bytes held from the raw allocator, allocated or not
+  size_t cached_bytes = 0;
+  size_t peak_allocated_bytes = 0;
+  size_t peak_cached_bytes = 0;
+  // the largest free block, i.e. the largest request served without a raw
+  // allocation (on its stream)
+  size_t largest_free_bytes = 0;
+  // calls to the raw allocator
+  size_t num_raw_allocs = 0;
+  size_t num_raw_frees = 0;
+
+  // 1 - largest free block / free cached bytes: 0 if the cached memory that
+  // is not allocated is one block, close to 1 if it is scattered
+  double fragmentation() const {
+    const size_t free_bytes = cached_bytes - allocated_bytes;
+    return free_bytes == 0 ? 0. : 1. - double(largest_free_bytes) / free_bytes;
+  }
+};
+
+/**
+ * A caching allocator on top of a raw allocator (e.g. cudaMalloc) that is
+ * slow or synchronizing, for memory whose sizes change from run to run.
+ *
+ * Requests are rounded to kRoundBytes. Small requests (up to kSmallBytes)
+ * are carved from kSmallSegmentBytes segments, large ones from segments of
+ * their own size; a cached block larger than a request is split and the
+ * blocks of a segment are merged again when freed. Freed blocks are only
+ * reused by requests on the stream they were allocated on, so work queued
+ * on that stream before the free is ordered before any later use. When the
+ * raw allocator fails, the cached segments that are entirely free are
+ * returned to it and the allocation is retried.
+ */
+class CachingAllocator {
+ public:
+  // returns nullptr when out of memory
+  typedef std::function<void*(size_t)> RawAlloc;
+  typedef std::function<void(void*)> RawFree;
+
+  static constexpr size_t kRoundBytes = 512;
+  static constexpr size_t kSmallBytes = 1 << 20;
+  static constexpr size_t kSmallSegmentBytes = 2 << 20;
+
+  CachingAllocator(RawAlloc raw_alloc, RawFree raw_free);
+  // returns the free segments; blocks still allocated are leaked
+  ~CachingAllocator();
+
+  CachingAllocator(const CachingAllocator&) = delete;
+  CachingAllocator& operator=(const CachingAllocator&) = delete;
+
+  void* Allocate(size_t nbytes, const void* stream);
+  void Free(void* ptr);
+  // returns the segments that are entirely free to the raw allocator
+  void EmptyCache();
+  CachingAllocatorStats GetStats() const;
+
+ private:
+  struct Block;
+  struct BlockOrder {
+    bool operator()(const Block* a, const Block* b) const;
+  };
+  typedef std::set<Block*, BlockOrder> FreeBlocks;
+
+  Block* RawAllocate(size_t nbytes, const void* stream, FreeBlocks* pool);
+  void ReleaseFreeSegments();
+
+  RawAlloc raw_alloc_;
+  RawFree raw_free_;
+  mutable std::mutex mutex_;
+  FreeBlocks small_blocks_;
+  FreeBlocks large_blocks_;
+  std::unordered_map<void*, Block*> allocated_;
+  CachingAllocatorStats stats_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_CORE_CACHING_ALLOCATOR_H_
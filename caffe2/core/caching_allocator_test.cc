@@ -0,0 +1,140 @@
+#include <cstdlib>
+
+#include "caffe2/core/caching_allocator.h"
+#include "caffe2/core/logging.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+const size_t kMB = 1 << 20;
+
+// a raw allocator with a budget of bytes
+class BudgetAllocator {
+ public:
+  explicit BudgetAllocator(size_t budget) : budget_(budget) {}
+
+  CachingAllocator::RawAlloc Alloc() {
+    return [this](size_t nbytes) -> void* {
+      if (used_ + nbytes > budget_) {
+        return nullptr;
+      }
+      used_ += nbytes;
+      void* ptr = malloc(nbytes);
+      sizes_[ptr] = nbytes;
+      return ptr;
+    };
+  }
+
+  CachingAllocator::RawFree Free() {
+    return [this](void* ptr) {
+      used_ -= sizes_[ptr];
+      sizes_.erase(ptr);
+      free(ptr);
+    };
+  }
+
+  size_t used() const {
+    return used_;
+  }
+
+ private:
+  size_t budget_;
+  size_t used_ = 0;
+  std::unordered_map<void*, size_t> sizes_;
+};
+
+const int kStreamA = 0;
+const int kStreamB = 1;
+
+} // namespace
+
+TEST(CachingAllocatorTest, ReusesFreedBlocks) {
+  BudgetAllocator raw(64 * kMB);
+  CachingAllocator allocator(raw.Alloc(), raw.Free());
+  void* a = allocator.Allocate(1000, &kStreamA);
+  allocator.Free(a);
+  EXPECT_EQ(allocator.Allocate(900, &kStreamA), a);
+  auto stats = allocator.GetStats();
+  EXPECT_EQ(stats.num_raw_allocs, 1);
+  EXPECT_EQ(stats.allocated_bytes, 1024);
+  EXPECT_EQ(stats.cached_bytes, CachingAllocator::kSmallSegmentBytes);
+}
+
+TEST(CachingAllocatorTest, KeepsStreamsApart) {
+  BudgetAllocator raw(64 * kMB);
+  CachingAllocator allocator(raw.Alloc(), raw.Free());
+  void* a = allocator.Allocate(4 * kMB, &kStreamA);
+  allocator.Free(a);
+  void* b = allocator.Allocate(4 * kMB, &kStreamB);
+  EXPECT_NE(a, b);
+  EXPECT_EQ(allocator.GetStats().num_raw_allocs, 2);
+  auto c = allocator.Allocate(4 * kMB, &kStreamA);
+  EXPECT_EQ(c, a);
+}
+
+TEST(CachingAllocatorTest, SplitsAndMergesLargeBlocks) {
+  BudgetAllocator raw(64 * kMB);
+  CachingAllocator allocator(raw.Alloc(), raw.Free());
+  char* a = static_cast<char*>(allocator.Allocate(8 * kMB, &kStreamA));
+  allocator.Free(a);
+  char* b = static_cast<char*>(allocator.Allocate(3 * kMB, &kStreamA));
+  char* c = static_cast<char*>(allocator.Allocate(3 * kMB, &kStreamA));
+  EXPECT_EQ(b, a);
+  EXPECT_EQ(c, a + 3 * kMB);
+  auto stats = allocator.GetStats();
+  EXPECT_EQ(stats.num_raw_allocs, 1);
+  EXPECT_EQ(stats.largest_free_bytes, 2 * kMB);
+  EXPECT_EQ(stats.fragmentation(), 0.);
+
+  // the 1MB left after a 7MB block is too small to split off
+  allocator.Free(b);
+  allocator.Free(c);
+  EXPECT_EQ(allocator.GetStats().largest_free_bytes, 8 * kMB);
+  EXPECT_EQ(allocator.Allocate(7 * kMB, &kStreamA), a);
+  EXPECT_EQ(allocator.GetStats().allocated_bytes, 8 * kMB);
+}
+
+TEST(CachingAllocatorTest, Fragmentation) {
+  BudgetAllocator raw(64 * kMB);
+  CachingAllocator allocator(raw.Alloc(), raw.Free());
+  void* a = allocator.Allocate(kMB / 2, &kStreamA);
+  void* b = allocator.Allocate(kMB / 2, &kStreamA);
+  void* c = allocator.Allocate(kMB / 2, &kStreamA);
+  allocator.Free(b);
+  // b and the last 512KB of the segment
+  auto stats = allocator.GetStats();
+  EXPECT_EQ(stats.cached_bytes, 2 * kMB);
+  EXPECT_EQ(stats.allocated_bytes, kMB);
+  EXPECT_EQ(stats.largest_free_bytes, kMB / 2);
+  EXPECT_DOUBLE_EQ(stats.fragmentation(), 0.5);
+  allocator.Free(c);
+  EXPECT_DOUBLE_EQ(allocator.GetStats().fragmentation(), 0.);
+  allocator.Free(a);
+  EXPECT_EQ(allocator.GetStats().peak_allocated_bytes, 3 * kMB / 2);
+}
+
+TEST(CachingAllocatorTest, ReleasesFreeSegmentsWhenOutOfMemory) {
+  BudgetAllocator raw(6 * kMB);
+  CachingAllocator allocator(raw.Alloc(), raw.Free());
+  void* a = allocator.Allocate(3 * kMB, &kStreamA);
+  void* b = allocator.Allocate(2 * kMB, &kStreamA);
+  allocator.Free(a);
+  // 5MB cached, the 3MB block is released for the 4MB one
+  void* c = allocator.Allocate(4 * kMB, &kStreamA);
+  EXPECT_NE(c, nullptr);
+  auto stats = allocator.GetStats();
+  EXPECT_EQ(stats.num_raw_frees, 1);
+  EXPECT_EQ(stats.cached_bytes, 6 * kMB);
+  EXPECT_EQ(stats.peak_cached_bytes, 6 * kMB);
+  EXPECT_THROW(allocator.Allocate(kMB, &kStreamA), EnforceNotMet);
+
+  allocator.Free(b);
+  allocator.Free(c);
+  allocator.EmptyCache();
+  EXPECT_EQ(allocator.GetStats().cached_bytes, 0);
+  EXPECT_EQ(raw.used(), 0);
+}
+
+} // namespace caffe2
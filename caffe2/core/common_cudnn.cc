@@ -1,8 +1,21 @@
+#include <algorithm>
+
 #include "caffe2/core/common_cudnn.h"
 #include "caffe2/core/cudnn_wrappers.h"
 
 #include "caffe2/core/init.h"
 
+CAFFE2_DEFINE_int(
+    caffe2_cudnn_ws_budget_mb,
+    0,
+    "If positive, the most scratch memory in MB that the cudnn ops sharing a "
+    "cudnn state of a GPU pick their algorithms for.");
+CAFFE2_DEFINE_int(
+    caffe2_cudnn_ws_reserve_mb,
+    -1,
+    "If not negative, the cudnn ops pick algorithms whose scratch leaves this "
+    "many MB of the device memory free.");
+
 namespace caffe2 {
 
 CuDNNWrapper::PerGPUCuDNNStates& CuDNNWrapper::cudnn_states() {
@@ -13,6 +26,42 @@ CuDNNWrapper::PerGPUCuDNNStates& CuDNNWrapper::cudnn_states() {
   return *p;
 }
 
+size_t CuDNNWrapper::workspace_budget(size_t state_idx, size_t limit) {
+  if (FLAGS_caffe2_cudnn_ws_budget_mb <= 0 &&
+      FLAGS_caffe2_cudnn_ws_reserve_mb < 0) {
+    return limit;
+  }
+  CAFFE_ENFORCE(
+      state_idx < CAFFE2_COMPILE_TIME_MAX_CUDNN_STATES, "Invalid state_idx");
+  auto& sync_state = cudnn_states()[context_->cuda_gpu_id()][state_idx];
+  size_t allocated = 0;
+  {
+    std::lock_guard<std::mutex> g(sync_state.mutex);
+    if (sync_state.state.get()) {
+      allocated = sync_state.state->workspace().nbytes();
+    }
+  }
+  size_t budget = limit;
+  if (FLAGS_caffe2_cudnn_ws_budget_mb > 0) {
+    budget = std::min(
+        budget, static_cast<size_t>(FLAGS_caffe2_cudnn_ws_budget_mb) << 20);
+  }
+  if (FLAGS_caffe2_cudnn_ws_reserve_mb >= 0) {
+    DeviceGuard dg(context_->cuda_gpu_id());
+    size_t free_bytes = 0, total_bytes = 0;
+    CUDA_ENFORCE(cudaMemGetInfo(&free_bytes, &total_bytes));
+    const size_t reserve =
+        static_cast<size_t>(FLAGS_caffe2_cudnn_ws_reserve_mb) << 20;
+    // the workspace is reallocated when it grows, so what it holds now
+    // is available as well
+    budget = std::min(
+        budget, allocated + (free_bytes > reserve ? free_bytes - reserve : 0));
+  }
+  // the shared workspace never shrinks, so no op needs to pick algorithms
+  // for less than it already holds
+  return std::max(budget, std::min(allocated, limit));
+}
+
 namespace {
 bool PrintCuDNNInfo(int*, char***) {
   VLOG(1) << "Caffe2 is built with CuDNN version " << CUDNN_VERSION;
@@ -8,6 +8,7 @@
 #include "caffe2/core/common.h"
 #include "caffe2/core/init.h"
 #include "caffe2/core/logging.h"
+#include "caffe2/core/numa.h"
 
 CAFFE2_DEFINE_bool(
     caffe2_cuda_full_device_control,
@@ -153,6 +154,12 @@ int GetGPUIDForPointer(const void* ptr) {
   return attr.device;
 }
 
+int GetGPUNUMANode(const int device) {
+  char pci_bus_id[32];
+  CUDA_ENFORCE(cudaDeviceGetPCIBusId(pci_bus_id, sizeof(pci_bus_id), device));
+  return GetNUMANodeOfPCIDevice(pci_bus_id);
+}
+
 struct CudaDevicePropWrapper {
   CudaDevicePropWrapper() : props(NumCudaDevices()) {
     for (int i = 0; i < NumCudaDevices(); ++i) {
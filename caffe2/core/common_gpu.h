@@ -118,6 +118,11 @@ int GetGPUIDForPointer(const void* ptr);
  */
 const cudaDeviceProp& GetDeviceProperty(const int device);
 
+/**
+ * Gets the NUMA node the given device is attached to, or -1 if it is unknown.
+ */
+int GetGPUNUMANode(const int device);
+
 /**
  * Runs a device query function and prints out the results to LOG(INFO).
  */
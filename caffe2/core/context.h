@@ -105,6 +105,11 @@ class CPUContext final {
       reporter_.New(data_and_deleter.first, nbytes);
       data_and_deleter.second = ReportAndDelete;
     }
+    auto* listener = GetMemoryAllocationListener();
+    if (listener) {
+      listener->New(-1, data_and_deleter.first, nbytes);
+      data_and_deleter.second = ListenAndDelete;
+    }
     return data_and_deleter;
   }
 
@@ -162,6 +167,18 @@ class CPUContext final {
     reporter_.Delete(ptr);
     GetCPUAllocator()->GetDeleter()(ptr);
   }
+
+  static void ListenAndDelete(void* ptr) {
+    auto* listener = GetMemoryAllocationListener();
+    if (listener) {
+      listener->Delete(ptr);
+    }
+    if (FLAGS_caffe2_report_cpu_memory_usage) {
+      ReportAndDelete(ptr);
+    } else {
+      GetCPUAllocator()->GetDeleter()(ptr);
+    }
+  }
 };
 
 template<>
@@ -11,12 +11,13 @@
 #include "caffe2/core/context_gpu.h"
 #include "caffe2/core/init.h"
 #include "caffe2/core/logging.h"
+#include "caffe2/core/static_tracepoint.h"
 #include "caffe2/core/tensor.h"
 #include "caffe2/utils/string_utils.h"
 
 CAFFE2_DEFINE_string(caffe2_cuda_memory_pool, "",
               "Sets the memory pool used by caffe2. Possible values are "
-              "none, cnmen and cub.");
+              "none, cnmen, cub and caching.");
 
 // For description of CUB caching allocator configuration, see
 // https://nvlabs.github.io/cub/structcub_1_1_caching_device_allocator.html
@@ -38,6 +39,13 @@ CAFFE2_DEFINE_bool(
     "If true CachingDeviceAllocator will print allocation and deallocation "
     "events to stdout.");
 
+CAFFE2_DEFINE_int(
+    caffe2_cuda_low_priority_stream_base,
+    0,
+    "If positive, the cuda streams of this id and above are created with the "
+    "lowest priority of the device, for the nets of background work, see the "
+    "stream_offset arg of the DAG and async nets.");
+
 CAFFE2_DEFINE_bool(
     caffe2_gpu_memory_tracking,
     false,
@@ -52,6 +60,9 @@ namespace caffe2 {
 CAFFE_KNOWN_TYPE(Tensor<CUDAContext>);
 
 thread_local ThreadLocalCUDAObjects CUDAContext::cuda_objects_;
+thread_local int CUDAContext::current_stream_id_ = 0;
+thread_local bool CUDAContext::capturing_ = false;
+thread_local size_t CUDAContext::capture_allocations_ = 0;
 
 // TODO(jiayq): these variables shouldn't be currently accessed during static
 // initialization. We should consider moving them to a Mayer's singleton to
@@ -62,6 +73,9 @@ CudaMemoryPoolType g_cuda_memory_pool_type;
 
 // For cub allocator
 unique_ptr<cub::CachingDeviceAllocator> g_cub_allocator;
+// For the caching allocator, one per gpu. They are never destroyed, as the
+// cuda runtime may be unloaded before the static destructors run.
+static CachingAllocator* g_caching_allocators[CAFFE2_COMPILE_TIME_MAX_GPUS];
 // an unordered map that holds the map from the cuda memory pointer to the
 // device id that it is allocated from. This is used in the cuda memory pool
 // cases, where we need the device id to carry out the deletion.
@@ -89,6 +103,25 @@ CudaMemoryPoolType GetCudaMemoryPoolType() {
   return g_cuda_memory_pool_type;
 }
 
+CachingAllocatorStats GetCudaCachingAllocatorStats(int gpu) {
+  std::lock_guard<std::mutex> lock(CUDAContext::mutex());
+  CAFFE_ENFORCE(
+      g_cuda_memory_pool_type == CudaMemoryPoolType::CACHING,
+      "Pass --caffe2_cuda_memory_pool=caching to enable the caching stats");
+  CAFFE_ENFORCE_LT(gpu, NumCudaDevices());
+  return g_caching_allocators[gpu]->GetStats();
+}
+
+void EmptyCudaCachingAllocator() {
+  std::lock_guard<std::mutex> lock(CUDAContext::mutex());
+  if (g_cuda_memory_pool_type != CudaMemoryPoolType::CACHING) {
+    return;
+  }
+  for (int i = 0; i < NumCudaDevices(); ++i) {
+    g_caching_allocators[i]->EmptyCache();
+  }
+}
+
 vector<TIndex> GetCUDATensorInfo(
     const void* c,
     bool* shares_data,
@@ -181,6 +214,27 @@ static void SetUpCub() {
   VLOG(1) << "Done setting up cub memory pool.";
 }
 
+static void SetUpCachingAllocators() {
+  VLOG(1) << "Setting up the caching memory pool.";
+  for (int i = 0; i < NumCudaDevices(); ++i) {
+    g_caching_allocators[i] = new CachingAllocator(
+        [i](size_t nbytes) -> void* {
+          DeviceGuard guard(i);
+          void* ptr = nullptr;
+          if (cudaMalloc(&ptr, nbytes) != cudaSuccess) {
+            // Clears the out of memory error, the pool frees and retries.
+            cudaGetLastError();
+            return nullptr;
+          }
+          return ptr;
+        },
+        [i](void* ptr) {
+          DeviceGuard guard(i);
+          CUDA_ENFORCE(cudaFree(ptr));
+        });
+  }
+}
+
 static void Caffe2SetCUDAMemoryPool() {
   if (FLAGS_caffe2_cuda_memory_pool == "" ||
       FLAGS_caffe2_cuda_memory_pool == "none") {
@@ -192,6 +246,9 @@ static void Caffe2SetCUDAMemoryPool() {
     // Sets up cub.
     g_cuda_memory_pool_type = CudaMemoryPoolType::CUB;
     SetUpCub();
+  } else if (FLAGS_caffe2_cuda_memory_pool == "caching") {
+    g_cuda_memory_pool_type = CudaMemoryPoolType::CACHING;
+    SetUpCachingAllocators();
   } else {
     CAFFE_THROW("Unrecognized cuda memory pool type: ",
                 FLAGS_caffe2_cuda_memory_pool);
@@ -312,6 +369,14 @@ void TrackMemoryAlloc(size_t nbytes) {
 }
 }
 
+// called with the allocation lock held and the device of ptr current
+static inline void ListenToNew(void* ptr, size_t nbytes) {
+  auto* listener = GetMemoryAllocationListener();
+  if (listener) {
+    listener->New(CaffeCudaGetDevice(), ptr, nbytes);
+  }
+}
+
 std::pair<void*, MemoryDeleter> CUDAContext::New(size_t nbytes) {
   // Lock the mutex
   std::lock_guard<std::mutex> lock(CUDAContext::mutex());
@@ -319,6 +384,9 @@ std::pair<void*, MemoryDeleter> CUDAContext::New(size_t nbytes) {
   static Caffe2CudaInitializerHelper g_cuda_initializer_;
   void* ptr = nullptr;
 
+  if (capturing_) {
+    ++capture_allocations_;
+  }
   if (FLAGS_caffe2_gpu_memory_tracking) {
     TrackMemoryAlloc(nbytes);
   }
@@ -329,6 +397,8 @@ std::pair<void*, MemoryDeleter> CUDAContext::New(size_t nbytes) {
       g_size_map[ptr] = nbytes;
       g_cuda_device_affiliation[ptr] = CaffeCudaGetDevice();
     }
+    ListenToNew(ptr, nbytes);
+    CAFFE_HOT_SDT(cuda_alloc, ptr, nbytes);
     return {ptr, Delete};
   case CudaMemoryPoolType::CUB:
     CUDA_ENFORCE(g_cub_allocator->DeviceAllocate(&ptr, nbytes));
@@ -338,14 +408,33 @@ std::pair<void*, MemoryDeleter> CUDAContext::New(size_t nbytes) {
     if (FLAGS_caffe2_gpu_memory_tracking) {
       g_size_map[ptr] = nbytes;
     }
+    ListenToNew(ptr, nbytes);
+    CAFFE_HOT_SDT(cuda_alloc, ptr, nbytes);
+    return {ptr, Delete};
+  case CudaMemoryPoolType::CACHING: {
+    const int gpu = CaffeCudaGetDevice();
+    ptr = g_caching_allocators[gpu]->Allocate(
+        nbytes, cuda_objects_.GetStream(gpu, current_stream_id_));
+    g_cuda_device_affiliation[ptr] = gpu;
+    if (FLAGS_caffe2_gpu_memory_tracking) {
+      g_size_map[ptr] = nbytes;
+    }
+    ListenToNew(ptr, nbytes);
+    CAFFE_HOT_SDT(cuda_alloc, ptr, nbytes);
     return {ptr, Delete};
   }
+  }
   return {nullptr, Delete};
 }
 
 void CUDAContext::Delete(void* ptr) {
+  CAFFE_HOT_SDT(cuda_free, ptr);
   // lock the mutex
   std::lock_guard<std::mutex> lock(CUDAContext::mutex());
+  auto* listener = GetMemoryAllocationListener();
+  if (listener) {
+    listener->Delete(ptr);
+  }
 
   if (FLAGS_caffe2_gpu_memory_tracking) {
     auto sz_it = g_size_map.find(ptr);
@@ -385,6 +474,13 @@ void CUDAContext::Delete(void* ptr) {
     g_cuda_device_affiliation.erase(it);
     break;
   }
+  case CudaMemoryPoolType::CACHING: {
+    auto it = g_cuda_device_affiliation.find(ptr);
+    DCHECK(it != g_cuda_device_affiliation.end());
+    g_caching_allocators[it->second]->Free(ptr);
+    g_cuda_device_affiliation.erase(it);
+    break;
+  }
   }
 }
 
@@ -4,20 +4,25 @@
 #include <ctime>
 #include <mutex>
 
+#include "caffe2/core/caching_allocator.h"
 #include "caffe2/core/common_cudnn.h"
 #include "caffe2/core/common_gpu.h"
 #include "caffe2/core/context.h"
+#include "caffe2/core/flags.h"
 #include "caffe2/core/logging.h"
 #include "caffe2/core/numa.h"
 #include "caffe2/core/tensor.h"
 #include "caffe2/core/types.h"
 #include "caffe2/proto/caffe2.pb.h"
 
+CAFFE2_DECLARE_int(caffe2_cuda_low_priority_stream_base);
+
 namespace caffe2 {
 
 enum class CudaMemoryPoolType {
   NONE = 0,
   CUB = 1,
+  CACHING = 2,
 };
 
 /**
@@ -27,6 +32,18 @@ enum class CudaMemoryPoolType {
  */
 CudaMemoryPoolType GetCudaMemoryPoolType();
 
+/**
+ * Gets the stats of the caching memory pool of a gpu. Only available if
+ * --caffe2_cuda_memory_pool=caching.
+ */
+CachingAllocatorStats GetCudaCachingAllocatorStats(int gpu);
+
+/**
+ * Returns the cached memory of the caching memory pool that is not
+ * allocated to the cuda driver, e.g. before a cudaMalloc outside caffe2.
+ */
+void EmptyCudaCachingAllocator();
+
 /**
  * A struct to host thread-local cuda objects.
  *
@@ -55,8 +72,21 @@ class ThreadLocalCUDAObjects {
     }
     if (!gpu_streams[stream_id]) {
       DeviceGuard guard(gpu);
-      CUDA_ENFORCE(cudaStreamCreateWithFlags(
-          &gpu_streams[stream_id], cudaStreamNonBlocking));
+      if (FLAGS_caffe2_cuda_low_priority_stream_base > 0 &&
+          stream_id >= FLAGS_caffe2_cuda_low_priority_stream_base) {
+        // the streams of background work, e.g. an evaluation running next
+        // to the training: the device schedules their kernels only when
+        // those of the other streams leave room
+        int least_priority = 0;
+        int greatest_priority = 0;
+        CUDA_ENFORCE(cudaDeviceGetStreamPriorityRange(
+            &least_priority, &greatest_priority));
+        CUDA_ENFORCE(cudaStreamCreateWithPriority(
+            &gpu_streams[stream_id], cudaStreamNonBlocking, least_priority));
+      } else {
+        CUDA_ENFORCE(cudaStreamCreateWithFlags(
+            &gpu_streams[stream_id], cudaStreamNonBlocking));
+      }
     }
     return gpu_streams[stream_id];
   }
@@ -133,6 +163,7 @@ class CUDAContext final {
 
   inline void SwitchToDevice(int stream_id) {
     set_stream_id(stream_id);
+    current_stream_id_ = stream_id;
     CaffeCudaSetDevice(gpu_id_);
   }
   inline void SwitchToDevice() {
@@ -149,7 +180,9 @@ class CUDAContext final {
   }
 
   void FinishDeviceComputation() {
-    cudaStreamSynchronize(cuda_objects_.GetStream(gpu_id_, stream_id_));
+    if (!capturing_) {
+      cudaStreamSynchronize(cuda_objects_.GetStream(gpu_id_, stream_id_));
+    }
     cudaError_t error = cudaGetLastError();
     if (error != cudaSuccess) {
       CAFFE_THROW("Encountered CUDA error: ", cudaGetErrorString(error));
@@ -238,6 +271,20 @@ class CUDAContext final {
     return true;
   }
 
+  // Set while a net of the thread captures the kernels of its ops into a
+  // CUDA graph (see net_cuda_graph_gpu.cc): the ops then do not synchronize
+  // their stream, and the allocations of the thread are counted.
+  static void SetStreamCapture(bool capturing) {
+    capturing_ = capturing;
+    capture_allocations_ = 0;
+  }
+  static bool IsStreamCapturing() {
+    return capturing_;
+  }
+  static size_t NumCaptureAllocations() {
+    return capture_allocations_;
+  }
+
   static bool IsStreamFree(const DeviceOption& option, int stream_id) {
     auto stream = CUDAContext::cuda_stream(option.cuda_gpu_id(), stream_id);
     return cudaStreamQuery(stream) == cudaSuccess;
@@ -254,6 +301,11 @@ class CUDAContext final {
   int random_seed_;
   curandGenerator_t curand_generator_{nullptr};
   static thread_local ThreadLocalCUDAObjects cuda_objects_;
+  // the stream of the last SwitchToDevice of the thread, i.e. of the op that
+  // runs, that the caching memory pool allocates on
+  static thread_local int current_stream_id_;
+  static thread_local bool capturing_;
+  static thread_local size_t capture_allocations_;
 };
 
 // For the CPU context, we also allow a (probably expensive) function
@@ -5,6 +5,10 @@
 
 #include "caffe2/core/common_cudnn.h"
 #include "caffe2/core/context_gpu.h"
+#include "caffe2/core/flags.h"
+
+CAFFE2_DECLARE_int(caffe2_cudnn_ws_budget_mb);
+CAFFE2_DECLARE_int(caffe2_cudnn_ws_reserve_mb);
 
 namespace caffe2 {
 
@@ -32,6 +36,10 @@ struct CuDNNWorkspace {
     return data_.get();
   }
 
+  size_t nbytes() const {
+    return nbytes_;
+  }
+
   void reset() {
     data_ = nullptr;
     nbytes_ = 0;
@@ -137,6 +145,16 @@ class CuDNNWrapper {
     CHECK_NOTNULL(sync_state.state.get())->execute(context_->cuda_stream(), f);
   }
 
+  /**
+   * Returns the scratch size that an op using the state state_idx may pick
+   * its algorithms for, at most limit. All the ops of a state share its
+   * workspace, which grows to the largest request, so the budget is for
+   * that shared workspace: with --caffe2_cudnn_ws_budget_mb it never grows
+   * past the budget, and with --caffe2_cudnn_ws_reserve_mb it never grows
+   * into the last reserved megabytes of free device memory.
+   */
+  size_t workspace_budget(size_t state_idx, size_t limit);
+
  protected:
   // Pointer to an external cuda context that the cudnn wrapper will use.
   CUDAContext* context_;
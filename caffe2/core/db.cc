@@ -179,8 +179,21 @@ void DBReaderSerializer::Serialize(
   proto.set_name(name);
   proto.set_source(reader.source_);
   proto.set_db_type(reader.db_type_);
-  if (reader.cursor() && reader.cursor()->SupportsSeek()) {
-    proto.set_key(reader.cursor()->key());
+  {
+    std::unique_lock<std::mutex> mutex_lock(reader.reader_mutex_);
+    if (reader.cursor_ && reader.cursor_->SupportsSeek()) {
+      proto.set_key(reader.cursor_->key());
+    }
+    // the shard, order and position, unless a shuffle buffer makes the
+    // order depend on all the reads before
+    if (reader.cursor_ && reader.shuffle_buffer_.empty()) {
+      proto.set_num_shards(reader.num_shards_);
+      proto.set_shard_id(reader.shard_id_);
+      proto.set_shuffle(reader.shuffle_);
+      proto.set_shuffle_seed(reader.shuffle_seed_);
+      proto.set_epoch(reader.epoch_);
+      proto.set_offset(reader.order_index_);
+    }
   }
   BlobProto blob_proto;
   blob_proto.set_name(name);
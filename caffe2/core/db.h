@@ -1,10 +1,14 @@
 #ifndef CAFFE2_CORE_DB_H_
 #define CAFFE2_CORE_DB_H_
 
+#include <algorithm>
 #include <mutex>
+#include <numeric>
+#include <random>
 
 #include "caffe2/core/blob_serialization.h"
 #include "caffe2/core/registry.h"
+#include "caffe2/core/static_tracepoint.h"
 #include "caffe2/proto/caffe2.pb.h"
 
 namespace caffe2 {
@@ -46,6 +50,15 @@ class Cursor {
    * Returns the current value.
    */
   virtual string value() = 0;
+  /**
+   * Points data and size at the current value inside the db instead of
+   * copying it out. The view stays valid until the cursor is destroyed.
+   * Returns false if the db cannot provide such a view, in which case
+   * value() has to be used.
+   */
+  virtual bool ValueView(const char** /*data*/, size_t* /*size*/) {
+    return false;
+  }
   /**
    * Returns whether the current location is valid - for example, if we have
    * reached the end of the database, return false.
@@ -156,15 +169,27 @@ class DBReader {
   }
 
   explicit DBReader(const DBReaderProto& proto) {
-    Open(proto.db_type(), proto.source());
-    if (proto.has_key()) {
+    Open(
+        proto.db_type(),
+        proto.source(),
+        proto.has_num_shards() ? proto.num_shards() : 1,
+        proto.shard_id());
+    if (proto.shuffle()) {
+      Shuffle(proto.shuffle_seed(), 0);
+    }
+    if (proto.has_key() && (!proto.has_offset() || !UseKeyIndex())) {
+      // the records in the order of the db, where the key is the position
       CAFFE_ENFORCE(cursor_->SupportsSeek(),
           "Encountering a proto that needs seeking but the db type "
           "does not support it.");
       cursor_->Seek(proto.key());
+      epoch_ = proto.epoch();
+      order_index_ = proto.offset();
+    } else if (proto.has_offset()) {
+      // straight to the record through the key index, or for a db that
+      // cannot seek, over the records before it
+      SeekToPosition(proto.epoch(), proto.offset());
     }
-    num_shards_ = 1;
-    shard_id_ = 0;
   }
 
   explicit DBReader(std::unique_ptr<DB> db)
@@ -218,21 +243,74 @@ class DBReader {
    * bit: the state of the cursor is actually changed. However, this allows
    * us to pass in a DBReader to an Operator without the need of a duplicated
    * output blob.
+   *
+   * The reads fire the db_read_start and db_read_done probes with the reader
+   * and the number of records, so the time from start to done includes the
+   * wait for the lock of the reader.
    */
   void Read(string* key, string* value) const {
     CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+    CAFFE_HOT_SDT(db_read_start, (void*)this, 1);
     std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
-    *key = cursor_->key();
-    *value = cursor_->value();
+    ReadNext(key, value);
+    CAFFE_HOT_SDT(db_read_done, (void*)this, 1);
+  }
 
-    // In sharded mode, each read skips num_shards_ records
-    for (int s = 0; s < num_shards_; s++) {
-      cursor_->Next();
-      if (!cursor_->Valid()) {
-        MoveToBeginning();
-        break;
-      }
+  /**
+   * Reads the next n records into keys and values under one lock of the
+   * reader, so that the input ops that share a reader contend once per
+   * batch instead of once per record. Thread safe.
+   */
+  void ReadBatch(
+      const int n,
+      std::vector<string>* keys,
+      std::vector<string>* values) const {
+    CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+    keys->resize(n);
+    values->resize(n);
+    CAFFE_HOT_SDT(db_read_start, (void*)this, n);
+    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+    for (int i = 0; i < n; ++i) {
+      ReadNext(&(*keys)[i], &(*values)[i]);
+    }
+    CAFFE_HOT_SDT(db_read_done, (void*)this, n);
+  }
+
+  /**
+   * Like Read(), but without copying the value if the cursor supports
+   * Cursor::ValueView(): data and size then point into the db, and stay
+   * valid until the reader is reopened or destroyed. Otherwise the value is
+   * copied into buffer and data points at it. Thread safe.
+   */
+  void ReadView(
+      string* key,
+      string* buffer,
+      const char** data,
+      size_t* size) const {
+    CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+    CAFFE_HOT_SDT(db_read_start, (void*)this, 1);
+    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+    ReadViewNext(key, buffer, data, size);
+    CAFFE_HOT_SDT(db_read_done, (void*)this, 1);
+  }
+
+  /**
+   * ReadView() of the next n records under one lock of the reader, into
+   * the arrays of n keys, buffers, data and sizes. Thread safe.
+   */
+  void ReadViewBatch(
+      const int n,
+      string* keys,
+      string* buffers,
+      const char** data,
+      size_t* sizes) const {
+    CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+    CAFFE_HOT_SDT(db_read_start, (void*)this, n);
+    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+    for (int i = 0; i < n; ++i) {
+      ReadViewNext(&keys[i], &buffers[i], &data[i], &sizes[i]);
     }
+    CAFFE_HOT_SDT(db_read_done, (void*)this, n);
   }
 
   /**
@@ -244,6 +322,159 @@ class DBReader {
     MoveToBeginning();
   }
 
+  /**
+   * Switches the reader to shard shard_id of num_shards, e.g. a new layout
+   * of the readers every epoch, and seeks to the first record of the shard.
+   * Thread safe.
+   */
+  void Reshard(const int32_t num_shards, const int32_t shard_id) const {
+    CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+    SetShard(num_shards, shard_id);
+    MoveToBeginning();
+  }
+
+  /**
+   * Reads the records in a new random order every epoch, the same for the
+   * same seed. A db that can seek is read through its key index in a
+   * permutation of all the records, seeded with seed and the epoch, of
+   * which every shard reads its part. Any other db is read in order into a
+   * buffer of buffer_size records, from which the reads take a random one
+   * and put the next record in its place. Thread safe.
+   */
+  void Shuffle(const int seed, const size_t buffer_size) const {
+    CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+    shuffle_ = true;
+    shuffle_seed_ = seed;
+    epoch_ = 0;
+    shuffle_buffer_.clear();
+    SetShard(num_shards_, shard_id_);
+    MoveToBeginning();
+    if (!keys_) {
+      CAFFE_ENFORCE_GT(
+          buffer_size, 0, "A db that cannot seek needs a shuffle buffer.");
+      shuffle_rng_.seed(seed);
+      shuffle_buffer_.resize(buffer_size);
+      for (auto& record : shuffle_buffer_) {
+        record.first = cursor_->key();
+        record.second = cursor_->value();
+        MoveToNext();
+      }
+    }
+  }
+
+  /**
+   * The position of the reader: the epoch, and the offset of the next
+   * record in the records of the shard in the order of the epoch, which
+   * with the seed of a shuffled reader pins down the next record. Thread
+   * safe.
+   */
+  void GetPosition(int* epoch, size_t* offset) const {
+    CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+    *epoch = epoch_;
+    *offset = order_index_;
+  }
+
+  /**
+   * The seed of the orders of a shuffled reader, -1 if it is not shuffled.
+   * Thread safe.
+   */
+  int ShuffleSeed() const {
+    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+    return shuffle_ ? shuffle_seed_ : -1;
+  }
+
+  /**
+   * Moves the reader to a position of GetPosition(), e.g. the one of a
+   * checkpoint to resume from, so that it goes on with the same records in
+   * the same order. A db that can seek gets there in one seek through the
+   * index of its keys, built if the reader has none yet; any other db
+   * walks over the records before it. Not for a reader with a shuffle
+   * buffer, whose order depends on all the reads before. Thread safe.
+   */
+  void SeekToPosition(const int epoch, const size_t offset) const {
+    CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+    CAFFE_ENFORCE(
+        shuffle_buffer_.empty(),
+        "The position of a reader with a shuffle buffer cannot be restored.");
+    if (!keys_ && cursor_->SupportsSeek()) {
+      indexed_ = true;
+      SetShard(num_shards_, shard_id_);
+    }
+    MoveToPosition(epoch, offset);
+  }
+
+  /**
+   * The number of records of the shard of the reader, i.e. of an epoch.
+   * Counted with a cursor of its own if the reader has no index of the
+   * keys. Thread safe.
+   */
+  size_t ShardSize() const {
+    CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+    size_t num_records = 0;
+    if (keys_) {
+      num_records = keys_->size();
+    } else {
+      auto cursor = db_->NewCursor();
+      for (cursor->SeekToFirst(); cursor->Valid(); cursor->Next()) {
+        ++num_records;
+      }
+    }
+    if (num_records <= shard_id_) {
+      return 0;
+    }
+    return (num_records - shard_id_ + num_shards_ - 1) / num_shards_;
+  }
+
+  /**
+   * Opens a reader of part part_id of num_parts of the records of the shard
+   * of this reader, with a cursor of its own on the same db and the same
+   * shuffling, e.g. one per decode thread so that their reads do not
+   * serialize on one cursor. The parts are disjoint and together cover the
+   * shard. The db has to allow concurrent cursors, like lmdb, where every
+   * cursor has a read transaction of its own.
+   */
+  std::unique_ptr<DBReader> OpenPart(
+      const int32_t num_parts,
+      const int32_t part_id) const {
+    CAFFE_ENFORCE(cursor_ != nullptr, "Reader not initialized.");
+    CAFFE_ENFORCE(part_id >= 0 && part_id < num_parts);
+    std::unique_lock<std::mutex> mutex_lock(reader_mutex_);
+    CAFFE_ENFORCE(
+        !shuffle_ || keys_,
+        "A reader with a shuffle buffer cannot be split into parts.");
+    std::unique_ptr<DBReader> part(new DBReader());
+    part->db_type_ = db_type_;
+    part->source_ = source_;
+    part->db_ = db_;
+    part->cursor_ = db_->NewCursor();
+    // the parts share one index of the keys, built by the first of them
+    if (!keys_ && part->cursor_->SupportsSeek()) {
+      part->SetShard(num_parts, 0);
+      keys_ = part->keys_;
+    }
+    part->keys_ = keys_;
+    part->shuffle_ = shuffle_;
+    part->shuffle_seed_ = shuffle_seed_;
+    part->indexed_ = indexed_;
+    part->epoch_ = epoch_;
+    // the records of shard s of n are s + i * n, and their part p of m the
+    // ones with i = p mod m, i.e. shard s + p * n of n * m
+    part->SetShard(num_shards_ * num_parts, shard_id_ + num_shards_ * part_id);
+    // the part goes on from the position of this reader: its first record
+    // is the first of its records i = p + j * m with i >= order_index_
+    size_t offset = 0;
+    if (order_index_ > static_cast<size_t>(part_id)) {
+      offset = (order_index_ - part_id + num_parts - 1) / num_parts;
+    }
+    part->MoveToPosition(epoch_, offset);
+    return part;
+  }
+
   /**
    * Returns the underlying cursor of the db reader.
    *
@@ -259,16 +490,84 @@ class DBReader {
 
  private:
   void InitializeCursor(const int32_t num_shards, const int32_t shard_id) {
+    cursor_ = db_->NewCursor();
+    keys_.reset();
+    shuffle_ = false;
+    indexed_ = false;
+    epoch_ = 0;
+    shuffle_buffer_.clear();
+    SetShard(num_shards, shard_id);
+    SeekToFirst();
+  }
+
+  void SetShard(const int32_t num_shards, const int32_t shard_id) const {
     CAFFE_ENFORCE(num_shards >= 1);
     CAFFE_ENFORCE(shard_id >= 0);
     CAFFE_ENFORCE(shard_id < num_shards);
     num_shards_ = num_shards;
     shard_id_ = shard_id;
-    cursor_ = db_->NewCursor();
-    SeekToFirst();
+    // In sharded or shuffled mode, or once seeked to a position, a db that
+    // can seek is read through an index of its keys, built with one pass
+    // over them: every read then seeks straight to the next record of the
+    // shard, instead of walking over the records of the other shards.
+    if ((num_shards_ > 1 || shuffle_ || indexed_) && !keys_ &&
+        cursor_->SupportsSeek()) {
+      auto keys = std::make_shared<std::vector<string>>();
+      for (cursor_->SeekToFirst(); cursor_->Valid(); cursor_->Next()) {
+        keys->push_back(cursor_->key());
+      }
+      keys_ = keys;
+    }
+  }
+
+  bool UseKeyIndex() const {
+    return keys_ && !keys_->empty() &&
+        (num_shards_ > 1 || shuffle_ || indexed_);
+  }
+
+  void MoveToNext() const {
+    if (UseKeyIndex()) {
+      if (++order_index_ == order_.size()) {
+        ++epoch_;
+        MoveToBeginning();
+      } else {
+        cursor_->Seek((*keys_)[order_[order_index_]]);
+      }
+      return;
+    }
+    // In sharded mode, each read skips num_shards_ records
+    ++order_index_;
+    for (int s = 0; s < num_shards_; s++) {
+      cursor_->Next();
+      if (!cursor_->Valid()) {
+        ++epoch_;
+        MoveToBeginning();
+        break;
+      }
+    }
   }
 
   void MoveToBeginning() const {
+    if (UseKeyIndex()) {
+      CAFFE_ENFORCE_LT(
+          shard_id_, keys_->size(), "Db has less rows than shard id");
+      // the records of the shard in the order of the epoch
+      std::vector<size_t> order(keys_->size());
+      std::iota(order.begin(), order.end(), 0);
+      if (shuffle_) {
+        std::seed_seq seq{shuffle_seed_, epoch_};
+        std::mt19937 rng(seq);
+        std::shuffle(order.begin(), order.end(), rng);
+      }
+      order_.clear();
+      for (size_t i = shard_id_; i < order.size(); i += num_shards_) {
+        order_.push_back(order[i]);
+      }
+      order_index_ = 0;
+      cursor_->Seek((*keys_)[order_[0]]);
+      return;
+    }
+    order_index_ = 0;
     cursor_->SeekToFirst();
     for (auto s = 0; s < shard_id_; s++) {
       cursor_->Next();
@@ -277,13 +576,87 @@ class DBReader {
     }
   }
 
+  // offset may be the size of the shard, for the start of the next epoch
+  void MoveToPosition(const int epoch, const size_t offset) const {
+    epoch_ = epoch;
+    MoveToBeginning();
+    if (!UseKeyIndex()) {
+      for (size_t i = 0; i < offset; ++i) {
+        MoveToNext();
+      }
+      return;
+    }
+    CAFFE_ENFORCE_LE(offset, order_.size(), "Position out of the shard");
+    if (offset == order_.size()) {
+      ++epoch_;
+      MoveToBeginning();
+      return;
+    }
+    order_index_ = offset;
+    cursor_->Seek((*keys_)[order_[order_index_]]);
+  }
+
+  void ReadNext(string* key, string* value) const {
+    if (!shuffle_buffer_.empty()) {
+      ReadFromShuffleBuffer(key, value);
+      return;
+    }
+    *key = cursor_->key();
+    *value = cursor_->value();
+    MoveToNext();
+  }
+
+  void ReadViewNext(
+      string* key,
+      string* buffer,
+      const char** data,
+      size_t* size) const {
+    if (!shuffle_buffer_.empty()) {
+      ReadFromShuffleBuffer(key, buffer);
+      *data = buffer->data();
+      *size = buffer->size();
+      return;
+    }
+    *key = cursor_->key();
+    if (!cursor_->ValueView(data, size)) {
+      *buffer = cursor_->value();
+      *data = buffer->data();
+      *size = buffer->size();
+    }
+    MoveToNext();
+  }
+
+  void ReadFromShuffleBuffer(string* key, string* value) const {
+    std::uniform_int_distribution<size_t> dist(0, shuffle_buffer_.size() - 1);
+    auto& record = shuffle_buffer_[dist(shuffle_rng_)];
+    *key = std::move(record.first);
+    *value = std::move(record.second);
+    record.first = cursor_->key();
+    record.second = cursor_->value();
+    MoveToNext();
+  }
+
   string db_type_;
   string source_;
-  unique_ptr<DB> db_;
+  // shared with the readers of OpenPart
+  std::shared_ptr<DB> db_;
   unique_ptr<Cursor> cursor_;
   mutable std::mutex reader_mutex_;
-  uint32_t num_shards_;
-  uint32_t shard_id_;
+  mutable uint32_t num_shards_ = 1;
+  mutable uint32_t shard_id_ = 0;
+  // the keys of the db in sharded or shuffled mode, or once seeked to a
+  // position, if it can seek, and the records of the shard in the order of
+  // the epoch
+  mutable std::shared_ptr<const std::vector<string>> keys_;
+  mutable std::vector<size_t> order_;
+  // the offset of the next record in the shard, also without the index
+  mutable size_t order_index_ = 0;
+  mutable bool indexed_ = false;
+  mutable bool shuffle_ = false;
+  mutable int shuffle_seed_ = 0;
+  mutable int epoch_ = 0;
+  mutable std::mt19937 shuffle_rng_;
+  mutable std::vector<std::pair<string, string>> shuffle_buffer_;
 
   DISABLE_COPY_AND_ASSIGN(DBReader);
 };
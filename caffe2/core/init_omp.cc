@@ -11,6 +11,7 @@
 #endif // CAFFE2_USE_MKL
 
 #include "caffe2/core/init.h"
+#include "caffe2/utils/cpu_budget_pool.h"
 
 CAFFE2_DEFINE_int(
     caffe2_omp_num_threads, 0,
@@ -37,6 +38,14 @@ bool Caffe2SetOpenMPThreads(int*, char***) {
   if (FLAGS_caffe2_omp_num_threads > 0) {
     VLOG(1) << "Setting omp_num_threads to " << FLAGS_caffe2_omp_num_threads;
     omp_set_num_threads(FLAGS_caffe2_omp_num_threads);
+  } else if (
+      FLAGS_caffe2_cpu_budget_threads > 0 && !getenv("OMP_NUM_THREADS")) {
+    // the OpenMP team of an operator counts against the operator share of
+    // the CPU budget, as the intra-op work on the budget pool does
+    const int threads = CpuBudgetMaxWorkers(-1, CpuConsumer::kOperator);
+    VLOG(1) << "Setting omp_num_threads to " << threads
+            << " from the CPU budget";
+    omp_set_num_threads(threads);
   }
   VLOG(1) << "Caffe2 running with " << omp_get_max_threads() << " OMP threads";
   return true;
@@ -64,6 +73,13 @@ bool Caffe2SetMKLThreads(int*, char***) {
   if (FLAGS_caffe2_mkl_num_threads > 0) {
     VLOG(1) << "Setting mkl_num_threads to " << FLAGS_caffe2_mkl_num_threads;
     mkl_set_num_threads(FLAGS_caffe2_mkl_num_threads);
+  } else if (
+      FLAGS_caffe2_omp_num_threads <= 0 && FLAGS_caffe2_cpu_budget_threads > 0 &&
+      !getenv("MKL_NUM_THREADS")) {
+    const int threads = CpuBudgetMaxWorkers(-1, CpuConsumer::kOperator);
+    VLOG(1) << "Setting mkl_num_threads to " << threads
+            << " from the CPU budget";
+    mkl_set_num_threads(threads);
   }
   VLOG(1) << "Caffe2 running with " << mkl_get_max_threads() << " MKL threads";
   return true;
@@ -0,0 +1,206 @@
+#include "caffe2/core/mapped_weights.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/types.h"
+
+namespace caffe2 {
+
+namespace {
+
+const char kMappedWeightsMagic[4] = {'C', '2', 'M', 'W'};
+
+size_t AlignUp(size_t offset) {
+  return (offset + kMappedWeightsAlignment - 1) / kMappedWeightsAlignment *
+      kMappedWeightsAlignment;
+}
+
+template <typename T>
+void Append(string* out, const T value) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// reads the index of a mapped file, checking that it stays in the file
+class IndexReader {
+ public:
+  IndexReader(const char* data, size_t size, const string& path)
+      : data_(data), size_(size), path_(path) {}
+
+  template <typename T>
+  T Read() {
+    T value;
+    memcpy(&value, Advance(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  string ReadString(size_t size) {
+    return string(Advance(size), size);
+  }
+
+ private:
+  const char* Advance(size_t size) {
+    CAFFE_ENFORCE_LE(
+        offset_ + size, size_, "Invalid mapped weights file ", path_);
+    const char* ptr = data_ + offset_;
+    offset_ += size;
+    return ptr;
+  }
+
+  const char* data_;
+  size_t size_;
+  const string& path_;
+  size_t offset_ = 0;
+};
+
+void EnforceLittleEndian() {
+  const int kValue = 1;
+  CAFFE_ENFORCE_EQ(
+      reinterpret_cast<const char*>(&kValue)[0],
+      1,
+      "Mapped weights on big endian platform are not written yet.");
+}
+
+} // namespace
+
+void SaveMappedWeights(
+    const string& path,
+    const Workspace& ws,
+    const std::vector<string>& blob_names) {
+  EnforceLittleEndian();
+  std::vector<const TensorCPU*> tensors;
+  size_t index_size = sizeof(kMappedWeightsMagic) + sizeof(uint32_t);
+  for (const auto& name : blob_names) {
+    const Blob* blob = ws.GetBlob(name);
+    CAFFE_ENFORCE(blob, "Blob does not exist: ", name);
+    CAFFE_ENFORCE(
+        blob->IsType<TensorCPU>(), "Blob is not a CPU Tensor: ", name);
+    const auto& tensor = blob->Get<TensorCPU>();
+    const auto data_type = TypeMetaToDataType(tensor.meta());
+    CAFFE_ENFORCE(
+        data_type != TensorProto_DataType_UNDEFINED &&
+            data_type != TensorProto_DataType_STRING,
+        "Only tensors of fundamental types can be mapped: ",
+        name,
+        " is ",
+        tensor.meta().name());
+    tensors.push_back(&tensor);
+    index_size += 3 * sizeof(uint32_t) + name.size() +
+        tensor.ndim() * sizeof(int64_t) + sizeof(uint64_t);
+  }
+
+  string index;
+  index.append(kMappedWeightsMagic, sizeof(kMappedWeightsMagic));
+  Append<uint32_t>(&index, tensors.size());
+  std::vector<size_t> offsets;
+  size_t offset = AlignUp(index_size);
+  for (int i = 0; i < tensors.size(); ++i) {
+    const auto& tensor = *tensors[i];
+    Append<uint32_t>(&index, blob_names[i].size());
+    index.append(blob_names[i]);
+    Append<int32_t>(&index, TypeMetaToDataType(tensor.meta()));
+    Append<uint32_t>(&index, tensor.ndim());
+    for (const auto d : tensor.dims()) {
+      Append<int64_t>(&index, d);
+    }
+    Append<uint64_t>(&index, offset);
+    offsets.push_back(offset);
+    offset = AlignUp(offset + tensor.nbytes());
+  }
+  DCHECK_EQ(index.size(), index_size);
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  CAFFE_ENFORCE(out, "Cannot open ", path);
+  out.write(index.data(), index.size());
+  size_t written = index.size();
+  const string padding(kMappedWeightsAlignment, '\0');
+  for (int i = 0; i < tensors.size(); ++i) {
+    out.write(padding.data(), offsets[i] - written);
+    out.write(
+        static_cast<const char*>(tensors[i]->raw_data()),
+        tensors[i]->nbytes());
+    written = offsets[i] + tensors[i]->nbytes();
+  }
+  CAFFE_ENFORCE(out, "Cannot write ", path);
+}
+
+std::vector<string> LoadMappedWeights(const string& path, Workspace* ws) {
+#ifdef _WIN32
+  CAFFE_THROW("Mapped weights are not supported on Windows.");
+#else
+  EnforceLittleEndian();
+  const int fd = open(path.c_str(), O_RDONLY);
+  CAFFE_ENFORCE_GE(fd, 0, "Cannot open mapped weights file ", path);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    CAFFE_THROW("Cannot stat mapped weights file ", path);
+  }
+  const size_t size = st.st_size;
+  void* data = size > 0
+      ? mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0)
+      : MAP_FAILED;
+  close(fd);
+  CAFFE_ENFORCE(data != MAP_FAILED, "Cannot map weights file ", path);
+  // the tensors share the mapping and the last of them unmaps it
+  std::shared_ptr<void> mapping(
+      data, [size](void* ptr) { munmap(ptr, size); });
+  const char* base = static_cast<const char*>(data);
+
+  IndexReader reader(base, size, path);
+  CAFFE_ENFORCE(
+      reader.ReadString(sizeof(kMappedWeightsMagic)) ==
+          string(kMappedWeightsMagic, sizeof(kMappedWeightsMagic)),
+      "Not a mapped weights file: ",
+      path);
+  const uint32_t num_tensors = reader.Read<uint32_t>();
+  std::vector<string> names;
+  for (uint32_t i = 0; i < num_tensors; ++i) {
+    const string name = reader.ReadString(reader.Read<uint32_t>());
+    const auto data_type =
+        static_cast<TensorProto::DataType>(reader.Read<int32_t>());
+    CAFFE_ENFORCE(
+        TensorProto_DataType_IsValid(data_type),
+        "Invalid data type of ",
+        name,
+        " in ",
+        path);
+    const TypeMeta& meta = DataTypeToTypeMeta(data_type);
+    std::vector<TIndex> dims(reader.Read<uint32_t>());
+    for (auto& d : dims) {
+      d = reader.Read<int64_t>();
+    }
+    const uint64_t offset = reader.Read<uint64_t>();
+
+    auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+    tensor->Resize(dims);
+    CAFFE_ENFORCE(
+        offset % kMappedWeightsAlignment == 0 &&
+            offset + tensor->size() * meta.itemsize() <= size,
+        "Invalid data of ",
+        name,
+        " in ",
+        path);
+    tensor->ShareExternalPointer(
+        const_cast<char*>(base + offset),
+        meta,
+        0,
+        [mapping](void*) {});
+    names.push_back(name);
+  }
+  VLOG(1) << "Mapped " << names.size() << " tensors from " << path;
+  return names;
+#endif
+}
+
+} // namespace caffe2
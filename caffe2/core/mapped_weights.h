@@ -0,0 +1,38 @@
+#ifndef CAFFE2_CORE_MAPPED_WEIGHTS_H_
+#define CAFFE2_CORE_MAPPED_WEIGHTS_H_
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/workspace.h"
+
+namespace caffe2 {
+
+// Alignment of the data of every tensor in a mapped weights file.
+constexpr size_t kMappedWeightsAlignment = 64;
+
+/**
+ * A mapped weights file holds CPU tensors of fundamental types in the layout
+ * they have in memory, so that they can be used right from the mapped file,
+ * without parsing or copying them. It is, in little endian:
+ *
+ *   "C2MW", uint32 number of tensors
+ *   per tensor: uint32 name size, name, int32 TensorProto data type,
+ *               uint32 ndim, int64 dims[ndim], uint64 data offset
+ *   the data of the tensors, each at a multiple of kMappedWeightsAlignment
+ */
+
+// Writes the TensorCPUs of blob_names in ws to path.
+void SaveMappedWeights(
+    const string& path,
+    const Workspace& ws,
+    const std::vector<string>& blob_names);
+
+// Maps path and creates a TensorCPU in ws for each of its tensors, sharing
+// the mapped pages; returns their names. The pages are read-only and shared
+// by all the processes that map the file, and the file stays mapped until
+// the last of the tensors is freed or reallocated. An op that writes one of
+// the tensors in place crashes.
+std::vector<string> LoadMappedWeights(const string& path, Workspace* ws);
+
+} // namespace caffe2
+
+#endif // CAFFE2_CORE_MAPPED_WEIGHTS_H_
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <fstream>
+
+#include "caffe2/core/mapped_weights.h"
+#include "caffe2/core/tensor.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+TEST(MappedWeightsTest, SharesTheMappedData) {
+  const string path = std::tmpnam(nullptr);
+  {
+    Workspace ws;
+    auto* w = ws.CreateBlob("w")->GetMutable<TensorCPU>();
+    w->Resize(3, 5);
+    for (int i = 0; i < w->size(); ++i) {
+      w->mutable_data<float>()[i] = i;
+    }
+    auto* n = ws.CreateBlob("n")->GetMutable<TensorCPU>();
+    n->Resize(7);
+    for (int i = 0; i < n->size(); ++i) {
+      n->mutable_data<int64_t>()[i] = -i;
+    }
+    ws.CreateBlob("empty")->GetMutable<TensorCPU>()->Resize(0, 2);
+    ws.GetBlob("empty")->GetMutable<TensorCPU>()->mutable_data<uint8_t>();
+    SaveMappedWeights(path, ws, {"w", "n", "empty"});
+  }
+
+  Workspace ws;
+  EXPECT_EQ(
+      LoadMappedWeights(path, &ws), std::vector<string>({"w", "n", "empty"}));
+  const auto& w = ws.GetBlob("w")->Get<TensorCPU>();
+  EXPECT_TRUE(w.shares_data());
+  EXPECT_EQ(w.dims(), std::vector<TIndex>({3, 5}));
+  EXPECT_EQ(
+      reinterpret_cast<uintptr_t>(w.raw_data()) % kMappedWeightsAlignment, 0);
+  for (int i = 0; i < w.size(); ++i) {
+    EXPECT_EQ(w.data<float>()[i], i);
+  }
+  const auto& n = ws.GetBlob("n")->Get<TensorCPU>();
+  EXPECT_EQ(
+      reinterpret_cast<uintptr_t>(n.raw_data()) % kMappedWeightsAlignment, 0);
+  for (int i = 0; i < n.size(); ++i) {
+    EXPECT_EQ(n.data<int64_t>()[i], -i);
+  }
+  const auto& empty = ws.GetBlob("empty")->Get<TensorCPU>();
+  EXPECT_EQ(empty.dims(), std::vector<TIndex>({0, 2}));
+  EXPECT_TRUE(empty.IsType<uint8_t>());
+
+  // the mapping outlives the file name and the other tensors
+  std::remove(path.c_str());
+  ws.RemoveBlob("n");
+  EXPECT_EQ(w.data<float>()[14], 14);
+}
+
+TEST(MappedWeightsTest, RejectsInvalidFiles) {
+  const string path = std::tmpnam(nullptr);
+  {
+    Workspace ws;
+    ws.CreateBlob("w")->GetMutable<TensorCPU>()->Resize(100);
+    ws.GetBlob("w")->GetMutable<TensorCPU>()->mutable_data<float>();
+    SaveMappedWeights(path, ws, {"w"});
+  }
+  // drop the end of the data
+  std::ifstream in(path, std::ios::binary);
+  string data((std::istreambuf_iterator<char>(in)), {});
+  std::ofstream(path, std::ios::binary | std::ios::trunc)
+      .write(data.data(), data.size() - 4);
+
+  Workspace ws;
+  EXPECT_THROW(LoadMappedWeights(path, &ws), EnforceNotMet);
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << "not weights";
+  EXPECT_THROW(LoadMappedWeights(path, &ws), EnforceNotMet);
+  std::remove(path.c_str());
+
+  ws.CreateBlob("s")->GetMutable<TensorCPU>()->Resize(1);
+  ws.GetBlob("s")->GetMutable<TensorCPU>()->mutable_data<string>();
+  EXPECT_THROW(SaveMappedWeights(path, ws, {"s"}), EnforceNotMet);
+}
+
+} // namespace caffe2
@@ -0,0 +1,237 @@
+#include "caffe2/core/memory_planner.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/types.h"
+
+namespace caffe2 {
+namespace memonger {
+
+namespace {
+
+// ops whose outputs share the memory of their inputs
+const std::unordered_set<string>& AliasingOps() {
+  static const std::unordered_set<string> ops = {
+      "Alias",
+      "SoftmaxWithLossGradient",
+      "SpatialSoftmaxWithLossGradient",
+  };
+  return ops;
+}
+
+bool SameDevice(const DeviceOption& a, const DeviceOption& b) {
+  return a.device_type() == b.device_type() &&
+      (a.device_type() == CPU || a.cuda_gpu_id() == b.cuda_gpu_id());
+}
+
+struct BlobInfo {
+  int first_write = -1;
+  int first_op = -1;
+  int last_op = -1;
+  bool read_first = false;
+  bool written_elsewhere = false;
+  std::vector<int> ops;
+  size_t nbytes = 0;
+};
+
+class Ancestors {
+ public:
+  explicit Ancestors(const NetDef& net)
+      : words_((net.op_size() + 63) / 64),
+        bits_(net.op_size() * words_, 0) {
+    // the dependencies of the dag net: read after write, write after read
+    // and write after write
+    std::unordered_map<string, int> last_writer;
+    std::unordered_map<string, std::vector<int>> readers;
+    for (int i = 0; i < net.op_size(); ++i) {
+      const auto& op = net.op(i);
+      std::vector<int> parents;
+      for (const auto& blob : op.input()) {
+        auto it = last_writer.find(blob);
+        if (it != last_writer.end()) {
+          parents.push_back(it->second);
+        }
+      }
+      for (const auto& blob : op.output()) {
+        auto it = last_writer.find(blob);
+        if (it != last_writer.end()) {
+          parents.push_back(it->second);
+        }
+        for (int reader : readers[blob]) {
+          if (reader != i) {
+            parents.push_back(reader);
+          }
+        }
+      }
+      for (int parent : parents) {
+        uint64_t* row = &bits_[i * words_];
+        const uint64_t* parent_row = &bits_[parent * words_];
+        for (int w = 0; w < words_; ++w) {
+          row[w] |= parent_row[w];
+        }
+        row[parent / 64] |= uint64_t(1) << (parent % 64);
+      }
+      for (const auto& blob : op.input()) {
+        readers[blob].push_back(i);
+      }
+      for (const auto& blob : op.output()) {
+        last_writer[blob] = i;
+        readers[blob].clear();
+      }
+    }
+  }
+
+  // whether op a runs before op b in every schedule
+  bool Before(const int a, const int b) const {
+    return (bits_[b * words_ + a / 64] >> (a % 64)) & 1;
+  }
+
+ private:
+  const int words_;
+  std::vector<uint64_t> bits_;
+};
+
+} // namespace
+
+MemoryPlan plan_activation_memory(
+    const NetDef& net,
+    const TensorShapes& shapes,
+    const DeviceOption& device,
+    const std::unordered_set<string>& dont_share_blob_names,
+    const size_t alignment) {
+  CAFFE_ENFORCE_GT(alignment, 0);
+  std::unordered_set<string> excluded(
+      dont_share_blob_names.begin(), dont_share_blob_names.end());
+  excluded.insert(net.external_input().begin(), net.external_input().end());
+  excluded.insert(net.external_output().begin(), net.external_output().end());
+
+  std::unordered_map<string, BlobInfo> infos;
+  std::vector<string> order;
+  std::unordered_set<string> read;
+  for (int i = 0; i < net.op_size(); ++i) {
+    const auto& op = net.op(i);
+    // Free drops the memory of its blobs, so an arena cannot back them
+    const bool aliasing =
+        AliasingOps().count(op.type()) > 0 || op.type() == "Free";
+    const bool on_device = SameDevice(
+        op.has_device_option() ? op.device_option() : net.device_option(),
+        device);
+    for (const auto& blob : op.input()) {
+      read.insert(blob);
+      if (aliasing) {
+        excluded.insert(blob);
+      }
+      auto& info = infos[blob];
+      if (info.first_write < 0) {
+        info.read_first = true;
+      }
+      if (info.ops.empty() || info.ops.back() != i) {
+        info.ops.push_back(i);
+      }
+    }
+    for (const auto& blob : op.output()) {
+      if (aliasing) {
+        excluded.insert(blob);
+      }
+      auto& info = infos[blob];
+      if (info.first_write < 0) {
+        info.first_write = i;
+        order.push_back(blob);
+      }
+      info.written_elsewhere |= !on_device;
+      if (info.ops.empty() || info.ops.back() != i) {
+        info.ops.push_back(i);
+      }
+    }
+  }
+
+  std::unordered_map<string, size_t> sizes;
+  for (const auto& shape : shapes.shapes()) {
+    if (shape.unknown_shape() || shape.data_type() == TensorProto::STRING ||
+        shape.data_type() == TensorProto::UNDEFINED) {
+      continue;
+    }
+    size_t nbytes = DataTypeToTypeMeta(shape.data_type()).itemsize();
+    for (const auto d : shape.dims()) {
+      nbytes *= d;
+    }
+    sizes[shape.name()] = (nbytes + alignment - 1) / alignment * alignment;
+  }
+
+  MemoryPlan plan;
+  std::vector<string> blobs;
+  for (const auto& blob : order) {
+    auto& info = infos[blob];
+    auto size = sizes.find(blob);
+    if (info.read_first || info.written_elsewhere || !read.count(blob) ||
+        excluded.count(blob) || size == sizes.end() || size->second == 0) {
+      continue;
+    }
+    info.nbytes = size->second;
+    info.first_op = info.ops.front();
+    info.last_op = info.ops.back();
+    plan.total_nbytes += info.nbytes;
+    blobs.push_back(blob);
+  }
+  if (blobs.empty()) {
+    return plan;
+  }
+
+  // lower bound: the blobs live at once in the op order
+  std::vector<std::pair<int, long long>> events;
+  for (const auto& blob : blobs) {
+    const auto& info = infos[blob];
+    events.emplace_back(info.first_op, info.nbytes);
+    events.emplace_back(info.last_op + 1, -static_cast<long long>(info.nbytes));
+  }
+  std::sort(events.begin(), events.end());
+  long long live = 0;
+  for (const auto& event : events) {
+    live += event.second;
+    plan.live_nbytes = std::max(plan.live_nbytes, static_cast<size_t>(live));
+  }
+
+  const Ancestors ancestors(net);
+  // whether every op of a runs before b is first written
+  auto before = [&](const BlobInfo& a, const BlobInfo& b) {
+    for (int op : a.ops) {
+      if (!ancestors.Before(op, b.first_write)) {
+        return false;
+      }
+    }
+    return true;
+  };
+
+  std::stable_sort(
+      blobs.begin(), blobs.end(), [&](const string& a, const string& b) {
+        return infos[a].nbytes > infos[b].nbytes;
+      });
+  std::vector<const BlobInfo*> placed;
+  for (const auto& blob : blobs) {
+    const auto& info = infos[blob];
+    std::vector<std::pair<size_t, size_t>> taken;
+    for (int i = 0; i < placed.size(); ++i) {
+      if (!before(*placed[i], info) && !before(info, *placed[i])) {
+        const auto& other = plan.placements[i];
+        taken.emplace_back(other.offset, other.offset + other.nbytes);
+      }
+    }
+    std::sort(taken.begin(), taken.end());
+    size_t offset = 0;
+    for (const auto& range : taken) {
+      if (range.first >= offset + info.nbytes) {
+        break;
+      }
+      offset = std::max(offset, range.second);
+    }
+    plan.placements.push_back({blob, offset, info.nbytes});
+    plan.arena_nbytes = std::max(plan.arena_nbytes, offset + info.nbytes);
+    placed.push_back(&info);
+  }
+  return plan;
+}
+
+} // memonger
+} // caffe2
@@ -0,0 +1,52 @@
+#ifndef CAFFE2_CORE_MEMORY_PLANNER_H_
+#define CAFFE2_CORE_MEMORY_PLANNER_H_
+
+#include <unordered_set>
+
+#include "caffe2/core/common.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+namespace memonger {
+
+struct BlobPlacement {
+  string blob;
+  size_t offset;
+  size_t nbytes;
+};
+
+struct MemoryPlan {
+  std::vector<BlobPlacement> placements;
+  // bytes of the arena, i.e. the planned peak
+  size_t arena_nbytes = 0;
+  // bytes of the planned blobs without any sharing
+  size_t total_nbytes = 0;
+  // the most bytes of planned blobs live at once in the op order, a lower
+  // bound of arena_nbytes
+  size_t live_nbytes = 0;
+};
+
+// Plans the blobs that the ops of net on device write into offsets of one
+// arena, from their sizes in shapes (the output of InferShapesAndTypes).
+//
+// Two blobs only overlap if every op that touches one of them runs before
+// the first op that writes the other in the dependency graph of the dag
+// net, so the plan holds for any schedule of the net. The blobs are placed
+// largest first at the lowest offset free of the blobs they conflict with.
+//
+// Blobs of unknown shape, external inputs and outputs, blobs that no op
+// reads (the net outputs that callers fetch), blobs read before they are
+// written, the blobs of ops that alias their inputs and outputs and the
+// blobs of Free ops (e.g. the recomputed activations) are not planned, nor
+// are the ones in dont_share_blob_names.
+MemoryPlan plan_activation_memory(
+    const NetDef& net,
+    const TensorShapes& shapes,
+    const DeviceOption& device,
+    const std::unordered_set<string>& dont_share_blob_names,
+    const size_t alignment = 256);
+
+} // memonger
+} // caffe2
+
+#endif // CAFFE2_CORE_MEMORY_PLANNER_H_
@@ -0,0 +1,148 @@
+#include <algorithm>
+
+#include "caffe2/core/memory_planner.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+void AddOp(
+    NetDef* net,
+    const std::vector<string>& inputs,
+    const std::vector<string>& outputs,
+    const int gpu_id = 0) {
+  auto* op = net->add_op();
+  op->set_type("Relu");
+  for (const auto& input : inputs) {
+    op->add_input(input);
+  }
+  for (const auto& output : outputs) {
+    op->add_output(output);
+  }
+  op->mutable_device_option()->set_device_type(CUDA);
+  op->mutable_device_option()->set_cuda_gpu_id(gpu_id);
+}
+
+void AddShape(
+    TensorShapes* shapes,
+    const string& name,
+    const int size,
+    const TensorProto::DataType type = TensorProto::FLOAT) {
+  auto* shape = shapes->add_shapes();
+  shape->set_name(name);
+  shape->add_dims(size);
+  shape->set_data_type(type);
+}
+
+DeviceOption Gpu(const int gpu_id) {
+  DeviceOption device;
+  device.set_device_type(CUDA);
+  device.set_cuda_gpu_id(gpu_id);
+  return device;
+}
+
+const memonger::BlobPlacement* Find(
+    const memonger::MemoryPlan& plan,
+    const string& blob) {
+  for (const auto& placement : plan.placements) {
+    if (placement.blob == blob) {
+      return &placement;
+    }
+  }
+  return nullptr;
+}
+
+bool Overlap(const memonger::MemoryPlan& plan, const string& a, const string& b) {
+  const auto* pa = Find(plan, a);
+  const auto* pb = Find(plan, b);
+  return pa->offset < pb->offset + pb->nbytes &&
+      pb->offset < pa->offset + pa->nbytes;
+}
+
+} // namespace
+
+TEST(MemoryPlannerTest, SharesAlongAChain) {
+  NetDef net;
+  net.add_external_input("x");
+  AddOp(&net, {"x"}, {"a"});
+  AddOp(&net, {"a"}, {"b"});
+  AddOp(&net, {"b"}, {"c"});
+  AddOp(&net, {"c"}, {"y"});
+  TensorShapes shapes;
+  AddShape(&shapes, "a", 1000);
+  AddShape(&shapes, "b", 100);
+  AddShape(&shapes, "c", 1000);
+  AddShape(&shapes, "y", 10);
+
+  const auto plan = memonger::plan_activation_memory(net, shapes, Gpu(0), {});
+  // y is never read, so it is an output and is not planned
+  ASSERT_EQ(plan.placements.size(), 3);
+  EXPECT_EQ(Find(plan, "y"), nullptr);
+  EXPECT_TRUE(Overlap(plan, "a", "c"));
+  EXPECT_FALSE(Overlap(plan, "a", "b"));
+  EXPECT_FALSE(Overlap(plan, "b", "c"));
+  // 4000 and 400 bytes, rounded up to 256
+  EXPECT_EQ(plan.arena_nbytes, 4096 + 512);
+  EXPECT_EQ(plan.total_nbytes, 2 * 4096 + 512);
+  EXPECT_EQ(plan.live_nbytes, 4096 + 512);
+}
+
+TEST(MemoryPlannerTest, KeepsParallelBranchesApart) {
+  // y dies before z is born in the op order, but the two branches of x can
+  // run at the same time in the dag net
+  NetDef net;
+  net.add_external_input("x");
+  AddOp(&net, {"x"}, {"y"});
+  AddOp(&net, {"y"}, {"y2"});
+  AddOp(&net, {"x"}, {"z"});
+  AddOp(&net, {"z", "y2"}, {"w"});
+  AddOp(&net, {"w"}, {"out"});
+  TensorShapes shapes;
+  for (const auto& blob : {"y", "y2", "z", "w", "out"}) {
+    AddShape(&shapes, blob, 64);
+  }
+
+  const auto plan = memonger::plan_activation_memory(net, shapes, Gpu(0), {});
+  ASSERT_EQ(plan.placements.size(), 4);
+  EXPECT_FALSE(Overlap(plan, "y", "z"));
+  EXPECT_FALSE(Overlap(plan, "y2", "z"));
+  EXPECT_FALSE(Overlap(plan, "y", "y2"));
+  // w comes after all of them
+  EXPECT_TRUE(Overlap(plan, "w", "y"));
+  // y2, z and w are live at the last op
+  EXPECT_EQ(plan.arena_nbytes, 3 * 256);
+  EXPECT_EQ(plan.live_nbytes, 3 * 256);
+}
+
+TEST(MemoryPlannerTest, SkipsBlobsItCannotPlan) {
+  NetDef net;
+  net.add_external_input("x");
+  net.add_external_output("kept");
+  AddOp(&net, {"x"}, {"kept"});
+  AddOp(&net, {"kept"}, {"fetched"});
+  AddOp(&net, {"fetched", "state"}, {"state"});
+  AddOp(&net, {"state"}, {"unknown"});
+  AddOp(&net, {"unknown"}, {"other_gpu"}, 1);
+  AddOp(&net, {"other_gpu", "names"}, {"planned"});
+  AddOp(&net, {"x"}, {"names"});
+  AddOp(&net, {"planned"}, {"out"});
+  TensorShapes shapes;
+  for (const auto& blob :
+       {"kept", "fetched", "state", "other_gpu", "planned", "out"}) {
+    AddShape(&shapes, blob, 64);
+  }
+  AddShape(&shapes, "names", 64, TensorProto::STRING);
+
+  const auto plan =
+      memonger::plan_activation_memory(net, shapes, Gpu(0), {"fetched"});
+  ASSERT_EQ(plan.placements.size(), 1);
+  EXPECT_EQ(plan.placements[0].blob, "planned");
+  EXPECT_EQ(plan.arena_nbytes, 256);
+
+  const auto other = memonger::plan_activation_memory(net, shapes, Gpu(1), {});
+  ASSERT_EQ(other.placements.size(), 1);
+  EXPECT_EQ(other.placements[0].blob, "other_gpu");
+}
+
+} // namespace caffe2
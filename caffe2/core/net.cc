@@ -1,7 +1,10 @@
 #include "caffe2/core/net.h"
 #include "caffe2/core/net_simple.h"
 
+#include <exception>
+#include <map>
 #include <set>
+#include <thread> // NOLINT
 #include <unordered_map>
 #include <unordered_set>
 
@@ -10,6 +13,11 @@
 #include "caffe2/proto/caffe2.pb.h"
 #include "caffe2/utils/proto_utils.h"
 
+CAFFE2_DEFINE_bool(
+    caffe2_net_parallel_op_creation,
+    false,
+    "Create the operators of a net with a thread per device.");
+
 namespace caffe2 {
 
 CAFFE_DEFINE_REGISTRY(
@@ -100,6 +108,99 @@ void AddGlobalNetObserverCreator(NetObserverCreator creator) {
   VLOG(1) << "Have set a custom GlobalNetObserverCreator";
 }
 
+namespace {
+
+unique_ptr<OperatorBase> CreateNetOperator(
+    const std::shared_ptr<const NetDef>& net_def,
+    const int idx,
+    Workspace* ws) {
+  const OperatorDef& op_def = net_def->op(idx);
+  VLOG(1) << "Creating operator #" << idx << ": " << op_def.name() << ": "
+          << op_def.type();
+  if (!op_def.has_device_option() && net_def->has_device_option()) {
+    // In the case that the operator def does not specify a device option but
+    // the net def has a default option, we copy the device option over to the
+    // operator def.
+    OperatorDef temp_def(op_def);
+    temp_def.mutable_device_option()->CopyFrom(net_def->device_option());
+    return CreateOperator(temp_def, ws, idx);
+  }
+  auto op = CreateOperator(op_def, ws, idx);
+  op->set_debug_def(
+      std::shared_ptr<const OperatorDef>{net_def, &(net_def->op(idx))});
+  return op;
+}
+
+} // namespace
+
+std::vector<std::unique_ptr<OperatorBase>> CreateNetOperators(
+    const std::shared_ptr<const NetDef>& net_def,
+    Workspace* ws) {
+  std::vector<std::unique_ptr<OperatorBase>> ops(net_def->op_size());
+  // the nets of inputs of changing shapes pick a growth policy for the
+  // tensors of their ops
+  TensorGrowthPolicy growth;
+  growth.factor = ArgumentHelper::GetSingleArgument<NetDef, float>(
+      *net_def, "tensor_growth_factor", 0.f);
+  const auto created = [&ops, &growth](const int idx) {
+    if (growth.enabled()) {
+      ops[idx]->set_tensor_growth(growth);
+    }
+  };
+  // the ops of a device, by (device type, gpu id)
+  std::map<std::pair<int, int>, std::vector<int>> devices;
+  for (int idx = 0; idx < net_def->op_size(); ++idx) {
+    const auto& op_def = net_def->op(idx);
+    const auto& option = op_def.has_device_option() ? op_def.device_option()
+                                                    : net_def->device_option();
+    devices[{option.device_type(),
+             option.device_type() == CUDA ? option.cuda_gpu_id() : 0}]
+        .push_back(idx);
+  }
+  if (!FLAGS_caffe2_net_parallel_op_creation || devices.size() < 2) {
+    for (int idx = 0; idx < net_def->op_size(); ++idx) {
+      ops[idx] = CreateNetOperator(net_def, idx, ws);
+      created(idx);
+    }
+    return ops;
+  }
+  // the outputs first, so that the threads mostly look blobs up
+  for (const auto& op_def : net_def->op()) {
+    for (const auto& output : op_def.output()) {
+      ws->CreateBlob(output);
+    }
+  }
+  Timer timer;
+  std::vector<std::exception_ptr> errors(devices.size());
+  std::vector<std::thread> threads;
+  for (const auto& device : devices) {
+    auto* error = &errors[threads.size()];
+    const auto* indices = &device.second;
+    threads.emplace_back([&net_def, ws, &ops, &created, error, indices]() {
+      try {
+        for (const int idx : *indices) {
+          ops[idx] = CreateNetOperator(net_def, idx, ws);
+          created(idx);
+        }
+      } catch (...) {
+        *error = std::current_exception();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (const auto& error : errors) {
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+  LOG(INFO) << "Created the " << ops.size() << " operators of net "
+          << net_def->name() << " on " << devices.size() << " devices in "
+          << timer.MilliSeconds() << " ms";
+  return ops;
+}
+
 unique_ptr<NetBase> CreateNet(const NetDef& net_def, Workspace* ws) {
   std::shared_ptr<NetDef> tmp_net_def(new NetDef(net_def));
   return CreateNet(tmp_net_def, ws);
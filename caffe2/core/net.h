@@ -145,6 +145,18 @@ unique_ptr<NetBase> CreateNet(
     const std::shared_ptr<const NetDef>& net_def,
     Workspace* ws);
 
+/**
+ * @brief Creates the operators of a net, in the order of net_def, with the
+ * device option of net_def for the ops without one.
+ *
+ * With FLAGS_caffe2_net_parallel_op_creation, the ops of every device are
+ * created by a thread of that device, which is what makes up most of the
+ * construction of the multi-GPU nets (e.g. the cudnn ops).
+ */
+std::vector<std::unique_ptr<OperatorBase>> CreateNetOperators(
+    const std::shared_ptr<const NetDef>& net_def,
+    Workspace* ws);
+
 void AddGlobalNetObserverCreator(NetObserverCreator creator);
 
 } // namespace caffe2
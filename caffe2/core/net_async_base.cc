@@ -1,6 +1,7 @@
 #include "caffe2/core/net_async_polling.h"
 
 #include "caffe2/core/operator.h"
+#include "caffe2/core/static_tracepoint.h"
 #include "caffe2/core/timer.h"
 
 CAFFE2_DEFINE_int(
@@ -35,6 +36,13 @@ CAFFE2_DEFINE_bool(
     true,
     "Select next non-busy stream");
 
+CAFFE2_DEFINE_int(
+    caffe2_net_async_stream_pool_size,
+    0,
+    "If positive, assign the chains of the net to this many streams per GPU "
+    "once (see dag_utils::assignStreams) instead of picking a stream for "
+    "every run");
+
 namespace caffe2 {
 
 thread_local std::vector<int> AsyncNetBase::stream_counters_;
@@ -44,6 +52,9 @@ AsyncNetBase::AsyncNetBase(
     Workspace* ws)
     : NetBase(net_def, ws) {
   operator_nodes_ = dag_utils::prepareOperatorNodes(net_def, ws);
+  stream_offset_ = ArgumentHelper::GetSingleArgument<NetDef, int>(
+      *net_def, "stream_offset", 0);
+  CAFFE_ENFORCE_GE(stream_offset_, 0);
   operators_.reserve(operator_nodes_.size());
   for (const auto& node : operator_nodes_) {
     operators_.push_back(node.operator_.get());
@@ -62,6 +73,16 @@ AsyncNetBase::AsyncNetBase(
     events_.push_back(&op->event());
   }
 
+  if (FLAGS_caffe2_net_async_stream_pool_size > 0) {
+    std::vector<DeviceOption> chain_devices;
+    chain_devices.reserve(chains_.size());
+    for (const auto* event : events_) {
+      chain_devices.push_back(event->GetDeviceOption());
+    }
+    chain_streams_ = dag_utils::assignStreams(
+        chain_nodes_, chain_devices, FLAGS_caffe2_net_async_stream_pool_size);
+  }
+
   gpu_pools_.resize(FLAGS_caffe2_net_async_max_gpus);
   cpu_pools_.resize(FLAGS_caffe2_net_async_max_numa_nodes);
   DeviceOption cpu_option;
@@ -111,6 +132,9 @@ std::shared_ptr<TaskThreadPool> AsyncNetBase::pool(
 }
 
 int AsyncNetBase::stream(int task_id) {
+  if (!chain_streams_.empty()) {
+    return stream_offset_ + chain_streams_[task_id];
+  }
   const auto& device_option = event(task_id).GetDeviceOption();
   int stream_id = 0;
   if (device_option.device_type() == CUDA) {
@@ -120,7 +144,7 @@ int AsyncNetBase::stream(int task_id) {
       stream_counters_.resize(gpu_id + 1, 0);
     }
     do {
-      stream_id = stream_counters_[gpu_id]++;
+      stream_id = stream_offset_ + stream_counters_[gpu_id]++;
       stream_counters_[gpu_id] %= FLAGS_caffe2_streams_per_gpu;
     } while (!isStreamFree(task_id, stream_id) &&
              FLAGS_caffe2_net_async_check_stream_status);
@@ -201,6 +225,13 @@ void AsyncNetBase::run(int task_id, int stream_id) {
   std::string err_msg;
   for (auto& op_id : chains_[task_id]) {
     auto& op = operators_[op_id];
+#ifdef CAFFE2_ENABLE_SDT
+    const auto& op_name = op->debug_def().name().c_str();
+    const auto& op_type = op->debug_def().type().c_str();
+    auto* op_ptr = op;
+    const auto& net_name = name_.c_str();
+    CAFFE_SDT(operator_start, net_name, op_name, op_type, op_ptr);
+#endif
     try {
       CAFFE_ENFORCE(op->RunAsync(stream_id), "Failed to execute an op");
     } catch (const std::exception& e) {
@@ -212,6 +243,9 @@ void AsyncNetBase::run(int task_id, int stream_id) {
           "Failed to execute task: unknown error,  op " +
           (op->has_debug_def() ? op->type() : " unknown"));
     }
+#ifdef CAFFE2_ENABLE_SDT
+    CAFFE_SDT(operator_done, net_name, op_name, op_type, op_ptr);
+#endif
   }
 
   if (FLAGS_caffe2_net_async_finish_chain) {
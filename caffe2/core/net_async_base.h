@@ -62,6 +62,10 @@ class AsyncNetBase : public NetBase {
   std::vector<std::shared_ptr<TaskThreadPool>> cpu_pools_;
   std::vector<std::shared_ptr<TaskThreadPool>> gpu_pools_;
   static thread_local std::vector<int> stream_counters_;
+  // the streams of the chains, if assigned once for the net
+  std::vector<int> chain_streams_;
+  // added to the stream ids of the net, see DAGNetBase::stream_offset_
+  int stream_offset_;
 
   DISABLE_COPY_AND_ASSIGN(AsyncNetBase);
 
@@ -0,0 +1,272 @@
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "caffe2/core/net_simple.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/static_tracepoint.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+namespace {
+
+// The device type and gpu of an op; the async ops of one device key run in
+// order on the stream 0 of the device.
+using DeviceKey = std::pair<int, int>;
+
+DeviceKey KeyOf(const OperatorBase& op) {
+  const auto& option = op.device_option();
+  return DeviceKey(
+      option.device_type(),
+      option.device_type() == CUDA ? option.cuda_gpu_id() : 0);
+}
+
+// A blob that an op reads or writes after an earlier op wrote it (a read
+// after write, or a write after write), or that it writes after an earlier
+// op read it (a write after read).
+struct Dependency {
+  int parent;
+  const Blob* blob;
+  bool read_after_write;
+};
+
+struct CompiledStep {
+  enum Mode {
+    // runs without a sync, ordered by the stream of its device
+    kUnsynced,
+    // records its event, which a later op or the end of the run waits for
+    kRecord,
+    // runs as in a SimpleNet, for an op with a disabled event
+    kSync,
+  };
+
+  OperatorBase* op;
+  Mode mode = kUnsynced;
+  std::vector<const Event*> waits;
+};
+
+} // namespace
+
+// A SimpleNet that runs its ops as a flat loop over a plan: the blobs that
+// every op reads and writes are taken from its Blob* pointers at the
+// construction, and after the first run, which runs as in a SimpleNet, the
+// plan keeps a sync only where an op depends on the device work of an async
+// op, i.e. of a CUDA op of another gpu, of a CUDA op for a CPU op, or of a
+// CUDA op writing a CPU tensor. Then the ops of a gpu queue on its stream
+// without the sync of Operator::Run after each, and the parents with a
+// dependent op record an event for it; the run ends by waiting for the last
+// async op of every device. The ops run in the order of the net, in one
+// thread; with an observer on the net or an op, the net runs as a SimpleNet.
+class CompiledNet : public SimpleNet {
+ public:
+  CompiledNet(const std::shared_ptr<const NetDef>& net_def, Workspace* ws);
+
+ protected:
+  bool Run() override;
+
+ private:
+  bool HasObservers();
+  void Plan();
+  bool FinishDevices();
+
+  std::vector<std::vector<Dependency>> dependencies_;
+  std::vector<CompiledStep> steps_;
+  // the last recorded op of every device
+  std::vector<OperatorBase*> finish_;
+  bool planned_ = false;
+
+  DISABLE_COPY_AND_ASSIGN(CompiledNet);
+};
+
+CompiledNet::CompiledNet(
+    const std::shared_ptr<const NetDef>& net_def,
+    Workspace* ws)
+    : SimpleNet(net_def, ws) {
+  const int num_ops = operators_.size();
+  dependencies_.resize(num_ops);
+  std::unordered_map<const Blob*, int> last_writer;
+  // the ops that read a blob since its last write
+  std::unordered_map<const Blob*, std::vector<int>> readers;
+  for (int idx = 0; idx < num_ops; ++idx) {
+    auto* op = operators_[idx].get();
+    auto& dependencies = dependencies_[idx];
+    for (const Blob* blob : op->Inputs()) {
+      auto it = last_writer.find(blob);
+      if (it != last_writer.end()) {
+        dependencies.push_back(Dependency{it->second, blob, true});
+      }
+    }
+    for (const Blob* blob : op->Outputs()) {
+      auto it = last_writer.find(blob);
+      if (it != last_writer.end() && it->second != idx) {
+        dependencies.push_back(Dependency{it->second, blob, false});
+      }
+      for (int reader : readers[blob]) {
+        if (reader != idx) {
+          dependencies.push_back(Dependency{reader, blob, false});
+        }
+      }
+    }
+    for (const Blob* blob : op->Inputs()) {
+      readers[blob].push_back(idx);
+    }
+    for (const Blob* blob : op->Outputs()) {
+      last_writer[blob] = idx;
+      readers[blob].clear();
+    }
+  }
+}
+
+bool CompiledNet::HasObservers() {
+  if (NumObservers() > 0) {
+    return true;
+  }
+  for (const auto& op : operators_) {
+    if (op->NumObservers() > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void CompiledNet::Plan() {
+  const int num_ops = operators_.size();
+  std::vector<bool> async(num_ops);
+  std::vector<bool> record(num_ops, false);
+  std::vector<std::vector<int>> waits(num_ops);
+  for (int idx = 0; idx < num_ops; ++idx) {
+    async[idx] = operators_[idx]->HasAsyncPart();
+  }
+  for (int idx = 0; idx < num_ops; ++idx) {
+    const auto* op = operators_[idx].get();
+    std::unordered_set<int> parents;
+    for (const auto& dependency : dependencies_[idx]) {
+      const int parent = dependency.parent;
+      if (!async[parent] || parents.count(parent)) {
+        continue;
+      }
+      // the blob types are the ones of the first run
+      const bool host_blob = dependency.read_after_write &&
+          dependency.blob->IsType<TensorCPU>();
+      if (!async[idx] || KeyOf(*operators_[parent]) != KeyOf(*op) ||
+          host_blob) {
+        parents.insert(parent);
+        waits[idx].push_back(parent);
+        record[parent] = true;
+      }
+    }
+  }
+  std::map<DeviceKey, int> last_async;
+  for (int idx = 0; idx < num_ops; ++idx) {
+    if (async[idx]) {
+      const auto key = KeyOf(*operators_[idx]);
+      last_async[key] = idx;
+      // the CPU ops with an async part do not keep an order between them
+      if (key.first != CUDA) {
+        record[idx] = true;
+      }
+    }
+  }
+  for (const auto& it : last_async) {
+    record[it.second] = true;
+  }
+
+  steps_.resize(num_ops);
+  int num_synced = 0;
+  for (int idx = 0; idx < num_ops; ++idx) {
+    auto& step = steps_[idx];
+    step.op = operators_[idx].get();
+    if (record[idx]) {
+      if (step.op->IsEventDisabled()) {
+        step.mode = CompiledStep::kSync;
+      } else {
+        step.mode = CompiledStep::kRecord;
+        if (async[idx] && KeyOf(*step.op).first != CUDA) {
+          finish_.push_back(step.op);
+        }
+      }
+      ++num_synced;
+    }
+    for (int parent : waits[idx]) {
+      // a synced parent is done once it returns
+      if (steps_[parent].mode == CompiledStep::kRecord) {
+        step.waits.push_back(&operators_[parent]->event());
+      }
+    }
+  }
+  for (const auto& it : last_async) {
+    if (steps_[it.second].mode == CompiledStep::kRecord &&
+        it.first.first == CUDA) {
+      finish_.push_back(steps_[it.second].op);
+    }
+  }
+  planned_ = true;
+  VLOG(1) << "Net " << name_ << " runs " << num_ops << " ops with "
+          << num_synced << " events or syncs";
+}
+
+bool CompiledNet::Run() {
+  if (!planned_ || HasObservers()) {
+    if (!SimpleNet::Run()) {
+      return false;
+    }
+    if (!planned_) {
+      Plan();
+    }
+    return true;
+  }
+  for (auto& step : steps_) {
+    auto* op = step.op;
+    if (!step.waits.empty()) {
+      op->WaitEvents(step.waits, 0);
+    }
+#ifdef CAFFE2_ENABLE_SDT
+    const auto& op_name = op->debug_def().name().c_str();
+    const auto& op_type = op->debug_def().type().c_str();
+    const auto& net_name = name_.c_str();
+    CAFFE_SDT(operator_start, net_name, op_name, op_type, op);
+#endif
+    bool res;
+    switch (step.mode) {
+      case CompiledStep::kRecord:
+        op->ResetEvent();
+        res = op->RunAsync();
+        break;
+      case CompiledStep::kSync:
+        res = op->Run();
+        break;
+      default:
+        res = op->RunUnsynced();
+    }
+#ifdef CAFFE2_ENABLE_SDT
+    CAFFE_SDT(operator_done, net_name, op_name, op_type, op);
+#endif
+    if (!res) {
+      LOG(ERROR) << "Operator failed: " << ProtoDebugString(op->debug_def());
+      return false;
+    }
+  }
+  return FinishDevices();
+}
+
+bool CompiledNet::FinishDevices() {
+  bool success = true;
+  for (auto* op : finish_) {
+    op->Finish();
+    const auto& event = op->event();
+    if (event.Query() != EventStatus::EVENT_SUCCESS) {
+      LOG(ERROR) << "Device computation of net " << name_
+                 << " failed: " << event.ErrorMessage();
+      success = false;
+    }
+  }
+  return success;
+}
+
+REGISTER_NET(compiled, CompiledNet);
+
+} // namespace caffe2
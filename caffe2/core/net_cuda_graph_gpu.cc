@@ -0,0 +1,320 @@
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/core/net_simple.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+namespace {
+
+// CUDA ops that must run on the host every iteration, or whose kernels
+// differ between iterations (random fills, NCCL before graph support); they
+// always run eagerly.
+const std::unordered_set<std::string>& UncapturableOps() {
+  static const std::unordered_set<std::string> ops{
+      "CustomizedVideoInput",
+      "DequeueBlobs",
+      "SafeDequeueBlobs",
+      "Dropout",
+      "GaussianFill",
+      "UniformFill",
+      "XavierFill",
+      "MSRAFill",
+      "NCCLAllreduce",
+      "NCCLBroadcast",
+      "NCCLReduce",
+      "NCCLAllGather",
+      "NCCLReduceScatter",
+      "Print",
+      "Python",
+  };
+  return ops;
+}
+
+// The data pointer and dims of every tensor that the ops read or write; the
+// replays of a graph need all of them unchanged.
+using BlobSignature = std::vector<std::pair<const void*, std::vector<TIndex>>>;
+
+// Consecutive CUDA ops of one gpu that are captured into a graph together.
+struct GraphSegment {
+  int begin;
+  int end;
+  int gpu_id;
+  bool capturable = true;
+  // of the last eager run, and of the run that the graph was captured in
+  BlobSignature last;
+  BlobSignature captured;
+#if CUDA_VERSION >= 10000
+  cudaGraph_t graph = nullptr;
+  cudaGraphExec_t exec = nullptr;
+#endif
+};
+
+} // namespace
+
+// A SimpleNet whose runs of consecutive CUDA ops of one gpu are captured into
+// CUDA graphs, once the tensors that they read and write keep their buffers
+// and shapes over a run, and then replayed with a single launch per segment
+// instead of a launch per kernel. The other ops (CPU ops, the ops of
+// UncapturableOps) run as in a SimpleNet, between the segments. When a
+// tensor of a segment is resized or reallocated, e.g. by a new input shape,
+// the segment runs eagerly and is captured again on the next run. A segment
+// with an op reading a CPU tensor, or whose capture fails or allocates
+// memory, always runs eagerly. The op observers only see the eager runs.
+class CUDAGraphNet : public SimpleNet {
+ public:
+  CUDAGraphNet(const std::shared_ptr<const NetDef>& net_def, Workspace* ws);
+
+  ~CUDAGraphNet() override {
+    for (auto& segment : segments_) {
+      ResetGraph(&segment);
+    }
+  }
+
+ protected:
+  bool Run() override;
+
+ private:
+  bool Capturable(const OperatorBase& op) const;
+  bool RunOps(int begin, int end);
+  bool RunSegment(GraphSegment* segment);
+  BlobSignature Signature(const GraphSegment& segment, bool* host_inputs);
+  bool Capture(GraphSegment* segment, const BlobSignature& signature);
+  void Replay(const GraphSegment& segment);
+  void ResetGraph(GraphSegment* segment);
+
+  std::vector<GraphSegment> segments_;
+
+  DISABLE_COPY_AND_ASSIGN(CUDAGraphNet);
+};
+
+CUDAGraphNet::CUDAGraphNet(
+    const std::shared_ptr<const NetDef>& net_def,
+    Workspace* ws)
+    : SimpleNet(net_def, ws) {
+#if CUDA_VERSION >= 10000
+  const int min_ops = ArgumentHelper(*net_def).GetSingleArgument<int>(
+      "cuda_graph_min_ops", 2);
+  const int num_ops = operators_.size();
+  for (int begin = 0; begin < num_ops;) {
+    if (!Capturable(*operators_[begin])) {
+      ++begin;
+      continue;
+    }
+    const int gpu_id = operators_[begin]->device_option().cuda_gpu_id();
+    int end = begin + 1;
+    while (end < num_ops && Capturable(*operators_[end]) &&
+           operators_[end]->device_option().cuda_gpu_id() == gpu_id) {
+      ++end;
+    }
+    if (end - begin >= min_ops) {
+      GraphSegment segment;
+      segment.begin = begin;
+      segment.end = end;
+      segment.gpu_id = gpu_id;
+      segments_.push_back(std::move(segment));
+    }
+    begin = end;
+  }
+  VLOG(1) << "Net " << name_ << " captures " << segments_.size()
+          << " segments of its " << num_ops << " ops into CUDA graphs";
+#else
+  LOG(INFO) << "Net " << name_ << " runs without CUDA graphs, they need "
+            << "CUDA 10";
+#endif
+}
+
+bool CUDAGraphNet::Capturable(const OperatorBase& op) const {
+  return op.device_option().device_type() == CUDA &&
+      !UncapturableOps().count(op.debug_def().type());
+}
+
+BlobSignature CUDAGraphNet::Signature(
+    const GraphSegment& segment,
+    bool* host_inputs) {
+  BlobSignature signature;
+  *host_inputs = false;
+  auto add = [&signature](const Blob* blob) {
+    if (blob->IsType<TensorCUDA>()) {
+      const auto& tensor = blob->Get<TensorCUDA>();
+      signature.emplace_back(tensor.raw_data(), tensor.dims());
+    } else {
+      signature.emplace_back(nullptr, std::vector<TIndex>());
+    }
+  };
+  for (int i = segment.begin; i < segment.end; ++i) {
+    for (const Blob* blob : operators_[i]->Inputs()) {
+      // the values of a CPU input are read when the op is captured
+      *host_inputs = *host_inputs || blob->IsType<TensorCPU>();
+      add(blob);
+    }
+    for (const Blob* blob : operators_[i]->Outputs()) {
+      add(blob);
+    }
+  }
+  return signature;
+}
+
+bool CUDAGraphNet::Run() {
+  StartAllObservers();
+  VLOG(1) << "Running net " << name_;
+  int next = 0;
+  for (auto& segment : segments_) {
+    if (!RunOps(next, segment.begin) || !RunSegment(&segment)) {
+      return false;
+    }
+    next = segment.end;
+  }
+  if (!RunOps(next, operators_.size())) {
+    return false;
+  }
+  StopAllObservers();
+  return true;
+}
+
+bool CUDAGraphNet::RunOps(int begin, int end) {
+  for (int i = begin; i < end; ++i) {
+    auto& op = operators_[i];
+    if (!op->Run()) {
+      LOG(ERROR) << "Operator failed: " << ProtoDebugString(op->debug_def());
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CUDAGraphNet::RunSegment(GraphSegment* segment) {
+  if (!segment->capturable) {
+    return RunOps(segment->begin, segment->end);
+  }
+  bool host_inputs = false;
+  const auto signature = Signature(*segment, &host_inputs);
+  if (host_inputs) {
+    LOG(INFO) << "Net " << name_ << " runs ops " << segment->begin << " to "
+              << segment->end << " without a CUDA graph: an op reads a CPU "
+              << "tensor";
+    segment->capturable = false;
+    return RunOps(segment->begin, segment->end);
+  }
+#if CUDA_VERSION >= 10000
+  if (segment->exec && signature == segment->captured) {
+    Replay(*segment);
+    return true;
+  }
+#endif
+  ResetGraph(segment);
+  if (signature != segment->last) {
+    // the first run or a new shape: the outputs get their buffers
+    const bool result = RunOps(segment->begin, segment->end);
+    segment->last = Signature(*segment, &host_inputs);
+    return result;
+  }
+  if (Capture(segment, signature)) {
+    Replay(*segment);
+    return true;
+  }
+  return RunOps(segment->begin, segment->end);
+}
+
+bool CUDAGraphNet::Capture(
+    GraphSegment* segment,
+    const BlobSignature& signature) {
+#if CUDA_VERSION >= 10000
+  DeviceGuard guard(segment->gpu_id);
+  // the stream that the ops of the thread run on
+  const cudaStream_t stream = CUDAContext::cuda_stream(segment->gpu_id, 0);
+  CUDA_ENFORCE(cudaStreamSynchronize(stream));
+  CUDAContext::SetStreamCapture(true);
+  CUDA_ENFORCE(
+      cudaStreamBeginCapture(stream, cudaStreamCaptureModeThreadLocal));
+  bool captured = true;
+  std::string error;
+  try {
+    for (int i = segment->begin; i < segment->end; ++i) {
+      if (!operators_[i]->Run()) {
+        captured = false;
+        error = "the op " + operators_[i]->debug_def().type() + " failed";
+        break;
+      }
+    }
+  } catch (const std::exception& e) {
+    captured = false;
+    error = e.what();
+  }
+  cudaGraph_t graph = nullptr;
+  const cudaError_t end = cudaStreamEndCapture(stream, &graph);
+  const size_t allocations = CUDAContext::NumCaptureAllocations();
+  CUDAContext::SetStreamCapture(false);
+  // the errors of a failed capture
+  cudaGetLastError();
+  bool host_inputs = false;
+  if (captured && end != cudaSuccess) {
+    captured = false;
+    error = cudaGetErrorString(end);
+  } else if (captured && allocations > 0) {
+    captured = false;
+    error = "the ops allocated memory";
+  } else if (captured && Signature(*segment, &host_inputs) != signature) {
+    captured = false;
+    error = "the ops resized their tensors";
+  }
+  if (captured &&
+      cudaGraphInstantiate(&segment->exec, graph, nullptr, nullptr, 0) !=
+          cudaSuccess) {
+    cudaGetLastError();
+    segment->exec = nullptr;
+    captured = false;
+    error = "the graph cannot be instantiated";
+  }
+  if (!captured) {
+    if (graph) {
+      CUDA_CHECK(cudaGraphDestroy(graph));
+    }
+    LOG(WARNING) << "Net " << name_ << " runs ops " << segment->begin
+                 << " to " << segment->end << " without a CUDA graph, their "
+                 << "capture failed: " << error;
+    segment->capturable = false;
+    return false;
+  }
+  VLOG(1) << "Captured ops " << segment->begin << " to " << segment->end
+          << " of net " << name_ << " into a CUDA graph";
+  segment->graph = graph;
+  segment->captured = signature;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void CUDAGraphNet::Replay(const GraphSegment& segment) {
+#if CUDA_VERSION >= 10000
+  DeviceGuard guard(segment.gpu_id);
+  const cudaStream_t stream = CUDAContext::cuda_stream(segment.gpu_id, 0);
+  CUDA_ENFORCE(cudaGraphLaunch(segment.exec, stream));
+  // as the ops, which finish their device computation
+  CUDA_ENFORCE(cudaStreamSynchronize(stream));
+#endif
+}
+
+void CUDAGraphNet::ResetGraph(GraphSegment* segment) {
+#if CUDA_VERSION >= 10000
+  if (segment->exec) {
+    CUDA_CHECK(cudaGraphExecDestroy(segment->exec));
+    segment->exec = nullptr;
+  }
+  if (segment->graph) {
+    CUDA_CHECK(cudaGraphDestroy(segment->graph));
+    segment->graph = nullptr;
+  }
+#endif
+}
+
+REGISTER_NET(cuda_graph, CUDAGraphNet);
+
+} // namespace caffe2
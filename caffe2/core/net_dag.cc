@@ -32,6 +32,9 @@ DAGNetBase::DAGNetBase(
   VLOG(1) << "Constructing DAGNet " << net_def->name();
 
   operator_nodes_ = dag_utils::prepareOperatorNodes(net_def, ws);
+  stream_offset_ = ArgumentHelper::GetSingleArgument<NetDef, int>(
+      *net_def, "stream_offset", 0);
+  CAFFE_ENFORCE_GE(stream_offset_, 0);
 
   execution_chains_ =
       (FLAGS_caffe2_disable_chaining
@@ -344,7 +347,7 @@ bool DAGNet::RunAt(int chain_id, const std::vector<int>& chain) {
     const auto& net_name = name_.c_str();
     CAFFE_SDT(operator_start, net_name, op_name, op_type, op_ptr);
 #endif
-    const auto success = operator_nodes_[i].operator_->Run();
+    const auto success = operator_nodes_[i].operator_->Run(stream_offset_);
 #ifdef CAFFE2_ENABLE_SDT
     CAFFE_SDT(operator_done, net_name, op_name, op_type, op_ptr);
 #endif
@@ -62,6 +62,10 @@ class DAGNetBase : public NetBase {
   std::vector<std::thread> workers_;
   int num_workers_;
   int remaining_ops_;
+  // the stream ids of the ops are offset by the stream_offset arg of the
+  // net, e.g. to run it on the low priority streams of
+  // --caffe2_cuda_low_priority_stream_base
+  int stream_offset_;
 
   bool success_;
   // Use an atomic to guard caught_exception_ so it is written to only once
@@ -292,22 +292,11 @@ std::vector<OperatorNode> prepareOperatorNodes(
   std::vector<OperatorNode> operator_nodes(net_def->op_size());
   std::map<string, int> blob_creator;
   std::map<string, std::set<int>> blob_readers;
-  bool net_def_has_device_option = net_def->has_device_option();
+  auto ops = CreateNetOperators(net_def, ws);
   // Initialize the operators
   for (int idx = 0; idx < net_def->op_size(); ++idx) {
     const OperatorDef& op_def = net_def->op(idx);
-    VLOG(1) << "Creating operator #" << idx << ": " << op_def.name() << ": "
-            << op_def.type();
-    if (!op_def.has_device_option() && net_def_has_device_option) {
-      OperatorDef temp_def(op_def);
-      temp_def.mutable_device_option()->CopyFrom(net_def->device_option());
-      operator_nodes[idx].operator_ = CreateOperator(temp_def, ws, idx);
-    } else {
-      auto op = CreateOperator(op_def, ws, idx);
-      op->set_debug_def(
-          std::shared_ptr<const OperatorDef>{net_def, &(net_def->op(idx))});
-      operator_nodes[idx].operator_ = std::move(op);
-    }
+    operator_nodes[idx].operator_ = std::move(ops[idx]);
     // Check the inputs, and set up parents if necessary. This addressese the
     // read after write case.
     auto checkInputs =
@@ -425,5 +414,57 @@ std::vector<OpGraphNode> prepareChainGraphNodes(
   return chain_nodes;
 }
 
+std::vector<int> assignStreams(
+    const std::vector<OpGraphNode>& chain_nodes,
+    const std::vector<DeviceOption>& chain_devices,
+    const int num_streams) {
+  CAFFE_ENFORCE_GT(num_streams, 0);
+  CAFFE_ENFORCE_EQ(chain_nodes.size(), chain_devices.size());
+  std::vector<int> streams(chain_nodes.size(), 0);
+  // whether a child already continues on the stream of the chain
+  std::vector<bool> continued(chain_nodes.size(), false);
+  std::unordered_map<int, int> next_stream;
+
+  // in topological order, so that the parents have their streams
+  std::vector<int> num_parents(chain_nodes.size());
+  std::vector<int> frontier;
+  for (int i = 0; i < chain_nodes.size(); ++i) {
+    num_parents[i] = chain_nodes[i].parents_.size();
+    if (num_parents[i] == 0) {
+      frontier.push_back(i);
+    }
+  }
+  for (int k = 0; k < frontier.size(); ++k) {
+    const int chain = frontier[k];
+    const auto& device = chain_devices[chain];
+    if (device.device_type() == CUDA) {
+      const int gpu = device.cuda_gpu_id();
+      int stream = -1;
+      for (const int parent : chain_nodes[chain].parents_) {
+        const auto& parent_device = chain_devices[parent];
+        if (!continued[parent] && parent_device.device_type() == CUDA &&
+            parent_device.cuda_gpu_id() == gpu) {
+          continued[parent] = true;
+          stream = streams[parent];
+          break;
+        }
+      }
+      if (stream < 0) {
+        stream = next_stream[gpu];
+        next_stream[gpu] = (stream + 1) % num_streams;
+      }
+      streams[chain] = stream;
+    }
+    for (const int child : chain_nodes[chain].children_) {
+      if (--num_parents[child] == 0) {
+        frontier.push_back(child);
+      }
+    }
+  }
+  CAFFE_ENFORCE_EQ(
+      frontier.size(), chain_nodes.size(), "The chain graph has a cycle");
+  return streams;
+}
+
 } // namespace dag_utils
 } // namespace caffe2
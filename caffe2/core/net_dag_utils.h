@@ -54,6 +54,16 @@ std::vector<OpGraphNode> prepareChainGraphNodes(
     const std::vector<dag_utils::OperatorNode>& operator_nodes,
     const std::vector<std::vector<int>>& execution_chains);
 
+// Assigns the chains on CUDA devices to num_streams streams per gpu. A chain
+// continues on the stream of a parent chain of its gpu that no sibling
+// continues yet, so the cross stream waits are only where the graph forks
+// and joins; the other chains take the streams of their gpu in turn. The
+// chains on other devices get stream 0.
+std::vector<int> assignStreams(
+    const std::vector<OpGraphNode>& chain_nodes,
+    const std::vector<DeviceOption>& chain_devices,
+    const int num_streams);
+
 } // namespace dag_utils
 } // namespace caffe2
 
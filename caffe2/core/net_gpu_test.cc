@@ -1,5 +1,6 @@
 #include <gtest/gtest.h>
 #include "caffe2/core/common_gpu.h"
+#include "caffe2/core/context_gpu.h"
 #include "caffe2/core/net.h"
 #include "caffe2/core/net_dag.h"
 #include "caffe2/core/operator.h"
@@ -133,4 +134,96 @@ TEST(NetTest, DISABLED_ChainingForDifferentDevices) {
   }
 }
 
+namespace {
+
+void FeedCUDA(Workspace* ws, const std::string& name, int size, float value) {
+  TensorCPU cpu(std::vector<TIndex>{size});
+  for (int i = 0; i < size; ++i) {
+    cpu.mutable_data<float>()[i] = value + i;
+  }
+  ws->CreateBlob(name)->GetMutable<TensorCUDA>()->CopyFrom(cpu);
+}
+
+void ExpectCUDA(Workspace* ws, const std::string& name, int size, float value) {
+  TensorCPU cpu(ws->GetBlob(name)->Get<TensorCUDA>());
+  ASSERT_EQ(cpu.size(), size);
+  for (int i = 0; i < size; ++i) {
+    EXPECT_FLOAT_EQ(cpu.data<float>()[i], (value + i) * 12) << name << i;
+  }
+}
+
+} // namespace
+
+// The two runs of CUDA ops around a CPU op are captured and replayed, and
+// run eagerly again when the input changes shape.
+TEST(NetTest, CUDAGraphNetReplaysSegments) {
+  if (!HasCudaGPU()) {
+    return;
+  }
+  const auto spec = R"DOC(
+        name: "cuda_graph"
+        type: "cuda_graph"
+        external_input: "X"
+        op {
+          input: "X"
+          output: "Y"
+          type: "Scale"
+          arg { name: "scale" f: 2.0 }
+          device_option { device_type: 1 }
+        }
+        op {
+          input: "Y"
+          input: "X"
+          output: "Z"
+          type: "Add"
+          device_option { device_type: 1 }
+        }
+        op {
+          input: "in"
+          output: "hidden"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "Z"
+          output: "W"
+          type: "Scale"
+          arg { name: "scale" f: 2.0 }
+          device_option { device_type: 1 }
+        }
+        op {
+          input: "W"
+          output: "W"
+          type: "Scale"
+          arg { name: "scale" f: 2.0 }
+          device_option { device_type: 1 }
+        }
+)DOC";
+  Workspace ws;
+  ws.CreateBlob("in");
+  NetDef net_def;
+  CAFFE_ENFORCE(TextFormat::ParseFromString(spec, &net_def));
+  FeedCUDA(&ws, "X", 5, 1.f);
+  std::unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  for (int i = 0; i < 4; ++i) {
+    counter.exchange(0);
+    ASSERT_TRUE(net->Run());
+    EXPECT_EQ(counter.load(), 1);
+    ExpectCUDA(&ws, "W", 5, 1.f);
+  }
+  // new values in the same buffer are seen by the replays
+  TensorCPU cpu(std::vector<TIndex>{5});
+  for (int i = 0; i < 5; ++i) {
+    cpu.mutable_data<float>()[i] = 3.f + i;
+  }
+  ws.GetBlob("X")->GetMutable<TensorCUDA>()->CopyFrom(cpu);
+  ASSERT_TRUE(net->Run());
+  ExpectCUDA(&ws, "W", 5, 3.f);
+  // a new shape
+  FeedCUDA(&ws, "X", 7, 2.f);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(net->Run());
+    ExpectCUDA(&ws, "W", 7, 2.f);
+  }
+}
+
 } // namespace caffe2
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include "caffe2/core/net.h"
 #include "caffe2/core/net_dag.h"
+#include "caffe2/core/net_dag_utils.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/core/scope_guard.h"
 
@@ -499,6 +500,36 @@ TEST(NetTest, ChainingForwardBackward) {
   checkNumChainsAndRun(spec, 1);
 }
 
+TEST(NetTest, AssignStreams) {
+  // 0 forks into 1, 2 and 3 on gpu 0, 1 and 2 join into 4, followed by 6;
+  // 3 is followed by the cpu chain 5
+  std::vector<dag_utils::OpGraphNode> nodes(7);
+  auto edge = [&](int parent, int child) {
+    nodes[parent].children_.push_back(child);
+    nodes[child].parents_.push_back(parent);
+  };
+  edge(0, 1);
+  edge(0, 2);
+  edge(0, 3);
+  edge(1, 4);
+  edge(2, 4);
+  edge(3, 5);
+  edge(4, 6);
+  DeviceOption gpu;
+  gpu.set_device_type(CUDA);
+  gpu.set_cuda_gpu_id(0);
+  std::vector<DeviceOption> devices(7, gpu);
+  devices[5].set_device_type(CPU);
+
+  const auto streams = dag_utils::assignStreams(nodes, devices, 3);
+  // the first child and the join continue on the stream of their parent
+  EXPECT_EQ(streams, std::vector<int>({0, 0, 1, 2, 0, 0, 0}));
+  // with fewer streams the siblings take them in turn
+  EXPECT_EQ(
+      dag_utils::assignStreams(nodes, devices, 2),
+      std::vector<int>({0, 0, 1, 0, 0, 0, 0}));
+}
+
 TEST(NetTest, ChainingForHogwildModel) {
   const auto spec = R"DOC(
         name: "example"
@@ -580,4 +611,41 @@ TEST(NetTest, FailingOperator) {
   }
 }
 
+TEST(NetTest, CompiledNetRunsAllOps) {
+  const auto spec = R"DOC(
+        name: "example"
+        type: "compiled"
+        external_input: "in"
+        op {
+          input: "in"
+          output: "hidden"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "hidden"
+          output: "hidden"
+          type: "NetTestDummy"
+        }
+        op {
+          input: "hidden"
+          output: "out"
+          type: "NetTestDummy"
+        }
+)DOC";
+
+  Workspace ws;
+  ws.CreateBlob("in");
+
+  NetDef net_def;
+  CAFFE_ENFORCE(TextFormat::ParseFromString(spec, &net_def));
+  std::unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  ASSERT_TRUE(net.get() != nullptr);
+  // the first run plans the later ones
+  for (int i = 0; i < 3; i++) {
+    counter.exchange(0);
+    ASSERT_TRUE(net.get()->Run());
+    ASSERT_EQ(3, counter.load());
+  }
+}
+
 } // namespace caffe2
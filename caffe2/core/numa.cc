@@ -11,6 +11,10 @@ CAFFE2_DEFINE_bool(
 #define CAFFE2_NUMA_ENABLED
 #endif
 
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+
 namespace caffe2 {
 
 #ifdef CAFFE2_NUMA_ENABLED
@@ -97,6 +101,20 @@ int GetCurrentNUMANode() {
   return numa_node_of_cpu(sched_getcpu());
 }
 
+int GetNUMANodeOfPCIDevice(const std::string& pci_bus_id) {
+  // sysfs names the devices with lower case hex digits
+  std::string name = pci_bus_id;
+  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+  std::ifstream numa_node_file(
+      "/sys/bus/pci/devices/" + name + "/numa_node");
+  int numa_node = -1;
+  if (!(numa_node_file >> numa_node)) {
+    VLOG(1) << "Unable to read the NUMA node of PCI device " << pci_bus_id;
+    return -1;
+  }
+  return numa_node;
+}
+
 #else // CAFFE2_NUMA_ENABLED
 
 bool IsNUMAEnabled() {
@@ -130,6 +148,11 @@ int GetCurrentNUMANode() {
   return -1;
 }
 
+int GetNUMANodeOfPCIDevice(const std::string& pci_bus_id) {
+  VLOG(1) << "NUMA is not enabled";
+  return -1;
+}
+
 #endif // CAFFE2_NUMA_ENABLED
 
 } // namespace caffe2
@@ -19,6 +19,10 @@ void NUMAMove(void* ptr, size_t size, int numa_node_id);
 
 int GetCurrentNUMANode();
 
+// NUMA node of a PCI device given its bus id (e.g. "0000:3b:00.0"),
+// -1 if it is unknown.
+int GetNUMANodeOfPCIDevice(const std::string& pci_bus_id);
+
 } // namespace caffe2
 
 #endif // CAFFE2_CORE_NUMA_H_
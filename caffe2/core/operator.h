@@ -159,6 +159,14 @@ class OperatorBase : public Observable<OperatorBase> {
     return Run(stream_id);
   }
 
+  // RunUnsynced runs the computation like Run, but without the op observers
+  // and without waiting for the device to finish it: the caller orders it
+  // with the later ops, e.g. by the stream of the device or by an event, see
+  // CompiledNet. Falls back to Run.
+  virtual bool RunUnsynced(int stream_id = 0) {
+    return Run(stream_id);
+  }
+
   virtual void AddRelatedBlobInfo(EnforceNotMet* err) {
     if (!has_debug_def()) {
       return;
@@ -267,6 +275,15 @@ class OperatorBase : public Observable<OperatorBase> {
     return engine_;
   }
 
+  // how the tensors that the op writes grow, from its net
+  void set_tensor_growth(const TensorGrowthPolicy& policy) {
+    tensor_growth_ = policy;
+  }
+
+  const TensorGrowthPolicy& tensor_growth() const {
+    return tensor_growth_;
+  }
+
  public:
   static constexpr int kNoNetPositionSet = -1;
 
@@ -279,6 +296,7 @@ class OperatorBase : public Observable<OperatorBase> {
   vector<Blob*> outputs_;
 
   int net_position_{kNoNetPositionSet};
+  TensorGrowthPolicy tensor_growth_;
 
  protected:
   virtual void RecordEvent(const char* err_msg = nullptr) {
@@ -366,6 +384,7 @@ class Operator : public OperatorBase {
       StartAllObservers();
 
       context_.SwitchToDevice(stream_id);
+      TensorGrowthGuard growth(tensor_growth());
       bool result = RunOnDevice();
       if (!result) {
         this->RecordLastFailedOpNetPosition();
@@ -389,9 +408,33 @@ class Operator : public OperatorBase {
     }
   }
 
+  bool RunUnsynced(int stream_id = 0) final {
+    try {
+      context_.SwitchToDevice(stream_id);
+      TensorGrowthGuard growth(tensor_growth());
+      bool result = RunOnDevice();
+      if (!result) {
+        this->RecordLastFailedOpNetPosition();
+      }
+      return result;
+    } catch (EnforceNotMet& err) {
+      if (has_debug_def()) {
+        err.AppendMessage(
+            "Error from operator: \n" + ProtoDebugString(debug_def()));
+        AddRelatedBlobInfo(&err);
+      }
+      this->RecordLastFailedOpNetPosition();
+      throw;
+    } catch (...) {
+      this->RecordLastFailedOpNetPosition();
+      throw;
+    }
+  }
+
   bool RunAsync(int stream_id = 0) final {
     try {
       context_.SwitchToDevice(stream_id);
+      TensorGrowthGuard growth(tensor_growth());
       auto result = RunOnDevice();
       if (result) {
         if (HasAsyncPart()) {
@@ -467,6 +467,17 @@ inline vector<TIndex> GetDimsVector(const TensorShape& shape) {
   return dims;
 }
 
+// Number of elements of a tensor of the shape, from dimension dim on
+inline uint64_t nElemFromDim(const TensorShape& X, int dim = 0) {
+  CAFFE_ENFORCE_GE(dim, 0, "Invalid maximum index specified");
+
+  uint64_t nElem = 1;
+  for (int i = dim; i < X.dims_size(); ++i) {
+    nElem *= X.dims(i);
+  }
+  return nElem;
+}
+
 // Helper function for infer op inputs and outputs device information.
 inline std::pair<std::vector<DeviceOption>, std::vector<DeviceOption>>
 InferOpInputOutputDevice(const OperatorDef& op) {
@@ -259,6 +259,12 @@ struct CompiledExecutionStep {
 
     auto createAndGetNet = [&](const std::string& network_name) {
       auto it = netDefs->find(network_name);
+      if (it == netDefs->end() && workspace->GetNet(network_name)) {
+        // A net the plan does not define, but that the workspace already
+        // has, is run as it is. A training loop can run a created net for
+        // many iterations this way without creating its operators again.
+        return workspace->GetNet(network_name);
+      }
       CAFFE_ENFORCE(
           it != netDefs->end(),
           "ExecutionStep " + mainStep->name() + " uses undefined net " +
@@ -2,6 +2,8 @@
 
 #include <unordered_set>
 
+#include "caffe2/core/mapped_weights.h"
+
 namespace caffe2 {
 
 namespace {
@@ -73,18 +75,46 @@ Predictor::Predictor(
     Workspace* parent)
     : run_net_(run_net), ws_(parent) {
   CAFFE_ENFORCE(ws_.RunNetOnce(init_net));
+  createRunNet();
+}
+
+Predictor::Predictor(
+    const std::string& weights_file,
+    const NetDef& run_net,
+    Workspace* parent)
+    : run_net_(run_net), ws_(parent) {
+  LoadMappedWeights(weights_file, &ws_);
+  createRunNet();
+}
+
+Predictor::Predictor(const NetDef& run_net, const Workspace* weights)
+    : run_net_(run_net), ws_(weights) {
+  CAFFE_ENFORCE(weights);
+  for (const auto& op : run_net_.op()) {
+    for (const auto& output : op.output()) {
+      CAFFE_ENFORCE(
+          !weights->HasBlob(output),
+          op.type(),
+          " writes ",
+          output,
+          " of the shared weights");
+    }
+  }
+  createRunNet();
+}
 
+void Predictor::createRunNet() {
   // real model inputs can be fed later in run* functions
   const auto& initialized_vec = ws_.Blobs();
   const std::unordered_set<std::string> initialized{initialized_vec.begin(),
                                                     initialized_vec.end()};
-  for (const auto& name : run_net.external_input()) {
+  for (const auto& name : run_net_.external_input()) {
     if (!initialized.count(name)) {
       auto* blob = ws_.CreateBlob(name);
       blob->template GetMutable<TensorCPU>();
     }
   }
-  CAFFE_ENFORCE(ws_.CreateNet(run_net));
+  CAFFE_ENFORCE(ws_.CreateNet(run_net_));
 }
 
 Predictor::~Predictor() {}
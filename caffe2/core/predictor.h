@@ -23,6 +23,21 @@ class Predictor {
       const NetDef& init_net,
       const NetDef& run_net,
       Workspace* parent = nullptr);
+
+  // Maps the weights of a mapped weights file (see mapped_weights.h)
+  // instead of running an `init_net`, so that the processes that serve the
+  // same model share one read-only copy of its weights
+  Predictor(
+      const std::string& weights_file,
+      const NetDef& run_net,
+      Workspace* parent = nullptr);
+
+  // Reads the weights from `weights`, a workspace filled once (by an
+  // `init_net` or LoadMappedWeights) and shared by the predictors of many
+  // threads, so that every one of them only holds the inputs and the
+  // activations of `run_net`. `weights` must outlive the predictor and is
+  // never written: no op of `run_net` may output one of its blobs.
+  Predictor(const NetDef& run_net, const Workspace* weights);
   ~Predictor();
 
   // Executes `run_net` on the inputs.
@@ -50,6 +65,8 @@ class Predictor {
   };
 
  private:
+  void createRunNet();
+
   NetDef run_net_;
   Workspace ws_;
   std::unordered_set<std::string> inputNames_;
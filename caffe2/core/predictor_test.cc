@@ -1,9 +1,12 @@
 #include "caffe2/core/context.h"
+#include "caffe2/core/mapped_weights.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/core/predictor.h"
 #include "caffe2/core/tensor.h"
 #include "caffe2/utils/math.h"
 
+#include <algorithm>
+
 #include <gtest/gtest.h>
 
 namespace caffe2 {
@@ -197,6 +200,54 @@ TEST_F(PredictorTest, SimpleBatchSizedMapInput) {
   EXPECT_NEAR(output.front()->data<float>()[4], 0.1209, 1E-4);
 }
 
+TEST_F(PredictorTest, MappedWeights) {
+  const std::string weights_file = std::tmpnam(nullptr);
+  SaveMappedWeights(weights_file, *p_->ws(), {"W", "b"});
+  Predictor mapped(weights_file, parseNetDef(predictSpec));
+  EXPECT_TRUE(mapped.ws()->GetBlob("W")->Get<TensorCPU>().shares_data());
+
+  auto inputData = randomTensor({1, 4}, ctx_.get());
+  Predictor::TensorVector input{inputData->template GetMutable<TensorCPU>()};
+  Predictor::TensorVector output;
+  mapped.run(input, &output);
+  EXPECT_EQ(output.size(), 1);
+  EXPECT_TRUE(output.front()->dims().size() == 2);
+  EXPECT_TRUE(output.front()->dim(0) == 1);
+  EXPECT_TRUE(output.front()->dim(1) == 10);
+  EXPECT_NEAR(output.front()->data<float>()[4], 0.1209, 1E-4);
+  std::remove(weights_file.c_str());
+}
+
+TEST_F(PredictorTest, SharedWeights) {
+  Workspace weights;
+  ASSERT_TRUE(weights.RunNetOnce(parseNetDef(initSpec)));
+  Predictor first(parseNetDef(predictSpec), &weights);
+  Predictor second(parseNetDef(predictSpec), &weights);
+  auto inputData = randomTensor({1, 4}, ctx_.get());
+  Predictor::TensorVector input{inputData->template GetMutable<TensorCPU>()};
+  for (auto* p : {&first, &second}) {
+    const auto local = p->ws()->LocalBlobs();
+    EXPECT_EQ(std::count(local.begin(), local.end(), "W"), 0);
+    EXPECT_EQ(
+        &p->ws()->GetBlob("W")->Get<TensorCPU>(),
+        &weights.GetBlob("W")->Get<TensorCPU>());
+
+    Predictor::TensorVector output;
+    p->run(input, &output);
+    EXPECT_EQ(output.size(), 1);
+    EXPECT_TRUE(output.front()->dim(1) == 10);
+    EXPECT_NEAR(output.front()->data<float>()[4], 0.1209, 1E-4);
+  }
+  EXPECT_NE(
+      first.ws()->GetBlob("y")->Get<TensorCPU>().data<float>(),
+      second.ws()->GetBlob("y")->Get<TensorCPU>().data<float>());
+
+  // a net writing the weights would race with the other predictors
+  NetDef writes = parseNetDef(predictSpec);
+  writes.mutable_op(0)->set_output(0, "b");
+  EXPECT_THROW({ Predictor p(writes, &weights); }, EnforceNotMet);
+}
+
 class PredictorMetaNetDefTest : public testing::Test {
  public:
   void SetUp() override {
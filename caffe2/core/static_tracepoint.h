@@ -1,5 +1,7 @@
 #pragma once
 
+#include "caffe2/core/macros.h"
+
 #if defined(__ELF__) && (defined(__x86_64__) || defined(__i386__))
 #include <caffe2/core/static_tracepoint_elfx86.h>
 
@@ -9,3 +11,14 @@
 #else
 #define CAFFE_SDT(name, ...) do {} while(0)
 #endif
+
+// The probes of the hot paths (the net executors, the allocators, the db
+// readers and the video input) are compiled in with CAFFE2_ENABLE_SDT, which
+// USE_SDT sets. A probe is a nop and the setup of its arguments until a
+// tracer (perf, bpftrace, systemtap) attaches to it, and its arguments are
+// pointers and integers at hand, so that they can stay in production builds.
+#ifdef CAFFE2_ENABLE_SDT
+#define CAFFE_HOT_SDT(name, ...) CAFFE_SDT(name, ##__VA_ARGS__)
+#else
+#define CAFFE_HOT_SDT(name, ...) do {} while(0)
+#endif
@@ -0,0 +1,301 @@
+#include "caffe2/core/streaming_predictor.h"
+
+#include <algorithm>
+#include <map>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+namespace {
+
+// frames per frame of the input, and frames behind the newest input frame,
+// both in frames of the blob
+struct Stream {
+  int rate;
+  int lag;
+};
+
+// the temporal (first) entry of a 3-dim conv/pool arg given either per dim
+// (`plural`) or for all dims
+int TemporalArg(
+    const ArgumentHelper& args,
+    const string& plural,
+    const string& single,
+    const int begin,
+    const int default_value) {
+  if (args.HasArgument(plural)) {
+    const auto values = args.GetRepeatedArgument<int>(plural);
+    CAFFE_ENFORCE_GT(values.size(), begin, plural);
+    return values[begin];
+  }
+  return args.GetSingleArgument<int>(single, default_value);
+}
+
+// the op with its temporal padding removed, the chunks bringing their own
+// context
+void RemoveTemporalPadding(OperatorDef* op) {
+  ArgumentHelper args(*op);
+  std::vector<int> pads(6, args.GetSingleArgument<int>("pad", 0));
+  if (args.HasArgument("pads")) {
+    pads = args.GetRepeatedArgument<int>("pads");
+    CAFFE_ENFORCE_EQ(pads.size(), 6, "pads of ", op->type());
+  }
+  pads[0] = 0;
+  pads[3] = 0;
+  auto* arg_list = op->mutable_arg();
+  for (int i = arg_list->size() - 1; i >= 0; --i) {
+    const string& name = arg_list->Get(i).name();
+    if (name == "pad" || name == "pads") {
+      arg_list->DeleteSubrange(i, 1);
+    }
+  }
+  op->add_arg()->CopyFrom(MakeArgument("pads", pads));
+}
+
+class StreamingNetBuilder {
+ public:
+  StreamingNetBuilder(const NetDef& run_net, const int stride)
+      : run_net_(run_net), stride_(stride) {
+    net_.CopyFrom(run_net);
+    net_.clear_op();
+  }
+
+  // Rewrites the ops of run_net up to (and with) the last one writing split
+  // before it is read; returns the index of that op.
+  int StreamOps(const string& split) {
+    const int last = LastWriter(split);
+    streams_[run_net_.external_input(0)] = Stream{1, 0};
+    for (int i = 0; i <= last; ++i) {
+      OperatorDef op = run_net_.op(i);
+      StreamOp(&op);
+      if (i == last) {
+        CAFFE_ENFORCE(
+            streams_.count(split), split, " is not computed from the frames");
+        for (auto& output : *op.mutable_output()) {
+          if (output == split) {
+            streams_[split + "_stream"] = streams_.at(split);
+            streams_.erase(split);
+            output = split + "_stream";
+          }
+        }
+      }
+      net_.add_op()->CopyFrom(op);
+    }
+    return last;
+  }
+
+  // Assembles the window of split from its stream; returns the lag of the
+  // window in input frames.
+  int AddWindow(const string& split, const int window) {
+    const Stream stream = streams_.at(split + "_stream");
+    CAFFE_ENFORCE_EQ(
+        window % stream.rate,
+        0,
+        "the window is not a whole number of frames of ",
+        split);
+    AddContext(
+        split + "_stream",
+        split,
+        window / stream.rate - stride_ / stream.rate,
+        false);
+    // which is the whole window, read like any other blob from here on
+    streams_.erase(split + "_stream");
+    streams_.erase(split);
+    return stream.lag * stream.rate;
+  }
+
+  // Copies the ops from `first` on, which run on the whole window.
+  void AddWindowOps(const int first) {
+    for (int i = first; i < run_net_.op_size(); ++i) {
+      const OperatorDef& op = run_net_.op(i);
+      for (const auto& input : op.input()) {
+        CAFFE_ENFORCE(
+            !streams_.count(input),
+            op.type(),
+            " after the split reads ",
+            input,
+            ", which is only computed on the new frames");
+      }
+      net_.add_op()->CopyFrom(op);
+    }
+  }
+
+  NetDef& net() {
+    return net_;
+  }
+
+ private:
+  int LastWriter(const string& split) {
+    int last = -1;
+    for (int i = 0; i < run_net_.op_size(); ++i) {
+      const auto& op = run_net_.op(i);
+      const bool writes =
+          std::find(op.output().begin(), op.output().end(), split) !=
+          op.output().end();
+      const bool reads =
+          std::find(op.input().begin(), op.input().end(), split) !=
+          op.input().end();
+      if (writes) {
+        last = i;
+      } else if (reads) {
+        break;
+      }
+    }
+    CAFFE_ENFORCE_GE(last, 0, "no op writes ", split);
+    return last;
+  }
+
+  void StreamOp(OperatorDef* op) {
+    // the rate and lag of its frames; the other inputs are weights
+    std::vector<int> stream_inputs;
+    int rate = 0;
+    int lag = 0;
+    for (int j = 0; j < op->input_size(); ++j) {
+      const auto it = streams_.find(op->input(j));
+      if (it == streams_.end()) {
+        continue;
+      }
+      CAFFE_ENFORCE(
+          rate == 0 || rate == it->second.rate,
+          op->type(),
+          " mixes frame rates");
+      rate = it->second.rate;
+      lag = std::max(lag, it->second.lag);
+      stream_inputs.push_back(j);
+    }
+    if (stream_inputs.empty()) {
+      for (const auto& output : op->output()) {
+        streams_.erase(output);
+      }
+      return;
+    }
+    // the inputs that are behind the others are delayed to them, e.g. the
+    // shortcut of a residual block with a temporal conv
+    for (const int j : stream_inputs) {
+      const int behind = lag - streams_.at(op->input(j)).lag;
+      if (behind > 0) {
+        op->set_input(j, AddContext(op->input(j), "", behind, true));
+      }
+    }
+
+    ArgumentHelper args(*op);
+    if (args.HasArgument("kernels") &&
+        args.GetRepeatedArgument<int>("kernels").size() == 3) {
+      CAFFE_ENFORCE(
+          !args.GetSingleArgument<int>("global_pooling", 0),
+          op->type(),
+          " pools globally before the split");
+      CAFFE_ENFORCE_EQ(
+          TemporalArg(args, "dilations", "dilation", 0, 1),
+          1,
+          op->type(),
+          " dilates in time");
+      CAFFE_ENFORCE_EQ(
+          stream_inputs.size(), 1, op->type(), " takes frames of two blobs");
+      CAFFE_ENFORCE_EQ(stream_inputs[0], 0);
+      const int kernel = args.GetRepeatedArgument<int>("kernels")[0];
+      const int stride = TemporalArg(args, "strides", "stride", 0, 1);
+      const int pad = TemporalArg(args, "pads", "pad", 0, 0);
+      CAFFE_ENFORCE_EQ(
+          (stride_ / rate) % stride,
+          0,
+          op->type(),
+          " strides over a step in time");
+      // a chunk of n frames after `context` frames of the stream gives n /
+      // stride frames, and the first of them is the one at the input frame
+      // context - pad back
+      const int context = std::max(kernel - stride, 0);
+      CAFFE_ENFORCE_GE(
+          context, pad, op->type(), " pads more than its kernel reaches");
+      const int align = (stride - (lag + context - pad) % stride) % stride;
+      if (align > 0) {
+        op->set_input(0, AddContext(op->input(0), "", align, true));
+      }
+      if (context > 0) {
+        op->set_input(0, AddContext(op->input(0), "", context, false));
+      }
+      RemoveTemporalPadding(op);
+      rate *= stride;
+      lag = (lag + align + context - pad) / stride;
+    }
+    for (const auto& output : op->output()) {
+      streams_[output] = Stream{rate, lag};
+    }
+  }
+
+  // Adds a TemporalContext op keeping `context` frames of input, and returns
+  // its output.
+  string AddContext(
+      const string& input,
+      string output,
+      const int context,
+      const bool delay) {
+    const int id = num_contexts_++;
+    const string suffix = (delay ? "_stream_delay_" : "_stream_context_") +
+        caffe2::to_string(id);
+    if (output.empty()) {
+      output = input + suffix;
+    }
+    const string state = input + suffix + "_state";
+    auto* op = net_.add_op();
+    op->CopyFrom(CreateOperatorDef(
+        "TemporalContext",
+        "",
+        std::vector<string>{input, state},
+        std::vector<string>{output, state},
+        std::vector<Argument>{MakeArgument<int>("context", context),
+                              MakeArgument<int>("delay", delay)}));
+    net_.add_external_input(state);
+    Stream stream = streams_.at(input);
+    if (delay) {
+      stream.lag += context;
+    }
+    streams_[output] = stream;
+    return output;
+  }
+
+  const NetDef& run_net_;
+  const int stride_;
+  NetDef net_;
+  std::map<string, Stream> streams_;
+  int num_contexts_ = 0;
+};
+
+} // namespace
+
+StreamingPredictor::StreamingPredictor(
+    const NetDef& init_net,
+    const NetDef& run_net,
+    const std::string& split_blob,
+    const int window,
+    const int stride,
+    Workspace* parent)
+    : window_(window), stride_(stride), lag_(0), pushed_frames_(0) {
+  CAFFE_ENFORCE_GT(run_net.external_input_size(), 0);
+  CAFFE_ENFORCE_GT(stride, 0);
+  CAFFE_ENFORCE_GE(window, stride);
+  StreamingNetBuilder builder(run_net, stride);
+  const int last = builder.StreamOps(split_blob);
+  lag_ = builder.AddWindow(split_blob, window);
+  builder.AddWindowOps(last + 1);
+  VLOG(1) << "Streaming " << run_net.name() << " from " << split_blob
+          << ", " << lag_ << " frames behind";
+  predictor_.reset(new Predictor(init_net, builder.net(), parent));
+}
+
+bool StreamingPredictor::run(
+    const TensorVector& inputs,
+    TensorVector* outputs) {
+  CAFFE_ENFORCE(!inputs.empty());
+  CAFFE_ENFORCE_GE(inputs[0]->ndim(), 3);
+  CAFFE_ENFORCE_EQ(inputs[0]->dim32(2), stride_, "frames of a step");
+  if (!predictor_->run(inputs, outputs)) {
+    return false;
+  }
+  pushed_frames_ += stride_;
+  return true;
+}
+
+} // namespace caffe2
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include "caffe2/core/predictor.h"
+
+namespace caffe2 {
+
+// Sliding-window inference over a stream of frames, e.g. a video action
+// classifier run on the last `window` frames every `stride` frames.
+//
+// `run_net` takes clips of `window` frames (dim 2 of its first external
+// input, N x C x T x H x W). The ops up to the one writing `split_blob` are
+// temporally local: they are only run on the `stride` new frames of every
+// step, each 3D conv and pool seeing the frames before them through a
+// TemporalContext op, so their activations are computed once per frame and
+// kept in ring buffers. The ops from `split_blob` on (the non-local blocks,
+// the temporal pooling) run on the whole window, assembled from the last
+// frames of `split_blob`.
+//
+// The early stages thus see the stream instead of the window: the frames
+// near the edges of a window get the real frames around them instead of
+// the zero padding a clip would have, and the window lags `lag()` frames
+// behind the newest one, the temporal half-width of the convs before the
+// split. Apart from the ops with a "kernels" arg of 3 dims, the ops before
+// the split must treat the frames independently.
+class StreamingPredictor {
+ public:
+  using TensorVector = Predictor::TensorVector;
+
+  StreamingPredictor(
+      const NetDef& init_net,
+      const NetDef& run_net,
+      const std::string& split_blob,
+      const int window,
+      const int stride,
+      Workspace* parent = nullptr);
+
+  // Runs a step on `stride` new frames in inputs[0] (the other inputs as
+  // Predictor::run takes them). The outputs are those of the window once
+  // ready() and of a partly filled one before.
+  bool run(const TensorVector& inputs, TensorVector* outputs);
+
+  // whether the window is made of frames of the stream only
+  bool ready() const {
+    return pushed_frames_ >= window_ + lag_;
+  }
+
+  // frames the window ends behind the newest frame pushed
+  int lag() const {
+    return lag_;
+  }
+
+  const NetDef& def() const {
+    return predictor_->def();
+  }
+
+  Workspace* ws() {
+    return predictor_->ws();
+  }
+
+ private:
+  const int window_;
+  const int stride_;
+  int lag_;
+  int pushed_frames_;
+  std::unique_ptr<Predictor> predictor_;
+};
+
+} // namespace caffe2
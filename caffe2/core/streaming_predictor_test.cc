@@ -0,0 +1,169 @@
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/streaming_predictor.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/utils/proto_utils.h"
+
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// a residual block with a temporal conv, then a temporal pool (the split),
+// then an average over the whole window
+const char* predictSpec = R"DOC(
+        name: "predict"
+        external_input: "data"
+        external_input: "w1"
+        external_input: "b1"
+        external_input: "w2"
+        external_input: "b2"
+        external_output: "y"
+        op {
+          input: "data" input: "w1" input: "b1" output: "conv1" type: "Conv"
+          arg { name: "kernels" ints: 3 ints: 3 ints: 3 }
+          arg { name: "pads" ints: 1 ints: 1 ints: 1 ints: 1 ints: 1 ints: 1 }
+        }
+        op { input: "conv1" output: "conv1" type: "Relu" }
+        op {
+          input: "data" input: "w2" input: "b2" output: "skip" type: "Conv"
+          arg { name: "kernels" ints: 1 ints: 1 ints: 1 }
+        }
+        op { input: "conv1" input: "skip" output: "sum" type: "Sum" }
+        op {
+          input: "sum" output: "pool" type: "MaxPool"
+          arg { name: "kernels" ints: 2 ints: 1 ints: 1 }
+          arg { name: "strides" ints: 2 ints: 1 ints: 1 }
+        }
+        op {
+          input: "pool" output: "y" type: "AveragePool"
+          arg { name: "kernels" ints: 4 ints: 4 ints: 4 }
+        }
+)DOC";
+
+const char* initSpec = R"DOC(
+        name: "init"
+        op {
+          output: "w1" type: "UniformFill"
+          arg { name: "shape" ints: 3 ints: 2 ints: 3 ints: 3 ints: 3 }
+          arg { name: "min" f: -0.5 }
+          arg { name: "max" f: 0.5 }
+        }
+        op {
+          output: "b1" type: "UniformFill"
+          arg { name: "shape" ints: 3 }
+          arg { name: "min" f: -0.5 }
+          arg { name: "max" f: 0.5 }
+        }
+        op {
+          output: "w2" type: "UniformFill"
+          arg { name: "shape" ints: 3 ints: 2 ints: 1 ints: 1 ints: 1 }
+          arg { name: "min" f: -0.5 }
+          arg { name: "max" f: 0.5 }
+        }
+        op {
+          output: "b2" type: "UniformFill"
+          arg { name: "shape" ints: 3 }
+          arg { name: "min" f: -0.5 }
+          arg { name: "max" f: 0.5 }
+        }
+)DOC";
+
+constexpr int kWindow = 8;
+constexpr int kStride = 4;
+constexpr int kFrames = 40;
+constexpr int kSize = 4;
+
+NetDef parseNetDef(const std::string& value) {
+  NetDef def;
+  CAFFE_ENFORCE(
+      TextFormat::ParseFromString(value, &def),
+      "Failed to parse NetDef with value: ",
+      value);
+  return def;
+}
+
+} // namespace
+
+TEST(StreamingPredictorTest, RewritesTheTemporalOps) {
+  StreamingPredictor p(
+      parseNetDef(initSpec), parseNetDef(predictSpec), "pool", kWindow,
+      kStride);
+  int contexts = 0;
+  for (const auto& op : p.def().op()) {
+    if (op.type() == "TemporalContext") {
+      ++contexts;
+    } else if (op.type() == "Conv" || op.type() == "MaxPool") {
+      const auto pads = ArgumentHelper(op).GetRepeatedArgument<int>("pads");
+      EXPECT_EQ(pads[0], 0);
+      EXPECT_EQ(pads[3], 0);
+    }
+  }
+  // the context of conv1, the delay of the shortcut to it, the delay of
+  // the pairs of the pool to the pairs of the clip and the window
+  EXPECT_EQ(contexts, 4);
+  // a frame of conv1 and one of pool
+  EXPECT_EQ(p.lag(), 2);
+}
+
+TEST(StreamingPredictorTest, MatchesTheWholeStream) {
+  StreamingPredictor p(
+      parseNetDef(initSpec), parseNetDef(predictSpec), "pool", kWindow,
+      kStride);
+
+  DeviceOption option;
+  option.set_random_seed(1701);
+  CPUContext context(option);
+  TensorCPU video(std::vector<TIndex>{1, 2, kFrames, kSize, kSize});
+  math::RandUniform<float, CPUContext>(
+      video.size(), -1.0, 1.0, video.mutable_data<float>(), &context);
+
+  // the split blob of the whole stream, by the ops before it with the
+  // weights of the predictor
+  Workspace ws;
+  for (const string name : {"w1", "b1", "w2", "b2"}) {
+    ws.CreateBlob(name)->GetMutable<TensorCPU>()->CopyFrom(
+        p.ws()->GetBlob(name)->Get<TensorCPU>());
+  }
+  NetDef prefix = parseNetDef(predictSpec);
+  prefix.mutable_op()->DeleteSubrange(prefix.op_size() - 1, 1);
+  prefix.clear_external_output();
+  ws.CreateBlob("data")->GetMutable<TensorCPU>()->CopyFrom(video);
+  ASSERT_TRUE(ws.RunNetOnce(prefix));
+  const auto& pool = ws.GetBlob("pool")->Get<TensorCPU>();
+  ASSERT_EQ(pool.dim32(2), kFrames / 2);
+  const int plane = kSize * kSize;
+
+  for (int pushed = kStride; pushed <= kFrames; pushed += kStride) {
+    TensorCPU chunk(std::vector<TIndex>{1, 2, kStride, kSize, kSize});
+    for (int c = 0; c < 2; ++c) {
+      context.Copy<float, CPUContext, CPUContext>(
+          kStride * plane,
+          video.data<float>() + (c * kFrames + pushed - kStride) * plane,
+          chunk.mutable_data<float>() + c * kStride * plane);
+    }
+    Predictor::TensorVector outputs;
+    ASSERT_TRUE(p.run({&chunk}, &outputs));
+    if (!p.ready()) {
+      continue;
+    }
+    // the mean of the frames of the window in the whole stream
+    const int end = (pushed - p.lag()) / 2;
+    const int begin = end - kWindow / 2;
+    const float* y = outputs[0]->data<float>();
+    for (int c = 0; c < 3; ++c) {
+      float expected = 0;
+      for (int t = begin; t < end; ++t) {
+        for (int i = 0; i < plane; ++i) {
+          expected += pool.data<float>()[(c * kFrames / 2 + t) * plane + i];
+        }
+      }
+      expected /= (end - begin) * plane;
+      EXPECT_NEAR(y[c], expected, 1e-4) << "frames " << pushed;
+    }
+  }
+}
+
+} // namespace caffe2
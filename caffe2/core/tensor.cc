@@ -18,6 +18,40 @@ namespace caffe2 {
 // declaring it here instead of context.cc because tensor.h includes context.h
 CAFFE_KNOWN_TYPE(Tensor<CPUContext>);
 
+namespace {
+thread_local const TensorGrowthPolicy* current_tensor_growth = nullptr;
+} // namespace
+
+size_t TensorGrowthPolicy::GrowTo(size_t capacity, size_t new_bytes) const {
+  const size_t bytes = std::max(
+      new_bytes, static_cast<size_t>(capacity * std::max(factor, 1.f)));
+  // the size classes are 4 per power of 2, so that at most a fifth of a
+  // capacity is unused past the factor
+  size_t power = 1;
+  while (power * 2 <= bytes) {
+    power *= 2;
+  }
+  const size_t step = std::max<size_t>(power / 4, 1);
+  return (bytes + step - 1) / step * step;
+}
+
+const TensorGrowthPolicy* CurrentTensorGrowthPolicy() {
+  return current_tensor_growth;
+}
+
+TensorGrowthGuard::TensorGrowthGuard(const TensorGrowthPolicy& policy)
+    : previous_(current_tensor_growth), set_(policy.enabled()) {
+  if (set_) {
+    current_tensor_growth = &policy;
+  }
+}
+
+TensorGrowthGuard::~TensorGrowthGuard() {
+  if (set_) {
+    current_tensor_growth = previous_;
+  }
+}
+
 TensorPrinter::TensorPrinter(
     const std::string& tensor_name,
     const std::string& file_name,
@@ -1,6 +1,7 @@
 #ifndef CAFFE2_CORE_TENSOR_H_
 #define CAFFE2_CORE_TENSOR_H_
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <fstream>
@@ -27,6 +28,42 @@ CAFFE2_DECLARE_int64(caffe2_max_keep_on_shrink_memory);
 
 namespace caffe2 {
 
+/**
+ * How the tensors written by the ops of a net grow, for nets whose inputs
+ * change shape from run to run (e.g. the fully convolutional test over clips
+ * of many sizes). A tensor that outgrows its capacity is reallocated to the
+ * size class above factor x its capacity, and never gives up capacity when it
+ * shrinks, so a blob settles at its high-water capacity and the runs after
+ * the warmup allocate nothing. A factor of 0 leaves the tensors alone.
+ */
+struct TensorGrowthPolicy {
+  float factor = 0.f;
+
+  inline bool enabled() const {
+    return factor > 0.f;
+  }
+
+  // the capacity in bytes for new_bytes, of a tensor that had capacity
+  size_t GrowTo(size_t capacity, size_t new_bytes) const;
+};
+
+/**
+ * The growth policy of the ops running on this thread, or nullptr; set by
+ * Operator::Run from the policy of its net for the duration of the op.
+ */
+const TensorGrowthPolicy* CurrentTensorGrowthPolicy();
+
+class TensorGrowthGuard {
+ public:
+  explicit TensorGrowthGuard(const TensorGrowthPolicy& policy);
+  ~TensorGrowthGuard();
+
+ private:
+  const TensorGrowthPolicy* previous_;
+  bool set_;
+  DISABLE_COPY_AND_ASSIGN(TensorGrowthGuard);
+};
+
 /**
  * A utility function to convert vector<int> to vector<TIndex>.
  */
@@ -292,6 +329,16 @@ class Tensor {
       // will create the data storage.
       int64_t new_size = size_ * meta_.itemsize();
       bool reset_tensor = false;
+      const TensorGrowthPolicy* growth = CurrentTensorGrowthPolicy();
+      if (growth && !reserved_ && !shares_data_) {
+        // keep the high-water capacity, and outgrow it by a size class
+        if (capacity_ < new_size) {
+          const size_t grow_to = growth->GrowTo(capacity_, new_size);
+          FreeMemory();
+          growth_capacity_ = grow_to;
+        }
+        return;
+      }
       if (reserved_) {
         // If tensor is reserved then don't claim its memeory unless capacity_
         // is smaller than new size
@@ -353,6 +400,7 @@ class Tensor {
   inline void FreeMemory() {
     data_.reset();
     capacity_ = 0;
+    growth_capacity_ = 0;
     // If reserved is true and we changed tensor memory then it is fine
     // to switch it to false, if Resize is called from Reserve and it triggers
     // FreeMemory() then reserved_ will be set to true at end of Reserve()
@@ -383,6 +431,7 @@ class Tensor {
     std::swap(shares_data_, other.shares_data_);
     std::swap(capacity_, other.capacity_);
     std::swap(reserved_, other.reserved_);
+    std::swap(growth_capacity_, other.growth_capacity_);
   }
 
   /**
@@ -541,12 +590,16 @@ class Tensor {
               deleter(ptr);
             });
         meta_.ctor()(data_.get(), size_);
+        capacity_ = size_ * meta_.itemsize();
       } else {
-        // For fundamental type, new and delete is easier.
-        auto ptr_and_deleter = Context::New(size_ * meta_.itemsize());
+        // For fundamental type, new and delete is easier. A tensor growing
+        // under a TensorGrowthPolicy allocates the capacity it grew to.
+        const size_t nbytes =
+            std::max<size_t>(size_ * meta_.itemsize(), growth_capacity_);
+        auto ptr_and_deleter = Context::New(nbytes);
         data_.reset(ptr_and_deleter.first, ptr_and_deleter.second);
+        capacity_ = nbytes;
       }
-      capacity_ = size_ * meta_.itemsize();
       return data_.get();
     }
   }
@@ -684,6 +737,8 @@ class Tensor {
   bool shares_data_ = false;
   size_t capacity_ = 0;
   bool reserved_ = false;
+  // the bytes that the next allocation takes, under a TensorGrowthPolicy
+  size_t growth_capacity_ = 0;
   // In case of chunk load we store how much data was already loaded
 
  private:
@@ -193,6 +193,12 @@ NetDef ApplyTransform(const string& key, const NetDef& netdef) {
   return t->ApplyTo(netdef);
 }
 
+NetDef ApplyTransform(const string& key, const NetDef& netdef, Workspace* ws) {
+  auto t = CreateTransform(key);
+  t->SetWorkspace(ws);
+  return t->ApplyTo(netdef);
+}
+
 double average_net_run_duration(
     const NetDef& netdef,
     const NetDef& init_netdef,
@@ -43,6 +43,15 @@ class Transform {
 
   virtual ~Transform() {}
 
+  /**
+   * Gives the transform the workspace that holds the blobs of the net, for
+   * transforms that rewrite parameter values (e.g. folding) and not only
+   * operators. Transforms that only work on the graph ignore it.
+   */
+  void SetWorkspace(Workspace* ws) {
+    ws_ = ws;
+  }
+
   /**
    * Determines the type of subgraphs that PatternMatch will find.
    *
@@ -124,6 +133,9 @@ class Transform {
     pattern_match_type_ = type;
   }
 
+  // may be null, see SetWorkspace()
+  Workspace* ws_ = nullptr;
+
  private:
   /**
    * A helper function for PatternMatch, which keeps track of the best subgraph
@@ -158,6 +170,9 @@ CAFFE_DECLARE_REGISTRY(TransformRegistry, Transform);
 // and immediately apply it to a Netdef.
 NetDef ApplyTransform(const string& key, const NetDef& netdef);
 
+// Same as above, with the blobs of the net in ws.
+NetDef ApplyTransform(const string& key, const NetDef& netdef, Workspace* ws);
+
 // Create a Transform object from registry, apply it to a NetDef.
 // Will only return the transformed net if it is faster than the old net.
 // This will run the init net first, will run the two nets warmup_runs times.
@@ -73,6 +73,7 @@ void Workspace::PrintBlobSizes() {
 }
 
 vector<string> Workspace::LocalBlobs() const {
+  std::lock_guard<std::recursive_mutex> guard(blob_map_mutex_);
   vector<string> names;
   names.reserve(blob_map_.size());
   for (auto& entry : blob_map_) {
@@ -82,6 +83,7 @@ vector<string> Workspace::LocalBlobs() const {
 }
 
 vector<string> Workspace::Blobs() const {
+  std::lock_guard<std::recursive_mutex> guard(blob_map_mutex_);
   vector<string> names;
   names.reserve(blob_map_.size());
   for (auto& entry : blob_map_) {
@@ -102,6 +104,7 @@ vector<string> Workspace::Blobs() const {
 }
 
 Blob* Workspace::CreateBlob(const string& name) {
+  std::lock_guard<std::recursive_mutex> guard(blob_map_mutex_);
   if (HasBlob(name)) {
     VLOG(1) << "Blob " << name << " already exists. Skipping.";
   } else if (forwarded_blobs_.count(name)) {
@@ -116,6 +119,7 @@ Blob* Workspace::CreateBlob(const string& name) {
 }
 
 Blob* Workspace::CreateLocalBlob(const string& name) {
+  std::lock_guard<std::recursive_mutex> guard(blob_map_mutex_);
   if (blob_map_.count(name)) {
     VLOG(1) << "Blob " << name << " already exists. Skipping.";
   } else {
@@ -126,6 +130,7 @@ Blob* Workspace::CreateLocalBlob(const string& name) {
 }
 
 Blob* Workspace::RenameBlob(const string& old_name, const string& new_name) {
+  std::lock_guard<std::recursive_mutex> guard(blob_map_mutex_);
   // We allow renaming only local blobs for API clarity purpose
   auto it = blob_map_.find(old_name);
   CAFFE_ENFORCE(
@@ -149,6 +154,7 @@ Blob* Workspace::RenameBlob(const string& old_name, const string& new_name) {
 }
 
 bool Workspace::RemoveBlob(const string& name) {
+  std::lock_guard<std::recursive_mutex> guard(blob_map_mutex_);
   auto it = blob_map_.find(name);
   if (it != blob_map_.end()) {
     VLOG(1) << "Removing blob " << name << " from this workspace.";
@@ -162,6 +168,7 @@ bool Workspace::RemoveBlob(const string& name) {
 }
 
 const Blob* Workspace::GetBlob(const string& name) const {
+  std::lock_guard<std::recursive_mutex> guard(blob_map_mutex_);
   if (blob_map_.count(name)) {
     return blob_map_.at(name).get();
   } else if (forwarded_blobs_.count(name)) {
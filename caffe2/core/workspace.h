@@ -169,6 +169,7 @@ class Workspace {
    * Checks if a blob with the given name is present in the current workspace.
    */
   inline bool HasBlob(const string& name) const {
+    std::lock_guard<std::recursive_mutex> guard(blob_map_mutex_);
     // First, check the local workspace,
     // Then, check the forwarding map, then the parent workspace
     if (blob_map_.count(name)) {
@@ -289,6 +290,10 @@ class Workspace {
 
  private:
   BlobMap blob_map_;
+  // guards blob_map_, so that the ops of a net can be constructed in
+  // parallel (FLAGS_caffe2_net_parallel_op_creation); recursive as blob
+  // creation looks the blob up
+  mutable std::recursive_mutex blob_map_mutex_;
   NetMap net_map_;
   const string root_folder_;
   const Workspace* shared_;
@@ -10,6 +10,22 @@ class WorkspaceTestFoo {};
 
 CAFFE_KNOWN_TYPE(WorkspaceTestFoo);
 
+// Counts its runs in its own state.
+class WorkspaceTestCountOp final : public OperatorBase {
+ public:
+  using OperatorBase::OperatorBase;
+  bool Run(int /* unused */) override {
+    *OperatorBase::Output<int>(0) = ++count_;
+    return true;
+  }
+
+ private:
+  int count_ = 0;
+};
+
+REGISTER_CPU_OPERATOR(WorkspaceTestCount, WorkspaceTestCountOp);
+OPERATOR_SCHEMA(WorkspaceTestCount).NumInputs(0).NumOutputs(1);
+
 TEST(WorkspaceTest, BlobAccess) {
   Workspace ws;
 
@@ -60,6 +76,33 @@ TEST(WorkspaceTest, RunEmptyPlan) {
   EXPECT_TRUE(ws.RunPlan(plan_def));
 }
 
+TEST(WorkspaceTest, RunPlanOnCreatedNet) {
+  Workspace ws;
+  NetDef net_def;
+  net_def.set_name("count");
+  auto* op = net_def.add_op();
+  op->set_type("WorkspaceTestCount");
+  op->add_output("count");
+  NetBase* net = ws.CreateNet(net_def);
+  ASSERT_NE(net, nullptr);
+  EXPECT_TRUE(net->Run());
+
+  // the plan does not include the net, so it runs the created one
+  PlanDef plan_def;
+  auto* step = plan_def.add_execution_step();
+  step->set_name("step");
+  step->add_network("count");
+  step->set_num_iter(3);
+  EXPECT_TRUE(ws.RunPlan(plan_def));
+  EXPECT_TRUE(ws.RunPlan(plan_def));
+  EXPECT_EQ(ws.GetNet("count"), net);
+  EXPECT_EQ(ws.GetBlob("count")->Get<int>(), 7);
+
+  // a net that neither has is an error
+  step->set_network(0, "undefined");
+  EXPECT_THROW(ws.RunPlan(plan_def), EnforceNotMet);
+}
+
 TEST(WorkspaceTest, Sharing) {
   Workspace parent;
   EXPECT_FALSE(parent.HasBlob("a"));
@@ -7,6 +7,8 @@
 #include <cuda.h>
 #include <nvrtc.h>
 
+#include "caffe2/core/flags.h"
+
 #define NVRTC_CHECK(condition)                                                 \
   do {                                                                         \
     nvrtcResult result = condition;                                            \
@@ -16,11 +18,22 @@
     }                                                                          \
   } while(0)
 
+CAFFE2_DECLARE_string(caffe2_cuda_rtc_cache_dir);
+
 namespace caffe2 {
 
+// The PTX of src. With cache, src is only compiled once per process, and
+// with caffe2_cuda_rtc_cache_dir only once across runs: the PTX is saved to,
+// and looked up in, that directory, which processes may share.
+string CompileToPTX(const string& src, bool cache);
+
 template <typename Derived>
 class CudaRTCFunction {
  public:
+  // Functions whose sources repeat, e.g. with no unique names, set this to
+  // have their PTX cached.
+  static constexpr bool kCachePTX = false;
+
   CudaRTCFunction() : module_loaded_(false) {}
   ~CudaRTCFunction() {
     if (module_loaded_) {
@@ -28,46 +41,19 @@ class CudaRTCFunction {
     }
   }
 
-  // TODO: this function is nontrivial and since CudaRTCFunction uses CRTP, it
-  // may potentially increase the binary size. In that case, move common parts
-  // into a separate function.
   template <typename... Args>
   void Compile(Args... args) {
     string src = static_cast<Derived*>(this)->GetSource(args...);
     string name = static_cast<Derived*>(this)->KernelName(args...);
     VLOG(1) << "function name: " << name;
     VLOG(1) << "function src:\n" << src;
-    // Actually do the compiling.
-    nvrtcProgram prog;
-    NVRTC_CHECK(nvrtcCreateProgram(
-        &prog, src.c_str(), nullptr, 0, nullptr, nullptr));
-    // Compile the program.
-    // TODO(Yangqing): how to find the current gpu architecture instead of hard
-    // coding it?
-    const char *nvrtc_opts[] = {"--gpu-architecture=compute_35",
-                                "--use_fast_math"};
-    nvrtcResult compile_result = nvrtcCompileProgram(
-        prog, 2, nvrtc_opts);
-    if (compile_result != NVRTC_SUCCESS) {
-      size_t log_size;
-      NVRTC_CHECK(nvrtcGetProgramLogSize(prog, &log_size));
-      vector<char> nvrtc_log(log_size);
-      NVRTC_CHECK(nvrtcGetProgramLog(prog, nvrtc_log.data()));
-      LOG(FATAL) << "Compilation failure for nvrtc("
-                 << nvrtcGetErrorString(compile_result) << "): \n"
-                 << nvrtc_log.data();
-    }
-    size_t ptx_size;
-    NVRTC_CHECK(nvrtcGetPTXSize(prog, &ptx_size));
-    vector<char> nvrtc_ptx(ptx_size);
-    NVRTC_CHECK(nvrtcGetPTX(prog, nvrtc_ptx.data()));
-    NVRTC_CHECK(nvrtcDestroyProgram(&prog));
+    const string nvrtc_ptx = CompileToPTX(src, Derived::kCachePTX);
     // After compilation, load the module.
     if (module_loaded_) {
       CUDA_DRIVERAPI_ENFORCE(cuModuleUnload(module_));
     }
     CUDA_DRIVERAPI_ENFORCE(
-        cuModuleLoadDataEx(&module_, nvrtc_ptx.data(), 0, 0, 0));
+        cuModuleLoadDataEx(&module_, nvrtc_ptx.c_str(), 0, 0, 0));
     module_loaded_ = true;
     CUDA_DRIVERAPI_ENFORCE(
         cuModuleGetFunction(&kernel_, module_, name.c_str()));
@@ -85,6 +71,18 @@ class CudaRTCFunction {
         kernel_, gx, gy, gz, bx, by, bz, shared_mem, stream, args_voidp, 0));
   }
 
+  // A Launch of a kernel whose parameters are only known at run time, a
+  // pointer to each of them in args.
+  void LaunchArgs(unsigned int gx, unsigned int gy, unsigned int gz,
+                  unsigned int bx, unsigned int by, unsigned int bz,
+                  unsigned int shared_mem, cudaStream_t stream,
+                  void** args) {
+    CAFFE_ENFORCE(
+        module_loaded_, "Cannot call Launch before a module is loaded.");
+    CUDA_DRIVERAPI_ENFORCE(cuLaunchKernel(
+        kernel_, gx, gy, gz, bx, by, bz, shared_mem, stream, args, 0));
+  }
+
   void LaunchEx(unsigned int gx, unsigned int gy, unsigned int gz,
                 unsigned int bx, unsigned int by, unsigned int bz,
                 unsigned int shared_mem, cudaStream_t stream,
@@ -0,0 +1,119 @@
+#include "caffe2/core/common_gpu.h"
+#include "caffe2/cuda_rtc/common_rtc.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+CAFFE2_DEFINE_string(
+    caffe2_cuda_rtc_cache_dir,
+    "",
+    "If set, an existing directory where the PTX of the NVRTC kernels that "
+    "are cached is saved, so that they are only compiled by the first run.");
+
+namespace caffe2 {
+
+namespace {
+
+string CompilePTX(const string& src) {
+  nvrtcProgram prog;
+  NVRTC_CHECK(nvrtcCreateProgram(
+      &prog, src.c_str(), nullptr, 0, nullptr, nullptr));
+  // Compile the program.
+  // TODO(Yangqing): how to find the current gpu architecture instead of hard
+  // coding it?
+  const char *nvrtc_opts[] = {"--gpu-architecture=compute_35",
+                              "--use_fast_math"};
+  nvrtcResult compile_result = nvrtcCompileProgram(
+      prog, 2, nvrtc_opts);
+  if (compile_result != NVRTC_SUCCESS) {
+    size_t log_size;
+    NVRTC_CHECK(nvrtcGetProgramLogSize(prog, &log_size));
+    vector<char> nvrtc_log(log_size);
+    NVRTC_CHECK(nvrtcGetProgramLog(prog, nvrtc_log.data()));
+    LOG(FATAL) << "Compilation failure for nvrtc("
+               << nvrtcGetErrorString(compile_result) << "): \n"
+               << nvrtc_log.data();
+  }
+  size_t ptx_size;
+  NVRTC_CHECK(nvrtcGetPTXSize(prog, &ptx_size));
+  vector<char> nvrtc_ptx(ptx_size);
+  NVRTC_CHECK(nvrtcGetPTX(prog, nvrtc_ptx.data()));
+  NVRTC_CHECK(nvrtcDestroyProgram(&prog));
+  // the size counts the terminating null
+  return string(nvrtc_ptx.data());
+}
+
+bool ReadFile(const string& path, string* contents) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+  std::stringstream ss;
+  ss << in.rdbuf();
+  *contents = ss.str();
+  return true;
+}
+
+// Writes to a file of its own first, so that other processes never read a
+// partial file.
+void WriteFile(const string& path, const string& contents) {
+  const string tmp = path + "." + std::to_string(getpid());
+  {
+    std::ofstream out(tmp, std::ios::binary);
+    out << contents;
+    if (!out) {
+      LOG(WARNING) << "Could not write " << tmp;
+      return;
+    }
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "Could not rename " << tmp << " to " << path;
+    std::remove(tmp.c_str());
+  }
+}
+
+} // namespace
+
+string CompileToPTX(const string& src, bool cache) {
+  if (!cache) {
+    return CompilePTX(src);
+  }
+  static std::mutex mutex;
+  static std::unordered_map<string, string> ptxs;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = ptxs.find(src);
+  if (it != ptxs.end()) {
+    return it->second;
+  }
+  const string& dir = FLAGS_caffe2_cuda_rtc_cache_dir;
+  string ptx;
+  if (dir.empty()) {
+    ptx = CompilePTX(src);
+  } else {
+    std::stringstream ss;
+    ss << dir << "/" << std::hex << std::hash<string>()(src);
+    const string path = ss.str();
+    // The source is kept next to its PTX for the hashes that collide. It is
+    // written last, so a matching source always has all of its PTX.
+    string cached_src;
+    if (ReadFile(path + ".cu", &cached_src) && cached_src == src &&
+        ReadFile(path + ".ptx", &ptx)) {
+      VLOG(1) << "PTX from " << path << ".ptx";
+    } else {
+      ptx = CompilePTX(src);
+      WriteFile(path + ".ptx", ptx);
+      WriteFile(path + ".cu", src);
+    }
+  }
+  ptxs[src] = ptx;
+  return ptx;
+}
+
+} // namespace caffe2
@@ -0,0 +1,211 @@
+#ifndef CAFFE2_CUDA_RTC_FUSED_POINTWISE_H_
+#define CAFFE2_CUDA_RTC_FUSED_POINTWISE_H_
+
+#include <string>
+#include <vector>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+// A step of a FusedPointwise op: one of Add, Sub, Mul, Div of two values,
+// or Relu, Scale (by scale) and StopGradient of one, b being -1.
+struct PointwiseStep {
+  std::string type;
+  int a;
+  int b;
+  float scale;
+};
+
+/**
+ * The program of a FusedPointwise op, the chain of pointwise ops it replaces.
+ *
+ * The values of the program are its inputs 0 .. num_inputs() - 1 followed by
+ * the results of its steps, the last of which is the output. An input is
+ * either of the shape of the output, or, with broadcast, of dims that are
+ * the dims of the output from axis on (-1 lining them up with its last dims,
+ * as for Add), e.g. the per-channel scale and bias of an AffineNd.
+ *
+ * It is kept in the arguments of the op, for the transform that builds it,
+ * the op and the gradient op that regenerate its kernels.
+ */
+class PointwiseProgram {
+ public:
+  PointwiseProgram() {}
+
+  static PointwiseProgram FromOperatorDef(const OperatorDef& def) {
+    ArgumentHelper args(def);
+    PointwiseProgram program;
+    program.broadcast_ = args.GetRepeatedArgument<int>("broadcast");
+    program.axes_ = args.GetRepeatedArgument<int>("axes");
+    const auto types = args.GetRepeatedArgument<std::string>("steps");
+    const auto operands = args.GetRepeatedArgument<int>("operands");
+    const auto scales = args.GetRepeatedArgument<float>("scales");
+    CAFFE_ENFORCE_EQ(program.broadcast_.size(), program.axes_.size());
+    CAFFE_ENFORCE_EQ(operands.size(), 2 * types.size());
+    CAFFE_ENFORCE_EQ(scales.size(), types.size());
+    CAFFE_ENFORCE(!types.empty(), "A FusedPointwise op needs a step");
+    for (size_t j = 0; j < types.size(); ++j) {
+      CAFFE_ENFORCE(
+          IsBinary(types[j]) || IsUnary(types[j]), "Not a step: ", types[j]);
+      program.steps_.push_back(
+          {types[j], operands[2 * j], operands[2 * j + 1], scales[j]});
+      const int result = program.num_inputs() + j;
+      CAFFE_ENFORCE(
+          operands[2 * j] >= 0 && operands[2 * j] < result &&
+              operands[2 * j + 1] < result,
+          "Step ",
+          j,
+          " reads a value it comes before");
+      CAFFE_ENFORCE_EQ(
+          operands[2 * j + 1] >= 0, IsBinary(types[j]), "Step ", j);
+    }
+    return program;
+  }
+
+  void AddArguments(OperatorDef* def) const {
+    std::vector<std::string> types;
+    std::vector<int> operands;
+    std::vector<float> scales;
+    for (const auto& step : steps_) {
+      types.push_back(step.type);
+      operands.push_back(step.a);
+      operands.push_back(step.b);
+      scales.push_back(step.scale);
+    }
+    def->add_arg()->CopyFrom(MakeArgument("broadcast", broadcast_));
+    def->add_arg()->CopyFrom(MakeArgument("axes", axes_));
+    def->add_arg()->CopyFrom(MakeArgument("steps", types));
+    def->add_arg()->CopyFrom(MakeArgument("operands", operands));
+    def->add_arg()->CopyFrom(MakeArgument("scales", scales));
+  }
+
+  static bool IsBinary(const std::string& type) {
+    return type == "Add" || type == "Sub" || type == "Mul" || type == "Div";
+  }
+
+  static bool IsUnary(const std::string& type) {
+    return type == "Relu" || type == "Scale" || type == "StopGradient";
+  }
+
+  // Returns the value of the new input.
+  int AddInput(const bool broadcast, const int axis) {
+    CAFFE_ENFORCE(steps_.empty(), "The inputs come before the steps");
+    broadcast_.push_back(broadcast);
+    axes_.push_back(broadcast ? axis : 0);
+    return num_inputs() - 1;
+  }
+
+  // Returns the value of the result of the new step.
+  int AddStep(
+      const std::string& type,
+      const int a,
+      const int b = -1,
+      const float scale = 1) {
+    CAFFE_ENFORCE(IsBinary(type) || IsUnary(type), "Not a step: ", type);
+    steps_.push_back({type, a, b, scale});
+    return num_values() - 1;
+  }
+
+  int num_inputs() const {
+    return broadcast_.size();
+  }
+  int num_values() const {
+    return num_inputs() + steps_.size();
+  }
+  int output() const {
+    return num_values() - 1;
+  }
+  bool broadcast(const int input) const {
+    return broadcast_[input];
+  }
+  int axis(const int input) const {
+    return axes_[input];
+  }
+  const std::vector<PointwiseStep>& steps() const {
+    return steps_;
+  }
+  const PointwiseStep& step(const int value) const {
+    return steps_[value - num_inputs()];
+  }
+
+  // Whether the gradient of the output flows back to each value and from it
+  // to an input, i.e. not only through a StopGradient.
+  std::vector<bool> ValuesWithGradient() const {
+    std::vector<bool> reaches_input(num_values(), true);
+    for (int v = num_inputs(); v < num_values(); ++v) {
+      const auto& s = step(v);
+      reaches_input[v] = s.type != "StopGradient" &&
+          (reaches_input[s.a] || (s.b >= 0 && reaches_input[s.b]));
+    }
+    std::vector<bool> reached(num_values(), false);
+    reached[output()] = true;
+    for (int v = output(); v >= num_inputs(); --v) {
+      const auto& s = step(v);
+      if (reached[v] && s.type != "StopGradient") {
+        reached[s.a] = true;
+        if (s.b >= 0) {
+          reached[s.b] = true;
+        }
+      }
+    }
+    std::vector<bool> with_gradient(num_values());
+    for (int v = 0; v < num_values(); ++v) {
+      with_gradient[v] = reached[v] && reaches_input[v];
+    }
+    return with_gradient;
+  }
+
+  std::vector<bool> InputsWithGradient() const {
+    const auto with_gradient = ValuesWithGradient();
+    return std::vector<bool>(
+        with_gradient.begin(), with_gradient.begin() + num_inputs());
+  }
+
+  // The values the gradient op computes again from its inputs: those the
+  // gradients of the steps use, and the values they are computed from. The
+  // output is not one of them, the gradient op reads it.
+  std::vector<bool> ValuesRecomputed() const {
+    const auto with_gradient = ValuesWithGradient();
+    std::vector<bool> needed(num_values(), false);
+    for (int v = num_inputs(); v < num_values(); ++v) {
+      const auto& s = step(v);
+      if (!with_gradient[v]) {
+        continue;
+      }
+      if (s.type == "Mul") {
+        needed[s.a] = needed[s.a] || with_gradient[s.b];
+        needed[s.b] = needed[s.b] || with_gradient[s.a];
+      } else if (s.type == "Div") {
+        needed[s.b] = true;
+        if (with_gradient[s.b]) {
+          needed[v] = true;
+        }
+      } else if (s.type == "Relu") {
+        needed[v] = true;
+      }
+    }
+    needed[output()] = false;
+    for (int v = output() - 1; v >= num_inputs(); --v) {
+      if (needed[v]) {
+        const auto& s = step(v);
+        needed[s.a] = true;
+        if (s.b >= 0) {
+          needed[s.b] = true;
+        }
+      }
+    }
+    return needed;
+  }
+
+ private:
+  std::vector<int> broadcast_;
+  std::vector<int> axes_;
+  std::vector<PointwiseStep> steps_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_CUDA_RTC_FUSED_POINTWISE_H_
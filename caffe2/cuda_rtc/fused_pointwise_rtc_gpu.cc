@@ -0,0 +1,576 @@
+#include <cstring>
+#include <sstream>
+
+#include "caffe2/core/common_gpu.h"
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/cuda_rtc/common_rtc.h"
+#include "caffe2/cuda_rtc/fused_pointwise.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+namespace {
+
+// the threads of a block of the gradient kernel that reduces the gradients
+// of the broadcast inputs, a power of 2
+constexpr int kPlaneThreads = 128;
+
+// The kernels are named the same in every module, so the sources of the ops
+// of the same program are the same, and their PTX cached.
+class FusedPointwiseRTCFunction
+    : public CudaRTCFunction<FusedPointwiseRTCFunction> {
+ public:
+  static constexpr bool kCachePTX = true;
+
+  string KernelName(const string& name, const string& /*src*/) {
+    return name;
+  }
+
+  string GetSource(const string& /*name*/, const string& src) {
+    return src;
+  }
+};
+
+string Value(const int v) {
+  return "v" + caffe2::to_string(v);
+}
+
+string Grad(const int v) {
+  return "g" + caffe2::to_string(v);
+}
+
+// the exact float, whatever its digits
+string FloatLiteral(const float f) {
+  int bits;
+  std::memcpy(&bits, &f, sizeof(bits));
+  std::stringstream ss;
+  ss << "__int_as_float(" << bits << ")";
+  return ss.str();
+}
+
+// Element i of input k: a broadcast input is repeated every count elements,
+// each of its elements for inner elements of the output.
+string Load(const PointwiseProgram& program, const int k) {
+  std::stringstream ss;
+  ss << "in" << k << "[";
+  if (program.broadcast(k)) {
+    ss << "(i / inner" << k << ") % count" << k;
+  } else {
+    ss << "i";
+  }
+  ss << "]";
+  return ss.str();
+}
+
+// The input parameters: the pointer to every input followed by its
+// broadcast shape, see BroadcastShapes. None of the pointers is __restrict__,
+// the output may be written in place of an input.
+void InputParams(const PointwiseProgram& program, std::stringstream* ss) {
+  for (int k = 0; k < program.num_inputs(); ++k) {
+    *ss << "    const float* in" << k << ",\n"
+        << "    const int inner" << k << ",\n"
+        << "    const int count" << k << ",\n";
+  }
+}
+
+// The statement that computes value v of the program, a step result.
+string StepStatement(const PointwiseProgram& program, const int v) {
+  const auto& s = program.step(v);
+  std::stringstream ss;
+  ss << "    const float " << Value(v) << " = ";
+  if (s.type == "Add") {
+    ss << Value(s.a) << " + " << Value(s.b);
+  } else if (s.type == "Sub") {
+    ss << Value(s.a) << " - " << Value(s.b);
+  } else if (s.type == "Mul") {
+    ss << Value(s.a) << " * " << Value(s.b);
+  } else if (s.type == "Div") {
+    ss << Value(s.a) << " / " << Value(s.b);
+  } else if (s.type == "Relu") {
+    ss << "fmaxf(" << Value(s.a) << ", 0.f)";
+  } else if (s.type == "Scale") {
+    ss << Value(s.a) << " * " << FloatLiteral(s.scale);
+  } else {
+    CAFFE_ENFORCE_EQ(s.type, "StopGradient");
+    ss << Value(s.a);
+  }
+  ss << ";\n";
+  return ss.str();
+}
+
+// The statements that add the gradient of value v to those of its operands
+// the gradient flows on from.
+string GradientStatements(
+    const PointwiseProgram& program,
+    const std::vector<bool>& with_gradient,
+    const int v) {
+  const auto& s = program.step(v);
+  const string g = Grad(v);
+  std::stringstream ss;
+  if (!with_gradient[v] || s.type == "StopGradient") {
+    return ss.str();
+  }
+  const bool da = with_gradient[s.a];
+  const bool db = s.b >= 0 && with_gradient[s.b];
+  if (s.type == "Add" || s.type == "Sub") {
+    if (da) {
+      ss << "    " << Grad(s.a) << " += " << g << ";\n";
+    }
+    if (db) {
+      ss << "    " << Grad(s.b) << (s.type == "Add" ? " += " : " -= ") << g
+         << ";\n";
+    }
+  } else if (s.type == "Mul") {
+    if (da) {
+      ss << "    " << Grad(s.a) << " += " << g << " * " << Value(s.b)
+         << ";\n";
+    }
+    if (db) {
+      ss << "    " << Grad(s.b) << " += " << g << " * " << Value(s.a)
+         << ";\n";
+    }
+  } else if (s.type == "Div") {
+    if (da) {
+      ss << "    " << Grad(s.a) << " += " << g << " / " << Value(s.b)
+         << ";\n";
+    }
+    if (db) {
+      ss << "    " << Grad(s.b) << " -= " << g << " * " << Value(v) << " / "
+         << Value(s.b) << ";\n";
+    }
+  } else if (s.type == "Relu") {
+    ss << "    " << Grad(s.a) << " += " << Value(v) << " > 0.f ? " << g
+       << " : 0.f;\n";
+  } else {
+    CAFFE_ENFORCE_EQ(s.type, "Scale");
+    ss << "    " << Grad(s.a) << " += " << g << " * "
+       << FloatLiteral(s.scale) << ";\n";
+  }
+  return ss.str();
+}
+
+// Y = the program of the inputs, a thread per element.
+string ForwardSource(const PointwiseProgram& program) {
+  std::stringstream ss;
+  ss << "extern \"C\" __global__ void fused_pointwise(\n"
+     << "    const int n,\n";
+  InputParams(program, &ss);
+  ss << "    float* out) {\n"
+     << "  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < n;\n"
+     << "       i += blockDim.x * gridDim.x) {\n";
+  for (int k = 0; k < program.num_inputs(); ++k) {
+    ss << "    const float " << Value(k) << " = " << Load(program, k)
+       << ";\n";
+  }
+  for (int v = program.num_inputs(); v < program.num_values(); ++v) {
+    ss << StepStatement(program, v);
+  }
+  ss << "    out[i] = " << Value(program.output()) << ";\n"
+     << "  }\n"
+     << "}\n";
+  return ss.str();
+}
+
+// The gradients of the inputs at element i, written to those of the output
+// shape and added to acc<k> for the broadcast ones.
+string GradientBody(const PointwiseProgram& program) {
+  const auto with_gradient = program.ValuesWithGradient();
+  const auto recomputed = program.ValuesRecomputed();
+  std::stringstream ss;
+  for (int k = 0; k < program.num_inputs(); ++k) {
+    if (recomputed[k]) {
+      ss << "    const float " << Value(k) << " = " << Load(program, k)
+         << ";\n";
+    }
+  }
+  for (int v = program.num_inputs(); v < program.output(); ++v) {
+    if (recomputed[v]) {
+      ss << StepStatement(program, v);
+    }
+  }
+  ss << "    const float " << Value(program.output()) << " = Y[i];\n";
+  for (int v = 0; v < program.output(); ++v) {
+    if (with_gradient[v]) {
+      ss << "    float " << Grad(v) << " = 0.f;\n";
+    }
+  }
+  ss << "    const float " << Grad(program.output()) << " = dY[i];\n";
+  for (int v = program.output(); v >= program.num_inputs(); --v) {
+    ss << GradientStatements(program, with_gradient, v);
+  }
+  for (int k = 0; k < program.num_inputs(); ++k) {
+    if (!with_gradient[k]) {
+      continue;
+    }
+    if (program.broadcast(k)) {
+      ss << "    acc" << k << " += " << Grad(k) << ";\n";
+    } else {
+      ss << "    d" << k << "[i] = " << Grad(k) << ";\n";
+    }
+  }
+  return ss.str();
+}
+
+// The gradient of every input, from dY, Y and the values the gradients of
+// the steps need, computed again from the inputs. The output is a sequence
+// of planes of plane_size elements. Every broadcast input with a gradient
+// has an element per plane, e.g. a channel, so a block sums the gradient of
+// a plane for all of them and adds the sums to their gradients, zeroed
+// first. Without them it is a thread per element.
+string GradientSource(const PointwiseProgram& program) {
+  const auto with_gradient = program.InputsWithGradient();
+  std::vector<int> reduced;
+  for (int k = 0; k < program.num_inputs(); ++k) {
+    if (with_gradient[k] && program.broadcast(k)) {
+      reduced.push_back(k);
+    }
+  }
+  std::stringstream ss;
+  ss << "extern \"C\" __global__ void fused_pointwise_gradient(\n"
+     << "    const int n,\n"
+     << "    const int plane_size,\n"
+     << "    const float* dY,\n"
+     << "    const float* Y,\n";
+  InputParams(program, &ss);
+  bool first = true;
+  for (int k = 0; k < program.num_inputs(); ++k) {
+    if (with_gradient[k]) {
+      ss << (first ? "" : ",\n") << "    float* d" << k;
+      first = false;
+    }
+  }
+  ss << ") {\n";
+  if (reduced.empty()) {
+    ss << "  for (int i = blockIdx.x * blockDim.x + threadIdx.x; i < n;\n"
+       << "       i += blockDim.x * gridDim.x) {\n"
+       << GradientBody(program)
+       << "  }\n"
+       << "}\n";
+    return ss.str();
+  }
+  ss << "  __shared__ float partial[" << reduced.size() << "]["
+     << kPlaneThreads << "];\n"
+     << "  const int planes = n / plane_size;\n"
+     << "  for (int p = blockIdx.x; p < planes; p += gridDim.x) {\n";
+  for (const int k : reduced) {
+    ss << "  float acc" << k << " = 0.f;\n";
+  }
+  ss << "  for (int j = threadIdx.x; j < plane_size; j += blockDim.x) {\n"
+     << "    const int i = p * plane_size + j;\n"
+     << GradientBody(program)
+     << "  }\n";
+  for (size_t r = 0; r < reduced.size(); ++r) {
+    ss << "  partial[" << r << "][threadIdx.x] = acc" << reduced[r] << ";\n";
+  }
+  ss << "  __syncthreads();\n"
+     << "  for (int s = blockDim.x / 2; s > 0; s >>= 1) {\n"
+     << "    if (threadIdx.x < s) {\n";
+  for (size_t r = 0; r < reduced.size(); ++r) {
+    ss << "      partial[" << r << "][threadIdx.x] += partial[" << r
+       << "][threadIdx.x + s];\n";
+  }
+  ss << "    }\n"
+     << "    __syncthreads();\n"
+     << "  }\n"
+     << "  if (threadIdx.x == 0) {\n";
+  for (size_t r = 0; r < reduced.size(); ++r) {
+    const int k = reduced[r];
+    ss << "    atomicAdd(&d" << k << "[p % count" << k << "], partial[" << r
+       << "][0]);\n";
+  }
+  ss << "  }\n"
+     << "  __syncthreads();\n"
+     << "  }\n"
+     << "}\n";
+  return ss.str();
+}
+
+// The broadcast shape of every input on an output of dims: matches the dims
+// of the inputs with the program and fills inner and count for the kernels.
+void BroadcastShapes(
+    const PointwiseProgram& program,
+    const std::vector<const TensorCUDA*>& inputs,
+    const std::vector<TIndex>& dims,
+    std::vector<int>* inner,
+    std::vector<int>* count) {
+  TIndex n = 1;
+  for (const TIndex d : dims) {
+    n *= d;
+  }
+  inner->resize(inputs.size());
+  count->resize(inputs.size());
+  for (size_t k = 0; k < inputs.size(); ++k) {
+    const auto& X = *inputs[k];
+    CAFFE_ENFORCE(X.IsType<float>(), "FusedPointwise only runs on float");
+    if (!program.broadcast(k)) {
+      CAFFE_ENFORCE_EQ(X.size(), n, "Input ", k, " is not of the output size");
+      (*inner)[k] = 1;
+      (*count)[k] = n;
+      continue;
+    }
+    const int ndim = X.ndim();
+    const int axis =
+        program.axis(k) == -1 ? dims.size() - ndim : program.axis(k);
+    CAFFE_ENFORCE(
+        axis >= 0 && axis + ndim <= static_cast<int>(dims.size()),
+        "Input ",
+        k,
+        " does not broadcast from axis ",
+        axis);
+    TIndex plane = 1;
+    for (int d = 0; d < ndim; ++d) {
+      CAFFE_ENFORCE_EQ(X.dim(d), dims[axis + d], "Input ", k, " dim ", d);
+    }
+    for (size_t d = axis + ndim; d < dims.size(); ++d) {
+      plane *= dims[d];
+    }
+    (*inner)[k] = plane;
+    (*count)[k] = X.size();
+  }
+}
+
+} // namespace
+
+/**
+ * Runs the chain of pointwise ops of the program in its arguments, see
+ * PointwiseProgram, as one kernel generated and compiled with NVRTC, with
+ * the PTX cached in caffe2_cuda_rtc_cache_dir. The FusePointwise transform
+ * makes them.
+ */
+class FusedPointwiseRTCOp final : public Operator<CUDAContext> {
+ public:
+  FusedPointwiseRTCOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CUDAContext>(operator_def, ws),
+        program_(PointwiseProgram::FromOperatorDef(operator_def)) {
+    CAFFE_ENFORCE_EQ(InputSize(), program_.num_inputs());
+    full_input_ = -1;
+    for (int k = 0; k < InputSize() && full_input_ < 0; ++k) {
+      if (!program_.broadcast(k)) {
+        full_input_ = k;
+      }
+    }
+    CAFFE_ENFORCE_GE(full_input_, 0, "An input must be of the output shape");
+    func_.Compile(string("fused_pointwise"), ForwardSource(program_));
+  }
+
+  bool RunOnDevice() override {
+    const auto& X = Input(full_input_);
+    CAFFE_ENFORCE_LT(X.size(), std::numeric_limits<int>::max());
+    const int n = X.size();
+    std::vector<const TensorCUDA*> inputs;
+    for (int k = 0; k < InputSize(); ++k) {
+      inputs.push_back(&Input(k));
+    }
+    std::vector<int> inner, count;
+    BroadcastShapes(program_, inputs, X.dims(), &inner, &count);
+    auto* Y = Output(0);
+    Y->Resize(X.dims());
+    float* Ydata = Y->mutable_data<float>();
+    if (n == 0) {
+      return true;
+    }
+    std::vector<const float*> data;
+    for (int k = 0; k < InputSize(); ++k) {
+      data.push_back(Input(k).data<float>());
+    }
+    std::vector<void*> args{const_cast<int*>(&n)};
+    for (int k = 0; k < InputSize(); ++k) {
+      args.push_back(&data[k]);
+      args.push_back(&inner[k]);
+      args.push_back(&count[k]);
+    }
+    args.push_back(&Ydata);
+    func_.LaunchArgs(
+        CAFFE_GET_BLOCKS(n),
+        1,
+        1,
+        CAFFE_CUDA_NUM_THREADS,
+        1,
+        1,
+        0,
+        context_.cuda_stream(),
+        args.data());
+    return true;
+  }
+
+ private:
+  PointwiseProgram program_;
+  int full_input_;
+  FusedPointwiseRTCFunction func_;
+};
+
+// Inputs: dY, Y and the inputs of the FusedPointwise op; outputs the
+// gradient of every input the gradient flows back to.
+class FusedPointwiseRTCGradientOp final : public Operator<CUDAContext> {
+ public:
+  FusedPointwiseRTCGradientOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CUDAContext>(operator_def, ws),
+        program_(PointwiseProgram::FromOperatorDef(operator_def)),
+        with_gradient_(program_.InputsWithGradient()) {
+    CAFFE_ENFORCE_EQ(InputSize(), program_.num_inputs() + 2);
+    int num_gradients = 0;
+    for (int k = 0; k < program_.num_inputs(); ++k) {
+      if (with_gradient_[k]) {
+        ++num_gradients;
+      }
+    }
+    CAFFE_ENFORCE_GT(num_gradients, 0);
+    CAFFE_ENFORCE_EQ(OutputSize(), num_gradients);
+    func_.Compile(
+        string("fused_pointwise_gradient"), GradientSource(program_));
+  }
+
+  bool RunOnDevice() override {
+    const auto& dY = Input(0);
+    const auto& Y = Input(1);
+    CAFFE_ENFORCE_EQ(dY.size(), Y.size());
+    CAFFE_ENFORCE_LT(Y.size(), std::numeric_limits<int>::max());
+    const int n = Y.size();
+    std::vector<const TensorCUDA*> inputs;
+    for (int k = 0; k < program_.num_inputs(); ++k) {
+      inputs.push_back(&Input(k + 2));
+    }
+    std::vector<int> inner, count;
+    BroadcastShapes(program_, inputs, Y.dims(), &inner, &count);
+
+    // the planes are the elements of the broadcast inputs with a gradient
+    int plane_size = 1;
+    bool reduced = false;
+    std::vector<float*> gradients;
+    int out = 0;
+    for (int k = 0; k < program_.num_inputs(); ++k) {
+      if (!with_gradient_[k]) {
+        continue;
+      }
+      auto* dX = Output(out++);
+      dX->ResizeLike(*inputs[k]);
+      gradients.push_back(dX->mutable_data<float>());
+      if (program_.broadcast(k)) {
+        CAFFE_ENFORCE(
+            !reduced || inner[k] == plane_size,
+            "The broadcast inputs with a gradient should broadcast alike");
+        plane_size = inner[k];
+        reduced = true;
+        math::Set<float, CUDAContext>(
+            dX->size(), 0, gradients.back(), &context_);
+      }
+    }
+    if (n == 0) {
+      return true;
+    }
+    const float* dYdata = dY.data<float>();
+    const float* Ydata = Y.data<float>();
+    std::vector<const float*> data;
+    for (const auto* X : inputs) {
+      // an input the output was written over is not read, see
+      // PointwiseProgram::ValuesRecomputed
+      data.push_back(X->data<float>());
+    }
+    std::vector<void*> args{
+        const_cast<int*>(&n), &plane_size, &dYdata, &Ydata};
+    for (int k = 0; k < program_.num_inputs(); ++k) {
+      args.push_back(&data[k]);
+      args.push_back(&inner[k]);
+      args.push_back(&count[k]);
+    }
+    for (auto& gradient : gradients) {
+      args.push_back(&gradient);
+    }
+    const int planes = n / plane_size;
+    if (reduced) {
+      func_.LaunchArgs(
+          std::min(planes, CAFFE_MAXIMUM_NUM_BLOCKS),
+          1,
+          1,
+          kPlaneThreads,
+          1,
+          1,
+          0,
+          context_.cuda_stream(),
+          args.data());
+    } else {
+      // a thread per element
+      func_.LaunchArgs(
+          CAFFE_GET_BLOCKS(n),
+          1,
+          1,
+          CAFFE_CUDA_NUM_THREADS,
+          1,
+          1,
+          0,
+          context_.cuda_stream(),
+          args.data());
+    }
+    return true;
+  }
+
+ private:
+  PointwiseProgram program_;
+  std::vector<bool> with_gradient_;
+  FusedPointwiseRTCFunction func_;
+};
+
+namespace {
+
+REGISTER_CUDA_OPERATOR_WITH_ENGINE(
+    FusedPointwise,
+    NVRTC,
+    FusedPointwiseRTCOp);
+REGISTER_CUDA_OPERATOR_WITH_ENGINE(
+    FusedPointwiseGradient,
+    NVRTC,
+    FusedPointwiseRTCGradientOp);
+
+OPERATOR_SCHEMA(FusedPointwise)
+    .NumInputs(1, INT_MAX)
+    .NumOutputs(1)
+    .SetDoc(R"DOC(
+Computes a chain of pointwise ops in one NVRTC kernel (engine NVRTC, CUDA
+only), e.g. an AffineNd and the Relu after it, without writing and reading
+back the values in between. The FusePointwise transform replaces the chains
+of a net with them.
+
+The chain is kept in the arguments: the inputs, each either of the shape of
+the output or, with broadcast, of dims that are those of the output from
+axes on (-1 for its last dims), and the steps, each one of Add, Sub, Mul,
+Div, Relu, Scale and StopGradient of the values before it, the values being
+the inputs followed by the results of the steps. The output is the result of
+the last step.
+
+The gradient is one more generated kernel, which computes the values the
+gradients of the steps need again from the inputs and the output, and sums
+the gradients of the broadcast inputs.
+)DOC")
+    .Arg("broadcast", "for every input, 1 if it is broadcast, else 0")
+    .Arg("axes", "for every broadcast input, the first axis it matches")
+    .Arg("steps", "the type of every step")
+    .Arg("operands", "the two values of every step, -1 for one")
+    .Arg("scales", "the scale of every step, used by Scale");
+
+OPERATOR_SCHEMA(FusedPointwiseGradient).NumInputs(3, INT_MAX).NumOutputs(0, INT_MAX);
+
+class GetFusedPointwiseGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    const auto with_gradient =
+        PointwiseProgram::FromOperatorDef(def_).InputsWithGradient();
+    vector<string> inputs{GO(0), O(0)};
+    vector<string> outputs;
+    for (int k = 0; k < def_.input_size(); ++k) {
+      inputs.push_back(I(k));
+      if (with_gradient[k]) {
+        outputs.push_back(GI(k));
+      }
+    }
+    if (outputs.empty()) {
+      return {};
+    }
+    return SingleGradientDef("FusedPointwiseGradient", "", inputs, outputs);
+  }
+};
+REGISTER_GRADIENT(FusedPointwise, GetFusedPointwiseGradient);
+
+} // namespace
+
+} // namespace caffe2
@@ -3,7 +3,68 @@
 namespace caffe2 {
 REGISTER_CPU_OPERATOR(CreateDB, CreateDBOp<CPUContext>);
 
-OPERATOR_SCHEMA(CreateDB).NumInputs(0).NumOutputs(1);
+OPERATOR_SCHEMA(CreateDB)
+    .NumInputs(0)
+    .NumOutputs(1)
+    .SetDoc(R"DOC(
+Opens a db and outputs a DBReader of it, for the input ops to read from.
+)DOC")
+    .Arg("db_type", "(string, default 'leveldb') the type of the db")
+    .Arg("db", "(string) the db to open")
+    .Arg("num_shards", "(int, default 1) the number of shards of the db")
+    .Arg("shard_id", "(int, default 0) the shard that the reader reads")
+    .Arg(
+        "shuffle",
+        "(bool, default false) read the records in a new random order "
+        "every epoch; see DBReader::Shuffle")
+    .Arg("shuffle_seed", "(int, default 0) the seed of the order")
+    .Arg(
+        "shuffle_buffer",
+        "(int, default 10000) the records buffered to shuffle a db that "
+        "cannot seek");
+
+REGISTER_CPU_OPERATOR(DBReaderPosition, DBReaderPositionOp);
+
+OPERATOR_SCHEMA(DBReaderPosition)
+    .NumInputs(1, 2)
+    .NumOutputs(1)
+    .SetDoc(R"DOC(
+Outputs the position of a DBReader as an int64 tensor of its shuffle seed (-1
+if it is not shuffled), epoch and offset in the records of its shard in the
+order of the epoch, e.g. to save with a checkpoint. With records, the
+position after reading that many records from the position of the second
+input, or from the start of the first epoch, without reading them; the input
+ops read ahead of the batches that the net has taken, so this is the
+position to resume the batches from.
+)DOC")
+    .Arg(
+        "records",
+        "(int64, default -1) the records read so far, -1 for the current "
+        "position of the reader")
+    .Input(0, "reader", "the DBReader")
+    .Input(
+        1,
+        "start",
+        "(optional) the position that the records were read from, e.g. the "
+        "one the reader was seeked to")
+    .Output(0, "position", "the int64 tensor (shuffle seed, epoch, offset)");
+
+REGISTER_CPU_OPERATOR(SeekDBReader, SeekDBReaderOp);
+
+OPERATOR_SCHEMA(SeekDBReader)
+    .NumInputs(2)
+    .NumOutputs(0)
+    .SetDoc(R"DOC(
+Moves a DBReader to a position of DBReaderPosition, e.g. the one of the
+checkpoint that a job resumes from, so that it goes on with the records that
+it would have read next, in the same order. A db that can seek gets there in
+one seek, through the index of its keys. The reader has to have the shuffle
+seed of the position, and no shuffle buffer.
+)DOC")
+    .Input(0, "reader", "the DBReader")
+    .Input(1, "position", "the int64 tensor (shuffle seed, epoch, offset)");
 
 NO_GRADIENT(CreateDB);
+NO_GRADIENT(DBReaderPosition);
+NO_GRADIENT(SeekDBReader);
 }  // namespace caffe2
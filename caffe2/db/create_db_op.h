@@ -19,13 +19,23 @@ class CreateDBOp final : public Operator<Context> {
         num_shards_(
             OperatorBase::template GetSingleArgument<int>("num_shards", 1)),
         shard_id_(
-            OperatorBase::template GetSingleArgument<int>("shard_id", 0)) {
+            OperatorBase::template GetSingleArgument<int>("shard_id", 0)),
+        shuffle_(
+            OperatorBase::template GetSingleArgument<bool>("shuffle", false)),
+        shuffle_seed_(
+            OperatorBase::template GetSingleArgument<int>("shuffle_seed", 0)),
+        shuffle_buffer_(OperatorBase::template GetSingleArgument<int>(
+            "shuffle_buffer",
+            10000)) {
     CAFFE_ENFORCE_GT(db_name_.size(), 0, "Must specify a db name.");
   }
 
   bool RunOnDevice() final {
-    OperatorBase::Output<db::DBReader>(0)->Open(
-        db_type_, db_name_, num_shards_, shard_id_);
+    auto* reader = OperatorBase::Output<db::DBReader>(0);
+    reader->Open(db_type_, db_name_, num_shards_, shard_id_);
+    if (shuffle_) {
+      reader->Shuffle(shuffle_seed_, shuffle_buffer_);
+    }
     return true;
   }
 
@@ -34,9 +44,79 @@ class CreateDBOp final : public Operator<Context> {
   string db_name_;
   uint32_t num_shards_;
   uint32_t shard_id_;
+  bool shuffle_;
+  int shuffle_seed_;
+  int shuffle_buffer_;
   DISABLE_COPY_AND_ASSIGN(CreateDBOp);
 };
 
+// The position (shuffle seed, epoch, offset) of a DBReader, see
+// DBReader::GetPosition, or with records >= 0 the one after reading records
+// records from the position of input 1, if any, or from the beginning of
+// the first epoch, worked out without reading.
+class DBReaderPositionOp final : public Operator<CPUContext> {
+ public:
+  DBReaderPositionOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws),
+        records_(GetSingleArgument<int64_t>("records", -1)) {}
+
+  bool RunOnDevice() final {
+    const auto& reader = OperatorBase::Input<db::DBReader>(0);
+    int epoch = 0;
+    size_t offset = 0;
+    if (records_ < 0) {
+      reader.GetPosition(&epoch, &offset);
+    } else {
+      const int64_t shard_size = reader.ShardSize();
+      CAFFE_ENFORCE_GT(shard_size, 0, "The shard of the reader is empty.");
+      int64_t records = records_;
+      if (InputSize() > 1) {
+        const auto& base = Input(1);
+        CAFFE_ENFORCE_EQ(base.size(), 3);
+        const int64_t* data = base.data<int64_t>();
+        CAFFE_ENFORCE_EQ(
+            data[0],
+            reader.ShuffleSeed(),
+            "The position is of a reader with another shuffle seed.");
+        records += data[1] * shard_size + data[2];
+      }
+      epoch = records / shard_size;
+      offset = records % shard_size;
+    }
+    auto* position = Output(0);
+    position->Resize(3);
+    int64_t* data = position->mutable_data<int64_t>();
+    data[0] = reader.ShuffleSeed();
+    data[1] = epoch;
+    data[2] = offset;
+    return true;
+  }
+
+ private:
+  int64_t records_;
+};
+
+// Moves a DBReader to a position of DBReaderPosition, in one seek if the db
+// can seek, see DBReader::SeekToPosition.
+class SeekDBReaderOp final : public Operator<CPUContext> {
+ public:
+  SeekDBReaderOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws) {}
+
+  bool RunOnDevice() final {
+    const auto& reader = OperatorBase::Input<db::DBReader>(0);
+    const auto& position = Input(1);
+    CAFFE_ENFORCE_EQ(position.size(), 3);
+    const int64_t* data = position.data<int64_t>();
+    CAFFE_ENFORCE_EQ(
+        data[0],
+        reader.ShuffleSeed(),
+        "The position is of a reader with another shuffle seed.");
+    reader.SeekToPosition(data[1], data[2]);
+    return true;
+  }
+};
+
 } // namespace caffe2
 
 #endif // CAFFE2_DB_CREATE_DB_OP_H_
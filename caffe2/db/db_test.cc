@@ -151,6 +151,58 @@ TEST(DBReaderTest, Reader) {
   EXPECT_EQ(keys_set.size(), kMaxItems);
 }
 
+TEST(DBReaderTest, ReadView) {
+  for (const string db_type : {"lmdb", "leveldb"}) {
+    std::string name = std::tmpnam(nullptr);
+    if (!CreateAndFill(db_type, name)) {
+      EXPECT_TRUE(0);
+      continue;
+    }
+    DBReader reader(db_type, name);
+    string key;
+    string buffer;
+    const char* data = nullptr;
+    size_t size = 0;
+    reader.ReadView(&key, &buffer, &data, &size);
+    EXPECT_EQ(key, "00");
+    EXPECT_EQ(string(data, size), "00");
+    const char* first_data = data;
+    reader.ReadView(&key, &buffer, &data, &size);
+    EXPECT_EQ(key, "01");
+    EXPECT_EQ(string(data, size), "01");
+    if (db_type == "lmdb") {
+      // views into the db stay valid while the reader is open
+      EXPECT_TRUE(buffer.empty());
+      EXPECT_EQ(string(first_data, 2), "00");
+    } else {
+      EXPECT_EQ(buffer, "01");
+    }
+  }
+}
+
+TEST(DBReaderTest, ReadBatch) {
+  std::string name = std::tmpnam(nullptr);
+  CreateAndFill("leveldb", name);
+  DBReader reader("leveldb", name);
+  std::vector<string> keys;
+  std::vector<string> values;
+  reader.ReadBatch(4, &keys, &values);
+  EXPECT_EQ(keys, std::vector<string>({"00", "01", "02", "03"}));
+  EXPECT_EQ(values, keys);
+  // batches wrap around the end of the db like single reads
+  reader.ReadBatch(kMaxItems, &keys, &values);
+  EXPECT_EQ(keys[5], "09");
+  EXPECT_EQ(keys[6], "00");
+
+  string view_keys[2];
+  string buffers[2];
+  const char* data[2];
+  size_t sizes[2];
+  reader.ReadViewBatch(2, view_keys, buffers, data, sizes);
+  EXPECT_EQ(view_keys[1], "05");
+  EXPECT_EQ(string(data[1], sizes[1]), "05");
+}
+
 TEST(DBReaderShardedTest, Reader) {
   std::string name = std::tmpnam(nullptr);
   CreateAndFill("leveldb", name);
@@ -196,5 +248,181 @@ TEST(DBReaderShardedTest, Reader) {
   EXPECT_EQ(value, "05");
 }
 
+TEST(DBReaderShardedTest, Reshard) {
+  for (const string db_type : {"lmdb", "leveldb"}) {
+    std::string name = std::tmpnam(nullptr);
+    if (!CreateAndFill(db_type, name)) {
+      EXPECT_TRUE(0);
+      continue;
+    }
+    DBReader reader(db_type, name, 4, 3);
+    string key;
+    string value;
+    for (const string expected : {"03", "07", "03"}) {
+      reader.Read(&key, &value);
+      EXPECT_EQ(key, expected);
+      EXPECT_EQ(value, expected);
+    }
+    // a new layout starts from the first record of the new shard
+    reader.Reshard(3, 1);
+    for (const string expected : {"01", "04", "07", "01"}) {
+      reader.Read(&key, &value);
+      EXPECT_EQ(key, expected);
+    }
+    reader.Reshard(1, 0);
+    for (const string expected : {"00", "01"}) {
+      reader.Read(&key, &value);
+      EXPECT_EQ(key, expected);
+    }
+    EXPECT_THROW(reader.Reshard(11, 10), EnforceNotMet);
+  }
+}
+
+TEST(DBReaderShardedTest, OpenPart) {
+  std::string name = std::tmpnam(nullptr);
+  if (!CreateAndFill("lmdb", name)) {
+    EXPECT_TRUE(0);
+    return;
+  }
+  DBReader reader("lmdb", name, 2, 1);
+  std::unique_ptr<DBReader> parts[2] = {reader.OpenPart(2, 0),
+                                        reader.OpenPart(2, 1)};
+  // the parts read at the same time, each with a cursor of its own
+  std::vector<string> keys[2];
+  std::vector<std::thread> threads;
+  for (int p = 0; p < 2; ++p) {
+    threads.emplace_back([&, p]() {
+      string key;
+      string buffer;
+      const char* data;
+      size_t size;
+      for (int i = 0; i < 3; ++i) {
+        parts[p]->ReadView(&key, &buffer, &data, &size);
+        EXPECT_EQ(string(data, size), key);
+        keys[p].push_back(key);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(keys[0], std::vector<string>({"01", "05", "09"}));
+  EXPECT_EQ(keys[1], std::vector<string>({"03", "07", "03"}));
+  EXPECT_THROW(reader.OpenPart(2, 2), EnforceNotMet);
+}
+
+TEST(DBReaderShardedTest, Shuffle) {
+  for (const string db_type : {"lmdb", "leveldb"}) {
+    std::string name = std::tmpnam(nullptr);
+    if (!CreateAndFill(db_type, name)) {
+      EXPECT_TRUE(0);
+      continue;
+    }
+    // the shards of the same seed split every epoch between them
+    DBReader reader0(db_type, name, 2, 0);
+    DBReader reader1(db_type, name, 2, 1);
+    reader0.Shuffle(7, 0);
+    reader1.Shuffle(7, 0);
+    string key;
+    string value;
+    std::vector<string> epochs[2];
+    for (int epoch = 0; epoch < 2; ++epoch) {
+      for (int i = 0; i < kMaxItems / 2; ++i) {
+        reader0.Read(&key, &value);
+        EXPECT_EQ(key, value);
+        epochs[epoch].push_back(key);
+        reader1.Read(&key, &value);
+        epochs[epoch].push_back(key);
+      }
+      std::set<string> keys(epochs[epoch].begin(), epochs[epoch].end());
+      EXPECT_EQ(keys.size(), kMaxItems);
+    }
+    EXPECT_NE(epochs[0], epochs[1]);
+  }
+}
+
+TEST(DBReaderShardedTest, Position) {
+  // lmdb, which lets the three readers open the db at the same time
+  const string db_type = "lmdb";
+  std::string name = std::tmpnam(nullptr);
+  if (!CreateAndFill(db_type, name)) {
+    EXPECT_TRUE(0);
+    return;
+  }
+  std::unique_ptr<DBReader> reader(new DBReader(db_type, name, 2, 1));
+  reader->Shuffle(7, 0);
+  EXPECT_EQ(reader->ShardSize(), kMaxItems / 2);
+  EXPECT_EQ(reader->ShuffleSeed(), 7);
+  string key;
+  string value;
+  // into the second epoch
+  for (int i = 0; i < kMaxItems / 2 + 2; ++i) {
+    reader->Read(&key, &value);
+  }
+  int epoch = -1;
+  size_t offset = 0;
+  reader->GetPosition(&epoch, &offset);
+  EXPECT_EQ(epoch, 1);
+  EXPECT_EQ(offset, 2u);
+
+  // a new reader of the shard seeks to the position
+  DBReader resumed(db_type, name, 2, 1);
+  resumed.Shuffle(7, 0);
+  resumed.SeekToPosition(epoch, offset);
+  // and so does a deserialized one
+  Blob reader_blob;
+  reader_blob.Reset(reader.release());
+  std::string str = reader_blob.Serialize("saved_reader");
+  Blob restored_blob;
+  EXPECT_NO_THROW(restored_blob.Deserialize(str));
+  const DBReader& restored = restored_blob.Get<DBReader>();
+  restored.GetPosition(&epoch, &offset);
+  EXPECT_EQ(epoch, 1);
+  EXPECT_EQ(offset, 2u);
+
+  // the rest of the epoch and the next one
+  const DBReader& original = reader_blob.Get<DBReader>();
+  string resumed_key;
+  string restored_key;
+  for (int i = 0; i < kMaxItems; ++i) {
+    original.Read(&key, &value);
+    resumed.Read(&resumed_key, &value);
+    restored.Read(&restored_key, &value);
+    EXPECT_EQ(resumed_key, key);
+    EXPECT_EQ(restored_key, key);
+  }
+  // the end of the shard is the start of the next epoch
+  resumed.SeekToPosition(3, kMaxItems / 2);
+  resumed.GetPosition(&epoch, &offset);
+  EXPECT_EQ(epoch, 4);
+  EXPECT_EQ(offset, 0u);
+  EXPECT_THROW(resumed.SeekToPosition(3, kMaxItems / 2 + 1), EnforceNotMet);
+}
+
+TEST(DBReaderTest, PositionWithoutShards) {
+  std::string name = std::tmpnam(nullptr);
+  CreateAndFill("leveldb", name);
+  string key;
+  string value;
+  int epoch = -1;
+  size_t offset = 0;
+  {
+    DBReader reader("leveldb", name);
+    for (int i = 0; i < kMaxItems + 3; ++i) {
+      reader.Read(&key, &value);
+    }
+    reader.GetPosition(&epoch, &offset);
+    EXPECT_EQ(epoch, 1);
+    EXPECT_EQ(offset, 3u);
+    EXPECT_EQ(reader.ShuffleSeed(), -1);
+    EXPECT_EQ(reader.ShardSize(), kMaxItems);
+  }
+  // seeking indexes the keys of the db
+  DBReader resumed("leveldb", name);
+  resumed.SeekToPosition(epoch, offset);
+  resumed.Read(&key, &value);
+  EXPECT_EQ(key, "03");
+}
+
 }  // namespace db
 }  // namespace caffe2
@@ -68,6 +68,14 @@ class LMDBCursor : public Cursor {
         mdb_value_.mv_size);
   }
 
+  // The read-only transaction of the cursor lives as long as the cursor,
+  // and keeps the pages of the memory map it has returned valid.
+  bool ValueView(const char** data, size_t* size) override {
+    *data = static_cast<const char*>(mdb_value_.mv_data);
+    *size = mdb_value_.mv_size;
+    return true;
+  }
+
   bool Valid() override { return valid_; }
 
  private:
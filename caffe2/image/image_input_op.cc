@@ -86,8 +86,16 @@ The dimension of the output image will always be cropxcrop
     .Arg("use_caffe_datum", "1 if the input is in Caffe format. Defaults to 0")
     .Arg("use_gpu_transform", "1 if GPU acceleration should be used."
          " Defaults to 0. Can only be 1 in a CUDAContext")
+    .Arg("partial_jpeg_decode", "1 to decode only the crop of JPEG images, "
+         "at a DCT scaling (1/8, 1/4, 1/2) close to the size it is resized "
+         "to. Needs Caffe2 built with USE_LIBJPEG_TURBO. Defaults to 0")
     .Arg("decode_threads", "Number of CPU decode/transform threads."
          " Defaults to 4")
+    .Arg("use_work_stealing_pool", "1 to run the decode threads as a "
+         "work-stealing pool with per-thread queues. Defaults to 0")
+    .Arg("use_cpu_budget_pool", "1 to decode on the process-wide CPU budget "
+         "pool, within its decode share, instead of decode_threads threads "
+         "of our own. Defaults to 0")
     .Arg("output_type", "If gpu_transform, can set to FLOAT or FLOAT16.")
     .Arg("db", "Name of the database (if not passed as input)")
     .Arg("db_type", "Type of database (if not passed as input)."
@@ -97,6 +105,8 @@ The dimension of the output image will always be cropxcrop
          "outputs)")
     .Arg("random_scale", "[min, max] shortest-side desired for image resize. "
          "Defaults to [-1, -1] or no random resize desired.")
+    .Arg("prefetch_depth", "Number of batches prefetched ahead of the "
+         "operator. Defaults to 1")
     .Input(0, "reader", "The input reader (a db::DBReader)")
     .Output(0, "data", "Tensor containing the images")
     .Output(1, "label", "Tensor containing the labels")
@@ -6,13 +6,17 @@
 
 #include <iostream>
 #include <algorithm>
+#include <limits>
 
 #include "caffe/proto/caffe.pb.h"
 #include "caffe2/core/db.h"
 #include "caffe2/utils/cast.h"
 #include "caffe2/utils/math.h"
+#include "caffe2/utils/cpu_budget_pool.h"
 #include "caffe2/utils/thread_pool.h"
+#include "caffe2/utils/work_stealing_thread_pool.h"
 #include "caffe2/operators/prefetch_op.h"
+#include "caffe2/image/jpeg_crop_decoder.h"
 #include "caffe2/image/transform_gpu.h"
 
 namespace caffe2 {
@@ -52,6 +56,7 @@ class ImageInputOp final
                                     Workspace* ws);
   ~ImageInputOp() {
     PrefetchOperator<Context>::Finalize();
+    decode_tasks_.Wait();
   }
 
   bool Prefetch() override;
@@ -76,6 +81,9 @@ class ImageInputOp final
   bool GetImageAndLabelAndInfoFromDBValue(
       const string& value, cv::Mat* img, PerImageArg& info, int item_id,
       std::mt19937* randgen);
+  bool DecodeJpegForTransform(
+      const char* data, size_t size, PerImageArg& info,
+      std::mt19937* randgen, cv::Mat* src, bool* inception_scale_jitter);
   void DecodeAndTransform(
       const std::string& value, float *image_data, int item_id,
       const int channels, std::size_t thread_index);
@@ -83,6 +91,18 @@ class ImageInputOp final
       const std::string& value, uint8_t *image_data, int item_id,
       const int channels, std::size_t thread_index);
 
+  template <typename Task>
+  void RunDecodeTask(Task task) {
+    if (cpu_budget_pool_) {
+      cpu_budget_pool_->RunTaskWithID(
+          CpuConsumer::kDecode, task, &decode_tasks_);
+    } else if (use_work_stealing_pool_) {
+      work_stealing_pool_->runTaskWithID(task);
+    } else {
+      thread_pool_->runTaskWithID(task);
+    }
+  }
+
   unique_ptr<db::DBReader> owned_reader_;
   const db::DBReader* reader_;
   CPUContext cpu_context_;
@@ -92,6 +112,18 @@ class ImageInputOp final
   Tensor<Context> prefetched_image_on_device_;
   Tensor<Context> prefetched_label_on_device_;
   vector<Tensor<Context>> prefetched_additional_outputs_on_device_;
+  // One finished batch per prefetch slot. Prefetch() fills the tensors
+  // above and swaps them into its slot, so the decoders keep writing to the
+  // same members whatever the prefetch depth is.
+  struct PrefetchedBatch {
+    TensorCPU image;
+    TensorCPU label;
+    vector<TensorCPU> additional_outputs;
+    Tensor<Context> image_on_device;
+    Tensor<Context> label_on_device;
+    vector<Tensor<Context>> additional_outputs_on_device;
+  };
+  vector<PrefetchedBatch> prefetched_batches_;
   // Default parameters for images
   PerImageArg default_arg_;
   int batch_size_;
@@ -123,13 +155,23 @@ class ImageInputOp final
   bool is_test_;
   bool use_caffe_datum_;
   bool gpu_transform_;
+  // decode only the crop of JPEGs with libjpeg-turbo, at a DCT scaling close
+  // to the size it is resized to
+  bool partial_jpeg_decode_;
   bool mean_std_copied_ = false;
 
   // thread pool for parse + decode
   int num_decode_threads_;
   int additional_inputs_offset_;
   int additional_inputs_count_;
+  // run the decode tasks on the process-wide CpuBudgetPool of the NUMA node
+  // of the device option instead, num_decode_threads_ being its size
+  std::shared_ptr<CpuBudgetPool> cpu_budget_pool_;
+  CpuTaskGroup decode_tasks_;
+  // run the decode tasks on a WorkStealingThreadPool instead
+  bool use_work_stealing_pool_;
   std::shared_ptr<TaskThreadPool> thread_pool_;
+  std::shared_ptr<WorkStealingThreadPool> work_stealing_pool_;
 
   // Output type for GPU transform path
   TensorProto_DataType output_type_;
@@ -151,6 +193,7 @@ ImageInputOp<Context>::ImageInputOp(
       reader_(nullptr),
       prefetched_additional_outputs_(OutputSize() - 2),
       prefetched_additional_outputs_on_device_(OutputSize() - 2),
+      prefetched_batches_(this->prefetch_depth_),
       batch_size_(
           OperatorBase::template GetSingleArgument<int>("batch_size", 0)),
       label_type_(static_cast<LABEL_TYPE>(
@@ -190,14 +233,36 @@ ImageInputOp<Context>::ImageInputOp(
       gpu_transform_(OperatorBase::template GetSingleArgument<int>(
           "use_gpu_transform",
           0)),
+      partial_jpeg_decode_(OperatorBase::template GetSingleArgument<int>(
+          "partial_jpeg_decode",
+          0)),
       num_decode_threads_(
           OperatorBase::template GetSingleArgument<int>("decode_threads", 4)),
-      thread_pool_(std::make_shared<TaskThreadPool>(num_decode_threads_)),
+      cpu_budget_pool_(
+          OperatorBase::template GetSingleArgument<int>(
+              "use_cpu_budget_pool",
+              0)
+              ? GetCpuBudgetPool(operator_def.device_option().numa_node_id())
+              : nullptr),
+      use_work_stealing_pool_(OperatorBase::template GetSingleArgument<int>(
+          "use_work_stealing_pool",
+          0)),
+      thread_pool_(
+          use_work_stealing_pool_ || cpu_budget_pool_
+              ? nullptr
+              : std::make_shared<TaskThreadPool>(num_decode_threads_)),
+      work_stealing_pool_(
+          use_work_stealing_pool_ && !cpu_budget_pool_
+              ? std::make_shared<WorkStealingThreadPool>(num_decode_threads_)
+              : nullptr),
       // output type only supported with CUDA and use_gpu_transform for now
       output_type_(
           cast::GetCastDataType(ArgumentHelper(operator_def), "output_type")),
       random_scale_(
           OperatorBase::template GetRepeatedArgument<int>("random_scale", {-1,-1})) {
+  if (cpu_budget_pool_) {
+    num_decode_threads_ = cpu_budget_pool_->size();
+  }
   if ((random_scale_[0] == -1) || (random_scale_[1] == -1)) {
     random_scaling_ = false;
   } else {
@@ -343,6 +408,17 @@ ImageInputOp<Context>::ImageInputOp(
   LOG(INFO) << "    " << (is_test_ ? "Central" : "Random")
             << " cropping image to " << crop_
             << (mirror_ ? " with " : " without ") << "random mirroring;";
+#ifdef CAFFE2_USE_LIBJPEG_TURBO
+  if (partial_jpeg_decode_) {
+    LOG(INFO) << "    Decoding only the crop of JPEGs with libjpeg-turbo;";
+  }
+#else
+  if (partial_jpeg_decode_) {
+    LOG(WARNING) << "partial_jpeg_decode needs Caffe2 built with "
+                 << "USE_LIBJPEG_TURBO, decoding whole JPEGs with OpenCV.";
+    partial_jpeg_decode_ = false;
+  }
+#endif
   LOG(INFO) << "Label Type: " << label_type_;
   LOG(INFO) << "Num Labels: " << num_labels_;
 
@@ -381,21 +457,18 @@ ImageInputOp<Context>::ImageInputOp(
   }
 }
 
-// Inception-stype scale jittering
-template <class Context>
-bool RandomSizedCropping(
-  cv::Mat* img,
-  const int crop,
-  std::mt19937* randgen
+// The region of the Inception-style scale jittering of an image of
+// im_height x im_width, or false if none is found in 10 tries
+inline bool RandomSizedCropRegion(
+  const int im_height,
+  const int im_width,
+  std::mt19937* randgen,
+  cv::Rect* roi
 ) {
-  cv::Mat scaled_img;
-  bool inception_scale_jitter = false;
-  int im_height = img->rows, im_width = img->cols;
   int area = im_height * im_width;
   std::uniform_real_distribution<> area_dis(0.08, 1.0);
   std::uniform_real_distribution<> aspect_ratio_dis(3.0 / 4.0, 4.0 / 3.0);
 
-  cv::Mat cropping;
   for (int i = 0; i < 10; ++i) {
     int target_area = int(ceil(area_dis(*randgen) * area));
     float aspect_ratio = aspect_ratio_dis(*randgen);
@@ -406,21 +479,91 @@ bool RandomSizedCropping(
         0, im_height - nh)(*randgen);
       int width_offset = std::uniform_int_distribution<>(
         0,im_width - nw)(*randgen);
-      cv::Rect ROI(width_offset, height_offset, nw, nh);
-      cropping = (*img)(ROI);
-      cv::resize(
-          cropping,
-          scaled_img,
-          cv::Size(crop, crop),
-          0,
-          0,
-          cv::INTER_AREA);
-      *img = scaled_img;
-      inception_scale_jitter = true;
-      break;
+      *roi = cv::Rect(width_offset, height_offset, nw, nh);
+      return true;
     }
   }
-  return inception_scale_jitter;
+  return false;
+}
+
+// Inception-stype scale jittering
+template <class Context>
+bool RandomSizedCropping(
+  cv::Mat* img,
+  const int crop,
+  std::mt19937* randgen
+) {
+  cv::Mat scaled_img;
+  cv::Rect ROI;
+  if (!RandomSizedCropRegion(img->rows, img->cols, randgen, &ROI)) {
+    return false;
+  }
+  cv::Mat cropping = (*img)(ROI);
+  cv::resize(
+      cropping,
+      scaled_img,
+      cv::Size(crop, crop),
+      0,
+      0,
+      cv::INTER_AREA);
+  *img = scaled_img;
+  return true;
+}
+
+// Decodes the JPEG data to src with libjpeg-turbo, only the part of it that
+// the transforms of GetImageAndLabelAndInfoFromDBValue keep: the
+// Inception-style crop, resized to crop_ (inception_scale_jitter), or else
+// the bounding box, at the DCT scaling closest to scale_. The bounding box is
+// then applied already. Returns false if data is not a JPEG or
+// partial_jpeg_decode is off, and src is to be decoded with OpenCV.
+template <class Context>
+bool ImageInputOp<Context>::DecodeJpegForTransform(
+    const char* data,
+    size_t size,
+    PerImageArg& info,
+    std::mt19937* randgen,
+    cv::Mat* src,
+    bool* inception_scale_jitter) {
+#ifdef CAFFE2_USE_LIBJPEG_TURBO
+  int height, width;
+  if (!partial_jpeg_decode_ || !JpegImageSize(data, size, &height, &width)) {
+    return false;
+  }
+  cv::Rect region(0, 0, width, height);
+  const BoundingBox& box = info.bounding_params;
+  if (box.valid && box.ymin + box.height <= height &&
+      box.xmin + box.width <= width) {
+    region = cv::Rect(box.xmin, box.ymin, box.width, box.height);
+  }
+
+  cv::Rect crop;
+  if (scale_jitter_type_ == INCEPTION_STYLE && !is_test_ &&
+      RandomSizedCropRegion(region.height, region.width, randgen, &crop)) {
+    cv::Mat decoded;
+    crop.x += region.x;
+    crop.y += region.y;
+    if (!DecodeJpegRegion(data, size, crop, crop_, crop_, color_, &decoded)) {
+      return false;
+    }
+    cv::resize(decoded, *src, cv::Size(crop_, crop_), 0, 0, cv::INTER_AREA);
+    *inception_scale_jitter = true;
+  } else {
+    // Only scale_ always rescales, minsize_ keeps the full resolution
+    const int min_size =
+        scale_ > 0 ? scale_ : std::numeric_limits<int>::max();
+    if (!DecodeJpegRegion(
+            data, size, region, min_size, min_size, color_, src)) {
+      return false;
+    }
+    if (!src->isContinuous()) {
+      *src = src->clone();
+    }
+  }
+  info.bounding_params.valid = false;
+  return true;
+#else
+  return false;
+#endif // CAFFE2_USE_LIBJPEG_TURBO
 }
 
 template <class Context>
@@ -436,6 +579,9 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
   // CAFFE_ENFORCE are silently dropped by the thread worker functions
   //
   cv::Mat src;
+  // set when DecodeJpegForTransform did the Inception-style jittering
+  bool jpeg_region_decoded = false;
+  bool inception_scale_jitter = false;
 
   // Use the default information for images
   info = default_arg_;
@@ -447,6 +593,11 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
     prefetched_label_.mutable_data<int>()[item_id] = datum.label();
     if (datum.encoded()) {
       // encoded image in datum.
+      jpeg_region_decoded = DecodeJpegForTransform(
+          datum.data().data(), datum.data().size(), info, randgen, &src,
+          &inception_scale_jitter);
+    }
+    if (datum.encoded() && !jpeg_region_decoded) {
       src = cv::imdecode(
           cv::Mat(
               1,
@@ -510,14 +661,19 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
       DCHECK_EQ(image_proto.string_data_size(), 1);
       const string& encoded_image_str = image_proto.string_data(0);
       int encoded_size = encoded_image_str.size();
-      // We use a cv::Mat to wrap the encoded str so we do not need a copy.
-      src = cv::imdecode(
-          cv::Mat(
-              1,
-              &encoded_size,
-              CV_8UC1,
-              const_cast<char*>(encoded_image_str.data())),
-          color_ ? CV_LOAD_IMAGE_COLOR : CV_LOAD_IMAGE_GRAYSCALE);
+      jpeg_region_decoded = DecodeJpegForTransform(
+          encoded_image_str.data(), encoded_size, info, randgen, &src,
+          &inception_scale_jitter);
+      if (!jpeg_region_decoded) {
+        // We use a cv::Mat to wrap the encoded str so we do not need a copy.
+        src = cv::imdecode(
+            cv::Mat(
+                1,
+                &encoded_size,
+                CV_8UC1,
+                const_cast<char*>(encoded_image_str.data())),
+            color_ ? CV_LOAD_IMAGE_COLOR : CV_LOAD_IMAGE_GRAYSCALE);
+      }
     } else if (image_proto.data_type() == TensorProto::BYTE) {
       // raw image content.
       int src_c = (image_proto.dims_size() == 3) ? image_proto.dims(2) : 1;
@@ -676,8 +832,7 @@ bool ImageInputOp<Context>::GetImageAndLabelAndInfoFromDBValue(
   }
 
   cv::Mat scaled_img;
-  bool inception_scale_jitter = false;
-  if (scale_jitter_type_ == INCEPTION_STYLE) {
+  if (scale_jitter_type_ == INCEPTION_STYLE && !jpeg_region_decoded) {
     if (!is_test_) {
       // Inception-stype scale jittering is only used for training
       inception_scale_jitter = RandomSizedCropping<Context>(img, crop_, randgen);
@@ -1130,7 +1285,7 @@ bool ImageInputOp<Context>::Prefetch() {
       // output of decode will still be int8
       uint8_t* image_data = prefetched_image_.mutable_data<uint8_t>() +
           crop_ * crop_ * channels * item_id;
-      thread_pool_->runTaskWithID(std::bind(
+      RunDecodeTask(std::bind(
           &ImageInputOp<Context>::DecodeAndTransposeOnly,
           this,
           std::string(value),
@@ -1141,7 +1296,7 @@ bool ImageInputOp<Context>::Prefetch() {
     } else {
       float* image_data = prefetched_image_.mutable_data<float>() +
           crop_ * crop_ * channels * item_id;
-      thread_pool_->runTaskWithID(std::bind(
+      RunDecodeTask(std::bind(
           &ImageInputOp<Context>::DecodeAndTransform,
           this,
           std::string(value),
@@ -1151,7 +1306,13 @@ bool ImageInputOp<Context>::Prefetch() {
           std::placeholders::_1));
     }
   }
-  thread_pool_->waitWorkComplete();
+  if (cpu_budget_pool_) {
+    decode_tasks_.Wait();
+  } else if (use_work_stealing_pool_) {
+    work_stealing_pool_->waitWorkComplete();
+  } else {
+    thread_pool_->waitWorkComplete();
+  }
 
   // If the context is not CPUContext, we will need to do a copy in the
   // prefetch function as well.
@@ -1164,29 +1325,42 @@ bool ImageInputOp<Context>::Prefetch() {
           prefetched_additional_outputs_[i], &context_);
     }
   }
+
+  // Hand the batch over to its slot. The tensors we get back belong to a
+  // slot that has already been copied out and are reused for the next one.
+  PrefetchedBatch& batch = prefetched_batches_[this->prefetch_slot_];
+  batch.image.swap(prefetched_image_);
+  batch.label.swap(prefetched_label_);
+  batch.additional_outputs.swap(prefetched_additional_outputs_);
+  batch.image_on_device.swap(prefetched_image_on_device_);
+  batch.label_on_device.swap(prefetched_label_on_device_);
+  batch.additional_outputs_on_device.swap(
+      prefetched_additional_outputs_on_device_);
+  prefetched_additional_outputs_.resize(OutputSize() - 2);
+  prefetched_additional_outputs_on_device_.resize(OutputSize() - 2);
+  // A slot that has not been filled yet hands back empty tensors.
+  prefetched_image_.ResizeLike(batch.image);
+  prefetched_label_.ResizeLike(batch.label);
+  for (int i = 0; i < prefetched_additional_outputs_.size(); ++i) {
+    prefetched_additional_outputs_[i].ResizeLike(
+        batch.additional_outputs[i]);
+  }
   return true;
 }
 
 template <class Context>
 bool ImageInputOp<Context>::CopyPrefetched() {
   auto* image_output = OperatorBase::Output<Tensor<Context> >(0);
-  auto* label_output = OperatorBase::Output<Tensor<Context> >(1);
-  vector<Tensor<Context>*> additional_outputs_output;
-
-  for (int i = 2; i < OutputSize(); ++i) {
-    additional_outputs_output.push_back(
-        OperatorBase::Output<Tensor<Context>>(i));
-  }
+  PrefetchedBatch& batch = prefetched_batches_[this->copy_slot_];
 
   // Note(jiayq): The if statement below should be optimized away by the
   // compiler since std::is_same is a constexpr.
   if (std::is_same<Context, CPUContext>::value) {
-    image_output->CopyFrom(prefetched_image_, &context_);
-    label_output->CopyFrom(prefetched_label_, &context_);
+    this->OutputPrefetched(0, &batch.image);
+    this->OutputPrefetched(1, &batch.label);
 
-    for (int i = 0; i < additional_outputs_output.size(); ++i) {
-      additional_outputs_output[i]->CopyFrom(
-          prefetched_additional_outputs_[i], &context_);
+    for (int i = 2; i < OutputSize(); ++i) {
+      this->OutputPrefetched(i, &batch.additional_outputs[i - 2]);
     }
   } else {
     // TODO: support color jitter and color lighting in gpu_transform
@@ -1203,24 +1377,23 @@ bool ImageInputOp<Context>::CopyPrefetched() {
       }
       // GPU transform kernel allows explicitly setting output type
       if (output_type_ == TensorProto_DataType_FLOAT) {
-        TransformOnGPU<uint8_t,float,Context>(prefetched_image_on_device_,
+        TransformOnGPU<uint8_t,float,Context>(batch.image_on_device,
                                               image_output, mean_gpu_,
                                               std_gpu_, &context_);
       } else if (output_type_ == TensorProto_DataType_FLOAT16) {
-        TransformOnGPU<uint8_t,float16,Context>(prefetched_image_on_device_,
+        TransformOnGPU<uint8_t,float16,Context>(batch.image_on_device,
                                                 image_output, mean_gpu_,
                                                 std_gpu_, &context_);
       }  else {
         return false;
       }
     } else {
-      image_output->CopyFrom(prefetched_image_on_device_, &context_);
+      this->OutputPrefetched(0, &batch.image_on_device);
     }
-    label_output->CopyFrom(prefetched_label_on_device_, &context_);
+    this->OutputPrefetched(1, &batch.label_on_device);
 
-    for (int i = 0; i < additional_outputs_output.size(); ++i) {
-      additional_outputs_output[i]->CopyFrom(
-          prefetched_additional_outputs_on_device_[i], &context_);
+    for (int i = 2; i < OutputSize(); ++i) {
+      this->OutputPrefetched(i, &batch.additional_outputs_on_device[i - 2]);
     }
   }
   return true;
@@ -0,0 +1,123 @@
+#include "caffe2/image/jpeg_crop_decoder.h"
+
+#ifdef CAFFE2_USE_LIBJPEG_TURBO
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+
+#include <jpeglib.h>
+
+namespace caffe2 {
+
+namespace {
+
+struct JpegErrorManager {
+  jpeg_error_mgr pub;
+  jmp_buf jump;
+};
+
+void ExitOnJpegError(j_common_ptr cinfo) {
+  longjmp(reinterpret_cast<JpegErrorManager*>(cinfo->err)->jump, 1);
+}
+
+void IgnoreJpegMessage(j_common_ptr /* cinfo */, int /* msg_level */) {}
+
+// A decompressor of an in-memory JPEG whose errors longjmp to error.jump,
+// which its user sets, instead of exiting the process.
+struct JpegDecompressor {
+  jpeg_decompress_struct cinfo;
+  JpegErrorManager error;
+
+  JpegDecompressor(const char* data, size_t size) {
+    cinfo.err = jpeg_std_error(&error.pub);
+    error.pub.error_exit = ExitOnJpegError;
+    error.pub.emit_message = IgnoreJpegMessage;
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(
+        &cinfo,
+        reinterpret_cast<unsigned char*>(const_cast<char*>(data)),
+        size);
+  }
+
+  ~JpegDecompressor() {
+    jpeg_destroy_decompress(&cinfo);
+  }
+};
+
+} // namespace
+
+bool JpegImageSize(const char* data, size_t size, int* height, int* width) {
+  JpegDecompressor decompressor(data, size);
+  if (setjmp(decompressor.error.jump)) {
+    return false;
+  }
+  jpeg_read_header(&decompressor.cinfo, TRUE);
+  *height = decompressor.cinfo.image_height;
+  *width = decompressor.cinfo.image_width;
+  return true;
+}
+
+int JpegScaleNumerator(int height, int width, int min_height, int min_width) {
+  for (int num = 1; num < 8; num *= 2) {
+    if (height * num / 8 >= min_height && width * num / 8 >= min_width) {
+      return num;
+    }
+  }
+  return 8;
+}
+
+bool DecodeJpegRegion(
+    const char* data,
+    size_t size,
+    const cv::Rect& roi,
+    int min_height,
+    int min_width,
+    bool color,
+    cv::Mat* out) {
+  JpegDecompressor decompressor(data, size);
+  jpeg_decompress_struct& cinfo = decompressor.cinfo;
+  cv::Mat decoded;
+  if (setjmp(decompressor.error.jump)) {
+    return false;
+  }
+  jpeg_read_header(&cinfo, TRUE);
+  const cv::Rect image(0, 0, cinfo.image_width, cinfo.image_height);
+  if (roi.area() <= 0 || (roi & image) != roi) {
+    return false;
+  }
+  cinfo.out_color_space = color ? JCS_EXT_BGR : JCS_GRAYSCALE;
+  cinfo.scale_num =
+      JpegScaleNumerator(roi.height, roi.width, min_height, min_width);
+  cinfo.scale_denom = 8;
+  jpeg_start_decompress(&cinfo);
+
+  // roi in pixels of the scaled output
+  const int scale = cinfo.scale_num;
+  const int x0 = roi.x * scale / 8;
+  const int y0 = roi.y * scale / 8;
+  const int x1 = std::min<int>(
+      ((roi.x + roi.width) * scale + 7) / 8, cinfo.output_width);
+  const int y1 = std::min<int>(
+      ((roi.y + roi.height) * scale + 7) / 8, cinfo.output_height);
+  // widens the columns to the iMCU boundaries around them
+  JDIMENSION x_offset = x0;
+  JDIMENSION width = x1 - x0;
+  jpeg_crop_scanline(&cinfo, &x_offset, &width);
+  if (y0 > 0) {
+    jpeg_skip_scanlines(&cinfo, y0);
+  }
+  decoded.create(y1 - y0, width, color ? CV_8UC3 : CV_8UC1);
+  while (cinfo.output_scanline < static_cast<JDIMENSION>(y1)) {
+    JSAMPROW row = decoded.ptr<uchar>(cinfo.output_scanline - y0);
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  // the rows below roi are never decoded
+  jpeg_abort_decompress(&cinfo);
+  *out = decoded(cv::Rect(x0 - x_offset, 0, x1 - x0, y1 - y0));
+  return true;
+}
+
+} // namespace caffe2
+
+#endif // CAFFE2_USE_LIBJPEG_TURBO
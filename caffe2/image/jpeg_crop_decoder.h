@@ -0,0 +1,42 @@
+#ifndef CAFFE2_IMAGE_JPEG_CROP_DECODER_H_
+#define CAFFE2_IMAGE_JPEG_CROP_DECODER_H_
+
+#include <opencv2/opencv.hpp>
+
+#include "caffe2/core/macros.h"
+
+namespace caffe2 {
+
+#ifdef CAFFE2_USE_LIBJPEG_TURBO
+
+// Reads the size of a JPEG from its header. Returns false if data is not a
+// JPEG that libjpeg-turbo can read.
+bool JpegImageSize(const char* data, size_t size, int* height, int* width);
+
+// The numerator of the largest libjpeg DCT scaling (1/8, 1/4, 1/2, or 1 of
+// 8/8) at which a region of height x width pixels is still at least
+// min_height x min_width.
+int JpegScaleNumerator(int height, int width, int min_height, int min_width);
+
+// Decodes the pixels of roi (in pixels of the full image) of a JPEG, at the
+// DCT scaling of JpegScaleNumerator(roi.height, roi.width, min_height,
+// min_width) / 8. Only the iMCU rows that cover roi are decoded, and only the
+// iMCU columns that cover it are upsampled and color converted, so a small
+// crop of a large image costs a fraction of cv::imdecode. out is BGR, or
+// grayscale if !color, of about roi.size() times the scaling, and may be a
+// view into a larger buffer. Returns false on any error (e.g. a CMYK JPEG),
+// in which case the caller falls back to cv::imdecode.
+bool DecodeJpegRegion(
+    const char* data,
+    size_t size,
+    const cv::Rect& roi,
+    int min_height,
+    int min_width,
+    bool color,
+    cv::Mat* out);
+
+#endif // CAFFE2_USE_LIBJPEG_TURBO
+
+} // namespace caffe2
+
+#endif // CAFFE2_IMAGE_JPEG_CROP_DECODER_H_
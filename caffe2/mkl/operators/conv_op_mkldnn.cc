@@ -14,17 +14,24 @@ class ConvMKLDNNOp final : public ConvPoolOpBase<CPUContext> {
   USE_CONV_POOL_BASE_FUNCTIONS(CPUContext);
   ConvMKLDNNOp(const OperatorDef& operator_def, Workspace* ws)
       : ConvPoolOpBase<CPUContext>(operator_def, ws) {
+    const int spatial = kernel_.size();
     OPERATOR_NEEDS_FEATURE(
-        dilation_h() == 1 && dilation_w() == 1, "Dilation not supported.");
-    OPERATOR_NEEDS_FEATURE(
-        pad_l() == pad_r() && pad_t() == pad_b(),
-        "Uneven padding not supported.");
+        spatial == 2 || spatial == 3, "Only 2D and 3D convolution supported.");
+    for (int i = 0; i < spatial; ++i) {
+      OPERATOR_NEEDS_FEATURE(dilation_[i] == 1, "Dilation not supported.");
+      OPERATOR_NEEDS_FEATURE(
+          pads_[i] == pads_[i + spatial], "Uneven padding not supported.");
+    }
+    OPERATOR_NEEDS_FEATURE(group_ == 1, "Group convolution not supported.");
     OPERATOR_NEEDS_FEATURE(
         order_ == StorageOrder::NCHW, "Only NCHW order supported.");
   }
   ~ConvMKLDNNOp() {}
 
   bool RunOnDeviceWithOrderNCHW() override {
+    if (kernel_.size() == 3) {
+      return RunOnDeviceWithOrderNCHW3d();
+    }
     auto& X = Input(INPUT);
     auto& filter = Input(FILTER);
     auto& bias = Input(BIAS);
@@ -99,6 +106,123 @@ class ConvMKLDNNOp final : public ConvPoolOpBase<CPUContext> {
     return true;
   }
 
+  // The MKL primitives are 2D only, so a N x C x T x H x W clip runs as a
+  // batch of its To output frames. The temporal taps are folded into the
+  // channels, which leaves the filter as is: M x C x kT x kH x kW is
+  // M x (C * kT) x kH x kW in memory. Frames with kT == 1 and no temporal
+  // padding are read in place through a strided layout; the others are
+  // gathered into To x (C * kT) x H x W first. The outputs of a clip are
+  // written back through a strided layout as well, so no transposes are
+  // needed.
+  bool RunOnDeviceWithOrderNCHW3d() {
+    auto& X = Input(INPUT);
+    auto& filter = Input(FILTER);
+    auto& bias = Input(BIAS);
+    TensorCPU* Y = Output(0);
+    CAFFE_ENFORCE(5 == X.ndim());
+    CAFFE_ENFORCE(5 == filter.ndim());
+    const int N = X.dim32(0), C = X.dim32(1), T_in = X.dim32(2),
+              H = X.dim32(3), W = X.dim32(4);
+    const int M = filter.dim32(0);
+    CAFFE_ENFORCE(
+        C == filter.dim32(1),
+        "Convolution op: # of input channels ",
+        C,
+        " is not equal to kernel channels:",
+        filter.dim32(1));
+    for (int i = 0; i < 3; ++i) {
+      CAFFE_ENFORCE(filter.dim32(i + 2) == kernel_[i]);
+    }
+    CAFFE_ENFORCE(bias.ndim() == 1);
+    CAFFE_ENFORCE(bias.dim32(0) == M);
+    ConvPoolOpBase<CPUContext>::SetOutputSize(X, Y, M);
+    const int T_out = Y->dim32(2), H_out = Y->dim32(3), W_out = Y->dim32(4);
+    const int kT = kernel_[0], stride_t = stride_[0], pad_t = pads_[0];
+    const int C_fold = C * kT;
+    const bool gather = kT > 1 || pad_t > 0;
+
+    if (cached_input_dims_ != X.dims() ||
+        cached_filter_dims_ != filter.dims()) {
+      cached_input_dims_ = X.dims();
+      cached_filter_dims_ = filter.dims();
+      size_t dimension = 4;
+      size_t bdata_sizes[4] = {W, H, C_fold, T_out};
+      size_t tdata_sizes[4] = {W_out, H_out, M, T_out};
+      size_t fdata_sizes[4] = {kernel_[2], kernel_[1], C_fold, M};
+      size_t strides[2] = {stride_[2], stride_[1]};
+      int pads[2] = {-pads_[2], -pads_[1]};
+
+      primitive_.Reset(
+          dnnConvolutionCreateForwardBias<float>,
+          nullptr,
+          dnnAlgorithmConvolutionDirect,
+          dimension,
+          bdata_sizes,
+          tdata_sizes,
+          fdata_sizes,
+          strides,
+          pads,
+          dnnBorderZeros);
+      // frame t of a clip is at t * H * W, channel c at c * T_in * H * W
+      size_t bdata_strides[4] = {1, W, T_in * H * W, stride_t * H * W};
+      if (gather) {
+        bdata_strides[2] = H * W;
+        bdata_strides[3] = C_fold * H * W;
+        col_buffer_.Resize(T_out, C_fold, H, W);
+      }
+      size_t tdata_strides[4] = {
+          1, W_out, T_out * H_out * W_out, H_out * W_out};
+      X_wrapper_.reset(new MKLMemory<T>(
+          dimension, bdata_sizes, bdata_strides, primitive_, dnnResourceSrc));
+      filter_wrapper_.reset(new MKLMemory<T>(
+          std::vector<TIndex>{M, C_fold, kernel_[1], kernel_[2]},
+          primitive_,
+          dnnResourceFilter));
+      bias_wrapper_.reset(
+          new MKLMemory<T>(bias.dims(), primitive_, dnnResourceBias, true));
+      Y_wrapper_.reset(new MKLMemory<T>(
+          dimension, tdata_sizes, tdata_strides, primitive_, dnnResourceDst));
+      resources_[dnnResourceSrc] = X_wrapper_->buffer();
+      resources_[dnnResourceFilter] = filter_wrapper_->buffer();
+      resources_[dnnResourceDst] = Y_wrapper_->buffer();
+    }
+    filter_wrapper_->CopyFrom(filter.template data<T>());
+    bias_wrapper_->CopyFrom(bias);
+    resources_[dnnResourceBias] = bias_wrapper_->buffer();
+
+    const T* Xdata = X.template data<T>();
+    T* Ydata = Y->template mutable_data<T>();
+    const size_t clip_size = C * T_in * H * W;
+    const size_t output_clip_size = M * T_out * H_out * W_out;
+    for (int n = 0; n < N; ++n) {
+      const T* x = Xdata + n * clip_size;
+      if (gather) {
+        T* col = col_buffer_.template mutable_data<T>();
+        const int frame = H * W;
+        for (int t = 0; t < T_out; ++t) {
+          for (int c = 0; c < C; ++c) {
+            for (int i = 0; i < kT; ++i) {
+              const int t_in = t * stride_t - pad_t + i;
+              T* dst = col + ((t * C + c) * kT + i) * frame;
+              if (t_in < 0 || t_in >= T_in) {
+                std::fill(dst, dst + frame, T(0));
+              } else {
+                const T* src = x + (c * T_in + t_in) * frame;
+                std::copy(src, src + frame, dst);
+              }
+            }
+          }
+        }
+        X_wrapper_->CopyFrom(col);
+      } else {
+        X_wrapper_->CopyFrom(x);
+      }
+      MKLDNN_SAFE_CALL(dnnExecute<float>(primitive_, resources_));
+      Y_wrapper_->CopyTo(Ydata + n * output_clip_size);
+    }
+    return true;
+  }
+
   bool RunOnDeviceWithOrderNHWC() override {
     CAFFE_NOT_IMPLEMENTED;
   }
@@ -113,6 +237,8 @@ class ConvMKLDNNOp final : public ConvPoolOpBase<CPUContext> {
   unique_ptr<MKLMemory<T>> filter_wrapper_ = nullptr;
   unique_ptr<MKLMemory<T>> bias_wrapper_ = nullptr;
   unique_ptr<MKLMemory<T>> Y_wrapper_ = nullptr;
+  // the temporally folded frames of a clip, for 3D convolutions
+  TensorCPU col_buffer_;
   void* resources_[dnnResourceNumber] = {0};
   INPUT_TAGS(INPUT, FILTER, BIAS);
 };
@@ -40,6 +40,18 @@ int MPICommRank(MPI_Comm comm) {
   return comm_rank;
 }
 
+void MPIWaitAll(std::vector<MPI_Request>* requests) {
+  while (true) {
+    int done = 0;
+    MPI_CHECK(MPI_Testall(
+        requests->size(), requests->data(), &done, MPI_STATUSES_IGNORE));
+    if (done) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+}
+
 /**
  * Helper function used to setup MPI intercommunicator.
  */
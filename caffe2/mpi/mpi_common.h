@@ -3,6 +3,7 @@
 
 #include <mpi.h>
 #include <mutex>
+#include <vector>
 
 #include "caffe2/core/logging.h"
 
@@ -67,6 +68,15 @@ int MPICommSize(MPI_Comm comm);
  */
 int MPICommRank(MPI_Comm comm);
 
+/**
+ * @brief Waits for the requests of non-blocking MPI calls.
+ *
+ * The requests are polled with MPI_Testall, and the MPI mutex is only held
+ * for a poll at a time, so that the MPI calls of other threads, e.g. the
+ * collectives of other ops on other communicators, go on in between.
+ */
+void MPIWaitAll(std::vector<MPI_Request>* requests);
+
 /**
  * @brief A simple wrapper over an MPI common world.
  */
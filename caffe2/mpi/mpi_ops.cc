@@ -30,4 +30,19 @@ REGISTER_CPU_OPERATOR(MPIAllreduce, MPIAllreduceOp<float, CPUContext>);
 REGISTER_CPU_OPERATOR(MPISendTensor, MPISendTensorOp<CPUContext>);
 REGISTER_CPU_OPERATOR(MPIReceiveTensor, MPIReceiveTensorOp<CPUContext>);
 
+REGISTER_CPU_OPERATOR_WITH_ENGINE(
+    CreateCommonWorld,
+    MPI,
+    CreateCommonWorldMPIOp<CPUContext>);
+// the clone of a common world has the ranks of the global communicator too
+REGISTER_CPU_OPERATOR_WITH_ENGINE(
+    CloneCommonWorld,
+    MPI,
+    CreateCommonWorldMPIOp<CPUContext>);
+REGISTER_CPU_OPERATOR_WITH_ENGINE(Broadcast, MPI, BroadcastMPIOp<CPUContext>);
+REGISTER_CPU_OPERATOR_WITH_ENGINE(
+    Allreduce,
+    MPI,
+    AllreduceMPIOp<float, CPUContext>);
+
 }  // namespace caffe2
@@ -245,6 +245,153 @@ class MPIReceiveTensorOp final : public Operator<Context> {
   OUTPUT_TAGS(OUTPUT, SRC_OUT, TAG_OUT);
 };
 
+// The MPI engine of the collective ops of communicator_op.cc
+// (CreateCommonWorld, CloneCommonWorld, Broadcast, Allreduce), so that
+// data_parallel_model runs on MPI with rendezvous['engine'] = 'MPI', as an
+// alternative to gloo.
+//
+// A common world is a communicator of its own with the ranks of the global
+// MPI communicator, so that the collectives of different common worlds, e.g.
+// the ones of CollectivesConcurrencyControl, do not interleave. It is split
+// when the op is constructed, as the ops are constructed in the same order on
+// every rank, while they may run in any order in a dag net. MPI is
+// initialized if needed, e.g. in a python process started by mpirun.
+template <class Context>
+class CreateCommonWorldMPIOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  CreateCommonWorldMPIOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws) {
+    int flag;
+    MPI_Initialized(&flag);
+    if (!flag) {
+      int mpi_ret;
+      MPI_CHECK(
+          MPI_Init_thread(nullptr, nullptr, MPI_THREAD_MULTIPLE, &mpi_ret));
+      CAFFE_ENFORCE_EQ(
+          mpi_ret,
+          MPI_THREAD_MULTIPLE,
+          "The MPI engine needs the MPI_THREAD_MULTIPLE mode");
+    }
+    world_.reset(new MPICommonWorldWrapper());
+    const int size = OperatorBase::template GetSingleArgument<int>(
+        "size", world_->size());
+    const int rank = OperatorBase::template GetSingleArgument<int>(
+        "rank", world_->rank());
+    CAFFE_ENFORCE_EQ(size, world_->size(), "Size of the MPI communicator");
+    CAFFE_ENFORCE_EQ(rank, world_->rank(), "Rank in the MPI communicator");
+  }
+
+  bool RunOnDevice() override {
+    if (world_) {
+      OperatorBase::Outputs()[0]->Reset(world_.release());
+    }
+    // a later run keeps the common world of the first one
+    CAFFE_ENFORCE(
+        OperatorBase::OutputIsType<MPICommonWorldWrapper>(0),
+        "The common world of the op was replaced");
+    return true;
+  }
+
+ private:
+  std::unique_ptr<MPICommonWorldWrapper> world_;
+};
+
+// Broadcasts the tensors from the root in place, with a non-blocking
+// MPI_Ibcast each, posted together.
+template <class Context>
+class BroadcastMPIOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  BroadcastMPIOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        root_(OperatorBase::template GetSingleArgument<int>("root", 0)) {}
+
+  bool RunOnDevice() override {
+    MPI_Comm comm = OperatorBase::Input<MPICommonWorldWrapper>(0).comm();
+    // MPI reads and writes the memory outside of the stream of the op
+    context_.FinishDeviceComputation();
+    requests_.resize(OutputSize());
+    for (int i = 0; i < OutputSize(); ++i) {
+      auto* output = Output(i);
+      CAFFE_ENFORCE(
+          output->size() > 0,
+          "Broadcast op uses in-place operation so the output "
+          "should be already allocated.");
+#if MPI_VERSION >= 3
+      MPI_CHECK(MPI_Ibcast(
+          output->raw_mutable_data(),
+          output->nbytes(),
+          MPIDataTypeWrapper<char>::type(),
+          root_,
+          comm,
+          &requests_[i]));
+#else
+      MPI_CHECK(MPI_Bcast(
+          output->raw_mutable_data(),
+          output->nbytes(),
+          MPIDataTypeWrapper<char>::type(),
+          root_,
+          comm));
+      requests_[i] = MPI_REQUEST_NULL;
+#endif
+    }
+    MPIWaitAll(&requests_);
+    return true;
+  }
+
+ protected:
+  int root_;
+  std::vector<MPI_Request> requests_;
+};
+
+// Sums the tensors over the ranks in place, with a non-blocking
+// MPI_Iallreduce each: the buckets of data_parallel_model, or the tensors of
+// an op, are all on the wire at once, and the op waits for them by polling,
+// see MPIWaitAll, so that the allreduces of other ops go on meanwhile. The
+// tensors of a CUDA op are reduced from the device memory by a CUDA-aware
+// MPI, see mpi_ops_gpu.cc.
+template <typename T, class Context>
+class AllreduceMPIOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  USE_SIMPLE_CTOR_DTOR(AllreduceMPIOp);
+
+  bool RunOnDevice() override {
+    MPI_Comm comm = OperatorBase::Input<MPICommonWorldWrapper>(0).comm();
+    // MPI reads and writes the memory outside of the stream of the op
+    context_.FinishDeviceComputation();
+    requests_.resize(OutputSize());
+    for (int i = 0; i < OutputSize(); ++i) {
+      auto* output = Output(i);
+#if MPI_VERSION >= 3
+      MPI_CHECK(MPI_Iallreduce(
+          MPI_IN_PLACE,
+          output->template mutable_data<T>(),
+          output->size(),
+          MPIDataTypeWrapper<T>::type(),
+          MPI_SUM,
+          comm,
+          &requests_[i]));
+#else
+      MPI_CHECK(MPI_Allreduce(
+          MPI_IN_PLACE,
+          output->template mutable_data<T>(),
+          output->size(),
+          MPIDataTypeWrapper<T>::type(),
+          MPI_SUM,
+          comm));
+      requests_[i] = MPI_REQUEST_NULL;
+#endif
+    }
+    MPIWaitAll(&requests_);
+    return true;
+  }
+
+ protected:
+  std::vector<MPI_Request> requests_;
+};
+
 }  // namespace caffe2
 
 #endif  // CAFFE2_MPI_MPI_OPS_H_
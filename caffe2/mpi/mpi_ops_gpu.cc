@@ -83,4 +83,39 @@ REGISTER_CUDA_OPERATOR(
     GPUFallbackOp<MPIAllreduceOp<float, CPUContext>>);
 #endif
 
+// The MPI engine of the collective ops, see mpi_ops.h: with a CUDA-aware MPI,
+// e.g. over InfiniBand with GPUDirect, the tensors go from the device memory
+// to the wire, else they are staged through the host memory.
+REGISTER_CUDA_OPERATOR_WITH_ENGINE(
+    CreateCommonWorld,
+    MPI,
+    CreateCommonWorldMPIOp<CUDAContext>);
+REGISTER_CUDA_OPERATOR_WITH_ENGINE(
+    CloneCommonWorld,
+    MPI,
+    CreateCommonWorldMPIOp<CUDAContext>);
+#if CAFFE2_HAS_CUDA_MPI_BASICS
+REGISTER_CUDA_OPERATOR_WITH_ENGINE(
+    Broadcast,
+    MPI,
+    BroadcastMPIOp<CUDAContext>);
+#else
+REGISTER_CUDA_OPERATOR_WITH_ENGINE(
+    Broadcast,
+    MPI,
+    GPUFallbackOp<BroadcastMPIOp<CPUContext>>);
+#endif
+
+#if CAFFE2_HAS_CUDA_MPI_ALLREDUCE
+REGISTER_CUDA_OPERATOR_WITH_ENGINE(
+    Allreduce,
+    MPI,
+    AllreduceMPIOp<float, CUDAContext>);
+#else
+REGISTER_CUDA_OPERATOR_WITH_ENGINE(
+    Allreduce,
+    MPI,
+    GPUFallbackOp<AllreduceMPIOp<float, CPUContext>>);
+#endif
+
 }  // namespace caffe2
@@ -299,6 +299,83 @@ TEST(MPITest, TestInPlaceMPIAllreduce) {
   }
 }
 
+const char kMPIEngineAllreduceNet[] = R"NET(
+  name: "allreduce_engine"
+  op {
+    output: "comm"
+    type: "CreateCommonWorld"
+    engine: "MPI"
+  }
+  op {
+    output: "X"
+    type: "ConstantFill"
+    arg {
+      name: "shape"
+      ints: 10
+    }
+    arg {
+      name: "value"
+      f: 0.0
+    }
+  }
+  op {
+    output: "Y"
+    type: "ConstantFill"
+    arg {
+      name: "shape"
+      ints: 3
+    }
+    arg {
+      name: "value"
+      f: 0.0
+    }
+  }
+  op {
+    input: "comm"
+    input: "X"
+    input: "Y"
+    output: "X"
+    output: "Y"
+    type: "Allreduce"
+    engine: "MPI"
+  }
+)NET";
+
+TEST(MPITest, TestMPIEngineAllreduce) {
+  NetDef net_def;
+  CHECK(TextFormat::ParseFromString(
+      string(kMPIEngineAllreduceNet), &net_def));
+  // Let's set the network's constant fill values to be the mpi rank.
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  for (int op = 1; op <= 2; ++op) {
+    auto* arg = net_def.mutable_op(op)->mutable_arg(1);
+    CAFFE_ENFORCE_EQ(arg->name(), "value");
+    arg->set_f(rank);
+  }
+  int size;
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  Workspace ws;
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  EXPECT_NE(nullptr, net.get());
+  // the second run keeps the common world of the first one
+  for (int run = 0; run < 2; ++run) {
+    EXPECT_TRUE(net->Run());
+    int expected_result = size * (size - 1) / 2;
+    auto& X = ws.GetBlob("X")->Get<TensorCPU>();
+    EXPECT_EQ(X.size(), 10);
+    for (int i = 0; i < X.size(); ++i) {
+      EXPECT_EQ(X.data<float>()[i], expected_result);
+    }
+    auto& Y = ws.GetBlob("Y")->Get<TensorCPU>();
+    EXPECT_EQ(Y.size(), 3);
+    for (int i = 0; i < Y.size(); ++i) {
+      EXPECT_EQ(Y.data<float>()[i], expected_result);
+    }
+  }
+}
+
 }  // namespace caffe2
 
 
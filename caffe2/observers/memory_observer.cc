@@ -0,0 +1,271 @@
+#include "memory_observer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace caffe2 {
+
+CAFFE_DEFINE_REGISTRY(MemoryTensorResolverRegistry, MemoryTensorResolver);
+CAFFE_REGISTER_CLASS(
+    MemoryTensorResolverRegistry,
+    CPU,
+    TensorMemoryResolver<CPUContext>);
+
+namespace {
+
+thread_local int g_owner = -1;
+
+// the rows of the peak compositions in the report of a device
+constexpr int kReportedUsages = 30;
+
+std::string DeviceName(int device) {
+  return device < 0 ? "cpu" : "gpu " + caffe2::to_string(device);
+}
+
+std::string Megabytes(int64_t bytes) {
+  std::ostringstream ss;
+  ss << std::fixed << std::setprecision(1) << bytes / (1024.0 * 1024.0)
+     << " MB";
+  return ss.str();
+}
+
+} // namespace
+
+MemoryTracker& MemoryTracker::Get() {
+  // never destroyed, as memory may be freed after the static destructors
+  static MemoryTracker* tracker = new MemoryTracker();
+  return *tracker;
+}
+
+void MemoryTracker::Start() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    devices_.clear();
+    blobs_.clear();
+  }
+  enabled_ = true;
+  SetMemoryAllocationListener(this);
+}
+
+void MemoryTracker::Stop() {
+  SetMemoryAllocationListener(nullptr);
+  enabled_ = false;
+}
+
+void MemoryTracker::New(int device, void* ptr, size_t nbytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& state = devices_[device];
+  state.allocations[ptr] = Allocation{nbytes, g_owner, next_serial_++};
+  state.live += nbytes;
+  if (state.live > state.peak) {
+    state.peak = state.live;
+    state.at_peak.clear();
+    for (const auto& allocation : state.allocations) {
+      state.at_peak.push_back(allocation.second);
+    }
+  }
+}
+
+void MemoryTracker::Delete(void* ptr) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& device : devices_) {
+    auto& state = device.second;
+    const auto it = state.allocations.find(ptr);
+    if (it != state.allocations.end()) {
+      state.live -= it->second.nbytes;
+      state.allocations.erase(it);
+      return;
+    }
+  }
+}
+
+int MemoryTracker::Intern(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = ids_.find(name);
+  if (it != ids_.end()) {
+    return it->second;
+  }
+  names_.push_back(name);
+  ids_[name] = names_.size() - 1;
+  return names_.size() - 1;
+}
+
+std::string MemoryTracker::Name(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return names_.at(id);
+}
+
+int MemoryTracker::SetOwner(int op) {
+  const int previous = g_owner;
+  g_owner = op;
+  return previous;
+}
+
+void MemoryTracker::NameBlob(const void* ptr, int blob) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& device : devices_) {
+    const auto& allocations = device.second.allocations;
+    const auto it = allocations.find(ptr);
+    if (it != allocations.end()) {
+      blobs_[it->second.serial] = blob;
+      return;
+    }
+  }
+}
+
+std::map<int, int64_t> MemoryTracker::LiveBytes() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::map<int, int64_t> live;
+  for (const auto& device : devices_) {
+    live[device.first] = device.second.live;
+  }
+  return live;
+}
+
+std::map<int, int64_t> MemoryTracker::PeakBytes() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::map<int, int64_t> peak;
+  for (const auto& device : devices_) {
+    peak[device.first] = device.second.peak;
+  }
+  return peak;
+}
+
+std::vector<MemoryUsage> MemoryTracker::PeakComposition(int device) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = devices_.find(device);
+  if (it == devices_.end()) {
+    return {};
+  }
+  std::map<std::pair<int, int>, MemoryUsage> usages;
+  for (const auto& allocation : it->second.at_peak) {
+    const auto blob_it = blobs_.find(allocation.serial);
+    const int blob = blob_it == blobs_.end() ? -1 : blob_it->second;
+    auto& usage = usages[{allocation.op, blob}];
+    if (usage.allocations == 0) {
+      usage.op = allocation.op < 0 ? "(no op)" : names_[allocation.op];
+      usage.blob = blob < 0 ? "" : names_[blob];
+    }
+    usage.bytes += allocation.nbytes;
+    ++usage.allocations;
+  }
+  std::vector<MemoryUsage> composition;
+  for (const auto& usage : usages) {
+    composition.push_back(usage.second);
+  }
+  std::sort(
+      composition.begin(),
+      composition.end(),
+      [](const MemoryUsage& a, const MemoryUsage& b) {
+        return a.bytes > b.bytes;
+      });
+  return composition;
+}
+
+MemoryOperatorObserver::MemoryOperatorObserver(
+    OperatorBase* subject,
+    MemoryObserver* net)
+    : ObserverBase<OperatorBase>(subject), net_(net) {
+  auto& tracker = MemoryTracker::Get();
+  std::string name;
+  if (subject->has_debug_def()) {
+    const auto& def = subject->debug_def();
+    name = def.type();
+    if (def.output_size() > 0) {
+      name += " " + def.output(0);
+    }
+    for (const auto& output : def.output()) {
+      blobs_.push_back(tracker.Intern(output));
+    }
+  }
+  op_ = tracker.Intern(name);
+}
+
+void MemoryOperatorObserver::Start() {
+  started_ = MemoryTracker::Get().enabled();
+  if (started_) {
+    previous_owner_ = MemoryTracker::SetOwner(op_);
+  }
+}
+
+void MemoryOperatorObserver::Stop() {
+  if (!started_) {
+    return;
+  }
+  auto& tracker = MemoryTracker::Get();
+  MemoryTracker::SetOwner(previous_owner_);
+  const auto& outputs = subject_->Outputs();
+  for (int i = 0; i < outputs.size() && i < blobs_.size(); ++i) {
+    for (const auto& resolver : net_->resolvers()) {
+      const void* data = resolver->Data(*outputs[i]);
+      if (data) {
+        tracker.NameBlob(data, blobs_[i]);
+        break;
+      }
+    }
+  }
+  net_->RecordOp(op_);
+}
+
+MemoryObserver::MemoryObserver(NetBase* subject)
+    : OperatorAttachingNetObserver<MemoryOperatorObserver, MemoryObserver>(
+          subject,
+          this) {
+  for (const auto& key : MemoryTensorResolverRegistry()->Keys()) {
+    resolvers_.push_back(MemoryTensorResolverRegistry()->Create(key));
+  }
+}
+
+void MemoryObserver::Start() {
+  if (MemoryTracker::Get().enabled()) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ops_.clear();
+  }
+}
+
+void MemoryObserver::RecordOp(int op) {
+  auto live = MemoryTracker::Get().LiveBytes();
+  std::lock_guard<std::mutex> lock(mutex_);
+  ops_.push_back(OpMemory{op, std::move(live)});
+}
+
+std::string MemoryObserver::debugInfo() {
+  auto& tracker = MemoryTracker::Get();
+  std::ostringstream ss;
+  ss << "live bytes after the ops of the last tracked run of "
+     << subject_->Name() << "\n";
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& op : ops_) {
+      ss << "  " << tracker.Name(op.op);
+      for (const auto& live : op.live) {
+        ss << "  " << DeviceName(live.first) << ": " << Megabytes(live.second);
+      }
+      ss << "\n";
+    }
+  }
+  for (const auto& peak : tracker.PeakBytes()) {
+    ss << "peak of " << DeviceName(peak.first) << ": "
+       << Megabytes(peak.second) << "\n";
+    const auto composition = tracker.PeakComposition(peak.first);
+    for (int i = 0; i < composition.size() && i < kReportedUsages; ++i) {
+      const auto& usage = composition[i];
+      ss << "  " << std::setw(10) << Megabytes(usage.bytes) << "  "
+         << usage.op;
+      if (!usage.blob.empty()) {
+        ss << " -> " << usage.blob;
+      }
+      if (usage.allocations > 1) {
+        ss << " (" << usage.allocations << " allocations)";
+      }
+      ss << "\n";
+    }
+    if (composition.size() > kReportedUsages) {
+      ss << "  ... " << composition.size() - kReportedUsages << " more\n";
+    }
+  }
+  return ss.str();
+}
+
+} // namespace caffe2
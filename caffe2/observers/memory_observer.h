@@ -0,0 +1,167 @@
+#ifndef CAFFE2_CONTRIB_OBSERVERS_MEMORY_OBSERVER_H_
+#define CAFFE2_CONTRIB_OBSERVERS_MEMORY_OBSERVER_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex> // NOLINT
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "caffe2/core/allocator.h"
+#include "caffe2/core/common.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/observer.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/registry.h"
+#include "caffe2/observers/operator_attaching_net_observer.h"
+
+namespace caffe2 {
+
+// Returns the data of the tensor a blob holds if it is an allocated tensor
+// of the device type it is registered for in MemoryTensorResolverRegistry,
+// e.g. by memory_observer_gpu.cc for CUDA, and nullptr otherwise.
+class MemoryTensorResolver {
+ public:
+  virtual ~MemoryTensorResolver() {}
+  virtual const void* Data(const Blob& blob) = 0;
+};
+
+template <class Context>
+class TensorMemoryResolver final : public MemoryTensorResolver {
+ public:
+  const void* Data(const Blob& blob) override {
+    if (!blob.IsType<Tensor<Context>>()) {
+      return nullptr;
+    }
+    const auto& tensor = blob.Get<Tensor<Context>>();
+    return tensor.capacity_nbytes() > 0 ? tensor.raw_data() : nullptr;
+  }
+};
+
+CAFFE_DECLARE_REGISTRY(MemoryTensorResolverRegistry, MemoryTensorResolver);
+
+// the bytes of a device held by the allocations an op made for one of its
+// output blobs, or for none of them (blob is empty)
+struct MemoryUsage {
+  std::string op;
+  std::string blob;
+  int64_t bytes;
+  int allocations;
+};
+
+// Tracks the live allocations of the CPU and CUDA contexts while it is
+// started, per device (-1 for the CPU, the GPU id otherwise) and by the op
+// that made them. Every new peak of a device keeps the allocations live on
+// it, so that the composition of the peak can be reported. Allocations made
+// before Start are not seen.
+class MemoryTracker final : public MemoryAllocationListener {
+ public:
+  static MemoryTracker& Get();
+
+  // clears the allocations and peaks, and starts listening
+  void Start();
+  void Stop();
+  bool enabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  void New(int device, void* ptr, size_t nbytes) override;
+  void Delete(void* ptr) override;
+
+  // the id of an op or blob name for SetOwner and NameBlob
+  int Intern(const std::string& name);
+  std::string Name(int id);
+  // attributes the allocations of the calling thread to the op of the id,
+  // or to no op with -1, and returns the previous one
+  static int SetOwner(int op);
+  // names the allocation at ptr after a blob, if it is tracked
+  void NameBlob(const void* ptr, int blob);
+
+  // per device
+  std::map<int, int64_t> LiveBytes();
+  std::map<int, int64_t> PeakBytes();
+  // the allocations live at the peak of a device, summed by op and blob,
+  // the largest first
+  std::vector<MemoryUsage> PeakComposition(int device);
+
+ private:
+  MemoryTracker() {}
+
+  struct Allocation {
+    size_t nbytes;
+    int op;
+    // to find the blob name, given after the allocation was kept at a peak
+    int64_t serial;
+  };
+  struct Device {
+    int64_t live = 0;
+    int64_t peak = 0;
+    std::unordered_map<const void*, Allocation> allocations;
+    std::vector<Allocation> at_peak;
+  };
+
+  std::mutex mutex_;
+  std::atomic<bool> enabled_{false};
+  std::map<int, Device> devices_;
+  std::unordered_map<int64_t, int> blobs_;
+  int64_t next_serial_ = 0;
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, int> ids_;
+};
+
+class MemoryObserver;
+
+class MemoryOperatorObserver final : public ObserverBase<OperatorBase> {
+ public:
+  MemoryOperatorObserver(OperatorBase* subject, MemoryObserver* net);
+
+ private:
+  void Start() override;
+  void Stop() override;
+
+  MemoryObserver* net_;
+  int op_;
+  std::vector<int> blobs_;
+  bool started_ = false;
+  int previous_owner_ = -1;
+};
+
+// Attributes the allocations made while the ops of a net run to the ops and
+// their output blobs, and records the live bytes per device after every op
+// of the runs while the MemoryTracker is started. debugInfo reports the live
+// bytes after the ops of the last tracked run, and the peak of each device
+// with its allocations by op and blob, largest first, to check a memonger
+// plan against what is allocated. While the tracker is stopped a run costs
+// a flag check per op.
+class MemoryObserver final
+    : public OperatorAttachingNetObserver<MemoryOperatorObserver,
+                                          MemoryObserver> {
+ public:
+  explicit MemoryObserver(NetBase* subject);
+
+  // the live bytes after an op of the current run
+  void RecordOp(int op);
+  const std::vector<std::unique_ptr<MemoryTensorResolver>>& resolvers() {
+    return resolvers_;
+  }
+
+  std::string debugInfo() override;
+
+ private:
+  void Start() override;
+
+  struct OpMemory {
+    int op;
+    std::map<int, int64_t> live;
+  };
+
+  std::vector<std::unique_ptr<MemoryTensorResolver>> resolvers_;
+  std::mutex mutex_;
+  std::vector<OpMemory> ops_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_CONTRIB_OBSERVERS_MEMORY_OBSERVER_H_
@@ -0,0 +1,12 @@
+#include "memory_observer.h"
+
+#include "caffe2/core/context_gpu.h"
+
+namespace caffe2 {
+
+CAFFE_REGISTER_CLASS(
+    MemoryTensorResolverRegistry,
+    CUDA,
+    TensorMemoryResolver<CUDAContext>);
+
+} // namespace caffe2
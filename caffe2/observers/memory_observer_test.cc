@@ -0,0 +1,96 @@
+#include "caffe2/core/common.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "memory_observer.h"
+
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// fills a temporary of "temp" floats, then an output of "size" floats
+class MemoryAllocOp final : public Operator<CPUContext> {
+ public:
+  MemoryAllocOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws),
+        size_(OperatorBase::GetSingleArgument<int>("size", 0)),
+        temp_(OperatorBase::GetSingleArgument<int>("temp", 0)) {}
+
+  bool RunOnDevice() override {
+    TensorCPU temp(vector<TIndex>{temp_});
+    temp.mutable_data<float>();
+    auto* output = Output(0);
+    output->Resize(size_);
+    output->mutable_data<float>();
+    return true;
+  }
+
+ private:
+  int size_;
+  int temp_;
+};
+
+REGISTER_CPU_OPERATOR(MemoryAlloc, MemoryAllocOp);
+OPERATOR_SCHEMA(MemoryAlloc).NumInputs(0, 1).NumOutputs(1);
+
+unique_ptr<NetBase> CreateMemoryNet(Workspace* ws) {
+  NetDef net_def;
+  net_def.set_name("memory");
+  auto& first = *net_def.add_op();
+  first.set_type("MemoryAlloc");
+  first.add_output("A");
+  first.add_arg()->CopyFrom(MakeArgument<int>("size", 1000));
+  first.add_arg()->CopyFrom(MakeArgument<int>("temp", 500));
+  auto& second = *net_def.add_op();
+  second.set_type("MemoryAlloc");
+  second.add_input("A");
+  second.add_output("B");
+  second.add_arg()->CopyFrom(MakeArgument<int>("size", 2000));
+  second.add_arg()->CopyFrom(MakeArgument<int>("temp", 500));
+  return unique_ptr<NetBase>(CreateNet(net_def, ws));
+}
+
+} // namespace
+
+TEST(MemoryObserverTest, AttributesThePeakToOpsAndBlobs) {
+  Workspace ws;
+  auto net = CreateMemoryNet(&ws);
+  auto memory_observer = caffe2::make_unique<MemoryObserver>(net.get());
+  auto* observer = memory_observer.get();
+  net->AttachObserver(std::move(memory_observer));
+  auto& tracker = MemoryTracker::Get();
+  tracker.Start();
+  net->Run();
+  net->Run();
+  tracker.Stop();
+
+  const int64_t A = 1000 * sizeof(float);
+  const int64_t B = 2000 * sizeof(float);
+  const int64_t temp = 500 * sizeof(float);
+  EXPECT_EQ(tracker.LiveBytes()[-1], A + B);
+  // the temporary of the second op is live when B is allocated
+  EXPECT_EQ(tracker.PeakBytes()[-1], A + B + temp);
+  const auto composition = tracker.PeakComposition(-1);
+  ASSERT_EQ(composition.size(), 3);
+  EXPECT_EQ(composition[0].op, "MemoryAlloc B");
+  EXPECT_EQ(composition[0].blob, "B");
+  EXPECT_EQ(composition[0].bytes, B);
+  EXPECT_EQ(composition[1].op, "MemoryAlloc A");
+  EXPECT_EQ(composition[1].blob, "A");
+  EXPECT_EQ(composition[2].op, "MemoryAlloc B");
+  EXPECT_EQ(composition[2].blob, "");
+  EXPECT_EQ(composition[2].bytes, temp);
+
+  const auto report = observer->debugInfo();
+  EXPECT_NE(report.find("peak of cpu: 0.0 MB"), std::string::npos);
+  EXPECT_NE(report.find("MemoryAlloc B -> B"), std::string::npos);
+
+  // nothing is tracked while stopped
+  Workspace other;
+  auto untracked = CreateMemoryNet(&other);
+  untracked->Run();
+  EXPECT_EQ(tracker.LiveBytes()[-1], A + B);
+}
+
+} // namespace caffe2
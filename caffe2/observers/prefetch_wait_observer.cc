@@ -0,0 +1,48 @@
+#include "prefetch_wait_observer.h"
+
+#include <algorithm>
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+PrefetchWaitObserver::PrefetchWaitObserver(NetBase* subject)
+    : ObserverBase<NetBase>(subject) {
+  for (const auto* op : subject->GetOperators()) {
+    const auto* counter = dynamic_cast<const PrefetchWaitCounter*>(op);
+    if (counter) {
+      counters_.push_back(counter);
+    }
+  }
+  start_waits_.resize(counters_.size());
+}
+
+void PrefetchWaitObserver::reset() {
+  total_time_ = 0;
+  total_wait_time_ = 0;
+  iterations_ = 0;
+}
+
+void PrefetchWaitObserver::Start() {
+  for (int i = 0; i < counters_.size(); ++i) {
+    start_waits_[i] = counters_[i]->total_wait_ms();
+  }
+  timer_.Start();
+}
+
+void PrefetchWaitObserver::Stop() {
+  const float run_time = timer_.MilliSeconds();
+  float wait_time = 0;
+  for (int i = 0; i < counters_.size(); ++i) {
+    wait_time = std::max<float>(
+        wait_time, counters_[i]->total_wait_ms() - start_waits_[i]);
+  }
+  last_wait_time_ = wait_time;
+  total_time_ += run_time;
+  total_wait_time_ += std::min(wait_time, run_time);
+  ++iterations_;
+  VLOG(1) << "This net iteration waited " << wait_time << " of " << run_time
+          << " ms for its input.";
+}
+
+} // namespace caffe2
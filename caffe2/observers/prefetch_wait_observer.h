@@ -0,0 +1,56 @@
+#ifndef CAFFE2_CONTRIB_OBSERVERS_PREFETCH_WAIT_OBSERVER_H_
+#define CAFFE2_CONTRIB_OBSERVERS_PREFETCH_WAIT_OBSERVER_H_
+
+#include <vector>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/observer.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/operators/prefetch_op.h"
+
+namespace caffe2 {
+
+// Measures how input bound a net is: the time its runs are stalled on the
+// prefetching threads of its PrefetchOperators, as a fraction of the time
+// of the runs. The towers of a data parallel net wait on their input ops
+// at the same time, so a run is charged the longest wait of its input ops.
+class PrefetchWaitObserver final : public ObserverBase<NetBase> {
+ public:
+  explicit PrefetchWaitObserver(NetBase* subject);
+
+  // since the construction or the last reset()
+  float stall_fraction() const {
+    return total_time_ > 0 ? total_wait_time_ / total_time_ : 0;
+  }
+  float average_wait_time() const {
+    return iterations_ > 0 ? total_wait_time_ / iterations_ : 0;
+  }
+  float average_time() const {
+    return iterations_ > 0 ? total_time_ / iterations_ : 0;
+  }
+  float last_wait_time() const {
+    return last_wait_time_;
+  }
+  int num_prefetch_ops() const {
+    return counters_.size();
+  }
+
+  void reset();
+
+ private:
+  void Start() override;
+  void Stop() override;
+
+  std::vector<const PrefetchWaitCounter*> counters_;
+  std::vector<double> start_waits_;
+  Timer timer_;
+  double total_time_ = 0;
+  double total_wait_time_ = 0;
+  float last_wait_time_ = 0;
+  int iterations_ = 0;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_CONTRIB_OBSERVERS_PREFETCH_WAIT_OBSERVER_H_
@@ -0,0 +1,103 @@
+#include "caffe2/core/common.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/operators/prefetch_op.h"
+#include "prefetch_wait_observer.h"
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+
+namespace caffe2 {
+
+namespace {
+
+// prefetches a batch in prefetch_ms
+class SlowPrefetchOp final : public PrefetchOperator<CPUContext> {
+ public:
+  SlowPrefetchOp(const OperatorDef& operator_def, Workspace* ws)
+      : PrefetchOperator<CPUContext>(operator_def, ws),
+        prefetch_ms_(GetSingleArgument<int>("prefetch_ms", 0)) {}
+
+  ~SlowPrefetchOp() {
+    PrefetchOperator<CPUContext>::Finalize();
+  }
+
+  bool Prefetch() override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(prefetch_ms_));
+    return true;
+  }
+
+  bool CopyPrefetched() override {
+    return true;
+  }
+
+ private:
+  const int prefetch_ms_;
+};
+
+// computes on the batch for compute_ms
+class ComputeOp final : public OperatorBase {
+ public:
+  ComputeOp(const OperatorDef& operator_def, Workspace* ws)
+      : OperatorBase(operator_def, ws),
+        compute_ms_(GetSingleArgument<int>("compute_ms", 0)) {}
+
+  bool Run(int /* unused */) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(compute_ms_));
+    return true;
+  }
+
+ private:
+  const int compute_ms_;
+};
+
+REGISTER_CPU_OPERATOR(SlowPrefetch, SlowPrefetchOp);
+OPERATOR_SCHEMA(SlowPrefetch).NumInputs(0).NumOutputs(0, 1);
+REGISTER_CPU_OPERATOR(Compute, ComputeOp);
+OPERATOR_SCHEMA(Compute).NumInputs(0, 1).NumOutputs(0);
+
+float RunStallFraction(int prefetch_ms, int compute_ms, bool no_prefetch) {
+  Workspace ws;
+  NetDef net_def;
+  auto& input = *net_def.add_op();
+  input.set_type("SlowPrefetch");
+  input.add_output("batch");
+  AddArgument<int>("prefetch_ms", prefetch_ms, &input);
+  AddArgument<bool>("no_prefetch", no_prefetch, &input);
+  auto& compute = *net_def.add_op();
+  compute.set_type("Compute");
+  compute.add_input("batch");
+  AddArgument<int>("compute_ms", compute_ms, &compute);
+  unique_ptr<NetBase> net(CreateNet(net_def, &ws));
+  auto net_ob = caffe2::make_unique<PrefetchWaitObserver>(net.get());
+  auto* ob = net_ob.get();
+  net->AttachObserver(std::move(net_ob));
+  EXPECT_EQ(ob->num_prefetch_ops(), 1);
+  // only the input op is counted; the first run waits for the first batch
+  // in any case
+  net->Run();
+  ob->reset();
+  for (int i = 0; i < 5; ++i) {
+    net->Run();
+  }
+  return ob->stall_fraction();
+}
+
+} // namespace
+
+TEST(PrefetchWaitObserverTest, InputBound) {
+  EXPECT_GT(RunStallFraction(40, 10, false), 0.5);
+}
+
+TEST(PrefetchWaitObserverTest, ComputeBound) {
+  EXPECT_LT(RunStallFraction(10, 40, false), 0.2);
+}
+
+TEST(PrefetchWaitObserverTest, NoPrefetchWaitsForPrefetch) {
+  const float fraction = RunStallFraction(30, 10, true);
+  EXPECT_GT(fraction, 0.6);
+  EXPECT_LT(fraction, 0.9);
+}
+
+} // namespace caffe2
@@ -0,0 +1,95 @@
+#include "timeline_observer.h"
+
+namespace caffe2 {
+
+CAFFE_DEFINE_REGISTRY(TimelineDeviceRecorderRegistry, TimelineDeviceRecorder);
+
+namespace {
+
+bool IsAllreduce(const string& type) {
+  return type.find("Allreduce") != string::npos ||
+      type.find("NCCL") != string::npos || type.find("Broadcast") == 0;
+}
+
+} // namespace
+
+TimelineOperatorObserver::TimelineOperatorObserver(
+    OperatorBase* subject,
+    TimelineObserver* net)
+    : ObserverBase<OperatorBase>(subject), net_(net), category_("op") {
+  if (subject->has_debug_def()) {
+    const auto& def = subject->debug_def();
+    name_ = def.type();
+    if (def.output_size() > 0) {
+      name_ += " " + def.output(0);
+    }
+    if (IsAllreduce(def.type())) {
+      category_ = "allreduce";
+    }
+  }
+}
+
+void TimelineOperatorObserver::Start() {
+  if (!TimelineRecorder::Get().enabled()) {
+    begin_us_ = -1;
+    return;
+  }
+  begin_us_ = TimelineRecorder::NowMicros();
+  auto* device_recorder = net_->device_recorder();
+  device_span_ = device_recorder && subject_->device_option().device_type() ==
+          CUDA
+      ? device_recorder->OpStart(subject_)
+      : -1;
+}
+
+void TimelineOperatorObserver::Stop() {
+  if (begin_us_ < 0) {
+    return;
+  }
+  if (device_span_ >= 0) {
+    net_->device_recorder()->OpStop(subject_, device_span_);
+  }
+  TimelineRecorder::Get().Record(TimelineSpan{name_,
+                                              category_,
+                                              kTimelineHost,
+                                              TimelineRecorder::ThreadLane(),
+                                              begin_us_,
+                                              TimelineRecorder::NowMicros()});
+}
+
+TimelineObserver::TimelineObserver(NetBase* subject)
+    : OperatorAttachingNetObserver<TimelineOperatorObserver, TimelineObserver>(
+          subject,
+          this) {
+  if (TimelineDeviceRecorderRegistry()->Has("CUDA")) {
+    device_recorder_ = TimelineDeviceRecorderRegistry()->Create("CUDA");
+  }
+}
+
+void TimelineObserver::Start() {
+  if (!TimelineRecorder::Get().enabled()) {
+    begin_us_ = -1;
+    return;
+  }
+  begin_us_ = TimelineRecorder::NowMicros();
+  if (device_recorder_) {
+    device_recorder_->NetStart();
+  }
+}
+
+void TimelineObserver::Stop() {
+  if (begin_us_ < 0) {
+    return;
+  }
+  if (device_recorder_) {
+    device_recorder_->NetStop();
+  }
+  TimelineRecorder::Get().Record(TimelineSpan{"iteration " + subject_->Name(),
+                                              "iteration",
+                                              kTimelineHost,
+                                              TimelineRecorder::ThreadLane(),
+                                              begin_us_,
+                                              TimelineRecorder::NowMicros()});
+}
+
+} // namespace caffe2
@@ -0,0 +1,78 @@
+#ifndef CAFFE2_CONTRIB_OBSERVERS_TIMELINE_OBSERVER_H_
+#define CAFFE2_CONTRIB_OBSERVERS_TIMELINE_OBSERVER_H_
+
+#include <memory>
+#include <string>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/observer.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/registry.h"
+#include "caffe2/observers/operator_attaching_net_observer.h"
+#include "caffe2/utils/timeline.h"
+
+namespace caffe2 {
+
+// Records the device side spans of the ops of a device type, registered in
+// TimelineDeviceRecorderRegistry under the name of the device type, e.g. by
+// timeline_observer_gpu.cc for CUDA. The spans of a run are placed on the
+// host clock when the net run ends.
+class TimelineDeviceRecorder {
+ public:
+  virtual ~TimelineDeviceRecorder() {}
+
+  virtual void NetStart() = 0;
+  // returns a handle of the op's span for OpStop
+  virtual int OpStart(const OperatorBase* op) = 0;
+  virtual void OpStop(const OperatorBase* op, int span) = 0;
+  // waits for the spans of the run and records them
+  virtual void NetStop() = 0;
+};
+
+CAFFE_DECLARE_REGISTRY(TimelineDeviceRecorderRegistry, TimelineDeviceRecorder);
+
+class TimelineObserver;
+
+class TimelineOperatorObserver final : public ObserverBase<OperatorBase> {
+ public:
+  TimelineOperatorObserver(OperatorBase* subject, TimelineObserver* net);
+
+ private:
+  void Start() override;
+  void Stop() override;
+
+  TimelineObserver* net_;
+  std::string name_;
+  const char* category_;
+  int64_t begin_us_ = -1;
+  int device_span_ = -1;
+};
+
+// Records the spans of the runs of a net and of its ops into the
+// TimelineRecorder while the recorder is started: the host spans of the
+// ops per thread, the device spans of the CUDA ops per stream and the
+// iterations themselves. Together with the spans of the input ops
+// (prefetch waits, decoding) this puts data loading and compute on one
+// timeline. While the recorder is stopped a run costs a flag check per op.
+class TimelineObserver final
+    : public OperatorAttachingNetObserver<TimelineOperatorObserver,
+                                          TimelineObserver> {
+ public:
+  explicit TimelineObserver(NetBase* subject);
+
+  TimelineDeviceRecorder* device_recorder() {
+    return device_recorder_.get();
+  }
+
+ private:
+  void Start() override;
+  void Stop() override;
+
+  std::unique_ptr<TimelineDeviceRecorder> device_recorder_;
+  int64_t begin_us_ = -1;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_CONTRIB_OBSERVERS_TIMELINE_OBSERVER_H_
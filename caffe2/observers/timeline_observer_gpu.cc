@@ -0,0 +1,154 @@
+#include "timeline_observer.h"
+
+#include <map>
+#include <mutex> // NOLINT
+#include <vector>
+
+#include "caffe2/core/context_gpu.h"
+
+namespace caffe2 {
+
+namespace {
+
+// Records a pair of CUDA events around each CUDA op on the op's stream. The
+// first op of a run on a GPU also records a reference event, waits for it
+// and takes the host time, so that the elapsed times of the events from the
+// reference event place the spans on the host clock. The waits and the
+// reads of the events only happen while the timeline is recorded.
+class CUDATimelineRecorder final : public TimelineDeviceRecorder {
+ public:
+  ~CUDATimelineRecorder() override {
+    for (auto& device_events : free_events_) {
+      DeviceGuard guard(device_events.first);
+      for (auto event : device_events.second) {
+        CUDA_CHECK(cudaEventDestroy(event));
+      }
+    }
+  }
+
+  void NetStart() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    spans_.clear();
+    references_.clear();
+  }
+
+  int OpStart(const OperatorBase* op) override {
+    auto cuda_op = dynamic_cast_if_rtti<const Operator<CUDAContext>*>(op);
+    if (!cuda_op) {
+      return -1;
+    }
+    const auto* context = cuda_op->getContext();
+    const int gpu = context->cuda_gpu_id();
+    const auto stream = context->cuda_stream();
+    DeviceGuard guard(gpu);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (references_.find(gpu) == references_.end()) {
+      auto reference = NewEvent(gpu);
+      CUDA_ENFORCE(cudaEventRecord(reference, stream));
+      CUDA_ENFORCE(cudaEventSynchronize(reference));
+      references_[gpu] = {reference, TimelineRecorder::NowMicros()};
+    }
+    DeviceSpan span;
+    span.name = op->has_debug_def() ? op->debug_def().type() : "";
+    span.gpu = gpu;
+    span.stream = stream;
+    span.start = NewEvent(gpu);
+    CUDA_ENFORCE(cudaEventRecord(span.start, stream));
+    spans_.push_back(std::move(span));
+    return spans_.size() - 1;
+  }
+
+  void OpStop(const OperatorBase* /* op */, int index) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& span = spans_[index];
+    DeviceGuard guard(span.gpu);
+    span.stop = NewEvent(span.gpu);
+    CUDA_ENFORCE(cudaEventRecord(span.stop, span.stream));
+  }
+
+  void NetStop() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& recorder = TimelineRecorder::Get();
+    for (auto& span : spans_) {
+      if (!span.stop) {
+        continue;
+      }
+      DeviceGuard guard(span.gpu);
+      CUDA_ENFORCE(cudaEventSynchronize(span.stop));
+      const auto& reference = references_[span.gpu];
+      float begin_ms = 0;
+      float end_ms = 0;
+      CUDA_ENFORCE(
+          cudaEventElapsedTime(&begin_ms, reference.first, span.start));
+      CUDA_ENFORCE(cudaEventElapsedTime(&end_ms, reference.first, span.stop));
+      recorder.Record(TimelineSpan{
+          span.name,
+          "cuda",
+          span.gpu,
+          StreamLane(span.gpu, span.stream),
+          reference.second + static_cast<int64_t>(begin_ms * 1000),
+          reference.second + static_cast<int64_t>(end_ms * 1000)});
+    }
+    for (auto& span : spans_) {
+      free_events_[span.gpu].push_back(span.start);
+      if (span.stop) {
+        free_events_[span.gpu].push_back(span.stop);
+      }
+    }
+    for (auto& reference : references_) {
+      free_events_[reference.first].push_back(reference.second.first);
+    }
+    spans_.clear();
+    references_.clear();
+  }
+
+ private:
+  struct DeviceSpan {
+    std::string name;
+    int gpu;
+    cudaStream_t stream;
+    cudaEvent_t start = nullptr;
+    cudaEvent_t stop = nullptr;
+  };
+
+  // called with mutex_ held and the device of gpu current
+  cudaEvent_t NewEvent(int gpu) {
+    auto& events = free_events_[gpu];
+    if (!events.empty()) {
+      auto event = events.back();
+      events.pop_back();
+      return event;
+    }
+    cudaEvent_t event;
+    CUDA_ENFORCE(cudaEventCreate(&event));
+    return event;
+  }
+
+  // a small id of the stream on its GPU, in the order the streams are seen
+  int64_t StreamLane(int gpu, cudaStream_t stream) {
+    auto& lanes = stream_lanes_[gpu];
+    const auto it = lanes.find(stream);
+    if (it != lanes.end()) {
+      return it->second;
+    }
+    const int64_t lane = lanes.size();
+    lanes[stream] = lane;
+    return lane;
+  }
+
+  std::mutex mutex_;
+  std::vector<DeviceSpan> spans_;
+  // gpu -> reference event and its host time
+  std::map<int, std::pair<cudaEvent_t, int64_t>> references_;
+  std::map<int, std::vector<cudaEvent_t>> free_events_;
+  std::map<int, std::map<cudaStream_t, int64_t>> stream_lanes_;
+};
+
+} // namespace
+
+CAFFE_REGISTER_CLASS(
+    TimelineDeviceRecorderRegistry,
+    CUDA,
+    CUDATimelineRecorder);
+
+} // namespace caffe2
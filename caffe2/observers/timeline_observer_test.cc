@@ -0,0 +1,95 @@
+#include "caffe2/core/common.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/operators/prefetch_op.h"
+#include "timeline_observer.h"
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <map>
+#include <thread>
+
+namespace caffe2 {
+
+namespace {
+
+class TimelinePrefetchOp final : public PrefetchOperator<CPUContext> {
+ public:
+  TimelinePrefetchOp(const OperatorDef& operator_def, Workspace* ws)
+      : PrefetchOperator<CPUContext>(operator_def, ws) {}
+
+  ~TimelinePrefetchOp() {
+    PrefetchOperator<CPUContext>::Finalize();
+  }
+
+  bool Prefetch() override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    return true;
+  }
+
+  bool CopyPrefetched() override {
+    return true;
+  }
+};
+
+class TimelineComputeOp final : public Operator<CPUContext> {
+ public:
+  TimelineComputeOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws) {}
+
+  bool RunOnDevice() override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return true;
+  }
+};
+
+REGISTER_CPU_OPERATOR(TimelinePrefetch, TimelinePrefetchOp);
+OPERATOR_SCHEMA(TimelinePrefetch).NumInputs(0).NumOutputs(0, 1);
+REGISTER_CPU_OPERATOR(TimelineCompute, TimelineComputeOp);
+OPERATOR_SCHEMA(TimelineCompute).NumInputs(0, 1).NumOutputs(0, 1);
+
+unique_ptr<NetBase> CreateTimelineNet(Workspace* ws) {
+  NetDef net_def;
+  net_def.set_name("timeline");
+  auto& input = *net_def.add_op();
+  input.set_type("TimelinePrefetch");
+  input.add_output("batch");
+  auto& compute = *net_def.add_op();
+  compute.set_type("TimelineCompute");
+  compute.add_input("batch");
+  compute.add_output("loss");
+  unique_ptr<NetBase> net(CreateNet(net_def, ws));
+  net->AttachObserver(caffe2::make_unique<TimelineObserver>(net.get()));
+  return net;
+}
+
+TEST(TimelineObserverTest, RecordsTheSpansOfStartedRuns) {
+  Workspace ws;
+  auto net = CreateTimelineNet(&ws);
+  auto& recorder = TimelineRecorder::Get();
+  recorder.Start(1000);
+  recorder.Stop();
+  net->Run();
+  EXPECT_TRUE(recorder.Spans().empty());
+
+  recorder.Start(1000);
+  net->Run();
+  net->Run();
+  recorder.Stop();
+  std::map<std::string, int> counts;
+  for (const auto& span : recorder.Spans()) {
+    ++counts[span.name];
+    EXPECT_EQ(span.pid, kTimelineHost);
+    EXPECT_LE(span.begin_us, span.end_us);
+  }
+  EXPECT_EQ(counts["iteration timeline"], 2);
+  EXPECT_EQ(counts["TimelineCompute loss"], 2);
+  // the input op does not run its observers; its wait has a span of its own
+  EXPECT_EQ(counts["prefetch wait"], 2);
+  // the prefetching thread may be a batch ahead
+  EXPECT_GE(counts["prefetch"], 1);
+}
+
+} // namespace
+
+} // namespace caffe2
@@ -3,7 +3,9 @@
 #include "caffe2/onnx/helper.h"
 #include "caffe2/proto/caffe2_legacy.pb.h"
 #include "caffe2/utils/map_utils.h"
+#include "caffe2/utils/proto_utils.h"
 
+#include <numeric>
 #include <unordered_set>
 
 namespace caffe2 {
@@ -138,7 +140,9 @@ OnnxExporter::get_special_operators() const {
         {"LRN", &OnnxExporter::CreateLrnNodes},
         {"Reshape", &OnnxExporter::CreateReshapeNodes},
         {"Slice", &OnnxExporter::CreateSliceNodes},
-        {"ChannelShuffle",  &OnnxExporter::CreateChannelShuffleNodes}
+        {"ChannelShuffle",  &OnnxExporter::CreateChannelShuffleNodes},
+        {"AffineNd", &OnnxExporter::CreateAffineNdNodes},
+        {"BatchMatMul", &OnnxExporter::CreateBatchMatMulNodes}
       };
   return kSpecialOperators;
 }
@@ -268,11 +272,18 @@ ConvertedResult OnnxExporter::CreateConvPoolNodes(
     }
   }
 
-  ApplyTrans(&attrs, global, "kernel", 2, "kernel_shape");
-  ApplyTrans(&attrs, global, "stride");
-  ApplyTrans(&attrs, global, "dilation");
-  ApplyTrans(&attrs, global, "adj");
-  ApplyTrans(&attrs, global, "pad", 4);
+  // the single value args are given for every spatial dim, e.g. 3 of the
+  // N x C x T x H x W clips of the video nets
+  int spatial_dims = 2;
+  const auto input_shape = shapes.find(def.input(0));
+  if (input_shape != shapes.end() && input_shape->second.dims_size() > 2) {
+    spatial_dims = input_shape->second.dims_size() - 2;
+  }
+  ApplyTrans(&attrs, global, "kernel", spatial_dims, "kernel_shape");
+  ApplyTrans(&attrs, global, "stride", spatial_dims);
+  ApplyTrans(&attrs, global, "dilation", spatial_dims);
+  ApplyTrans(&attrs, global, "adj", spatial_dims);
+  ApplyTrans(&attrs, global, "pad", 2 * spatial_dims);
 
   // Fix legacy pad attr
   auto it = attrs.find("legacy_pad");
@@ -374,6 +385,106 @@ ConvertedResult OnnxExporter::CreateConcatNodes(
   return result;
 }
 
+ConvertedResult OnnxExporter::CreateAffineNdNodes(
+    const caffe2::OperatorDef& def,
+    const std::unordered_map<std::string, caffe2::TensorShape>& shapes) {
+  CAFFE_ENFORCE_EQ(def.input_size(), 3);
+  for (const auto& a : def.arg()) {
+    CAFFE_ENFORCE(
+        a.name() != "order" || a.s() == "NCHW",
+        "Only NCHW AffineNd can be exported to ONNX");
+  }
+  // Y = X * scale + bias, both broadcast along the channels
+  ConvertedResult result;
+  auto& nodes = result.first;
+  const auto scaled = DummyName::NewDummyName();
+  nodes.emplace_back(MakeNode(
+      "Mul",
+      {def.input(0), def.input(1)},
+      {scaled},
+      {MakeAttribute("broadcast", 1), MakeAttribute("axis", 1)}));
+  nodes.emplace_back(MakeNode(
+      "Add",
+      {scaled, def.input(2)},
+      {def.output(0)},
+      {MakeAttribute("broadcast", 1), MakeAttribute("axis", 1)},
+      def.name()));
+  return result;
+}
+
+ConvertedResult OnnxExporter::CreateBatchMatMulNodes(
+    const caffe2::OperatorDef& def,
+    const std::unordered_map<std::string, caffe2::TensorShape>& shapes) {
+  CAFFE_ENFORCE_EQ(def.input_size(), 2);
+  ArgumentHelper args(def);
+  const float alpha = args.GetSingleArgument<float>("alpha", 1.0f);
+  auto y = def.output(0);
+
+  ConvertedResult result;
+  auto& nodes = result.first;
+  auto& const_tensors = result.second;
+
+  // the permutation of an operand, then the swap of its last two dims
+  const auto permute = [&](const std::string& x,
+                           const std::string& axes_name,
+                           const std::string& trans_name) {
+    const auto ndim = shapes.at(x).dims_size();
+    std::vector<int64_t> perm(ndim);
+    std::iota(perm.begin(), perm.end(), 0);
+    if (args.HasArgument(axes_name)) {
+      const auto axes = args.GetRepeatedArgument<int64_t>(axes_name);
+      CAFFE_ENFORCE_EQ(axes.size(), static_cast<size_t>(ndim), axes_name);
+      perm = axes;
+    }
+    if (args.GetSingleArgument<int>(trans_name, 0) && ndim >= 2) {
+      std::swap(perm[ndim - 2], perm[ndim - 1]);
+    }
+    std::vector<int64_t> identity(ndim);
+    std::iota(identity.begin(), identity.end(), 0);
+    if (perm == identity) {
+      return x;
+    }
+    const auto transposed = DummyName::NewDummyName();
+    nodes.emplace_back(MakeNode(
+        "Transpose", {x}, {transposed}, {MakeAttribute("perm", perm)}));
+    return transposed;
+  };
+  const auto a = permute(def.input(0), "axes_a", "trans_a");
+  const auto b = permute(def.input(1), "axes_b", "trans_b");
+
+  const bool has_axes_y = args.HasArgument("axes_y");
+  const auto product =
+      (has_axes_y || alpha != 1.0f) ? DummyName::NewDummyName() : y;
+  nodes.emplace_back(MakeNode("MatMul", {a, b}, {product}, def.name()));
+
+  auto scaled = product;
+  if (alpha != 1.0f) {
+    scaled = has_axes_y ? DummyName::NewDummyName() : y;
+    TensorProto alpha_tensor;
+    alpha_tensor.set_name(DummyName::NewDummyName());
+    alpha_tensor.set_data_type(TensorProto::FLOAT);
+    alpha_tensor.add_dims(1);
+    alpha_tensor.add_float_data(alpha);
+    const_tensors.emplace_back(alpha_tensor);
+    nodes.emplace_back(MakeNode(
+        "Mul",
+        {product, alpha_tensor.name()},
+        {scaled},
+        {MakeAttribute("broadcast", 1)}));
+  }
+
+  if (has_axes_y) {
+    nodes.emplace_back(MakeNode(
+        "Transpose",
+        {scaled},
+        {y},
+        {MakeAttribute(
+            "perm", args.GetRepeatedArgument<int64_t>("axes_y"))}));
+  }
+
+  return result;
+}
+
 ConvertedResult OnnxExporter::CreateChannelShuffleNodes(
     const caffe2::OperatorDef& def,
     const std::unordered_map<std::string, caffe2::TensorShape>& shapes) {
@@ -1,4 +1,5 @@
 #include "caffe2/operators/accuracy_op.h"
+#include "caffe2/utils/math.h"
 
 namespace caffe2 {
 
@@ -69,4 +70,87 @@ classes, it is considered a correct prediction.
           "accuracy");
 
 SHOULD_NOT_DO_GRADIENT(Accuracy);
+
+template <>
+bool AccumulateTopKAccuracyOp<float, CPUContext>::RunOnDevice() {
+  auto& X = Input(PREDICTION);
+  auto& label = Input(LABEL);
+  auto* counts = Output(0);
+  CAFFE_ENFORCE_GE(X.ndim(), 2);
+  const int N = X.dim32(0);
+  const int D = X.size_from_dim(1);
+  CAFFE_ENFORCE_EQ(label.ndim(), 1);
+  CAFFE_ENFORCE_EQ(label.dim32(0), N);
+  if (counts->size() != NumCounts()) {
+    // the first batch starts the counts
+    counts->Resize(NumCounts());
+    math::Set<float, CPUContext>(
+        NumCounts(), 0.f, counts->mutable_data<float>(), &context_);
+  }
+  const auto* Xdata = X.data<float>();
+  const auto* labelData = label.data<int>();
+  float* countsData = counts->mutable_data<float>();
+  const int num_k = top_k_.size();
+  for (int i = 0; i < N; ++i) {
+    const int label_i = labelData[i];
+    CAFFE_ENFORCE(label_i >= 0 && label_i < D, "Label out of range.");
+    const auto label_pred = Xdata[i * D + label_i];
+    // the rank of the label, as the first one of equal scores, overall and
+    // among the first first_n classes
+    int rank = 1;
+    int rank_n = 1;
+    for (int j = 0; j < D; ++j) {
+      const auto pred = Xdata[i * D + j];
+      if ((pred > label_pred) || (pred == label_pred && j < label_i)) {
+        ++rank;
+        rank_n += j < first_n_;
+      }
+    }
+    for (int k = 0; k < num_k; ++k) {
+      countsData[k] += rank <= top_k_[k];
+      if (first_n_ > 0) {
+        countsData[num_k + k] += label_i < first_n_ && rank_n <= top_k_[k];
+      }
+    }
+  }
+  countsData[NumCounts() - 1] += N;
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(
+    AccumulateTopKAccuracy,
+    AccumulateTopKAccuracyOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(AccumulateTopKAccuracy)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .EnforceInplace({{2, 0}})
+    .SetDoc(R"DOC(
+Accumulates the top-k accuracy of batches on the device of the op: adds the
+number of samples of the batch whose label is among the k top scoring classes,
+for every k of top_k, to the running counts, as well as the batch size. With
+first_n, the hits of the first first_n classes alone, i.e. of the first_n-way
+problem, follow. The counts are only started from 0 when their size does not
+match, so the caller resets them, e.g. by feeding zeros, after reading them.
+)DOC")
+    .Arg("top_k", "(int list, default [1]) the ks to count the hits of")
+    .Arg("first_n", "(int, default 0) also count the first first_n classes")
+    .Input(
+        0,
+        "predictions",
+        "tensor (Tensor<float>) of size (num_batches x num_classes x ...) "
+        "containing scores")
+    .Input(
+        1,
+        "labels",
+        "1-D tensor (Tensor<int>) of size (num_batches) having the indices of "
+        "true labels")
+    .Input(2, "counts", "the running counts, updated in place")
+    .Output(
+        0,
+        "counts",
+        "1-D tensor (Tensor<float>) of the hits of every k, those of "
+        "first_n, and the number of samples");
+
+SHOULD_NOT_DO_GRADIENT(AccumulateTopKAccuracy);
 }  // namespace caffe2
@@ -70,4 +70,102 @@ bool AccuracyOp<float, CUDAContext>::RunOnDevice() {
 }
 
 REGISTER_CUDA_OPERATOR(Accuracy, AccuracyOp<float, CUDAContext>);
+
+namespace {
+struct TopK {
+  int size;
+  int k[AccumulateTopKAccuracyOp<float, CUDAContext>::kMaxTopK];
+};
+
+// the ranks of the labels like AccuracyKernel, a block per row; thread 0 of
+// every block keeps its hits and adds them to the counts once
+__global__ void AccumulateTopKAccuracyKernel(
+    const int N,
+    const int D,
+    const TopK top_k,
+    const int first_n,
+    const float* Xdata,
+    const int* labelData,
+    float* counts) {
+  typedef cub::BlockReduce<int, CAFFE_CUDA_NUM_THREADS> BlockReduce;
+  __shared__ typename BlockReduce::TempStorage temp_storage;
+  int hits[AccumulateTopKAccuracyOp<float, CUDAContext>::kMaxTopK * 2] = {0};
+  for (int row = blockIdx.x; row < N; row += gridDim.x) {
+    const int label = labelData[row];
+    const float label_pred = Xdata[row * D + label];
+    int rank = 0;
+    int rank_n = 0;
+    for (int col = threadIdx.x; col < D; col += blockDim.x) {
+      const float pred = Xdata[row * D + col];
+      if (pred > label_pred || (pred == label_pred && col <= label)) {
+        ++rank;
+        rank_n += col < first_n;
+      }
+    }
+    rank = BlockReduce(temp_storage).Sum(rank);
+    __syncthreads();
+    if (first_n > 0) {
+      rank_n = BlockReduce(temp_storage).Sum(rank_n);
+      __syncthreads();
+    }
+    if (threadIdx.x == 0) {
+      for (int k = 0; k < top_k.size; ++k) {
+        hits[k] += rank <= top_k.k[k];
+        if (first_n > 0) {
+          hits[top_k.size + k] += label < first_n && rank_n <= top_k.k[k];
+        }
+      }
+    }
+  }
+  if (threadIdx.x == 0) {
+    const int num_hits = top_k.size * (first_n > 0 ? 2 : 1);
+    for (int i = 0; i < num_hits; ++i) {
+      atomicAdd(counts + i, static_cast<float>(hits[i]));
+    }
+    if (blockIdx.x == 0) {
+      atomicAdd(counts + num_hits, static_cast<float>(N));
+    }
+  }
+}
+} // namespace
+
+template <>
+bool AccumulateTopKAccuracyOp<float, CUDAContext>::RunOnDevice() {
+  auto& X = Input(PREDICTION);
+  auto& label = Input(LABEL);
+  auto* counts = Output(0);
+  CAFFE_ENFORCE_GE(X.ndim(), 2);
+  const int N = X.dim32(0);
+  const int D = X.size_from_dim(1);
+  CAFFE_ENFORCE_EQ(label.ndim(), 1);
+  CAFFE_ENFORCE_EQ(label.dim32(0), N);
+  if (counts->size() != NumCounts()) {
+    counts->Resize(NumCounts());
+    math::Set<float, CUDAContext>(
+        NumCounts(), 0.f, counts->mutable_data<float>(), &context_);
+  }
+  if (N == 0) {
+    return true;
+  }
+  TopK top_k;
+  top_k.size = top_k_.size();
+  std::copy(top_k_.begin(), top_k_.end(), top_k.k);
+  AccumulateTopKAccuracyKernel<<<
+      std::min(CAFFE_MAXIMUM_NUM_BLOCKS, N),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(
+      N,
+      D,
+      top_k,
+      first_n_,
+      X.data<float>(),
+      label.data<int>(),
+      counts->mutable_data<float>());
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(
+    AccumulateTopKAccuracy,
+    AccumulateTopKAccuracyOp<float, CUDAContext>);
 }  // namespace caffe2
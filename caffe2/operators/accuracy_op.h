@@ -21,6 +21,38 @@ class AccuracyOp final : public Operator<Context> {
   INPUT_TAGS(PREDICTION, LABEL);
 };
 
+// Adds the top-k hits of a batch for every k of top_k, and with first_n > 0
+// those among the first first_n classes, and the batch size to the running
+// counts, which stay on the device until they are fetched.
+template <typename T, class Context>
+class AccumulateTopKAccuracyOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  AccumulateTopKAccuracyOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        top_k_(OperatorBase::GetRepeatedArgument<int>("top_k", {1})),
+        first_n_(OperatorBase::GetSingleArgument<int>("first_n", 0)) {
+    CAFFE_ENFORCE(top_k_.size() > 0 && top_k_.size() <= kMaxTopK);
+    for (const int k : top_k_) {
+      CAFFE_ENFORCE_GT(k, 0);
+    }
+  }
+
+  bool RunOnDevice() override;
+
+  static constexpr int kMaxTopK = 8;
+
+ protected:
+  // hits of every k of top_k, then of the first_n classes, then the count
+  int NumCounts() const {
+    return top_k_.size() * (first_n_ > 0 ? 2 : 1) + 1;
+  }
+
+  std::vector<int> top_k_;
+  int first_n_;
+  INPUT_TAGS(PREDICTION, LABEL, COUNTS);
+};
+
 } // namespace caffe2
 
 #endif // CAFFE2_OPERATORS_ACCURACY_OP_H_
@@ -0,0 +1,18 @@
+#include "caffe2/operators/activation_arena_op.h"
+
+namespace caffe2 {
+REGISTER_CPU_OPERATOR(ActivationArena, ActivationArenaOp<CPUContext>);
+SHOULD_NOT_DO_GRADIENT(ActivationArena);
+
+OPERATOR_SCHEMA(ActivationArena)
+    .NumInputs(0)
+    .NumOutputs(1, INT_MAX)
+    .SetDoc(R"DOC(
+Allocates one arena and points every output at a slice of it, so that the
+ops that write the outputs later on reuse the arena instead of allocating.
+Run once, before the net, with the plan of memonger.plan_activation_memory.
+)DOC")
+    .Arg("arena_nbytes", "Bytes of the arena")
+    .Arg("offsets", "Offset of every output in the arena")
+    .Arg("nbytes", "Bytes of every output");
+} // namespace caffe2
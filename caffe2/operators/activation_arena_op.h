@@ -0,0 +1,58 @@
+#ifndef CAFFE2_OPERATORS_ACTIVATION_ARENA_OP_H_
+#define CAFFE2_OPERATORS_ACTIVATION_ARENA_OP_H_
+
+#include <memory>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+
+namespace caffe2 {
+
+// ActivationArenaOp allocates one arena of arena_nbytes and points every
+// output at its offset in it, with a capacity of its nbytes, as planned by
+// memonger::plan_activation_memory. The ops that later write the outputs
+// keep the arena memory as long as their tensors fit in the capacity and
+// allocate their own otherwise. The arena is freed with its last tensor.
+template <class Context>
+class ActivationArenaOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  ActivationArenaOp(const OperatorDef& def, Workspace* ws)
+      : Operator<Context>(def, ws),
+        arena_nbytes_(
+            OperatorBase::GetSingleArgument<int64_t>("arena_nbytes", 0)),
+        offsets_(OperatorBase::GetRepeatedArgument<int64_t>("offsets")),
+        nbytes_(OperatorBase::GetRepeatedArgument<int64_t>("nbytes")) {
+    CAFFE_ENFORCE_EQ(offsets_.size(), OutputSize());
+    CAFFE_ENFORCE_EQ(nbytes_.size(), OutputSize());
+    for (int i = 0; i < OutputSize(); ++i) {
+      CAFFE_ENFORCE_GT(nbytes_[i], 0);
+      CAFFE_ENFORCE_LE(offsets_[i] + nbytes_[i], arena_nbytes_);
+    }
+  }
+
+  bool RunOnDevice() override {
+    auto ptr_and_deleter = Context::New(arena_nbytes_);
+    std::shared_ptr<void> arena(
+        ptr_and_deleter.first, ptr_and_deleter.second);
+    for (int i = 0; i < OutputSize(); ++i) {
+      auto* Y = Output(i);
+      Y->Resize(nbytes_[i]);
+      Y->ShareExternalPointer(
+          static_cast<char*>(arena.get()) + offsets_[i],
+          TypeMeta::Make<uint8_t>(),
+          nbytes_[i],
+          [arena](void*) {});
+    }
+    return true;
+  }
+
+ private:
+  const int64_t arena_nbytes_;
+  const std::vector<int64_t> offsets_;
+  const std::vector<int64_t> nbytes_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_OPERATORS_ACTIVATION_ARENA_OP_H_
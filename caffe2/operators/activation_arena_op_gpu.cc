@@ -0,0 +1,6 @@
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/operators/activation_arena_op.h"
+
+namespace caffe2 {
+REGISTER_CUDA_OPERATOR(ActivationArena, ActivationArenaOp<CUDAContext>);
+} // namespace caffe2
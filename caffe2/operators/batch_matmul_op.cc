@@ -5,11 +5,73 @@ namespace caffe2 {
 
 REGISTER_CPU_OPERATOR(BatchMatMul, BatchMatMulOp<CPUContext>);
 
+namespace {
+
+vector<int> AxesOrIdentity(const vector<int>& axes, const int ndim) {
+  if (!axes.empty()) {
+    return axes;
+  }
+  vector<int> identity(ndim);
+  for (int i = 0; i < ndim; ++i) {
+    identity[i] = i;
+  }
+  return identity;
+}
+
+// the inverse of the permutation axes, empty for the identity
+vector<int> InverseAxes(const vector<int>& axes) {
+  vector<int> inverse(axes.size());
+  for (int i = 0; i < axes.size(); ++i) {
+    inverse[axes[i]] = i;
+  }
+  return inverse;
+}
+
+bool HasAxes(const ArgumentHelper& helper) {
+  return helper.HasArgument("axes_a") || helper.HasArgument("axes_b") ||
+      helper.HasArgument("axes_y");
+}
+
+} // namespace
+
 vector<TensorShape> TensorInferenceForBatchMatMul(
     const OperatorDef& def,
     const vector<TensorShape>& in) {
   ArgumentHelper helper(def);
   bool broadcast = helper.GetSingleArgument<int>("broadcast", 0);
+  if (HasAxes(helper)) {
+    // the permuted views of BatchMatMulOp::RunStridedWithType
+    const int ndim = in[0].dims_size();
+    CAFFE_ENFORCE_EQ(in[1].dims_size(), ndim);
+    const auto axes_a =
+        AxesOrIdentity(helper.GetRepeatedArgument<int>("axes_a"), ndim);
+    const auto axes_b =
+        AxesOrIdentity(helper.GetRepeatedArgument<int>("axes_b"), ndim);
+    const auto axes_y =
+        AxesOrIdentity(helper.GetRepeatedArgument<int>("axes_y"), ndim);
+    vector<TIndex> dims_A(ndim), dims_B(ndim), dims_Y(ndim);
+    for (int i = 0; i < ndim; ++i) {
+      dims_A[i] = in[0].dims(axes_a[i]);
+      dims_B[i] = in[1].dims(axes_b[i]);
+    }
+    if (helper.GetSingleArgument<int>("trans_a", 0)) {
+      std::swap(dims_A[ndim - 2], dims_A[ndim - 1]);
+    }
+    if (helper.GetSingleArgument<int>("trans_b", 0)) {
+      std::swap(dims_B[ndim - 2], dims_B[ndim - 1]);
+    }
+    for (int i = 0; i < ndim - 2; ++i) {
+      dims_Y[i] = std::max(dims_A[i], dims_B[i]);
+    }
+    dims_Y[ndim - 2] = dims_A[ndim - 2];
+    dims_Y[ndim - 1] = dims_B[ndim - 1];
+    vector<TIndex> output_dims(ndim);
+    for (int i = 0; i < ndim; ++i) {
+      output_dims[i] = dims_Y[axes_y[i]];
+    }
+    return vector<TensorShape>{
+        CreateTensorShape(output_dims, in[0].data_type())};
+  }
   if (!broadcast) {
     const auto ndim = in[0].dims_size();
     CAFFE_ENFORCE_GE(ndim, 2);
@@ -98,14 +160,18 @@ OpSchema::Cost CostInferenceForBatchMatMul(
   for (int i = 0; i < Y.dims_size(); i++) {
     nElemY *= Y.dims(i);
   }
+  const auto axes_a =
+      AxesOrIdentity(helper.GetRepeatedArgument<int>("axes_a"), ndims_A);
   size_t K;
   if (helper.GetSingleArgument<int>("trans_a", 0)) {
-    K = in[0].dims(ndims_A - 2);
+    K = in[0].dims(axes_a[ndims_A - 2]);
   } else {
-    K = in[0].dims(ndims_A - 1);
+    K = in[0].dims(axes_a[ndims_A - 1]);
   }
   c.flops = 2 * nElemY * K;
-  c.bytes_moved = nElemY * sizeof(float);
+  // A and B are read and Y written
+  c.bytes_moved =
+      (nElemFromDim(in[0]) + nElemFromDim(in[1]) + nElemY) * sizeof(float);
   c.params_bytes = 0;
   return c;
 }
@@ -133,9 +199,26 @@ two diemnsional, it behaves like normal matrix multiplication.
     .Arg(
         "broadcast",
         "Pass 1 to allow broadcasting of dimensions. Behavior is the same as numpy.matmul. Gradient is currently not supported when running in broadcast mode.")
+    .Arg(
+        "alpha",
+        "Y = alpha * A * B, e.g. to fold the Scale of the rows of an "
+        "attention affinity into its product (default 1)")
+    .Arg(
+        "axes_a",
+        "Permutation of the dims of A, as np.transpose, to read it as the "
+        "batch of matrices of the permuted tensor without copying it. The "
+        "permuted matrices must keep the last axis of A. A, B and Y then "
+        "have the same rank and batch dims of size 1 are broadcast with "
+        "broadcast=1.")
+    .Arg("axes_b", "Permutation of the dims of B, as axes_a")
+    .Arg(
+        "axes_y",
+        "Y is written as np.transpose(A * B, axes_y), e.g. (0, 2, 1, 3) "
+        "writes the product of (N, G, M, K) and (N, G, K, N) as (N, M, G, N)")
     .TensorInferenceFunction(TensorInferenceForBatchMatMul)
     .CostInferenceFunction(
-        OpSchema::CostInferenceFunctionType(CostInferenceForBatchMatMul));
+        OpSchema::CostInferenceFunctionType(CostInferenceForBatchMatMul))
+    .InheritOnnxSchema("MatMul");
 
 class GetBatchMatMulGradient : public GradientMakerBase {
   using GradientMakerBase::GradientMakerBase;
@@ -161,82 +244,80 @@ class GetBatchMatMulGradient : public GradientMakerBase {
       trans_b = GetArgument(Def(), "trans_b").i();
     }
 
-    auto no_trans_arg = vector<Argument>();
-    auto trans_a_arg = vector<Argument>{MakeArgument<int>("trans_a", 1)};
-    auto trans_b_arg = vector<Argument>{MakeArgument<int>("trans_b", 1)};
-    auto trans_both_arg = vector<Argument>{MakeArgument<int>("trans_a", 1),
-                                           MakeArgument<int>("trans_b", 1)};
-
-    if (ArgumentHelper::HasArgument(Def(), "use_scratch")) {
-      no_trans_arg.push_back(MakeArgument<int>("use_scratch", 1));
-      trans_a_arg.push_back(MakeArgument<int>("use_scratch", 1));
-      trans_b_arg.push_back(MakeArgument<int>("use_scratch", 1));
-      trans_both_arg.push_back(MakeArgument<int>("use_scratch", 1));
+    // With axes the gradients read every operand, and write dA and dB, with
+    // the permutation of its forward tensor: dY is read through the inverse
+    // of axes_y and dA is written through the inverse of axes_a.
+    ArgumentHelper helper(Def());
+    const bool has_axes = HasAxes(helper);
+    vector<vector<int>> axes(3);
+    if (has_axes) {
+      int ndim = 0;
+      for (const char* name : {"axes_a", "axes_b", "axes_y"}) {
+        ndim = std::max<int>(ndim, helper.GetRepeatedArgument<int>(name).size());
+      }
+      axes[0] = AxesOrIdentity(helper.GetRepeatedArgument<int>("axes_a"), ndim);
+      axes[1] = AxesOrIdentity(helper.GetRepeatedArgument<int>("axes_b"), ndim);
+      axes[2] = InverseAxes(
+          AxesOrIdentity(helper.GetRepeatedArgument<int>("axes_y"), ndim));
     }
+    // operands 0, 1 and 2 are A, B and dY
+    const vector<string> operands{I(0), I(1), GO(0)};
+    auto gradient = [&](const int first,
+                        const int second,
+                        const bool ta,
+                        const bool tb,
+                        const int input) {
+      vector<Argument> args;
+      if (ta) {
+        args.push_back(MakeArgument<int>("trans_a", 1));
+      }
+      if (tb) {
+        args.push_back(MakeArgument<int>("trans_b", 1));
+      }
+      if (has_axes) {
+        args.push_back(MakeArgument<vector<int>>("axes_a", axes[first]));
+        args.push_back(MakeArgument<vector<int>>("axes_b", axes[second]));
+        args.push_back(
+            MakeArgument<vector<int>>("axes_y", InverseAxes(axes[input])));
+      }
+      // both dA and dB are scaled by alpha
+      if (ArgumentHelper::HasArgument(Def(), "alpha")) {
+        args.push_back(GetArgument(Def(), "alpha"));
+      }
+      if (ArgumentHelper::HasArgument(Def(), "use_scratch")) {
+        args.push_back(MakeArgument<int>("use_scratch", 1));
+      }
+      return CreateOperatorDef(
+          "BatchMatMul",
+          "",
+          vector<string>{operands[first], operands[second]},
+          vector<string>{GI(input)},
+          args);
+    };
 
     if (trans_a) {
       if (trans_b) {
         // A'B':
         // dA = B'G', dB = G'A'
-        return vector<OperatorDef>{CreateOperatorDef(
-                                       "BatchMatMul",
-                                       "",
-                                       vector<string>{I(1), GO(0)},
-                                       vector<string>{GI(0)},
-                                       trans_both_arg),
-                                   CreateOperatorDef(
-                                       "BatchMatMul",
-                                       "",
-                                       vector<string>{GO(0), I(0)},
-                                       vector<string>{GI(1)},
-                                       trans_both_arg)};
+        return vector<OperatorDef>{gradient(1, 2, true, true, 0),
+                                   gradient(2, 0, true, true, 1)};
       } else {
         // A'B:
         // dA = BG', dB = AG
-        return vector<OperatorDef>{CreateOperatorDef(
-                                       "BatchMatMul",
-                                       "",
-                                       vector<string>{I(1), GO(0)},
-                                       vector<string>{GI(0)},
-                                       trans_b_arg),
-                                   CreateOperatorDef(
-                                       "BatchMatMul",
-                                       "",
-                                       vector<string>{I(0), GO(0)},
-                                       vector<string>{GI(1)},
-                                       no_trans_arg)};
+        return vector<OperatorDef>{gradient(1, 2, false, true, 0),
+                                   gradient(0, 2, false, false, 1)};
       }
     } else {
       if (trans_b) {
         // AB':
         // dA = GB, dB = G'A
-        return vector<OperatorDef>{CreateOperatorDef(
-                                       "BatchMatMul",
-                                       "",
-                                       vector<string>{GO(0), I(1)},
-                                       vector<string>{GI(0)},
-                                       no_trans_arg),
-                                   CreateOperatorDef(
-                                       "BatchMatMul",
-                                       "",
-                                       vector<string>{GO(0), I(0)},
-                                       vector<string>{GI(1)},
-                                       trans_a_arg)};
+        return vector<OperatorDef>{gradient(2, 1, false, false, 0),
+                                   gradient(2, 0, true, false, 1)};
       } else {
         // AB:
         // dA = GB', dB = A'G
-        return vector<OperatorDef>{CreateOperatorDef(
-                                       "BatchMatMul",
-                                       "",
-                                       vector<string>{GO(0), I(1)},
-                                       vector<string>{GI(0)},
-                                       trans_b_arg),
-                                   CreateOperatorDef(
-                                       "BatchMatMul",
-                                       "",
-                                       vector<string>{I(0), GO(0)},
-                                       vector<string>{GI(1)},
-                                       trans_a_arg)};
+        return vector<OperatorDef>{gradient(2, 1, false, true, 0),
+                                   gradient(0, 2, true, false, 1)};
       }
     }
   }
@@ -1,6 +1,7 @@
 #ifndef CAFFE2_OPERATORS_MATMUL_OP_H_
 #define CAFFE2_OPERATORS_MATMUL_OP_H_
 
+#include <algorithm>
 #include <sstream>
 
 #include "caffe2/core/context.h"
@@ -18,6 +19,10 @@ class BatchMatMulOp final : public Operator<Context> {
         trans_a_(OperatorBase::GetSingleArgument<int>("trans_a", 0)),
         trans_b_(OperatorBase::GetSingleArgument<int>("trans_b", 0)),
         broadcast_(OperatorBase::GetSingleArgument<int>("broadcast", 0)),
+        alpha_(OperatorBase::GetSingleArgument<float>("alpha", 1.0f)),
+        axes_a_(OperatorBase::GetRepeatedArgument<int>("axes_a")),
+        axes_b_(OperatorBase::GetRepeatedArgument<int>("axes_b")),
+        axes_y_(OperatorBase::GetRepeatedArgument<int>("axes_y")),
         use_scratch_(OperatorBase::GetSingleArgument<int>("use_scratch", 0)) {
     if (use_scratch_) {
       scratch_ = std::make_shared<Tensor<Context>>();
@@ -41,6 +46,14 @@ class BatchMatMulOp final : public Operator<Context> {
     auto ndims_B = B.ndim();
     auto dims_B = B.dims();
 
+    // permuted operands and numpy broadcasting of batch dims of size 1 go
+    // through the strided path
+    if (!axes_a_.empty() || !axes_b_.empty() || !axes_y_.empty() ||
+        (broadcast_ && ndims_A == ndims_B && ndims_A > 2 &&
+         !std::equal(dims_A.begin(), dims_A.end() - 2, dims_B.begin()))) {
+      return RunStridedWithType<T>();
+    }
+
     auto noBroadcastErrorMsg = [](size_t dim1, size_t dim2) {
       std::stringstream ss;
       ss << "Inputs with dimensions A = ";
@@ -94,6 +107,14 @@ class BatchMatMulOp final : public Operator<Context> {
       Y->Resize(1);
       math::Dot<T, Context>(
           dims_A[0], data_A, data_B, Y->template mutable_data<T>(), &context_);
+      if (alpha_ != 1.0f) {
+        math::Scale<T, Context>(
+            1,
+            alpha_,
+            Y->template data<T>(),
+            Y->template mutable_data<T>(),
+            &context_);
+      }
     } else {
       bool A_broadcasted = false, B_broadcasted = false;
       if (ndims_A == 1) {
@@ -262,7 +283,7 @@ class BatchMatMulOp final : public Operator<Context> {
             M,
             N,
             K,
-            1.0f,
+            alpha_,
             data_A + p * A_stride,
             data_B + p * B_stride,
             0.0f,
@@ -274,10 +295,242 @@ class BatchMatMulOp final : public Operator<Context> {
     return true;
   }
 
+  // Y = A * B on strided views: an operand of shape dims, read through the
+  // permutation axes (empty for the identity), is the tensor of dims
+  // dims[axes[i]] and strides strides[axes[i]], like np.transpose, and Y is
+  // written as np.transpose(A * B, axes_y). The last two axes of the views
+  // are the matrices, each with one unit stride, so e.g. a (N, C, G, L)
+  // tensor multiplies as the N x G matrices C x L of its (N, G, C, L)
+  // transpose without copying it. Batch dims of size 1 are broadcast with
+  // broadcast=1. The GEMMs of the last batch dim are one strided batched
+  // call, the other batch dims are looped over.
+  template <typename T>
+  bool RunStridedWithType() {
+    const auto& A = Input(0);
+    const auto& B = Input(1);
+    auto* Y = Output(0);
+
+    std::vector<TIndex> dims_A, strides_A, dims_B, strides_B;
+    PermutedView(A.dims(), axes_a_, &dims_A, &strides_A);
+    PermutedView(B.dims(), axes_b_, &dims_B, &strides_B);
+    const int ndim = dims_A.size();
+    CAFFE_ENFORCE_GE(ndim, 2);
+    CAFFE_ENFORCE_EQ(
+        dims_B.size(),
+        ndim,
+        "BatchMatMul with axes needs operands of the same rank");
+    if (trans_a_) {
+      std::swap(dims_A[ndim - 2], dims_A[ndim - 1]);
+      std::swap(strides_A[ndim - 2], strides_A[ndim - 1]);
+    }
+    if (trans_b_) {
+      std::swap(dims_B[ndim - 2], dims_B[ndim - 1]);
+      std::swap(strides_B[ndim - 2], strides_B[ndim - 1]);
+    }
+    CAFFE_ENFORCE_EQ(
+        dims_A[ndim - 1],
+        dims_B[ndim - 2],
+        "BatchMatMul inner dimensions of A and B don't match");
+
+    // batch dims of the output view, the ones of size 1 get the stride 0
+    std::vector<TIndex> dims_Y(ndim);
+    for (int i = 0; i < ndim - 2; ++i) {
+      if (dims_A[i] == dims_B[i]) {
+        dims_Y[i] = dims_A[i];
+      } else {
+        CAFFE_ENFORCE(
+            broadcast_ && (dims_A[i] == 1 || dims_B[i] == 1),
+            "BatchMatMul batch dim ",
+            i,
+            " of A and B don't match: ",
+            dims_A[i],
+            " vs ",
+            dims_B[i]);
+        dims_Y[i] = std::max(dims_A[i], dims_B[i]);
+        (dims_A[i] == 1 ? strides_A : strides_B)[i] = 0;
+      }
+    }
+    dims_Y[ndim - 2] = dims_A[ndim - 2];
+    dims_Y[ndim - 1] = dims_B[ndim - 1];
+
+    // Y is contiguous in the order of axes_y
+    std::vector<TIndex> stored_dims(ndim), strides_Y(ndim);
+    std::vector<int> axes_y = PermutationOrIdentity(axes_y_, ndim);
+    for (int i = 0; i < ndim; ++i) {
+      stored_dims[i] = dims_Y[axes_y[i]];
+    }
+    TIndex stride = 1;
+    for (int i = ndim - 1; i >= 0; --i) {
+      strides_Y[axes_y[i]] = stride;
+      stride *= stored_dims[i];
+    }
+    Y->Resize(stored_dims);
+    auto* Y_data = Y->template mutable_data<T>();
+    if (Y->size() == 0) {
+      return true;
+    }
+
+    const T* data_A = A.template data<T>();
+    const T* data_B = B.template data<T>();
+    // C = A * B is row major, with a row stride; else compute the column
+    // major Y as Y' = B' * A'
+    if (strides_Y[ndim - 1] != 1 && dims_Y[ndim - 1] != 1) {
+      std::swap(dims_A, dims_B);
+      std::swap(strides_A, strides_B);
+      std::swap(data_A, data_B);
+      for (auto* v : {&dims_A, &strides_A, &dims_B, &strides_B, &dims_Y,
+                      &strides_Y}) {
+        std::swap((*v)[ndim - 2], (*v)[ndim - 1]);
+      }
+    }
+    const int M = dims_Y[ndim - 2];
+    const int N = dims_Y[ndim - 1];
+    const int K = dims_A[ndim - 1];
+    CBLAS_TRANSPOSE trans_A, trans_B, trans_Y;
+    int lda, ldb, ldc;
+    MatrixLayout(M, K, strides_A[ndim - 2], strides_A[ndim - 1], &trans_A, &lda);
+    MatrixLayout(K, N, strides_B[ndim - 2], strides_B[ndim - 1], &trans_B, &ldb);
+    MatrixLayout(M, N, strides_Y[ndim - 2], strides_Y[ndim - 1], &trans_Y, &ldc);
+    CAFFE_ENFORCE(trans_Y == CblasNoTrans);
+
+    // drop the batch dims of size 1 and merge the ones that are contiguous
+    // in A, B and Y
+    std::vector<TIndex> batch, batch_A, batch_B, batch_Y;
+    for (int i = 0; i < ndim - 2; ++i) {
+      if (dims_Y[i] == 1) {
+        continue;
+      }
+      if (!batch.empty() && batch_A.back() == strides_A[i] * dims_Y[i] &&
+          batch_B.back() == strides_B[i] * dims_Y[i] &&
+          batch_Y.back() == strides_Y[i] * dims_Y[i]) {
+        batch.back() *= dims_Y[i];
+        batch_A.back() = strides_A[i];
+        batch_B.back() = strides_B[i];
+        batch_Y.back() = strides_Y[i];
+        continue;
+      }
+      batch.push_back(dims_Y[i]);
+      batch_A.push_back(strides_A[i]);
+      batch_B.push_back(strides_B[i]);
+      batch_Y.push_back(strides_Y[i]);
+    }
+    if (batch.empty()) {
+      batch = {1};
+      batch_A = batch_B = batch_Y = {0};
+    }
+
+    const int inner = batch.size() - 1;
+    std::vector<TIndex> index(inner, 0);
+    while (true) {
+      TIndex offset_A = 0, offset_B = 0, offset_Y = 0;
+      for (int i = 0; i < inner; ++i) {
+        offset_A += index[i] * batch_A[i];
+        offset_B += index[i] * batch_B[i];
+        offset_Y += index[i] * batch_Y[i];
+      }
+      math::GemmStridedBatched<T, Context, Engine>(
+          trans_A,
+          trans_B,
+          batch[inner],
+          M,
+          N,
+          K,
+          alpha_,
+          data_A + offset_A,
+          lda,
+          batch_A[inner],
+          data_B + offset_B,
+          ldb,
+          batch_B[inner],
+          0.0f,
+          Y_data + offset_Y,
+          ldc,
+          batch_Y[inner],
+          &context_);
+      int i = inner - 1;
+      for (; i >= 0 && ++index[i] == batch[i]; --i) {
+        index[i] = 0;
+      }
+      if (i < 0) {
+        break;
+      }
+    }
+    return true;
+  }
+
  protected:
+  static std::vector<int> PermutationOrIdentity(
+      const std::vector<int>& axes,
+      const int ndim) {
+    if (axes.empty()) {
+      std::vector<int> identity(ndim);
+      for (int i = 0; i < ndim; ++i) {
+        identity[i] = i;
+      }
+      return identity;
+    }
+    CAFFE_ENFORCE_EQ(axes.size(), ndim, "axes must be a permutation of dims");
+    std::vector<bool> seen(ndim, false);
+    for (const int axis : axes) {
+      CAFFE_ENFORCE(
+          axis >= 0 && axis < ndim && !seen[axis],
+          "axes must be a permutation of dims");
+      seen[axis] = true;
+    }
+    return axes;
+  }
+
+  // dims and strides of the contiguous tensor of shape in_dims permuted by
+  // axes
+  static void PermutedView(
+      const std::vector<TIndex>& in_dims,
+      const std::vector<int>& axes,
+      std::vector<TIndex>* dims,
+      std::vector<TIndex>* strides) {
+    const int ndim = in_dims.size();
+    const std::vector<int> perm = PermutationOrIdentity(axes, ndim);
+    std::vector<TIndex> in_strides(ndim);
+    TIndex stride = 1;
+    for (int i = ndim - 1; i >= 0; --i) {
+      in_strides[i] = stride;
+      stride *= in_dims[i];
+    }
+    dims->resize(ndim);
+    strides->resize(ndim);
+    for (int i = 0; i < ndim; ++i) {
+      (*dims)[i] = in_dims[perm[i]];
+      (*strides)[i] = in_strides[perm[i]];
+    }
+  }
+
+  // The GEMM transpose flag and leading dimension of the row major rows x
+  // cols matrix with these strides; one of them must be 1.
+  static void MatrixLayout(
+      const int rows,
+      const int cols,
+      const TIndex row_stride,
+      const TIndex col_stride,
+      CBLAS_TRANSPOSE* trans,
+      int* ld) {
+    if (col_stride == 1 || cols == 1) {
+      *trans = CblasNoTrans;
+      *ld = rows == 1 ? cols : std::max<TIndex>(row_stride, cols);
+    } else {
+      CAFFE_ENFORCE(
+          row_stride == 1 || rows == 1,
+          "BatchMatMul axes must keep the last input axis in the matrices");
+      *trans = CblasTrans;
+      *ld = std::max<TIndex>(col_stride, rows);
+    }
+  }
+
   bool trans_a_;
   bool trans_b_;
   bool broadcast_;
+  float alpha_;
+  std::vector<int> axes_a_;
+  std::vector<int> axes_b_;
+  std::vector<int> axes_y_;
 
   bool use_scratch_;
   std::shared_ptr<Tensor<Context>> scratch_;
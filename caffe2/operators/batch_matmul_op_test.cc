@@ -33,6 +33,24 @@ class BatchMatMulOpTest : public testing::Test {
         cpu_context_.get());
   }
 
+  // a deterministic input with distinct values
+  void AddInput(const std::vector<TIndex>& dims, const string& name) {
+    Blob* blob = ws_.CreateBlob(name);
+    auto* tensor = blob->GetMutable<TensorCPU>();
+    tensor->Resize(dims);
+    for (int i = 0; i < tensor->size(); ++i) {
+      tensor->mutable_data<float>()[i] = (i % 7) - 3.f + i * 0.01f;
+    }
+  }
+
+  void AddAxes(const string& name, const std::vector<int>& axes) {
+    def_.add_arg()->CopyFrom(MakeArgument<std::vector<int>>(name, axes));
+  }
+
+  const float* Data(const string& name) const {
+    return ws_.GetBlob(name)->Get<TensorCPU>().data<float>();
+  }
+
   void VerifyOutput(const std::vector<TIndex>& dims, const float value) const {
     const Blob* Y_blob = ws_.GetBlob("Y");
     ASSERT_NE(nullptr, Y_blob);
@@ -74,5 +92,101 @@ TEST_F(BatchMatMulOpTest, BatchMatMulOpBroadcastTest) {
   VerifyOutput(std::vector<TIndex>{2, 3, 5, 6}, 10.0f);
 }
 
+TEST_F(BatchMatMulOpTest, BatchMatMulOpBroadcastBatchDimsTest) {
+  auto* arg = def_.add_arg();
+  arg->set_name("broadcast");
+  arg->set_i(1);
+  AddConstInput(std::vector<TIndex>{2, 1, 5, 10}, 1.0f, "A");
+  AddConstInput(std::vector<TIndex>{1, 3, 10, 6}, 1.0f, "B");
+  std::unique_ptr<OperatorBase> op(CreateOperator(def_, &ws_));
+  ASSERT_NE(nullptr, op);
+  ASSERT_TRUE(op->Run());
+  VerifyOutput(std::vector<TIndex>{2, 3, 5, 6}, 10.0f);
+}
+
+TEST_F(BatchMatMulOpTest, BatchMatMulOpAlphaTest) {
+  def_.add_arg()->CopyFrom(MakeArgument<float>("alpha", 0.5f));
+  AddConstInput(std::vector<TIndex>{3, 5, 10}, 1.0f, "A");
+  AddConstInput(std::vector<TIndex>{3, 10, 6}, 1.0f, "B");
+  std::unique_ptr<OperatorBase> op(CreateOperator(def_, &ws_));
+  ASSERT_NE(nullptr, op);
+  ASSERT_TRUE(op->Run());
+  VerifyOutput(std::vector<TIndex>{3, 5, 6}, 5.0f);
+
+  // and through the strided path
+  AddAxes("axes_a", {0, 1, 2});
+  op = CreateOperator(def_, &ws_);
+  ASSERT_TRUE(op->Run());
+  VerifyOutput(std::vector<TIndex>{3, 5, 6}, 5.0f);
+}
+
+// the (N, C, G, L) tensors multiply as the N x G matrices of their
+// (N, G, C, L) transposes, e.g. the grouped non-local affinity theta' * phi
+TEST_F(BatchMatMulOpTest, BatchMatMulOpAxesTest) {
+  const int N = 2, C = 3, G = 4, L = 5, L2 = 6;
+  AddInput(std::vector<TIndex>{N, C, G, L}, "A");
+  AddInput(std::vector<TIndex>{N, C, G, L2}, "B");
+  def_.add_arg()->CopyFrom(MakeArgument<int>("trans_a", 1));
+  AddAxes("axes_a", {0, 2, 1, 3});
+  AddAxes("axes_b", {0, 2, 1, 3});
+  std::unique_ptr<OperatorBase> op(CreateOperator(def_, &ws_));
+  ASSERT_NE(nullptr, op);
+  ASSERT_TRUE(op->Run());
+
+  const auto& Y = ws_.GetBlob("Y")->Get<TensorCPU>();
+  ASSERT_EQ(Y.dims(), (std::vector<TIndex>{N, G, L, L2}));
+  const float* A = Data("A");
+  const float* B = Data("B");
+  for (int n = 0; n < N; ++n) {
+    for (int g = 0; g < G; ++g) {
+      for (int i = 0; i < L; ++i) {
+        for (int j = 0; j < L2; ++j) {
+          float expected = 0.f;
+          for (int c = 0; c < C; ++c) {
+            expected += A[((n * C + c) * G + g) * L + i] *
+                B[((n * C + c) * G + g) * L2 + j];
+          }
+          EXPECT_NEAR(
+              expected, Y.data<float>()[((n * G + g) * L + i) * L2 + j], 1e-4);
+        }
+      }
+    }
+  }
+}
+
+// the product of the (N, G, C, L) view of A and of (N, G, L2, L)' written
+// back as (N, C, G, L2)
+TEST_F(BatchMatMulOpTest, BatchMatMulOpOutputAxesTest) {
+  const int N = 2, C = 3, G = 4, L = 5, L2 = 6;
+  AddInput(std::vector<TIndex>{N, C, G, L}, "A");
+  AddInput(std::vector<TIndex>{N, G, L2, L}, "B");
+  def_.add_arg()->CopyFrom(MakeArgument<int>("trans_b", 1));
+  AddAxes("axes_a", {0, 2, 1, 3});
+  AddAxes("axes_y", {0, 2, 1, 3});
+  std::unique_ptr<OperatorBase> op(CreateOperator(def_, &ws_));
+  ASSERT_NE(nullptr, op);
+  ASSERT_TRUE(op->Run());
+
+  const auto& Y = ws_.GetBlob("Y")->Get<TensorCPU>();
+  ASSERT_EQ(Y.dims(), (std::vector<TIndex>{N, C, G, L2}));
+  const float* A = Data("A");
+  const float* B = Data("B");
+  for (int n = 0; n < N; ++n) {
+    for (int c = 0; c < C; ++c) {
+      for (int g = 0; g < G; ++g) {
+        for (int j = 0; j < L2; ++j) {
+          float expected = 0.f;
+          for (int l = 0; l < L; ++l) {
+            expected += A[((n * C + c) * G + g) * L + l] *
+                B[((n * G + g) * L2 + j) * L + l];
+          }
+          EXPECT_NEAR(
+              expected, Y.data<float>()[((n * C + c) * G + g) * L2 + j], 1e-4);
+        }
+      }
+    }
+  }
+}
+
 } // namespace
 } // namespace caffe2
@@ -0,0 +1,47 @@
+#include "caffe2/operators/bucket_flatten_op.h"
+
+namespace caffe2 {
+REGISTER_CPU_OPERATOR(BucketFlatten, BucketFlattenOp<CPUContext>);
+REGISTER_CPU_OPERATOR(BucketUnflatten, BucketUnflattenOp<CPUContext>);
+SHOULD_NOT_DO_GRADIENT(BucketFlatten);
+SHOULD_NOT_DO_GRADIENT(BucketUnflatten);
+
+OPERATOR_SCHEMA(BucketFlatten)
+    .NumInputs(1, INT_MAX)
+    .NumOutputs(1)
+    .TensorInferenceFunction([](const OperatorDef& /* unused */,
+                                const vector<TensorShape>& in) {
+      vector<TensorShape> out(1);
+      TIndex size = 0;
+      for (const auto& shape : in) {
+        TIndex shape_size = 1;
+        for (const auto d : shape.dims()) {
+          shape_size *= d;
+        }
+        size += shape_size;
+      }
+      out[0].set_data_type(in[0].data_type());
+      out[0].add_dims(size);
+      return out;
+    })
+    .SetDoc(R"DOC(
+Flattens the inputs, which have the same type, one after the other into one
+1-D output, e.g. to allreduce a bucket of small gradients at once.
+)DOC")
+    .Output(0, "bucket", "The inputs, flattened and concatenated");
+
+OPERATOR_SCHEMA(BucketUnflatten)
+    .NumInputs(2, INT_MAX)
+    .NumOutputs(1, INT_MAX)
+    .EnforceInplace([](int in, int out) { return in == out + 1; })
+    .TensorInferenceFunction([](const OperatorDef& /* unused */,
+                                const vector<TensorShape>& in) {
+      return vector<TensorShape>(in.begin() + 1, in.end());
+    })
+    .SetDoc(R"DOC(
+The inverse of BucketFlatten: copies the slices of the bucket back into the
+blobs that it was flattened from. The blobs are inputs 1 to N, in place with
+outputs 0 to N - 1.
+)DOC")
+    .Input(0, "bucket", "The output of BucketFlatten");
+} // namespace caffe2
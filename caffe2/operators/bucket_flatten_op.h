@@ -0,0 +1,71 @@
+#ifndef CAFFE2_OPERATORS_BUCKET_FLATTEN_OP_H_
+#define CAFFE2_OPERATORS_BUCKET_FLATTEN_OP_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+
+namespace caffe2 {
+
+// Copies all the inputs, e.g. the gradients of a bucket, one after the other
+// into one flat output that a single allreduce can take.
+template <class Context>
+class BucketFlattenOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  USE_SIMPLE_CTOR_DTOR(BucketFlattenOp);
+
+  bool RunOnDevice() override {
+    const auto& meta = Input(0).meta();
+    TIndex size = 0;
+    for (int i = 0; i < InputSize(); ++i) {
+      CAFFE_ENFORCE(
+          Input(i).meta() == meta,
+          "All the inputs of a bucket should have the same type");
+      size += Input(i).size();
+    }
+    auto* Y = Output(0);
+    Y->Resize(size);
+    char* dst = static_cast<char*>(Y->raw_mutable_data(meta));
+    for (int i = 0; i < InputSize(); ++i) {
+      const auto& X = Input(i);
+      context_.template CopyItems<Context, Context>(
+          meta, X.size(), X.raw_data(), dst);
+      dst += X.nbytes();
+    }
+    return true;
+  }
+};
+
+// Copies the slices of a flat bucket back into the blobs it was flattened
+// from, in place.
+template <class Context>
+class BucketUnflattenOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  USE_SIMPLE_CTOR_DTOR(BucketUnflattenOp);
+
+  bool RunOnDevice() override {
+    const auto& bucket = Input(0);
+    const auto& meta = bucket.meta();
+    TIndex size = 0;
+    for (int i = 0; i < OutputSize(); ++i) {
+      CAFFE_ENFORCE(
+          Input(i + 1).meta() == meta,
+          "All the outputs of a bucket should have its type");
+      size += Input(i + 1).size();
+    }
+    CAFFE_ENFORCE_EQ(size, bucket.size(), "Bucket size mismatch");
+    const char* src = static_cast<const char*>(bucket.raw_data());
+    for (int i = 0; i < OutputSize(); ++i) {
+      auto* X = Output(i);
+      context_.template CopyItems<Context, Context>(
+          meta, X->size(), src, X->raw_mutable_data(meta));
+      src += X->nbytes();
+    }
+    return true;
+  }
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_OPERATORS_BUCKET_FLATTEN_OP_H_
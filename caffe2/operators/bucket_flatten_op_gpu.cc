@@ -0,0 +1,7 @@
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/operators/bucket_flatten_op.h"
+
+namespace caffe2 {
+REGISTER_CUDA_OPERATOR(BucketFlatten, BucketFlattenOp<CUDAContext>);
+REGISTER_CUDA_OPERATOR(BucketUnflatten, BucketUnflattenOp<CUDAContext>);
+} // namespace caffe2
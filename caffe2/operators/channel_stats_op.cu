@@ -1,3 +1,5 @@
+#include <cub/block/block_reduce.cuh>
+
 #include "caffe2/core/context_gpu.h"
 #include "caffe2/operators/channel_stats_op.h"
 
@@ -5,141 +7,57 @@ namespace caffe2 {
 
 namespace {
 
-// based on "Optimizing Parallel Reduction in CUDA" by Mark Harris
-
-// note - volatile keyword is needed to allow doing a warp reduction without
-// synchronization on recent architectures
-template <unsigned int blockSize>
-__device__ void warpReduce(volatile float* sdata, unsigned int tid) {
-  // note - the if statements are "free" as they are resolved at compile time
-  if (blockSize >= 64)
-    sdata[tid] += sdata[tid + 32];
-  if (blockSize >= 32)
-    sdata[tid] += sdata[tid + 16];
-  if (blockSize >= 16)
-    sdata[tid] += sdata[tid + 8];
-  if (blockSize >= 8)
-    sdata[tid] += sdata[tid + 4];
-  if (blockSize >= 4)
-    sdata[tid] += sdata[tid + 2];
-  if (blockSize >= 2)
-    sdata[tid] += sdata[tid + 1];
-}
-
-template <unsigned int blockSize>
-__global__ void ChannelStatsBlockKernel(
-    int N,
-    int C,
-    int valsPerChannel,
+// The sum and the sum of squares of every (n, c) plane, a block per plane,
+// written to sums[c * N + n] for ChannelStatsFinalSumsKernel.
+__global__ void ChannelStatsPlaneKernel(
+    const int N,
+    const int C,
+    const int valsPerChannel,
     const float* inputData,
     float* sums,
     float* sumsq) {
-  __shared__ float sumData[blockSize];
-  __shared__ float sumSqData[blockSize];
-
-  auto tid = threadIdx.x;
-  auto numBlocksPerChannel = (valsPerChannel + blockSize - 1) / blockSize;
-  auto localBlockIndex = blockIdx.x % numBlocksPerChannel;
-  auto inputIndex = (blockIdx.x / numBlocksPerChannel) * valsPerChannel +
-      localBlockIndex * blockSize + tid;
-
-  sumData[tid] = 0;
-  sumSqData[tid] = 0;
-
-  if (localBlockIndex * blockSize + tid < valsPerChannel) {
-    sumData[tid] += inputData[inputIndex];
-    sumSqData[tid] += inputData[inputIndex] * inputData[inputIndex];
-  }
-
-  __syncthreads();
-  if (blockSize >= 512) {
-    if (tid < 256) {
-      sumData[tid] += sumData[tid + 256];
-      sumSqData[tid] += sumSqData[tid + 256];
+  typedef cub::BlockReduce<float, CAFFE_CUDA_NUM_THREADS> BlockReduce;
+  __shared__ typename BlockReduce::TempStorage sumStorage;
+  __shared__ typename BlockReduce::TempStorage sumSqStorage;
+  for (int plane = blockIdx.x; plane < N * C; plane += gridDim.x) {
+    const float* planeData = inputData + plane * valsPerChannel;
+    float sum = 0;
+    float sumSq = 0;
+    for (int i = threadIdx.x; i < valsPerChannel; i += blockDim.x) {
+      const float x = planeData[i];
+      sum += x;
+      sumSq += x * x;
     }
-    __syncthreads();
-  }
-  if (blockSize >= 256) {
-    if (tid < 128) {
-      sumData[tid] += sumData[tid + 128];
-      sumSqData[tid] += sumSqData[tid + 128];
-    }
-    __syncthreads();
-  }
-  if (blockSize >= 128) {
-    if (tid < 64) {
-      sumData[tid] += sumData[tid + 64];
-      sumSqData[tid] += sumSqData[tid + 64];
+    sum = BlockReduce(sumStorage).Sum(sum);
+    sumSq = BlockReduce(sumSqStorage).Sum(sumSq);
+    if (threadIdx.x == 0) {
+      const int n = plane / C;
+      const int c = plane % C;
+      sums[c * N + n] = sum;
+      sumsq[c * N + n] = sumSq;
     }
     __syncthreads();
   }
-
-  if (tid < 32) {
-    warpReduce<blockSize>(sumData, tid);
-    warpReduce<blockSize>(sumSqData, tid);
-  }
-
-  // output block data sorted by C to simplify second reduction
-  if (tid == 0) {
-    auto n = blockIdx.x / numBlocksPerChannel / C;
-    auto c = (blockIdx.x / numBlocksPerChannel) % C;
-    auto outputIndex = (c * N + n) * numBlocksPerChannel + localBlockIndex;
-    sums[outputIndex] = sumData[0];
-    sumsq[outputIndex] = sumSqData[0];
-  }
 }
 
-template <unsigned int blockSize>
+// Adds up the planes of every channel, in order, so the stats do not depend
+// on the launch.
 __global__ void ChannelStatsFinalSumsKernel(
-    int N,
-    int C,
-    int numSumsPerChannel,
+    const int N,
+    const int C,
     const float* sumsScratch,
     const float* sumsqScratch,
     float* channelSums,
     float* channelSumsq) {
-  __shared__ float sumData[blockSize];
-  __shared__ float sumSqData[blockSize];
-
-  auto tid = threadIdx.x;
-  auto inputIndex = blockIdx.x * N * numSumsPerChannel + tid;
-  sumData[tid] = 0;
-  sumSqData[tid] = 0;
-  for (auto i = inputIndex; i < (blockIdx.x + 1) * N * numSumsPerChannel;
-       i += blockSize) {
-    sumData[tid] += sumsScratch[i];
-    sumSqData[tid] += sumsqScratch[i];
-  }
-  __syncthreads();
-  if (blockSize >= 512) {
-    if (tid < 256) {
-      sumData[tid] += sumData[tid + 256];
-      sumSqData[tid] += sumSqData[tid + 256];
-    }
-    __syncthreads();
-  }
-  if (blockSize >= 256) {
-    if (tid < 128) {
-      sumData[tid] += sumData[tid + 128];
-      sumSqData[tid] += sumSqData[tid + 128];
-    }
-    __syncthreads();
-  }
-  if (blockSize >= 128) {
-    if (tid < 64) {
-      sumData[tid] += sumData[tid + 64];
-      sumSqData[tid] += sumSqData[tid + 64];
+  CUDA_1D_KERNEL_LOOP(c, C) {
+    float sum = 0;
+    float sumSq = 0;
+    for (int n = 0; n < N; ++n) {
+      sum += sumsScratch[c * N + n];
+      sumSq += sumsqScratch[c * N + n];
     }
-    __syncthreads();
-  }
-  if (tid < 32) {
-    warpReduce<blockSize>(sumData, tid);
-    warpReduce<blockSize>(sumSqData, tid);
-  }
-
-  if (tid == 0) {
-    channelSums[blockIdx.x] = sumData[0];
-    channelSumsq[blockIdx.x] = sumSqData[0];
+    channelSums[c] = sum;
+    channelSumsq[c] = sumSq;
   }
 }
 } // namespace
@@ -160,33 +78,39 @@ bool ChannelStatsOp<CUDAContext>::RunOnDevice() {
   const auto X_arr = X.data<float>();
   const auto valsPerChannel = H * W * D;
 
-  const auto numBlocksPerChannel = CAFFE_GET_BLOCKS(valsPerChannel);
-  const auto numBlocksTotal = numBlocksPerChannel * N * C;
-
-  sumScratch_.Resize(numBlocksTotal);
-  sumsqScratch_.Resize(numBlocksTotal);
+  sumScratch_.Resize(N * C);
+  sumsqScratch_.Resize(N * C);
 
   sum->Resize(C);
   sumsq->Resize(C);
 
-  ChannelStatsBlockKernel<CAFFE_CUDA_NUM_THREADS>
-      <<<numBlocksTotal, CAFFE_CUDA_NUM_THREADS, 0, context_.cuda_stream()>>>(
-          N,
-          C,
-          valsPerChannel,
-          X_arr,
-          sumScratch_.mutable_data<float>(),
-          sumsqScratch_.mutable_data<float>());
+  if (N * C > 0) {
+    ChannelStatsPlaneKernel<<<
+        std::min(N * C, CAFFE_MAXIMUM_NUM_BLOCKS),
+        CAFFE_CUDA_NUM_THREADS,
+        0,
+        context_.cuda_stream()>>>(
+        N,
+        C,
+        valsPerChannel,
+        X_arr,
+        sumScratch_.mutable_data<float>(),
+        sumsqScratch_.mutable_data<float>());
+  }
 
-  ChannelStatsFinalSumsKernel<CAFFE_CUDA_NUM_THREADS>
-      <<<C, CAFFE_CUDA_NUM_THREADS, 0, context_.cuda_stream()>>>(
-          N,
-          C,
-          numBlocksPerChannel,
-          sumScratch_.data<float>(),
-          sumsqScratch_.data<float>(),
-          sum->mutable_data<float>(),
-          sumsq->mutable_data<float>());
+  if (C > 0) {
+    ChannelStatsFinalSumsKernel<<<
+        CAFFE_GET_BLOCKS(C),
+        CAFFE_CUDA_NUM_THREADS,
+        0,
+        context_.cuda_stream()>>>(
+        N,
+        C,
+        sumScratch_.data<float>(),
+        sumsqScratch_.data<float>(),
+        sum->mutable_data<float>(),
+        sumsq->mutable_data<float>());
+  }
 
   return true;
 }
@@ -12,7 +12,12 @@ Creates a common world for communication operators.
     .Input(0, "kv_handler", "Key/value handler for rendezvous (optional).")
     .Output(0, "comm_world", "A common world for collective operations.")
     .Arg("size", "(int) size of the common world.")
-    .Arg("rank", "(int) rank of this node in the common world.");
+    .Arg("rank", "(int) rank of this node in the common world.")
+    .Arg(
+        "reuse_cached",
+        "(bool) reuse the common world of an op of the same name, size and "
+        "rank created earlier in the process, e.g. in another net, instead "
+        "of a new rendezvous.");
 
 OPERATOR_SCHEMA(CloneCommonWorld)
     .NumInputs(1)
@@ -0,0 +1,284 @@
+#include "caffe2/operators/conv3d_op_mobile.h"
+
+#ifndef CAFFE2_MOBILE
+#error "mobile build state not defined"
+#endif
+
+#if CAFFE2_MOBILE
+
+#include <algorithm>
+#include <cstring>
+
+#include "caffe2/utils/math.h"
+#include "caffe2/utils/threadpool/ThreadPool.h"
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif // __ARM_NEON__
+
+namespace caffe2 {
+
+namespace {
+
+// dst[i] = src[i * stride] for i < n
+void CopyStrided(const float* src, const int stride, const int n, float* dst) {
+  if (stride == 1) {
+    std::memcpy(dst, src, n * sizeof(float));
+    return;
+  }
+  int i = 0;
+#ifdef __ARM_NEON__
+  if (stride == 2) {
+    // the even lanes of 8 floats at a time, the last of which is past the
+    // row for i + 4 == n
+    for (; i + 5 <= n; i += 4) {
+      vst1q_f32(dst + i, vld2q_f32(src + 2 * i).val[0]);
+    }
+  }
+#endif // __ARM_NEON__
+  for (; i < n; ++i) {
+    dst[i] = src[i * stride];
+  }
+}
+
+// The kH * kW rows of the (C * kH * kW) x (H_out * W_out) frame matrix that
+// belong to the H x W frame x of one channel
+void UnfoldChannel(
+    const float* x,
+    const int H,
+    const int W,
+    const int kH,
+    const int kW,
+    const int stride_h,
+    const int stride_w,
+    const int pad_t,
+    const int pad_l,
+    const int H_out,
+    const int W_out,
+    float* col) {
+  for (int kh = 0; kh < kH; ++kh) {
+    for (int kw = 0; kw < kW; ++kw) {
+      float* row = col + (kh * kW + kw) * H_out * W_out;
+      // the output columns whose window column kw is inside the frame
+      const int before = std::max(pad_l - kw, 0);
+      const int after = std::max(W + pad_l - kw, 0);
+      const int w_begin = std::min((before + stride_w - 1) / stride_w, W_out);
+      const int w_end =
+          std::max(std::min((after + stride_w - 1) / stride_w, W_out), w_begin);
+      for (int h = 0; h < H_out; ++h) {
+        float* out = row + h * W_out;
+        const int ih = h * stride_h - pad_t + kh;
+        if (ih < 0 || ih >= H) {
+          std::fill(out, out + W_out, 0.f);
+          continue;
+        }
+        std::fill(out, out + w_begin, 0.f);
+        CopyStrided(
+            x + ih * W + w_begin * stride_w - pad_l + kw,
+            stride_w,
+            w_end - w_begin,
+            out + w_begin);
+        std::fill(out + w_end, out + W_out, 0.f);
+      }
+    }
+  }
+}
+
+} // namespace
+
+void Conv3dMobileOp::PackFilter(const TensorCPU& filter) {
+  const int M = filter.dim32(0);
+  const int C = filter.dim32(1);
+  const int kT = kernel_[0];
+  const int kHW = kernel_[1] * kernel_[2];
+  const int K = C * kHW;
+  packed_filter_.Resize(kT, M, K);
+  const float* W = filter.data<float>();
+  float* packed = packed_filter_.mutable_data<float>();
+  for (int m = 0; m < M; ++m) {
+    for (int c = 0; c < C; ++c) {
+      for (int kt = 0; kt < kT; ++kt) {
+        std::memcpy(
+            packed + (kt * M + m) * K + c * kHW,
+            W + ((m * C + c) * kT + kt) * kHW,
+            kHW * sizeof(float));
+      }
+    }
+  }
+}
+
+void Conv3dMobileOp::MultiplyFrame(
+    const int kt,
+    const float* B,
+    const int ldb,
+    const int n,
+    float* Y,
+    const int ldc) {
+  const int M = packed_filter_.dim32(1);
+  const int K = packed_filter_.dim32(2);
+  const float* A = packed_filter_.data<float>() + kt * M * K;
+  auto* pool = ws_->GetThreadPool();
+  // blocks of at least 8 output channels per thread
+  const int num_blocks =
+      std::max(1, std::min<int>(pool->getNumThreads(), M / 8));
+  const int block = (M + num_blocks - 1) / num_blocks;
+  pool->run(
+      [&](int, size_t b) {
+        const int m_begin = b * block;
+        const int m_end = std::min(m_begin + block, M);
+        if (m_begin >= m_end) {
+          return;
+        }
+        math::GemmEx<float, CPUContext>(
+            CblasNoTrans,
+            CblasNoTrans,
+            m_end - m_begin,
+            n,
+            K,
+            1,
+            A + m_begin * K,
+            K,
+            B,
+            ldb,
+            1,
+            Y + m_begin * ldc,
+            ldc,
+            &context_);
+      },
+      num_blocks);
+}
+
+bool Conv3dMobileOp::RunOnDeviceWithOrderNCHW() {
+  const auto& X = Input(INPUT);
+  const auto& filter = Input(FILTER);
+  auto* Y = Output(0);
+  CAFFE_ENFORCE_EQ(X.ndim(), 5);
+  CAFFE_ENFORCE_EQ(filter.ndim(), 5);
+  const int N = X.dim32(0);
+  const int C = X.dim32(1);
+  const int M = filter.dim32(0);
+  CAFFE_ENFORCE_EQ(filter.dim32(1), C, "Input channels do not match.");
+  for (int i = 0; i < 3; ++i) {
+    CAFFE_ENFORCE_EQ(filter.dim32(i + 2), kernel_[i]);
+  }
+  ConvPoolOpBase<CPUContext>::SetOutputSize(X, Y, M);
+
+  const int T = X.dim32(2);
+  const int H = X.dim32(3);
+  const int W = X.dim32(4);
+  const int T_out = Y->dim32(2);
+  const int H_out = Y->dim32(3);
+  const int W_out = Y->dim32(4);
+  const int frame = H * W;
+  const int frame_out = H_out * W_out;
+  const int kT = kernel_[0];
+  const int stride_t = stride_[0];
+  const int pad_t = pads_[0];
+  const bool pointwise = kernel_[1] == 1 && kernel_[2] == 1 &&
+      stride_[1] == 1 && stride_[2] == 1 && pads_[1] == 0 && pads_[2] == 0 &&
+      pads_[4] == 0 && pads_[5] == 0;
+
+  PackFilter(filter);
+  const float* Xdata = X.data<float>();
+  float* Ydata = Y->mutable_data<float>();
+  // the gemms accumulate into the bias
+  const float* bias = nullptr;
+  if (InputSize() == 3) {
+    const auto& b = Input(BIAS);
+    CAFFE_ENFORCE_EQ(b.ndim(), 1);
+    CAFFE_ENFORCE_EQ(b.dim32(0), M);
+    bias = b.data<float>();
+  }
+  for (int m = 0; m < N * M; ++m) {
+    float* y = Ydata + m * T_out * frame_out;
+    std::fill(y, y + T_out * frame_out, bias ? bias[m % M] : 0.f);
+  }
+  if (!pointwise) {
+    col_buffer_.Resize(C * kernel_[1] * kernel_[2], frame_out);
+  }
+  auto* pool = ws_->GetThreadPool();
+
+  for (int image_id = 0; image_id < N; ++image_id) {
+    const float* x = Xdata + image_id * C * T * frame;
+    float* y = Ydata + image_id * M * T_out * frame_out;
+    if (pointwise && stride_t == 1) {
+      // the output frames [begin, end) of tap kt read the consecutive input
+      // frames from begin - pad_t + kt on
+      for (int kt = 0; kt < kT; ++kt) {
+        const int begin = std::max(0, pad_t - kt);
+        const int end = std::min(T_out, T + pad_t - kt);
+        if (begin < end) {
+          MultiplyFrame(
+              kt,
+              x + (begin - pad_t + kt) * frame,
+              T * frame,
+              (end - begin) * frame,
+              y + begin * frame_out,
+              T_out * frame_out);
+        }
+      }
+      continue;
+    }
+    for (int t = 0; t < T; ++t) {
+      // the frame matrix of input frame t, unfolded for its first tap
+      const float* B = nullptr;
+      int ldb = 0;
+      for (int kt = 0; kt < kT; ++kt) {
+        const int offset = t + pad_t - kt;
+        if (offset < 0 || offset % stride_t != 0 ||
+            offset / stride_t >= T_out) {
+          continue;
+        }
+        if (!B && pointwise) {
+          B = x + t * frame;
+          ldb = T * frame;
+        } else if (!B) {
+          float* col = col_buffer_.mutable_data<float>();
+          const int rows = kernel_[1] * kernel_[2] * frame_out;
+          pool->run(
+              [&](int, size_t c) {
+                UnfoldChannel(
+                    x + (c * T + t) * frame,
+                    H,
+                    W,
+                    kernel_[1],
+                    kernel_[2],
+                    stride_[1],
+                    stride_[2],
+                    pads_[1],
+                    pads_[2],
+                    H_out,
+                    W_out,
+                    col + c * rows);
+              },
+              C);
+          B = col;
+          ldb = frame_out;
+        }
+        MultiplyFrame(
+            kt,
+            B,
+            ldb,
+            frame_out,
+            y + offset / stride_t * frame_out,
+            T_out * frame_out);
+      }
+    }
+  }
+  if (relu_) {
+    math::Maximum<float, CPUContext>(Y->size(), 0.f, Ydata, Ydata, &context_);
+  }
+  return true;
+}
+
+bool Conv3dMobileOp::RunOnDeviceWithOrderNHWC() {
+  CAFFE_THROW("Not implemented.");
+}
+
+// mobile-only implementation (frame by frame + vectorized + multithreaded)
+REGISTER_CPU_OPERATOR_WITH_ENGINE(Conv, MOBILE, Conv3dMobileOp);
+REGISTER_CPU_OPERATOR_WITH_ENGINE(ConvRelu, MOBILE, Conv3dMobileOp);
+
+} // namespace caffe2
+
+#endif // CAFFE2_MOBILE
@@ -0,0 +1,74 @@
+#ifndef CAFFE2_OPERATORS_CONV3D_OP_MOBILE_H_
+#define CAFFE2_OPERATORS_CONV3D_OP_MOBILE_H_
+
+#include "caffe2/core/common.h"
+
+#ifndef CAFFE2_MOBILE
+#error "mobile build state not defined"
+#endif
+
+#if CAFFE2_MOBILE
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/operators/conv_pool_op_base.h"
+
+namespace caffe2 {
+
+// 3D convolution of NCTHW clips for ARM CPUs (Conv / ConvRelu with engine
+// MOBILE). The clip is convolved frame by frame: every input frame is
+// unfolded once into a (C * kH * kW) x (H_out * W_out) matrix of its
+// spatial windows, which then takes one gemm per temporal tap into the
+// output frames it contributes to, instead of the kT-times larger col
+// buffer of Im2colNd. The frames of the gemms are split across the threads
+// of the workspace by output channels.
+//
+// The factorized kernels of the (2+1)D and I3D blocks take the short cuts:
+// kT x 1 x 1 kernels with spatial stride 1 and no spatial padding need no
+// unfolding and, with temporal stride 1, one gemm per tap over all frames;
+// 1 x kH x kW kernels see every input frame once.
+class Conv3dMobileOp final : public ConvPoolOpBase<CPUContext> {
+ public:
+  USE_CONV_POOL_BASE_FUNCTIONS(CPUContext);
+  Conv3dMobileOp(const OperatorDef& operator_def, Workspace* ws)
+      : ConvPoolOpBase<CPUContext>(operator_def, ws),
+        relu_(operator_def.type() == "ConvRelu") {
+    OPERATOR_NEEDS_FEATURE(
+        order_ == StorageOrder::NCHW, "Only NCHW order is supported.");
+    OPERATOR_NEEDS_FEATURE(kernel_.size() == 3, "Only 3D kernels.");
+    OPERATOR_NEEDS_FEATURE(group_ == 1, "Group convolution not supported.");
+    for (const int dilation : dilation_) {
+      OPERATOR_NEEDS_FEATURE(dilation == 1, "Dilation not supported.");
+    }
+  }
+
+  bool RunOnDeviceWithOrderNCHW() override;
+  bool RunOnDeviceWithOrderNHWC() override;
+
+ private:
+  // the taps of a temporal offset as M x (C * kH * kW) matrices
+  void PackFilter(const TensorCPU& filter);
+
+  // Y[m0:m1] += the filter of tap kt x the frame matrix B
+  void MultiplyFrame(
+      const int kt,
+      const float* B,
+      const int ldb,
+      const int n,
+      float* Y,
+      const int ldc);
+
+  const bool relu_;
+  TensorCPU packed_filter_;
+  TensorCPU col_buffer_;
+
+  // Input: X, W, b
+  // Output: Y
+  INPUT_TAGS(INPUT, FILTER, BIAS);
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_MOBILE
+
+#endif // CAFFE2_OPERATORS_CONV3D_OP_MOBILE_H_
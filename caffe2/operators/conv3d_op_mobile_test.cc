@@ -0,0 +1,129 @@
+#include <cmath>
+#include <random>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/operators/conv3d_op_mobile.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/utils/proto_utils.h"
+
+#include "gtest/gtest.h"
+
+namespace caffe2 {
+
+#if CAFFE2_MOBILE
+
+namespace {
+
+void AddNoiseInput(
+    const vector<TIndex>& shape,
+    const string& name,
+    Workspace* ws) {
+  DeviceOption option;
+  CPUContext context(option);
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(shape);
+  math::RandGaussian<float, CPUContext>(
+      tensor->size(), 0.0f, 1.0f, tensor->mutable_data<float>(), &context);
+}
+
+OperatorDef ConvDef(
+    const string& type,
+    const string& engine,
+    const string& output,
+    const vector<int>& kernels,
+    const vector<int>& strides,
+    const vector<int>& pads) {
+  OperatorDef def;
+  def.set_type(type);
+  def.set_engine(engine);
+  def.add_input("X");
+  def.add_input("W");
+  def.add_input("b");
+  def.add_output(output);
+  def.add_arg()->CopyFrom(MakeArgument("kernels", kernels));
+  def.add_arg()->CopyFrom(MakeArgument("strides", strides));
+  def.add_arg()->CopyFrom(MakeArgument("pads", pads));
+  return def;
+}
+
+// the MOBILE engine against the Im2colNd conv
+void Compare(
+    const string& type,
+    const int C,
+    const int M,
+    const vector<int>& dims,
+    const vector<int>& kernels,
+    const vector<int>& strides,
+    const vector<int>& pads) {
+  Workspace ws;
+  AddNoiseInput({2, C, dims[0], dims[1], dims[2]}, "X", &ws);
+  AddNoiseInput({M, C, kernels[0], kernels[1], kernels[2]}, "W", &ws);
+  AddNoiseInput({M}, "b", &ws);
+
+  unique_ptr<OperatorBase> mobile(CreateOperator(
+      ConvDef(type, "MOBILE", "Y1", kernels, strides, pads), &ws));
+  ASSERT_NE(nullptr, dynamic_cast<Conv3dMobileOp*>(mobile.get()));
+  unique_ptr<OperatorBase> ref(
+      CreateOperator(ConvDef(type, "", "Y2", kernels, strides, pads), &ws));
+  ASSERT_TRUE(mobile->Run());
+  ASSERT_TRUE(ref->Run());
+
+  const auto& Y1 = ws.GetBlob("Y1")->Get<TensorCPU>();
+  const auto& Y2 = ws.GetBlob("Y2")->Get<TensorCPU>();
+  ASSERT_EQ(Y1.dims(), Y2.dims());
+  for (int i = 0; i < Y1.size(); ++i) {
+    EXPECT_NEAR(Y1.data<float>()[i], Y2.data<float>()[i], 1e-3) << i;
+  }
+}
+
+} // namespace
+
+TEST(Conv3dMobile, TestFactorized) {
+  // the temporal and spatial convs of (2+1)D and I3D blocks
+  Compare("Conv", 8, 16, {8, 7, 9}, {3, 1, 1}, {1, 1, 1}, {1, 0, 0, 1, 0, 0});
+  Compare("Conv", 8, 16, {8, 7, 9}, {3, 1, 1}, {2, 1, 1}, {1, 0, 0, 1, 0, 0});
+  Compare("Conv", 8, 16, {4, 9, 9}, {1, 3, 3}, {1, 1, 1}, {0, 1, 1, 0, 1, 1});
+  Compare("Conv", 8, 16, {4, 12, 12}, {1, 3, 3}, {1, 2, 2}, {0, 1, 1, 0, 1, 1});
+  Compare("Conv", 3, 16, {8, 16, 16}, {5, 7, 7}, {2, 2, 2}, {2, 3, 3, 2, 3, 3});
+  Compare("ConvRelu", 8, 8, {4, 6, 6}, {1, 1, 1}, {1, 2, 2}, vector<int>(6));
+}
+
+TEST(Conv3dMobile, TestRandom) {
+  std::mt19937 gen(0);
+  auto rand = [&](int a, int b) {
+    return std::uniform_int_distribution<int>(a, b)(gen);
+  };
+  for (int i = 0; i < 10; ++i) {
+    vector<int> kernels{rand(1, 3), rand(1, 3), rand(1, 3)};
+    vector<int> strides{rand(1, 2), rand(1, 3), rand(1, 3)};
+    vector<int> pads(6);
+    for (int j = 0; j < 6; ++j) {
+      pads[j] = rand(0, kernels[j % 3] - 1);
+    }
+    Compare(
+        rand(0, 1) ? "Conv" : "ConvRelu",
+        rand(1, 6),
+        rand(1, 20),
+        {rand(3, 6), rand(3, 10), rand(3, 10)},
+        kernels,
+        strides,
+        pads);
+  }
+}
+
+TEST(Conv3dMobile, TestUnsupported) {
+  Workspace ws;
+  AddNoiseInput({1, 2, 5, 5}, "X", &ws);
+  AddNoiseInput({4, 2, 3, 3}, "W", &ws);
+  AddNoiseInput({4}, "b", &ws);
+  OperatorDef def =
+      ConvDef("Conv", "MOBILE", "Y", {3, 3}, {1, 1}, {1, 1, 1, 1});
+  // 2D convs fall back to the default engine
+  unique_ptr<OperatorBase> op(CreateOperator(def, &ws));
+  EXPECT_EQ(nullptr, dynamic_cast<Conv3dMobileOp*>(op.get()));
+}
+
+#endif // CAFFE2_MOBILE
+
+} // namespace caffe2
@@ -5,16 +5,32 @@
 namespace caffe2 {
 
 REGISTER_CPU_OPERATOR(ConvGradient, ConvGradientOp<float, CPUContext>);
-OPERATOR_SCHEMA(ConvGradient).NumInputs(2, 3).NumOutputs(1, 3);
+OPERATOR_SCHEMA(ConvGradient)
+    .NumInputs(2, 3)
+    .NumOutputs(1, 3)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForConvGradient));
 
 REGISTER_CPU_OPERATOR(Conv1DGradient, ConvGradientOp<float, CPUContext>);
-OPERATOR_SCHEMA(Conv1DGradient).NumInputs(2, 3).NumOutputs(1, 3);
+OPERATOR_SCHEMA(Conv1DGradient)
+    .NumInputs(2, 3)
+    .NumOutputs(1, 3)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForConvGradient));
 
 REGISTER_CPU_OPERATOR(Conv2DGradient, ConvGradientOp<float, CPUContext>);
-OPERATOR_SCHEMA(Conv2DGradient).NumInputs(2, 3).NumOutputs(1, 3);
+OPERATOR_SCHEMA(Conv2DGradient)
+    .NumInputs(2, 3)
+    .NumOutputs(1, 3)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForConvGradient));
 
 REGISTER_CPU_OPERATOR(Conv3DGradient, ConvGradientOp<float, CPUContext>);
-OPERATOR_SCHEMA(Conv3DGradient).NumInputs(2, 3).NumOutputs(1, 3);
+OPERATOR_SCHEMA(Conv3DGradient)
+    .NumInputs(2, 3)
+    .NumOutputs(1, 3)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForConvGradient));
 
 class GetConvGradient : public GradientMakerBase {
   using GradientMakerBase::GradientMakerBase;
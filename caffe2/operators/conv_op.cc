@@ -94,4 +94,26 @@ OPERATOR_SCHEMA(Conv3D)
     .FillUsing(ConvDocGenerator("3D "))
     .InheritOnnxSchema("Conv");
 
+// Inference only: the FuseConvRelu transform writes it for a Conv followed
+// by a Relu.
+REGISTER_CPU_OPERATOR(ConvRelu, ConvOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(ConvRelu)
+    .NumInputs(2, 3)
+    .NumOutputs(1)
+    .TensorInferenceFunction(ConvPoolOpBase<CPUContext>::TensorInferenceForConv)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForConv))
+    .SetDoc(R"DOC(
+The Conv operator followed by a Relu of its output, max(Y, 0), in one pass:
+every image is rectified right after its GEMMs, while it is still in the
+cache. It takes the inputs and arguments of Conv.
+)DOC")
+    .Input(0, "X", "Input data blob, as the input of Conv")
+    .Input(1, "filter", "The filter blob, as the filter of Conv")
+    .Input(2, "bias", "The optional 1D bias blob of size (M)")
+    .Output(0, "Y", "max(Conv(X, filter, bias), 0)");
+
+SHOULD_NOT_DO_GRADIENT(ConvRelu);
+
 } // namespace caffe2
@@ -15,7 +15,8 @@ class ConvOp final : public ConvPoolOpBase<Context> {
  public:
   USE_CONV_POOL_BASE_FUNCTIONS(Context);
   ConvOp(const OperatorDef& operator_def, Workspace* ws)
-      : ConvPoolOpBase<Context>(operator_def, ws) {
+      : ConvPoolOpBase<Context>(operator_def, ws),
+        relu_(operator_def.type() == "ConvRelu") {
     // Since this is the default convolution implementation, we will
     // use CAFFE_ENFORCE instead of OPERATOR_NEEDS_FEATURE.
     CAFFE_ENFORCE(
@@ -34,6 +35,9 @@ class ConvOp final : public ConvPoolOpBase<Context> {
   bool RunOnDeviceWithOrderNHWC() override;
 
  private:
+  // ConvRelu: max(conv, 0), applied to every image while it is still in
+  // the cache after its GEMMs
+  const bool relu_;
   Tensor<Context> col_buffer_;
   Tensor<Context> bias_multiplier_;
   Tensor<Context> img_shape_device_;
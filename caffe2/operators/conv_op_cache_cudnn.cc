@@ -5,6 +5,12 @@
 #include "caffe2/core/logging.h"
 #include "caffe2/core/tensor.h"
 
+CAFFE2_DEFINE_int(
+    caffe2_cudnn_shape_cache_size,
+    8,
+    "Number of input shapes whose descriptors and algorithms every cudnn "
+    "conv, pool, batch norm and softmax op keeps set up.");
+
 namespace caffe2 {
 
 template class AlgorithmsCache<cudnnConvolutionFwdAlgo_t>;
@@ -1,13 +1,30 @@
 #ifndef CAFFE2_OPERATORS_CONV_OP_CACHE_H_
 #define CAFFE2_OPERATORS_CONV_OP_CACHE_H_
 
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
 #include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "caffe2/core/flags.h"
 #include "caffe2/core/logging.h"
 #include "caffe2/core/tensor.h"
 
+CAFFE2_DECLARE_int(caffe2_cudnn_shape_cache_size);
+
 namespace caffe2 {
 template <typename TAlgorithm>
 class AlgorithmsCache {
@@ -61,6 +78,158 @@ TAlgorithm AlgorithmsCache<TAlgorithm>::getAlgorithm(
 
   return hash_[seed];
 }
+
+// A small LRU of the per-shape state of an op, such as its cudnn descriptors
+// and algorithms. Ops whose inputs take turns in a few shapes, e.g. in fully
+// convolutional testing or multigrid training, then set up each shape once
+// instead of on every change. An evicted entry keeps its resources for the
+// shape that replaces it, so TEntry only needs to be default constructible.
+template <typename TEntry>
+class ShapeCache {
+ public:
+  explicit ShapeCache(const int capacity)
+      : capacity_(std::max(capacity, 1)) {}
+
+  // Returns the entry of key and makes it the most recent one. *created is
+  // set if the entry is new to key and still has to be set up.
+  TEntry* Lookup(const std::vector<TIndex>& key, bool* created);
+
+  int size() const {
+    return entries_.size();
+  }
+
+ private:
+  const int capacity_;
+  std::list<std::pair<std::vector<TIndex>, std::unique_ptr<TEntry>>> entries_;
+};
+
+template <typename TEntry>
+TEntry* ShapeCache<TEntry>::Lookup(
+    const std::vector<TIndex>& key,
+    bool* created) {
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (it->first == key) {
+      entries_.splice(entries_.begin(), entries_, it);
+      *created = false;
+      return entries_.front().second.get();
+    }
+  }
+  if ((int)entries_.size() < capacity_) {
+    entries_.emplace_front(key, std::unique_ptr<TEntry>(new TEntry()));
+  } else {
+    entries_.splice(entries_.begin(), entries_, std::prev(entries_.end()));
+    entries_.front().first = key;
+  }
+  *created = true;
+  return entries_.front().second.get();
+}
+
+// A file backed store of the algorithms found by exhaustive search, so that
+// restarted jobs and new nets skip the benchmarking. An entry is keyed by a
+// string without white space that describes the device, the library version
+// and the problem, e.g. the dims and the conv parameters.
+//
+// All the ops of a process share the instance of a path, which reads the
+// file when it is opened. New entries are merged with the current content
+// of the file under a lock on <path>.lock and renamed into place, so the
+// processes of a node share the file and a reader never sees a partial one.
+class AlgorithmsCacheFile {
+ public:
+  // Returns the cache of path, opened on first use, or nullptr if path is
+  // empty.
+  static AlgorithmsCacheFile* Open(const std::string& path);
+
+  // Looks key up, rereading the file once on a miss in case another
+  // process added it.
+  bool Lookup(const std::string& key, int* algo, float* time);
+
+  void Insert(const std::string& key, const int algo, const float time);
+
+ private:
+  explicit AlgorithmsCacheFile(const std::string& path) : path_(path) {
+    Load();
+  }
+
+  // Adds the entries of the file to entries_, keeping the ones in memory.
+  void Load();
+
+  const std::string path_;
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::pair<int, float>> entries_;
+};
+
+inline AlgorithmsCacheFile* AlgorithmsCacheFile::Open(const std::string& path) {
+  static std::mutex mutex;
+  static std::map<std::string, std::unique_ptr<AlgorithmsCacheFile>> caches;
+  if (path.empty()) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& cache = caches[path];
+  if (!cache) {
+    cache.reset(new AlgorithmsCacheFile(path));
+  }
+  return cache.get();
+}
+
+inline void AlgorithmsCacheFile::Load() {
+  std::ifstream in(path_);
+  std::string key;
+  int algo;
+  float time;
+  while (in >> key >> algo >> time) {
+    entries_.emplace(key, std::make_pair(algo, time));
+  }
+}
+
+inline bool
+AlgorithmsCacheFile::Lookup(const std::string& key, int* algo, float* time) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    Load();
+    it = entries_.find(key);
+    if (it == entries_.end()) {
+      return false;
+    }
+  }
+  *algo = it->second.first;
+  *time = it->second.second;
+  return true;
+}
+
+inline void AlgorithmsCacheFile::Insert(
+    const std::string& key,
+    const int algo,
+    const float time) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_[key] = std::make_pair(algo, time);
+  const std::string lock_path = path_ + ".lock";
+  const int lock_fd = open(lock_path.c_str(), O_RDWR | O_CREAT, 0666);
+  if (lock_fd < 0 || flock(lock_fd, LOCK_EX) != 0) {
+    LOG(WARNING) << "Cannot lock " << lock_path
+                 << ", the algorithm is not saved";
+    if (lock_fd >= 0) {
+      close(lock_fd);
+    }
+    return;
+  }
+  Load();
+  const std::string tmp_path = path_ + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream out(tmp_path, std::ios::trunc);
+    for (const auto& entry : entries_) {
+      out << entry.first << " " << entry.second.first << " "
+          << entry.second.second << "\n";
+    }
+  }
+  if (std::rename(tmp_path.c_str(), path_.c_str()) != 0) {
+    LOG(WARNING) << "Cannot write " << path_ << ", the algorithm is not saved";
+    std::remove(tmp_path.c_str());
+  }
+  flock(lock_fd, LOCK_UN);
+  close(lock_fd);
+}
 } // namespace caffe2
 
 #endif
@@ -1,3 +1,8 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
 #include <vector>
 
 #include "caffe2/core/context_gpu.h"
@@ -58,4 +63,75 @@ TEST(AlgorithmsCacheTest, KeysDifferIfFlagsAreDifferent) {
   EXPECT_EQ(res3, 10);
 }
 
+TEST(AlgorithmsCacheFileTest, SavesAndRereadsEntries) {
+  EXPECT_EQ(AlgorithmsCacheFile::Open(""), nullptr);
+
+  const std::string path =
+      "/tmp/caffe2_algo_cache_test_" + std::to_string(getpid());
+  std::remove(path.c_str());
+  AlgorithmsCacheFile* cache = AlgorithmsCacheFile::Open(path);
+  ASSERT_NE(cache, nullptr);
+  EXPECT_EQ(AlgorithmsCacheFile::Open(path), cache);
+
+  int algo;
+  float time;
+  EXPECT_FALSE(cache->Lookup("fwd/x1,2,", &algo, &time));
+  cache->Insert("fwd/x1,2,", 3, 0.5f);
+  EXPECT_TRUE(cache->Lookup("fwd/x1,2,", &algo, &time));
+  EXPECT_EQ(algo, 3);
+  EXPECT_FLOAT_EQ(time, 0.5f);
+
+  // The entry is in the file, and entries written by others are found.
+  {
+    std::ifstream in(path);
+    std::string key;
+    in >> key >> algo >> time;
+    EXPECT_EQ(key, "fwd/x1,2,");
+    EXPECT_EQ(algo, 3);
+  }
+  {
+    std::ofstream out(path, std::ios::app);
+    out << "bwd_data/x1,2, 5 0.25\n";
+  }
+  EXPECT_TRUE(cache->Lookup("bwd_data/x1,2,", &algo, &time));
+  EXPECT_EQ(algo, 5);
+  EXPECT_FLOAT_EQ(time, 0.25f);
+
+  // Saving merges with the file instead of overwriting it.
+  cache->Insert("bwd_filter/x1,2,", 1, 2.0f);
+  int num_lines = 0;
+  {
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+      ++num_lines;
+    }
+  }
+  EXPECT_EQ(num_lines, 3);
+
+  std::remove(path.c_str());
+  std::remove((path + ".lock").c_str());
+}
+
+TEST(ShapeCacheTest, EvictsLeastRecentlyUsed) {
+  ShapeCache<int> cache(2);
+  bool created = false;
+  *cache.Lookup({1, 2}, &created) = 12;
+  EXPECT_TRUE(created);
+  *cache.Lookup({3, 4}, &created) = 34;
+  EXPECT_TRUE(created);
+  EXPECT_EQ(*cache.Lookup({1, 2}, &created), 12);
+  EXPECT_FALSE(created);
+
+  // {3, 4} is the least recent one, and its entry is reused
+  int* entry = cache.Lookup({5, 6}, &created);
+  EXPECT_TRUE(created);
+  EXPECT_EQ(*entry, 34);
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(*cache.Lookup({1, 2}, &created), 12);
+  EXPECT_FALSE(created);
+  cache.Lookup({3, 4}, &created);
+  EXPECT_TRUE(created);
+}
+
 } // namespace caffe2
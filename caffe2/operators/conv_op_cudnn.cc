@@ -1,12 +1,22 @@
+#include <sstream>
+
 #include "caffe2/core/context_gpu.h"
 
 #include "caffe2/core/common_gpu.h"
 #include "caffe2/core/cudnn_wrappers.h"
+#include "caffe2/core/flags.h"
 #include "caffe2/operators/conv_op.h"
 #include "caffe2/operators/conv_op_cache_cudnn.h"
 #include "caffe2/operators/conv_pool_op_base.h"
 #include "caffe2/operators/op_utils_cudnn.h"
 
+CAFFE2_DEFINE_string(
+    caffe2_cudnn_algo_cache_file,
+    "",
+    "If set, the algorithms found by the exhaustive search of the cudnn "
+    "convolutions are saved to and looked up in this file, which can be "
+    "shared by the processes of a node.");
+
 namespace caffe2 {
 
 class CudnnConvOpBase : public ConvPoolOpBase<CUDAContext> {
@@ -23,7 +33,10 @@ class CudnnConvOpBase : public ConvPoolOpBase<CUDAContext> {
             OperatorBase::GetSingleArgument<int>("deterministic", 0)),
         cudnn_state_(OperatorBase::GetSingleArgument<int>("cudnn_state", 0)),
         force_algo_(OperatorBase::GetRepeatedArgument<int>("force_algo", vector<int>{-1,-1,-1})),
-        enable_tensor_core_(OperatorBase::GetSingleArgument<bool>("enable_tensor_core", 1)) {
+        enable_tensor_core_(OperatorBase::GetSingleArgument<bool>("enable_tensor_core", 1)),
+        algo_cache_file_(
+            AlgorithmsCacheFile::Open(FLAGS_caffe2_cudnn_algo_cache_file)),
+        descriptor_cache_(FLAGS_caffe2_cudnn_shape_cache_size) {
     CHECK(!deterministic_ || !exhaustive_search_);
     CAFFE_ENFORCE(group_ > 0);
     CAFFE_ENFORCE(!deterministic_ || !exhaustive_search_);
@@ -63,25 +76,138 @@ class CudnnConvOpBase : public ConvPoolOpBase<CUDAContext> {
       force_algo_[ALGO_WGRAD] =
           OperatorBase::GetSingleArgument<int>("force_algo_wgrad", -1);
     }
+  }
+
+ protected:
+  // The descriptors, algorithms and workspace size of an input and filter
+  // shape, kept in descriptor_cache_.
+  struct ConvDescriptors {
+    ConvDescriptors() {
+      CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&bottom_desc));
+      CUDNN_ENFORCE(cudnnCreateFilterDescriptor(&filter_desc));
+      CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&bias_desc));
+      CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&top_desc));
+      CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&top_desc_for_bias));
+      CUDNN_ENFORCE(cudnnCreateConvolutionDescriptor(&conv_desc));
+      CUDNN_ENFORCE(cudnnCreateConvolutionDescriptor(&bwd_filter_conv_desc));
+      CUDNN_ENFORCE(cudnnCreateConvolutionDescriptor(&bwd_data_conv_desc));
+    }
+
+    ~ConvDescriptors() {
+      CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(bottom_desc));
+      CUDNN_ENFORCE(cudnnDestroyFilterDescriptor(filter_desc));
+      CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(bias_desc));
+      CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(top_desc));
+      CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(top_desc_for_bias));
+      CUDNN_ENFORCE(cudnnDestroyConvolutionDescriptor(conv_desc));
+      CUDNN_ENFORCE(cudnnDestroyConvolutionDescriptor(bwd_filter_conv_desc));
+      CUDNN_ENFORCE(cudnnDestroyConvolutionDescriptor(bwd_data_conv_desc));
+    }
+
+    cudnnTensorDescriptor_t bottom_desc;
+    cudnnFilterDescriptor_t filter_desc;
+    cudnnTensorDescriptor_t bias_desc;
+    cudnnTensorDescriptor_t top_desc;
+    cudnnTensorDescriptor_t top_desc_for_bias;
+    cudnnConvolutionDescriptor_t conv_desc;
+    // the gradient op only
+    cudnnConvolutionDescriptor_t bwd_filter_conv_desc;
+    cudnnConvolutionDescriptor_t bwd_data_conv_desc;
+    cudnnDataType_t compute_type = CUDNN_DATA_FLOAT;
+    size_t ws_nbytes = 0;
+    cudnnConvolutionFwdAlgo_t algo;
+    cudnnConvolutionBwdFilterAlgo_t bwd_filter_algo;
+    cudnnConvolutionBwdDataAlgo_t bwd_data_algo;
+  };
+
+  // Points the descriptors of the op at those of the shapes of X and the
+  // filter. *created is set if they are new and still have to be set up.
+  ConvDescriptors* LookupDescriptors(
+      const vector<TIndex>& input_dims,
+      const vector<TIndex>& filter_dims,
+      bool* created) {
+    vector<TIndex> key(input_dims);
+    key.push_back(-1);
+    key.insert(key.end(), filter_dims.begin(), filter_dims.end());
+    ConvDescriptors* descs = descriptor_cache_.Lookup(key, created);
+    bottom_desc_ = descs->bottom_desc;
+    filter_desc_ = descs->filter_desc;
+    bias_desc_ = descs->bias_desc;
+    top_desc_ = descs->top_desc;
+    top_desc_for_bias_ = descs->top_desc_for_bias;
+    conv_desc_ = descs->conv_desc;
+    compute_type_ = descs->compute_type;
+    cudnn_ws_nbytes_ = descs->ws_nbytes;
+    return descs;
+  }
 
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&bottom_desc_));
-    CUDNN_ENFORCE(cudnnCreateFilterDescriptor(&filter_desc_));
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&bias_desc_));
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&top_desc_));
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&top_desc_for_bias_));
-    CUDNN_ENFORCE(cudnnCreateConvolutionDescriptor(&conv_desc_));
+  // The key of a searched algorithm in the cache file: the device, the cudnn
+  // version, and all that the search depends on for the given pass.
+  std::string AlgorithmCacheKey(
+      const char* pass,
+      const vector<TIndex>& input_dims,
+      const vector<TIndex>& filter_dims,
+      const cudnnDataType_t data_type,
+      const cudnnDataType_t compute_type) const {
+    std::string device = GetDeviceProperty(context_.cuda_gpu_id()).name;
+    for (auto& c : device) {
+      if (c == ' ') {
+        c = '_';
+      }
+    }
+    std::ostringstream key;
+    key << device << "/cudnn" << cudnnGetVersion() << "/" << pass << "/x";
+    for (const auto d : input_dims) {
+      key << d << ",";
+    }
+    key << "/w";
+    for (const auto d : filter_dims) {
+      key << d << ",";
+    }
+    key << "/s";
+    for (const auto d : stride_) {
+      key << d << ",";
+    }
+    key << "/p";
+    for (const auto d : pads_) {
+      key << d << ",";
+    }
+    key << "/d";
+    for (const auto d : dilation_) {
+      key << d << ",";
+    }
+    key << "/g" << group_ << "/o" << order_ << "/t" << data_type << "/c"
+        << compute_type << "/tc" << enable_tensor_core_ << "/ws"
+        << cudnn_ws_nbytes_limit_;
+    return key.str();
   }
 
-  ~CudnnConvOpBase() {
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(bottom_desc_));
-    CUDNN_ENFORCE(cudnnDestroyFilterDescriptor(filter_desc_));
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(bias_desc_));
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(top_desc_));
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(top_desc_for_bias_));
-    CUDNN_ENFORCE(cudnnDestroyConvolutionDescriptor(conv_desc_));
+  // Wraps an exhaustive search so that it first looks the algorithm up in
+  // the cache file and then saves what it finds there.
+  template <typename TAlgorithmWithCost>
+  std::function<TAlgorithmWithCost()> PersistedSearch(
+      const std::string& key,
+      std::function<TAlgorithmWithCost()> search) {
+    if (algo_cache_file_ == nullptr) {
+      return search;
+    }
+    return [this, key, search]() -> TAlgorithmWithCost {
+      using TAlgorithm =
+          typename std::tuple_element<0, TAlgorithmWithCost>::type;
+      int algo;
+      float time;
+      if (algo_cache_file_->Lookup(key, &algo, &time)) {
+        VLOG(1) << "CUDNN Convolution: found " << key << " in "
+                << FLAGS_caffe2_cudnn_algo_cache_file;
+        return TAlgorithmWithCost(static_cast<TAlgorithm>(algo), time);
+      }
+      const TAlgorithmWithCost result = search();
+      algo_cache_file_->Insert(
+          key, static_cast<int>(std::get<0>(result)), std::get<1>(result));
+      return result;
+    };
   }
 
- protected:
   // A helper function to set up the tensor Nd desriptor, depending on the order
   // the group and the type given.
   template <typename T>
@@ -113,8 +239,10 @@ class CudnnConvOpBase : public ConvPoolOpBase<CUDAContext> {
               W * C,
               C));
         } else {
-          vector<int> dims = {N, H, W, D, CC};
-          vector<int> strides = {H * W * D * CC, W * D * CC, D * CC, CC, 1};
+          // cudnn takes the dims in NCHW order whatever the layout, the
+          // channels last strides are what makes the tensor NHWC
+          vector<int> dims = {N, CC, H, W, D};
+          vector<int> strides = {H * W * D * C, 1, W * D * C, D * C, C};
           CUDNN_ENFORCE(cudnnSetTensorNdDescriptor(
               tensorDesc,
               cudnnTypeWrapper<T>::type,
@@ -138,7 +266,7 @@ class CudnnConvOpBase : public ConvPoolOpBase<CUDAContext> {
               1));
         } else {
           vector<int> dims = {N, CC, H, W, D};
-          vector<int> strides = {CC * H * W * D, H * W * D, W * D, D, 1};
+          vector<int> strides = {C * H * W * D, H * W * D, W * D, D, 1};
           CUDNN_ENFORCE(cudnnSetTensorNdDescriptor(
               tensorDesc,
               cudnnTypeWrapper<T>::type,
@@ -152,6 +280,68 @@ class CudnnConvOpBase : public ConvPoolOpBase<CUDAContext> {
     }
   }
 
+  // Sets the Nd filter descriptor of a convolution with M output channels.
+  // Like the tensors, the filter dims are given as (M, C / group, kernel...)
+  // for both orders, the format tells cudnn where the channels are.
+  template <typename T>
+  void SetFilterNdDescriptorWithGroup(int M, int C) {
+#if CUDNN_VERSION_MIN(7, 0, 0)
+    const int MM = M;
+#else
+    const int MM = M / group_;
+#endif
+    vector<int> dims = {MM, C / group_};
+    dims.insert(dims.end(), kernel_.begin(), kernel_.end());
+    while (dims.size() < 4) {
+      dims.push_back(1);
+    }
+    CUDNN_ENFORCE(cudnnSetFilterNdDescriptor(
+        filter_desc_,
+        cudnnTypeWrapper<T>::type,
+        GetCudnnTensorFormat(order_),
+        dims.size(),
+        dims.data()));
+  }
+
+  // Sets the descriptor of the whole output, used to add the bias in one
+  // call.
+  template <typename T>
+  void SetTopDescriptorForBias(
+      int size,
+      int N,
+      int M,
+      int H_out,
+      int W_out,
+      int D_out) {
+    if (kernel_.size() == 2) {
+      CUDNN_ENFORCE(cudnnSetTensor4dDescriptor(
+          top_desc_for_bias_,
+          GetCudnnTensorFormat(order_),
+          cudnnTypeWrapper<T>::type,
+          N,
+          M,
+          H_out,
+          W_out));
+      return;
+    }
+    vector<int> dims = {N, M, H_out, W_out, D_out};
+    vector<int> strides;
+    if (order_ == StorageOrder::NHWC) {
+      strides = {
+          H_out * W_out * D_out * M, 1, W_out * D_out * M, D_out * M, M};
+    } else {
+      strides = {
+          M * H_out * W_out * D_out, H_out * W_out * D_out, W_out * D_out,
+          D_out, 1};
+    }
+    CUDNN_ENFORCE(cudnnSetTensorNdDescriptor(
+        top_desc_for_bias_,
+        cudnnTypeWrapper<T>::type,
+        size > 3 ? size : 4,
+        dims.data(),
+        strides.data()));
+  }
+
   void DuplicateConvDesc(
       cudnnConvolutionDescriptor_t input,
       size_t kernelDims,
@@ -402,10 +592,8 @@ class CudnnConvOpBase : public ConvPoolOpBase<CUDAContext> {
     }
   }
 
-  vector<TIndex> cudnn_input_dims_;
-  vector<TIndex> cudnn_filter_dims_;
-
   CuDNNWrapper cudnn_wrapper_;
+  // the descriptors of the current shapes, owned by descriptor_cache_
   cudnnTensorDescriptor_t bottom_desc_;
   cudnnFilterDescriptor_t filter_desc_;
   cudnnTensorDescriptor_t bias_desc_;
@@ -421,6 +609,9 @@ class CudnnConvOpBase : public ConvPoolOpBase<CUDAContext> {
   vector<int> force_algo_; // stored as FWD, dFILTER, dDATA
   bool enable_tensor_core_;
   cudnnDataType_t compute_type_;
+  // shared with the other ops, nullptr without caffe2_cudnn_algo_cache_file
+  AlgorithmsCacheFile* algo_cache_file_;
+  ShapeCache<ConvDescriptors> descriptor_cache_;
 };
 
 class CudnnConvOp final : public CudnnConvOpBase {
@@ -452,15 +643,9 @@ class CudnnConvGradientOp final : public CudnnConvOpBase {
     CAFFE_ENFORCE(
         !(no_bias_ && OutputSize() == 3),
         "If bias is not present, you should not have 3 grad output.");
-
-    CUDNN_ENFORCE(cudnnCreateConvolutionDescriptor(&bwd_data_conv_desc_));
-    CUDNN_ENFORCE(cudnnCreateConvolutionDescriptor(&bwd_filter_conv_desc_));
   }
 
-  ~CudnnConvGradientOp() {
-    CUDNN_ENFORCE(cudnnDestroyConvolutionDescriptor(bwd_data_conv_desc_));
-    CUDNN_ENFORCE(cudnnDestroyConvolutionDescriptor(bwd_filter_conv_desc_));
-  }
+  ~CudnnConvGradientOp() {}
 
   template <
       typename T_X,
@@ -566,99 +751,62 @@ bool CudnnConvOp::DoRunWithType() {
   int group_offset_filter = filter.size() / group_;
 
   // Set up the cudnn algorithms & workspace if necessary
-  bool input_changed = (X.dims() != cudnn_input_dims_);
-  bool filter_changed = (filter.dims() != cudnn_filter_dims_);
-  if (input_changed || filter_changed) {
-    VLOG(1) << "Changing the cudnn descriptor configurations.";
-    if (input_changed) {
-      cudnn_input_dims_ = X.dims();
-      SetTensorNdDescriptorWithGroup<T_X>(
-          X.ndim(), bottom_desc_, N, C, H, W, D);
-    }
-    if (filter_changed) {
-      cudnn_filter_dims_ = filter.dims();
-      if (kernel_.size() == 2) {
+  bool created = false;
+  ConvDescriptors* descs =
+      LookupDescriptors(X.dims(), filter.dims(), &created);
+  if (created) {
+    VLOG(1) << "Setting up the cudnn descriptors of new shapes.";
+    SetTensorNdDescriptorWithGroup<T_X>(
+        X.ndim(), bottom_desc_, N, C, H, W, D);
+    if (kernel_.size() == 2) {
 #if CUDNN_VERSION_MIN(7, 0, 0)
-        const int MM = M;
+      const int MM = M;
 #else
-        const int MM = M / group_;
+      const int MM = M / group_;
 #endif
-        CUDNN_ENFORCE(cudnnSetFilter4dDescriptor(
-            filter_desc_,
-            cudnnTypeWrapper<T_W>::type,
+      CUDNN_ENFORCE(cudnnSetFilter4dDescriptor(
+          filter_desc_,
+          cudnnTypeWrapper<T_W>::type,
+          GetCudnnTensorFormat(order_),
+          MM,
+          C / group_,
+          kernel_h(),
+          kernel_w()));
+    } else {
+      SetFilterNdDescriptorWithGroup<T_W>(M, C);
+    }
+    if (InputSize() == 3) {
+      if (kernel_.size() == 2) {
+        CUDNN_ENFORCE(cudnnSetTensor4dDescriptor(
+            bias_desc_,
             GetCudnnTensorFormat(order_),
-            MM,
-            C / group_,
-            kernel_h(),
-            kernel_w()));
+            cudnnTypeWrapper<T_B>::type,
+            1,
+            M,
+            1,
+            1));
       } else {
-        vector<int> dims(filter.dims().begin(), filter.dims().end());
-        dims[0] /= group_;
-#if !CUDNN_VERSION_MIN(7, 0, 0)
-        order_ == StorageOrder::NCHW ? dims[1] /= group_
-                                     : dims[filter.ndim() - 1] /= group_;
-#endif
-        dims[filter.ndim() - 1] /= group_;
-        CUDNN_ENFORCE(cudnnSetFilterNdDescriptor(
-            filter_desc_,
-            cudnnTypeWrapper<T_W>::type,
-            GetCudnnTensorFormat(order_),
-            dims.size(),
-            dims.data()));
-      }
-      if (InputSize() == 3) {
-        if (kernel_.size() == 2) {
-          CUDNN_ENFORCE(cudnnSetTensor4dDescriptor(
-              bias_desc_,
-              GetCudnnTensorFormat(order_),
-              cudnnTypeWrapper<T_B>::type,
-              1,
-              M,
-              1,
-              1));
-        } else {
-          std::vector<int> bias_dims(X.ndim(), 1);
-          bias_dims[1] = M;
-          std::vector<int> strides = {M, 1, 1, 1, 1, 1};
-          CUDNN_ENFORCE(cudnnSetTensorNdDescriptor(
-              bias_desc_,
-              cudnnTypeWrapper<T_B>::type,
-              X.ndim() > 3 ? X.ndim() : 4,
-              bias_dims.data(),
-              strides.data()));
-        }
+        std::vector<int> bias_dims(X.ndim(), 1);
+        bias_dims[1] = M;
+        std::vector<int> strides = {M, 1, 1, 1, 1, 1};
+        CUDNN_ENFORCE(cudnnSetTensorNdDescriptor(
+            bias_desc_,
+            cudnnTypeWrapper<T_B>::type,
+            X.ndim() > 3 ? X.ndim() : 4,
+            bias_dims.data(),
+            strides.data()));
       }
     }
     // Set the output
     SetTensorNdDescriptorWithGroup<T_Y>(
         X.ndim(), top_desc_, N, M, H_out, W_out, D_out);
     // Set the output with descriptor useful for bias addition in one run.
-    if (kernel_.size() == 2) {
-      CUDNN_ENFORCE(cudnnSetTensor4dDescriptor(
-          top_desc_for_bias_,
-          GetCudnnTensorFormat(order_),
-          cudnnTypeWrapper<T_B>::type,
-          N,
-          M,
-          H_out,
-          W_out));
-    } else {
-      vector<int> dims = {N, M, H_out, W_out, D_out};
-      vector<int> strides = {M * H_out * W_out * D_out,
-                             H_out * W_out * D_out,
-                             W_out * D_out,
-                             D_out,
-                             1};
-      CUDNN_ENFORCE(cudnnSetTensorNdDescriptor(
-          top_desc_for_bias_,
-          cudnnTypeWrapper<T_B>::type,
-          X.ndim() > 3 ? X.ndim() : 4,
-          dims.data(),
-          strides.data()));
-    }
+    SetTopDescriptorForBias<T_B>(X.ndim(), N, M, H_out, W_out, D_out);
 
     compute_type_ = DetermineComputeTypeFromInput(X);
     SetConvDescFromArguments();
+    const size_t ws_limit =
+        cudnn_wrapper_.workspace_budget(cudnn_state_, cudnn_ws_nbytes_limit_);
 
 #if CUDNN_VERSION_MIN(7, 0, 0)
     if (enable_tensor_core_) {
@@ -682,8 +830,17 @@ bool CudnnConvOp::DoRunWithType() {
       for (int i = 0; i < 2; i++) {
         SetConvDescComputeType(conv_desc_, kComputeTypesToTry[i]);
 
+        const std::string key = AlgorithmCacheKey(
+            "fwd",
+            X.dims(),
+            filter.dims(),
+            cudnnTypeWrapper<T_X>::type,
+            kComputeTypesToTry[i]);
         algosToCompare[i] = algo_cache_.getAlgorithm(
-            X.dims(), filter.dims(), kComputeTypesToTry[i], [&]() {
+            X.dims(),
+            filter.dims(),
+            kComputeTypesToTry[i],
+            PersistedSearch<ConvFwdAlgorithmWithCost>(key, [&]() {
               VLOG(1) << "CUDNN Convolution fwd: doing exhaustive "
                       << "search for " << kComputePassNames[i];
               // When we do an exhaustive search, we will ignore the workspace
@@ -709,15 +866,15 @@ bool CudnnConvOp::DoRunWithType() {
                         kNUM_CUDNN_FWD_ALGS,
                         &returned_algo_count,
                         fwd_perf_stat.data(),
-                        state->workspace().get(cudnn_ws_nbytes_limit_),
-                        cudnn_ws_nbytes_limit_));
+                        state->workspace().get(ws_limit),
+                        ws_limit));
                   });
               LogCuDNNPerfStats(fwd_perf_stat, returned_algo_count);
               float algo_time = fwd_perf_stat[0].status == CUDNN_STATUS_SUCCESS
                   ? fwd_perf_stat[0].time
                   : 1e10;
               return ConvFwdAlgorithmWithCost(fwd_perf_stat[0].algo, algo_time);
-            });
+            }));
 
         // When set to fp32 compute, don't try fp16
         if (compute_type_ == CUDNN_DATA_FLOAT) {
@@ -746,7 +903,7 @@ bool CudnnConvOp::DoRunWithType() {
           conv_desc_,
           top_desc_,
           CUDNN_CONVOLUTION_FWD_SPECIFY_WORKSPACE_LIMIT,
-          cudnn_ws_nbytes_limit_,
+          ws_limit,
           &algo_));
     }
     CUDNN_ENFORCE(cudnnGetConvolutionForwardWorkspaceSize(
@@ -757,8 +914,35 @@ bool CudnnConvOp::DoRunWithType() {
         top_desc_,
         algo_,
         &cudnn_ws_nbytes_));
+    if (exhaustive_search_ && !deterministic_ && force_algo_[ALGO_FWD] < 0 &&
+        cudnn_ws_nbytes_ > ws_limit) {
+      // A cached algorithm can exceed the current workspace budget, fall
+      // back to the best one within it.
+      CUDNN_ENFORCE(cudnnGetConvolutionForwardAlgorithm(
+          cudnn_wrapper_.inline_cudnn_handle(),
+          bottom_desc_,
+          filter_desc_,
+          conv_desc_,
+          top_desc_,
+          CUDNN_CONVOLUTION_FWD_SPECIFY_WORKSPACE_LIMIT,
+          ws_limit,
+          &algo_));
+      CUDNN_ENFORCE(cudnnGetConvolutionForwardWorkspaceSize(
+          cudnn_wrapper_.inline_cudnn_handle(),
+          bottom_desc_,
+          filter_desc_,
+          conv_desc_,
+          top_desc_,
+          algo_,
+          &cudnn_ws_nbytes_));
+    }
     VLOG(1) << "CuDNN algorithm: " << algo_;
     VLOG(1) << "CuDNN workspace size: " << cudnn_ws_nbytes_;
+    descs->compute_type = compute_type_;
+    descs->ws_nbytes = cudnn_ws_nbytes_;
+    descs->algo = algo_;
+  } else {
+    algo_ = descs->algo;
   }
 
   // Now, actually run the computation.
@@ -922,98 +1106,64 @@ bool CudnnConvGradientOp::DoRunWithType() {
   dfilter->ResizeLike(filter);
 
   // Set up the cudnn algorithms & workspace if necessary
-  bool input_changed = (X.dims() != cudnn_input_dims_);
-  bool filter_changed = (filter.dims() != cudnn_filter_dims_);
-  if (input_changed || filter_changed) {
-    VLOG(1) << "Changing the cudnn descriptor configurations.";
-    if (input_changed) {
-      cudnn_input_dims_ = X.dims();
-      SetTensorNdDescriptorWithGroup<T_X>(
-          X.ndim(), bottom_desc_, N, C, H, W, D);
-    }
-    if (filter_changed) {
-      cudnn_filter_dims_ = filter.dims();
-      if (kernel_.size() == 2) {
+  bool created = false;
+  ConvDescriptors* descs =
+      LookupDescriptors(X.dims(), filter.dims(), &created);
+  bwd_filter_conv_desc_ = descs->bwd_filter_conv_desc;
+  bwd_data_conv_desc_ = descs->bwd_data_conv_desc;
+  if (created) {
+    VLOG(1) << "Setting up the cudnn descriptors of new shapes.";
+    SetTensorNdDescriptorWithGroup<T_X>(
+        X.ndim(), bottom_desc_, N, C, H, W, D);
+    if (kernel_.size() == 2) {
 #if CUDNN_VERSION_MIN(7, 0, 0)
-        const int MM = M;
+      const int MM = M;
 #else
-        const int MM = M / group_;
+      const int MM = M / group_;
 #endif
-        CUDNN_ENFORCE(cudnnSetFilter4dDescriptor(
-            filter_desc_,
-            cudnnTypeWrapper<T_W>::type,
+      CUDNN_ENFORCE(cudnnSetFilter4dDescriptor(
+          filter_desc_,
+          cudnnTypeWrapper<T_W>::type,
+          GetCudnnTensorFormat(order_),
+          MM,
+          C / group_,
+          kernel_h(),
+          kernel_w()));
+    } else {
+      SetFilterNdDescriptorWithGroup<T_W>(M, C);
+    }
+    if (!no_bias_) {
+      if (kernel_.size() == 2) {
+        CUDNN_ENFORCE(cudnnSetTensor4dDescriptor(
+            bias_desc_,
             GetCudnnTensorFormat(order_),
-            MM,
-            C / group_,
-            kernel_h(),
-            kernel_w()));
+            cudnnTypeWrapper<T_B>::type,
+            1,
+            M,
+            1,
+            1));
       } else {
-        vector<int> dims(filter.dims().begin(), filter.dims().end());
-#if !CUDNN_VERSION_MIN(7, 0, 0)
-        dims[0] /= group_;
-#endif
-        order_ == StorageOrder::NCHW ? dims[1] /= group_
-                                     : dims[filter.ndim() - 1] /= group_;
-        CUDNN_ENFORCE(cudnnSetFilterNdDescriptor(
-            filter_desc_,
-            cudnnTypeWrapper<T_W>::type,
-            GetCudnnTensorFormat(order_),
-            dims.size(),
-            dims.data()));
-      }
-      if (!no_bias_) {
-        if (kernel_.size() == 2) {
-          CUDNN_ENFORCE(cudnnSetTensor4dDescriptor(
-              bias_desc_,
-              GetCudnnTensorFormat(order_),
-              cudnnTypeWrapper<T_B>::type,
-              1,
-              M,
-              1,
-              1));
-        } else {
-          std::vector<int> bias_dims(X.ndim(), 1);
-          bias_dims[1] = M;
-          std::vector<int> strides = {M, 1, 1, 1, 1, 1};
-          CUDNN_ENFORCE(cudnnSetTensorNdDescriptor(
-              bias_desc_,
-              cudnnTypeWrapper<T_B>::type,
-              X.ndim() > 3 ? X.ndim() : 4,
-              bias_dims.data(),
-              strides.data()));
-        }
+        std::vector<int> bias_dims(X.ndim(), 1);
+        bias_dims[1] = M;
+        std::vector<int> strides = {M, 1, 1, 1, 1, 1};
+        CUDNN_ENFORCE(cudnnSetTensorNdDescriptor(
+            bias_desc_,
+            cudnnTypeWrapper<T_B>::type,
+            X.ndim() > 3 ? X.ndim() : 4,
+            bias_dims.data(),
+            strides.data()));
       }
     }
     // Set the output
     SetTensorNdDescriptorWithGroup<T_DX>(
         X.ndim(), top_desc_, N, M, H_out, W_out, D_out);
     // Set the output with descriptor useful for bias addition in one run.
-    if (kernel_.size() == 2) {
-      CUDNN_ENFORCE(cudnnSetTensor4dDescriptor(
-          top_desc_for_bias_,
-          GetCudnnTensorFormat(order_),
-          cudnnTypeWrapper<T_B>::type,
-          N,
-          M,
-          H_out,
-          W_out));
-    } else {
-      vector<int> dims = {N, M, H_out, W_out, D_out};
-      vector<int> strides = {M * H_out * W_out * D_out,
-                             H_out * W_out * D_out,
-                             W_out * D_out,
-                             D_out,
-                             1};
-      CUDNN_ENFORCE(cudnnSetTensorNdDescriptor(
-          top_desc_for_bias_,
-          cudnnTypeWrapper<T_B>::type,
-          X.ndim() > 3 ? X.ndim() : 4,
-          dims.data(),
-          strides.data()));
-    }
+    SetTopDescriptorForBias<T_B>(X.ndim(), N, M, H_out, W_out, D_out);
 
     compute_type_ = DetermineComputeTypeFromInput(X);
     SetConvDescFromArguments();
+    const size_t ws_limit =
+        cudnn_wrapper_.workspace_budget(cudnn_state_, cudnn_ws_nbytes_limit_);
 
     DuplicateConvDesc(
         conv_desc_, kernel_.size(), dilation_.size(), bwd_filter_conv_desc_);
@@ -1047,8 +1197,17 @@ bool CudnnConvGradientOp::DoRunWithType() {
       for (int i = 0; i < 2; i++) {
         SetConvDescComputeType(bwd_filter_conv_desc_, kComputeTypesToTry[i]);
 
+        const std::string key = AlgorithmCacheKey(
+            "bwd_filter",
+            X.dims(),
+            filter.dims(),
+            cudnnTypeWrapper<T_X>::type,
+            kComputeTypesToTry[i]);
         algosToCompare[i] = filter_algo_cache_.getAlgorithm(
-            X.dims(), filter.dims(), kComputeTypesToTry[i], [&]() {
+            X.dims(),
+            filter.dims(),
+            kComputeTypesToTry[i],
+            PersistedSearch<ConvBwdFilterAlgorithmWithCost>(key, [&]() {
               VLOG(1) << "CUDNN Convolution bwd: doing filter exhaustive"
                       << "search for " << kComputePassNames[i];
               // When we do an exhaustive search, we will ignore the workspace
@@ -1077,8 +1236,8 @@ bool CudnnConvGradientOp::DoRunWithType() {
                         kNUM_CUDNN_BWD_FILTER_ALGS,
                         &returned_algo_count,
                         filter_perf_stat.data(),
-                        state->workspace().get(cudnn_ws_nbytes_limit_),
-                        cudnn_ws_nbytes_limit_));
+                        state->workspace().get(ws_limit),
+                        ws_limit));
                   });
               LogCuDNNPerfStats(filter_perf_stat, returned_algo_count);
               float algo_time =
@@ -1087,7 +1246,7 @@ bool CudnnConvGradientOp::DoRunWithType() {
                   : 1e10;
               return ConvBwdFilterAlgorithmWithCost(
                   filter_perf_stat[0].algo, algo_time);
-            });
+            }));
 
         // When set to fp32 compute, don't try fp16
         if (compute_type_ == CUDNN_DATA_FLOAT) {
@@ -1117,7 +1276,7 @@ bool CudnnConvGradientOp::DoRunWithType() {
           bwd_filter_conv_desc_,
           filter_desc_,
           CUDNN_CONVOLUTION_BWD_FILTER_SPECIFY_WORKSPACE_LIMIT,
-          cudnn_ws_nbytes_limit_,
+          ws_limit,
           &bwd_filter_algo_));
     }
     // Pick dX algo if needed
@@ -1134,8 +1293,17 @@ bool CudnnConvGradientOp::DoRunWithType() {
         for (int i = 0; i < 2; i++) {
           SetConvDescComputeType(bwd_data_conv_desc_, kComputeTypesToTry[i]);
 
+          const std::string key = AlgorithmCacheKey(
+              "bwd_data",
+              X.dims(),
+              filter.dims(),
+              cudnnTypeWrapper<T_X>::type,
+              kComputeTypesToTry[i]);
           algosToCompare[i] = data_algo_cache_.getAlgorithm(
-              X.dims(), filter.dims(), kComputeTypesToTry[i], [&]() {
+              X.dims(),
+              filter.dims(),
+              kComputeTypesToTry[i],
+              PersistedSearch<ConvBwdDataAlgorithmWithCost>(key, [&]() {
                 VLOG(1) << "CUDNN Convolution bwd: doing data exhaustive"
                         << "search for " << kComputePassNames[i];
                 int returned_algo_count;
@@ -1164,8 +1332,8 @@ bool CudnnConvGradientOp::DoRunWithType() {
                           kNUM_CUDNN_BWD_DATA_ALGS,
                           &returned_algo_count,
                           data_perf_stat.data(),
-                          state->workspace().get(cudnn_ws_nbytes_limit_),
-                          cudnn_ws_nbytes_limit_));
+                          state->workspace().get(ws_limit),
+                          ws_limit));
                     });
 
                 LogCuDNNPerfStats(data_perf_stat, returned_algo_count);
@@ -1175,7 +1343,7 @@ bool CudnnConvGradientOp::DoRunWithType() {
                     : 1e10;
                 return ConvBwdDataAlgorithmWithCost(
                     data_perf_stat[0].algo, algo_time);
-              });
+              }));
 
           // When set to fp32 compute, don't try fp16
           if (compute_type_ == CUDNN_DATA_FLOAT) {
@@ -1204,7 +1372,7 @@ bool CudnnConvGradientOp::DoRunWithType() {
             bwd_data_conv_desc_,
             bottom_desc_,
             CUDNN_CONVOLUTION_BWD_DATA_SPECIFY_WORKSPACE_LIMIT,
-            cudnn_ws_nbytes_limit_,
+            ws_limit,
             &bwd_data_algo_));
       }
     }
@@ -1220,6 +1388,28 @@ bool CudnnConvGradientOp::DoRunWithType() {
         filter_desc_,
         bwd_filter_algo_,
         &bwd_filter_ws_size));
+    if (exhaustive_search_ && !deterministic_ &&
+        force_algo_[ALGO_WGRAD] < 0 && bwd_filter_ws_size > ws_limit) {
+      // A cached algorithm can exceed the current workspace budget, fall
+      // back to the best one within it.
+      CUDNN_ENFORCE(cudnnGetConvolutionBackwardFilterAlgorithm(
+          cudnn_wrapper_.inline_cudnn_handle(),
+          bottom_desc_,
+          top_desc_,
+          bwd_filter_conv_desc_,
+          filter_desc_,
+          CUDNN_CONVOLUTION_BWD_FILTER_SPECIFY_WORKSPACE_LIMIT,
+          ws_limit,
+          &bwd_filter_algo_));
+      CUDNN_ENFORCE(cudnnGetConvolutionBackwardFilterWorkspaceSize(
+          cudnn_wrapper_.inline_cudnn_handle(),
+          bottom_desc_,
+          top_desc_,
+          bwd_filter_conv_desc_,
+          filter_desc_,
+          bwd_filter_algo_,
+          &bwd_filter_ws_size));
+    }
     if (OutputSize() == 3 || (no_bias_ && (OutputSize() == 2))) {
       // get workspace size for backwards data algorithm
       CUDNN_ENFORCE(cudnnGetConvolutionBackwardDataWorkspaceSize(
@@ -1230,6 +1420,26 @@ bool CudnnConvGradientOp::DoRunWithType() {
           bottom_desc_,
           bwd_data_algo_,
           &bwd_data_ws_size));
+      if (exhaustive_search_ && !deterministic_ &&
+          force_algo_[ALGO_DGRAD] < 0 && bwd_data_ws_size > ws_limit) {
+        CUDNN_ENFORCE(cudnnGetConvolutionBackwardDataAlgorithm(
+            cudnn_wrapper_.inline_cudnn_handle(),
+            filter_desc_,
+            top_desc_,
+            bwd_data_conv_desc_,
+            bottom_desc_,
+            CUDNN_CONVOLUTION_BWD_DATA_SPECIFY_WORKSPACE_LIMIT,
+            ws_limit,
+            &bwd_data_algo_));
+        CUDNN_ENFORCE(cudnnGetConvolutionBackwardDataWorkspaceSize(
+            cudnn_wrapper_.inline_cudnn_handle(),
+            filter_desc_,
+            top_desc_,
+            bwd_data_conv_desc_,
+            bottom_desc_,
+            bwd_data_algo_,
+            &bwd_data_ws_size));
+      }
     } else {
       bwd_data_ws_size = 0;
     }
@@ -1238,6 +1448,13 @@ bool CudnnConvGradientOp::DoRunWithType() {
     VLOG(1) << "CuDNN bwd data & filter algorithm: " << bwd_data_algo_ << ", "
             << bwd_filter_algo_;
     VLOG(1) << "CuDNN workspace size: " << cudnn_ws_nbytes_;
+    descs->compute_type = compute_type_;
+    descs->ws_nbytes = cudnn_ws_nbytes_;
+    descs->bwd_filter_algo = bwd_filter_algo_;
+    descs->bwd_data_algo = bwd_data_algo_;
+  } else {
+    bwd_filter_algo_ = descs->bwd_filter_algo;
+    bwd_data_algo_ = descs->bwd_data_algo;
   }
 
   // Now, actually run the computation.
@@ -81,6 +81,87 @@ bool ConvOp<T, Context>::RunOnDeviceWithOrderNCHW() {
   }
   T* Ydata = Y->template mutable_data<T>();
 
+  // Specialized path for 1x1(x1) convolution with pad 0 that strides along
+  // the leading spatial axis at most - we can skip im2col and the col
+  // buffer, and multiply with (a strided view of) the image directly.
+  const int pointwise_stride = PointwiseLeadingStride();
+  if (pointwise_stride > 0) {
+    const T* filter_data = filter.template data<T>();
+    if (pointwise_stride == 1) {
+      // One batched gemm over the images per group.
+      for (int group_id = 0; group_id < group_; ++group_id) {
+        math::GemmStridedBatched<T, Context>(
+            CblasNoTrans,
+            CblasNoTrans,
+            N,
+            M / group_,
+            output_image_size,
+            kernel_dim,
+            1,
+            filter_data + group_id * filter_offset,
+            kernel_dim,
+            0,
+            Xdata + group_id * input_offset,
+            input_image_size,
+            input_offset * group_,
+            0,
+            Ydata + group_id * output_offset,
+            output_image_size,
+            output_offset * group_,
+            &context_);
+      }
+    } else {
+      // One batched gemm over the output frames per image and group, each
+      // reading every pointwise_stride-th input frame.
+      const int frames = output_dims[0];
+      const int frame_size = output_image_size / frames;
+      for (int image_id = 0; image_id < N; ++image_id) {
+        for (int group_id = 0; group_id < group_; ++group_id) {
+          math::GemmStridedBatched<T, Context>(
+              CblasNoTrans,
+              CblasNoTrans,
+              frames,
+              M / group_,
+              frame_size,
+              kernel_dim,
+              1,
+              filter_data + group_id * filter_offset,
+              kernel_dim,
+              0,
+              Xdata + (image_id * group_ + group_id) * input_offset,
+              input_image_size,
+              pointwise_stride * frame_size,
+              0,
+              Ydata + (image_id * group_ + group_id) * output_offset,
+              output_image_size,
+              frame_size,
+              &context_);
+        }
+      }
+    }
+    if (InputSize() == 3) {
+      auto* bias_data = Input(BIAS).template data<T>();
+      for (int image_id = 0; image_id < N; ++image_id) {
+        math::Gemm<T, Context>(
+            CblasNoTrans,
+            CblasNoTrans,
+            M,
+            output_image_size,
+            1,
+            1,
+            bias_data,
+            bias_multiplier_.template data<T>(),
+            1,
+            Ydata + image_id * output_offset * group_,
+            &context_);
+      }
+    }
+    if (relu_) {
+      math::Maximum<T, Context>(Y->size(), 0.f, Ydata, Ydata, &context_);
+    }
+    return true;
+  }
+
   auto f = [&](Tensor<Context>* col_buffer) {
     col_buffer->Resize(buffer_shape);
     T* col_buffer_data = col_buffer->template mutable_data<T>();
@@ -151,6 +232,10 @@ bool ConvOp<T, Context>::RunOnDeviceWithOrderNCHW() {
             Ydata,
             &context_);
       }
+      if (relu_) {
+        math::Maximum<T, Context>(
+            output_offset * group_, 0.f, Ydata, Ydata, &context_);
+      }
       Xdata += input_offset * group_;
       Ydata += output_offset * group_;
     }
@@ -239,6 +324,9 @@ bool ConvOp<T, Context>::RunOnDeviceWithOrderNHWC() {
           Ydata,
           &context_);
     }
+    if (relu_) {
+      math::Maximum<T, Context>(Y->size(), 0.f, Ydata, Ydata, &context_);
+    }
   } else {
     if (InputSize() == 3) {
       const auto& bias = Input(BIAS);
@@ -298,6 +386,10 @@ bool ConvOp<T, Context>::RunOnDeviceWithOrderNHWC() {
               Ydata,
               &context_);
         }
+        if (relu_) {
+          math::Maximum<T, Context>(
+              output_offset, 0.f, Ydata, Ydata, &context_);
+        }
         Xdata += input_offset;
         Ydata += output_offset;
       }
@@ -355,7 +447,17 @@ bool ConvGradientOp<T, Context>::RunOnDeviceWithOrderNCHW() {
   col_buffer_shape.push_back(C / group_ * kernel_dims_size);
   col_buffer_shape.insert(
       col_buffer_shape.end(), output_dims.begin(), output_dims.end());
-  col_buffer_.Resize(col_buffer_shape);
+  // For 1x1(x1) convolution with pad 0 that strides along the leading
+  // spatial axis at most, the image frames are used in place of the col
+  // buffer, so im2col and col2im are skipped.
+  const int pointwise_stride = PointwiseLeadingStride();
+  // The output frames along the leading axis, or the whole output image
+  // without stride.
+  const int pointwise_frames = pointwise_stride > 1 ? output_dims[0] : 1;
+  const int frame_size = output_image_size / pointwise_frames;
+  if (pointwise_stride == 0) {
+    col_buffer_.Resize(col_buffer_shape);
+  }
 
   if (kernel_.size() != 2) {
     SetDeviceTensor(img_shape, &img_shape_device_);
@@ -367,7 +469,9 @@ bool ConvGradientOp<T, Context>::RunOnDeviceWithOrderNCHW() {
   const T* Xdata = X.template data<T>();
   const T* filter_data = filter.template data<T>();
   const T* dYdata = dY.template data<T>();
-  T* col_buffer_data = col_buffer_.template mutable_data<T>();
+  T* col_buffer_data = pointwise_stride > 0
+      ? nullptr
+      : col_buffer_.template mutable_data<T>();
   T* dfilter_data = dfilter->template mutable_data<T>();
 
   // Pre-setting the gradients to zero.
@@ -394,6 +498,27 @@ bool ConvGradientOp<T, Context>::RunOnDeviceWithOrderNCHW() {
     for (int group_id = 0; group_id < group_; ++group_id) {
       // When we compute the gradient with respect to the filters, we need to do
       // im2col to allow gemm-type computation.
+      if (pointwise_stride > 0) {
+        for (int frame = 0; frame < pointwise_frames; ++frame) {
+          math::GemmEx<T, Context>(
+              CblasNoTrans,
+              CblasTrans,
+              M / group_,
+              kernel_dim,
+              frame_size,
+              1,
+              dYdata + group_id * output_offset + frame * frame_size,
+              output_image_size,
+              Xdata + group_id * input_offset +
+                  frame * pointwise_stride * frame_size,
+              input_image_size,
+              1,
+              dfilter_data + group_id * filter_offset,
+              kernel_dim,
+              &context_);
+        }
+        continue;
+      }
       if (kernel_.size() == 2) {
         math::Im2col<T, Context, StorageOrder::NCHW>(
             Xdata + group_id * input_offset,
@@ -463,6 +588,59 @@ bool ConvGradientOp<T, Context>::RunOnDeviceWithOrderNCHW() {
     dX->ResizeLike(X);
     T* dXdata = dX->template mutable_data<T>();
     dYdata = dY.template data<T>();
+    if (pointwise_stride == 1) {
+      // One batched gemm over the images per group.
+      for (int group_id = 0; group_id < group_; ++group_id) {
+        math::GemmStridedBatched<T, Context>(
+            CblasTrans,
+            CblasNoTrans,
+            N,
+            kernel_dim,
+            output_image_size,
+            M / group_,
+            1,
+            filter_data + group_id * filter_offset,
+            kernel_dim,
+            0,
+            dYdata + group_id * output_offset,
+            output_image_size,
+            output_offset * group_,
+            0,
+            dXdata + group_id * input_offset,
+            input_image_size,
+            input_offset * group_,
+            &context_);
+      }
+      return true;
+    }
+    if (pointwise_stride > 1) {
+      // The input frames between the strided ones get no gradient.
+      math::Set<T, Context>(dX->size(), 0, dXdata, &context_);
+      for (int image_id = 0; image_id < N; ++image_id) {
+        for (int group_id = 0; group_id < group_; ++group_id) {
+          math::GemmStridedBatched<T, Context>(
+              CblasTrans,
+              CblasNoTrans,
+              pointwise_frames,
+              kernel_dim,
+              frame_size,
+              M / group_,
+              1,
+              filter_data + group_id * filter_offset,
+              kernel_dim,
+              0,
+              dYdata + (image_id * group_ + group_id) * output_offset,
+              output_image_size,
+              frame_size,
+              0,
+              dXdata + (image_id * group_ + group_id) * input_offset,
+              input_image_size,
+              pointwise_stride * frame_size,
+              &context_);
+        }
+      }
+      return true;
+    }
     for (int image_id = 0; image_id < N; ++image_id) {
       for (int group_id = 0; group_id < group_; ++group_id) {
         // Compute gradient into col_buffer.
@@ -497,11 +675,12 @@ bool ConvGradientOp<T, Context>::RunOnDeviceWithOrderNCHW() {
               dXdata,
               &context_);
         } else {
+          // the image of a group, which Col2imNd zeroes before adding to it
           math::Col2imNd<T, Context, StorageOrder::NCHW>(
               col_buffer_data,
               img_shape_device_.template data<int>(),
               col_buffer_shape_device_.template data<int>(),
-              C * input_image_size,
+              input_offset,
               col_buffer_size,
               kernel_device_.template data<int>(),
               stride_device_.template data<int>(),
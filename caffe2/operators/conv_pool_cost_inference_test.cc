@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/operator_schema.h"
+
+namespace caffe2 {
+
+namespace {
+
+TensorShape Shape(const vector<int>& dims) {
+  return CreateTensorShape(dims, TensorProto::FLOAT);
+}
+
+OpSchema::Cost InferCost(
+    const OperatorDef& def,
+    const vector<TensorShape>& shapes) {
+  const auto* schema = OpSchemaRegistry::Schema(def.type());
+  CAFFE_ENFORCE(schema && schema->HasCostInferenceFunction(), def.type());
+  return schema->InferCost(def, shapes);
+}
+
+} // namespace
+
+TEST(ConvPoolCostInferenceTest, Conv3D) {
+  // a 3x3x3 conv of 4 into 8 channels over 4x6x6, with a bias
+  const auto def = CreateOperatorDef(
+      "Conv",
+      "",
+      vector<string>{"X", "W", "b"},
+      vector<string>{"Y"},
+      vector<Argument>{MakeArgument<vector<int>>("kernels", {3, 3, 3}),
+                       MakeArgument<vector<int>>("pads", {1, 1, 1, 1, 1, 1}),
+                       MakeArgument<vector<int>>("strides", {1, 1, 1})});
+  const auto c = InferCost(
+      def,
+      {Shape({2, 4, 4, 6, 6}), Shape({8, 4, 3, 3, 3}), Shape({8})});
+  const uint64_t Y_size = 2 * 8 * 4 * 6 * 6;
+  EXPECT_EQ(c.flops, Y_size * 4 * 27 * 2 + Y_size);
+  EXPECT_EQ(c.bytes_moved, (2 * 4 * 4 * 6 * 6 + Y_size) * sizeof(float));
+  EXPECT_EQ(c.params_bytes, (8 * 4 * 27 + 8) * sizeof(float));
+}
+
+TEST(ConvPoolCostInferenceTest, GroupedConv) {
+  // 2 groups, so W has half of the 4 input channels
+  const auto def = CreateOperatorDef(
+      "Conv",
+      "",
+      vector<string>{"X", "W"},
+      vector<string>{"Y"},
+      vector<Argument>{MakeArgument<int>("kernel", 1),
+                       MakeArgument<int>("group", 2)});
+  const auto c = InferCost(def, {Shape({1, 4, 5, 5}), Shape({6, 2, 1, 1})});
+  EXPECT_EQ(c.flops, 6 * 25 * 2 * 2);
+  EXPECT_EQ(c.params_bytes, 6 * 2 * sizeof(float));
+}
+
+TEST(ConvPoolCostInferenceTest, ConvGradient) {
+  const vector<Argument> args{MakeArgument<vector<int>>("kernels", {1, 3, 3}),
+                              MakeArgument<vector<int>>(
+                                  "pads", {0, 1, 1, 0, 1, 1})};
+  const vector<TensorShape> shapes{
+      Shape({1, 2, 3, 4, 4}), Shape({5, 2, 1, 3, 3}), Shape({1, 5, 3, 4, 4})};
+  const uint64_t conv_flops = 5 * 3 * 4 * 4 * 2 * 9 * 2;
+  const uint64_t X_bytes = 2 * 3 * 4 * 4 * sizeof(float);
+  const uint64_t dY_bytes = 5 * 3 * 4 * 4 * sizeof(float);
+  // dW, db and dX
+  auto with_dX = InferCost(
+      CreateOperatorDef(
+          "ConvGradient",
+          "",
+          vector<string>{"X", "W", "dY"},
+          vector<string>{"dW", "db", "dX"},
+          args),
+      shapes);
+  EXPECT_EQ(with_dX.flops, 2 * conv_flops + 5 * 3 * 4 * 4);
+  EXPECT_EQ(with_dX.bytes_moved, 2 * X_bytes + dY_bytes);
+  EXPECT_EQ(with_dX.params_bytes, 2 * (5 * 2 * 9 + 5) * sizeof(float));
+  // dW only
+  auto args_no_bias = args;
+  args_no_bias.push_back(MakeArgument<int>("no_bias", 1));
+  auto dW_only = InferCost(
+      CreateOperatorDef(
+          "ConvGradient",
+          "",
+          vector<string>{"X", "W", "dY"},
+          vector<string>{"dW"},
+          args_no_bias),
+      shapes);
+  EXPECT_EQ(dW_only.flops, conv_flops);
+  EXPECT_EQ(dW_only.bytes_moved, X_bytes + dY_bytes);
+}
+
+TEST(ConvPoolCostInferenceTest, Pool3D) {
+  const auto def = CreateOperatorDef(
+      "MaxPool",
+      "",
+      vector<string>{"X"},
+      vector<string>{"Y"},
+      vector<Argument>{MakeArgument<vector<int>>("kernels", {1, 2, 2}),
+                       MakeArgument<vector<int>>("strides", {1, 2, 2})});
+  const auto c = InferCost(def, {Shape({2, 3, 4, 8, 8})});
+  const uint64_t Y_size = 2 * 3 * 4 * 4 * 4;
+  EXPECT_EQ(c.flops, Y_size * 4);
+  EXPECT_EQ(c.bytes_moved, (Y_size * 4 + Y_size) * sizeof(float));
+
+  const auto global = CreateOperatorDef(
+      "AveragePool",
+      "",
+      vector<string>{"X"},
+      vector<string>{"Y"},
+      vector<Argument>{MakeArgument<int>("global_pooling", 1)});
+  EXPECT_EQ(InferCost(global, {Shape({2, 3, 4, 8, 8})}).flops, 6 * 256);
+
+  const auto gradient = CreateOperatorDef(
+      "MaxPoolGradient",
+      "",
+      vector<string>{"X", "Y", "dY"},
+      vector<string>{"dX"},
+      vector<Argument>{MakeArgument<vector<int>>("kernels", {1, 2, 2}),
+                       MakeArgument<vector<int>>("strides", {1, 2, 2})});
+  const auto g = InferCost(
+      gradient,
+      {Shape({2, 3, 4, 8, 8}), Shape({2, 3, 4, 4, 4}), Shape({2, 3, 4, 4, 4})});
+  EXPECT_EQ(g.flops, Y_size * 4);
+}
+
+TEST(ConvPoolCostInferenceTest, SpatialBN3D) {
+  const auto def = CreateOperatorDef(
+      "SpatialBN",
+      "",
+      vector<string>{"X", "scale", "bias", "mean", "var"},
+      vector<string>{"Y"},
+      vector<Argument>{MakeArgument<int>("is_test", 1)});
+  const auto X = Shape({2, 4, 3, 5, 5});
+  const auto C = Shape({4});
+  const auto c = InferCost(def, {X, C, C, C, C});
+  EXPECT_EQ(c.flops, 4 * nElemFromDim(X));
+  EXPECT_EQ(c.bytes_moved, 2 * nElemFromDim(X) * sizeof(float));
+}
+
+} // namespace caffe2
@@ -396,64 +396,122 @@ class ConvPoolOpBase : public Operator<Context> {
     CAFFE_NOT_IMPLEMENTED;
   }
 
-  static struct OpSchema::Cost CostInferenceForConv(
+  // The cost of a convolution of X by W into Y, in 2D or 3D, with a bias or
+  // the gradient of one. W holds in_channels / group input channels, so
+  // groups are accounted for. bytes_moved counts X and Y, params_bytes the
+  // filter and the bias.
+  static struct OpSchema::Cost CostForConv(
       const OperatorDef& def,
-      const vector<TensorShape>& inputs) {
+      const TensorShape& X,
+      const TensorShape& W,
+      const TensorShape& Y,
+      const bool has_bias) {
     struct OpSchema::Cost c;
-    const TensorShape X = inputs[0];
-    const TensorShape W = inputs[1];
-    const TensorShape Y = TensorInferenceForConv(def, inputs)[0];
     ArgumentHelper helper(def);
     const auto order =
         StringToStorageOrder(helper.GetSingleArgument<string>("order", "NCHW"));
-
-    unsigned long long N;
-    unsigned long long Y_t = 1;
-    unsigned long long Y_h;
-    unsigned long long Y_w;
-    unsigned long long kernel_t = 1;
-    unsigned long long kernel_h;
-    unsigned long long kernel_w;
-    unsigned long long in_channels;
-    unsigned long long out_channels;
-
-    N = X.dims(0);
+    CAFFE_ENFORCE(
+        X.dims_size() == 4 || X.dims_size() == 5,
+        "Conv cost inference supports 4D and 5D inputs.");
     if (X.dims_size() == 5) {
-      // 3D convolution
       CAFFE_ENFORCE_EQ(order, StorageOrder::NCHW, "Conv3D only supports NCHW");
-      Y_t = Y.dims(2);
-      Y_h = Y.dims(3);
-      Y_w = Y.dims(4);
-      kernel_t = W.dims(2);
-      kernel_h = W.dims(3);
-      kernel_w = W.dims(4);
-      in_channels = W.dims(1);
-      out_channels = W.dims(0);
-    } else {
-      // 2D convolution
-      CAFFE_ENFORCE_EQ(X.dims_size(), 4, "Conv2D should have 4D input tensor");
-      if (order == StorageOrder::NHWC) {
-        Y_h = Y.dims(1);
-        Y_w = Y.dims(2);
-        kernel_h = W.dims(1);
-        kernel_w = W.dims(2);
-        in_channels = W.dims(3);
-        out_channels = W.dims(0);
-      } else {
-        Y_h = Y.dims(2);
-        Y_w = Y.dims(3);
-        kernel_h = W.dims(2);
-        kernel_w = W.dims(3);
-        in_channels = W.dims(1);
-        out_channels = W.dims(0);
-      }
     }
-    // grouping is NOT properly handled yet
-    c.flops = N * Y_t * Y_h * Y_w * kernel_t * kernel_w * kernel_h *
-        in_channels * out_channels * 2;
-    c.bytes_moved = N * out_channels * Y_t * Y_h * Y_w * sizeof(float);
-    c.params_bytes = out_channels * in_channels * kernel_t * kernel_h *
-        kernel_w * sizeof(float);
+    const uint64_t out_channels = W.dims(0);
+    // the filter volume times its input channels, in either order
+    const uint64_t kernel_size = nElemFromDim(W, 1);
+    const uint64_t Y_size = nElemFromDim(Y);
+    c.flops = Y_size * kernel_size * 2 + (has_bias ? Y_size : 0);
+    c.bytes_moved = (nElemFromDim(X) + Y_size) * sizeof(float);
+    c.params_bytes =
+        (out_channels * kernel_size + (has_bias ? out_channels : 0)) *
+        sizeof(float);
+    return c;
+  }
+
+  static struct OpSchema::Cost CostInferenceForConv(
+      const OperatorDef& def,
+      const vector<TensorShape>& inputs) {
+    const TensorShape Y = TensorInferenceForConv(def, inputs)[0];
+    return CostForConv(def, inputs[0], inputs[1], Y, inputs.size() > 2);
+  }
+
+  // ConvGradient takes X, W and dY and computes dW, the bias gradient unless
+  // no_bias is set and dX if it has an output for it. dW and dX each cost a
+  // convolution.
+  static struct OpSchema::Cost CostInferenceForConvGradient(
+      const OperatorDef& def,
+      const vector<TensorShape>& inputs) {
+    CAFFE_ENFORCE_EQ(inputs.size(), 3, "ConvGradient takes X, W and dY.");
+    ArgumentHelper helper(def);
+    const bool no_bias = helper.GetSingleArgument<int>("no_bias", 0);
+    const bool compute_dX = def.output_size() == (no_bias ? 2 : 3);
+    const auto& X = inputs[0];
+    const auto& dY = inputs[2];
+    auto c = CostForConv(def, X, inputs[1], dY, !no_bias);
+    if (compute_dX) {
+      c.flops += nElemFromDim(dY) * nElemFromDim(inputs[1], 1) * 2;
+      c.bytes_moved += nElemFromDim(X) * sizeof(float);
+    }
+    // the parameters are read and their gradients written
+    c.params_bytes *= 2;
+    return c;
+  }
+
+  // The kernel of a pooling op over X, from its arguments as the op reads
+  // them.
+  static vector<int> PoolKernel(const OperatorDef& def, const TensorShape& X) {
+    ArgumentHelper helper(def);
+    const auto order =
+        StringToStorageOrder(helper.GetSingleArgument<string>("order", "NCHW"));
+    if (helper.GetSingleArgument<int>("global_pooling", 0)) {
+      const int first = order == StorageOrder::NCHW ? 2 : 1;
+      return vector<int>(
+          X.dims().begin() + first,
+          X.dims().begin() + first + X.dims_size() - 2);
+    }
+    vector<int> kernel = helper.GetRepeatedArgument<int>("kernels");
+    if (helper.HasArgument("kernel")) {
+      kernel.resize(2, helper.GetSingleArgument<int>("kernel", 1));
+    } else if (
+        helper.HasArgument("kernel_h") && helper.HasArgument("kernel_w")) {
+      kernel.push_back(helper.GetSingleArgument<int>("kernel_h", 1));
+      kernel.push_back(helper.GetSingleArgument<int>("kernel_w", 1));
+    }
+    return kernel;
+  }
+
+  // A pooling op reads its kernel window for every output.
+  static struct OpSchema::Cost CostInferenceForPool(
+      const OperatorDef& def,
+      const vector<TensorShape>& inputs) {
+    struct OpSchema::Cost c;
+    const TensorShape Y = TensorInferenceForPool(def, inputs)[0];
+    uint64_t kernel_size = 1;
+    for (const int k : PoolKernel(def, inputs[0])) {
+      kernel_size *= k;
+    }
+    const uint64_t Y_size = nElemFromDim(Y);
+    c.flops = Y_size * kernel_size;
+    c.bytes_moved = (nElemFromDim(inputs[0]) + Y_size) * sizeof(float);
+    c.params_bytes = 0;
+    return c;
+  }
+
+  // PoolGradient takes X, Y and dY and writes dX.
+  static struct OpSchema::Cost CostInferenceForPoolGradient(
+      const OperatorDef& def,
+      const vector<TensorShape>& inputs) {
+    CAFFE_ENFORCE_EQ(inputs.size(), 3, "PoolGradient takes X, Y and dY.");
+    struct OpSchema::Cost c;
+    uint64_t kernel_size = 1;
+    for (const int k : PoolKernel(def, inputs[0])) {
+      kernel_size *= k;
+    }
+    const uint64_t X_size = nElemFromDim(inputs[0]);
+    const uint64_t Y_size = nElemFromDim(inputs[1]);
+    c.flops = Y_size * kernel_size;
+    c.bytes_moved = (2 * X_size + 2 * Y_size) * sizeof(float);
+    c.params_bytes = 0;
     return c;
   }
 
@@ -469,7 +527,7 @@ class ConvPoolOpBase : public Operator<Context> {
     vector<int> pads = helper.GetRepeatedArgument<int>("pads");
     vector<int> kernel = helper.GetRepeatedArgument<int>("kernels");
     vector<int> strides = helper.GetRepeatedArgument<int>("strides");
-    vector<int> dilations = helper.GetRepeatedArgument<int>("dilation");
+    vector<int> dilations = helper.GetRepeatedArgument<int>("dilations");
     if (helper.HasArgument("pad")) {
       pads.resize(4, helper.GetSingleArgument<int>("pad", 0));
     } else if (
@@ -498,11 +556,11 @@ class ConvPoolOpBase : public Operator<Context> {
     }
 
     if (helper.HasArgument("dilation")) {
-      strides.resize(2, helper.GetSingleArgument<int>("dilation", 1));
+      dilations.resize(2, helper.GetSingleArgument<int>("dilation", 1));
     } else if (
         helper.HasArgument("dilation_h") && helper.HasArgument("dilation_w")) {
-      strides.push_back(helper.GetSingleArgument<int>("dilation_h", 1));
-      strides.push_back(helper.GetSingleArgument<int>("dilation_w", 1));
+      dilations.push_back(helper.GetSingleArgument<int>("dilation_h", 1));
+      dilations.push_back(helper.GetSingleArgument<int>("dilation_w", 1));
     }
 
     auto check_and_set_default_value =
@@ -557,7 +615,8 @@ class ConvPoolOpBase : public Operator<Context> {
     auto order =
         StringToStorageOrder(helper.GetSingleArgument<string>("order", "NCHW"));
     int num_channels =
-        (order == StorageOrder::NCHW ? in[0].dims(1) : in[0].dims(3));
+        (order == StorageOrder::NCHW ? in[0].dims(1)
+                                     : in[0].dims(in[0].dims_size() - 1));
     return TensorInferenceForSchema(def, in, num_channels);
   }
 
@@ -705,6 +764,27 @@ class ConvPoolOpBase : public Operator<Context> {
     return dilation_[1];
   }
 
+  // For 1x1(x1) kernels without padding that only stride along the leading
+  // spatial axis (e.g. time), returns that stride, else 0. Every output
+  // frame of the leading axis is then a GEMM on one input frame, so the
+  // image is used as is instead of an im2col buffer.
+  int PointwiseLeadingStride() const {
+    for (int i = 0; i < kernel_.size(); ++i) {
+      if (kernel_[i] != 1 || (i > 0 && stride_[i] != 1)) {
+        return 0;
+      }
+    }
+    for (int i = 0; i < pads_.size(); ++i) {
+      if (pads_[i] != 0) {
+        return 0;
+      }
+    }
+    if (kernel_.size() == 1 && stride_[0] != 1) {
+      return 0;
+    }
+    return stride_[0];
+  }
+
  private:
  inline void AllocateAndCopy(const vector<int>& vec, Tensor<Context>& tensor) {
       tensor.Resize(vec.size());
@@ -712,34 +792,35 @@ class ConvPoolOpBase : public Operator<Context> {
           vec.size(), vec.data(), tensor.template mutable_data<int>());
  }
 
-#define USE_CONV_POOL_BASE_FUNCTIONS(Context)      \
-  USE_OPERATOR_FUNCTIONS(Context);                 \
-  using ConvPoolOpBase<Context>::pads_;            \
-  using ConvPoolOpBase<Context>::pads_device_;     \
-  using ConvPoolOpBase<Context>::pad_t;            \
-  using ConvPoolOpBase<Context>::pad_l;            \
-  using ConvPoolOpBase<Context>::pad_b;            \
-  using ConvPoolOpBase<Context>::pad_r;            \
-  using ConvPoolOpBase<Context>::legacy_pad_;      \
-  using ConvPoolOpBase<Context>::global_pooling_;  \
-  using ConvPoolOpBase<Context>::kernel_;          \
-  using ConvPoolOpBase<Context>::kernel_device_;   \
-  using ConvPoolOpBase<Context>::kernel_h;         \
-  using ConvPoolOpBase<Context>::kernel_w;         \
-  using ConvPoolOpBase<Context>::dilation_;        \
-  using ConvPoolOpBase<Context>::dilation_device_; \
-  using ConvPoolOpBase<Context>::dilation_h;       \
-  using ConvPoolOpBase<Context>::dilation_w;       \
-  using ConvPoolOpBase<Context>::stride_;          \
-  using ConvPoolOpBase<Context>::stride_device_;   \
-  using ConvPoolOpBase<Context>::stride_h;         \
-  using ConvPoolOpBase<Context>::stride_w;         \
-  using ConvPoolOpBase<Context>::group_;           \
-  using ConvPoolOpBase<Context>::order_;           \
-  using ConvPoolOpBase<Context>::shared_buffer_;   \
-  using ConvPoolOpBase<Context>::GetDims;          \
-  using ConvPoolOpBase<Context>::GetDimsSize;      \
-  using ConvPoolOpBase<Context>::SetDeviceTensor;  \
+#define USE_CONV_POOL_BASE_FUNCTIONS(Context)            \
+  USE_OPERATOR_FUNCTIONS(Context);                       \
+  using ConvPoolOpBase<Context>::pads_;                  \
+  using ConvPoolOpBase<Context>::pads_device_;           \
+  using ConvPoolOpBase<Context>::pad_t;                  \
+  using ConvPoolOpBase<Context>::pad_l;                  \
+  using ConvPoolOpBase<Context>::pad_b;                  \
+  using ConvPoolOpBase<Context>::pad_r;                  \
+  using ConvPoolOpBase<Context>::legacy_pad_;            \
+  using ConvPoolOpBase<Context>::global_pooling_;        \
+  using ConvPoolOpBase<Context>::kernel_;                \
+  using ConvPoolOpBase<Context>::kernel_device_;         \
+  using ConvPoolOpBase<Context>::kernel_h;               \
+  using ConvPoolOpBase<Context>::kernel_w;               \
+  using ConvPoolOpBase<Context>::dilation_;              \
+  using ConvPoolOpBase<Context>::dilation_device_;       \
+  using ConvPoolOpBase<Context>::dilation_h;             \
+  using ConvPoolOpBase<Context>::dilation_w;             \
+  using ConvPoolOpBase<Context>::stride_;                \
+  using ConvPoolOpBase<Context>::stride_device_;         \
+  using ConvPoolOpBase<Context>::stride_h;               \
+  using ConvPoolOpBase<Context>::stride_w;               \
+  using ConvPoolOpBase<Context>::group_;                 \
+  using ConvPoolOpBase<Context>::order_;                 \
+  using ConvPoolOpBase<Context>::shared_buffer_;         \
+  using ConvPoolOpBase<Context>::GetDims;                \
+  using ConvPoolOpBase<Context>::GetDimsSize;            \
+  using ConvPoolOpBase<Context>::PointwiseLeadingStride; \
+  using ConvPoolOpBase<Context>::SetDeviceTensor;        \
   using ConvPoolOpBase<Context>::ws_
 };
 
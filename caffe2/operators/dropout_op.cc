@@ -2,8 +2,30 @@
 
 namespace caffe2 {
 
+template <>
+void PhiloxDropout<CPUContext>(
+    const int N,
+    const float ratio,
+    const int64_t seed,
+    const int64_t offset,
+    const float* X,
+    float* Y,
+    CPUContext* /*context*/) {
+  const float scale = 1. / (1. - ratio);
+  for (int i = 0; i < N; i += 4) {
+    bool keep[4];
+    PhiloxDropoutKeep(i / 4, seed, offset, ratio, keep);
+    for (int j = 0; j < 4 && i + j < N; ++j) {
+      Y[i + j] = keep[j] ? X[i + j] * scale : 0;
+    }
+  }
+}
+
 template <>
 bool DropoutOp<float, CPUContext>::RunOnDevice() {
+  if (!is_test_ && regenerate_mask_) {
+    return RunWithRegeneratedMask();
+  }
   auto& X = Input(0);
   auto* Y = Output(0);
   Y->Resize(X.dims());
@@ -34,6 +56,9 @@ bool DropoutOp<float, CPUContext>::RunOnDevice() {
 
 template <>
 bool DropoutGradientOp<float, CPUContext>::RunOnDevice() {
+  if (!is_test_ && regenerate_mask_) {
+    return RunWithRegeneratedMask();
+  }
   auto& dY = Input(0);
   auto* dX = Output(0);
   dX->Resize(dY.dims());
@@ -71,7 +96,12 @@ OPERATOR_SCHEMA(Dropout)
       ArgumentHelper argsHelper(def);
       out.push_back(in[0]);
       auto output_mask = !argsHelper.GetSingleArgument<bool>("is_test", 0);
-      if (output_mask) {
+      if (output_mask &&
+          argsHelper.GetSingleArgument<int>("regenerate_mask", 0)) {
+        out.emplace_back();
+        out[1].add_dims(2);
+        out[1].set_data_type(TensorProto_DataType_INT64);
+      } else if (output_mask) {
         out.push_back(in[0]);
         out[1].set_data_type(TensorProto_DataType_BOOL);
       }
@@ -83,8 +113,18 @@ output (Tensor<float>) and mask (Tensor<bool>). Depending on whether it is in
 test mode or not, the output Y will either be a random dropout, or a simple
 copy of the input. Note that our implementation of Dropout does scaling in
 the training phase, so during testing nothing needs to be done.
+
+With regenerate_mask, the mask output is instead a CPU int64 tensor of the
+seed and the offset of a counter based (Philox) generator, from which
+DropoutGrad regenerates the mask: nothing of the size of the input is kept
+for the backward pass, and no mask is written and read again. The seed is
+the random_seed of the device option, and the offset changes every run.
 )DOC")
     .Arg("ratio", "(float, default 0.5) the ratio of random dropout")
+    .Arg(
+        "regenerate_mask",
+        "(int, default 0) if nonzero, output the seed of the mask and "
+        "regenerate it in the gradient, instead of outputting the mask")
     .ArgIsTest(
         "(int) if nonzero, run dropout in test mode where "
         "the output is simply Y = X.")
@@ -93,7 +133,8 @@ the training phase, so during testing nothing needs to be done.
     .Output(
         1,
         "mask",
-        "The output mask. If is_test is nonzero, this output is not filled.")
+        "The output mask, or its seed and offset with regenerate_mask. If "
+        "is_test is nonzero, this output is not filled.")
     .InheritOnnxSchema("Dropout");
 
 OPERATOR_SCHEMA(DropoutGrad)
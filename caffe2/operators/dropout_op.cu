@@ -16,10 +16,52 @@ __global__ void DropoutKernel(
     Ydata[i] = Xdata[i] * scale * maskdata[i];
   }
 }
+
+// A thread per 4 elements, as many as the Philox words of a counter.
+__global__ void PhiloxDropoutKernel(
+    const int N,
+    const float ratio,
+    const int64_t seed,
+    const int64_t offset,
+    const float* X,
+    float* Y) {
+  const float scale = 1. / (1. - ratio);
+  CUDA_1D_KERNEL_LOOP(group, (N + 3) / 4) {
+    bool keep[4];
+    PhiloxDropoutKeep(group, seed, offset, ratio, keep);
+    const int begin = 4 * group;
+    for (int j = 0; j < 4 && begin + j < N; ++j) {
+      Y[begin + j] = keep[j] ? X[begin + j] * scale : 0;
+    }
+  }
+}
 } // namespace
 
+template <>
+void PhiloxDropout<CUDAContext>(
+    const int N,
+    const float ratio,
+    const int64_t seed,
+    const int64_t offset,
+    const float* X,
+    float* Y,
+    CUDAContext* context) {
+  const int groups = (N + 3) / 4;
+  if (groups == 0) {
+    return;
+  }
+  PhiloxDropoutKernel<<<
+      CAFFE_GET_BLOCKS(groups),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(N, ratio, seed, offset, X, Y);
+}
+
 template <>
 bool DropoutOp<float, CUDAContext>::RunOnDevice() {
+  if (!is_test_ && regenerate_mask_) {
+    return RunWithRegeneratedMask();
+  }
   auto& X = Input(0);
   auto* Y = Output(0);
   Y->Resize(X.dims());
@@ -64,6 +106,9 @@ __global__ void DropoutGradientKernel(
 
 template <>
 bool DropoutGradientOp<float, CUDAContext>::RunOnDevice() {
+  if (!is_test_ && regenerate_mask_) {
+    return RunWithRegeneratedMask();
+  }
   auto& dY = Input(0);
   auto* dX = Output(0);
   dX->Resize(dY.dims());
@@ -1,13 +1,53 @@
 #ifndef CAFFE2_OPERATORS_DROPOUT_OP_H_
 #define CAFFE2_OPERATORS_DROPOUT_OP_H_
 
+#include <limits>
+
 #include "caffe2/core/context.h"
 #include "caffe2/core/logging.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/utils/math.h"
+#include "caffe2/utils/philox_random.h"
 
 namespace caffe2 {
 
+// The 4 keep bits of elements 4 * group to 4 * group + 3 of the mask of a
+// dropout with the given seed and offset: an element is kept when its
+// uniform in [0, 1) is at least ratio.
+CAFFE2_PHILOX_HOST_DEVICE inline void PhiloxDropoutKeep(
+    const int64_t group,
+    const int64_t seed,
+    const int64_t offset,
+    const float ratio,
+    bool keep[4]) {
+  const uint32_t counter[4] = {static_cast<uint32_t>(group),
+                               static_cast<uint32_t>(group >> 32),
+                               static_cast<uint32_t>(offset),
+                               static_cast<uint32_t>(offset >> 32)};
+  uint32_t random[4];
+  Philox4x32(
+      counter,
+      static_cast<uint32_t>(seed),
+      static_cast<uint32_t>(seed >> 32),
+      random);
+  for (int j = 0; j < 4; ++j) {
+    keep[j] = (random[j] >> 8) * (1.0f / (1 << 24)) >= ratio;
+  }
+}
+
+// Y = X * mask / (1 - ratio) with the mask of PhiloxDropoutKeep, for the
+// dropout with regenerate_mask as for its gradient, which regenerates the
+// mask of the same seed and offset. X and Y may be the same.
+template <class Context>
+void PhiloxDropout(
+    const int N,
+    const float ratio,
+    const int64_t seed,
+    const int64_t offset,
+    const float* X,
+    float* Y,
+    Context* context);
+
 template <typename T, class Context>
 class DropoutOp final : public Operator<Context> {
  public:
@@ -16,7 +56,13 @@ class DropoutOp final : public Operator<Context> {
       : Operator<Context>(operator_def, ws),
         ratio_(OperatorBase::GetSingleArgument<float>("ratio", 0.5)),
         is_test_(
-            OperatorBase::GetSingleArgument<int>(OpSchema::Arg_IsTest, 0)) {
+            OperatorBase::GetSingleArgument<int>(OpSchema::Arg_IsTest, 0)),
+        regenerate_mask_(
+            OperatorBase::GetSingleArgument<int>("regenerate_mask", 0)),
+        seed_(
+            operator_def.device_option().has_random_seed()
+                ? operator_def.device_option().random_seed()
+                : RandomNumberSeed()) {
     CAFFE_ENFORCE_GE(ratio_, 0);
     CAFFE_ENFORCE_LT(ratio_, 1);
   }
@@ -24,8 +70,34 @@ class DropoutOp final : public Operator<Context> {
   bool RunOnDevice() override;
 
  protected:
+  // Outputs the seed and the offset of the mask instead of the mask, a new
+  // offset every run.
+  bool RunWithRegeneratedMask() {
+    auto& X = Input(0);
+    auto* Y = Output(0);
+    Y->Resize(X.dims());
+    CAFFE_ENFORCE_LE(X.size(), std::numeric_limits<int>::max());
+    auto* state = OperatorBase::Output<TensorCPU>(1);
+    state->Resize(2);
+    int64_t* state_data = state->template mutable_data<int64_t>();
+    state_data[0] = seed_;
+    state_data[1] = offset_++;
+    PhiloxDropout<Context>(
+        X.size(),
+        ratio_,
+        state_data[0],
+        state_data[1],
+        X.template data<float>(),
+        Y->template mutable_data<float>(),
+        &context_);
+    return true;
+  }
+
   float ratio_;
   bool is_test_;
+  bool regenerate_mask_;
+  int64_t seed_;
+  int64_t offset_ = 0;
   // Input: X; Output: Y, mask.
 };
 
@@ -37,7 +109,9 @@ class DropoutGradientOp final : public Operator<Context> {
       : Operator<Context>(operator_def, ws),
         ratio_(OperatorBase::GetSingleArgument<float>("ratio", 0.5)),
         is_test_(
-            OperatorBase::GetSingleArgument<int>(OpSchema::Arg_IsTest, 0)) {
+            OperatorBase::GetSingleArgument<int>(OpSchema::Arg_IsTest, 0)),
+        regenerate_mask_(
+            OperatorBase::GetSingleArgument<int>("regenerate_mask", 0)) {
     CAFFE_ENFORCE_GE(ratio_, 0);
     CAFFE_ENFORCE_LT(ratio_, 1);
   }
@@ -45,8 +119,28 @@ class DropoutGradientOp final : public Operator<Context> {
   bool RunOnDevice() override;
 
  protected:
+  // The mask is regenerated from the seed and the offset of the dropout.
+  bool RunWithRegeneratedMask() {
+    auto& dY = Input(0);
+    auto* dX = Output(0);
+    dX->Resize(dY.dims());
+    const auto& state = OperatorBase::Input<TensorCPU>(1);
+    CAFFE_ENFORCE_EQ(state.size(), 2);
+    const int64_t* state_data = state.template data<int64_t>();
+    PhiloxDropout<Context>(
+        dY.size(),
+        ratio_,
+        state_data[0],
+        state_data[1],
+        dY.template data<float>(),
+        dX->template mutable_data<float>(),
+        &context_);
+    return true;
+  }
+
   float ratio_;
   bool is_test_;
+  bool regenerate_mask_;
   // Input: dY, mask; Output: dX
 };
 
@@ -23,6 +23,9 @@ class CuDNNDropoutOp final : public Operator<CUDAContext> {
         random_seed_(operator_def.device_option().random_seed()) {
     CAFFE_ENFORCE_GE(ratio_, 0);
     CAFFE_ENFORCE_LT(ratio_, 1);
+    CAFFE_ENFORCE(
+        !OperatorBase::GetSingleArgument<int>("regenerate_mask", 0),
+        "regenerate_mask is only supported by the default engine");
     CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&data_desc_));
 
     CUDNN_ENFORCE(cudnnCreateDropoutDescriptor(&dropout_desc_));
@@ -0,0 +1,113 @@
+#include "caffe2/operators/flat_buffer_op.h"
+
+namespace caffe2 {
+REGISTER_CPU_OPERATOR(CreateFlatBuffer, CreateFlatBufferOp<CPUContext>);
+REGISTER_CPU_OPERATOR(FlatBufferFromViews, FlatBufferFromViewsOp<CPUContext>);
+REGISTER_CPU_OPERATOR(FlatBufferToViews, FlatBufferToViewsOp<CPUContext>);
+REGISTER_CPU_OPERATOR(FlatBufferShards, FlatBufferShardsOp<CPUContext>);
+REGISTER_CPU_OPERATOR(FlatBufferSlices, FlatBufferSlicesOp<CPUContext>);
+SHOULD_NOT_DO_GRADIENT(CreateFlatBuffer);
+SHOULD_NOT_DO_GRADIENT(FlatBufferFromViews);
+SHOULD_NOT_DO_GRADIENT(FlatBufferToViews);
+SHOULD_NOT_DO_GRADIENT(FlatBufferShards);
+SHOULD_NOT_DO_GRADIENT(FlatBufferSlices);
+
+OPERATOR_SCHEMA(CreateFlatBuffer)
+    .NumInputs(1, INT_MAX)
+    .NumOutputs(2, INT_MAX)
+    .NumInputsOutputs([](int in, int out) { return out == in + 1; })
+    .AllowInplace([](int in, int out) { return in == out; })
+    .TensorInferenceFunction([](const OperatorDef& /* unused */,
+                                const vector<TensorShape>& in) {
+      vector<TensorShape> out(in.begin(), in.end());
+      out.emplace_back();
+      out.back().set_data_type(in[0].data_type());
+      out.back().set_unknown_shape(true);
+      return out;
+    })
+    .SetDoc(R"DOC(
+Allocates one flat buffer, the last output, and makes outputs 0 to N - 1
+views into it, one after the other, with the shapes of inputs 0 to N - 1.
+With copy (default 1) every view starts with the data of its input, which it
+may replace in place, e.g. to move the params of a model into a buffer;
+otherwise the buffer is zeroed, e.g. to lay out the gradients of the params,
+whose blobs the backward ops then write into the buffer.
+
+A view keeps pointing into the buffer as long as its size and type do not
+change, so that one op on the buffer, e.g. an allreduce, covers all the
+views. FlatBufferFromViews and FlatBufferToViews order such an op with the
+ops on the views. Every view starts at a multiple of 128 bytes; the padding
+between them, and after the last one up to size_multiple, is zero.
+)DOC")
+    .Arg("copy", "copy the inputs into the views, default 1")
+    .Arg(
+        "size_multiple",
+        "pad the buffer to a multiple of this many items, default 1")
+    .Output(0, "views", "Views into the buffer, outputs 0 to N - 1")
+    .Output(1, "buffer", "The flat buffer, the last output");
+
+OPERATOR_SCHEMA(FlatBufferFromViews)
+    .NumInputs(2, INT_MAX)
+    .NumOutputs(1)
+    .AllowInplace([](int in, int out) { return out == 0 && in > 0; })
+    .SetDoc(R"DOC(
+Outputs the flat buffer of CreateFlatBuffer, the last input, in place after
+the views, inputs 0 to N - 1, which it enforces are still views into it. It
+copies nothing: it makes the ops on the buffer, e.g. the allreduce of flat
+gradients, run after the ops that write the views.
+)DOC")
+    .Arg(
+        "starts",
+        "the item offsets of the views, e.g. of FlatBufferSlices, instead of "
+        "the layout of CreateFlatBuffer");
+
+OPERATOR_SCHEMA(FlatBufferToViews)
+    .NumInputs(2, INT_MAX)
+    .NumOutputs(1, INT_MAX)
+    .EnforceInplace([](int in, int out) { return in == out + 1; })
+    .SetDoc(R"DOC(
+The inverse of FlatBufferFromViews: outputs the views, inputs 1 to N, in
+place after the flat buffer, input 0. It copies nothing: it makes the ops on
+the views, e.g. the update of the params, run after the ops that write the
+buffer.
+)DOC")
+    .Arg(
+        "starts",
+        "the item offsets of the views, e.g. of FlatBufferSlices, instead of "
+        "the layout of CreateFlatBuffer");
+
+OPERATOR_SCHEMA(FlatBufferShards)
+    .NumInputs(1)
+    .NumOutputs(2)
+    .SetDoc(R"DOC(
+Outputs two views of the flat buffer of CreateFlatBuffer, the input, whose
+size should be a multiple of num_shards: the buffer as a matrix of
+num_shards rows, and its row shard_id. E.g. with the matrices of the flat
+gradients of all the devices as inputs and their rows as outputs, an NCCL
+reduce-scatter sums the gradients into the shard of every device in place,
+and an allgather of the rows of the flat params into the matrices gathers
+the updated shards.
+
+It copies nothing and can run every iteration, to order the ops on the
+views after the ops on the buffer. The views do not own the memory.
+)DOC")
+    .Arg("num_shards", "the number of rows, default 1")
+    .Arg("shard_id", "the row of the second output, default 0")
+    .Input(0, "buffer", "The flat buffer")
+    .Output(0, "shards", "The buffer as num_shards rows")
+    .Output(1, "shard", "The row shard_id");
+
+OPERATOR_SCHEMA(FlatBufferSlices)
+    .NumInputs(1)
+    .NumOutputs(1, INT_MAX)
+    .SetDoc(R"DOC(
+Outputs 1-D views of the items [starts[i], starts[i] + lengths[i]) of the
+flat buffer, the input, e.g. the parts of the params in a shard of a flat
+buffer of params (see FlatBufferShards), for multi-tensor updates of the
+shard. It copies nothing; the views do not own the memory.
+)DOC")
+    .Arg("starts", "the first item of every view")
+    .Arg("lengths", "the number of items of every view")
+    .Input(0, "buffer", "The flat buffer")
+    .Output(0, "views", "One view per start and length");
+} // namespace caffe2
@@ -0,0 +1,286 @@
+#ifndef CAFFE2_OPERATORS_FLAT_BUFFER_OP_H_
+#define CAFFE2_OPERATORS_FLAT_BUFFER_OP_H_
+
+#include <memory>
+#include <vector>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// Every view of a flat buffer starts at a multiple of this many bytes.
+constexpr size_t kFlatBufferAlignment = 128;
+
+// The byte offsets of views of the given numbers of bytes, one after the
+// other in a flat buffer; the last offset is the size of the buffer.
+inline std::vector<size_t> FlatBufferOffsets(
+    const std::vector<size_t>& nbytes) {
+  std::vector<size_t> offsets(1, 0);
+  for (const size_t n : nbytes) {
+    const size_t end = offsets.back() + n;
+    offsets.push_back(
+        (end + kFlatBufferAlignment - 1) / kFlatBufferAlignment *
+        kFlatBufferAlignment);
+  }
+  return offsets;
+}
+
+// Allocates one flat buffer, its last output, for the first N outputs and
+// makes each of them a view into it with the shape of the matching input.
+// With copy (default), a view starts with the data of its input, so that
+// params can be moved into a buffer in place; otherwise the buffer is
+// zeroed, e.g. for the gradients of params, which are only written later.
+// The buffer is padded with zeros to a multiple of size_multiple items, e.g.
+// to split it into equal shards (see FlatBufferShards).
+//
+// The views and the buffer share the memory, which is freed with the last of
+// them. A view stays a view as long as its size and type do not change.
+template <class Context>
+class CreateFlatBufferOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  CreateFlatBufferOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        copy_(OperatorBase::GetSingleArgument<int>("copy", 1)),
+        size_multiple_(
+            OperatorBase::GetSingleArgument<int>("size_multiple", 1)) {
+    CAFFE_ENFORCE_GT(size_multiple_, 0);
+  }
+
+  bool RunOnDevice() override {
+    const int num_views = InputSize();
+    CAFFE_ENFORCE_EQ(OutputSize(), num_views + 1);
+    const auto& meta = Input(0).meta();
+    std::vector<size_t> nbytes;
+    for (int i = 0; i < num_views; ++i) {
+      CAFFE_ENFORCE(
+          Input(i).meta() == meta,
+          "All the views of a flat buffer should have the same type");
+      nbytes.push_back(Input(i).nbytes());
+    }
+    const auto offsets = FlatBufferOffsets(nbytes);
+    CAFFE_ENFORCE_EQ(offsets.back() % meta.itemsize(), 0);
+    const size_t multiple = size_multiple_ * meta.itemsize();
+    const size_t size = (offsets.back() + multiple - 1) / multiple * multiple;
+
+    auto ptr_and_deleter = Context::New(size);
+    std::shared_ptr<void> memory(
+        ptr_and_deleter.first, ptr_and_deleter.second);
+    char* base = static_cast<char*>(memory.get());
+    math::Set<char, Context>(size, 0, base, &context_);
+
+    for (int i = 0; i < num_views; ++i) {
+      // an output in place of its input is copied before it is replaced
+      const auto& X = Input(i);
+      if (copy_) {
+        context_.template CopyItems<Context, Context>(
+            meta, X.size(), X.raw_data(), base + offsets[i]);
+      }
+      const std::vector<TIndex> dims = X.dims();
+      auto* Y = Output(i);
+      Y->Resize(dims);
+      Y->ShareExternalPointer(
+          base + offsets[i], meta, nbytes[i], [memory](void*) {});
+    }
+    auto* buffer = Output(num_views);
+    buffer->Resize(size / meta.itemsize());
+    buffer->ShareExternalPointer(base, meta, 0, [memory](void*) {});
+    return true;
+  }
+
+ private:
+  bool copy_;
+  int size_multiple_;
+};
+
+// Enforces that the tensors are still the views of the flat buffer
+// CreateFlatBuffer made them, or, with starts, views at these item offsets
+// (see FlatBufferSlices).
+template <class Context>
+void CheckFlatBufferViews(
+    const Tensor<Context>& buffer,
+    const std::vector<const Tensor<Context>*>& views,
+    const std::vector<int64_t>& starts = std::vector<int64_t>()) {
+  std::vector<size_t> nbytes;
+  for (const auto* view : views) {
+    nbytes.push_back(view->nbytes());
+  }
+  auto offsets = FlatBufferOffsets(nbytes);
+  if (!starts.empty()) {
+    CAFFE_ENFORCE_EQ(starts.size(), views.size());
+    for (size_t i = 0; i < views.size(); ++i) {
+      offsets[i] = starts[i] * buffer.itemsize();
+      CAFFE_ENFORCE_LE(
+          offsets[i] + nbytes[i],
+          buffer.nbytes(),
+          "View ",
+          i,
+          " ends after the buffer");
+    }
+  } else {
+    CAFFE_ENFORCE_LE(
+        offsets.back(), buffer.nbytes(), "The views do not fit the buffer");
+  }
+  const char* base = static_cast<const char*>(buffer.raw_data());
+  for (size_t i = 0; i < views.size(); ++i) {
+    CAFFE_ENFORCE(
+        views[i]->meta() == buffer.meta() &&
+            (views[i]->size() == 0 ||
+             views[i]->raw_data() == base + offsets[i]),
+        "View ",
+        i,
+        " is no longer in the flat buffer; it was reallocated");
+  }
+}
+
+// Outputs the flat buffer of its views, its last input, in place. It copies
+// nothing: it is the op that reads all the views, for the ops that use the
+// buffer to depend on the ops that write them, e.g. for the allreduce of
+// the flat gradients to run after the backward pass.
+template <class Context>
+class FlatBufferFromViewsOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  FlatBufferFromViewsOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        starts_(OperatorBase::GetRepeatedArgument<int64_t>("starts")) {
+    CAFFE_ENFORCE_EQ(
+        operator_def.input(operator_def.input_size() - 1),
+        operator_def.output(0),
+        "The buffer should be output in place");
+  }
+
+  bool RunOnDevice() override {
+    std::vector<const Tensor<Context>*> views;
+    for (int i = 0; i < InputSize() - 1; ++i) {
+      views.push_back(&Input(i));
+    }
+    CheckFlatBufferViews(Input(InputSize() - 1), views, starts_);
+    return true;
+  }
+
+ private:
+  std::vector<int64_t> starts_;
+};
+
+// Outputs the views of the flat buffer, its first input, in place. The
+// inverse of FlatBufferFromViews, for the ops that use the views to depend
+// on the ops that write the buffer.
+template <class Context>
+class FlatBufferToViewsOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  FlatBufferToViewsOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        starts_(OperatorBase::GetRepeatedArgument<int64_t>("starts")) {}
+
+  bool RunOnDevice() override {
+    std::vector<const Tensor<Context>*> views;
+    for (int i = 1; i < InputSize(); ++i) {
+      views.push_back(&Input(i));
+    }
+    CheckFlatBufferViews(Input(0), views, starts_);
+    return true;
+  }
+
+ private:
+  std::vector<int64_t> starts_;
+};
+
+// Makes view a tensor of the given dims on the memory at data. The view does
+// not own the memory: it is only valid as long as the buffer it points into.
+template <class Context>
+void ShareFlatBufferView(
+    const Tensor<Context>& buffer,
+    size_t offset,
+    const std::vector<TIndex>& dims,
+    Tensor<Context>* view) {
+  char* base =
+      static_cast<char*>(const_cast<void*>(buffer.raw_data())) + offset;
+  view->Resize(dims);
+  CAFFE_ENFORCE_LE(offset + view->size() * buffer.itemsize(), buffer.nbytes());
+  view->ShareExternalPointer(base, buffer.meta(), 0, [](void*) {});
+}
+
+// Outputs two views of the flat buffer, its input: the buffer as num_shards
+// rows of equal size, and the row shard_id. E.g. the NCCL reduce-scatter of
+// the first views of the gradients of all the devices sums the shards of
+// the devices into their second views, in place, and an allgather of the
+// updated shards of the params into the first views of the params makes
+// every device see all of them. It copies nothing, so it can run every
+// iteration to order the ops on the views after those on the buffer.
+template <class Context>
+class FlatBufferShardsOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  FlatBufferShardsOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        num_shards_(OperatorBase::GetSingleArgument<int>("num_shards", 1)),
+        shard_id_(OperatorBase::GetSingleArgument<int>("shard_id", 0)) {
+    CAFFE_ENFORCE_GT(num_shards_, 0);
+    CAFFE_ENFORCE(
+        shard_id_ >= 0 && shard_id_ < num_shards_,
+        "shard_id should be in [0, num_shards)");
+  }
+
+  bool RunOnDevice() override {
+    const auto& buffer = Input(0);
+    CAFFE_ENFORCE_EQ(
+        buffer.size() % num_shards_,
+        0,
+        "The buffer should be padded to a multiple of num_shards items, see "
+        "the size_multiple of CreateFlatBuffer");
+    const TIndex shard_size = buffer.size() / num_shards_;
+    ShareFlatBufferView(
+        buffer, 0, std::vector<TIndex>{num_shards_, shard_size}, Output(0));
+    ShareFlatBufferView(
+        buffer,
+        shard_id_ * shard_size * buffer.itemsize(),
+        std::vector<TIndex>{shard_size},
+        Output(1));
+    return true;
+  }
+
+ private:
+  int num_shards_;
+  int shard_id_;
+};
+
+// Outputs 1-D views of the items [starts[i], starts[i] + lengths[i]) of the
+// flat buffer, its input, e.g. of the params in a shard of the buffer. It
+// copies nothing.
+template <class Context>
+class FlatBufferSlicesOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  FlatBufferSlicesOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        starts_(OperatorBase::GetRepeatedArgument<int64_t>("starts")),
+        lengths_(OperatorBase::GetRepeatedArgument<int64_t>("lengths")) {
+    CAFFE_ENFORCE_EQ(starts_.size(), OutputSize());
+    CAFFE_ENFORCE_EQ(lengths_.size(), OutputSize());
+  }
+
+  bool RunOnDevice() override {
+    const auto& buffer = Input(0);
+    for (int i = 0; i < OutputSize(); ++i) {
+      CAFFE_ENFORCE(starts_[i] >= 0 && lengths_[i] >= 0);
+      ShareFlatBufferView(
+          buffer,
+          starts_[i] * buffer.itemsize(),
+          std::vector<TIndex>{lengths_[i]},
+          Output(i));
+    }
+    return true;
+  }
+
+ private:
+  std::vector<int64_t> starts_;
+  std::vector<int64_t> lengths_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_OPERATORS_FLAT_BUFFER_OP_H_
@@ -0,0 +1,10 @@
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/operators/flat_buffer_op.h"
+
+namespace caffe2 {
+REGISTER_CUDA_OPERATOR(CreateFlatBuffer, CreateFlatBufferOp<CUDAContext>);
+REGISTER_CUDA_OPERATOR(FlatBufferFromViews, FlatBufferFromViewsOp<CUDAContext>);
+REGISTER_CUDA_OPERATOR(FlatBufferToViews, FlatBufferToViewsOp<CUDAContext>);
+REGISTER_CUDA_OPERATOR(FlatBufferShards, FlatBufferShardsOp<CUDAContext>);
+REGISTER_CUDA_OPERATOR(FlatBufferSlices, FlatBufferSlicesOp<CUDAContext>);
+} // namespace caffe2
@@ -107,7 +107,15 @@ db specified by the arguments.
         "(list of strings) if set, used instead of original "
         "blob names. Must be the same length as number of blobs.")
     .Arg("db", "(string) the path to the db to load.")
-    .Arg("db_type", "(string) the type of the db.");
+    .Arg("db_type", "(string) the type of the db.")
+    .Arg(
+        "num_threads",
+        "(int, default 1) the number of threads serializing the blobs.")
+    .Arg(
+        "async_save",
+        "(bool, default false) if true, the tensors are copied to a cpu "
+        "snapshot and written in the background. The next run of the op (or "
+        "the destruction of the op) waits for the write to finish.");
 
 OPERATOR_SCHEMA(Checkpoint)
     .NumInputs(1, INT_MAX)
@@ -117,7 +125,9 @@ The Checkpoint operator is similar to the Save operator, but allows one to save
 to db every few iterations, with a db name that is appended with the iteration
 count. It takes [1, infinity) number of inputs and has no output. The first
 input has to be a TensorCPU of type int and has size 1 (i.e. the iteration
-counter). This is determined whether we need to do checkpointing.
+counter). This is determined whether we need to do checkpointing. It takes the
+arguments of the Save operator; with async_save, the write of a checkpoint
+goes on until the next checkpoint.
 )DOC")
     .Arg(
         "absolute_path",
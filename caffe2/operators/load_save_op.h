@@ -1,8 +1,11 @@
 #ifndef CAFFE2_OPERATORS_LOAD_SAVE_OP_H_
 #define CAFFE2_OPERATORS_LOAD_SAVE_OP_H_
 
+#include <atomic>
 #include <cstdio>
+#include <future>
 #include <map>
+#include <mutex>
 #include <unordered_set>
 
 #include "caffe2/core/blob_serialization.h"
@@ -418,8 +421,11 @@ class SaveOp final : public Operator<Context> {
         db_name_(OperatorBase::GetSingleArgument<string>("db", "")),
         db_type_(OperatorBase::GetSingleArgument<string>("db_type", "")),
         blob_names_(
-            OperatorBase::GetRepeatedArgument<string>("blob_name_overrides")) {
+            OperatorBase::GetRepeatedArgument<string>("blob_name_overrides")),
+        num_threads_(OperatorBase::GetSingleArgument<int>("num_threads", 1)),
+        async_(OperatorBase::GetSingleArgument<bool>("async_save", false)) {
     CAFFE_ENFORCE_GT(db_name_.size(), 0, "Must specify a db name.");
+    CAFFE_ENFORCE_GT(num_threads_, 0, "num_threads should be positive.");
     CAFFE_ENFORCE_GT(db_type_.size(), 0, "Must specify a db type.");
     CAFFE_ENFORCE(
         blob_names_.empty() ||
@@ -452,38 +458,124 @@ class SaveOp final : public Operator<Context> {
     }
   }
 
+  ~SaveOp() {
+    try {
+      WaitForPreviousSave();
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Saving " << db_name_ << " failed: " << e.what();
+    }
+  }
+
   bool RunOnDevice() override {
+    WaitForPreviousSave();
     string full_db_name =
         absolute_path_ ? db_name_ : (ws_->RootFolder() + "/" + db_name_);
+    const vector<const Blob*>& inputs = OperatorBase::Inputs();
+    if (!async_) {
+      Write(full_db_name, inputs, blob_names_, {});
+      return true;
+    }
+
+    // Copy the tensors to a cpu snapshot, so that the next iterations can
+    // update them while the snapshot is serialized and written; the other
+    // blobs are small and serialized right away.
+    auto snapshot = std::make_shared<std::vector<Blob>>(inputs.size());
+    auto serialized =
+        std::make_shared<std::vector<std::pair<string, string>>>();
+    auto snapshot_inputs = std::make_shared<std::vector<const Blob*>>();
+    auto snapshot_names = std::make_shared<std::vector<string>>();
+    for (int i = 0; i < inputs.size(); ++i) {
+      auto& blob = (*snapshot)[i];
+      if (inputs[i]->template IsType<Tensor<Context>>()) {
+        blob.template GetMutable<TensorCPU>()->CopyFrom(
+            inputs[i]->template Get<Tensor<Context>>(), &context_);
+      } else if (inputs[i]->template IsType<TensorCPU>()) {
+        blob.template GetMutable<TensorCPU>()->CopyFrom(
+            inputs[i]->template Get<TensorCPU>());
+      } else {
+        inputs[i]->Serialize(
+            blob_names_[i], [&](const string& name, const string& data) {
+              serialized->emplace_back(name, data);
+            });
+        continue;
+      }
+      snapshot_inputs->push_back(&blob);
+      snapshot_names->push_back(blob_names_[i]);
+    }
+    context_.FinishDeviceComputation();
+    pending_ = std::async(
+        std::launch::async,
+        [this,
+         full_db_name,
+         snapshot,
+         snapshot_inputs,
+         snapshot_names,
+         serialized]() {
+          Write(full_db_name, *snapshot_inputs, *snapshot_names, *serialized);
+        });
+    return true;
+  }
+
+ private:
+  // Rethrows the error of the previous asynchronous save, if any.
+  void WaitForPreviousSave() {
+    if (pending_.valid()) {
+      auto pending = std::move(pending_);
+      pending.get();
+    }
+  }
+
+  // Serializes the blobs with num_threads_ threads into a new db, after
+  // the entries that are already serialized.
+  void Write(
+      const string& full_db_name,
+      const vector<const Blob*>& blobs,
+      const std::vector<string>& names,
+      const std::vector<std::pair<string, string>>& serialized) {
     std::unique_ptr<DB> out_db(
         caffe2::db::CreateDB(db_type_, full_db_name, caffe2::db::NEW));
     CAFFE_ENFORCE(out_db.get(), "Cannot open db for writing: ", full_db_name);
 
+    std::mutex db_mutex;
     BlobSerializerBase::SerializationAcceptor acceptor = [&](
         const std::string& blobName, const std::string& data) {
-      // transaction should take care of locking
       VLOG(2) << "Sending " << blobName << " blob's data of size "
               << data.size() << " to db";
+      std::lock_guard<std::mutex> guard(db_mutex);
       auto transaction = out_db->NewTransaction();
       transaction->Put(blobName, data);
       transaction->Commit();
     };
+    for (const auto& entry : serialized) {
+      acceptor(entry.first, entry.second);
+    }
 
-    const vector<const Blob*>& inputs = OperatorBase::Inputs();
-    for (int i = 0; i < inputs.size(); ++i) {
-      inputs[i]->Serialize(blob_names_[i], acceptor);
+    std::atomic<int> next(0);
+    auto serialize = [&]() {
+      for (int i = next++; i < blobs.size(); i = next++) {
+        blobs[i]->Serialize(names[i], acceptor);
+      }
+    };
+    std::vector<std::future<void>> workers;
+    for (int i = 1; i < std::min<int>(num_threads_, blobs.size()); ++i) {
+      workers.emplace_back(std::async(std::launch::async, serialize));
+    }
+    serialize();
+    for (auto& worker : workers) {
+      worker.get();
     }
     out_db->Close();
-    return true;
   }
 
- private:
   Workspace* ws_;
   bool absolute_path_;
   string strip_prefix_;
   string db_name_;
   string db_type_;
   std::vector<std::string> blob_names_;
+  int num_threads_;
+  bool async_;
+  std::future<void> pending_;
 };
 
 template <typename... Ts>
@@ -540,8 +632,10 @@ class CheckpointOp final : public Operator<Context> {
     if (iter % every_ == 0) {
       GetMutableArgument("db", true, &save_op_def_)
           ->set_s(FormatString(db_pattern_, iter));
-      SaveOp<Context> sub_op(save_op_def_, ws_);
-      return sub_op.Run();
+      // an async save of the previous checkpoint finishes when its op is
+      // replaced
+      save_op_.reset(new SaveOp<Context>(save_op_def_, ws_));
+      return save_op_->Run();
     } else {
       return true;
     }
@@ -552,6 +646,7 @@ class CheckpointOp final : public Operator<Context> {
   int every_;
   Workspace* ws_;
   OperatorDef save_op_def_;
+  std::unique_ptr<SaveOp<Context>> save_op_;
 };
 
 } // namespace caffe2
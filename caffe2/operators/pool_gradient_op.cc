@@ -318,42 +318,74 @@ bool PoolGradientOp<T, Context, PoolType>::RunOnDeviceWithOrderNHWC() {
 REGISTER_CPU_OPERATOR(
     AveragePoolGradient,
     PoolGradientOp<float, CPUContext, AveragePool<float>>);
-OPERATOR_SCHEMA(AveragePoolGradient).NumInputs(3).NumOutputs(1);
+OPERATOR_SCHEMA(AveragePoolGradient)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPoolGradient));
 
 REGISTER_CPU_OPERATOR(
     AveragePool1DGradient,
     PoolGradientOp<float, CPUContext, AveragePool<float>>);
-OPERATOR_SCHEMA(AveragePool1DGradient).NumInputs(3).NumOutputs(1);
+OPERATOR_SCHEMA(AveragePool1DGradient)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPoolGradient));
 
 REGISTER_CPU_OPERATOR(
     AveragePool2DGradient,
     PoolGradientOp<float, CPUContext, AveragePool<float>>);
-OPERATOR_SCHEMA(AveragePool2DGradient).NumInputs(3).NumOutputs(1);
+OPERATOR_SCHEMA(AveragePool2DGradient)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPoolGradient));
 
 REGISTER_CPU_OPERATOR(
     AveragePool3DGradient,
     PoolGradientOp<float, CPUContext, AveragePool<float>>);
-OPERATOR_SCHEMA(AveragePool3DGradient).NumInputs(3).NumOutputs(1);
+OPERATOR_SCHEMA(AveragePool3DGradient)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPoolGradient));
 
 REGISTER_CPU_OPERATOR(
     MaxPoolGradient,
     PoolGradientOp<float, CPUContext, MaxPool<float>>);
-OPERATOR_SCHEMA(MaxPoolGradient).NumInputs(3).NumOutputs(1);
+OPERATOR_SCHEMA(MaxPoolGradient)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPoolGradient));
 
 REGISTER_CPU_OPERATOR(
     MaxPool1DGradient,
     PoolGradientOp<float, CPUContext, MaxPool<float>>);
-OPERATOR_SCHEMA(MaxPool1DGradient).NumInputs(3).NumOutputs(1);
+OPERATOR_SCHEMA(MaxPool1DGradient)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPoolGradient));
 
 REGISTER_CPU_OPERATOR(
     MaxPool2DGradient,
     PoolGradientOp<float, CPUContext, MaxPool<float>>);
-OPERATOR_SCHEMA(MaxPool2DGradient).NumInputs(3).NumOutputs(1);
+OPERATOR_SCHEMA(MaxPool2DGradient)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPoolGradient));
 
 REGISTER_CPU_OPERATOR(
     MaxPool3DGradient,
     PoolGradientOp<float, CPUContext, MaxPool<float>>);
-OPERATOR_SCHEMA(MaxPool3DGradient).NumInputs(3).NumOutputs(1);
+OPERATOR_SCHEMA(MaxPool3DGradient)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPoolGradient));
 
 class GetPoolGradient : public GradientMakerBase {
   using GradientMakerBase::GradientMakerBase;
@@ -1,6 +1,7 @@
 // TODO(ataei): reduce the apparent redundancy of all the code below.
 #include "caffe2/operators/pool_op.h"
 #include "caffe2/utils/cpu_neon.h"
+#include "caffe2/utils/parallel_for.h"
 
 namespace caffe2 {
 
@@ -303,8 +304,213 @@ void runNeonMaxPool2x2p0s0NCHW(
     }
   }
 }
+
+// y += x and y = max(y, x) over rows of n floats, the inner loops of the
+// separable 3D pooling below
+void sumRowNeon(const float* x, const int n, float* y) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    vst1q_f32(y + i, vaddq_f32(vld1q_f32(y + i), vld1q_f32(x + i)));
+    vst1q_f32(y + i + 4, vaddq_f32(vld1q_f32(y + i + 4), vld1q_f32(x + i + 4)));
+  }
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(y + i, vaddq_f32(vld1q_f32(y + i), vld1q_f32(x + i)));
+  }
+  for (; i < n; ++i) {
+    y[i] += x[i];
+  }
+}
+
+void maxRowNeon(const float* x, const int n, float* y) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    vst1q_f32(y + i, vmaxq_f32(vld1q_f32(y + i), vld1q_f32(x + i)));
+    vst1q_f32(y + i + 4, vmaxq_f32(vld1q_f32(y + i + 4), vld1q_f32(x + i + 4)));
+  }
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(y + i, vmaxq_f32(vld1q_f32(y + i), vld1q_f32(x + i)));
+  }
+  for (; i < n; ++i) {
+    y[i] = std::max(y[i], x[i]);
+  }
+}
 #endif // __ARM_NEON__
 
+// The [start, end) input range of every output position along one axis of
+// a pooling window, clipped to the input.
+struct PoolRanges {
+  std::vector<int> start;
+  std::vector<int> end;
+};
+
+PoolRanges ComputePoolRanges(
+    const int input_size,
+    const int output_size,
+    const int kernel,
+    const int stride,
+    const int pad) {
+  PoolRanges ranges;
+  ranges.start.resize(output_size);
+  ranges.end.resize(output_size);
+  for (int i = 0; i < output_size; ++i) {
+    const int start = i * stride - pad;
+    ranges.start[i] = max(start, 0);
+    ranges.end[i] = min(start + kernel, input_size);
+  }
+  return ranges;
+}
+
+bool IsIdentityPool(const PoolRanges& ranges, const int input_size) {
+  if (ranges.start.size() != input_size) {
+    return false;
+  }
+  for (int i = 0; i < input_size; ++i) {
+    if (ranges.start[i] != i || ranges.end[i] != i + 1) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Pools X of outer x input_size x inner along its middle axis into Y of
+// outer x output_size x inner, without finalizing. The inner loops run over
+// contiguous rows of inner elements.
+template <typename T, typename PoolType>
+void PoolAlongAxis(
+    const T* X,
+    const int outer,
+    const int input_size,
+    const int inner,
+    const PoolRanges& ranges,
+    T* Y) {
+  const int output_size = ranges.start.size();
+  for (int o = 0; o < outer; ++o) {
+    const T* x = X + o * input_size * inner;
+    for (int p = 0; p < output_size; ++p) {
+      T* y = Y + (o * output_size + p) * inner;
+      for (int i = 0; i < inner; ++i) {
+        y[i] = PoolType::initialize();
+      }
+      for (int l = ranges.start[p]; l < ranges.end[p]; ++l) {
+        PoolType::processRow(x + l * inner, inner, y);
+      }
+    }
+  }
+}
+
+// 3D pooling of the N x C planes of an NCHW tensor. Max and average pooling
+// are separable, so every plane is pooled along its innermost axis, then
+// the middle one and then the outer one, which costs kT + kH + kW instead of
+// kT * kH * kW per output; axes pooled with 1 / 1 windows are skipped and
+// planes fully covered by the window reduce in one pass.
+template <typename T, typename PoolType>
+void RunPool3dNCHW(
+    const int planes,
+    const int* input_dims,
+    const int* output_dims,
+    const int* kernel,
+    const int* stride,
+    const int* pad,
+    const T* X,
+    T* Y) {
+  const int input_plane = input_dims[0] * input_dims[1] * input_dims[2];
+  const int output_plane = output_dims[0] * output_dims[1] * output_dims[2];
+  PoolRanges ranges[3];
+  for (int i = 0; i < 3; ++i) {
+    ranges[i] = ComputePoolRanges(
+        input_dims[i], output_dims[i], kernel[i], stride[i], pad[i]);
+  }
+
+  if (output_plane == 1 && ranges[0].start[0] == 0 &&
+      ranges[0].end[0] == input_dims[0] && ranges[1].start[0] == 0 &&
+      ranges[1].end[0] == input_dims[1] && ranges[2].start[0] == 0 &&
+      ranges[2].end[0] == input_dims[2]) {
+    // global pooling, e.g. pool5 over T x 7 x 7
+    ParallelFor(
+        planes,
+        ParallelForGrainSize(input_plane),
+        [&](int64_t begin, int64_t end) {
+          for (int plane = begin; plane < end; ++plane) {
+            const T* x = X + plane * input_plane;
+            T y = PoolType::initialize();
+            for (int i = 0; i < input_plane; ++i) {
+              PoolType::process(x[i], y);
+            }
+            PoolType::finalize(input_plane, y);
+            Y[plane] = y;
+          }
+        });
+    return;
+  }
+
+  bool identity[3];
+  for (int i = 0; i < 3; ++i) {
+    identity[i] = IsIdentityPool(ranges[i], input_dims[i]);
+  }
+  // the window size of every output position, as the product of the sizes
+  // along the axes
+  std::vector<int> counts(output_plane);
+  for (int i0 = 0, index = 0; i0 < output_dims[0]; ++i0) {
+    for (int i1 = 0; i1 < output_dims[1]; ++i1) {
+      for (int i2 = 0; i2 < output_dims[2]; ++i2, ++index) {
+        counts[index] = (ranges[0].end[i0] - ranges[0].start[i0]) *
+            (ranges[1].end[i1] - ranges[1].start[i1]) *
+            (ranges[2].end[i2] - ranges[2].start[i2]);
+      }
+    }
+  }
+
+  ParallelFor(
+      planes,
+      ParallelForGrainSize(input_plane),
+      [&](int64_t begin, int64_t end) {
+        // X pooled along the innermost axis, then along the middle one, per
+        // chunk
+        std::vector<T> pooled2(
+            input_dims[0] * input_dims[1] * output_dims[2]);
+        std::vector<T> pooled1(
+            input_dims[0] * output_dims[1] * output_dims[2]);
+        for (int plane = begin; plane < end; ++plane) {
+          const T* x = X + plane * input_plane;
+          T* y = Y + plane * output_plane;
+          if (!identity[2]) {
+            PoolAlongAxis<T, PoolType>(
+                x,
+                input_dims[0] * input_dims[1],
+                input_dims[2],
+                1,
+                ranges[2],
+                pooled2.data());
+            x = pooled2.data();
+          }
+          if (!identity[1]) {
+            PoolAlongAxis<T, PoolType>(
+                x,
+                input_dims[0],
+                input_dims[1],
+                output_dims[2],
+                ranges[1],
+                identity[0] ? y : pooled1.data());
+            x = identity[0] ? y : pooled1.data();
+          }
+          if (!identity[0]) {
+            PoolAlongAxis<T, PoolType>(
+                x,
+                1,
+                input_dims[0],
+                output_dims[1] * output_dims[2],
+                ranges[0],
+                y);
+          } else if (x != y) {
+            std::copy(x, x + output_plane, y);
+          }
+          for (int i = 0; i < output_plane; ++i) {
+            PoolType::finalize(counts[i], y[i]);
+          }
+        }
+      });
+}
+
 } // namespace
 
 template <typename T>
@@ -326,6 +532,16 @@ class AveragePool {
     y_data += x_data;
   }
 
+  static void processRow(const T* x_data, const int n, T* y_data) {
+#ifdef __ARM_NEON__
+    sumRowNeon(x_data, n, y_data);
+#else
+    for (int i = 0; i < n; ++i) {
+      y_data[i] += x_data[i];
+    }
+#endif
+  }
+
   static void finalize(const int size, T& y_data) {
     y_data /= size;
   }
@@ -420,6 +636,16 @@ class MaxPool {
     }
   }
 
+  static void processRow(const T* x_data, const int n, T* y_data) {
+#ifdef __ARM_NEON__
+    maxRowNeon(x_data, n, y_data);
+#else
+    for (int i = 0; i < n; ++i) {
+      process(x_data[i], y_data[i]);
+    }
+#endif
+  }
+
   static void finalize(const int /*size*/, T& /*y_data*/) {}
 
   static void finalize(
@@ -582,44 +808,20 @@ bool PoolOp<T, Context, PoolType>::RunOnDeviceWithOrderNCHW() {
         }
       }
       break;
-    case 3:
-      for (int n = 0; n < X.dim32(0); ++n) {
-        for (int c = 0; c < channels; ++c) {
-          for (int ph = 0; ph < pooled_height; ++ph) {
-            int hstart = ph * stride_h() - pad_t();
-            int hend = min(hstart + kernel_h(), height);
-            hstart = max(hstart, 0);
-            for (int pw = 0; pw < pooled_width; ++pw) {
-              int wstart = pw * stride_w() - pad_l();
-              int wend = min(wstart + kernel_w(), width);
-              wstart = max(wstart, 0);
-              for (int pd = 0; pd < pooled_depth; ++pd) {
-                int dstart = pd * stride_[2] - pads_[2];
-                int dend = min(dstart + kernel_[2], depth);
-                dstart = max(dstart, 0);
-                const int pool_index =
-                    ph * pooled_width * pooled_depth + pw * pooled_depth + pd;
-                T Yh = PoolType::initialize();
-                for (int h = hstart; h < hend; ++h) {
-                  for (int w = wstart; w < wend; ++w) {
-                    for (int d = dstart; d < dend; ++d) {
-                      const int input_index = h * width * depth + w * depth + d;
-                      PoolType::process(Xdata[input_index], Yh);
-                    }
-                  }
-                }
-                PoolType::finalize(
-                    (hend - hstart) * (wend - wstart) * (dend - dstart), Yh);
-                Ydata[pool_index] = Yh;
-              }
-            }
-          }
-          // Do offset.
-          Xdata += height * width * depth;
-          Ydata += pooled_height * pooled_width * pooled_depth;
-        }
-      }
+    case 3: {
+      const int input_dims[3] = {height, width, depth};
+      const int output_dims[3] = {pooled_height, pooled_width, pooled_depth};
+      RunPool3dNCHW<T, PoolType>(
+          X.dim32(0) * channels,
+          input_dims,
+          output_dims,
+          kernel_.data(),
+          stride_.data(),
+          pads_.data(),
+          Xdata,
+          Ydata);
       break;
+    }
     default:
       CAFFE_THROW("Unsupported pooling size : ", kernel_.size());
       return false;
@@ -798,6 +1000,8 @@ OPERATOR_SCHEMA(AveragePool)
     .NumInputs(1)
     .NumOutputs(1)
     .TensorInferenceFunction(ConvPoolOpBase<CPUContext>::TensorInferenceForPool)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPool))
     .FillUsing(AveragePoolDocGenerator(""))
     .InheritOnnxSchema("AveragePool");
 
@@ -809,6 +1013,8 @@ OPERATOR_SCHEMA(AveragePool1D)
     .NumInputs(1)
     .NumOutputs(1)
     .TensorInferenceFunction(ConvPoolOpBase<CPUContext>::TensorInferenceForPool)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPool))
     .FillUsing(AveragePoolDocGenerator("1D"))
     .InheritOnnxSchema("AveragePool");
 
@@ -820,6 +1026,8 @@ OPERATOR_SCHEMA(AveragePool2D)
     .NumInputs(1)
     .NumOutputs(1)
     .TensorInferenceFunction(ConvPoolOpBase<CPUContext>::TensorInferenceForPool)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPool))
     .FillUsing(AveragePoolDocGenerator("2D"))
     .InheritOnnxSchema("AveragePool");
 
@@ -831,6 +1039,8 @@ OPERATOR_SCHEMA(AveragePool3D)
     .NumInputs(1)
     .NumOutputs(1)
     .TensorInferenceFunction(ConvPoolOpBase<CPUContext>::TensorInferenceForPool)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPool))
     .FillUsing(AveragePoolDocGenerator("3D"))
     .InheritOnnxSchema("AveragePool");
 
@@ -840,6 +1050,8 @@ OPERATOR_SCHEMA(MaxPool)
     .NumInputs(1)
     .NumOutputs(1)
     .TensorInferenceFunction(ConvPoolOpBase<CPUContext>::TensorInferenceForPool)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPool))
     .FillUsing(MaxPoolDocGenerator(""))
     .InheritOnnxSchema("MaxPool");
 
@@ -849,6 +1061,8 @@ OPERATOR_SCHEMA(MaxPool1D)
     .NumInputs(1)
     .NumOutputs(1)
     .TensorInferenceFunction(ConvPoolOpBase<CPUContext>::TensorInferenceForPool)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPool))
     .FillUsing(MaxPoolDocGenerator("1D"))
     .InheritOnnxSchema("MaxPool");
 
@@ -858,6 +1072,8 @@ OPERATOR_SCHEMA(MaxPool2D)
     .NumInputs(1)
     .NumOutputs(1)
     .TensorInferenceFunction(ConvPoolOpBase<CPUContext>::TensorInferenceForPool)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPool))
     .FillUsing(MaxPoolDocGenerator("2D"))
     .InheritOnnxSchema("MaxPool");
 
@@ -867,6 +1083,8 @@ OPERATOR_SCHEMA(MaxPool3D)
     .NumInputs(1)
     .NumOutputs(1)
     .TensorInferenceFunction(ConvPoolOpBase<CPUContext>::TensorInferenceForPool)
+    .CostInferenceFunction(OpSchema::CostInferenceFunctionType(
+        ConvPoolOpBase<CPUContext>::CostInferenceForPool))
     .FillUsing(MaxPoolDocGenerator("3D"))
     .InheritOnnxSchema("MaxPool");
 } // namespace caffe2
@@ -1,5 +1,6 @@
 #include "caffe2/core/context_gpu.h"
 #include "caffe2/core/cudnn_wrappers.h"
+#include "caffe2/operators/conv_op_cache_cudnn.h"
 #include "caffe2/operators/conv_pool_op_base.h"
 
 #include <cub/cub.cuh>
@@ -106,16 +107,33 @@ void setTensorDescriptor(
   }
 }
 
+// the descriptors of an input shape, see caffe2_cudnn_shape_cache_size
+struct PoolDescriptors {
+  PoolDescriptors() {
+    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&bottom_desc));
+    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&top_desc));
+    CUDNN_ENFORCE(cudnnCreatePoolingDescriptor(&pooling_desc));
+  }
+
+  ~PoolDescriptors() {
+    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(bottom_desc));
+    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(top_desc));
+    CUDNN_ENFORCE(cudnnDestroyPoolingDescriptor(pooling_desc));
+  }
+
+  cudnnTensorDescriptor_t bottom_desc;
+  cudnnTensorDescriptor_t top_desc;
+  cudnnPoolingDescriptor_t pooling_desc;
+};
+
 } // namespace
 
 class CuDNNPoolOp : public ConvPoolOpBase<CUDAContext> {
  public:
   CuDNNPoolOp(const OperatorDef& operator_def, Workspace* ws)
       : ConvPoolOpBase<CUDAContext>(operator_def, ws),
-        cudnn_wrapper_(&context_) {
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&bottom_desc_));
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&top_desc_));
-    CUDNN_ENFORCE(cudnnCreatePoolingDescriptor(&pooling_desc_));
+        cudnn_wrapper_(&context_),
+        descriptor_cache_(FLAGS_caffe2_cudnn_shape_cache_size) {
     OPERATOR_NEEDS_FEATURE(kernel_.size() >=2 && kernel_.size() <=3,
         "Cudnn pooling only supports 4d and 5d tensor");
     if (legacy_pad_ != LegacyPadding::CAFFE_LEGACY_POOLING) {
@@ -143,11 +161,7 @@ class CuDNNPoolOp : public ConvPoolOpBase<CUDAContext> {
     }
   }
 
-  ~CuDNNPoolOp() {
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(bottom_desc_));
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(top_desc_));
-    CUDNN_ENFORCE(cudnnDestroyPoolingDescriptor(pooling_desc_));
-  }
+  ~CuDNNPoolOp() {}
 
   template <typename T, typename M>
   bool DoRunWithType() {
@@ -211,10 +225,14 @@ class CuDNNPoolOp : public ConvPoolOpBase<CUDAContext> {
       }
     }
 
-    if (cudnn_input_dims_ != X.dims()) {
-      // Dimensions changed; we will need to re-initialize things.
-      VLOG(1) << "Changing the cudnn descriptor configurations.";
-      cudnn_input_dims_ = X.dims();
+    bool created = false;
+    PoolDescriptors* descs = descriptor_cache_.Lookup(X.dims(), &created);
+    bottom_desc_ = descs->bottom_desc;
+    top_desc_ = descs->top_desc;
+    pooling_desc_ = descs->pooling_desc;
+    if (created) {
+      // New dimensions; we will need to initialize things.
+      VLOG(1) << "Setting up the cudnn descriptors of a new shape.";
       setTensorDescriptor<T>(X.ndim(), order_, N, C, H, W, D, bottom_desc_);
       setTensorDescriptor<T>(
           Y->ndim(), order_, N, C, H_out, W_out, D_out, top_desc_);
@@ -279,9 +297,9 @@ class CuDNNPoolOp : public ConvPoolOpBase<CUDAContext> {
   }
 
  protected:
-  vector<TIndex> cudnn_input_dims_;
-
   CuDNNWrapper cudnn_wrapper_;
+  ShapeCache<PoolDescriptors> descriptor_cache_;
+  // the descriptors of the current shape, owned by descriptor_cache_
   cudnnTensorDescriptor_t bottom_desc_;
   cudnnTensorDescriptor_t top_desc_;
   cudnnPoolingDescriptor_t pooling_desc_;
@@ -294,10 +312,8 @@ class CuDNNPoolGradientOp : public ConvPoolOpBase<CUDAContext> {
  public:
   CuDNNPoolGradientOp(const OperatorDef& operator_def, Workspace* ws)
       : ConvPoolOpBase<CUDAContext>(operator_def, ws),
-        cudnn_wrapper_(&context_) {
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&bottom_desc_));
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&top_desc_));
-    CUDNN_ENFORCE(cudnnCreatePoolingDescriptor(&pooling_desc_));
+        cudnn_wrapper_(&context_),
+        descriptor_cache_(FLAGS_caffe2_cudnn_shape_cache_size) {
     // Figure out the pooling descriptor.
     if (operator_def.type() == "MaxPoolGradient" ||
         operator_def.type() == "MaxPool1DGradient" ||
@@ -322,11 +338,7 @@ class CuDNNPoolGradientOp : public ConvPoolOpBase<CUDAContext> {
     }
   }
 
-  ~CuDNNPoolGradientOp() {
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(bottom_desc_));
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(top_desc_));
-    CUDNN_ENFORCE(cudnnDestroyPoolingDescriptor(pooling_desc_));
-  }
+  ~CuDNNPoolGradientOp() {}
 
   template <typename T, typename M>
   bool DoRunWithType() {
@@ -414,10 +426,14 @@ class CuDNNPoolGradientOp : public ConvPoolOpBase<CUDAContext> {
       CAFFE_THROW("Unsupported kernel size :", kernel_.size());
     }
 
-    if (cudnn_input_dims_ != X.dims()) {
-      // Dimensions changed; we will need to re-initialize things.
-      VLOG(1) << "Changing the cudnn descriptor configurations.";
-      cudnn_input_dims_ = X.dims();
+    bool created = false;
+    PoolDescriptors* descs = descriptor_cache_.Lookup(X.dims(), &created);
+    bottom_desc_ = descs->bottom_desc;
+    top_desc_ = descs->top_desc;
+    pooling_desc_ = descs->pooling_desc;
+    if (created) {
+      // New dimensions; we will need to initialize things.
+      VLOG(1) << "Setting up the cudnn descriptors of a new shape.";
       setTensorDescriptor<T>(X.ndim(), order_, N, C, H, W, D, bottom_desc_);
       setTensorDescriptor<T>(
           Y.ndim(), order_, N, C, H_out, W_out, D_out, top_desc_);
@@ -492,9 +508,9 @@ class CuDNNPoolGradientOp : public ConvPoolOpBase<CUDAContext> {
   }
 
  protected:
-  vector<TIndex> cudnn_input_dims_;
-
   CuDNNWrapper cudnn_wrapper_;
+  ShapeCache<PoolDescriptors> descriptor_cache_;
+  // the descriptors of the current shape, owned by descriptor_cache_
   cudnnTensorDescriptor_t bottom_desc_;
   cudnnTensorDescriptor_t top_desc_;
   cudnnPoolingDescriptor_t pooling_desc_;
@@ -2,11 +2,15 @@
 #define CAFFE2_OPERATORS_PREFETCH_OP_H_
 
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <thread> // NOLINT
+#include <vector>
 
 #include "caffe2/core/context.h"
 #include "caffe2/core/operator.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/utils/timeline.h"
 
 namespace caffe2 {
 
@@ -17,21 +21,124 @@ namespace caffe2 {
 // For any operator that is derived from PrefetchOperator, it should
 // explicitly call the Finalize() function in its destructor, so that the
 // prefetching thread is properly destructed.
+//
+// The prefetching thread can run up to prefetch_depth batches ahead of the
+// operator. The batches live in a ring of prefetch_depth slots: Prefetch()
+// fills slot prefetch_slot_ and CopyPrefetched() consumes slot copy_slot_,
+// so a derived class that keeps its prefetched data per slot can run with
+// prefetch_depth > 1. The default depth of 1 keeps a single slot.
+//
+// With zero_copy_output, OutputPrefetched() hands the prefetched tensors
+// over to the outputs instead of copying them, see PrefetchBufferPool.
+
+// The time a PrefetchOperator run spends waiting for its prefetching thread,
+// i.e. the time the net is stalled on the input. PrefetchWaitObserver reads
+// it to report how input bound a net is. With no_prefetch the whole
+// Prefetch() is waited for.
+class PrefetchWaitCounter {
+ public:
+  virtual ~PrefetchWaitCounter() {}
+
+  float last_wait_ms() const {
+    return last_wait_ms_;
+  }
+  double total_wait_ms() const {
+    return total_wait_ms_;
+  }
+  int64_t num_waits() const {
+    return num_waits_;
+  }
+
+ protected:
+  void AddWait(const float ms) {
+    last_wait_ms_ = ms;
+    total_wait_ms_ += ms;
+    ++num_waits_;
+  }
+
+ private:
+  float last_wait_ms_ = 0;
+  double total_wait_ms_ = 0;
+  int64_t num_waits_ = 0;
+};
+
+// The buffers of the tensors prefetched for one output, for handing a batch
+// over without a copy: HandOff() makes the output share the buffer of the
+// prefetched tensor through ShareExternalPointer(), with a deleter that
+// returns the buffer to the pool once the output, and every tensor sharing
+// its data, lets go of it. The prefetched tensor takes a free buffer of the
+// pool in exchange, which the prefetching thread fills with a later batch.
+// The pool grows to the number of buffers that are out at once, one per
+// slot and one or two per output.
+//
+// A released buffer is only refilled after the batch that released it has
+// been copied out and Run() has finished the device computation of the
+// operator, so the work reading it on the stream of the net is done.
+template <class Context>
+class PrefetchBufferPool {
+ public:
+  PrefetchBufferPool() : free_(std::make_shared<FreeBuffers>()) {}
+
+  void HandOff(Tensor<Context>* prefetched, Tensor<Context>* output) {
+    std::unique_ptr<Tensor<Context>> buffer;
+    {
+      std::lock_guard<std::mutex> lock(free_->mutex);
+      if (!free_->buffers.empty()) {
+        buffer = std::move(free_->buffers.back());
+        free_->buffers.pop_back();
+      }
+    }
+    if (!buffer) {
+      buffer.reset(new Tensor<Context>());
+    }
+    buffer->swap(*prefetched);
+    // the deleter owns the buffer while the output shares it, and may run
+    // after the operator is gone
+    Tensor<Context>* shared = buffer.release();
+    std::weak_ptr<FreeBuffers> pool = free_;
+    output->Resize(shared->dims());
+    output->ShareExternalPointer(
+        shared->raw_mutable_data(shared->meta()),
+        shared->meta(),
+        shared->nbytes(),
+        [pool, shared](void* /* unused */) {
+          std::unique_ptr<Tensor<Context>> buffer(shared);
+          if (auto free = pool.lock()) {
+            std::lock_guard<std::mutex> lock(free->mutex);
+            free->buffers.push_back(std::move(buffer));
+          }
+        });
+  }
+
+ private:
+  struct FreeBuffers {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Tensor<Context>>> buffers;
+  };
+  std::shared_ptr<FreeBuffers> free_;
+};
 
 // Note: We inherit from OperatorBase since we control the
 // synchronization properties of this operator ourselves (we inform
 // the waiting producer after we synchronize). This is a special-case
 // - you should generally inherit from Operator<Context> directly.
 template <class Context>
-class PrefetchOperator : public OperatorBase {
+class PrefetchOperator : public OperatorBase, public PrefetchWaitCounter {
  public:
   PrefetchOperator(const OperatorDef& operator_def, Workspace* ws)
       : OperatorBase(operator_def, ws),
         context_(operator_def.device_option()),
-        prefetched_(false),
-        prefetch_success_(true),
+        prefetch_depth_(GetSingleArgument<int>("prefetch_depth", 1)),
+        prefetch_limit_(prefetch_depth_),
+        prefetch_slot_(0),
+        copy_slot_(0),
+        num_prefetched_(0),
+        prefetch_success_(prefetch_depth_, true),
         finalize_(false),
-        no_prefetch_(GetSingleArgument<bool>("no_prefetch", false)) {
+        no_prefetch_(GetSingleArgument<bool>("no_prefetch", false)),
+        zero_copy_output_(GetSingleArgument<bool>("zero_copy_output", false)),
+        output_pools_(OutputSize()) {
+    CAFFE_ENFORCE_GE(prefetch_depth_, 1, "prefetch_depth must be positive.");
     context_.SwitchToDevice(0);
   }
 
@@ -45,11 +152,10 @@ class PrefetchOperator : public OperatorBase {
   void Finalize() {
     if (prefetch_thread_.get()) {
       {
+        // The prefetching thread finishes the batch it is working on, if
+        // any, and quits instead of starting another one.
         std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
-        while (!prefetched_)
-          consumer_.wait(lock);
         finalize_ = true;
-        prefetched_ = false;
       }
       producer_.notify_one();
       prefetch_thread_->join();
@@ -64,7 +170,14 @@ class PrefetchOperator : public OperatorBase {
   bool Run(int /* unused */ /*stream_id*/) override {
     if (no_prefetch_) {
       context_.SwitchToDevice(0);
-      bool result = Prefetch() && CopyPrefetched();
+      Timer timer;
+      bool result;
+      {
+        TimelineScope span("input", "prefetch wait");
+        result = Prefetch();
+      }
+      AddWait(timer.MilliSeconds());
+      result = result && CopyPrefetched();
       context_.FinishDeviceComputation();
       return result;
     }
@@ -76,10 +189,23 @@ class PrefetchOperator : public OperatorBase {
           new std::thread([this] { this->PrefetchWorker(); }));
     }
     context_.SwitchToDevice(0);
-    std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
-    while (!prefetched_)
-      consumer_.wait(lock);
-    if (!prefetch_success_) {
+    bool success;
+    {
+      TimelineScope span("input", "prefetch wait");
+      Timer timer;
+      std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
+      while (num_prefetched_ == 0)
+        consumer_.wait(lock);
+      const float wait_ms = timer.MilliSeconds();
+      AddWait(wait_ms);
+      stall_ms_ += wait_ms;
+      // The flags of the slots share words of the vector, which the
+      // prefetching thread writes for the other slots, so the flag is read
+      // under the lock. The data of the slot at copy_slot_ is not touched by
+      // the prefetching thread until we release the slot below.
+      success = prefetch_success_[copy_slot_];
+    }
+    if (!success) {
       LOG(ERROR) << "Prefetching failed.";
       return false;
     }
@@ -87,33 +213,51 @@ class PrefetchOperator : public OperatorBase {
       LOG(ERROR) << "Error when copying prefetched data.";
       return false;
     }
-    prefetched_ = false;
     context_.FinishDeviceComputation();
+    {
+      std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
+      copy_slot_ = (copy_slot_ + 1) % prefetch_depth_;
+      --num_prefetched_;
+    }
     producer_.notify_one();
     return true;
   }
 
   void PrefetchWorker() {
     context_.SwitchToDevice();
-    std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
-    while (prefetched_)
-      producer_.wait(lock);
-    while (!finalize_) {
+    while (true) {
+      {
+        Timer timer;
+        std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
+        while (num_prefetched_ >= prefetch_limit_ && !finalize_)
+          producer_.wait(lock);
+        if (finalize_) {
+          return;
+        }
+        last_idle_ms_ = timer.MilliSeconds();
+        last_stall_ms_ = stall_ms_;
+        stall_ms_ = 0;
+      }
       // We will need to run a FinishDeviceComputation() call because the
       // prefetcher thread and the main thread are potentially using different
       // streams (like on GPU).
+      bool success = false;
       try {
-        prefetch_success_ = Prefetch();
+        TimelineScope span("input", "prefetch");
+        success = Prefetch();
         context_.FinishDeviceComputation();
       } catch (const std::exception& e) {
         // TODO: propagate exception_ptr to the caller side
         LOG(ERROR) << "Prefetching error " << e.what();
-        prefetch_success_ = false;
+        success = false;
+      }
+      {
+        std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
+        prefetch_success_[prefetch_slot_] = success;
+        prefetch_slot_ = (prefetch_slot_ + 1) % prefetch_depth_;
+        ++num_prefetched_;
       }
-      prefetched_ = true;
       consumer_.notify_one();
-      while (prefetched_)
-        producer_.wait(lock);
     }
   }
 
@@ -122,19 +266,75 @@ class PrefetchOperator : public OperatorBase {
   virtual bool CopyPrefetched() = 0;
 
  protected:
+  // Sets output i to the tensor prefetched for it. With zero_copy_output
+  // the output shares its buffer, and the tensor gets a buffer of the pool
+  // of the output to be filled next; otherwise it is copied.
+  void OutputPrefetched(const int i, Tensor<Context>* prefetched) {
+    auto* output = OperatorBase::Output<Tensor<Context>>(i);
+    if (zero_copy_output_ && prefetched->size() > 0) {
+      output_pools_[i].HandOff(prefetched, output);
+    } else {
+      output->CopyFrom(*prefetched, &context_);
+    }
+  }
+
+  // A tensor prefetched on another device is always copied.
+  template <class SrcContext>
+  void OutputPrefetched(const int i, Tensor<SrcContext>* prefetched) {
+    OperatorBase::Output<Tensor<Context>>(i)->CopyFrom(*prefetched, &context_);
+  }
+
+  // For Prefetch() on the prefetching thread: the time the operator waited
+  // for a batch since the previous Prefetch() started, and the time the
+  // prefetching thread waited for a free slot before this one. Both stay 0
+  // with no_prefetch.
+  float last_stall_ms() const {
+    return last_stall_ms_;
+  }
+  float last_idle_ms() const {
+    return last_idle_ms_;
+  }
+
+  // For Prefetch() on the prefetching thread: prefetch at most limit of the
+  // prefetch_depth_ slots ahead, from the next batch on.
+  void SetPrefetchLimit(const int limit) {
+    CAFFE_ENFORCE(limit >= 1 && limit <= prefetch_depth_);
+    std::unique_lock<std::mutex> lock(prefetch_access_mutex_);
+    prefetch_limit_ = limit;
+  }
+
   Context context_;
   std::mutex prefetch_access_mutex_;
   std::condition_variable producer_, consumer_;
-  // prefetched_ is used to tell the operator that it is done.
-  std::atomic<bool> prefetched_;
-  // prefetch_success_ is used to see if prefetching failed or not.
-  std::atomic<bool> prefetch_success_;
+  // Number of slots in the ring of prefetched batches.
+  const int prefetch_depth_;
+  // Number of slots the prefetching thread fills ahead, see
+  // SetPrefetchLimit().
+  int prefetch_limit_;
+  // prefetch_slot_ is the slot Prefetch() fills, copy_slot_ is the slot
+  // CopyPrefetched() reads. With no_prefetch both stay at 0.
+  int prefetch_slot_;
+  int copy_slot_;
+  // num_prefetched_ is the number of slots that are ready to be copied.
+  int num_prefetched_;
+  // prefetch_success_ is used to see if prefetching failed or not, per slot,
+  // under prefetch_access_mutex_.
+  vector<bool> prefetch_success_;
   // finalize_ is used to tell the prefetcher to quit.
   std::atomic<bool> finalize_;
   unique_ptr<std::thread> prefetch_thread_;
+  // The waits of the operator since the last batch was started, under
+  // prefetch_access_mutex_, and the ones Prefetch() sees.
+  float stall_ms_ = 0;
+  float last_stall_ms_ = 0;
+  float last_idle_ms_ = 0;
 
   // Whether to do prefetching or run this as a normal operator
   const bool no_prefetch_;
+  // Whether to hand the prefetched tensors over to the outputs instead of
+  // copying them, with one pool of buffers per output.
+  const bool zero_copy_output_;
+  vector<PrefetchBufferPool<Context>> output_pools_;
 };
 
 } // namespace caffe2
@@ -1,4 +1,5 @@
 #include <cub/block/block_reduce.cuh>
+#include <cub/warp/warp_reduce.cuh>
 #include "caffe2/core/context_gpu.h"
 #include "caffe2/operators/reduction_front_back_ops.h"
 
@@ -94,6 +95,174 @@ __global__ void columnwise_sum_kernel(
   }
 }
 
+// Rows of at most this many columns are summed by a warp each, not a block.
+constexpr int kWarpRowMaxCols = 256;
+constexpr int kWarpsPerBlock = CAFFE_CUDA_NUM_THREADS / 32;
+
+template <typename T, bool NORMALIZE>
+__global__ void rowwise_warp_sum_kernel(
+    const int rows,
+    const int cols,
+    const T* data,
+    const int* lengths,
+    T* out) {
+  typedef cub::WarpReduce<T> WarpReduce;
+  __shared__ typename WarpReduce::TempStorage temp_storage[kWarpsPerBlock];
+  const int warp = threadIdx.x / 32;
+  const int lane = threadIdx.x % 32;
+  for (int rowIndex = blockIdx.x * kWarpsPerBlock + warp; rowIndex < rows;
+       rowIndex += gridDim.x * kWarpsPerBlock) {
+    T sum = 0;
+    const int rowOffset = rowIndex * cols;
+    const int length = lengths == nullptr ? cols : lengths[rowIndex];
+    for (int colIndex = lane; colIndex < length; colIndex += 32) {
+      sum += data[rowOffset + colIndex];
+    }
+    sum = WarpReduce(temp_storage[warp]).Sum(sum);
+    if (lane == 0) {
+      out[rowIndex] = NORMALIZE ? sum / length : sum;
+    }
+  }
+}
+
+// The columnwise sums of tiles of kTileCols columns, with blocks of
+// kTileCols x kTileRows threads, so that every warp reads a row of the tile
+// in one go. blockIdx.y is a chunk of rows_per_chunk rows; with more than one
+// chunk out is the partial sum of every chunk, added up by
+// columnwise_chunk_sum_kernel.
+constexpr int kTileCols = 32;
+constexpr int kTileRows = CAFFE_CUDA_NUM_THREADS / kTileCols;
+
+template <typename T, bool NORMALIZE>
+__global__ void columnwise_tile_sum_kernel(
+    const int rows,
+    const int cols,
+    const int rows_per_chunk,
+    const T* data,
+    const int* lengths,
+    T* out) {
+  __shared__ T partial[kTileRows][kTileCols + 1];
+  const int tiles = (cols + kTileCols - 1) / kTileCols;
+  const int rowBegin = blockIdx.y * rows_per_chunk;
+  for (int tile = blockIdx.x; tile < tiles; tile += gridDim.x) {
+    const int colIndex = tile * kTileCols + threadIdx.x;
+    const int length = colIndex >= cols
+        ? 0
+        : lengths == nullptr ? rows : lengths[colIndex];
+    const int rowEnd = min(rowBegin + rows_per_chunk, length);
+    T sum = 0;
+    for (int rowIndex = rowBegin + threadIdx.y; rowIndex < rowEnd;
+         rowIndex += kTileRows) {
+      sum += data[rowIndex * cols + colIndex];
+    }
+    partial[threadIdx.y][threadIdx.x] = sum;
+    __syncthreads();
+    for (int s = kTileRows / 2; s > 0; s >>= 1) {
+      if (threadIdx.y < s) {
+        partial[threadIdx.y][threadIdx.x] +=
+            partial[threadIdx.y + s][threadIdx.x];
+      }
+      __syncthreads();
+    }
+    if (threadIdx.y == 0 && colIndex < cols) {
+      sum = partial[0][threadIdx.x];
+      out[blockIdx.y * cols + colIndex] = NORMALIZE ? sum / length : sum;
+    }
+    __syncthreads();
+  }
+}
+
+template <typename T, bool NORMALIZE>
+__global__ void columnwise_chunk_sum_kernel(
+    const int rows,
+    const int cols,
+    const int chunks,
+    const T* partial,
+    const int* lengths,
+    T* out) {
+  CUDA_1D_KERNEL_LOOP(colIndex, cols) {
+    T sum = 0;
+    for (int chunk = 0; chunk < chunks; ++chunk) {
+      sum += partial[chunk * cols + colIndex];
+    }
+    const int length = lengths == nullptr ? rows : lengths[colIndex];
+    out[colIndex] = NORMALIZE ? sum / length : sum;
+  }
+}
+
+// A warp per row for the short rows, else a block per row.
+template <typename T, bool NORMALIZE>
+void RowwiseSum(
+    const int rows,
+    const int cols,
+    const T* data,
+    const int* lengths,
+    T* out,
+    CUDAContext* context) {
+  if (cols <= kWarpRowMaxCols) {
+    rowwise_warp_sum_kernel<T, NORMALIZE>
+        <<<std::min(
+               (rows + kWarpsPerBlock - 1) / kWarpsPerBlock,
+               CAFFE_MAXIMUM_NUM_BLOCKS),
+           CAFFE_CUDA_NUM_THREADS,
+           0,
+           context->cuda_stream()>>>(rows, cols, data, lengths, out);
+    return;
+  }
+  rowwise_sum_kernel<T, NORMALIZE>
+      <<<std::min(rows, CAFFE_MAXIMUM_NUM_BLOCKS),
+         CAFFE_CUDA_NUM_THREADS,
+         0,
+         context->cuda_stream()>>>(rows, cols, data, lengths, out);
+}
+
+// A block per column for a few columns; else tiles of columns read a row at
+// a time, with the rows split into chunks when there are too few tiles to
+// fill the GPU, e.g. the channels of an N x T x H x W reduction.
+template <typename T, bool NORMALIZE>
+void ColumnwiseSum(
+    const int rows,
+    const int cols,
+    const T* data,
+    const int* lengths,
+    T* out,
+    Tensor<CUDAContext>* scratch,
+    CUDAContext* context) {
+  if (cols < kTileCols) {
+    columnwise_sum_kernel<T, NORMALIZE>
+        <<<std::min(cols, CAFFE_MAXIMUM_NUM_BLOCKS),
+           CAFFE_CUDA_NUM_THREADS,
+           0,
+           context->cuda_stream()>>>(rows, cols, data, lengths, out);
+    return;
+  }
+  const int tiles = (cols + kTileCols - 1) / kTileCols;
+  const int chunks = std::max(
+      1,
+      std::min(
+          (rows + 4 * kTileRows - 1) / (4 * kTileRows),
+          CAFFE_MAXIMUM_NUM_BLOCKS / 4 / tiles));
+  const int rows_per_chunk = (rows + chunks - 1) / chunks;
+  const dim3 grid(std::min(tiles, CAFFE_MAXIMUM_NUM_BLOCKS), chunks);
+  const dim3 block(kTileCols, kTileRows);
+  if (chunks == 1) {
+    columnwise_tile_sum_kernel<T, NORMALIZE>
+        <<<grid, block, 0, context->cuda_stream()>>>(
+            rows, cols, rows_per_chunk, data, lengths, out);
+    return;
+  }
+  scratch->Resize(chunks, cols);
+  T* partial = scratch->template mutable_data<T>();
+  columnwise_tile_sum_kernel<T, false>
+      <<<grid, block, 0, context->cuda_stream()>>>(
+          rows, cols, rows_per_chunk, data, lengths, partial);
+  columnwise_chunk_sum_kernel<T, NORMALIZE>
+      <<<CAFFE_GET_BLOCKS(cols),
+         CAFFE_CUDA_NUM_THREADS,
+         0,
+         context->cuda_stream()>>>(rows, cols, chunks, partial, lengths, out);
+}
+
 } // anonymous namespace
 
 /***
@@ -109,11 +278,8 @@ void SumReduceDimsOp<CUDAContext, true, false>::Compute(
     const T* in_data,
     const int* lengths_data,
     T* out_data) {
-  columnwise_sum_kernel<T, false>
-      <<<std::min(cols, CAFFE_MAXIMUM_NUM_BLOCKS),
-         CAFFE_CUDA_NUM_THREADS,
-         0,
-         context_.cuda_stream()>>>(rows, cols, in_data, lengths_data, out_data);
+  ColumnwiseSum<T, false>(
+      rows, cols, in_data, lengths_data, out_data, &scratch_, &context_);
 }
 
 // ReduceBackSum: rowwise sum
@@ -125,11 +291,7 @@ void SumReduceDimsOp<CUDAContext, false, false>::Compute(
     const T* in_data,
     const int* lengths_data,
     T* out_data) {
-  rowwise_sum_kernel<T, false>
-      <<<std::min(rows, CAFFE_MAXIMUM_NUM_BLOCKS),
-         CAFFE_CUDA_NUM_THREADS,
-         0,
-         context_.cuda_stream()>>>(rows, cols, in_data, lengths_data, out_data);
+  RowwiseSum<T, false>(rows, cols, in_data, lengths_data, out_data, &context_);
 }
 
 // ReduceFrontSumGradient
@@ -191,11 +353,8 @@ void SumReduceDimsOp<CUDAContext, true, true>::Compute(
     const T* in_data,
     const int* lengths_data,
     T* out_data) {
-  columnwise_sum_kernel<T, true>
-      <<<std::min(cols, CAFFE_MAXIMUM_NUM_BLOCKS),
-         CAFFE_CUDA_NUM_THREADS,
-         0,
-         context_.cuda_stream()>>>(rows, cols, in_data, lengths_data, out_data);
+  ColumnwiseSum<T, true>(
+      rows, cols, in_data, lengths_data, out_data, &scratch_, &context_);
 }
 
 // ReduceBackMean: rowwise mean
@@ -207,11 +366,7 @@ void SumReduceDimsOp<CUDAContext, false, true>::Compute(
     const T* in_data,
     const int* lengths_data,
     T* out_data) {
-  rowwise_sum_kernel<T, true>
-      <<<std::min(rows, CAFFE_MAXIMUM_NUM_BLOCKS),
-         CAFFE_CUDA_NUM_THREADS,
-         0,
-         context_.cuda_stream()>>>(rows, cols, in_data, lengths_data, out_data);
+  RowwiseSum<T, true>(rows, cols, in_data, lengths_data, out_data, &context_);
 }
 
 // ReduceFrontMeanGradient
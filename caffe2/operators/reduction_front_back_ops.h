@@ -79,6 +79,8 @@ class SumReduceDimsOp final : public Operator<Context> {
       T* out_data);
 
   int num_reduce_dims_;
+  // the partial sums of a columnwise reduction split over row chunks (CUDA)
+  Tensor<Context> scratch_;
 };
 
 template <class Context, bool FIRSTDIMS, bool NORMALIZE>
@@ -1,6 +1,7 @@
 #include "caffe2/operators/relu_op.h"
 
 #include "caffe2/utils/math.h"
+#include "caffe2/utils/parallel_for.h"
 
 namespace caffe2 {
 
@@ -14,8 +15,16 @@ bool ReluOp<float, CPUContext>::RunOnDevice() {
   const float zero = 0.0f;
   vDSP_vthres(X.data<float>(), 1, &zero, Y->mutable_data<float>(), 1, X.size());
 #else
-  EigenVectorMap<float>(Y->mutable_data<float>(), X.size()) =
-      ConstEigenVectorMap<float>(X.data<float>(), X.size()).cwiseMax(0.f);
+  const float* X_data = X.data<float>();
+  float* Y_data = Y->mutable_data<float>();
+  ParallelFor(
+      X.size(),
+      ParallelForGrainSize(1),
+      [X_data, Y_data](int64_t begin, int64_t end) {
+        EigenVectorMap<float>(Y_data + begin, end - begin) =
+            ConstEigenVectorMap<float>(X_data + begin, end - begin)
+                .cwiseMax(0.f);
+      });
 #endif
   /* Naive implementation
   const float* Xdata = X.data<float>();
@@ -0,0 +1,35 @@
+#include "caffe2/operators/scale_by_inverse_count_op.h"
+
+namespace caffe2 {
+
+REGISTER_CPU_OPERATOR(ScaleByInverseCount, ScaleByInverseCountOp<CPUContext>);
+OPERATOR_SCHEMA(ScaleByInverseCount)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .AllowInplace({{0, 0}})
+    .IdenticalTypeAndShape()
+    .SetDoc(R"DOC(
+Divides the input by the number of its elements from axis on, e.g. by the
+length of its rows with the default axis -1. It is one op for the scaling
+that a ConstantFill of ones, a ReduceBackSum of them, an Add to broadcast the
+counts and a Div by them do, without materializing the ones or the counts,
+and it works for inputs whose shape is only known at run time.
+)DOC")
+    .Arg("axis", "(int, default -1) the first axis that is counted")
+    .Input(0, "X", "input tensor")
+    .Output(0, "Y", "X divided by the product of its dims from axis on");
+
+class GetScaleByInverseCountGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    // dY has the shape of X, so the same op with the same axis scales it
+    return SingleGradientDef(
+        "ScaleByInverseCount",
+        "",
+        vector<string>{GO(0)},
+        vector<string>{GI(0)});
+  }
+};
+REGISTER_GRADIENT(ScaleByInverseCount, GetScaleByInverseCountGradient);
+
+} // namespace caffe2
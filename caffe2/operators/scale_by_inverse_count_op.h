@@ -0,0 +1,50 @@
+#ifndef CAFFE2_OPERATORS_SCALE_BY_INVERSE_COUNT_OP_H_
+#define CAFFE2_OPERATORS_SCALE_BY_INVERSE_COUNT_OP_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// Y = X / count, count being the number of elements of X from axis on: a
+// mean without the reduction, e.g. the normalization of the non-local blocks
+// without softmax by the length of their rows.
+template <class Context>
+class ScaleByInverseCountOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  ScaleByInverseCountOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        axis_(OperatorBase::GetSingleArgument<int>("axis", -1)) {}
+
+  template <typename T>
+  bool DoRunWithType() {
+    auto& X = Input(0);
+    auto* Y = Output(0);
+    CAFFE_ENFORCE_GT(X.ndim(), 0);
+    const TIndex count = X.size_from_dim(X.canonical_axis_index(axis_));
+    Y->ResizeLike(X);
+    if (count == 0) {
+      return true;
+    }
+    math::Scale<T, Context>(
+        X.size(),
+        1.0f / count,
+        X.template data<T>(),
+        Y->template mutable_data<T>(),
+        &context_);
+    return true;
+  }
+
+  bool RunOnDevice() override {
+    return DispatchHelper<TensorTypes<float>>::call(this, Input(0));
+  }
+
+ protected:
+  int axis_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_OPERATORS_SCALE_BY_INVERSE_COUNT_OP_H_
@@ -0,0 +1,13 @@
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/operators/scale_by_inverse_count_op.h"
+
+namespace caffe2 {
+
+template <>
+bool ScaleByInverseCountOp<CUDAContext>::RunOnDevice() {
+  return DispatchHelper<TensorTypes<float16, float>>::call(this, Input(0));
+}
+
+REGISTER_CUDA_OPERATOR(ScaleByInverseCount, ScaleByInverseCountOp<CUDAContext>);
+
+} // namespace caffe2
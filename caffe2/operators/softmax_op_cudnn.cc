@@ -1,6 +1,7 @@
 #include "caffe2/core/context_gpu.h"
 #include "caffe2/core/cudnn_wrappers.h"
 #include "caffe2/core/types.h"
+#include "caffe2/operators/conv_op_cache_cudnn.h"
 #include "caffe2/operators/softmax_op.h"
 
 namespace caffe2 {
@@ -11,6 +12,19 @@ constexpr int GRADIENT_NUM_DESCRIPTORS = 3;
 constexpr int BOTTOM_DESC_ID = 0;
 constexpr int TOP_DESC_ID = 1;
 constexpr int TOP_GRADIENT_DESC_ID = 2;
+
+// the descriptor of an input shape, see caffe2_cudnn_shape_cache_size
+struct SoftmaxDescriptor {
+  SoftmaxDescriptor() {
+    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&desc));
+  }
+
+  ~SoftmaxDescriptor() {
+    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(desc));
+  }
+
+  cudnnTensorDescriptor_t desc;
+};
 }  // namespace
 
 class CuDNNSoftmaxOp final : public Operator<CUDAContext> {
@@ -18,13 +32,10 @@ class CuDNNSoftmaxOp final : public Operator<CUDAContext> {
   explicit CuDNNSoftmaxOp(const OperatorDef& def, Workspace* ws)
       : Operator<CUDAContext>(def, ws),
         cudnn_wrapper_(&context_),
-        axis_(OperatorBase::GetSingleArgument<int>("axis", 1)) {
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&desc_));
-  }
+        axis_(OperatorBase::GetSingleArgument<int>("axis", 1)),
+        descriptor_cache_(FLAGS_caffe2_cudnn_shape_cache_size) {}
 
-  ~CuDNNSoftmaxOp() {
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(desc_));
-  }
+  ~CuDNNSoftmaxOp() {}
 
   template <typename T>
   bool DoRunWithType() {
@@ -35,7 +46,9 @@ class CuDNNSoftmaxOp final : public Operator<CUDAContext> {
     const int D = X.size_from_dim(canonical_axis);
 
     Y->ResizeLike(X);
-    if (dims_ != X.dims()) {
+    bool created = false;
+    desc_ = descriptor_cache_.Lookup(X.dims(), &created)->desc;
+    if (created) {
       CUDNN_ENFORCE(cudnnSetTensor4dDescriptor(
           desc_,
           GetCudnnTensorFormat(StorageOrder::NCHW),
@@ -44,7 +57,6 @@ class CuDNNSoftmaxOp final : public Operator<CUDAContext> {
           D,
           1,
           1));
-      dims_ = X.dims();
     }
     CUDNN_ENFORCE(cudnnSoftmaxForward(
         cudnn_wrapper_.inline_cudnn_handle(),
@@ -66,8 +78,9 @@ class CuDNNSoftmaxOp final : public Operator<CUDAContext> {
  protected:
   CuDNNWrapper cudnn_wrapper_;
   int axis_;
+  ShapeCache<SoftmaxDescriptor> descriptor_cache_;
+  // the descriptor of the current shape, owned by descriptor_cache_
   cudnnTensorDescriptor_t desc_;
-  vector<TIndex> dims_;
 };
 
 
@@ -76,13 +89,10 @@ class CuDNNSoftmaxGradientOp final : public Operator<CUDAContext> {
   explicit CuDNNSoftmaxGradientOp(const OperatorDef& def, Workspace* ws)
       : Operator<CUDAContext>(def, ws),
         cudnn_wrapper_(&context_),
-        axis_(OperatorBase::GetSingleArgument<int>("axis", 1)) {
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&desc_));
-  }
+        axis_(OperatorBase::GetSingleArgument<int>("axis", 1)),
+        descriptor_cache_(FLAGS_caffe2_cudnn_shape_cache_size) {}
 
-  ~CuDNNSoftmaxGradientOp() {
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(desc_));
-  }
+  ~CuDNNSoftmaxGradientOp() {}
 
   template <typename T>
   bool DoRunWithType() {
@@ -95,7 +105,9 @@ class CuDNNSoftmaxGradientOp final : public Operator<CUDAContext> {
 
     CHECK_EQ(Y.dims(), dY.dims());
     dX->ResizeLike(Y);
-    if (dims_ != Y.dims()) {
+    bool created = false;
+    desc_ = descriptor_cache_.Lookup(Y.dims(), &created)->desc;
+    if (created) {
       CUDNN_ENFORCE(cudnnSetTensor4dDescriptor(
           desc_,
           GetCudnnTensorFormat(StorageOrder::NCHW),
@@ -104,7 +116,6 @@ class CuDNNSoftmaxGradientOp final : public Operator<CUDAContext> {
           D,
           1,
           1));
-      dims_ = Y.dims();
     }
     CUDNN_ENFORCE(cudnnSoftmaxBackward(
         cudnn_wrapper_.inline_cudnn_handle(),
@@ -128,8 +139,9 @@ class CuDNNSoftmaxGradientOp final : public Operator<CUDAContext> {
  protected:
   CuDNNWrapper cudnn_wrapper_;
   int axis_;
+  ShapeCache<SoftmaxDescriptor> descriptor_cache_;
+  // the descriptor of the current shape, owned by descriptor_cache_
   cudnnTensorDescriptor_t desc_;
-  vector<TIndex> dims_;
 };
 
 namespace {
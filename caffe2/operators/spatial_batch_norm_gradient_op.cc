@@ -115,12 +115,34 @@ bool SpatialBNGradientOp<CPUContext>::RunOnDevice() {
 
 REGISTER_CPU_OPERATOR(SpatialBNGradient, SpatialBNGradientOp<CPUContext>);
 
+namespace {
+// Two passes over X and dY: the reductions to dscale and dbias and then dX.
+OpSchema::Cost CostInferenceForSpatialBNGradient(
+    const OperatorDef& def,
+    const vector<TensorShape>& in) {
+  struct OpSchema::Cost cost;
+  ArgumentHelper helper(def);
+  const auto order =
+      StringToStorageOrder(helper.GetSingleArgument<string>("order", "NCHW"));
+  const TensorShape X = in[0];
+  const int C =
+      (order == StorageOrder::NCHW ? X.dims(1) : X.dims(X.dims_size() - 1));
+  const uint64_t size = nElemFromDim(X);
+  cost.flops = 8 * size;
+  // X and dY are read twice and dX written
+  cost.bytes_moved = 5 * size * sizeof(float);
+  cost.params_bytes = 5 * C * sizeof(float);
+  return cost;
+}
+} // namespace
+
 // Input: X, scale, dY, mean, variance, dscale, dbias
 // Output: dX, dscale, dbias
 OPERATOR_SCHEMA(SpatialBNGradient)
     .NumInputs({5, 7})
     .NumOutputs(3)
-    .AllowInplace({{5, 1}, {6, 2}});
+    .AllowInplace({{5, 1}, {6, 2}})
+    .CostInferenceFunction(CostInferenceForSpatialBNGradient);
 
 // Spatial batch normalization's gradient, depending on the various input sizes,
 // is a bit more complex than usual gradient operators.
@@ -1,4 +1,5 @@
 #include "caffe2/operators/spatial_batch_norm_op.h"
+#include "caffe2/utils/parallel_for.h"
 
 namespace caffe2 {
 
@@ -137,20 +138,34 @@ bool SpatialBNOp<CPUContext>::RunOnDevice() {
       bias_arr - mean_arr * inv_std * scale_arr;
   switch (order_) {
     case StorageOrder::NHWC: {
-      EigenArrayMap<float>(Y->mutable_data<float>(), C, N * sample_size) =
-          (ConstEigenArrayMap<float>(X.data<float>(), C, N * sample_size)
-               .colwise() *
-           new_scale)
-              .colwise() +
-          new_bias;
+      // chunks of pixels
+      const float* X_data = X.data<float>();
+      float* Y_data = Y->mutable_data<float>();
+      ParallelFor(
+          N * sample_size,
+          ParallelForGrainSize(C),
+          [&](int64_t begin, int64_t end) {
+            EigenArrayMap<float>(Y_data + begin * C, C, end - begin) =
+                (ConstEigenArrayMap<float>(X_data + begin * C, C, end - begin)
+                     .colwise() *
+                 new_scale)
+                    .colwise() +
+                new_bias;
+          });
       break;
     }
     case StorageOrder::NCHW: {
       EigenArrayMap<float> Y_arr(Y->mutable_data<float>(), sample_size, N * C);
       ConstEigenArrayMap<float> X_arr(X.data<float>(), sample_size, N * C);
-      for (int nc = 0; nc < N * C; ++nc) {
-        Y_arr.col(nc) = X_arr.col(nc) * new_scale(nc % C) + new_bias(nc % C);
-      }
+      ParallelFor(
+          N * C,
+          ParallelForGrainSize(sample_size),
+          [&](int64_t begin, int64_t end) {
+            for (int64_t nc = begin; nc < end; ++nc) {
+              Y_arr.col(nc) =
+                  X_arr.col(nc) * new_scale(nc % C) + new_bias(nc % C);
+            }
+          });
       break;
     }
     default:
@@ -170,6 +185,8 @@ OpSchema::Cost CostInferenceForSpatialBN(
   const TensorShape X = in[0];
   const int C =
       (order == StorageOrder::NCHW ? X.dims(1) : X.dims(X.dims_size() - 1));
+  // X is read and Y written, in 2D or 3D
+  cost.bytes_moved = 2 * nElemFromDim(X) * sizeof(float);
   cost.params_bytes = 2 * C * sizeof(float);
   return cost;
 }
@@ -2,6 +2,7 @@
 
 #include "caffe2/core/context_gpu.h"
 #include "caffe2/core/cudnn_wrappers.h"
+#include "caffe2/operators/conv_op_cache_cudnn.h"
 #include "caffe2/operators/spatial_batch_norm_op.h"
 #include "caffe2/utils/math.h"
 
@@ -12,13 +13,33 @@ static_assert(CUDNN_VERSION >= 5000,
 
 namespace caffe2 {
 
+namespace {
+
+// the descriptors of an input shape, see caffe2_cudnn_shape_cache_size
+struct BNDescriptors {
+  BNDescriptors() {
+    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&data_desc));
+    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&bn_param_desc));
+  }
+
+  ~BNDescriptors() {
+    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(data_desc));
+    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(bn_param_desc));
+  }
+
+  cudnnTensorDescriptor_t data_desc;
+  cudnnTensorDescriptor_t bn_param_desc;
+};
+
+} // namespace
+
 class CudnnSpatialBNOp final : public SpatialBNOp<CUDAContext> {
  public:
   USE_OPERATOR_FUNCTIONS(CUDAContext);
   CudnnSpatialBNOp(const OperatorDef& operator_def, Workspace* ws)
-      : SpatialBNOp<CUDAContext>(operator_def, ws), cudnn_wrapper_(&context_) {
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&data_desc_));
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&bn_param_desc_));
+      : SpatialBNOp<CUDAContext>(operator_def, ws),
+        cudnn_wrapper_(&context_),
+        descriptor_cache_(FLAGS_caffe2_cudnn_shape_cache_size) {
     if (epsilon_ <= CUDNN_BN_MIN_EPSILON - FLT_EPSILON) {
       LOG(ERROR) << "Provided epsilon is smaller than "
                  << "CUDNN_BN_MIN_EPSILON. Setting it to "
@@ -32,10 +53,7 @@ class CudnnSpatialBNOp final : public SpatialBNOp<CUDAContext> {
 #endif
   }
 
-  ~CudnnSpatialBNOp() {
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(data_desc_));
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(bn_param_desc_));
-  }
+  ~CudnnSpatialBNOp() {}
 
   template <typename T, typename M>
   bool DoRunWithType();
@@ -43,9 +61,10 @@ class CudnnSpatialBNOp final : public SpatialBNOp<CUDAContext> {
 
  protected:
   CuDNNWrapper cudnn_wrapper_;
+  ShapeCache<BNDescriptors> descriptor_cache_;
+  // the descriptors of the current shape, owned by descriptor_cache_
   cudnnTensorDescriptor_t data_desc_;
   cudnnTensorDescriptor_t bn_param_desc_;
-  vector<TIndex> cudnn_input_dims_;
 
   cudnnBatchNormMode_t mode_;
 };
@@ -55,9 +74,8 @@ class CudnnSpatialBNGradientOp final : public SpatialBNGradientOp<CUDAContext> {
   USE_OPERATOR_FUNCTIONS(CUDAContext);
   CudnnSpatialBNGradientOp(const OperatorDef& operator_def, Workspace* ws)
       : SpatialBNGradientOp<CUDAContext>(operator_def, ws),
-        cudnn_wrapper_(&context_) {
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&data_desc_));
-    CUDNN_ENFORCE(cudnnCreateTensorDescriptor(&bn_param_desc_));
+        cudnn_wrapper_(&context_),
+        descriptor_cache_(FLAGS_caffe2_cudnn_shape_cache_size) {
     if (epsilon_ <= CUDNN_BN_MIN_EPSILON - FLT_EPSILON) {
       LOG(ERROR) << "Provided epsilon is smaller than "
                  << "CUDNN_BN_MIN_EPSILON. Setting it to "
@@ -71,10 +89,7 @@ class CudnnSpatialBNGradientOp final : public SpatialBNGradientOp<CUDAContext> {
 #endif
   }
 
-  ~CudnnSpatialBNGradientOp() {
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(data_desc_));
-    CUDNN_ENFORCE(cudnnDestroyTensorDescriptor(bn_param_desc_));
-  }
+  ~CudnnSpatialBNGradientOp() {}
 
   template <typename T, typename M>
   bool DoRunWithType();
@@ -83,9 +98,10 @@ class CudnnSpatialBNGradientOp final : public SpatialBNGradientOp<CUDAContext> {
 
  protected:
   CuDNNWrapper cudnn_wrapper_;
+  ShapeCache<BNDescriptors> descriptor_cache_;
+  // the descriptors of the current shape, owned by descriptor_cache_
   cudnnTensorDescriptor_t data_desc_;
   cudnnTensorDescriptor_t bn_param_desc_;
-  vector<TIndex> cudnn_input_dims_;
 
   cudnnBatchNormMode_t mode_;
 };
@@ -121,10 +137,13 @@ bool CudnnSpatialBNOp::DoRunWithType() {
   CAFFE_ENFORCE_EQ(bias.ndim(), 1);
   CAFFE_ENFORCE_EQ(scale.dim32(0), C);
   CAFFE_ENFORCE_EQ(bias.dim32(0), C);
-  // See if we need to reshape.
-  if (X.dims() != cudnn_input_dims_) {
+  // See if the shape is new to the op.
+  bool created = false;
+  BNDescriptors* descs = descriptor_cache_.Lookup(X.dims(), &created);
+  data_desc_ = descs->data_desc;
+  bn_param_desc_ = descs->bn_param_desc;
+  if (created) {
     VLOG(1) << "Setting descriptors.";
-    cudnn_input_dims_ = X.dims();
     if (order_ == StorageOrder::NCHW) {
       vector<int> dims = {N, C, H, W, D};
       vector<int> strides = {C * H * W * D, H * W * D, W * D, D, 1};
@@ -275,8 +294,12 @@ bool CudnnSpatialBNGradientOp::DoRunWithType() {
       : 1;
   CAFFE_ENFORCE_EQ(scale.ndim(), 1);
   CAFFE_ENFORCE_EQ(scale.dim32(0), C);
-  // See if we need to reshape.
-  if (X.dims() != cudnn_input_dims_) {
+  // See if the shape is new to the op.
+  bool created = false;
+  BNDescriptors* descs = descriptor_cache_.Lookup(X.dims(), &created);
+  data_desc_ = descs->data_desc;
+  bn_param_desc_ = descs->bn_param_desc;
+  if (created) {
     if (order_ == StorageOrder::NCHW) {
       vector<int> dims = {N, C, H, W, D};
       vector<int> strides = {C * H * W * D, H * W * D, W * D, D, 1};
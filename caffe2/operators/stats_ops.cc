@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <chrono>
+#include <sstream>
+#include <unordered_map>
 #include <vector>
 #include "caffe2/core/operator.h"
 #include "caffe2/core/stats.h"
@@ -53,6 +56,50 @@ class StatRegistryExportOp : public Operator<CPUContext> {
   bool reset_;
 };
 
+// Logs the counters of the global StatRegistry that start with one of the
+// prefixes, as their change since the previous run of the op. It neither
+// resets the counters nor allocates tensors, so it can run next to the other
+// readers of the registry.
+class StatRegistryDumpOp : public Operator<CPUContext> {
+ public:
+  StatRegistryDumpOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator(operator_def, ws),
+        prefixes_(GetRepeatedArgument<std::string>("prefixes")),
+        skip_unchanged_(GetSingleArgument<bool>("skip_unchanged", true)) {}
+
+  bool RunOnDevice() override {
+    std::ostringstream out;
+    int num_logged = 0;
+    for (const auto& stat : StatRegistry::get().publish()) {
+      if (!prefixes_.empty() &&
+          std::none_of(
+              prefixes_.begin(),
+              prefixes_.end(),
+              [&stat](const std::string& prefix) {
+                return stat.key.compare(0, prefix.size(), prefix) == 0;
+              })) {
+        continue;
+      }
+      auto& last = last_values_[stat.key];
+      const int64_t delta = stat.value - last;
+      last = stat.value;
+      if (delta == 0 && skip_unchanged_) {
+        continue;
+      }
+      out << (num_logged++ > 0 ? " " : "") << stat.key << "=" << delta;
+    }
+    if (num_logged > 0) {
+      LOG(INFO) << "Stats: " << out.str();
+    }
+    return true;
+  }
+
+ private:
+  std::vector<std::string> prefixes_;
+  bool skip_unchanged_;
+  std::unordered_map<std::string, int64_t> last_values_;
+};
+
 class StatRegistryUpdateOp : public Operator<CPUContext> {
  public:
   StatRegistryUpdateOp(const OperatorDef& operator_def, Workspace* ws)
@@ -198,6 +245,7 @@ struct CpuUtilizationReportOp : public Operator<CPUContext> {
 REGISTER_CPU_OPERATOR(StatRegistryCreate, StatRegistryCreateOp);
 REGISTER_CPU_OPERATOR(StatRegistryUpdate, StatRegistryUpdateOp);
 REGISTER_CPU_OPERATOR(StatRegistryExport, StatRegistryExportOp);
+REGISTER_CPU_OPERATOR(StatRegistryDump, StatRegistryDumpOp);
 
 REGISTER_CPU_OPERATOR(TimerBegin, TimerBeginOp);
 REGISTER_CPU_OPERATOR(TimerEnd, TimerEndOp);
@@ -245,6 +293,18 @@ OPERATOR_SCHEMA(StatRegistryExport)
         "reset",
         "(default true) Whether to atomically reset the counters afterwards.");
 
+OPERATOR_SCHEMA(StatRegistryDump)
+    .NumInputs(0)
+    .NumOutputs(0)
+    .SetDoc(R"DOC(
+Logs the counters of the global StatRegistry, as their change since the
+previous run of this op. Unlike StatRegistryExport it does not reset them.
+)DOC")
+    .Arg("prefixes", "(list of string) Only log the keys with these prefixes.")
+    .Arg(
+        "skip_unchanged",
+        "(default true) Whether to leave out the counters that did not change.");
+
 OPERATOR_SCHEMA(TimerBegin)
     .NumInputs(0)
     .NumOutputs(1)
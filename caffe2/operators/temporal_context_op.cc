@@ -0,0 +1,30 @@
+#include "caffe2/operators/temporal_context_op.h"
+
+namespace caffe2 {
+
+REGISTER_CPU_OPERATOR(TemporalContext, TemporalContextOp<CPUContext>);
+OPERATOR_SCHEMA(TemporalContext)
+    .NumInputs(2)
+    .NumOutputs(2)
+    .EnforceInplace({{1, 1}})
+    .SetDoc(R"DOC(
+Streams a clip through the temporal dim (dim 2) of N x C x T x ... chunks. It
+keeps the last `context` frames seen in STATE and outputs them followed by
+the new chunk, so that an op with a temporal kernel of context + 1 frames
+and no temporal padding outputs one frame per new frame, as it would on the
+whole stream; the streaming inference of the StreamingPredictor puts one in
+front of every 3D conv and pool before its split blob. With delay the output
+is the chunk `context` frames back instead, which lines up two branches of a
+residual block. STATE starts out as zeros, the padding at the start of the
+stream, and is reset to zeros when the other dims of the chunks change.
+)DOC")
+    .Arg("context", "(int) number of frames kept")
+    .Arg("delay", "(bool, default 0) output the chunk delayed by context")
+    .Input(0, "X", "new chunk, N x C x T x ...")
+    .Input(1, "STATE", "last frames of the stream, N x C x context x ...")
+    .Output(0, "Y", "N x C x (context + T) x ..., or N x C x T x ... delayed")
+    .Output(1, "STATE", "updated in place");
+
+SHOULD_NOT_DO_GRADIENT(TemporalContext);
+
+} // namespace caffe2
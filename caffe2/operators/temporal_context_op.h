@@ -0,0 +1,93 @@
+#ifndef CAFFE2_OPERATORS_TEMPORAL_CONTEXT_OP_H_
+#define CAFFE2_OPERATORS_TEMPORAL_CONTEXT_OP_H_
+
+#include <cstring>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/operator.h"
+
+namespace caffe2 {
+
+// Keeps the last `context` frames (dim 2 of N x C x T x ...) of a stream of
+// chunks in STATE and puts them in front of every new chunk, so that a
+// temporal conv without temporal padding computes the frames of the chunk
+// as if the whole stream had been its input. With delay the output is the
+// chunk `context` frames back instead. STATE starts out as zeros.
+template <class Context>
+class TemporalContextOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  TemporalContextOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        context_frames_(
+            OperatorBase::GetSingleArgument<int>("context", 0)),
+        delay_(OperatorBase::GetSingleArgument<int>("delay", 0)) {
+    CAFFE_ENFORCE_GE(context_frames_, 0);
+  }
+
+  bool RunOnDevice() override {
+    auto& X = Input(0);
+    auto& state = Input(1);
+    auto* Y = Output(0);
+    auto* state_out = Output(1);
+    CAFFE_ENFORCE_GE(X.ndim(), 3);
+    CAFFE_ENFORCE(
+        state_out == &state, "STATE must be updated in place");
+    const TIndex outer = X.dim(0) * X.dim(1);
+    const TIndex frames = X.dim(2);
+    const TIndex K = context_frames_;
+    const size_t frame_bytes = X.size_from_dim(3) * X.itemsize();
+
+    // a new stream, or one of other frames: start from zeros
+    std::vector<TIndex> state_dims = X.dims();
+    state_dims[2] = K;
+    if (state.dims() != state_dims || state.meta() != X.meta()) {
+      state_out->Resize(state_dims);
+      std::memset(
+          state_out->raw_mutable_data(X.meta()), 0, state_out->nbytes());
+    }
+    std::vector<TIndex> y_dims = X.dims();
+    y_dims[2] = delay_ ? frames : K + frames;
+    Y->Resize(y_dims);
+
+    const char* x = static_cast<const char*>(X.raw_data());
+    char* s = static_cast<char*>(state_out->raw_mutable_data(X.meta()));
+    char* y = static_cast<char*>(Y->raw_mutable_data(X.meta()));
+    for (TIndex o = 0; o < outer; ++o) {
+      const char* x_o = x + o * frames * frame_bytes;
+      char* s_o = s + o * K * frame_bytes;
+      char* y_o = y + o * y_dims[2] * frame_bytes;
+      // the context and the chunk in a row; Y is the whole row, or its
+      // first `frames` frames with delay
+      if (delay_) {
+        const TIndex from_state = std::min(K, frames);
+        std::memcpy(y_o, s_o, from_state * frame_bytes);
+        std::memcpy(
+            y_o + from_state * frame_bytes,
+            x_o,
+            (frames - from_state) * frame_bytes);
+      } else {
+        std::memcpy(y_o, s_o, K * frame_bytes);
+        std::memcpy(y_o + K * frame_bytes, x_o, frames * frame_bytes);
+      }
+      // and STATE its last K frames
+      if (K > frames) {
+        std::memmove(
+            s_o, s_o + frames * frame_bytes, (K - frames) * frame_bytes);
+        std::memcpy(
+            s_o + (K - frames) * frame_bytes, x_o, frames * frame_bytes);
+      } else {
+        std::memcpy(s_o, x_o + (frames - K) * frame_bytes, K * frame_bytes);
+      }
+    }
+    return true;
+  }
+
+ protected:
+  int context_frames_;
+  bool delay_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_OPERATORS_TEMPORAL_CONTEXT_OP_H_
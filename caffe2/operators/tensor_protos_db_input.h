@@ -23,8 +23,9 @@ class TensorProtosDBInput final : public PrefetchOperator<Context> {
   bool CopyPrefetched() override;
 
  private:
-  // Prefetch will always just happen on the CPU side.
-  vector<Blob> prefetched_blobs_;
+  // Prefetch will always just happen on the CPU side. One set of blobs per
+  // prefetch slot.
+  vector<vector<Blob>> prefetched_blobs_;
   int batch_size_;
   bool shape_inferred_ = false;
   string key_;
@@ -36,14 +37,19 @@ TensorProtosDBInput<Context>::TensorProtosDBInput(
     const OperatorDef& operator_def,
     Workspace* ws)
     : PrefetchOperator<Context>(operator_def, ws),
-      prefetched_blobs_(operator_def.output_size()),
+      prefetched_blobs_(this->prefetch_depth_),
       batch_size_(
-          OperatorBase::template GetSingleArgument<int>("batch_size", 0)) {}
+          OperatorBase::template GetSingleArgument<int>("batch_size", 0)) {
+  for (auto& blobs : prefetched_blobs_) {
+    blobs = vector<Blob>(operator_def.output_size());
+  }
+}
 
 template <class Context>
 bool TensorProtosDBInput<Context>::Prefetch() {
   const db::DBReader& reader = OperatorBase::Input<db::DBReader>(0);
   TensorDeserializer<CPUContext> deserializer;
+  vector<Blob>& prefetched_blobs = prefetched_blobs_[this->prefetch_slot_];
   if (batch_size_ == 0) {
     // We do not need to construct a batch. As a result, we will simply
     // deserialize everything into the target prefetched blob.
@@ -57,7 +63,7 @@ bool TensorProtosDBInput<Context>::Prefetch() {
       }
       deserializer.Deserialize(
           protos.protos(i),
-          prefetched_blobs_[i].template GetMutable<TensorCPU>());
+          prefetched_blobs[i].template GetMutable<TensorCPU>());
     }
   } else {
     vector<TensorCPU> temp_tensors(OutputSize());
@@ -72,11 +78,11 @@ bool TensorProtosDBInput<Context>::Prefetch() {
           vector<int> dims(
               protos.protos(i).dims().begin(), protos.protos(i).dims().end());
           dims.insert(dims.begin(), batch_size_);
-          prefetched_blobs_[i].template GetMutable<TensorCPU>()->Resize(dims);
+          prefetched_blobs[i].template GetMutable<TensorCPU>()->Resize(dims);
         }
       }
       for (int i = 0; i < protos.protos_size(); ++i) {
-        TensorCPU* dst = prefetched_blobs_[i].template GetMutable<TensorCPU>();
+        TensorCPU* dst = prefetched_blobs[i].template GetMutable<TensorCPU>();
         TensorCPU& src = temp_tensors[i];
         if (protos.protos(i).has_device_detail()) {
           protos.mutable_protos(i)->clear_device_detail();
@@ -97,9 +103,11 @@ bool TensorProtosDBInput<Context>::Prefetch() {
 
 template <class Context>
 bool TensorProtosDBInput<Context>::CopyPrefetched() {
+  vector<Blob>& prefetched_blobs = prefetched_blobs_[this->copy_slot_];
   for (int i = 0; i < OutputSize(); ++i) {
-    OperatorBase::Output<Tensor<Context>>(i)->CopyFrom(
-        prefetched_blobs_[i].template Get<TensorCPU>(), &this->context_);
+    // handed over on the CPU, copied to other devices
+    this->OutputPrefetched(
+        i, prefetched_blobs[i].template GetMutable<TensorCPU>());
   }
   return true;
 }
@@ -6,6 +6,22 @@
 
 namespace caffe2 {
 
+#define CAFFE2_CPU_TRANSPOSE_CONTIGUOUS_BLOCKS(T) \
+  template <>                                    \
+  bool TransposeContiguousBlocks<T, CPUContext>( \
+      const std::vector<int>& /* dims */,        \
+      const std::vector<int>& /* axes */,        \
+      const T* /* X */,                          \
+      T* /* Y */,                                \
+      CPUContext* /* context */) {               \
+    return false;                                \
+  }
+CAFFE2_CPU_TRANSPOSE_CONTIGUOUS_BLOCKS(float)
+CAFFE2_CPU_TRANSPOSE_CONTIGUOUS_BLOCKS(double)
+CAFFE2_CPU_TRANSPOSE_CONTIGUOUS_BLOCKS(int)
+CAFFE2_CPU_TRANSPOSE_CONTIGUOUS_BLOCKS(long)
+#undef CAFFE2_CPU_TRANSPOSE_CONTIGUOUS_BLOCKS
+
 REGISTER_CPU_OPERATOR(Transpose, TransposeOp<CPUContext>);
 
 #ifdef CAFFE2_HAS_MKL_DNN
@@ -3,6 +3,111 @@
 
 namespace caffe2 {
 
+namespace {
+
+constexpr int kMaxTransposeBlocksDims = 8;
+// below this many elements per block a thread per element of math::Transpose
+// wastes less of the blocks
+constexpr int kMinTransposeBlockSize = 32;
+
+struct TransposeBlocksDims {
+  int num_axes;
+  int y_dims[kMaxTransposeBlocksDims];
+  int x_strides[kMaxTransposeBlocksDims];
+};
+
+// A CUDA block per block of Y at a time: the index of the block in X is
+// computed once, and the threads copy its contiguous elements.
+template <typename T>
+__global__ void TransposeContiguousBlocksKernel(
+    const int num_blocks,
+    const int block_size,
+    const TransposeBlocksDims dims,
+    const T* X,
+    T* Y) {
+  for (int y_block = blockIdx.x; y_block < num_blocks;
+       y_block += gridDim.x) {
+    int x_block = 0;
+    for (int i = dims.num_axes - 1, r = y_block; i >= 0; --i) {
+      x_block += (r % dims.y_dims[i]) * dims.x_strides[i];
+      r /= dims.y_dims[i];
+    }
+    const T* x = X + static_cast<TIndex>(x_block) * block_size;
+    T* y = Y + static_cast<TIndex>(y_block) * block_size;
+    for (int i = threadIdx.x; i < block_size; i += blockDim.x) {
+#if __CUDA_ARCH__ >= 350
+      y[i] = __ldg(x + i);
+#else
+      y[i] = x[i];
+#endif
+    }
+  }
+}
+
+template <typename T>
+bool TransposeContiguousBlocksCUDA(
+    const std::vector<int>& dims,
+    const std::vector<int>& axes,
+    const T* X,
+    T* Y,
+    CUDAContext* context) {
+  const int num_axes = dims.size() - 1;
+  const int block_size = dims.back();
+  if (axes.back() != num_axes || num_axes > kMaxTransposeBlocksDims ||
+      block_size < kMinTransposeBlockSize) {
+    return false;
+  }
+  if (num_axes == 0) {
+    context->Copy<T, CUDAContext, CUDAContext>(block_size, X, Y);
+    return true;
+  }
+  TransposeBlocksDims blocks_dims;
+  blocks_dims.num_axes = num_axes;
+  std::vector<int> strides(num_axes);
+  int stride = 1;
+  for (int i = num_axes - 1; i >= 0; --i) {
+    strides[i] = stride;
+    stride *= dims[i];
+  }
+  int num_blocks = 1;
+  for (int i = 0; i < num_axes; ++i) {
+    blocks_dims.y_dims[i] = dims[axes[i]];
+    blocks_dims.x_strides[i] = strides[axes[i]];
+    num_blocks *= dims[axes[i]];
+  }
+  if (num_blocks == 0) {
+    return true;
+  }
+  const int num_threads = std::min(
+      CAFFE_CUDA_NUM_THREADS,
+      math::roundUp(block_size, kMinTransposeBlockSize));
+  TransposeContiguousBlocksKernel<T>
+      <<<std::min(num_blocks, CAFFE_MAXIMUM_NUM_BLOCKS),
+         num_threads,
+         0,
+         context->cuda_stream()>>>(
+          num_blocks, block_size, blocks_dims, X, Y);
+  return true;
+}
+
+} // namespace
+
+#define CAFFE2_CUDA_TRANSPOSE_CONTIGUOUS_BLOCKS(T)                      \
+  template <>                                                           \
+  bool TransposeContiguousBlocks<T, CUDAContext>(                       \
+      const std::vector<int>& dims,                                     \
+      const std::vector<int>& axes,                                     \
+      const T* X,                                                       \
+      T* Y,                                                             \
+      CUDAContext* context) {                                           \
+    return TransposeContiguousBlocksCUDA<T>(dims, axes, X, Y, context); \
+  }
+CAFFE2_CUDA_TRANSPOSE_CONTIGUOUS_BLOCKS(float)
+CAFFE2_CUDA_TRANSPOSE_CONTIGUOUS_BLOCKS(double)
+CAFFE2_CUDA_TRANSPOSE_CONTIGUOUS_BLOCKS(int)
+CAFFE2_CUDA_TRANSPOSE_CONTIGUOUS_BLOCKS(long)
+#undef CAFFE2_CUDA_TRANSPOSE_CONTIGUOUS_BLOCKS
+
 REGISTER_CUDA_OPERATOR(Transpose, TransposeOp<CUDAContext>);
 
 } // namespace caffe2
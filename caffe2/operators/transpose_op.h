@@ -8,6 +8,18 @@
 
 namespace caffe2 {
 
+// Transposes X into Y by the dims and axes reduced by
+// math::ComputeTransposeDims, if the innermost reduced axis stays in place,
+// by copying its contiguous blocks. Returns false otherwise, or for a
+// Context whose math::Transpose already does so (CPU).
+template <typename T, class Context>
+bool TransposeContiguousBlocks(
+    const std::vector<int>& dims,
+    const std::vector<int>& axes,
+    const T* X,
+    T* Y,
+    Context* context);
+
 template <class Context>
 class TransposeOp final : public Operator<Context> {
  public:
@@ -46,9 +58,10 @@ class TransposeOp final : public Operator<Context> {
       }
     }
     Y->Resize(y_dims);
-    SetDeviceTensor(x_dims, &x_dims_device_);
-    SetDeviceTensor(y_dims, &y_dims_device_);
-    SetDeviceTensor(axes_, &axes_device_);
+    math::ComputeTransposeDims(
+        num_axes, x_dims.data(), axes_.data(), &reduced_dims_, &reduced_axes_);
+    x_dims_ = x_dims;
+    y_dims_ = y_dims;
 
     // Do the actual transpose, which is implemented in DoRunWithType().
     return DispatchHelper<TensorTypes<float, double, int, long>>::call(
@@ -66,6 +79,17 @@ class TransposeOp final : public Operator<Context> {
   bool DoRunWithType() {
     const auto& X = Input(0);
     auto* Y = Output(0);
+    if (TransposeContiguousBlocks<T, Context>(
+            reduced_dims_,
+            reduced_axes_,
+            X.template data<T>(),
+            Y->template mutable_data<T>(),
+            &context_)) {
+      return true;
+    }
+    SetDeviceTensor(x_dims_, &x_dims_device_);
+    SetDeviceTensor(y_dims_, &y_dims_device_);
+    SetDeviceTensor(axes_, &axes_device_);
     math::Transpose<T, Context>(
         axes_.size(),
         x_dims_device_.template data<int>(),
@@ -79,6 +103,10 @@ class TransposeOp final : public Operator<Context> {
   }
 
   std::vector<int> axes_;
+  std::vector<int> x_dims_;
+  std::vector<int> y_dims_;
+  std::vector<int> reduced_dims_;
+  std::vector<int> reduced_axes_;
 
   Tensor<Context> x_dims_device_;
   Tensor<Context> y_dims_device_;
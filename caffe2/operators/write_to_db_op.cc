@@ -0,0 +1,43 @@
+#include "caffe2/operators/write_to_db_op.h"
+
+namespace caffe2 {
+
+REGISTER_CPU_OPERATOR(WriteToDB, WriteToDBOp<CPUContext>);
+
+OPERATOR_SCHEMA(WriteToDB)
+    .NumInputs(1, INT_MAX)
+    .NumOutputs(0)
+    .SetDoc(R"DOC(
+Writes a record per item of a batch to a new db, e.g. the features or the
+predictions of the clips of a test net, without fetching them to python. The
+key of an item is its video id and a running number of the op, zero padded,
+so that the records of a video are next to each other; items with a negative
+video id, the padding of a last batch, are skipped. The value is a
+TensorProtos of the slices of the item of all the inputs, the video id first,
+which TensorProtosDBInput reads back.
+
+The op serializes the records and queues them to a writer thread, which puts
+them to the db in transactions of transaction_size records, the last ones
+when the op is destroyed. The op waits when max_pending records are queued.
+The stats records_written, bytes_written, pending_records, commit_time_ns and
+backpressure_wait_time_ns are named after the second input.
+)DOC")
+    .Arg("db", "(string) the db to create")
+    .Arg("db_type", "(string, default 'lmdb') the type of the db")
+    .Arg(
+        "absolute_path",
+        "(bool, default false) whether db is an absolute path, instead of "
+        "one in the root folder of the workspace")
+    .Arg(
+        "transaction_size",
+        "(int, default 1000) the records of a transaction of the writer")
+    .Arg(
+        "max_pending",
+        "(int, default 10000) the records queued before the op waits for "
+        "the writer")
+    .Input(0, "video_ids", "the int or int64 video ids of the N items")
+    .Input(1, "X", "(optional) tensors of N items to write, any number");
+
+SHOULD_NOT_DO_GRADIENT(WriteToDB);
+
+} // namespace caffe2
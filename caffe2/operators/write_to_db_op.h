@@ -0,0 +1,252 @@
+#ifndef CAFFE2_OPERATORS_WRITE_TO_DB_OP_H_
+#define CAFFE2_OPERATORS_WRITE_TO_DB_OP_H_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/blob_serialization.h"
+#include "caffe2/core/context.h"
+#include "caffe2/core/db.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/stats.h"
+#include "caffe2/core/timer.h"
+
+namespace caffe2 {
+
+// Writes a record per item of a batch to a db, e.g. the features or the
+// predictions of the clips of the test net: the key is the video id of the
+// item and a running number, and the value a TensorProtos of the slices of
+// the item of all the inputs, in the order of the inputs, which
+// TensorProtosDBInput reads back. The records are serialized by the op and
+// queued to a writer thread, which puts them to the db in transactions of
+// transaction_size records, so that the net does not wait for the disk;
+// when max_pending records are queued, the op waits for the writer.
+template <class Context>
+class WriteToDBOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  WriteToDBOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        db_name_(OperatorBase::GetSingleArgument<string>("db", "")),
+        db_type_(OperatorBase::GetSingleArgument<string>("db_type", "lmdb")),
+        transaction_size_(OperatorBase::GetSingleArgument<int>(
+            "transaction_size",
+            1000)),
+        max_pending_(
+            OperatorBase::GetSingleArgument<int>("max_pending", 10000)),
+        blob_names_(operator_def.input().begin(), operator_def.input().end()),
+        host_tensors_(operator_def.input_size()),
+        finished_(false),
+        next_record_(0),
+        stats_(operator_def.input_size() > 1 ? operator_def.input(1) : "") {
+    CAFFE_ENFORCE_GT(db_name_.size(), 0, "Must specify a db name.");
+    CAFFE_ENFORCE_GT(transaction_size_, 0);
+    CAFFE_ENFORCE_GE(max_pending_, transaction_size_);
+    string full_db_name = db_name_;
+    if (!OperatorBase::GetSingleArgument<int>("absolute_path", false)) {
+      full_db_name = ws->RootFolder() + "/" + db_name_;
+    }
+    db_ = db::CreateDB(db_type_, full_db_name, db::NEW);
+    CAFFE_ENFORCE(db_.get(), "Cannot open db for writing: ", full_db_name);
+    writer_ = std::thread(&WriteToDBOp::WriterLoop, this);
+  }
+
+  ~WriteToDBOp() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      finished_ = true;
+    }
+    not_empty_.notify_all();
+    writer_.join();
+    if (error_) {
+      try {
+        std::rethrow_exception(error_);
+      } catch (const std::exception& e) {
+        LOG(ERROR) << "Writing " << db_name_ << " failed: " << e.what();
+      }
+    }
+    db_->Close();
+  }
+
+  bool RunOnDevice() override {
+    const int num_inputs = InputSize();
+    // the inputs on the host, copied once from the device
+    std::vector<const TensorCPU*> inputs(num_inputs);
+    for (int i = 0; i < num_inputs; ++i) {
+      const Blob& blob = *OperatorBase::Inputs()[i];
+      if (blob.template IsType<TensorCPU>()) {
+        inputs[i] = &blob.template Get<TensorCPU>();
+      } else {
+        host_tensors_[i].CopyFrom(
+            blob.template Get<Tensor<Context>>(), &context_);
+        inputs[i] = &host_tensors_[i];
+      }
+    }
+    context_.FinishDeviceComputation();
+
+    const TensorCPU& video_ids = *inputs[0];
+    const int64_t num_items = video_ids.size();
+    for (int i = 1; i < num_inputs; ++i) {
+      CAFFE_ENFORCE(
+          inputs[i]->ndim() > 0 && inputs[i]->dim(0) == num_items,
+          "Input ",
+          blob_names_[i],
+          " is not a batch of the ",
+          num_items,
+          " video ids");
+    }
+
+    TensorSerializer<CPUContext> serializer;
+    std::vector<Record> records;
+    for (int64_t item = 0; item < num_items; ++item) {
+      const int64_t video_id = VideoId(video_ids, item);
+      // the padding of the last batch
+      if (video_id < 0) {
+        continue;
+      }
+      TensorProtos protos;
+      for (int i = 0; i < num_inputs; ++i) {
+        const TensorCPU& input = *inputs[i];
+        const size_t item_size = input.size() / std::max<TIndex>(1, num_items);
+        TensorProto* proto = protos.add_protos();
+        serializer.Serialize(
+            input, blob_names_[i], proto, item * item_size, item_size);
+        // the item, instead of a segment of the batch
+        proto->clear_dims();
+        for (int d = 1; d < input.ndim(); ++d) {
+          proto->add_dims(input.dim(d));
+        }
+        proto->clear_segment();
+        proto->clear_device_detail();
+        proto->set_name(blob_names_[i]);
+      }
+      char key[32];
+      snprintf(
+          key,
+          sizeof(key),
+          "%010lld_%012lld",
+          static_cast<long long>(video_id),
+          static_cast<long long>(next_record_++));
+      records.push_back(Record{key, protos.SerializeAsString()});
+    }
+
+    Timer timer;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (auto& record : records) {
+      // backpressure: wait for the writer to catch up
+      not_full_.wait(lock, [this]() {
+        return queue_.size() < max_pending_ || error_;
+      });
+      if (error_) {
+        std::rethrow_exception(error_);
+      }
+      queue_.push_back(std::move(record));
+      CAFFE_EVENT(stats_, pending_records, 1);
+    }
+    lock.unlock();
+    CAFFE_EVENT(stats_, backpressure_wait_time_ns, timer.NanoSeconds());
+    not_empty_.notify_one();
+    return true;
+  }
+
+ private:
+  struct Record {
+    string key;
+    string value;
+  };
+
+  static int64_t VideoId(const TensorCPU& video_ids, int64_t item) {
+    if (video_ids.template IsType<int64_t>()) {
+      return video_ids.template data<int64_t>()[item];
+    }
+    CAFFE_ENFORCE(
+        video_ids.template IsType<int>(), "The video ids are not integers");
+    return video_ids.template data<int>()[item];
+  }
+
+  // Puts the queued records to the db in transactions of transaction_size_
+  // records, and the rest once the op is destroyed.
+  void WriterLoop() {
+    try {
+      auto transaction = db_->NewTransaction();
+      std::vector<Record> batch;
+      while (true) {
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          not_empty_.wait(lock, [this]() {
+            return queue_.size() >= transaction_size_ || finished_;
+          });
+          if (queue_.empty()) {
+            return;
+          }
+          const size_t n = std::min<size_t>(queue_.size(), transaction_size_);
+          batch.clear();
+          for (size_t i = 0; i < n; ++i) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+          }
+        }
+        not_full_.notify_all();
+        CAFFE_EVENT(
+            stats_, pending_records, -static_cast<int64_t>(batch.size()));
+
+        Timer timer;
+        int64_t bytes = 0;
+        for (const auto& record : batch) {
+          transaction->Put(record.key, record.value);
+          bytes += record.value.size();
+        }
+        transaction->Commit();
+        CAFFE_EVENT(stats_, commit_time_ns, timer.NanoSeconds());
+        CAFFE_EVENT(stats_, records_written, batch.size());
+        CAFFE_EVENT(stats_, bytes_written, bytes);
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      error_ = std::current_exception();
+      not_full_.notify_all();
+    }
+  }
+
+  string db_name_;
+  string db_type_;
+  size_t transaction_size_;
+  size_t max_pending_;
+  std::vector<string> blob_names_;
+  std::vector<TensorCPU> host_tensors_;
+  std::unique_ptr<db::DB> db_;
+
+  // the records serialized by the op and not yet put to the db
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<Record> queue_;
+  bool finished_;
+  std::exception_ptr error_;
+  int64_t next_record_;
+  std::thread writer_;
+
+  // named after the first tensor written after the video ids, e.g.
+  // gpu_0/pred/records_written
+  struct WriteToDBStats {
+    CAFFE_STAT_CTOR(WriteToDBStats);
+    // records queued and not yet put to the db
+    CAFFE_EXPORTED_STAT(pending_records);
+    CAFFE_EXPORTED_STAT(records_written);
+    CAFFE_EXPORTED_STAT(bytes_written);
+    // time of a transaction of the writer, and the time the op waited for
+    // the writer to take its records
+    CAFFE_AVG_EXPORTED_STAT(commit_time_ns);
+    CAFFE_AVG_EXPORTED_STAT(backpressure_wait_time_ns);
+  } stats_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_OPERATORS_WRITE_TO_DB_OP_H_
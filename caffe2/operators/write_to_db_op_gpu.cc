@@ -0,0 +1,6 @@
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/operators/write_to_db_op.h"
+
+namespace caffe2 {
+REGISTER_CUDA_OPERATOR(WriteToDB, WriteToDBOp<CUDAContext>);
+} // namespace caffe2
@@ -0,0 +1,73 @@
+#include <cstdio>
+#include <memory>
+
+#include <gtest/gtest.h>
+#include "caffe2/core/blob_serialization.h"
+#include "caffe2/core/db.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+TEST(WriteToDBTest, WritesARecordPerItem) {
+  const string name = std::tmpnam(nullptr);
+  Workspace ws;
+  OperatorDef def;
+  def.set_type("WriteToDB");
+  def.add_input("video_ids");
+  def.add_input("pred");
+  AddArgument("db", name, &def);
+  AddArgument("db_type", string("leveldb"), &def);
+  AddArgument("absolute_path", 1, &def);
+  AddArgument("transaction_size", 2, &def);
+  AddArgument("max_pending", 2, &def);
+
+  auto* video_ids = ws.CreateBlob("video_ids")->GetMutable<TensorCPU>();
+  video_ids->Resize(3);
+  auto* pred = ws.CreateBlob("pred")->GetMutable<TensorCPU>();
+  pred->Resize(3, 2);
+  {
+    unique_ptr<OperatorBase> op(CreateOperator(def, &ws));
+    ASSERT_NE(nullptr, op.get());
+    for (int batch = 0; batch < 2; ++batch) {
+      int* ids = video_ids->mutable_data<int>();
+      float* data = pred->mutable_data<float>();
+      for (int i = 0; i < 3; ++i) {
+        // the last item of the second batch is padding
+        ids[i] = batch == 1 && i == 2 ? -1 : 10 * batch + i;
+        data[2 * i] = ids[i];
+        data[2 * i + 1] = -ids[i];
+      }
+      EXPECT_TRUE(op->Run());
+    }
+    // destroying the op commits the last records
+  }
+
+  db::DBReader reader("leveldb", name);
+  TensorDeserializer<CPUContext> deserializer;
+  const int expected_ids[] = {0, 1, 2, 10, 11};
+  string key;
+  string value;
+  for (int i = 0; i < 5; ++i) {
+    reader.Read(&key, &value);
+    TensorProtos protos;
+    ASSERT_TRUE(protos.ParseFromString(value));
+    ASSERT_EQ(protos.protos_size(), 2);
+    TensorCPU id;
+    deserializer.Deserialize(protos.protos(0), &id);
+    EXPECT_EQ(id.ndim(), 0);
+    EXPECT_EQ(id.data<int>()[0], expected_ids[i]);
+    TensorCPU item;
+    deserializer.Deserialize(protos.protos(1), &item);
+    EXPECT_EQ(protos.protos(1).name(), "pred");
+    ASSERT_EQ(item.ndim(), 1);
+    EXPECT_EQ(item.dim(0), 2);
+    EXPECT_EQ(item.data<float>()[0], expected_ids[i]);
+    EXPECT_EQ(item.data<float>()[1], -expected_ids[i]);
+  }
+  // and back to the first
+  reader.Read(&key, &value);
+  EXPECT_EQ(key.substr(0, 10), "0000000000");
+}
+
+} // namespace caffe2
@@ -0,0 +1,98 @@
+#include "caffe2/perfkernels/affine_nd.h"
+#include "caffe2/perfkernels/common.h"
+#include "caffe2/utils/cpuid.h"
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif // __ARM_NEON__
+
+namespace caffe2 {
+
+namespace {
+
+template <bool kBias>
+void AffineNdPixelsImpl(
+    const float* x,
+    const int num_pixels,
+    const int channels,
+    const float* scale,
+    const float* bias,
+    float* y) {
+  for (int i = 0; i < num_pixels; ++i) {
+    const float* xi = x + i * channels;
+    float* yi = y + i * channels;
+    int c = 0;
+#ifdef __ARM_NEON__
+    for (; c + 4 <= channels; c += 4) {
+      float32x4_t v = vmulq_f32(vld1q_f32(xi + c), vld1q_f32(scale + c));
+      if (kBias) {
+        v = vaddq_f32(v, vld1q_f32(bias + c));
+      }
+      vst1q_f32(yi + c, v);
+    }
+#endif // __ARM_NEON__
+    for (; c < channels; ++c) {
+      yi[c] = kBias ? xi[c] * scale[c] + bias[c] : xi[c] * scale[c];
+    }
+  }
+}
+
+} // namespace
+
+void AffineNdPlane__base(
+    const float* x,
+    const int n,
+    const float scale,
+    const float bias,
+    float* y) {
+  int i = 0;
+#ifdef __ARM_NEON__
+  const float32x4_t vscale = vdupq_n_f32(scale);
+  const float32x4_t vbias = vdupq_n_f32(bias);
+  for (; i + 4 <= n; i += 4) {
+    vst1q_f32(y + i, vaddq_f32(vmulq_f32(vld1q_f32(x + i), vscale), vbias));
+  }
+#endif // __ARM_NEON__
+  for (; i < n; ++i) {
+    y[i] = x[i] * scale + bias;
+  }
+}
+
+void AffineNdPlane(
+    const float* x,
+    const int n,
+    const float scale,
+    const float bias,
+    float* y) {
+  AVX512_DO(AffineNdPlane, x, n, scale, bias, y);
+  AVX2_FMA_DO(AffineNdPlane, x, n, scale, bias, y);
+  BASE_DO(AffineNdPlane, x, n, scale, bias, y);
+}
+
+void AffineNdPixels__base(
+    const float* x,
+    const int num_pixels,
+    const int channels,
+    const float* scale,
+    const float* bias,
+    float* y) {
+  if (bias) {
+    AffineNdPixelsImpl<true>(x, num_pixels, channels, scale, bias, y);
+  } else {
+    AffineNdPixelsImpl<false>(x, num_pixels, channels, scale, bias, y);
+  }
+}
+
+void AffineNdPixels(
+    const float* x,
+    const int num_pixels,
+    const int channels,
+    const float* scale,
+    const float* bias,
+    float* y) {
+  AVX512_DO(AffineNdPixels, x, num_pixels, channels, scale, bias, y);
+  AVX2_FMA_DO(AffineNdPixels, x, num_pixels, channels, scale, bias, y);
+  BASE_DO(AffineNdPixels, x, num_pixels, channels, scale, bias, y);
+}
+
+} // namespace caffe2
@@ -0,0 +1,25 @@
+#pragma once
+
+namespace caffe2 {
+
+// y = x * scale + bias over the n values of one (n, c) plane of an NCHW
+// AffineNd. x and y may be the same.
+void AffineNdPlane(
+    const float* x,
+    const int n,
+    const float scale,
+    const float bias,
+    float* y);
+
+// y = x * scale + bias channelwise over num_pixels pixels of channels values
+// each, as an NHWC AffineNd does; with a null bias y = x * scale, as its
+// gradient does. x and y may be the same.
+void AffineNdPixels(
+    const float* x,
+    const int num_pixels,
+    const int channels,
+    const float* scale,
+    const float* bias,
+    float* y);
+
+} // namespace caffe2
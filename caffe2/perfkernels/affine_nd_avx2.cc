@@ -0,0 +1,80 @@
+#include "caffe2/perfkernels/affine_nd.h"
+
+#include <immintrin.h>
+
+namespace caffe2 {
+
+namespace {
+
+template <bool kBias>
+void AffineNdPixelsAVX2Impl(
+    const float* x,
+    const int num_pixels,
+    const int channels,
+    const float* scale,
+    const float* bias,
+    float* y) {
+  for (int i = 0; i < num_pixels; ++i) {
+    const float* xi = x + i * channels;
+    float* yi = y + i * channels;
+    int c = 0;
+    // scale and bias stay in L1 across the pixels
+    for (; c + 8 <= channels; c += 8) {
+      const __m256 v = _mm256_loadu_ps(xi + c);
+      const __m256 s = _mm256_loadu_ps(scale + c);
+      _mm256_storeu_ps(
+          yi + c,
+          kBias ? _mm256_fmadd_ps(v, s, _mm256_loadu_ps(bias + c))
+                : _mm256_mul_ps(v, s));
+    }
+    for (; c < channels; ++c) {
+      yi[c] = kBias ? xi[c] * scale[c] + bias[c] : xi[c] * scale[c];
+    }
+  }
+}
+
+} // namespace
+
+void AffineNdPlane__avx2_fma(
+    const float* x,
+    const int n,
+    const float scale,
+    const float bias,
+    float* y) {
+  const __m256 vscale = _mm256_set1_ps(scale);
+  const __m256 vbias = _mm256_set1_ps(bias);
+  int i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const __m256 v0 = _mm256_loadu_ps(x + i);
+    const __m256 v1 = _mm256_loadu_ps(x + i + 8);
+    const __m256 v2 = _mm256_loadu_ps(x + i + 16);
+    const __m256 v3 = _mm256_loadu_ps(x + i + 24);
+    _mm256_storeu_ps(y + i, _mm256_fmadd_ps(v0, vscale, vbias));
+    _mm256_storeu_ps(y + i + 8, _mm256_fmadd_ps(v1, vscale, vbias));
+    _mm256_storeu_ps(y + i + 16, _mm256_fmadd_ps(v2, vscale, vbias));
+    _mm256_storeu_ps(y + i + 24, _mm256_fmadd_ps(v3, vscale, vbias));
+  }
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(
+        y + i, _mm256_fmadd_ps(_mm256_loadu_ps(x + i), vscale, vbias));
+  }
+  for (; i < n; ++i) {
+    y[i] = x[i] * scale + bias;
+  }
+}
+
+void AffineNdPixels__avx2_fma(
+    const float* x,
+    const int num_pixels,
+    const int channels,
+    const float* scale,
+    const float* bias,
+    float* y) {
+  if (bias) {
+    AffineNdPixelsAVX2Impl<true>(x, num_pixels, channels, scale, bias, y);
+  } else {
+    AffineNdPixelsAVX2Impl<false>(x, num_pixels, channels, scale, bias, y);
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,93 @@
+#include "caffe2/perfkernels/affine_nd.h"
+
+#include <immintrin.h>
+
+namespace caffe2 {
+
+namespace {
+
+template <bool kBias>
+void AffineNdPixelsAVX512Impl(
+    const float* x,
+    const int num_pixels,
+    const int channels,
+    const float* scale,
+    const float* bias,
+    float* y) {
+  // the channels past the last full vector go through a mask, so in NHWC a
+  // pixel of 8, 24 or 48 channels takes no scalar step
+  const int full = channels / 16 * 16;
+  const __mmask16 tail = (1 << (channels - full)) - 1;
+  for (int i = 0; i < num_pixels; ++i) {
+    const float* xi = x + i * channels;
+    float* yi = y + i * channels;
+    for (int c = 0; c < full; c += 16) {
+      const __m512 v = _mm512_loadu_ps(xi + c);
+      const __m512 s = _mm512_loadu_ps(scale + c);
+      _mm512_storeu_ps(
+          yi + c,
+          kBias ? _mm512_fmadd_ps(v, s, _mm512_loadu_ps(bias + c))
+                : _mm512_mul_ps(v, s));
+    }
+    if (tail) {
+      const __m512 v = _mm512_maskz_loadu_ps(tail, xi + full);
+      const __m512 s = _mm512_maskz_loadu_ps(tail, scale + full);
+      _mm512_mask_storeu_ps(
+          yi + full,
+          tail,
+          kBias ? _mm512_fmadd_ps(
+                      v, s, _mm512_maskz_loadu_ps(tail, bias + full))
+                : _mm512_mul_ps(v, s));
+    }
+  }
+}
+
+} // namespace
+
+void AffineNdPlane__avx512(
+    const float* x,
+    const int n,
+    const float scale,
+    const float bias,
+    float* y) {
+  const __m512 vscale = _mm512_set1_ps(scale);
+  const __m512 vbias = _mm512_set1_ps(bias);
+  int i = 0;
+  for (; i + 64 <= n; i += 64) {
+    const __m512 v0 = _mm512_loadu_ps(x + i);
+    const __m512 v1 = _mm512_loadu_ps(x + i + 16);
+    const __m512 v2 = _mm512_loadu_ps(x + i + 32);
+    const __m512 v3 = _mm512_loadu_ps(x + i + 48);
+    _mm512_storeu_ps(y + i, _mm512_fmadd_ps(v0, vscale, vbias));
+    _mm512_storeu_ps(y + i + 16, _mm512_fmadd_ps(v1, vscale, vbias));
+    _mm512_storeu_ps(y + i + 32, _mm512_fmadd_ps(v2, vscale, vbias));
+    _mm512_storeu_ps(y + i + 48, _mm512_fmadd_ps(v3, vscale, vbias));
+  }
+  for (; i + 16 <= n; i += 16) {
+    _mm512_storeu_ps(
+        y + i, _mm512_fmadd_ps(_mm512_loadu_ps(x + i), vscale, vbias));
+  }
+  if (i < n) {
+    const __mmask16 tail = (1 << (n - i)) - 1;
+    _mm512_mask_storeu_ps(
+        y + i,
+        tail,
+        _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, x + i), vscale, vbias));
+  }
+}
+
+void AffineNdPixels__avx512(
+    const float* x,
+    const int num_pixels,
+    const int channels,
+    const float* scale,
+    const float* bias,
+    float* y) {
+  if (bias) {
+    AffineNdPixelsAVX512Impl<true>(x, num_pixels, channels, scale, bias, y);
+  } else {
+    AffineNdPixelsAVX512Impl<false>(x, num_pixels, channels, scale, bias, y);
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,366 @@
+#include "caffe2/perfkernels/clip_transform.h"
+#include "caffe2/perfkernels/common.h"
+#include "caffe2/utils/cpuid.h"
+
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif // __ARM_NEON__
+
+namespace caffe2 {
+
+namespace {
+
+#ifdef __ARM_NEON__
+inline float32x4_t NormalizeNeon(
+    uint16x4_t x,
+    float32x4_t mean,
+    float32x4_t inv_std) {
+  return vmulq_f32(vsubq_f32(vcvtq_f32_u32(vmovl_u16(x)), mean), inv_std);
+}
+
+inline float32x4_t ReverseNeon(float32x4_t x) {
+  // vrev64q swaps within the 64-bit halves, then swap the halves
+  x = vrev64q_f32(x);
+  return vcombine_f32(vget_high_f32(x), vget_low_f32(x));
+}
+
+// NEON has no gather: the four taps go through the stack
+inline float32x4_t LoadTapsNeon(const std::uint8_t* row, const int* idx) {
+  const float taps[4] = {static_cast<float>(row[idx[0]]),
+                         static_cast<float>(row[idx[1]]),
+                         static_cast<float>(row[idx[2]]),
+                         static_cast<float>(row[idx[3]])};
+  return vld1q_f32(taps);
+}
+
+inline void StorePlaneNeon(uint8x16_t x, std::uint8_t* y) {
+  vst1q_u8(y, x);
+}
+
+inline void StorePlaneNeon(uint8x16_t x, float* y) {
+  uint16x8_t lo = vmovl_u8(vget_low_u8(x));
+  uint16x8_t hi = vmovl_u8(vget_high_u8(x));
+  vst1q_f32(y, vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))));
+  vst1q_f32(y + 4, vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))));
+  vst1q_f32(y + 8, vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))));
+  vst1q_f32(y + 12, vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))));
+}
+#endif // __ARM_NEON__
+
+template <bool kMirror>
+void NormalizeRow(
+    const std::uint8_t* x,
+    const int n,
+    const float mean,
+    const float inv_std,
+    float* y) {
+  int w = 0;
+#ifdef __ARM_NEON__
+  const float32x4_t vmean = vdupq_n_f32(mean);
+  const float32x4_t vinv_std = vdupq_n_f32(inv_std);
+  for (; w + 8 <= n; w += 8) {
+    uint16x8_t x16 = vmovl_u8(vld1_u8(x + w));
+    float32x4_t lo = NormalizeNeon(vget_low_u16(x16), vmean, vinv_std);
+    float32x4_t hi = NormalizeNeon(vget_high_u16(x16), vmean, vinv_std);
+    if (kMirror) {
+      vst1q_f32(y + n - w - 4, ReverseNeon(lo));
+      vst1q_f32(y + n - w - 8, ReverseNeon(hi));
+    } else {
+      vst1q_f32(y + w, lo);
+      vst1q_f32(y + w + 4, hi);
+    }
+  }
+#endif // __ARM_NEON__
+  for (; w < n; ++w) {
+    y[kMirror ? n - 1 - w : w] = (static_cast<float>(x[w]) - mean) * inv_std;
+  }
+}
+
+template <bool kMirror>
+void ClipTransformUint8Impl(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int h_off,
+    const int w_off,
+    const int h_crop,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  for (int c = 0; c < channels; ++c) {
+    const int src_c = reverse_channels ? channels - c - 1 : c;
+    for (int l = 0; l < length; ++l) {
+      const std::uint8_t* src =
+          clip + ((src_c * length + l) * height + h_off) * width + w_off;
+      float* dst = transformed_clip + (c * length + l) * h_crop * w_crop;
+      for (int h = 0; h < h_crop; ++h) {
+        NormalizeRow<kMirror>(
+            src + h * width, w_crop, mean, inv_std, dst + h * w_crop);
+      }
+    }
+  }
+}
+
+template <bool kMirror>
+void BilinearRow(
+    const std::uint8_t* row0,
+    const std::uint8_t* row1,
+    const float wy,
+    const int* x0,
+    const int* x1,
+    const float* fx,
+    const int n,
+    const float mean,
+    const float inv_std,
+    float* y) {
+  int w = 0;
+#ifdef __ARM_NEON__
+  const float32x4_t vwy = vdupq_n_f32(wy);
+  const float32x4_t vmean = vdupq_n_f32(mean);
+  const float32x4_t vinv_std = vdupq_n_f32(inv_std);
+  for (; w + 4 <= n; w += 4) {
+    const float32x4_t wx = vld1q_f32(fx + w);
+    const float32x4_t p00 = LoadTapsNeon(row0, x0 + w);
+    const float32x4_t p01 = LoadTapsNeon(row0, x1 + w);
+    const float32x4_t p10 = LoadTapsNeon(row1, x0 + w);
+    const float32x4_t p11 = LoadTapsNeon(row1, x1 + w);
+    const float32x4_t top =
+        vaddq_f32(p00, vmulq_f32(vsubq_f32(p01, p00), wx));
+    const float32x4_t bottom =
+        vaddq_f32(p10, vmulq_f32(vsubq_f32(p11, p10), wx));
+    const float32x4_t value =
+        vaddq_f32(top, vmulq_f32(vsubq_f32(bottom, top), vwy));
+    const float32x4_t v = vmulq_f32(vsubq_f32(value, vmean), vinv_std);
+    if (kMirror) {
+      vst1q_f32(y + n - w - 4, ReverseNeon(v));
+    } else {
+      vst1q_f32(y + w, v);
+    }
+  }
+#endif // __ARM_NEON__
+  for (; w < n; ++w) {
+    const float wx = fx[w];
+    const float top = row0[x0[w]] + (row0[x1[w]] - row0[x0[w]]) * wx;
+    const float bottom = row1[x0[w]] + (row1[x1[w]] - row1[x0[w]]) * wx;
+    const float value = top + (bottom - top) * wy;
+    y[kMirror ? n - 1 - w : w] = (value - mean) * inv_std;
+  }
+}
+
+template <bool kMirror>
+void BilinearClipTransformUint8Impl(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int* y0,
+    const int* y1,
+    const float* fy,
+    const int h_crop,
+    const int* x0,
+    const int* x1,
+    const float* fx,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  for (int c = 0; c < channels; ++c) {
+    const int src_c = reverse_channels ? channels - c - 1 : c;
+    for (int l = 0; l < length; ++l) {
+      const std::uint8_t* src = clip + (src_c * length + l) * height * width;
+      float* dst = transformed_clip + (c * length + l) * h_crop * w_crop;
+      for (int h = 0; h < h_crop; ++h) {
+        BilinearRow<kMirror>(
+            src + y0[h] * width, src + y1[h] * width, fy[h], x0, x1, fx,
+            w_crop, mean, inv_std, dst + h * w_crop);
+      }
+    }
+  }
+}
+
+template <typename T>
+void PackedRGBToPlanarImpl(
+    const std::uint8_t* packed,
+    const int num_pixels,
+    const int plane_stride,
+    T* planar) {
+  T* p0 = planar;
+  T* p1 = planar + plane_stride;
+  T* p2 = planar + 2 * plane_stride;
+  int i = 0;
+#ifdef __ARM_NEON__
+  for (; i + 16 <= num_pixels; i += 16) {
+    uint8x16x3_t v = vld3q_u8(packed + 3 * i);
+    StorePlaneNeon(v.val[0], p0 + i);
+    StorePlaneNeon(v.val[1], p1 + i);
+    StorePlaneNeon(v.val[2], p2 + i);
+  }
+#endif // __ARM_NEON__
+  for (; i < num_pixels; ++i) {
+    p0[i] = static_cast<T>(packed[3 * i]);
+    p1[i] = static_cast<T>(packed[3 * i + 1]);
+    p2[i] = static_cast<T>(packed[3 * i + 2]);
+  }
+}
+
+} // namespace
+
+void ClipTransformUint8__base(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int h_off,
+    const int w_off,
+    const int h_crop,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool mirror,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  if (mirror) {
+    ClipTransformUint8Impl<true>(
+        clip, channels, length, height, width, h_off, w_off, h_crop, w_crop,
+        mean, inv_std, reverse_channels, transformed_clip);
+  } else {
+    ClipTransformUint8Impl<false>(
+        clip, channels, length, height, width, h_off, w_off, h_crop, w_crop,
+        mean, inv_std, reverse_channels, transformed_clip);
+  }
+}
+
+void ClipTransformUint8(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int h_off,
+    const int w_off,
+    const int h_crop,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool mirror,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  AVX512_DO(
+      ClipTransformUint8,
+      clip, channels, length, height, width, h_off, w_off, h_crop, w_crop,
+      mean, inv_std, mirror, reverse_channels, transformed_clip);
+  AVX2_DO(
+      ClipTransformUint8,
+      clip, channels, length, height, width, h_off, w_off, h_crop, w_crop,
+      mean, inv_std, mirror, reverse_channels, transformed_clip);
+  BASE_DO(
+      ClipTransformUint8,
+      clip, channels, length, height, width, h_off, w_off, h_crop, w_crop,
+      mean, inv_std, mirror, reverse_channels, transformed_clip);
+}
+
+void BilinearClipTransformUint8__base(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int* y0,
+    const int* y1,
+    const float* fy,
+    const int h_crop,
+    const int* x0,
+    const int* x1,
+    const float* fx,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool mirror,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  if (mirror) {
+    BilinearClipTransformUint8Impl<true>(
+        clip, channels, length, height, width, y0, y1, fy, h_crop, x0, x1, fx,
+        w_crop, mean, inv_std, reverse_channels, transformed_clip);
+  } else {
+    BilinearClipTransformUint8Impl<false>(
+        clip, channels, length, height, width, y0, y1, fy, h_crop, x0, x1, fx,
+        w_crop, mean, inv_std, reverse_channels, transformed_clip);
+  }
+}
+
+void BilinearClipTransformUint8(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int* y0,
+    const int* y1,
+    const float* fy,
+    const int h_crop,
+    const int* x0,
+    const int* x1,
+    const float* fx,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool mirror,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  AVX512_DO(
+      BilinearClipTransformUint8,
+      clip, channels, length, height, width, y0, y1, fy, h_crop, x0, x1, fx,
+      w_crop, mean, inv_std, mirror, reverse_channels, transformed_clip);
+  AVX2_DO(
+      BilinearClipTransformUint8,
+      clip, channels, length, height, width, y0, y1, fy, h_crop, x0, x1, fx,
+      w_crop, mean, inv_std, mirror, reverse_channels, transformed_clip);
+  BASE_DO(
+      BilinearClipTransformUint8,
+      clip, channels, length, height, width, y0, y1, fy, h_crop, x0, x1, fx,
+      w_crop, mean, inv_std, mirror, reverse_channels, transformed_clip);
+}
+
+void PackedRGBToPlanarFloat__base(
+    const std::uint8_t* packed,
+    const int num_pixels,
+    const int plane_stride,
+    float* planar) {
+  PackedRGBToPlanarImpl(packed, num_pixels, plane_stride, planar);
+}
+
+void PackedRGBToPlanarFloat(
+    const std::uint8_t* packed,
+    const int num_pixels,
+    const int plane_stride,
+    float* planar) {
+  AVX2_DO(PackedRGBToPlanarFloat, packed, num_pixels, plane_stride, planar);
+  BASE_DO(PackedRGBToPlanarFloat, packed, num_pixels, plane_stride, planar);
+}
+
+void PackedRGBToPlanarUint8__base(
+    const std::uint8_t* packed,
+    const int num_pixels,
+    const int plane_stride,
+    std::uint8_t* planar) {
+  PackedRGBToPlanarImpl(packed, num_pixels, plane_stride, planar);
+}
+
+void PackedRGBToPlanarUint8(
+    const std::uint8_t* packed,
+    const int num_pixels,
+    const int plane_stride,
+    std::uint8_t* planar) {
+  AVX2_DO(PackedRGBToPlanarUint8, packed, num_pixels, plane_stride, planar);
+  BASE_DO(PackedRGBToPlanarUint8, packed, num_pixels, plane_stride, planar);
+}
+
+} // namespace caffe2
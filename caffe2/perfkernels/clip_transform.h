@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+
+namespace caffe2 {
+
+// Crops the h_crop x w_crop window at (h_off, w_off) out of every frame of a
+// planar uint8 clip laid out as channels x length x height x width, and
+// writes it to transformed_clip (channels x length x h_crop x w_crop) as
+// (x - mean) * inv_std. With mirror the window is flipped horizontally, with
+// reverse_channels the channel order is reversed (RGB <-> BGR).
+void ClipTransformUint8(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int h_off,
+    const int w_off,
+    const int h_crop,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool mirror,
+    const bool reverse_channels,
+    float* transformed_clip);
+
+// Resizes every frame of a planar uint8 clip (channels x length x height x
+// width) bilinearly and writes the h_crop x w_crop window of the result to
+// transformed_clip as (x - mean) * inv_std, with mirror and reverse_channels
+// as above. Row h of the window blends source rows y0[h] and y1[h] with
+// weight fy[h] on y1[h], column w columns x0[w] and x1[w] with weight fx[w]
+// on x1[w]; the taps are nondecreasing and inside the frame. The vectorized
+// paths round like the scalar one up to a contracted multiply-add.
+void BilinearClipTransformUint8(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int* y0,
+    const int* y1,
+    const float* fy,
+    const int h_crop,
+    const int* x0,
+    const int* x1,
+    const float* fx,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool mirror,
+    const bool reverse_channels,
+    float* transformed_clip);
+
+// Splits num_pixels packed 3-channel pixels (c0 c1 c2 c0 c1 c2 ...) into
+// three planes in a single sweep. Plane c starts at planar + c * plane_stride.
+void PackedRGBToPlanarFloat(
+    const std::uint8_t* packed,
+    const int num_pixels,
+    const int plane_stride,
+    float* planar);
+
+void PackedRGBToPlanarUint8(
+    const std::uint8_t* packed,
+    const int num_pixels,
+    const int plane_stride,
+    std::uint8_t* planar);
+
+} // namespace caffe2
@@ -0,0 +1,345 @@
+#include "caffe2/perfkernels/clip_transform.h"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+namespace caffe2 {
+
+namespace {
+
+template <bool kMirror>
+void NormalizeRowAVX2(
+    const std::uint8_t* x,
+    const int n,
+    const float mean,
+    const float inv_std,
+    float* y) {
+  const __m256 vmean = _mm256_set1_ps(mean);
+  const __m256 vinv_std = _mm256_set1_ps(inv_std);
+  const __m256i reverse = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  int w = 0;
+  // 16 pixels per iteration: one 128-bit load, two 8-float stores
+  for (; w + 16 <= n; w += 16) {
+    __m128i x8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + w));
+    __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(x8));
+    __m256 hi =
+        _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(x8, 8)));
+    // sub then mul, to round exactly like the scalar path
+    lo = _mm256_mul_ps(_mm256_sub_ps(lo, vmean), vinv_std);
+    hi = _mm256_mul_ps(_mm256_sub_ps(hi, vmean), vinv_std);
+    if (kMirror) {
+      _mm256_storeu_ps(
+          y + n - w - 8, _mm256_permutevar8x32_ps(lo, reverse));
+      _mm256_storeu_ps(
+          y + n - w - 16, _mm256_permutevar8x32_ps(hi, reverse));
+    } else {
+      _mm256_storeu_ps(y + w, lo);
+      _mm256_storeu_ps(y + w + 8, hi);
+    }
+  }
+  for (; w + 8 <= n; w += 8) {
+    __m128i x8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(x + w));
+    __m256 v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(x8));
+    v = _mm256_mul_ps(_mm256_sub_ps(v, vmean), vinv_std);
+    if (kMirror) {
+      _mm256_storeu_ps(y + n - w - 8, _mm256_permutevar8x32_ps(v, reverse));
+    } else {
+      _mm256_storeu_ps(y + w, v);
+    }
+  }
+  for (; w < n; ++w) {
+    y[kMirror ? n - 1 - w : w] = (static_cast<float>(x[w]) - mean) * inv_std;
+  }
+}
+
+template <bool kMirror>
+void ClipTransformUint8AVX2Impl(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int h_off,
+    const int w_off,
+    const int h_crop,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  for (int c = 0; c < channels; ++c) {
+    const int src_c = reverse_channels ? channels - c - 1 : c;
+    for (int l = 0; l < length; ++l) {
+      const std::uint8_t* src =
+          clip + ((src_c * length + l) * height + h_off) * width + w_off;
+      float* dst = transformed_clip + (c * length + l) * h_crop * w_crop;
+      for (int h = 0; h < h_crop; ++h) {
+        NormalizeRowAVX2<kMirror>(
+            src + h * width, w_crop, mean, inv_std, dst + h * w_crop);
+      }
+    }
+  }
+}
+
+// row[idx[0..7]] as floats. Each lane loads the 4 bytes from its tap on and
+// keeps the first, so the taps must be 3 bytes clear of the end of the row.
+inline __m256 GatherTapsAVX2(const std::uint8_t* row, const __m256i idx) {
+  const __m256i v =
+      _mm256_i32gather_epi32(reinterpret_cast<const int*>(row), idx, 1);
+  return _mm256_cvtepi32_ps(_mm256_and_si256(v, _mm256_set1_epi32(0xff)));
+}
+
+template <bool kMirror>
+void BilinearRowAVX2(
+    const std::uint8_t* row0,
+    const std::uint8_t* row1,
+    const int width,
+    const float wy,
+    const int* x0,
+    const int* x1,
+    const float* fx,
+    const int n,
+    const float mean,
+    const float inv_std,
+    float* y) {
+  const __m256 vwy = _mm256_set1_ps(wy);
+  const __m256 vmean = _mm256_set1_ps(mean);
+  const __m256 vinv_std = _mm256_set1_ps(inv_std);
+  const __m256i reverse = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  int w = 0;
+  // the taps are nondecreasing, so once the last tap of a vector gets near
+  // the end of the row the rest of it goes scalar
+  for (; w + 8 <= n && x1[w + 7] + 4 <= width; w += 8) {
+    const __m256i i0 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x0 + w));
+    const __m256i i1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x1 + w));
+    const __m256 wx = _mm256_loadu_ps(fx + w);
+    const __m256 p00 = GatherTapsAVX2(row0, i0);
+    const __m256 p10 = GatherTapsAVX2(row1, i0);
+    const __m256 top = _mm256_add_ps(
+        p00, _mm256_mul_ps(_mm256_sub_ps(GatherTapsAVX2(row0, i1), p00), wx));
+    const __m256 bottom = _mm256_add_ps(
+        p10, _mm256_mul_ps(_mm256_sub_ps(GatherTapsAVX2(row1, i1), p10), wx));
+    const __m256 value =
+        _mm256_add_ps(top, _mm256_mul_ps(_mm256_sub_ps(bottom, top), vwy));
+    const __m256 v = _mm256_mul_ps(_mm256_sub_ps(value, vmean), vinv_std);
+    if (kMirror) {
+      _mm256_storeu_ps(y + n - w - 8, _mm256_permutevar8x32_ps(v, reverse));
+    } else {
+      _mm256_storeu_ps(y + w, v);
+    }
+  }
+  for (; w < n; ++w) {
+    const float wx = fx[w];
+    const float top = row0[x0[w]] + (row0[x1[w]] - row0[x0[w]]) * wx;
+    const float bottom = row1[x0[w]] + (row1[x1[w]] - row1[x0[w]]) * wx;
+    const float value = top + (bottom - top) * wy;
+    y[kMirror ? n - 1 - w : w] = (value - mean) * inv_std;
+  }
+}
+
+template <bool kMirror>
+void BilinearClipTransformUint8AVX2Impl(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int* y0,
+    const int* y1,
+    const float* fy,
+    const int h_crop,
+    const int* x0,
+    const int* x1,
+    const float* fx,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  for (int c = 0; c < channels; ++c) {
+    const int src_c = reverse_channels ? channels - c - 1 : c;
+    for (int l = 0; l < length; ++l) {
+      const std::uint8_t* src = clip + (src_c * length + l) * height * width;
+      float* dst = transformed_clip + (c * length + l) * h_crop * w_crop;
+      for (int h = 0; h < h_crop; ++h) {
+        BilinearRowAVX2<kMirror>(
+            src + y0[h] * width, src + y1[h] * width, width, fy[h], x0, x1,
+            fx, w_crop, mean, inv_std, dst + h * w_crop);
+      }
+    }
+  }
+}
+
+// Deinterleaves 16 packed pixels (48 bytes in a, b, c) into one 16-byte
+// register per channel with three byte shuffles and two ors per channel.
+inline void DeinterleaveRGB16(
+    const std::uint8_t* packed,
+    __m128i* c0,
+    __m128i* c1,
+    __m128i* c2) {
+  const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed));
+  const __m128i b =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + 16));
+  const __m128i c =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + 32));
+  *c0 = _mm_or_si128(
+      _mm_or_si128(
+          _mm_shuffle_epi8(
+              a,
+              _mm_setr_epi8(
+                  0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                  -1)),
+          _mm_shuffle_epi8(
+              b,
+              _mm_setr_epi8(
+                  -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1,
+                  -1))),
+      _mm_shuffle_epi8(
+          c,
+          _mm_setr_epi8(
+              -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)));
+  *c1 = _mm_or_si128(
+      _mm_or_si128(
+          _mm_shuffle_epi8(
+              a,
+              _mm_setr_epi8(
+                  1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                  -1)),
+          _mm_shuffle_epi8(
+              b,
+              _mm_setr_epi8(
+                  -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1,
+                  -1))),
+      _mm_shuffle_epi8(
+          c,
+          _mm_setr_epi8(
+              -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)));
+  *c2 = _mm_or_si128(
+      _mm_or_si128(
+          _mm_shuffle_epi8(
+              a,
+              _mm_setr_epi8(
+                  2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                  -1)),
+          _mm_shuffle_epi8(
+              b,
+              _mm_setr_epi8(
+                  -1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1,
+                  -1))),
+      _mm_shuffle_epi8(
+          c,
+          _mm_setr_epi8(
+              -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)));
+}
+
+inline void StorePlane16(__m128i x, std::uint8_t* y) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(y), x);
+}
+
+inline void StorePlane16(__m128i x, float* y) {
+  _mm256_storeu_ps(y, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(x)));
+  _mm256_storeu_ps(
+      y + 8, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(x, 8))));
+}
+
+template <typename T>
+void PackedRGBToPlanarAVX2Impl(
+    const std::uint8_t* packed,
+    const int num_pixels,
+    const int plane_stride,
+    T* planar) {
+  T* p0 = planar;
+  T* p1 = planar + plane_stride;
+  T* p2 = planar + 2 * plane_stride;
+  int i = 0;
+  for (; i + 16 <= num_pixels; i += 16) {
+    __m128i c0, c1, c2;
+    DeinterleaveRGB16(packed + 3 * i, &c0, &c1, &c2);
+    StorePlane16(c0, p0 + i);
+    StorePlane16(c1, p1 + i);
+    StorePlane16(c2, p2 + i);
+  }
+  for (; i < num_pixels; ++i) {
+    p0[i] = static_cast<T>(packed[3 * i]);
+    p1[i] = static_cast<T>(packed[3 * i + 1]);
+    p2[i] = static_cast<T>(packed[3 * i + 2]);
+  }
+}
+
+} // namespace
+
+void ClipTransformUint8__avx2(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int h_off,
+    const int w_off,
+    const int h_crop,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool mirror,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  if (mirror) {
+    ClipTransformUint8AVX2Impl<true>(
+        clip, channels, length, height, width, h_off, w_off, h_crop, w_crop,
+        mean, inv_std, reverse_channels, transformed_clip);
+  } else {
+    ClipTransformUint8AVX2Impl<false>(
+        clip, channels, length, height, width, h_off, w_off, h_crop, w_crop,
+        mean, inv_std, reverse_channels, transformed_clip);
+  }
+}
+
+void BilinearClipTransformUint8__avx2(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int* y0,
+    const int* y1,
+    const float* fy,
+    const int h_crop,
+    const int* x0,
+    const int* x1,
+    const float* fx,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool mirror,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  if (mirror) {
+    BilinearClipTransformUint8AVX2Impl<true>(
+        clip, channels, length, height, width, y0, y1, fy, h_crop, x0, x1, fx,
+        w_crop, mean, inv_std, reverse_channels, transformed_clip);
+  } else {
+    BilinearClipTransformUint8AVX2Impl<false>(
+        clip, channels, length, height, width, y0, y1, fy, h_crop, x0, x1, fx,
+        w_crop, mean, inv_std, reverse_channels, transformed_clip);
+  }
+}
+
+void PackedRGBToPlanarFloat__avx2(
+    const std::uint8_t* packed,
+    const int num_pixels,
+    const int plane_stride,
+    float* planar) {
+  PackedRGBToPlanarAVX2Impl(packed, num_pixels, plane_stride, planar);
+}
+
+void PackedRGBToPlanarUint8__avx2(
+    const std::uint8_t* packed,
+    const int num_pixels,
+    const int plane_stride,
+    std::uint8_t* planar) {
+  PackedRGBToPlanarAVX2Impl(packed, num_pixels, plane_stride, planar);
+}
+
+} // namespace caffe2
@@ -0,0 +1,219 @@
+#include "caffe2/perfkernels/clip_transform.h"
+
+#include <immintrin.h>
+
+namespace caffe2 {
+
+namespace {
+
+inline __m512 ReverseAVX512(const __m512 x) {
+  return _mm512_permutexvar_ps(
+      _mm512_set_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+      x);
+}
+
+template <bool kMirror>
+void NormalizeRowAVX512(
+    const std::uint8_t* x,
+    const int n,
+    const float mean,
+    const float inv_std,
+    float* y) {
+  const __m512 vmean = _mm512_set1_ps(mean);
+  const __m512 vinv_std = _mm512_set1_ps(inv_std);
+  int w = 0;
+  // 16 pixels per iteration: one 128-bit load, one 16-float store
+  for (; w + 16 <= n; w += 16) {
+    const __m128i x8 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + w));
+    __m512 v = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(x8));
+    // sub then mul, to round exactly like the scalar path
+    v = _mm512_mul_ps(_mm512_sub_ps(v, vmean), vinv_std);
+    if (kMirror) {
+      _mm512_storeu_ps(y + n - w - 16, ReverseAVX512(v));
+    } else {
+      _mm512_storeu_ps(y + w, v);
+    }
+  }
+  for (; w < n; ++w) {
+    y[kMirror ? n - 1 - w : w] = (static_cast<float>(x[w]) - mean) * inv_std;
+  }
+}
+
+template <bool kMirror>
+void ClipTransformUint8AVX512Impl(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int h_off,
+    const int w_off,
+    const int h_crop,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  for (int c = 0; c < channels; ++c) {
+    const int src_c = reverse_channels ? channels - c - 1 : c;
+    for (int l = 0; l < length; ++l) {
+      const std::uint8_t* src =
+          clip + ((src_c * length + l) * height + h_off) * width + w_off;
+      float* dst = transformed_clip + (c * length + l) * h_crop * w_crop;
+      for (int h = 0; h < h_crop; ++h) {
+        NormalizeRowAVX512<kMirror>(
+            src + h * width, w_crop, mean, inv_std, dst + h * w_crop);
+      }
+    }
+  }
+}
+
+// row[idx[0..15]] as floats. Each lane loads the 4 bytes from its tap on and
+// keeps the first, so the taps must be 3 bytes clear of the end of the row.
+inline __m512 GatherTapsAVX512(const std::uint8_t* row, const __m512i idx) {
+  const __m512i v = _mm512_i32gather_epi32(idx, row, 1);
+  return _mm512_cvtepi32_ps(_mm512_and_si512(v, _mm512_set1_epi32(0xff)));
+}
+
+template <bool kMirror>
+void BilinearRowAVX512(
+    const std::uint8_t* row0,
+    const std::uint8_t* row1,
+    const int width,
+    const float wy,
+    const int* x0,
+    const int* x1,
+    const float* fx,
+    const int n,
+    const float mean,
+    const float inv_std,
+    float* y) {
+  const __m512 vwy = _mm512_set1_ps(wy);
+  const __m512 vmean = _mm512_set1_ps(mean);
+  const __m512 vinv_std = _mm512_set1_ps(inv_std);
+  int w = 0;
+  // the taps are nondecreasing, so once the last tap of a vector gets near
+  // the end of the row the rest of it goes scalar
+  for (; w + 16 <= n && x1[w + 15] + 4 <= width; w += 16) {
+    const __m512i i0 = _mm512_loadu_si512(x0 + w);
+    const __m512i i1 = _mm512_loadu_si512(x1 + w);
+    const __m512 wx = _mm512_loadu_ps(fx + w);
+    const __m512 p00 = GatherTapsAVX512(row0, i0);
+    const __m512 p10 = GatherTapsAVX512(row1, i0);
+    const __m512 top = _mm512_add_ps(
+        p00,
+        _mm512_mul_ps(_mm512_sub_ps(GatherTapsAVX512(row0, i1), p00), wx));
+    const __m512 bottom = _mm512_add_ps(
+        p10,
+        _mm512_mul_ps(_mm512_sub_ps(GatherTapsAVX512(row1, i1), p10), wx));
+    const __m512 value =
+        _mm512_add_ps(top, _mm512_mul_ps(_mm512_sub_ps(bottom, top), vwy));
+    const __m512 v = _mm512_mul_ps(_mm512_sub_ps(value, vmean), vinv_std);
+    if (kMirror) {
+      _mm512_storeu_ps(y + n - w - 16, ReverseAVX512(v));
+    } else {
+      _mm512_storeu_ps(y + w, v);
+    }
+  }
+  for (; w < n; ++w) {
+    const float wx = fx[w];
+    const float top = row0[x0[w]] + (row0[x1[w]] - row0[x0[w]]) * wx;
+    const float bottom = row1[x0[w]] + (row1[x1[w]] - row1[x0[w]]) * wx;
+    const float value = top + (bottom - top) * wy;
+    y[kMirror ? n - 1 - w : w] = (value - mean) * inv_std;
+  }
+}
+
+template <bool kMirror>
+void BilinearClipTransformUint8AVX512Impl(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int* y0,
+    const int* y1,
+    const float* fy,
+    const int h_crop,
+    const int* x0,
+    const int* x1,
+    const float* fx,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  for (int c = 0; c < channels; ++c) {
+    const int src_c = reverse_channels ? channels - c - 1 : c;
+    for (int l = 0; l < length; ++l) {
+      const std::uint8_t* src = clip + (src_c * length + l) * height * width;
+      float* dst = transformed_clip + (c * length + l) * h_crop * w_crop;
+      for (int h = 0; h < h_crop; ++h) {
+        BilinearRowAVX512<kMirror>(
+            src + y0[h] * width, src + y1[h] * width, width, fy[h], x0, x1,
+            fx, w_crop, mean, inv_std, dst + h * w_crop);
+      }
+    }
+  }
+}
+
+} // namespace
+
+void ClipTransformUint8__avx512(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int h_off,
+    const int w_off,
+    const int h_crop,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool mirror,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  if (mirror) {
+    ClipTransformUint8AVX512Impl<true>(
+        clip, channels, length, height, width, h_off, w_off, h_crop, w_crop,
+        mean, inv_std, reverse_channels, transformed_clip);
+  } else {
+    ClipTransformUint8AVX512Impl<false>(
+        clip, channels, length, height, width, h_off, w_off, h_crop, w_crop,
+        mean, inv_std, reverse_channels, transformed_clip);
+  }
+}
+
+void BilinearClipTransformUint8__avx512(
+    const std::uint8_t* clip,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int* y0,
+    const int* y1,
+    const float* fy,
+    const int h_crop,
+    const int* x0,
+    const int* x1,
+    const float* fx,
+    const int w_crop,
+    const float mean,
+    const float inv_std,
+    const bool mirror,
+    const bool reverse_channels,
+    float* transformed_clip) {
+  if (mirror) {
+    BilinearClipTransformUint8AVX512Impl<true>(
+        clip, channels, length, height, width, y0, y1, fy, h_crop, x0, x1, fx,
+        w_crop, mean, inv_std, reverse_channels, transformed_clip);
+  } else {
+    BilinearClipTransformUint8AVX512Impl<false>(
+        clip, channels, length, height, width, y0, y1, fy, h_crop, x0, x1, fx,
+        w_crop, mean, inv_std, reverse_channels, transformed_clip);
+  }
+}
+
+} // namespace caffe2
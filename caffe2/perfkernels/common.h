@@ -35,11 +35,12 @@ In foo.cc, do:
 // and run time architecture support.
 //
 // During build time:
-//    The build system should provide flags CAFFE2_PERF_WITH_AVX2 and
-//    CAFFE2_PERF_WITH_AVX that corresponds to the __AVX__ and __AVX2__ flags
-//    the compiler provides. Note that we do not use the compiler flags but
-//    rely on the build system flags, because the common files (like foo.cc
-//    above) will always be built without __AVX__ and __AVX2__.
+//    The build system should provide flags CAFFE2_PERF_WITH_AVX512,
+//    CAFFE2_PERF_WITH_AVX2 and CAFFE2_PERF_WITH_AVX that corresponds to the
+//    __AVX512F__, __AVX2__ and __AVX__ flags the compiler provides. Note that
+//    we do not use the compiler flags but rely on the build system flags,
+//    because the common files (like foo.cc above) will always be built
+//    without __AVX__ and __AVX2__.
 // During run time:
 //    we use cpuid to identify cpu support and run the proper functions.
 
@@ -50,6 +51,18 @@ In foo.cc, do:
 
 #define BASE_DO(funcname, ...) return funcname##__base(__VA_ARGS__);
 
+#ifdef CAFFE2_PERF_WITH_AVX512
+// the Skylake-SP subset: F, BW, DQ and VL
+#define AVX512_DO(funcname, ...)                        \
+  decltype(funcname##__base) funcname##__avx512;        \
+  if (GetCpuId().avx512f() && GetCpuId().avx512bw() &&  \
+      GetCpuId().avx512dq() && GetCpuId().avx512vl()) { \
+    return funcname##__avx512(__VA_ARGS__);             \
+  }
+#else // CAFFE2_PERF_WITH_AVX512
+#define AVX512_DO(funcname, ...)
+#endif // CAFFE2_PERF_WITH_AVX512
+
 #ifdef CAFFE2_PERF_WITH_AVX2
 #define AVX2_DO(funcname, ...)                 \
   decltype(funcname##__base) funcname##__avx2; \
@@ -0,0 +1,82 @@
+#include "caffe2/perfkernels/softmax.h"
+#include "caffe2/perfkernels/common.h"
+#include "caffe2/utils/cpuid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace caffe2 {
+
+void SoftmaxRows__base(
+    const int N,
+    const int D,
+    const float* X,
+    float* Y,
+    const bool logarithmic,
+    float* rowmax,
+    float* rowsum) {
+  // the elements exponentiated against one running max
+  constexpr int kBlockSize = 64;
+  const int num_blocks = (D + kBlockSize - 1) / kBlockSize;
+#pragma omp parallel if (static_cast<long>(N) * D >= 65536)
+  {
+    // the running max every block of Y was exponentiated against
+    std::vector<float> block_max(num_blocks);
+#pragma omp for
+    for (int i = 0; i < N; ++i) {
+      const float* x = X + static_cast<long>(i) * D;
+      float* y = Y + static_cast<long>(i) * D;
+      float max = -std::numeric_limits<float>::infinity();
+      float sum = 0;
+      for (int b = 0; b < num_blocks; ++b) {
+        const int begin = b * kBlockSize;
+        const int end = std::min(begin + kBlockSize, D);
+        const float block = *std::max_element(x + begin, x + end);
+        if (block > max) {
+          sum *= std::exp(max - block);
+          max = block;
+        }
+        for (int j = begin; j < end; ++j) {
+          const float e = std::exp(x[j] - max);
+          if (!logarithmic) {
+            y[j] = e;
+          }
+          sum += e;
+        }
+        block_max[b] = max;
+      }
+      rowmax[i] = max;
+      rowsum[i] = sum;
+      if (logarithmic) {
+        const float shift = max + std::log(std::max(sum, 1e-20f));
+        for (int j = 0; j < D; ++j) {
+          y[j] = x[j] - shift;
+        }
+        continue;
+      }
+      for (int b = 0; b < num_blocks; ++b) {
+        const float scale = std::exp(block_max[b] - max) / sum;
+        const int end = std::min((b + 1) * kBlockSize, D);
+        for (int j = b * kBlockSize; j < end; ++j) {
+          y[j] *= scale;
+        }
+      }
+    }
+  }
+}
+
+void SoftmaxRows(
+    const int N,
+    const int D,
+    const float* X,
+    float* Y,
+    const bool logarithmic,
+    float* rowmax,
+    float* rowsum) {
+  AVX2_FMA_DO(SoftmaxRows, N, D, X, Y, logarithmic, rowmax, rowsum);
+  BASE_DO(SoftmaxRows, N, D, X, Y, logarithmic, rowmax, rowsum);
+}
+
+} // namespace caffe2
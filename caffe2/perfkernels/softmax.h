@@ -0,0 +1,22 @@
+#pragma once
+
+namespace caffe2 {
+
+// Computes the softmax of every row of X (N x D) into Y, or with logarithmic
+// the log softmax, and the max and the sum of the exponentials of every row
+// into rowmax and rowsum (X - rowmax exponentiated).
+//
+// A row is read once to find both its max and its sum: it is exponentiated
+// in blocks against the running max, and the sum is rescaled whenever a
+// block raises the max (an online softmax). A second pass scales Y by the
+// max and the sum. Rows are split over OpenMP threads.
+void SoftmaxRows(
+    const int N,
+    const int D,
+    const float* X,
+    float* Y,
+    const bool logarithmic,
+    float* rowmax,
+    float* rowsum);
+
+} // namespace caffe2
@@ -0,0 +1,149 @@
+#include "caffe2/perfkernels/softmax.h"
+
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace caffe2 {
+
+namespace {
+
+// exp(x) = 2^n * exp(r) with n = round(x / ln 2) and |r| <= ln 2 / 2, by the
+// polynomial of Cephes' expf. Exact to a few ulp; 0 below the normal floats.
+inline __m256 Exp256(__m256 x) {
+  const __m256 min_x = _mm256_set1_ps(-87.33654f);
+  const __m256 max_x = _mm256_set1_ps(88.37626f);
+  const __m256 underflow = _mm256_cmp_ps(x, min_x, _CMP_LT_OQ);
+  x = _mm256_min_ps(_mm256_max_ps(x, min_x), max_x);
+  const __m256 n = _mm256_round_ps(
+      _mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  // ln 2 in two parts, for r to be exact
+  __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+  r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+  __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+  p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), r);
+  p = _mm256_add_ps(p, _mm256_set1_ps(1.f));
+  const __m256i exponent = _mm256_slli_epi32(
+      _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+  const __m256 y = _mm256_mul_ps(p, _mm256_castsi256_ps(exponent));
+  return _mm256_andnot_ps(underflow, y);
+}
+
+inline float HorizontalMax(__m256 v) {
+  __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+  m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+  return _mm_cvtss_f32(m);
+}
+
+inline float HorizontalSum(__m256 v) {
+  __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+  s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+  s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+  return _mm_cvtss_f32(s);
+}
+
+} // namespace
+
+void SoftmaxRows__avx2_fma(
+    const int N,
+    const int D,
+    const float* X,
+    float* Y,
+    const bool logarithmic,
+    float* rowmax,
+    float* rowsum) {
+  // as in SoftmaxRows__base: 8 vectors per running max
+  constexpr int kBlockSize = 64;
+  const int num_blocks = (D + kBlockSize - 1) / kBlockSize;
+#pragma omp parallel if (static_cast<long>(N) * D >= 65536)
+  {
+    std::vector<float> block_max(num_blocks);
+#pragma omp for
+    for (int i = 0; i < N; ++i) {
+      const float* x = X + static_cast<long>(i) * D;
+      float* y = Y + static_cast<long>(i) * D;
+      float max = -std::numeric_limits<float>::infinity();
+      __m256 vsum = _mm256_setzero_ps();
+      float tail_sum = 0;
+      for (int b = 0; b < num_blocks; ++b) {
+        const int begin = b * kBlockSize;
+        const int end = std::min(begin + kBlockSize, D);
+        // the vectors of the block, then the elements past the last one
+        const int vend = begin + (end - begin) / 8 * 8;
+        __m256 vblock = _mm256_set1_ps(max);
+        for (int j = begin; j < vend; j += 8) {
+          vblock = _mm256_max_ps(vblock, _mm256_loadu_ps(x + j));
+        }
+        float block = HorizontalMax(vblock);
+        for (int j = vend; j < end; ++j) {
+          block = std::max(block, x[j]);
+        }
+        if (block > max) {
+          const float rescale = std::exp(max - block);
+          vsum = _mm256_mul_ps(vsum, _mm256_set1_ps(rescale));
+          tail_sum *= rescale;
+          max = block;
+        }
+        const __m256 vmax = _mm256_set1_ps(max);
+        for (int j = begin; j < vend; j += 8) {
+          const __m256 e = Exp256(_mm256_sub_ps(_mm256_loadu_ps(x + j), vmax));
+          if (!logarithmic) {
+            _mm256_storeu_ps(y + j, e);
+          }
+          vsum = _mm256_add_ps(vsum, e);
+        }
+        for (int j = vend; j < end; ++j) {
+          const float e = std::exp(x[j] - max);
+          if (!logarithmic) {
+            y[j] = e;
+          }
+          tail_sum += e;
+        }
+        block_max[b] = max;
+      }
+      const float sum = HorizontalSum(vsum) + tail_sum;
+      rowmax[i] = max;
+      rowsum[i] = sum;
+      if (logarithmic) {
+        const float shift = max + std::log(std::max(sum, 1e-20f));
+        const __m256 vshift = _mm256_set1_ps(shift);
+        int j = 0;
+        for (; j + 8 <= D; j += 8) {
+          _mm256_storeu_ps(
+              y + j, _mm256_sub_ps(_mm256_loadu_ps(x + j), vshift));
+        }
+        for (; j < D; ++j) {
+          y[j] = x[j] - shift;
+        }
+        continue;
+      }
+      for (int b = 0; b < num_blocks; ++b) {
+        const float scale = std::exp(block_max[b] - max) / sum;
+        const __m256 vscale = _mm256_set1_ps(scale);
+        const int begin = b * kBlockSize;
+        const int end = std::min(begin + kBlockSize, D);
+        int j = begin;
+        for (; j + 8 <= end; j += 8) {
+          _mm256_storeu_ps(
+              y + j, _mm256_mul_ps(_mm256_loadu_ps(y + j), vscale));
+        }
+        for (; j < end; ++j) {
+          y[j] *= scale;
+        }
+      }
+    }
+  }
+}
+
+} // namespace caffe2
@@ -17,6 +17,7 @@ from caffe2.python.control_ops_grad import \
     gen_do_gradient, gen_if_gradient, gen_while_gradient
 
 import caffe2.python._import_c_extension as C
+import contextlib
 import pickle
 import numpy as np
 import sys
@@ -947,7 +948,7 @@ StopGradient. Op:\n\n{}""".format(op.output[0], str(op)))
 
         return new_input_to_grad, gradient_ops
 
-    def GetBackwardPass(self, ys):
+    def GetBackwardPass(self, ys, recompute_segments=None):
         """Gets the backward pass that computes the derivatives of given blobs.
 
         Inputs:
@@ -957,6 +958,9 @@ StopGradient. Op:\n\n{}""".format(op.output[0], str(op)))
               dictionary, for any dictionary entries that are not None, we will
               take the corresponding blobs as their gradients; for all those
               that are None, we will auto-fill them with 1.
+          recompute_segments: a list of RecomputeSegment. The forward ops of
+              each segment are emitted again right before its gradient ops,
+              and its activations freed right after them.
         """
         if isinstance(ys, list):
             ys = dict((y, None) for y in ys)
@@ -977,7 +981,14 @@ StopGradient. Op:\n\n{}""".format(op.output[0], str(op)))
         # we are playing it backwards, we cannot refer to variables that are
         # at a version older than current_versions because it is already been
         # overwritten.
+        segment_by_end = dict(
+            (segment.end - 1, segment) for segment in recompute_segments or [])
+        segment, segment_begin = None, 0
         for forward_op_idx in reversed(range(len(self.ssa))):
+            if forward_op_idx in segment_by_end:
+                segment = segment_by_end[forward_op_idx]
+                segment_begin = len(all_gradient_ops)
+
             input_to_grad, gradient_ops = self._GenerateGradientsForForwardOp(
                 forward_op_idx, all_input_to_grad)
             all_input_to_grad.update(input_to_grad)
@@ -992,6 +1003,14 @@ StopGradient. Op:\n\n{}""".format(op.output[0], str(op)))
             all_input_to_grad.update(grad_map)
             all_gradient_ops += additional_sum_ops
 
+            if segment is not None and forward_op_idx == segment.start:
+                # only the segments that get gradients are recomputed
+                if len(all_gradient_ops) > segment_begin:
+                    all_gradient_ops[segment_begin:segment_begin] = \
+                        segment.RecomputeOps()
+                    all_gradient_ops += segment.FreeOps(recomputed=True)
+                segment = None
+
         # (3) Post-processing.
         # After we have done computation for each op, we now have the gradient
         # operators ready. For the output map, we will convert everything to
@@ -1087,7 +1106,8 @@ class GradientRegistry(object):
         return gradient_ops, g_input
 
     @classmethod
-    def GetBackwardPass(cls, operators, ys, ys_generate_gradient=False):
+    def GetBackwardPass(cls, operators, ys, ys_generate_gradient=False,
+                        recompute_segments=None):
         """Gets the backward pass for the list of operators.
 
         Args:
@@ -1098,13 +1118,88 @@ class GradientRegistry(object):
                 dictionary, for any dictionary entries that are not None, we'll
                 take the corresponding blobs as their gradients; for all those
                 that are None, we will auto-fill them with 1.
+            recompute_segments: a list of RecomputeSegment of operators whose
+                forward ops are recomputed in the backward pass.
         Returns:
             gradient_ops: a list of gradient operators to run.
             all_input_to_grads: a map from input to their corresponding
                 gradients.
         """
         ir = IR(operators)
-        return ir.GetBackwardPass(ys)
+        return ir.GetBackwardPass(ys, recompute_segments)
+
+
+class RecomputeSegment(object):
+    """A range [start, end) of forward operators that keeps only its inputs
+    and outputs for the backward pass: its other activations are freed right
+    after its forward ops, and the ops are run again right before its
+    gradient ops (see Net.RecomputeSegment). The copies write the in-place
+    updates of their inputs, such as the running stats of SpatialBN, to
+    scratch blobs so that they are not applied twice.
+    """
+
+    def __init__(self, operators, start, end, keep_blobs=()):
+        self.start = start
+        self.end = end
+        ops = operators[start:end]
+        inputs = []
+        written = set()
+        for op in ops:
+            if op.type == 'Dropout' and not any(
+                    arg.name == 'is_test' and arg.i for arg in op.arg):
+                raise ValueError(
+                    'Cannot recompute the random op {}'.format(op.type))
+            for blob in op.input:
+                if blob not in written and blob not in inputs:
+                    inputs.append(blob)
+            written.update(op.output)
+        for op in operators[end:]:
+            for blob in op.output:
+                if blob in inputs:
+                    raise ValueError(
+                        '{} is an input of the recompute segment of operators '
+                        '{} to {} and is overwritten after it'.format(
+                            blob, start, end))
+
+        used_outside = set(str(b) for b in keep_blobs)
+        for op in list(operators[:start]) + list(operators[end:]):
+            used_outside.update(op.input)
+        self._internal = []
+        for op in ops:
+            for blob in op.output:
+                if blob not in used_outside and blob not in inputs and \
+                        blob not in self._internal:
+                    self._internal.append(blob)
+
+        self._recompute_ops = []
+        self._scratch = []
+        for i, op in enumerate(ops):
+            new_op = caffe2_pb2.OperatorDef()
+            new_op.CopyFrom(op)
+            for j, blob in enumerate(op.output):
+                if blob not in inputs:
+                    continue
+                if any(blob in later.input for later in ops[i + 1:]):
+                    raise ValueError(
+                        'Cannot recompute the in-place update of {}, an input '
+                        'of the recompute segment of operators {} to {}'.format(
+                            blob, start, end))
+                new_op.output[j] = blob + '_recompute'
+                self._scratch.append(new_op.output[j])
+            self._recompute_ops.append(new_op)
+        self._device_option = ops[0].device_option if ops else None
+
+    def RecomputeOps(self):
+        return list(self._recompute_ops)
+
+    def FreeOps(self, recomputed=False):
+        """The op that frees the activations of the segment, after its
+        forward ops or, with recomputed, after its gradient ops."""
+        blobs = self._internal + (self._scratch if recomputed else [])
+        if not blobs:
+            return []
+        return [CreateOperator(
+            'Free', blobs, blobs, device_option=self._device_option)]
 
 
 GradientRegistry.RegisterGradient('Do')(gen_do_gradient)
@@ -1387,6 +1482,9 @@ class Net(object):
         self._op_outputs = set()
         self._external_input_map = set()
         self._attr_dict = defaultdict(list)
+        # [start, end) op ranges recorded by RecomputeSegment()
+        self._recompute_segments = []
+        self._in_recompute_segment = False
         if type(name_or_proto) is caffe2_pb2.NetDef:
             proto = name_or_proto
             # We rae initializing a network by a NetDef. In this case, we will
@@ -1836,8 +1934,22 @@ class Net(object):
         the gradient accumulation (Sum) is float only right now.
         """
 
+        ops = self._net.op[skip:]
+        keep_blobs = list(ys) + list(self._net.external_output)
+        segments = [
+            RecomputeSegment(ops, start - skip, end - skip, keep_blobs)
+            for start, end in self._recompute_segments if start >= skip]
         grad_ops, input_to_grad = GradientRegistry.GetBackwardPass(
-            self._net.op[skip:], ys)
+            ops, ys, recompute_segments=segments)
+        if segments:
+            # free the activations of every segment after its forward ops
+            forward_ops = list(self._net.op)
+            for segment in reversed(segments):
+                forward_ops[skip + segment.end:skip + segment.end] = \
+                    segment.FreeOps()
+            del self._net.op[:]
+            self._net.op.extend(forward_ops)
+            self._recompute_segments = []
         # Check if in immediate mode: the grad_ops are actually being produced
         # by C++ and bypasses the CreateOperator() call, so in immediate mode
         # we will have to explicitly run them.
@@ -1847,6 +1959,29 @@ class Net(object):
         self._ExtendOps(grad_ops)
         return input_to_grad
 
+    @contextlib.contextmanager
+    def RecomputeSegment(self):
+        """Marks the ops added in its scope as a segment that is recomputed
+        in the backward pass of AddGradientOperators instead of keeping its
+        activations, e.g. a residual block:
+
+            with model.net.RecomputeSegment():
+                blob_out = residual_block(model, blob_in, ...)
+
+        Only the inputs and outputs of the segment are kept. Its ops must be
+        deterministic and its inputs must not be overwritten by later ops.
+        """
+        assert not self._in_recompute_segment, \
+            'Recompute segments cannot be nested'
+        start = len(self._net.op)
+        self._in_recompute_segment = True
+        try:
+            yield
+        finally:
+            self._in_recompute_segment = False
+        if len(self._net.op) > start:
+            self._recompute_segments.append((start, len(self._net.op)))
+
     def AddExternalInput(self, *inputs):
         assert len(inputs) > 0
         refs = []
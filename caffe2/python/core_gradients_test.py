@@ -913,5 +913,68 @@ class TestGradientsAccumulationWithPassThroughGradients(test_util.TestCase):
             self.assertTrue("schema" in str(e))
 
 
+class TestRecomputeSegments(test_util.TestCase):
+    def _segment(self, net, h):
+        t = net.Tanh(h, "t")
+        r = net.Relu(t, "r")
+        return net.Mul([r, t], "y")
+
+    def _net(self, recompute):
+        net = core.Net("recompute_net")
+        x, w = net.AddExternalInput("x", "w")
+        h = net.Mul([x, w], "h")
+        if recompute:
+            with net.RecomputeSegment():
+                y = self._segment(net, h)
+        else:
+            y = self._segment(net, h)
+        loss = net.AveragedLoss(net.Mul([y, w], "z"), "loss")
+        return net, net.AddGradientOperators([loss])
+
+    def _run(self, net, grad_map):
+        workspace.ResetWorkspace()
+        np.random.seed(0)
+        workspace.blobs["x"] = np.random.randn(4, 5).astype(np.float32)
+        workspace.blobs["w"] = np.random.randn(4, 5).astype(np.float32)
+        workspace.RunNetOnce(net)
+        return [workspace.blobs[grad_map[b]] for b in ("x", "w")]
+
+    def testRecomputeOps(self):
+        net, _ = self._net(recompute=True)
+        ops = net.Proto().op
+        types = [op.type for op in ops]
+        self.assertEqual(types.count("Tanh"), 2)
+        self.assertEqual(types.count("Relu"), 2)
+        # the activations of the segment are freed after its forward ops
+        # and again after its gradient ops
+        frees = [i for i, op in enumerate(ops) if op.type == "Free"]
+        self.assertEqual(len(frees), 2)
+        self.assertEqual(ops[frees[0] - 1].output[0], "y")
+        self.assertEqual(list(ops[frees[0]].input), ["t", "r"])
+        self.assertEqual(ops[frees[1] - 1].type, "TanhGradient")
+        # the recomputed ops come right before the gradient ops of the segment
+        recompute = types.index("Tanh", frees[0])
+        self.assertEqual(types[recompute + 1], "Relu")
+        self.assertEqual(types[recompute + 2], "Mul")
+        self.assertEqual(ops[recompute + 3].input[0], "y_grad")
+
+    def testRecomputeGradients(self):
+        ref = self._run(*self._net(recompute=False))
+        grads = self._run(*self._net(recompute=True))
+        for g, r in zip(grads, ref):
+            np.testing.assert_allclose(g, r, rtol=1e-6)
+
+    def testOverwrittenInput(self):
+        net = core.Net("recompute_net")
+        x, w = net.AddExternalInput("x", "w")
+        h = net.Mul([x, w], "h")
+        with net.RecomputeSegment():
+            y = self._segment(net, h)
+        net.Relu(h, h)
+        loss = net.AveragedLoss(net.Mul([y, h], "z"), "loss")
+        with self.assertRaises(ValueError):
+            net.AddGradientOperators([loss])
+
+
 if __name__ == '__main__':
     unittest.main()
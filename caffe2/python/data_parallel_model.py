@@ -24,6 +24,9 @@ log.setLevel(logging.INFO)
 
 _DEFAULT_TIMEOUT_SEC = 30
 
+# the fp32 views of CreateFlatBuffer start at multiples of 128 bytes
+_FLAT_BUFFER_ALIGNMENT = 128 // 4
+
 
 def Parallelize_GPU(*args, **kwargs):
     kwargs['cpu_device'] = False
@@ -55,6 +58,13 @@ def Parallelize(
     num_threads_per_device=4,
     shared_model=False,
     combine_spatial_bn=False,
+    allreduce_bucket_mb=0,
+    allreduce_compression=None,
+    allreduce_error_feedback=False,
+    flatten_params=False,
+    micro_batches=1,
+    shard_optimizer_state=False,
+    link_devices_fun=None,
 ):
     '''
     Function to create a model that can run on many GPUs or CPUs.
@@ -89,6 +99,21 @@ def Parallelize(
       rendezvous:       used for rendezvous in distributed computation, if None
                         then only one node is used. To create rendezvous,
                         use <TBD>.
+                        With rendezvous['allreduce_engine'] set to
+                        'GLOO_HIERARCHICAL' (engine 'GLOO', GPU only), the
+                        gradients are reduce-scattered over the local GPUs
+                        with NCCL, the shards allreduced across the nodes
+                        with gloo and gathered back with NCCL.
+                        With rendezvous['engine'] set to 'MPI' (and
+                        'kv_handler' None, in processes started by mpirun,
+                        'num_shards' and 'shard_id' their MPI size and
+                        rank), the collectives run on MPI, from the device
+                        memory with a CUDA-aware MPI; see caffe2/mpi.
+                        With rendezvous['reuse_common_worlds'] set, the
+                        nets parallelized again in the process, e.g. the
+                        test net next to the train net, reuse the gloo
+                        common worlds of the same names instead of a new
+                        rendezvous in the store.
       net_type:         Network type
       optimize_gradient_memory: whether to apply 'memonger' to share blobs
       shared_model      (only for CPU) use same parameters on each device
@@ -104,7 +129,62 @@ def Parallelize(
                         When set to True, applies batch normalization across
                         all devices within the node. If False, batch
                         normalization will be done separately for each device.
-                        This option is currently only supported on the CPU.
+                        On GPU the statistics are allreduced with NCCL and
+                        the ops become SyncSpatialBN.
+      allreduce_bucket_mb:
+                        When > 0 (GPU only), the dense gradients are flattened
+                        into buckets of about this many MB in the order the
+                        backward pass produces them, and each bucket is
+                        allreduced at once as soon as all of its gradients
+                        are computed, instead of one allreduce per gradient.
+      allreduce_compression:
+                        'fp16' to cast the dense fp32 GPU gradients to fp16
+                        for the allreduce across nodes, halving the traffic,
+                        or a dict from the gradient or bucket names (e.g.
+                        'allreduce_bucket_0') to 'fp16' / None to select
+                        them. Only used with a rendezvous.
+      allreduce_error_feedback:
+                        With allreduce_compression, keep the fp16 rounding
+                        error of every device and add it to the gradient of
+                        the next iteration.
+      flatten_params:   When True (GPU only), the dense fp32 params of every
+                        device are moved into one flat buffer, and their
+                        gradients into another, which the backward pass
+                        writes in place. The gradients are then allreduced
+                        as the one buffer, and the params can be copied or
+                        updated all at once.
+      micro_batches:    When > 1, every iteration runs the forward and backward
+                        passes on micro_batches micro-batches in turn: the
+                        gradients of the first micro_batches - 1 are added up
+                        by a separate net, model._micro_batch_net, and
+                        model.net adds the last ones before the allreduce and
+                        the update, which so run once per iteration. The loss
+                        scale is divided by micro_batches. Run the micro-batch
+                        net micro_batches - 1 times before model.net, see
+                        RunNet. Does not support flatten_params,
+                        allreduce_bucket_mb or dynamic_memory_management.
+      shard_optimizer_state:
+                        When True (GPU, single host, with flatten_params and
+                        use_nccl), the flat gradients are reduce-scattered
+                        instead of allreduced: device i of N gets the sum of
+                        the i-th of N equal shards of the flat buffer. The
+                        param_update_builder_fun updates only that shard,
+                        see GetParamShard and AddParamShardState, so every
+                        device keeps 1 / N of the optimizer state, and the
+                        updated shards are then allgathered into the flat
+                        params of all the devices. The shard state is not
+                        synced and not in GetCheckpointParams.
+      link_devices_fun:
+                        Function that is called with the model once the
+                        forward passes of all the devices are built, and
+                        before the gradient operators are added. The ops of
+                        the forward passes are then interleaved (see
+                        _InterleaveOps), so it can add ops that read the
+                        blobs of the other devices through Copy ops, e.g. to
+                        exchange the halos of activations that are sharded
+                        over the devices; their gradients flow back to the
+                        devices. The input ops, which may differ between the
+                        devices, stay in front of the interleaved ops.
     '''
     assert scope.CurrentDeviceScope() is None \
         or scope.CurrentDeviceScope().device_type == caffe2_pb2.CPU, \
@@ -114,6 +194,22 @@ def Parallelize(
     if devices is None:
         devices = list(range(0, workspace.NumCudaDevices())),
 
+    assert micro_batches >= 1, "micro_batches should be >= 1"
+    # the micro-batch net does not write the flat or bucketed gradients and
+    # knows nothing of the Free ops
+    assert micro_batches == 1 or not (
+        flatten_params or allreduce_bucket_mb > 0 or
+        dynamic_memory_management), \
+        "micro_batches does not support flatten_params, allreduce_bucket_mb " \
+        "or dynamic_memory_management"
+    assert not shard_optimizer_state or (
+        not cpu_device and rendezvous is None and use_nccl and
+        flatten_params and allreduce_bucket_mb == 0 and
+        param_update_builder_fun is not None), \
+        "shard_optimizer_state needs a GPU model on a single host, " \
+        "use_nccl, flatten_params and a param_update_builder_fun, and does " \
+        "not support allreduce_bucket_mb"
+
     if not cpu_device:
         for gpu in devices:
             if gpu >= workspace.NumCudaDevices():
@@ -125,6 +221,9 @@ def Parallelize(
         model_helper_obj._shared_model = False
         device_name = "GPU"
         assert shared_model is False, "Shared model only supported on CPU"
+        # freeing the gradients would reallocate them out of the buffer
+        assert not (flatten_params and dynamic_memory_management), \
+            "flatten_params does not support dynamic_memory_management"
     else:
         model_helper_obj._device_type = caffe2_pb2.CPU
         model_helper_obj._device_prefix = "cpu"
@@ -146,6 +245,13 @@ def Parallelize(
     model_helper_obj._rendezvous = rendezvous
     model_helper_obj._broadcast_context = None
     model_helper_obj._grad_names = []
+    model_helper_obj._allreduce_compression = allreduce_compression
+    model_helper_obj._allreduce_error_feedback = allreduce_error_feedback
+    model_helper_obj._micro_batches = micro_batches
+    model_helper_obj._micro_batch_net = None
+    model_helper_obj._param_shards = None
+    model_helper_obj._param_shard_state = set()
+    model_helper_obj._num_input_ops = {}
 
     assert isinstance(model_helper_obj, model_helper.ModelHelper)
 
@@ -158,7 +264,7 @@ def Parallelize(
 
     losses_by_gpu = {}
     num_shards = 1 if rendezvous is None else rendezvous['num_shards']
-    loss_scale = 1.0 / (len(devices) * num_shards)
+    loss_scale = 1.0 / (len(devices) * num_shards * micro_batches)
 
     has_parameter_updates = param_update_builder_fun is not None or \
         optimizer_builder_fun is not None
@@ -188,7 +294,10 @@ def Parallelize(
             with core.NameScope("{}_{}".format(model_helper_obj._device_prefix,
                                                device)):
                 log.info("Model for {} : {}".format(device_name, device))
+                num_ops = len(model_helper_obj.net.Proto().op)
                 input_builder_fun(model_helper_obj)
+                model_helper_obj._num_input_ops[device] = \
+                    len(model_helper_obj.net.Proto().op) - num_ops
                 losses = forward_pass_builder_fun(model_helper_obj, loss_scale)
                 # Losses are not needed for test net
                 if has_parameter_updates:
@@ -199,6 +308,9 @@ def Parallelize(
                             'Model builder func must return list of loss blobs'
 
                 losses_by_gpu[device] = losses
+    if link_devices_fun is not None:
+        _InterleaveOps(model_helper_obj)
+        link_devices_fun(model_helper_obj)
     _ValidateParams(model_helper_obj.params)
 
     # Create parameter map
@@ -226,8 +338,6 @@ def Parallelize(
     _AddGradientOperators(devices, model_helper_obj, losses_by_gpu)
 
     if combine_spatial_bn:
-        assert(cpu_device), \
-            'combine_spatial_bn is currently only supported on the CPU'
         assert(has_parameter_updates), \
             'combine_spatial_bn should only be used for train model'
         _InterleaveOps(model_helper_obj)
@@ -253,6 +363,9 @@ def Parallelize(
 
     _InferBlobDevice(model_helper_obj)
 
+    if micro_batches > 1:
+        _AddMicroBatchSums(model_helper_obj, devices)
+
     log.info("Add gradient all-reduces for SyncSGD")
     if broadcast_computed_params:
         _BroadcastComputedParams(devices, model_helper_obj, rendezvous, use_nccl)
@@ -261,6 +374,25 @@ def Parallelize(
         # Gradients in reverse order
         reverse_ordered_grads = _GetReverseOrderedGrads(model_helper_obj)
         assert(len(reverse_ordered_grads) > 0)
+        if flatten_params and not cpu_device:
+            reverse_ordered_grads = _FlattenParams(
+                model_helper_obj,
+                devices,
+                reverse_ordered_grads,
+                num_shards=len(devices) if shard_optimizer_state else 1,
+            )
+        if shard_optimizer_state and "flat_gradients" in reverse_ordered_grads:
+            reverse_ordered_grads.remove("flat_gradients")
+            _ReduceScatterFlatGradients(model_helper_obj, devices)
+        bucket_grads = allreduce_bucket_mb > 0 and not cpu_device and (
+            len(devices) > 1 or rendezvous is not None)
+        if bucket_grads:
+            reverse_ordered_grads = _FlattenGradientBuckets(
+                model_helper_obj,
+                devices,
+                reverse_ordered_grads,
+                allreduce_bucket_mb,
+            )
         _AllReduceBlobs(
             reverse_ordered_grads,
             devices,
@@ -270,6 +402,11 @@ def Parallelize(
             use_nccl,
             max_concurrent_distributed_ops,
         )
+        if bucket_grads:
+            _UnflattenGradientBuckets(model_helper_obj, devices)
+        # the views of the sharded flat gradients only hold partial sums
+        if flatten_params and not cpu_device and not shard_optimizer_state:
+            _FlatGradientsToViews(model_helper_obj, devices)
     else:
         log.info("NOTE: Param builder function did not create any parameters.")
 
@@ -288,6 +425,8 @@ def Parallelize(
                     "{}_{}".format(model_helper_obj._device_prefix, device)
                 ):
                     param_update_builder_fun(model_helper_obj)
+        if model_helper_obj._param_shards is not None:
+            _AllGatherParamShards(model_helper_obj, devices)
     else:
         log.info("Calling optimizer builder function")
         optimizer = optimizer_builder_fun(model_helper_obj)
@@ -352,6 +491,12 @@ def Parallelize(
     if shared_model:
         _RemapParameterBlobsForSharedModel(model_helper_obj, all_params)
 
+    if micro_batches > 1:
+        # after the blob renames of memonger and the shared model
+        _CreateMicroBatchNet(model_helper_obj)
+        model_helper_obj._data_parallel_model_nets.insert(
+            0, (model_helper_obj._micro_batch_net, micro_batches - 1))
+
 
 def Parallelize_GPU_BMUF(*args, **kwargs):
     kwargs['cpu_device'] = False
@@ -671,6 +816,14 @@ def RunWarmup(model):
 
 
 def RunNet(model, num_iterations):
+    if model._micro_batches > 1:
+        # the micro-batches of every iteration, then its update
+        for _ in range(num_iterations):
+            workspace.RunNet(
+                model._micro_batch_net.Proto().name,
+                model._micro_batches - 1)
+            workspace.RunNet(model.net.Proto().name)
+        return
     for net_iter in model._data_parallel_model_nets:
         if isinstance(net_iter, tuple):
             workspace.RunNet(net_iter[0].Proto().name, net_iter[1])
@@ -928,6 +1081,56 @@ def _Broadcast(devices, model, net, param, use_nccl=False):
             )
 
 
+# the name of the ops of model.net that add the sums of the gradients of the
+# micro-batches, see _AddMicroBatchSums
+_MICRO_BATCH_SUM = "micro_batch_sum"
+
+
+def _AddMicroBatchSums(model, devices):
+    '''
+    Adds the sums <grad>_micro_sum of the gradients of the first micro-batches
+    of an iteration, which _CreateMicroBatchNet accumulates, to the gradients
+    of model.net, and sets the sums back to 0 for the next iteration. The
+    gradients then hold the ones of the whole iteration for the allreduce.
+    '''
+    grad_to_param = {
+        str(grad): param for param, grad in viewitems(model.param_to_grad)}
+    model._micro_batch_sums = []
+    for grad_name in model._grad_names:
+        for device in devices:
+            grad = model._device_grouped_blobs[grad_name][device]
+            assert isinstance(grad, core.BlobReference), \
+                "micro_batches does not support the sparse gradient {}".format(
+                    grad_name)
+            device_opt = core.DeviceOption(model._device_type, device)
+            with core.DeviceScope(device_opt):
+                grad_sum = model.param_init_net.ConstantFill(
+                    [grad_to_param[str(grad)]], str(grad) + "_micro_sum",
+                    value=0.0)
+                model.net.Sum([grad, grad_sum], grad, name=_MICRO_BATCH_SUM)
+                model.net.ConstantFill(
+                    grad_sum, grad_sum, value=0.0, name=_MICRO_BATCH_SUM)
+            model._micro_batch_sums.append((grad, grad_sum, device_opt))
+
+
+def _CreateMicroBatchNet(model):
+    '''
+    model._micro_batch_net runs the ops of model.net up to the gradients, and
+    accumulates the gradients into the sums of _AddMicroBatchSums.
+    '''
+    ops = model.net.Proto().op
+    first_sum = next(
+        i for i, op in enumerate(ops) if op.name == _MICRO_BATCH_SUM)
+    net = model.net.Clone(
+        model.net.Proto().name + "_micro_batch",
+        op_id_mask=list(range(first_sum)),
+    )
+    for grad, grad_sum, device_opt in model._micro_batch_sums:
+        with core.DeviceScope(device_opt):
+            net.Accumulate(grad, grad_sum, gamma=1.0)
+    model._micro_batch_net = net
+
+
 def _AllReduce(devices, model, net, param, use_nccl=False, control_input=None):
     blobs_group = list(viewvalues(model._device_grouped_blobs[param]))
     if model._device_type == caffe2_pb2.CUDA and use_nccl:
@@ -1253,7 +1456,11 @@ def _AllReduceBlobsDistributed(
 ):
     num_workers = model.net.Proto().num_workers
     assert num_workers > 1, "Please specify more than 1 worker"
-    all_reduce_engine = rendezvous['engine']
+    all_reduce_engine = rendezvous.get('allreduce_engine', rendezvous['engine'])
+    if all_reduce_engine == 'GLOO_HIERARCHICAL':
+        assert rendezvous['engine'] == 'GLOO' and \
+            model._device_type == caffe2_pb2.CUDA, \
+            "The hierarchical allreduce needs GPUs and the GLOO engine"
 
     master_device_opt = core.DeviceOption(model._device_type, devices[0])
 
@@ -1267,12 +1474,17 @@ def _AllReduceBlobsDistributed(
     )
 
     nccl_control_blob = None
+    compressed = _GetCompressedAllreduces(model, blob_names, devices)
+    error_feedback = getattr(model, '_allreduce_error_feedback', False)
 
     for blob_name in blob_names:
         master_blob = model._device_grouped_blobs[blob_name][devices[0]]
         blobs_group = list(viewvalues(model._device_grouped_blobs[blob_name]))
 
         assert master_blob in blobs_group
+        device_blobs = [
+            (d, model._device_grouped_blobs[blob_name][d]) for d in devices
+        ]
 
         # Remark: NCCLReduce does not support in-place modifications
         # so we need a temporary blob
@@ -1296,10 +1508,20 @@ def _AllReduceBlobsDistributed(
             # With Gloo cross GPU and cross machine allreduce
             # can be executed in a single operation.
             # Try to use GPUDirect if transport == ibverbs.
-            allreduce(
-                blobs_group,
-                gpu_direct=(rendezvous.get("transport", None) == "ibverbs"),
-            )
+            if blob_name in compressed:
+                halves = _CompressForAllreduce(
+                    model, net, device_blobs, compressed[blob_name],
+                    error_feedback)
+                allreduce(
+                    halves,
+                    gpu_direct=(rendezvous.get("transport", None) == "ibverbs"),
+                )
+                _DecompressAfterAllreduce(model, net, device_blobs, halves)
+            else:
+                allreduce(
+                    blobs_group,
+                    gpu_direct=(rendezvous.get("transport", None) == "ibverbs"),
+                )
         else:
             # Step 1: sum blobs from local GPUs to master GPU
             with core.DeviceScope(master_device_opt):
@@ -1315,7 +1537,15 @@ def _AllReduceBlobsDistributed(
                 net.Copy(master_blob, reduced_blob)
 
             # Step 2: allreduce between all hosts, between master GPUs
-            allreduce([reduced_blob])
+            if blob_name in compressed:
+                reduced = [(devices[0], reduced_blob)]
+                halves = _CompressForAllreduce(
+                    model, net, reduced, compressed[blob_name],
+                    error_feedback)
+                allreduce(halves)
+                _DecompressAfterAllreduce(model, net, reduced, halves)
+            else:
+                allreduce([reduced_blob])
 
             with core.DeviceScope(master_device_opt):
                 net.Copy(reduced_blob, master_blob)
@@ -1324,6 +1554,85 @@ def _AllReduceBlobsDistributed(
             _Broadcast(devices, model, net, blob_name)
 
 
+def _GetCompressedAllreduces(model, blob_names, devices):
+    '''
+    Returns the blobs of blob_names whose allreduce the model compresses to
+    fp16, with the shape of their blobs: the dense fp32 GPU gradients and
+    the buckets of them.
+    '''
+    compression = getattr(model, '_allreduce_compression', None)
+    if not compression:
+        return {}
+    shapes, types = workspace.InferShapesAndTypes([model.param_init_net], {})
+    grad_to_param = {
+        str(g): str(p) for p, g in viewitems(model.param_to_grad)
+        if isinstance(g, core.BlobReference)
+    }
+    buckets = dict(getattr(model, '_gradient_buckets', {}))
+    # a flat buffer is allreduced with the padding between its views
+    buckets.update(getattr(model, '_flat_gradients', {}))
+    compressed = {}
+    for name in blob_names:
+        if isinstance(compression, dict):
+            mode = compression.get(name)
+        else:
+            mode = compression
+        if mode is None:
+            continue
+        assert mode == 'fp16', \
+            "Unsupported allreduce compression: {}".format(mode)
+        master = model._device_grouped_blobs[name][devices[0]]
+        if isinstance(master, core.GradientSlice) or \
+                not _IsGPUBlob(model, name):
+            continue
+        params = [
+            grad_to_param.get(str(model._device_grouped_blobs[g][devices[0]]))
+            for g in buckets.get(name, [name])
+        ]
+        if any(p not in shapes or types[p] != caffe2_pb2.TensorProto.FLOAT
+               for p in params):
+            log.warning("Not compressing the allreduce of {}".format(name))
+            continue
+        if name in getattr(model, '_flat_gradients', {}):
+            compressed[name] = [sum(
+                (int(np.prod(shapes[p])) + 31) // 32 * 32 for p in params)]
+        elif name in buckets:
+            compressed[name] = [sum(int(np.prod(shapes[p])) for p in params)]
+        else:
+            compressed[name] = shapes[params[0]]
+    log.info("Compressing {} of {} allreduces to fp16".format(
+        len(compressed), len(blob_names)))
+    return compressed
+
+
+def _CompressForAllreduce(model, net, device_blobs, shape, error_feedback):
+    '''
+    Casts the (device, blob) pairs to fp16 blobs to allreduce. With
+    error_feedback, the rounding error of every blob is kept and added to
+    it in the next iteration.
+    '''
+    halves = []
+    for device, blob in device_blobs:
+        with core.DeviceScope(core.DeviceOption(model._device_type, device)):
+            if error_feedback:
+                error = "{}_fp16_error".format(blob)
+                model.param_init_net.ConstantFill(
+                    [], error, shape=shape, value=0.0)
+                net.Add([blob, error], blob)
+            half = net.FloatToHalf(blob, "{}_fp16".format(blob))
+            if error_feedback:
+                rounded = net.HalfToFloat(half, "{}_fp16_rounded".format(blob))
+                net.Sub([blob, rounded], error)
+            halves.append(half)
+    return halves
+
+
+def _DecompressAfterAllreduce(model, net, device_blobs, halves):
+    for (device, blob), half in zip(device_blobs, halves):
+        with core.DeviceScope(core.DeviceOption(model._device_type, device)):
+            net.HalfToFloat(half, blob)
+
+
 def _AllReduceBlobsSingleHost(blob_names, devices, model, net, use_nccl):
     """Performs NCCL AllReduce to distribute blobs to all the GPUs."""
 
@@ -1442,6 +1751,349 @@ def _GetReverseOrderedGrads(model):
     return list(reversed(model._grad_names))
 
 
+def _FlattenGradientBuckets(model, devices, grad_names, bucket_mb):
+    '''
+    Groups the dense GPU gradients of grad_names into buckets of up to
+    bucket_mb MB, in the order the backward pass produces them, and flattens
+    each bucket into one blob per device. Returns the names to allreduce in
+    that order: the buckets, and the gradients left out of them (sparse, of
+    unknown size or too large for a bucket).
+    '''
+    master_prefix = "{}_{}/".format(model._device_prefix, devices[0])
+    last_writer = {}
+    for i, op in enumerate(model.net.Proto().op):
+        for b in op.output:
+            last_writer[b] = i
+    grad_to_param = {
+        str(g): str(p) for p, g in viewitems(model.param_to_grad)
+        if isinstance(g, core.BlobReference)
+    }
+    shapes, types = workspace.InferShapesAndTypes([model.param_init_net], {})
+    itemsizes = {
+        caffe2_pb2.TensorProto.FLOAT: 4,
+        caffe2_pb2.TensorProto.FLOAT16: 2,
+        caffe2_pb2.TensorProto.DOUBLE: 8,
+    }
+    bucket_bytes = bucket_mb * 1024 * 1024
+
+    def grad_order(name):
+        return last_writer.get(master_prefix + name, len(last_writer))
+
+    model._gradient_buckets = OrderedDict()
+    names = []
+    bucket = []
+    bucket_state = {'bytes': 0, 'type': None}
+
+    def close_bucket():
+        if len(bucket) == 1:
+            names.append(bucket[0])
+        elif len(bucket) > 1:
+            bucket_name = "allreduce_bucket_{}".format(
+                len(model._gradient_buckets))
+            model._gradient_buckets[bucket_name] = list(bucket)
+            model._device_grouped_blobs[bucket_name] = {}
+            for device in devices:
+                device_opt = core.DeviceOption(model._device_type, device)
+                with core.DeviceScope(device_opt):
+                    flat = model.net.BucketFlatten(
+                        [model._device_grouped_blobs[g][device]
+                         for g in bucket],
+                        "{}_{}/{}".format(
+                            model._device_prefix, device, bucket_name),
+                    )
+                model._device_grouped_blobs[bucket_name][device] = flat
+                model._blob_to_device[str(flat)] = device_opt
+            names.append(bucket_name)
+        del bucket[:]
+        bucket_state['bytes'] = 0
+
+    for name in sorted(grad_names, key=grad_order):
+        master_grad = model._device_grouped_blobs[name][devices[0]]
+        param = grad_to_param.get(str(master_grad))
+        if (isinstance(master_grad, core.GradientSlice) or
+                not _IsGPUBlob(model, name) or param not in shapes or
+                types[param] not in itemsizes):
+            names.append(name)
+            continue
+        nbytes = int(np.prod(shapes[param])) * itemsizes[types[param]]
+        if nbytes >= bucket_bytes:
+            names.append(name)
+            continue
+        if (bucket_state['bytes'] + nbytes > bucket_bytes or
+                types[param] != bucket_state['type']):
+            close_bucket()
+        bucket.append(name)
+        bucket_state['bytes'] += nbytes
+        bucket_state['type'] = types[param]
+    close_bucket()
+    log.info("Allreducing {} gradients in {} buckets of up to {} MB".format(
+        sum(len(b) for b in viewvalues(model._gradient_buckets)),
+        len(model._gradient_buckets), bucket_mb))
+    return names
+
+
+def _UnflattenGradientBuckets(model, devices):
+    '''
+    Copies the allreduced buckets back into their gradients, in place.
+    '''
+    for bucket_name, grads in viewitems(model._gradient_buckets):
+        for device in devices:
+            device_opt = core.DeviceOption(model._device_type, device)
+            with core.DeviceScope(device_opt):
+                grad_blobs = [
+                    model._device_grouped_blobs[g][device] for g in grads
+                ]
+                model.net.BucketUnflatten(
+                    [model._device_grouped_blobs[bucket_name][device]] +
+                    grad_blobs,
+                    grad_blobs,
+                )
+
+
+def _FlattenParams(model, devices, grad_names, num_shards=1):
+    '''
+    Moves the dense fp32 GPU params with a gradient in grad_names into one
+    flat buffer per device, 'flat_params', and lays out their gradients as
+    views of another, 'flat_gradients', which the backward ops then write in
+    place. Both buffers are padded to a multiple of num_shards items.
+    Returns the names to allreduce: the flat gradients, after the gradients
+    left out of the buffer (sparse or of unknown size).
+    '''
+    grad_to_param = {
+        str(g): str(p) for p, g in viewitems(model.param_to_grad)
+        if isinstance(g, core.BlobReference)
+    }
+    shapes, types = workspace.InferShapesAndTypes([model.param_init_net], {})
+    names = []
+    flat = []
+    for name in grad_names:
+        master_grad = model._device_grouped_blobs[name][devices[0]]
+        param = grad_to_param.get(str(master_grad))
+        if (isinstance(master_grad, core.GradientSlice) or
+                not _IsGPUBlob(model, name) or param not in shapes or
+                types[param] != caffe2_pb2.TensorProto.FLOAT):
+            names.append(name)
+        else:
+            flat.append(name)
+    if len(flat) == 0:
+        return names
+
+    flat_name = "flat_gradients"
+    model._flat_gradients = {flat_name: flat}
+    model._flat_views = set([flat_name] + flat + [
+        stripBlobName(grad_to_param[str(model._device_grouped_blobs[g][
+            devices[0]])]) for g in flat])
+    # the param names and the offsets and sizes of the views, in items, as
+    # CreateFlatBuffer lays them out, and the padded size of the buffer
+    model._flat_param_layout = []
+    end = 0
+    for g in flat:
+        param = grad_to_param[str(model._device_grouped_blobs[g][devices[0]])]
+        size = int(np.prod(shapes[param]))
+        model._flat_param_layout.append((stripBlobName(param), end, size))
+        end += (size + _FLAT_BUFFER_ALIGNMENT - 1) // \
+            _FLAT_BUFFER_ALIGNMENT * _FLAT_BUFFER_ALIGNMENT
+    model._flat_param_size = (end + num_shards - 1) // num_shards * num_shards
+    model._device_grouped_blobs[flat_name] = {}
+    model._device_grouped_blobs["flat_params"] = {}
+    for device in devices:
+        device_opt = core.DeviceOption(model._device_type, device)
+        prefix = "{}_{}/".format(model._device_prefix, device)
+        grads = [model._device_grouped_blobs[g][device] for g in flat]
+        params = [grad_to_param[str(g)] for g in grads]
+        with core.DeviceScope(device_opt):
+            model.param_init_net.CreateFlatBuffer(
+                params, params + [prefix + "flat_params"], copy=1,
+                size_multiple=num_shards)
+            model.param_init_net.CreateFlatBuffer(
+                params, grads + [prefix + flat_name], copy=0,
+                size_multiple=num_shards)
+            flat_grads = model.net.FlatBufferFromViews(
+                grads + [prefix + flat_name], prefix + flat_name)
+        model._device_grouped_blobs[flat_name][device] = flat_grads
+        model._device_grouped_blobs["flat_params"][device] = \
+            core.BlobReference(prefix + "flat_params")
+        model._blob_to_device[prefix + flat_name] = device_opt
+        model._blob_to_device[prefix + "flat_params"] = device_opt
+    log.info("Flattened {} params and their gradients".format(len(flat)))
+    return names + [flat_name]
+
+
+def _ReduceScatterFlatGradients(model, devices):
+    '''
+    For shard_optimizer_state: sums the shard of the flat gradients of every
+    device over the devices, in place, with one NCCL reduce-scatter, and
+    makes the views of the params and the gradients in the shards, see
+    GetParamShard. Nothing is copied.
+    '''
+    num_shards = len(devices)
+    shard_size = model._flat_param_size // num_shards
+    model._param_shards = {}
+    shards = []
+    reduced = []
+    for i, device in enumerate(devices):
+        device_opt = core.DeviceOption(model._device_type, device)
+        prefix = "{}_{}/".format(model._device_prefix, device)
+        with core.DeviceScope(device_opt):
+            grads, grad_shard = model.net.FlatBufferShards(
+                model._device_grouped_blobs["flat_gradients"][device],
+                [prefix + "flat_gradients_shards",
+                 prefix + "flat_gradients_shard"],
+                num_shards=num_shards, shard_id=i)
+        shards.append(grads)
+        reduced.append(grad_shard)
+        model._blob_to_device[str(grads)] = device_opt
+        model._blob_to_device[str(grad_shard)] = device_opt
+    with core.DeviceScope(
+            core.DeviceOption(model._device_type, devices[0])):
+        model.net.NCCLReduceScatter(shards, reduced)
+
+    for i, device in enumerate(devices):
+        device_opt = core.DeviceOption(model._device_type, device)
+        prefix = "{}_{}/".format(model._device_prefix, device)
+        # the parts of the params in [begin, end) of the buffer
+        begin = i * shard_size
+        end = begin + shard_size
+        slices = [
+            (name, max(start, begin) - begin,
+             min(start + size, end) - max(start, begin))
+            for name, start, size in model._flat_param_layout
+            if start < end and start + size > begin
+        ]
+        with core.DeviceScope(device_opt):
+            _, param_shard = model.net.FlatBufferShards(
+                prefix + "flat_params",
+                [prefix + "flat_params_shards", prefix + "flat_params_shard"],
+                num_shards=num_shards, shard_id=i)
+        model._blob_to_device[str(param_shard)] = device_opt
+        shard = []
+        if slices:
+            starts = [start for _, start, _ in slices]
+            lengths = [length for _, _, length in slices]
+            with core.DeviceScope(device_opt):
+                params = model.net.FlatBufferSlices(
+                    param_shard,
+                    [prefix + name + "_shard" for name, _, _ in slices],
+                    starts=starts, lengths=lengths)
+                grads = model.net.FlatBufferSlices(
+                    reduced[i],
+                    [prefix + name + "_grad_shard" for name, _, _ in slices],
+                    starts=starts, lengths=lengths)
+            if len(slices) == 1:
+                params, grads = [params], [grads]
+            params, grads = list(params), list(grads)
+            shard = [
+                (core.BlobReference(prefix + name), p, g, start, length)
+                for (name, start, length), p, g in zip(slices, params, grads)
+            ]
+            for blob in params + grads:
+                model._blob_to_device[str(blob)] = device_opt
+        model._param_shards[device] = shard
+    log.info("Sharded the flat params into {} shards of {} items".format(
+        num_shards, shard_size))
+
+
+def _AllGatherParamShards(model, devices):
+    '''
+    For shard_optimizer_state: gathers the updated shards of the flat params
+    of all the devices into the flat params of every device, with one NCCL
+    allgather after the updates of the views of the shards.
+    '''
+    shards = []
+    gathered = []
+    for device in devices:
+        device_opt = core.DeviceOption(model._device_type, device)
+        prefix = "{}_{}/".format(model._device_prefix, device)
+        views = model._param_shards[device]
+        shard = core.BlobReference(prefix + "flat_params_shard")
+        # a shard can be all padding, without views
+        if views:
+            with core.DeviceScope(device_opt):
+                shard = model.net.FlatBufferFromViews(
+                    [view for _, view, _, _, _ in views] + [shard], shard,
+                    starts=[start for _, _, _, start, _ in views])
+        shards.append(shard)
+        gathered.append(core.BlobReference(prefix + "flat_params_shards"))
+    with core.DeviceScope(
+            core.DeviceOption(model._device_type, devices[0])):
+        model.net.NCCLAllGather(shards, gathered)
+
+
+def _CurrentDevice(model):
+    device_opt = scope.CurrentDeviceScope()
+    assert device_opt is not None and \
+        device_opt.device_type == model._device_type, \
+        "Call within the device scope of param_update_builder_fun"
+    return device_opt.cuda_gpu_id
+
+
+def GetParamShard(model):
+    '''
+    With shard_optimizer_state, the part of the flat params that the device
+    of the current device scope updates, for param_update_builder_fun: a
+    list of (param, param view, gradient view), with the views of the items
+    of the param in the shard of the device. The gradients are summed over
+    the devices; the other items of the param and of its gradient blob are
+    not to be updated or read on the device. Returns None without
+    shard_optimizer_state.
+    '''
+    if getattr(model, '_param_shards', None) is None:
+        return None
+    return [
+        (param, view, grad)
+        for param, view, grad, _, _ in
+        model._param_shards[_CurrentDevice(model)]
+    ]
+
+
+def AddParamShardState(model, name, value=0.0):
+    '''
+    With shard_optimizer_state, creates the optimizer state of the param
+    shard of the device of the current device scope, e.g. its momentum: one
+    blob, 'flat_<name>_shard', of the size of the shard, filled with value
+    by the param init net. Unlike replicated state, it differs between the
+    devices and is not synced. Returns the views of the items of the params
+    of GetParamShard in it, '<param>_<name>_shard', in the same order.
+    '''
+    device = _CurrentDevice(model)
+    shard_name = "flat_{}_shard".format(name)
+    model._param_shard_state.add(shard_name)
+    prefix = "{}_{}/".format(model._device_prefix, device)
+    # the names are scoped already
+    state = model.param_init_net.ConstantFill(
+        [], core.BlobReference(prefix + shard_name),
+        shape=[model._flat_param_size // len(model._devices)], value=value)
+    shard = model._param_shards[device]
+    if not shard:
+        return []
+    views = model.net.FlatBufferSlices(
+        state,
+        [core.BlobReference("{}_{}_shard".format(param, name))
+         for param, _, _, _, _ in shard],
+        starts=[start for _, _, _, start, _ in shard],
+        lengths=[length for _, _, _, _, length in shard])
+    return list(views) if len(shard) > 1 else [views]
+
+
+def _FlatGradientsToViews(model, devices):
+    '''
+    Makes the updates of the params depend on the allreduce of the flat
+    gradients, whose views they read. Nothing is copied.
+    '''
+    for flat_name, grads in viewitems(getattr(model, '_flat_gradients', {})):
+        for device in devices:
+            device_opt = core.DeviceOption(model._device_type, device)
+            with core.DeviceScope(device_opt):
+                grad_blobs = [
+                    model._device_grouped_blobs[g][device] for g in grads
+                ]
+                model.net.FlatBufferToViews(
+                    [model._device_grouped_blobs[flat_name][device]] +
+                    grad_blobs,
+                    grad_blobs,
+                )
+
+
 # A helper function to extract a parameter's name
 def stripBlobName(param):
     # Format is "a/b/c/d" -> "b/c/d"
@@ -1596,6 +2248,16 @@ def _ComputeBlobsToSync(model):
         assert diff == set(), \
            "Some params not instantiated in param init net: {}".format(diff)
 
+        # the flat params are synced with one copy per device instead of
+        # the views, and there is nothing to sync in the flat gradients or
+        # in the optimizer state of the param shards, which differs between
+        # the devices
+        views = getattr(model, '_flat_views', set()).union(
+            getattr(model, '_param_shard_state', set()))
+        sync_names = set(n for n in sync_names if n not in views)
+        blobs_to_sync = [
+            b for b in blobs_to_sync if stripBlobName(b) not in views]
+
     # Remove duplicates and sort
     prefixlen = len(model._device_prefix) + 1
 
@@ -1690,6 +2352,56 @@ def OptimizeGradientMemory(model,
         )
 
 
+def PlanActivationMemory(model, input_shapes, excluded_blobs):
+    """
+    Gives every device a static memory plan of its activations and
+    gradients, sized by shape inference: the blobs that never live at the
+    same time share one preallocated arena per device, see
+    memonger.plan_activation_memory. Call it instead of
+    OptimizeGradientMemory (the net is not renamed), before running
+    param_init_net, which allocates the arenas.
+    input_shapes:  dict of blob name to shape for the inputs of the model.
+                   The inputs are not planned.
+    excluded_blobs: list of blobs that cannot be shared. These are blobs
+                   that you will access externally.
+    Returns a dict of device to the planned bytes of its arena.
+    """
+    input_shapes_all_devices = {}
+    for b, shp in viewitems(input_shapes):
+        for d in model._devices:
+            input_shapes_all_devices["{}_{}/{}".
+                                     format(model._device_prefix, d, b)] = shp
+
+    (shapes, types) = workspace.InferShapesAndTypes(
+        [model.param_init_net, model.net],
+        input_shapes_all_devices,
+    )
+
+    arena_bytes = {}
+    for device in model._devices:
+        namescope = "{}_{}/".format(model._device_prefix, device)
+        excluded_blobs_by_device = set(namescope + b for b in excluded_blobs)
+        excluded_blobs_by_device.update(
+            namescope + b for b in input_shapes)
+        device_opt = core.DeviceOption(model._device_type, device)
+        plan = memonger.plan_activation_memory(
+            model.net,
+            shapes,
+            types,
+            device_opt,
+            dont_share_blobs=excluded_blobs_by_device,
+        )
+        memonger.add_activation_arena(model.param_init_net, plan, device_opt)
+        blobs, _, _, arena_nbytes, total_nbytes, live_nbytes = plan
+        log.info(
+            "{}: planned {} blobs of {:.1f} MB into an arena of {:.1f} MB "
+            "(lower bound {:.1f} MB)".format(
+                namescope, len(blobs), total_nbytes / 1024. / 1024.,
+                arena_nbytes / 1024. / 1024., live_nbytes / 1024. / 1024.))
+        arena_bytes[device] = arena_nbytes
+    return arena_bytes
+
+
 def _CreateOrCloneCommonWorld(
         net,
         common_world_blob,
@@ -1744,6 +2456,8 @@ def _CreateOrCloneCommonWorld(
             kwargs['interface'] = rendezvous['interface']
         if 'mpi_rendezvous' in rendezvous:
             kwargs['mpi_rendezvous'] = rendezvous['mpi_rendezvous']
+        if rendezvous.get('reuse_common_worlds', False):
+            kwargs['reuse_cached'] = True
         comm_world = net.CreateCommonWorld(
             rendezvous['kv_handler'] or [],
             common_world_blob,
@@ -1825,17 +2539,23 @@ def _InterleaveOps(model):
     ensures that progress is made along the critical path roughly concurrently
     for each device, which is important due to the extra intra-node
     synchronization required for multi-device batch normalization.
+    The ops of the input builders come first, in their order: they need not
+    be the same on every device.
     '''
     orig_ops = list(model.net.Proto().op)
-    num_devices = len(model._devices)
-    num_ops_per_dev = len(orig_ops) // num_devices
-    assert num_devices * num_ops_per_dev == len(orig_ops), \
-           'Number of ops per device in original net is not uniform'
-    new_ops = []
-    ops = {d: [] for d in range(num_devices)}
+    ops = {d: [] for d in model._devices}
     for op in orig_ops:
         ops[op.device_option.cuda_gpu_id].append(op)
 
+    new_ops = []
+    for d in model._devices:
+        num_input_ops = model._num_input_ops.get(d, 0)
+        new_ops.extend(ops[d][:num_input_ops])
+        ops[d] = ops[d][num_input_ops:]
+    num_ops_per_dev = len(ops[model._devices[0]])
+    assert all(len(ops[d]) == num_ops_per_dev for d in model._devices), \
+           'Number of ops per device in original net is not uniform'
+
     for j in range(num_ops_per_dev):
         tp = None
         for d in model._devices:
@@ -1850,10 +2570,31 @@ def _InterleaveOps(model):
     model.net.Proto().op.extend(new_ops)
 
 
+def _AllreduceOp(blobs, device):
+    return core.CreateOperator(
+        "NCCLAllreduce",
+        blobs,
+        blobs,
+        device_option=core.DeviceOption(caffe2_pb2.CUDA, device))
+
+
 def _InterDeviceBatchNormalization(model):
+    '''
+    Rewrites the SpatialBN ops, and their gradients, so that they normalize
+    with the batch statistics of all the devices. The per channel statistics
+    of every device are summed on cpu_0 on CPU. On GPU they are summed in
+    place on every device by an NCCLAllreduce, and the ops become
+    SyncSpatialBN / SyncSpatialBNGradient, which take the group sums of the
+    device they run on. The allreduces only depend on the statistics of the
+    interleaved SpatialBN ops, so the DAG net overlaps them with the branches
+    of the net that don't need the normalized output, e.g. the shortcut conv
+    of a residual block.
+    '''
     orig_ops = list(model.net.Proto().op)
     new_ops = []
     num_devices = len(model._devices)
+    gpu = model._device_type == caffe2_pb2.CUDA
+    master_device = model._devices[0]
     batch_norm_ops = []
     injected_ops = []
 
@@ -1871,14 +2612,20 @@ def _InterDeviceBatchNormalization(model):
         if op.type != 'SpatialBN' and op.type != 'SpatialBNGradient':
             if spatial_bn_phase:
                 new_ops.extend(injected_ops)
-                new_ops.append(
-                    core.CreateOperator("Sum",
-                                        sums_blobs,
-                                        input_blob_name + "_sums_combined"))
-                new_ops.append(
-                    core.CreateOperator("Sum",
-                                        sumsq_blobs,
-                                        input_blob_name + "_sumsq_combined"))
+                if gpu:
+                    new_ops.append(_AllreduceOp(sums_blobs, master_device))
+                    new_ops.append(_AllreduceOp(sumsq_blobs, master_device))
+                else:
+                    new_ops.append(
+                        core.CreateOperator(
+                            "Sum",
+                            sums_blobs,
+                            input_blob_name + "_sums_combined"))
+                    new_ops.append(
+                        core.CreateOperator(
+                            "Sum",
+                            sumsq_blobs,
+                            input_blob_name + "_sumsq_combined"))
                 new_ops.extend(batch_norm_ops)
                 injected_ops = []
                 batch_norm_ops = []
@@ -1888,19 +2635,27 @@ def _InterDeviceBatchNormalization(model):
                 input_blob_name = None
             elif spatial_bn_gradient_phase:
                 new_ops.extend(injected_ops)
-                scale_blob = \
-                    "cpu_0/" + stripBlobName(scale_grad_blobs[0]) + "_combined"
-                bias_blob = \
-                    "cpu_0/" + stripBlobName(bias_grad_blobs[0]) + "_combined"
-                new_ops.append(
-                    core.CreateOperator("Sum", scale_grad_blobs, scale_blob))
-                new_ops.append(
-                    core.CreateOperator("Sum", bias_grad_blobs, bias_blob))
-                for blob in scale_grad_blobs:
+                if gpu:
+                    new_ops.append(
+                        _AllreduceOp(scale_grad_blobs, master_device))
                     new_ops.append(
-                        core.CreateOperator("Copy", scale_blob, blob))
-                for blob in bias_grad_blobs:
-                    new_ops.append(core.CreateOperator("Copy", bias_blob, blob))
+                        _AllreduceOp(bias_grad_blobs, master_device))
+                else:
+                    scale_blob = "cpu_0/" + \
+                        stripBlobName(scale_grad_blobs[0]) + "_combined"
+                    bias_blob = "cpu_0/" + \
+                        stripBlobName(bias_grad_blobs[0]) + "_combined"
+                    new_ops.append(
+                        core.CreateOperator(
+                            "Sum", scale_grad_blobs, scale_blob))
+                    new_ops.append(
+                        core.CreateOperator("Sum", bias_grad_blobs, bias_blob))
+                    for blob in scale_grad_blobs:
+                        new_ops.append(
+                            core.CreateOperator("Copy", scale_blob, blob))
+                    for blob in bias_grad_blobs:
+                        new_ops.append(
+                            core.CreateOperator("Copy", bias_blob, blob))
                 new_ops.extend(batch_norm_ops)
                 injected_ops = []
                 batch_norm_ops = []
@@ -1917,11 +2672,19 @@ def _InterDeviceBatchNormalization(model):
                 core.CreateOperator(
                     "ChannelStats",
                     name,
-                    [name + "_sums", name + "_sumsq"]))
+                    [name + "_sums", name + "_sumsq"],
+                    device_option=op.device_option))
             sums_blobs.append(name + "_sums")
             sumsq_blobs.append(name + "_sumsq")
-            op.input.append(input_blob_name + "_sums_combined")
-            op.input.append(input_blob_name + "_sumsq_combined")
+            if gpu:
+                # every device normalizes with its copy of the group sums
+                op.input.append(name + "_sums")
+                op.input.append(name + "_sumsq")
+                op.type = 'SyncSpatialBN'
+                op.engine = ''
+            else:
+                op.input.append(input_blob_name + "_sums_combined")
+                op.input.append(input_blob_name + "_sumsq_combined")
             op.arg.extend([utils.MakeArgument("num_batches", num_devices)])
             batch_norm_ops.append(op)
         elif op.type == 'SpatialBNGradient':
@@ -1930,9 +2693,13 @@ def _InterDeviceBatchNormalization(model):
                 core.CreateOperator("ChannelBackpropStats",
                                     [op.input[0], op.input[3], op.input[4],
                                      op.input[2]],
-                                    [op.output[1], op.output[2]]))
+                                    [op.output[1], op.output[2]],
+                                    device_option=op.device_option))
             scale_grad_blobs.append(op.output[1])
             bias_grad_blobs.append(op.output[2])
+            if gpu:
+                op.type = 'SyncSpatialBNGradient'
+                op.engine = ''
             op.arg.extend([utils.MakeArgument("num_batches", num_devices)])
             op.input.extend([op.output[1], op.output[2]])
             batch_norm_ops.append(op)
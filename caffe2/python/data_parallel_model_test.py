@@ -14,7 +14,8 @@ import hypothesis.strategies as st
 
 from caffe2.proto import caffe2_pb2
 from caffe2.python import brew, core, cnn, data_parallel_model, dyndep, \
-    model_helper, optimizer, rnn_cell, workspace, data_parallel_model_utils
+    model_helper, optimizer, rnn_cell, scope, workspace, \
+    data_parallel_model_utils
 from caffe2.python.test_util import TestCase
 
 
@@ -351,6 +352,267 @@ class DataParallelModelTest(TestCase):
                 device_option=None,
                 tmpdir=tmpdir)
 
+    @unittest.skipIf(not workspace.has_gpu_support, "No gpu support.")
+    def test_allreduce_compression(self):
+        def add_input_ops(model):
+            pass
+
+        def add_model_ops(model, loss_scale):
+            fc = model.FC("data", "fc", 16, 1,
+                          ("ConstantFill", {}), ("ConstantFill", {}))
+            loss = model.AveragedLoss(fc, "loss")
+            return [model.Scale(loss, scale=loss_scale)]
+
+        def add_optimizer(model):
+            return optimizer.build_sgd(model, 0.1, policy="fixed")
+
+        model = cnn.CNNModelHelper(order="NHWC", name="test_compression")
+        data_parallel_model.Parallelize_GPU(
+            model,
+            input_builder_fun=add_input_ops,
+            forward_pass_builder_fun=add_model_ops,
+            optimizer_builder_fun=add_optimizer,
+            devices=[0, 1],
+            rendezvous=dict(
+                kv_handler="store_handler",
+                shard_id=0,
+                num_shards=2,
+                engine='GLOO',
+            ),
+            allreduce_compression={'fc_w_grad': 'fp16'},
+            allreduce_error_feedback=True,
+        )
+        ops = model.net.Proto().op
+        halves = [op.output[0] for op in ops if op.type == "FloatToHalf"]
+        self.assertEqual(
+            halves, ["gpu_0/fc_w_grad_fp16", "gpu_1/fc_w_grad_fp16"])
+        allreduces = dict(
+            (op.name, op) for op in ops if op.type == "Allreduce")
+        self.assertEqual(list(allreduces["fc_w_grad"].input[1:]), halves)
+        self.assertEqual(
+            list(allreduces["fc_b_grad"].input[1:]),
+            ["gpu_0/fc_b_grad", "gpu_1/fc_b_grad"])
+        errors = [
+            op for op in model.param_init_net.Proto().op
+            if op.output[0].endswith("_fp16_error")
+        ]
+        self.assertEqual(len(errors), 2)
+        shape = [a for a in errors[0].arg if a.name == "shape"][0]
+        self.assertEqual(list(shape.ints), [1, 16])
+
+    def run_micro_batch_model(self, micro_batches):
+        def add_input_ops(model):
+            pass
+
+        def add_model_ops(model, loss_scale):
+            fc = model.FC("data", "fc", 16, 1,
+                          ("ConstantFill", {}), ("ConstantFill", {}))
+            sq = model.SquaredL2Distance(
+                [model.FlattenToVec(fc, "fc_fl"), "label"], "sq")
+            loss = model.AveragedLoss(sq, "loss")
+            return [model.Scale(loss, scale=loss_scale)]
+
+        def add_optimizer(model):
+            return optimizer.build_sgd(model, 0.1, policy="fixed")
+
+        workspace.ResetWorkspace()
+        devices = [0, 1]
+        model = cnn.CNNModelHelper(
+            order="NHWC", name="test_micro{}".format(micro_batches))
+        data_parallel_model.Parallelize(
+            model,
+            input_builder_fun=add_input_ops,
+            forward_pass_builder_fun=add_model_ops,
+            optimizer_builder_fun=add_optimizer,
+            devices=devices,
+            cpu_device=True,
+            micro_batches=micro_batches,
+        )
+        np.random.seed(2603)
+        batch_size = 32
+        per_device = batch_size // len(devices) // micro_batches
+        for i in range(4):
+            data = np.random.rand(batch_size, 16).astype(np.float32)
+            labels = np.round(data[:, 0]).astype(np.float32)
+            for m in range(micro_batches):
+                for j, g in enumerate(devices):
+                    st = (m * len(devices) + j) * per_device
+                    workspace.FeedBlob(
+                        "cpu_{}/data".format(g), data[st:st + per_device])
+                    workspace.FeedBlob(
+                        "cpu_{}/label".format(g), labels[st:st + per_device])
+                if i == 0 and m == 0:
+                    data_parallel_model.RunInitNet(model)
+                if m < micro_batches - 1:
+                    workspace.RunNet(model._micro_batch_net.Proto().name)
+                else:
+                    workspace.RunNet(model.net.Proto().name)
+        return workspace.FetchBlob("cpu_0/fc_w"), model
+
+    def test_micro_batches(self):
+        """
+        Two micro-batches per iteration give the update of their whole batch.
+        """
+        full, _ = self.run_micro_batch_model(1)
+        micro, model = self.run_micro_batch_model(2)
+        np.testing.assert_allclose(full, micro, rtol=1e-5, atol=1e-6)
+        # the micro-batch net neither allreduces nor updates
+        op_types = set(
+            op.type for op in model._micro_batch_net.Proto().op)
+        self.assertIn("Accumulate", op_types)
+        self.assertNotIn("Iter", op_types)
+        self.assertNotIn("WeightedSum", op_types)
+
+    def run_sharded_model(self, shard_optimizer_state):
+        def add_input_ops(model):
+            pass
+
+        def add_model_ops(model, loss_scale):
+            fc = model.FC("data", "fc", 16, 3,
+                          ("ConstantFill", {"value": 0.1}),
+                          ("ConstantFill", {}))
+            loss = model.AveragedLoss(model.net.Sqr(fc, "sqr"), "loss")
+            return [model.Scale(loss, scale=loss_scale)]
+
+        def add_parameter_update_ops(model):
+            lr = model.param_init_net.ConstantFill(
+                [], "lr", shape=[1], value=0.1)
+            shard = data_parallel_model.GetParamShard(model)
+            if shard is not None:
+                momenta = data_parallel_model.AddParamShardState(
+                    model, "momentum")
+                inputs = [lr]
+                for (_, param, grad), momentum in zip(shard, momenta):
+                    inputs += [grad, momentum, param]
+                if shard:
+                    model.net.MultiTensorMomentumSGDUpdate(
+                        inputs, inputs[1:], momentum=0.9)
+                return
+            for param in model.GetParams():
+                grad = model.param_to_grad[param]
+                momentum = model.param_init_net.ConstantFill(
+                    [param], param + "_momentum", value=0.0)
+                model.net.MomentumSGDUpdate(
+                    [grad, momentum, lr, param], [grad, momentum, param],
+                    momentum=0.9)
+
+        workspace.ResetWorkspace()
+        devices = [0, 1]
+        model = cnn.CNNModelHelper(
+            order="NHWC", name="test_shard{}".format(shard_optimizer_state))
+        data_parallel_model.Parallelize_GPU(
+            model,
+            input_builder_fun=add_input_ops,
+            forward_pass_builder_fun=add_model_ops,
+            param_update_builder_fun=add_parameter_update_ops,
+            devices=devices,
+            use_nccl=True,
+            flatten_params=True,
+            shard_optimizer_state=shard_optimizer_state,
+        )
+        np.random.seed(2603)
+        for i in range(3):
+            for g in devices:
+                workspace.FeedBlob(
+                    "gpu_{}/data".format(g),
+                    np.random.rand(8, 16).astype(np.float32),
+                    device_option=core.DeviceOption(caffe2_pb2.CUDA, g))
+            if i == 0:
+                data_parallel_model.RunInitNet(model)
+            data_parallel_model.RunNet(model, 1)
+        return [workspace.FetchBlob("gpu_{}/fc_w".format(g))
+                for g in devices]
+
+    @unittest.skipIf(not workspace.has_gpu_support, "No gpu support.")
+    @unittest.skipIf(workspace.NumCudaDevices() < 2, "Need at least 2 GPUs.")
+    def test_shard_optimizer_state(self):
+        """
+        Updating the shards of the flat params gives the replicated update,
+        with half the momentum on each of the two gpus.
+        """
+        replicated = self.run_sharded_model(False)
+        sharded = self.run_sharded_model(True)
+        for r, s in zip(replicated, sharded):
+            np.testing.assert_allclose(r, s, rtol=1e-5, atol=1e-6)
+        np.testing.assert_allclose(sharded[0], sharded[1])
+        self.assertEqual(
+            workspace.FetchBlob("gpu_0/flat_momentum_shard").size * 2,
+            workspace.FetchBlob("gpu_0/flat_params").size)
+        self.assertFalse(workspace.HasBlob("gpu_0/fc_w_momentum"))
+
+    @unittest.skipIf(not workspace.has_gpu_support, "No gpu support.")
+    @unittest.skipIf(workspace.NumCudaDevices() < 2, "Need at least 2 GPUs.")
+    def test_link_devices(self):
+        """
+        The ops of link_devices_fun read the blobs that the other gpu computes
+        in its forward pass, and the gradients flow back to that gpu.
+        """
+        def add_input_ops(model):
+            # an input op of the first gpu only
+            if scope.CurrentNameScope() == "gpu_0/":
+                model.net.StopGradient("data", "data")
+
+        def add_model_ops(model, loss_scale):
+            gpu = scope.CurrentDeviceScope().cuda_gpu_id
+            x = model.net.Scale("data", "x", scale=1.0 + gpu)
+            # the other gpu reads its own copy, so that the gradients of x
+            # are summed on its gpu
+            model.net.Copy(x, "x_send")
+            rows, _ = model.net.Concat(
+                [x, "x_other"], ["rows", "rows_split"], axis=0)
+            fc = model.FC(rows, "fc", 4, 1,
+                          ("ConstantFill", {"value": 0.5}),
+                          ("ConstantFill", {}))
+            loss = model.AveragedLoss(fc, "loss")
+            return [model.Scale(loss, scale=loss_scale)]
+
+        def link_devices(model):
+            ops = list(model.net.Proto().op)
+            del model.net.Proto().op[:]
+            for op in ops:
+                if op.type == "Concat":
+                    gpu = op.device_option.cuda_gpu_id
+                    model.net.Proto().op.extend([core.CreateOperator(
+                        "Copy", ["gpu_{}/x_send".format(1 - gpu)],
+                        ["gpu_{}/x_other".format(gpu)],
+                        device_option=op.device_option)])
+                model.net.Proto().op.extend([op])
+
+        def add_parameter_update_ops(model):
+            pass
+
+        workspace.ResetWorkspace()
+        devices = [0, 1]
+        model = cnn.CNNModelHelper(order="NHWC", name="test_link_devices")
+        data_parallel_model.Parallelize_GPU(
+            model,
+            input_builder_fun=add_input_ops,
+            forward_pass_builder_fun=add_model_ops,
+            param_update_builder_fun=add_parameter_update_ops,
+            devices=devices,
+            link_devices_fun=link_devices,
+        )
+        data = [np.random.rand(2, 4).astype(np.float32) for _ in devices]
+        for g in devices:
+            workspace.FeedBlob(
+                "gpu_{}/data".format(g), data[g],
+                device_option=core.DeviceOption(caffe2_pb2.CUDA, g))
+        data_parallel_model.RunInitNet(model)
+        data_parallel_model.RunNet(model, 1)
+        np.testing.assert_allclose(
+            workspace.FetchBlob("gpu_0/rows"),
+            np.concatenate([data[0], 2 * data[1]]), rtol=1e-6)
+        np.testing.assert_allclose(
+            workspace.FetchBlob("gpu_1/rows"),
+            np.concatenate([2 * data[1], data[0]]), rtol=1e-6)
+        # the rows of gpu 1 are scaled by 2 on both gpus
+        np.testing.assert_allclose(
+            workspace.FetchBlob("gpu_1/data_grad"),
+            2 * workspace.FetchBlob("gpu_1/x_grad"), rtol=1e-6)
+        np.testing.assert_allclose(
+            workspace.FetchBlob("gpu_0/fc_w_grad"),
+            workspace.FetchBlob("gpu_1/fc_w_grad"), rtol=1e-5)
+
     def test_device_scope_check(self):
         with self.assertRaises(AssertionError):
             with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, 0)):
@@ -765,6 +765,58 @@ class TestOperators(hu.HypothesisTestCase):
             inputs=[prediction, labels, top_k],
             reference=op_ref)
 
+    @given(prediction=hu.arrays(dims=[10, 5],
+                                elements=st.floats(allow_nan=False,
+                                                   allow_infinity=False,
+                                                   min_value=0,
+                                                   max_value=1)),
+           labels=hu.arrays(dims=[10],
+                            dtype=np.int32,
+                            elements=st.integers(min_value=0,
+                                                 max_value=5 - 1)),
+           first_n=st.integers(min_value=0, max_value=5),
+           **hu.gcs)
+    def test_accumulate_top_k_accuracy(self, prediction, labels, first_n,
+                                       gc, dc):
+        top_k = [1, 3]
+        op = core.CreateOperator(
+            "AccumulateTopKAccuracy",
+            ["prediction", "labels", "counts"],
+            ["counts"],
+            top_k=top_k,
+            first_n=first_n,
+            device_option=gc
+        )
+        num_counts = len(top_k) * (2 if first_n > 0 else 1) + 1
+        counts = np.arange(num_counts).astype(np.float32)
+
+        def rank(scores, label):
+            return 1 + sum(
+                1 for j, item in enumerate(scores)
+                if item > scores[label] or
+                (item == scores[label] and j < label))
+
+        def op_ref(prediction, labels, counts):
+            counts = counts.copy()
+            for i in range(len(prediction)):
+                r = rank(prediction[i], labels[i])
+                r_n = rank(prediction[i][:first_n], labels[i]) \
+                    if labels[i] < first_n else None
+                for k, top in enumerate(top_k):
+                    counts[k] += r <= top
+                    if first_n > 0:
+                        counts[len(top_k) + k] += \
+                            r_n is not None and r_n <= top
+            counts[-1] += len(prediction)
+            return (counts,)
+
+        # the running counts are added to
+        self.assertReferenceChecks(
+            device_option=gc,
+            op=op,
+            inputs=[prediction, labels, counts],
+            reference=op_ref)
+
     @given(target_probabilities=hu.arrays(
         dims=[10], elements=st.floats(allow_nan=False,
                                       allow_infinity=False,
@@ -77,9 +77,18 @@ def share_grad_blobs(
         if (is_grad_op(op)):
             grad_op_indices.append(idx)
 
+    # Blobs that are freed, e.g. the activations of recompute segments,
+    # already give their memory back and cannot be shared
+    freed_blobs = set()
+    for op in net.Proto().op:
+        if op.type == "Free":
+            freed_blobs.update(op.output)
+
     shared_blobs = set()
     for op in net.Proto().op:
         for b in list(op.input) + list(op.output):
+            if b in freed_blobs:
+                continue
             if is_grad_blob(b) or (share_activations and b in activations):
                 shared_blobs.add(b)
     start_time = time.time()
@@ -226,6 +235,60 @@ def estimate_memory_usage(protos, shapes, types, devicescope):
     return (total_allocated, max_allocated, allocs_by_ops)
 
 
+def plan_activation_memory(net, shapes, types, device_option,
+                           dont_share_blobs=None, alignment=256):
+    '''
+    Plans the blobs that the ops of net on device_option write into one
+    arena, by their inferred sizes (shapes and types as returned by
+    workspace.InferShapesAndTypes) and their liveness in the dag of the net,
+    see caffe2/core/memory_planner.h. Unlike share_grad_blobs the net is not
+    renamed: the plan is applied by running the op of add_activation_arena
+    once before the net.
+
+    Returns (blobs, offsets, nbytes, arena_nbytes, total_nbytes,
+    live_nbytes): the planned blobs with their offsets and sizes, the bytes
+    of the arena, the bytes of the blobs without sharing and the most bytes
+    live at once in the op order.
+    '''
+    netproto = net.Proto() if isinstance(net, core.Net) else net
+    shapes_proto = caffe2_pb2.TensorShapes()
+    for blob, dims in viewitems(shapes):
+        shape = shapes_proto.shapes.add()
+        shape.name = blob
+        shape.dims.extend(dims)
+        if blob in types:
+            shape.data_type = types[blob]
+    start_time = time.time()
+    plan = C.memonger_plan_activation_memory(
+        netproto.SerializeToString(),
+        shapes_proto.SerializeToString(),
+        device_option.SerializeToString(),
+        set(str(s).encode('utf-8') for s in dont_share_blobs or []),
+        alignment,
+    )
+    log.info("Activation memory planning took {} secs".format(
+        time.time() - start_time))
+    return plan
+
+
+def add_activation_arena(init_net, plan, device_option):
+    '''
+    Adds the op that allocates the arena of plan on device_option and points
+    the planned blobs into it to init_net.
+    '''
+    blobs, offsets, nbytes, arena_nbytes = plan[:4]
+    if not blobs:
+        return
+    op = core.CreateOperator(
+        "ActivationArena", [], [str(b) for b in blobs],
+        arena_nbytes=arena_nbytes,
+        offsets=list(offsets),
+        nbytes=list(nbytes),
+        device_option=device_option,
+    )
+    init_net.Proto().op.extend([op])
+
+
 def release_blobs_when_used(netproto, dont_free_blobs, selector_fun=None):
     '''
     Insert Free-ops after a blob has been used the last time, so that its
@@ -757,5 +757,53 @@ class MemongerTest(hu.HypothesisTestCase):
         self.assertEqual(expect_frees, found_frees)
 
 
+    def test_plan_activation_memory(self):
+        m = model_helper.ModelHelper()
+        with core.NameScope("name_x"):
+            fc1 = brew.fc(m, "data", "fc1", dim_in=8, dim_out=16)
+            fc2 = brew.fc(m, fc1, "fc2", dim_in=16, dim_out=16)
+            fc3 = brew.fc(m, fc2, "fc3", dim_in=16, dim_out=4)
+            fc3.Relu([], "relu3") \
+               .Softmax([], "pred") \
+               .LabelCrossEntropy(["label"], ["xent"]) \
+               .AveragedLoss([], "loss")
+        input_to_grad = m.AddGradientOperators(["name_x/loss"])
+        data = np.random.randn(6, 8).astype(np.float32)
+        label = np.random.randint(low=0, high=4, size=(6,)).astype(np.int32)
+
+        workspace.RunNetOnce(m.param_init_net)
+        workspace.FeedBlob("name_x/data", data)
+        workspace.FeedBlob("name_x/label", label)
+        workspace.RunNetOnce(m.net)
+        loss = workspace.FetchBlob("name_x/loss")
+        grad = workspace.FetchBlob(str(input_to_grad["name_x/fc1_w"]))
+
+        shapes, types = workspace.InferShapesAndTypes(
+            [m.param_init_net, m.net],
+            {"name_x/data": [6, 8], "name_x/label": [6]},
+        )
+        plan = memonger.plan_activation_memory(
+            m.net, shapes, types, core.DeviceOption(caffe2_pb2.CPU),
+            dont_share_blobs=["name_x/data", "name_x/label", "name_x/loss"])
+        blobs, offsets, nbytes, arena_nbytes, total_nbytes, _ = plan
+        self.assertIn("name_x/fc1", blobs)
+        self.assertNotIn("name_x/fc1_w", blobs)
+        self.assertLess(arena_nbytes, total_nbytes)
+
+        workspace.ResetWorkspace()
+        init_net = core.Net("init")
+        memonger.add_activation_arena(
+            init_net, plan, core.DeviceOption(caffe2_pb2.CPU))
+        workspace.RunNetOnce(m.param_init_net)
+        workspace.RunNetOnce(init_net)
+        workspace.FeedBlob("name_x/data", data)
+        workspace.FeedBlob("name_x/label", label)
+        workspace.RunNetOnce(m.net)
+        np.testing.assert_almost_equal(
+            loss, workspace.FetchBlob("name_x/loss"))
+        np.testing.assert_almost_equal(
+            grad, workspace.FetchBlob(str(input_to_grad["name_x/fc1_w"])))
+
+
 if __name__ == '__main__':
     unittest.main()
@@ -219,6 +219,78 @@ class TestCaffe2Basic(TestCase):
         Y, = c2.run_model(onnx_model, inputs=[X])
         np.testing.assert_almost_equal(Y, X[:, 1:2, :])
 
+    def _export_and_run(self, init_net, predict_net, X):
+        ws, (Y_ref,) = c2_native_run_net(
+            init_net=init_net,
+            predict_net=predict_net,
+            inputs=[X])
+        onnx_model = c2_onnx.caffe2_net_to_onnx_model(
+            predict_net=predict_net,
+            init_net=init_net,
+            value_info={
+                'X': (onnx.mapping.NP_TYPE_TO_TENSOR_TYPE[X.dtype], X.shape)
+            })
+        Y, = c2.run_model(onnx_model, inputs=[X])
+        np.testing.assert_almost_equal(Y, Y_ref, decimal=5)
+
+    def _init_net(self, **params):
+        init_net = caffe2_pb2.NetDef()
+        init_net.name = 'test-init-net'
+        for name, value in sorted(params.items()):
+            init_net.op.extend([core.CreateOperator(
+                'GivenTensorFill', [], [name],
+                shape=value.shape, values=value.flatten())])
+        return init_net
+
+    def test_conv_pool_3d(self):
+        X = np.random.randn(1, 2, 4, 6, 6).astype(np.float32)
+        W = np.random.randn(3, 2, 3, 3, 3).astype(np.float32)
+
+        predict_net = caffe2_pb2.NetDef()
+        predict_net.name = 'test-conv-pool-3d-net'
+        predict_net.external_input[:] = ['X', 'W']
+        predict_net.external_output[:] = ['Y']
+        predict_net.op.extend([
+            core.CreateOperator(
+                'Conv', ['X', 'W'], ['conv'],
+                kernels=[3, 3, 3], pads=[1, 1, 1, 1, 1, 1]),
+            # single value args, given for each of the 3 dims
+            core.CreateOperator(
+                'MaxPool', ['conv'], ['pool'], kernel=2, stride=2),
+            core.CreateOperator('Softmax', ['pool'], ['Y']),
+        ])
+        self._export_and_run(self._init_net(W=W), predict_net, X)
+
+    def test_batch_matmul(self):
+        X = np.random.randn(2, 3, 4).astype(np.float32)
+        B = np.random.randn(2, 5, 4).astype(np.float32)
+
+        predict_net = caffe2_pb2.NetDef()
+        predict_net.name = 'test-batch-matmul-net'
+        predict_net.external_input[:] = ['X', 'B']
+        predict_net.external_output[:] = ['Y']
+        predict_net.op.extend([
+            core.CreateOperator(
+                'BatchMatMul', ['X', 'B'], ['Y'], trans_b=1, alpha=0.5),
+        ])
+        self._export_and_run(self._init_net(B=B), predict_net, X)
+
+    @unittest.skipIf(
+        not core.IsOperator('AffineNd'), 'No video ops in this build')
+    def test_affine_nd(self):
+        X = np.random.randn(1, 3, 2, 4, 4).astype(np.float32)
+        scale = np.random.randn(3).astype(np.float32)
+        bias = np.random.randn(3).astype(np.float32)
+
+        predict_net = caffe2_pb2.NetDef()
+        predict_net.name = 'test-affine-nd-net'
+        predict_net.external_input[:] = ['X', 'scale', 'bias']
+        predict_net.external_output[:] = ['Y']
+        predict_net.op.extend([
+            core.CreateOperator('AffineNd', ['X', 'scale', 'bias'], ['Y']),
+        ])
+        self._export_and_run(
+            self._init_net(scale=scale, bias=bias), predict_net, X)
 
 class TestCaffe2End2End(TestCase):
     def _model_dir(self, model):
@@ -0,0 +1,47 @@
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+from hypothesis import given
+import hypothesis.strategies as st
+import numpy as np
+
+from caffe2.python import core
+import caffe2.python.hypothesis_test_util as hu
+
+
+class TestBucketFlatten(hu.HypothesisTestCase):
+    @given(Xs=st.lists(hu.tensor(min_dim=1, max_dim=3), min_size=1,
+                       max_size=4),
+           **hu.gcs)
+    def test_bucket_flatten(self, Xs, gc, dc):
+        names = ["X{}".format(i) for i in range(len(Xs))]
+        op = core.CreateOperator("BucketFlatten", names, ["bucket"])
+
+        def flatten_ref(*Xs):
+            return np.concatenate([X.flatten() for X in Xs]),
+
+        self.assertReferenceChecks(gc, op, Xs, flatten_ref)
+        self.assertDeviceChecks(dc, op, Xs, [0])
+
+    @given(Xs=st.lists(hu.tensor(min_dim=1, max_dim=3), min_size=1,
+                       max_size=4),
+           **hu.gcs)
+    def test_bucket_unflatten(self, Xs, gc, dc):
+        names = ["X{}".format(i) for i in range(len(Xs))]
+        bucket = np.concatenate([X.flatten() for X in Xs]) * 2
+        op = core.CreateOperator(
+            "BucketUnflatten", ["bucket"] + names, names)
+
+        def unflatten_ref(bucket, *Xs):
+            return tuple(X * 2 for X in Xs)
+
+        self.assertReferenceChecks(gc, op, [bucket] + Xs, unflatten_ref)
+        self.assertDeviceChecks(dc, op, [bucket] + Xs,
+                                list(range(len(Xs))))
+
+
+if __name__ == "__main__":
+    import unittest
+    unittest.main()
@@ -37,6 +37,27 @@ class TestChannelStats(hu.HypothesisTestCase):
                 .astype(np.float32) - 0.5
         self.assertReferenceChecks(gc, op, [X], referenceChannelStatsTest)
 
+    @given(
+        size=st.integers(3, 6),
+        inputChannels=st.integers(1, 10),
+        batchSize=st.integers(1, 3),
+        **hu.gcs
+    )
+    def testChannelStats5d(self, size, inputChannels, batchSize, gc, dc):
+        op = core.CreateOperator(
+            "ChannelStats",
+            ["X"],
+            ["sum", "sumsq"],
+        )
+
+        def referenceChannelStatsTest(X):
+            return (np.sum(X, axis=(0, 2, 3, 4)),
+                    np.sum(X**2, axis=(0, 2, 3, 4)))
+
+        X = np.random.rand(batchSize, inputChannels, 4, size, size)\
+                .astype(np.float32) - 0.5
+        self.assertReferenceChecks(gc, op, [X], referenceChannelStatsTest)
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -4,6 +4,7 @@ from __future__ import print_function
 
 import collections
 import functools
+import unittest
 
 import numpy as np
 from hypothesis import assume, given
@@ -296,6 +297,56 @@ class TestConvolution(hu.HypothesisTestCase):
             kernel, dilation, pad, use_bias, gc, dc
         )
 
+    @given(input_channels=st.integers(1, 2),
+           output_channels=st.integers(1, 2),
+           group=st.integers(1, 2),
+           batch_size=st.integers(1, 2),
+           temporal_stride=st.integers(1, 3),
+           size=st.integers(3, 5),
+           use_bias=st.booleans(),
+           **hu.gcs)
+    def test_3d_pointwise_convolution_nchw(self, input_channels,
+                                           output_channels, group, batch_size,
+                                           temporal_stride, size, use_bias,
+                                           gc, dc):
+        # 1x1x1 kernels with a temporal stride only take the path without
+        # im2col.
+        input_channels *= group
+        output_channels *= group
+        op = core.CreateOperator(
+            "Conv",
+            ["X", "w", "b"] if use_bias else ["X", "w"],
+            ["Y"],
+            strides=[temporal_stride, 1, 1],
+            kernels=[1, 1, 1],
+            group=group,
+            order="NCHW",
+            engine="",
+        )
+        X = np.random.rand(
+            batch_size, input_channels, size, size, size).astype(np.float32)\
+            - 0.5
+        w = np.random.rand(
+            output_channels, input_channels // group, 1, 1, 1).astype(
+                np.float32) - 0.5
+        b = np.random.rand(output_channels).astype(np.float32) - 0.5
+        inputs = [X, w, b] if use_bias else [X, w]
+
+        def ref(X, w, b=None):
+            X = X[:, :, ::temporal_stride]
+            Xg = np.split(X, group, axis=1)
+            wg = np.split(w.reshape(w.shape[:2]), group, axis=0)
+            Y = np.concatenate(
+                [np.einsum('mc,nctij->nmtij', wi, Xi)
+                 for wi, Xi in zip(wg, Xg)], axis=1)
+            if b is not None:
+                Y += b.reshape(1, -1, 1, 1, 1)
+            return (Y,)
+
+        self.assertReferenceChecks(gc, op, inputs, ref)
+        for i in range(len(inputs)):
+            self.assertGradientChecks(gc, op, inputs, i, [0])
+
     @given(op_type=st.sampled_from(["Conv", "Conv3D"]),
            batch_size=st.integers(1, 2),
            stride=st.integers(1, 2),
@@ -344,6 +395,93 @@ class TestConvolution(hu.HypothesisTestCase):
         for i in range(len(inputs)):
             self.assertGradientChecks(gc, op, inputs, i, [0])
 
+    @unittest.skipIf(not workspace.has_gpu_support, "No gpu support.")
+    @given(batch_size=st.integers(1, 2),
+           stride=st.integers(1, 2),
+           size=st.integers(3, 5),
+           kernel=st.integers(1, 3),
+           pad=st.integers(0, 1),
+           input_channels=st.integers(1, 4),
+           output_channels=st.integers(1, 4),
+           use_bias=st.booleans())
+    def test_3d_convolution_cudnn_layout(self, batch_size, stride, size,
+                                         kernel, pad, input_channels,
+                                         output_channels, use_bias):
+        gc = hu.gpu_do
+        X = np.random.rand(batch_size, size, size, size,
+                           input_channels).astype(np.float32) - 0.5
+        w = np.random.rand(output_channels, kernel, kernel, kernel,
+                           input_channels).astype(np.float32) - 0.5
+        b = np.random.rand(output_channels).astype(np.float32) - 0.5
+        outputs = {}
+        for order in ["NCHW", "NHWC"]:
+            op = core.CreateOperator(
+                "Conv",
+                ["X", "w", "b"] if use_bias else ["X", "w"],
+                ["Y"],
+                strides=[stride] * 3,
+                kernels=[kernel] * 3,
+                pads=[pad] * 6,
+                order=order,
+                engine="CUDNN",
+                device_option=gc,
+            )
+            if order == "NCHW":
+                X_f = X.transpose((0, 4, 1, 2, 3))
+                w_f = w.transpose((0, 4, 1, 2, 3))
+            else:
+                X_f = X
+                w_f = w
+            self.ws.create_blob("X").feed(X_f, device_option=gc)
+            self.ws.create_blob("w").feed(w_f, device_option=gc)
+            self.ws.create_blob("b").feed(b, device_option=gc)
+            self.ws.run(op)
+            outputs[order] = self.ws.blobs["Y"].fetch()
+        np.testing.assert_allclose(
+            outputs["NCHW"],
+            outputs["NHWC"].transpose((0, 4, 1, 2, 3)),
+            atol=1e-4,
+            rtol=1e-4)
+
+    @given(batch_size=st.integers(1, 2),
+           kernels=st.sampled_from([[1, 1, 1], [1, 3, 3], [3, 1, 1],
+                                    [3, 3, 3]]),
+           temporal_stride=st.integers(1, 2),
+           stride=st.integers(1, 2),
+           size=st.integers(3, 6),
+           input_channels=st.integers(1, 4),
+           output_channels=st.integers(1, 4))
+    def test_3d_convolution_mkldnn(self, batch_size, kernels, temporal_stride,
+                                   stride, size, input_channels,
+                                   output_channels):
+        # the MKLDNN engine runs 3D convolutions as 2D ones over the frames
+        # of every clip, compare it with the generic implementation
+        pads = [k // 2 for k in kernels] * 2
+        X = np.random.rand(batch_size, input_channels, size + 1, size,
+                           size).astype(np.float32) - 0.5
+        w = np.random.rand(output_channels, input_channels,
+                           *kernels).astype(np.float32) - 0.5
+        b = np.random.rand(output_channels).astype(np.float32) - 0.5
+        outputs = {}
+        for engine in ["", "MKLDNN"]:
+            op = core.CreateOperator(
+                "Conv",
+                ["X", "w", "b"],
+                ["Y"],
+                strides=[temporal_stride, stride, stride],
+                kernels=kernels,
+                pads=pads,
+                order="NCHW",
+                engine=engine,
+            )
+            self.ws.create_blob("X").feed(X)
+            self.ws.create_blob("w").feed(w)
+            self.ws.create_blob("b").feed(b)
+            self.ws.run(op)
+            outputs[engine] = self.ws.blobs["Y"].fetch()
+        np.testing.assert_allclose(
+            outputs[""], outputs["MKLDNN"], atol=1e-4, rtol=1e-4)
+
     @given(op_type=st.sampled_from(["Conv", "Conv2D"]),
            stride=st.integers(1, 3),
            pad=st.integers(0, 3),
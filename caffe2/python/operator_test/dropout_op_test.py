@@ -8,7 +8,7 @@ import hypothesis.strategies as st
 import numpy as np
 
 from caffe2.proto import caffe2_pb2
-from caffe2.python import core
+from caffe2.python import core, workspace
 import caffe2.python.hypothesis_test_util as hu
 
 
@@ -72,3 +72,29 @@ class TestDropout(hu.HypothesisTestCase):
             gc, op, [X], reference_dropout_ratio0,
             # Don't check the mask with cuDNN because it's packed data
             outputs_to_check=None if engine != 'CUDNN' else [0])
+
+    @given(X=hu.tensor(elements=st.floats(1.0, 2.0)),
+           in_place=st.booleans(),
+           ratio=st.floats(0, 0.9),
+           **hu.gcs)
+    def test_dropout_regenerate_mask(self, X, in_place, ratio, gc, dc):
+        """The gradient regenerates the mask of the dropout from its seed."""
+        Y_name = "X" if in_place else "Y"
+        op = core.CreateOperator(
+            "Dropout", ["X"], [Y_name, "state"],
+            ratio=ratio, is_test=False, regenerate_mask=1, device_option=gc)
+        grad_op = core.CreateOperator(
+            "DropoutGrad", ["dY", "state"], ["dX"],
+            ratio=ratio, is_test=False, regenerate_mask=1, device_option=gc)
+        workspace.FeedBlob("X", X, device_option=gc)
+        workspace.FeedBlob("dY", np.ones_like(X), device_option=gc)
+        workspace.RunOperatorOnce(op)
+        workspace.RunOperatorOnce(grad_op)
+        Y = workspace.FetchBlob(Y_name)
+        dX = workspace.FetchBlob("dX")
+        scale = 1. / (1. - ratio)
+        keep = Y != 0
+        np.testing.assert_allclose(Y[keep], X[keep] * scale, rtol=1e-5)
+        np.testing.assert_array_equal(dX != 0, keep)
+        np.testing.assert_allclose(dX[keep], scale, rtol=1e-5)
+        self.assertEqual(workspace.FetchBlob("state").shape, (2,))
@@ -0,0 +1,136 @@
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+from hypothesis import given
+import hypothesis.strategies as st
+import numpy as np
+
+from caffe2.python import core, workspace
+import caffe2.python.hypothesis_test_util as hu
+
+
+def _flat_buffer(Xs, size_multiple=1):
+    # every view starts at a multiple of 128 bytes, the padding is zero
+    align = 128 // 4
+    chunks = []
+    for X in Xs:
+        padded = (X.size + align - 1) // align * align
+        chunks.append(np.pad(X.flatten(), (0, padded - X.size), 'constant'))
+    flat = np.concatenate(chunks).astype(np.float32)
+    size = (flat.size + size_multiple - 1) // size_multiple * size_multiple
+    return np.pad(flat, (0, size - flat.size), 'constant')
+
+
+class TestFlatBuffer(hu.HypothesisTestCase):
+    @given(Xs=st.lists(hu.tensor(min_dim=1, max_dim=3), min_size=1,
+                       max_size=4),
+           copy=st.booleans(),
+           **hu.gcs)
+    def test_create_flat_buffer(self, Xs, copy, gc, dc):
+        names = ["X{}".format(i) for i in range(len(Xs))]
+        views = ["Y{}".format(i) for i in range(len(Xs))]
+        op = core.CreateOperator(
+            "CreateFlatBuffer", names, views + ["buffer"], copy=int(copy))
+
+        def create_ref(*Xs):
+            if not copy:
+                Xs = [np.zeros_like(X) for X in Xs]
+            return tuple(Xs) + (_flat_buffer(Xs),)
+
+        self.assertReferenceChecks(gc, op, Xs, create_ref)
+        self.assertDeviceChecks(dc, op, Xs, list(range(len(Xs) + 1)))
+
+    @given(Xs=st.lists(hu.tensor(min_dim=1, max_dim=3), min_size=1,
+                       max_size=4),
+           **hu.gcs)
+    def test_views_share_the_buffer(self, Xs, gc, dc):
+        names = ["X{}".format(i) for i in range(len(Xs))]
+        for name, X in zip(names, Xs):
+            workspace.FeedBlob(name, X, device_option=gc)
+        workspace.RunOperatorOnce(core.CreateOperator(
+            "CreateFlatBuffer", names, names + ["buffer"],
+            device_option=gc))
+
+        # an op on the views is seen in the buffer, and the other way round
+        for name in names:
+            workspace.RunOperatorOnce(core.CreateOperator(
+                "Scale", name, name, scale=2.0, device_option=gc))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            "FlatBufferFromViews", names + ["buffer"], "buffer",
+            device_option=gc))
+        np.testing.assert_allclose(
+            workspace.FetchBlob("buffer"),
+            _flat_buffer([X * 2 for X in Xs]), rtol=1e-5)
+
+        workspace.RunOperatorOnce(core.CreateOperator(
+            "Scale", "buffer", "buffer", scale=0.5, device_option=gc))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            "FlatBufferToViews", ["buffer"] + names, names,
+            device_option=gc))
+        for name, X in zip(names, Xs):
+            np.testing.assert_allclose(
+                workspace.FetchBlob(name), X, rtol=1e-5)
+
+    @given(X=hu.tensor(min_dim=1, max_dim=2), **hu.gcs)
+    def test_reallocated_view(self, X, gc, dc):
+        workspace.FeedBlob("X", X, device_option=gc)
+        workspace.RunOperatorOnce(core.CreateOperator(
+            "CreateFlatBuffer", ["X"], ["X", "buffer"], device_option=gc))
+        workspace.FeedBlob(
+            "X", np.concatenate([X.flatten()] * 2), device_option=gc)
+        with self.assertRaises(RuntimeError):
+            workspace.RunOperatorOnce(core.CreateOperator(
+                "FlatBufferFromViews", ["X", "buffer"], "buffer",
+                device_option=gc))
+
+    @given(Xs=st.lists(hu.tensor(min_dim=1, max_dim=3), min_size=1,
+                       max_size=4),
+           num_shards=st.integers(1, 5),
+           **hu.gcs)
+    def test_shards_and_slices(self, Xs, num_shards, gc, dc):
+        names = ["X{}".format(i) for i in range(len(Xs))]
+        for name, X in zip(names, Xs):
+            workspace.FeedBlob(name, X, device_option=gc)
+        workspace.RunOperatorOnce(core.CreateOperator(
+            "CreateFlatBuffer", names, names + ["buffer"],
+            size_multiple=num_shards, device_option=gc))
+        flat = _flat_buffer(Xs, num_shards)
+        np.testing.assert_allclose(workspace.FetchBlob("buffer"), flat)
+
+        shard_size = flat.size // num_shards
+        shard_id = num_shards - 1
+        workspace.RunOperatorOnce(core.CreateOperator(
+            "FlatBufferShards", "buffer", ["shards", "shard"],
+            num_shards=num_shards, shard_id=shard_id, device_option=gc))
+        np.testing.assert_allclose(
+            workspace.FetchBlob("shards"),
+            flat.reshape(num_shards, shard_size))
+        np.testing.assert_allclose(
+            workspace.FetchBlob("shard"),
+            flat[shard_id * shard_size:(shard_id + 1) * shard_size])
+
+        # the slices of the shard write into the buffer and its views
+        starts = [0, shard_size // 2]
+        lengths = [shard_size // 2, shard_size - shard_size // 2]
+        workspace.RunOperatorOnce(core.CreateOperator(
+            "FlatBufferSlices", "shard", ["slice0", "slice1"],
+            starts=starts, lengths=lengths, device_option=gc))
+        for name in ["slice0", "slice1"]:
+            workspace.RunOperatorOnce(core.CreateOperator(
+                "Scale", name, name, scale=2.0, device_option=gc))
+        workspace.RunOperatorOnce(core.CreateOperator(
+            "FlatBufferFromViews", ["slice0", "slice1", "shard"], "shard",
+            starts=starts, device_option=gc))
+        flat[shard_id * shard_size:] *= 2
+        np.testing.assert_allclose(
+            workspace.FetchBlob("buffer"), flat, rtol=1e-5)
+        workspace.RunOperatorOnce(core.CreateOperator(
+            "FlatBufferToViews", ["buffer"] + names, names,
+            device_option=gc))
+
+
+if __name__ == "__main__":
+    import unittest
+    unittest.main()
@@ -237,7 +237,8 @@ def create_test(output_dir, width, height, default_bound, minsize, crop, means,
 
 def run_test(
         size_tuple, means, stds, label_type, num_labels, is_test, scale_jitter_type,
-        color_jitter, color_lighting, dc, validator, output1=None, output2_size=None):
+        color_jitter, color_lighting, dc, validator, output1=None, output2_size=None,
+        prefetch_depth=1):
     # TODO: Does not test on GPU and does not test use_gpu_transform
     # WARNING: Using ModelHelper automatically does NHWC to NCHW
     # transformation if needed.
@@ -300,7 +301,8 @@ def run_test(
                 output_sizes=output_sizes,
                 scale_jitter_type=scale_jitter_type,
                 color_jitter=color_jitter,
-                color_lighting=color_lighting
+                color_lighting=color_lighting,
+                prefetch_depth=prefetch_depth
             )
 
             imageop.device_option.CopyFrom(device_option)
@@ -365,12 +367,13 @@ class TestImport(hu.HypothesisTestCase):
         scale_jitter_type=st.integers(min_value=0, max_value=1),
         color_jitter=st.integers(min_value=0, max_value=1),
         color_lighting=st.integers(min_value=0, max_value=1),
+        prefetch_depth=st.integers(min_value=1, max_value=3),
         **hu.gcs)
     @settings(verbosity=Verbosity.verbose)
     def test_imageinput(
             self, size_tuple, means, stds, label_type,
             num_labels, is_test, scale_jitter_type, color_jitter, color_lighting,
-            gc, dc):
+            prefetch_depth, gc, dc):
         def validator(expected_images, device_option, count_images):
             self.validate_image_and_label(
                 expected_images, device_option, count_images, label_type,
@@ -378,7 +381,8 @@ class TestImport(hu.HypothesisTestCase):
         # End validator
         run_test(
             size_tuple, means, stds, label_type, num_labels, is_test,
-            scale_jitter_type, color_jitter, color_lighting, dc, validator)
+            scale_jitter_type, color_jitter, color_lighting, dc, validator,
+            prefetch_depth=prefetch_depth)
     # End test_imageinput
 
     @given(size_tuple=st.tuples(
@@ -78,6 +78,61 @@ class TestLearningRate(hu.HypothesisTestCase):
         )
         self.assertReferenceChecks(gc, op, [iter], ref)
 
+    @given(**hu.gcs_cpu_only)
+    def test_steps_with_relative_lrs_learning_rate_op(self, gc, dc):
+        iter = np.random.randint(low=0, high=400, size=1)
+        steps = [0, 100, 200, 300]
+        lrs = [1.0, 0.1, 0.01, 0.001]
+        num_iter = 50
+        start_multiplier = 0.1
+        base_lr = float(np.random.random(1))
+
+        def step(iter):
+            return lrs[np.searchsorted(steps, iter, side='right') - 1]
+
+        def ref(iter):
+            iter = int(iter)
+            lr = step(iter)
+            if iter < num_iter:
+                lr = iter * (step(num_iter) - start_multiplier) / (
+                    num_iter - 1) + start_multiplier
+            return (np.array(base_lr * lr), )
+
+        op = core.CreateOperator(
+            'LearningRate',
+            'iter',
+            'lr',
+            policy="stepsWithRelativeLrs",
+            base_lr=base_lr,
+            steps=steps,
+            lrs=lrs,
+            num_iter=num_iter,
+            start_multiplier=start_multiplier,
+        )
+        self.assertReferenceChecks(gc, op, [iter], ref)
+
+    @given(**hu.gcs_cpu_only)
+    def test_learning_rate_op_scales_momentum(self, gc, dc):
+        # the first run of a resumed run at a step scales the momentum by
+        # the lr of the step over the lr of the iteration before
+        iter = np.array([100], dtype=np.int64)
+        momentum = np.random.randn(4, 3).astype(np.float32)
+        base_lr = 0.5
+
+        def ref(iter, momentum):
+            return (np.array(base_lr * 0.1), momentum * 0.1)
+
+        op = core.CreateOperator(
+            'LearningRate',
+            ['iter', 'momentum'],
+            ['lr', 'momentum'],
+            policy="stepsWithRelativeLrs",
+            base_lr=base_lr,
+            steps=[0, 100],
+            lrs=[1.0, 0.1],
+        )
+        self.assertReferenceChecks(gc, op, [iter, momentum], ref)
+
 
 if __name__ == "__main__":
     import unittest
@@ -317,6 +317,54 @@ class TestLoadSave(TestLoadSaveBase):
                 if e.errno != errno.ENOENT:
                     raise
 
+    def testAsyncCheckpoint(self):
+        names = ['gpu_0/blob_{}'.format(i) for i in range(4)]
+        blobs = [np.random.rand(1000 + i).astype(np.float32)
+                 for i in range(4)]
+        for name, blob in zip(names, blobs):
+            workspace.FeedBlob(name, blob)
+        workspace.FeedBlob('iter', np.array([0], dtype=np.int64))
+        tmp_folder = tempfile.mkdtemp()
+        try:
+            net = core.Net('checkpoint')
+            net.Checkpoint(
+                ['iter'] + names, [],
+                absolute_path=1,
+                strip_prefix='gpu_0/',
+                db=os.path.join(tmp_folder, 'db_%d'),
+                db_type=self._db_type,
+                num_threads=3,
+                async_save=1,
+            )
+            workspace.CreateNet(net)
+            for i in range(2):
+                workspace.FeedBlob('iter', np.array([i], dtype=np.int64))
+                workspace.RunNet(net)
+                # the snapshot is taken when the op runs
+                workspace.FeedBlob(names[0], blobs[0] + 1)
+            # the pending save finishes with the net
+            workspace.ResetWorkspace()
+            for i in range(2):
+                workspace.RunOperatorOnce(
+                    core.CreateOperator(
+                        "Load", [], ['blob_{}'.format(j) for j in range(4)],
+                        absolute_path=1,
+                        db=os.path.join(tmp_folder, 'db_{}'.format(i)),
+                        db_type=self._db_type,
+                    )
+                )
+                np.testing.assert_array_equal(
+                    workspace.FetchBlob('blob_0'), blobs[0] + i)
+                for j in range(1, 4):
+                    np.testing.assert_array_equal(
+                        workspace.FetchBlob('blob_{}'.format(j)), blobs[j])
+        finally:
+            try:
+                shutil.rmtree(tmp_folder)
+            except OSError as e:
+                if e.errno != errno.ENOENT:
+                    raise
+
     def testMissingFile(self):
         tmp_folder = tempfile.mkdtemp()
         tmp_file = os.path.join(tmp_folder, "missing_db")
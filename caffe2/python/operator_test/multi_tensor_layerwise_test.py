@@ -0,0 +1,141 @@
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+from caffe2.python import core
+import caffe2.python.hypothesis_test_util as hu
+
+from hypothesis import given
+import hypothesis.strategies as st
+import numpy as np
+import unittest
+
+
+def _trust_ratio(param, update, trust, scale):
+    param_norm = np.linalg.norm(param)
+    update_norm = np.linalg.norm(update)
+    if not trust or param_norm == 0 or update_norm == 0:
+        return 1.0
+    return scale(param_norm, update_norm)
+
+
+class TestMultiTensorLayerwise(hu.HypothesisTestCase):
+    @given(sizes=st.lists(st.integers(1, 20000), min_size=1, max_size=4),
+           **hu.gcs)
+    def test_multi_tensor_lars(self, sizes, gc, dc):
+        momentum = 0.9
+        eta = 0.01
+        offset = 0.1
+        grad_scale = 0.5
+        weight_decay = [1e-4, 1e-2]
+        trust = [1, 0]
+        groups = [i % 2 for i in range(len(sizes))]
+        lr = np.random.rand(1).astype(np.float32)
+        inputs = [lr]
+        names = ["lr"]
+        for i, n in enumerate(sizes):
+            inputs += [np.random.rand(n).astype(np.float32) for _ in range(3)]
+            names += ["grad_{}".format(i), "momentum_{}".format(i),
+                      "param_{}".format(i)]
+
+        def multi_tensor_lars(lr, *tensors):
+            outputs = []
+            for i in range(len(tensors) // 3):
+                grad, m, param = tensors[3 * i:3 * i + 3]
+                grad = grad_scale * grad + weight_decay[groups[i]] * param
+                local_lr = lr * _trust_ratio(
+                    param, grad, trust[groups[i]],
+                    lambda p, u: eta * p / (u + offset * p))
+                m_new = momentum * m + local_lr * grad
+                outputs += [m_new, m_new, param - m_new]
+            return outputs
+
+        op = core.CreateOperator(
+            "MultiTensorLarsUpdate",
+            names,
+            names[1:],
+            momentum=momentum,
+            eta=eta,
+            offset=offset,
+            grad_scale=grad_scale,
+            weight_decay=weight_decay,
+            trust=trust,
+            groups=groups,
+        )
+
+        self.assertReferenceChecks(
+            device_option=gc,
+            op=op,
+            inputs=inputs,
+            reference=multi_tensor_lars,
+            threshold=1e-3,
+        )
+
+        self.assertDeviceChecks(dc, op, inputs, list(range(len(names) - 1)))
+
+    @given(sizes=st.lists(st.integers(1, 20000), min_size=1, max_size=4),
+           iteration=st.integers(0, 100),
+           **hu.gcs)
+    def test_multi_tensor_lamb(self, sizes, iteration, gc, dc):
+        beta1 = 0.9
+        beta2 = 0.999
+        epsilon = 1e-6
+        weight_decay = [1e-2, 0.0]
+        trust = [1, 0]
+        groups = [i % 2 for i in range(len(sizes))]
+        lr = np.random.rand(1).astype(np.float32)
+        it = np.array([iteration], dtype=np.int64)
+        inputs = [lr, it]
+        names = ["lr", "iter"]
+        for i, n in enumerate(sizes):
+            inputs += [np.random.rand(n).astype(np.float32) for _ in range(4)]
+            names += ["grad_{}".format(i), "m1_{}".format(i),
+                      "m2_{}".format(i), "param_{}".format(i)]
+
+        def multi_tensor_lamb(lr, it, *tensors):
+            t = it[0] + 1
+            outputs = []
+            for i in range(len(tensors) // 4):
+                grad, m1, m2, param = tensors[4 * i:4 * i + 4]
+                m1 = beta1 * m1 + (1 - beta1) * grad
+                m2 = beta2 * m2 + (1 - beta2) * np.square(grad)
+                update = (m1 / (1 - beta1 ** t)) / (
+                    np.sqrt(m2 / (1 - beta2 ** t)) + epsilon) + \
+                    weight_decay[groups[i]] * param
+                step = lr * _trust_ratio(
+                    param, update, trust[groups[i]],
+                    lambda p, u: p / u) * update
+                outputs += [step, m1, m2, param - step]
+            return outputs
+
+        op = core.CreateOperator(
+            "MultiTensorLambUpdate",
+            names,
+            names[2:],
+            beta1=beta1,
+            beta2=beta2,
+            epsilon=epsilon,
+            weight_decay=weight_decay,
+            trust=trust,
+            groups=groups,
+        )
+        # iter lives on the CPU
+        input_device_options = {"iter": hu.cpu_do}
+
+        self.assertReferenceChecks(
+            device_option=gc,
+            op=op,
+            inputs=inputs,
+            reference=multi_tensor_lamb,
+            threshold=1e-3,
+            input_device_options=input_device_options,
+        )
+
+        self.assertDeviceChecks(
+            dc, op, inputs, list(range(len(names) - 2)),
+            input_device_options=input_device_options)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,68 @@
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+from caffe2.python import core
+import caffe2.python.hypothesis_test_util as hu
+
+from hypothesis import given
+import hypothesis.strategies as st
+import numpy as np
+import unittest
+
+
+class TestMultiTensorMomentumSGD(hu.HypothesisTestCase):
+    @given(sizes=st.lists(st.integers(1, 20000), min_size=1, max_size=4),
+           nesterov=st.booleans(), **hu.gcs)
+    def test_multi_tensor_momentum_sgd(self, sizes, nesterov, gc, dc):
+        momentum = 0.9
+        grad_scale = 0.5
+        weight_decay = [1e-4, 1e-2]
+        groups = [i % 2 for i in range(len(sizes))]
+        lr = np.random.rand(1).astype(np.float32)
+        inputs = [lr]
+        names = ["lr"]
+        for i, n in enumerate(sizes):
+            inputs += [np.random.rand(n).astype(np.float32) for _ in range(3)]
+            names += ["grad_{}".format(i), "momentum_{}".format(i),
+                      "param_{}".format(i)]
+
+        def multi_tensor_momentum_sgd(lr, *tensors):
+            outputs = []
+            for i in range(len(tensors) // 3):
+                grad, m, param = tensors[3 * i:3 * i + 3]
+                grad = grad_scale * grad + weight_decay[groups[i]] * param
+                if not nesterov:
+                    m_new = lr * grad + momentum * m
+                    grad_new = m_new
+                else:
+                    m_new = momentum * m + lr * grad
+                    grad_new = (1 + momentum) * m_new - momentum * m
+                outputs += [grad_new, m_new, param - grad_new]
+            return outputs
+
+        op = core.CreateOperator(
+            "MultiTensorMomentumSGDUpdate",
+            names,
+            names[1:],
+            momentum=momentum,
+            nesterov=int(nesterov),
+            grad_scale=grad_scale,
+            weight_decay=weight_decay,
+            groups=groups,
+        )
+
+        self.assertReferenceChecks(
+            device_option=gc,
+            op=op,
+            inputs=inputs,
+            reference=multi_tensor_momentum_sgd,
+            threshold=1e-3,
+        )
+
+        self.assertDeviceChecks(dc, op, inputs, list(range(len(names) - 1)))
+
+
+if __name__ == "__main__":
+    unittest.main()
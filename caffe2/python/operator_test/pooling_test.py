@@ -178,6 +178,54 @@ class TestPooling(hu.HypothesisTestCase):
         if 'MaxPool' not in op_type:
             self.assertGradientChecks(gc, op, [X], 0, [0], threshold=0.001)
 
+    @given(window=st.sampled_from([
+               # (kernels, strides, pads) of the video nets' pooling layers
+               ([1, 2, 2], [1, 2, 2], [0, 0, 0]),
+               ([1, 3, 3], [1, 2, 2], [0, 1, 1]),
+               ([3, 3, 3], [2, 2, 2], [1, 1, 1]),
+               ([2, 1, 1], [2, 1, 1], [0, 0, 0])]),
+           time=st.integers(2, 5),
+           size=st.integers(4, 7),
+           input_channels=st.integers(1, 3),
+           batch_size=st.integers(1, 2),
+           op_type=st.sampled_from(["MaxPool", "AveragePool"]),
+           **hu.gcs_cpu_only)
+    def test_pooling_3d_anisotropic(self, window, time, size, input_channels,
+                                    batch_size, op_type, gc, dc):
+        kernels, strides, pads = window
+        op = core.CreateOperator(
+            op_type,
+            ["X"],
+            ["Y"],
+            kernels=kernels,
+            strides=strides,
+            pads=pads * 2,
+            order="NCHW",
+        )
+        X = np.random.rand(
+            batch_size, input_channels, time, size, size).astype(np.float32)
+
+        def pool_ref(X):
+            dims = X.shape[2:]
+            out = [(d + 2 * p - k) // s + 1
+                   for d, k, s, p in zip(dims, kernels, strides, pads)]
+            Y = np.zeros(X.shape[:2] + tuple(out), dtype=np.float32)
+            for t in range(out[0]):
+                for h in range(out[1]):
+                    for w in range(out[2]):
+                        x = X
+                        for axis, i in enumerate([t, h, w]):
+                            start = i * strides[axis] - pads[axis]
+                            end = min(start + kernels[axis], dims[axis])
+                            x = np.take(
+                                x, range(max(start, 0), end),
+                                axis=axis + 2)
+                        reduce = np.max if op_type == "MaxPool" else np.mean
+                        Y[:, :, t, h, w] = reduce(x, axis=(2, 3, 4))
+            return (Y,)
+
+        self.assertReferenceChecks(gc, op, [X], pool_ref)
+
     @unittest.skipIf(not workspace.has_gpu_support, "No GPU support")
     @given(stride=st.integers(1, 3),
            pad=st.integers(0, 3),
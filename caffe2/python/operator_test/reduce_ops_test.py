@@ -174,6 +174,21 @@ class TestReduceFrontReductions(hu.HypothesisTestCase):
         self.grad_variant_input_test(
             "ReduceFrontSumGradient", X, ref_sum, num_reduce_dim)
 
+    @given(op_name=st.sampled_from(["ReduceFrontSum", "ReduceFrontMean"]),
+           num_reduce_dim=st.integers(1, 4), **hu.gcs)
+    def test_reduce_front_5d(self, op_name, num_reduce_dim, gc, dc):
+        # N x T x H x W x C, with enough rows and columns for the tiled
+        # CUDA kernels and their row chunks
+        X = np.random.rand(8, 4, 3, 5, 40).astype(np.float32)
+        reduce = np.sum if op_name == "ReduceFrontSum" else np.mean
+
+        def ref(X):
+            return [reduce(X, axis=tuple(range(num_reduce_dim)))]
+
+        op = core.CreateOperator(
+            op_name, ["input"], ["outputs"], num_reduce_dim=num_reduce_dim)
+        self.assertReferenceChecks(gc, op, [X], ref, threshold=1e-3)
+
     @given(**hu.gcs)
     def test_reduce_front_sum_with_length(self, dc, gc):
         num_reduce_dim = 1
@@ -295,6 +310,20 @@ class TestReduceFrontReductions(hu.HypothesisTestCase):
         self.grad_variant_input_test(
             "ReduceBackSumGradient", X, ref_sum, num_reduce_dim)
 
+    @given(op_name=st.sampled_from(["ReduceBackSum", "ReduceBackMean"]),
+           num_reduce_dim=st.integers(1, 3), **hu.gcs)
+    def test_reduce_back_5d(self, op_name, num_reduce_dim, gc, dc):
+        # short rows are summed by a warp each on CUDA, long ones by a block
+        X = np.random.rand(2, 3, 8, 6, 7).astype(np.float32)
+        reduce = np.sum if op_name == "ReduceBackSum" else np.mean
+
+        def ref(X):
+            return [reduce(X, axis=tuple(range(5 - num_reduce_dim, 5)))]
+
+        op = core.CreateOperator(
+            op_name, ["input"], ["outputs"], num_reduce_dim=num_reduce_dim)
+        self.assertReferenceChecks(gc, op, [X], ref, threshold=1e-3)
+
     @given(**hu.gcs)
     def test_reduce_back_sum_with_length(self, dc, gc):
         num_reduce_dim = 1
@@ -0,0 +1,34 @@
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+from hypothesis import given
+import hypothesis.strategies as st
+import numpy as np
+from caffe2.python import core
+import caffe2.python.hypothesis_test_util as hu
+import unittest
+
+
+class TestScaleByInverseCount(hu.HypothesisTestCase):
+    @given(axis=st.integers(-3, 2), inplace=st.booleans(), **hu.gcs)
+    def test_scale_by_inverse_count(self, axis, inplace, gc, dc):
+        X = np.random.rand(2, 3, 4).astype(np.float32) - 0.5
+        op = core.CreateOperator(
+            "ScaleByInverseCount",
+            ["X"],
+            ["X" if inplace else "Y"],
+            axis=axis,
+        )
+
+        def ref(X):
+            return [X / np.prod(X.shape[axis:])]
+
+        self.assertReferenceChecks(gc, op, [X], ref)
+        self.assertDeviceChecks(dc, op, [X], [0])
+        self.assertGradientChecks(gc, op, [X], 0, [0])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -6,17 +6,23 @@
 #include "caffe2/contrib/script/compiler.h"
 #include "caffe2/core/asan.h"
 #include "caffe2/core/db.h"
+#include "caffe2/core/mapped_weights.h"
+#include "caffe2/core/memory_planner.h"
 #include "caffe2/core/numa.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/core/predictor.h"
 #include "caffe2/core/stats.h"
 #include "caffe2/core/transform.h"
 #include "caffe2/mkl/mkl_utils.h"
+#include "caffe2/observers/memory_observer.h"
+#include "caffe2/observers/prefetch_wait_observer.h"
 #include "caffe2/observers/runcnt_observer.h"
 #include "caffe2/observers/time_observer.h"
+#include "caffe2/observers/timeline_observer.h"
 #include "caffe2/onnx/backend.h"
 #include "caffe2/onnx/helper.h"
 #include "caffe2/onnx/onnx_exporter.h"
+#include "caffe2/transforms/optimize_video_inference.h"
 #include "caffe2/utils/cpuid.h"
 #include "caffe2/utils/string_utils.h"
 
@@ -38,6 +44,28 @@ static Workspace* gWorkspace = nullptr;
 static std::string gCurrentWorkspaceName;
 
 BlobFetcherBase::~BlobFetcherBase() {}
+BlobFetcherBase::PendingFetch::~PendingFetch() {}
+
+namespace {
+// a fetch that is already done
+class ReadyFetch : public BlobFetcherBase::PendingFetch {
+ public:
+  explicit ReadyFetch(py::object obj) : obj_(std::move(obj)) {}
+
+ protected:
+  py::object Finish() override {
+    return obj_;
+  }
+
+ private:
+  py::object obj_;
+};
+} // namespace
+
+std::unique_ptr<BlobFetcherBase::PendingFetch> BlobFetcherBase::FetchAsync(
+    const Blob& blob) {
+  return caffe2::make_unique<ReadyFetch>(Fetch(blob));
+}
 BlobFeederBase::~BlobFeederBase() {}
 
 CAFFE_DEFINE_TYPED_REGISTRY(
@@ -170,6 +198,33 @@ py::object fetchBlob(Workspace* ws, const std::string& name) {
     return py::bytes(ss.str());
   }
 }
+
+std::unique_ptr<BlobFetcherBase::PendingFetch> fetchBlobAsync(
+    Workspace* ws,
+    const std::string& name) {
+  CAFFE_ENFORCE(ws->HasBlob(name), "Can't find blob: ", name);
+  const caffe2::Blob& blob = *(ws->GetBlob(name));
+  auto fetcher = CreateFetcher(blob.meta().id());
+  if (fetcher) {
+    return fetcher->FetchAsync(blob);
+  }
+  return caffe2::make_unique<ReadyFetch>(fetchBlob(ws, name));
+}
+
+// Starts the copies of all the blobs before waiting for any of them.
+std::vector<py::object> fetchBlobs(
+    Workspace* ws,
+    const std::vector<std::string>& names) {
+  std::vector<std::unique_ptr<BlobFetcherBase::PendingFetch>> pending;
+  for (const auto& name : names) {
+    pending.push_back(fetchBlobAsync(ws, name));
+  }
+  std::vector<py::object> fetched;
+  for (auto& fetch : pending) {
+    fetched.push_back(fetch->Wait());
+  }
+  return fetched;
+}
 } // namespace python_detail
 
 class GetPythonGradient : public GradientMakerBase {
@@ -257,10 +312,40 @@ void addObjectMethods(py::module& m) {
                 cast_ob, "Observer does not implement this function.");
             return cast_ob->average_time_children();
           })
+      .def(
+          "stall_fraction",
+          [](ObserverBase<NetBase>* ob) {
+            auto* cast_ob = dynamic_cast_if_rtti<PrefetchWaitObserver*>(ob);
+            CAFFE_ENFORCE(
+                cast_ob, "Observer does not implement this function.");
+            return cast_ob->stall_fraction();
+          })
+      .def(
+          "average_wait_time",
+          [](ObserverBase<NetBase>* ob) {
+            auto* cast_ob = dynamic_cast_if_rtti<PrefetchWaitObserver*>(ob);
+            CAFFE_ENFORCE(
+                cast_ob, "Observer does not implement this function.");
+            return cast_ob->average_wait_time();
+          })
+      .def(
+          "reset",
+          [](ObserverBase<NetBase>* ob) {
+            auto* cast_ob = dynamic_cast_if_rtti<PrefetchWaitObserver*>(ob);
+            CAFFE_ENFORCE(
+                cast_ob, "Observer does not implement this function.");
+            cast_ob->reset();
+          })
       .def("debug_info", [](ObserverBase<NetBase>* ob) {
         return ob->debugInfo();
       });
 
+  py::class_<BlobFetcherBase::PendingFetch>(m, "PendingFetch")
+      .def(
+          "wait",
+          &BlobFetcherBase::PendingFetch::Wait,
+          "Waits for the fetch and returns the fetched blob.");
+
   py::class_<Blob>(m, "Blob")
       .def(
           "serialize",
@@ -1027,6 +1112,9 @@ void addGlobalMethods(py::module& m) {
   }
 
         REGISTER_PYTHON_EXPOSED_OBSERVER(TimeObserver);
+        REGISTER_PYTHON_EXPOSED_OBSERVER(PrefetchWaitObserver);
+        REGISTER_PYTHON_EXPOSED_OBSERVER(TimelineObserver);
+        REGISTER_PYTHON_EXPOSED_OBSERVER(MemoryObserver);
 #undef REGISTER_PYTHON_EXPOSED_OBSERVER
 
         if (observer_type.compare("RunCountObserver") == 0) {
@@ -1078,6 +1166,17 @@ void addGlobalMethods(py::module& m) {
     return true;
   });
   m.def("nets", []() { return gWorkspace->Nets(); });
+  m.def(
+      "save_mapped_weights",
+      [](const std::string& path, const std::vector<std::string>& blobs) {
+        CAFFE_ENFORCE(gWorkspace);
+        SaveMappedWeights(path, *gWorkspace, blobs);
+        return true;
+      });
+  m.def("load_mapped_weights", [](const std::string& path) {
+    CAFFE_ENFORCE(gWorkspace);
+    return LoadMappedWeights(path, gWorkspace);
+  });
   m.def("run_operator_once", [](const py::bytes& op_def) {
     CAFFE_ENFORCE(gWorkspace);
     OperatorDef def;
@@ -1132,12 +1231,24 @@ void addGlobalMethods(py::module& m) {
             ParseProtoFromLargeString(net_def.cast<std::string>(), &def));
         py::gil_scoped_release g;
 
-        auto transformed_net = ApplyTransform(transform_key, def);
+        auto transformed_net =
+            ApplyTransform(transform_key, def, gWorkspace);
 
         std::string protob;
         CAFFE_ENFORCE(transformed_net.SerializeToString(&protob));
         return py::bytes(protob);
       });
+  m.def("optimize_video_inference", [](const py::bytes& net_def) {
+    NetDef def;
+    CAFFE_ENFORCE(ParseProtoFromLargeString(net_def.cast<std::string>(), &def));
+    py::gil_scoped_release g;
+
+    auto optimized_net = OptimizeVideoInference(def, gWorkspace);
+
+    std::string protob;
+    CAFFE_ENFORCE(optimized_net.SerializeToString(&protob));
+    return py::bytes(protob);
+  });
   m.def(
       "apply_transform_if_faster",
       [](const string& transform_key,
@@ -1211,6 +1322,42 @@ void addGlobalMethods(py::module& m) {
         CAFFE_ENFORCE(optimized.SerializeToString(&protob));
         return py::bytes(protob);
       });
+  m.def(
+      "memonger_plan_activation_memory",
+      [](const py::bytes& net_def,
+         const py::bytes& shapes_def,
+         const py::bytes& device_def,
+         const std::unordered_set<string>& dont_share_blob_names,
+         size_t alignment) {
+        NetDef net;
+        CAFFE_ENFORCE(
+            ParseProtoFromLargeString(net_def.cast<std::string>(), &net));
+        TensorShapes shapes;
+        CAFFE_ENFORCE(shapes.ParseFromString(shapes_def.cast<std::string>()));
+        DeviceOption device;
+        CAFFE_ENFORCE(device.ParseFromString(device_def.cast<std::string>()));
+        memonger::MemoryPlan plan;
+        {
+          py::gil_scoped_release g;
+          plan = memonger::plan_activation_memory(
+              net, shapes, device, dont_share_blob_names, alignment);
+        }
+        std::vector<std::string> blobs;
+        std::vector<size_t> offsets;
+        std::vector<size_t> nbytes;
+        for (const auto& placement : plan.placements) {
+          blobs.push_back(placement.blob);
+          offsets.push_back(placement.offset);
+          nbytes.push_back(placement.nbytes);
+        }
+        return py::make_tuple(
+            blobs,
+            offsets,
+            nbytes,
+            plan.arena_nbytes,
+            plan.total_nbytes,
+            plan.live_nbytes);
+      });
   m.def(
       "infer_shapes_and_types_from_workspace",
       [](const std::vector<py::bytes>& net_protos) {
@@ -1256,6 +1403,12 @@ void addGlobalMethods(py::module& m) {
   m.def("fetch_blob", [](const std::string& name) -> py::object {
     return python_detail::fetchBlob(gWorkspace, name);
   });
+  m.def("fetch_blob_async", [](const std::string& name) {
+    return python_detail::fetchBlobAsync(gWorkspace, name);
+  });
+  m.def("fetch_blobs", [](const std::vector<std::string>& names) {
+    return python_detail::fetchBlobs(gWorkspace, names);
+  });
   m.def(
       "feed_blob",
       [](const std::string& name, py::object arg, py::object device_option) {
@@ -1357,6 +1510,16 @@ void addGlobalMethods(py::module& m) {
     }
     return stats_map;
   });
+  m.def("timeline_start", [](size_t capacity) {
+    TimelineRecorder::Get().Start(capacity);
+  });
+  m.def("timeline_stop", []() { TimelineRecorder::Get().Stop(); });
+  m.def("timeline_write", [](const std::string& path) {
+    py::gil_scoped_release g;
+    TimelineRecorder::Get().WriteChromeTrace(path);
+  });
+  m.def("memory_tracking_start", []() { MemoryTracker::Get().Start(); });
+  m.def("memory_tracking_stop", []() { MemoryTracker::Get().Stop(); });
   m.def("is_numa_enabled", []() { return IsNUMAEnabled(); });
   m.def("get_num_numa_nodes", []() { return GetNumNUMANodes(); });
   m.def("get_blob_numa_node", [](const std::string& blob_name) {
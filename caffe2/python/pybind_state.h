@@ -46,8 +46,34 @@ class BlobFetcherBase {
     pybind11::object obj;
     bool copied;
   };
+  // A fetch that may still be in flight, see FetchAsync.
+  class PendingFetch {
+   public:
+    virtual ~PendingFetch();
+    // Waits for the fetch and returns the fetched object, the same one on
+    // every call.
+    pybind11::object Wait() {
+      if (!done_) {
+        result_ = Finish();
+        done_ = true;
+      }
+      return result_;
+    }
+
+   protected:
+    virtual pybind11::object Finish() = 0;
+
+   private:
+    bool done_ = false;
+    pybind11::object result_;
+  };
+
   virtual ~BlobFetcherBase();
   virtual pybind11::object Fetch(const Blob& blob) = 0;
+  // Starts the fetch of blob and returns without waiting for its copy to the
+  // host; the blob must not be written before Wait. By default the blob is
+  // fetched at once.
+  virtual std::unique_ptr<PendingFetch> FetchAsync(const Blob& blob);
 };
 
 class BlobFeederBase {
@@ -10,6 +10,10 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 
+#include <cstring>
+#include <map>
+#include <mutex>
+
 #include "caffe2/core/common_cudnn.h"
 #include "caffe2/core/context_gpu.h"
 #include "caffe2/operators/operator_fallback_gpu.h"
@@ -27,7 +31,146 @@ REGISTER_CUDA_OPERATOR(
     PythonDLPackGradient,
     PythonGradientOp<CUDAContext, true>);
 
-REGISTER_BLOB_FETCHER((TypeMeta::Id<TensorCUDA>()), TensorFetcher<CUDAContext>);
+namespace {
+
+// Pinned host buffers that the asynchronous fetches copy into. A buffer goes
+// back to the pool when its fetch is done; the buffers are never freed.
+class PinnedStagingPool {
+ public:
+  struct Buffer {
+    void* ptr;
+    size_t capacity;
+  };
+
+  static PinnedStagingPool& Get() {
+    static PinnedStagingPool* pool = new PinnedStagingPool();
+    return *pool;
+  }
+
+  // the smallest free buffer of at least nbytes, or a new one
+  Buffer Acquire(size_t nbytes) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = free_.lower_bound(nbytes);
+      if (it != free_.end()) {
+        Buffer buffer{it->second, it->first};
+        free_.erase(it);
+        return buffer;
+      }
+    }
+    Buffer buffer{nullptr, nbytes};
+    CUDA_ENFORCE(cudaMallocHost(&buffer.ptr, nbytes));
+    return buffer;
+  }
+
+  void Release(const Buffer& buffer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.emplace(buffer.capacity, buffer.ptr);
+  }
+
+ private:
+  std::mutex mutex_;
+  std::multimap<size_t, void*> free_;
+};
+
+// A non blocking stream per gpu for the fetches, so that they do not wait
+// for the work queued on the streams of the nets. As with FetchBlob, the net
+// that wrote a blob has finished when the blob is fetched.
+cudaStream_t FetchStream(int gpu) {
+  static std::mutex mutex;
+  static std::vector<cudaStream_t> streams(NumCudaDevices(), nullptr);
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!streams[gpu]) {
+    DeviceGuard guard(gpu);
+    CUDA_ENFORCE(
+        cudaStreamCreateWithFlags(&streams[gpu], cudaStreamNonBlocking));
+  }
+  return streams[gpu];
+}
+
+// The copy of a CUDA tensor to a pinned buffer, then to a new numpy array.
+class PendingCUDAFetch : public BlobFetcherBase::PendingFetch {
+ public:
+  PendingCUDAFetch(const TensorCUDA& tensor, const int numpy_type)
+      : dims_(tensor.dims().begin(), tensor.dims().end()),
+        numpy_type_(numpy_type),
+        nbytes_(tensor.nbytes()),
+        gpu_(GetGPUIDForPointer(tensor.raw_data())),
+        buffer_(PinnedStagingPool::Get().Acquire(nbytes_)) {
+    DeviceGuard guard(gpu_);
+    const cudaStream_t stream = FetchStream(gpu_);
+    CUDA_ENFORCE(cudaEventCreateWithFlags(&event_, cudaEventDisableTiming));
+    CUDA_ENFORCE(cudaMemcpyAsync(
+        buffer_.ptr,
+        tensor.raw_data(),
+        nbytes_,
+        cudaMemcpyDeviceToHost,
+        stream));
+    CUDA_ENFORCE(cudaEventRecord(event_, stream));
+  }
+
+  ~PendingCUDAFetch() override {
+    if (event_) {
+      // never waited for, the copy may still write to the buffer
+      CUDA_CHECK(cudaEventSynchronize(event_));
+      Done();
+    }
+  }
+
+ protected:
+  py::object Finish() override {
+    {
+      py::gil_scoped_release release;
+      CUDA_ENFORCE(cudaEventSynchronize(event_));
+    }
+    auto obj = py::reinterpret_steal<py::object>(
+        PyArray_SimpleNew(dims_.size(), dims_.data(), numpy_type_));
+    std::memcpy(
+        PyArray_DATA(reinterpret_cast<PyArrayObject*>(obj.ptr())),
+        buffer_.ptr,
+        nbytes_);
+    Done();
+    return obj;
+  }
+
+ private:
+  void Done() {
+    CUDA_CHECK(cudaEventDestroy(event_));
+    event_ = nullptr;
+    PinnedStagingPool::Get().Release(buffer_);
+  }
+
+  std::vector<npy_intp> dims_;
+  int numpy_type_;
+  size_t nbytes_;
+  int gpu_;
+  PinnedStagingPool::Buffer buffer_;
+  cudaEvent_t event_ = nullptr;
+};
+
+// TensorFetcher, with the copies of FetchAsync on the fetch stream of the
+// gpu of the tensor
+class CUDATensorFetcher : public TensorFetcher<CUDAContext> {
+ public:
+  std::unique_ptr<PendingFetch> FetchAsync(const Blob& blob) override {
+    const auto& tensor = blob.Get<TensorCUDA>();
+    CAFFE_ENFORCE_GE(tensor.size(), 0, "Trying to fetch unitilized tensor");
+    const int numpy_type = CaffeToNumpyType(tensor.meta());
+    CAFFE_ENFORCE(
+        numpy_type != -1,
+        "This tensor's data type is not supported: ",
+        tensor.meta().name(),
+        ".");
+    if (tensor.size() == 0 || numpy_type == NPY_OBJECT) {
+      return BlobFetcherBase::FetchAsync(blob);
+    }
+    return caffe2::make_unique<PendingCUDAFetch>(tensor, numpy_type);
+  }
+};
+
+} // namespace
+
+REGISTER_BLOB_FETCHER((TypeMeta::Id<TensorCUDA>()), CUDATensorFetcher);
 REGISTER_BLOB_FEEDER(CUDA, TensorFeeder<CUDAContext>);
 
 namespace py = pybind11;
@@ -50,6 +193,20 @@ void addCUDAGlobalMethods(py::module& m) {
     obj["totalGlobalMem"] = py::cast(prop.totalGlobalMem);
     return obj;
   });
+  m.def("get_cuda_memory_stats", [](int gpu) {
+    const auto stats = GetCudaCachingAllocatorStats(gpu);
+    std::map<std::string, py::object> obj;
+    obj["allocated_bytes"] = py::cast(stats.allocated_bytes);
+    obj["cached_bytes"] = py::cast(stats.cached_bytes);
+    obj["peak_allocated_bytes"] = py::cast(stats.peak_allocated_bytes);
+    obj["peak_cached_bytes"] = py::cast(stats.peak_cached_bytes);
+    obj["largest_free_bytes"] = py::cast(stats.largest_free_bytes);
+    obj["num_raw_allocs"] = py::cast(stats.num_raw_allocs);
+    obj["num_raw_frees"] = py::cast(stats.num_raw_frees);
+    obj["fragmentation"] = py::cast(stats.fragmentation());
+    return obj;
+  });
+  m.def("empty_cuda_cache", &EmptyCudaCachingAllocator);
 };
 
 void addCUDAObjectMethods(py::module& m) {
@@ -50,16 +50,26 @@ if has_gpu_support:
         return np.asarray(C.get_cuda_peer_access_pattern())
 
     GetDeviceProperties = C.get_device_properties
+    # stats of the caching memory pool (--caffe2_cuda_memory_pool=caching)
+    GetCUDAMemoryStats = C.get_cuda_memory_stats
+    EmptyCUDACache = C.empty_cuda_cache
 else:
     NumCudaDevices = lambda: 0 # noqa
     GetCuDNNVersion = lambda: 0 # noqa
     GetCuDNNVersion = lambda: 0 # noqa
     GetCudaPeerAccessPattern = lambda: np.array([]) # noqa
     GetDeviceProperties = lambda x: None # noqa
+    GetCUDAMemoryStats = lambda x: None # noqa
+    EmptyCUDACache = lambda: None # noqa
 
 IsNUMAEnabled = C.is_numa_enabled
 GetNumNUMANodes = C.get_num_numa_nodes
 GetBlobNUMANode = C.get_blob_numa_node
+TimelineStart = C.timeline_start
+TimelineStop = C.timeline_stop
+TimelineWrite = C.timeline_write
+MemoryTrackingStart = C.memory_tracking_start
+MemoryTrackingStop = C.memory_tracking_stop
 
 def _GetFreeFlaskPort():
     """Get a free flask port."""
@@ -316,14 +326,28 @@ def FeedBlob(name, arr, device_option=None):
 
 
 def FetchBlobs(names):
-    """Fetches a list of blobs from the workspace.
+    """Fetches a list of blobs from the workspace. The copies of the GPU blobs
+    are all started before waiting for them.
 
     Inputs:
         names: list of names of blobs - strings or BlobReferences
     Returns:
         list of fetched blobs
     """
-    return [FetchBlob(name) for name in names]
+    return C.fetch_blobs([StringifyBlobName(name) for name in names])
+
+
+def FetchBlobAsync(name):
+    """Starts fetching a blob from the workspace. A GPU blob is copied to
+    pinned host memory on a side stream; the blob must not be written before
+    the fetch is waited for.
+
+    Inputs:
+      name: the name of the blob - a string or a BlobReference
+    Returns:
+      a PendingFetch whose wait() returns the fetched blob
+    """
+    return C.fetch_blob_async(StringifyBlobName(name))
 
 
 def FetchBlob(name):
@@ -341,6 +365,9 @@ def ApplyTransform(transform_key, net):
     """Apply a Transform to a NetDef protobuf object, and returns the new
     transformed NetDef.
 
+    Transforms that rewrite parameters (e.g. FoldAffineIntoConv) read and
+    write the blobs of the current workspace.
+
     Inputs:
       transform_key: the name of the transform, as it is stored in the registry
       net: a NetDef protobuf object
@@ -356,6 +383,26 @@ def ApplyTransform(transform_key, net):
     return transformed_net
 
 
+def OptimizeVideoInference(net):
+    """Rewrites a test NetDef of the video nets for inference: folds the
+    affine layers into the convs and the Scale of the non-local blocks into
+    their BatchMatMul, composes the Transposes and runs the Reshapes in place,
+    and fuses the Relus into the Sums and convs before them.
+
+    The folds rewrite the parameters in the current workspace, which must
+    hold them.
+
+    Inputs:
+      net: a NetDef protobuf object
+    Returns:
+      Optimized NetDef protobuf object.
+    """
+    optimized_net = caffe2_pb2.NetDef()
+    optimized_net.ParseFromString(
+        C.optimize_video_inference(net.SerializeToString()))
+    return optimized_net
+
+
 def ApplyTransformIfFaster(transform_key, net, init_net, **kwargs):
     """Apply a Transform to a NetDef protobuf object, and returns the new
     transformed NetDef, only if it runs faster than the original.
@@ -234,6 +234,17 @@ class TestWorkspace(unittest.TestCase):
         self.assertEquals(s1, fetch1)
         self.assertEquals(s2, fetch2)
 
+    def testFetchBlobAsync(self):
+        data = np.random.rand(2, 3).astype(np.float32)
+        workspace.FeedBlob('data', data)
+        workspace.FeedBlob('s', b"test")
+        pending = workspace.FetchBlobAsync('data')
+        pending_s = workspace.FetchBlobAsync('s')
+        np.testing.assert_array_equal(pending.wait(), data)
+        self.assertEqual(pending_s.wait(), b"test")
+        # waiting again returns the same fetch
+        self.assertIs(pending.wait(), pending.wait())
+
     def testFetchFeedViaBlobDict(self):
         self.assertEqual(
             workspace.RunNetOnce(self.net.Proto().SerializeToString()), True)
@@ -306,6 +317,19 @@ class TestWorkspaceGPU(test_util.TestCase):
         self.assertEqual(fetched_again.shape, (1, 2, 3, 4))
         np.testing.assert_array_equal(fetched_again, 2.0)
 
+    def testFetchBlobsGPU(self):
+        self.net.ConstantFill([], "testblob2", shape=[3], value=2.0)
+        self.net.RunAllOnGPU()
+        workspace.RunNetOnce(self.net)
+        pending = workspace.FetchBlobAsync("testblob")
+        fetched, fetched2 = workspace.FetchBlobs(["testblob", "testblob2"])
+        np.testing.assert_array_equal(pending.wait(), fetched)
+        self.assertEqual(fetched.shape, (1, 2, 3, 4))
+        np.testing.assert_array_equal(fetched, 1.0)
+        np.testing.assert_array_equal(fetched2, 2.0)
+        # a pending fetch that is never waited for is dropped cleanly
+        workspace.FetchBlobAsync("testblob2")
+
     def testGetCudaPeerAccessPattern(self):
         pattern = workspace.GetCudaPeerAccessPattern()
         self.assertEqual(type(pattern), np.ndarray)
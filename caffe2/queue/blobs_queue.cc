@@ -1,7 +1,9 @@
 #include "caffe2/queue/blobs_queue.h"
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <queue>
@@ -28,8 +30,12 @@ BlobsQueue::BlobsQueue(
     size_t capacity,
     size_t numBlobs,
     bool enforceUniqueName,
-    const std::vector<std::string>& fieldNames)
-    : numBlobs_(numBlobs), name_(queueName), stats_(queueName) {
+    const std::vector<std::string>& fieldNames,
+    bool lockFree)
+    : numBlobs_(numBlobs),
+      name_(queueName),
+      lockFree_(lockFree),
+      stats_(queueName) {
   if (!fieldNames.empty()) {
     CAFFE_ENFORCE_EQ(
         fieldNames.size(), numBlobs, "Wrong number of fieldNames provided.");
@@ -52,11 +58,23 @@ BlobsQueue::BlobsQueue(
     queue_.push_back(blobs);
   }
   DCHECK_EQ(queue_.size(), capacity);
+  if (lockFree_) {
+    CAFFE_ENFORCE_GT(capacity, 0, "A lock-free queue needs a capacity");
+    sequences_.reset(new std::atomic<int64_t>[capacity]);
+    for (auto i = 0; i < capacity; ++i) {
+      sequences_[i].store(i, std::memory_order_relaxed);
+    }
+  }
 }
 
 bool BlobsQueue::blockingRead(
     const std::vector<Blob*>& inputs,
     float timeout_secs) {
+  CAFFE_ENFORCE(
+      !hasSlotEvents(), "A device resident queue is read in reservations");
+  if (lockFree_) {
+    return blockingReadLockFree(inputs, timeout_secs);
+  }
   Timer readTimer;
   auto keeper = this->shared_from_this();
   const auto& name = name_.c_str();
@@ -69,6 +87,7 @@ bool BlobsQueue::blockingRead(
   // Decrease queue balance before reading to indicate queue read pressure
   // is being increased (-ve queue balance indicates more reads than writes)
   CAFFE_EVENT(stats_, queue_balance, -1);
+  Timer waitTimer;
   if (timeout_secs > 0) {
     std::chrono::milliseconds timeout_ms(int(timeout_secs * 1000));
     cv_.wait_for(
@@ -76,6 +95,7 @@ bool BlobsQueue::blockingRead(
   } else {
     cv_.wait(g, [this, canRead]() { return closing_ || canRead(); });
   }
+  CAFFE_EVENT(stats_, read_wait_time_ns, waitTimer.NanoSeconds());
   if (!canRead()) {
     if (timeout_secs > 0 && !closing_) {
       LOG(ERROR) << "DequeueBlobs timed out in " << timeout_secs << " secs";
@@ -103,6 +123,22 @@ bool BlobsQueue::blockingRead(
 }
 
 bool BlobsQueue::tryWrite(const std::vector<Blob*>& inputs) {
+  CAFFE_ENFORCE(
+      !hasSlotEvents(), "A device resident queue is written in reservations");
+  if (lockFree_) {
+    Timer writeTimer;
+    auto keeper = this->shared_from_this();
+    const auto& name = name_.c_str();
+    CAFFE_SDT(queue_write_start, name, (void*)this, SDT_NONBLOCKING_OP);
+    if (!tryWriteLockFree(inputs)) {
+      CAFFE_SDT(queue_write_end, name, (void*)this, SDT_ABORT);
+      return false;
+    }
+    wakeWaiter(waitingReaders_, readCv_);
+    CAFFE_EVENT(stats_, queue_balance, 1);
+    CAFFE_EVENT(stats_, write_time_ns, writeTimer.NanoSeconds());
+    return true;
+  }
   Timer writeTimer;
   auto keeper = this->shared_from_this();
   const auto& name = name_.c_str();
@@ -122,6 +158,11 @@ bool BlobsQueue::tryWrite(const std::vector<Blob*>& inputs) {
 }
 
 bool BlobsQueue::blockingWrite(const std::vector<Blob*>& inputs) {
+  CAFFE_ENFORCE(
+      !hasSlotEvents(), "A device resident queue is written in reservations");
+  if (lockFree_) {
+    return blockingWriteLockFree(inputs);
+  }
   Timer writeTimer;
   auto keeper = this->shared_from_this();
   const auto& name = name_.c_str();
@@ -130,7 +171,9 @@ bool BlobsQueue::blockingWrite(const std::vector<Blob*>& inputs) {
   // Increase queue balance before writing to indicate queue write pressure is
   // being increased (+ve queue balance indicates more writes than reads)
   CAFFE_EVENT(stats_, queue_balance, 1);
+  Timer waitTimer;
   cv_.wait(g, [this]() { return closing_ || canWrite(); });
+  CAFFE_EVENT(stats_, write_wait_time_ns, waitTimer.NanoSeconds());
   if (!canWrite()) {
     CAFFE_SDT(queue_write_end, name, (void*)this, SDT_ABORT);
     return false;
@@ -146,6 +189,8 @@ void BlobsQueue::close() {
 
   std::lock_guard<std::mutex> g(mutex_);
   cv_.notify_all();
+  readCv_.notify_all();
+  writeCv_.notify_all();
 }
 
 bool BlobsQueue::canWrite() {
@@ -170,4 +215,254 @@ void BlobsQueue::doWrite(const std::vector<Blob*>& inputs) {
   cv_.notify_all();
 }
 
+bool BlobsQueue::blockingReadLockFree(
+    const std::vector<Blob*>& inputs,
+    float timeout_secs) {
+  Timer readTimer;
+  auto keeper = this->shared_from_this();
+  const auto& name = name_.c_str();
+  CAFFE_SDT(queue_read_start, name, (void*)this, SDT_BLOCKING_OP);
+  CAFFE_EVENT(stats_, queue_balance, -1);
+  bool timedOut = false;
+  if (!tryReadLockFree(inputs)) {
+    Timer waitTimer;
+    const bool read = waitLockFree(
+        [this, &inputs]() { return tryReadLockFree(inputs); },
+        waitingReaders_,
+        readCv_,
+        timeout_secs,
+        &timedOut);
+    CAFFE_EVENT(stats_, read_wait_time_ns, waitTimer.NanoSeconds());
+    if (!read) {
+      if (timedOut && !closing_) {
+        LOG(ERROR) << "DequeueBlobs timed out in " << timeout_secs
+                   << " secs";
+        CAFFE_SDT(queue_read_end, name, (void*)this, SDT_TIMEOUT);
+      } else {
+        CAFFE_SDT(queue_read_end, name, (void*)this, SDT_CANCEL);
+      }
+      return false;
+    }
+  }
+  wakeWaiter(waitingWriters_, writeCv_);
+  CAFFE_EVENT(stats_, read_time_ns, readTimer.NanoSeconds());
+  return true;
+}
+
+bool BlobsQueue::blockingWriteLockFree(const std::vector<Blob*>& inputs) {
+  Timer writeTimer;
+  auto keeper = this->shared_from_this();
+  const auto& name = name_.c_str();
+  CAFFE_SDT(queue_write_start, name, (void*)this, SDT_BLOCKING_OP);
+  CAFFE_EVENT(stats_, queue_balance, 1);
+  if (!tryWriteLockFree(inputs)) {
+    Timer waitTimer;
+    const bool written = waitLockFree(
+        [this, &inputs]() { return tryWriteLockFree(inputs); },
+        waitingWriters_,
+        writeCv_,
+        0,
+        nullptr);
+    CAFFE_EVENT(stats_, write_wait_time_ns, waitTimer.NanoSeconds());
+    if (!written) {
+      CAFFE_SDT(queue_write_end, name, (void*)this, SDT_ABORT);
+      return false;
+    }
+  }
+  wakeWaiter(waitingReaders_, readCv_);
+  CAFFE_EVENT(stats_, write_time_ns, writeTimer.NanoSeconds());
+  return true;
+}
+
+bool BlobsQueue::reserveRead(Slot* slot, float timeout_secs) {
+  CAFFE_ENFORCE(lockFree_, "Only a lock-free queue has reserved reads");
+  Timer waitTimer;
+  bool timedOut = false;
+  const bool reserved = claimReadLockFree(&slot->pos) ||
+      waitLockFree(
+          [this, slot]() { return claimReadLockFree(&slot->pos); },
+          waitingReaders_,
+          readCv_,
+          timeout_secs,
+          &timedOut);
+  CAFFE_EVENT(stats_, read_wait_time_ns, waitTimer.NanoSeconds());
+  if (!reserved) {
+    if (timedOut && !closing_) {
+      LOG(ERROR) << "Reserved read timed out in " << timeout_secs << " secs";
+    }
+    return false;
+  }
+  slot->blobs = &queue_[slot->pos % queue_.size()];
+  return true;
+}
+
+void BlobsQueue::commitRead(const Slot& slot) {
+  CAFFE_EVENT(stats_, queue_dequeued_records);
+  // the slot is free for the writer of the next lap
+  sequences_[slot.pos % queue_.size()].store(
+      slot.pos + queue_.size(), std::memory_order_release);
+  wakeWaiter(waitingWriters_, writeCv_);
+}
+
+bool BlobsQueue::reserveWrite(Slot* slot) {
+  CAFFE_ENFORCE(lockFree_, "Only a lock-free queue has reserved writes");
+  Timer waitTimer;
+  const bool reserved = claimWriteLockFree(&slot->pos) ||
+      waitLockFree(
+          [this, slot]() { return claimWriteLockFree(&slot->pos); },
+          waitingWriters_,
+          writeCv_,
+          0,
+          nullptr);
+  CAFFE_EVENT(stats_, write_wait_time_ns, waitTimer.NanoSeconds());
+  if (!reserved) {
+    return false;
+  }
+  slot->blobs = &queue_[slot->pos % queue_.size()];
+  return true;
+}
+
+void BlobsQueue::commitWrite(const Slot& slot) {
+  sequences_[slot.pos % queue_.size()].store(
+      slot.pos + 1, std::memory_order_release);
+  wakeWaiter(waitingReaders_, readCv_);
+}
+
+void BlobsQueue::createSlotEvents(const DeviceOption& option) {
+  CAFFE_ENFORCE(lockFree_, "Only a lock-free queue has reservations");
+  CAFFE_ENFORCE(!hasSlotEvents());
+  for (auto i = 0; i < queue_.size(); ++i) {
+    writtenEvents_.emplace_back(new Event(option));
+    readEvents_.emplace_back(new Event(option));
+  }
+}
+
+bool BlobsQueue::tryReadLockFree(const std::vector<Blob*>& inputs) {
+  // checked before claiming a slot, which cannot be given back
+  CAFFE_ENFORCE(inputs.size() >= numBlobs_);
+  int64_t pos;
+  if (!claimReadLockFree(&pos)) {
+    return false;
+  }
+  const int64_t capacity = queue_.size();
+  auto& result = queue_[pos % capacity];
+  for (auto i = 0; i < result.size(); ++i) {
+    auto bytes = BlobStat::sizeBytes(*result[i]);
+    CAFFE_EVENT(stats_, queue_dequeued_bytes, bytes, i);
+    using std::swap;
+    swap(*(inputs[i]), *(result[i]));
+  }
+  CAFFE_SDT(
+      queue_read_end,
+      name_.c_str(),
+      (void*)this,
+      writePos_.load(std::memory_order_relaxed) - pos - 1);
+  CAFFE_EVENT(stats_, queue_dequeued_records);
+  sequences_[pos % capacity].store(pos + capacity, std::memory_order_release);
+  return true;
+}
+
+bool BlobsQueue::tryWriteLockFree(const std::vector<Blob*>& inputs) {
+  CAFFE_ENFORCE(inputs.size() >= numBlobs_);
+  int64_t pos;
+  if (!claimWriteLockFree(&pos)) {
+    return false;
+  }
+  const int64_t capacity = queue_.size();
+  auto& result = queue_[pos % capacity];
+  for (auto i = 0; i < result.size(); ++i) {
+    using std::swap;
+    swap(*(inputs[i]), *(result[i]));
+  }
+  CAFFE_SDT(
+      queue_write_end,
+      name_.c_str(),
+      (void*)this,
+      readPos_.load(std::memory_order_relaxed) + capacity - pos - 1);
+  sequences_[pos % capacity].store(pos + 1, std::memory_order_release);
+  return true;
+}
+
+bool BlobsQueue::claimReadLockFree(int64_t* claimed) {
+  const int64_t capacity = queue_.size();
+  int64_t pos = readPos_.load(std::memory_order_relaxed);
+  for (;;) {
+    const int64_t seq =
+        sequences_[pos % capacity].load(std::memory_order_acquire);
+    const int64_t diff = seq - (pos + 1);
+    if (diff == 0) {
+      if (readPos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        *claimed = pos;
+        return true;
+      }
+    } else if (diff < 0) {
+      return false; // empty
+    } else {
+      pos = readPos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool BlobsQueue::claimWriteLockFree(int64_t* claimed) {
+  const int64_t capacity = queue_.size();
+  int64_t pos = writePos_.load(std::memory_order_relaxed);
+  for (;;) {
+    const int64_t seq =
+        sequences_[pos % capacity].load(std::memory_order_acquire);
+    const int64_t diff = seq - pos;
+    if (diff == 0) {
+      if (writePos_.compare_exchange_weak(
+              pos, pos + 1, std::memory_order_relaxed)) {
+        *claimed = pos;
+        return true;
+      }
+    } else if (diff < 0) {
+      return false; // full
+    } else {
+      pos = writePos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool BlobsQueue::waitLockFree(
+    const std::function<bool()>& attempt,
+    std::atomic<int>& waiters,
+    std::condition_variable& cv,
+    float timeout_secs,
+    bool* timedOut) {
+  const auto deadline = std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(int(timeout_secs * 1000));
+  bool done = false;
+  bool expired = false;
+  std::unique_lock<std::mutex> g(mutex_);
+  waiters.fetch_add(1);
+  // pairs with the fence of wakeWaiter: either the other side sees this
+  // thread waiting, or this thread sees the slot it released
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  while (!(done = attempt()) && !closing_ && !expired) {
+    if (timeout_secs > 0) {
+      expired = cv.wait_until(g, deadline) == std::cv_status::timeout;
+    } else {
+      cv.wait(g);
+    }
+  }
+  waiters.fetch_sub(1);
+  if (timedOut) {
+    *timedOut = expired;
+  }
+  return done;
+}
+
+void BlobsQueue::wakeWaiter(
+    std::atomic<int>& waiters,
+    std::condition_variable& cv) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiters.load(std::memory_order_relaxed) > 0) {
+    // a waiter checks the ring and goes to sleep under the mutex
+    std::lock_guard<std::mutex> g(mutex_);
+    cv.notify_one();
+  }
+}
+
 } // namespace caffe2
@@ -2,11 +2,13 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <queue>
 
 #include "caffe2/core/blob_stats.h"
+#include "caffe2/core/event.h"
 #include "caffe2/core/logging.h"
 #include "caffe2/core/stats.h"
 #include "caffe2/core/tensor.h"
@@ -16,6 +18,12 @@ namespace caffe2 {
 
 // A thread-safe, bounded, blocking queue.
 // Modelled as a circular buffer.
+//
+// With lockFree, the circular buffer is a multi-producer / multi-consumer
+// ring with a sequence number per slot: readers and writers claim slots with
+// a compare-and-swap of their position, and only take the mutex to wait
+// while the queue is empty or full, each waking one waiter of the other
+// side.
 
 // Containing blobs are owned by the workspace.
 // On read, we swap out the underlying data for the blob passed in for blobs
@@ -28,7 +36,8 @@ class BlobsQueue : public std::enable_shared_from_this<BlobsQueue> {
       size_t capacity,
       size_t numBlobs,
       bool enforceUniqueName,
-      const std::vector<std::string>& fieldNames = {});
+      const std::vector<std::string>& fieldNames = {},
+      bool lockFree = false);
 
   ~BlobsQueue() {
     close();
@@ -43,11 +52,75 @@ class BlobsQueue : public std::enable_shared_from_this<BlobsQueue> {
   size_t getNumBlobs() const {
     return numBlobs_;
   }
+  size_t getCapacity() const {
+    return queue_.size();
+  }
+  bool isLockFree() const {
+    return lockFree_;
+  }
+
+  // A slot of the ring, reserved by a reader or a writer.
+  struct Slot {
+    int64_t pos;
+    const std::vector<Blob*>* blobs;
+  };
+
+  // In place access to the slots of a lock-free queue. reserveWrite waits
+  // for a free slot, whose blobs keep the tensors of an earlier lap, so that
+  // a producer of same-shape records fills them without allocating, and
+  // commitWrite hands the slot to the readers; reserveRead / commitRead let a
+  // consumer use a record in place and give the slot back. The reservations
+  // are committed in any order, but the records are read in the order their
+  // slots were reserved. Return false when the queue is closed, or when the
+  // read times out.
+  bool reserveWrite(Slot* slot);
+  void commitWrite(const Slot& slot);
+  bool reserveRead(Slot* slot, float timeout_secs = 0.0f);
+  void commitRead(const Slot& slot);
+
+  // A device resident queue has two events per slot, of the device of
+  // option: the writer of a slot records writtenEvent on its stream once it
+  // has filled the slot, and the reader records readEvent once it has taken
+  // the tensors out, so that the streams of a producer and a consumer only
+  // wait on each other for the slots they share, and never the host. Such a
+  // queue is written and read through the reservations, by the EnqueueBlobs
+  // and DequeueBlobs ops of the device.
+  void createSlotEvents(const DeviceOption& option);
+  bool hasSlotEvents() const {
+    return !writtenEvents_.empty();
+  }
+  Event* writtenEvent(const Slot& slot) {
+    return writtenEvents_[slot.pos % queue_.size()].get();
+  }
+  Event* readEvent(const Slot& slot) {
+    return readEvents_[slot.pos % queue_.size()].get();
+  }
 
  private:
   bool canWrite();
   void doWrite(const std::vector<Blob*>& inputs);
 
+  bool blockingReadLockFree(
+      const std::vector<Blob*>& inputs,
+      float timeout_secs);
+  bool blockingWriteLockFree(const std::vector<Blob*>& inputs);
+  // claim and fill a slot, or return false on an empty / full ring; the
+  // callers wake a waiter of the other side, outside of mutex_
+  bool tryReadLockFree(const std::vector<Blob*>& inputs);
+  bool tryWriteLockFree(const std::vector<Blob*>& inputs);
+  // claim the position of the next record / free slot
+  bool claimReadLockFree(int64_t* pos);
+  bool claimWriteLockFree(int64_t* pos);
+  // retries attempt under mutex_ until it succeeds, the queue is closed or
+  // timeout_secs (if > 0) expire
+  bool waitLockFree(
+      const std::function<bool()>& attempt,
+      std::atomic<int>& waiters,
+      std::condition_variable& cv,
+      float timeout_secs,
+      bool* timedOut);
+  void wakeWaiter(std::atomic<int>& waiters, std::condition_variable& cv);
+
   std::atomic<bool> closing_{false};
 
   size_t numBlobs_;
@@ -58,6 +131,24 @@ class BlobsQueue : public std::enable_shared_from_this<BlobsQueue> {
   std::vector<std::vector<Blob*>> queue_;
   const std::string name_;
 
+  // the lock-free ring: slot i holds a record for the reader at position p
+  // when its sequence is p + 1, and is free for the writer at p when it is p
+  const bool lockFree_;
+  std::unique_ptr<std::atomic<int64_t>[]> sequences_;
+  // the positions are written by different threads, keep them apart
+  char pad0_[64];
+  std::atomic<int64_t> readPos_{0};
+  char pad1_[64];
+  std::atomic<int64_t> writePos_{0};
+  char pad2_[64];
+  std::atomic<int> waitingReaders_{0};
+  std::atomic<int> waitingWriters_{0};
+  std::condition_variable readCv_;
+  std::condition_variable writeCv_;
+
+  std::vector<std::unique_ptr<Event>> writtenEvents_;
+  std::vector<std::unique_ptr<Event>> readEvents_;
+
   struct QueueStats {
     CAFFE_STAT_CTOR(QueueStats);
     CAFFE_EXPORTED_STAT(queue_balance);
@@ -65,6 +156,9 @@ class BlobsQueue : public std::enable_shared_from_this<BlobsQueue> {
     CAFFE_DETAILED_EXPORTED_STAT(queue_dequeued_bytes);
     CAFFE_AVG_EXPORTED_STAT(read_time_ns);
     CAFFE_AVG_EXPORTED_STAT(write_time_ns);
+    // time the blocking reads and writes wait on an empty or full queue
+    CAFFE_AVG_EXPORTED_STAT(read_wait_time_ns);
+    CAFFE_AVG_EXPORTED_STAT(write_wait_time_ns);
   } stats_;
 };
 } // namespace caffe2
@@ -0,0 +1,165 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/queue/blobs_queue.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+std::shared_ptr<BlobsQueue>
+CreateQueue(Workspace* ws, const string& name, size_t capacity, bool lockFree) {
+  return std::make_shared<BlobsQueue>(
+      ws, name, capacity, 1, true, std::vector<std::string>(), lockFree);
+}
+
+bool Write(BlobsQueue* queue, int value, bool blocking) {
+  Blob blob;
+  *blob.GetMutable<int>() = value;
+  return blocking ? queue->blockingWrite({&blob}) : queue->tryWrite({&blob});
+}
+
+bool Read(BlobsQueue* queue, int* value, float timeout_secs = 0) {
+  Blob blob;
+  if (!queue->blockingRead({&blob}, timeout_secs)) {
+    return false;
+  }
+  *value = blob.Get<int>();
+  return true;
+}
+
+class BlobsQueueTest : public ::testing::TestWithParam<bool> {};
+
+} // namespace
+
+TEST_P(BlobsQueueTest, ReadsInOrder) {
+  Workspace ws;
+  auto queue = CreateQueue(&ws, "q", 3, GetParam());
+  EXPECT_EQ(queue->isLockFree(), GetParam());
+  // a few laps of the ring
+  for (int lap = 0; lap < 3; ++lap) {
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_TRUE(Write(queue.get(), lap * 3 + i, false));
+    }
+    EXPECT_FALSE(Write(queue.get(), -1, false));
+    for (int i = 0; i < 3; ++i) {
+      int value;
+      EXPECT_TRUE(Read(queue.get(), &value));
+      EXPECT_EQ(value, lap * 3 + i);
+    }
+  }
+}
+
+TEST_P(BlobsQueueTest, ReadTimesOut) {
+  Workspace ws;
+  auto queue = CreateQueue(&ws, "q", 2, GetParam());
+  int value;
+  EXPECT_FALSE(Read(queue.get(), &value, 0.05));
+  EXPECT_TRUE(Write(queue.get(), 7, false));
+  EXPECT_TRUE(Read(queue.get(), &value, 0.05));
+  EXPECT_EQ(value, 7);
+}
+
+TEST_P(BlobsQueueTest, CloseWakesWaiters) {
+  Workspace ws;
+  auto queue = CreateQueue(&ws, "q", 1, GetParam());
+  EXPECT_TRUE(Write(queue.get(), 0, false));
+  bool written = true;
+  std::thread writer([&] { written = Write(queue.get(), 1, true); });
+  int value;
+  EXPECT_TRUE(Read(queue.get(), &value));
+  EXPECT_TRUE(Read(queue.get(), &value));
+  EXPECT_EQ(value, 1);
+  writer.join();
+  EXPECT_TRUE(written);
+
+  bool read = true;
+  std::thread reader([&] { read = Read(queue.get(), &value); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  queue->close();
+  reader.join();
+  EXPECT_FALSE(read);
+}
+
+TEST_P(BlobsQueueTest, ManyProducersAndConsumers) {
+  const int kThreads = 4;
+  const int kRecords = 5000;
+  Workspace ws;
+  auto queue = CreateQueue(&ws, "q", 8, GetParam());
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kRecords; ++i) {
+        EXPECT_TRUE(Write(queue.get(), t * kRecords + i, true));
+      }
+    });
+  }
+  std::atomic<int64_t> sum{0};
+  std::vector<std::vector<int>> last(kThreads, std::vector<int>(kThreads, -1));
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kRecords; ++i) {
+        int value;
+        ASSERT_TRUE(Read(queue.get(), &value));
+        sum += value;
+        // the records of a producer come out in the order it wrote them
+        const int producer = value / kRecords;
+        EXPECT_LT(last[t][producer], value);
+        last[t][producer] = value;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const int64_t n = kThreads * kRecords;
+  EXPECT_EQ(sum, n * (n - 1) / 2);
+}
+
+TEST(BlobsQueueTest, ReservesSlotsInPlace) {
+  Workspace ws;
+  auto queue = CreateQueue(&ws, "q", 2, true);
+  std::vector<const float*> data;
+  for (int i = 0; i < 6; ++i) {
+    BlobsQueue::Slot slot;
+    ASSERT_TRUE(queue->reserveWrite(&slot));
+    auto* tensor = (*slot.blobs)[0]->GetMutable<TensorCPU>();
+    tensor->Resize(4);
+    tensor->mutable_data<float>()[0] = i;
+    data.push_back(tensor->data<float>());
+    queue->commitWrite(slot);
+
+    ASSERT_TRUE(queue->reserveRead(&slot));
+    EXPECT_EQ((*slot.blobs)[0]->Get<TensorCPU>().data<float>()[0], i);
+    queue->commitRead(slot);
+  }
+  // the slots keep their tensors from lap to lap
+  EXPECT_EQ(data[0], data[2]);
+  EXPECT_EQ(data[1], data[5]);
+}
+
+TEST(BlobsQueueTest, CommitsOutOfOrder) {
+  Workspace ws;
+  auto queue = CreateQueue(&ws, "q", 2, true);
+  BlobsQueue::Slot a, b, c;
+  ASSERT_TRUE(queue->reserveWrite(&a));
+  ASSERT_TRUE(queue->reserveWrite(&b));
+  *(*a.blobs)[0]->GetMutable<int>() = 1;
+  *(*b.blobs)[0]->GetMutable<int>() = 2;
+  queue->commitWrite(b);
+  // a is still being written
+  EXPECT_FALSE(queue->reserveRead(&c, 0.01));
+  queue->commitWrite(a);
+  int value;
+  EXPECT_TRUE(Read(queue.get(), &value));
+  EXPECT_EQ(value, 1);
+  EXPECT_TRUE(Read(queue.get(), &value));
+  EXPECT_EQ(value, 2);
+}
+
+INSTANTIATE_TEST_CASE_P(LockFree, BlobsQueueTest, ::testing::Bool());
+
+} // namespace caffe2
@@ -17,7 +17,18 @@ REGISTER_CPU_OPERATOR(
     WeightedSampleDequeueBlobs,
     WeightedSampleDequeueBlobsOp<CPUContext>);
 
-OPERATOR_SCHEMA(CreateBlobsQueue).NumInputs(0).NumOutputs(1);
+OPERATOR_SCHEMA(CreateBlobsQueue)
+    .NumInputs(0)
+    .NumOutputs(1)
+    .Arg(
+        "lock_free",
+        "Use a lock-free ring that only locks to wait on an empty or full "
+        "queue, for queues with many producer and consumer threads")
+    .Arg(
+        "device_resident",
+        "CUDA only: the slots hold tensors of the device, which EnqueueBlobs "
+        "fills with copies on the stream of the producer, and DequeueBlobs "
+        "hands out after its stream waits on an event of the slot");
 OPERATOR_SCHEMA(EnqueueBlobs)
     .NumInputsOutputs([](int inputs, int outputs) {
       return inputs >= 2 && outputs >= 1 && inputs == outputs + 1;
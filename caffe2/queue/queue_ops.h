@@ -24,12 +24,28 @@ class CreateBlobsQueueOp final : public Operator<Context> {
         GetSingleArgument("enforce_unique_name", false);
     const auto fieldNames =
         OperatorBase::template GetRepeatedArgument<std::string>("field_names");
+    const auto deviceResident = GetSingleArgument("device_resident", false);
+    // the device resident slots are filled in reservations
+    const auto lockFree =
+        GetSingleArgument("lock_free", false) || deviceResident;
+    CAFFE_ENFORCE(
+        !deviceResident || this->device_option().device_type() == CUDA,
+        "Only a CUDA queue can be device resident");
     CAFFE_ENFORCE_EQ(this->OutputSize(), 1);
     auto queuePtr = Operator<Context>::Outputs()[0]
                         ->template GetMutable<std::shared_ptr<BlobsQueue>>();
     CAFFE_ENFORCE(queuePtr);
     *queuePtr = std::make_shared<BlobsQueue>(
-        ws_, name, capacity, numBlobs, enforceUniqueName, fieldNames);
+        ws_,
+        name,
+        capacity,
+        numBlobs,
+        enforceUniqueName,
+        fieldNames,
+        lockFree);
+    if (deviceResident) {
+      (*queuePtr)->createSlotEvents(this->device_option());
+    }
     return true;
   }
 
@@ -5,6 +5,70 @@
 
 namespace caffe2 {
 
+// A device resident queue: the producer copies its CPU or CUDA tensors into
+// the tensors of a reserved slot on its own stream, after that stream waits
+// on the reader of the slot of the previous lap, and records the slot.
+template <>
+bool EnqueueBlobsOp<CUDAContext>::RunOnDevice() {
+  CAFFE_ENFORCE(InputSize() > 1);
+  auto queue =
+      OperatorBase::Inputs()[0]->template Get<std::shared_ptr<BlobsQueue>>();
+  CAFFE_ENFORCE(queue && OutputSize() == queue->getNumBlobs());
+  if (!queue->hasSlotEvents()) {
+    return queue->blockingWrite(this->Outputs());
+  }
+
+  BlobsQueue::Slot slot;
+  if (!queue->reserveWrite(&slot)) {
+    return false;
+  }
+  if (slot.pos >= static_cast<int64_t>(queue->getCapacity())) {
+    context_.WaitEvent(*queue->readEvent(slot));
+  }
+  for (int i = 0; i < OutputSize(); ++i) {
+    const Blob* input = OperatorBase::Inputs()[i + 1];
+    auto* tensor = (*slot.blobs)[i]->GetMutable<TensorCUDA>();
+    if (input->IsType<TensorCPU>()) {
+      tensor->CopyFrom(input->Get<TensorCPU>(), &context_);
+    } else {
+      tensor->CopyFrom(input->Get<TensorCUDA>(), &context_);
+    }
+  }
+  auto* written = queue->writtenEvent(slot);
+  written->Reset();
+  context_.Record(written);
+  queue->commitWrite(slot);
+  return true;
+}
+
+// The consumer only makes its stream wait on the copies of the slot and
+// swaps the tensors out, there is no copy on its stream.
+template <>
+bool DequeueBlobsOp<CUDAContext>::RunOnDevice() {
+  CAFFE_ENFORCE(InputSize() == 1);
+  auto queue =
+      OperatorBase::Inputs()[0]->template Get<std::shared_ptr<BlobsQueue>>();
+  CAFFE_ENFORCE(queue && OutputSize() == queue->getNumBlobs());
+  if (!queue->hasSlotEvents()) {
+    return queue->blockingRead(this->Outputs(), timeout_secs_);
+  }
+
+  BlobsQueue::Slot slot;
+  if (!queue->reserveRead(&slot, timeout_secs_)) {
+    return false;
+  }
+  context_.WaitEvent(*queue->writtenEvent(slot));
+  for (int i = 0; i < OutputSize(); ++i) {
+    using std::swap;
+    swap(*Outputs()[i], *(*slot.blobs)[i]);
+  }
+  auto* read = queue->readEvent(slot);
+  read->Reset();
+  context_.Record(read);
+  queue->commitRead(slot);
+  return true;
+}
+
 REGISTER_CUDA_OPERATOR(CreateBlobsQueue, CreateBlobsQueueOp<CUDAContext>);
 REGISTER_CUDA_OPERATOR(EnqueueBlobs, EnqueueBlobsOp<CUDAContext>);
 REGISTER_CUDA_OPERATOR(DequeueBlobs, DequeueBlobsOp<CUDAContext>);
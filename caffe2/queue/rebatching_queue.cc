@@ -95,23 +95,61 @@ std::vector<std::vector<TensorCPU>> split(
 
   return outputs;
 }
+
+// Copies n rows between data and the slots from pos on, a run of the ring
+// that wraps around at most once
+void copySlots(
+    CPUContext& context,
+    TensorCPU* slots,
+    uint64_t pos,
+    TIndex n,
+    char* data,
+    bool toSlots) {
+  const TIndex capacity = slots->dim(0);
+  const auto rowItems = slots->size_from_dim(1);
+  const auto rowBytes = rowItems * slots->itemsize();
+  char* ring = static_cast<char*>(slots->raw_mutable_data());
+  while (n > 0 && rowItems > 0) {
+    const TIndex slot = pos % capacity;
+    const TIndex run = std::min<TIndex>(n, capacity - slot);
+    char* slotData = ring + slot * rowBytes;
+    context.CopyItems<CPUContext, CPUContext>(
+        slots->meta(),
+        run * rowItems,
+        toSlots ? data : slotData /* src */,
+        toSlots ? slotData : data /* dst */);
+    data += run * rowBytes;
+    pos += run;
+    n -= run;
+  }
+}
 } // anonymous namespace
 
-RebatchingQueue::RebatchingQueue(size_t capacity, size_t numBlobs)
-    : capacity_(capacity), numBlobs_(numBlobs), queue_(capacity) {}
+RebatchingQueue::RebatchingQueue(
+    size_t capacity,
+    size_t numBlobs,
+    bool fixedShape)
+    : capacity_(capacity),
+      numBlobs_(numBlobs),
+      queue_(fixedShape ? 0 : capacity),
+      fixedShape_(fixedShape),
+      slots_(fixedShape ? numBlobs : 0) {}
 
 RebatchingQueue::~RebatchingQueue() {
   close();
 }
 
 bool RebatchingQueue::canRead() const {
-  return tail_ < head_;
+  return (fixedShape_ ? reservedTail_ : tail_) < head_;
 }
 
 bool RebatchingQueue::dequeue(
     CPUContext& context,
     size_t numElements,
     const std::vector<TensorCPU*>& outputs) {
+  if (fixedShape_) {
+    return dequeueFixed(context, numElements, outputs);
+  }
   std::vector<std::vector<TensorCPU>> results;
   results.reserve(numElements);
 
@@ -152,12 +190,15 @@ bool RebatchingQueue::dequeue(
 }
 
 bool RebatchingQueue::canWrite() const {
-  return tail_ + capacity() > head_;
+  return tail_ + capacity() > (fixedShape_ ? reservedHead_ : head_);
 }
 
 bool RebatchingQueue::enqueueOne(
-    CPUContext& /*context*/,
+    CPUContext& context,
     const std::vector<const TensorCPU*>& inputs) {
+  if (fixedShape_) {
+    return enqueueFixed(context, inputs, false);
+  }
   std::vector<std::vector<TensorCPU>> splittedInputs;
   splittedInputs.emplace_back();
   auto& tensorVector = splittedInputs.back();
@@ -173,6 +214,9 @@ bool RebatchingQueue::enqueueMany(
     CPUContext& context,
     const std::vector<const TensorCPU*>& inputs) {
   CAFFE_ENFORCE_EQ(numBlobs_, inputs.size());
+  if (fixedShape_) {
+    return enqueueFixed(context, inputs, true);
+  }
 
   std::vector<std::vector<TensorCPU>> splittedInputs;
   splittedInputs = split(context, inputs);
@@ -209,6 +253,148 @@ bool RebatchingQueue::enqueue(
   return true;
 }
 
+void RebatchingQueue::prepareSlots(
+    const std::vector<const TensorCPU*>& inputs,
+    bool batched) {
+  for (int i = 0; i < numBlobs_; ++i) {
+    const auto& input = *inputs[i];
+    auto dims = input.dims();
+    if (batched) {
+      CAFFE_ENFORCE(!dims.empty());
+      CAFFE_ENFORCE_EQ(dims[0], inputs[0]->dim(0));
+      dims.erase(dims.begin());
+    }
+    dims.insert(dims.begin(), capacity());
+    if (!slotsReady_) {
+      slots_[i].Resize(dims);
+      slots_[i].raw_mutable_data(input.meta());
+      continue;
+    }
+    CAFFE_ENFORCE(
+        slots_[i].meta() == input.meta(),
+        "Fixed shape queue of ",
+        slots_[i].meta().name(),
+        " got ",
+        input.meta().name());
+    CAFFE_ENFORCE(
+        slots_[i].dims() == dims,
+        "Fixed shape queue got an element of another shape");
+  }
+  slotsReady_ = true;
+}
+
+bool RebatchingQueue::enqueueFixed(
+    CPUContext& context,
+    const std::vector<const TensorCPU*>& inputs,
+    bool batched) {
+  CAFFE_ENFORCE_EQ(numBlobs_, inputs.size());
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    prepareSlots(inputs, batched);
+  }
+  const TIndex numRows = batched ? inputs[0]->dim(0) : 1;
+  TIndex row = 0;
+  while (row < numRows) {
+    uint64_t start;
+    TIndex n;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cvOverflow_.wait(lock, [this] { return canWrite() || isClosed_; });
+      if (isClosed_) {
+        return false;
+      }
+      start = reservedHead_;
+      n = std::min<TIndex>(numRows - row, tail_ + capacity() - start);
+      reservedHead_ += n;
+    }
+
+    for (int i = 0; i < numBlobs_; ++i) {
+      const auto& input = *inputs[i];
+      const auto rowBytes = input.size_from_dim(batched ? 1 : 0) *
+          input.itemsize();
+      copySlots(
+          context,
+          &slots_[i],
+          start,
+          n,
+          (char*)input.raw_data() + row * rowBytes,
+          true);
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cvCommit_.wait(lock, [this, start] { return head_ == start; });
+      head_ = start + n;
+    }
+    cvCommit_.notify_all();
+    cvEmpty_.notify_all();
+    row += n;
+  }
+  return true;
+}
+
+bool RebatchingQueue::dequeueFixed(
+    CPUContext& context,
+    size_t numElements,
+    const std::vector<TensorCPU*>& outputs) {
+  CAFFE_ENFORCE_EQ(numBlobs_, outputs.size());
+  TIndex row = 0;
+  while (row < numElements) {
+    uint64_t start;
+    TIndex n;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cvEmpty_.wait(lock, [this] { return canRead() || isClosed_; });
+      if (!canRead() && isClosed_) {
+        break;
+      }
+      if (row == 0) {
+        // same shape as the last dequeue, so the memory is kept
+        for (int i = 0; i < numBlobs_; ++i) {
+          auto dims = slots_[i].dims();
+          dims[0] = numElements;
+          outputs[i]->Resize(dims);
+          outputs[i]->raw_mutable_data(slots_[i].meta());
+        }
+      }
+      start = reservedTail_;
+      n = std::min<TIndex>(numElements - row, head_ - start);
+      reservedTail_ += n;
+    }
+
+    for (int i = 0; i < numBlobs_; ++i) {
+      auto* output = outputs[i];
+      const auto rowBytes = output->size_from_dim(1) * output->itemsize();
+      copySlots(
+          context,
+          &slots_[i],
+          start,
+          n,
+          (char*)output->raw_mutable_data() + row * rowBytes,
+          false);
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cvCommit_.wait(lock, [this, start] { return tail_ == start; });
+      tail_ = start + n;
+    }
+    cvCommit_.notify_all();
+    cvOverflow_.notify_all();
+    row += n;
+  }
+
+  if (row == 0) {
+    return false;
+  }
+  if (row < numElements) {
+    for (auto* output : outputs) {
+      output->Shrink(row);
+    }
+  }
+  return true;
+}
+
 size_t RebatchingQueue::capacity() const {
   return capacity_;
 }
@@ -17,9 +17,16 @@ namespace caffe2 {
 // atomic index + circular queue optimizations or pull something more
 // heavy-weight later
 
+// With fixedShape, the queue owns a [capacity, element dims] tensor per blob,
+// made on the first enqueue, and all the elements have the same shape: the
+// producers reserve a run of slots and copy their rows straight into it, and
+// the consumers copy a run of slots straight into their outputs, which keep
+// their memory from one dequeue to the next. A run is one contiguous copy
+// per blob, or two where it wraps around the ring, instead of a copy and a
+// tensor per element.
 class RebatchingQueue {
  public:
-  RebatchingQueue(size_t capacity, size_t numBlobs);
+  RebatchingQueue(size_t capacity, size_t numBlobs, bool fixedShape = false);
 
   ~RebatchingQueue();
 
@@ -47,6 +54,16 @@ class RebatchingQueue {
  private:
   bool enqueue(std::vector<std::vector<TensorCPU>> splittedInputs);
 
+  bool enqueueFixed(
+      CPUContext& context,
+      const std::vector<const TensorCPU*>& inputs,
+      bool batched);
+  bool dequeueFixed(
+      CPUContext& context,
+      size_t numElements,
+      const std::vector<TensorCPU*>& outputs);
+  void prepareSlots(const std::vector<const TensorCPU*>& inputs, bool batched);
+
   bool canWrite() const;
   bool canRead() const;
 
@@ -64,5 +81,16 @@ class RebatchingQueue {
   std::condition_variable cvOverflow_;
 
   std::vector<std::vector<TensorCPU>> queue_;
+
+  const bool fixedShape_;
+  // fixedShape_: row i of the tensor of a blob is slot i
+  std::vector<TensorCPU> slots_;
+  bool slotsReady_{false};
+  // the slots [head_, reservedHead_) are being written and the slots
+  // [tail_, reservedTail_) are being read; the runs are committed, moving
+  // head_ / tail_, in the order they were reserved
+  uint64_t reservedHead_{0};
+  uint64_t reservedTail_{0};
+  std::condition_variable cvCommit_;
 };
 } // caffe2
@@ -26,7 +26,11 @@ Creates the Queue.
     .Arg("num_blobs", "Number of input tensors the queue will support")
     .Arg(
         "capacity",
-        "Maximal number of elements the queue can hold at any given point");
+        "Maximal number of elements the queue can hold at any given point")
+    .Arg(
+        "fixed_shape",
+        "All the elements have the shape of the first one, and are copied "
+        "into and out of tensors of the queue without allocating");
 
 OPERATOR_SCHEMA(CloseRebatchingQueue)
     .NumInputs(1)
@@ -15,7 +15,8 @@ class CreateRebatchingQueueOp : public Operator<CPUContext> {
     *OperatorBase::Output<RebatchingQueuePtr>(0) =
         RebatchingQueuePtr(new RebatchingQueue(
             OperatorBase::GetSingleArgument<int>("capacity", 1),
-            OperatorBase::GetSingleArgument<int>("num_blobs", 1)));
+            OperatorBase::GetSingleArgument<int>("num_blobs", 1),
+            OperatorBase::GetSingleArgument<bool>("fixed_shape", false)));
     return true;
   }
 };
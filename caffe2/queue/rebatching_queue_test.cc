@@ -0,0 +1,111 @@
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/queue/rebatching_queue.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// a [rows, 2] tensor of first * 10 + row, first * 10 + row + 0.5
+TensorCPU MakeRows(int first, int rows) {
+  TensorCPU tensor(std::vector<TIndex>{rows, 2});
+  auto* data = tensor.mutable_data<float>();
+  for (int i = 0; i < rows; ++i) {
+    data[2 * i] = (first + i) * 10;
+    data[2 * i + 1] = (first + i) * 10 + 0.5;
+  }
+  return tensor;
+}
+
+void ExpectRows(const TensorCPU& tensor, int first, int rows) {
+  ASSERT_EQ(tensor.dims(), (std::vector<TIndex>{rows, 2}));
+  for (int i = 0; i < rows; ++i) {
+    EXPECT_EQ(tensor.data<float>()[2 * i], (first + i) * 10);
+    EXPECT_EQ(tensor.data<float>()[2 * i + 1], (first + i) * 10 + 0.5);
+  }
+}
+
+} // namespace
+
+TEST(RebatchingQueueTest, FixedShapeRebatches) {
+  CPUContext context;
+  RebatchingQueue queue(5, 1, true);
+  TensorCPU output;
+  const float* data = nullptr;
+  // batches of 3 in, of 2 out, wrapping around the 5 slots
+  int read = 0;
+  for (int written = 0; written < 12; written += 3) {
+    auto input = MakeRows(written, 3);
+    EXPECT_TRUE(queue.enqueueMany(context, {&input}));
+    while (read + 2 <= written + 3) {
+      EXPECT_TRUE(queue.dequeue(context, 2, {&output}));
+      ExpectRows(output, read, 2);
+      if (data) {
+        EXPECT_EQ(output.data<float>(), data);
+      }
+      data = output.data<float>();
+      read += 2;
+    }
+  }
+
+  auto one = MakeRows(12, 1);
+  one.Resize(2);
+  EXPECT_TRUE(queue.enqueueOne(context, {&one}));
+  queue.close();
+  // the last of the 13 rows, in the memory of the earlier batches
+  EXPECT_TRUE(queue.dequeue(context, 2, {&output}));
+  ExpectRows(output, 12, 1);
+  EXPECT_EQ(output.data<float>(), data);
+  EXPECT_FALSE(queue.dequeue(context, 2, {&output}));
+}
+
+TEST(RebatchingQueueTest, FixedShapeEnforcesShape) {
+  CPUContext context;
+  RebatchingQueue queue(4, 1, true);
+  auto input = MakeRows(0, 2);
+  EXPECT_TRUE(queue.enqueueMany(context, {&input}));
+  TensorCPU other(std::vector<TIndex>{2, 3});
+  other.mutable_data<float>();
+  EXPECT_THROW(queue.enqueueMany(context, {&other}), EnforceNotMet);
+}
+
+TEST(RebatchingQueueTest, FixedShapeProducersAndConsumers) {
+  const int kThreads = 3;
+  const int kBatches = 200;
+  RebatchingQueue queue(7, 1, true);
+  std::vector<std::thread> producers;
+  for (int t = 0; t < kThreads; ++t) {
+    producers.emplace_back([&, t] {
+      CPUContext context;
+      for (int i = 0; i < kBatches; ++i) {
+        // rows of a batch hold the same value
+        TensorCPU input(std::vector<TIndex>{4, 2});
+        auto* data = input.mutable_data<float>();
+        std::fill(data, data + 8, float(t * kBatches + i));
+        EXPECT_TRUE(queue.enqueueMany(context, {&input}));
+      }
+    });
+  }
+  double sum = 0;
+  std::thread consumer([&] {
+    CPUContext context;
+    TensorCPU output;
+    while (queue.dequeue(context, 3, {&output})) {
+      for (int i = 0; i < output.size(); ++i) {
+        sum += output.data<float>()[i];
+      }
+    }
+  });
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  queue.close();
+  consumer.join();
+  const double n = kThreads * kBatches;
+  EXPECT_EQ(sum, 8 * n * (n - 1) / 2);
+}
+
+} // namespace caffe2
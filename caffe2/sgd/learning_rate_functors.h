@@ -1,6 +1,9 @@
 #ifndef CAFFE2_SGD_LEARNING_RATE_FUNCTORS_H_
 #define CAFFE2_SGD_LEARNING_RATE_FUNCTORS_H_
 
+#include <algorithm>
+#include <vector>
+
 #include "caffe2/core/context.h"
 #include "caffe2/core/operator.h"
 
@@ -135,6 +138,39 @@ class ConstantWarmupLearningRate : public LearningRateFunctor<T> {
   uint64_t num_iter_;
 };
 
+// StepsWithRelativeLrs: return lrs[i] for steps[i] <= iter < steps[i + 1],
+// where steps[0] is 0 and the last lr holds from the last step on. The
+// first num_iter iterations warm up linearly from start_multiplier at
+// iteration 0 to the multiplier of iteration num_iter at num_iter - 1.
+template <typename T>
+class StepsWithRelativeLrsLearningRate : public LearningRateFunctor<T> {
+ public:
+  StepsWithRelativeLrsLearningRate(
+      const std::vector<int64_t>& steps,
+      const std::vector<T>& lrs,
+      const T start_multiplier,
+      const int64_t num_iter)
+      : steps_(steps),
+        lrs_(lrs),
+        start_multiplier_(start_multiplier),
+        num_iter_(num_iter) {}
+  T operator()(const int64_t iter) const override {
+    if (iter >= num_iter_ || num_iter_ < 2) {
+      return Step(iter);
+    }
+    return start_multiplier_ +
+        (Step(num_iter_) - start_multiplier_) * T(iter) / T(num_iter_ - 1);
+  }
+  T Step(const int64_t iter) const {
+    const auto next = std::upper_bound(steps_.begin(), steps_.end(), iter);
+    return lrs_[std::max<int64_t>(next - steps_.begin() - 1, 0)];
+  }
+  std::vector<int64_t> steps_;
+  std::vector<T> lrs_;
+  T start_multiplier_;
+  int64_t num_iter_;
+};
+
 // hill: the learning rate changes according to following 3 stages
 // 1) linear warmup (increasing) at first num_iter steps from start_multiplier
 // 2) inverse shrink (decreasing) afterwards (gamma, power)
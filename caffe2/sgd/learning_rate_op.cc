@@ -4,8 +4,9 @@ namespace caffe2 {
 REGISTER_CPU_OPERATOR(LearningRate, LearningRateOp<float, CPUContext>);
 
 OPERATOR_SCHEMA(LearningRate)
-    .NumInputs(1)
-    .NumOutputs(1)
+    .NumInputs(1, INT_MAX)
+    .NumOutputs(1, INT_MAX)
+    .EnforceInplace([](int in, int out) { return in > 0 && in == out; })
     .SetDoc(R"DOC(
 Learning rate is a decreasing function of time. With low learning rates the
 improvements will be linear. With high learning rates they will start to look
@@ -24,6 +25,13 @@ Required:
     `constantWarmup`: uses `multiplier`, `num_iter`
     `alter`: uses  `active_first`, `active_period`, `inactive_period`
     `hill`: uses those in both `linearWarmup` and `inv`, plus `end_multiplier`
+    `stepsWithRelativeLrs`: uses `steps`, `lrs`, and `start_multiplier`,
+      `num_iter` for a linear warmup
+
+
+Inputs after the iterations are momentum blobs, which are scaled in place by
+new lr / old lr whenever the learning rate changes, as the update history
+V := mu * V + lr * grad of MomentumSGDUpdate scales with the lr.
 
 
 Optional:
@@ -67,12 +75,21 @@ Example usage:
     .Arg(
         "multiplier",
         "(float, default 0.5) constant multiplier for learning rate")
+    .Arg(
+        "steps",
+        "(int64_t list) the first iterations of the steps, starting at 0, in "
+        "stepsWithRelativeLrs policy")
+    .Arg("lrs", "(float list) the multiplier of every step")
     .Input(0, "input", "description needed")
+    .Input(1, "momentum", "(optional) update histories to scale in place")
     .Output(0, "output", "description needed")
     .DeviceInferenceFunction([](const OperatorDef& def) {
+      std::vector<DeviceOption> input_devices(
+          def.input_size(), def.device_option());
+      input_devices[0] = DeviceOption();
       return std::make_pair(
-          std::vector<DeviceOption>{DeviceOption()},
-          std::vector<DeviceOption>{def.device_option()});
+          input_devices,
+          std::vector<DeviceOption>(def.output_size(), def.device_option()));
     });
 
 NO_GRADIENT(LearningRate);
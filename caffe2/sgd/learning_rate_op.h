@@ -1,11 +1,13 @@
 #ifndef CAFFE2_SGD_LEARNING_RATE_OP_H_
 #define CAFFE2_SGD_LEARNING_RATE_OP_H_
 
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
 #include "caffe2/core/context.h"
 #include "caffe2/core/operator.h"
 #include "caffe2/sgd/learning_rate_functors.h"
+#include "caffe2/utils/math.h"
 
 namespace caffe2 {
 
@@ -90,6 +92,21 @@ class LearningRateOp final : public Operator<Context> {
           OperatorBase::template GetSingleArgument<int>("num_iter", 0);
       DCHECK_GT(multiplier, 0);
       functor_.reset(new ConstantWarmupLearningRate<T>(multiplier, num_iter));
+    } else if (policy == "stepsWithRelativeLrs") {
+      const auto steps =
+          OperatorBase::template GetRepeatedArgument<int64_t>("steps");
+      const auto lrs = OperatorBase::template GetRepeatedArgument<float>("lrs");
+      CAFFE_ENFORCE(
+          steps.size() && steps[0] == 0, "The first step must be at 0.");
+      CAFFE_ENFORCE(std::is_sorted(steps.begin(), steps.end()));
+      CAFFE_ENFORCE_EQ(steps.size(), lrs.size(), "One lr per step.");
+      T start_multiplier = OperatorBase::template GetSingleArgument<float>(
+          "start_multiplier", 0.);
+      int num_iter =
+          OperatorBase::template GetSingleArgument<int>("num_iter", 0);
+      functor_.reset(new StepsWithRelativeLrsLearningRate<T>(
+          steps, vector<T>(lrs.begin(), lrs.end()), start_multiplier,
+          num_iter));
     } else {
       LOG(FATAL) << "Unknown learning rate policy: " << policy;
     }
@@ -100,17 +117,46 @@ class LearningRateOp final : public Operator<Context> {
     int64_t iter =
         OperatorBase::Input<TensorCPU>(0).template data<int64_t>()[0];
     T learning_rate = base_lr_ * (*functor_)(iter);
-    // Write to output.
-    auto* output = Output(0);
-    output->Resize(vector<TIndex>());
-    context_.template Copy<T, CPUContext, Context>(
-        1, &learning_rate, Output(0)->template mutable_data<T>());
+    CAFFE_ENFORCE_EQ(InputSize(), OutputSize());
+    if (InputSize() > 1) {
+      // The momentum V := mu * V + lr * grad scales with the lr, so it is
+      // scaled to the new lr when the lr changes. A resumed run starts from
+      // the lr of the previous iteration.
+      const T last_lr = has_lr_
+          ? last_lr_
+          : (iter > 0 ? base_lr_ * (*functor_)(iter - 1) : learning_rate);
+      if (std::abs(learning_rate - last_lr) >
+          std::abs(T(1e-7) * learning_rate)) {
+        for (int i = 1; i < InputSize(); ++i) {
+          const auto& momentum = Input(i);
+          math::Scale<T, Context>(
+              momentum.size(),
+              learning_rate / last_lr,
+              momentum.template data<T>(),
+              Output(i)->template mutable_data<T>(),
+              &context_);
+        }
+      }
+    }
+    // Write to output, when the lr changes. This spares the copy to the
+    // device on most iterations.
+    if (!has_lr_ || learning_rate != last_lr_) {
+      auto* output = Output(0);
+      output->Resize(vector<TIndex>());
+      context_.template Copy<T, CPUContext, Context>(
+          1, &learning_rate, Output(0)->template mutable_data<T>());
+      last_lr_ = learning_rate;
+      has_lr_ = true;
+    }
     return true;
   }
 
  private:
   unique_ptr<LearningRateFunctor<T> > functor_;
   T base_lr_;
+  // the lr of the last run, which the output still holds
+  T last_lr_ = 0;
+  bool has_lr_ = false;
 
 };
 
@@ -0,0 +1,163 @@
+#include "caffe2/sgd/multi_tensor_layerwise_op.h"
+
+namespace caffe2 {
+
+template <>
+void multi_tensor_layerwise_norms<CPUContext>(
+    const int num_chunks,
+    const LayerwiseTensor* tensors,
+    const LayerwiseChunk* chunks,
+    const LayerwiseHyperParams& hp,
+    float* norms,
+    CPUContext* /*context*/) {
+  // the sums of the chunks, added up per tensor after the parallel loop
+  std::vector<float> partial(2 * num_chunks);
+#pragma omp parallel for
+  for (int c = 0; c < num_chunks; ++c) {
+    const LayerwiseChunk& chunk = chunks[c];
+    const LayerwiseTensor& t = tensors[chunk.tensor];
+    float param_sq = 0;
+    float update_sq = 0;
+    for (int i = chunk.begin; i < chunk.end; ++i) {
+      const float p = t.param[i];
+      float g = hp.grad_scale * t.grad[i];
+      if (hp.lamb) {
+        const float m = hp.beta1 * t.moment1[i] + (1 - hp.beta1) * g;
+        const float v = hp.beta2 * t.moment2[i] + (1 - hp.beta2) * g * g;
+        t.moment1[i] = m;
+        t.moment2[i] = v;
+        g = m * hp.correction1 /
+                (std::sqrt(v * hp.correction2) + hp.epsilon) +
+            t.weight_decay * p;
+      } else {
+        g += t.weight_decay * p;
+      }
+      t.grad[i] = g;
+      param_sq += p * p;
+      update_sq += g * g;
+    }
+    partial[2 * c] = param_sq;
+    partial[2 * c + 1] = update_sq;
+  }
+  for (int c = 0; c < num_chunks; ++c) {
+    norms[2 * chunks[c].tensor] += partial[2 * c];
+    norms[2 * chunks[c].tensor + 1] += partial[2 * c + 1];
+  }
+}
+
+template <>
+void multi_tensor_layerwise_apply<CPUContext>(
+    const int num_chunks,
+    const LayerwiseTensor* tensors,
+    const LayerwiseChunk* chunks,
+    const LayerwiseHyperParams& hp,
+    const float* norms,
+    const float* lr,
+    CPUContext* /*context*/) {
+  const float LR = lr[0];
+#pragma omp parallel for
+  for (int c = 0; c < num_chunks; ++c) {
+    const LayerwiseChunk& chunk = chunks[c];
+    const LayerwiseTensor& t = tensors[chunk.tensor];
+    const float local_lr = LR *
+        layerwise_trust_ratio(hp,
+                              t.trust,
+                              norms[2 * chunk.tensor],
+                              norms[2 * chunk.tensor + 1]);
+    for (int i = chunk.begin; i < chunk.end; ++i) {
+      float update = local_lr * t.grad[i];
+      if (!hp.lamb) {
+        update += hp.momentum * t.moment1[i];
+        t.moment1[i] = update;
+      }
+      t.grad[i] = update;
+      t.param[i] -= update;
+    }
+  }
+}
+
+REGISTER_CPU_OPERATOR(
+    MultiTensorLarsUpdate,
+    MultiTensorLayerwiseUpdateOp<float, CPUContext, false>);
+REGISTER_CPU_OPERATOR(
+    MultiTensorLambUpdate,
+    MultiTensorLayerwiseUpdateOp<float, CPUContext, true>);
+
+OPERATOR_SCHEMA(MultiTensorLarsUpdate)
+    .NumInputs([](int n) { return n >= 4 && (n - 1) % 3 == 0; })
+    .NumOutputs(3, INT_MAX)
+    .EnforceInplace([](int in, int out) { return in == out + 1; })
+    .TensorInferenceFunction(
+        [](const OperatorDef& /* unused */, const vector<TensorShape>& in) {
+          return vector<TensorShape>(in.begin() + 1, in.end());
+        })
+    .SetDoc(R"DOC(
+
+Performs momentum SGD with Layer-wise Adaptive Rate Scaling (LARS,
+https://arxiv.org/abs/1708.03888) on many tensors in one op. Given inputs
+(lr, grad_0, m_0, param_0, grad_1, m_1, param_1, ...) computes for every
+tensor i
+
+    grad = grad_scale * grad_i + weight_decay[groups[i]] * param_i
+    local_lr = lr * eta * norm(param_i) / (norm(grad) + offset * norm(param_i))
+    m_i = momentum * m_i + local_lr * grad
+    param_i = param_i - m_i
+
+in place, with grad_i set to m_i as MomentumSGDUpdate does. local_lr is lr
+for the tensors of a group with trust 0, e.g. the batch norm params and the
+biases, and for a tensor with a zero norm. Without weight decay and with
+eta 1 the scale of lr is the lr_rescale of the Lars op.
+
+The norms of all the tensors are computed in one segmented reduction over a
+table of their chunks, and all the updates in one more pass: on CUDA two
+kernel launches in all, instead of a Lars op and an update per tensor. The
+table is only copied to the GPU again when a blob is reallocated, so the
+views of a CreateFlatBuffer may be updated as well as separate blobs.
+
+)DOC")
+    .Arg("momentum", "momentum, default 0")
+    .Arg("eta", "trust coefficient, default 1")
+    .Arg("offset", "rescaling offset as in the Lars op, default 0")
+    .Arg("grad_scale", "scale of the gradients, e.g. to undo a loss scale")
+    .Arg("weight_decay", "weight decay of every group")
+    .Arg("trust", "1 (default) to scale the lr of the group by LARS, else 0")
+    .Arg("groups", "group of every tensor, default 0");
+SHOULD_NOT_DO_GRADIENT(MultiTensorLarsUpdate);
+
+OPERATOR_SCHEMA(MultiTensorLambUpdate)
+    .NumInputs([](int n) { return n >= 6 && (n - 2) % 4 == 0; })
+    .NumOutputs(4, INT_MAX)
+    .EnforceInplace([](int in, int out) { return in == out + 2; })
+    .TensorInferenceFunction(
+        [](const OperatorDef& /* unused */, const vector<TensorShape>& in) {
+          return vector<TensorShape>(in.begin() + 2, in.end());
+        })
+    .SetDoc(R"DOC(
+
+Performs the LAMB update (https://arxiv.org/abs/1904.00962) of many tensors
+in one op. Given inputs (lr, iter, grad_0, m1_0, m2_0, param_0, grad_1, ...)
+computes for every tensor i, with t = iter + 1
+
+    grad = grad_scale * grad_i
+    m1_i = beta1 * m1_i + (1 - beta1) * grad
+    m2_i = beta2 * m2_i + (1 - beta2) * grad ^ 2
+    update = (m1_i / (1 - beta1 ^ t)) / (sqrt(m2_i / (1 - beta2 ^ t)) + epsilon)
+             + weight_decay[groups[i]] * param_i
+    param_i = param_i - lr * norm(param_i) / norm(update) * update
+
+in place, with grad_i set to the step taken. As for MultiTensorLarsUpdate
+the ratio of the norms is 1 for the groups with trust 0, the norms are
+computed in one segmented reduction over all the tensors and the updates in
+one more pass. iter is an int64 on the CPU, as for Adam.
+
+)DOC")
+    .Arg("beta1", "decay of the first moment, default 0.9")
+    .Arg("beta2", "decay of the second moment, default 0.999")
+    .Arg("epsilon", "default 1e-6")
+    .Arg("grad_scale", "scale of the gradients, e.g. to undo a loss scale")
+    .Arg("weight_decay", "weight decay of every group")
+    .Arg("trust", "1 (default) to scale the lr of the group by LAMB, else 0")
+    .Arg("groups", "group of every tensor, default 0");
+SHOULD_NOT_DO_GRADIENT(MultiTensorLambUpdate);
+
+} // namespace caffe2
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// A tensor of a MultiTensorLarsUpdate or MultiTensorLambUpdate, updated in
+// place, with the weight decay of its group and whether its learning rate
+// is scaled by its trust ratio. LARS has no moment2.
+struct LayerwiseTensor {
+  float* grad;
+  float* moment1;
+  float* moment2;
+  float* param;
+  float weight_decay;
+  int trust;
+};
+
+// The elements [begin, end) of a tensor, reduced and updated by a block of
+// the CUDA kernels or an OpenMP iteration of the CPU version.
+struct LayerwiseChunk {
+  int tensor;
+  int begin;
+  int end;
+};
+
+constexpr int kLayerwiseChunkSize = 8192;
+
+struct LayerwiseHyperParams {
+  bool lamb;
+  float grad_scale;
+  // LARS
+  float momentum;
+  float eta;
+  float offset;
+  // LAMB, with the bias corrections of the iteration
+  float beta1;
+  float beta2;
+  float epsilon;
+  float correction1;
+  float correction2;
+};
+
+// The first pass: writes the direction of every tensor to its grad, which
+// for LARS is grad_scale * grad + weight_decay * param, and for LAMB the
+// Adam direction with the weight decay added after the moments are updated,
+// and adds the squared norms of the param and of the direction of every
+// tensor to norms[2 * tensor] and norms[2 * tensor + 1], which start at 0.
+template <typename Context>
+void multi_tensor_layerwise_norms(
+    const int num_chunks,
+    const LayerwiseTensor* tensors,
+    const LayerwiseChunk* chunks,
+    const LayerwiseHyperParams& hp,
+    float* norms,
+    Context* context);
+
+// The second pass: scales the learning rate of every tensor with its trust
+// ratio and applies the direction, writing the applied update to grad.
+template <typename Context>
+void multi_tensor_layerwise_apply(
+    const int num_chunks,
+    const LayerwiseTensor* tensors,
+    const LayerwiseChunk* chunks,
+    const LayerwiseHyperParams& hp,
+    const float* norms,
+    const float* lr,
+    Context* context);
+
+// The trust ratio of a tensor from the squared norms of its param and its
+// direction; 1 for a tensor excluded from it or with a zero norm.
+#ifdef __CUDACC__
+__host__ __device__
+#endif
+inline float layerwise_trust_ratio(
+    const LayerwiseHyperParams& hp,
+    const int trust,
+    const float param_sq,
+    const float update_sq) {
+  const float param_norm = std::sqrt(param_sq);
+  const float update_norm = std::sqrt(update_sq);
+  if (!trust || param_norm == 0 || update_norm == 0) {
+    return 1;
+  }
+  return hp.lamb ? param_norm / update_norm
+                 : hp.eta * param_norm / (update_norm + hp.offset * param_norm);
+}
+
+// Inputs (lr, (grad, momentum, param)*) for LARS, (lr, iter, (grad, moment1,
+// moment2, param)*) for LAMB; the outputs are the inputs after lr and iter,
+// in place.
+template <typename T, class Context, bool LAMB>
+class MultiTensorLayerwiseUpdateOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  MultiTensorLayerwiseUpdateOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        weight_decay_(
+            OperatorBase::GetRepeatedArgument<float>("weight_decay")),
+        trust_(OperatorBase::GetRepeatedArgument<int>("trust")),
+        groups_(OperatorBase::GetRepeatedArgument<int>("groups")) {
+    hp_.lamb = LAMB;
+    hp_.grad_scale = OperatorBase::GetSingleArgument<float>("grad_scale", 1.0);
+    hp_.momentum = OperatorBase::GetSingleArgument<float>("momentum", 0.0);
+    hp_.eta = OperatorBase::GetSingleArgument<float>("eta", 1.0);
+    hp_.offset = OperatorBase::GetSingleArgument<float>("offset", 0.0);
+    hp_.beta1 = OperatorBase::GetSingleArgument<float>("beta1", 0.9);
+    hp_.beta2 = OperatorBase::GetSingleArgument<float>("beta2", 0.999);
+    hp_.epsilon = OperatorBase::GetSingleArgument<float>("epsilon", 1e-6);
+    CAFFE_ENFORCE_GE(hp_.offset, 0);
+    CAFFE_ENFORCE_EQ((InputSize() - kFirst) % kStride, 0);
+    num_tensors_ = (InputSize() - kFirst) / kStride;
+    if (weight_decay_.empty()) {
+      weight_decay_.push_back(0);
+    }
+    if (trust_.empty()) {
+      trust_.resize(weight_decay_.size(), 1);
+    }
+    CAFFE_ENFORCE_EQ(
+        trust_.size(), weight_decay_.size(), "Need a trust per group.");
+    if (groups_.empty()) {
+      groups_.resize(num_tensors_, 0);
+    }
+    CAFFE_ENFORCE_EQ(
+        static_cast<int>(groups_.size()),
+        num_tensors_,
+        "Need a group per tensor.");
+    for (const int group : groups_) {
+      CAFFE_ENFORCE(
+          group >= 0 && group < static_cast<int>(weight_decay_.size()),
+          "No weight_decay for group ",
+          group);
+    }
+  }
+
+  bool RunOnDevice() override {
+    CAFFE_ENFORCE_EQ(Input(LR).size(), 1);
+    if (LAMB) {
+      // Iter lives on the CPU, as for Adam
+      CAFFE_ENFORCE(OperatorBase::InputIsType<TensorCPU>(ITER));
+      const auto t =
+          OperatorBase::Input<TensorCPU>(ITER).template data<int64_t>()[0] +
+          1;
+      hp_.correction1 = 1. / (1. - std::pow(hp_.beta1, t));
+      hp_.correction2 = 1. / (1. - std::pow(hp_.beta2, t));
+    }
+    std::vector<LayerwiseTensor> tensors(num_tensors_);
+    std::vector<TIndex> sizes(num_tensors_);
+    for (int i = 0; i < num_tensors_; ++i) {
+      const int in = kFirst + kStride * i;
+      const int out = in - kFirst;
+      const auto& grad = Input(in);
+      for (int j = 1; j < kStride; ++j) {
+        CAFFE_ENFORCE_EQ(grad.size(), Input(in + j).size());
+      }
+      CAFFE_ENFORCE_LE(grad.size(), std::numeric_limits<int>::max());
+      tensors[i].grad = Output(out)->template mutable_data<T>();
+      tensors[i].moment1 = Output(out + 1)->template mutable_data<T>();
+      tensors[i].moment2 =
+          LAMB ? Output(out + 2)->template mutable_data<T>() : nullptr;
+      tensors[i].param = Output(out + kStride - 1)->template mutable_data<T>();
+      tensors[i].weight_decay = weight_decay_[groups_[i]];
+      tensors[i].trust = trust_[groups_[i]];
+      sizes[i] = grad.size();
+    }
+    if (Changed(tensors, sizes)) {
+      BuildTable(tensors, sizes);
+    }
+    if (num_chunks_ == 0) {
+      return true;
+    }
+    const auto* table = table_.template data<char>();
+    const auto* tensor_table = reinterpret_cast<const LayerwiseTensor*>(table);
+    const auto* chunk_table = reinterpret_cast<const LayerwiseChunk*>(
+        table + num_tensors_ * sizeof(LayerwiseTensor));
+    norms_.Resize(2 * num_tensors_);
+    float* norms = norms_.template mutable_data<float>();
+    math::Set<float, Context>(norms_.size(), 0, norms, &context_);
+    multi_tensor_layerwise_norms<Context>(
+        num_chunks_, tensor_table, chunk_table, hp_, norms, &context_);
+    multi_tensor_layerwise_apply<Context>(
+        num_chunks_,
+        tensor_table,
+        chunk_table,
+        hp_,
+        norms,
+        Input(LR).template data<T>(),
+        &context_);
+    return true;
+  }
+
+ private:
+  // the inputs before the tensors, and the inputs of a tensor
+  static constexpr int kFirst = LAMB ? 2 : 1;
+  static constexpr int kStride = LAMB ? 4 : 3;
+
+  bool Changed(
+      const std::vector<LayerwiseTensor>& tensors,
+      const std::vector<TIndex>& sizes) const {
+    if (sizes != sizes_) {
+      return true;
+    }
+    for (int i = 0; i < num_tensors_; ++i) {
+      if (tensors[i].grad != tensors_[i].grad ||
+          tensors[i].moment1 != tensors_[i].moment1 ||
+          tensors[i].moment2 != tensors_[i].moment2 ||
+          tensors[i].param != tensors_[i].param) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // As for MultiTensorMomentumSGDUpdate, the table is only copied again when
+  // a blob is reallocated, which views of flat buffers never are.
+  void BuildTable(
+      const std::vector<LayerwiseTensor>& tensors,
+      const std::vector<TIndex>& sizes) {
+    tensors_ = tensors;
+    sizes_ = sizes;
+    std::vector<LayerwiseChunk> chunks;
+    for (int i = 0; i < num_tensors_; ++i) {
+      for (TIndex begin = 0; begin < sizes[i]; begin += kLayerwiseChunkSize) {
+        const TIndex end = std::min(begin + kLayerwiseChunkSize, sizes[i]);
+        chunks.push_back({i, static_cast<int>(begin), static_cast<int>(end)});
+      }
+    }
+    num_chunks_ = chunks.size();
+    const size_t tensor_bytes = tensors.size() * sizeof(LayerwiseTensor);
+    const size_t chunk_bytes = chunks.size() * sizeof(LayerwiseChunk);
+    host_table_.Resize(tensor_bytes + chunk_bytes);
+    char* host = host_table_.template mutable_data<char>();
+    memcpy(host, tensors.data(), tensor_bytes);
+    memcpy(host + tensor_bytes, chunks.data(), chunk_bytes);
+    table_.CopyFrom(host_table_, &context_);
+  }
+
+  LayerwiseHyperParams hp_;
+  // the weight decay and trust of every group, and the group of every tensor
+  std::vector<float> weight_decay_;
+  std::vector<int> trust_;
+  std::vector<int> groups_;
+  int num_tensors_;
+  std::vector<LayerwiseTensor> tensors_;
+  std::vector<TIndex> sizes_;
+  int num_chunks_ = 0;
+  TensorCPU host_table_;
+  Tensor<Context> table_;
+  // the squared norms of the param and the direction of every tensor
+  Tensor<Context> norms_;
+  INPUT_TAGS(LR, ITER);
+};
+
+} // namespace caffe2
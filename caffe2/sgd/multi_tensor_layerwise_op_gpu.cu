@@ -0,0 +1,109 @@
+#include <cub/block/block_reduce.cuh>
+
+#include "caffe2/core/common_gpu.h"
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/sgd/multi_tensor_layerwise_op.h"
+
+namespace caffe2 {
+
+__global__ void MultiTensorLayerwiseNormsKernel(
+    const LayerwiseTensor* tensors,
+    const LayerwiseChunk* chunks,
+    const LayerwiseHyperParams hp,
+    float* norms) {
+  typedef cub::BlockReduce<float, CAFFE_CUDA_NUM_THREADS> BlockReduce;
+  __shared__ BlockReduce::TempStorage temp_storage;
+  const LayerwiseChunk chunk = chunks[blockIdx.x];
+  const LayerwiseTensor t = tensors[chunk.tensor];
+  float param_sq = 0;
+  float update_sq = 0;
+  for (int i = chunk.begin + threadIdx.x; i < chunk.end; i += blockDim.x) {
+    const float p = t.param[i];
+    float g = hp.grad_scale * t.grad[i];
+    if (hp.lamb) {
+      const float m = hp.beta1 * t.moment1[i] + (1 - hp.beta1) * g;
+      const float v = hp.beta2 * t.moment2[i] + (1 - hp.beta2) * g * g;
+      t.moment1[i] = m;
+      t.moment2[i] = v;
+      g = m * hp.correction1 / (sqrtf(v * hp.correction2) + hp.epsilon) +
+          t.weight_decay * p;
+    } else {
+      g += t.weight_decay * p;
+    }
+    t.grad[i] = g;
+    param_sq += p * p;
+    update_sq += g * g;
+  }
+  param_sq = BlockReduce(temp_storage).Sum(param_sq);
+  __syncthreads();
+  update_sq = BlockReduce(temp_storage).Sum(update_sq);
+  // the chunks of a tensor add up into its norms
+  if (threadIdx.x == 0) {
+    atomicAdd(norms + 2 * chunk.tensor, param_sq);
+    atomicAdd(norms + 2 * chunk.tensor + 1, update_sq);
+  }
+}
+
+__global__ void MultiTensorLayerwiseApplyKernel(
+    const LayerwiseTensor* tensors,
+    const LayerwiseChunk* chunks,
+    const LayerwiseHyperParams hp,
+    const float* norms,
+    const float* lr) {
+  const LayerwiseChunk chunk = chunks[blockIdx.x];
+  const LayerwiseTensor t = tensors[chunk.tensor];
+  const float local_lr = lr[0] *
+      layerwise_trust_ratio(hp,
+                            t.trust,
+                            norms[2 * chunk.tensor],
+                            norms[2 * chunk.tensor + 1]);
+  for (int i = chunk.begin + threadIdx.x; i < chunk.end; i += blockDim.x) {
+    float update = local_lr * t.grad[i];
+    if (!hp.lamb) {
+      update += hp.momentum * t.moment1[i];
+      t.moment1[i] = update;
+    }
+    t.grad[i] = update;
+    t.param[i] -= update;
+  }
+}
+
+template <>
+void multi_tensor_layerwise_norms<CUDAContext>(
+    const int num_chunks,
+    const LayerwiseTensor* tensors,
+    const LayerwiseChunk* chunks,
+    const LayerwiseHyperParams& hp,
+    float* norms,
+    CUDAContext* context) {
+  MultiTensorLayerwiseNormsKernel<<<
+      num_chunks,
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(tensors, chunks, hp, norms);
+}
+
+template <>
+void multi_tensor_layerwise_apply<CUDAContext>(
+    const int num_chunks,
+    const LayerwiseTensor* tensors,
+    const LayerwiseChunk* chunks,
+    const LayerwiseHyperParams& hp,
+    const float* norms,
+    const float* lr,
+    CUDAContext* context) {
+  MultiTensorLayerwiseApplyKernel<<<
+      num_chunks,
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(tensors, chunks, hp, norms, lr);
+}
+
+REGISTER_CUDA_OPERATOR(
+    MultiTensorLarsUpdate,
+    MultiTensorLayerwiseUpdateOp<float, CUDAContext, false>);
+REGISTER_CUDA_OPERATOR(
+    MultiTensorLambUpdate,
+    MultiTensorLayerwiseUpdateOp<float, CUDAContext, true>);
+
+} // namespace caffe2
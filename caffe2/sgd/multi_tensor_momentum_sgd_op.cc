@@ -0,0 +1,70 @@
+#include "caffe2/sgd/multi_tensor_momentum_sgd_op.h"
+
+namespace caffe2 {
+
+template <>
+void multi_tensor_momentum_sgd_update<CPUContext>(
+    const int num_chunks,
+    const MomentumSGDTensor* tensors,
+    const MomentumSGDChunk* chunks,
+    const float* lr,
+    const float momentum,
+    const bool nesterov,
+    const float grad_scale,
+    CPUContext* /*context*/) {
+  const float LR = lr[0];
+#pragma omp parallel for
+  for (int c = 0; c < num_chunks; ++c) {
+    const MomentumSGDChunk& chunk = chunks[c];
+    const MomentumSGDTensor& t = tensors[chunk.tensor];
+    for (int i = chunk.begin; i < chunk.end; ++i) {
+      const float g = grad_scale * t.grad[i] + t.weight_decay * t.param[i];
+      const float mi = t.momentum[i];
+      float adjusted_gradient;
+      if (!nesterov) {
+        adjusted_gradient = LR * g + momentum * mi;
+        t.momentum[i] = adjusted_gradient;
+      } else {
+        const float mi_new = momentum * mi + LR * g;
+        t.momentum[i] = mi_new;
+        adjusted_gradient = (1 + momentum) * mi_new - momentum * mi;
+      }
+      t.grad[i] = adjusted_gradient;
+      t.param[i] -= adjusted_gradient;
+    }
+  }
+}
+
+REGISTER_CPU_OPERATOR(
+    MultiTensorMomentumSGDUpdate,
+    MultiTensorMomentumSGDUpdateOp<float, CPUContext>);
+OPERATOR_SCHEMA(MultiTensorMomentumSGDUpdate)
+    .NumInputs([](int n) { return n >= 4 && (n - 1) % 3 == 0; })
+    .NumOutputs(3, INT_MAX)
+    .EnforceInplace([](int in, int out) { return in == out + 1; })
+    .TensorInferenceFunction(
+        [](const OperatorDef& /* unused */, const vector<TensorShape>& in) {
+          return vector<TensorShape>(in.begin() + 1, in.end());
+        })
+    .SetDoc(R"DOC(
+
+Performs the MomentumSGDUpdate of many tensors in one op, with the weight
+decay folded into the gradients. Given inputs (lr, grad_0, m_0, param_0,
+grad_1, m_1, param_1, ...) and arguments (momentum, nesterov, grad_scale,
+weight_decay, groups), computes for every tensor i:
+
+    grad = grad_scale * grad_i + weight_decay[groups[i]] * param_i
+
+followed by the update of MomentumSGDUpdate on grad, m_i and param_i, in
+place. weight_decay holds the weight decay of every group of tensors, e.g.
+of the conv weights and of the batch norm params, and groups the group of
+every tensor (default 0).
+
+The CUDA version updates all the tensors in one kernel launch over a table
+of their chunks, which is only copied to the GPU again when a blob is
+reallocated.
+
+)DOC");
+SHOULD_NOT_DO_GRADIENT(MultiTensorMomentumSGDUpdate);
+
+} // namespace caffe2
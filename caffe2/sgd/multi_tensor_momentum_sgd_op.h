@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+
+namespace caffe2 {
+
+// A tensor of a MultiTensorMomentumSGDUpdate, updated in place, with the
+// weight decay of its group.
+struct MomentumSGDTensor {
+  float* grad;
+  float* momentum;
+  float* param;
+  float weight_decay;
+};
+
+// The elements [begin, end) of a tensor. The CUDA kernel updates a chunk
+// per block, the CPU version a chunk per OpenMP iteration.
+struct MomentumSGDChunk {
+  int tensor;
+  int begin;
+  int end;
+};
+
+constexpr int kMomentumSGDChunkSize = 8192;
+
+// Updates the chunks of the tensors like momentum_sgd_update, on the
+// gradient grad_scale * grad + weight_decay * param. For CUDA, tensors and
+// chunks are in device memory.
+template <typename Context>
+void multi_tensor_momentum_sgd_update(
+    const int num_chunks,
+    const MomentumSGDTensor* tensors,
+    const MomentumSGDChunk* chunks,
+    const float* lr,
+    const float momentum,
+    const bool nesterov,
+    const float grad_scale,
+    Context* context);
+
+template <typename T, class Context>
+class MultiTensorMomentumSGDUpdateOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  MultiTensorMomentumSGDUpdateOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        momentum_(OperatorBase::GetSingleArgument<float>("momentum", 0.0)),
+        nesterov_(OperatorBase::GetSingleArgument<int>("nesterov", 0)),
+        grad_scale_(OperatorBase::GetSingleArgument<float>("grad_scale", 1.0)),
+        weight_decay_(
+            OperatorBase::GetRepeatedArgument<float>("weight_decay")),
+        groups_(OperatorBase::GetRepeatedArgument<int>("groups")) {
+    CAFFE_ENFORCE_EQ((InputSize() - 1) % 3, 0);
+    num_tensors_ = (InputSize() - 1) / 3;
+    if (weight_decay_.empty()) {
+      weight_decay_.push_back(0);
+    }
+    if (groups_.empty()) {
+      groups_.resize(num_tensors_, 0);
+    }
+    CAFFE_ENFORCE_EQ(
+        static_cast<int>(groups_.size()),
+        num_tensors_,
+        "Need a group per tensor.");
+    for (const int group : groups_) {
+      CAFFE_ENFORCE(
+          group >= 0 && group < static_cast<int>(weight_decay_.size()),
+          "No weight_decay for group ",
+          group);
+    }
+  }
+
+  bool RunOnDevice() override {
+    CAFFE_ENFORCE_EQ(Input(LR).size(), 1);
+    std::vector<MomentumSGDTensor> tensors(num_tensors_);
+    std::vector<TIndex> sizes(num_tensors_);
+    for (int i = 0; i < num_tensors_; ++i) {
+      const auto& grad = Input(1 + 3 * i);
+      CAFFE_ENFORCE_EQ(grad.size(), Input(2 + 3 * i).size());
+      CAFFE_ENFORCE_EQ(grad.size(), Input(3 + 3 * i).size());
+      CAFFE_ENFORCE_LE(grad.size(), std::numeric_limits<int>::max());
+      tensors[i].grad = Output(3 * i)->template mutable_data<T>();
+      tensors[i].momentum = Output(3 * i + 1)->template mutable_data<T>();
+      tensors[i].param = Output(3 * i + 2)->template mutable_data<T>();
+      tensors[i].weight_decay = weight_decay_[groups_[i]];
+      sizes[i] = grad.size();
+    }
+    if (Changed(tensors, sizes)) {
+      BuildTable(tensors, sizes);
+    }
+    if (num_chunks_ == 0) {
+      return true;
+    }
+    const auto* table = table_.template data<char>();
+    multi_tensor_momentum_sgd_update<Context>(
+        num_chunks_,
+        reinterpret_cast<const MomentumSGDTensor*>(table),
+        reinterpret_cast<const MomentumSGDChunk*>(
+            table + num_tensors_ * sizeof(MomentumSGDTensor)),
+        Input(LR).template data<T>(),
+        momentum_,
+        nesterov_,
+        grad_scale_,
+        &context_);
+    return true;
+  }
+
+ private:
+  bool Changed(
+      const std::vector<MomentumSGDTensor>& tensors,
+      const std::vector<TIndex>& sizes) const {
+    if (sizes != sizes_) {
+      return true;
+    }
+    for (int i = 0; i < num_tensors_; ++i) {
+      if (tensors[i].grad != tensors_[i].grad ||
+          tensors[i].momentum != tensors_[i].momentum ||
+          tensors[i].param != tensors_[i].param) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Packs the tensors and their chunks into one table on the device. The
+  // blobs keep their memory from one iteration to the next, so the table is
+  // only copied again when a blob is reallocated.
+  void BuildTable(
+      const std::vector<MomentumSGDTensor>& tensors,
+      const std::vector<TIndex>& sizes) {
+    tensors_ = tensors;
+    sizes_ = sizes;
+    std::vector<MomentumSGDChunk> chunks;
+    for (int i = 0; i < num_tensors_; ++i) {
+      for (TIndex begin = 0; begin < sizes[i];
+           begin += kMomentumSGDChunkSize) {
+        const TIndex end = std::min(begin + kMomentumSGDChunkSize, sizes[i]);
+        chunks.push_back({i, static_cast<int>(begin), static_cast<int>(end)});
+      }
+    }
+    num_chunks_ = chunks.size();
+    const size_t tensor_bytes = tensors.size() * sizeof(MomentumSGDTensor);
+    const size_t chunk_bytes = chunks.size() * sizeof(MomentumSGDChunk);
+    host_table_.Resize(tensor_bytes + chunk_bytes);
+    char* host = host_table_.template mutable_data<char>();
+    memcpy(host, tensors.data(), tensor_bytes);
+    memcpy(host + tensor_bytes, chunks.data(), chunk_bytes);
+    table_.CopyFrom(host_table_, &context_);
+  }
+
+  float momentum_;
+  bool nesterov_;
+  // scales the gradients before the weight decay, e.g. to undo a loss scale
+  float grad_scale_;
+  // the weight decay of every group, and the group of every tensor
+  std::vector<float> weight_decay_;
+  std::vector<int> groups_;
+  int num_tensors_;
+  // the tensors of the table, to see when a blob is reallocated
+  std::vector<MomentumSGDTensor> tensors_;
+  std::vector<TIndex> sizes_;
+  int num_chunks_ = 0;
+  // the tensors followed by the chunks. host_table_ outlives the copy of
+  // the table, which may be asynchronous from pinned memory.
+  TensorCPU host_table_;
+  Tensor<Context> table_;
+  INPUT_TAGS(LR);
+};
+
+} // namespace caffe2
@@ -0,0 +1,56 @@
+#include "caffe2/core/common_gpu.h"
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/sgd/multi_tensor_momentum_sgd_op.h"
+
+namespace caffe2 {
+
+__global__ void MultiTensorMomentumSGDKernel(
+    const MomentumSGDTensor* tensors,
+    const MomentumSGDChunk* chunks,
+    const float* lr,
+    const float momentum,
+    const bool nesterov,
+    const float grad_scale) {
+  const MomentumSGDChunk chunk = chunks[blockIdx.x];
+  const MomentumSGDTensor t = tensors[chunk.tensor];
+  const float LR = lr[0];
+  for (int i = chunk.begin + threadIdx.x; i < chunk.end; i += blockDim.x) {
+    const float g = grad_scale * t.grad[i] + t.weight_decay * t.param[i];
+    const float mi = t.momentum[i];
+    float adjusted_gradient;
+    if (!nesterov) {
+      adjusted_gradient = LR * g + momentum * mi;
+      t.momentum[i] = adjusted_gradient;
+    } else {
+      const float mi_new = momentum * mi + LR * g;
+      t.momentum[i] = mi_new;
+      adjusted_gradient = (1 + momentum) * mi_new - momentum * mi;
+    }
+    t.grad[i] = adjusted_gradient;
+    t.param[i] -= adjusted_gradient;
+  }
+}
+
+template <>
+void multi_tensor_momentum_sgd_update<CUDAContext>(
+    const int num_chunks,
+    const MomentumSGDTensor* tensors,
+    const MomentumSGDChunk* chunks,
+    const float* lr,
+    const float momentum,
+    const bool nesterov,
+    const float grad_scale,
+    CUDAContext* context) {
+  MultiTensorMomentumSGDKernel<<<
+      num_chunks,
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(
+      tensors, chunks, lr, momentum, nesterov, grad_scale);
+}
+
+REGISTER_CUDA_OPERATOR(
+    MultiTensorMomentumSGDUpdate,
+    MultiTensorMomentumSGDUpdateOp<float, CUDAContext>);
+
+} // namespace caffe2
@@ -0,0 +1,182 @@
+#include "caffe2/transforms/fold_affine_transform.h"
+
+#include <cmath>
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/tensor.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+using transform::Graph;
+
+namespace {
+
+// the CPU tensor of blob name, or null
+const TensorCPU* GetCPUTensor(Workspace* ws, const string& name) {
+  if (!ws->HasBlob(name)) {
+    return nullptr;
+  }
+  const Blob* blob = ws->GetBlob(name);
+  if (!blob->IsType<TensorCPU>()) {
+    return nullptr;
+  }
+  const auto& tensor = blob->Get<TensorCPU>();
+  if (!tensor.IsType<float>()) {
+    return nullptr;
+  }
+  return &tensor;
+}
+
+bool IsNCHW(const OperatorDef& op) {
+  return ArgumentHelper(op).GetSingleArgument<string>("order", "NCHW") ==
+      "NCHW";
+}
+
+} // namespace
+
+bool FoldAffineTransform::PatternRule(
+    const Graph& g,
+    const std::vector<int>& subgraph,
+    int idx) {
+  const OperatorDef& op = g.node(idx).op;
+  if (subgraph.size() == 0) {
+    return op.type() == "Conv" && IsNCHW(op) && op.output_size() == 1 &&
+        (op.input_size() == 2 || op.input_size() == 3);
+  }
+  if (subgraph.size() != 1) {
+    return false;
+  }
+  const transform::Node& conv = g.node(subgraph[0]);
+  const string& conv_out = conv.op.output(0);
+  // the affine op must be the only reader of the conv output
+  if (conv.children.size() != 1 || conv.children.count(idx) == 0 ||
+      g.external_output().count(conv_out) || op.input(0) != conv_out ||
+      op.output_size() != 1 || !IsNCHW(op)) {
+    return false;
+  }
+  for (int i = 1; i < op.input_size(); ++i) {
+    if (op.input(i) == conv_out) {
+      return false;
+    }
+  }
+  if (op.type() == "AffineNd") {
+    return op.input_size() == 3;
+  }
+  if (op.type() == "SpatialBN") {
+    return op.input_size() == 5 &&
+        ArgumentHelper(op).GetSingleArgument<int>(OpSchema::Arg_IsTest, 0);
+  }
+  return false;
+}
+
+bool FoldAffineTransform::ValidatorRule(
+    const Graph& g,
+    const std::vector<int>& subgraph) {
+  if (subgraph.size() != 2 || !ws_) {
+    return false;
+  }
+  const OperatorDef& conv = g.node(subgraph[0]).op;
+  const TensorCPU* W = GetCPUTensor(ws_, conv.input(1));
+  if (!W || W->ndim() < 1) {
+    return false;
+  }
+  if (conv.input_size() == 3) {
+    const TensorCPU* b = GetCPUTensor(ws_, conv.input(2));
+    if (!b || b->size() != W->dim(0)) {
+      return false;
+    }
+  }
+  std::vector<float> scale, shift;
+  return GetScaleShift(g.node(subgraph[1]).op, W->dim(0), &scale, &shift);
+}
+
+bool FoldAffineTransform::GetScaleShift(
+    const OperatorDef& op,
+    int M,
+    std::vector<float>* scale,
+    std::vector<float>* shift) {
+  std::vector<const TensorCPU*> params;
+  for (int i = 1; i < op.input_size(); ++i) {
+    const TensorCPU* param = GetCPUTensor(ws_, op.input(i));
+    if (!param || param->size() != M) {
+      return false;
+    }
+    params.push_back(param);
+  }
+  const float* s = params[0]->data<float>();
+  const float* t = params[1]->data<float>();
+  scale->assign(s, s + M);
+  shift->assign(t, t + M);
+  if (op.type() == "SpatialBN") {
+    const float epsilon =
+        ArgumentHelper(op).GetSingleArgument<float>("epsilon", 1e-5f);
+    const float* mean = params[2]->data<float>();
+    const float* var = params[3]->data<float>();
+    for (int m = 0; m < M; ++m) {
+      (*scale)[m] /= std::sqrt(var[m] + epsilon);
+      (*shift)[m] -= mean[m] * (*scale)[m];
+    }
+  }
+  return true;
+}
+
+bool FoldAffineTransform::ReplaceRule(
+    const std::vector<int>& subgraph,
+    Graph* g_ptr) {
+  CHECK(g_ptr);
+  auto& g = *g_ptr;
+  const int conv_idx = subgraph[0];
+  const int affine_idx = subgraph[1];
+  OperatorDef& conv = g.node(conv_idx).op;
+  const OperatorDef affine = g.node(affine_idx).op;
+
+  const TensorCPU& W = *GetCPUTensor(ws_, conv.input(1));
+  const int M = W.dim(0);
+  const int per_channel = W.size() / M;
+  std::vector<float> scale, shift;
+  CAFFE_ENFORCE(GetScaleShift(affine, M, &scale, &shift));
+
+  const string& out = affine.output(0);
+  auto* W_folded = ws_->CreateBlob(out + "_fold_w")->GetMutable<TensorCPU>();
+  W_folded->ResizeLike(W);
+  const float* W_data = W.data<float>();
+  float* W_folded_data = W_folded->mutable_data<float>();
+  for (int m = 0; m < M; ++m) {
+    for (int k = 0; k < per_channel; ++k) {
+      W_folded_data[m * per_channel + k] =
+          W_data[m * per_channel + k] * scale[m];
+    }
+  }
+  auto* b_folded = ws_->CreateBlob(out + "_fold_b")->GetMutable<TensorCPU>();
+  b_folded->Resize(M);
+  float* b_folded_data = b_folded->mutable_data<float>();
+  const float* b_data = conv.input_size() == 3
+      ? GetCPUTensor(ws_, conv.input(2))->data<float>()
+      : nullptr;
+  for (int m = 0; m < M; ++m) {
+    b_folded_data[m] = (b_data ? b_data[m] * scale[m] : 0.f) + shift[m];
+  }
+
+  conv.set_input(1, out + "_fold_w");
+  if (conv.input_size() == 3) {
+    conv.set_input(2, out + "_fold_b");
+  } else {
+    conv.add_input(out + "_fold_b");
+  }
+  conv.set_output(0, out);
+
+  // the conv takes over the readers of the affine op
+  const auto children = g.node(affine_idx).children;
+  g.DeactivateSubgraph({affine_idx});
+  for (const auto& child : children) {
+    g.node(conv_idx).children[child.first] = child.second;
+    g.node(child.first).parents[conv_idx] = child.second;
+  }
+  return true;
+}
+
+REGISTER_TRANSFORM(FoldAffineIntoConv, FoldAffineTransform);
+
+} // namespace caffe2
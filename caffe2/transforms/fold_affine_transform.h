@@ -0,0 +1,49 @@
+#pragma once
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/transform.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+/**
+ * Fold Affine Into Conv
+ *
+ * Matches a Conv (NCHW) whose only reader is a per-channel affine op, that
+ * is AffineNd(X, scale, bias) or SpatialBN with is_test = 1, and folds the
+ * affine op into the weights and bias of the conv:
+ *
+ *   W'[m] = W[m] * s[m],  b'[m] = b[m] * s[m] + t[m]
+ *
+ * with s = scale, t = bias for AffineNd and s = scale / sqrt(var + epsilon),
+ * t = bias - mean * s for SpatialBN. The folded parameters are written to
+ * new blobs of the workspace (the original ones may be shared), named after
+ * the output of the affine op, which the conv now writes to.
+ *
+ * The parameters are read from the workspace given by SetWorkspace() and
+ * must be CPU tensors; without a workspace nothing is matched.
+ */
+class FoldAffineTransform : public Transform {
+ protected:
+  bool PatternRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph,
+      int idx) override;
+  bool ValidatorRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph) override;
+  bool ReplaceRule(const std::vector<int>& subgraph, transform::Graph* g_ptr)
+      override;
+
+ private:
+  // the per-channel scale and shift of the affine op, if its parameters are
+  // there and fit the M channels of the conv
+  bool GetScaleShift(
+      const OperatorDef& op,
+      int M,
+      std::vector<float>* scale,
+      std::vector<float>* shift);
+};
+
+} // namespace caffe2
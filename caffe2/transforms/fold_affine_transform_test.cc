@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/transforms/fold_affine_transform.h"
+
+namespace caffe2 {
+
+namespace {
+
+using transform::Graph;
+
+void AddTensor(
+    Workspace* ws,
+    const string& name,
+    const std::vector<TIndex>& dims,
+    const std::vector<float>& values) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  CHECK_EQ(tensor->size(), values.size());
+  std::copy(values.begin(), values.end(), tensor->mutable_data<float>());
+}
+
+const float* GetData(Workspace* ws, const string& name) {
+  return ws->GetBlob(name)->Get<TensorCPU>().data<float>();
+}
+
+TEST(FoldAffineTest, TestAffineNd) {
+  Workspace ws;
+  // two output channels with two weights each
+  AddTensor(&ws, "W", {2, 1, 1, 2}, {1, 2, 3, 4});
+  AddTensor(&ws, "b", {2}, {1, -1});
+  AddTensor(&ws, "scale", {2}, {2, 0.5});
+  AddTensor(&ws, "bias", {2}, {3, 4});
+
+  NetDef netdef;
+  AddOp(&netdef, "Conv", {"in", "W", "b"}, {"conv"});
+  AddOp(&netdef, "AffineNd", {"conv", "scale", "bias"}, {"affine"});
+  AddOp(&netdef, "Relu", {"affine"}, {"out"});
+
+  auto t = TransformRegistry()->Create("FoldAffineIntoConv");
+  t->SetWorkspace(&ws);
+  NetDef transformed_netdef = t->ApplyTo(netdef);
+
+  EXPECT_EQ(transformed_netdef.op_size(), 2);
+  const auto& conv = transformed_netdef.op(0);
+  EXPECT_EQ(conv.type(), "Conv");
+  EXPECT_EQ(conv.input(0), "in");
+  EXPECT_EQ(conv.output(0), "affine");
+  EXPECT_EQ(transformed_netdef.op(1).input(0), "affine");
+
+  const float* W = GetData(&ws, conv.input(1));
+  const float* b = GetData(&ws, conv.input(2));
+  const std::vector<float> W_expected = {2, 4, 1.5, 2};
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_FLOAT_EQ(W[i], W_expected[i]);
+  }
+  EXPECT_FLOAT_EQ(b[0], 5);
+  EXPECT_FLOAT_EQ(b[1], 3.5);
+  // the original parameters are left alone
+  EXPECT_FLOAT_EQ(GetData(&ws, "W")[0], 1);
+}
+
+TEST(FoldAffineTest, TestSpatialBNWithoutBias) {
+  Workspace ws;
+  AddTensor(&ws, "W", {2, 1, 1, 1}, {1, 2});
+  AddTensor(&ws, "scale", {2}, {1, 2});
+  AddTensor(&ws, "bias", {2}, {0, 1});
+  AddTensor(&ws, "mean", {2}, {1, 2});
+  AddTensor(&ws, "var", {2}, {4, 16});
+
+  NetDef netdef;
+  AddOp(&netdef, "Conv", {"in", "W"}, {"conv"});
+  auto* bn = AddOp(
+      &netdef, "SpatialBN", {"conv", "scale", "bias", "mean", "var"}, {"bn"});
+  bn->add_arg()->CopyFrom(MakeArgument<int>("is_test", 1));
+  bn->add_arg()->CopyFrom(MakeArgument<float>("epsilon", 0.f));
+
+  auto t = TransformRegistry()->Create("FoldAffineIntoConv");
+  t->SetWorkspace(&ws);
+  NetDef transformed_netdef = t->ApplyTo(netdef);
+
+  EXPECT_EQ(transformed_netdef.op_size(), 1);
+  const auto& conv = transformed_netdef.op(0);
+  EXPECT_EQ(conv.input_size(), 3);
+  EXPECT_EQ(conv.output(0), "bn");
+  const float* W = GetData(&ws, conv.input(1));
+  const float* b = GetData(&ws, conv.input(2));
+  EXPECT_FLOAT_EQ(W[0], 0.5);
+  EXPECT_FLOAT_EQ(W[1], 1);
+  EXPECT_FLOAT_EQ(b[0], -0.5);
+  EXPECT_FLOAT_EQ(b[1], 0);
+}
+
+TEST(FoldAffineTest, TestNoFold) {
+  Workspace ws;
+  AddTensor(&ws, "W", {2, 1, 1, 1}, {1, 2});
+  AddTensor(&ws, "scale", {2}, {1, 2});
+  AddTensor(&ws, "bias", {2}, {0, 1});
+  AddTensor(&ws, "short", {3}, {0, 1, 2});
+
+  NetDef netdef;
+  // the conv output has a second reader
+  AddOp(&netdef, "Conv", {"in", "W"}, {"conv1"});
+  AddOp(&netdef, "AffineNd", {"conv1", "scale", "bias"}, {"affine1"});
+  AddOp(&netdef, "Relu", {"conv1"}, {"relu1"});
+  // training mode batch norm
+  AddOp(&netdef, "Conv", {"in", "W"}, {"conv2"});
+  AddOp(&netdef, "SpatialBN", {"conv2", "scale", "bias", "scale", "bias"},
+        {"bn2"});
+  // parameters that don't fit the conv
+  AddOp(&netdef, "Conv", {"in", "W"}, {"conv3"});
+  AddOp(&netdef, "AffineNd", {"conv3", "short", "short"}, {"affine3"});
+
+  auto t = TransformRegistry()->Create("FoldAffineIntoConv");
+  EXPECT_EQ(t->ApplyTo(netdef).op_size(), 7); // no workspace, no match
+  t->SetWorkspace(&ws);
+  EXPECT_EQ(t->ApplyTo(netdef).op_size(), 7);
+}
+
+} // namespace
+
+} // namespace caffe2
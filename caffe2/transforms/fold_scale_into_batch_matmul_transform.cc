@@ -0,0 +1,77 @@
+#include "caffe2/transforms/fold_scale_into_batch_matmul_transform.h"
+
+#include "caffe2/core/common.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+using transform::Graph;
+
+bool FoldScaleIntoBatchMatMulTransform::PatternRule(
+    const Graph& g,
+    const std::vector<int>& subgraph,
+    int idx) {
+  const OperatorDef& op = g.node(idx).op;
+  if (subgraph.size() == 0) {
+    return op.type() == "BatchMatMul" && op.output_size() == 1;
+  }
+  if (subgraph.size() != 1) {
+    return false;
+  }
+  const transform::Node& matmul = g.node(subgraph[0]);
+  const string& matmul_out = matmul.op.output(0);
+  // the Scale must be the only reader of the product (an external output
+  // written in place by the Scale is its own)
+  return op.type() == "Scale" && op.input_size() == 1 &&
+      op.output_size() == 1 && op.input(0) == matmul_out &&
+      matmul.children.size() == 1 && matmul.children.count(idx) &&
+      (op.output(0) == matmul_out || !g.external_output().count(matmul_out));
+}
+
+bool FoldScaleIntoBatchMatMulTransform::ValidatorRule(
+    const Graph& g,
+    const std::vector<int>& subgraph) {
+  if (subgraph.size() != 2) {
+    return false;
+  }
+  const OperatorDef& matmul = g.node(subgraph[0]).op;
+  const OperatorDef& scale = g.node(subgraph[1]).op;
+  // the product can not be written over one of its operands
+  return matmul.input(0) != scale.output(0) &&
+      matmul.input(1) != scale.output(0);
+}
+
+bool FoldScaleIntoBatchMatMulTransform::ReplaceRule(
+    const std::vector<int>& subgraph,
+    Graph* g_ptr) {
+  CHECK(g_ptr);
+  auto& g = *g_ptr;
+  const int matmul_idx = subgraph[0];
+  const int scale_idx = subgraph[1];
+  OperatorDef& matmul = g.node(matmul_idx).op;
+  const OperatorDef& scale = g.node(scale_idx).op;
+  const float alpha =
+      ArgumentHelper(matmul).GetSingleArgument<float>("alpha", 1.0f) *
+      ArgumentHelper(scale).GetSingleArgument<float>("scale", 1.0f);
+  auto* args = matmul.mutable_arg();
+  for (int i = args->size() - 1; i >= 0; --i) {
+    if (args->Get(i).name() == "alpha") {
+      args->DeleteSubrange(i, 1);
+    }
+  }
+  matmul.add_arg()->CopyFrom(MakeArgument<float>("alpha", alpha));
+  matmul.set_output(0, scale.output(0));
+
+  // the BatchMatMul takes over the readers of the Scale
+  const auto children = g.node(scale_idx).children;
+  g.DeactivateSubgraph({scale_idx});
+  for (const auto& child : children) {
+    g.node(matmul_idx).children[child.first] = child.second;
+    g.node(child.first).parents[matmul_idx] = child.second;
+  }
+  return true;
+}
+
+REGISTER_TRANSFORM(FoldScaleIntoBatchMatMul, FoldScaleIntoBatchMatMulTransform);
+
+} // namespace caffe2
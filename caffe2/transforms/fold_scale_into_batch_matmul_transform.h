@@ -0,0 +1,32 @@
+#pragma once
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/transform.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+/**
+ * Fold Scale Into BatchMatMul
+ *
+ * Matches a BatchMatMul whose only reader is a Scale of its output, e.g. the
+ * affinity theta' * phi of a non-local block scaled by dim_inner^-0.5
+ * before its softmax, and folds the scale into the alpha of the GEMMs of
+ * the BatchMatMul, which then writes to the output of the Scale. This saves
+ * a pass over the (THW) x (THW) affinity of every non-local block.
+ */
+class FoldScaleIntoBatchMatMulTransform : public Transform {
+ protected:
+  bool PatternRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph,
+      int idx) override;
+  bool ValidatorRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph) override;
+  bool ReplaceRule(const std::vector<int>& subgraph, transform::Graph* g_ptr)
+      override;
+};
+
+} // namespace caffe2
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/transforms/fold_scale_into_batch_matmul_transform.h"
+
+namespace caffe2 {
+
+namespace {
+
+using transform::Graph;
+
+TEST(FoldScaleIntoBatchMatMulTest, TestAffinity) {
+  NetDef netdef;
+  auto* matmul =
+      AddOp(&netdef, "BatchMatMul", {"theta", "phi"}, {"affinity"});
+  matmul->add_arg()->CopyFrom(MakeArgument<int>("trans_a", 1));
+  AddOp(&netdef, "Scale", {"affinity"}, {"affinity"}) // in place
+      ->add_arg()
+      ->CopyFrom(MakeArgument<float>("scale", 0.25f));
+  AddOp(&netdef, "Softmax", {"affinity"}, {"prob"});
+
+  auto t = TransformRegistry()->Create("FoldScaleIntoBatchMatMul");
+  NetDef transformed_netdef = t->ApplyTo(netdef);
+
+  EXPECT_EQ(transformed_netdef.op_size(), 2);
+  const auto& folded = transformed_netdef.op(0);
+  EXPECT_EQ(folded.type(), "BatchMatMul");
+  EXPECT_EQ(folded.output(0), "affinity");
+  ArgumentHelper args(folded);
+  EXPECT_EQ(args.GetSingleArgument<int>("trans_a", 0), 1);
+  EXPECT_FLOAT_EQ(args.GetSingleArgument<float>("alpha", 1), 0.25f);
+  EXPECT_EQ(transformed_netdef.op(1).input(0), "affinity");
+}
+
+TEST(FoldScaleIntoBatchMatMulTest, TestAlpha) {
+  NetDef netdef;
+  AddOp(&netdef, "BatchMatMul", {"a", "b"}, {"ab"})
+      ->add_arg()
+      ->CopyFrom(MakeArgument<float>("alpha", 3.f));
+  AddOp(&netdef, "Scale", {"ab"}, {"out"})
+      ->add_arg()
+      ->CopyFrom(MakeArgument<float>("scale", 0.5f));
+
+  NetDef transformed_netdef = ApplyTransform("FoldScaleIntoBatchMatMul", netdef);
+
+  EXPECT_EQ(transformed_netdef.op_size(), 1);
+  const auto& folded = transformed_netdef.op(0);
+  EXPECT_EQ(folded.output(0), "out");
+  EXPECT_EQ(folded.arg_size(), 1);
+  EXPECT_FLOAT_EQ(
+      ArgumentHelper(folded).GetSingleArgument<float>("alpha", 1), 1.5f);
+}
+
+TEST(FoldScaleIntoBatchMatMulTest, TestNoFold) {
+  NetDef netdef;
+  // the product has a second reader
+  AddOp(&netdef, "BatchMatMul", {"a", "b"}, {"ab1"});
+  AddOp(&netdef, "Scale", {"ab1"}, {"scaled1"});
+  AddOp(&netdef, "Copy", {"ab1"}, {"copy1"});
+  // the scale writes over an operand
+  AddOp(&netdef, "BatchMatMul", {"a", "b"}, {"ab2"});
+  AddOp(&netdef, "Scale", {"ab2"}, {"a"});
+
+  auto t = TransformRegistry()->Create("FoldScaleIntoBatchMatMul");
+  EXPECT_EQ(t->ApplyTo(netdef).op_size(), 5);
+}
+
+} // namespace
+
+} // namespace caffe2
@@ -0,0 +1,73 @@
+#include "caffe2/transforms/fuse_conv_relu_transform.h"
+
+#include "caffe2/core/common.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+using transform::Graph;
+
+bool FuseConvReluTransform::PatternRule(
+    const Graph& g,
+    const std::vector<int>& subgraph,
+    int idx) {
+  const OperatorDef& op = g.node(idx).op;
+  if (subgraph.size() == 0) {
+    return op.type() == "Conv" && op.output_size() == 1 &&
+        op.device_option().device_type() == CPU &&
+        (!op.has_engine() || op.engine().empty());
+  }
+  if (subgraph.size() != 1) {
+    return false;
+  }
+  const transform::Node& conv = g.node(subgraph[0]);
+  const string& conv_out = conv.op.output(0);
+  // the Relu must be the only reader of the conv (an external output
+  // written in place by the Relu is its own)
+  return op.type() == "Relu" && op.input_size() == 1 &&
+      op.output_size() == 1 && op.input(0) == conv_out &&
+      conv.children.size() == 1 && conv.children.count(idx) &&
+      (op.output(0) == conv_out || !g.external_output().count(conv_out));
+}
+
+bool FuseConvReluTransform::ValidatorRule(
+    const Graph& g,
+    const std::vector<int>& subgraph) {
+  if (subgraph.size() != 2) {
+    return false;
+  }
+  const OperatorDef& conv = g.node(subgraph[0]).op;
+  const OperatorDef& relu = g.node(subgraph[1]).op;
+  // the conv can not write over one of its inputs
+  for (const auto& input : conv.input()) {
+    if (input == relu.output(0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FuseConvReluTransform::ReplaceRule(
+    const std::vector<int>& subgraph,
+    Graph* g_ptr) {
+  CHECK(g_ptr);
+  auto& g = *g_ptr;
+  const int conv_idx = subgraph[0];
+  const int relu_idx = subgraph[1];
+  OperatorDef& conv = g.node(conv_idx).op;
+  conv.set_type("ConvRelu");
+  conv.set_output(0, g.node(relu_idx).op.output(0));
+
+  // the ConvRelu takes over the readers of the Relu
+  const auto children = g.node(relu_idx).children;
+  g.DeactivateSubgraph({relu_idx});
+  for (const auto& child : children) {
+    g.node(conv_idx).children[child.first] = child.second;
+    g.node(child.first).parents[conv_idx] = child.second;
+  }
+  return true;
+}
+
+REGISTER_TRANSFORM(FuseConvRelu, FuseConvReluTransform);
+
+} // namespace caffe2
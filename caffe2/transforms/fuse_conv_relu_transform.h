@@ -0,0 +1,33 @@
+#pragma once
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/transform.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+/**
+ * Fuse Conv Relu
+ *
+ * Rewrites a CPU Conv of the default engine whose only reader is a Relu of
+ * its output into one ConvRelu op, writing to the output of the Relu, which
+ * rectifies every image right after its GEMMs. Run it after
+ * FoldAffineIntoConv, which leaves the Conv right before the Relu of a
+ * Conv + BN + Relu. Convs of other devices and engines, which have no
+ * ConvRelu, are left alone.
+ */
+class FuseConvReluTransform : public Transform {
+ protected:
+  bool PatternRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph,
+      int idx) override;
+  bool ValidatorRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph) override;
+  bool ReplaceRule(const std::vector<int>& subgraph, transform::Graph* g_ptr)
+      override;
+};
+
+} // namespace caffe2
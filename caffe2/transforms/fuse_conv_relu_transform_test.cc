@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/transforms/fuse_conv_relu_transform.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+namespace {
+
+using transform::Graph;
+
+void AddRandomTensor(
+    Workspace* ws,
+    const string& name,
+    const std::vector<TIndex>& dims,
+    CPUContext* context) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  math::RandUniform<float, CPUContext>(
+      tensor->size(), -1, 1, tensor->mutable_data<float>(), context);
+}
+
+TEST(FuseConvReluTest, TestFuse) {
+  NetDef netdef;
+  AddOp(&netdef, "Conv", {"in", "W", "b"}, {"conv1"});
+  AddOp(&netdef, "Relu", {"conv1"}, {"conv1"}); // in place
+  AddOp(&netdef, "Conv", {"conv1", "W"}, {"conv2"});
+  AddOp(&netdef, "Relu", {"conv2"}, {"out"});
+
+  auto t = TransformRegistry()->Create("FuseConvRelu");
+  EXPECT_EQ(t->PatternMatch(Graph(netdef)).size(), 2);
+  NetDef transformed_netdef = t->ApplyTo(netdef);
+
+  EXPECT_EQ(transformed_netdef.op_size(), 2);
+  const auto& fused1 = transformed_netdef.op(0);
+  EXPECT_EQ(fused1.type(), "ConvRelu");
+  EXPECT_EQ(fused1.input_size(), 3);
+  EXPECT_EQ(fused1.output(0), "conv1");
+  const auto& fused2 = transformed_netdef.op(1);
+  EXPECT_EQ(fused2.type(), "ConvRelu");
+  EXPECT_EQ(fused2.input(0), "conv1");
+  EXPECT_EQ(fused2.output(0), "out");
+}
+
+TEST(FuseConvReluTest, TestNoFuse) {
+  NetDef netdef;
+  // the conv has a second reader
+  AddOp(&netdef, "Conv", {"in", "W"}, {"conv1"});
+  AddOp(&netdef, "Relu", {"conv1"}, {"relu1"});
+  AddOp(&netdef, "Copy", {"conv1"}, {"copy1"});
+  // another engine
+  AddOp(&netdef, "Conv", {"in", "W"}, {"conv2"})->set_engine("NNPACK");
+  AddOp(&netdef, "Relu", {"conv2"}, {"relu2"});
+  // another device
+  AddOp(&netdef, "Conv", {"in", "W"}, {"conv3"})
+      ->mutable_device_option()
+      ->set_device_type(CUDA);
+  AddOp(&netdef, "Relu", {"conv3"}, {"relu3"});
+  // the relu writes over the filter
+  AddOp(&netdef, "Conv", {"in", "W"}, {"conv4"});
+  AddOp(&netdef, "Relu", {"conv4"}, {"W"});
+
+  auto t = TransformRegistry()->Create("FuseConvRelu");
+  EXPECT_EQ(t->ApplyTo(netdef).op_size(), 9);
+}
+
+TEST(FuseConvReluTest, TestSameOutput) {
+  DeviceOption option;
+  option.set_random_seed(1701);
+  CPUContext context(option);
+  Workspace ws;
+  AddRandomTensor(&ws, "in", {2, 3, 4, 5, 5}, &context);
+  AddRandomTensor(&ws, "W3", {4, 3, 3, 3, 3}, &context);
+  AddRandomTensor(&ws, "W1", {4, 4, 1, 1, 1}, &context);
+  AddRandomTensor(&ws, "b", {4}, &context);
+
+  NetDef netdef;
+  netdef.set_name("convs");
+  // the im2col path and the 1x1x1 path
+  auto* conv = AddOp(&netdef, "Conv", {"in", "W3", "b"}, {"conv1"});
+  conv->add_arg()->CopyFrom(MakeArgument<vector<int>>("kernels", {3, 3, 3}));
+  conv->add_arg()->CopyFrom(
+      MakeArgument<vector<int>>("pads", {1, 1, 1, 1, 1, 1}));
+  AddOp(&netdef, "Relu", {"conv1"}, {"relu1"});
+  conv = AddOp(&netdef, "Conv", {"relu1", "W1", "b"}, {"conv2"});
+  conv->add_arg()->CopyFrom(MakeArgument<vector<int>>("kernels", {1, 1, 1}));
+  AddOp(&netdef, "Relu", {"conv2"}, {"relu2"});
+
+  ASSERT_TRUE(ws.RunNetOnce(netdef));
+  TensorCPU expected(ws.GetBlob("relu2")->Get<TensorCPU>());
+  NetDef transformed_netdef = ApplyTransform("FuseConvRelu", netdef);
+  ASSERT_EQ(transformed_netdef.op_size(), 2);
+  ws.RemoveBlob("relu2");
+  ASSERT_TRUE(ws.RunNetOnce(transformed_netdef));
+  const auto& fused = ws.GetBlob("relu2")->Get<TensorCPU>();
+  ASSERT_EQ(fused.dims(), expected.dims());
+  for (int i = 0; i < fused.size(); ++i) {
+    EXPECT_EQ(fused.data<float>()[i], expected.data<float>()[i]);
+  }
+}
+
+} // namespace
+
+} // namespace caffe2
@@ -0,0 +1,236 @@
+#include "caffe2/transforms/fuse_pointwise_transform.h"
+
+#include <algorithm>
+#include <map>
+
+#include "caffe2/core/common.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+using transform::Graph;
+
+namespace {
+
+bool IsPointwise(const OperatorDef& op) {
+  if (op.output_size() != 1 || op.device_option().device_type() != CUDA) {
+    return false;
+  }
+  ArgumentHelper args(op);
+  if (op.type() == "Relu" || op.type() == "Scale" ||
+      op.type() == "StopGradient") {
+    return op.input_size() == 1;
+  }
+  if (PointwiseProgram::IsBinary(op.type())) {
+    return op.input_size() == 2 &&
+        args.GetSingleArgument<string>("axis_str", "").empty();
+  }
+  if (op.type() == "Sum") {
+    return op.input_size() >= 1;
+  }
+  if (op.type() == "AffineNd") {
+    return op.input_size() == 3 &&
+        args.GetSingleArgument<string>("order", "NCHW") == "NCHW";
+  }
+  return false;
+}
+
+// Whether input i of op is broadcast, and from which axis.
+bool IsBroadcast(const OperatorDef& op, const int i, int* axis) {
+  ArgumentHelper args(op);
+  if (op.type() == "AffineNd") {
+    *axis = 1;
+    return i > 0;
+  }
+  if (PointwiseProgram::IsBinary(op.type()) &&
+      args.GetSingleArgument<int>("broadcast", 0)) {
+    *axis = args.GetSingleArgument<int>("axis", -1);
+    return i == 1;
+  }
+  return false;
+}
+
+// Builds the program of a chain of ops and the blobs of its inputs; false
+// when the chain cannot be fused.
+bool BuildProgram(
+    const Graph& g,
+    const std::vector<int>& subgraph,
+    PointwiseProgram* program,
+    std::vector<string>* inputs) {
+  // the inputs first, as the program takes them
+  std::map<string, int> values;
+  for (size_t j = 0; j < subgraph.size(); ++j) {
+    const OperatorDef& op = g.node(subgraph[j]).op;
+    for (int i = 0; i < op.input_size(); ++i) {
+      int axis = 0;
+      const bool broadcast = IsBroadcast(op, i, &axis);
+      if (j > 0 && op.input(i) == g.node(subgraph[j - 1]).op.output(0)) {
+        // the value of the chain is of the output shape
+        if (broadcast) {
+          return false;
+        }
+        continue;
+      }
+      const auto it = values.find(op.input(i));
+      if (it != values.end()) {
+        // a blob can only be read one way
+        if (program->broadcast(it->second) != broadcast ||
+            (broadcast && program->axis(it->second) != axis)) {
+          return false;
+        }
+        continue;
+      }
+      values[op.input(i)] = program->AddInput(broadcast, axis);
+      inputs->push_back(op.input(i));
+    }
+  }
+
+  int value = -1;
+  for (size_t j = 0; j < subgraph.size(); ++j) {
+    const OperatorDef& op = g.node(subgraph[j]).op;
+    std::vector<int> in;
+    for (int i = 0; i < op.input_size(); ++i) {
+      const bool chained =
+          j > 0 && op.input(i) == g.node(subgraph[j - 1]).op.output(0);
+      in.push_back(chained ? value : values.at(op.input(i)));
+    }
+    if (op.type() == "Sum") {
+      value = in[0];
+      for (size_t i = 1; i < in.size(); ++i) {
+        value = program->AddStep("Add", value, in[i]);
+      }
+      if (in.size() == 1) {
+        value = program->AddStep("Scale", value);
+      }
+    } else if (op.type() == "AffineNd") {
+      // the scale and bias of an AffineNd have no gradient
+      const int scale = program->AddStep("StopGradient", in[1]);
+      const int bias = program->AddStep("StopGradient", in[2]);
+      value = program->AddStep(
+          "Add", program->AddStep("Mul", in[0], scale), bias);
+    } else if (PointwiseProgram::IsBinary(op.type())) {
+      value = program->AddStep(op.type(), in[0], in[1]);
+    } else {
+      value = program->AddStep(
+          op.type(),
+          in[0],
+          -1,
+          ArgumentHelper(op).GetSingleArgument<float>("scale", 1.0));
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+bool FusePointwiseTransform::PatternRule(
+    const Graph& g,
+    const std::vector<int>& subgraph,
+    int idx) {
+  const OperatorDef& op = g.node(idx).op;
+  if (!IsPointwise(op)) {
+    return false;
+  }
+  if (subgraph.size() == 0) {
+    return true;
+  }
+  const transform::Node& last = g.node(subgraph.back());
+  const string& last_out = last.op.output(0);
+  // the op must be the only reader of the chain so far, on the same device
+  return op.device_option().cuda_gpu_id() ==
+      g.node(subgraph[0]).op.device_option().cuda_gpu_id() &&
+      std::find(op.input().begin(), op.input().end(), last_out) !=
+      op.input().end() &&
+      last.children.size() == 1 && last.children.count(idx) &&
+      !g.external_output().count(last_out);
+}
+
+bool FusePointwiseTransform::ValidatorRule(
+    const Graph& g,
+    const std::vector<int>& subgraph) {
+  if (subgraph.size() < 2) {
+    return false;
+  }
+  PointwiseProgram program;
+  std::vector<string> inputs;
+  if (!BuildProgram(g, subgraph, &program, &inputs)) {
+    return false;
+  }
+  // the fused op reads its inputs where the last op of the chain was, so no
+  // op in between may write them
+  const int first = subgraph.front();
+  const int last = subgraph.back();
+  for (int idx = first + 1; idx < last; ++idx) {
+    if (std::find(subgraph.begin(), subgraph.end(), idx) != subgraph.end()) {
+      continue;
+    }
+    for (const auto& output : g.node(idx).op.output()) {
+      if (std::find(inputs.begin(), inputs.end(), output) != inputs.end()) {
+        return false;
+      }
+    }
+  }
+  // and the gradient reads the inputs it computes values from again, so
+  // neither the fused op nor any op after it may write them
+  const auto recomputed = program.ValuesRecomputed();
+  for (int idx = last; idx < static_cast<int>(g.size()); ++idx) {
+    for (const auto& output : g.node(idx).op.output()) {
+      for (int k = 0; k < program.num_inputs(); ++k) {
+        if (recomputed[k] && inputs[k] == output) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool FusePointwiseTransform::ReplaceRule(
+    const std::vector<int>& subgraph,
+    Graph* g_ptr) {
+  CHECK(g_ptr);
+  auto& g = *g_ptr;
+  PointwiseProgram program;
+  std::vector<string> inputs;
+  CAFFE_ENFORCE(BuildProgram(g, subgraph, &program, &inputs));
+
+  // the fused op replaces the last op of the chain
+  const int last = subgraph.back();
+  OperatorDef& op = g.node(last).op;
+  OperatorDef fused;
+  fused.set_type("FusedPointwise");
+  fused.set_engine("NVRTC");
+  if (op.has_name()) {
+    fused.set_name(op.name());
+  }
+  fused.mutable_device_option()->CopyFrom(op.device_option());
+  for (const auto& input : inputs) {
+    fused.add_input(input);
+  }
+  fused.add_output(op.output(0));
+  program.AddArguments(&fused);
+  op = fused;
+
+  // and takes over the writers of the inputs of the ones before it
+  std::map<int, std::vector<string>> parents;
+  for (size_t j = 0; j + 1 < subgraph.size(); ++j) {
+    for (const auto& edge : g.node(subgraph[j]).parents) {
+      if (std::find(subgraph.begin(), subgraph.end(), edge.first) ==
+          subgraph.end()) {
+        auto& blobs = parents[edge.first];
+        blobs.insert(blobs.end(), edge.second.begin(), edge.second.end());
+      }
+    }
+  }
+  g.DeactivateSubgraph(std::vector<int>(subgraph.begin(), subgraph.end() - 1));
+  for (const auto& parent : parents) {
+    auto& blobs = g.node(last).parents[parent.first];
+    blobs.insert(blobs.end(), parent.second.begin(), parent.second.end());
+    g.node(parent.first).children[last] = blobs;
+  }
+  return true;
+}
+
+REGISTER_TRANSFORM(FusePointwise, FusePointwiseTransform);
+
+} // namespace caffe2
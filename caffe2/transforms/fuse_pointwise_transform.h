@@ -0,0 +1,38 @@
+#pragma once
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/transform.h"
+#include "caffe2/cuda_rtc/fused_pointwise.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+/**
+ * Fuse Pointwise
+ *
+ * Rewrites a chain of pointwise CUDA ops, each the only reader of the output
+ * of the one before it, into one FusedPointwise op (engine NVRTC) writing to
+ * the output of the last one, so the values in between are never written to
+ * and read back from memory, e.g. an AffineNd and its Relu. The ops are Add,
+ * Sub, Mul and Div (also with broadcast), Sum, Relu, Scale, StopGradient and
+ * AffineNd in NCHW, all on float.
+ *
+ * A chain is left alone when an op in between writes one of its inputs, when
+ * it would broadcast a value of the chain, or when an input the gradient
+ * computes values from again is written by it or after it.
+ */
+class FusePointwiseTransform : public Transform {
+ protected:
+  bool PatternRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph,
+      int idx) override;
+  bool ValidatorRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph) override;
+  bool ReplaceRule(const std::vector<int>& subgraph, transform::Graph* g_ptr)
+      override;
+};
+
+} // namespace caffe2
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/transforms/fuse_pointwise_transform.h"
+
+namespace caffe2 {
+
+namespace {
+
+using transform::Graph;
+
+OperatorDef* AddCUDAOp(
+    NetDef* netdef,
+    const string& type,
+    std::vector<string> inputs,
+    std::vector<string> outputs) {
+  auto* op = AddOp(netdef, type, inputs, outputs);
+  op->mutable_device_option()->set_device_type(CUDA);
+  return op;
+}
+
+TEST(FusePointwiseTest, TestAffineRelu) {
+  NetDef netdef;
+  AddCUDAOp(&netdef, "Conv", {"in", "w"}, {"conv"});
+  AddCUDAOp(&netdef, "AffineNd", {"conv", "s", "b"}, {"conv"}); // in place
+  AddCUDAOp(&netdef, "Relu", {"conv"}, {"conv"});
+  AddCUDAOp(&netdef, "Conv", {"conv", "w2"}, {"out"});
+
+  auto t = TransformRegistry()->Create("FusePointwise");
+  EXPECT_EQ(t->PatternMatch(Graph(netdef)).size(), 1);
+  NetDef transformed_netdef = t->ApplyTo(netdef);
+
+  EXPECT_EQ(transformed_netdef.op_size(), 3);
+  const auto& fused = transformed_netdef.op(1);
+  EXPECT_EQ(fused.type(), "FusedPointwise");
+  EXPECT_EQ(fused.engine(), "NVRTC");
+  EXPECT_EQ(fused.device_option().device_type(), CUDA);
+  EXPECT_EQ(fused.input_size(), 3);
+  EXPECT_EQ(fused.input(0), "conv");
+  EXPECT_EQ(fused.input(1), "s");
+  EXPECT_EQ(fused.input(2), "b");
+  EXPECT_EQ(fused.output(0), "conv");
+  EXPECT_EQ(transformed_netdef.op(2).type(), "Conv");
+
+  const auto program = PointwiseProgram::FromOperatorDef(fused);
+  EXPECT_TRUE(program.broadcast(1));
+  EXPECT_EQ(program.axis(1), 1);
+  EXPECT_EQ(program.step(program.output()).type, "Relu");
+  // only the data gets a gradient, and the scale is all it needs
+  const auto with_gradient = program.InputsWithGradient();
+  EXPECT_TRUE(with_gradient[0]);
+  EXPECT_FALSE(with_gradient[1]);
+  EXPECT_FALSE(with_gradient[2]);
+  const auto recomputed = program.ValuesRecomputed();
+  EXPECT_FALSE(recomputed[0]);
+  EXPECT_TRUE(recomputed[1]);
+}
+
+TEST(FusePointwiseTest, TestNormalize) {
+  NetDef netdef;
+  AddCUDAOp(&netdef, "ConstantFill", {"ab"}, {"zeros"});
+  auto* add = AddCUDAOp(&netdef, "Add", {"zeros", "ones"}, {"denom"});
+  add->add_arg()->CopyFrom(MakeArgument("broadcast", 1));
+  add->add_arg()->CopyFrom(MakeArgument("axis", 0));
+  AddCUDAOp(&netdef, "StopGradient", {"denom"}, {"denom"});
+  AddCUDAOp(&netdef, "Div", {"ab", "denom"}, {"p"});
+
+  auto t = TransformRegistry()->Create("FusePointwise");
+  NetDef transformed_netdef = t->ApplyTo(netdef);
+
+  EXPECT_EQ(transformed_netdef.op_size(), 2);
+  const auto& fused = transformed_netdef.op(1);
+  EXPECT_EQ(fused.type(), "FusedPointwise");
+  EXPECT_EQ(fused.input(0), "zeros");
+  EXPECT_EQ(fused.input(1), "ones");
+  EXPECT_EQ(fused.input(2), "ab");
+  EXPECT_EQ(fused.output(0), "p");
+  const auto program = PointwiseProgram::FromOperatorDef(fused);
+  EXPECT_EQ(program.steps().size(), 3);
+  EXPECT_EQ(program.axis(1), 0);
+  const auto with_gradient = program.InputsWithGradient();
+  EXPECT_FALSE(with_gradient[0]);
+  EXPECT_FALSE(with_gradient[1]);
+  EXPECT_TRUE(with_gradient[2]);
+}
+
+TEST(FusePointwiseTest, TestNoFuse) {
+  NetDef netdef;
+  // on the CPU
+  AddOp(&netdef, "Sum", {"a", "b"}, {"sum1"});
+  AddOp(&netdef, "Relu", {"sum1"}, {"relu1"});
+  // the sum has a second reader
+  AddCUDAOp(&netdef, "Sum", {"a", "b"}, {"sum2"});
+  AddCUDAOp(&netdef, "Relu", {"sum2"}, {"relu2"});
+  AddCUDAOp(&netdef, "Copy", {"sum2"}, {"copy2"});
+  // the value of the chain would be broadcast
+  AddCUDAOp(&netdef, "Relu", {"a"}, {"relu3"});
+  auto* mul = AddCUDAOp(&netdef, "Mul", {"b", "relu3"}, {"mul3"});
+  mul->add_arg()->CopyFrom(MakeArgument("broadcast", 1));
+  // the gradient of the Mul needs c, which the Relu writes over
+  AddCUDAOp(&netdef, "Mul", {"b", "c"}, {"mul4"});
+  AddCUDAOp(&netdef, "Relu", {"mul4"}, {"c"});
+
+  auto t = TransformRegistry()->Create("FusePointwise");
+  EXPECT_EQ(t->ApplyTo(netdef).op_size(), 9);
+}
+
+} // namespace
+
+} // namespace caffe2
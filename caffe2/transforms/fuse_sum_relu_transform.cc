@@ -0,0 +1,73 @@
+#include "caffe2/transforms/fuse_sum_relu_transform.h"
+
+#include "caffe2/core/common.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/video/sum_relu_op.h"
+
+namespace caffe2 {
+
+using transform::Graph;
+
+bool FuseSumReluTransform::PatternRule(
+    const Graph& g,
+    const std::vector<int>& subgraph,
+    int idx) {
+  const OperatorDef& op = g.node(idx).op;
+  if (subgraph.size() == 0) {
+    return op.type() == "Sum" && op.output_size() == 1 &&
+        op.input_size() <= kSumReluMaxInputs;
+  }
+  if (subgraph.size() != 1) {
+    return false;
+  }
+  const transform::Node& sum = g.node(subgraph[0]);
+  const string& sum_out = sum.op.output(0);
+  // the Relu must be the only reader of the sum (an external output
+  // written in place by the Relu is its own)
+  return op.type() == "Relu" && op.input_size() == 1 &&
+      op.output_size() == 1 && op.input(0) == sum_out &&
+      sum.children.size() == 1 && sum.children.count(idx) &&
+      (op.output(0) == sum_out || !g.external_output().count(sum_out));
+}
+
+bool FuseSumReluTransform::ValidatorRule(
+    const Graph& g,
+    const std::vector<int>& subgraph) {
+  if (subgraph.size() != 2) {
+    return false;
+  }
+  const OperatorDef& sum = g.node(subgraph[0]).op;
+  const OperatorDef& relu = g.node(subgraph[1]).op;
+  // SumRelu only runs in place of its first input
+  for (int i = 1; i < sum.input_size(); ++i) {
+    if (sum.input(i) == relu.output(0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FuseSumReluTransform::ReplaceRule(
+    const std::vector<int>& subgraph,
+    Graph* g_ptr) {
+  CHECK(g_ptr);
+  auto& g = *g_ptr;
+  const int sum_idx = subgraph[0];
+  const int relu_idx = subgraph[1];
+  OperatorDef& sum = g.node(sum_idx).op;
+  sum.set_type("SumRelu");
+  sum.set_output(0, g.node(relu_idx).op.output(0));
+
+  // the SumRelu takes over the readers of the Relu
+  const auto children = g.node(relu_idx).children;
+  g.DeactivateSubgraph({relu_idx});
+  for (const auto& child : children) {
+    g.node(sum_idx).children[child.first] = child.second;
+    g.node(child.first).parents[sum_idx] = child.second;
+  }
+  return true;
+}
+
+REGISTER_TRANSFORM(FuseSumRelu, FuseSumReluTransform);
+
+} // namespace caffe2
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/transform.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+/**
+ * Fuse Sum Relu
+ *
+ * Rewrites a Sum whose only reader is a Relu of its output into one SumRelu
+ * op, writing to the output of the Relu. This saves a pass over the output of
+ * every residual block. Sums with more inputs than the CUDA SumRelu takes,
+ * and Relus that write over one of the later inputs of the Sum, are left
+ * alone.
+ */
+class FuseSumReluTransform : public Transform {
+ protected:
+  bool PatternRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph,
+      int idx) override;
+  bool ValidatorRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph) override;
+  bool ReplaceRule(const std::vector<int>& subgraph, transform::Graph* g_ptr)
+      override;
+};
+
+} // namespace caffe2
@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/transforms/fuse_sum_relu_transform.h"
+
+namespace caffe2 {
+
+namespace {
+
+using transform::Graph;
+
+TEST(FuseSumReluTest, TestResidual) {
+  NetDef netdef;
+  AddOp(&netdef, "Conv", {"in"}, {"branch"});
+  AddOp(&netdef, "Sum", {"branch", "in"}, {"branch"}); // in place
+  AddOp(&netdef, "Relu", {"branch"}, {"branch"});
+  AddOp(&netdef, "Conv", {"branch"}, {"branch2"});
+  AddOp(&netdef, "Sum", {"branch2", "branch"}, {"sum2"});
+  AddOp(&netdef, "Relu", {"sum2"}, {"out"});
+
+  auto t = TransformRegistry()->Create("FuseSumRelu");
+  EXPECT_EQ(t->PatternMatch(Graph(netdef)).size(), 2);
+  NetDef transformed_netdef = t->ApplyTo(netdef);
+
+  EXPECT_EQ(transformed_netdef.op_size(), 4);
+  const auto& fused1 = transformed_netdef.op(1);
+  EXPECT_EQ(fused1.type(), "SumRelu");
+  EXPECT_EQ(fused1.input(0), "branch");
+  EXPECT_EQ(fused1.input(1), "in");
+  EXPECT_EQ(fused1.output(0), "branch");
+  EXPECT_EQ(transformed_netdef.op(2).input(0), "branch");
+  const auto& fused2 = transformed_netdef.op(3);
+  EXPECT_EQ(fused2.type(), "SumRelu");
+  EXPECT_EQ(fused2.output(0), "out");
+}
+
+TEST(FuseSumReluTest, TestNoFuse) {
+  NetDef netdef;
+  // the sum has a second reader
+  AddOp(&netdef, "Sum", {"a", "b"}, {"sum1"});
+  AddOp(&netdef, "Relu", {"sum1"}, {"relu1"});
+  AddOp(&netdef, "Copy", {"sum1"}, {"copy1"});
+  // the relu writes over the second input
+  AddOp(&netdef, "Sum", {"a", "b"}, {"sum2"});
+  AddOp(&netdef, "Relu", {"sum2"}, {"b"});
+  // not a relu of the sum
+  AddOp(&netdef, "Sum", {"a", "c"}, {"sum3"});
+  AddOp(&netdef, "Relu", {"a"}, {"relu3"});
+
+  auto t = TransformRegistry()->Create("FuseSumRelu");
+  EXPECT_EQ(t->ApplyTo(netdef).op_size(), 7);
+}
+
+} // namespace
+
+} // namespace caffe2
@@ -0,0 +1,24 @@
+#include "caffe2/transforms/optimize_video_inference.h"
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/transform.h"
+
+namespace caffe2 {
+
+NetDef OptimizeVideoInference(const NetDef& net, Workspace* ws) {
+  NetDef optimized = net;
+  for (const char* key :
+       {"FoldAffineIntoConv",
+        "FoldScaleIntoBatchMatMul",
+        "SimplifyReshapeTranspose",
+        "FuseSumRelu",
+        "FuseConvRelu"}) {
+    const int before = optimized.op_size();
+    optimized = ApplyTransform(key, optimized, ws);
+    VLOG(1) << key << " removed " << before - optimized.op_size() << " ops of "
+            << net.name();
+  }
+  return optimized;
+}
+
+} // namespace caffe2
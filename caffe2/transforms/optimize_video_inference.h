@@ -0,0 +1,25 @@
+#pragma once
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+/**
+ * Rewrites the test net of a video model (e.g. I3D with non-local blocks)
+ * for inference by the transforms, in order:
+ *
+ *   FoldAffineIntoConv        Conv + AffineNd / test mode SpatialBN
+ *   FoldScaleIntoBatchMatMul  the scaled affinity of the non-local blocks
+ *   SimplifyReshapeTranspose  the Reshape / Transpose sandwiches of the
+ *                             non-local blocks and their temporal groups
+ *   FuseSumRelu               the shortcut Sum + Relu of the residual blocks
+ *   FuseConvRelu              Conv + Relu, on CPU
+ *
+ * The folds read the parameters from ws as CPU tensors and write the folded
+ * ones there; with a null ws nothing is folded.
+ */
+NetDef OptimizeVideoInference(const NetDef& net, Workspace* ws);
+
+} // namespace caffe2
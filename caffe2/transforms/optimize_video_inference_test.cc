@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include "caffe2/core/graph.h"
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/transforms/optimize_video_inference.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+namespace {
+
+void AddRandomTensor(
+    Workspace* ws,
+    const string& name,
+    const std::vector<TIndex>& dims,
+    const float min,
+    const float max,
+    CPUContext* context) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  math::RandUniform<float, CPUContext>(
+      tensor->size(), min, max, tensor->mutable_data<float>(), context);
+}
+
+OperatorDef* AddConv(
+    NetDef* netdef,
+    const std::vector<string>& inputs,
+    const string& output) {
+  auto* op = AddOp(netdef, "Conv", inputs, {output});
+  op->add_arg()->CopyFrom(MakeArgument<vector<int>>("kernels", {1, 1, 1}));
+  return op;
+}
+
+OperatorDef* AddReshape(
+    NetDef* netdef,
+    const std::vector<string>& inputs,
+    const string& output) {
+  auto* op = AddOp(netdef, "Reshape", inputs, {output, output + "_shape"});
+  if (inputs.size() == 1) {
+    op->add_arg()->CopyFrom(MakeArgument<vector<int>>("shape", {1, 2, -1}));
+  }
+  return op;
+}
+
+// a residual block with BN around a non-local block
+NetDef NonLocalBlock() {
+  NetDef netdef;
+  netdef.set_name("nonlocal");
+  AddConv(&netdef, {"data", "w", "b"}, "conv");
+  AddOp(&netdef, "SpatialBN", {"conv", "s", "t", "mean", "var"}, {"bn"})
+      ->add_arg()
+      ->CopyFrom(MakeArgument<int>("is_test", 1));
+  AddOp(&netdef, "Relu", {"bn"}, {"bn"});
+  AddConv(&netdef, {"bn", "w_theta"}, "theta");
+  AddConv(&netdef, {"bn", "w_phi"}, "phi");
+  AddReshape(&netdef, {"theta"}, "theta_re");
+  AddReshape(&netdef, {"phi"}, "phi_re");
+  AddOp(&netdef, "BatchMatMul", {"theta_re", "phi_re"}, {"affinity"})
+      ->add_arg()
+      ->CopyFrom(MakeArgument<int>("trans_a", 1));
+  AddOp(&netdef, "Scale", {"affinity"}, {"affinity"})
+      ->add_arg()
+      ->CopyFrom(MakeArgument<float>("scale", 0.5f));
+  AddOp(&netdef, "Softmax", {"affinity"}, {"prob"})
+      ->add_arg()
+      ->CopyFrom(MakeArgument<int>("axis", 2));
+  AddOp(&netdef, "BatchMatMul", {"phi_re", "prob"}, {"y"})
+      ->add_arg()
+      ->CopyFrom(MakeArgument<int>("trans_b", 1));
+  AddReshape(&netdef, {"y", "theta_re_shape"}, "y_re");
+  AddConv(&netdef, {"y_re", "w_out"}, "out");
+  AddOp(&netdef, "Sum", {"bn", "out"}, {"sum"});
+  AddOp(&netdef, "Relu", {"sum"}, {"sum"});
+  netdef.add_external_output("sum");
+  return netdef;
+}
+
+TEST(OptimizeVideoInferenceTest, TestNonLocalBlock) {
+  DeviceOption option;
+  option.set_random_seed(1701);
+  CPUContext context(option);
+  Workspace ws;
+  AddRandomTensor(&ws, "data", {1, 4, 2, 3, 3}, -1, 1, &context);
+  AddRandomTensor(&ws, "w", {4, 4, 1, 1, 1}, -1, 1, &context);
+  AddRandomTensor(&ws, "b", {4}, -1, 1, &context);
+  for (const string name : {"s", "t", "mean"}) {
+    AddRandomTensor(&ws, name, {4}, -1, 1, &context);
+  }
+  AddRandomTensor(&ws, "var", {4}, 0.5, 1.5, &context);
+  for (const string name : {"w_theta", "w_phi"}) {
+    AddRandomTensor(&ws, name, {2, 4, 1, 1, 1}, -1, 1, &context);
+  }
+  AddRandomTensor(&ws, "w_out", {4, 2, 1, 1, 1}, -1, 1, &context);
+
+  const NetDef netdef = NonLocalBlock();
+  ASSERT_TRUE(ws.RunNetOnce(netdef));
+  TensorCPU expected(ws.GetBlob("sum")->Get<TensorCPU>());
+
+  const NetDef optimized = OptimizeVideoInference(netdef, &ws);
+  std::vector<string> types;
+  for (const auto& op : optimized.op()) {
+    types.push_back(op.type());
+    if (op.type() == "Reshape") {
+      EXPECT_EQ(op.input(0), op.output(0));
+    }
+  }
+  EXPECT_EQ(
+      types,
+      (std::vector<string>{"ConvRelu",
+                           "Conv",
+                           "Conv",
+                           "Reshape",
+                           "Reshape",
+                           "BatchMatMul",
+                           "Softmax",
+                           "BatchMatMul",
+                           "Reshape",
+                           "Conv",
+                           "SumRelu"}));
+
+  ws.RemoveBlob("sum");
+  ASSERT_TRUE(ws.RunNetOnce(optimized));
+  const auto& sum = ws.GetBlob("sum")->Get<TensorCPU>();
+  ASSERT_EQ(sum.dims(), expected.dims());
+  for (int i = 0; i < sum.size(); ++i) {
+    EXPECT_NEAR(sum.data<float>()[i], expected.data<float>()[i], 1e-4);
+  }
+}
+
+} // namespace
+
+} // namespace caffe2
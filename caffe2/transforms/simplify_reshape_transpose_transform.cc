@@ -0,0 +1,152 @@
+#include "caffe2/transforms/simplify_reshape_transpose_transform.h"
+
+#include <algorithm>
+
+#include "caffe2/core/common.h"
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+using transform::Graph;
+
+namespace {
+
+bool Reads(const OperatorDef& op, const string& blob) {
+  return std::find(op.input().begin(), op.input().end(), blob) !=
+      op.input().end();
+}
+
+bool Writes(const OperatorDef& op, const string& blob) {
+  return std::find(op.output().begin(), op.output().end(), blob) !=
+      op.output().end();
+}
+
+std::vector<int> Axes(const OperatorDef& op) {
+  return ArgumentHelper(op).GetRepeatedArgument<int>("axes");
+}
+
+} // namespace
+
+bool SimplifyReshapeTransposeTransform::PatternRule(
+    const Graph& g,
+    const std::vector<int>& subgraph,
+    int idx) {
+  const OperatorDef& op = g.node(idx).op;
+  if (subgraph.size() == 0) {
+    // the producer of the blob read by a Transpose or Reshape, which must
+    // not write it in place
+    for (const auto& output : op.output()) {
+      if (Reads(op, output)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  if (subgraph.size() != 1) {
+    return false;
+  }
+  const transform::Node& producer = g.node(subgraph[0]);
+  if (op.input_size() == 0 || producer.children.size() != 1 ||
+      !producer.children.count(idx) ||
+      g.external_output().count(op.input(0)) ||
+      !Writes(producer.op, op.input(0))) {
+    return false;
+  }
+  // the blob must only be read once, as the data of the op
+  for (int i = 1; i < op.input_size(); ++i) {
+    if (op.input(i) == op.input(0)) {
+      return false;
+    }
+  }
+  if (op.type() == "Transpose") {
+    return producer.op.type() == "Transpose" && op.output_size() == 1;
+  }
+  return op.type() == "Reshape" && op.output(0) != op.input(0);
+}
+
+bool SimplifyReshapeTransposeTransform::ValidatorRule(
+    const Graph& g,
+    const std::vector<int>& subgraph) {
+  if (subgraph.size() != 2) {
+    return false;
+  }
+  const OperatorDef& first = g.node(subgraph[0]).op;
+  const OperatorDef& second = g.node(subgraph[1]).op;
+  if (second.type() == "Transpose") {
+    const auto p = Axes(first);
+    const auto q = Axes(second);
+    return !p.empty() && p.size() == q.size();
+  }
+  // the producer can write the output of the Reshape only if no op between
+  // them reads or writes it
+  const string& reshaped = second.output(0);
+  if (Reads(first, reshaped) || Writes(first, reshaped)) {
+    return false;
+  }
+  for (int i = subgraph[0] + 1; i < subgraph[1]; ++i) {
+    const OperatorDef& op = g.node(i).op;
+    if (Reads(op, reshaped) || Writes(op, reshaped)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SimplifyReshapeTransposeTransform::ReplaceRule(
+    const std::vector<int>& subgraph,
+    Graph* g_ptr) {
+  CHECK(g_ptr);
+  auto& g = *g_ptr;
+  const int first_idx = subgraph[0];
+  const int second_idx = subgraph[1];
+  OperatorDef& first = g.node(first_idx).op;
+  OperatorDef& second = g.node(second_idx).op;
+  const string blob = second.input(0);
+
+  if (second.type() == "Reshape") {
+    for (int i = 0; i < first.output_size(); ++i) {
+      if (first.output(i) == blob) {
+        first.set_output(i, second.output(0));
+      }
+    }
+    second.set_input(0, second.output(0));
+    for (auto& child : g.node(first_idx).children) {
+      for (auto& name : child.second) {
+        name = second.output(0);
+      }
+    }
+    for (auto& name : g.node(second_idx).parents[first_idx]) {
+      name = second.output(0);
+    }
+    return true;
+  }
+
+  // y[i] = x[p[q[i]]] for y = transpose(transpose(x, p), q)
+  const auto p = Axes(first);
+  const auto q = Axes(second);
+  std::vector<int> axes(q.size());
+  for (int i = 0; i < q.size(); ++i) {
+    axes[i] = p[q[i]];
+  }
+  auto* args = first.mutable_arg();
+  for (int i = args->size() - 1; i >= 0; --i) {
+    if (args->Get(i).name() == "axes") {
+      args->DeleteSubrange(i, 1);
+    }
+  }
+  first.add_arg()->CopyFrom(MakeArgument<std::vector<int>>("axes", axes));
+  first.set_output(0, second.output(0));
+
+  // the first Transpose takes over the readers of the second
+  const auto children = g.node(second_idx).children;
+  g.DeactivateSubgraph({second_idx});
+  for (const auto& child : children) {
+    g.node(first_idx).children[child.first] = child.second;
+    g.node(child.first).parents[first_idx] = child.second;
+  }
+  return true;
+}
+
+REGISTER_TRANSFORM(SimplifyReshapeTranspose, SimplifyReshapeTransposeTransform);
+
+} // namespace caffe2
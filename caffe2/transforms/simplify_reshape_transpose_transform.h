@@ -0,0 +1,39 @@
+#pragma once
+
+#include "caffe2/core/common.h"
+#include "caffe2/core/transform.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/utils/proto_utils.h"
+
+namespace caffe2 {
+
+/**
+ * Simplify Reshape Transpose
+ *
+ * Removes the copies of the Reshape and Transpose sandwiches of the
+ * non-local blocks and of the temporal groups around them:
+ *
+ *  - a Transpose whose only reader is another Transpose becomes one
+ *    Transpose by the composed permutation, e.g. the last transpose of a
+ *    group sandwich and the first of the next one;
+ *  - a Reshape that is the only reader of its input, written by the op
+ *    before it, runs in place: the op writes to the output of the Reshape
+ *    right away, so the Reshape only changes the dims instead of copying.
+ *
+ * Ops writing in place, and Transposes by the default (reversed) axes, are
+ * left alone.
+ */
+class SimplifyReshapeTransposeTransform : public Transform {
+ protected:
+  bool PatternRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph,
+      int idx) override;
+  bool ValidatorRule(
+      const transform::Graph& g,
+      const std::vector<int>& subgraph) override;
+  bool ReplaceRule(const std::vector<int>& subgraph, transform::Graph* g_ptr)
+      override;
+};
+
+} // namespace caffe2
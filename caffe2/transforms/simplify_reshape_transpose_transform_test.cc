@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include "caffe2/core/net.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/transforms/simplify_reshape_transpose_transform.h"
+
+namespace caffe2 {
+
+namespace {
+
+using transform::Graph;
+
+OperatorDef* AddTranspose(
+    NetDef* netdef,
+    const string& input,
+    const string& output,
+    const std::vector<int>& axes) {
+  auto* op = AddOp(netdef, "Transpose", {input}, {output});
+  op->add_arg()->CopyFrom(MakeArgument<std::vector<int>>("axes", axes));
+  return op;
+}
+
+OperatorDef* AddReshape(
+    NetDef* netdef,
+    const string& input,
+    const string& output,
+    const std::vector<int>& shape) {
+  auto* op =
+      AddOp(netdef, "Reshape", {input}, {output, output + "_old_shape"});
+  op->add_arg()->CopyFrom(MakeArgument<std::vector<int>>("shape", shape));
+  return op;
+}
+
+// the start of a temporal group sandwich of a non-local block
+TEST(SimplifyReshapeTransposeTest, TestGroupSandwich) {
+  NetDef netdef;
+  AddOp(&netdef, "Relu", {"in"}, {"x"});
+  AddTranspose(&netdef, "x", "x_trans", {0, 2, 1, 3, 4});
+  AddReshape(&netdef, "x_trans", "x_re", {4, 2, 3, 2, 2});
+  AddTranspose(&netdef, "x_re", "x_re_trans", {0, 2, 1, 3, 4});
+  AddTranspose(&netdef, "x_re_trans", "out", {0, 1, 2, 4, 3});
+
+  NetDef transformed_netdef =
+      ApplyTransform("SimplifyReshapeTranspose", netdef);
+
+  ASSERT_EQ(transformed_netdef.op_size(), 4);
+  // the transpose writes the reshaped blob
+  EXPECT_EQ(transformed_netdef.op(1).output(0), "x_re");
+  const auto& reshape = transformed_netdef.op(2);
+  EXPECT_EQ(reshape.type(), "Reshape");
+  EXPECT_EQ(reshape.input(0), "x_re");
+  EXPECT_EQ(reshape.output(0), "x_re");
+  // the two last transposes are one
+  const auto& transpose = transformed_netdef.op(3);
+  EXPECT_EQ(transpose.input(0), "x_re");
+  EXPECT_EQ(transpose.output(0), "out");
+  EXPECT_EQ(
+      ArgumentHelper(transpose).GetRepeatedArgument<int>("axes"),
+      (std::vector<int>{0, 2, 1, 4, 3}));
+}
+
+TEST(SimplifyReshapeTransposeTest, TestSameOutput) {
+  Workspace ws;
+  auto* in = ws.CreateBlob("in")->GetMutable<TensorCPU>();
+  in->Resize(std::vector<TIndex>{2, 3, 4, 2, 2});
+  for (int i = 0; i < in->size(); ++i) {
+    in->mutable_data<float>()[i] = i;
+  }
+  NetDef netdef;
+  netdef.set_name("sandwich");
+  AddTranspose(&netdef, "in", "x_trans", {0, 2, 1, 3, 4});
+  AddReshape(&netdef, "x_trans", "x_re", {4, 2, 3, 2, 2});
+  AddTranspose(&netdef, "x_re", "x_re_trans", {0, 2, 1, 3, 4});
+  AddTranspose(&netdef, "x_re_trans", "out", {1, 0, 2, 4, 3});
+
+  ASSERT_TRUE(ws.RunNetOnce(netdef));
+  TensorCPU expected(ws.GetBlob("out")->Get<TensorCPU>());
+  ws.RemoveBlob("out");
+  ASSERT_TRUE(
+      ws.RunNetOnce(ApplyTransform("SimplifyReshapeTranspose", netdef)));
+  const auto& out = ws.GetBlob("out")->Get<TensorCPU>();
+  ASSERT_EQ(out.dims(), expected.dims());
+  for (int i = 0; i < out.size(); ++i) {
+    EXPECT_EQ(out.data<float>()[i], expected.data<float>()[i]);
+  }
+}
+
+TEST(SimplifyReshapeTransposeTest, TestNoSimplify) {
+  NetDef netdef;
+  // the transpose has a second reader
+  AddTranspose(&netdef, "in", "t1", {1, 0});
+  AddTranspose(&netdef, "t1", "t2", {1, 0});
+  AddOp(&netdef, "Copy", {"t1"}, {"copy1"});
+  // the input of the reshape is written in place
+  AddOp(&netdef, "Relu", {"in"}, {"in"});
+  AddReshape(&netdef, "in", "in_re", {-1});
+  // the reshaped blob is read before the reshape
+  AddOp(&netdef, "Relu", {"a"}, {"b"});
+  AddOp(&netdef, "Copy", {"b_re"}, {"copy2"});
+  AddReshape(&netdef, "b", "b_re", {-1});
+  // the data is also the shape
+  AddOp(&netdef, "Relu", {"a"}, {"c"});
+  AddOp(&netdef, "Reshape", {"c", "c"}, {"c_re", "c_old_shape"});
+
+  auto t = TransformRegistry()->Create("SimplifyReshapeTranspose");
+  const NetDef transformed_netdef = t->ApplyTo(netdef);
+  ASSERT_EQ(transformed_netdef.op_size(), 10);
+  for (const auto& op : transformed_netdef.op()) {
+    if (op.type() == "Reshape") {
+      EXPECT_NE(op.input(0), op.output(0));
+    }
+  }
+}
+
+} // namespace
+
+} // namespace caffe2
@@ -0,0 +1,207 @@
+#include "caffe2/utils/cpu_budget_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/numa.h"
+
+CAFFE2_DEFINE_int(
+    caffe2_cpu_budget_threads,
+    0,
+    "The number of workers of the shared CPU budget pools of all NUMA nodes "
+    "together. 0 to use the number of cores.");
+CAFFE2_DEFINE_double(
+    caffe2_cpu_budget_decode_share,
+    0.75,
+    "The share of the workers of a CPU budget pool that the decoding of the "
+    "input ops may occupy at a time.");
+CAFFE2_DEFINE_double(
+    caffe2_cpu_budget_operator_share,
+    0.5,
+    "The share of the workers of a CPU budget pool that the intra-op work of "
+    "CPU operators may occupy at a time. Also sizes the OpenMP and MKL "
+    "threads when caffe2_cpu_budget_threads is set and they are not.");
+
+namespace caffe2 {
+
+CpuBudgetPool::CpuBudgetPool(
+    std::size_t pool_size,
+    int numa_node_id,
+    const std::vector<std::size_t>& max_workers)
+    : numa_node_id_(numa_node_id),
+      max_workers_(max_workers),
+      running_(true),
+      queues_(kNumCpuConsumers),
+      busy_(kNumCpuConsumers, 0) {
+  CAFFE_ENFORCE_GT(pool_size, 0);
+  CAFFE_ENFORCE_EQ(max_workers_.size(), std::size_t(kNumCpuConsumers));
+  for (auto& max : max_workers_) {
+    max = std::max<std::size_t>(1, std::min(max, pool_size));
+  }
+  for (std::size_t i = 0; i < pool_size; ++i) {
+    threads_.emplace_back(std::bind(&CpuBudgetPool::MainLoop, this, i));
+  }
+}
+
+CpuBudgetPool::~CpuBudgetPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+    wake_.notify_all();
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void CpuBudgetPool::RunTaskWithID(
+    CpuConsumer consumer,
+    std::function<void(std::size_t)> task,
+    CpuTaskGroup* group) {
+  if (group) {
+    group->Add();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  queues_[static_cast<int>(consumer)].push_back(Task{std::move(task), group});
+  wake_.notify_one();
+}
+
+void CpuBudgetPool::ParallelFor(
+    CpuConsumer consumer,
+    std::size_t n,
+    const std::function<void(std::size_t)>& fn) {
+  if (n == 0) {
+    return;
+  }
+  struct State {
+    std::atomic<std::size_t> next{0};
+    std::size_t finished = 0;
+    std::mutex mutex;
+    std::condition_variable done;
+  };
+  // the helpers may start after the loop is over, so they share the state
+  auto state = std::make_shared<State>();
+  const std::function<void(std::size_t)>* body = &fn;
+  auto work = [state, body, n]() {
+    std::size_t ran = 0;
+    for (std::size_t i = state->next++; i < n; i = state->next++) {
+      (*body)(i);
+      ++ran;
+    }
+    if (ran > 0) {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->finished += ran;
+      if (state->finished == n) {
+        state->done.notify_all();
+      }
+    }
+  };
+  const std::size_t helpers = std::min(n, max_workers(consumer)) - 1;
+  for (std::size_t i = 0; i < helpers; ++i) {
+    // a helper that starts late finds no index left and never touches fn
+    RunTaskWithID(consumer, [work](std::size_t /* index */) { work(); });
+  }
+  work();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->done.wait(lock, [&state, n]() { return state->finished == n; });
+}
+
+int CpuBudgetPool::NextConsumer() const {
+  for (int consumer = 0; consumer < kNumCpuConsumers; ++consumer) {
+    if (!queues_[consumer].empty() &&
+        busy_[consumer] < max_workers_[consumer]) {
+      return consumer;
+    }
+  }
+  return -1;
+}
+
+void CpuBudgetPool::MainLoop(std::size_t index) {
+  NUMABind(numa_node_id_);
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    int consumer = -1;
+    wake_.wait(lock, [this, &consumer]() {
+      consumer = NextConsumer();
+      return consumer >= 0 || !running_;
+    });
+    if (consumer < 0) {
+      return;
+    }
+    Task task = std::move(queues_[consumer].front());
+    queues_[consumer].pop_front();
+    ++busy_[consumer];
+    lock.unlock();
+    try {
+      task.fn(index);
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Exception in a CPU budget pool task: " << e.what();
+    }
+    if (task.group) {
+      task.group->Done();
+    }
+    // destroy the task before taking the lock, in case it holds shared_ptrs
+    task.fn = nullptr;
+    lock.lock();
+    --busy_[consumer];
+    // the consumer is under its share again, a sleeping worker may take its
+    // next task
+    if (!queues_[consumer].empty()) {
+      wake_.notify_one();
+    }
+  }
+}
+
+std::size_t CpuBudgetThreads(int numa_node_id) {
+  int threads = FLAGS_caffe2_cpu_budget_threads;
+  if (threads <= 0) {
+    threads = std::thread::hardware_concurrency();
+    CAFFE_ENFORCE(threads > 0, "Failed to get number of CPU cores");
+  }
+  const int num_nodes = GetNumNUMANodes();
+  if (numa_node_id >= 0 && num_nodes > 1) {
+    threads /= num_nodes;
+  }
+  return std::max(threads, 1);
+}
+
+std::size_t CpuBudgetMaxWorkers(int numa_node_id, CpuConsumer consumer) {
+  const double share = consumer == CpuConsumer::kDecode
+      ? FLAGS_caffe2_cpu_budget_decode_share
+      : FLAGS_caffe2_cpu_budget_operator_share;
+  CAFFE_ENFORCE(share > 0 && share <= 1, "Invalid CPU budget share ", share);
+  return std::max<std::size_t>(
+      1, std::lround(share * CpuBudgetThreads(numa_node_id)));
+}
+
+std::shared_ptr<CpuBudgetPool> GetCpuBudgetPool(int numa_node_id) {
+  static std::unordered_map<int, std::weak_ptr<CpuBudgetPool>> pools;
+  static std::mutex pool_mutex;
+  std::lock_guard<std::mutex> lock(pool_mutex);
+
+  std::shared_ptr<CpuBudgetPool> pool;
+  if (pools.count(numa_node_id)) {
+    pool = pools.at(numa_node_id).lock();
+  }
+  if (!pool) {
+    const std::size_t size = CpuBudgetThreads(numa_node_id);
+    std::vector<std::size_t> max_workers(kNumCpuConsumers);
+    max_workers[static_cast<int>(CpuConsumer::kOperator)] =
+        CpuBudgetMaxWorkers(numa_node_id, CpuConsumer::kOperator);
+    max_workers[static_cast<int>(CpuConsumer::kDecode)] =
+        CpuBudgetMaxWorkers(numa_node_id, CpuConsumer::kDecode);
+    LOG(INFO) << "Using a CPU budget pool of " << size << " workers on NUMA "
+              << "node " << numa_node_id << ", at most "
+              << max_workers[static_cast<int>(CpuConsumer::kOperator)]
+              << " for operators and "
+              << max_workers[static_cast<int>(CpuConsumer::kDecode)]
+              << " for decoding";
+    pool = std::make_shared<CpuBudgetPool>(size, numa_node_id, max_workers);
+    pools[numa_node_id] = pool;
+  }
+  return pool;
+}
+
+} // namespace caffe2
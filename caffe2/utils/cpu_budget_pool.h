@@ -0,0 +1,139 @@
+#ifndef CAFFE2_UTILS_CPU_BUDGET_POOL_H_
+#define CAFFE2_UTILS_CPU_BUDGET_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/flags.h"
+
+CAFFE2_DECLARE_int(caffe2_cpu_budget_threads);
+CAFFE2_DECLARE_double(caffe2_cpu_budget_decode_share);
+CAFFE2_DECLARE_double(caffe2_cpu_budget_operator_share);
+
+namespace caffe2 {
+
+// The users of the CPU budget, in the order a free worker serves them: the
+// intra-op work of CPU operators, which a net thread waits for, before the
+// decoding of input ops, which runs ahead of the net.
+enum class CpuConsumer {
+  kOperator = 0,
+  kDecode = 1,
+};
+constexpr int kNumCpuConsumers = 2;
+
+// Counts the tasks of one user of a CpuBudgetPool, which can wait for them
+// without waiting for the tasks of the other users.
+class CpuTaskGroup {
+ public:
+  CpuTaskGroup() : pending_(0) {}
+
+  void Add() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++pending_;
+  }
+
+  void Done() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_ == 0) {
+      done_.notify_all();
+    }
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return pending_ == 0; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable done_;
+  std::size_t pending_;
+};
+
+// One pool of workers that the CPU consumers of a process share, instead of
+// a pool per op plus an OpenMP team per thread. Every consumer has a queue
+// and may occupy at most max_workers(consumer) workers at a time, so a burst
+// of decoding cannot take the cores the operators need, and the other way
+// around; a free worker takes the next task of the first consumer, in
+// CpuConsumer order, that is under its share. The workers are bound to
+// numa_node_id if it is >= 0.
+class CpuBudgetPool {
+ public:
+  CpuBudgetPool(
+      std::size_t pool_size,
+      int numa_node_id,
+      const std::vector<std::size_t>& max_workers);
+  ~CpuBudgetPool();
+
+  std::size_t size() const {
+    return threads_.size();
+  }
+
+  int numa_node_id() const {
+    return numa_node_id_;
+  }
+
+  std::size_t max_workers(CpuConsumer consumer) const {
+    return max_workers_[static_cast<int>(consumer)];
+  }
+
+  // Runs task(worker index), the index being in [0, size()), so that the
+  // caller can keep per-worker state. group, if any, counts the task.
+  void RunTaskWithID(
+      CpuConsumer consumer,
+      std::function<void(std::size_t)> task,
+      CpuTaskGroup* group = nullptr);
+
+  // Runs fn(i) for i in [0, n) on the calling thread and up to
+  // max_workers(consumer) - 1 workers, and returns once they are all done.
+  // The caller works on the range too, so this neither deadlocks when it is
+  // called from a worker nor waits for workers that are busy elsewhere. fn
+  // must not throw.
+  void ParallelFor(
+      CpuConsumer consumer,
+      std::size_t n,
+      const std::function<void(std::size_t)>& fn);
+
+ private:
+  struct Task {
+    std::function<void(std::size_t)> fn;
+    CpuTaskGroup* group;
+  };
+
+  // the consumer of the next task a worker may take, -1 for none; called
+  // with mutex_ held
+  int NextConsumer() const;
+
+  void MainLoop(std::size_t index);
+
+  int numa_node_id_;
+  std::vector<std::size_t> max_workers_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool running_;
+  std::vector<std::deque<Task>> queues_;
+  std::vector<std::size_t> busy_;
+};
+
+// The number of workers of the budget of a NUMA node (-1 for the whole
+// machine): caffe2_cpu_budget_threads, or the cores, split evenly between
+// the NUMA nodes.
+std::size_t CpuBudgetThreads(int numa_node_id);
+
+// The share of the budget of a NUMA node that consumer may use, at least 1.
+std::size_t CpuBudgetMaxWorkers(int numa_node_id, CpuConsumer consumer);
+
+// The process-wide pool of a NUMA node (-1 for the whole machine), created
+// on first use with the budget flags, and shared by all its users.
+std::shared_ptr<CpuBudgetPool> GetCpuBudgetPool(int numa_node_id);
+
+} // namespace caffe2
+
+#endif // CAFFE2_UTILS_CPU_BUDGET_POOL_H_
@@ -0,0 +1,110 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "caffe2/utils/cpu_budget_pool.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+TEST(CpuBudgetPoolTest, RunsTasksOfAGroup) {
+  CpuBudgetPool pool(4, -1, {4, 4});
+  CpuTaskGroup group;
+  std::atomic<int> sum(0);
+  for (int i = 0; i < 1000; ++i) {
+    pool.RunTaskWithID(
+        CpuConsumer::kDecode,
+        [&sum, i](std::size_t index) {
+          ASSERT_LT(index, 4u);
+          sum += i;
+        },
+        &group);
+  }
+  group.Wait();
+  EXPECT_EQ(sum, 999 * 1000 / 2);
+}
+
+TEST(CpuBudgetPoolTest, KeepsConsumersToTheirShare) {
+  CpuBudgetPool pool(4, -1, {4, 2});
+  CpuTaskGroup group;
+  std::atomic<int> running(0);
+  std::atomic<int> max_running(0);
+  for (int i = 0; i < 20; ++i) {
+    pool.RunTaskWithID(
+        CpuConsumer::kDecode,
+        [&running, &max_running](std::size_t /* index */) {
+          const int now = ++running;
+          int max = max_running;
+          while (now > max && !max_running.compare_exchange_weak(max, now)) {
+          }
+          std::this_thread::sleep_for(std::chrono::milliseconds(2));
+          --running;
+        },
+        &group);
+  }
+  group.Wait();
+  EXPECT_EQ(pool.max_workers(CpuConsumer::kDecode), 2u);
+  EXPECT_LE(max_running, 2);
+}
+
+TEST(CpuBudgetPoolTest, OperatorsRunBesideASaturatedDecode) {
+  CpuBudgetPool pool(3, -1, {3, 2});
+  CpuTaskGroup decode;
+  std::atomic<bool> release(false);
+  for (int i = 0; i < 4; ++i) {
+    pool.RunTaskWithID(
+        CpuConsumer::kDecode,
+        [&release](std::size_t /* index */) {
+          while (!release) {
+            std::this_thread::yield();
+          }
+        },
+        &decode);
+  }
+  // the worker outside the decode share is free for operators
+  CpuTaskGroup ops;
+  std::atomic<int> ran(0);
+  pool.RunTaskWithID(
+      CpuConsumer::kOperator, [&ran](std::size_t /* index */) { ++ran; }, &ops);
+  ops.Wait();
+  EXPECT_EQ(ran, 1);
+  release = true;
+  decode.Wait();
+}
+
+TEST(CpuBudgetPoolTest, ParallelForCoversTheRange) {
+  CpuBudgetPool pool(4, -1, {3, 4});
+  std::vector<std::atomic<int>> hits(1000);
+  for (auto& hit : hits) {
+    hit = 0;
+  }
+  for (int round = 0; round < 10; ++round) {
+    pool.ParallelFor(CpuConsumer::kOperator, hits.size(), [&hits](std::size_t i) {
+      ++hits[i];
+    });
+  }
+  for (auto& hit : hits) {
+    EXPECT_EQ(hit, 10);
+  }
+}
+
+TEST(CpuBudgetPoolTest, ParallelForFromAWorker) {
+  CpuBudgetPool pool(2, -1, {2, 2});
+  CpuTaskGroup group;
+  std::atomic<int> sum(0);
+  for (int t = 0; t < 4; ++t) {
+    pool.RunTaskWithID(
+        CpuConsumer::kOperator,
+        [&pool, &sum](std::size_t /* index */) {
+          pool.ParallelFor(CpuConsumer::kOperator, 100, [&sum](std::size_t i) {
+            sum += i;
+          });
+        },
+        &group);
+  }
+  group.Wait();
+  EXPECT_EQ(sum, 4 * 99 * 100 / 2);
+}
+
+} // namespace caffe2
@@ -4,6 +4,14 @@
 #include <cstdlib>
 #include <stdint.h>
 
+// div / mod can also be called from CUDA kernels, on a divisor built on the
+// host and passed by value
+#ifdef __CUDACC__
+#define FIXED_DIVISOR_DECL __host__ __device__ inline
+#else
+#define FIXED_DIVISOR_DECL inline
+#endif
+
 namespace caffe2 {
 
 // Utility class for quickly calculating quotients and remainders for
@@ -31,7 +39,7 @@ class FixedDivisor<int32_t> {
   }
 
   /// Calculates `q = n / d`.
-  inline int32_t div(int32_t n) const {
+  FIXED_DIVISOR_DECL int32_t div(int32_t n) const {
     // In lieu of a mulhi instruction being available, perform the
     // work in uint64
     uint64_t mul64 = magic_ * (uint64_t) n;
@@ -39,12 +47,12 @@ class FixedDivisor<int32_t> {
   }
 
   /// Calculates `r = n % d`.
-  inline int32_t mod(int32_t n) const {
+  FIXED_DIVISOR_DECL int32_t mod(int32_t n) const {
     return n - d_ * div(n);
   }
 
   /// Calculates `q = n / d` and `r = n % d` together.
-  inline void divMod(int32_t n, int32_t& q, int32_t& r) const {
+  FIXED_DIVISOR_DECL void divMod(int32_t n, int32_t& q, int32_t& r) const {
     const int32_t quotient = div(n);
     q = quotient;
     r = n - d_ * quotient;
@@ -110,4 +118,6 @@ class FixedDivisor<int32_t> {
 
 } // namespace caffe2
 
+#undef FIXED_DIVISOR_DECL
+
 #endif // CAFFE2_UTILS_FIXED_DIVISOR_H_
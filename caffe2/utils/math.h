@@ -195,6 +195,18 @@ void Transpose(
     T* Y,
     Context* context);
 
+// Merges the adjacent axes of a transpose of dims by axes that stay adjacent
+// and in order, and drops the axes of size 1, e.g. the axes (0, 2, 1, 3, 4)
+// of (N, C, T, H, W) become (0, 2, 1, 3) of (N, C, T, H * W). Transposing by
+// the reduced axes moves the same elements, and the innermost data stays
+// contiguous iff the last reduced axis stays in place.
+void ComputeTransposeDims(
+    const int num_axes,
+    const int* dims,
+    const int* axes,
+    std::vector<int>* reduced_dims,
+    std::vector<int>* reduced_axes);
+
 // Decaf gemm provides a simpler interface to the gemm functions, with the
 // limitation that the data has to be contiguous in memory.
 template <typename T, class Context, class Engine = DefaultEngine>
@@ -249,6 +261,32 @@ void GemmBatched(
     Tensor<Context>* scratch = nullptr,
     TensorProto::DataType math_type = TensorProto_DataType_FLOAT);
 
+// GemmStridedBatched is GemmBatched on strided matrices: matrix i of A, B and
+// C starts a_stride, b_stride and c_stride elements after matrix i - 1 (a
+// stride may be 0 to reuse a matrix) and lda, ldb and ldc are the leading
+// dimensions of GemmEx.
+template <typename T, class Context, class Engine = DefaultEngine>
+void GemmStridedBatched(
+    const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB,
+    const int batch_size,
+    const int M,
+    const int N,
+    const int K,
+    const float alpha,
+    const T* A,
+    const int lda,
+    const long long a_stride,
+    const T* B,
+    const int ldb,
+    const long long b_stride,
+    const float beta,
+    T* C,
+    const int ldc,
+    const long long c_stride,
+    Context* context,
+    TensorProto::DataType math_type = TensorProto_DataType_FLOAT);
+
 // Gemv always takes in a M*N matrix A, and depending on whether we set TransA
 // to Trans, the output is:
 // CblasNoTrans: x is an N dim vector and y is an M dim vector.
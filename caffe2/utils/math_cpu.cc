@@ -22,6 +22,8 @@
 
 #include "caffe2/utils/math.h"
 #include "caffe2/utils/cpu_neon.h"
+#include "caffe2/utils/parallel_for.h"
+#include "caffe2/core/common_omp.h"
 #include "caffe2/core/context.h"
 #include "Eigen/Core"
 #include "Eigen/Dense"
@@ -406,6 +408,36 @@ CAFFE2_SPECIALIZED_AXPBY(float, s)
 
 #endif  // CAFFE2_USE_EIGEN_FOR_BLAS
 
+namespace {
+
+#ifndef CAFFE2_USE_MKL
+// Below this many multiply-adds a GEMM of a batch is too small to keep the
+// threads of the BLAS busy, and the batch is faster with a GEMM per thread.
+constexpr long long kGemmBatchSerialMinSize = 64 * 64 * 64;
+
+// Whether to run the GEMMs of a batch in parallel, each on one thread, rather
+// than one after the other. The BLAS and Eigen run single threaded inside an
+// OpenMP parallel region.
+bool ParallelizeGemmBatch(
+    const int batch_size,
+    const int M,
+    const int N,
+    const int K) {
+#ifdef _OPENMP
+  return batch_size > 1 && omp_get_max_threads() > 1 && !omp_in_parallel() &&
+      static_cast<long long>(M) * N * K < kGemmBatchSerialMinSize;
+#else
+  (void)batch_size;
+  (void)M;
+  (void)N;
+  (void)K;
+  return false;
+#endif // _OPENMP
+}
+#endif // CAFFE2_USE_MKL
+
+} // namespace
+
 template <>
 void GemmBatched<float, CPUContext>(
     const CBLAS_TRANSPOSE TransA,
@@ -458,6 +490,8 @@ void GemmBatched<float, CPUContext>(
       &batch_size);
 #else // CAFFE2_USE_MKL
   // loop over matrices in the batch
+  const bool parallel = ParallelizeGemmBatch(batch_size, M, N, K);
+#pragma omp parallel for if (parallel)
   for (int i = 0; i < batch_size; ++i) {
     math::Gemm<float, CPUContext>(
         TransA,
@@ -475,6 +509,79 @@ void GemmBatched<float, CPUContext>(
 #endif
 }
 
+template <>
+void GemmStridedBatched<float, CPUContext>(
+    const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB,
+    const int batch_size,
+    const int M,
+    const int N,
+    const int K,
+    const float alpha,
+    const float* A,
+    const int lda,
+    const long long a_stride,
+    const float* B,
+    const int ldb,
+    const long long b_stride,
+    const float beta,
+    float* C,
+    const int ldc,
+    const long long c_stride,
+    CPUContext* context,
+    TensorProto::DataType /* math_type */) {
+#ifdef CAFFE2_USE_MKL
+  (void)context;
+
+  std::vector<const float*> a_array(batch_size, nullptr);
+  std::vector<const float*> b_array(batch_size, nullptr);
+  std::vector<float*> c_array(batch_size, nullptr);
+  for (int i = 0; i < batch_size; ++i) {
+    a_array[i] = A + a_stride * i;
+    b_array[i] = B + b_stride * i;
+    c_array[i] = C + c_stride * i;
+  }
+  cblas_sgemm_batch(
+      CblasRowMajor,
+      &TransA,
+      &TransB,
+      &M,
+      &N,
+      &K,
+      &alpha,
+      a_array.data(),
+      &lda,
+      b_array.data(),
+      &ldb,
+      &beta,
+      c_array.data(),
+      &ldc,
+      1,
+      &batch_size);
+#else // CAFFE2_USE_MKL
+  // loop over matrices in the batch
+  const bool parallel = ParallelizeGemmBatch(batch_size, M, N, K);
+#pragma omp parallel for if (parallel)
+  for (int i = 0; i < batch_size; ++i) {
+    math::GemmEx<float, CPUContext>(
+        TransA,
+        TransB,
+        M,
+        N,
+        K,
+        alpha,
+        A + a_stride * i,
+        lda,
+        B + b_stride * i,
+        ldb,
+        beta,
+        C + c_stride * i,
+        ldc,
+        context);
+  }
+#endif // CAFFE2_USE_MKL
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // MKL VML alternatives.
 // Depending on whether we are using MKL, we will delegate the Caffe math
@@ -938,6 +1045,83 @@ void Select<float, CPUContext>(
     y[i] = x[i * D + idx[i]];
   }
 }
+namespace {
+
+// Im2col of a (C, T, H, W) image for 3d kernels. Every column row is one
+// (c, kt, kh, kw) tap and is filled independently, a (t, h) line at a time,
+// so the rows are spread over the OpenMP threads. The common video kernel
+// sizes are template arguments so that the row decomposition is resolved at
+// compile time; 0 means the size is only known at run time.
+template <int kKT, int kKH, int kKW>
+void Im2col3dNCHW(
+    const float* data_img,
+    const int* im_shape,
+    const int* col_shape,
+    const int* kernel_shape,
+    const int* stride,
+    const int* dilation,
+    const int* pad,
+    float* data_col) {
+  const int kernel_t = kKT > 0 ? kKT : kernel_shape[0];
+  const int kernel_h = kKH > 0 ? kKH : kernel_shape[1];
+  const int kernel_w = kKW > 0 ? kKW : kernel_shape[2];
+  const int T = im_shape[1], H = im_shape[2], W = im_shape[3];
+  const int out_t = col_shape[1], out_h = col_shape[2], out_w = col_shape[3];
+  const int rows = col_shape[0];
+  const int out_plane = out_h * out_w;
+  const int out_size = out_t * out_plane;
+#pragma omp parallel for
+  for (int row = 0; row < rows; ++row) {
+    const int w_off = row % kernel_w;
+    const int h_off = (row / kernel_w) % kernel_h;
+    const int t_off = (row / kernel_w / kernel_h) % kernel_t;
+    const int c = row / kernel_w / kernel_h / kernel_t;
+    const float* img = data_img + c * T * H * W;
+    float* col = data_col + row * out_size;
+    // the output columns whose input column is inside the image
+    const int w_shift = w_off * dilation[2] - pad[2];
+    int w_begin = 0;
+    while (w_begin < out_w && w_begin * stride[2] + w_shift < 0) {
+      ++w_begin;
+    }
+    int w_end = w_begin;
+    while (w_end < out_w && w_end * stride[2] + w_shift < W) {
+      ++w_end;
+    }
+    for (int t = 0; t < out_t; ++t) {
+      const int t_im = t * stride[0] - pad[0] + t_off * dilation[0];
+      float* col_plane = col + t * out_plane;
+      if (t_im < 0 || t_im >= T) {
+        std::memset(col_plane, 0, sizeof(float) * out_plane);
+        continue;
+      }
+      for (int h = 0; h < out_h; ++h) {
+        const int h_im = h * stride[1] - pad[1] + h_off * dilation[1];
+        float* dst = col_plane + h * out_w;
+        if (h_im < 0 || h_im >= H) {
+          std::memset(dst, 0, sizeof(float) * out_w);
+          continue;
+        }
+        const float* src = img + (t_im * H + h_im) * W;
+        std::memset(dst, 0, sizeof(float) * w_begin);
+        if (stride[2] == 1) {
+          std::memcpy(
+              dst + w_begin,
+              src + w_begin + w_shift,
+              sizeof(float) * (w_end - w_begin));
+        } else {
+          for (int w = w_begin; w < w_end; ++w) {
+            dst[w] = src[w * stride[2] + w_shift];
+          }
+        }
+        std::memset(dst + w_end, 0, sizeof(float) * (out_w - w_end));
+      }
+    }
+  }
+}
+
+} // namespace
+
 // Ported from caffe 1.
 template <>
 void Im2colNd<float, CPUContext, StorageOrder::NCHW>(
@@ -954,6 +1138,31 @@ void Im2colNd<float, CPUContext, StorageOrder::NCHW>(
     float* data_col,
     CPUContext* /* context */,
     bool accumulate_output) {
+  if (N == 3 && !accumulate_output) {
+    const int kt = kernel_shape[0], kh = kernel_shape[1], kw = kernel_shape[2];
+    auto im2col = Im2col3dNCHW<0, 0, 0>;
+    if (kt == 1 && kh == 1 && kw == 1) {
+      im2col = Im2col3dNCHW<1, 1, 1>;
+    } else if (kt == 3 && kh == 1 && kw == 1) {
+      im2col = Im2col3dNCHW<3, 1, 1>;
+    } else if (kt == 1 && kh == 3 && kw == 3) {
+      im2col = Im2col3dNCHW<1, 3, 3>;
+    } else if (kt == 3 && kh == 3 && kw == 3) {
+      im2col = Im2col3dNCHW<3, 3, 3>;
+    } else if (kt == 5 && kh == 7 && kw == 7) {
+      im2col = Im2col3dNCHW<5, 7, 7>;
+    }
+    im2col(
+        data_img,
+        im_shape,
+        col_shape,
+        kernel_shape,
+        stride,
+        dilation,
+        pad,
+        data_col);
+    return;
+  }
   int kernel_size = 1;
   for (int i = 0; i < N; ++i) {
     kernel_size *= kernel_shape[i];
@@ -1543,6 +1752,7 @@ bool TryTransposeWithHPTT(
 
 #endif // CAFFE2_USE_HPTT
 
+// The strides of the axes of X in the order of the axes of Y.
 std::vector<int>
 ComputeXStrides(const int num_axes, const int* dims, const int* axes) {
   std::vector<int> x_strides(num_axes);
@@ -1558,90 +1768,220 @@ ComputeXStrides(const int num_axes, const int* dims, const int* axes) {
   return x_strides;
 }
 
-void IncreaseIndex(const int* dims, std::vector<int>* index) {
-  for (int i = index->size() - 1; i >= 0; --i) {
-    ++index->at(i);
-    if (index->at(i) >= dims[i]) {
-      index->at(i) -= dims[i];
-    } else {
-      break;
-    }
-  }
+// Copies the blocks of block_size elements of X by the reduced dims and
+// axes, block_size for the innermost axes that stay in place. An iteration
+// of the ParallelFor computes the index in X of a row along the last axis of
+// Y once, and copies the row with a stride.
+template <typename T>
+void TransposeBlocksCPU(
+    const int num_axes,
+    const int* dims,
+    const int* axes,
+    const int block_size,
+    const T* X,
+    T* Y) {
+  const std::vector<int> x_strides = ComputeXStrides(num_axes, dims, axes);
+  std::vector<int> y_dims(num_axes);
+  for (int i = 0; i < num_axes; ++i) {
+    y_dims[i] = dims[axes[i]];
+  }
+  const int row_size = y_dims.back();
+  const int row_stride = x_strides.back();
+  const int num_rows = std::accumulate(
+      y_dims.cbegin(), y_dims.cend() - 1, 1, std::multiplies<int>());
+  ParallelFor(
+      num_rows,
+      ParallelForGrainSize(static_cast<int64_t>(row_size) * block_size),
+      [&](int64_t begin, int64_t end) {
+        for (int row = begin; row < end; ++row) {
+          int x_index = 0;
+          for (int i = num_axes - 2, r = row; i >= 0; --i) {
+            x_index += (r % y_dims[i]) * x_strides[i];
+            r /= y_dims[i];
+          }
+          T* y = Y + static_cast<TIndex>(row) * row_size * block_size;
+          if (block_size == 1) {
+            for (int j = 0; j < row_size; ++j) {
+              y[j] = X[x_index + j * row_stride];
+            }
+          } else {
+            for (int j = 0; j < row_size; ++j) {
+              memcpy(
+                  y + j * block_size,
+                  X +
+                      static_cast<TIndex>(x_index + j * row_stride) *
+                          block_size,
+                  block_size * sizeof(T));
+            }
+          }
+        }
+      });
+}
+
+// Transposes the last two axes of X, (batch_size, rows, cols), in tiles that
+// stay in the cache.
+template <typename T>
+void BatchTranspose2DCPU(
+    const int batch_size,
+    const int rows,
+    const int cols,
+    const T* X,
+    T* Y) {
+  constexpr int kTileSize = 32;
+  const int row_tiles = (rows + kTileSize - 1) / kTileSize;
+  ParallelFor(
+      batch_size * row_tiles,
+      ParallelForGrainSize(static_cast<int64_t>(kTileSize) * cols),
+      [&](int64_t begin, int64_t end) {
+        for (int t = begin; t < end; ++t) {
+          const int b = t / row_tiles;
+          const int r0 = (t % row_tiles) * kTileSize;
+          const int r1 = std::min(r0 + kTileSize, rows);
+          const T* x = X + static_cast<TIndex>(b) * rows * cols;
+          T* y = Y + static_cast<TIndex>(b) * rows * cols;
+          for (int c0 = 0; c0 < cols; c0 += kTileSize) {
+            const int c1 = std::min(c0 + kTileSize, cols);
+            for (int r = r0; r < r1; ++r) {
+              for (int c = c0; c < c1; ++c) {
+                y[c * rows + r] = x[r * cols + c];
+              }
+            }
+          }
+        }
+      });
 }
 
 template <typename T>
 void TransposeCPU(
-    const int num_axes,
-    const int* x_dims,
-    const int* y_dims,
-    const int* axes,
+    const std::vector<int>& dims,
+    const std::vector<int>& axes,
     const int data_size,
     const T* X,
     T* Y) {
-  // Measure amount of contiguous data we can copy at once
-  int block_size = 1;
-  int num_shared_idxs = 0;
-  for (int i = num_axes - 1; i >= 0 && axes[i] == i; --i) {
-    block_size *= y_dims[i];
-    ++num_shared_idxs;
+  const int num_axes = dims.size();
+  if (data_size == 0) {
+    return;
   }
-
-  if (num_axes < 2 || num_shared_idxs == num_axes) {
+  if (num_axes == 1) {
     memcpy(Y, X, data_size * sizeof(T));
     return;
   }
-
-  const int itr_axes = num_axes - num_shared_idxs;
-  const std::vector<int> x_strides = ComputeXStrides(itr_axes, x_dims, axes);
-  std::vector<int> index_digits(itr_axes, 0);
-  const int num_blocks = data_size / block_size;
-  for (int y_index = 0; y_index < num_blocks; ++y_index) {
-    const int x_index = std::inner_product(
-        x_strides.cbegin(), x_strides.cend(), index_digits.cbegin(), 0);
-    if (block_size == 1) {
-      Y[y_index] = X[x_index];
-    } else {
-      memcpy(
-          Y + block_size * y_index,
-          X + block_size * x_index,
-          block_size * sizeof(T));
-    }
-    IncreaseIndex(y_dims, &index_digits);
+  // e.g. (0, 2, 1, 3, 4): copies of the H x W planes
+  if (axes.back() == num_axes - 1) {
+    TransposeBlocksCPU(
+        num_axes - 1, dims.data(), axes.data(), dims.back(), X, Y);
+    return;
   }
+  // e.g. (0, 2, 3, 4, 1): a transpose of a matrix per batch
+  bool batch_2d = axes[num_axes - 2] == num_axes - 1 &&
+      axes[num_axes - 1] == num_axes - 2;
+  for (int i = 0; i < num_axes - 2; ++i) {
+    batch_2d = batch_2d && axes[i] == i;
+  }
+  if (batch_2d) {
+    BatchTranspose2DCPU(
+        data_size / (dims[num_axes - 2] * dims[num_axes - 1]),
+        dims[num_axes - 2],
+        dims[num_axes - 1],
+        X,
+        Y);
+    return;
+  }
+  TransposeBlocksCPU(num_axes, dims.data(), axes.data(), 1, X, Y);
 }
 
 } // namespace
 
+void ComputeTransposeDims(
+    const int num_axes,
+    const int* dims,
+    const int* axes,
+    std::vector<int>* reduced_dims,
+    std::vector<int>* reduced_axes) {
+  // drop the axes of size 1
+  std::vector<int> index(num_axes, -1);
+  std::vector<int> kept_dims;
+  for (int i = 0; i < num_axes; ++i) {
+    if (dims[i] != 1) {
+      index[i] = kept_dims.size();
+      kept_dims.push_back(dims[i]);
+    }
+  }
+  std::vector<int> kept_axes;
+  for (int i = 0; i < num_axes; ++i) {
+    if (index[axes[i]] >= 0) {
+      kept_axes.push_back(index[axes[i]]);
+    }
+  }
+  // the runs of axes of Y that are consecutive axes of X, by their first
+  // axis of X
+  const int n = kept_axes.size();
+  std::vector<int> first_axes;
+  for (int i = 0; i < n; ++i) {
+    if (i == 0 || kept_axes[i] != kept_axes[i - 1] + 1) {
+      first_axes.push_back(kept_axes[i]);
+    }
+  }
+  std::vector<int> sorted_first(first_axes);
+  std::sort(sorted_first.begin(), sorted_first.end());
+  reduced_dims->assign(sorted_first.size(), 1);
+  for (size_t r = 0; r < sorted_first.size(); ++r) {
+    const int end = r + 1 < sorted_first.size() ? sorted_first[r + 1] : n;
+    for (int a = sorted_first[r]; a < end; ++a) {
+      (*reduced_dims)[r] *= kept_dims[a];
+    }
+  }
+  reduced_axes->clear();
+  for (const int first : first_axes) {
+    reduced_axes->push_back(
+        std::lower_bound(sorted_first.begin(), sorted_first.end(), first) -
+        sorted_first.begin());
+  }
+  if (reduced_dims->empty()) {
+    reduced_dims->push_back(1);
+    reduced_axes->push_back(0);
+  }
+}
+
 template <>
 void Transpose<float, CPUContext>(
     const int num_axes,
     const int* x_dims,
-    const int* y_dims,
+    const int* /* y_dims */,
     const int* axes,
     const int data_size,
     const float* X,
     float* Y,
     CPUContext* /* context */) {
+  std::vector<int> dims;
+  std::vector<int> reduced_axes;
+  ComputeTransposeDims(num_axes, x_dims, axes, &dims, &reduced_axes);
 #ifdef CAFFE2_USE_HPTT
-  if (TryTransposeWithHPTT(num_axes, x_dims, axes, X, Y)) {
+  // copying contiguous blocks beats HPTT
+  if (reduced_axes.back() != static_cast<int>(dims.size()) - 1 &&
+      TryTransposeWithHPTT(
+          dims.size(), dims.data(), reduced_axes.data(), X, Y)) {
     return;
   }
 #endif // CAFFE2_USE_HPTT
-  TransposeCPU(num_axes, x_dims, y_dims, axes, data_size, X, Y);
+  TransposeCPU(dims, reduced_axes, data_size, X, Y);
 }
 
-#define CAFFE2_SPECIALIZED_TRANSPOSE(T)                            \
-  template <>                                                      \
-  void Transpose<T, CPUContext>(                                   \
-      const int num_axes,                                          \
-      const int* x_dims,                                           \
-      const int* y_dims,                                           \
-      const int* axes,                                             \
-      const int data_size,                                         \
-      const T* X,                                                  \
-      T* Y,                                                        \
-      CPUContext* /* context */) {                                 \
-    TransposeCPU(num_axes, x_dims, y_dims, axes, data_size, X, Y); \
+#define CAFFE2_SPECIALIZED_TRANSPOSE(T)                                 \
+  template <>                                                           \
+  void Transpose<T, CPUContext>(                                        \
+      const int num_axes,                                               \
+      const int* x_dims,                                                \
+      const int* /* y_dims */,                                          \
+      const int* axes,                                                  \
+      const int data_size,                                              \
+      const T* X,                                                       \
+      T* Y,                                                             \
+      CPUContext* /* context */) {                                      \
+    std::vector<int> dims;                                              \
+    std::vector<int> reduced_axes;                                      \
+    ComputeTransposeDims(num_axes, x_dims, axes, &dims, &reduced_axes); \
+    TransposeCPU(dims, reduced_axes, data_size, X, Y);                  \
   }
 CAFFE2_SPECIALIZED_TRANSPOSE(double)
 CAFFE2_SPECIALIZED_TRANSPOSE(int)
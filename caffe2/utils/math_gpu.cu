@@ -484,6 +484,154 @@ void GemmBatched<float16, CUDAContext>(
 #endif
 }
 
+template <>
+void GemmStridedBatched<float, CUDAContext>(
+    const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB,
+    const int batch_size,
+    const int M,
+    const int N,
+    const int K,
+    const float alpha,
+    const float* A,
+    const int lda,
+    const long long a_stride,
+    const float* B,
+    const int ldb,
+    const long long b_stride,
+    const float beta,
+    float* C,
+    const int ldc,
+    const long long c_stride,
+    CUDAContext* context,
+    TensorProto::DataType /* math_type */) {
+#if __CUDACC_VER_MAJOR__ < 8
+  // loop over matrices in the batch
+  for (int i = 0; i < batch_size; ++i) {
+    math::GemmEx<float, CUDAContext>(
+        TransA,
+        TransB,
+        M,
+        N,
+        K,
+        alpha,
+        A + a_stride * i,
+        lda,
+        B + b_stride * i,
+        ldb,
+        beta,
+        C + c_stride * i,
+        ldc,
+        context);
+  }
+#else
+  // Note that cublas follows fortran order, so the order is different from
+  // the cblas convention.
+  cublasOperation_t cuTransA =
+      (TransA == CblasNoTrans) ? CUBLAS_OP_N : CUBLAS_OP_T;
+  cublasOperation_t cuTransB =
+      (TransB == CblasNoTrans) ? CUBLAS_OP_N : CUBLAS_OP_T;
+  CUBLAS_ENFORCE(cublasSgemmStridedBatched(
+      context->cublas_handle(),
+      cuTransB,
+      cuTransA,
+      N,
+      M,
+      K,
+      &alpha,
+      B,
+      ldb,
+      b_stride,
+      A,
+      lda,
+      a_stride,
+      &beta,
+      C,
+      ldc,
+      c_stride,
+      batch_size));
+#endif
+}
+
+template <>
+void GemmStridedBatched<float16, CUDAContext>(
+    const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB,
+    const int batch_size,
+    const int M,
+    const int N,
+    const int K,
+    const float alpha,
+    const float16* A,
+    const int lda,
+    const long long a_stride,
+    const float16* B,
+    const int ldb,
+    const long long b_stride,
+    const float beta,
+    float16* C,
+    const int ldc,
+    const long long c_stride,
+    CUDAContext* context,
+    TensorProto::DataType math_type) {
+  cublasOperation_t cuTransA =
+      (TransA == CblasNoTrans) ? CUBLAS_OP_N : CUBLAS_OP_T;
+  cublasOperation_t cuTransB =
+      (TransB == CblasNoTrans) ? CUBLAS_OP_N : CUBLAS_OP_T;
+  if (math_type == TensorProto_DataType_FLOAT) {
+    // fp32 accumulation, looped SgemmEx
+    for (int i = 0; i < batch_size; ++i) {
+      CUBLAS_CHECK(cublasSgemmEx(
+          context->cublas_handle(),
+          cuTransB,
+          cuTransA,
+          N,
+          M,
+          K,
+          &alpha,
+          B + b_stride * i,
+          CUDA_R_16F,
+          ldb,
+          A + a_stride * i,
+          CUDA_R_16F,
+          lda,
+          &beta,
+          C + c_stride * i,
+          CUDA_R_16F,
+          ldc));
+    }
+  } else if (math_type == TensorProto_DataType_FLOAT16) {
+#if __CUDACC_VER_MAJOR__ < 8
+    CAFFE_THROW("Strided batched Hgemm needs CUDA 8");
+#else
+    // convert alpha, beta from float -> __half
+    auto alpha_fp16 = convert::floatToHalf(alpha);
+    auto beta_fp16 = convert::floatToHalf(beta);
+    CUBLAS_ENFORCE(cublasHgemmStridedBatched(
+        context->cublas_handle(),
+        cuTransB,
+        cuTransA,
+        N,
+        M,
+        K,
+        &alpha_fp16,
+        (const __half*)B,
+        ldb,
+        b_stride,
+        (const __half*)A,
+        lda,
+        a_stride,
+        &beta_fp16,
+        (__half*)C,
+        ldc,
+        c_stride,
+        batch_size));
+#endif
+  } else {
+    CAFFE_THROW("Unsupported math type");
+  }
+}
+
 #if CUDA_VERSION >= 9000
 
 // No change, but required. Defer to default CUDA engine
@@ -607,6 +755,146 @@ void GemmBatched<float, CUDAContext, TensorCoreEngine>(
       math_type);
 }
 
+template <>
+void GemmStridedBatched<float, CUDAContext, TensorCoreEngine>(
+    const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB,
+    const int batch_size,
+    const int M,
+    const int N,
+    const int K,
+    const float alpha,
+    const float* A,
+    const int lda,
+    const long long a_stride,
+    const float* B,
+    const int ldb,
+    const long long b_stride,
+    const float beta,
+    float* C,
+    const int ldc,
+    const long long c_stride,
+    CUDAContext* context,
+    TensorProto::DataType math_type) {
+  // tensor cores take fp16 inputs, defer to default CUDA engine
+  return GemmStridedBatched<float, CUDAContext, DefaultEngine>(
+      TransA,
+      TransB,
+      batch_size,
+      M,
+      N,
+      K,
+      alpha,
+      A,
+      lda,
+      a_stride,
+      B,
+      ldb,
+      b_stride,
+      beta,
+      C,
+      ldc,
+      c_stride,
+      context,
+      math_type);
+}
+
+// fp16 inputs and outputs with fp32 accumulation on tensor cores; the
+// math type is always fp32.
+template <>
+void GemmStridedBatched<float16, CUDAContext, TensorCoreEngine>(
+    const CBLAS_TRANSPOSE TransA,
+    const CBLAS_TRANSPOSE TransB,
+    const int batch_size,
+    const int M,
+    const int N,
+    const int K,
+    const float alpha,
+    const float16* A,
+    const int lda,
+    const long long a_stride,
+    const float16* B,
+    const int ldb,
+    const long long b_stride,
+    const float beta,
+    float16* C,
+    const int ldc,
+    const long long c_stride,
+    CUDAContext* context,
+    TensorProto::DataType /* math_type */) {
+  // Note that cublas follows fortran order, so the order is different from
+  // the cblas convention.
+  cublasOperation_t cuTransA =
+      (TransA == CblasNoTrans) ? CUBLAS_OP_N : CUBLAS_OP_T;
+  cublasOperation_t cuTransB =
+      (TransB == CblasNoTrans) ? CUBLAS_OP_N : CUBLAS_OP_T;
+
+  // enable TensorCore for this call on this handle
+  if (TensorCoreAvailable()) {
+    CUBLAS_ENFORCE(cublasSetMathMode(
+        context->cublas_handle(),
+        CUBLAS_TENSOR_OP_MATH));
+  }
+
+#if CUDA_VERSION >= 9010
+  CUBLAS_ENFORCE(cublasGemmStridedBatchedEx(
+      context->cublas_handle(),
+      cuTransB,
+      cuTransA,
+      N,
+      M,
+      K,
+      &alpha,
+      B,
+      CUDA_R_16F,
+      ldb,
+      b_stride,
+      A,
+      CUDA_R_16F,
+      lda,
+      a_stride,
+      &beta,
+      C,
+      CUDA_R_16F,
+      ldc,
+      c_stride,
+      batch_size,
+      CUDA_R_32F,
+      CUBLAS_GEMM_DFALT_TENSOR_OP));
+#else
+  // no strided batched GemmEx before CUDA 9.1, loop over the batch
+  for (int i = 0; i < batch_size; ++i) {
+    CUBLAS_ENFORCE(cublasGemmEx(
+        context->cublas_handle(),
+        cuTransB,
+        cuTransA,
+        N,
+        M,
+        K,
+        &alpha,
+        B + b_stride * i,
+        CUDA_R_16F,
+        ldb,
+        A + a_stride * i,
+        CUDA_R_16F,
+        lda,
+        &beta,
+        C + c_stride * i,
+        CUDA_R_16F,
+        ldc,
+        CUDA_R_32F,
+        CUBLAS_GEMM_DFALT_TENSOR_OP));
+  }
+#endif
+
+  // Now disable TensorCore math for subsequent calls to this handle
+  if (TensorCoreAvailable()) {
+    CUBLAS_ENFORCE(cublasSetMathMode(
+        context->cublas_handle(),
+        CUBLAS_DEFAULT_MATH));
+  }
+}
+
 template <>
 void GemmBatched<float16, CUDAContext, TensorCoreEngine>(
     const CBLAS_TRANSPOSE TransA,
@@ -621,9 +909,11 @@ void GemmBatched<float16, CUDAContext, TensorCoreEngine>(
     const float beta,
     float16* C,
     CUDAContext* context,
-    Tensor<CUDAContext>* scratch,
+    Tensor<CUDAContext>* /* scratch */,
     TensorProto::DataType math_type) {
-  return GemmBatched<float16, CUDAContext, DefaultEngine>(
+  // the contiguous batch is a strided one, and tensor cores accumulate in
+  // fp32 without the fp32 scratch copies of the default engine
+  return GemmStridedBatched<float16, CUDAContext, TensorCoreEngine>(
       TransA,
       TransB,
       batch_size,
@@ -632,11 +922,16 @@ void GemmBatched<float16, CUDAContext, TensorCoreEngine>(
       K,
       alpha,
       A,
+      (TransA == CblasNoTrans) ? K : M,
+      static_cast<long long>(M) * K,
       B,
+      (TransB == CblasNoTrans) ? N : K,
+      static_cast<long long>(K) * N,
       beta,
       C,
+      N,
+      static_cast<long long>(M) * N,
       context,
-      scratch,
       math_type);
 }
 
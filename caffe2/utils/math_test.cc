@@ -162,6 +162,38 @@ TEST_P(GemmBatchedTest, GemmBatchedFloatTest) {
   VerifyOutput(20.0f);
 }
 
+// Enough small GEMMs to be run in parallel, each with its own values.
+TEST(MathTest, GemmBatchedSmallMatrices) {
+  DeviceOption option;
+  CPUContext cpu_context(option);
+  const int batch_size = 16;
+  TensorCPU X(std::vector<int>{batch_size, 4, 8});
+  TensorCPU W(std::vector<int>{batch_size, 8, 3});
+  TensorCPU Y(std::vector<int>{batch_size, 4, 3});
+  for (int i = 0; i < batch_size; ++i) {
+    math::Set<float, CPUContext>(
+        32, i, X.mutable_data<float>() + 32 * i, &cpu_context);
+    math::Set<float, CPUContext>(
+        24, 2, W.mutable_data<float>() + 24 * i, &cpu_context);
+  }
+  math::GemmBatched<float, CPUContext>(
+      CblasNoTrans,
+      CblasNoTrans,
+      batch_size,
+      4,
+      3,
+      8,
+      1.0f,
+      X.data<float>(),
+      W.data<float>(),
+      0.0f,
+      Y.mutable_data<float>(),
+      &cpu_context);
+  for (int i = 0; i < Y.size(); ++i) {
+    EXPECT_FLOAT_EQ(16.0f * (i / 12), Y.data<float>()[i]) << i;
+  }
+}
+
 INSTANTIATE_TEST_CASE_P(
     GemmBatchedTrans,
     GemmBatchedTest,
@@ -366,4 +398,142 @@ TEST(MathTest, TranposeTest) {
   }
 }
 
+TEST(MathTest, ComputeTransposeDimsTest) {
+  std::vector<int> dims;
+  std::vector<int> axes;
+  {
+    // Only the channels and the time swap: copies of the H x W planes.
+    const std::vector<int> x_dims = {2, 3, 4, 5, 6};
+    const std::vector<int> x_axes = {0, 2, 1, 3, 4};
+    math::ComputeTransposeDims(5, x_dims.data(), x_axes.data(), &dims, &axes);
+    EXPECT_EQ(dims, std::vector<int>({2, 3, 4, 30}));
+    EXPECT_EQ(axes, std::vector<int>({0, 2, 1, 3}));
+  }
+  {
+    // The channels move last: a matrix transpose per batch.
+    const std::vector<int> x_dims = {2, 3, 4, 5, 6};
+    const std::vector<int> x_axes = {0, 2, 3, 4, 1};
+    math::ComputeTransposeDims(5, x_dims.data(), x_axes.data(), &dims, &axes);
+    EXPECT_EQ(dims, std::vector<int>({2, 3, 120}));
+    EXPECT_EQ(axes, std::vector<int>({0, 2, 1}));
+  }
+  {
+    // The axes of size 1 do not count.
+    const std::vector<int> x_dims = {1, 3, 1, 5};
+    const std::vector<int> x_axes = {2, 3, 0, 1};
+    math::ComputeTransposeDims(4, x_dims.data(), x_axes.data(), &dims, &axes);
+    EXPECT_EQ(dims, std::vector<int>({3, 5}));
+    EXPECT_EQ(axes, std::vector<int>({1, 0}));
+  }
+}
+
+TEST(MathTest, Tranpose5DTest) {
+  DeviceOption option;
+  CPUContext cpu_context(option);
+  const std::vector<int> x_dims = {2, 3, 4, 5, 6};
+  const std::vector<std::vector<int>> all_axes = {
+      {0, 2, 1, 3, 4}, {0, 2, 3, 4, 1}, {0, 4, 1, 2, 3}, {4, 1, 3, 0, 2}};
+  TensorCPU X(x_dims);
+  for (int i = 0; i < X.size(); ++i) {
+    X.mutable_data<float>()[i] = static_cast<float>(i);
+  }
+  std::vector<int> x_strides(5, 1);
+  for (int i = 3; i >= 0; --i) {
+    x_strides[i] = x_strides[i + 1] * x_dims[i + 1];
+  }
+  for (const auto& axes : all_axes) {
+    std::vector<int> y_dims(5);
+    for (int i = 0; i < 5; ++i) {
+      y_dims[i] = x_dims[axes[i]];
+    }
+    TensorCPU Y(y_dims);
+    math::Transpose<float, CPUContext>(
+        5,
+        x_dims.data(),
+        y_dims.data(),
+        axes.data(),
+        X.size(),
+        X.data<float>(),
+        Y.mutable_data<float>(),
+        &cpu_context);
+    for (int y_index = 0; y_index < Y.size(); ++y_index) {
+      int x_index = 0;
+      for (int i = 4, r = y_index; i >= 0; --i) {
+        x_index += (r % y_dims[i]) * x_strides[axes[i]];
+        r /= y_dims[i];
+      }
+      EXPECT_FLOAT_EQ(X.data<float>()[x_index], Y.data<float>()[y_index]);
+    }
+  }
+}
+
+TEST(MathTest, Im2col3dTest) {
+  DeviceOption option;
+  CPUContext cpu_context(option);
+  const int C = 2, T = 4, H = 5, W = 6;
+  const std::vector<int> im_shape = {C, T, H, W};
+  TensorCPU X(im_shape);
+  for (int i = 0; i < X.size(); ++i) {
+    X.mutable_data<float>()[i] = static_cast<float>(i + 1);
+  }
+  // kernel, stride, dilation and leading pad per axis; the specialized and
+  // the run time kernel sizes, unit and larger strides.
+  const std::vector<std::vector<int>> configs = {
+      {1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0},
+      {3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0},
+      {1, 3, 3, 1, 2, 2, 1, 1, 1, 0, 1, 1},
+      {3, 3, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1},
+      {2, 3, 2, 2, 1, 3, 1, 2, 1, 1, 2, 1},
+  };
+  for (const auto& config : configs) {
+    const int* kernel = config.data();
+    const int* stride = config.data() + 3;
+    const int* dilation = config.data() + 6;
+    const int* pad = config.data() + 9;
+    std::vector<int> col_shape = {C * kernel[0] * kernel[1] * kernel[2]};
+    for (int d = 0; d < 3; ++d) {
+      const int extent = dilation[d] * (kernel[d] - 1) + 1;
+      col_shape.push_back(
+          (im_shape[d + 1] + 2 * pad[d] - extent) / stride[d] + 1);
+    }
+    TensorCPU col(col_shape);
+    math::Im2colNd<float, CPUContext, StorageOrder::NCHW>(
+        X.data<float>(),
+        im_shape.data(),
+        col_shape.data(),
+        X.size(),
+        col.size(),
+        kernel,
+        stride,
+        dilation,
+        pad,
+        3,
+        col.mutable_data<float>(),
+        &cpu_context);
+    const float* col_data = col.data<float>();
+    for (int row = 0; row < col_shape[0]; ++row) {
+      const int kw = row % kernel[2];
+      const int kh = row / kernel[2] % kernel[1];
+      const int kt = row / kernel[2] / kernel[1] % kernel[0];
+      const int c = row / kernel[2] / kernel[1] / kernel[0];
+      for (int t = 0; t < col_shape[1]; ++t) {
+        for (int h = 0; h < col_shape[2]; ++h) {
+          for (int w = 0; w < col_shape[3]; ++w) {
+            const int t_im = t * stride[0] - pad[0] + kt * dilation[0];
+            const int h_im = h * stride[1] - pad[1] + kh * dilation[1];
+            const int w_im = w * stride[2] - pad[2] + kw * dilation[2];
+            float expected = 0;
+            if (t_im >= 0 && t_im < T && h_im >= 0 && h_im < H &&
+                w_im >= 0 && w_im < W) {
+              expected =
+                  X.data<float>()[((c * T + t_im) * H + h_im) * W + w_im];
+            }
+            EXPECT_FLOAT_EQ(expected, *col_data++);
+          }
+        }
+      }
+    }
+  }
+}
+
 } // namespace caffe2
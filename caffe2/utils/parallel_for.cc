@@ -0,0 +1,60 @@
+#include "caffe2/utils/parallel_for.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "caffe2/utils/cpu_budget_pool.h"
+
+CAFFE2_DEFINE_bool(
+    caffe2_cpu_parallel_for,
+    false,
+    "Split the outer loops of the CPU operators that use ParallelFor over the "
+    "operator share of the CPU budget pool.");
+
+namespace caffe2 {
+
+namespace {
+
+// set on the threads running the chunks of a ParallelFor
+thread_local bool in_parallel_for = false;
+
+} // namespace
+
+void ParallelFor(
+    int64_t n,
+    int64_t grain_size,
+    const std::function<void(int64_t, int64_t)>& fn) {
+  if (n <= 0) {
+    return;
+  }
+  grain_size = std::max<int64_t>(grain_size, 1);
+  if (!FLAGS_caffe2_cpu_parallel_for || in_parallel_for ||
+      n < 2 * grain_size) {
+    fn(0, n);
+    return;
+  }
+  // kept for the life of the process, the pool only lives while it is used
+  static std::shared_ptr<CpuBudgetPool> pool = GetCpuBudgetPool(-1);
+  const int64_t num_chunks = std::min<int64_t>(
+      n / grain_size, pool->max_workers(CpuConsumer::kOperator));
+  if (num_chunks < 2) {
+    fn(0, n);
+    return;
+  }
+  pool->ParallelFor(
+      CpuConsumer::kOperator, num_chunks, [n, num_chunks, &fn](std::size_t i) {
+        SerialParallelForScope nested;
+        fn(n * i / num_chunks, n * (i + 1) / num_chunks);
+      });
+}
+
+SerialParallelForScope::SerialParallelForScope()
+    : previous_(in_parallel_for) {
+  in_parallel_for = true;
+}
+
+SerialParallelForScope::~SerialParallelForScope() {
+  in_parallel_for = previous_;
+}
+
+} // namespace caffe2
@@ -0,0 +1,51 @@
+#ifndef CAFFE2_UTILS_PARALLEL_FOR_H_
+#define CAFFE2_UTILS_PARALLEL_FOR_H_
+
+#include <cstdint>
+#include <functional>
+
+#include "caffe2/core/flags.h"
+
+CAFFE2_DECLARE_bool(caffe2_cpu_parallel_for);
+
+namespace caffe2 {
+
+// The least work, in elements touched, worth a chunk of a ParallelFor: less
+// than that costs about as much to hand to a worker as to run.
+constexpr int64_t kParallelForMinChunkCost = 1 << 15;
+
+// The grain size of a ParallelFor whose items cost cost_per_item elements
+// each, e.g. the T x H x W of a (n, c) plane.
+inline int64_t ParallelForGrainSize(int64_t cost_per_item) {
+  return cost_per_item >= kParallelForMinChunkCost
+      ? 1
+      : kParallelForMinChunkCost / (cost_per_item > 0 ? cost_per_item : 1);
+}
+
+// Runs fn(begin, end) on chunks that cover [0, n), of grain_size items at
+// least, on the calling thread and the operator share of the CPU budget pool
+// (see cpu_budget_pool.h) when caffe2_cpu_parallel_for is set. It runs
+// fn(0, n) on the calling thread when the flag is not set, when n is less
+// than two grains, and when it is called from within the fn of another
+// ParallelFor. Chunks run concurrently, so they must write disjoint data,
+// and fn must not throw.
+void ParallelFor(
+    int64_t n,
+    int64_t grain_size,
+    const std::function<void(int64_t, int64_t)>& fn);
+
+// Runs the ParallelFor loops of the current thread serially while it lives,
+// as if they were nested in another one; e.g. on the decode threads of an
+// input op, which already run a clip each.
+class SerialParallelForScope {
+ public:
+  SerialParallelForScope();
+  ~SerialParallelForScope();
+
+ private:
+  bool previous_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_UTILS_PARALLEL_FOR_H_
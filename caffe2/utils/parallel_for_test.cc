@@ -0,0 +1,82 @@
+#include <atomic>
+#include <vector>
+
+#include "caffe2/utils/parallel_for.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+class ParallelForTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    FLAGS_caffe2_cpu_parallel_for = true;
+  }
+  void TearDown() override {
+    FLAGS_caffe2_cpu_parallel_for = false;
+  }
+};
+
+} // namespace
+
+TEST_F(ParallelForTest, CoversTheRangeOnce) {
+  std::vector<std::atomic<int>> hits(10007);
+  for (auto& hit : hits) {
+    hit = 0;
+  }
+  ParallelFor(hits.size(), 10, [&hits](int64_t begin, int64_t end) {
+    EXPECT_LT(begin, end);
+    for (int64_t i = begin; i < end; ++i) {
+      ++hits[i];
+    }
+  });
+  for (auto& hit : hits) {
+    EXPECT_EQ(hit, 1);
+  }
+}
+
+TEST_F(ParallelForTest, RunsSmallLoopsInOneCall) {
+  int calls = 0;
+  ParallelFor(15, 8, [&calls](int64_t begin, int64_t end) {
+    EXPECT_EQ(begin, 0);
+    EXPECT_EQ(end, 15);
+    ++calls;
+  });
+  EXPECT_EQ(calls, 1);
+}
+
+TEST_F(ParallelForTest, RunsNestedLoopsSerially) {
+  std::atomic<int> inner_calls(0);
+  std::atomic<int64_t> sum(0);
+  ParallelFor(64, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      ParallelFor(100, 1, [&](int64_t inner_begin, int64_t inner_end) {
+        ++inner_calls;
+        sum += inner_end - inner_begin;
+      });
+    }
+  });
+  EXPECT_EQ(inner_calls, 64);
+  EXPECT_EQ(sum, 64 * 100);
+}
+
+TEST_F(ParallelForTest, RunsSeriallyInASerialScope) {
+  SerialParallelForScope serial;
+  int calls = 0;
+  ParallelFor(1 << 20, 1, [&calls](int64_t begin, int64_t end) {
+    EXPECT_EQ(begin, 0);
+    EXPECT_EQ(end, 1 << 20);
+    ++calls;
+  });
+  EXPECT_EQ(calls, 1);
+}
+
+TEST(ParallelForGrainSizeTest, GrowsWithCheaperItems) {
+  EXPECT_EQ(ParallelForGrainSize(kParallelForMinChunkCost), 1);
+  EXPECT_EQ(ParallelForGrainSize(1 << 20), 1);
+  EXPECT_EQ(ParallelForGrainSize(kParallelForMinChunkCost / 4), 4);
+  EXPECT_EQ(ParallelForGrainSize(0), kParallelForMinChunkCost);
+}
+
+} // namespace caffe2
@@ -0,0 +1,93 @@
+#ifndef CAFFE2_UTILS_PHILOX_RANDOM_H_
+#define CAFFE2_UTILS_PHILOX_RANDOM_H_
+
+#include <stdint.h>
+
+#ifdef __CUDACC__
+#define CAFFE2_PHILOX_HOST_DEVICE __host__ __device__
+#else
+#define CAFFE2_PHILOX_HOST_DEVICE
+#endif
+
+namespace caffe2 {
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2,
+// 3"), a counter based generator: the 4 random words of a counter depend only
+// on it and the key, so the numbers of an element can be regenerated on their
+// own, on the CPU and on the GPU alike.
+CAFFE2_PHILOX_HOST_DEVICE inline void Philox4x32(
+    const uint32_t counter[4],
+    uint32_t key0,
+    uint32_t key1,
+    uint32_t out[4]) {
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  for (int round = 0; round < 10; ++round) {
+    const uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c0;
+    const uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c2;
+    const uint32_t hi0 = static_cast<uint32_t>(p0 >> 32);
+    const uint32_t lo0 = static_cast<uint32_t>(p0);
+    const uint32_t hi1 = static_cast<uint32_t>(p1 >> 32);
+    const uint32_t lo1 = static_cast<uint32_t>(p1);
+    c0 = hi1 ^ c1 ^ key0;
+    c1 = lo1;
+    c2 = hi0 ^ c3 ^ key1;
+    c3 = lo0;
+    key0 += 0x9E3779B9u;
+    key1 += 0xBB67AE85u;
+  }
+  out[0] = c0;
+  out[1] = c1;
+  out[2] = c2;
+  out[3] = c3;
+}
+
+// A generator for the std distributions over the Philox4x32 words of the
+// counters {0, lo, hi, stream}, {1, lo, hi, stream}, ... of the key seed,
+// where lo and hi are the words of index. Generators of different (seed,
+// stream, index) draw independent sequences, so work items that each take
+// the generator of their index can run in any order and on any thread and
+// still draw the same numbers.
+class PhiloxRandom {
+ public:
+  typedef uint32_t result_type;
+
+  PhiloxRandom(
+      const uint64_t seed,
+      const uint32_t stream,
+      const uint64_t index)
+      : key0_(static_cast<uint32_t>(seed)),
+        key1_(static_cast<uint32_t>(seed >> 32)),
+        counter_{0,
+                 static_cast<uint32_t>(index),
+                 static_cast<uint32_t>(index >> 32),
+                 stream} {}
+
+  static constexpr result_type min() {
+    return 0;
+  }
+
+  static constexpr result_type max() {
+    return 0xFFFFFFFFu;
+  }
+
+  result_type operator()() {
+    if (next_ == 4) {
+      Philox4x32(counter_, key0_, key1_, words_);
+      ++counter_[0];
+      next_ = 0;
+    }
+    return words_[next_++];
+  }
+
+ private:
+  const uint32_t key0_;
+  const uint32_t key1_;
+  uint32_t counter_[4];
+  uint32_t words_[4];
+  // the next of words_ to return, 4 once they are used up
+  int next_ = 4;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_UTILS_PHILOX_RANDOM_H_
@@ -0,0 +1,55 @@
+#include "caffe2/utils/philox_random.h"
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+namespace caffe2 {
+
+TEST(PhiloxRandomTest, KnownAnswer) {
+  // the test vectors of Random123 for Philox4x32-10
+  const uint32_t zeros[4] = {0, 0, 0, 0};
+  uint32_t out[4];
+  Philox4x32(zeros, 0, 0, out);
+  EXPECT_EQ(out[0], 0x6627e8d5u);
+  EXPECT_EQ(out[1], 0xe169c58du);
+  EXPECT_EQ(out[2], 0xbc57ac4cu);
+  EXPECT_EQ(out[3], 0x9b00dbd8u);
+  const uint32_t ones[4] = {
+      0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu};
+  Philox4x32(ones, 0xffffffffu, 0xffffffffu, out);
+  EXPECT_EQ(out[0], 0x408f276du);
+  EXPECT_EQ(out[1], 0x41c83b0eu);
+  EXPECT_EQ(out[2], 0xa20bc7c6u);
+  EXPECT_EQ(out[3], 0x6d5451fdu);
+}
+
+TEST(PhiloxRandomTest, SameIndexSameNumbers) {
+  PhiloxRandom gen1(1234, 1, 5);
+  PhiloxRandom gen2(1234, 1, 5);
+  PhiloxRandom other_index(1234, 1, 6);
+  PhiloxRandom other_stream(1234, 2, 5);
+  PhiloxRandom other_seed(1235, 1, 5);
+  std::uniform_int_distribution<int> dist(0, 1 << 30);
+  int num_equal = 0;
+  for (int i = 0; i < 10; ++i) {
+    const int x = dist(gen1);
+    EXPECT_EQ(x, dist(gen2));
+    num_equal += x == dist(other_index);
+    num_equal += x == dist(other_stream);
+    num_equal += x == dist(other_seed);
+  }
+  EXPECT_EQ(num_equal, 0);
+}
+
+TEST(PhiloxRandomTest, Bernoulli) {
+  PhiloxRandom gen(0, 0, 0);
+  std::bernoulli_distribution coin(0.5);
+  int num_heads = 0;
+  for (int i = 0; i < 10000; ++i) {
+    num_heads += coin(gen);
+  }
+  EXPECT_NEAR(num_heads, 5000, 300);
+}
+
+} // namespace caffe2
@@ -0,0 +1,124 @@
+#include "caffe2/utils/timeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <set>
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+namespace {
+
+void WriteJsonString(std::ostream& out, const std::string& str) {
+  out << '"';
+  for (const char c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << ' ';
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+// the Chrome trace pid of a lane: the host first, then the GPUs
+int ChromePid(const int pid) {
+  return pid == kTimelineHost ? 0 : pid + 1;
+}
+
+} // namespace
+
+TimelineRecorder& TimelineRecorder::Get() {
+  static TimelineRecorder recorder;
+  return recorder;
+}
+
+int64_t TimelineRecorder::NowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int64_t TimelineRecorder::ThreadLane() {
+  static std::atomic<int64_t> next_lane{0};
+  thread_local int64_t lane = next_lane++;
+  return lane;
+}
+
+void TimelineRecorder::Start(size_t capacity) {
+  CAFFE_ENFORCE_GT(capacity, 0, "The timeline needs room for a span.");
+  std::lock_guard<std::mutex> lock(mutex_);
+  ring_.clear();
+  ring_.resize(capacity);
+  next_ = 0;
+  size_ = 0;
+  enabled_ = true;
+}
+
+void TimelineRecorder::Stop() {
+  enabled_ = false;
+}
+
+void TimelineRecorder::Record(TimelineSpan span) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!enabled_ || ring_.empty()) {
+    return;
+  }
+  ring_[next_] = std::move(span);
+  next_ = (next_ + 1) % ring_.size();
+  size_ = std::min(size_ + 1, ring_.size());
+}
+
+std::vector<TimelineSpan> TimelineRecorder::Spans() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<TimelineSpan> spans;
+  spans.reserve(size_);
+  const size_t first = (next_ + ring_.size() - size_) % std::max<size_t>(
+      ring_.size(), 1);
+  for (size_t i = 0; i < size_; ++i) {
+    spans.push_back(ring_[(first + i) % ring_.size()]);
+  }
+  return spans;
+}
+
+void TimelineRecorder::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  next_ = 0;
+  size_ = 0;
+}
+
+void TimelineRecorder::WriteChromeTrace(const std::string& path) const {
+  const auto spans = Spans();
+  std::ofstream out(path, std::ios::trunc);
+  CAFFE_ENFORCE(out, "Cannot open ", path);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  std::set<int> pids;
+  bool first = true;
+  for (const auto& span : spans) {
+    pids.insert(span.pid);
+    out << (first ? "" : ",\n") << "{\"name\": ";
+    WriteJsonString(out, span.name);
+    out << ", \"cat\": \"" << span.category << "\", \"ph\": \"X\", \"ts\": "
+        << span.begin_us << ", \"dur\": " << span.end_us - span.begin_us
+        << ", \"pid\": " << ChromePid(span.pid) << ", \"tid\": " << span.tid
+        << "}";
+    first = false;
+  }
+  for (const int pid : pids) {
+    out << (first ? "" : ",\n")
+        << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": "
+        << ChromePid(pid) << ", \"args\": {\"name\": \""
+        << (pid == kTimelineHost ? std::string("host")
+                                 : "gpu " + std::to_string(pid))
+        << "\"}}";
+    first = false;
+  }
+  out << "\n]}\n";
+  CAFFE_ENFORCE(out, "Cannot write ", path);
+}
+
+} // namespace caffe2
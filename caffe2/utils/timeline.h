@@ -0,0 +1,93 @@
+#ifndef CAFFE2_UTILS_TIMELINE_H_
+#define CAFFE2_UTILS_TIMELINE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex> // NOLINT
+#include <string>
+#include <vector>
+
+namespace caffe2 {
+
+// One span of a timeline. Spans are laid out in lanes: pid kTimelineHost
+// holds the host threads, with tid the thread lane of TimelineRecorder,
+// and pid >= 0 holds the streams of that GPU, with tid the stream lane.
+struct TimelineSpan {
+  std::string name;
+  // a string literal, e.g. "op", "allreduce", "input" or "decode"
+  const char* category;
+  int pid;
+  int64_t tid;
+  int64_t begin_us;
+  int64_t end_us;
+};
+
+constexpr int kTimelineHost = -1;
+
+// Records spans into a ring buffer while it is started, so that it can be
+// left on for some iterations of a production job and keeps the last
+// capacity spans. Recording takes a lock; while the recorder is stopped the
+// record sites only load an atomic flag. The spans are written in the
+// Chrome trace format (chrome://tracing), as htrace_to_chrome.py does.
+class TimelineRecorder {
+ public:
+  static TimelineRecorder& Get();
+
+  // microseconds of the clock of all the spans
+  static int64_t NowMicros();
+  // a small id of the calling thread, its lane on the host
+  static int64_t ThreadLane();
+
+  void Start(size_t capacity);
+  void Stop();
+  bool enabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  void Record(TimelineSpan span);
+  // the spans in the ring, oldest first
+  std::vector<TimelineSpan> Spans() const;
+  void Clear();
+  void WriteChromeTrace(const std::string& path) const;
+
+ private:
+  TimelineRecorder() {}
+
+  std::atomic<bool> enabled_{false};
+  mutable std::mutex mutex_;
+  std::vector<TimelineSpan> ring_;
+  size_t next_ = 0;
+  size_t size_ = 0;
+};
+
+// Records the span of its scope on the host lane of the thread, if the
+// recorder was started when the scope began.
+class TimelineScope {
+ public:
+  TimelineScope(const char* category, const char* name)
+      : category_(category),
+        name_(name),
+        begin_us_(
+            TimelineRecorder::Get().enabled() ? TimelineRecorder::NowMicros()
+                                              : -1) {}
+
+  ~TimelineScope() {
+    if (begin_us_ >= 0) {
+      TimelineRecorder::Get().Record(TimelineSpan{name_,
+                                                  category_,
+                                                  kTimelineHost,
+                                                  TimelineRecorder::ThreadLane(),
+                                                  begin_us_,
+                                                  TimelineRecorder::NowMicros()});
+    }
+  }
+
+ private:
+  const char* category_;
+  const char* name_;
+  const int64_t begin_us_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_UTILS_TIMELINE_H_
@@ -0,0 +1,77 @@
+#include "caffe2/utils/timeline.h"
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+namespace caffe2 {
+
+namespace {
+
+TimelineSpan HostSpan(const std::string& name, int64_t begin_us) {
+  return TimelineSpan{name, "op", kTimelineHost, 0, begin_us, begin_us + 1};
+}
+
+TEST(TimelineTest, KeepsTheLastSpansOfTheRing) {
+  auto& recorder = TimelineRecorder::Get();
+  recorder.Start(3);
+  for (int i = 0; i < 5; ++i) {
+    recorder.Record(HostSpan("span" + std::to_string(i), i));
+  }
+  recorder.Stop();
+  recorder.Record(HostSpan("stopped", 5));
+  const auto spans = recorder.Spans();
+  ASSERT_EQ(spans.size(), 3);
+  EXPECT_EQ(spans[0].name, "span2");
+  EXPECT_EQ(spans[1].name, "span3");
+  EXPECT_EQ(spans[2].name, "span4");
+  recorder.Clear();
+  EXPECT_TRUE(recorder.Spans().empty());
+}
+
+TEST(TimelineTest, ScopesRecordOnlyWhileStarted) {
+  auto& recorder = TimelineRecorder::Get();
+  recorder.Start(8);
+  recorder.Stop();
+  { TimelineScope scope("decode", "before"); }
+  recorder.Start(8);
+  {
+    TimelineScope scope("decode", "during");
+    recorder.Stop();
+  }
+  const auto spans = recorder.Spans();
+  ASSERT_EQ(spans.size(), 0);
+  recorder.Start(8);
+  { TimelineScope scope("decode", "during"); }
+  recorder.Stop();
+  ASSERT_EQ(recorder.Spans().size(), 1);
+  EXPECT_EQ(recorder.Spans()[0].name, "during");
+  EXPECT_EQ(recorder.Spans()[0].pid, kTimelineHost);
+  EXPECT_LE(recorder.Spans()[0].begin_us, recorder.Spans()[0].end_us);
+}
+
+TEST(TimelineTest, WritesChromeTrace) {
+  auto& recorder = TimelineRecorder::Get();
+  recorder.Start(8);
+  recorder.Record(HostSpan("Conv \"out\"", 10));
+  recorder.Record(TimelineSpan{"Conv", "cuda", 1, 0, 12, 20});
+  recorder.Stop();
+  const std::string path = "timeline_test.json";
+  recorder.WriteChromeTrace(path);
+  std::ifstream in(path);
+  std::stringstream json;
+  json << in.rdbuf();
+  std::remove(path.c_str());
+  const auto trace = json.str();
+  EXPECT_NE(trace.find("\"name\": \"Conv \\\"out\\\"\""), std::string::npos);
+  EXPECT_NE(
+      trace.find("\"ph\": \"X\", \"ts\": 12, \"dur\": 8, \"pid\": 2"),
+      std::string::npos);
+  EXPECT_NE(trace.find("\"args\": {\"name\": \"host\"}"), std::string::npos);
+  EXPECT_NE(trace.find("\"args\": {\"name\": \"gpu 1\"}"), std::string::npos);
+}
+
+} // namespace
+
+} // namespace caffe2
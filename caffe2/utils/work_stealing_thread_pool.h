@@ -0,0 +1,189 @@
+#ifndef CAFFE2_UTILS_WORK_STEALING_THREAD_POOL_H_
+#define CAFFE2_UTILS_WORK_STEALING_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "caffe2/core/numa.h"
+
+namespace caffe2 {
+
+// WorkStealingThreadPool has the same runTask / runTaskWithID /
+// waitWorkComplete interface as TaskThreadPool, but every worker owns a
+// deque with its own mutex. Tasks are pushed round robin, a worker takes
+// tasks from the front of its own deque and steals from the back of the
+// other ones when it runs dry, so producers and workers rarely contend on
+// the same lock. The shared mutexes are only taken to put an idle worker to
+// sleep and to signal waitWorkComplete().
+class WorkStealingThreadPool {
+ private:
+  struct task_element_t {
+    bool run_with_id;
+    std::function<void()> no_id;
+    std::function<void(std::size_t)> with_id;
+
+    explicit task_element_t(const std::function<void()>& f)
+        : run_with_id(false), no_id(f), with_id(nullptr) {}
+    explicit task_element_t(const std::function<void(std::size_t)>& f)
+        : run_with_id(true), no_id(nullptr), with_id(f) {}
+  };
+
+  struct worker_queue_t {
+    std::mutex mutex;
+    std::deque<task_element_t> tasks;
+  };
+
+  std::vector<std::unique_ptr<worker_queue_t>> queues_;
+  std::vector<std::thread> threads_;
+  std::atomic<bool> running_;
+  // tasks pushed and not yet taken by a worker
+  std::atomic<std::size_t> queued_;
+  // tasks pushed and not yet finished
+  std::atomic<std::size_t> pending_;
+  std::atomic<std::size_t> sleeping_;
+  std::atomic<std::size_t> next_queue_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  std::mutex complete_mutex_;
+  std::condition_variable completed_;
+  int numa_node_id_;
+
+ public:
+  explicit WorkStealingThreadPool(std::size_t pool_size, int numa_node_id = -1)
+      : running_(true),
+        queued_(0),
+        pending_(0),
+        sleeping_(0),
+        next_queue_(0),
+        numa_node_id_(numa_node_id) {
+    for (std::size_t i = 0; i < pool_size; ++i) {
+      queues_.emplace_back(new worker_queue_t());
+    }
+    for (std::size_t i = 0; i < pool_size; ++i) {
+      threads_.emplace_back(
+          std::bind(&WorkStealingThreadPool::main_loop, this, i));
+    }
+  }
+
+  // Set running flag to false then wake up all threads.
+  ~WorkStealingThreadPool() {
+    {
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      running_ = false;
+      wake_.notify_all();
+    }
+
+    try {
+      for (auto& t : threads_) {
+        t.join();
+      }
+    } catch (const std::exception&) {
+    }
+  }
+
+  template <typename Task>
+  void runTask(Task task) {
+    push(task_element_t(static_cast<std::function<void()>>(task)));
+  }
+
+  void run(const std::function<void()>& func) {
+    runTask(func);
+  }
+
+  template <typename Task>
+  void runTaskWithID(Task task) {
+    push(task_element_t(static_cast<std::function<void(std::size_t)>>(task)));
+  }
+
+  /// @brief Wait for all pushed tasks to finish
+  void waitWorkComplete() {
+    std::unique_lock<std::mutex> lock(complete_mutex_);
+    while (pending_ != 0) {
+      completed_.wait(lock);
+    }
+  }
+
+ private:
+  void push(task_element_t task) {
+    ++pending_;
+    worker_queue_t& queue = *queues_[next_queue_++ % queues_.size()];
+    {
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      queue.tasks.push_back(std::move(task));
+    }
+    ++queued_;
+    // A worker going to sleep registers in sleeping_ before it checks
+    // queued_ under sleep_mutex_, so either it sees this task or we see it.
+    if (sleeping_ > 0) {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      wake_.notify_one();
+    }
+  }
+
+  bool pop(std::size_t index, task_element_t* task) {
+    const std::size_t num_queues = queues_.size();
+    for (std::size_t i = 0; i < num_queues; ++i) {
+      worker_queue_t& queue = *queues_[(index + i) % num_queues];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.tasks.empty()) {
+        continue;
+      }
+      // our own queue is served in order, the others are stolen from
+      if (i == 0) {
+        *task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      } else {
+        *task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      }
+      --queued_;
+      return true;
+    }
+    return false;
+  }
+
+  /// @brief Entry point for pool threads.
+  void main_loop(std::size_t index) {
+    NUMABind(numa_node_id_);
+
+    task_element_t task(std::function<void()>(nullptr));
+    while (running_) {
+      if (!pop(index, &task)) {
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        ++sleeping_;
+        while (queued_ == 0 && running_) {
+          wake_.wait(lock);
+        }
+        --sleeping_;
+        continue;
+      }
+
+      // Run the task.
+      try {
+        if (task.run_with_id) {
+          task.with_id(index);
+        } else {
+          task.no_id();
+        }
+      } catch (const std::exception&) {
+      }
+      // Destroy the task now in case it holds shared_ptr arguments.
+      task = task_element_t(std::function<void()>(nullptr));
+
+      if (--pending_ == 0) {
+        std::lock_guard<std::mutex> lock(complete_mutex_);
+        completed_.notify_all();
+      }
+    } // while running_
+  }
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_UTILS_WORK_STEALING_THREAD_POOL_H_
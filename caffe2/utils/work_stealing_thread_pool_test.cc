@@ -0,0 +1,52 @@
+#include <atomic>
+#include <vector>
+
+#include "caffe2/utils/work_stealing_thread_pool.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+TEST(WorkStealingThreadPoolTest, RunsAllTasks) {
+  WorkStealingThreadPool pool(4);
+  std::atomic<int> sum(0);
+  for (int i = 0; i < 1000; ++i) {
+    pool.runTask([&sum, i]() { sum += i; });
+  }
+  pool.waitWorkComplete();
+  EXPECT_EQ(sum, 999 * 1000 / 2);
+}
+
+TEST(WorkStealingThreadPoolTest, PassesWorkerIndex) {
+  const int kNumThreads = 3;
+  WorkStealingThreadPool pool(kNumThreads);
+  std::vector<std::atomic<int>> per_thread(kNumThreads);
+  for (auto& count : per_thread) {
+    count = 0;
+  }
+  for (int i = 0; i < 300; ++i) {
+    pool.runTaskWithID([&per_thread](std::size_t index) {
+      ASSERT_LT(index, per_thread.size());
+      ++per_thread[index];
+    });
+  }
+  pool.waitWorkComplete();
+  int total = 0;
+  for (auto& count : per_thread) {
+    total += count;
+  }
+  EXPECT_EQ(total, 300);
+}
+
+TEST(WorkStealingThreadPoolTest, WaitsRepeatedly) {
+  WorkStealingThreadPool pool(2);
+  std::atomic<int> count(0);
+  for (int round = 0; round < 50; ++round) {
+    for (int i = 0; i < 10; ++i) {
+      pool.runTask([&count]() { ++count; });
+    }
+    pool.waitWorkComplete();
+    EXPECT_EQ(count, (round + 1) * 10);
+  }
+}
+
+} // namespace caffe2
@@ -84,7 +84,11 @@ class ZmqSocket {
   }
 
   int Send(const string& msg, int flags) {
-    int nbytes = zmq_send(ptr_, msg.c_str(), msg.size(), flags);
+    return Send(msg.c_str(), msg.size(), flags);
+  }
+
+  int Send(const void* data, size_t size, int flags) {
+    int nbytes = zmq_send(ptr_, data, size, flags);
     if (nbytes) {
       return nbytes;
     } else if (zmq_errno() == EAGAIN) {
@@ -97,10 +101,14 @@ class ZmqSocket {
   }
 
   int SendTillSuccess(const string& msg, int flags) {
-    CAFFE_ENFORCE(msg.size(), "You cannot send an empty message.");
+    return SendTillSuccess(msg.c_str(), msg.size(), flags);
+  }
+
+  int SendTillSuccess(const void* data, size_t size, int flags) {
+    CAFFE_ENFORCE(size, "You cannot send an empty message.");
     int nbytes = 0;
     do {
-      nbytes = Send(msg, flags);
+      nbytes = Send(data, size, flags);
     } while (nbytes == 0);
     return nbytes;
   }
@@ -126,6 +134,20 @@ class ZmqSocket {
     return nbytes;
   }
 
+  // whether the last message received has more parts
+  bool RecvMore() {
+    int more = 0;
+    size_t size = sizeof(more);
+    int rc = zmq_getsockopt(ptr_, ZMQ_RCVMORE, &more, &size);
+    CAFFE_ENFORCE_EQ(rc, 0);
+    return more != 0;
+  }
+
+  void SetOption(int option, int value) {
+    int rc = zmq_setsockopt(ptr_, option, &value, sizeof(value));
+    CAFFE_ENFORCE_EQ(rc, 0);
+  }
+
  private:
   ZmqContext context_;
   void* ptr_;
@@ -32,32 +32,43 @@
 
 namespace caffe2 {
 
+// Y = X * scale[c] + bias[c] for X of N x C x (any inner dims, e.g. TxHxW),
+// or of N x (any inner dims) x C with order NHWC
 template <typename T, class Context>
 class AffineNdOp final : public Operator<Context> {
  public:
   AffineNdOp(const OperatorDef& operator_def, Workspace* ws)
-      : Operator<Context>(operator_def, ws) {}
+      : Operator<Context>(operator_def, ws),
+        order_(StringToStorageOrder(
+            OperatorBase::template GetSingleArgument<string>(
+                "order", "NCHW"))) {}
   USE_OPERATOR_CONTEXT_FUNCTIONS;
+  bool RunOnDevice() override;
 
-  bool RunOnDevice() override {
-    // Lazy, not implementing the CPU version
-    CAFFE_NOT_IMPLEMENTED;
-    return true;
-  }
+  // the CUDA op also runs on float16 X (with scale and bias of the same type)
+  template <typename U>
+  bool DoRunWithType();
+
+ protected:
+  StorageOrder order_;
 };
 
 template <typename T, class Context>
 class AffineNdGradientOp final : public Operator<Context> {
  public:
   AffineNdGradientOp(const OperatorDef& def, Workspace* ws)
-      : Operator<Context>(def, ws) {}
+      : Operator<Context>(def, ws),
+        order_(StringToStorageOrder(
+            OperatorBase::template GetSingleArgument<string>(
+                "order", "NCHW"))) {}
   USE_OPERATOR_CONTEXT_FUNCTIONS;
+  bool RunOnDevice() override;
+
+  template <typename U>
+  bool DoRunWithType();
 
-  bool RunOnDevice() override {
-    // Lazy, not implementing the CPU version
-    CAFFE_NOT_IMPLEMENTED;
-    return true;
-  }
+ protected:
+  StorageOrder order_;
 };
 
 } // namespace caffe2
@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/bad_video_registry.h"
+
+#include <fstream>
+#include <unordered_map>
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+std::shared_ptr<BadVideoRegistry> BadVideoRegistry::Get(
+    const std::string& path) {
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::weak_ptr<BadVideoRegistry>>
+      registries;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto registry = registries[path].lock();
+  if (!registry) {
+    registry = std::make_shared<BadVideoRegistry>(path);
+    registries[path] = registry;
+  }
+  return registry;
+}
+
+BadVideoRegistry::BadVideoRegistry(const std::string& path) : path_(path) {
+  if (path_.empty()) {
+    return;
+  }
+  std::ifstream file(path_);
+  std::string key;
+  while (std::getline(file, key)) {
+    if (!key.empty()) {
+      keys_.insert(key);
+    }
+  }
+  if (!keys_.empty()) {
+    LOG(INFO) << "Skipping the " << keys_.size() << " bad videos of "
+              << path_;
+  }
+}
+
+bool BadVideoRegistry::Contains(const std::string& key) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return keys_.count(key) > 0;
+}
+
+bool BadVideoRegistry::Add(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!keys_.insert(key).second) {
+    return false;
+  }
+  ++num_added_;
+  // a key of several lines would come back as several keys
+  if (!path_.empty() && key.find('\n') == std::string::npos) {
+    std::ofstream file(path_, std::ios::app);
+    file << key << '\n';
+    if (!file) {
+      LOG(ERROR) << "Cannot add the bad video " << key << " to " << path_;
+    }
+  }
+  return true;
+}
+
+size_t BadVideoRegistry::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return keys_.size();
+}
+
+int64_t BadVideoRegistry::num_added() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_added_;
+}
+
+} // namespace caffe2
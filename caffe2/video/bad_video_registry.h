@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_BAD_VIDEO_REGISTRY_H_
+#define CAFFE2_VIDEO_BAD_VIDEO_REGISTRY_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+namespace caffe2 {
+
+// The videos that failed to decode, by key (the path of a local video or
+// the db key of a record), so the input ops skip them instead of decoding
+// them again every epoch. A registry with a path keeps the keys in that
+// file, one per line: it is loaded when the registry is made and every new
+// key is appended, so the videos stay known across restarts and to the
+// other processes that use the file. Thread safe.
+class BadVideoRegistry {
+ public:
+  // the registry of path, shared by the ops of the process
+  static std::shared_ptr<BadVideoRegistry> Get(const std::string& path);
+
+  // empty path for a registry that is not persisted
+  explicit BadVideoRegistry(const std::string& path);
+
+  BadVideoRegistry(const BadVideoRegistry&) = delete;
+  BadVideoRegistry& operator=(const BadVideoRegistry&) = delete;
+
+  bool Contains(const std::string& key) const;
+
+  // registers key, false if it was known already
+  bool Add(const std::string& key);
+
+  // the known bad videos, and those of them that Add() found in this process
+  size_t size() const;
+  int64_t num_added() const;
+
+  const std::string& path() const {
+    return path_;
+  }
+
+ private:
+  const std::string path_;
+  mutable std::mutex mutex_;
+  std::unordered_set<std::string> keys_;
+  int64_t num_added_ = 0;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_BAD_VIDEO_REGISTRY_H_
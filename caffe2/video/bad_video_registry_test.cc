@@ -0,0 +1,70 @@
+#include <unistd.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include "caffe2/video/bad_video_registry.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+std::string RegistryPath(const char* test) {
+  return std::string("/tmp/caffe2_bad_videos_") + test + "_" +
+      std::to_string(getpid());
+}
+
+} // namespace
+
+TEST(BadVideoRegistryTest, AddsKeys) {
+  BadVideoRegistry registry("");
+  EXPECT_FALSE(registry.Contains("/data/a.mp4"));
+  EXPECT_TRUE(registry.Add("/data/a.mp4"));
+  EXPECT_FALSE(registry.Add("/data/a.mp4"));
+  EXPECT_TRUE(registry.Contains("/data/a.mp4"));
+  EXPECT_FALSE(registry.Contains("/data/b.mp4"));
+  EXPECT_EQ(registry.size(), 1);
+  EXPECT_EQ(registry.num_added(), 1);
+}
+
+TEST(BadVideoRegistryTest, PersistsKeys) {
+  const std::string path = RegistryPath("persist");
+  std::remove(path.c_str());
+  {
+    BadVideoRegistry registry(path);
+    EXPECT_TRUE(registry.Add("/data/a.mp4"));
+    EXPECT_TRUE(registry.Add("00000042"));
+    // kept in memory only
+    EXPECT_TRUE(registry.Add("two\nlines"));
+  }
+  BadVideoRegistry registry(path);
+  EXPECT_TRUE(registry.Contains("/data/a.mp4"));
+  EXPECT_TRUE(registry.Contains("00000042"));
+  EXPECT_FALSE(registry.Contains("two"));
+  EXPECT_EQ(registry.size(), 2);
+  // found by an earlier run
+  EXPECT_EQ(registry.num_added(), 0);
+  EXPECT_FALSE(registry.Add("/data/a.mp4"));
+  std::ifstream file(path);
+  int lines = 0;
+  for (std::string line; std::getline(file, line);) {
+    ++lines;
+  }
+  EXPECT_EQ(lines, 2);
+  std::remove(path.c_str());
+}
+
+TEST(BadVideoRegistryTest, SharesRegistries) {
+  const std::string path = RegistryPath("share");
+  std::remove(path.c_str());
+  auto a = BadVideoRegistry::Get(path);
+  auto b = BadVideoRegistry::Get(path);
+  EXPECT_EQ(a.get(), b.get());
+  EXPECT_NE(a.get(), BadVideoRegistry::Get(path + ".other").get());
+  a->Add("/data/a.mp4");
+  EXPECT_TRUE(b->Contains("/data/a.mp4"));
+  std::remove(path.c_str());
+}
+
+} // namespace caffe2
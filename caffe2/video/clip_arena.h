@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_CLIP_ARENA_H_
+#define CAFFE2_VIDEO_CLIP_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace caffe2 {
+
+// Bump allocator for the buffers that only live while one clip is decoded
+// and transformed (e.g. the RGB frames of the decoder). Allocations are
+// 64 byte aligned and stay valid until the next Reset(), which releases
+// all of them at once but keeps the memory for the next clip. If a clip
+// needed more than one block, Reset() replaces the blocks with a single
+// one of the high-water size, so after the first few clips there is no
+// allocation at all.
+//
+// The arena is not thread safe; use one per decode thread through
+// ThreadLocalClipArena(). The reserved and high-water bytes of all the
+// arenas are exported as the clip_arena_reserved_bytes and
+// clip_arena_high_water_bytes stats of the "video_clip_arena" group.
+class ClipArena {
+ public:
+  ClipArena();
+  ~ClipArena();
+
+  void* Allocate(size_t nbytes);
+  void Reset();
+
+  // bytes handed out since the last Reset()
+  size_t bytes_in_use() const {
+    return bytes_in_use_;
+  }
+  // the most bytes in use between two Reset() calls so far
+  size_t high_water() const {
+    return high_water_;
+  }
+  // bytes held in blocks
+  size_t capacity() const;
+
+ private:
+  struct Block {
+    uint8_t* data;
+    size_t size;
+  };
+
+  void AddBlock(size_t nbytes);
+  void FreeBlocks();
+
+  std::vector<Block> blocks_;
+  // block we are allocating from and the first free byte in it
+  size_t current_block_;
+  size_t offset_;
+  size_t bytes_in_use_;
+  size_t high_water_;
+};
+
+ClipArena& ThreadLocalClipArena();
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_CLIP_ARENA_H_
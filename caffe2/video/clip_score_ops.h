@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_CLIP_SCORE_OPS_H_
+#define CAFFE2_VIDEO_CLIP_SCORE_OPS_H_
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/video/progressive_clip_scheduler.h"
+
+namespace caffe2 {
+
+// status of a clip in the second output of AccumulateClipScores
+constexpr int kClipSkipped = -1;
+constexpr int kClipAdded = 0;
+constexpr int kClipFinished = 1;
+
+// Adds the scores of every clip of a batch to the running average of its
+// video on the ClipScoreBoard `board`, and finishes the video once the top
+// two classes of the average are `margin` apart after at least `min_clips`
+// clips, or after `max_clips` clips.
+class AccumulateClipScoresOp final : public Operator<CPUContext> {
+ public:
+  USE_OPERATOR_FUNCTIONS(CPUContext);
+
+  AccumulateClipScoresOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws),
+        margin_(OperatorBase::GetSingleArgument<float>("margin", 0.f)),
+        min_clips_(OperatorBase::GetSingleArgument<int>("min_clips", 1)),
+        max_clips_(OperatorBase::GetSingleArgument<int>("max_clips", 0)) {
+    const std::string name =
+        OperatorBase::GetSingleArgument<std::string>("board", "");
+    CAFFE_ENFORCE(!name.empty(), "AccumulateClipScores needs a board.");
+    CAFFE_ENFORCE_GE(min_clips_, 1);
+    board_ = ClipScoreBoard::Get(name);
+  }
+
+  bool RunOnDevice() override {
+    const auto& scores = Input(0);
+    const auto& video_ids = Input(1);
+    CAFFE_ENFORCE_GE(scores.ndim(), 1);
+    const int num_clips = scores.dim32(0);
+    CAFFE_ENFORCE_EQ(video_ids.size(), num_clips);
+    const int num_classes = num_clips > 0 ? scores.size() / num_clips : 0;
+    CAFFE_ENFORCE_GE(num_classes, 2, "Margins need two classes.");
+
+    auto* average = Output(0);
+    auto* status = Output(1);
+    average->Resize(num_clips, num_classes);
+    status->Resize(num_clips);
+    const float* scores_data = scores.data<float>();
+    const int* video_id_data = video_ids.data<int>();
+    float* average_data = average->mutable_data<float>();
+    int* status_data = status->mutable_data<int>();
+    std::fill(average_data, average_data + average->size(), 0.f);
+    std::vector<float> top(2);
+    for (int i = 0; i < num_clips; ++i) {
+      // padding clips have no video
+      const int video_id = video_id_data[i];
+      float* clip_average = average_data + i * num_classes;
+      const int count = video_id < 0
+          ? 0
+          : board_->Add(
+                video_id,
+                scores_data + i * num_classes,
+                num_classes,
+                clip_average);
+      if (count == 0) {
+        status_data[i] = kClipSkipped;
+        continue;
+      }
+      std::partial_sort_copy(
+          clip_average,
+          clip_average + num_classes,
+          top.begin(),
+          top.end(),
+          std::greater<float>());
+      const bool confident =
+          margin_ > 0 && count >= min_clips_ && top[0] - top[1] >= margin_;
+      if (confident || (max_clips_ > 0 && count >= max_clips_)) {
+        board_->Finish(video_id);
+        status_data[i] = kClipFinished;
+      } else {
+        status_data[i] = kClipAdded;
+      }
+    }
+    return true;
+  }
+
+ private:
+  const float margin_;
+  const int min_clips_;
+  const int max_clips_;
+  std::shared_ptr<ClipScoreBoard> board_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_CLIP_SCORE_OPS_H_
@@ -0,0 +1,451 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CONV2PLUS1D_OP_H_
+#define CONV2PLUS1D_OP_H_
+
+#include <vector>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// mid = max(scale * pre + bias, 0) (no max without relu) of the C x HW
+// intermediate of a frame
+template <class Context>
+void Conv2Plus1DAffine(
+    const int C,
+    const int HW,
+    const float* scale,
+    const float* bias,
+    const bool relu,
+    const float* pre,
+    float* mid,
+    Context* context);
+
+// dmid (C x HW) to dpre in place, and adds the gradients of scale and bias
+template <class Context>
+void Conv2Plus1DAffineGradient(
+    const int C,
+    const int HW,
+    const float* scale,
+    const float* bias,
+    const bool relu,
+    const float* pre,
+    float* dmid,
+    float* dscale,
+    float* dbias,
+    Context* context);
+
+// The sizes of a Conv2Plus1D op on X (N x C x T x H x W), from its inputs
+// and arguments.
+struct Conv2Plus1DShape {
+  int N, C, T, H, W;
+  // the channels of the intermediate and of the output
+  int Cm, M;
+  int kt, kh, kw;
+  int To, Ho, Wo;
+
+  int HW() const {
+    return H * W;
+  }
+  int HoWo() const {
+    return Ho * Wo;
+  }
+  int col_rows() const {
+    return Cm * kh * kw;
+  }
+};
+
+// The arguments shared by Conv2Plus1D and its gradient.
+class Conv2Plus1DBase {
+ public:
+  explicit Conv2Plus1DBase(const OperatorBase& op)
+      : temporal_stride_(op.GetSingleArgument<int>("temporal_stride", 1)),
+        temporal_pad_(op.GetSingleArgument<int>("temporal_pad", 0)),
+        spatial_strides_(op.GetRepeatedArgument<int>(
+            "spatial_strides", std::vector<int>{1, 1})),
+        spatial_pads_(op.GetRepeatedArgument<int>(
+            "spatial_pads", std::vector<int>{0, 0, 0, 0})),
+        relu_(op.GetSingleArgument<int>("relu", 1)) {
+    CAFFE_ENFORCE_GT(temporal_stride_, 0);
+    CAFFE_ENFORCE_GE(temporal_pad_, 0);
+    CAFFE_ENFORCE_EQ(spatial_strides_.size(), 2, "spatial_strides is [h, w]");
+    CAFFE_ENFORCE_EQ(
+        spatial_pads_.size(), 4, "spatial_pads is [h, w, h_end, w_end]");
+  }
+
+  template <class Context>
+  Conv2Plus1DShape GetShape(
+      const Tensor<Context>& X,
+      const Tensor<Context>& Wt,
+      const Tensor<Context>& Ws) const {
+    CAFFE_ENFORCE_EQ(X.ndim(), 5, "Conv2Plus1D needs N x C x T x H x W");
+    CAFFE_ENFORCE_EQ(Wt.ndim(), 5);
+    CAFFE_ENFORCE_EQ(Ws.ndim(), 5);
+    Conv2Plus1DShape s;
+    s.N = X.dim32(0);
+    s.C = X.dim32(1);
+    s.T = X.dim32(2);
+    s.H = X.dim32(3);
+    s.W = X.dim32(4);
+    s.Cm = Wt.dim32(0);
+    s.M = Ws.dim32(0);
+    s.kt = Wt.dim32(2);
+    s.kh = Ws.dim32(3);
+    s.kw = Ws.dim32(4);
+    CAFFE_ENFORCE(
+        Wt.dim32(1) == s.C && Wt.dim32(3) == 1 && Wt.dim32(4) == 1,
+        "the temporal filters are Cm x C x kt x 1 x 1");
+    CAFFE_ENFORCE(
+        Ws.dim32(1) == s.Cm && Ws.dim32(2) == 1,
+        "the spatial filters are M x Cm x 1 x kh x kw");
+    s.To = (s.T + 2 * temporal_pad_ - s.kt) / temporal_stride_ + 1;
+    s.Ho = (s.H + spatial_pads_[0] + spatial_pads_[2] - s.kh) /
+            spatial_strides_[0] +
+        1;
+    s.Wo = (s.W + spatial_pads_[1] + spatial_pads_[3] - s.kw) /
+            spatial_strides_[1] +
+        1;
+    CAFFE_ENFORCE(s.To > 0 && s.Ho > 0 && s.Wo > 0, "empty output");
+    return s;
+  }
+
+  // whether the spatial conv reads the intermediate as is, without im2col
+  bool PointwiseSpatial(const Conv2Plus1DShape& s) const {
+    return s.kh == 1 && s.kw == 1 && spatial_strides_[0] == 1 &&
+        spatial_strides_[1] == 1 && spatial_pads_[0] == 0 &&
+        spatial_pads_[1] == 0 && spatial_pads_[2] == 0 &&
+        spatial_pads_[3] == 0;
+  }
+
+  // the input frame of output frame t and temporal tap k, or -1 in the pads
+  int InputFrame(const Conv2Plus1DShape& s, const int t, const int k) const {
+    const int t_in = t * temporal_stride_ - temporal_pad_ + k;
+    return t_in < 0 || t_in >= s.T ? -1 : t_in;
+  }
+
+ protected:
+  // pre = sum_k Wt[:, :, k] * X[n, :, t_in(t, k)], the temporal conv of
+  // frame t of clip n; wt is Wt as kt x Cm x C
+  template <class Context>
+  void TemporalConv(
+      const Conv2Plus1DShape& s,
+      const float* Xn,
+      const float* wt,
+      const int t,
+      float* pre,
+      Context* context) const {
+    bool first = true;
+    for (int k = 0; k < s.kt; ++k) {
+      const int t_in = InputFrame(s, t, k);
+      if (t_in < 0) {
+        continue;
+      }
+      math::GemmEx<float, Context>(
+          CblasNoTrans, CblasNoTrans, s.Cm, s.HW(), s.C, 1.f,
+          wt + k * s.Cm * s.C, s.C, Xn + t_in * s.HW(), s.T * s.HW(),
+          first ? 0.f : 1.f, pre, s.HW(), context);
+      first = false;
+    }
+    if (first) {
+      math::Set<float, Context>(s.Cm * s.HW(), 0.f, pre, context);
+    }
+  }
+
+  // the columns of the spatial conv of the intermediate of a frame
+  template <class Context>
+  const float* SpatialColumns(
+      const Conv2Plus1DShape& s,
+      const float* mid,
+      float* col,
+      Context* context) const {
+    if (PointwiseSpatial(s)) {
+      return mid;
+    }
+    math::Im2col<float, Context, StorageOrder::NCHW>(
+        mid, s.Cm, s.H, s.W, s.kh, s.kw, 1, 1, spatial_pads_[0],
+        spatial_pads_[1], spatial_pads_[2], spatial_pads_[3],
+        spatial_strides_[0], spatial_strides_[1], col, context);
+    return col;
+  }
+
+  // Wt (Cm x C x kt) as kt x Cm x C, so that a tap is a GEMM operand
+  template <class Context>
+  void TapMajor(
+      const Conv2Plus1DShape& s,
+      const float* Wt,
+      float* wt,
+      Context* context) const {
+    const int x_dims[2] = {s.Cm * s.C, s.kt};
+    const int y_dims[2] = {s.kt, s.Cm * s.C};
+    const int axes[2] = {1, 0};
+    math::Transpose<float, Context>(
+        2, x_dims, y_dims, axes, s.Cm * s.C * s.kt, Wt, wt, context);
+  }
+
+  int temporal_stride_;
+  int temporal_pad_;
+  std::vector<int> spatial_strides_;
+  std::vector<int> spatial_pads_;
+  bool relu_;
+};
+
+// A factorized (2+1)D conv, the temporal kt x 1 x 1 conv of an I3D block,
+// the per-channel affine (frozen or folded BN) and relu after it, and the
+// spatial 1 x kh x kw conv, in one op:
+//   Y = Ws * relu(scale * (Wt * X) + bias) + bs.
+// Inputs: X (N x C x T x H x W), Wt (Cm x C x kt x 1 x 1), scale and bias
+// (Cm), Ws (M x Cm x 1 x kh x kw) and optionally bs (M). The op goes frame
+// by frame: the Cm x H x W intermediate of a frame is made and read back
+// right away from a one frame workspace, so it stays in cache instead of
+// making a round trip through memory as a N x Cm x T x H x W blob. The
+// gradient makes it again the same way.
+template <typename T, class Context>
+class Conv2Plus1DOp final : public Operator<Context>, Conv2Plus1DBase {
+ public:
+  Conv2Plus1DOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        Conv2Plus1DBase(static_cast<const OperatorBase&>(*this)) {}
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+
+  bool RunOnDevice() override {
+    const auto& X = Input(0);
+    const auto& Wt = Input(1);
+    const auto& scale = Input(2);
+    const auto& bias = Input(3);
+    const auto& Ws = Input(4);
+    const auto s = GetShape(X, Wt, Ws);
+    CAFFE_ENFORCE_EQ(scale.size(), s.Cm);
+    CAFFE_ENFORCE_EQ(bias.size(), s.Cm);
+    const bool has_bias = InputSize() == 6;
+    auto* Y = Output(0);
+    Y->Resize(std::vector<TIndex>{s.N, s.M, s.To, s.Ho, s.Wo});
+
+    wt_.Resize(s.kt, s.Cm, s.C);
+    TapMajor(s, Wt.template data<float>(), wt_.template mutable_data<float>(),
+             &context_);
+    pre_.Resize(s.Cm, s.HW());
+    mid_.Resize(s.Cm, s.HW());
+    col_.Resize(s.col_rows(), s.HoWo());
+    if (has_bias) {
+      CAFFE_ENFORCE_EQ(Input(5).size(), s.M);
+      ones_.Resize(s.HoWo());
+      math::Set<float, Context>(
+          s.HoWo(), 1.f, ones_.template mutable_data<float>(), &context_);
+    }
+    for (int n = 0; n < s.N; ++n) {
+      const float* Xn =
+          X.template data<float>() + n * s.C * s.T * s.HW();
+      float* Yn = Y->template mutable_data<float>() +
+          n * s.M * s.To * s.HoWo();
+      for (int t = 0; t < s.To; ++t) {
+        float* pre = pre_.template mutable_data<float>();
+        float* mid = mid_.template mutable_data<float>();
+        TemporalConv(s, Xn, wt_.template data<float>(), t, pre, &context_);
+        Conv2Plus1DAffine<Context>(
+            s.Cm, s.HW(), scale.template data<float>(),
+            bias.template data<float>(), relu_, pre, mid, &context_);
+        const float* col = SpatialColumns(
+            s, mid, col_.template mutable_data<float>(), &context_);
+        // frame t of the M output channels, To * HoWo apart
+        math::GemmEx<float, Context>(
+            CblasNoTrans, CblasNoTrans, s.M, s.HoWo(), s.col_rows(), 1.f,
+            Ws.template data<float>(), s.col_rows(), col, s.HoWo(), 0.f,
+            Yn + t * s.HoWo(), s.To * s.HoWo(), &context_);
+        if (has_bias) {
+          math::GemmEx<float, Context>(
+              CblasNoTrans, CblasNoTrans, s.M, s.HoWo(), 1, 1.f,
+              Input(5).template data<float>(), 1,
+              ones_.template data<float>(), s.HoWo(), 1.f,
+              Yn + t * s.HoWo(), s.To * s.HoWo(), &context_);
+        }
+      }
+    }
+    return true;
+  }
+
+ protected:
+  Tensor<Context> wt_;
+  Tensor<Context> pre_;
+  Tensor<Context> mid_;
+  Tensor<Context> col_;
+  Tensor<Context> ones_;
+};
+
+// Inputs: X, Wt, scale, bias, Ws, [bs], dY. Outputs: dX, dWt, dscale,
+// dbias, dWs, [dbs].
+template <typename T, class Context>
+class Conv2Plus1DGradientOp final : public Operator<Context>,
+                                    Conv2Plus1DBase {
+ public:
+  Conv2Plus1DGradientOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        Conv2Plus1DBase(static_cast<const OperatorBase&>(*this)) {}
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+
+  bool RunOnDevice() override {
+    const bool has_bias = InputSize() == 7;
+    const auto& X = Input(0);
+    const auto& Wt = Input(1);
+    const auto& scale = Input(2);
+    const auto& bias = Input(3);
+    const auto& Ws = Input(4);
+    const auto& dY = Input(has_bias ? 6 : 5);
+    const auto s = GetShape(X, Wt, Ws);
+    CAFFE_ENFORCE_EQ(dY.size(), s.N * s.M * s.To * s.HoWo());
+
+    auto* dX = Output(0);
+    auto* dWt = Output(1);
+    auto* dscale = Output(2);
+    auto* dbias = Output(3);
+    auto* dWs = Output(4);
+    dX->ResizeLike(X);
+    dWt->ResizeLike(Wt);
+    dscale->ResizeLike(scale);
+    dbias->ResizeLike(bias);
+    dWs->ResizeLike(Ws);
+    math::Set<float, Context>(
+        dX->size(), 0.f, dX->template mutable_data<float>(), &context_);
+    math::Set<float, Context>(
+        s.Cm, 0.f, dscale->template mutable_data<float>(), &context_);
+    math::Set<float, Context>(
+        s.Cm, 0.f, dbias->template mutable_data<float>(), &context_);
+    math::Set<float, Context>(
+        dWs->size(), 0.f, dWs->template mutable_data<float>(), &context_);
+    float* dbs = nullptr;
+    if (has_bias) {
+      auto* dbs_tensor = Output(5);
+      dbs_tensor->Resize(s.M);
+      dbs = dbs_tensor->template mutable_data<float>();
+      math::Set<float, Context>(s.M, 0.f, dbs, &context_);
+    }
+
+    wt_.Resize(s.kt, s.Cm, s.C);
+    dwt_.Resize(s.kt, s.Cm, s.C);
+    const float* wt = wt_.template mutable_data<float>();
+    float* dwt = dwt_.template mutable_data<float>();
+    TapMajor(s, Wt.template data<float>(), wt_.template mutable_data<float>(),
+             &context_);
+    math::Set<float, Context>(dwt_.size(), 0.f, dwt, &context_);
+    pre_.Resize(s.Cm, s.HW());
+    mid_.Resize(s.Cm, s.HW());
+    col_.Resize(s.col_rows(), s.HoWo());
+    dcol_.Resize(s.col_rows(), s.HoWo());
+    ones_.Resize(s.HoWo());
+    math::Set<float, Context>(
+        s.HoWo(), 1.f, ones_.template mutable_data<float>(), &context_);
+    const bool pointwise = PointwiseSpatial(s);
+
+    for (int n = 0; n < s.N; ++n) {
+      const float* Xn =
+          X.template data<float>() + n * s.C * s.T * s.HW();
+      float* dXn = dX->template mutable_data<float>() + n * s.C * s.T * s.HW();
+      const float* dYn =
+          dY.template data<float>() + n * s.M * s.To * s.HoWo();
+      for (int t = 0; t < s.To; ++t) {
+        float* pre = pre_.template mutable_data<float>();
+        float* mid = mid_.template mutable_data<float>();
+        TemporalConv(s, Xn, wt, t, pre, &context_);
+        Conv2Plus1DAffine<Context>(
+            s.Cm, s.HW(), scale.template data<float>(),
+            bias.template data<float>(), relu_, pre, mid, &context_);
+        const float* col = SpatialColumns(
+            s, mid, col_.template mutable_data<float>(), &context_);
+        const float* dYt = dYn + t * s.HoWo();
+
+        // the spatial conv: dWs, dbs and the gradient of the columns
+        math::GemmEx<float, Context>(
+            CblasNoTrans, CblasTrans, s.M, s.col_rows(), s.HoWo(), 1.f, dYt,
+            s.To * s.HoWo(), col, s.HoWo(), 1.f,
+            dWs->template mutable_data<float>(), s.col_rows(), &context_);
+        if (has_bias) {
+          math::GemmEx<float, Context>(
+              CblasNoTrans, CblasNoTrans, s.M, 1, s.HoWo(), 1.f, dYt,
+              s.To * s.HoWo(), ones_.template data<float>(), 1, 1.f, dbs, 1,
+              &context_);
+        }
+        // dmid goes to the workspace of mid, which is done
+        float* dcol = pointwise ? mid : dcol_.template mutable_data<float>();
+        math::GemmEx<float, Context>(
+            CblasTrans, CblasNoTrans, s.col_rows(), s.HoWo(), s.M, 1.f,
+            Ws.template data<float>(), s.col_rows(), dYt, s.To * s.HoWo(),
+            0.f, dcol, s.HoWo(), &context_);
+        if (!pointwise) {
+          math::Col2im<float, Context, StorageOrder::NCHW>(
+              dcol, s.Cm, s.H, s.W, s.kh, s.kw, 1, 1, spatial_pads_[0],
+              spatial_pads_[1], spatial_pads_[2], spatial_pads_[3],
+              spatial_strides_[0], spatial_strides_[1], mid, &context_);
+        }
+
+        // the affine and relu: dmid to dpre
+        Conv2Plus1DAffineGradient<Context>(
+            s.Cm, s.HW(), scale.template data<float>(),
+            bias.template data<float>(), relu_, pre, mid,
+            dscale->template mutable_data<float>(),
+            dbias->template mutable_data<float>(), &context_);
+
+        // the temporal conv: dWt and dX of the input frames of the taps
+        for (int k = 0; k < s.kt; ++k) {
+          const int t_in = InputFrame(s, t, k);
+          if (t_in < 0) {
+            continue;
+          }
+          math::GemmEx<float, Context>(
+              CblasNoTrans, CblasTrans, s.Cm, s.C, s.HW(), 1.f, mid, s.HW(),
+              Xn + t_in * s.HW(), s.T * s.HW(), 1.f,
+              dwt + k * s.Cm * s.C, s.C, &context_);
+          math::GemmEx<float, Context>(
+              CblasTrans, CblasNoTrans, s.C, s.HW(), s.Cm, 1.f,
+              wt + k * s.Cm * s.C, s.C, mid, s.HW(), 1.f,
+              dXn + t_in * s.HW(), s.T * s.HW(), &context_);
+        }
+      }
+    }
+    // kt x Cm x C back to Cm x C x kt
+    const int x_dims[2] = {s.kt, s.Cm * s.C};
+    const int y_dims[2] = {s.Cm * s.C, s.kt};
+    const int axes[2] = {1, 0};
+    math::Transpose<float, Context>(
+        2, x_dims, y_dims, axes, dWt->size(), dwt,
+        dWt->template mutable_data<float>(), &context_);
+    return true;
+  }
+
+ protected:
+  Tensor<Context> wt_;
+  Tensor<Context> dwt_;
+  Tensor<Context> pre_;
+  Tensor<Context> mid_;
+  Tensor<Context> col_;
+  Tensor<Context> dcol_;
+  Tensor<Context> ones_;
+};
+
+} // namespace caffe2
+
+#endif // CONV2PLUS1D_OP_H_
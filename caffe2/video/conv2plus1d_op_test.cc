@@ -0,0 +1,174 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/operator_gradient.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/conv2plus1d_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// a 3 x 1 x 1 conv with temporal stride 2 of a 2 x 3 x 5 x 5 x 4 input to
+// 2 channels, then a 1 x 3 x 3 conv with asymmetric pads to 3 channels
+constexpr int kN = 2;
+constexpr int kC = 3;
+constexpr int kT = 5;
+constexpr int kH = 5;
+constexpr int kW = 4;
+constexpr int kCm = 2;
+constexpr int kM = 3;
+
+void AddRandomInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<TIndex>& dims,
+    const int seed) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  for (int i = 0; i < tensor->size(); ++i) {
+    tensor->mutable_data<float>()[i] = dist(gen);
+  }
+}
+
+OperatorDef MakeOp(
+    const std::string& type,
+    const std::vector<std::string>& inputs,
+    const std::string& output) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  def.add_output(output);
+  return def;
+}
+
+// the separate ops: Conv, AffineNd, Relu, Conv
+std::vector<OperatorDef> SeparateOps() {
+  auto temporal = MakeOp("Conv", {"X", "Wt"}, "pre");
+  temporal.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("kernels", {3, 1, 1}));
+  temporal.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("strides", {2, 1, 1}));
+  temporal.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("pads", {1, 0, 0, 1, 0, 0}));
+  auto spatial = MakeOp("Conv", {"mid", "Ws", "bs"}, "Y_ref");
+  spatial.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("kernels", {1, 3, 3}));
+  spatial.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("strides", {1, 1, 2}));
+  spatial.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("pads", {0, 1, 1, 0, 1, 0}));
+  return {temporal,
+          MakeOp("AffineNd", {"pre", "scale", "bias"}, "z"),
+          MakeOp("Relu", {"z"}, "mid"),
+          spatial};
+}
+
+OperatorDef FusedOp() {
+  auto def = MakeOp(
+      "Conv2Plus1D", {"X", "Wt", "scale", "bias", "Ws", "bs"}, "Y");
+  def.add_arg()->CopyFrom(MakeArgument<int>("temporal_stride", 2));
+  def.add_arg()->CopyFrom(MakeArgument<int>("temporal_pad", 1));
+  def.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("spatial_strides", {1, 2}));
+  def.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("spatial_pads", {1, 1, 1, 0}));
+  return def;
+}
+
+void AddInputs(Workspace* ws) {
+  AddRandomInput(ws, "X", {kN, kC, kT, kH, kW}, 1);
+  AddRandomInput(ws, "Wt", {kCm, kC, 3, 1, 1}, 2);
+  AddRandomInput(ws, "scale", {kCm}, 3);
+  AddRandomInput(ws, "bias", {kCm}, 4);
+  AddRandomInput(ws, "Ws", {kM, kCm, 1, 3, 3}, 5);
+  AddRandomInput(ws, "bs", {kM}, 6);
+}
+
+const TensorCPU& Get(Workspace* ws, const std::string& name) {
+  return ws->GetBlob(name)->Get<TensorCPU>();
+}
+
+void ExpectNear(const TensorCPU& actual, const TensorCPU& expected,
+                const std::string& name) {
+  ASSERT_EQ(actual.dims(), expected.dims()) << name;
+  for (int i = 0; i < actual.size(); ++i) {
+    EXPECT_NEAR(actual.data<float>()[i], expected.data<float>()[i], 1e-4)
+        << name << " " << i;
+  }
+}
+
+} // namespace
+
+TEST(Conv2Plus1DOpTest, MatchesSeparateOps) {
+  Workspace ws;
+  AddInputs(&ws);
+  for (const auto& def : SeparateOps()) {
+    ASSERT_TRUE(CreateOperator(def, &ws)->Run());
+  }
+  ASSERT_TRUE(CreateOperator(FusedOp(), &ws)->Run());
+  ExpectNear(Get(&ws, "Y"), Get(&ws, "Y_ref"), "Y");
+  EXPECT_EQ(Get(&ws, "Y").dims(), (std::vector<TIndex>{kN, kM, 3, 5, 2}));
+}
+
+TEST(Conv2Plus1DOpTest, GradientMatchesSeparateOps) {
+  Workspace ws;
+  AddInputs(&ws);
+  const auto separate = SeparateOps();
+  for (const auto& def : separate) {
+    ASSERT_TRUE(CreateOperator(def, &ws)->Run());
+  }
+  AddRandomInput(&ws, "Y_ref_grad", Get(&ws, "Y_ref").dims(), 7);
+  for (auto it = separate.rbegin(); it != separate.rend(); ++it) {
+    GradientWrapper dY;
+    dY.dense_ = it->output(0) + "_grad";
+    const auto meta = GetGradientForOp(*it, {dY});
+    for (const auto& grad_def : meta.ops_) {
+      ASSERT_TRUE(CreateOperator(grad_def, &ws)->Run());
+    }
+  }
+
+  const auto fused = FusedOp();
+  ASSERT_TRUE(CreateOperator(fused, &ws)->Run());
+  ws.CreateBlob("Y_grad")->GetMutable<TensorCPU>()->CopyFrom(
+      Get(&ws, "Y_ref_grad"));
+  GradientWrapper dY;
+  dY.dense_ = "Y_grad";
+  auto meta = GetGradientForOp(fused, {dY});
+  ASSERT_EQ(meta.ops_.size(), 1);
+  auto& grad_def = meta.ops_[0];
+  ASSERT_EQ(grad_def.output_size(), 6);
+  for (int i = 0; i < grad_def.output_size(); ++i) {
+    grad_def.set_output(i, grad_def.output(i) + "_fused");
+  }
+  ASSERT_TRUE(CreateOperator(grad_def, &ws)->Run());
+
+  for (const std::string name : {"X", "Wt", "Ws", "bs"}) {
+    ExpectNear(
+        Get(&ws, name + "_grad_fused"), Get(&ws, name + "_grad"), name);
+  }
+  // the affine is frozen in AffineNd: its gradients from z_grad and pre
+  const auto& z_grad = Get(&ws, "z_grad");
+  const auto& pre = Get(&ws, "pre");
+  const int plane = pre.size() / (kN * kCm);
+  std::vector<double> dscale(kCm), dbias(kCm);
+  for (int i = 0; i < pre.size(); ++i) {
+    const int c = i / plane % kCm;
+    dscale[c] += z_grad.data<float>()[i] * pre.data<float>()[i];
+    dbias[c] += z_grad.data<float>()[i];
+  }
+  for (int c = 0; c < kCm; ++c) {
+    EXPECT_NEAR(
+        Get(&ws, "scale_grad_fused").data<float>()[c], dscale[c], 1e-4);
+    EXPECT_NEAR(Get(&ws, "bias_grad_fused").data<float>()[c], dbias[c], 1e-4);
+  }
+}
+
+} // namespace caffe2
@@ -26,26 +26,68 @@
 #define CUSTOMIZED_VIDEO_INPUT_OP_H_
 
 #include <iostream>
+#include <iterator>
+#include <list>
+#include <mutex>
 #include <random>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <cstdlib>
 #include <ctime>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
 
 
 #include <opencv2/opencv.hpp>
 
 #include "caffe2/core/db.h"
 #include "caffe2/core/logging.h"
+#include "caffe2/core/numa.h"
+#include "caffe2/core/static_tracepoint.h"
+#include "caffe2/core/stats.h"
+#include "caffe2/core/timer.h"
 #include "caffe2/operators/prefetch_op.h"
 #include "caffe2/utils/math.h"
+#include "caffe2/utils/cast.h"
 #include "caffe2/utils/thread_pool.h"
+#include "caffe2/utils/timeline.h"
+#include "caffe2/utils/cpu_budget_pool.h"
+#include "caffe2/utils/parallel_for.h"
+#include "caffe2/utils/work_stealing_thread_pool.h"
 // #include "caffe2/video/video_io.h"
+#include "caffe2/video/bad_video_registry.h"
+#include "caffe2/video/customized_video_decoder.h"
 #include "caffe2/video/customized_video_io.h"
+#include "caffe2/video/customized_video_transform_gpu.h"
+#include "caffe2/video/decode_cost_model.h"
+#include "caffe2/video/decode_thread_controller.h"
+#include "caffe2/video/nvjpeg_clip_decoder.h"
+#include "caffe2/video/progressive_clip_scheduler.h"
+#include "caffe2/video/remote_video_store.h"
+#include "caffe2/video/shared_clip_cache.h"
+#include "caffe2/video/shared_frame_cache.h"
+#include "caffe2/video/video_meta_index.h"
+#include "caffe2/video/video_record.h"
+#include "caffe2/video/video_stats.h"
 
 namespace caffe2 {
 
+// NUMA node local to the device an op runs on, -1 if unknown. The CUDA
+// version is in customized_video_input_op_gpu.cc.
+template <class Context>
+int GetDeviceNUMANode(const DeviceOption& option);
+
+template <>
+int GetDeviceNUMANode<CPUContext>(const DeviceOption& option);
+
 template <class Context>
 class CustomizedVideoInputOp final : public PrefetchOperator<Context> {
  public:
@@ -56,6 +98,8 @@ class CustomizedVideoInputOp final : public PrefetchOperator<Context> {
     const OperatorDef& operator_def, Workspace* ws);
   ~CustomizedVideoInputOp() {
     PrefetchOperator<Context>::Finalize();
+    // the shared pool outlives us, our tasks in it must not
+    decode_tasks_.Wait();
   }
 
   // override methods
@@ -64,32 +108,227 @@ class CustomizedVideoInputOp final : public PrefetchOperator<Context> {
 
  private:
   bool GetClipAndLabelFromDBValue(
-      const std::string& value,
-      float*& buffer,
+      const VideoRecord& record,
+      const int length,
+      const int sampling_rate,
+      std::vector<unsigned char>& buffer,
       int* label_data,
-      std::mt19937* randgen,
+      PhiloxRandom* randgen,
       int & height,
       int & width);
 
-  void DecodeAndTransform(
-      const std::string value,
+  // the labels of a db record
+  void GetLabelFromDBValue(const VideoRecord& record, int* label_data);
+
+  // use_nvjpeg: read the encoded frames of the clip of a record, and pick
+  // its scaled size and crop offsets (geometry, see JpegClipBatch) and
+  // mirror flag, for DecodeJpegClipsOnGPU
+  bool ReadJpegClip(
+      const VideoRecord& record,
+      int* label_data,
+      const int length,
+      const int sampling_rate,
+      const int crop_size,
+      PhiloxRandom* randgen,
+      std::bernoulli_distribution* mirror_this_clip,
+      std::vector<std::string>* frames,
+      int* geometry,
+      int* mirror_data);
+
+  // declared with the decode pipeline below
+  struct DecodingBatch;
+
+  // use_nvjpeg: pack the frames of a decoded batch into the staging buffer
+  // of prefetched_jpeg_
+  void PackJpegClips(DecodingBatch* decoded);
+
+  // video id and (temporal, spatial) clip index of the num_views clips of
+  // a db record, for the output_clip_index outputs
+  void GetClipIndexFromDBValue(
+      const VideoRecord& record,
+      const int num_views,
+      int* video_id,
+      int* clip_index);
+
+  // look up / store a decoded clip shared by the spatial crops of a clip
+  bool GetCachedClip(
+      const std::string& key,
+      std::vector<unsigned char>& buffer,
+      int& height,
+      int& width);
+
+  void CacheClip(
+      const std::string& key,
+      const std::vector<unsigned char>& buffer,
+      const int height,
+      const int width);
+
+  // false if the video yields no clip
+  bool DecodeAndTransform(
+      const VideoRecord& record,
       float* clip_data,
       int* label_data,
       const int crop_size,
+      const int length,
+      const int sampling_rate,
       const bool mirror,
       const float mean,
       const float std,
-      std::mt19937* randgen,
+      PhiloxRandom* randgen,
       std::bernoulli_distribution* mirror_this_clip,
       int* height_out,
-      int* width_out);
+      int* width_out,
+      std::vector<unsigned char>* buffer,
+      unsigned char* cropped_clip_data,
+      int* mirror_data);
+
+  // CPU op: the float clips of a prefetched batch to an output, in order_
+  void CopyClip(const TensorCPU& clip, Tensor<Context>* output);
+
+  // the clip of a pathway, every pathway_steps_[pathway]-th frame of the
+  // N x C x T x H x W clips
+  void GetPathwayClip(
+      const TensorCPU& clip,
+      const int pathway,
+      TensorCPU* pathway_clip);
+
+  // decode a video once and write all of its test views, clip slot by
+  // clip slot for every spatial crop, into num_views_ consecutive items
+  bool DecodeAndTransformViews(
+      const VideoRecord& record,
+      float* clip_data,
+      int* label_data,
+      PhiloxRandom* randgen,
+      std::bernoulli_distribution* mirror_this_clip,
+      std::vector<std::vector<unsigned char>>* buffers);
+
+  // the shape of the clips of a batch
+  struct ClipShape {
+    int batch_size;
+    int length;
+    int crop;
+    int sampling_rate;
+  };
+
+  // A batch on its way through the decode pipeline: the staging tensors the
+  // decode workers write to, their per-item scratch buffers, and the number
+  // of items that are still being decoded.
+  struct DecodingBatch {
+    TensorCPU clip;
+    TensorCPU label;
+    TensorCPU mirror;
+    TensorCPU video_id;
+    TensorCPU clip_index;
+    // the db records of the batch: views into the db where the reader
+    // supports them, otherwise into the copies in values
+    std::vector<const char*> value_data;
+    std::vector<size_t> value_size;
+    std::vector<std::string> values;
+    std::vector<std::string> keys;
+    // per-item planar uint8 clips, reused across batches
+    std::vector<std::vector<unsigned char>> clip_buffers;
+    // per-record clips of all clip slots in expand_test_views_ mode
+    std::vector<std::vector<std::vector<unsigned char>>> view_clip_buffers;
+    // use_nvjpeg: per-item encoded frames, and their geometry
+    std::vector<std::vector<std::string>> jpeg_frames;
+    TensorCPU jpeg_geometry;
+    // only useful for crop_ <= 0
+    std::vector<float*> list_clip_data;
+    std::vector<int> list_height_out;
+    std::vector<int> list_width_out;
+    // schedule_by_cost: the work units of the items, see DecodeCostModel
+    std::vector<double> cost_units;
+    ClipShape shape;
+    // the random index of the first item, see random_seed_
+    uint64_t first_item_index = 0;
+    bool submitted = false;
+    int num_pending = 0;
+    std::mutex mutex;
+    std::condition_variable done;
+
+    ~DecodingBatch() {
+      for (float* data : list_clip_data) {
+        delete[] data;
+      }
+    }
+  };
+
+  // read the records of a batch and queue one decode task per record
+  void SubmitBatch(DecodingBatch* batch);
+  // schedule_by_cost: the order to queue the first num_items items of a
+  // batch in, by decreasing estimated decode time
+  std::vector<int> CostOrder(DecodingBatch* batch, int num_items);
+  // clip_shapes: the shape of the next batch of the schedule
+  ClipShape NextClipShape();
+  // clip_shapes: resize the staging tensors of a batch to its shape, within
+  // buffers that hold the largest batch of the schedule
+  void ResizeBatch(DecodingBatch* batch);
+  // progressive_test: fill the records of a batch with the views of
+  // progressive_scheduler_, scheduled views first, and write the outputs of
+  // the padding after them. Returns the number of views to decode.
+  int ScheduleProgressiveBatch(DecodingBatch* batch);
+  // decode one record of a batch on a decode thread and count it down
+  void DecodeItem(DecodingBatch* batch, int item_id, std::size_t thread_index);
+  // read the next record of the db into an item, on a decode thread
+  void ReadItem(DecodingBatch* batch, int item_id, std::size_t thread_index);
+  void WaitBatch(DecodingBatch* batch);
+  // take the next decoded batch from the decode pipeline
+  DecodingBatch* NextDecodedBatch();
+  // adaptive_decode_threads: feed the waits of the last batch to
+  // decode_controller_ and apply what it decides
+  void AdaptDecodeThreads();
+
+  // crop_ <= 0: move the decoded clips of a batch into their size buckets
+  void BucketUncroppedClips(DecodingBatch* decoded);
+  // crop_ <= 0: fill prefetched_clip_ and prefetched_label_ from a bucket
+  void EmitUncroppedBatch();
 
   const db::DBReader* reader_;
+  // read the records in the decode threads, each through a part reader of
+  // its own over a disjoint share of the records of the reader, instead of
+  // the whole batch under the lock of the shared reader
+  bool parallel_reads_;
+  std::vector<std::unique_ptr<db::DBReader>> part_readers_;
   CPUContext cpu_context_;
   TensorCPU prefetched_clip_;
   TensorCPU prefetched_label_;
+  // per-clip mirror flags for the GPU transform
+  TensorCPU prefetched_mirror_;
+  // per-clip video id, and temporal and spatial clip index, with
+  // output_clip_index
+  TensorCPU prefetched_video_id_;
+  TensorCPU prefetched_clip_index_;
   Tensor<Context> prefetched_clip_on_device_;
   Tensor<Context> prefetched_label_on_device_;
+  Tensor<Context> prefetched_mirror_on_device_;
+  Tensor<Context> prefetched_video_id_on_device_;
+  Tensor<Context> prefetched_clip_index_on_device_;
+  // The host tensors come from the pinned CPU allocator once CUDA is in
+  // use, so the device copy of a batch is issued asynchronously on a stream
+  // of its own (copy_context_) and CopyPrefetched waits on copied_event.
+  // PrefetchWorker's FinishDeviceComputation() then no longer waits for the
+  // copy, and the prefetch thread is ready as soon as decoding is done.
+  Context copy_context_;
+  // One finished batch per prefetch slot. Prefetch() fills the tensors
+  // above and swaps them into its slot; a host buffer is only reused after
+  // CopyPrefetched has waited for its device copy.
+  struct PrefetchedClips {
+    TensorCPU clip;
+    TensorCPU label;
+    TensorCPU mirror;
+    TensorCPU video_id;
+    TensorCPU clip_index;
+    Tensor<Context> clip_on_device;
+    Tensor<Context> label_on_device;
+    Tensor<Context> mirror_on_device;
+    Tensor<Context> video_id_on_device;
+    Tensor<Context> clip_index_on_device;
+    std::vector<TensorCPU> pathway_clips;
+    std::vector<Tensor<Context>> pathway_clips_on_device;
+    JpegClipBatch jpeg;
+    std::unique_ptr<Event> copied_event;
+  };
+  std::vector<PrefetchedClips> prefetched_batches_;
   int batch_size_;
   float mean_;
   float std_;
@@ -109,6 +348,21 @@ class CustomizedVideoInputOp final : public PrefetchOperator<Context> {
 
   // thread pool for parse + decode
   int num_decode_threads_;
+  // adaptive_decode_threads: the pools have a thread for each of the
+  // max_decode_threads, and decode_gate_ lets as many of them decode as
+  // decode_controller_ wants, which also sets the depth of the prefetch ring
+  std::unique_ptr<DecodeThreadController> decode_controller_;
+  DecodeGate decode_gate_;
+  Timer prefetch_cycle_timer_;
+  bool prefetch_cycle_started_;
+  // schedule_by_cost: queue the decode tasks of a batch longest first, by
+  // the estimates of cost_model_, rather than in db order. The items keep
+  // their slots and random streams, so the batches are the same. The slow
+  // videos start first, and the threads that finish early take the short
+  // items, then the longest ones of the next batch, which is queued before
+  // this one is waited for.
+  bool schedule_by_cost_;
+  DecodeCostModel cost_model_;
 
   // extra attributes follow
   int use_bgr_;
@@ -120,7 +374,232 @@ class CustomizedVideoInputOp final : public PrefetchOperator<Context> {
   int sample_times_;
   int use_multi_crop_;
 
+  // seek to the clip window instead of decoding the whole video
+  bool use_selective_decoding_;
+
+  // do the scale augmentation in the decoder's colour conversion pass
+  bool use_decoder_scaling_;
+
+  // keep the decoder contexts of the last file open in each decode thread
+  bool use_decoder_cache_;
+
+  // allocate the decoded frames of a clip from a per-thread ClipArena
+  bool use_frame_arena_;
+
+  // read buffer of FFmpeg, 0 for the default
+  int io_buffer_size_;
+  // read local files through a memory mapping
+  bool use_mmap_;
+  // ask the kernel to read the local files of a batch ahead while its
+  // records are queued for decoding
+  bool readahead_files_;
+  // let selective decoding skip the non-reference frames between the
+  // sampled frames
+  bool skip_nonref_frames_;
+  // sample the clips at this frame rate instead of the videos' own, so that
+  // sampling_rate spans the same time in every video. 0 to disable
+  float target_fps_;
+  // threads of the codec of each decoded video. With decode_cpu_budget > 0
+  // it is the share of the budget left to each of the decode_threads.
+  int codec_threads_;
+  int decode_cpu_budget_;
+  TensorProtos readahead_protos_;
+
+  // in multi-crop testing, decode every clip of a video once and cut all
+  // of its spatial crops from the same decoded clip
+  bool reuse_multi_crop_clips_;
+  struct CachedClip {
+    std::string key;
+    std::vector<unsigned char> data;
+    int height;
+    int width;
+  };
+  // most recently decoded first
+  std::list<CachedClip> cached_clips_;
+  std::mutex cached_clips_mutex_;
+
+  // expand each db record into sample_times_ clips x the spatial crops of
+  // use_multi_crop_, instead of reading one record per test view
+  bool expand_test_views_;
+  int num_views_;
+
+  // DecodeBackend used for the video streams ("software" or "cuvid")
+  std::string decode_backend_name_;
+  DecodeBackend decode_backend_;
+  // DecodeQuality of the training clips ("full" or "fast"), test clips are
+  // always decoded in full
+  std::string decode_quality_name_;
+  DecodeQuality decode_quality_;
+
+  // meta data of the local video files, looked up for the records that do
+  // not carry their own, so the clip can be placed before decoding
+  std::string video_meta_index_path_;
+  VideoMetaIndex video_meta_index_;
+  // open the videos with stream meta data without avformat_find_stream_info,
+  // for containers whose header describes the video stream (e.g. mp4, mkv)
+  bool skip_stream_info_;
+  // with >= 0, the jittered clips of the videos with key frames in their
+  // meta data start within this many frames after a key frame
+  int key_frame_jitter_;
+
+  // decoded frames shared by the processes of a node, for the clips that
+  // can be placed before decoding
+  std::string frame_cache_name_;
+  std::unique_ptr<SharedFrameCache> frame_cache_;
+  // decoded clips shared by the processes of a node, for the clips that do
+  // not depend on the random generator (e.g. the test clips)
+  std::string clip_cache_name_;
+  std::shared_ptr<SharedClipCache> clip_cache_;
+
+  // the videos that failed to decode (bad_video_list). Training skips them
+  // for the next records of the db, and the op fails once more than
+  // max_bad_videos_ (-1 for any number) have failed in it
+  std::shared_ptr<BadVideoRegistry> bad_videos_;
+  int max_bad_videos_;
+  bool replace_bad_videos_;
+  std::atomic<int64_t> num_bad_videos_{0};
+
+  // reads the local files that are http:// urls from an object store, in
+  // blocks kept in an LRU cache, and prefetches the videos of the batches
+  // that are queued for decoding
+  std::shared_ptr<RemoteVideoStore> remote_store_;
+
+  // also output the video id (the label of a test db) and the clip index
+  // of every clip, so results can be matched up in any order
+  bool output_clip_index_;
+
+  // multi-pathway models (pathway_lengths, pathway_sampling_rates): the
+  // clips are decoded and transformed once, at the gcd of the sampling
+  // rates and long enough for every pathway, and the clip of pathway k is
+  // every pathway_steps_[k]-th frame of it, with the same start, crop and
+  // mirror. Output 0 is the clip of pathway 0, the clips of the other
+  // pathways follow all the other outputs from first_pathway_output_ on.
+  std::vector<int> pathway_lengths_;
+  std::vector<int> pathway_steps_;
+  int first_pathway_output_;
+  std::vector<TensorCPU> prefetched_pathway_clips_;
+  std::vector<Tensor<Context>> prefetched_pathway_clips_on_device_;
+  // multigrid training (clip_shapes, clip_shape_iters): the batches take
+  // their (batch size, length, crop) from a schedule that repeats every
+  // shape for its number of batches, and cycles through the shapes. A
+  // shorter clip is sampled at a higher rate, so that every clip spans the
+  // frames of length x sampling_rate. The staging buffers are allocated for
+  // the largest batch of the schedule on their first batch, and only
+  // resized later.
+  std::vector<ClipShape> clip_shapes_;
+  std::vector<int> clip_shape_iters_;
+  int clip_shape_index_;
+  int clip_shape_count_;
+  int max_clip_size_;
+  int max_batch_size_;
+
+  // progressive_test: test the views of every video in the order of their
+  // coverage, one view per video in turn, and stop scheduling the views of
+  // the videos that the AccumulateClipScores ops on score_board finish
+  std::unique_ptr<ProgressiveClipScheduler> progressive_scheduler_;
+
+  // copy the cropped clips to the device as uint8, then mirror, reorder the
+  // channels and normalize them there. The CPU op outputs the uint8 clips
+  // and, as its last output, the mirror flags instead, for the GPU of
+  // another node to transform them (see ZmqClipInput).
+  bool gpu_transform_;
+  // with gpu_transform_, decode the frames to I420 instead of RGB and
+  // convert them on the GPU: the cropped clips are half the bytes of RGB,
+  // and swscale only scales them
+  bool gpu_yuv_transform_;
+  // with gpu_transform_ and use_image_, only read the JPEG frames of the
+  // clips on the decode threads, and copy them to the device encoded:
+  // nvJPEG decodes them there, and a kernel scales and crops them before
+  // the GPU transform. prefetched_jpeg_ is the pinned staging copy.
+  bool use_nvjpeg_;
+  std::shared_ptr<NvJpegClipDecoder> nvjpeg_decoder_;
+  JpegClipBatch prefetched_jpeg_;
+  // clip output of the GPU transform: FLOAT, FLOAT16, or UINT8 for clips
+  // that are only mirrored and reordered, to be normalized by the model
+  TensorProto_DataType output_type_;
+  // NCHW outputs the clips as N x C x T x H x W, NHWC as N x T x H x W x C
+  // for the channels last nets
+  StorageOrder order_;
+
+  // Prefetch() queues the next batch before it waits for the current one,
+  // so the decode threads go straight on to it instead of idling while the
+  // slowest video of the batch finishes.
+  std::unique_ptr<DecodingBatch> decoding_batches_[2];
+  int decoding_index_;
+  // item i of the read sequence of the op, counting from 0 over all
+  // batches, is augmented with PhiloxRandom(random_seed_, random_stream_, i)
+  // whatever decode thread takes it and in whatever order. The seed is the
+  // random_seed of the device option, if set, and the stream the gpu id, so
+  // that the input ops of the gpus draw apart.
+  const uint64_t random_seed_;
+  const uint32_t random_stream_;
+  uint64_t next_item_index_;
+  // protobuf db records are parsed into the message of their decode
+  // thread; parsing again into the same message reuses its strings, such as
+  // an in-db video. Header records are read in place.
+  std::vector<TensorProtos> protos_per_thread_;
+
+  // crop_ <= 0: every video keeps its own output size, so decoded clips
+  // wait in a bucket per size until the bucket holds a batch. Once
+  // bucket_buffer_size_ clips are waiting, the bucket of the oldest clip goes
+  // out padded with all-zero clips. The label output names the video of
+  // each clip, and is -1 for padding.
+  struct UncroppedClip {
+    int64_t sequence;
+    std::vector<float> data;
+    std::vector<int> label;
+    int video_id;
+    int clip_index[2];
+  };
+  std::map<std::pair<int, int>, std::deque<UncroppedClip>> uncropped_buckets_;
+  int num_bucketed_clips_;
+  int64_t next_clip_sequence_;
+  int bucket_buffer_size_;
+
+  struct VideoInputStats {
+    CAFFE_STAT_CTOR(VideoInputStats);
+    // records read from the db but not decoded yet
+    CAFFE_EXPORTED_STAT(decode_queue_balance);
+    // batches decoded and not yet taken by CopyPrefetched
+    CAFFE_EXPORTED_STAT(prefetched_batch_balance);
+    CAFFE_AVG_EXPORTED_STAT(batch_wait_time_ns);
+    // time of the stages of a clip, summed over the decode threads; the
+    // decode time includes the sws_scale time of video_decoder/sws_time_ns
+    CAFFE_AVG_EXPORTED_STAT(db_read_time_ns);
+    CAFFE_AVG_EXPORTED_STAT(parse_time_ns);
+    CAFFE_AVG_EXPORTED_STAT(decode_time_ns);
+    CAFFE_AVG_EXPORTED_STAT(transform_time_ns);
+    CAFFE_AVG_EXPORTED_STAT(prefetch_time_ns);
+    // the same stages as histograms, see video_stats.h
+    CAFFE_LATENCY_HISTOGRAM_STAT(batch_wait_latency);
+    CAFFE_LATENCY_HISTOGRAM_STAT(db_read_latency);
+    CAFFE_LATENCY_HISTOGRAM_STAT(decode_latency);
+    CAFFE_LATENCY_HISTOGRAM_STAT(transform_latency);
+    CAFFE_LATENCY_HISTOGRAM_STAT(prefetch_latency);
+    // bytes of the db records, and of the batches copied to the device
+    CAFFE_EXPORTED_STAT(db_bytes_read);
+    CAFFE_EXPORTED_STAT(h2d_bytes);
+    // videos that failed to decode, and known bad records skipped for the
+    // next ones
+    CAFFE_EXPORTED_STAT(bad_videos_found);
+    CAFFE_EXPORTED_STAT(bad_videos_skipped);
+    // adaptive_decode_threads: the decode threads and prefetch slots in use
+    CAFFE_EXPORTED_STAT(active_decode_threads);
+    CAFFE_EXPORTED_STAT(active_prefetch_depth);
+  } stats_;
+
+  // NUMA node the decode threads, the prefetch thread and the staging
+  // buffers are bound to with bind_to_device_numa, -1 for no binding
+  int numa_node_;
+  bool prefetch_thread_bound_;
+  // run the decode tasks on the process-wide CpuBudgetPool of numa_node_,
+  // within its decode share, instead of a pool of our own
+  std::shared_ptr<CpuBudgetPool> cpu_budget_pool_;
+  CpuTaskGroup decode_tasks_;
+  // run the decode tasks on a WorkStealingThreadPool instead
+  bool use_work_stealing_pool_;
   std::shared_ptr<TaskThreadPool> thread_pool_;
+  std::shared_ptr<WorkStealingThreadPool> work_stealing_pool_;
 };
 
 template <class Context>
@@ -129,6 +608,11 @@ CustomizedVideoInputOp<Context>::CustomizedVideoInputOp(
     Workspace* ws)
     : PrefetchOperator<Context>(operator_def, ws),
       reader_(nullptr),
+      parallel_reads_(
+          OperatorBase::template GetSingleArgument<int>(
+            "parallel_reads", 0)),
+      copy_context_(operator_def.device_option()),
+      prefetched_batches_(this->prefetch_depth_),
       batch_size_(
           OperatorBase::template GetSingleArgument<int>("batch_size", 0)),
       mean_(OperatorBase::template GetSingleArgument<float>("mean", 0.)),
@@ -152,8 +636,17 @@ CustomizedVideoInputOp<Context>::CustomizedVideoInputOp(
       is_test_(OperatorBase::template GetSingleArgument<int>("is_test", 0)),
       im_extension_(
           OperatorBase::template GetSingleArgument<string>("im_extension", "")),
-      num_decode_threads_(
-          OperatorBase::template GetSingleArgument<int>("decode_threads", 4)),
+      num_decode_threads_(std::max(
+          OperatorBase::template GetSingleArgument<int>("decode_threads", 4),
+          OperatorBase::template GetSingleArgument<int>(
+              "adaptive_decode_threads", 0)
+              ? OperatorBase::template GetSingleArgument<int>(
+                    "max_decode_threads", 0)
+              : 0)),
+      prefetch_cycle_started_(false),
+      schedule_by_cost_(
+          OperatorBase::template GetSingleArgument<int>(
+            "schedule_by_cost", 0)),
       use_bgr_(OperatorBase::template GetSingleArgument<int>("use_bgr", 0)),
       min_size_(OperatorBase::template GetSingleArgument<int>("min_size", 256)),
       max_size_(OperatorBase::template GetSingleArgument<int>("max_size", 480)),
@@ -164,9 +657,150 @@ CustomizedVideoInputOp<Context>::CustomizedVideoInputOp(
           OperatorBase::template GetSingleArgument<int>("sample_times", 10)),
       use_multi_crop_(
           OperatorBase::template GetSingleArgument<int>("use_multi_crop", 0)),
-
-      thread_pool_(new TaskThreadPool(num_decode_threads_)) {
+      use_selective_decoding_(
+          OperatorBase::template GetSingleArgument<int>(
+            "use_selective_decoding", 0)),
+      use_decoder_scaling_(
+          OperatorBase::template GetSingleArgument<int>(
+            "use_decoder_scaling", 0)),
+      use_decoder_cache_(
+          OperatorBase::template GetSingleArgument<int>(
+            "use_decoder_cache", 0)),
+      use_frame_arena_(
+          OperatorBase::template GetSingleArgument<int>(
+            "use_frame_arena", 0)),
+      io_buffer_size_(
+          OperatorBase::template GetSingleArgument<int>(
+            "io_buffer_size", 0)),
+      use_mmap_(
+          OperatorBase::template GetSingleArgument<int>("use_mmap", 0)),
+      readahead_files_(
+          OperatorBase::template GetSingleArgument<int>(
+            "readahead_files", 0)),
+      skip_nonref_frames_(
+          OperatorBase::template GetSingleArgument<int>(
+            "skip_nonref_frames", 0)),
+      target_fps_(
+          OperatorBase::template GetSingleArgument<float>("target_fps", 0)),
+      codec_threads_(
+          OperatorBase::template GetSingleArgument<int>("codec_threads", 1)),
+      decode_cpu_budget_(
+          OperatorBase::template GetSingleArgument<int>(
+            "decode_cpu_budget", 0)),
+      reuse_multi_crop_clips_(
+          OperatorBase::template GetSingleArgument<int>(
+            "reuse_multi_crop_clips", 0)),
+      expand_test_views_(
+          OperatorBase::template GetSingleArgument<int>(
+            "expand_test_views", 0)),
+      num_views_(1),
+      decode_backend_name_(
+          OperatorBase::template GetSingleArgument<string>(
+            "decode_backend", "software")),
+      decode_backend_(SOFTWARE_DECODE),
+      decode_quality_name_(
+          OperatorBase::template GetSingleArgument<string>(
+            "decode_quality", "full")),
+      decode_quality_(FULL_QUALITY),
+      video_meta_index_path_(
+          OperatorBase::template GetSingleArgument<string>(
+            "video_meta_index", "")),
+      skip_stream_info_(
+          OperatorBase::template GetSingleArgument<int>(
+            "skip_stream_info", 0)),
+      key_frame_jitter_(
+          OperatorBase::template GetSingleArgument<int>(
+            "key_frame_jitter", -1)),
+      frame_cache_name_(
+          OperatorBase::template GetSingleArgument<string>(
+            "frame_cache_name", "")),
+      clip_cache_name_(
+          OperatorBase::template GetSingleArgument<string>(
+            "clip_cache_name", "")),
+      max_bad_videos_(
+          OperatorBase::template GetSingleArgument<int>(
+            "max_bad_videos", -1)),
+      output_clip_index_(
+          OperatorBase::template GetSingleArgument<int>(
+            "output_clip_index", 0)),
+      gpu_transform_(
+          OperatorBase::template GetSingleArgument<int>(
+            "use_gpu_transform", 0)),
+      gpu_yuv_transform_(
+          OperatorBase::template GetSingleArgument<int>(
+            "use_gpu_yuv_transform", 0)),
+      use_nvjpeg_(
+          OperatorBase::template GetSingleArgument<int>("use_nvjpeg", 0)),
+      output_type_(
+          cast::GetCastDataType(ArgumentHelper(operator_def), "output_type")),
+      order_(StringToStorageOrder(
+          OperatorBase::template GetSingleArgument<string>("order", "NCHW"))),
+      decoding_index_(0),
+      random_seed_(
+          operator_def.device_option().has_random_seed()
+              ? operator_def.device_option().random_seed()
+              : RandomNumberSeed()),
+      random_stream_(operator_def.device_option().cuda_gpu_id()),
+      next_item_index_(0),
+      num_bucketed_clips_(0),
+      next_clip_sequence_(0),
+      bucket_buffer_size_(
+          OperatorBase::template GetSingleArgument<int>(
+            "bucket_buffer_size", 0)),
+      stats_(operator_def.output(0)),
+      numa_node_(
+          OperatorBase::template GetSingleArgument<int>(
+            "bind_to_device_numa", 0) ?
+          GetDeviceNUMANode<Context>(operator_def.device_option()) : -1),
+      prefetch_thread_bound_(false),
+      cpu_budget_pool_(
+          OperatorBase::template GetSingleArgument<int>(
+            "use_cpu_budget_pool", 0) ? GetCpuBudgetPool(numa_node_)
+          : nullptr),
+      use_work_stealing_pool_(
+          OperatorBase::template GetSingleArgument<int>(
+            "use_work_stealing_pool", 0)),
+      thread_pool_(
+          use_work_stealing_pool_ || cpu_budget_pool_ ? nullptr :
+          new TaskThreadPool(num_decode_threads_, numa_node_)),
+      work_stealing_pool_(
+          use_work_stealing_pool_ && !cpu_budget_pool_ ?
+          new WorkStealingThreadPool(num_decode_threads_, numa_node_)
+          : nullptr) {
   CAFFE_ENFORCE_GT(batch_size_, 0, "Batch size should be nonnegative.");
+  pathway_lengths_ =
+      OperatorBase::template GetRepeatedArgument<int>("pathway_lengths");
+  if (!pathway_lengths_.empty()) {
+    const std::vector<int> rates =
+        OperatorBase::template GetRepeatedArgument<int>(
+            "pathway_sampling_rates");
+    CAFFE_ENFORCE_EQ(
+        pathway_lengths_.size(),
+        rates.size(),
+        "Need a sampling rate for every pathway.");
+    CAFFE_ENFORCE(
+        crop_ > 0 && !gpu_transform_,
+        "The pathways are cut from the cropped float clips.");
+    // the clip that is decoded, sampled at the gcd of the rates
+    sampling_rate_ = 0;
+    for (int rate : rates) {
+      CAFFE_ENFORCE_GT(rate, 0, "Pathway sampling rates must be positive.");
+      int gcd = sampling_rate_;
+      while (rate > 0) {
+        const int remainder = gcd % rate;
+        gcd = rate;
+        rate = remainder;
+      }
+      sampling_rate_ = gcd;
+    }
+    length_ = 0;
+    for (int k = 0; k < pathway_lengths_.size(); k++) {
+      CAFFE_ENFORCE_GT(pathway_lengths_[k], 0, "Pathway lengths must be set.");
+      pathway_steps_.push_back(rates[k] / sampling_rate_);
+      length_ = std::max(
+          length_, (pathway_lengths_[k] - 1) * pathway_steps_.back() + 1);
+    }
+  }
   // CAFFE_ENFORCE_GE(scale_h_, 0, "Must provide the scale value.");
   // CAFFE_ENFORCE_GE(scale_w_, 0, "Must provide the cropping value.");
   CAFFE_ENFORCE_GT(length_, 0, "Must provide the clip length value.");
@@ -186,19 +820,312 @@ CustomizedVideoInputOp<Context>::CustomizedVideoInputOp(
         0,
         "Number of labels must be set for using multiple label output.");
   }
+  if (reuse_multi_crop_clips_) {
+    CAFFE_ENFORCE(
+        is_test_ && use_multi_crop_ > 0 && !temporal_jitter_,
+        "Decoded clips can only be reused in multi-crop testing.");
+  }
+  if (expand_test_views_) {
+    CAFFE_ENFORCE(
+        is_test_ && !temporal_jitter_,
+        "Test views can only be expanded for testing.");
+    CAFFE_ENFORCE_GT(crop_, 0, "Expanding test views needs a crop size.");
+    CAFFE_ENFORCE(
+        use_local_file_ && !use_image_,
+        "Expanding test views is only implemented for local video files.");
+    const int num_crops =
+        use_multi_crop_ == 1 ? 3 : (use_multi_crop_ == 2 ? 6 : 1);
+    num_views_ = sample_times_ * num_crops;
+    CAFFE_ENFORCE_EQ(
+        batch_size_ % num_views_,
+        0,
+        "Batch size must be a multiple of the ",
+        num_views_,
+        " views of a video.");
+  }
+  if (OperatorBase::template GetSingleArgument<int>("progressive_test", 0)) {
+    CAFFE_ENFORCE(
+        is_test_ && !temporal_jitter_ && !expand_test_views_,
+        "A progressive test reads one record per test view.");
+    CAFFE_ENFORCE_GT(crop_, 0, "A progressive test needs a crop size.");
+    CAFFE_ENFORCE(
+        output_clip_index_,
+        "A progressive test outputs the video ids of its clips.");
+    CAFFE_ENFORCE(
+        !parallel_reads_,
+        "A progressive test reads the views of a video in one batch.");
+    const std::string board =
+        OperatorBase::template GetSingleArgument<string>("score_board", "");
+    CAFFE_ENFORCE(!board.empty(), "A progressive test needs a score_board.");
+    const int num_crops =
+        use_multi_crop_ == 1 ? 3 : (use_multi_crop_ == 2 ? 6 : 1);
+    const int window = OperatorBase::template GetSingleArgument<int>(
+        "progressive_window", 0);
+    // the videos whose next views wait for the scores of their last ones
+    progressive_scheduler_.reset(new ProgressiveClipScheduler(
+        sample_times_ * num_crops,
+        window > 0 ? window : 4 * batch_size_,
+        ClipScoreBoard::Get(board)));
+  }
+  const std::string bad_video_list =
+      OperatorBase::template GetSingleArgument<string>("bad_video_list", "");
+  bad_videos_ = bad_video_list.empty()
+      ? std::make_shared<BadVideoRegistry>("")
+      : BadVideoRegistry::Get(bad_video_list);
+  // test views are scheduled by record and keep their video ids
+  replace_bad_videos_ = !is_test_ && !progressive_scheduler_;
+  if (decode_backend_name_ == "cuvid") {
+    decode_backend_ = CUVID_DECODE;
+  } else {
+    CAFFE_ENFORCE_EQ(
+        decode_backend_name_,
+        "software",
+        "Unknown decode_backend, use software or cuvid.");
+  }
+  if (decode_quality_name_ == "fast") {
+    decode_quality_ = is_test_ ? FULL_QUALITY : FAST_QUALITY;
+  } else {
+    CAFFE_ENFORCE_EQ(
+        decode_quality_name_,
+        "full",
+        "Unknown decode_quality, use full or fast.");
+  }
+  if (!video_meta_index_path_.empty()) {
+    CAFFE_ENFORCE(
+        use_local_file_, "The video meta index is keyed by local file path.");
+    CAFFE_ENFORCE(
+        video_meta_index_.Open(video_meta_index_path_),
+        "Cannot read the video meta index ",
+        video_meta_index_path_);
+  }
+  if (!frame_cache_name_.empty()) {
+    CAFFE_ENFORCE(
+        use_local_file_, "The frame cache is keyed by local file path.");
+    CAFFE_ENFORCE(
+        !(use_scale_augmentaiton_ && use_decoder_scaling_),
+        "The frame cache holds unscaled frames, so it cannot be used with "
+        "use_decoder_scaling.");
+    const size_t cache_size_mb =
+        OperatorBase::template GetSingleArgument<int>(
+            "frame_cache_size_mb", 4096);
+    const size_t cache_frame_bytes =
+        OperatorBase::template GetSingleArgument<int>(
+            "frame_cache_frame_bytes", 640 * 480 * 3);
+    frame_cache_.reset(new SharedFrameCache(
+        frame_cache_name_, cache_size_mb << 20, cache_frame_bytes));
+  }
+  if (!clip_cache_name_.empty()) {
+    CAFFE_ENFORCE(
+        use_local_file_ && !use_image_,
+        "The clip cache is keyed by local video file path.");
+    const size_t cache_size_mb =
+        OperatorBase::template GetSingleArgument<int>(
+            "clip_cache_size_mb", 4096);
+    // a 32 frame clip of 256 x 456 frames
+    const size_t cache_clip_bytes =
+        OperatorBase::template GetSingleArgument<int>(
+            "clip_cache_clip_bytes", 32 * 256 * 456 * 3);
+    clip_cache_ = GetSharedClipCache(
+        clip_cache_name_, cache_size_mb << 20, cache_clip_bytes);
+  }
+  if (OperatorBase::template GetSingleArgument<int>("remote_files", 0)) {
+    CAFFE_ENFORCE(
+        use_local_file_ && !use_image_,
+        "Remote files are the videos of use_local_file.");
+    RemoteVideoStore::Options options;
+    options.cache_dir = OperatorBase::template GetSingleArgument<std::string>(
+        "remote_cache_dir", "");
+    options.cache_bytes =
+        int64_t(OperatorBase::template GetSingleArgument<int>(
+            "remote_cache_mb", 1024))
+        << 20;
+    options.block_size = OperatorBase::template GetSingleArgument<int>(
+                             "remote_block_kb", 512)
+        << 10;
+    options.connections = OperatorBase::template GetSingleArgument<int>(
+        "remote_connections", 8);
+    options.prefetch_threads = OperatorBase::template GetSingleArgument<int>(
+        "remote_prefetch_threads", 4);
+    options.prefetch_blocks = OperatorBase::template GetSingleArgument<int>(
+        "remote_prefetch_blocks", 2);
+    // the ops of all the gpus share the connections and the cache
+    remote_store_ = RemoteVideoStore::Get(options);
+  }
+  if (gpu_transform_) {
+    CAFFE_ENFORCE_GT(crop_, 0, "The GPU transform needs a crop size.");
+    CAFFE_ENFORCE(
+        use_scale_augmentaiton_ && use_decoder_scaling_ && !expand_test_views_,
+        "The GPU transform needs use_decoder_scaling.");
+  }
+  if (gpu_yuv_transform_) {
+    CAFFE_ENFORCE(gpu_transform_, "use_gpu_yuv_transform needs the GPU one.");
+    CAFFE_ENFORCE(!use_image_, "Frames of images are RGB.");
+    CAFFE_ENFORCE_EQ(crop_ % 2, 0, "I420 clips need an even crop size.");
+  }
+  if (use_nvjpeg_) {
+    CAFFE_ENFORCE(
+        gpu_transform_ && !gpu_yuv_transform_ && use_image_ &&
+            use_local_file_,
+        "use_nvjpeg decodes the local frames of use_image on the GPU, for "
+        "use_gpu_transform.");
+    CAFFE_ENFORCE(
+        !OperatorBase::template GetSingleArgument<int>("progressive_test", 0),
+        "use_nvjpeg decodes full batches.");
+    nvjpeg_decoder_ =
+        CreateNvJpegClipDecoder<Context>(operator_def.device_option());
+  }
+  CAFFE_ENFORCE(
+      output_type_ == TensorProto_DataType_FLOAT ||
+          output_type_ == TensorProto_DataType_FLOAT16 ||
+          output_type_ == TensorProto_DataType_UINT8,
+      "output_type can be FLOAT, FLOAT16 or UINT8.");
+  CAFFE_ENFORCE(
+      gpu_transform_ || output_type_ == TensorProto_DataType_FLOAT,
+      "Only use_gpu_transform can output FLOAT16 or UINT8 clips.");
+  CAFFE_ENFORCE(
+      order_ == StorageOrder::NCHW || gpu_transform_ ||
+          (std::is_same<Context, CPUContext>::value),
+      "The CUDA op needs use_gpu_transform to output NHWC clips.");
   if (crop_ <= 0){  // not cropping
     CAFFE_ENFORCE_EQ(
         is_test_,
         1,
         "Cannot use spatial uncrop at training.");
+    if (bucket_buffer_size_ <= 0) {
+      bucket_buffer_size_ = 4 * batch_size_;
+    }
+    CAFFE_ENFORCE_GE(
+        bucket_buffer_size_,
+        batch_size_,
+        "bucket_buffer_size must hold at least one batch.");
+  }
+  const std::vector<int> shapes =
+      OperatorBase::template GetRepeatedArgument<int>("clip_shapes");
+  clip_shape_iters_ =
+      OperatorBase::template GetRepeatedArgument<int>("clip_shape_iters");
+  clip_shape_index_ = 0;
+  clip_shape_count_ = 0;
+  max_clip_size_ = batch_size_ * length_ * std::max(crop_, 0) *
+      std::max(crop_, 0) * 3;
+  max_batch_size_ = batch_size_;
+  if (!shapes.empty()) {
+    CAFFE_ENFORCE(
+        !is_test_ && crop_ > 0 && pathway_lengths_.empty(),
+        "Clip shapes are for training on cropped clips of one pathway.");
+    CAFFE_ENFORCE_EQ(
+        shapes.size() % 3,
+        0,
+        "clip_shapes are (batch size, length, crop) triples.");
+    const int num_shapes = shapes.size() / 3;
+    if (clip_shape_iters_.size() == 1) {
+      clip_shape_iters_.resize(num_shapes, clip_shape_iters_[0]);
+    }
+    CAFFE_ENFORCE_EQ(
+        clip_shape_iters_.size(),
+        num_shapes,
+        "Need the number of batches of every clip shape, or one for all.");
+    for (int k = 0; k < num_shapes; k++) {
+      ClipShape shape;
+      shape.batch_size = shapes[3 * k];
+      shape.length = shapes[3 * k + 1];
+      shape.crop = shapes[3 * k + 2];
+      CAFFE_ENFORCE(
+          shape.batch_size > 0 && shape.length > 0 && shape.crop > 0,
+          "Clip shapes must be positive.");
+      CAFFE_ENFORCE_GT(clip_shape_iters_[k], 0);
+      CAFFE_ENFORCE(
+          !gpu_yuv_transform_ || shape.crop % 2 == 0,
+          "I420 clips need an even crop size.");
+      // the temporal span of the clips of length x sampling_rate
+      shape.sampling_rate = std::max<int>(
+          1, std::lround(float(sampling_rate_) * length_ / shape.length));
+      clip_shapes_.push_back(shape);
+      max_clip_size_ = std::max(
+          max_clip_size_,
+          shape.batch_size * shape.length * shape.crop * shape.crop * 3);
+      max_batch_size_ = std::max(max_batch_size_, shape.batch_size);
+    }
   }
 
   // Always need a dbreader, even when using local video files
   CAFFE_ENFORCE_GT(
       operator_def.input_size(), 0, "Need to have a DBReader blob input");
+  first_pathway_output_ = output_clip_index_ ? 4 : 2;
+  CAFFE_ENFORCE_EQ(
+      OutputSize(),
+      first_pathway_output_ +
+          (gpu_transform_ && std::is_same<Context, CPUContext>::value) +
+          std::max<int>(0, pathway_lengths_.size() - 1),
+      "output_clip_index adds the video id and clip index outputs, the "
+      "CPU op with use_gpu_transform the mirror flags, and every pathway "
+      "after the first its clip.");
+  prefetched_pathway_clips_.resize(pathway_lengths_.size());
+  prefetched_pathway_clips_on_device_.resize(pathway_lengths_.size());
+
+  CAFFE_ENFORCE_GE(codec_threads_, 0, "codec_threads 0 means per core.");
+  CAFFE_ENFORCE(
+      target_fps_ <= 0 || !use_image_,
+      "target_fps needs the timestamps of videos, not folders of frames.");
+  if (cpu_budget_pool_) {
+    // the per-thread state is per worker of the shared pool, and its decode
+    // share is all the cores decoding gets: one thread per codec
+    num_decode_threads_ = cpu_budget_pool_->size();
+    codec_threads_ = 1;
+  } else if (decode_cpu_budget_ > 0) {
+    // clips in flight cost a clip buffer each, threads of a codec do not,
+    // so the budget left over by the clip level goes to the codecs
+    codec_threads_ = std::max(1, decode_cpu_budget_ / num_decode_threads_);
+  }
+
+  if (OperatorBase::template GetSingleArgument<int>(
+          "adaptive_decode_threads", 0)) {
+    CAFFE_ENFORCE(
+        !this->no_prefetch_,
+        "adaptive_decode_threads needs the waits of the prefetch thread.");
+    DecodeThreadController::Options options;
+    options.max_threads = num_decode_threads_;
+    options.min_threads = std::min(
+        options.max_threads,
+        OperatorBase::template GetSingleArgument<int>(
+            "min_decode_threads", 1));
+    options.min_depth = std::min(
+        this->prefetch_depth_,
+        OperatorBase::template GetSingleArgument<int>(
+            "min_prefetch_depth", 1));
+    options.max_depth = this->prefetch_depth_;
+    options.window = OperatorBase::template GetSingleArgument<int>(
+        "adaptive_window", options.window);
+    // starts from decode_threads and the full prefetch_depth
+    decode_controller_.reset(new DecodeThreadController(
+        options,
+        OperatorBase::template GetSingleArgument<int>("decode_threads", 4),
+        this->prefetch_depth_));
+    decode_gate_.SetLimit(decode_controller_->threads());
+    CAFFE_EVENT(stats_, active_decode_threads, decode_controller_->threads());
+    CAFFE_EVENT(stats_, active_prefetch_depth, decode_controller_->depth());
+  }
+
+  CAFFE_ENFORCE(
+      !schedule_by_cost_ || !parallel_reads_,
+      "schedule_by_cost orders the records of a batch once they are read, "
+      "not with parallel_reads.");
 
   LOG(INFO) << "Creating a clip input op with the following setting: ";
   LOG(INFO) << "    Using " << num_decode_threads_ << " CPU threads;";
+  if (decode_controller_) {
+    LOG(INFO) << "    Adapting the decode threads, starting from "
+              << decode_controller_->threads();
+  }
+  LOG(INFO) << "    Codec threads per video: " << codec_threads_;
+  LOG(INFO) << "    Work-stealing decode pool?: " << use_work_stealing_pool_;
+  if (cpu_budget_pool_) {
+    LOG(INFO) << "    Decoding on the CPU budget pool, on at most "
+              << cpu_budget_pool_->max_workers(CpuConsumer::kDecode)
+              << " of its " << cpu_budget_pool_->size() << " workers";
+  }
+  if (numa_node_ >= 0) {
+    LOG(INFO) << "    Decoding on NUMA node " << numa_node_;
+  }
   if (temporal_jitter_) {
     LOG(INFO) << "  Using temporal jittering;";
   }
@@ -210,6 +1137,16 @@ CustomizedVideoInputOp<Context>::CustomizedVideoInputOp(
   LOG(INFO) << "    Using " << (is_test_ ? "center" : "random") << " crop";
   LOG(INFO) << "    Using a clip of " << length_ << " frames;";
   LOG(INFO) << "    Using a sampling rate of 1:" << sampling_rate_;
+  for (int k = 0; k < pathway_lengths_.size(); k++) {
+    LOG(INFO) << "    Pathway " << k << ": " << pathway_lengths_[k]
+              << " frames at 1:" << sampling_rate_ * pathway_steps_[k];
+  }
+  for (int k = 0; k < clip_shapes_.size(); k++) {
+    LOG(INFO) << "    Clip shape " << k << ": " << clip_shape_iters_[k]
+              << " batches of " << clip_shapes_[k].batch_size << " x "
+              << clip_shapes_[k].length << " x " << clip_shapes_[k].crop
+              << " at 1:" << clip_shapes_[k].sampling_rate;
+  }
   LOG(INFO) << "    Subtract mean " << mean_ << " and divide by std " << std_
             << ".";
 
@@ -217,8 +1154,69 @@ CustomizedVideoInputOp<Context>::CustomizedVideoInputOp(
   LOG(INFO) << "    Scaling image from " << min_size_ << " to " << max_size_;
   LOG(INFO) << "    Using scale augmentaiton?: " << use_scale_augmentaiton_ ;
   LOG(INFO) << "    Using BGR order?: " << use_bgr_ ;
+  LOG(INFO) << "    Output order: "
+            << (order_ == StorageOrder::NHWC ? "NHWC" : "NCHW");
   LOG(INFO) << "    Using sample_times_:" << sample_times_;
   LOG(INFO) << "    Using use_multi_crop_: " << use_multi_crop_ ;
+  LOG(INFO) << "    Using selective decoding?: " << use_selective_decoding_
+            << ", skipping non-reference frames?: " << skip_nonref_frames_;
+  if (target_fps_ > 0) {
+    LOG(INFO) << "    Sampling the clips at " << target_fps_ << " fps";
+  }
+  LOG(INFO) << "    Scaling in the decoder?: " << use_decoder_scaling_;
+  LOG(INFO) << "    Caching decoder contexts?: " << use_decoder_cache_;
+  LOG(INFO) << "    Frame buffers from an arena?: " << use_frame_arena_;
+  LOG(INFO) << "    Reading files through mmap?: " << use_mmap_
+            << ", with readahead?: " << readahead_files_;
+  LOG(INFO) << "    Reading records in the decode threads?: "
+            << parallel_reads_;
+  LOG(INFO) << "    Decoding the costly records first?: "
+            << schedule_by_cost_;
+  LOG(INFO) << "    Reusing clips across crops?: " << reuse_multi_crop_clips_;
+  LOG(INFO) << "    Views per db record: " << num_views_;
+  LOG(INFO) << "    Progressive test?: " << (progressive_scheduler_ != nullptr);
+  LOG(INFO) << "    Using " << decode_backend_name_ << " video decoding";
+  LOG(INFO) << "    Fast decoding quality?: "
+            << (decode_quality_ == FAST_QUALITY);
+  if (!video_meta_index_path_.empty()) {
+    LOG(INFO) << "    Video meta data of " << video_meta_index_.size()
+              << " files from " << video_meta_index_path_;
+  }
+  LOG(INFO) << "    Skipping the stream probe of videos with meta data?: "
+            << skip_stream_info_;
+  if (key_frame_jitter_ >= 0) {
+    LOG(INFO) << "    Starting the jittered clips at most "
+              << key_frame_jitter_ << " frames after a key frame";
+  }
+  if (!bad_videos_->path().empty()) {
+    LOG(INFO) << "    Keeping the bad videos in " << bad_videos_->path()
+              << ", at most " << max_bad_videos_ << " new ones";
+  }
+  if (frame_cache_) {
+    LOG(INFO) << "    Caching " << frame_cache_->num_slots()
+              << " decoded frames in " << frame_cache_name_;
+  }
+  if (clip_cache_) {
+    LOG(INFO) << "    Caching " << clip_cache_->num_slots()
+              << " decoded clips in " << clip_cache_name_;
+  }
+  if (remote_store_) {
+    LOG(INFO) << "    Reading remote videos in blocks of "
+              << (remote_store_->block_size() >> 10) << " KB";
+  }
+  if (gpu_transform_) {
+    LOG(INFO) << "    Performing transformation on GPU"
+              << (gpu_yuv_transform_ ? ", from YUV" : "")
+              << (use_nvjpeg_ ? ", decoding the frames with nvJPEG" : "");
+  }
+  if (crop_ <= 0) {
+    LOG(INFO) << "    Bucketing uncropped clips by size, holding up to "
+              << bucket_buffer_size_ << " clips";
+  }
+  LOG(INFO) << "    Outputting clips as "
+            << OperatorBase::template GetSingleArgument<string>(
+                   "output_type", "float")
+            << ".";
 
 
   vector<TIndex> data_shape(5);
@@ -236,7 +1234,12 @@ CustomizedVideoInputOp<Context>::CustomizedVideoInputOp(
     data_shape[3] = 320;  // rough estimate
     data_shape[4] = 320;  // rough estimate
   }
-  prefetched_clip_.Resize(data_shape);
+  if (gpu_yuv_transform_) {
+    // T I420 frames of each clip, see YuvClipCropFlex
+    prefetched_clip_.Resize(batch_size_, length_, crop_ * 3 / 2, crop_);
+  } else {
+    prefetched_clip_.Resize(data_shape);
+  }
 
   // If multiple label is used, outout label is a binary vector of length
   // number of labels-dim in indicating which labels present
@@ -247,159 +1250,470 @@ CustomizedVideoInputOp<Context>::CustomizedVideoInputOp(
   } else {
     prefetched_label_.Resize(vector<TIndex>(1, batch_size_));
   }
+  if (output_clip_index_) {
+    prefetched_video_id_.Resize(batch_size_);
+    prefetched_clip_index_.Resize(batch_size_, 2);
+  }
+
+  const int num_items = max_batch_size_ / num_views_;
+  for (auto& batch : decoding_batches_) {
+    batch.reset(new DecodingBatch());
+    batch->clip.ResizeLike(prefetched_clip_);
+    batch->label.ResizeLike(prefetched_label_);
+    batch->mirror.Resize(batch_size_);
+    batch->video_id.ResizeLike(prefetched_video_id_);
+    batch->clip_index.ResizeLike(prefetched_clip_index_);
+    batch->shape.batch_size = batch_size_;
+    batch->shape.length = length_;
+    batch->shape.crop = crop_;
+    batch->shape.sampling_rate = sampling_rate_;
+    batch->value_data.resize(num_items, nullptr);
+    batch->value_size.resize(num_items, 0);
+    batch->values.resize(num_items);
+    batch->keys.resize(num_items);
+    if (expand_test_views_) {
+      batch->view_clip_buffers.resize(num_items);
+    } else if (use_nvjpeg_) {
+      batch->jpeg_frames.resize(num_items);
+      batch->jpeg_geometry.Resize(num_items, 4);
+    } else {
+      batch->clip_buffers.resize(num_items);
+    }
+    batch->list_clip_data.resize(num_items, nullptr);
+    batch->list_height_out.resize(num_items);
+    batch->list_width_out.resize(num_items);
+    batch->cost_units.resize(num_items, 0);
+  }
+
+  protos_per_thread_.resize(num_decode_threads_);
+}
+
+template <class Context>
+void CustomizedVideoInputOp<Context>::GetLabelFromDBValue(
+    const VideoRecord& record,
+    int* label_data) {
+  if (!multiple_label_) {
+      label_data[0] = record.label(0);
+  } else {
+    // For multiple label case, output label is a binary vector
+    // where presented concepts are makred 1
+    memset(label_data, 0, sizeof(int) * num_of_labels_);
+    for (int i = 0; i < record.num_labels; i++) {
+      label_data[record.label(i)] = 1;
+    }
+  }
 }
 
 template <class Context>
 bool CustomizedVideoInputOp<Context>::GetClipAndLabelFromDBValue(
-    const string& value,
-    float*& buffer,
+    const VideoRecord& record,
+    const int length,
+    const int sampling_rate,
+    std::vector<unsigned char>& buffer,
     int* label_data,
-    std::mt19937* randgen,
+    PhiloxRandom* randgen,
     int & height,
     int & width
   ) {
-  TensorProtos protos;
-  CAFFE_ENFORCE(protos.ParseFromString(value));
-  const TensorProto& video_proto = protos.protos(0);
-  const TensorProto& label_proto = protos.protos(1);
-
   int start_frm = -1;
   if (!temporal_jitter_) {
-    const TensorProto& start_frm_proto = protos.protos(2);
-    start_frm = start_frm_proto.int32_data(0);
+    CAFFE_ENFORCE_GE(record.start_frm, 0, "The record has no start frame.");
+    start_frm = record.start_frm;
   }
   // int start_frm = temporal_jitter_ ? -1 : 0;
 
-  // assign labels
-  if (!multiple_label_) {
-      label_data[0] = label_proto.int32_data(0);
-  } else {
-    // For multiple label case, output label is a binary vector
-    // where presented concepts are makred 1
-    memset(label_data, 0, sizeof(int) * num_of_labels_);
-    for (int i = 0; i < label_proto.int32_data_size(); i++) {
-      label_data[label_proto.int32_data(i)] = 1;
+  GetLabelFromDBValue(record, label_data);
+
+  const bool scale_in_decoder =
+      use_scale_augmentaiton_ && use_decoder_scaling_;
+  const int decode_min_size = scale_in_decoder ? min_size_ : -1;
+  const int decode_max_size = scale_in_decoder ? max_size_ : -1;
+
+  // a record with meta data, or the meta index, tells the decoder the frame
+  // count and where the key frames are, so it does not have to guess from
+  // the container
+  VideoStreamInfo stream_info;
+  const VideoStreamInfo* record_stream_info = nullptr;
+  VideoMetaEntry meta_entry;
+  if (record.has_meta()) {
+    stream_info.numFrames = record.num_frames;
+    stream_info.fps = record.fps;
+    stream_info.keyFrames.resize(record.num_key_frames);
+    for (int i = 0; i < record.num_key_frames; i++) {
+      stream_info.keyFrames[i] = record.key_frame(i);
     }
+    record_stream_info = &stream_info;
+  } else if (
+      video_meta_index_.size() > 0 &&
+      video_meta_index_.Lookup(
+          std::string(record.payload, record.payload_size), &meta_entry)) {
+    stream_info.numFrames = meta_entry.num_frames;
+    stream_info.fps = meta_entry.fps;
+    stream_info.keyFrames.swap(meta_entry.key_frames);
+    record_stream_info = &stream_info;
   }
+  stream_info.skipProbe = skip_stream_info_ && stream_info.fps > 0;
+  stream_info.keyFrameJitter = key_frame_jitter_;
 
-  if (use_local_file_) {
-    CAFFE_ENFORCE_EQ(
-        video_proto.data_type(),
-        TensorProto::STRING,
-        "Database with a file_list is expected to be string data");
-  }
-
-  if (video_proto.data_type() == TensorProto::STRING) {
-    const string& encoded_video_str = video_proto.string_data(0);
-    int encoded_size = encoded_video_str.size();
-    if (!use_local_file_) {
-      DecodeClipFromMemoryBufferFlex(
-          const_cast<char*>(encoded_video_str.data()),
-          encoded_size,
-          start_frm,
-          length_,
-          height,
-          width,
-          sampling_rate_,
-          buffer,
-          randgen);
-    } else { // use local file
-      // encoded string contains an absolute path to a local file or folder
-      std::string filename = encoded_video_str;
-      if (use_image_) {
-        LOG(FATAL) << "Branch not implemented.";
-        /* CAFFE_ENFORCE(
-          !temporal_jitter_,
-          "Temporal jittering is not suported for image sequence input"
-        );
-        CHECK(ReadClipFromFrames(
-            filename,
-            start_frm,
-            im_extension_,
-            length_,
-            scale_h_,
-            scale_w_,
-            sampling_rate_,
-            buffer)); */
-      } else {
-        // printf("filename: %s\n", filename.c_str());
-        CHECK(DecodeClipFromVideoFileFlex(
-            filename,
-            start_frm,
-            length_,
-            height,
-            width,
-            sampling_rate_,
-            buffer,
-            randgen,
-            sample_times_
-          ));
-      } // end of else (i.e., use_image_ == False)
-    } // end of else (i.e., use_local_file_ == True)
-  } else if (video_proto.data_type() == TensorProto::BYTE) {
-    LOG(FATAL) << "Branch not implemented.";
-    /* DecodeClipFromMemoryBufferFlex(
-        video_proto.byte_data().data(),
-        video_proto.byte_data().size(),
+  if (!use_local_file_) {
+    // decode straight from the db record
+    DecodeClipFromMemoryBufferFlex(
+        record.payload,
+        record.payload_size,
         start_frm,
-        length_,
+        length,
         height,
         width,
-        sampling_rate_,
+        sampling_rate,
         buffer,
-        randgen); */
-  } else {
-    LOG(FATAL) << "Unknown video data type.";
+        randgen,
+        use_selective_decoding_,
+        decode_min_size,
+        decode_max_size,
+        decode_backend_,
+        use_frame_arena_,
+        record_stream_info,
+        io_buffer_size_,
+        skip_nonref_frames_,
+        codec_threads_,
+        target_fps_,
+        decode_quality_,
+        gpu_yuv_transform_);
+  } else { // use local file
+    // encoded string contains an absolute path to a local file or folder
+    std::string filename(record.payload, record.payload_size);
+    if (use_image_) {
+      // a folder of frames, of which only the frames of the clip are read
+      return DecodeClipFromFrames(
+          filename,
+          im_extension_,
+          start_frm,
+          length,
+          height,
+          width,
+          sampling_rate,
+          buffer,
+          randgen,
+          sample_times_,
+          decode_min_size,
+          decode_max_size,
+          record_stream_info ? record_stream_info->numFrames : -1);
+    } else {
+      // the crops of a test clip only differ in spatial_pos
+      const std::string clip_key = reuse_multi_crop_clips_
+          ? filename + ":" + std::to_string(start_frm)
+          : std::string();
+      if (reuse_multi_crop_clips_ &&
+          GetCachedClip(clip_key, buffer, height, width)) {
+        return true;
+      }
+      // a clip placed by start_frm and scaled to a fixed size is the same
+      // in every process that decodes it
+      const bool shared_clip = clip_cache_ && start_frm >= 0 &&
+          decode_min_size == decode_max_size;
+      std::string shared_key;
+      if (shared_clip) {
+        std::ostringstream key;
+        key << filename << ":" << start_frm << "/" << sample_times_ << ":"
+            << length << "x" << sampling_rate << "@" << target_fps_ << ":"
+            << decode_min_size << ":" << decode_backend_ << ":"
+            << decode_quality_ << ":" << gpu_yuv_transform_;
+        shared_key = key.str();
+        if (clip_cache_->Lookup(shared_key, &buffer, &height, &width)) {
+          if (reuse_multi_crop_clips_) {
+            CacheClip(clip_key, buffer, height, width);
+          }
+          return true;
+        }
+      }
+      // printf("filename: %s\n", filename.c_str());
+      if (!DecodeClipFromVideoFileFlex(
+          filename,
+          start_frm,
+          length,
+          height,
+          width,
+          sampling_rate,
+          buffer,
+          randgen,
+          sample_times_,
+          use_selective_decoding_,
+          decode_min_size,
+          decode_max_size,
+          use_decoder_cache_,
+          decode_backend_,
+          use_frame_arena_,
+          record_stream_info,
+          frame_cache_.get(),
+          io_buffer_size_,
+          use_mmap_,
+          skip_nonref_frames_,
+          codec_threads_,
+          remote_store_.get(),
+          target_fps_,
+          decode_quality_,
+          gpu_yuv_transform_
+        )) {
+        return false;
+      }
+      if (reuse_multi_crop_clips_) {
+        CacheClip(clip_key, buffer, height, width);
+      }
+      if (shared_clip) {
+        clip_cache_->Insert(shared_key, buffer, height, width);
+      }
+    } // end of else (i.e., use_image_ == False)
+  } // end of else (i.e., use_local_file_ == True)
+  return true;
+}
+
+template <class Context>
+bool CustomizedVideoInputOp<Context>::ReadJpegClip(
+    const VideoRecord& record,
+    int* label_data,
+    const int length,
+    const int sampling_rate,
+    const int crop_size,
+    PhiloxRandom* randgen,
+    std::bernoulli_distribution* mirror_this_clip,
+    std::vector<std::string>* frames,
+    int* geometry,
+    int* mirror_data) {
+  int start_frm = -1;
+  if (!temporal_jitter_) {
+    CAFFE_ENFORCE_GE(record.start_frm, 0, "The record has no start frame.");
+    start_frm = record.start_frm;
+  }
+  GetLabelFromDBValue(record, label_data);
+
+  Timer timer;
+  int height = -1;
+  int width = -1;
+  if (!ReadClipFrameFiles(
+          std::string(record.payload, record.payload_size),
+          im_extension_,
+          start_frm,
+          length,
+          height,
+          width,
+          sampling_rate,
+          frames,
+          randgen,
+          sample_times_,
+          record.has_meta() ? record.num_frames : -1)) {
+    frames->clear();
+    return false;
   }
+  const float read_ns = timer.NanoSeconds();
+  CAFFE_EVENT(stats_, decode_time_ns, read_ns);
+  CAFFE_EVENT(stats_, decode_latency, read_ns);
+
+  // the size the decoder would scale the frames to, the GPU scales them
+  int height_scaled = -1;
+  int width_scaled = -1;
+  GetScaledSize(
+      height,
+      width,
+      max_size_,
+      min_size_,
+      randgen,
+      height_scaled,
+      width_scaled);
+  geometry[0] = height_scaled;
+  geometry[1] = width_scaled;
+  GetClipCropWindow(
+      height_scaled,
+      width_scaled,
+      crop_size,
+      crop_size,
+      mirror_,
+      randgen,
+      mirror_this_clip,
+      is_test_,
+      use_multi_crop_ > 0 ? record.spatial_pos : -1,
+      &geometry[2],
+      &geometry[3],
+      mirror_data);
   return true;
 }
 
 template <class Context>
-void CustomizedVideoInputOp<Context>::DecodeAndTransform(
-    const std::string value,
+void CustomizedVideoInputOp<Context>::PackJpegClips(DecodingBatch* decoded) {
+  const int num_clips = decoded->shape.batch_size;
+  const int length = decoded->shape.length;
+  // a clip that failed to read takes the frames of the one before it (or
+  // after it, for the first ones), as the CPU path keeps the stale clip
+  std::vector<int> source(num_clips, -1);
+  int last_read = -1;
+  for (int n = 0; n < num_clips; ++n) {
+    if (decoded->jpeg_frames[n].size() == static_cast<size_t>(length)) {
+      last_read = n;
+    }
+    source[n] = last_read;
+  }
+  CAFFE_ENFORCE_GE(last_read, 0, "No clip of the batch could be read.");
+  for (int n = 0; n < num_clips && source[n] < 0; ++n) {
+    source[n] = last_read;
+  }
+  JpegClipBatch& jpeg = prefetched_jpeg_;
+  jpeg.offsets.Resize(num_clips * length + 1);
+  int64_t* offsets = jpeg.offsets.template mutable_data<int64_t>();
+  int64_t size = 0;
+  for (int n = 0; n < num_clips; ++n) {
+    for (const std::string& frame : decoded->jpeg_frames[source[n]]) {
+      *offsets++ = size;
+      size += frame.size();
+    }
+  }
+  *offsets = size;
+  jpeg.encoded.Resize(size);
+  uint8_t* encoded = jpeg.encoded.template mutable_data<uint8_t>();
+  jpeg.geometry.Resize(num_clips, 4);
+  const int* geometry = decoded->jpeg_geometry.template data<int>();
+  int* packed_geometry = jpeg.geometry.template mutable_data<int>();
+  for (int n = 0; n < num_clips; ++n) {
+    for (const std::string& frame : decoded->jpeg_frames[source[n]]) {
+      memcpy(encoded, frame.data(), frame.size());
+      encoded += frame.size();
+    }
+    std::copy(
+        geometry + 4 * source[n],
+        geometry + 4 * source[n] + 4,
+        packed_geometry + 4 * n);
+  }
+}
+
+template <class Context>
+void CustomizedVideoInputOp<Context>::GetClipIndexFromDBValue(
+    const VideoRecord& record,
+    const int num_views,
+    int* video_id,
+    int* clip_index) {
+  // test dbs store the index of the video as its label
+  const int id = record.label(0);
+  if (num_views > 1) {
+    // expand_test_views_ writes view (crop * sample_times_ + t)
+    for (int view = 0; view < num_views; ++view) {
+      video_id[view] = id;
+      clip_index[2 * view] = view % sample_times_;
+      clip_index[2 * view + 1] =
+          use_multi_crop_ > 0 ? view / sample_times_ : -1;
+    }
+    return;
+  }
+  video_id[0] = id;
+  clip_index[0] = temporal_jitter_ ? -1 : record.start_frm;
+  clip_index[1] = use_multi_crop_ > 0 ? record.spatial_pos : -1;
+}
+
+template <class Context>
+bool CustomizedVideoInputOp<Context>::GetCachedClip(
+    const std::string& key,
+    std::vector<unsigned char>& buffer,
+    int& height,
+    int& width) {
+  std::lock_guard<std::mutex> lock(cached_clips_mutex_);
+  for (auto it = cached_clips_.begin(); it != cached_clips_.end(); ++it) {
+    if (it->key == key) {
+      buffer = it->data;
+      height = it->height;
+      width = it->width;
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class Context>
+void CustomizedVideoInputOp<Context>::CacheClip(
+    const std::string& key,
+    const std::vector<unsigned char>& buffer,
+    const int height,
+    const int width) {
+  std::lock_guard<std::mutex> lock(cached_clips_mutex_);
+  // the other crops of a clip follow within the next sample_times_ entries,
+  // give or take the entries being decoded concurrently
+  const int capacity = sample_times_ + num_decode_threads_;
+  if (cached_clips_.size() >= capacity) {
+    // recycle the oldest entry to keep its allocation
+    cached_clips_.splice(
+        cached_clips_.begin(), cached_clips_, std::prev(cached_clips_.end()));
+  } else {
+    cached_clips_.emplace_front();
+  }
+  CachedClip& clip = cached_clips_.front();
+  clip.key = key;
+  clip.data = buffer;
+  clip.height = height;
+  clip.width = width;
+}
+
+template <class Context>
+bool CustomizedVideoInputOp<Context>::DecodeAndTransform(
+    const VideoRecord& record,
     float* clip_data,
     int* label_data,
     const int crop_size,  // -1 is uncrop
+    const int length,
+    const int sampling_rate,
     const bool mirror,
     const float mean,
     const float std,
-    std::mt19937* randgen,
+    PhiloxRandom* randgen,
     std::bernoulli_distribution* mirror_this_clip,
     int* height_out,
-    int* width_out
+    int* width_out,
+    std::vector<unsigned char>* buffer,
+    unsigned char* cropped_clip_data,
+    int* mirror_data
   ) {
-  float* buffer = nullptr;
-
   // Decode the video from memory or read from a local file
   int height_raw = -1;
   int width_raw = -1;
   int height_scaled = -1;
   int width_scaled = -1;
-  CHECK(GetClipAndLabelFromDBValue(
-    value, buffer, label_data, randgen, height_raw, width_raw)
-  );
+  Timer timer;
+  CAFFE_HOT_SDT(video_decode_start, (void*)this, record.payload_size);
+  if (!GetClipAndLabelFromDBValue(
+    record,
+    length,
+    sampling_rate,
+    *buffer,
+    label_data,
+    randgen,
+    height_raw,
+    width_raw)) {
+    return false;
+  }
+  CAFFE_HOT_SDT(video_decode_done, (void*)this, height_raw, width_raw);
+  const float decode_ns = timer.NanoSeconds();
+  CAFFE_EVENT(stats_, decode_time_ns, decode_ns);
+  CAFFE_EVENT(stats_, decode_latency, decode_ns);
 
-  if ((height_raw <= 0) || (width_raw <= 0)) return;
+  if ((height_raw <= 0) || (width_raw <= 0)) return false;
+  timer.Start();
+  CAFFE_HOT_SDT(video_transform_start, (void*)this, length);
 
   const int num_clips = 1;
 
   for (int i = 0; i < num_clips; i ++) {
     if (use_scale_augmentaiton_) {
-      const int buffer_sample_size = height_raw * width_raw * length_ * 3;
-      float* buffer_scaled = nullptr;
+      const int buffer_sample_size = height_raw * width_raw * length * 3;
 
-      ScaleTransform(
-          buffer + buffer_sample_size * i,
-          3,
-          length_,
-          height_raw,
-          width_raw,
-          max_size_,
-          min_size_,
-          buffer_scaled,
-          randgen,
-          height_scaled,
-          width_scaled);
+      if (use_decoder_scaling_) {
+        // the decoder has already scaled the frames
+        height_scaled = height_raw;
+        width_scaled = width_raw;
+      } else {
+        GetScaledSize(
+            height_raw,
+            width_raw,
+            max_size_,
+            min_size_,
+            randgen,
+            height_scaled,
+            width_scaled);
+      }
 
 
       // determine the returned output size
@@ -430,48 +1744,100 @@ void CustomizedVideoInputOp<Context>::DecodeAndTransform(
         } // else crop_size > 0
       } // if i
 
-      const int clip_size = *height_out * *width_out * length_ * 3;
+      const int clip_size = *height_out * *width_out * length * 3;
       int spatial_pos = -1;
       if (use_multi_crop_ > 0)
       {
         // crop along the longer side
-        TensorProtos protos;
-        CAFFE_ENFORCE(protos.ParseFromString(value));
-        const TensorProto& spatial_pos_proto = protos.protos(3);
-        spatial_pos = spatial_pos_proto.int32_data(0);
+        spatial_pos = record.spatial_pos;
       }
 
-      ClipTransformFlex(
-          buffer_scaled,
-          3,
-          length_,
-          height_scaled,
-          width_scaled,
-          (*height_out),
-          (*width_out),
-          mirror,
-          mean,
-          std,
-          clip_data + clip_size * i,
-          randgen,
-          mirror_this_clip,
-          is_test_,
-          use_bgr_,
-          spatial_pos
-        );
-
-      if (buffer_scaled != nullptr)
-        delete[] buffer_scaled;
+      if (cropped_clip_data && gpu_yuv_transform_) {
+        // also converted to RGB on the GPU
+        YuvClipCropFlex(
+            buffer->data(),
+            length,
+            height_scaled,
+            width_scaled,
+            (*height_out),
+            (*width_out),
+            mirror,
+            cropped_clip_data,
+            randgen,
+            mirror_this_clip,
+            is_test_,
+            spatial_pos,
+            mirror_data
+          );
+      } else if (cropped_clip_data) {
+        // mirrored and normalized later on the GPU
+        ClipCropFlex(
+            buffer->data() + buffer_sample_size * i,
+            3,
+            length,
+            height_scaled,
+            width_scaled,
+            (*height_out),
+            (*width_out),
+            mirror,
+            cropped_clip_data + clip_size * i,
+            randgen,
+            mirror_this_clip,
+            is_test_,
+            spatial_pos,
+            mirror_data + i
+          );
+      } else if (use_decoder_scaling_) {
+        ClipTransformFlex(
+            buffer->data() + buffer_sample_size * i,
+            3,
+            length,
+            height_scaled,
+            width_scaled,
+            (*height_out),
+            (*width_out),
+            mirror,
+            mean,
+            std,
+            clip_data + clip_size * i,
+            randgen,
+            mirror_this_clip,
+            is_test_,
+            use_bgr_,
+            spatial_pos
+          );
+      } else {
+        ScaleCropNormalizeTransform(
+            buffer->data() + buffer_sample_size * i,
+            3,
+            length,
+            height_raw,
+            width_raw,
+            height_scaled,
+            width_scaled,
+            (*height_out),
+            (*width_out),
+            mirror,
+            mean,
+            std,
+            clip_data + clip_size * i,
+            randgen,
+            mirror_this_clip,
+            is_test_,
+            use_bgr_,
+            spatial_pos
+          );
+      }
     } else {
       LOG(FATAL) << "We don't recommend using unrestricted input size, "
       << "as it is heavily dependent on dataset preparation.";
 
-      // const int buffer_sample_size = height * width * length_ * 3;
+      // const int buffer_sample_size = height * width * length * 3;
       // it will caused problem is the side < crop_size
       // ClipTransform(
       //     buffer + buffer_sample_size * i,
       //     3,
-      //     length_,
+      //     length,
       //     height,
       //     width,
       //     crop_size + ,
@@ -484,39 +1850,214 @@ void CustomizedVideoInputOp<Context>::DecodeAndTransform(
       //     is_test_);
     } // else
   } // i
-  delete[] buffer;
+  CAFFE_HOT_SDT(video_transform_done, (void*)this, length);
+  const float transform_ns = timer.NanoSeconds();
+  CAFFE_EVENT(stats_, transform_time_ns, transform_ns);
+  CAFFE_EVENT(stats_, transform_latency, transform_ns);
+  return true;
 }
 
 template <class Context>
-bool CustomizedVideoInputOp<Context>::Prefetch() {
-  // We will get the reader pointer from input.
-  // If we use local clips, db will store the list
-  reader_ = &OperatorBase::Input<db::DBReader>(0);
+bool CustomizedVideoInputOp<Context>::DecodeAndTransformViews(
+    const VideoRecord& record,
+    float* clip_data,
+    int* label_data,
+    PhiloxRandom* randgen,
+    std::bernoulli_distribution* mirror_this_clip,
+    std::vector<std::vector<unsigned char>>* buffers) {
+  // every view carries the label of the video
+  const int label_size = multiple_label_ ? num_of_labels_ : 1;
+  if (!multiple_label_) {
+    label_data[0] = record.label(0);
+  } else {
+    memset(label_data, 0, sizeof(int) * num_of_labels_);
+    for (int i = 0; i < record.num_labels; i++) {
+      label_data[record.label(i)] = 1;
+    }
+  }
+  for (int view = 1; view < num_views_; view++) {
+    memcpy(
+        label_data + view * label_size, label_data, sizeof(int) * label_size);
+  }
 
-  const int channels = 3;
+  const bool scale_in_decoder =
+      use_scale_augmentaiton_ && use_decoder_scaling_;
+  int height_raw = -1;
+  int width_raw = -1;
+  Timer timer;
+  CAFFE_HOT_SDT(video_decode_start, (void*)this, record.payload_size);
+  if (!DecodeClipsFromVideoFileFlex(
+      std::string(record.payload, record.payload_size),
+      length_,
+      height_raw,
+      width_raw,
+      sampling_rate_,
+      *buffers,
+      randgen,
+      sample_times_,
+      scale_in_decoder ? min_size_ : -1,
+      scale_in_decoder ? max_size_ : -1,
+      use_decoder_cache_,
+      decode_backend_,
+      use_frame_arena_,
+      io_buffer_size_,
+      use_mmap_,
+      codec_threads_,
+      remote_store_.get(),
+      target_fps_)) {
+    return false;
+  }
+  CAFFE_HOT_SDT(video_decode_done, (void*)this, height_raw, width_raw);
+  const float decode_ns = timer.NanoSeconds();
+  CAFFE_EVENT(stats_, decode_time_ns, decode_ns);
+  CAFFE_EVENT(stats_, decode_latency, decode_ns);
+  timer.Start();
+  CAFFE_HOT_SDT(video_transform_start, (void*)this, length_ * num_views_);
 
-  // Call mutable_data() once to allocate the underlying memory.
-  prefetched_clip_.mutable_data<float>();
-  prefetched_label_.mutable_data<int>();
+  if (!use_scale_augmentaiton_) {
+    LOG(FATAL) << "We don't recommend using unrestricted input size, "
+    << "as it is heavily dependent on dataset preparation.";
+  }
 
-  // Prefetching handled with a thread pool of "decode_threads" threads.
-  std::mt19937 meta_randgen(time(nullptr));
-  std::vector<std::mt19937> randgen_per_thread;
-  for (int i = 0; i < num_decode_threads_; ++i) {
-    randgen_per_thread.emplace_back(meta_randgen());
+  // views follow the order of create_video_lmdb_test_multicrop.py:
+  // spatial crop major, clip slot minor
+  const int num_crops = num_views_ / sample_times_;
+  const int clip_size = crop_ * crop_ * length_ * 3;
+  for (int t = 0; t < sample_times_; t++) {
+    const unsigned char* clip = (*buffers)[t].data();
+    int height_scaled = height_raw;
+    int width_scaled = width_raw;
+    if (!use_decoder_scaling_) {
+      GetScaledSize(
+          height_raw,
+          width_raw,
+          max_size_,
+          min_size_,
+          randgen,
+          height_scaled,
+          width_scaled);
+    }
+    for (int crop = 0; crop < num_crops; crop++) {
+      const int spatial_pos = use_multi_crop_ > 0 ? crop : -1;
+      float* view_data = clip_data + (crop * sample_times_ + t) * clip_size;
+      if (use_decoder_scaling_) {
+        ClipTransformFlex(
+            clip,
+            3,
+            length_,
+            height_scaled,
+            width_scaled,
+            crop_,
+            crop_,
+            mirror_,
+            mean_,
+            std_,
+            view_data,
+            randgen,
+            mirror_this_clip,
+            is_test_,
+            use_bgr_,
+            spatial_pos);
+      } else {
+        ScaleCropNormalizeTransform(
+            clip,
+            3,
+            length_,
+            height_raw,
+            width_raw,
+            height_scaled,
+            width_scaled,
+            crop_,
+            crop_,
+            mirror_,
+            mean_,
+            std_,
+            view_data,
+            randgen,
+            mirror_this_clip,
+            is_test_,
+            use_bgr_,
+            spatial_pos);
+      }
+    }
   }
+  CAFFE_HOT_SDT(video_transform_done, (void*)this, length_ * num_views_);
+  const float transform_ns = timer.NanoSeconds();
+  CAFFE_EVENT(stats_, transform_time_ns, transform_ns);
+  CAFFE_EVENT(stats_, transform_latency, transform_ns);
+  return true;
+}
 
-  std::bernoulli_distribution mirror_this_clip(0.5);
+template <class Context>
+typename CustomizedVideoInputOp<Context>::ClipShape
+CustomizedVideoInputOp<Context>::NextClipShape() {
+  if (clip_shape_count_ == clip_shape_iters_[clip_shape_index_]) {
+    clip_shape_index_ = (clip_shape_index_ + 1) % clip_shapes_.size();
+    clip_shape_count_ = 0;
+  }
+  ++clip_shape_count_;
+  return clip_shapes_[clip_shape_index_];
+}
+
+template <class Context>
+void CustomizedVideoInputOp<Context>::ResizeBatch(DecodingBatch* batch) {
+  const int label_size = multiple_label_ ? num_of_labels_ : 1;
+  // the buffers grow to the largest batch once; shrinking keeps them
+  batch->clip.Resize(max_clip_size_);
+  batch->label.Resize(max_batch_size_ * label_size);
+  if (gpu_transform_) {
+    batch->clip.template mutable_data<uint8_t>();
+  } else {
+    batch->clip.template mutable_data<float>();
+  }
+  batch->label.template mutable_data<int>();
+
+  const ClipShape& shape = batch->shape;
+  if (gpu_yuv_transform_) {
+    batch->clip.Resize(
+        shape.batch_size, shape.length, shape.crop * 3 / 2, shape.crop);
+  } else {
+    batch->clip.Resize(std::vector<TIndex>{
+        shape.batch_size, 3, shape.length, shape.crop, shape.crop});
+  }
+  if (multiple_label_) {
+    batch->label.Resize(shape.batch_size, num_of_labels_);
+  } else {
+    batch->label.Resize(shape.batch_size);
+  }
+  batch->mirror.Resize(shape.batch_size);
+  if (output_clip_index_) {
+    batch->video_id.Resize(shape.batch_size);
+    batch->clip_index.Resize(shape.batch_size, 2);
+  }
+}
+
+template <class Context>
+void CustomizedVideoInputOp<Context>::SubmitBatch(DecodingBatch* batch) {
+  if (!clip_shapes_.empty()) {
+    batch->shape = NextClipShape();
+    ResizeBatch(batch);
+  }
+  // Call mutable_data() once to allocate the underlying memory.
+  if (gpu_transform_) {
+    // we'll transfer up in uint8, then convert later
+    batch->clip.template mutable_data<uint8_t>();
+    batch->mirror.template mutable_data<int>();
+  } else {
+    batch->clip.template mutable_data<float>();
+  }
+  batch->label.template mutable_data<int>();
+  if (output_clip_index_) {
+    batch->video_id.template mutable_data<int>();
+    batch->clip_index.template mutable_data<int>();
+  }
 
-  const int num_items = batch_size_;
+  // with expand_test_views_ every item is a db record of num_views_ clips
+  const int num_items = batch->shape.batch_size / num_views_;
+  batch->first_item_index = next_item_index_;
+  next_item_index_ += num_items;
 
   // ------------ only useful for crop_ <= 0
-  std::vector<float*> list_clip_data;
-  std::vector<int> list_height_out;
-  std::vector<int> list_width_out;
-  list_clip_data.resize(num_items);
-  list_height_out.resize(num_items);
-  list_width_out.resize(num_items);
   const int MAX_IMAGE_SIZE = 500 * 500;
   if (crop_ <= 0) {
     for (int item_id = 0; item_id < num_items; ++item_id) {
@@ -525,112 +2066,797 @@ bool CustomizedVideoInputOp<Context>::Prefetch() {
       we have to allocate outside of DecodeAndTransform,
       because DecodeAndTransform does not change the values.
       */
-      list_clip_data[item_id] =
-        new float[num_clips * MAX_IMAGE_SIZE * length_ * 3];
-      list_height_out[item_id] = -1;
-      list_width_out[item_id] = -1;
+      if (batch->list_clip_data[item_id] == nullptr) {
+        batch->list_clip_data[item_id] =
+          new float[num_clips * MAX_IMAGE_SIZE * length_ * 3];
+      }
+      batch->list_height_out[item_id] = -1;
+      batch->list_width_out[item_id] = -1;
     } // for
   } //if
   // ------------------------
 
+  const int num_decoded =
+      progressive_scheduler_ ? ScheduleProgressiveBatch(batch) : num_items;
+  {
+    std::lock_guard<std::mutex> lock(batch->mutex);
+    batch->num_pending = num_decoded;
+    batch->submitted = true;
+  }
+  if (num_decoded == 0) {
+    // all padding, done without a decode task to count it down
+    CAFFE_EVENT(stats_, prefetched_batch_balance, 1);
+    return;
+  }
+  // read the batch under one lock of the reader that the input ops of all
+  // the gpus share, without a copy of the values if the db can avoid it;
+  // with parallel_reads_ every decode thread reads its own items
+  if (!parallel_reads_ && !progressive_scheduler_) {
+    Timer timer;
+    reader_->ReadViewBatch(
+        num_items,
+        batch->keys.data(),
+        batch->values.data(),
+        batch->value_data.data(),
+        batch->value_size.data());
+    const float read_ns = timer.NanoSeconds();
+    CAFFE_EVENT(stats_, db_read_time_ns, read_ns);
+    CAFFE_EVENT(stats_, db_read_latency, read_ns);
+    for (int item_id = 0; item_id < num_items; ++item_id) {
+      CAFFE_EVENT(stats_, db_bytes_read, batch->value_size[item_id]);
+    }
+  }
+  // the items in the order their tasks are queued in: that of the db, or
+  // the costly ones first
+  std::vector<int> order;
+  if (schedule_by_cost_) {
+    order = CostOrder(batch, num_decoded);
+  }
+  for (int i = 0; i < num_decoded; ++i) {
+    const int item_id = order.empty() ? i : order[i];
+    if ((readahead_files_ || remote_store_) && use_local_file_ &&
+        !parallel_reads_) {
+      VideoRecord record;
+      ParseVideoRecord(
+          batch->value_data[item_id],
+          batch->value_size[item_id],
+          &readahead_protos_,
+          &record);
+      const std::string filename(record.payload, record.payload_size);
+      if (remote_store_ && RemoteVideoStore::IsRemote(filename)) {
+        remote_store_->Prefetch(filename);
+      } else if (readahead_files_) {
+        ReadaheadVideoFile(filename);
+      }
+    }
+    CAFFE_EVENT(stats_, decode_queue_balance, 1);
+    std::function<void(std::size_t)> task = std::bind(
+        &CustomizedVideoInputOp<Context>::DecodeItem,
+        this,
+        batch,
+        item_id,
+        std::placeholders::_1);
+    if (decode_controller_) {
+      // the threads beyond the active ones wait at the gate
+      task = [this, task](std::size_t thread_index) {
+        DecodeGate::Scope scope(&decode_gate_);
+        task(thread_index);
+      };
+    }
+    if (cpu_budget_pool_) {
+      cpu_budget_pool_->RunTaskWithID(
+          CpuConsumer::kDecode, task, &decode_tasks_);
+    } else if (use_work_stealing_pool_) {
+      work_stealing_pool_->runTaskWithID(task);
+    } else {
+      thread_pool_->runTaskWithID(task);
+    }
+  } // for over the batch
+}
+
+template <class Context>
+std::vector<int> CustomizedVideoInputOp<Context>::CostOrder(
+    DecodingBatch* batch,
+    int num_items) {
+  const int clip_frames = batch->shape.length * batch->shape.sampling_rate;
+  std::vector<double> costs(num_items, 0);
   for (int item_id = 0; item_id < num_items; ++item_id) {
-    std::mt19937* randgen = &randgen_per_thread[item_id % num_decode_threads_];
+    batch->cost_units[item_id] = 0;
+    double units = 0;
+    std::string key;
+    try {
+      VideoRecord record;
+      ParseVideoRecord(
+          batch->value_data[item_id],
+          batch->value_size[item_id],
+          &readahead_protos_,
+          &record);
+      // the key of DecodeItem
+      key = use_local_file_ ? std::string(record.payload, record.payload_size)
+                            : batch->keys[item_id];
+      VideoMetaEntry meta;
+      if (record.has_meta()) {
+        units = DecodeCostModel::ClipUnits(
+            record.num_frames,
+            record.num_key_frames,
+            record.width,
+            record.height,
+            clip_frames);
+      } else if (
+          use_local_file_ && video_meta_index_.size() > 0 &&
+          video_meta_index_.Lookup(key, &meta)) {
+        units = DecodeCostModel::ClipUnits(
+            meta.num_frames,
+            meta.key_frames.size(),
+            meta.width,
+            meta.height,
+            clip_frames);
+      }
+    } catch (const std::exception&) {
+      // DecodeItem reports the record
+      continue;
+    }
+    batch->cost_units[item_id] = units;
+    costs[item_id] = cost_model_.Estimate(key, units);
+  }
+  return LongestFirstOrder(costs);
+}
 
-    // get the label data pointer for the item_id -th example
-    int* label_data = prefetched_label_.mutable_data<int>() +
-        (multiple_label_ ? num_of_labels_ : 1) * item_id;
+template <class Context>
+int CustomizedVideoInputOp<Context>::ScheduleProgressiveBatch(
+    DecodingBatch* batch) {
+  std::vector<std::string> records;
+  progressive_scheduler_->Next(
+      batch_size_,
+      [this](const int n, std::vector<std::string>* values) {
+        std::vector<std::string> keys(n);
+        std::vector<std::string> buffers(n);
+        std::vector<const char*> data(n);
+        std::vector<size_t> sizes(n);
+        Timer timer;
+        reader_->ReadViewBatch(
+            n, keys.data(), buffers.data(), data.data(), sizes.data());
+        const float read_ns = timer.NanoSeconds();
+        CAFFE_EVENT(stats_, db_read_time_ns, read_ns);
+        CAFFE_EVENT(stats_, db_read_latency, read_ns);
+        // the views of a video outlive the next read
+        values->clear();
+        for (int i = 0; i < n; ++i) {
+          CAFFE_EVENT(stats_, db_bytes_read, sizes[i]);
+          values->emplace_back(data[i], sizes[i]);
+        }
+      },
+      &records);
+  const int label_size = multiple_label_ ? num_of_labels_ : 1;
+  int num_scheduled = 0;
+  for (int item_id = 0; item_id < batch_size_; ++item_id) {
+    batch->values[item_id].swap(records[item_id]);
+    batch->value_data[item_id] = batch->values[item_id].data();
+    batch->value_size[item_id] = batch->values[item_id].size();
+    if (batch->value_size[item_id] > 0) {
+      ++num_scheduled;
+      continue;
+    }
+    // padding once every video of the db has been scheduled
+    int* label_data =
+        batch->label.template mutable_data<int>() + label_size * item_id;
+    std::fill(label_data, label_data + label_size, -1);
+    batch->video_id.template mutable_data<int>()[item_id] = -1;
+    batch->clip_index.template mutable_data<int>()[2 * item_id] = -1;
+    batch->clip_index.template mutable_data<int>()[2 * item_id + 1] = -1;
+  }
+  return num_scheduled;
+}
 
-    // float* clip_data = prefetched_clip_.mutable_data<float>() +
-    //   crop_ * crop_ * length_ * channels * item_id;
+template <class Context>
+void CustomizedVideoInputOp<Context>::ReadItem(
+    DecodingBatch* batch,
+    int item_id,
+    std::size_t thread_index) {
+  Timer timer;
+  // the view stays valid until this thread reads its next record
+  const db::DBReader* reader =
+      parallel_reads_ ? part_readers_[thread_index].get() : reader_;
+  reader->ReadView(
+      &batch->keys[item_id],
+      &batch->values[item_id],
+      &batch->value_data[item_id],
+      &batch->value_size[item_id]);
+  const float read_ns = timer.NanoSeconds();
+  CAFFE_EVENT(stats_, db_read_time_ns, read_ns);
+  CAFFE_EVENT(stats_, db_read_latency, read_ns);
+  CAFFE_EVENT(stats_, db_bytes_read, batch->value_size[item_id]);
+}
 
-    std::string key, value;
-    // read data
-    reader_->Read(&key, &value);
-    thread_pool_->runTask(std::bind(
-        &CustomizedVideoInputOp<Context>::DecodeAndTransform,
-        this,
-        std::string(value),
-        (crop_ > 0) ?
-        (prefetched_clip_.mutable_data<float>() +
-          crop_ * crop_ * length_ * channels * item_id) // clip_data
-        : (list_clip_data[item_id]), // temp list
-        label_data,
-        crop_,
-        mirror_,
-        mean_,
-        std_,
-        randgen,
-        &mirror_this_clip,
-        &(list_height_out[item_id]),
-        &(list_width_out[item_id])
-      ));
-  } // for over the batch
-  thread_pool_->waitWorkComplete();
+template <class Context>
+void CustomizedVideoInputOp<Context>::DecodeItem(
+    DecodingBatch* batch,
+    int item_id,
+    std::size_t thread_index) {
+  CAFFE_ENFORCE((int)thread_index < num_decode_threads_);
+  const int channels = 3;
+  const ClipShape& shape = batch->shape;
+  const int clip_size = shape.crop * shape.crop * shape.length * channels;
+  // the uint8 clips of the GPU transform, I420 ones are half the size
+  const int cropped_clip_size = gpu_yuv_transform_ ? clip_size / 2 : clip_size;
+  PhiloxRandom randgen(
+      random_seed_, random_stream_, batch->first_item_index + item_id);
+  std::bernoulli_distribution mirror_this_clip(0.5);
+  TimelineScope span("decode", "decode clip");
+  // the decode threads run a clip each already
+  SerialParallelForScope serial_transforms;
+  // a record that fails to decode, or is known to, is replaced by the next
+  // one of the db, a few times in a row at most
+  const int kMaxReplacements = 16;
+  bool read = parallel_reads_;
+  Timer item_timer;
+  for (int replacements = 0;; ++replacements) {
+    bool decoded = false;
+    std::string bad_video_key;
+    try {
+      Timer timer;
+      if (read) {
+        ReadItem(batch, item_id, thread_index);
+        timer.Start();
+      }
+      read = true;
+      VideoRecord record;
+      ParseVideoRecord(
+          batch->value_data[item_id],
+          batch->value_size[item_id],
+          &protos_per_thread_[thread_index],
+          &record);
+      CAFFE_EVENT(stats_, parse_time_ns, timer.NanoSeconds());
+      bad_video_key = use_local_file_
+          ? std::string(record.payload, record.payload_size)
+          : batch->keys[item_id];
+      if (replace_bad_videos_ && replacements < kMaxReplacements &&
+          bad_videos_->Contains(bad_video_key)) {
+        CAFFE_EVENT(stats_, bad_videos_skipped, 1);
+        continue;
+      }
+      if (output_clip_index_) {
+        const int first_clip = item_id * num_views_;
+        GetClipIndexFromDBValue(
+            record,
+            num_views_,
+            batch->video_id.template mutable_data<int>() + first_clip,
+            batch->clip_index.template mutable_data<int>() + 2 * first_clip);
+      }
+      if (expand_test_views_) {
+        const int view_id = item_id * num_views_;
+        decoded = DecodeAndTransformViews(
+            record,
+            batch->clip.template mutable_data<float>() + clip_size * view_id,
+            batch->label.template mutable_data<int>() +
+                (multiple_label_ ? num_of_labels_ : 1) * view_id,
+            &randgen,
+            &mirror_this_clip,
+            &batch->view_clip_buffers[item_id]);
+      } else if (use_nvjpeg_) {
+        decoded = ReadJpegClip(
+            record,
+            batch->label.template mutable_data<int>() +
+                (multiple_label_ ? num_of_labels_ : 1) * item_id,
+            shape.length,
+            shape.sampling_rate,
+            shape.crop,
+            &randgen,
+            &mirror_this_clip,
+            &batch->jpeg_frames[item_id],
+            batch->jpeg_geometry.template mutable_data<int>() + 4 * item_id,
+            batch->mirror.template mutable_data<int>() + item_id);
+      } else {
+        decoded = DecodeAndTransform(
+            record,
+            gpu_transform_ ? nullptr :
+            (crop_ > 0) ?
+            (batch->clip.template mutable_data<float>() +
+              clip_size * item_id) // clip_data
+            : (batch->list_clip_data[item_id]), // temp list
+            batch->label.template mutable_data<int>() +
+                (multiple_label_ ? num_of_labels_ : 1) * item_id,
+            crop_ > 0 ? shape.crop : crop_,
+            shape.length,
+            shape.sampling_rate,
+            mirror_,
+            mean_,
+            std_,
+            &randgen,
+            &mirror_this_clip,
+            &(batch->list_height_out[item_id]),
+            &(batch->list_width_out[item_id]),
+            &batch->clip_buffers[item_id],
+            gpu_transform_ ?
+            (batch->clip.template mutable_data<uint8_t>() +
+              cropped_clip_size * item_id)
+            : nullptr,
+            gpu_transform_ ?
+            (batch->mirror.template mutable_data<int>() + item_id)
+            : nullptr);
+      }
+    } catch (const std::exception& e) {
+      LOG(ERROR) << "Decoding error " << e.what();
+    }
+    if (decoded) {
+      if (schedule_by_cost_ && replacements == 0) {
+        cost_model_.Observe(
+            bad_video_key,
+            batch->cost_units[item_id],
+            item_timer.NanoSeconds());
+      }
+      break;
+    }
+    const int64_t num_bad_videos = ++num_bad_videos_;
+    CAFFE_EVENT(stats_, bad_videos_found, 1);
+    if (!bad_video_key.empty() && bad_videos_->Add(bad_video_key)) {
+      LOG(ERROR) << "Added the bad video " << bad_video_key << " ("
+                 << num_bad_videos << " in this op)";
+    }
+    if (!replace_bad_videos_ || replacements >= kMaxReplacements ||
+        (max_bad_videos_ >= 0 && num_bad_videos > max_bad_videos_)) {
+      break;
+    }
+  }
+  CAFFE_EVENT(stats_, decode_queue_balance, -1);
+  bool batch_done = false;
+  {
+    std::lock_guard<std::mutex> lock(batch->mutex);
+    batch_done = --batch->num_pending == 0;
+  }
+  if (batch_done) {
+    CAFFE_EVENT(stats_, prefetched_batch_balance, 1);
+    batch->done.notify_one();
+  }
+}
 
-  // ------------ only useful for crop_ <= 0
-  if (crop_ <= 0) {  // There should be only one item
-    if (num_items != 1) {
-      LOG(FATAL) << "There should be only one item.";
-    }
-    if (MAX_IMAGE_SIZE < list_height_out[0] * list_width_out[0]) {
-      LOG(FATAL) << "Buffer is too small.";
-    }
-
-    // reallocate
-    /*
-    The network is usually designed for 224x224 input. If the empty image is
-    smaller than this size, the network run can crash (e.g., kernel > space)
-    */
-    const int MIN_SIZE = 224;
-    vector<TIndex> data_shape(5);
-    data_shape[0] = batch_size_;
-    data_shape[1] = 3;
-    data_shape[2] = length_;
-    data_shape[3] = std::max(list_height_out[0], MIN_SIZE); // for safety
-    data_shape[4] = std::max(list_width_out[0], MIN_SIZE); // for safety
-    prefetched_clip_.Resize(data_shape);
-    prefetched_clip_.mutable_data<float>();
-    if (list_height_out[0] < MIN_SIZE || list_width_out[0] < MIN_SIZE) {
-      LOG(ERROR) << "Video is too small.";
+template <class Context>
+void CustomizedVideoInputOp<Context>::WaitBatch(DecodingBatch* batch) {
+  Timer timer;
+  std::unique_lock<std::mutex> lock(batch->mutex);
+  while (batch->num_pending > 0) {
+    batch->done.wait(lock);
+  }
+  batch->submitted = false;
+  const float wait_ns = timer.NanoSeconds();
+  CAFFE_EVENT(stats_, batch_wait_time_ns, wait_ns);
+  CAFFE_EVENT(stats_, batch_wait_latency, wait_ns);
+}
+
+template <class Context>
+typename CustomizedVideoInputOp<Context>::DecodingBatch*
+CustomizedVideoInputOp<Context>::NextDecodedBatch() {
+  DecodingBatch* decoded = decoding_batches_[decoding_index_].get();
+  if (!decoded->submitted) {
+    SubmitBatch(decoded);
+  }
+  // queue the next batch before waiting for this one
+  DecodingBatch* next_batch = decoding_batches_[1 - decoding_index_].get();
+  SubmitBatch(next_batch);
+  WaitBatch(decoded);
+  decoding_index_ = 1 - decoding_index_;
+  return decoded;
+}
+
+template <class Context>
+void CustomizedVideoInputOp<Context>::BucketUncroppedClips(
+    DecodingBatch* decoded) {
+  const int MAX_IMAGE_SIZE = 500 * 500;
+  const int label_size = multiple_label_ ? num_of_labels_ : 1;
+  const int* label_data = decoded->label.template data<int>();
+  for (int item_id = 0; item_id < batch_size_; ++item_id) {
+    int height = decoded->list_height_out[item_id];
+    int width = decoded->list_width_out[item_id];
+    UncroppedClip clip;
+    clip.sequence = next_clip_sequence_++;
+    clip.label.assign(
+        label_data + label_size * item_id,
+        label_data + label_size * (item_id + 1));
+    clip.video_id = -1;
+    clip.clip_index[0] = -1;
+    clip.clip_index[1] = -1;
+    if (output_clip_index_) {
+      clip.video_id = decoded->video_id.template data<int>()[item_id];
+      clip.clip_index[0] =
+          decoded->clip_index.template data<int>()[2 * item_id];
+      clip.clip_index[1] =
+          decoded->clip_index.template data<int>()[2 * item_id + 1];
     }
+    if (decoded->list_clip_data[item_id] != nullptr
+        && height > 0 && width > 0) {
+      if (MAX_IMAGE_SIZE < height * width) {
+        LOG(FATAL) << "Buffer is too small.";
+      }
+      const float* clip_data = decoded->list_clip_data[item_id];
+      clip.data.assign(clip_data, clip_data + height * width * length_ * 3);
+    } else {
+      // an empty video comes out as an all-zero clip of the smallest size
+      height = 0;
+      width = 0;
+    }
+    uncropped_buckets_[std::make_pair(height, width)].push_back(
+        std::move(clip));
+    ++num_bucketed_clips_;
+  }
+}
+
+template <class Context>
+void CustomizedVideoInputOp<Context>::EmitUncroppedBatch() {
+  auto ready = uncropped_buckets_.end();
+  while (true) {
+    // the full bucket whose first clip has waited longest, if any
+    auto oldest = uncropped_buckets_.end();
+    for (auto it = uncropped_buckets_.begin();
+         it != uncropped_buckets_.end();
+         ++it) {
+      if (oldest == uncropped_buckets_.end() ||
+          it->second.front().sequence < oldest->second.front().sequence) {
+        oldest = it;
+      }
+      if ((int)it->second.size() >= batch_size_ &&
+          (ready == uncropped_buckets_.end() ||
+           it->second.front().sequence < ready->second.front().sequence)) {
+        ready = it;
+      }
+    }
+    if (ready != uncropped_buckets_.end()) {
+      break;
+    }
+    if (num_bucketed_clips_ >= bucket_buffer_size_) {
+      ready = oldest;
+      break;
+    }
+    BucketUncroppedClips(NextDecodedBatch());
+  }
+
+  std::deque<UncroppedClip>& bucket = ready->second;
+  const int height = ready->first.first;
+  const int width = ready->first.second;
+  const int num_clips = std::min<int>(bucket.size(), batch_size_);
+
+  /*
+  The network is usually designed for 224x224 input. If the empty image is
+  smaller than this size, the network run can crash (e.g., kernel > space)
+  */
+  const int MIN_SIZE = 224;
+  vector<TIndex> data_shape(5);
+  data_shape[0] = batch_size_;
+  data_shape[1] = 3;
+  data_shape[2] = length_;
+  data_shape[3] = std::max(height, MIN_SIZE); // for safety
+  data_shape[4] = std::max(width, MIN_SIZE); // for safety
+  prefetched_clip_.Resize(data_shape);
+  if (height < MIN_SIZE || width < MIN_SIZE) {
+    LOG(ERROR) << "Video is too small.";
+  }
+  if (multiple_label_) {
+    prefetched_label_.Resize(batch_size_, num_of_labels_);
+  } else {
+    prefetched_label_.Resize(batch_size_);
+  }
+
+  // in case of empty video, initialize an all-zero blob
+  float* clip_data = prefetched_clip_.mutable_data<float>();
+  memset(clip_data, 0, sizeof(float) * prefetched_clip_.size());
+  int* label_data = prefetched_label_.mutable_data<int>();
+  std::fill(label_data, label_data + prefetched_label_.size(), -1);
+  int* video_id_data = nullptr;
+  int* clip_index_data = nullptr;
+  if (output_clip_index_) {
+    video_id_data = prefetched_video_id_.mutable_data<int>();
+    clip_index_data = prefetched_clip_index_.mutable_data<int>();
+    std::fill(video_id_data, video_id_data + batch_size_, -1);
+    std::fill(clip_index_data, clip_index_data + 2 * batch_size_, -1);
+  }
+  const int clip_size = prefetched_clip_.size() / batch_size_;
+  for (int i = 0; i < num_clips; ++i) {
+    const UncroppedClip& clip = bucket.front();
+    std::copy(clip.data.begin(), clip.data.end(), clip_data + clip_size * i);
+    std::copy(
+        clip.label.begin(),
+        clip.label.end(),
+        label_data + clip.label.size() * i);
+    if (output_clip_index_) {
+      video_id_data[i] = clip.video_id;
+      clip_index_data[2 * i] = clip.clip_index[0];
+      clip_index_data[2 * i + 1] = clip.clip_index[1];
+    }
+    bucket.pop_front();
+  }
+  num_bucketed_clips_ -= num_clips;
+  if (bucket.empty()) {
+    uncropped_buckets_.erase(ready);
+  }
+}
 
-    // in case of empty video, initialize an all-zero blob
-    memset(prefetched_clip_.mutable_data<float>(), 0,
-      sizeof(float) * prefetched_clip_.size());
-    if (list_clip_data[0] != nullptr
-        && list_height_out[0] > 0 && list_width_out[0] > 0) {
-      const int num_clips = batch_size_;
+template <class Context>
+void CustomizedVideoInputOp<Context>::GetPathwayClip(
+    const TensorCPU& clip,
+    const int pathway,
+    TensorCPU* pathway_clip) {
+  const int length = pathway_lengths_[pathway];
+  const int step = pathway_steps_[pathway];
+  const int num_channels = clip.dim32(0) * clip.dim32(1);
+  const int clip_length = clip.dim32(2);
+  const int frame_size = clip.dim32(3) * clip.dim32(4);
+  std::vector<TIndex> dims = clip.dims();
+  dims[2] = length;
+  pathway_clip->Resize(dims);
+  const float* src = clip.template data<float>();
+  float* dst = pathway_clip->template mutable_data<float>();
+  for (int c = 0; c < num_channels; c++) {
+    for (int t = 0; t < length; t++) {
       memcpy(
-          prefetched_clip_.mutable_data<float>(),
-          list_clip_data[0],
-          sizeof(float) * num_clips *
-          list_height_out[0] * list_width_out[0] * length_ * 3
-      );
-      delete [] list_clip_data[0];
-      list_clip_data[0] = nullptr;
-    }
-  } // if crop_ <= 0
-  // ------------------------
+          dst + (c * length + t) * frame_size,
+          src + (c * clip_length + t * step) * frame_size,
+          frame_size * sizeof(float));
+    }
+  }
+}
+
+template <class Context>
+void CustomizedVideoInputOp<Context>::AdaptDecodeThreads() {
+  // the first cycle includes the start of the net
+  const float cycle_ms = prefetch_cycle_timer_.MilliSeconds();
+  prefetch_cycle_timer_.Start();
+  if (!prefetch_cycle_started_) {
+    prefetch_cycle_started_ = true;
+    return;
+  }
+  const int threads = decode_controller_->threads();
+  const int depth = decode_controller_->depth();
+  if (!decode_controller_->Observe(
+          this->last_stall_ms(), this->last_idle_ms(), cycle_ms)) {
+    return;
+  }
+  if (decode_controller_->threads() != threads) {
+    decode_gate_.SetLimit(decode_controller_->threads());
+    CAFFE_EVENT(
+        stats_, active_decode_threads, decode_controller_->threads() - threads);
+  }
+  if (decode_controller_->depth() != depth) {
+    this->SetPrefetchLimit(decode_controller_->depth());
+    CAFFE_EVENT(
+        stats_, active_prefetch_depth, decode_controller_->depth() - depth);
+  }
+  VLOG(1) << "Decoding on " << decode_controller_->threads()
+          << " threads, prefetching " << decode_controller_->depth()
+          << " batches ahead";
+}
+
+template <class Context>
+bool CustomizedVideoInputOp<Context>::Prefetch() {
+  if (decode_controller_) {
+    AdaptDecodeThreads();
+  }
+  Timer timer;
+  // We will get the reader pointer from input.
+  // If we use local clips, db will store the list
+  reader_ = &OperatorBase::Input<db::DBReader>(0);
+  CAFFE_ENFORCE(
+      max_bad_videos_ < 0 || num_bad_videos_.load() <= max_bad_videos_,
+      num_bad_videos_.load(),
+      " videos failed to decode, more than max_bad_videos (",
+      max_bad_videos_,
+      "), see ",
+      bad_videos_->path().empty() ? "the log" : bad_videos_->path());
+  if (parallel_reads_ && part_readers_.empty()) {
+    for (int i = 0; i < num_decode_threads_; ++i) {
+      part_readers_.push_back(reader_->OpenPart(num_decode_threads_, i));
+    }
+  }
+
+  // Bind the prefetch thread once, before it first touches the staging
+  // buffers, so that the CPU allocator places them on the same node. With
+  // no_prefetch we run on the caller's thread and leave it alone.
+  if (numa_node_ >= 0 && !prefetch_thread_bound_ && !this->no_prefetch_) {
+    NUMABind(numa_node_);
+    prefetch_thread_bound_ = true;
+  }
+
+  if (crop_ > 0) {
+    DecodingBatch* decoded = NextDecodedBatch();
+    // take the decoded batch; it gets back the buffers of a batch that has
+    // been handed over to a prefetch slot
+    prefetched_clip_.swap(decoded->clip);
+    prefetched_label_.swap(decoded->label);
+    prefetched_mirror_.swap(decoded->mirror);
+    prefetched_video_id_.swap(decoded->video_id);
+    prefetched_clip_index_.swap(decoded->clip_index);
+    if (use_nvjpeg_) {
+      PackJpegClips(decoded);
+    }
+    decoded->clip.ResizeLike(prefetched_clip_);
+    decoded->label.ResizeLike(prefetched_label_);
+    decoded->mirror.ResizeLike(prefetched_mirror_);
+    decoded->video_id.ResizeLike(prefetched_video_id_);
+    decoded->clip_index.ResizeLike(prefetched_clip_index_);
+  } else {
+    EmitUncroppedBatch();
+  }
+
+  if (!pathway_lengths_.empty()) {
+    // the clip of pathway 0 takes the place of the decoded one
+    for (int k = 0; k < pathway_lengths_.size(); k++) {
+      GetPathwayClip(prefetched_clip_, k, &prefetched_pathway_clips_[k]);
+    }
+    prefetched_clip_.swap(prefetched_pathway_clips_[0]);
+  }
 
   // If the context is not CPUContext, we will need to do a copy in the
   // prefetch function as well.
   if (!std::is_same<Context, CPUContext>::value) {
-    prefetched_clip_on_device_.CopyFrom(prefetched_clip_, &context_);
-    prefetched_label_on_device_.CopyFrom(prefetched_label_, &context_);
+    // stream 0 of this thread is synchronized by the prefetch worker
+    copy_context_.SwitchToDevice(1);
+    if (use_nvjpeg_) {
+      // only the encoded frames go to the device
+      DecodeJpegClipsOnGPU<Context>(
+          nvjpeg_decoder_.get(),
+          prefetched_jpeg_,
+          prefetched_clip_.dim32(2),
+          prefetched_clip_.dim32(3),
+          &prefetched_clip_on_device_,
+          &copy_context_);
+      CAFFE_EVENT(stats_, h2d_bytes, prefetched_jpeg_.encoded.nbytes());
+    } else {
+      prefetched_clip_on_device_.CopyFrom(prefetched_clip_, &copy_context_);
+      CAFFE_EVENT(stats_, h2d_bytes, prefetched_clip_.nbytes());
+    }
+    prefetched_label_on_device_.CopyFrom(prefetched_label_, &copy_context_);
+    CAFFE_EVENT(stats_, h2d_bytes, prefetched_label_.nbytes());
+    if (gpu_transform_) {
+      prefetched_mirror_on_device_.CopyFrom(
+          prefetched_mirror_, &copy_context_);
+    }
+    if (output_clip_index_) {
+      prefetched_video_id_on_device_.CopyFrom(
+          prefetched_video_id_, &copy_context_);
+      prefetched_clip_index_on_device_.CopyFrom(
+          prefetched_clip_index_, &copy_context_);
+    }
+    for (int k = 1; k < pathway_lengths_.size(); k++) {
+      prefetched_pathway_clips_on_device_[k].CopyFrom(
+          prefetched_pathway_clips_[k], &copy_context_);
+      CAFFE_EVENT(stats_, h2d_bytes, prefetched_pathway_clips_[k].nbytes());
+    }
+  }
+
+  // Hand the batch over to its slot. The tensors we get back belong to a
+  // slot that has already been copied out and are reused for the next one.
+  PrefetchedClips& batch = prefetched_batches_[this->prefetch_slot_];
+  batch.clip.swap(prefetched_clip_);
+  batch.label.swap(prefetched_label_);
+  batch.mirror.swap(prefetched_mirror_);
+  batch.video_id.swap(prefetched_video_id_);
+  batch.clip_index.swap(prefetched_clip_index_);
+  batch.clip_on_device.swap(prefetched_clip_on_device_);
+  batch.label_on_device.swap(prefetched_label_on_device_);
+  batch.mirror_on_device.swap(prefetched_mirror_on_device_);
+  batch.video_id_on_device.swap(prefetched_video_id_on_device_);
+  batch.clip_index_on_device.swap(prefetched_clip_index_on_device_);
+  batch.pathway_clips.swap(prefetched_pathway_clips_);
+  batch.pathway_clips_on_device.swap(prefetched_pathway_clips_on_device_);
+  batch.jpeg.swap(prefetched_jpeg_);
+  if (!std::is_same<Context, CPUContext>::value) {
+    // an event can only be recorded once
+    batch.copied_event.reset(new Event(OperatorBase::device_option()));
+    copy_context_.Record(batch.copied_event.get());
   }
+  // A slot that has not been filled yet hands back empty tensors.
+  prefetched_clip_.ResizeLike(batch.clip);
+  prefetched_label_.ResizeLike(batch.label);
+  prefetched_video_id_.ResizeLike(batch.video_id);
+  prefetched_clip_index_.ResizeLike(batch.clip_index);
+  prefetched_pathway_clips_.resize(pathway_lengths_.size());
+  prefetched_pathway_clips_on_device_.resize(pathway_lengths_.size());
+  const float prefetch_ns = timer.NanoSeconds();
+  CAFFE_EVENT(stats_, prefetch_time_ns, prefetch_ns);
+  CAFFE_EVENT(stats_, prefetch_latency, prefetch_ns);
   return true;
 }
 
+template <class Context>
+void CustomizedVideoInputOp<Context>::CopyClip(
+    const TensorCPU& clip,
+    Tensor<Context>* output) {
+  if (order_ == StorageOrder::NHWC) {
+    // N x C x T x H x W -> N x T x H x W x C
+    const std::vector<int> x_dims(clip.dims().begin(), clip.dims().end());
+    const std::vector<int> axes = {0, 2, 3, 4, 1};
+    std::vector<int> y_dims(5);
+    for (int i = 0; i < 5; ++i) {
+      y_dims[i] = x_dims[axes[i]];
+    }
+    output->Resize(y_dims);
+    math::Transpose<float, Context>(
+        5,
+        x_dims.data(),
+        y_dims.data(),
+        axes.data(),
+        clip.size(),
+        clip.template data<float>(),
+        output->template mutable_data<float>(),
+        &context_);
+  } else {
+    output->CopyFrom(clip, &context_);
+  }
+}
+
 template <class Context>
 bool CustomizedVideoInputOp<Context>::CopyPrefetched() {
   auto* clip_output = OperatorBase::Output<Tensor<Context>>(0);
-  auto* label_output = OperatorBase::Output<Tensor<Context>>(1);
+  PrefetchedClips& batch = prefetched_batches_[this->copy_slot_];
+  CAFFE_EVENT(stats_, prefetched_batch_balance, -1);
   if (std::is_same<Context, CPUContext>::value) {
-    clip_output->CopyFrom(prefetched_clip_, &context_);
-    label_output->CopyFrom(prefetched_label_, &context_);
+    if (gpu_transform_) {
+      // the cropped N x C x T x H x W uint8 clips, as they are decoded, or
+      // the N x T x 3H/2 x W I420 ones
+      this->OutputPrefetched(0, &batch.clip);
+      this->OutputPrefetched(OutputSize() - 1, &batch.mirror);
+    } else {
+      CopyClip(batch.clip, clip_output);
+    }
+    this->OutputPrefetched(1, &batch.label);
+    if (output_clip_index_) {
+      this->OutputPrefetched(2, &batch.video_id);
+      this->OutputPrefetched(3, &batch.clip_index);
+    }
+    for (int k = 1; k < pathway_lengths_.size(); k++) {
+      CopyClip(
+          batch.pathway_clips[k],
+          OperatorBase::Output<Tensor<Context>>(first_pathway_output_ + k - 1));
+    }
   } else {
-    clip_output->CopyFrom(prefetched_clip_on_device_, &context_);
-    label_output->CopyFrom(prefetched_label_on_device_, &context_);
+    // the prefetched tensors are complete once the copy stream reaches the
+    // event; this does not block the host
+    context_.WaitEvent(*batch.copied_event);
+    if (gpu_transform_) {
+      // GPU transform kernel allows explicitly setting output type
+      if (output_type_ == TensorProto_DataType_FLOAT) {
+        TransformClipsOnGPU<uint8_t, float, Context>(
+            batch.clip_on_device,
+            batch.mirror_on_device,
+            clip_output,
+            mean_,
+            1.f / std_,
+            use_bgr_,
+            order_ == StorageOrder::NHWC,
+            &context_);
+      } else if (output_type_ == TensorProto_DataType_FLOAT16) {
+        TransformClipsOnGPU<uint8_t, float16, Context>(
+            batch.clip_on_device,
+            batch.mirror_on_device,
+            clip_output,
+            mean_,
+            1.f / std_,
+            use_bgr_,
+            order_ == StorageOrder::NHWC,
+            &context_);
+      } else {
+        // mirror and reorder only, the model subtracts mean and divides by
+        // std in its first layer
+        TransformClipsOnGPU<uint8_t, uint8_t, Context>(
+            batch.clip_on_device,
+            batch.mirror_on_device,
+            clip_output,
+            0.f,
+            1.f,
+            use_bgr_,
+            order_ == StorageOrder::NHWC,
+            &context_);
+      }
+    } else {
+      this->OutputPrefetched(0, &batch.clip_on_device);
+    }
+    this->OutputPrefetched(1, &batch.label_on_device);
+    if (output_clip_index_) {
+      this->OutputPrefetched(2, &batch.video_id_on_device);
+      this->OutputPrefetched(3, &batch.clip_index_on_device);
+    }
+    for (int k = 1; k < pathway_lengths_.size(); k++) {
+      this->OutputPrefetched(
+          first_pathway_output_ + k - 1, &batch.pathway_clips_on_device[k]);
+    }
   }
   return true;
 }
@@ -0,0 +1,184 @@
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "caffe2/core/db.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/operator_schema.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/video/video_record.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// the schema only: the op itself needs a db of videos
+OperatorDef InputDef(const std::vector<std::string>& outputs) {
+  OperatorDef def;
+  def.set_type("CustomizedVideoInput");
+  for (const auto& output : outputs) {
+    def.add_output(output);
+  }
+  def.add_arg()->CopyFrom(MakeArgument<int>("batch_size", 2));
+  def.add_arg()->CopyFrom(MakeArgument<int>("length", 8));
+  return def;
+}
+
+std::vector<TensorShape> Infer(const OperatorDef& def) {
+  const auto* schema = OpSchemaRegistry::Schema(def.type());
+  CAFFE_ENFORCE(schema);
+  return schema->InferTensor(def, {});
+}
+
+std::vector<int64_t> Dims(const TensorShape& shape) {
+  return std::vector<int64_t>(shape.dims().begin(), shape.dims().end());
+}
+
+// a folder of num_frames frames, every pixel of frame i being 10 * i, and a
+// minidb of records of the folder that start at the frames of starts
+std::string WriteFramesAndDB(
+    const std::string& dir,
+    const int num_frames,
+    const std::vector<int>& starts) {
+  char name[512];
+  for (int i = 0; i < num_frames; ++i) {
+    snprintf(name, sizeof(name), "%s/%06d.png", dir.c_str(), i);
+    CAFFE_ENFORCE(
+        cv::imwrite(name, cv::Mat(12, 16, CV_8UC3, cv::Scalar::all(10 * i))));
+  }
+  const std::string db_name = dir + "/db";
+  std::unique_ptr<db::DB> db(db::CreateDB("minidb", db_name, db::NEW));
+  std::unique_ptr<db::Transaction> trans(db->NewTransaction());
+  const int32_t label = 0;
+  for (int i = 0; i < starts.size(); ++i) {
+    VideoRecord record;
+    record.payload = dir.data();
+    record.payload_size = dir.size();
+    record.label_data = reinterpret_cast<const char*>(&label);
+    record.num_labels = 1;
+    record.start_frm = starts[i];
+    record.spatial_pos = -1;
+    record.num_frames = -1;
+    record.key_frame_data = nullptr;
+    record.num_key_frames = 0;
+    trans->Put(std::to_string(i), SerializeVideoRecord(record));
+  }
+  trans->Commit();
+  return db_name;
+}
+
+} // namespace
+
+TEST(CustomizedVideoInputOpTest, InfersCroppedClipsAndLabels) {
+  auto def = InputDef({"data", "labels", "video_id", "clip_index"});
+  def.add_arg()->CopyFrom(MakeArgument<int>("crop", 112));
+  def.add_arg()->CopyFrom(MakeArgument<int>("output_clip_index", 1));
+  const auto out = Infer(def);
+  ASSERT_EQ(out.size(), 4);
+  EXPECT_EQ(Dims(out[0]), std::vector<int64_t>({2, 3, 8, 112, 112}));
+  EXPECT_EQ(out[0].data_type(), TensorProto::FLOAT);
+  EXPECT_EQ(Dims(out[1]), std::vector<int64_t>({2}));
+  EXPECT_EQ(out[1].data_type(), TensorProto::INT32);
+  EXPECT_EQ(Dims(out[2]), std::vector<int64_t>({2}));
+  EXPECT_EQ(Dims(out[3]), std::vector<int64_t>({2, 2}));
+
+  def.add_arg()->CopyFrom(MakeArgument<string>("order", "NHWC"));
+  EXPECT_EQ(Dims(Infer(def)[0]), std::vector<int64_t>({2, 8, 112, 112, 3}));
+
+  const auto cost =
+      OpSchemaRegistry::Schema(def.type())->InferCost(def, {});
+  EXPECT_EQ(cost.flops, 0);
+  EXPECT_EQ(
+      cost.bytes_moved, (2 * 3 * 8 * 112 * 112 + 2 + 2 + 4) * sizeof(float));
+}
+
+TEST(CustomizedVideoInputOpTest, InfersUncroppedMultiLabelClips) {
+  auto def = InputDef({"data", "labels"});
+  def.add_arg()->CopyFrom(MakeArgument<int>("crop", -1));
+  def.add_arg()->CopyFrom(MakeArgument<int>("multiple_label", 1));
+  def.add_arg()->CopyFrom(MakeArgument<int>("num_of_labels", 5));
+  const auto out = Infer(def);
+  ASSERT_EQ(out.size(), 2);
+  // the clips keep the size of their bucket
+  EXPECT_TRUE(out[0].unknown_shape());
+  EXPECT_EQ(out[0].data_type(), TensorProto::FLOAT);
+  EXPECT_FALSE(out[1].unknown_shape());
+  EXPECT_EQ(Dims(out[1]), std::vector<int64_t>({2, 5}));
+}
+
+TEST(CustomizedVideoInputOpTest, InfersRawClipsForTheGPUTransform) {
+  auto def = InputDef({"data", "labels", "mirror"});
+  def.add_arg()->CopyFrom(MakeArgument<int>("crop", 112));
+  def.add_arg()->CopyFrom(MakeArgument<int>("use_gpu_transform", 1));
+  auto out = Infer(def);
+  ASSERT_EQ(out.size(), 3);
+  EXPECT_EQ(Dims(out[0]), std::vector<int64_t>({2, 3, 8, 112, 112}));
+  EXPECT_EQ(out[0].data_type(), TensorProto::UINT8);
+  EXPECT_EQ(Dims(out[2]), std::vector<int64_t>({2}));
+
+  def.add_arg()->CopyFrom(MakeArgument<int>("use_gpu_yuv_transform", 1));
+  out = Infer(def);
+  EXPECT_EQ(Dims(out[0]), std::vector<int64_t>({2, 8, 168, 112}));
+}
+
+// The pathways are cut from one clip at the gcd of their sampling rates:
+// pathway 0 takes 4 frames at rate 1, pathway 1 2 frames at rate 2.
+TEST(CustomizedVideoInputOpTest, CutsThePathwaysFromOneClip) {
+  char dir[] = "/tmp/customized_video_input_op_test_XXXXXX";
+  ASSERT_NE(mkdtemp(dir), nullptr);
+  const std::vector<int> starts = {2, 5};
+  const std::string db_name = WriteFramesAndDB(dir, 16, starts);
+  Workspace ws;
+  ws.CreateBlob("reader")->Reset(new db::DBReader("minidb", db_name));
+
+  auto def = InputDef({"fast", "labels", "slow"});
+  def.add_input("reader");
+  def.add_arg()->CopyFrom(MakeArgument<int>("crop", 8));
+  def.add_arg()->CopyFrom(MakeArgument<int>("is_test", 1));
+  def.add_arg()->CopyFrom(MakeArgument<int>("use_local_file", 1));
+  def.add_arg()->CopyFrom(MakeArgument<int>("use_image", 1));
+  def.add_arg()->CopyFrom(MakeArgument<string>("im_extension", ".png"));
+  // the frames keep their size of 12x16
+  def.add_arg()->CopyFrom(MakeArgument<int>("use_scale_augmentaiton", 1));
+  def.add_arg()->CopyFrom(MakeArgument<int>("min_size", 12));
+  def.add_arg()->CopyFrom(MakeArgument<int>("max_size", 12));
+  // the records start at frame start_frm * 16 / sample_times
+  def.add_arg()->CopyFrom(MakeArgument<int>("temporal_jitter", 0));
+  def.add_arg()->CopyFrom(MakeArgument<int>("sample_times", 16));
+  def.add_arg()->CopyFrom(MakeArgument<int>("decode_threads", 1));
+  def.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("pathway_lengths", {4, 2}));
+  def.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("pathway_sampling_rates", {1, 2}));
+  auto op = CreateOperator(def, &ws);
+  ASSERT_TRUE(op->Run());
+
+  const std::vector<std::string> names = {"fast", "slow"};
+  const std::vector<int> lengths = {4, 2};
+  const std::vector<int> steps = {1, 2};
+  for (int k = 0; k < names.size(); ++k) {
+    const auto& clip = ws.GetBlob(names[k])->Get<TensorCPU>();
+    ASSERT_EQ(clip.dims(), std::vector<TIndex>({2, 3, lengths[k], 8, 8}));
+    const float* data = clip.data<float>();
+    for (int n = 0; n < 2; ++n) {
+      for (int c = 0; c < 3; ++c) {
+        for (int t = 0; t < lengths[k]; ++t) {
+          const float* frame =
+              data + ((n * 3 + c) * lengths[k] + t) * 8 * 8;
+          for (int i = 0; i < 8 * 8; ++i) {
+            EXPECT_EQ(frame[i], 10.f * (starts[n] + t * steps[k]))
+                << names[k] << " clip " << n << " frame " << t;
+          }
+        }
+      }
+    }
+  }
+}
+
+} // namespace caffe2
@@ -23,10 +23,21 @@
   */
 
 #include "caffe2/video/customized_video_io.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
 #include <random>
 #include <string>
 #include "caffe2/core/logging.h"
+#include "caffe2/perfkernels/clip_transform.h"
+#include "caffe2/utils/parallel_for.h"
+#include "caffe2/video/clip_arena.h"
 #include "caffe2/video/customized_video_decoder.h"
+#include "caffe2/video/shared_frame_cache.h"
+#include "caffe2/video/video_record.h"
 
 namespace caffe2 {
 
@@ -54,6 +65,20 @@ void ImageDataToBuffer(
   }
 }
 
+void ImageDataToBuffer(
+    unsigned char* data_buffer,
+    int height,
+    int width,
+    unsigned char* buffer,
+    int c) {
+  int idx = 0;
+  for (int h = 0; h < height; ++h) {
+    for (int w = 0; w < width; ++w) {
+      buffer[idx++] = data_buffer[h * width * 3 + w * 3 + c];
+    }
+  }
+}
+
 bool ReadClipFromFrames(
     std::string img_dir,
     const int start_frm,
@@ -113,6 +138,36 @@ bool ReadClipFromFrames(
   return true;
 }
 
+void ReadaheadVideoFile(const std::string& filename) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+  close(fd);
+}
+
+int GetNumberOfImages(std::string input_dir, std::string file_extension) {
+  DIR* dir = opendir(input_dir.c_str());
+  if (dir == nullptr) {
+    LOG(ERROR) << "Cannot open " << input_dir;
+    return 0;
+  }
+  int num_of_images = 0;
+  while (struct dirent* entry = readdir(dir)) {
+    const std::string name(entry->d_name);
+    if (name.size() > file_extension.size() &&
+        name.compare(
+            name.size() - file_extension.size(),
+            file_extension.size(),
+            file_extension) == 0) {
+      num_of_images++;
+    }
+  }
+  closedir(dir);
+  return num_of_images;
+}
+
 int GetNumberOfFrames(std::string filename) {
   cv::VideoCapture cap;
   cap.open(filename);
@@ -151,6 +206,16 @@ void GetVideoMeta(std::string filename, int& number_of_frames, double& fps) {
   }
 }
 
+void GetVideoMeta(const VideoRecord& record, int& number_of_frames, double& fps) {
+  if (record.has_meta()) {
+    number_of_frames = record.num_frames;
+    fps = record.fps;
+    return;
+  }
+  GetVideoMeta(
+      std::string(record.payload, record.payload_size), number_of_frames, fps);
+}
+
 bool ReadClipFromVideoLazzy(
     std::string filename,
     const int start_frm,
@@ -382,14 +447,12 @@ bool DecodeClipFromVideoFile(
       buffer = new float[data_size];
     }
 
-    for (int c = 0; c < 3; c++) {
-      ImageDataToBuffer(
-          (unsigned char*)sampledFrames[i]->data_.get(),
-          sampledFrames[i]->height_,
-          sampledFrames[i]->width_,
-          buffer + c * channel_size + offset,
-          c);
-    }
+    // deinterleave all three channels of the frame in one pass
+    PackedRGBToPlanarFloat(
+        (unsigned char*)sampledFrames[i]->data_.get(),
+        image_size,
+        channel_size,
+        buffer + offset);
     offset += image_size;
   }
   CAFFE_ENFORCE(offset == channel_size, "Wrong offset size");
@@ -413,7 +476,7 @@ bool DecodeClipFromMemoryBuffer(
     const int width,
     const int sampling_rate,
     float*& buffer,
-    std::mt19937* randgen) {
+    PhiloxRandom* randgen) {
   Params params;
   std::vector<std::unique_ptr<DecodedFrame>> sampledFrames;
   CustomVideoDecoder decoder;
@@ -471,14 +534,12 @@ bool DecodeClipFromMemoryBuffer(
       buffer = new float[data_size];
     }
 
-    for (int c = 0; c < 3; c++) {
-      ImageDataToBuffer(
-          (unsigned char*)sampledFrames[i]->data_.get(),
-          sampledFrames[i]->height_,
-          sampledFrames[i]->width_,
-          buffer + c * channel_size + offset,
-          c);
-    }
+    // deinterleave all three channels of the frame in one pass
+    PackedRGBToPlanarFloat(
+        (unsigned char*)sampledFrames[i]->data_.get(),
+        image_size,
+        channel_size,
+        buffer + offset);
     offset += image_size;
   }
   CAFFE_ENFORCE(offset == channel_size, "Wrong offset size");
@@ -498,26 +559,20 @@ bool DecodeClipFromMemoryBuffer(
 // customized functions follow
 // ----------------------------------------------------------------
 
-void ClipTransformFlex(
-    const float* clip_data,
-    const int channels,
-    const int length,
+// pick the crop offsets in a height x width frame, center (or one of the
+// multi-crop positions) for testing and random for training
+static void GetCropOffsets(
     const int height,
     const int width,
     const int h_crop,
     const int w_crop,
-    const bool mirror,
-    float mean,
-    float std,
-    float* transformed_clip,
-    std::mt19937* randgen,
-    std::bernoulli_distribution* mirror_this_clip,
+    PhiloxRandom* randgen,
     const bool use_center_crop,
-    const bool use_bgr,
-    const int spatial_pos
-  ) {
-  int h_off = 0;
-  int w_off = 0;
+    const int spatial_pos,
+    int& h_off,
+    int& w_off) {
+  h_off = 0;
+  w_off = 0;
 
   assert(height >= h_crop);
   assert(width >= w_crop);
@@ -536,119 +591,524 @@ void ClipTransformFlex(
     h_off = std::uniform_int_distribution<>(0, height - h_crop)(*randgen);
     w_off = std::uniform_int_distribution<>(0, width - w_crop)(*randgen);
   }
+}
+
+void ClipTransformFlex(
+    const unsigned char* clip_data,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int h_crop,
+    const int w_crop,
+    const bool mirror,
+    float mean,
+    float std,
+    float* transformed_clip,
+    PhiloxRandom* randgen,
+    std::bernoulli_distribution* mirror_this_clip,
+    const bool use_center_crop,
+    const bool use_bgr,
+    const int spatial_pos
+  ) {
+  int h_off = 0;
+  int w_off = 0;
+  GetCropOffsets(
+      height,
+      width,
+      h_crop,
+      w_crop,
+      randgen,
+      use_center_crop,
+      spatial_pos,
+      h_off,
+      w_off);
 
   float inv_std = 1.f / std;
-  int top_index, data_index;
   bool mirror_me = mirror && (*mirror_this_clip)(*randgen);
   if (spatial_pos >= 0)
   {
     mirror_me = int(spatial_pos / 3);
   }
 
+  // the frames are independent, one output plane per iteration
+  ParallelFor(
+      channels * length,
+      ParallelForGrainSize(h_crop * w_crop),
+      [&](int64_t begin, int64_t end) {
+        for (int64_t plane = begin; plane < end; ++plane) {
+          const int c = plane / length;
+          const int src_c = use_bgr ? channels - c - 1 : c;
+          ClipTransformUint8(
+              clip_data +
+                  (src_c * length + plane % length) * height * width,
+              1,
+              1,
+              height,
+              width,
+              h_off,
+              w_off,
+              h_crop,
+              w_crop,
+              mean,
+              inv_std,
+              mirror_me,
+              false,
+              transformed_clip + plane * h_crop * w_crop);
+        }
+      });
+}
+
+void GetClipCropWindow(
+    const int height,
+    const int width,
+    const int h_crop,
+    const int w_crop,
+    const bool mirror,
+    PhiloxRandom* randgen,
+    std::bernoulli_distribution* mirror_this_clip,
+    const bool use_center_crop,
+    const int spatial_pos,
+    int* h_off,
+    int* w_off,
+    int* mirror_me) {
+  GetCropOffsets(
+      height,
+      width,
+      h_crop,
+      w_crop,
+      randgen,
+      use_center_crop,
+      spatial_pos,
+      *h_off,
+      *w_off);
+
+  *mirror_me = mirror && (*mirror_this_clip)(*randgen);
+  if (spatial_pos >= 0)
+  {
+    *mirror_me = int(spatial_pos / 3);
+  }
+}
+
+void ClipCropFlex(
+    const unsigned char* clip_data,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int h_crop,
+    const int w_crop,
+    const bool mirror,
+    unsigned char* cropped_clip,
+    PhiloxRandom* randgen,
+    std::bernoulli_distribution* mirror_this_clip,
+    const bool use_center_crop,
+    const int spatial_pos,
+    int* mirror_me
+  ) {
+  int h_off = 0;
+  int w_off = 0;
+  GetClipCropWindow(
+      height,
+      width,
+      h_crop,
+      w_crop,
+      mirror,
+      randgen,
+      mirror_this_clip,
+      use_center_crop,
+      spatial_pos,
+      &h_off,
+      &w_off,
+      mirror_me);
+
   for (int c = 0; c < channels; ++c) {
     for (int l = 0; l < length; ++l) {
+      const unsigned char* src =
+          clip_data + ((c * length + l) * height + h_off) * width + w_off;
+      unsigned char* dst = cropped_clip + (c * length + l) * h_crop * w_crop;
       for (int h = 0; h < h_crop; ++h) {
-        for (int w = 0; w < w_crop; ++w) {
-          if (!use_bgr) { // rgb as is
-            data_index =
-                ((c * length + l) * height + h_off + h) * width + w_off + w;
-          } else {
-            data_index =
-                (((channels - c - 1) * length + l) * height + h_off + h) * width
-                + w_off + w;
-          }
-          if (mirror_me) {
-            top_index = ((c * length + l) * h_crop + h) * w_crop +
-                (w_crop - 1 - w);
-          } else {
-            top_index = ((c * length + l) * h_crop + h) * w_crop + w;
-          }
-          transformed_clip[top_index] =
-              (clip_data[data_index] - mean) * inv_std;
-        }
+        memcpy(dst, src, w_crop);
+        src += width;
+        dst += w_crop;
+      }
+    }
+  }
+}
+
+void YuvClipCropFlex(
+    const unsigned char* clip_data,
+    const int length,
+    const int height,
+    const int width,
+    const int h_crop,
+    const int w_crop,
+    const bool mirror,
+    unsigned char* cropped_clip,
+    PhiloxRandom* randgen,
+    std::bernoulli_distribution* mirror_this_clip,
+    const bool use_center_crop,
+    const int spatial_pos,
+    int* mirror_me
+  ) {
+  int h_off = 0;
+  int w_off = 0;
+  GetCropOffsets(
+      height,
+      width,
+      h_crop,
+      w_crop,
+      randgen,
+      use_center_crop,
+      spatial_pos,
+      h_off,
+      w_off);
+  // a chroma sample covers 2 x 2 luma pixels
+  h_off &= ~1;
+  w_off &= ~1;
+
+  *mirror_me = mirror && (*mirror_this_clip)(*randgen);
+  if (spatial_pos >= 0)
+  {
+    *mirror_me = int(spatial_pos / 3);
+  }
+
+  const PlanarLayout in(width, height, true);
+  const PlanarLayout out(w_crop, h_crop, true);
+  for (int l = 0; l < length; ++l) {
+    for (int c = 0; c < 3; ++c) {
+      const int shift = c > 0 ? 1 : 0;
+      const unsigned char* src = clip_data + in.offset(length, l, c) +
+          (h_off >> shift) * in.width[c] + (w_off >> shift);
+      unsigned char* dst = cropped_clip + out.offset(1, 0, c);
+      for (int h = 0; h < out.height[c]; ++h) {
+        memcpy(dst, src, out.width[c]);
+        src += in.width[c];
+        dst += out.width[c];
       }
     }
+    cropped_clip += out.frameSize;
+  }
+}
+
+int GetScaleSideLength(
+    const int max_size,
+    const int min_size,
+    PhiloxRandom* randgen) {
+  if (min_size == max_size)
+  {
+    return min_size;
   }
+  return std::uniform_int_distribution<>(min_size, max_size)(*randgen);
+}
+
+void GetScaledSize(
+    const int height,
+    const int width,
+    const int max_size,
+    const int min_size,
+    PhiloxRandom* randgen,
+    int & new_height,
+    int & new_width) {
+  int side_length = GetScaleSideLength(max_size, min_size, randgen);
+
+  float ratio = 1;
+
+  if (height > width)
+  {
+    ratio = (float)side_length / (float)width;
+  }
+  else
+  {
+    ratio = (float)side_length / (float)height;
+  }
+  new_height = (int)((float)height * ratio);
+  new_width = (int)((float)width * ratio);
 }
 
 void ScaleTransform(
-    const float* clip_data,
+    const unsigned char* clip_data,
     const int channels,
     const int length,
     const int height,
     const int width,
     const int max_size,
     const int min_size,
-    float*& buffer,
-    std::mt19937* randgen,
+    std::vector<unsigned char>& buffer,
+    PhiloxRandom* randgen,
     int & new_height,
     int & new_width)
     {
-      int side_length;
+      GetScaledSize(
+          height, width, max_size, min_size, randgen, new_height, new_width);
 
-      if (min_size == max_size)
-      {
-        side_length = min_size;
-      }
-      else
+      const int image_size = height * width;
+      const int new_image_size = new_height * new_width;
+      buffer.resize(new_image_size * length * channels);
+
+      // resize each plane of the clip in place, without repacking to HWC
+      for (int c = 0; c < channels; ++c)
       {
-        side_length =
-          std::uniform_int_distribution<>(min_size, max_size)(*randgen);
-      }
-      new_height = height;
-      new_width  = width;
+        for (int l = 0; l < length; ++l)
+        {
+          cv::Mat img_origin(
+              height,
+              width,
+              CV_8UC1,
+              const_cast<unsigned char*>(
+                  clip_data + (c * length + l) * image_size));
+          cv::Mat img(
+              new_height,
+              new_width,
+              CV_8UC1,
+              buffer.data() + (c * length + l) * new_image_size);
+          cv::resize(img_origin, img, cv::Size(new_width, new_height));
+        } // l
+      } // c
+    } // ScaleTransform
 
-      float ratio = 1;
+// bilinear source taps along one axis, matching cv::resize INTER_LINEAR
+static void GetLinearTaps(
+    const int src_size,
+    const int dst_size,
+    const int dst_off,
+    const int dst_len,
+    std::vector<int>& idx0,
+    std::vector<int>& idx1,
+    std::vector<float>& frac) {
+  const double scale = (double)src_size / dst_size;
+  idx0.resize(dst_len);
+  idx1.resize(dst_len);
+  frac.resize(dst_len);
+  for (int d = 0; d < dst_len; ++d) {
+    float f = (float)((dst_off + d + 0.5) * scale - 0.5);
+    int s = (int)floorf(f);
+    f -= s;
+    if (s < 0) {
+      s = 0;
+      f = 0;
+    }
+    if (s >= src_size - 1) {
+      s = src_size - 1;
+      f = 0;
+    }
+    idx0[d] = s;
+    idx1[d] = std::min(s + 1, src_size - 1);
+    frac[d] = f;
+  }
+}
 
-      buffer = nullptr;
+void ScaleCropNormalizeTransform(
+    const unsigned char* clip_data,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int scaled_height,
+    const int scaled_width,
+    const int h_crop,
+    const int w_crop,
+    const bool mirror,
+    float mean,
+    float std,
+    float* transformed_clip,
+    PhiloxRandom* randgen,
+    std::bernoulli_distribution* mirror_this_clip,
+    const bool use_center_crop,
+    const bool use_bgr,
+    const int spatial_pos) {
+  // the crop window and mirroring are drawn in the same order as in
+  // ScaleTransform + ClipTransformFlex
+  int h_off = 0;
+  int w_off = 0;
+  GetCropOffsets(
+      scaled_height,
+      scaled_width,
+      h_crop,
+      w_crop,
+      randgen,
+      use_center_crop,
+      spatial_pos,
+      h_off,
+      w_off);
 
-      if (height > width)
-      {
-        ratio = (float)side_length / (float)width;
-      }
-      else
-      {
-        ratio = (float)side_length / (float)height;
+  bool mirror_me = mirror && (*mirror_this_clip)(*randgen);
+  if (spatial_pos >= 0)
+  {
+    mirror_me = int(spatial_pos / 3);
+  }
+
+  // only the pixels inside the crop window get interpolated
+  std::vector<int> y0, y1, x0, x1;
+  std::vector<float> fy, fx;
+  GetLinearTaps(height, scaled_height, h_off, h_crop, y0, y1, fy);
+  GetLinearTaps(width, scaled_width, w_off, w_crop, x0, x1, fx);
+
+  // the frames are independent, one output plane per iteration
+  ParallelFor(
+      channels * length,
+      ParallelForGrainSize(h_crop * w_crop),
+      [&](int64_t begin, int64_t end) {
+        for (int64_t plane = begin; plane < end; ++plane) {
+          const int c = plane / length;
+          const int src_c = use_bgr ? channels - c - 1 : c;
+          BilinearClipTransformUint8(
+              clip_data +
+                  (src_c * length + plane % length) * height * width,
+              1, 1, height, width, y0.data(), y1.data(), fy.data(), h_crop,
+              x0.data(), x1.data(), fx.data(), w_crop, mean, 1.f / std,
+              mirror_me, false, transformed_clip + plane * h_crop * w_crop);
+        }
+      });
+}
+
+// copy the sampled frames of a fully decoded video into a planar clip,
+// sampled at clip_fps if the frame rates are known. The frames of a yuv clip
+// are YUV420P, which is laid out like a planar clip of one frame
+static void SampledFramesToPlanarClip(
+    const std::vector<std::unique_ptr<DecodedFrame>>& sampledFrames,
+    const int use_start_frm,
+    const int length,
+    const int sampling_rate,
+    std::vector<unsigned char>& buffer,
+    const double video_fps = 0,
+    const double clip_fps = 0,
+    const bool yuv = false) {
+  const PlanarLayout layout(
+      sampledFrames[0]->width_, sampledFrames[0]->height_, yuv);
+  const int image_size = layout.size[0];
+  const int channel_size = image_size * length;
+  buffer.resize(layout.frameSize * length);
+
+  int offset = 0;
+  for (int idx = 0; idx < length; idx ++){
+    int i = use_start_frm +
+        ClipFrameOffset(idx * sampling_rate, video_fps, clip_fps);
+    // TODO{km}: consider cylindric sampling
+    i = i % (int)(sampledFrames.size());  // periodic sampling
+    const unsigned char* data =
+        (unsigned char*)sampledFrames[i]->data_.get();
+    if (yuv) {
+      for (int c = 0; c < 3; c++) {
+        memcpy(
+            buffer.data() + layout.offset(length, idx, c),
+            data + layout.start[c],
+            layout.size[c]);
       }
-      new_height = (int)((float)height * ratio);
-      new_width = (int)((float)width * ratio);
+    } else {
+      // deinterleave all three channels of the frame in one pass
+      PackedRGBToPlanarUint8(
+          data, image_size, channel_size, buffer.data() + offset);
+    }
+    offset += image_size;
+  }
+  CAFFE_ENFORCE(offset == channel_size, "Wrong offset size");
+}
 
-      cv::Mat img(cv::Size(new_width, new_height), CV_8UC3);
-      cv::Mat img_origin(cv::Size(width, height), CV_8UC3);
+// frame rate of the fully decoded video from the timestamps of its frames,
+// 0 if they do not tell
+static double SampledFramesFps(
+    const std::vector<std::unique_ptr<DecodedFrame>>& sampledFrames) {
+  if (sampledFrames.size() < 2) {
+    return 0;
+  }
+  const double duration =
+      sampledFrames.back()->timestamp_ - sampledFrames[0]->timestamp_;
+  return duration > 0 ? (sampledFrames.size() - 1) / duration : 0;
+}
 
-      int image_size = new_height * new_width;
-      int channel_size = image_size * length;
-      int data_size = channel_size * 3;
-      buffer = new float[data_size];
-      int offset = 0;
+// one decoder per decode thread that keeps the contexts of the last file
+// open, as consecutive db entries often come from the same video
+// start frame of the clip in a video of num_of_frames frames, random if
+// start_frm < 0 (near a key frame of stream_info, see RandomClipStart) and
+// slot start_frm of sample_times evenly spaced ones otherwise
+static int ChooseClipStart(
+    const int num_of_frames,
+    const int start_frm,
+    const int clip_frames,
+    const int sample_times,
+    PhiloxRandom* randgen,
+    const VideoStreamInfo* stream_info) {
+  if (start_frm < 0) { // perform temporal jittering
+    return RandomClipStart(
+        num_of_frames,
+        clip_frames,
+        stream_info ? *stream_info : VideoStreamInfo(),
+        randgen);
+  }
+  float frame_gaps = (float)(num_of_frames) / (float)(sample_times);
+  return ((int)(frame_gaps * start_frm)) % num_of_frames;
+}
 
-      for (int l = 0; l < length; ++l)
-      {
-        for (int c = 0; c < 3; ++c)
-        {
-          for (int h = 0; h < height; ++h)
-          {
-            for (int w = 0; w < width; ++w)
-            {
-              int data_index = ((c * length + l) * height  + h) * width  + w;
-              float tnum = clip_data[data_index];
-              img_origin.at<cv::Vec3b>(h, w)[c] = (uchar)(tnum);
-              // img_origin.at<cv::Vec3b>(h, w)[2 - c] = (uchar)(tnum);
-            } // w
-          } // h
-        } // c
-        cv::resize(img_origin, img, cv::Size(new_width, new_height));
-
-        for (int c = 0; c < 3; c++) {
-          ImageChannelToBuffer(&img, buffer + c * channel_size + offset, c);
-        } // c
-        offset += image_size;
-      } // l
-      CAFFE_ENFORCE(offset == channel_size, "Wrong offset size");
-      img_origin.release();
-      img.release();
-    } // ScaleTransform
+// fills the planar clip buffer from the frame cache, false unless all the
+// frames of the clip are cached with the same size
+static bool ReadCachedClip(
+    SharedFrameCache* frame_cache,
+    const std::string& filename,
+    const int clip_start,
+    const int length,
+    const int sampling_rate,
+    std::vector<unsigned char>& buffer,
+    int& height,
+    int& width) {
+  std::vector<uint8_t> planes;
+  int image_size = 0;
+  for (int idx = 0; idx < length; idx++) {
+    int frame_height;
+    int frame_width;
+    if (!frame_cache->Lookup(
+            filename,
+            clip_start + idx * sampling_rate,
+            &frame_height,
+            &frame_width,
+            &planes)) {
+      return false;
+    }
+    if (idx == 0) {
+      height = frame_height;
+      width = frame_width;
+      image_size = height * width;
+      buffer.resize(image_size * length * 3);
+    } else if (frame_height != height || frame_width != width) {
+      return false;
+    }
+    for (int c = 0; c < 3; c++) {
+      memcpy(
+          buffer.data() + c * image_size * length + idx * image_size,
+          planes.data() + c * image_size,
+          image_size);
+    }
+  }
+  return true;
+}
 
+// puts the frames of a planar clip buffer into the frame cache
+static void CacheClip(
+    SharedFrameCache* frame_cache,
+    const std::string& filename,
+    const int clip_start,
+    const int length,
+    const int sampling_rate,
+    const std::vector<unsigned char>& buffer,
+    const int height,
+    const int width) {
+  const int image_size = height * width;
+  for (int idx = 0; idx < length; idx++) {
+    frame_cache->Insert(
+        filename,
+        clip_start + idx * sampling_rate,
+        height,
+        width,
+        buffer.data() + idx * image_size,
+        image_size * length);
+  }
+}
+
+static CustomVideoDecoder& ThreadLocalDecoder() {
+  thread_local CustomVideoDecoder decoder;
+  decoder.reuseContexts(true);
+  return decoder;
+}
 
 // for reading file from lmdb
 bool DecodeClipFromVideoFileFlex(
@@ -658,67 +1118,272 @@ bool DecodeClipFromVideoFileFlex(
     int & height,
     int & width,
     const int sampling_rate,
-    float*& buffer,
-    std::mt19937* randgen,
-    const int sample_times
+    std::vector<unsigned char>& buffer,
+    PhiloxRandom* randgen,
+    const int sample_times,
+    const bool use_selective_decoding,
+    const int min_size,
+    const int max_size,
+    const bool use_decoder_cache,
+    const int decode_backend,
+    const bool use_frame_arena,
+    const VideoStreamInfo* stream_info,
+    SharedFrameCache* frame_cache,
+    const int io_buffer_size,
+    const bool use_mmap,
+    const bool skip_nonref_frames,
+    const int codec_threads,
+    RemoteVideoStore* remote_store,
+    const float target_fps,
+    const int decode_quality,
+    const bool yuv_output
   ) {
   Params params;
   std::vector<std::unique_ptr<DecodedFrame>> sampledFrames;
-  CustomVideoDecoder decoder;
+  CustomVideoDecoder local_decoder;
+  CustomVideoDecoder& decoder =
+      use_decoder_cache ? ThreadLocalDecoder() : local_decoder;
 
   params.outputHeight_ = -1;
   params.outputWidth_ = -1;
   params.maximumOutputFrames_ = MAX_DECODING_FRAMES;
+  params.decodeBackend(static_cast<DecodeBackend>(decode_backend));
+  params.decodeQuality(static_cast<DecodeQuality>(decode_quality));
+  params.yuvOutput(yuv_output);
+  params.codecThreads(codec_threads);
+  if (io_buffer_size > 0) {
+    params.ioBufferSize(io_buffer_size);
+  }
+  params.mmapInput(use_mmap);
+  params.remoteStore(remote_store);
+  params.clipFps(target_fps);
+  if (stream_info) {
+    params.streamInfo(*stream_info);
+  }
+  if (use_frame_arena) {
+    // the frames of the previous clip are gone by now
+    ClipArena& arena = ThreadLocalClipArena();
+    arena.Reset();
+    params.frameArena(&arena);
+  }
+  if (min_size > 0) {
+    // scale augmentation happens in the colour conversion pass
+    params.outputShortSide(GetScaleSideLength(max_size, min_size, randgen));
+  }
 
-  // decode all frames with defaul sampling rate
-  decoder.decodeFile(filename, params, sampledFrames);
-
-  buffer = nullptr;
-  int offset = 0;
-  int channel_size = 0;
-  int image_size = 0;
-  int data_size = 0;
-  CAFFE_ENFORCE_LT(1, sampledFrames.size(), "video cannot be empty");
+  const int clip_frames = length * sampling_rate;
+  // the clip window in frames of the video, which is only known ahead for
+  // a target fps with the frame rate of the video
+  int window_frames = clip_frames;
+  if (target_fps > 0) {
+    window_frames = stream_info && stream_info->fps > 0
+        ? ClipFrameOffset(clip_frames - 1, stream_info->fps, target_fps) + 1
+        : -1;
+  }
+  // with the frame count known, the clip is placed before decoding begins
+  int known_start = -1;
+  if (stream_info && window_frames > 0 &&
+      stream_info->numFrames >= window_frames) {
+    known_start = ChooseClipStart(
+        stream_info->numFrames,
+        start_frm,
+        window_frames,
+        sample_times,
+        randgen,
+        stream_info);
+    if (known_start + window_frames > stream_info->numFrames) {
+      // the window wraps around the end of the video
+      known_start = -1;
+    }
+  }
+  // the cached frames are those sampling_rate apart, in RGB
+  const bool use_frame_cache = frame_cache && target_fps <= 0 && !yuv_output;
+  if (use_frame_cache && known_start >= 0 &&
+      ReadCachedClip(
+          frame_cache,
+          filename,
+          known_start,
+          length,
+          sampling_rate,
+          buffer,
+          height,
+          width)) {
+    return true;
+  }
 
-  int use_start_frm = start_frm;
-  if (start_frm < 0) { // perform temporal jittering
-    if ((int)(sampledFrames.size() - length * sampling_rate) > 0) {
-      use_start_frm = std::uniform_int_distribution<>(
-          0, (int)(sampledFrames.size() - length * sampling_rate))(*randgen);
-    } else { use_start_frm = 0; }
+  int clip_start = -1;
+  if (use_selective_decoding) {
+    // only decode the clip window, starting from the preceding key frame,
+    // and only convert the frames that are sampled from it straight into
+    // the planar clip buffer
+    std::vector<int> clip_indices;
+    for (int idx = 0; idx < length; idx++) {
+      clip_indices.push_back(idx * sampling_rate);
+    }
+    params.clipSlot(start_frm, sample_times)
+        .clipStart(known_start)
+        .randomGenerator(randgen)
+        .outputFrameIndices(clip_indices)
+        .planarOutput(&buffer)
+        .skipNonRefFrames(skip_nonref_frames && sampling_rate > 1);
+    clip_start = decoder.decodeFile(
+        filename, params, sampledFrames, clip_frames, false);
+    // with a target fps the decoder voids an incomplete window itself
+    const int min_frames = target_fps > 0 ? 1 : clip_frames;
+    if (clip_start >= 0 && sampledFrames.size() < min_frames) {
+      /* selective decoding failed. Decode the video as a stream. */
+      clip_start = -1;
+    }
+    params.outputFrameIndices_.clear();
+    params.skipNonRefFrames(false);
   }
-  else
-  {
-    int num_of_frames = (int)(sampledFrames.size());
-    float frame_gaps = (float)(num_of_frames) / (float)(sample_times);
-    use_start_frm = ((int)(frame_gaps * start_frm)) % num_of_frames;
+  if (clip_start < 0) {
+    // decode the video front to back, holding one clip window of frames at
+    // most instead of all the frames of the video
+    params.clipSlot(start_frm, sample_times)
+        .clipStart(known_start)
+        .randomGenerator(randgen)
+        .planarOutput(&buffer)
+        .streamingClip(length, sampling_rate);
+    clip_start = decoder.decodeFile(filename, params, sampledFrames);
+  }
+  if (clip_start < 0) {
+    // the frame count was off, decode all frames with defaul sampling rate
+    params.planarOutput_ = nullptr;
+    params.streamingClip(0, 1);
+    decoder.decodeFile(filename, params, sampledFrames);
   }
 
+  // a streamed clip of one frame is fine
+  CAFFE_ENFORCE_LT(
+      clip_start >= 0 ? 0 : 1, sampledFrames.size(), "video cannot be empty");
 
   height = (int)sampledFrames[0]->height_;
   width  = (int)sampledFrames[0]->width_;
 
-  for (int idx = 0; idx < length; idx ++){
-    int i = use_start_frm + idx * sampling_rate;
-    i = i % (int)(sampledFrames.size());
-    if (idx == 0) {
-      image_size = sampledFrames[i]->height_ * sampledFrames[i]->width_;
-      channel_size = image_size * length;
-      data_size = channel_size * 3;
-      buffer = new float[data_size];
+  if (clip_start < 0) {
+    const double video_fps =
+        target_fps > 0 ? SampledFramesFps(sampledFrames) : 0;
+    const int video_window_frames =
+        ClipFrameOffset(clip_frames - 1, video_fps, target_fps) + 1;
+    int use_start_frm = known_start >= 0 ? known_start : ChooseClipStart(
+        (int)sampledFrames.size(),
+        start_frm,
+        video_window_frames,
+        sample_times,
+        randgen,
+        stream_info);
+
+    SampledFramesToPlanarClip(
+        sampledFrames,
+        use_start_frm,
+        length,
+        sampling_rate,
+        buffer,
+        video_fps,
+        target_fps,
+        yuv_output);
+    if (use_start_frm + video_window_frames <= sampledFrames.size()) {
+      clip_start = use_start_frm;
     }
+  } // else the buffer has already been filled
+
+  if (use_frame_cache && known_start >= 0 && clip_start == known_start) {
+    CacheClip(
+        frame_cache,
+        filename,
+        clip_start,
+        length,
+        sampling_rate,
+        buffer,
+        height,
+        width);
+  }
 
-    for (int c = 0; c < 3; c++) {
-      ImageDataToBuffer(
-          (unsigned char*)sampledFrames[i]->data_.get(),
-          sampledFrames[i]->height_,
-          sampledFrames[i]->width_,
-          buffer + c * channel_size + offset,
-          c);
-    }
-    offset += image_size;
+  // free the sampledFrames
+  for (int i = 0; i < sampledFrames.size(); i++) {
+    DecodedFrame* p = sampledFrames[i].release();
+    delete p;
+  }
+  sampledFrames.clear();
+
+  return true;
+}
+
+// for reading all the test clips of a file from lmdb
+bool DecodeClipsFromVideoFileFlex(
+    std::string filename,
+    const int length,
+    int & height,
+    int & width,
+    const int sampling_rate,
+    std::vector<std::vector<unsigned char>>& clips,
+    PhiloxRandom* randgen,
+    const int sample_times,
+    const int min_size,
+    const int max_size,
+    const bool use_decoder_cache,
+    const int decode_backend,
+    const bool use_frame_arena,
+    const int io_buffer_size,
+    const bool use_mmap,
+    const int codec_threads,
+    RemoteVideoStore* remote_store,
+    const float target_fps,
+    const int decode_quality
+  ) {
+  Params params;
+  std::vector<std::unique_ptr<DecodedFrame>> sampledFrames;
+  CustomVideoDecoder local_decoder;
+  CustomVideoDecoder& decoder =
+      use_decoder_cache ? ThreadLocalDecoder() : local_decoder;
+
+  params.outputHeight_ = -1;
+  params.outputWidth_ = -1;
+  params.maximumOutputFrames_ = MAX_DECODING_FRAMES;
+  params.decodeBackend(static_cast<DecodeBackend>(decode_backend));
+  params.decodeQuality(static_cast<DecodeQuality>(decode_quality));
+  params.codecThreads(codec_threads);
+  if (io_buffer_size > 0) {
+    params.ioBufferSize(io_buffer_size);
+  }
+  params.mmapInput(use_mmap);
+  params.remoteStore(remote_store);
+  if (use_frame_arena) {
+    // the frames of the previous clip are gone by now
+    ClipArena& arena = ThreadLocalClipArena();
+    arena.Reset();
+    params.frameArena(&arena);
+  }
+  if (min_size > 0) {
+    // all the clips share the scale drawn here
+    params.outputShortSide(GetScaleSideLength(max_size, min_size, randgen));
+  }
+
+  // the clips are spread over the whole video, so decode all frames
+  decoder.decodeFile(filename, params, sampledFrames);
+
+  CAFFE_ENFORCE_LT(1, sampledFrames.size(), "video cannot be empty");
+
+  height = (int)sampledFrames[0]->height_;
+  width  = (int)sampledFrames[0]->width_;
+
+  clips.resize(sample_times);
+  const int num_of_frames = (int)(sampledFrames.size());
+  const float frame_gaps = (float)(num_of_frames) / (float)(sample_times);
+  const double video_fps =
+      target_fps > 0 ? SampledFramesFps(sampledFrames) : 0;
+  for (int t = 0; t < sample_times; t++) {
+    const int use_start_frm = ((int)(frame_gaps * t)) % num_of_frames;
+    SampledFramesToPlanarClip(
+        sampledFrames,
+        use_start_frm,
+        length,
+        sampling_rate,
+        clips[t],
+        video_fps,
+        target_fps);
   }
-  CAFFE_ENFORCE(offset == channel_size, "Wrong offset size");
 
   // free the sampledFrames
   for (int i = 0; i < sampledFrames.size(); i++) {
@@ -740,8 +1405,20 @@ bool DecodeClipFromMemoryBufferFlex(
     int & height,
     int & width,
     const int sampling_rate,
-    float*& buffer,
-    std::mt19937* randgen) {
+    std::vector<unsigned char>& buffer,
+    PhiloxRandom* randgen,
+    const bool use_selective_decoding,
+    const int min_size,
+    const int max_size,
+    const int decode_backend,
+    const bool use_frame_arena,
+    const VideoStreamInfo* stream_info,
+    const int io_buffer_size,
+    const bool skip_nonref_frames,
+    const int codec_threads,
+    const float target_fps,
+    const int decode_quality,
+    const bool yuv_output) {
   Params params;
   std::vector<std::unique_ptr<DecodedFrame>> sampledFrames;
   CustomVideoDecoder decoder;
@@ -749,70 +1426,102 @@ bool DecodeClipFromMemoryBufferFlex(
   params.outputHeight_ = -1;
   params.outputWidth_ =  -1;
   params.maximumOutputFrames_ = MAX_DECODING_FRAMES;
+  params.decodeBackend(static_cast<DecodeBackend>(decode_backend));
+  params.decodeQuality(static_cast<DecodeQuality>(decode_quality));
+  params.yuvOutput(yuv_output);
+  params.codecThreads(codec_threads);
+  params.clipFps(target_fps);
+  if (io_buffer_size > 0) {
+    params.ioBufferSize(io_buffer_size);
+  }
+  if (stream_info) {
+    params.streamInfo(*stream_info);
+  }
+  if (use_frame_arena) {
+    // the frames of the previous clip are gone by now
+    ClipArena& arena = ThreadLocalClipArena();
+    arena.Reset();
+    params.frameArena(&arena);
+  }
+  if (min_size > 0) {
+    // scale augmentation happens in the colour conversion pass
+    params.outputShortSide(GetScaleSideLength(max_size, min_size, randgen));
+  }
 
-  // ----------- usable with selective decoding
-  // bool isTemporalJitter = (start_frm < 0);
-  // decoder.decodeMemory(
-  //     video_buffer,
-  //     size,
-  //     params,
-  //     sampledFrames,
-  //     length * sampling_rate,
-  //     !isTemporalJitter);
-  //
-  // if (sampledFrames.size() < length * sampling_rate) {
-  //   /* selective decoding failed. Decode all frames. */
-  //   decoder.decodeMemory(video_buffer, size, params, sampledFrames);
-  // }
-  // ----------- usable with selective decoding
-
-  decoder.decodeMemory(video_buffer, size, params, sampledFrames);
-
-  buffer = nullptr;
-  int offset = 0;
-  int channel_size = 0;
-  int image_size = 0;
-  int data_size = 0;
-
-  int use_start_frm = start_frm;
-  if (start_frm < 0) { // perform temporal jittering
-    if ((int)(sampledFrames.size() - length * sampling_rate) > 0) {
-      use_start_frm = std::uniform_int_distribution<>(
-          0, (int)(sampledFrames.size() - length * sampling_rate))(*randgen);
-    } else { use_start_frm = 0; }
+  // a fixed start_frm is an absolute frame index here, so only the
+  // temporal jittering case can seek to a random clip window
+  const bool isTemporalJitter = (start_frm < 0);
+  const int clip_frames = length * sampling_rate;
+  int clip_start = -1;
+  if (use_selective_decoding && isTemporalJitter) {
+    std::vector<int> clip_indices;
+    for (int idx = 0; idx < length; idx++) {
+      clip_indices.push_back(idx * sampling_rate);
+    }
+    params.randomGenerator(randgen)
+        .outputFrameIndices(clip_indices)
+        .planarOutput(&buffer)
+        .skipNonRefFrames(skip_nonref_frames && sampling_rate > 1);
+    clip_start = decoder.decodeMemory(
+        video_buffer, size, params, sampledFrames, clip_frames, false);
+    // with a target fps the decoder voids an incomplete window itself
+    const int min_frames = target_fps > 0 ? 1 : clip_frames;
+    if (clip_start >= 0 && sampledFrames.size() < min_frames) {
+      /* selective decoding failed. Decode the video as a stream. */
+      clip_start = -1;
+    }
+    params.outputFrameIndices_.clear();
+    params.skipNonRefFrames(false);
+  }
+  if (clip_start < 0) {
+    // decode the video front to back, holding one clip window of frames at
+    // most instead of all the frames of the video
+    params.clipStart(start_frm)
+        .randomGenerator(randgen)
+        .planarOutput(&buffer)
+        .streamingClip(length, sampling_rate);
+    clip_start =
+        decoder.decodeMemory(video_buffer, size, params, sampledFrames);
+  }
+  if (clip_start < 0) {
+    // the frame count was off, decode all frames
+    params.planarOutput_ = nullptr;
+    params.streamingClip(0, 1);
+    decoder.decodeMemory(video_buffer, size, params, sampledFrames);
   }
 
   if (sampledFrames.size() == 0) {
     LOG(ERROR) << "This video is empty.";
-    buffer = nullptr;
+    buffer.clear();
     return true;
   }
 
   height = (int)sampledFrames[0]->height_ ;
   width  = (int)sampledFrames[0]->width_;
 
-  for (int idx = 0; idx < length; idx ++){
-    int i = use_start_frm + idx * sampling_rate;
-    // TODO{km}: consider cylindric sampling
-    i = i % (int)(sampledFrames.size());
-    if (idx == 0) {
-      image_size = sampledFrames[i]->height_ * sampledFrames[i]->width_;
-      channel_size = image_size * length;
-      data_size = channel_size * 3;
-      buffer = new float[data_size];
+  if (clip_start < 0) {
+    const double video_fps =
+        target_fps > 0 ? SampledFramesFps(sampledFrames) : 0;
+    const int video_window_frames =
+        ClipFrameOffset(clip_frames - 1, video_fps, target_fps) + 1;
+    int use_start_frm = start_frm;
+    if (start_frm < 0) { // perform temporal jittering
+      if ((int)(sampledFrames.size() - video_window_frames) > 0) {
+        use_start_frm = std::uniform_int_distribution<>(
+            0, (int)(sampledFrames.size() - video_window_frames))(*randgen);
+      } else { use_start_frm = 0; }
     }
 
-    for (int c = 0; c < 3; c++) {
-      ImageDataToBuffer(
-          (unsigned char*)sampledFrames[i]->data_.get(),
-          sampledFrames[i]->height_,
-          sampledFrames[i]->width_,
-          buffer + c * channel_size + offset,
-          c);
-    }
-    offset += image_size;
-  }
-  CAFFE_ENFORCE(offset == channel_size, "Wrong offset size");
+    SampledFramesToPlanarClip(
+        sampledFrames,
+        use_start_frm,
+        length,
+        sampling_rate,
+        buffer,
+        video_fps,
+        target_fps,
+        yuv_output);
+  } // else the decoder has already filled the buffer
 
   // free the sampledFrames
   for (int i = 0; i < sampledFrames.size(); i++) {
@@ -824,5 +1533,223 @@ bool DecodeClipFromMemoryBufferFlex(
   return true;
 }
 
+#if defined(CV_VERSION_MAJOR) && \
+    (CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 1))
+#define CUSTOMIZED_VIDEO_IO_REDUCED_IMREAD
+#endif
+
+// how much smaller than its size cv::imread may decode a JPEG frame, so that
+// its short side still is at least short_side
+static int GetImageReduction(
+    const int height,
+    const int width,
+    const int short_side) {
+#ifdef CUSTOMIZED_VIDEO_IO_REDUCED_IMREAD
+  for (const int reduction : {8, 4, 2}) {
+    if (std::min(height, width) / reduction >= short_side) {
+      return reduction;
+    }
+  }
+#endif
+  return 1;
+}
+
+static int GetImageReadFlags(const int reduction) {
+#ifdef CUSTOMIZED_VIDEO_IO_REDUCED_IMREAD
+  // libjpeg scales these down in the DCT domain
+  switch (reduction) {
+    case 8:
+      return cv::IMREAD_REDUCED_COLOR_8;
+    case 4:
+      return cv::IMREAD_REDUCED_COLOR_4;
+    case 2:
+      return cv::IMREAD_REDUCED_COLOR_2;
+  }
+#endif
+  return CV_LOAD_IMAGE_COLOR;
+}
+
+bool DecodeClipFromFrames(
+    std::string input_dir,
+    std::string file_extension,
+    const int start_frm,
+    const int length,
+    int & height,
+    int & width,
+    const int sampling_rate,
+    std::vector<unsigned char>& buffer,
+    PhiloxRandom* randgen,
+    const int sample_times,
+    const int min_size,
+    const int max_size,
+    const int num_frames) {
+  const int num_of_frames = num_frames > 0
+      ? num_frames
+      : GetNumberOfImages(input_dir, file_extension);
+  if (num_of_frames <= 0) {
+    LOG(ERROR) << "No frames in " << input_dir;
+    return false;
+  }
+  // frame files have no key frames
+  const int clip_start = ChooseClipStart(
+      num_of_frames,
+      start_frm,
+      length * sampling_rate,
+      sample_times,
+      randgen,
+      nullptr);
+  const int short_side =
+      min_size > 0 ? GetScaleSideLength(max_size, min_size, randgen) : -1;
+
+  char fn_im[512];
+  cv::Mat img, img_read;
+  int reduction = 1;
+  int image_size = 0;
+  int channel_size = 0;
+  for (int idx = 0; idx < length; idx++) {
+    // periodic sampling, as for videos
+    const int i = (clip_start + idx * sampling_rate) % num_of_frames;
+    snprintf(
+        fn_im, 512, "%s/%06d%s", input_dir.c_str(), i, file_extension.c_str());
+    img_read = cv::imread(fn_im, GetImageReadFlags(reduction));
+    if (!img_read.data) {
+      LOG(ERROR) << "Could not open or find file " << fn_im;
+      return false;
+    }
+    if (idx == 0) {
+      // the first frame, read at full size, sets the size of the clip
+      height = img_read.rows;
+      width = img_read.cols;
+      if (short_side > 0) {
+        GetScaledSize(
+            img_read.rows,
+            img_read.cols,
+            short_side,
+            short_side,
+            randgen,
+            height,
+            width);
+        reduction =
+            GetImageReduction(img_read.rows, img_read.cols, short_side);
+      }
+      image_size = height * width;
+      channel_size = image_size * length;
+      buffer.resize(channel_size * 3);
+    }
+    if (img_read.rows != height || img_read.cols != width) {
+      cv::resize(
+          img_read, img, cv::Size(width, height), 0, 0, cv::INTER_LINEAR);
+    } else {
+      img = img_read;
+    }
+    // the clips are RGB, like the decoded video frames
+    cv::cvtColor(img, img, CV_BGR2RGB);
+    PackedRGBToPlanarUint8(
+        img.data, image_size, channel_size, buffer.data() + idx * image_size);
+  }
+  return true;
+}
+
+bool GetJpegFrameSize(
+    const unsigned char* data,
+    const size_t size,
+    int* height,
+    int* width) {
+  if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+    return false;
+  }
+  // the segments after SOI, up to the first start of frame marker
+  size_t pos = 2;
+  while (pos + 4 <= size) {
+    if (data[pos] != 0xFF) {
+      return false;
+    }
+    const unsigned char marker = data[pos + 1];
+    if (marker == 0xFF) {
+      // fill byte
+      ++pos;
+      continue;
+    }
+    const size_t length = (data[pos + 2] << 8) | data[pos + 3];
+    // SOF0-SOF15, but DHT (C4), JPG (C8) and DAC (CC)
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 &&
+        marker != 0xC8 && marker != 0xCC) {
+      if (pos + 9 > size) {
+        return false;
+      }
+      *height = (data[pos + 5] << 8) | data[pos + 6];
+      *width = (data[pos + 7] << 8) | data[pos + 8];
+      return *height > 0 && *width > 0;
+    }
+    if (marker == 0xD9 || marker == 0xDA || length < 2) {
+      // EOI or the scan before any frame header
+      return false;
+    }
+    pos += 2 + length;
+  }
+  return false;
+}
+
+bool ReadClipFrameFiles(
+    std::string input_dir,
+    std::string file_extension,
+    const int start_frm,
+    const int length,
+    int & height,
+    int & width,
+    const int sampling_rate,
+    std::vector<std::string>* frames,
+    PhiloxRandom* randgen,
+    const int sample_times,
+    const int num_frames) {
+  const int num_of_frames = num_frames > 0
+      ? num_frames
+      : GetNumberOfImages(input_dir, file_extension);
+  if (num_of_frames <= 0) {
+    LOG(ERROR) << "No frames in " << input_dir;
+    return false;
+  }
+  // frame files have no key frames
+  const int clip_start = ChooseClipStart(
+      num_of_frames,
+      start_frm,
+      length * sampling_rate,
+      sample_times,
+      randgen,
+      nullptr);
+
+  char fn_im[512];
+  frames->resize(length);
+  for (int idx = 0; idx < length; idx++) {
+    // periodic sampling, as for videos
+    const int i = (clip_start + idx * sampling_rate) % num_of_frames;
+    snprintf(
+        fn_im, 512, "%s/%06d%s", input_dir.c_str(), i, file_extension.c_str());
+    std::ifstream file(fn_im, std::ios::binary);
+    if (!file) {
+      LOG(ERROR) << "Could not open or find file " << fn_im;
+      return false;
+    }
+    std::string& frame = (*frames)[idx];
+    // the string keeps its capacity from the clips before
+    file.seekg(0, std::ios::end);
+    frame.resize(file.tellg());
+    file.seekg(0, std::ios::beg);
+    file.read(&frame[0], frame.size());
+    if (!file) {
+      LOG(ERROR) << "Could not read file " << fn_im;
+      return false;
+    }
+  }
+  if (!GetJpegFrameSize(
+          reinterpret_cast<const unsigned char*>((*frames)[0].data()),
+          (*frames)[0].size(),
+          &height,
+          &width)) {
+    LOG(ERROR) << "Not a JPEG frame in " << input_dir;
+    return false;
+  }
+  return true;
+}
 
 } // caffe2 namespace
@@ -27,12 +27,19 @@
 
 #include <opencv2/opencv.hpp>
 #include <random>
+#include <vector>
 #include "caffe/proto/caffe.pb.h"
+#include "caffe2/utils/philox_random.h"
 
 #include <iostream>
 
 namespace caffe2 {
 
+class RemoteVideoStore;
+class SharedFrameCache;
+struct VideoRecord;
+struct VideoStreamInfo;
+
 void ImageChannelToBuffer(const cv::Mat* img, float* buffer, int c);
 
 void ImageDataToBuffer(
@@ -42,12 +49,23 @@ void ImageDataToBuffer(
     float* buffer,
     int c);
 
+void ImageDataToBuffer(
+    unsigned char* data_buffer,
+    int height,
+    int width,
+    unsigned char* buffer,
+    int c);
+
 int GetNumberOfFrames(std::string filename);
 
 double GetVideoFPS(std::string filename);
 
 void GetVideoMeta(std::string filename, int& number_of_frames, double& fps);
 
+// reads the meta data from the record header if it has one, otherwise opens
+// the video the record points to like the overload above
+void GetVideoMeta(const VideoRecord& record, int& number_of_frames, double& fps);
+
 bool ReadClipFromFrames(
     std::string input_dir,
     const int start_frm,
@@ -58,6 +76,59 @@ bool ReadClipFromFrames(
     const int sampling_rate,
     float*& buffer);
 
+// asks the kernel to start reading the file into the page cache, so that a
+// decoder opening it later does not wait for the storage
+void ReadaheadVideoFile(const std::string& filename);
+
+// number of files ending in file_extension in input_dir
+int GetNumberOfImages(std::string input_dir, std::string file_extension);
+
+// reads a clip of length frames, sampling_rate frames apart, from the frames
+// of a video extracted to input_dir as <%06d frame index><file_extension>.
+// Only the frames of the clip are read, start_frm and sample_times place it
+// as in DecodeClipFromVideoFileFlex, and num_frames is the number of frames
+// if known (otherwise the directory is listed). With min_size > 0 the short
+// side of the frames is scaled to a length drawn from [min_size, max_size],
+// and JPEG frames are then decoded at a reduced size where they allow it.
+bool DecodeClipFromFrames(
+    std::string input_dir,
+    std::string file_extension,
+    const int start_frm,
+    const int length,
+    int & height,
+    int & width,
+    const int sampling_rate,
+    std::vector<unsigned char>& buffer,
+    PhiloxRandom* randgen,
+    const int sample_times,
+    const int min_size = -1,
+    const int max_size = -1,
+    const int num_frames = -1);
+
+// the size of a JPEG from its start of frame marker, false if data is not
+// a JPEG or ends before it
+bool GetJpegFrameSize(
+    const unsigned char* data,
+    const size_t size,
+    int* height,
+    int* width);
+
+// the encoded files of the frames of the clip that DecodeClipFromFrames
+// would read, for a decoder of their own (e.g. nvJPEG on the GPU). height
+// and width are the size of the first frame, from its JPEG header.
+bool ReadClipFrameFiles(
+    std::string input_dir,
+    std::string file_extension,
+    const int start_frm,
+    const int length,
+    int & height,
+    int & width,
+    const int sampling_rate,
+    std::vector<std::string>* frames,
+    PhiloxRandom* randgen,
+    const int sample_times,
+    const int num_frames = -1);
+
 bool ReadClipFromVideoLazzy(
     std::string filename,
     const int start_frm,
@@ -103,14 +174,16 @@ bool DecodeClipFromMemoryBuffer(
     const int width,
     const int sampling_rate,
     float*& buffer,
-    std::mt19937* randgen);
+    PhiloxRandom* randgen);
 
 // ----------------------------------------------------------------
 // customized functions follow
+// the clips below are planar uint8 buffers laid out as 3 x length x H x W
+// (RGB) and are only converted to float by ClipTransformFlex
 // ----------------------------------------------------------------
 
 void ClipTransformFlex(
-    const float* clip_data,
+    const unsigned char* clip_data,
     const int channels,
     const int length,
     const int height,
@@ -121,26 +194,138 @@ void ClipTransformFlex(
     float mean,
     float std,
     float* transformed_clip,
-    std::mt19937* randgen,
+    PhiloxRandom* randgen,
     std::bernoulli_distribution* mirror_this_clip,
     const bool use_center_crop,
     const bool use_bgr,
     const int spatial_pos
   );
 
+// same crop window as ClipTransformFlex, but the uint8 values are copied
+// as is; mirroring, channel order and normalization are left to the GPU
+// transform, which gets the mirror decision through mirror_me
+void ClipCropFlex(
+    const unsigned char* clip_data,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int h_crop,
+    const int w_crop,
+    const bool mirror,
+    unsigned char* cropped_clip,
+    PhiloxRandom* randgen,
+    std::bernoulli_distribution* mirror_this_clip,
+    const bool use_center_crop,
+    const int spatial_pos,
+    int* mirror_me
+  );
+
+// the crop window and mirror decision of ClipCropFlex, for a clip that is
+// cropped elsewhere (e.g. on the GPU, see NvJpegClipDecoder)
+void GetClipCropWindow(
+    const int height,
+    const int width,
+    const int h_crop,
+    const int w_crop,
+    const bool mirror,
+    PhiloxRandom* randgen,
+    std::bernoulli_distribution* mirror_this_clip,
+    const bool use_center_crop,
+    const int spatial_pos,
+    int* h_off,
+    int* w_off,
+    int* mirror_me);
+
+// ClipCropFlex of an I420 planar clip (see PlanarLayout), at even offsets
+// for the chroma planes. The cropped clip is written as length I420 frames
+// of h_crop x w_crop one after the other, the GPU transform also converts
+// them to RGB
+void YuvClipCropFlex(
+    const unsigned char* clip_data,
+    const int length,
+    const int height,
+    const int width,
+    const int h_crop,
+    const int w_crop,
+    const bool mirror,
+    unsigned char* cropped_clip,
+    PhiloxRandom* randgen,
+    std::bernoulli_distribution* mirror_this_clip,
+    const bool use_center_crop,
+    const int spatial_pos,
+    int* mirror_me
+  );
+
 void ScaleTransform(
-    const float* clip_data,
+    const unsigned char* clip_data,
     const int channels,
     const int length,
     const int height,
     const int width,
     const int max_size,
     const int min_size,
-    float*& buffer,
-    std::mt19937* randgen,
+    std::vector<unsigned char>& buffer,
+    PhiloxRandom* randgen,
+    int & new_height,
+    int & new_width);
+
+// draw the short side length for scale augmentation from
+// [min_size, max_size]
+int GetScaleSideLength(
+    const int max_size,
+    const int min_size,
+    PhiloxRandom* randgen);
+
+// draw the short side from [min_size, max_size] and return the frame size
+// scaled to it, keeping the aspect ratio
+void GetScaledSize(
+    const int height,
+    const int width,
+    const int max_size,
+    const int min_size,
+    PhiloxRandom* randgen,
     int & new_height,
     int & new_width);
 
+// ScaleTransform to scaled_height x scaled_width followed by
+// ClipTransformFlex, fused: only the crop window is interpolated and it is
+// written as normalized float straight into transformed_clip
+void ScaleCropNormalizeTransform(
+    const unsigned char* clip_data,
+    const int channels,
+    const int length,
+    const int height,
+    const int width,
+    const int scaled_height,
+    const int scaled_width,
+    const int h_crop,
+    const int w_crop,
+    const bool mirror,
+    float mean,
+    float std,
+    float* transformed_clip,
+    PhiloxRandom* randgen,
+    std::bernoulli_distribution* mirror_this_clip,
+    const bool use_center_crop,
+    const bool use_bgr,
+    const int spatial_pos);
+
+// io_buffer_size > 0 sets the read size of FFmpeg, and use_mmap reads the
+// file through a memory mapping instead of stdio. skip_nonref_frames lets
+// selective decoding skip the non-reference frames between the sampled ones
+// and codec_threads sets the threads of the codec (0 for one per core)
+// with min_size > 0 the decoder scales the short side of the frames to a
+// length drawn from [min_size, max_size]; decode_backend is a DecodeBackend
+// stream_info, e.g. from the meta data of the db record, spares selective
+// decoding the frame count estimate and lets it seek to the exact key frame;
+// with it, the clips are also served from and put into frame_cache. With a
+// remote_store, a filename that is an http:// url is read through it.
+// With target_fps > 0, the clip is sampled at that frame rate instead of
+// the video's: its sampling_rate is in frames at target_fps, each taken at
+// the video frame nearest to its time in the clip window. decode_quality
+// is a DecodeQuality, and with yuv_output the clip is I420 (see
+// PlanarLayout) of an even frame size, and not put into the frame cache
 bool DecodeClipFromVideoFileFlex(
     std::string filename,
     const int start_frm,
@@ -148,9 +333,48 @@ bool DecodeClipFromVideoFileFlex(
     int & height,
     int & width,
     const int sampling_rate,
-    float*& buffer,
-    std::mt19937* randgen,
-    const int sample_times);
+    std::vector<unsigned char>& buffer,
+    PhiloxRandom* randgen,
+    const int sample_times,
+    const bool use_selective_decoding = false,
+    const int min_size = -1,
+    const int max_size = -1,
+    const bool use_decoder_cache = false,
+    const int decode_backend = 0,
+    const bool use_frame_arena = false,
+    const VideoStreamInfo* stream_info = nullptr,
+    SharedFrameCache* frame_cache = nullptr,
+    const int io_buffer_size = 0,
+    const bool use_mmap = false,
+    const bool skip_nonref_frames = false,
+    const int codec_threads = 1,
+    RemoteVideoStore* remote_store = nullptr,
+    const float target_fps = 0,
+    const int decode_quality = 0,
+    const bool yuv_output = false);
+
+// decodes the video once and fills clips[t] (resized to sample_times) with
+// the clip that DecodeClipFromVideoFileFlex returns for start_frm = t
+bool DecodeClipsFromVideoFileFlex(
+    std::string filename,
+    const int length,
+    int & height,
+    int & width,
+    const int sampling_rate,
+    std::vector<std::vector<unsigned char>>& clips,
+    PhiloxRandom* randgen,
+    const int sample_times,
+    const int min_size = -1,
+    const int max_size = -1,
+    const bool use_decoder_cache = false,
+    const int decode_backend = 0,
+    const bool use_frame_arena = false,
+    const int io_buffer_size = 0,
+    const bool use_mmap = false,
+    const int codec_threads = 1,
+    RemoteVideoStore* remote_store = nullptr,
+    const float target_fps = 0,
+    const int decode_quality = 0);
 
 bool DecodeClipFromMemoryBufferFlex(
     const char* video_buffer,
@@ -160,8 +384,20 @@ bool DecodeClipFromMemoryBufferFlex(
     int & height,
     int & width,
     const int sampling_rate,
-    float*& buffer,
-    std::mt19937* randgen);
+    std::vector<unsigned char>& buffer,
+    PhiloxRandom* randgen,
+    const bool use_selective_decoding = false,
+    const int min_size = -1,
+    const int max_size = -1,
+    const int decode_backend = 0,
+    const bool use_frame_arena = false,
+    const VideoStreamInfo* stream_info = nullptr,
+    const int io_buffer_size = 0,
+    const bool skip_nonref_frames = false,
+    const int codec_threads = 1,
+    const float target_fps = 0,
+    const int decode_quality = 0,
+    const bool yuv_output = false);
 }
 
 
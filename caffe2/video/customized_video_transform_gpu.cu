@@ -0,0 +1,251 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/utils/conversions.h"
+#include "caffe2/video/customized_video_transform_gpu.h"
+
+namespace caffe2 {
+
+namespace {
+
+// channel c of the RGB of a pixel of studio range YUV, BT.601 like the
+// YUV420P -> RGB24 conversion of swscale
+__device__ float YuvToRgb(
+    const float y,
+    const float u,
+    const float v,
+    const int c) {
+  const float luma = 1.164383f * (y - 16.f);
+  float value;
+  if (c == 0) {
+    value = luma + 1.596027f * (v - 128.f);
+  } else if (c == 1) {
+    value = luma - 0.391762f * (u - 128.f) - 0.812968f * (v - 128.f);
+  } else {
+    value = luma + 2.017232f * (u - 128.f);
+  }
+  return rintf(fminf(fmaxf(value, 0.f), 255.f));
+}
+
+// one thread per output value: consecutive threads write consecutive w,
+// and read consecutive (or, mirrored, reversed) source pixels of a row.
+// Channels last, consecutive threads write the channels of a pixel.
+// kYuv clips are I420 frames, whose RGB is converted here, the chroma of a
+// pixel being the sample of the 2 x 2 pixels it is in.
+template <typename In, typename Out, bool kChannelsLast, bool kYuv>
+__global__ void TransformClipsKernel(
+    const int n,
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    const In* in,
+    const int* mirror,
+    Out* out) {
+  CUDA_1D_KERNEL_LOOP(index, n) {
+    int c, t, h, w, clip;
+    if (kChannelsLast) {
+      c = index % C;
+      w = (index / C) % W;
+      h = (index / (C * W)) % H;
+      t = (index / (C * W * H)) % T;
+      clip = index / (C * W * H * T);
+    } else {
+      w = index % W;
+      h = (index / W) % H;
+      t = (index / (W * H)) % T;
+      c = (index / (W * H * T)) % C;
+      clip = index / (W * H * T * C);
+    }
+    const int in_c = reverse_channels ? C - 1 - c : c;
+    const int in_w = mirror[clip] ? W - 1 - w : w;
+    float value;
+    if (kYuv) {
+      const In* frame = in + (clip * T + t) * (H * W + H * W / 2);
+      const In* u = frame + H * W;
+      const In* v = u + H * W / 4;
+      const int chroma = (h / 2) * (W / 2) + in_w / 2;
+      value = YuvToRgb(
+          convert::To<In, float>(frame[h * W + in_w]),
+          convert::To<In, float>(u[chroma]),
+          convert::To<In, float>(v[chroma]),
+          in_c);
+    } else {
+      const int in_index = (((clip * C + in_c) * T + t) * H + h) * W + in_w;
+      value = convert::To<In, float>(in[in_index]);
+    }
+    out[index] = convert::To<float, Out>((value - mean) * inv_std);
+  }
+}
+
+template <typename In, typename Out, bool kChannelsLast, bool kYuv>
+void LaunchTransformClips(
+    const int n,
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    const In* in,
+    const int* mirror,
+    Out* out,
+    CUDAContext* context) {
+  TransformClipsKernel<In, Out, kChannelsLast, kYuv>
+      <<<CAFFE_GET_BLOCKS(n),
+         CAFFE_CUDA_NUM_THREADS,
+         0,
+         context->cuda_stream()>>>(
+          n, C, T, H, W, mean, inv_std, reverse_channels, in, mirror, out);
+}
+
+} // namespace
+
+template <typename T_IN, typename T_OUT, class Context>
+bool TransformClipsOnGPU(
+    Tensor<Context>& X,
+    Tensor<Context>& mirror,
+    Tensor<Context>* Y,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    const bool channels_last,
+    Context* context) {
+  // clips come in as N x C x T x H x W, I420 clips as N x T x 3H/2 x W
+  const bool yuv = X.ndim() == 4;
+  CAFFE_ENFORCE(X.ndim() == 5 || yuv);
+  CAFFE_ENFORCE_EQ(mirror.size(), X.dim(0));
+  const int N = X.dim32(0);
+  const int C = yuv ? 3 : X.dim32(1);
+  const int T = X.dim32(yuv ? 1 : 2);
+  const int H = yuv ? X.dim32(2) / 3 * 2 : X.dim32(3);
+  const int W = X.dim32(yuv ? 3 : 4);
+  if (yuv) {
+    CAFFE_ENFORCE(X.dim32(2) % 3 == 0 && H % 2 == 0 && W % 2 == 0);
+  }
+  if (channels_last) {
+    Y->Resize(std::vector<TIndex>{N, T, H, W, C});
+  } else {
+    Y->Resize(std::vector<TIndex>{N, C, T, H, W});
+  }
+  const int n = Y->size();
+  const T_IN* in = X.template data<T_IN>();
+  const int* mirror_data = mirror.template data<int>();
+  T_OUT* out = Y->template mutable_data<T_OUT>();
+  if (channels_last && yuv) {
+    LaunchTransformClips<T_IN, T_OUT, true, true>(
+        n,
+        C,
+        T,
+        H,
+        W,
+        mean,
+        inv_std,
+        reverse_channels,
+        in,
+        mirror_data,
+        out,
+        context);
+  } else if (channels_last) {
+    LaunchTransformClips<T_IN, T_OUT, true, false>(
+        n,
+        C,
+        T,
+        H,
+        W,
+        mean,
+        inv_std,
+        reverse_channels,
+        in,
+        mirror_data,
+        out,
+        context);
+  } else if (yuv) {
+    LaunchTransformClips<T_IN, T_OUT, false, true>(
+        n,
+        C,
+        T,
+        H,
+        W,
+        mean,
+        inv_std,
+        reverse_channels,
+        in,
+        mirror_data,
+        out,
+        context);
+  } else {
+    LaunchTransformClips<T_IN, T_OUT, false, false>(
+        n,
+        C,
+        T,
+        H,
+        W,
+        mean,
+        inv_std,
+        reverse_channels,
+        in,
+        mirror_data,
+        out,
+        context);
+  }
+  return true;
+}
+
+template bool TransformClipsOnGPU<uint8_t, float, CUDAContext>(
+    Tensor<CUDAContext>& X,
+    Tensor<CUDAContext>& mirror,
+    Tensor<CUDAContext>* Y,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    const bool channels_last,
+    CUDAContext* context);
+
+template bool TransformClipsOnGPU<uint8_t, float16, CUDAContext>(
+    Tensor<CUDAContext>& X,
+    Tensor<CUDAContext>& mirror,
+    Tensor<CUDAContext>* Y,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    const bool channels_last,
+    CUDAContext* context);
+
+template bool TransformClipsOnGPU<uint8_t, uint8_t, CUDAContext>(
+    Tensor<CUDAContext>& X,
+    Tensor<CUDAContext>& mirror,
+    Tensor<CUDAContext>* Y,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    const bool channels_last,
+    CUDAContext* context);
+
+} // namespace caffe2
@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/decode_cost_model.h"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+namespace caffe2 {
+
+double DecodeCostModel::ClipUnits(
+    int num_frames,
+    int num_key_frames,
+    int width,
+    int height,
+    int clip_frames) {
+  if (num_frames <= 0 || width <= 0 || height <= 0) {
+    return 0;
+  }
+  const double gop = num_key_frames > 0
+      ? static_cast<double>(num_frames) / num_key_frames
+      : num_frames;
+  const double frames =
+      std::min<double>(num_frames, gop / 2 + std::max(clip_frames, 1));
+  return frames * width * height;
+}
+
+double DecodeCostModel::Estimate(const std::string& key, double units) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = record_ns_.find(std::hash<std::string>()(key));
+  if (it != record_ns_.end()) {
+    return it->second;
+  }
+  if (units > 0 && units_ > 0) {
+    return units * unit_ns_ / units_;
+  }
+  return num_observed_ > 0 ? total_ns_ / num_observed_ : 0;
+}
+
+void DecodeCostModel::Observe(
+    const std::string& key,
+    double units,
+    double ns) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  total_ns_ += ns;
+  ++num_observed_;
+  if (units > 0) {
+    unit_ns_ += ns;
+    units_ += units;
+  }
+  const size_t hash = std::hash<std::string>()(key);
+  const auto it = record_ns_.find(hash);
+  if (it != record_ns_.end()) {
+    // the clips of a record start at random frames
+    it->second = 0.5f * it->second + 0.5f * static_cast<float>(ns);
+  } else if (record_ns_.size() < max_records_) {
+    record_ns_.emplace(hash, static_cast<float>(ns));
+  }
+}
+
+std::vector<int> LongestFirstOrder(const std::vector<double>& costs) {
+  std::vector<int> order(costs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&costs](int a, int b) {
+    return costs[a] > costs[b];
+  });
+  return order;
+}
+
+} // namespace caffe2
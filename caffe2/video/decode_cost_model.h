@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_DECODE_COST_MODEL_H_
+#define CAFFE2_VIDEO_DECODE_COST_MODEL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace caffe2 {
+
+// Estimates how long the records of a db take to decode, for an input op to
+// start the expensive items of a batch first (longest processing time
+// first), so that a batch ends on short items spread over the decode
+// threads rather than on one long video. The estimate of a record is, by
+// preference:
+//  - its decode time as last observed, smoothed over the epochs;
+//  - its work units (see ClipUnits) times the observed time per unit;
+//  - the mean observed decode time.
+// Records are remembered by the hash of their key. Thread safe.
+class DecodeCostModel {
+ public:
+  // remembers the decode times of at most max_records records
+  explicit DecodeCostModel(size_t max_records = 1 << 20)
+      : max_records_(max_records) {}
+
+  // The pixels decoded for a clip of clip_frames frames of a video: from
+  // the key frame before the clip, half a GOP early on average, to its end.
+  // 0 if the meta data is unknown (non-positive).
+  static double ClipUnits(
+      int num_frames,
+      int num_key_frames,
+      int width,
+      int height,
+      int clip_frames);
+
+  // ns; units <= 0 if unknown. 0 before the first observation.
+  double Estimate(const std::string& key, double units) const;
+  void Observe(const std::string& key, double units, double ns);
+
+  size_t num_records() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return record_ns_.size();
+  }
+
+ private:
+  const size_t max_records_;
+  mutable std::mutex mutex_;
+  std::unordered_map<size_t, float> record_ns_;
+  double total_ns_ = 0;
+  int64_t num_observed_ = 0;
+  // of the observations with units
+  double unit_ns_ = 0;
+  double units_ = 0;
+};
+
+// The order to start the items of a batch in: the highest cost first, and
+// items of equal cost in their order.
+std::vector<int> LongestFirstOrder(const std::vector<double>& costs);
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_DECODE_COST_MODEL_H_
@@ -0,0 +1,57 @@
+#include <string>
+#include <vector>
+
+#include "caffe2/video/decode_cost_model.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+TEST(DecodeCostModelTest, ClipUnits) {
+  // 300 frames, a key frame every 30: 15 frames to the clip on average
+  EXPECT_DOUBLE_EQ(
+      DecodeCostModel::ClipUnits(300, 10, 320, 240, 32),
+      (15 + 32) * 320. * 240.);
+  // no more than the video
+  EXPECT_DOUBLE_EQ(
+      DecodeCostModel::ClipUnits(20, 1, 10, 10, 32), 20 * 10. * 10.);
+  EXPECT_EQ(DecodeCostModel::ClipUnits(-1, 0, 320, 240, 32), 0);
+  EXPECT_EQ(DecodeCostModel::ClipUnits(300, 10, -1, -1, 32), 0);
+}
+
+TEST(DecodeCostModelTest, EstimatesByPreference) {
+  DecodeCostModel model;
+  EXPECT_EQ(model.Estimate("a", 100), 0);
+  model.Observe("a", 100, 1000);
+  model.Observe("b", 0, 3000);
+  // observed
+  EXPECT_FLOAT_EQ(model.Estimate("a", 100), 1000);
+  EXPECT_FLOAT_EQ(model.Estimate("b", 0), 3000);
+  // by units, at the 10 ns per unit of a
+  EXPECT_FLOAT_EQ(model.Estimate("c", 50), 500);
+  // the mean
+  EXPECT_FLOAT_EQ(model.Estimate("c", 0), 2000);
+  // smoothed
+  model.Observe("a", 100, 2000);
+  EXPECT_FLOAT_EQ(model.Estimate("a", 100), 1500);
+  EXPECT_EQ(model.num_records(), 2);
+}
+
+TEST(DecodeCostModelTest, RemembersAtMostMaxRecords) {
+  DecodeCostModel model(2);
+  model.Observe("a", 0, 1000);
+  model.Observe("b", 0, 2000);
+  model.Observe("c", 0, 6000);
+  EXPECT_EQ(model.num_records(), 2);
+  // c still counts for the mean
+  EXPECT_FLOAT_EQ(model.Estimate("c", 0), 3000);
+}
+
+TEST(DecodeCostModelTest, LongestFirstOrder) {
+  EXPECT_EQ(
+      LongestFirstOrder({1, 5, 0, 5, 3}), std::vector<int>({1, 3, 4, 0, 2}));
+  // no estimates: the db order
+  EXPECT_EQ(LongestFirstOrder({0, 0, 0}), std::vector<int>({0, 1, 2}));
+  EXPECT_TRUE(LongestFirstOrder({}).empty());
+}
+
+} // namespace caffe2
@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_DECODE_THREAD_CONTROLLER_H_
+#define CAFFE2_VIDEO_DECODE_THREAD_CONTROLLER_H_
+
+#include <condition_variable>
+#include <mutex>
+
+namespace caffe2 {
+
+// Sizes the decode stage of an input op from the way its batches flow
+// through the prefetch ring. For every batch the op reports how long the
+// net stalled waiting for a batch, how long the prefetch thread sat idle
+// waiting for the net to free a slot, and the time of the whole cycle.
+// At the end of every window of batches:
+//  - a net that stalled for more than grow_stall of the window gets another
+//    decode thread, or, when the prefetch thread was idle in the same
+//    window (the decode keeps up on average but not batch by batch) or all
+//    max_threads decode already, another prefetch slot;
+//  - a net that never stalled while the prefetch thread idled for more
+//    than shrink_idle of the window gives up a decode thread, and a
+//    prefetch slot once it is down to min_threads.
+class DecodeThreadController {
+ public:
+  struct Options {
+    int min_threads = 1;
+    int max_threads = 1;
+    int min_depth = 1;
+    int max_depth = 1;
+    // batches per decision
+    int window = 8;
+    float grow_stall = 0.02f;
+    float shrink_idle = 0.25f;
+  };
+
+  DecodeThreadController(const Options& options, int threads, int depth);
+
+  // Adds the times of a batch, in ms. Returns true if threads() or depth()
+  // changed.
+  bool Observe(float stall_ms, float idle_ms, float cycle_ms);
+
+  int threads() const {
+    return threads_;
+  }
+  int depth() const {
+    return depth_;
+  }
+
+ private:
+  Options options_;
+  int threads_;
+  int depth_;
+  int num_batches_ = 0;
+  double stall_ms_ = 0;
+  double idle_ms_ = 0;
+  double cycle_ms_ = 0;
+};
+
+// Lets at most limit() decode tasks run at once. The pool threads beyond
+// the limit sleep in Enter() until it is raised, so that a pool sized for
+// the most threads decodes on as many as a DecodeThreadController wants.
+class DecodeGate {
+ public:
+  explicit DecodeGate(int limit = 1) : limit_(limit) {}
+
+  void Enter();
+  void Leave();
+  void SetLimit(int limit);
+
+  int limit() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return limit_;
+  }
+
+  class Scope {
+   public:
+    explicit Scope(DecodeGate* gate) : gate_(gate) {
+      gate_->Enter();
+    }
+    ~Scope() {
+      gate_->Leave();
+    }
+
+   private:
+    DecodeGate* gate_;
+  };
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  int limit_;
+  int running_ = 0;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_DECODE_THREAD_CONTROLLER_H_
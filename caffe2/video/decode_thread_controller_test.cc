@@ -0,0 +1,118 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "caffe2/video/decode_thread_controller.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+DecodeThreadController::Options TestOptions() {
+  DecodeThreadController::Options options;
+  options.min_threads = 2;
+  options.max_threads = 4;
+  options.min_depth = 1;
+  options.max_depth = 2;
+  options.window = 4;
+  return options;
+}
+
+// feeds a window of identical batches
+bool ObserveWindow(
+    DecodeThreadController* controller,
+    float stall_ms,
+    float idle_ms) {
+  bool changed = false;
+  for (int i = 0; i < 4; ++i) {
+    changed = controller->Observe(stall_ms, idle_ms, 100) || changed;
+  }
+  return changed;
+}
+
+} // namespace
+
+TEST(DecodeThreadControllerTest, DecidesOncePerWindow) {
+  DecodeThreadController controller(TestOptions(), 2, 1);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_FALSE(controller.Observe(50, 0, 100));
+  }
+  EXPECT_TRUE(controller.Observe(50, 0, 100));
+  EXPECT_EQ(controller.threads(), 3);
+}
+
+TEST(DecodeThreadControllerTest, GrowsThreadsThenDepthOnStalls) {
+  DecodeThreadController controller(TestOptions(), 2, 1);
+  EXPECT_TRUE(ObserveWindow(&controller, 50, 0));
+  EXPECT_TRUE(ObserveWindow(&controller, 50, 0));
+  EXPECT_EQ(controller.threads(), 4);
+  EXPECT_EQ(controller.depth(), 1);
+  EXPECT_TRUE(ObserveWindow(&controller, 50, 0));
+  EXPECT_EQ(controller.depth(), 2);
+  // nothing left to grow
+  EXPECT_FALSE(ObserveWindow(&controller, 50, 0));
+}
+
+TEST(DecodeThreadControllerTest, BurstyStallsDeepenTheRingFirst) {
+  DecodeThreadController controller(TestOptions(), 2, 1);
+  EXPECT_TRUE(ObserveWindow(&controller, 10, 10));
+  EXPECT_EQ(controller.threads(), 2);
+  EXPECT_EQ(controller.depth(), 2);
+}
+
+TEST(DecodeThreadControllerTest, ShrinksWhenTheNetIsTheBottleneck) {
+  DecodeThreadController controller(TestOptions(), 4, 2);
+  EXPECT_TRUE(ObserveWindow(&controller, 0, 50));
+  EXPECT_TRUE(ObserveWindow(&controller, 0, 50));
+  EXPECT_EQ(controller.threads(), 2);
+  EXPECT_EQ(controller.depth(), 2);
+  EXPECT_TRUE(ObserveWindow(&controller, 0, 50));
+  EXPECT_EQ(controller.depth(), 1);
+  EXPECT_FALSE(ObserveWindow(&controller, 0, 50));
+  // a balanced pipeline stays as it is
+  controller = DecodeThreadController(TestOptions(), 3, 1);
+  EXPECT_FALSE(ObserveWindow(&controller, 0, 10));
+  EXPECT_EQ(controller.threads(), 3);
+}
+
+TEST(DecodeGateTest, KeepsTasksToTheLimit) {
+  DecodeGate gate(2);
+  std::atomic<int> running(0);
+  std::atomic<int> max_running(0);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&]() {
+      DecodeGate::Scope scope(&gate);
+      const int now = ++running;
+      int max = max_running;
+      while (now > max && !max_running.compare_exchange_weak(max, now)) {
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      --running;
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_LE(max_running, 2);
+}
+
+TEST(DecodeGateTest, RaisingTheLimitWakesWaiters) {
+  DecodeGate gate(1);
+  gate.Enter();
+  std::atomic<bool> entered(false);
+  std::thread waiter([&]() {
+    DecodeGate::Scope scope(&gate);
+    entered = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  EXPECT_FALSE(entered);
+  gate.SetLimit(2);
+  waiter.join();
+  EXPECT_TRUE(entered);
+  gate.Leave();
+}
+
+} // namespace caffe2
@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef DECODE_VIDEO_CLIP_OP_H_
+#define DECODE_VIDEO_CLIP_OP_H_
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/cpu_budget_pool.h"
+#include "caffe2/utils/thread_pool.h"
+
+namespace caffe2 {
+
+// Decodes, scales, crops and normalizes one test clip per item of a batch
+// of encoded videos, as CustomizedVideoInputOp does for the records of a
+// test db, so that a predict net can run from the bytes of the videos to
+// their scores. The items that share a video and a start frame, e.g. the
+// crops of a multi-crop test, are decoded once; the decoding is spread over
+// decode_threads threads, which keep their decoders with use_decoder_cache.
+class DecodeVideoClipOp final : public Operator<CPUContext> {
+ public:
+  USE_OPERATOR_FUNCTIONS(CPUContext);
+
+  DecodeVideoClipOp(const OperatorDef& operator_def, Workspace* ws);
+
+  bool RunOnDevice() override;
+
+ private:
+  // decodes the clip of items[0] and writes the crop of every item of
+  // items to the output
+  void DecodeItems(
+      const std::vector<int>& items,
+      const std::string& video,
+      const int start_frm,
+      const int* spatial_pos,
+      const uint64_t random_index,
+      float* clip_data);
+
+  const int length_;
+  const int sampling_rate_;
+  const int crop_;
+  const int min_size_;
+  const int max_size_;
+  const float mean_;
+  const float std_;
+  const bool use_bgr_;
+  const bool use_local_file_;
+  const int sample_times_;
+  const int default_start_frm_;
+  const bool use_selective_decoding_;
+  const bool use_decoder_cache_;
+  int decode_backend_;
+  const int codec_threads_;
+  // group i of the groups decoded by the op, counting from 0 over all
+  // runs, is decoded with PhiloxRandom(random_seed_, 0, i), the seed being
+  // the random_seed of the device option if set
+  const uint64_t random_seed_;
+  uint64_t next_random_index_;
+  std::shared_ptr<TaskThreadPool> thread_pool_;
+  // with use_cpu_budget_pool, the shared pool decoding instead of ours
+  std::shared_ptr<CpuBudgetPool> cpu_budget_pool_;
+};
+
+} // namespace caffe2
+
+#endif // DECODE_VIDEO_CLIP_OP_H_
@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/expand_clip_op.h"
+
+#include "caffe2/utils/conversions.h"
+
+namespace caffe2 {
+
+template <>
+void ExpandClip<float, CPUContext>(
+    const int size,
+    const uint8_t* X,
+    const float mean,
+    const float inv_std,
+    float* Y,
+    CPUContext* /* context */) {
+  for (int i = 0; i < size; ++i) {
+    Y[i] = (X[i] - mean) * inv_std;
+  }
+}
+
+template <>
+void ExpandClip<float16, CPUContext>(
+    const int size,
+    const uint8_t* X,
+    const float mean,
+    const float inv_std,
+    float16* Y,
+    CPUContext* /* context */) {
+  for (int i = 0; i < size; ++i) {
+    Y[i] = convert::To<float, float16>((X[i] - mean) * inv_std);
+  }
+}
+
+REGISTER_CPU_OPERATOR(ExpandClip, ExpandClipOp<CPUContext>);
+
+OPERATOR_SCHEMA(ExpandClip)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .TensorInferenceFunction([](const OperatorDef& def,
+                                const vector<TensorShape>& in) {
+      vector<TensorShape> out(1, in[0]);
+      out[0].set_data_type(
+          cast::GetCastDataType(ArgumentHelper(def), "output_type"));
+      return out;
+    })
+    .SetDoc(R"DOC(
+Expands a batch of uint8 clips to Y = (X - mean) / std, of float or
+float16. With VIDEO_OUTPUT_TYPE b'uint8' the video input ops keep their
+prefetched batches and output their clips as uint8, a quarter of the
+memory of float clips, and the model expands them with this op right
+before the first conv.
+)DOC")
+    .Arg("mean", "subtracted from every value, 0 by default")
+    .Arg("std", "every value is divided by it, 1 by default")
+    .Arg("output_type", "FLOAT (default) or FLOAT16")
+    .Input(0, "X", "uint8 clips")
+    .Output(0, "Y", "the normalized clips, of the shape of X");
+
+NO_GRADIENT(ExpandClip);
+
+} // namespace caffe2
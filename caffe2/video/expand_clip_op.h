@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef EXPAND_CLIP_OP_H_
+#define EXPAND_CLIP_OP_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/cast.h"
+
+namespace caffe2 {
+
+// Y[i] = (X[i] - mean) * inv_std for the size uint8 values of X, with Y of
+// float or float16
+template <typename T_OUT, class Context>
+void ExpandClip(
+    const int size,
+    const uint8_t* X,
+    const float mean,
+    const float inv_std,
+    T_OUT* Y,
+    Context* context);
+
+// Normalizes a batch of uint8 clips, the input op output of
+// VIDEO_OUTPUT_TYPE b'uint8', to the float or float16 input of the first
+// conv, in a single pass over the clips.
+template <class Context>
+class ExpandClipOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  ExpandClipOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        mean_(OperatorBase::template GetSingleArgument<float>("mean", 0.f)),
+        std_(OperatorBase::template GetSingleArgument<float>("std", 1.f)),
+        output_type_(cast::GetCastDataType(
+            ArgumentHelper(operator_def),
+            "output_type")) {
+    CAFFE_ENFORCE_GT(std_, 0, "std must be positive");
+    CAFFE_ENFORCE(
+        output_type_ == TensorProto_DataType_FLOAT ||
+            output_type_ == TensorProto_DataType_FLOAT16,
+        "output_type can be FLOAT or FLOAT16.");
+  }
+
+  bool RunOnDevice() override {
+    auto& X = Input(0);
+    auto* Y = Output(0);
+    CAFFE_ENFORCE(X.template IsType<uint8_t>(), "The clips are not uint8");
+    Y->ResizeLike(X);
+    if (X.size() == 0) {
+      return true;
+    }
+    if (output_type_ == TensorProto_DataType_FLOAT) {
+      ExpandClip<float, Context>(
+          X.size(),
+          X.template data<uint8_t>(),
+          mean_,
+          1.f / std_,
+          Y->template mutable_data<float>(),
+          &context_);
+    } else {
+      ExpandClip<float16, Context>(
+          X.size(),
+          X.template data<uint8_t>(),
+          mean_,
+          1.f / std_,
+          Y->template mutable_data<float16>(),
+          &context_);
+    }
+    return true;
+  }
+
+ private:
+  float mean_;
+  float std_;
+  TensorProto_DataType output_type_;
+};
+
+} // namespace caffe2
+
+#endif // EXPAND_CLIP_OP_H_
@@ -0,0 +1,67 @@
+#include <cstdint>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/conversions.h"
+#include "caffe2/video/expand_clip_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+void AddClips(Workspace* ws, const std::vector<uint8_t>& values) {
+  auto* tensor = ws->CreateBlob("X")->GetMutable<TensorCPU>();
+  tensor->Resize(1, 3, values.size() / 3);
+  std::copy(values.begin(), values.end(), tensor->mutable_data<uint8_t>());
+}
+
+void RunExpandClip(Workspace* ws, const std::string& output_type) {
+  OperatorDef def;
+  def.set_type("ExpandClip");
+  def.add_input("X");
+  def.add_output("Y");
+  auto* arg = def.add_arg();
+  arg->set_name("mean");
+  arg->set_f(114.75f);
+  arg = def.add_arg();
+  arg->set_name("std");
+  arg->set_f(57.375f);
+  arg = def.add_arg();
+  arg->set_name("output_type");
+  arg->set_s(output_type);
+  auto op = CreateOperator(def, ws);
+  ASSERT_TRUE(op->Run());
+}
+
+} // namespace
+
+TEST(ExpandClipOpTest, Float) {
+  Workspace ws;
+  const std::vector<uint8_t> x = {0, 1, 100, 114, 115, 128, 200, 254, 255};
+  AddClips(&ws, x);
+  RunExpandClip(&ws, "float");
+
+  const auto& Y = ws.GetBlob("Y")->Get<TensorCPU>();
+  EXPECT_EQ(Y.dims(), ws.GetBlob("X")->Get<TensorCPU>().dims());
+  for (int i = 0; i < x.size(); ++i) {
+    EXPECT_FLOAT_EQ(Y.data<float>()[i], (x[i] - 114.75f) / 57.375f);
+  }
+}
+
+TEST(ExpandClipOpTest, Float16) {
+  Workspace ws;
+  const std::vector<uint8_t> x = {0, 17, 114, 115, 255, 3};
+  AddClips(&ws, x);
+  RunExpandClip(&ws, "float16");
+
+  const auto& Y = ws.GetBlob("Y")->Get<TensorCPU>();
+  ASSERT_TRUE(Y.IsType<float16>());
+  for (int i = 0; i < x.size(); ++i) {
+    const float y = convert::To<float16, float>(Y.data<float16>()[i]);
+    EXPECT_NEAR(y, (x[i] - 114.75f) / 57.375f, 2e-3);
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,224 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/global_avg_pool_fc_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// Sums of the windows of one C x ... plane, separably: each axis is reduced
+// with a running sum from the innermost to the outermost one, so a window
+// costs a few adds per axis whatever its size. plane and buffer are
+// scratch of the plane size.
+void WindowSums(
+    const float* x,
+    const std::vector<int>& dims,
+    const std::vector<int>& window_dims,
+    const std::vector<int>& window_counts,
+    std::vector<float>* plane,
+    std::vector<float>* buffer,
+    float* y) {
+  const int spatial = dims.size();
+  std::vector<int> cur(dims);
+  const float* in = x;
+  for (int a = spatial - 1; a >= 0; --a) {
+    const int k = window_dims[a];
+    if (k == 1) {
+      continue;
+    }
+    int outer = 1;
+    for (int i = 0; i < a; ++i) {
+      outer *= cur[i];
+    }
+    int inner = 1;
+    for (int i = a + 1; i < spatial; ++i) {
+      inner *= cur[i];
+    }
+    const int size = cur[a];
+    const int count = window_counts[a];
+    float* out = in == plane->data() ? buffer->data() : plane->data();
+    for (int o = 0; o < outer; ++o) {
+      const float* src = in + o * size * inner;
+      float* dst = out + o * count * inner;
+      for (int i = 0; i < inner; ++i) {
+        float sum = 0.f;
+        for (int l = 0; l < k; ++l) {
+          sum += src[l * inner + i];
+        }
+        dst[i] = sum;
+        for (int p = 1; p < count; ++p) {
+          sum += src[(p + k - 1) * inner + i] - src[(p - 1) * inner + i];
+          dst[p * inner + i] = sum;
+        }
+      }
+    }
+    cur[a] = count;
+    in = out;
+  }
+  int size = 1;
+  for (int d : cur) {
+    size *= d;
+  }
+  std::copy(in, in + size, y);
+}
+
+} // namespace
+
+template <>
+bool GlobalAvgPoolFCOp<float, CPUContext>::RunOnDevice() {
+  auto& X = Input(0);
+  auto& W = Input(1);
+  auto& b = Input(2);
+  auto* Y = Output(0);
+  InferWindows(X);
+  const int N = X.dim32(0);
+  const int C = X.dim32(1);
+  const int K = W.dim32(0);
+  // FC weights are K x C, the test nets' 1x1x1 conv weights K x C x 1 x 1 x 1
+  CAFFE_ENFORCE_EQ(W.size_from_dim(1), C);
+  CAFFE_ENFORCE_EQ(b.size(), K);
+  const int plane_size = X.size_from_dim(2);
+  const int L = num_windows_;
+  int window_size = 1;
+  for (int d : window_dims_) {
+    window_size *= d;
+  }
+  std::vector<int> dims(X.dims().begin() + 2, X.dims().end());
+
+  pooled_.Resize(N, C, L);
+  const float* Xdata = X.data<float>();
+  float* pooled = pooled_.mutable_data<float>();
+  if (L == 1) {
+    ConstEigenMatrixMap<float> x(Xdata, plane_size, N * C);
+    EigenVectorMap<float>(pooled, N * C) = x.colwise().mean();
+  } else {
+#pragma omp parallel
+    {
+      std::vector<float> plane(plane_size);
+      std::vector<float> buffer(plane_size);
+#pragma omp for
+      for (int i = 0; i < N * C; ++i) {
+        WindowSums(
+            Xdata + i * plane_size,
+            dims,
+            window_dims_,
+            window_counts_,
+            &plane,
+            &buffer,
+            pooled + i * L);
+      }
+    }
+    math::Scale<float, CPUContext>(
+        N * C * L, 1.f / window_size, pooled, pooled, &context_);
+  }
+
+  // logits of every window, K x L column major per clip
+  Y->Resize(N, K);
+  float* Ydata = Y->mutable_data<float>();
+  float* logits = Ydata;
+  if (L > 1 || softmax_) {
+    logits_.Resize(N, L, K);
+    logits = logits_.mutable_data<float>();
+  }
+  if (L == 1) {
+    math::Gemm<float, CPUContext>(
+        CblasNoTrans,
+        CblasTrans,
+        N,
+        K,
+        C,
+        1.f,
+        pooled,
+        W.data<float>(),
+        0.f,
+        logits,
+        &context_);
+  } else {
+    for (int n = 0; n < N; ++n) {
+      math::Gemm<float, CPUContext>(
+          CblasTrans,
+          CblasTrans,
+          L,
+          K,
+          C,
+          1.f,
+          pooled + n * C * L,
+          W.data<float>(),
+          0.f,
+          logits + n * L * K,
+          &context_);
+    }
+  }
+  EigenMatrixMap<float> z(logits, K, N * L);
+  z.colwise() += ConstEigenVectorMap<float>(b.data<float>(), K);
+  if (softmax_) {
+    for (int i = 0; i < N * L; ++i) {
+      auto col = z.col(i);
+      col = (col.array() - col.maxCoeff()).exp();
+      col /= col.sum();
+    }
+  }
+  if (logits != Ydata) {
+    EigenMatrixMap<float> y(Ydata, K, N);
+    for (int n = 0; n < N; ++n) {
+      y.col(n) = z.middleCols(n * L, L).rowwise().mean();
+    }
+  }
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(GlobalAvgPoolFC, GlobalAvgPoolFCOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(GlobalAvgPoolFC)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .TensorInferenceFunction([](const OperatorDef& def,
+                                const vector<TensorShape>& in) {
+      vector<TensorShape> out(1);
+      out[0].set_data_type(in[0].data_type());
+      out[0].add_dims(in[0].dims(0));
+      out[0].add_dims(in[1].dims(0));
+      return out;
+    })
+    .SetDoc(R"DOC(
+The pool5 -> FC (-> Softmax) head of the video nets in one op. X is average
+pooled over windows of the given kernels with stride 1 and no padding (over
+all of its spatial axes by default, i.e. global pooling), every pooled window
+is projected by W and b, optionally turned into class probabilities by a
+softmax, and Y is the mean over the windows. With one window and no softmax
+this is AveragePool + FC; with the pool5 kernels and softmax it is the fully
+convolutional test head (1x1x1 conv, per location softmax, spatial mean).
+The spatial size of X may change from run to run. Inference only.
+)DOC")
+    .Arg("kernels", "Pooling window per spatial axis (default: the whole input)")
+    .Arg("softmax", "Average the per window softmax instead of the logits")
+    .Input(0, "X", "Input features of shape N x C x T x H x W (NCHW)")
+    .Input(1, "W", "FC weights, K x C (or K x C x 1 x 1 x 1)")
+    .Input(2, "b", "FC bias of size K")
+    .Output(0, "Y", "N x K logits, or probabilities with softmax");
+
+SHOULD_NOT_DO_GRADIENT(GlobalAvgPoolFC);
+
+} // namespace caffe2
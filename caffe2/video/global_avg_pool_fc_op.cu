@@ -0,0 +1,254 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <cfloat>
+
+#include <cub/block/block_reduce.cuh>
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/video/global_avg_pool_fc_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+constexpr int kThreads = CAFFE_CUDA_NUM_THREADS;
+
+using BlockReduce = cub::BlockReduce<float, kThreads>;
+
+// global pooling, one block per N x C plane
+__global__ void PlaneMeanKernel(
+    const int planes,
+    const int plane_size,
+    const float* X,
+    float* pooled) {
+  __shared__ typename BlockReduce::TempStorage temp;
+  for (int i = blockIdx.x; i < planes; i += gridDim.x) {
+    const float* x = X + static_cast<size_t>(i) * plane_size;
+    float sum = 0.f;
+    for (int j = threadIdx.x; j < plane_size; j += blockDim.x) {
+      sum += x[j];
+    }
+    sum = BlockReduce(temp).Sum(sum);
+    if (threadIdx.x == 0) {
+      pooled[i] = sum / plane_size;
+    }
+    __syncthreads();
+  }
+}
+
+// one thread per window of a plane; the spatial axes are padded to three
+__global__ void WindowMeanKernel(
+    const int size,
+    const int T,
+    const int H,
+    const int W,
+    const int kT,
+    const int kH,
+    const int kW,
+    const int LT,
+    const int LH,
+    const int LW,
+    const float* X,
+    float* pooled) {
+  const int L = LT * LH * LW;
+  const float scale = 1.f / (kT * kH * kW);
+  CUDA_1D_KERNEL_LOOP(index, size) {
+    const int w = index % LW;
+    const int h = (index / LW) % LH;
+    const int t = (index / (LW * LH)) % LT;
+    const int plane = index / L;
+    const float* x = X + static_cast<size_t>(plane) * T * H * W;
+    float sum = 0.f;
+    for (int i = t; i < t + kT; ++i) {
+      for (int j = h; j < h + kH; ++j) {
+        for (int l = w; l < w + kW; ++l) {
+          sum += x[(i * H + j) * W + l];
+        }
+      }
+    }
+    pooled[index] = sum * scale;
+  }
+}
+
+// one block per clip: adds the bias to the logits of its L windows, takes
+// their softmax if asked to, and writes the mean over the windows to Y.
+// Every thread owns the same classes in all windows, so logits may be Y
+// itself when L is 1.
+__global__ void HeadKernel(
+    const int N,
+    const int L,
+    const int K,
+    const bool softmax,
+    const float* logits,
+    const float* bias,
+    float* Y) {
+  __shared__ typename BlockReduce::TempStorage temp;
+  __shared__ float shared;
+  for (int n = blockIdx.x; n < N; n += gridDim.x) {
+    float* y = Y + n * K;
+    for (int l = 0; l < L; ++l) {
+      const float* z = logits + (static_cast<size_t>(n) * L + l) * K;
+      float max = 0.f;
+      float inv_sum = 1.f;
+      if (softmax) {
+        float m = -FLT_MAX;
+        for (int k = threadIdx.x; k < K; k += blockDim.x) {
+          m = fmaxf(m, z[k] + bias[k]);
+        }
+        m = BlockReduce(temp).Reduce(m, cub::Max());
+        if (threadIdx.x == 0) {
+          shared = m;
+        }
+        __syncthreads();
+        max = shared;
+        float s = 0.f;
+        for (int k = threadIdx.x; k < K; k += blockDim.x) {
+          s += expf(z[k] + bias[k] - max);
+        }
+        s = BlockReduce(temp).Sum(s);
+        if (threadIdx.x == 0) {
+          shared = s;
+        }
+        __syncthreads();
+        inv_sum = 1.f / shared;
+      }
+      for (int k = threadIdx.x; k < K; k += blockDim.x) {
+        const float v = z[k] + bias[k];
+        const float p = (softmax ? expf(v - max) * inv_sum : v) / L;
+        y[k] = l == 0 ? p : y[k] + p;
+      }
+      __syncthreads();
+    }
+  }
+}
+
+} // namespace
+
+template <>
+bool GlobalAvgPoolFCOp<float, CUDAContext>::RunOnDevice() {
+  auto& X = Input(0);
+  auto& W = Input(1);
+  auto& b = Input(2);
+  auto* Y = Output(0);
+  InferWindows(X);
+  const int N = X.dim32(0);
+  const int C = X.dim32(1);
+  const int K = W.dim32(0);
+  CAFFE_ENFORCE_EQ(W.size_from_dim(1), C);
+  CAFFE_ENFORCE_EQ(b.size(), K);
+  const int plane_size = X.size_from_dim(2);
+  const int L = num_windows_;
+
+  pooled_.Resize(N, C, L);
+  float* pooled = pooled_.mutable_data<float>();
+  if (L == 1) {
+    PlaneMeanKernel<<<
+        std::min(N * C, CAFFE_MAXIMUM_NUM_BLOCKS),
+        kThreads,
+        0,
+        context_.cuda_stream()>>>(N * C, plane_size, X.data<float>(), pooled);
+  } else {
+    const int spatial = X.ndim() - 2;
+    CAFFE_ENFORCE_LE(
+        spatial, 3, "GlobalAvgPoolFC windows take up to 3 spatial axes on GPU");
+    // the spatial axes, padded to T x H x W
+    int dims[3] = {1, 1, 1};
+    int windows[3] = {1, 1, 1};
+    int counts[3] = {1, 1, 1};
+    for (int i = 0; i < spatial; ++i) {
+      dims[3 - spatial + i] = X.dim32(i + 2);
+      windows[3 - spatial + i] = window_dims_[i];
+      counts[3 - spatial + i] = window_counts_[i];
+    }
+    const int size = N * C * L;
+    WindowMeanKernel<<<
+        CAFFE_GET_BLOCKS(size),
+        CAFFE_CUDA_NUM_THREADS,
+        0,
+        context_.cuda_stream()>>>(
+        size,
+        dims[0],
+        dims[1],
+        dims[2],
+        windows[0],
+        windows[1],
+        windows[2],
+        counts[0],
+        counts[1],
+        counts[2],
+        X.data<float>(),
+        pooled);
+  }
+
+  Y->Resize(N, K);
+  float* Ydata = Y->mutable_data<float>();
+  float* logits = Ydata;
+  if (L > 1 || softmax_) {
+    logits_.Resize(N, L, K);
+    logits = logits_.mutable_data<float>();
+  }
+  if (L == 1) {
+    math::Gemm<float, CUDAContext>(
+        CblasNoTrans,
+        CblasTrans,
+        N,
+        K,
+        C,
+        1.f,
+        pooled,
+        W.data<float>(),
+        0.f,
+        logits,
+        &context_);
+  } else {
+    for (int n = 0; n < N; ++n) {
+      math::Gemm<float, CUDAContext>(
+          CblasTrans,
+          CblasTrans,
+          L,
+          K,
+          C,
+          1.f,
+          pooled + n * C * L,
+          W.data<float>(),
+          0.f,
+          logits + n * L * K,
+          &context_);
+    }
+  }
+  HeadKernel<<<
+      std::min(N, CAFFE_MAXIMUM_NUM_BLOCKS),
+      kThreads,
+      0,
+      context_.cuda_stream()>>>(
+      N, L, K, softmax_, logits, b.data<float>(), Ydata);
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(
+    GlobalAvgPoolFC,
+    GlobalAvgPoolFCOp<float, CUDAContext>);
+
+} // namespace caffe2
@@ -0,0 +1,215 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <algorithm>
+
+#include "caffe2/video/group_conv_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// the outputs [*lo, *hi) along an axis whose input o * stride - pad + offset
+// is in [0, size)
+inline void ValidRange(
+    const int size,
+    const int out,
+    const int stride,
+    const int pad,
+    const int offset,
+    int* lo,
+    int* hi) {
+  const int first = pad - offset;
+  *lo = first <= 0 ? 0 : (first + stride - 1) / stride;
+  const int last = size - 1 + pad - offset;
+  *hi = last < 0 ? 0 : std::min(out, last / stride + 1);
+}
+
+// f(y, x) for every output y of a channel and the input x that the kernel
+// tap (kt, kh, kw) reads for it, skipping the padding
+template <typename F>
+inline void ForEachTap(
+    const GroupConv3dShape& s,
+    const int kt,
+    const int kh,
+    const int kw,
+    F f) {
+  int t_lo, t_hi, h_lo, h_hi, w_lo, w_hi;
+  const int offset_t = kt * s.dilation[0];
+  const int offset_h = kh * s.dilation[1];
+  const int offset_w = kw * s.dilation[2];
+  ValidRange(s.in[0], s.out[0], s.stride[0], s.pad[0], offset_t, &t_lo, &t_hi);
+  ValidRange(s.in[1], s.out[1], s.stride[1], s.pad[1], offset_h, &h_lo, &h_hi);
+  ValidRange(s.in[2], s.out[2], s.stride[2], s.pad[2], offset_w, &w_lo, &w_hi);
+  for (int t = t_lo; t < t_hi; ++t) {
+    const int t_in = t * s.stride[0] - s.pad[0] + offset_t;
+    for (int h = h_lo; h < h_hi; ++h) {
+      const int h_in = h * s.stride[1] - s.pad[1] + offset_h;
+      const int y_row = (t * s.out[1] + h) * s.out[2];
+      const int x_row = (t_in * s.in[1] + h_in) * s.in[2];
+      for (int w = w_lo; w < w_hi; ++w) {
+        f(y_row + w, x_row + w * s.stride[2] - s.pad[2] + offset_w);
+      }
+    }
+  }
+}
+
+} // namespace
+
+template <>
+void GroupConv3d<float, CPUContext>(
+    const GroupConv3dShape& s,
+    const float* X,
+    const float* W,
+    const float* b,
+    float* Y,
+    CPUContext* /*context*/) {
+  const int C_group = s.C / s.G;
+  const int M_group = s.M / s.G;
+  const int in_size = s.in_size();
+  const int out_size = s.out_size();
+  const int kernel_size = s.kernel_size();
+  // an output channel of a clip per iteration, accumulated tap by tap over
+  // the input channels of its group
+#pragma omp parallel for
+  for (int nm = 0; nm < s.N * s.M; ++nm) {
+    const int n = nm / s.M;
+    const int m = nm % s.M;
+    const int g = m / M_group;
+    float* y = Y + nm * out_size;
+    std::fill(y, y + out_size, b ? b[m] : 0.f);
+    for (int c = 0; c < C_group; ++c) {
+      const float* x = X + (n * s.C + g * C_group + c) * in_size;
+      const float* w = W + (m * C_group + c) * kernel_size;
+      for (int kt = 0; kt < s.kernel[0]; ++kt) {
+        for (int kh = 0; kh < s.kernel[1]; ++kh) {
+          for (int kw = 0; kw < s.kernel[2]; ++kw) {
+            const float weight =
+                w[(kt * s.kernel[1] + kh) * s.kernel[2] + kw];
+            ForEachTap(s, kt, kh, kw, [=](int yi, int xi) {
+              y[yi] += weight * x[xi];
+            });
+          }
+        }
+      }
+    }
+  }
+}
+
+template <>
+void GroupConv3dInputGradient<float, CPUContext>(
+    const GroupConv3dShape& s,
+    const float* dY,
+    const float* W,
+    float* dX,
+    CPUContext* /*context*/) {
+  const int C_group = s.C / s.G;
+  const int M_group = s.M / s.G;
+  const int in_size = s.in_size();
+  const int out_size = s.out_size();
+  const int kernel_size = s.kernel_size();
+  // an input channel of a clip per iteration, from the output channels of
+  // its group
+#pragma omp parallel for
+  for (int nc = 0; nc < s.N * s.C; ++nc) {
+    const int n = nc / s.C;
+    const int c = nc % s.C;
+    const int g = c / C_group;
+    float* dx = dX + nc * in_size;
+    std::fill(dx, dx + in_size, 0.f);
+    for (int m = g * M_group; m < (g + 1) * M_group; ++m) {
+      const float* dy = dY + (n * s.M + m) * out_size;
+      const float* w = W + (m * C_group + c % C_group) * kernel_size;
+      for (int kt = 0; kt < s.kernel[0]; ++kt) {
+        for (int kh = 0; kh < s.kernel[1]; ++kh) {
+          for (int kw = 0; kw < s.kernel[2]; ++kw) {
+            const float weight =
+                w[(kt * s.kernel[1] + kh) * s.kernel[2] + kw];
+            ForEachTap(s, kt, kh, kw, [=](int yi, int xi) {
+              dx[xi] += weight * dy[yi];
+            });
+          }
+        }
+      }
+    }
+  }
+}
+
+template <>
+void GroupConv3dFilterGradient<float, CPUContext>(
+    const GroupConv3dShape& s,
+    const float* X,
+    const float* dY,
+    float* dW,
+    float* db,
+    CPUContext* /*context*/) {
+  const int C_group = s.C / s.G;
+  const int M_group = s.M / s.G;
+  const int in_size = s.in_size();
+  const int out_size = s.out_size();
+  const int kernel_size = s.kernel_size();
+  // the filters of an output channel per iteration, over the clips
+#pragma omp parallel for
+  for (int m = 0; m < s.M; ++m) {
+    const int g = m / M_group;
+    float* dw = dW + m * C_group * kernel_size;
+    std::fill(dw, dw + C_group * kernel_size, 0.f);
+    float bias = 0.f;
+    for (int n = 0; n < s.N; ++n) {
+      const float* dy = dY + (n * s.M + m) * out_size;
+      for (int c = 0; c < C_group; ++c) {
+        const float* x = X + (n * s.C + g * C_group + c) * in_size;
+        for (int k = 0; k < kernel_size; ++k) {
+          const int kt = k / (s.kernel[1] * s.kernel[2]);
+          const int kh = k / s.kernel[2] % s.kernel[1];
+          const int kw = k % s.kernel[2];
+          float sum = 0.f;
+          ForEachTap(s, kt, kh, kw, [&](int yi, int xi) {
+            sum += dy[yi] * x[xi];
+          });
+          dw[c * kernel_size + k] += sum;
+        }
+      }
+      if (db) {
+        for (int i = 0; i < out_size; ++i) {
+          bias += dy[i];
+        }
+      }
+    }
+    if (db) {
+      db[m] = bias;
+    }
+  }
+}
+
+REGISTER_CPU_OPERATOR_WITH_ENGINE(
+    Conv,
+    DIRECT,
+    GroupConvOp<float, CPUContext>);
+REGISTER_CPU_OPERATOR_WITH_ENGINE(
+    ConvGradient,
+    DIRECT,
+    GroupConvGradientOp<float, CPUContext>);
+
+} // namespace caffe2
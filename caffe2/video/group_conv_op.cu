@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <cub/block/block_reduce.cuh>
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/video/group_conv_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+constexpr int kReduceThreads = 128;
+using BlockReduce = cub::BlockReduce<float, kReduceThreads>;
+
+// a thread per output, over the input channels of its group and the taps
+__global__ void GroupConv3dKernel(
+    const int count,
+    const GroupConv3dShape s,
+    const float* X,
+    const float* W,
+    const float* b,
+    float* Y) {
+  const int C_group = s.C / s.G;
+  const int M_group = s.M / s.G;
+  const int kernel_size = s.kernel[0] * s.kernel[1] * s.kernel[2];
+  CUDA_1D_KERNEL_LOOP(index, count) {
+    const int w = index % s.out[2];
+    const int h = index / s.out[2] % s.out[1];
+    const int t = index / (s.out[2] * s.out[1]) % s.out[0];
+    const int nm = index / (s.out[2] * s.out[1] * s.out[0]);
+    const int n = nm / s.M;
+    const int m = nm % s.M;
+    const int g = m / M_group;
+    float sum = b ? b[m] : 0.f;
+    for (int c = 0; c < C_group; ++c) {
+      const float* x =
+          X + (n * s.C + g * C_group + c) * s.in[0] * s.in[1] * s.in[2];
+      const float* weight = W + (m * C_group + c) * kernel_size;
+      for (int kt = 0; kt < s.kernel[0]; ++kt) {
+        const int t_in = t * s.stride[0] - s.pad[0] + kt * s.dilation[0];
+        if (t_in < 0 || t_in >= s.in[0]) {
+          continue;
+        }
+        for (int kh = 0; kh < s.kernel[1]; ++kh) {
+          const int h_in = h * s.stride[1] - s.pad[1] + kh * s.dilation[1];
+          if (h_in < 0 || h_in >= s.in[1]) {
+            continue;
+          }
+          for (int kw = 0; kw < s.kernel[2]; ++kw) {
+            const int w_in =
+                w * s.stride[2] - s.pad[2] + kw * s.dilation[2];
+            if (w_in < 0 || w_in >= s.in[2]) {
+              continue;
+            }
+            sum += __ldg(weight + (kt * s.kernel[1] + kh) * s.kernel[2] + kw) *
+                __ldg(x + (t_in * s.in[1] + h_in) * s.in[2] + w_in);
+          }
+        }
+      }
+    }
+    Y[index] = sum;
+  }
+}
+
+// the output position of an input position and a tap along an axis, or -1
+__device__ inline int
+OutputOf(const int i, const int tap, const int stride, const int pad,
+         const int dilation, const int out) {
+  const int o = i + pad - tap * dilation;
+  if (o < 0 || o % stride != 0 || o / stride >= out) {
+    return -1;
+  }
+  return o / stride;
+}
+
+// a thread per input, over the output channels of its group and the taps
+// that read it
+__global__ void GroupConv3dInputGradientKernel(
+    const int count,
+    const GroupConv3dShape s,
+    const float* dY,
+    const float* W,
+    float* dX) {
+  const int C_group = s.C / s.G;
+  const int M_group = s.M / s.G;
+  const int kernel_size = s.kernel[0] * s.kernel[1] * s.kernel[2];
+  CUDA_1D_KERNEL_LOOP(index, count) {
+    const int w = index % s.in[2];
+    const int h = index / s.in[2] % s.in[1];
+    const int t = index / (s.in[2] * s.in[1]) % s.in[0];
+    const int nc = index / (s.in[2] * s.in[1] * s.in[0]);
+    const int n = nc / s.C;
+    const int c = nc % s.C;
+    const int g = c / C_group;
+    float sum = 0.f;
+    for (int m = g * M_group; m < (g + 1) * M_group; ++m) {
+      const float* dy =
+          dY + (n * s.M + m) * s.out[0] * s.out[1] * s.out[2];
+      const float* weight = W + (m * C_group + c % C_group) * kernel_size;
+      for (int kt = 0; kt < s.kernel[0]; ++kt) {
+        const int t_out = OutputOf(
+            t, kt, s.stride[0], s.pad[0], s.dilation[0], s.out[0]);
+        if (t_out < 0) {
+          continue;
+        }
+        for (int kh = 0; kh < s.kernel[1]; ++kh) {
+          const int h_out = OutputOf(
+              h, kh, s.stride[1], s.pad[1], s.dilation[1], s.out[1]);
+          if (h_out < 0) {
+            continue;
+          }
+          for (int kw = 0; kw < s.kernel[2]; ++kw) {
+            const int w_out = OutputOf(
+                w, kw, s.stride[2], s.pad[2], s.dilation[2], s.out[2]);
+            if (w_out < 0) {
+              continue;
+            }
+            sum += __ldg(weight + (kt * s.kernel[1] + kh) * s.kernel[2] + kw) *
+                __ldg(dy + (t_out * s.out[1] + h_out) * s.out[2] + w_out);
+          }
+        }
+      }
+    }
+    dX[index] = sum;
+  }
+}
+
+// a block per filter tap (m, c, k), reducing over the clips and outputs
+__global__ void GroupConv3dFilterGradientKernel(
+    const GroupConv3dShape s,
+    const float* X,
+    const float* dY,
+    float* dW) {
+  __shared__ typename BlockReduce::TempStorage reduce_storage;
+  const int C_group = s.C / s.G;
+  const int M_group = s.M / s.G;
+  const int kernel_size = s.kernel[0] * s.kernel[1] * s.kernel[2];
+  const int out_size = s.out[0] * s.out[1] * s.out[2];
+  const int in_size = s.in[0] * s.in[1] * s.in[2];
+  const int k = blockIdx.x % kernel_size;
+  const int c = blockIdx.x / kernel_size % C_group;
+  const int m = blockIdx.x / (kernel_size * C_group);
+  const int g = m / M_group;
+  const int kt = k / (s.kernel[1] * s.kernel[2]);
+  const int kh = k / s.kernel[2] % s.kernel[1];
+  const int kw = k % s.kernel[2];
+  float sum = 0.f;
+  for (int i = threadIdx.x; i < s.N * out_size; i += blockDim.x) {
+    const int n = i / out_size;
+    const int w = i % s.out[2];
+    const int h = i / s.out[2] % s.out[1];
+    const int t = i / (s.out[2] * s.out[1]) % s.out[0];
+    const int t_in = t * s.stride[0] - s.pad[0] + kt * s.dilation[0];
+    const int h_in = h * s.stride[1] - s.pad[1] + kh * s.dilation[1];
+    const int w_in = w * s.stride[2] - s.pad[2] + kw * s.dilation[2];
+    if (t_in < 0 || t_in >= s.in[0] || h_in < 0 || h_in >= s.in[1] ||
+        w_in < 0 || w_in >= s.in[2]) {
+      continue;
+    }
+    sum += __ldg(dY + (n * s.M + m) * out_size + i % out_size) *
+        __ldg(X + (n * s.C + g * C_group + c) * in_size +
+              (t_in * s.in[1] + h_in) * s.in[2] + w_in);
+  }
+  sum = BlockReduce(reduce_storage).Sum(sum);
+  if (threadIdx.x == 0) {
+    dW[blockIdx.x] = sum;
+  }
+}
+
+// a block per output channel
+__global__ void GroupConv3dBiasGradientKernel(
+    const GroupConv3dShape s,
+    const float* dY,
+    float* db) {
+  __shared__ typename BlockReduce::TempStorage reduce_storage;
+  const int out_size = s.out[0] * s.out[1] * s.out[2];
+  const int m = blockIdx.x;
+  float sum = 0.f;
+  for (int i = threadIdx.x; i < s.N * out_size; i += blockDim.x) {
+    sum += __ldg(dY + (i / out_size * s.M + m) * out_size + i % out_size);
+  }
+  sum = BlockReduce(reduce_storage).Sum(sum);
+  if (threadIdx.x == 0) {
+    db[m] = sum;
+  }
+}
+
+} // namespace
+
+template <>
+void GroupConv3d<float, CUDAContext>(
+    const GroupConv3dShape& s,
+    const float* X,
+    const float* W,
+    const float* b,
+    float* Y,
+    CUDAContext* context) {
+  const int count = s.N * s.M * s.out_size();
+  GroupConv3dKernel<<<
+      CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(count, s, X, W, b, Y);
+}
+
+template <>
+void GroupConv3dInputGradient<float, CUDAContext>(
+    const GroupConv3dShape& s,
+    const float* dY,
+    const float* W,
+    float* dX,
+    CUDAContext* context) {
+  const int count = s.N * s.C * s.in_size();
+  GroupConv3dInputGradientKernel<<<
+      CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(count, s, dY, W, dX);
+}
+
+template <>
+void GroupConv3dFilterGradient<float, CUDAContext>(
+    const GroupConv3dShape& s,
+    const float* X,
+    const float* dY,
+    float* dW,
+    float* db,
+    CUDAContext* context) {
+  GroupConv3dFilterGradientKernel<<<
+      s.M * (s.C / s.G) * s.kernel_size(),
+      kReduceThreads,
+      0,
+      context->cuda_stream()>>>(s, X, dY, dW);
+  if (db) {
+    GroupConv3dBiasGradientKernel<<<
+        s.M,
+        kReduceThreads,
+        0,
+        context->cuda_stream()>>>(s, dY, db);
+  }
+}
+
+REGISTER_CUDA_OPERATOR_WITH_ENGINE(
+    Conv,
+    DIRECT,
+    GroupConvOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR_WITH_ENGINE(
+    ConvGradient,
+    DIRECT,
+    GroupConvGradientOp<float, CUDAContext>);
+
+} // namespace caffe2
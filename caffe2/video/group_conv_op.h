@@ -0,0 +1,225 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef GROUP_CONV_OP_H_
+#define GROUP_CONV_OP_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/operators/conv_pool_op_base.h"
+
+namespace caffe2 {
+
+// The sizes of a grouped 3D convolution of X (N x C x in) with W
+// (M x C / G x kernel) to Y (N x M x out), NCHW.
+struct GroupConv3dShape {
+  int N, C, M, G;
+  int in[3];
+  int out[3];
+  int kernel[3];
+  int stride[3];
+  int pad[3];
+  int dilation[3];
+
+  int in_size() const {
+    return in[0] * in[1] * in[2];
+  }
+  int out_size() const {
+    return out[0] * out[1] * out[2];
+  }
+  int kernel_size() const {
+    return kernel[0] * kernel[1] * kernel[2];
+  }
+};
+
+// Y = conv(X, W) + b, b may be null
+template <typename T, class Context>
+void GroupConv3d(
+    const GroupConv3dShape& shape,
+    const T* X,
+    const T* W,
+    const T* b,
+    T* Y,
+    Context* context);
+
+template <typename T, class Context>
+void GroupConv3dInputGradient(
+    const GroupConv3dShape& shape,
+    const T* dY,
+    const T* W,
+    T* dX,
+    Context* context);
+
+// db may be null
+template <typename T, class Context>
+void GroupConv3dFilterGradient(
+    const GroupConv3dShape& shape,
+    const T* X,
+    const T* dY,
+    T* dW,
+    T* db,
+    Context* context);
+
+template <class Context>
+void GroupConv3dShapeOf(
+    const Tensor<Context>& X,
+    const Tensor<Context>& W,
+    const int group,
+    const std::vector<int>& kernel,
+    const std::vector<int>& stride,
+    const std::vector<int>& pads,
+    const std::vector<int>& dilation,
+    GroupConv3dShape* shape) {
+  CAFFE_ENFORCE_EQ(X.ndim(), 5, "the DIRECT engine takes 3D convolutions");
+  CAFFE_ENFORCE_EQ(W.ndim(), 5);
+  shape->N = X.dim32(0);
+  shape->C = X.dim32(1);
+  shape->M = W.dim32(0);
+  shape->G = group;
+  CAFFE_ENFORCE_EQ(shape->C % group, 0);
+  CAFFE_ENFORCE_EQ(shape->M % group, 0);
+  CAFFE_ENFORCE_EQ(W.dim32(1), shape->C / group);
+  for (int i = 0; i < 3; ++i) {
+    CAFFE_ENFORCE_EQ(W.dim32(i + 2), kernel[i]);
+    shape->in[i] = X.dim32(i + 2);
+    shape->kernel[i] = kernel[i];
+    shape->stride[i] = stride[i];
+    shape->pad[i] = pads[i];
+    shape->dilation[i] = dilation[i];
+    shape->out[i] =
+        (shape->in[i] + pads[i] + pads[i + 3] -
+         (dilation[i] * (kernel[i] - 1) + 1)) /
+            stride[i] +
+        1;
+  }
+}
+
+// Conv with engine DIRECT: a direct grouped 3D convolution, without im2col,
+// for the grouped and depthwise (group == C) convolutions of ResNeXt and
+// channel-separated models. The generic Conv runs one im2col and GEMM per
+// group, which are small and slow for these; the cost of this one is the
+// FLOPs of the convolution. NCHW only.
+template <typename T, class Context>
+class GroupConvOp final : public ConvPoolOpBase<Context> {
+ public:
+  USE_CONV_POOL_BASE_FUNCTIONS(Context);
+  GroupConvOp(const OperatorDef& operator_def, Workspace* ws)
+      : ConvPoolOpBase<Context>(operator_def, ws) {
+    OPERATOR_NEEDS_FEATURE(
+        order_ == StorageOrder::NCHW, "Only NCHW order supported.");
+    CAFFE_ENFORCE_EQ(
+        kernel_.size(), 3, "the DIRECT engine takes 3D convolutions");
+  }
+
+  bool RunOnDeviceWithOrderNCHW() override {
+    auto& X = Input(0);
+    auto& W = Input(1);
+    auto* Y = Output(0);
+    GroupConv3dShape shape;
+    GroupConv3dShapeOf(
+        X, W, group_, kernel_, stride_, pads_, dilation_, &shape);
+    ConvPoolOpBase<Context>::SetOutputSize(X, Y, shape.M);
+    const T* b = nullptr;
+    if (InputSize() == 3) {
+      CAFFE_ENFORCE_EQ(Input(2).size(), shape.M);
+      b = Input(2).template data<T>();
+    }
+    GroupConv3d<T, Context>(
+        shape,
+        X.template data<T>(),
+        W.template data<T>(),
+        b,
+        Y->template mutable_data<T>(),
+        &context_);
+    return true;
+  }
+
+  bool RunOnDeviceWithOrderNHWC() override {
+    CAFFE_NOT_IMPLEMENTED;
+  }
+};
+
+// ConvGradient with engine DIRECT: inputs X, W and dY, outputs dW, db
+// (unless no_bias) and dX (unless no_gradient_to_input).
+template <typename T, class Context>
+class GroupConvGradientOp final : public ConvPoolOpBase<Context> {
+ public:
+  USE_CONV_POOL_BASE_FUNCTIONS(Context);
+  GroupConvGradientOp(const OperatorDef& operator_def, Workspace* ws)
+      : ConvPoolOpBase<Context>(operator_def, ws),
+        no_bias_(OperatorBase::GetSingleArgument<int>("no_bias", 0)) {
+    OPERATOR_NEEDS_FEATURE(
+        order_ == StorageOrder::NCHW, "Only NCHW order supported.");
+    CAFFE_ENFORCE_EQ(
+        kernel_.size(), 3, "the DIRECT engine takes 3D convolutions");
+  }
+
+  bool RunOnDeviceWithOrderNCHW() override {
+    auto& X = Input(0);
+    auto& W = Input(1);
+    auto& dY = Input(2);
+    GroupConv3dShape shape;
+    GroupConv3dShapeOf(
+        X, W, group_, kernel_, stride_, pads_, dilation_, &shape);
+    CAFFE_ENFORCE_EQ(dY.size(), shape.N * shape.M * shape.out_size());
+    auto* dW = Output(0);
+    dW->ResizeLike(W);
+    T* db = nullptr;
+    if (!no_bias_) {
+      auto* dbias = Output(1);
+      dbias->Resize(shape.M);
+      db = dbias->template mutable_data<T>();
+    }
+    GroupConv3dFilterGradient<T, Context>(
+        shape,
+        X.template data<T>(),
+        dY.template data<T>(),
+        dW->template mutable_data<T>(),
+        db,
+        &context_);
+    if (OutputSize() == (no_bias_ ? 2 : 3)) {
+      auto* dX = Output(no_bias_ ? 1 : 2);
+      dX->ResizeLike(X);
+      GroupConv3dInputGradient<T, Context>(
+          shape,
+          dY.template data<T>(),
+          W.template data<T>(),
+          dX->template mutable_data<T>(),
+          &context_);
+    }
+    return true;
+  }
+
+  bool RunOnDeviceWithOrderNHWC() override {
+    CAFFE_NOT_IMPLEMENTED;
+  }
+
+ private:
+  bool no_bias_;
+};
+
+} // namespace caffe2
+
+#endif // GROUP_CONV_OP_H_
@@ -0,0 +1,99 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/operator_gradient.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/group_conv_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// a 2 x C x 4 x 6 x 5 input
+constexpr int kN = 2;
+constexpr int kT = 4;
+constexpr int kH = 6;
+constexpr int kW = 5;
+
+void AddRandomInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<TIndex>& dims,
+    const int seed) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  for (int i = 0; i < tensor->size(); ++i) {
+    tensor->mutable_data<float>()[i] = dist(gen);
+  }
+}
+
+OperatorDef ConvDef(const std::string& engine, const int group) {
+  OperatorDef def;
+  def.set_type("Conv");
+  def.set_engine(engine);
+  def.add_input("X");
+  def.add_input("W");
+  def.add_input("b");
+  def.add_output("Y_" + engine);
+  def.add_arg()->CopyFrom(MakeArgument<int>("group", group));
+  def.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("kernels", {3, 3, 3}));
+  def.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("strides", {2, 1, 2}));
+  // uneven pads; ConvPoolOpBase does not allow dilations with groups
+  def.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("pads", {1, 0, 1, 1, 2, 0}));
+  return def;
+}
+
+// runs Conv and ConvGradient with the default engine and DIRECT, and checks
+// that Y, dX, dW and db match
+void CheckGroupConv(const int C, const int M, const int group) {
+  Workspace ws;
+  AddRandomInput(&ws, "X", {kN, C, kT, kH, kW}, 1);
+  AddRandomInput(&ws, "W", {M, C / group, 3, 3, 3}, 2);
+  AddRandomInput(&ws, "b", {M}, 3);
+  std::vector<std::string> grads;
+  for (const std::string engine : {"", "DIRECT"}) {
+    const auto def = ConvDef(engine, group);
+    ASSERT_TRUE(CreateOperator(def, &ws)->Run());
+    const auto& Y = ws.GetBlob("Y_" + engine)->Get<TensorCPU>();
+    AddRandomInput(&ws, "Y_" + engine + "_grad", Y.dims(), 4);
+    GradientWrapper dY;
+    dY.dense_ = "Y_" + engine + "_grad";
+    auto meta = GetGradientForOp(def, {dY});
+    ASSERT_EQ(meta.ops_.size(), 1);
+    auto& grad_def = meta.ops_[0];
+    EXPECT_EQ(grad_def.engine(), engine);
+    for (int i = 0; i < grad_def.output_size(); ++i) {
+      grad_def.set_output(i, grad_def.output(i) + "_" + engine);
+    }
+    ASSERT_TRUE(CreateOperator(grad_def, &ws)->Run());
+  }
+  for (const std::string name : {"Y", "X_grad", "W_grad", "b_grad"}) {
+    const auto& expected = ws.GetBlob(name + "_")->Get<TensorCPU>();
+    const auto& actual = ws.GetBlob(name + "_DIRECT")->Get<TensorCPU>();
+    ASSERT_EQ(actual.dims(), expected.dims()) << name;
+    for (int i = 0; i < actual.size(); ++i) {
+      EXPECT_NEAR(actual.data<float>()[i], expected.data<float>()[i], 1e-4)
+          << name << " " << i;
+    }
+  }
+}
+
+} // namespace
+
+TEST(GroupConvOpTest, GroupedMatchesConv) {
+  CheckGroupConv(6, 4, 2);
+}
+
+TEST(GroupConvOpTest, DepthwiseMatchesConv) {
+  CheckGroupConv(4, 8, 4);
+}
+
+} // namespace caffe2
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef INPLACE_ABN_OP_H_
+#define INPLACE_ABN_OP_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// In-place activated BN: Y = act(SpatialBN'(X)) for NCHW X of any number of
+// spatial dims, with act(z) = z for z >= 0 and alpha * z otherwise (alpha in
+// (0, 1], 1 being the identity), written over X. SpatialBN' is SpatialBN
+// with the scale |scale| + epsilon, so that the affine transform and act
+// are invertible: the gradient reads Y instead of X and recomputes
+// x_hat = (act^-1(Y) - bias) / (|scale| + epsilon), so the pair keeps one
+// activation for the backward pass instead of the BN input and output.
+// Inputs, outputs and the other arguments are the ones of SpatialBN.
+template <typename T, class Context>
+class InPlaceABNOp final : public Operator<Context> {
+ public:
+  InPlaceABNOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        is_test_(OperatorBase::template GetSingleArgument<int>(
+            OpSchema::Arg_IsTest,
+            0)),
+        epsilon_(
+            OperatorBase::template GetSingleArgument<float>("epsilon", 1e-5f)),
+        momentum_(
+            OperatorBase::template GetSingleArgument<float>("momentum", 0.9f)),
+        alpha_(
+            OperatorBase::template GetSingleArgument<float>("alpha", 0.01f)) {
+    CAFFE_ENFORCE(
+        (is_test_ && OutputSize() == 1) || (!is_test_ && OutputSize() == 5));
+    CAFFE_ENFORCE_EQ(
+        OperatorBase::template GetSingleArgument<string>("order", "NCHW"),
+        "NCHW",
+        "InPlaceABN only supports NCHW");
+    CAFFE_ENFORCE_GT(epsilon_, 0);
+    CAFFE_ENFORCE_GE(momentum_, 0);
+    CAFFE_ENFORCE_LE(momentum_, 1);
+    CAFFE_ENFORCE_GT(alpha_, 0, "the activation must be invertible");
+    CAFFE_ENFORCE_LE(alpha_, 1);
+  }
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  bool RunOnDevice() override;
+
+ protected:
+  bool is_test_;
+  float epsilon_;
+  float momentum_;
+  float alpha_;
+  INPUT_TAGS(INPUT, SCALE, BIAS, EST_MEAN, EST_VAR);
+  OUTPUT_TAGS(OUTPUT, RUNNING_MEAN, RUNNING_VAR, SAVED_MEAN, SAVED_INV_STD);
+
+  // a and b of Y = act(a[c] * X + b[c]), on GPU
+  Tensor<Context> affine_;
+};
+
+// Input: Y, scale, bias, dY, saved_inv_std
+// Output: dX (may be in place of dY), dscale, dbias
+template <typename T, class Context>
+class InPlaceABNGradientOp final : public Operator<Context> {
+ public:
+  InPlaceABNGradientOp(const OperatorDef& def, Workspace* ws)
+      : Operator<Context>(def, ws),
+        epsilon_(
+            OperatorBase::template GetSingleArgument<float>("epsilon", 1e-5f)),
+        alpha_(
+            OperatorBase::template GetSingleArgument<float>("alpha", 0.01f)) {
+    CAFFE_ENFORCE_GT(alpha_, 0);
+  }
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  bool RunOnDevice() override;
+
+ protected:
+  float epsilon_;
+  float alpha_;
+  INPUT_TAGS(OUTPUT, SCALE, BIAS, OUTPUT_GRAD, SAVED_INV_STD);
+  OUTPUT_TAGS(INPUT_GRAD, SCALE_GRAD, BIAS_GRAD);
+};
+
+} // namespace caffe2
+
+#endif // INPLACE_ABN_OP_H_
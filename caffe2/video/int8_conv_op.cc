@@ -0,0 +1,266 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/int8_conv_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// output tiles of the GEMM, kTileM x kTileP int32 accumulators stay in L1
+constexpr int kTileM = 8;
+constexpr int kTileP = 256;
+
+// im2col of one image, rows ((c * kT + i) * kH + j) * kW + l and columns
+// (t * H_out + h) * W_out + w, padded with pad_value
+void Int8Im2col3d(
+    const uint8_t* X,
+    const int C,
+    const int* dims,
+    const int* kernel,
+    const int* stride,
+    const int* pad,
+    const int* output_dims,
+    const uint8_t pad_value,
+    uint8_t* col) {
+  const int T = dims[0], H = dims[1], W = dims[2];
+  const int kT = kernel[0], kH = kernel[1], kW = kernel[2];
+  const int T_out = output_dims[0], H_out = output_dims[1],
+            W_out = output_dims[2];
+  const int output_size = T_out * H_out * W_out;
+  const int kernel_size = kT * kH * kW;
+#pragma omp parallel for
+  for (int row = 0; row < C * kernel_size; ++row) {
+    const int c = row / kernel_size;
+    const int i = row / (kH * kW) % kT;
+    const int j = row / kW % kH;
+    const int l = row % kW;
+    const uint8_t* x = X + c * T * H * W;
+    uint8_t* y = col + row * output_size;
+    for (int t = 0; t < T_out; ++t) {
+      const int t_in = t * stride[0] - pad[0] + i;
+      for (int h = 0; h < H_out; ++h) {
+        const int h_in = h * stride[1] - pad[1] + j;
+        uint8_t* y_row = y + (t * H_out + h) * W_out;
+        if (t_in < 0 || t_in >= T || h_in < 0 || h_in >= H) {
+          std::fill(y_row, y_row + W_out, pad_value);
+          continue;
+        }
+        const uint8_t* x_row = x + (t_in * H + h_in) * W;
+        for (int w = 0; w < W_out; ++w) {
+          const int w_in = w * stride[2] - pad[2] + l;
+          y_row[w] = (w_in < 0 || w_in >= W) ? pad_value : x_row[w_in];
+        }
+      }
+    }
+  }
+}
+
+// Y (M x P) = requantize(W (M x K) * col (K x P))
+void Int8Gemm(
+    const int M,
+    const int K,
+    const int P,
+    const int8_t* W,
+    const uint8_t* col,
+    const float* multipliers,
+    const float* offsets,
+    const int zero_point,
+    const int min_value,
+    uint8_t* Y) {
+  const int tiles_m = (M + kTileM - 1) / kTileM;
+  const int tiles_p = (P + kTileP - 1) / kTileP;
+#pragma omp parallel for
+  for (int tile = 0; tile < tiles_m * tiles_p; ++tile) {
+    const int m0 = tile / tiles_p * kTileM;
+    const int p0 = tile % tiles_p * kTileP;
+    const int rows = std::min(kTileM, M - m0);
+    const int cols = std::min(kTileP, P - p0);
+    int32_t acc[kTileM][kTileP];
+    for (int m = 0; m < rows; ++m) {
+      std::fill(acc[m], acc[m] + cols, 0);
+    }
+    for (int k = 0; k < K; ++k) {
+      const uint8_t* c = col + static_cast<size_t>(k) * P + p0;
+      for (int m = 0; m < rows; ++m) {
+        const int32_t w = W[(m0 + m) * K + k];
+        if (w == 0) {
+          continue;
+        }
+        int32_t* a = acc[m];
+        for (int p = 0; p < cols; ++p) {
+          a[p] += w * static_cast<int32_t>(c[p]);
+        }
+      }
+    }
+    for (int m = 0; m < rows; ++m) {
+      const float multiplier = multipliers[m0 + m];
+      const float offset = offsets[m0 + m];
+      uint8_t* y = Y + static_cast<size_t>(m0 + m) * P + p0;
+      for (int p = 0; p < cols; ++p) {
+        const int q = static_cast<int>(
+                          std::nearbyint(acc[m][p] * multiplier + offset)) +
+            zero_point;
+        y[p] = int8::Saturate(std::max(q, min_value));
+      }
+    }
+  }
+}
+
+} // namespace
+
+bool Int8ConvNdOp::RunOnDeviceWithOrderNCHW() {
+  const auto& X = Input(INPUT);
+  const auto& filter = Input(FILTER);
+  const auto& filter_scale = Input(FILTER_SCALE);
+  const auto& bias = Input(BIAS);
+  auto* Y = Output(0);
+  CAFFE_ENFORCE(X.IsType<uint8_t>(), "Int8ConvNd takes uint8 inputs");
+  CAFFE_ENFORCE(filter.IsType<int8_t>(), "Int8ConvNd takes int8 weights");
+  const int spatial = kernel_.size();
+  CAFFE_ENFORCE_EQ(X.ndim(), spatial + 2);
+  CAFFE_ENFORCE_EQ(filter.ndim(), spatial + 2);
+  const int N = X.dim32(0);
+  const int C = X.dim32(1);
+  const int M = filter.dim32(0);
+  CAFFE_ENFORCE_EQ(C, filter.dim32(1) * group_);
+  CAFFE_ENFORCE_EQ(M % group_, 0);
+  for (int i = 0; i < spatial; ++i) {
+    CAFFE_ENFORCE_EQ(filter.dim32(i + 2), kernel_[i]);
+  }
+  CAFFE_ENFORCE_EQ(filter_scale.size(), M);
+  CAFFE_ENFORCE_EQ(bias.size(), M);
+  ConvPoolOpBase<CPUContext>::SetOutputSize(X, Y, M);
+
+  // 2D convolutions are 3D ones over a single frame
+  int dims[3] = {1, 1, 1};
+  int output_dims[3] = {1, 1, 1};
+  int kernel[3] = {1, 1, 1};
+  int stride[3] = {1, 1, 1};
+  int pad[3] = {0, 0, 0};
+  bool pointwise = true;
+  for (int i = 0; i < spatial; ++i) {
+    const int j = 3 - spatial + i;
+    dims[j] = X.dim32(i + 2);
+    output_dims[j] = Y->dim32(i + 2);
+    kernel[j] = kernel_[i];
+    stride[j] = stride_[i];
+    pad[j] = pads_[i];
+    pointwise = pointwise && kernel_[i] == 1 && stride_[i] == 1 &&
+        pads_[i] == 0 && pads_[i + spatial] == 0;
+  }
+  const int input_size = dims[0] * dims[1] * dims[2];
+  const int output_size = output_dims[0] * output_dims[1] * output_dims[2];
+  const int M_group = M / group_;
+  const int K_group = filter.size_from_dim(1);
+
+  // requantization of the accumulators: the input zero point comes off as
+  // X_zero_point * sum(W) per channel
+  const int8_t* Wdata = filter.data<int8_t>();
+  const float* scales = filter_scale.data<float>();
+  const float* bias_data = bias.data<float>();
+  multipliers_.resize(M);
+  offsets_.resize(M);
+  for (int m = 0; m < M; ++m) {
+    int32_t sum = 0;
+    for (int k = 0; k < K_group; ++k) {
+      sum += Wdata[m * K_group + k];
+    }
+    const float real_scale = X_scale_ * scales[m];
+    multipliers_[m] = real_scale / Y_scale_;
+    offsets_[m] = (bias_data[m] - real_scale * X_zero_point_ * sum) / Y_scale_;
+  }
+
+  const uint8_t* Xdata = X.data<uint8_t>();
+  uint8_t* Ydata = Y->mutable_data<uint8_t>();
+  if (!pointwise) {
+    col_buffer_.resize(static_cast<size_t>(C) * filter.size_from_dim(2) *
+                       output_size);
+  }
+  const int min_value = relu_ ? Y_zero_point_ : 0;
+  for (int n = 0; n < N; ++n) {
+    const uint8_t* x = Xdata + static_cast<size_t>(n) * C * input_size;
+    const uint8_t* col = x;
+    if (!pointwise) {
+      Int8Im2col3d(
+          x,
+          C,
+          dims,
+          kernel,
+          stride,
+          pad,
+          output_dims,
+          int8::Saturate(X_zero_point_),
+          col_buffer_.data());
+      col = col_buffer_.data();
+    }
+    for (int g = 0; g < group_; ++g) {
+      Int8Gemm(
+          M_group,
+          K_group,
+          output_size,
+          Wdata + g * M_group * K_group,
+          col + static_cast<size_t>(g) * K_group * output_size,
+          multipliers_.data() + g * M_group,
+          offsets_.data() + g * M_group,
+          Y_zero_point_,
+          min_value,
+          Ydata + (static_cast<size_t>(n) * M + g * M_group) * output_size);
+    }
+  }
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(Int8ConvNd, Int8ConvNdOp);
+
+OPERATOR_SCHEMA(Int8ConvNd)
+    .NumInputs(4)
+    .NumOutputs(1)
+    .TensorInferenceFunction([](const OperatorDef& def,
+                                const vector<TensorShape>& in) {
+      auto out = ConvPoolOpBase<CPUContext>::TensorInferenceForConv(def, in);
+      out[0].set_data_type(TensorProto::UINT8);
+      return out;
+    })
+    .SetDoc(R"DOC(
+Quantized 2D / 3D convolution (NCHW) for inference. X holds uint8 values of
+real X_scale * (X - X_zero_point), W int8 values of real W_scale[m] * W, and
+the output is requantized to uint8 with Y_scale and Y_zero_point, after a
+ReLU if relu is set. Accumulates in int32; the bias stays in float. Takes the
+kernels, strides, pads and group arguments of Conv; no dilation.
+)DOC")
+    .Arg("X_scale", "Scale of the input")
+    .Arg("X_zero_point", "Zero point of the input")
+    .Arg("Y_scale", "Scale of the output")
+    .Arg("Y_zero_point", "Zero point of the output")
+    .Arg("relu", "Apply a ReLU before requantizing")
+    .Input(0, "X", "uint8 input of shape N x C x (T x) H x W")
+    .Input(1, "W", "int8 weights of shape M x C / group x (kT x) kH x kW")
+    .Input(2, "W_scale", "float scale of every output channel, size M")
+    .Input(3, "b", "float bias, size M")
+    .Output(0, "Y", "uint8 output");
+
+SHOULD_NOT_DO_GRADIENT(Int8ConvNd);
+
+} // namespace caffe2
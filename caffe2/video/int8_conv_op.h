@@ -0,0 +1,88 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef INT8_CONV_OP_H_
+#define INT8_CONV_OP_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/operators/conv_pool_op_base.h"
+#include "caffe2/video/int8_utils.h"
+
+namespace caffe2 {
+
+// 2D / 3D NCHW convolution of uint8 activations with int8 weights, int32
+// accumulation and a requantized uint8 output:
+//   Y = Q(X_scale * W_scale[m] * sum((X - X_zero_point) * W) + b[m])
+// where Q quantizes with Y_scale and Y_zero_point, after an optional ReLU.
+// The convolution is an im2col (padded with the zero point) and a GEMM that
+// runs in tiles of the output, in parallel; 1x1x1 convolutions without
+// stride or padding read X in place.
+class Int8ConvNdOp final : public ConvPoolOpBase<CPUContext> {
+ public:
+  USE_CONV_POOL_BASE_FUNCTIONS(CPUContext);
+  Int8ConvNdOp(const OperatorDef& operator_def, Workspace* ws)
+      : ConvPoolOpBase<CPUContext>(operator_def, ws),
+        X_scale_(OperatorBase::GetSingleArgument<float>("X_scale", 1.f)),
+        X_zero_point_(OperatorBase::GetSingleArgument<int>("X_zero_point", 0)),
+        Y_scale_(OperatorBase::GetSingleArgument<float>("Y_scale", 1.f)),
+        Y_zero_point_(OperatorBase::GetSingleArgument<int>("Y_zero_point", 0)),
+        relu_(OperatorBase::GetSingleArgument<bool>("relu", false)) {
+    OPERATOR_NEEDS_FEATURE(
+        order_ == StorageOrder::NCHW, "Only NCHW order supported.");
+    CAFFE_ENFORCE(
+        kernel_.size() == 2 || kernel_.size() == 3,
+        "Int8ConvNd takes 2D and 3D convolutions");
+    for (int d : dilation_) {
+      CAFFE_ENFORCE_EQ(d, 1, "Int8ConvNd does not support dilation");
+    }
+    CAFFE_ENFORCE_GT(X_scale_, 0.f);
+    CAFFE_ENFORCE_GT(Y_scale_, 0.f);
+  }
+
+  bool RunOnDeviceWithOrderNCHW() override;
+  bool RunOnDeviceWithOrderNHWC() override {
+    CAFFE_NOT_IMPLEMENTED;
+  }
+
+ private:
+  float X_scale_;
+  int X_zero_point_;
+  float Y_scale_;
+  int Y_zero_point_;
+  bool relu_;
+
+  std::vector<uint8_t> col_buffer_;
+  // the factor and offset that requantize the accumulators of every output
+  // channel
+  std::vector<float> multipliers_;
+  std::vector<float> offsets_;
+
+  INPUT_TAGS(INPUT, FILTER, FILTER_SCALE, BIAS);
+};
+
+} // namespace caffe2
+
+#endif // INT8_CONV_OP_H_
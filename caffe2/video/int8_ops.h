@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef INT8_OPS_H_
+#define INT8_OPS_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/operators/conv_pool_op_base.h"
+#include "caffe2/video/int8_utils.h"
+
+namespace caffe2 {
+
+// float -> uint8 with Y_scale and Y_zero_point, at the entry of an int8
+// region of the net
+class Int8QuantizeOp final : public Operator<CPUContext> {
+ public:
+  USE_OPERATOR_FUNCTIONS(CPUContext);
+  Int8QuantizeOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws),
+        Y_scale_(OperatorBase::GetSingleArgument<float>("Y_scale", 1.f)),
+        Y_zero_point_(
+            OperatorBase::GetSingleArgument<int>("Y_zero_point", 0)) {
+    CAFFE_ENFORCE_GT(Y_scale_, 0.f);
+  }
+  bool RunOnDevice() override;
+
+ private:
+  float Y_scale_;
+  int Y_zero_point_;
+};
+
+// uint8 -> float with X_scale and X_zero_point, at the exit of an int8
+// region of the net
+class Int8DequantizeOp final : public Operator<CPUContext> {
+ public:
+  USE_OPERATOR_FUNCTIONS(CPUContext);
+  Int8DequantizeOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws),
+        X_scale_(OperatorBase::GetSingleArgument<float>("X_scale", 1.f)),
+        X_zero_point_(
+            OperatorBase::GetSingleArgument<int>("X_zero_point", 0)) {}
+  bool RunOnDevice() override;
+
+ private:
+  float X_scale_;
+  int X_zero_point_;
+};
+
+// Max or average pooling of uint8 values, 2D or 3D NCHW. Both keep the
+// scale and zero point of the input, averages are rounded to nearest.
+template <bool kMax>
+class Int8PoolOp final : public ConvPoolOpBase<CPUContext> {
+ public:
+  USE_CONV_POOL_BASE_FUNCTIONS(CPUContext);
+  Int8PoolOp(const OperatorDef& operator_def, Workspace* ws)
+      : ConvPoolOpBase<CPUContext>(operator_def, ws) {
+    OPERATOR_NEEDS_FEATURE(
+        order_ == StorageOrder::NCHW, "Only NCHW order supported.");
+    CAFFE_ENFORCE(
+        kernel_.size() == 2 || kernel_.size() == 3,
+        "Int8 pooling takes 2D and 3D windows");
+  }
+  bool RunOnDeviceWithOrderNCHW() override;
+  bool RunOnDeviceWithOrderNHWC() override {
+    CAFFE_NOT_IMPLEMENTED;
+  }
+};
+
+// Y = Q(A_scale * (A - A_zero_point) + B_scale * (B - B_zero_point)), after
+// an optional ReLU: the residual sum of a bottleneck block
+class Int8SumReluOp final : public Operator<CPUContext> {
+ public:
+  USE_OPERATOR_FUNCTIONS(CPUContext);
+  Int8SumReluOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws),
+        A_scale_(OperatorBase::GetSingleArgument<float>("A_scale", 1.f)),
+        A_zero_point_(
+            OperatorBase::GetSingleArgument<int>("A_zero_point", 0)),
+        B_scale_(OperatorBase::GetSingleArgument<float>("B_scale", 1.f)),
+        B_zero_point_(
+            OperatorBase::GetSingleArgument<int>("B_zero_point", 0)),
+        Y_scale_(OperatorBase::GetSingleArgument<float>("Y_scale", 1.f)),
+        Y_zero_point_(
+            OperatorBase::GetSingleArgument<int>("Y_zero_point", 0)),
+        relu_(OperatorBase::GetSingleArgument<bool>("relu", false)) {
+    CAFFE_ENFORCE_GT(Y_scale_, 0.f);
+  }
+  bool RunOnDevice() override;
+
+ private:
+  float A_scale_;
+  int A_zero_point_;
+  float B_scale_;
+  int B_zero_point_;
+  float Y_scale_;
+  int Y_zero_point_;
+  bool relu_;
+};
+
+} // namespace caffe2
+
+#endif // INT8_OPS_H_
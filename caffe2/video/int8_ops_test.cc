@@ -0,0 +1,259 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/int8_conv_op.h"
+#include "caffe2/video/int8_ops.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+template <typename T>
+void AddRandomInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<int>& dims,
+    const int low,
+    const int high,
+    const int seed) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> dist(low, high);
+  for (int i = 0; i < tensor->size(); ++i) {
+    tensor->mutable_data<T>()[i] = dist(gen);
+  }
+}
+
+void AddFloatInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<float>& values) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(values.size());
+  std::copy(values.begin(), values.end(), tensor->mutable_data<float>());
+}
+
+void AddArg(OperatorDef* def, const std::string& name, const float value) {
+  auto* arg = def->add_arg();
+  arg->set_name(name);
+  arg->set_f(value);
+}
+
+void AddArg(OperatorDef* def, const std::string& name, const int value) {
+  auto* arg = def->add_arg();
+  arg->set_name(name);
+  arg->set_i(value);
+}
+
+void AddArg(
+    OperatorDef* def,
+    const std::string& name,
+    const std::vector<int>& values) {
+  auto* arg = def->add_arg();
+  arg->set_name(name);
+  for (int value : values) {
+    arg->add_ints(value);
+  }
+}
+
+OperatorDef MakeDef(
+    const std::string& type,
+    const std::vector<std::string>& inputs) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  def.add_output("Y");
+  return def;
+}
+
+const TensorCPU& RunAndGetOutput(Workspace* ws, const OperatorDef& def) {
+  auto op = CreateOperator(def, ws);
+  EXPECT_TRUE(op->Run());
+  return ws->GetBlob("Y")->Get<TensorCPU>();
+}
+
+} // namespace
+
+TEST(Int8OpsTest, QuantizeRoundTrips) {
+  Workspace ws;
+  AddFloatInput(&ws, "X", {-1.f, 0.f, 0.26f, 1.f, 100.f});
+  auto def = MakeDef("Int8Quantize", {"X"});
+  AddArg(&def, "Y_scale", 0.5f);
+  AddArg(&def, "Y_zero_point", 4);
+  const auto& Q = RunAndGetOutput(&ws, def);
+  const std::vector<uint8_t> expected = {2, 4, 5, 6, 204};
+  EXPECT_EQ(
+      std::vector<uint8_t>(Q.data<uint8_t>(), Q.data<uint8_t>() + Q.size()),
+      expected);
+
+  ws.CreateBlob("Q")->GetMutable<TensorCPU>()->CopyFrom(Q);
+  auto dequantize = MakeDef("Int8Dequantize", {"Q"});
+  AddArg(&dequantize, "X_scale", 0.5f);
+  AddArg(&dequantize, "X_zero_point", 4);
+  const auto& Y = RunAndGetOutput(&ws, dequantize);
+  const std::vector<float> values = {-1.f, 0.f, 0.5f, 1.f, 100.f};
+  for (int i = 0; i < Y.size(); ++i) {
+    EXPECT_FLOAT_EQ(Y.data<float>()[i], values[i]);
+  }
+}
+
+// Int8ConvNd against the float convolution of the dequantized values,
+// requantized with the same parameters
+TEST(Int8OpsTest, ConvMatchesFloatReference) {
+  const float X_scale = 0.05f, Y_scale = 0.2f;
+  const int X_zero_point = 10, Y_zero_point = 30;
+  struct Config {
+    std::vector<int> input_dims;
+    std::vector<int> kernels;
+    std::vector<int> strides;
+    std::vector<int> pads;
+    int group;
+  };
+  const std::vector<Config> configs = {
+      {{2, 6, 4, 5, 5}, {3, 3, 3}, {1, 2, 2}, {1, 1, 1, 1, 1, 1}, 1},
+      {{1, 4, 3, 6, 6}, {1, 1, 1}, {1, 1, 1}, {0, 0, 0, 0, 0, 0}, 1},
+      {{1, 4, 5, 4, 4}, {3, 1, 1}, {2, 1, 1}, {1, 0, 0, 1, 0, 0}, 2},
+      {{2, 3, 7, 7}, {3, 3}, {2, 2}, {1, 1, 1, 1}, 1},
+  };
+  for (const auto& config : configs) {
+    for (const bool relu : {false, true}) {
+      Workspace ws;
+      const int M = 6;
+      const int C = config.input_dims[1];
+      std::vector<int> filter_dims = {M, C / config.group};
+      filter_dims.insert(
+          filter_dims.end(), config.kernels.begin(), config.kernels.end());
+      AddRandomInput<uint8_t>(&ws, "X", config.input_dims, 0, 255, 1);
+      AddRandomInput<int8_t>(&ws, "W", filter_dims, -127, 127, 2);
+      std::vector<float> scales(M), bias(M);
+      for (int m = 0; m < M; ++m) {
+        scales[m] = 0.002f * (m + 1);
+        bias[m] = 0.1f * m - 0.2f;
+      }
+      AddFloatInput(&ws, "W_scale", scales);
+      AddFloatInput(&ws, "b", bias);
+      auto def = MakeDef("Int8ConvNd", {"X", "W", "W_scale", "b"});
+      AddArg(&def, "kernels", config.kernels);
+      AddArg(&def, "strides", config.strides);
+      AddArg(&def, "pads", config.pads);
+      AddArg(&def, "group", config.group);
+      AddArg(&def, "X_scale", X_scale);
+      AddArg(&def, "X_zero_point", X_zero_point);
+      AddArg(&def, "Y_scale", Y_scale);
+      AddArg(&def, "Y_zero_point", Y_zero_point);
+      AddArg(&def, "relu", static_cast<int>(relu));
+      const auto& Y = RunAndGetOutput(&ws, def);
+
+      // float reference
+      auto* Xf = ws.CreateBlob("Xf")->GetMutable<TensorCPU>();
+      auto* Wf = ws.CreateBlob("Wf")->GetMutable<TensorCPU>();
+      auto* bf = ws.CreateBlob("bf")->GetMutable<TensorCPU>();
+      const auto& X = ws.GetBlob("X")->Get<TensorCPU>();
+      const auto& W = ws.GetBlob("W")->Get<TensorCPU>();
+      Xf->Resize(X.dims());
+      Wf->Resize(W.dims());
+      bf->Resize(M);
+      for (int i = 0; i < X.size(); ++i) {
+        Xf->mutable_data<float>()[i] =
+            int8::Dequantize(X.data<uint8_t>()[i], X_scale, X_zero_point);
+      }
+      const int K = W.size_from_dim(1);
+      for (int i = 0; i < W.size(); ++i) {
+        Wf->mutable_data<float>()[i] = W.data<int8_t>()[i] * scales[i / K];
+      }
+      std::copy(bias.begin(), bias.end(), bf->mutable_data<float>());
+      auto conv = def;
+      conv.set_type("Conv");
+      conv.set_input(0, "Xf");
+      conv.set_input(1, "Wf");
+      conv.set_input(2, "bf");
+      conv.mutable_input()->RemoveLast();
+      conv.set_output(0, "Yf");
+      ASSERT_TRUE(CreateOperator(conv, &ws)->Run());
+      const auto& Yf = ws.GetBlob("Yf")->Get<TensorCPU>();
+      ASSERT_EQ(Yf.dims(), Y.dims());
+      for (int i = 0; i < Y.size(); ++i) {
+        float value = Yf.data<float>()[i];
+        if (relu) {
+          value = std::max(value, 0.f);
+        }
+        const int expected =
+            int8::Quantize(value, 1.f / Y_scale, Y_zero_point);
+        // float rounding of the two paths can differ at ties
+        EXPECT_NEAR(Y.data<uint8_t>()[i], expected, 1) << i;
+      }
+    }
+  }
+}
+
+TEST(Int8OpsTest, PoolsUint8) {
+  Workspace ws;
+  AddRandomInput<uint8_t>(&ws, "X", {2, 3, 4, 5, 5}, 0, 255, 3);
+  const auto& X = ws.GetBlob("X")->Get<TensorCPU>();
+  auto max_pool = MakeDef("Int8MaxPool", {"X"});
+  AddArg(&max_pool, "kernels", std::vector<int>{1, 3, 3});
+  AddArg(&max_pool, "strides", std::vector<int>{1, 2, 2});
+  AddArg(&max_pool, "pads", std::vector<int>{0, 1, 1, 0, 1, 1});
+  const auto& Y = RunAndGetOutput(&ws, max_pool);
+  ASSERT_EQ(Y.dims(), std::vector<TIndex>({2, 3, 4, 3, 3}));
+  // window (1, 1) of frame 2 of plane 1 covers rows and columns 1..3
+  const uint8_t* x = X.data<uint8_t>() + (1 * 4 + 2) * 25;
+  int expected = 0;
+  for (int h = 1; h <= 3; ++h) {
+    for (int w = 1; w <= 3; ++w) {
+      expected = std::max(expected, static_cast<int>(x[h * 5 + w]));
+    }
+  }
+  EXPECT_EQ(Y.data<uint8_t>()[(1 * 4 + 2) * 9 + 4], expected);
+
+  auto average_pool = MakeDef("Int8AveragePool", {"X"});
+  AddArg(&average_pool, "kernels", std::vector<int>{4, 5, 5});
+  const auto& Z = RunAndGetOutput(&ws, average_pool);
+  ASSERT_EQ(Z.size(), 6);
+  for (int plane = 0; plane < 6; ++plane) {
+    int sum = 0;
+    for (int i = 0; i < 100; ++i) {
+      sum += X.data<uint8_t>()[plane * 100 + i];
+    }
+    EXPECT_EQ(Z.data<uint8_t>()[plane], (sum + 50) / 100);
+  }
+}
+
+TEST(Int8OpsTest, SumsWithOwnScales) {
+  Workspace ws;
+  auto* A = ws.CreateBlob("A")->GetMutable<TensorCPU>();
+  auto* B = ws.CreateBlob("B")->GetMutable<TensorCPU>();
+  A->Resize(3);
+  B->Resize(3);
+  // A = 0.1 * (a - 10): -1, 0, 1; B = 0.2 * (b - 5): 1, -1, 0
+  const uint8_t a[] = {0, 10, 20};
+  const uint8_t b[] = {10, 0, 5};
+  std::copy(a, a + 3, A->mutable_data<uint8_t>());
+  std::copy(b, b + 3, B->mutable_data<uint8_t>());
+  for (const bool relu : {false, true}) {
+    auto def = MakeDef("Int8SumRelu", {"A", "B"});
+    AddArg(&def, "A_scale", 0.1f);
+    AddArg(&def, "A_zero_point", 10);
+    AddArg(&def, "B_scale", 0.2f);
+    AddArg(&def, "B_zero_point", 5);
+    AddArg(&def, "Y_scale", 0.5f);
+    AddArg(&def, "Y_zero_point", 8);
+    AddArg(&def, "relu", static_cast<int>(relu));
+    const auto& Y = RunAndGetOutput(&ws, def);
+    // sums 0, -1, 1
+    const std::vector<uint8_t> expected =
+        relu ? std::vector<uint8_t>{8, 8, 10} : std::vector<uint8_t>{8, 6, 10};
+    EXPECT_EQ(
+        std::vector<uint8_t>(Y.data<uint8_t>(), Y.data<uint8_t>() + 3),
+        expected);
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef INT8_UTILS_H_
+#define INT8_UTILS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace caffe2 {
+namespace int8 {
+
+// The int8 inference ops use uint8 activations with a scale and a zero point
+// per tensor, real = scale * (q - zero_point), given as op arguments by the
+// calibration, and int8 weights with one scale per output channel and no
+// zero point, real = scale[m] * q.
+
+inline uint8_t Saturate(const int value) {
+  return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+// value is in units of the output scale already
+inline uint8_t Requantize(const float value, const int zero_point) {
+  return Saturate(static_cast<int>(std::nearbyint(value)) + zero_point);
+}
+
+inline uint8_t Quantize(
+    const float value,
+    const float inv_scale,
+    const int zero_point) {
+  return Requantize(value * inv_scale, zero_point);
+}
+
+inline float Dequantize(
+    const uint8_t value,
+    const float scale,
+    const int zero_point) {
+  return scale * (static_cast<int>(value) - zero_point);
+}
+
+} // namespace int8
+} // namespace caffe2
+
+#endif // INT8_UTILS_H_
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/local_nonlocal_op.h"
+
+namespace caffe2 {
+
+template <>
+bool LocalNonLocalOp<float, CPUContext>::RunOnDevice() {
+  auto& theta = Input(0);
+  auto& phi = Input(1);
+  auto& g = Input(2);
+  auto* Y = Output(0);
+  auto* lse = Output(1);
+
+  int N, C, Cg;
+  LocalWindow win;
+  LocalNonLocalDims(theta, phi, g, window_, dilation_, &N, &C, &Cg, &win);
+  auto dims = theta.dims();
+  dims[1] = Cg;
+  Y->Resize(dims);
+  lse->Resize(N, theta.size_from_dim(2));
+  LocalNonLocalCPU(
+      N, C, Cg, win, scale_,
+      theta.data<float>(), phi.data<float>(), g.data<float>(),
+      Y->mutable_data<float>(), lse->mutable_data<float>());
+  return true;
+}
+
+template <>
+bool LocalNonLocalGradientOp<float, CPUContext>::RunOnDevice() {
+  auto& theta = Input(0);
+  auto& phi = Input(1);
+  auto& g = Input(2);
+  auto& lse = Input(3);
+  auto& dY = Input(4);
+  auto* dtheta = Output(0);
+  auto* dphi = Output(1);
+  auto* dg = Output(2);
+
+  int N, C, Cg;
+  LocalWindow win;
+  LocalNonLocalDims(theta, phi, g, window_, dilation_, &N, &C, &Cg, &win);
+  CAFFE_ENFORCE_EQ(dY.size(), N * Cg * theta.size_from_dim(2));
+  dtheta->ResizeLike(theta);
+  dphi->ResizeLike(phi);
+  dg->ResizeLike(g);
+  LocalNonLocalGradientCPU(
+      N, C, Cg, win, scale_,
+      theta.data<float>(), phi.data<float>(), g.data<float>(),
+      lse.data<float>(), dY.data<float>(),
+      dtheta->mutable_data<float>(), dphi->mutable_data<float>(),
+      dg->mutable_data<float>());
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(LocalNonLocal, LocalNonLocalOp<float, CPUContext>);
+REGISTER_CPU_OPERATOR(LocalNonLocalGradient,
+                      LocalNonLocalGradientOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(LocalNonLocal)
+    .NumInputs(3)
+    .NumOutputs(2)
+    .SetDoc(R"DOC(
+Computes the aggregation of a windowed non-local block in one op: every
+query position (t, h, w) of theta attends only to the keys of phi and g in a
+window around (t * Tk / T, h * Hk / H, w * Wk / W), the position of the query
+on the grid of the keys, which may be pooled:
+Y[:, q] = g[:, keys(q)] * softmax(scale * theta[:, q]^T * phi[:, keys(q)])^T.
+The keys of a window are window[i] positions dilation[i] apart along every
+axis; the ones outside the grid are left out. Compute and memory grow with
+positions x window instead of positions^2.
+)DOC")
+    .Arg("scale", "(float) scale of the affinity before the softmax")
+    .Arg("window", "(list of 3 odd ints) keys of a window along t, h, w")
+    .Arg("dilation", "(list of 3 ints) steps between the keys, default 1")
+    .Input(0, "theta", "N x C x T x H x W")
+    .Input(1, "phi", "N x C x Tk x Hk x Wk")
+    .Input(2, "g", "N x Cg x Tk x Hk x Wk")
+    .Output(0, "Y", "shape of theta with Cg channels")
+    .Output(1, "lse", "N x (T * H * W) log-sum-exp of the window affinities");
+// Input: theta, phi, g, lse, dY; Output: dtheta, dphi, dg
+OPERATOR_SCHEMA(LocalNonLocalGradient)
+    .NumInputs(5)
+    .NumOutputs(3);
+
+class GetLocalNonLocalGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    return SingleGradientDef(
+        "LocalNonLocalGradient", "",
+        vector<string>{I(0), I(1), I(2), O(1), GO(0)},
+        vector<string>{GI(0), GI(1), GI(2)});
+  }
+};
+
+REGISTER_GRADIENT(LocalNonLocal, GetLocalNonLocalGradient);
+
+} // namespace caffe2
@@ -0,0 +1,310 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <cfloat>
+#include <cub/block/block_reduce.cuh>
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/video/local_nonlocal_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// A block per query and clip: its threads form the affinities of the window
+// keys one key each, then reduce over the window and fold the keys into the
+// channels one channel each.
+constexpr int kThreads = 128;
+using BlockReduce = cub::BlockReduce<float, kThreads>;
+
+// The position of key k of the window of query q, or -1 outside the grid
+// (LocalWindowKeys on the host).
+__device__ int WindowKey(const LocalWindow& win, const int q, const int k) {
+  const int t = q / (win.H * win.W);
+  const int h = q / win.W % win.H;
+  const int w = q % win.W;
+  const int a = k / (win.window[1] * win.window[2]);
+  const int b = k / win.window[2] % win.window[1];
+  const int c = k % win.window[2];
+  const int kt =
+      t * win.Tk / win.T + (a - win.window[0] / 2) * win.dilation[0];
+  const int kh =
+      h * win.Hk / win.H + (b - win.window[1] / 2) * win.dilation[1];
+  const int kw =
+      w * win.Wk / win.W + (c - win.window[2] / 2) * win.dilation[2];
+  if (kt < 0 || kt >= win.Tk || kh < 0 || kh >= win.Hk || kw < 0 ||
+      kw >= win.Wk) {
+    return -1;
+  }
+  return (kt * win.Hk + kh) * win.Wk + kw;
+}
+
+__global__ void LocalNonLocalKernel(
+    const int C,
+    const int Cg,
+    const LocalWindow win,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    float* Y,
+    float* lse) {
+  // the features of the query, the affinities and the keys of the window
+  extern __shared__ float shared[];
+  __shared__ typename BlockReduce::TempStorage reduce_storage;
+  __shared__ float m_sh;
+  __shared__ float l_sh;
+  const int K = win.window[0] * win.window[1] * win.window[2];
+  float* q_sh = shared;
+  float* p_sh = q_sh + C;
+  int* keys_sh = reinterpret_cast<int*>(p_sh + K);
+
+  const int q = blockIdx.x;
+  const int n = blockIdx.y;
+  const int Lq = win.T * win.H * win.W;
+  const int Lk = win.Tk * win.Hk * win.Wk;
+  theta += n * C * Lq;
+  phi += n * C * Lk;
+  g += n * Cg * Lk;
+  Y += n * Cg * Lq;
+
+  for (int c = threadIdx.x; c < C; c += kThreads) {
+    q_sh[c] = theta[c * Lq + q];
+  }
+  __syncthreads();
+  float m = -FLT_MAX;
+  for (int k = threadIdx.x; k < K; k += kThreads) {
+    const int key = WindowKey(win, q, k);
+    keys_sh[k] = key;
+    float s = -FLT_MAX;
+    if (key >= 0) {
+      s = 0.f;
+      for (int c = 0; c < C; ++c) {
+        s += q_sh[c] * phi[c * Lk + key];
+      }
+      s *= scale;
+    }
+    p_sh[k] = s;
+    m = fmaxf(m, s);
+  }
+  m = BlockReduce(reduce_storage).Reduce(m, cub::Max());
+  if (threadIdx.x == 0) {
+    m_sh = m;
+  }
+  __syncthreads();
+  float l = 0.f;
+  for (int k = threadIdx.x; k < K; k += kThreads) {
+    // the keys outside the grid come out as 0
+    const float p = keys_sh[k] >= 0 ? expf(p_sh[k] - m_sh) : 0.f;
+    p_sh[k] = p;
+    l += p;
+  }
+  l = BlockReduce(reduce_storage).Sum(l);
+  if (threadIdx.x == 0) {
+    l_sh = l;
+    lse[n * Lq + q] = m_sh + logf(l);
+  }
+  __syncthreads();
+  for (int c = threadIdx.x; c < Cg; c += kThreads) {
+    float y = 0.f;
+    for (int k = 0; k < K; ++k) {
+      if (keys_sh[k] >= 0) {
+        y += p_sh[k] * g[c * Lk + keys_sh[k]];
+      }
+    }
+    Y[c * Lq + q] = y / l_sh;
+  }
+}
+
+__global__ void LocalNonLocalGradientKernel(
+    const int C,
+    const int Cg,
+    const LocalWindow win,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    const float* lse,
+    const float* dY,
+    float* dtheta,
+    float* dphi,
+    float* dg) {
+  extern __shared__ float shared[];
+  __shared__ typename BlockReduce::TempStorage reduce_storage;
+  __shared__ float d_sh;
+  const int K = win.window[0] * win.window[1] * win.window[2];
+  float* q_sh = shared;
+  float* dy_sh = q_sh + C;
+  float* p_sh = dy_sh + Cg;
+  float* ds_sh = p_sh + K;
+  int* keys_sh = reinterpret_cast<int*>(ds_sh + K);
+
+  const int q = blockIdx.x;
+  const int n = blockIdx.y;
+  const int Lq = win.T * win.H * win.W;
+  const int Lk = win.Tk * win.Hk * win.Wk;
+  theta += n * C * Lq;
+  phi += n * C * Lk;
+  g += n * Cg * Lk;
+  dY += n * Cg * Lq;
+  dtheta += n * C * Lq;
+  dphi += n * C * Lk;
+  dg += n * Cg * Lk;
+
+  for (int c = threadIdx.x; c < C; c += kThreads) {
+    q_sh[c] = theta[c * Lq + q];
+  }
+  for (int c = threadIdx.x; c < Cg; c += kThreads) {
+    dy_sh[c] = dY[c * Lq + q];
+  }
+  __syncthreads();
+  // the softmax again, from the saved log-sum-exp, and dP = dY g^T
+  const float row_lse = lse[n * Lq + q];
+  float d = 0.f;
+  for (int k = threadIdx.x; k < K; k += kThreads) {
+    const int key = WindowKey(win, q, k);
+    keys_sh[k] = key;
+    float p = 0.f;
+    float dp = 0.f;
+    if (key >= 0) {
+      float s = 0.f;
+      for (int c = 0; c < C; ++c) {
+        s += q_sh[c] * phi[c * Lk + key];
+      }
+      p = expf(scale * s - row_lse);
+      for (int c = 0; c < Cg; ++c) {
+        dp += dy_sh[c] * g[c * Lk + key];
+      }
+    }
+    p_sh[k] = p;
+    ds_sh[k] = dp;
+    d += p * dp;
+  }
+  d = BlockReduce(reduce_storage).Sum(d);
+  if (threadIdx.x == 0) {
+    d_sh = d;
+  }
+  __syncthreads();
+  // dS = P .* (dP - rowsum(P .* dP))
+  for (int k = threadIdx.x; k < K; k += kThreads) {
+    ds_sh[k] = p_sh[k] * (ds_sh[k] - d_sh);
+  }
+  __syncthreads();
+  for (int c = threadIdx.x; c < C; c += kThreads) {
+    float dq = 0.f;
+    for (int k = 0; k < K; ++k) {
+      if (keys_sh[k] >= 0) {
+        dq += ds_sh[k] * phi[c * Lk + keys_sh[k]];
+      }
+    }
+    dtheta[c * Lq + q] = scale * dq;
+  }
+  // the keys are shared with the windows of the neighbouring queries
+  for (int i = threadIdx.x; i < C * K; i += kThreads) {
+    const int k = i % K;
+    if (keys_sh[k] >= 0) {
+      atomicAdd(
+          dphi + (i / K) * Lk + keys_sh[k], scale * ds_sh[k] * q_sh[i / K]);
+    }
+  }
+  for (int i = threadIdx.x; i < Cg * K; i += kThreads) {
+    const int k = i % K;
+    if (keys_sh[k] >= 0) {
+      atomicAdd(dg + (i / K) * Lk + keys_sh[k], p_sh[k] * dy_sh[i / K]);
+    }
+  }
+}
+
+} // namespace
+
+template <>
+bool LocalNonLocalOp<float, CUDAContext>::RunOnDevice() {
+  auto& theta = Input(0);
+  auto& phi = Input(1);
+  auto& g = Input(2);
+  auto* Y = Output(0);
+  auto* lse = Output(1);
+
+  int N, C, Cg;
+  LocalWindow win;
+  LocalNonLocalDims(theta, phi, g, window_, dilation_, &N, &C, &Cg, &win);
+  auto dims = theta.dims();
+  dims[1] = Cg;
+  Y->Resize(dims);
+  const int Lq = theta.size_from_dim(2);
+  lse->Resize(N, Lq);
+  LocalNonLocalKernel<<<
+      dim3(Lq, N),
+      kThreads,
+      C * sizeof(float) + win.size() * (sizeof(float) + sizeof(int)),
+      context_.cuda_stream()>>>(
+      C, Cg, win, scale_,
+      theta.data<float>(), phi.data<float>(), g.data<float>(),
+      Y->mutable_data<float>(), lse->mutable_data<float>());
+  return true;
+}
+
+template <>
+bool LocalNonLocalGradientOp<float, CUDAContext>::RunOnDevice() {
+  auto& theta = Input(0);
+  auto& phi = Input(1);
+  auto& g = Input(2);
+  auto& lse = Input(3);
+  auto& dY = Input(4);
+  auto* dtheta = Output(0);
+  auto* dphi = Output(1);
+  auto* dg = Output(2);
+
+  int N, C, Cg;
+  LocalWindow win;
+  LocalNonLocalDims(theta, phi, g, window_, dilation_, &N, &C, &Cg, &win);
+  const int Lq = theta.size_from_dim(2);
+  CAFFE_ENFORCE_EQ(dY.size(), N * Cg * Lq);
+  dtheta->ResizeLike(theta);
+  dphi->ResizeLike(phi);
+  dg->ResizeLike(g);
+  math::Set<float, CUDAContext>(
+      dphi->size(), 0.f, dphi->mutable_data<float>(), &context_);
+  math::Set<float, CUDAContext>(
+      dg->size(), 0.f, dg->mutable_data<float>(), &context_);
+  LocalNonLocalGradientKernel<<<
+      dim3(Lq, N),
+      kThreads,
+      (C + Cg) * sizeof(float) +
+          win.size() * (2 * sizeof(float) + sizeof(int)),
+      context_.cuda_stream()>>>(
+      C, Cg, win, scale_,
+      theta.data<float>(), phi.data<float>(), g.data<float>(),
+      lse.data<float>(), dY.data<float>(),
+      dtheta->mutable_data<float>(), dphi->mutable_data<float>(),
+      dg->mutable_data<float>());
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(LocalNonLocal, LocalNonLocalOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR(
+    LocalNonLocalGradient,
+    LocalNonLocalGradientOp<float, CUDAContext>);
+} // namespace caffe2
@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef LOCAL_NONLOCAL_OP_H_
+#define LOCAL_NONLOCAL_OP_H_
+
+#include <vector>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/video/nonlocal_attention.h"
+
+namespace caffe2 {
+
+// theta is N x C x T x H x W, phi N x C x Tk x Hk x Wk and g
+// N x Cg x Tk x Hk x Wk
+template <class Context>
+void LocalNonLocalDims(
+    const Tensor<Context>& theta,
+    const Tensor<Context>& phi,
+    const Tensor<Context>& g,
+    const std::vector<int>& window,
+    const std::vector<int>& dilation,
+    int* N,
+    int* C,
+    int* Cg,
+    LocalWindow* win) {
+  CAFFE_ENFORCE_EQ(theta.ndim(), 5);
+  CAFFE_ENFORCE_EQ(phi.ndim(), 5);
+  CAFFE_ENFORCE_EQ(g.ndim(), 5);
+  *N = theta.dim32(0);
+  *C = theta.dim32(1);
+  *Cg = g.dim32(1);
+  CAFFE_ENFORCE_EQ(phi.dim32(0), *N);
+  CAFFE_ENFORCE_EQ(g.dim32(0), *N);
+  CAFFE_ENFORCE_EQ(phi.dim32(1), *C, "theta and phi need the same channels");
+  for (int i = 0; i < 3; ++i) {
+    CAFFE_ENFORCE_EQ(
+        g.dim32(i + 2), phi.dim32(i + 2), "phi and g need the same size");
+    win->window[i] = window[i];
+    win->dilation[i] = dilation[i];
+  }
+  win->T = theta.dim32(2);
+  win->H = theta.dim32(3);
+  win->W = theta.dim32(4);
+  win->Tk = phi.dim32(2);
+  win->Hk = phi.dim32(3);
+  win->Wk = phi.dim32(4);
+}
+
+// Windowed non-local block: every query position of theta attends only to
+// the window x dilation keys of phi and g around it (see LocalWindow), so
+// the cost grows linearly with the positions instead of quadratically. The
+// second output keeps the log-sum-exp of the window affinities for the
+// gradient.
+template <typename T, class Context>
+class LocalNonLocalOp final : public Operator<Context> {
+ public:
+  LocalNonLocalOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        scale_(OperatorBase::GetSingleArgument<float>("scale", 1.f)),
+        window_(OperatorBase::GetRepeatedArgument<int>("window")),
+        dilation_(OperatorBase::GetRepeatedArgument<int>(
+            "dilation", std::vector<int>{1, 1, 1})) {
+    CAFFE_ENFORCE_EQ(window_.size(), 3, "window needs [t, h, w]");
+    CAFFE_ENFORCE_EQ(dilation_.size(), 3, "dilation needs [t, h, w]");
+    for (int i = 0; i < 3; ++i) {
+      CAFFE_ENFORCE(
+          window_[i] > 0 && window_[i] % 2 == 1,
+          "the window sizes should be odd");
+      CAFFE_ENFORCE_GT(dilation_[i], 0);
+    }
+  }
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  bool RunOnDevice() override;
+
+ protected:
+  float scale_;
+  std::vector<int> window_;
+  std::vector<int> dilation_;
+};
+
+template <typename T, class Context>
+class LocalNonLocalGradientOp final : public Operator<Context> {
+ public:
+  LocalNonLocalGradientOp(const OperatorDef& def, Workspace* ws)
+      : Operator<Context>(def, ws),
+        scale_(OperatorBase::GetSingleArgument<float>("scale", 1.f)),
+        window_(OperatorBase::GetRepeatedArgument<int>("window")),
+        dilation_(OperatorBase::GetRepeatedArgument<int>(
+            "dilation", std::vector<int>{1, 1, 1})) {
+    CAFFE_ENFORCE_EQ(window_.size(), 3, "window needs [t, h, w]");
+    CAFFE_ENFORCE_EQ(dilation_.size(), 3, "dilation needs [t, h, w]");
+  }
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  bool RunOnDevice() override;
+
+ protected:
+  float scale_;
+  std::vector<int> window_;
+  std::vector<int> dilation_;
+};
+
+} // namespace caffe2
+
+#endif // LOCAL_NONLOCAL_OP_H_
@@ -0,0 +1,183 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <cfloat>
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/video/max_pool_argmax_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// A thread per output
+__global__ void MaxPoolArgmaxKernel(
+    const int num_outputs,
+    const MaxPoolArgmaxGeometry g,
+    const float* X,
+    float* Y,
+    uint8_t* argmax) {
+  CUDA_1D_KERNEL_LOOP(index, num_outputs) {
+    const int ow = index % g.out[2];
+    const int oh = index / g.out[2] % g.out[1];
+    const int ot = index / (g.out[2] * g.out[1]) % g.out[0];
+    const int plane = index / (g.out[2] * g.out[1] * g.out[0]);
+    const float* x = X + plane * g.in[0] * g.in[1] * g.in[2];
+    // the window in the coordinates of X, before the clipping
+    const int t0 = ot * g.stride[0] - g.pad[0];
+    const int h0 = oh * g.stride[1] - g.pad[1];
+    const int w0 = ow * g.stride[2] - g.pad[2];
+    float best = -FLT_MAX;
+    int best_offset = kMaxPoolNoArgmax;
+    for (int kt = max(0, -t0); kt < min(g.kernel[0], g.in[0] - t0); ++kt) {
+      for (int kh = max(0, -h0); kh < min(g.kernel[1], g.in[1] - h0); ++kh) {
+        for (int kw = max(0, -w0); kw < min(g.kernel[2], g.in[2] - w0);
+             ++kw) {
+          const float value =
+              x[((t0 + kt) * g.in[1] + h0 + kh) * g.in[2] + w0 + kw];
+          if (best_offset == kMaxPoolNoArgmax || value > best) {
+            best = value;
+            best_offset = (kt * g.kernel[1] + kh) * g.kernel[2] + kw;
+          }
+        }
+      }
+    }
+    Y[index] = best;
+    argmax[index] = best_offset;
+  }
+}
+
+// A thread per input, which gathers the gradients of the outputs whose
+// windows cover it and whose argmax is it: no atomics, and the sums do not
+// depend on the schedule
+__global__ void MaxPoolArgmaxGradientKernel(
+    const int num_inputs,
+    const MaxPoolArgmaxGeometry g,
+    const uint8_t* argmax,
+    const float* dY,
+    float* dX) {
+  CUDA_1D_KERNEL_LOOP(index, num_inputs) {
+    const int w = index % g.in[2] + g.pad[2];
+    const int h = index / g.in[2] % g.in[1] + g.pad[1];
+    const int t = index / (g.in[2] * g.in[1]) % g.in[0] + g.pad[0];
+    const int plane = index / (g.in[2] * g.in[1] * g.in[0]);
+    const int out_offset = plane * g.out[0] * g.out[1] * g.out[2];
+    const uint8_t* a = argmax + out_offset;
+    const float* dy = dY + out_offset;
+    // the outputs whose windows cover the padded position (t, h, w)
+    const int ot_begin =
+        t < g.kernel[0] ? 0 : (t - g.kernel[0]) / g.stride[0] + 1;
+    const int oh_begin =
+        h < g.kernel[1] ? 0 : (h - g.kernel[1]) / g.stride[1] + 1;
+    const int ow_begin =
+        w < g.kernel[2] ? 0 : (w - g.kernel[2]) / g.stride[2] + 1;
+    const int ot_end = min(t / g.stride[0] + 1, g.out[0]);
+    const int oh_end = min(h / g.stride[1] + 1, g.out[1]);
+    const int ow_end = min(w / g.stride[2] + 1, g.out[2]);
+    float grad = 0.f;
+    for (int ot = ot_begin; ot < ot_end; ++ot) {
+      const int kt = t - ot * g.stride[0];
+      for (int oh = oh_begin; oh < oh_end; ++oh) {
+        const int kh = h - oh * g.stride[1];
+        for (int ow = ow_begin; ow < ow_end; ++ow) {
+          const int kw = w - ow * g.stride[2];
+          const int out = (ot * g.out[1] + oh) * g.out[2] + ow;
+          if (a[out] == (kt * g.kernel[1] + kh) * g.kernel[2] + kw) {
+            grad += dy[out];
+          }
+        }
+      }
+    }
+    dX[index] = grad;
+  }
+}
+
+} // namespace
+
+template <>
+bool MaxPoolArgmaxOp<float, CUDAContext>::RunOnDeviceWithOrderNCHW() {
+  auto& X = Input(0);
+  auto* Y = Output(0);
+  auto* argmax = Output(1);
+  auto* X_dims = OperatorBase::Output<TensorCPU>(2);
+  ConvPoolOpBase<CUDAContext>::SetOutputSize(X, Y, X.dim32(1));
+  argmax->ResizeLike(*Y);
+  X_dims->Resize(X.ndim());
+  std::copy(
+      X.dims().begin(), X.dims().end(), X_dims->mutable_data<TIndex>());
+  const auto g =
+      MakeMaxPoolArgmaxGeometry(X.dims(), Y->dims(), kernel_, stride_, pads_);
+  const int num_outputs = Y->size();
+  if (num_outputs == 0) {
+    return true;
+  }
+  MaxPoolArgmaxKernel<<<
+      CAFFE_GET_BLOCKS(num_outputs),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(
+      num_outputs,
+      g,
+      X.data<float>(),
+      Y->mutable_data<float>(),
+      argmax->mutable_data<uint8_t>());
+  return true;
+}
+
+template <>
+bool MaxPoolArgmaxGradientOp<float, CUDAContext>::RunOnDeviceWithOrderNCHW() {
+  auto& argmax = Input(0);
+  const auto& X_dims = OperatorBase::Input<TensorCPU>(1);
+  auto& dY = Input(2);
+  auto* dX = Output(0);
+  CAFFE_ENFORCE(argmax.dims() == dY.dims());
+  const vector<TIndex> x_dims(
+      X_dims.data<TIndex>(), X_dims.data<TIndex>() + X_dims.size());
+  dX->Resize(x_dims);
+  ConvPoolOpBase<CUDAContext>::ComputePads(
+      vector<int>(x_dims.begin() + 2, x_dims.end()));
+  const auto g =
+      MakeMaxPoolArgmaxGeometry(x_dims, dY.dims(), kernel_, stride_, pads_);
+  const int num_inputs = dX->size();
+  if (num_inputs == 0) {
+    return true;
+  }
+  MaxPoolArgmaxGradientKernel<<<
+      CAFFE_GET_BLOCKS(num_inputs),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(
+      num_inputs,
+      g,
+      argmax.data<uint8_t>(),
+      dY.data<float>(),
+      dX->mutable_data<float>());
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(MaxPoolArgmax, MaxPoolArgmaxOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR(
+    MaxPoolArgmaxGradient,
+    MaxPoolArgmaxGradientOp<float, CUDAContext>);
+} // namespace caffe2
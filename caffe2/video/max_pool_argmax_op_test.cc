@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/video/max_pool_argmax_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// distinct values, so that every window has a single max
+void AddRandomInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<TIndex>& dims,
+    int seed) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  float* data = tensor->mutable_data<float>();
+  std::iota(data, data + tensor->size(), 0.f);
+  std::shuffle(data, data + tensor->size(), std::mt19937(seed));
+}
+
+OperatorDef PoolDef(
+    const std::string& type,
+    const std::vector<std::string>& inputs,
+    const std::vector<std::string>& outputs,
+    const std::vector<int>& kernels,
+    const std::vector<int>& strides,
+    const std::vector<int>& pads) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  for (const auto& output : outputs) {
+    def.add_output(output);
+  }
+  AddArgument("kernels", kernels, &def);
+  AddArgument("strides", strides, &def);
+  AddArgument("pads", pads, &def);
+  AddArgument("order", string("NCHW"), &def);
+  return def;
+}
+
+void RunDef(Workspace* ws, const OperatorDef& def) {
+  auto op = CreateOperator(def, ws);
+  ASSERT_TRUE(op->Run());
+}
+
+void ExpectSameTensors(Workspace* ws, const string& a, const string& b) {
+  const auto& A = ws->GetBlob(a)->Get<TensorCPU>();
+  const auto& B = ws->GetBlob(b)->Get<TensorCPU>();
+  ASSERT_EQ(A.dims(), B.dims());
+  for (int i = 0; i < A.size(); ++i) {
+    EXPECT_EQ(A.data<float>()[i], B.data<float>()[i]) << a << " " << i;
+  }
+}
+
+// MaxPoolArgmax and its gradient against MaxPool and MaxPoolGradient
+void CheckAgainstMaxPool(
+    const std::vector<TIndex>& x_dims,
+    const std::vector<int>& kernels,
+    const std::vector<int>& strides,
+    const std::vector<int>& pads) {
+  Workspace ws;
+  AddRandomInput(&ws, "X", x_dims, 1);
+  RunDef(&ws, PoolDef("MaxPool", {"X"}, {"Y"}, kernels, strides, pads));
+  RunDef(
+      &ws,
+      PoolDef(
+          "MaxPoolArgmax",
+          {"X"},
+          {"Y_argmax", "argmax", "X_dims"},
+          kernels,
+          strides,
+          pads));
+  ExpectSameTensors(&ws, "Y", "Y_argmax");
+
+  const auto& Y = ws.GetBlob("Y")->Get<TensorCPU>();
+  AddRandomInput(&ws, "dY", Y.dims(), 2);
+  RunDef(
+      &ws,
+      PoolDef(
+          "MaxPoolGradient",
+          {"X", "Y", "dY"},
+          {"dX"},
+          kernels,
+          strides,
+          pads));
+  RunDef(
+      &ws,
+      PoolDef(
+          "MaxPoolArgmaxGradient",
+          {"argmax", "X_dims", "dY"},
+          {"dX_argmax"},
+          kernels,
+          strides,
+          pads));
+  ExpectSameTensors(&ws, "dX", "dX_argmax");
+}
+
+} // namespace
+
+// the stem pool of the I3D nets, with overlapping windows
+TEST(MaxPoolArgmaxOpTest, OverlappingWindows3d) {
+  CheckAgainstMaxPool(
+      {2, 3, 4, 9, 9}, {2, 3, 3}, {2, 2, 2}, {0, 1, 1, 0, 1, 1});
+}
+
+// the 1x2x2 pools of the non-local blocks
+TEST(MaxPoolArgmaxOpTest, NonLocalPool) {
+  CheckAgainstMaxPool(
+      {1, 4, 3, 6, 8}, {1, 2, 2}, {1, 2, 2}, {0, 0, 0, 0, 0, 0});
+}
+
+TEST(MaxPoolArgmaxOpTest, Pool2d) {
+  CheckAgainstMaxPool({2, 2, 7, 5}, {3, 3}, {2, 2}, {1, 1, 1, 1});
+}
+
+TEST(MaxPoolArgmaxOpTest, RejectsLargeWindows) {
+  Workspace ws;
+  AddRandomInput(&ws, "X", {1, 1, 8, 8, 8}, 1);
+  auto op = CreateOperator(
+      PoolDef(
+          "MaxPoolArgmax",
+          {"X"},
+          {"Y", "argmax", "X_dims"},
+          {8, 8, 8},
+          {1, 1, 1},
+          {0, 0, 0, 0, 0, 0}),
+      &ws);
+  EXPECT_THROW(op->Run(), EnforceNotMet);
+}
+
+} // namespace caffe2
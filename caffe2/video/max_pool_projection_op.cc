@@ -0,0 +1,169 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/max_pool_projection_op.h"
+
+#include <algorithm>
+#include <climits>
+
+namespace caffe2 {
+
+template <>
+void MaxPoolWindows<CPUContext>(
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const int k,
+    const float* X,
+    float* pooled,
+    uint8_t* argmax,
+    CPUContext* /* context */) {
+  const int Ho = H / k;
+  const int Wo = W / k;
+  for (int ct = 0; ct < C * T; ++ct) {
+    const float* plane = X + ct * H * W;
+    for (int ho = 0; ho < Ho; ++ho) {
+      for (int wo = 0; wo < Wo; ++wo) {
+        int best = 0;
+        float value = plane[ho * k * W + wo * k];
+        for (int i = 0; i < k; ++i) {
+          for (int j = 0; j < k; ++j) {
+            const float v = plane[(ho * k + i) * W + wo * k + j];
+            if (v > value) {
+              value = v;
+              best = i * k + j;
+            }
+          }
+        }
+        const int index = (ct * Ho + ho) * Wo + wo;
+        pooled[index] = value;
+        argmax[index] = best;
+      }
+    }
+  }
+}
+
+template <>
+void GatherPooled<CPUContext>(
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const int k,
+    const float* X,
+    const uint8_t* argmax,
+    float* pooled,
+    CPUContext* /* context */) {
+  const int Ho = H / k;
+  const int Wo = W / k;
+  for (int index = 0; index < C * T * Ho * Wo; ++index) {
+    const int wo = index % Wo;
+    const int ho = index / Wo % Ho;
+    const int ct = index / (Wo * Ho);
+    const int h = ho * k + argmax[index] / k;
+    const int w = wo * k + argmax[index] % k;
+    pooled[index] = X[(ct * H + h) * W + w];
+  }
+}
+
+template <>
+void ScatterPooledGradient<CPUContext>(
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const int k,
+    const uint8_t* argmax,
+    const float* dpooled,
+    float* dX,
+    CPUContext* /* context */) {
+  const int Ho = H / k;
+  const int Wo = W / k;
+  std::fill(dX, dX + C * T * H * W, 0.f);
+  for (int index = 0; index < C * T * Ho * Wo; ++index) {
+    const int wo = index % Wo;
+    const int ho = index / Wo % Ho;
+    const int ct = index / (Wo * Ho);
+    const int h = ho * k + argmax[index] / k;
+    const int w = wo * k + argmax[index] % k;
+    dX[(ct * H + h) * W + w] = dpooled[index];
+  }
+}
+
+REGISTER_CPU_OPERATOR(
+    MaxPoolProjection,
+    MaxPoolProjectionOp<float, CPUContext>);
+REGISTER_CPU_OPERATOR(
+    MaxPoolProjectionGradient,
+    MaxPoolProjectionGradientOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(MaxPoolProjection)
+    .NumInputs(2, INT_MAX)
+    .NumOutputs(2, INT_MAX)
+    .SetDoc(R"DOC(
+Max pooling of X (N x C x T x H x W) over [1, kernel, kernel] windows with
+stride kernel, followed by 1 x 1 x 1 projections of the pooled X, e.g. the
+phi and g convs of a non-local block, in one op:
+Y_i = W_i * maxpool(X) + b_i. The pooled X is never stored: the last output
+keeps the position of the max of every window as a uint8, from which the
+gradient takes the pooled values from X and routes the gradient of the
+pooled X back to X.
+)DOC")
+    .Arg("kernel", "(int) spatial window and stride of the pooling, default 2")
+    .Arg("no_bias", "(int) if 1, the projections have no b_i inputs")
+    .Input(0, "X", "N x C x T x H x W")
+    .Output(0, "Y_0", "N x Cout_0 x T x (H / kernel) x (W / kernel)");
+// Input: X, argmax, W_i..., dY_i...; Output: dX, (dW_i, db_i)...
+OPERATOR_SCHEMA(MaxPoolProjectionGradient)
+    .NumInputs(4, INT_MAX)
+    .NumOutputs(2, INT_MAX);
+
+class GetMaxPoolProjectionGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    const bool no_bias =
+        ArgumentHelper(def_).GetSingleArgument<int>("no_bias", 0);
+    const int step = no_bias ? 1 : 2;
+    const int projections = def_.output_size() - 1;
+    vector<string> inputs{I(0), O(projections)};
+    vector<string> outputs{GI(0)};
+    for (int i = 0; i < projections; ++i) {
+      inputs.push_back(I(1 + i * step));
+      outputs.push_back(GI(1 + i * step));
+      if (!no_bias) {
+        outputs.push_back(GI(2 + i * step));
+      }
+    }
+    for (int i = 0; i < projections; ++i) {
+      inputs.push_back(GO(i));
+    }
+    return SingleGradientDef(
+        "MaxPoolProjectionGradient", "", inputs, outputs);
+  }
+};
+
+REGISTER_GRADIENT(MaxPoolProjection, GetMaxPoolProjectionGradient);
+
+} // namespace caffe2
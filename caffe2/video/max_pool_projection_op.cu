@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/video/max_pool_projection_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+__global__ void MaxPoolWindowsKernel(
+    const int size,
+    const int H,
+    const int W,
+    const int Ho,
+    const int Wo,
+    const int k,
+    const float* X,
+    float* pooled,
+    uint8_t* argmax) {
+  CUDA_1D_KERNEL_LOOP(index, size) {
+    const int wo = index % Wo;
+    const int ho = index / Wo % Ho;
+    const float* plane = X + index / (Wo * Ho) * H * W;
+    int best = 0;
+    float value = plane[ho * k * W + wo * k];
+    for (int i = 0; i < k; ++i) {
+      for (int j = 0; j < k; ++j) {
+        const float v = plane[(ho * k + i) * W + wo * k + j];
+        if (v > value) {
+          value = v;
+          best = i * k + j;
+        }
+      }
+    }
+    pooled[index] = value;
+    argmax[index] = best;
+  }
+}
+
+__global__ void GatherPooledKernel(
+    const int size,
+    const int H,
+    const int W,
+    const int Ho,
+    const int Wo,
+    const int k,
+    const float* X,
+    const uint8_t* argmax,
+    float* pooled) {
+  CUDA_1D_KERNEL_LOOP(index, size) {
+    const int wo = index % Wo;
+    const int ho = index / Wo % Ho;
+    const int ct = index / (Wo * Ho);
+    const int h = ho * k + argmax[index] / k;
+    const int w = wo * k + argmax[index] % k;
+    pooled[index] = X[(ct * H + h) * W + w];
+  }
+}
+
+// one thread per element of dX, so that no two threads write the same one
+__global__ void ScatterPooledGradientKernel(
+    const int size,
+    const int H,
+    const int W,
+    const int Ho,
+    const int Wo,
+    const int k,
+    const uint8_t* argmax,
+    const float* dpooled,
+    float* dX) {
+  CUDA_1D_KERNEL_LOOP(index, size) {
+    const int w = index % W;
+    const int h = index / W % H;
+    const int ct = index / (W * H);
+    const int ho = h / k;
+    const int wo = w / k;
+    float value = 0.f;
+    if (ho < Ho && wo < Wo) {
+      const int pooled_index = (ct * Ho + ho) * Wo + wo;
+      if (argmax[pooled_index] == (h % k) * k + w % k) {
+        value = dpooled[pooled_index];
+      }
+    }
+    dX[index] = value;
+  }
+}
+
+} // namespace
+
+template <>
+void MaxPoolWindows<CUDAContext>(
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const int k,
+    const float* X,
+    float* pooled,
+    uint8_t* argmax,
+    CUDAContext* context) {
+  const int size = C * T * (H / k) * (W / k);
+  MaxPoolWindowsKernel<<<
+      CAFFE_GET_BLOCKS(size),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(
+      size, H, W, H / k, W / k, k, X, pooled, argmax);
+}
+
+template <>
+void GatherPooled<CUDAContext>(
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const int k,
+    const float* X,
+    const uint8_t* argmax,
+    float* pooled,
+    CUDAContext* context) {
+  const int size = C * T * (H / k) * (W / k);
+  GatherPooledKernel<<<
+      CAFFE_GET_BLOCKS(size),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(
+      size, H, W, H / k, W / k, k, X, argmax, pooled);
+}
+
+template <>
+void ScatterPooledGradient<CUDAContext>(
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const int k,
+    const uint8_t* argmax,
+    const float* dpooled,
+    float* dX,
+    CUDAContext* context) {
+  const int size = C * T * H * W;
+  ScatterPooledGradientKernel<<<
+      CAFFE_GET_BLOCKS(size),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(
+      size, H, W, H / k, W / k, k, argmax, dpooled, dX);
+}
+
+REGISTER_CUDA_OPERATOR(
+    MaxPoolProjection,
+    MaxPoolProjectionOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR(
+    MaxPoolProjectionGradient,
+    MaxPoolProjectionGradientOp<float, CUDAContext>);
+} // namespace caffe2
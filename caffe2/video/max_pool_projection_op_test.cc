@@ -0,0 +1,172 @@
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/max_pool_projection_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// two projections of a 2 x 3 x 2 x 5 x 4 input, pooled to 2 x 2 x 2
+constexpr int kN = 2;
+constexpr int kC = 3;
+constexpr int kT = 2;
+constexpr int kH = 5;
+constexpr int kW = 4;
+constexpr int kL = kT * (kH / 2) * (kW / 2);
+const std::vector<int> kCout = {4, 2};
+
+void AddRandomInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<int>& dims,
+    const int seed) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  for (int i = 0; i < tensor->size(); ++i) {
+    tensor->mutable_data<float>()[i] = dist(gen);
+  }
+}
+
+void AddInputs(Workspace* ws) {
+  AddRandomInput(ws, "X", {kN, kC, kT, kH, kW}, 1);
+  for (int i = 0; i < kCout.size(); ++i) {
+    AddRandomInput(ws, "W" + caffe2::to_string(i), {kCout[i], kC, 1, 1, 1},
+                   2 + i);
+    AddRandomInput(ws, "b" + caffe2::to_string(i), {kCout[i]}, 4 + i);
+  }
+}
+
+OperatorDef ProjectionDef() {
+  OperatorDef def;
+  def.set_type("MaxPoolProjection");
+  def.add_input("X");
+  for (int i = 0; i < kCout.size(); ++i) {
+    def.add_input("W" + caffe2::to_string(i));
+    def.add_input("b" + caffe2::to_string(i));
+    def.add_output("Y" + caffe2::to_string(i));
+  }
+  def.add_output("argmax");
+  return def;
+}
+
+using Inputs = std::map<std::string, std::vector<double>>;
+
+Inputs ReadInputs(Workspace* ws) {
+  Inputs inputs;
+  for (const std::string name : {"X", "W0", "b0", "W1", "b1"}) {
+    const auto& tensor = ws->GetBlob(name)->Get<TensorCPU>();
+    inputs[name].assign(
+        tensor.data<float>(), tensor.data<float>() + tensor.size());
+  }
+  return inputs;
+}
+
+// Y_i of the MaxPool and the 1x1x1 conv, in double
+std::vector<double> ReferenceProjection(const Inputs& inputs, const int i) {
+  const auto& x = inputs.at("X");
+  const auto& w = inputs.at("W" + caffe2::to_string(i));
+  const auto& b = inputs.at("b" + caffe2::to_string(i));
+  const int Cout = kCout[i];
+  std::vector<double> y(kN * Cout * kL);
+  for (int n = 0; n < kN; ++n) {
+    for (int l = 0; l < kL; ++l) {
+      const int t = l / 4, ho = l / 2 % 2, wo = l % 2;
+      for (int o = 0; o < Cout; ++o) {
+        double sum = b[o];
+        for (int c = 0; c < kC; ++c) {
+          double m = -1e30;
+          for (int h = 2 * ho; h < 2 * ho + 2; ++h) {
+            for (int v = 2 * wo; v < 2 * wo + 2; ++v) {
+              m = std::max(m, x[(((n * kC + c) * kT + t) * kH + h) * kW + v]);
+            }
+          }
+          sum += w[o * kC + c] * m;
+        }
+        y[(n * Cout + o) * kL + l] = sum;
+      }
+    }
+  }
+  return y;
+}
+
+} // namespace
+
+TEST(MaxPoolProjectionOpTest, MatchesMaxPoolAndConvs) {
+  Workspace ws;
+  AddInputs(&ws);
+  auto op = CreateOperator(ProjectionDef(), &ws);
+  ASSERT_TRUE(op->Run());
+  const auto inputs = ReadInputs(&ws);
+  for (int i = 0; i < kCout.size(); ++i) {
+    const auto& Y = ws.GetBlob("Y" + caffe2::to_string(i))->Get<TensorCPU>();
+    EXPECT_EQ(Y.dims(), (std::vector<TIndex>{kN, kCout[i], kT, 2, 2}));
+    const auto expected = ReferenceProjection(inputs, i);
+    for (int j = 0; j < Y.size(); ++j) {
+      EXPECT_NEAR(Y.data<float>()[j], expected[j], 1e-5) << i << " " << j;
+    }
+  }
+  const auto& argmax = ws.GetBlob("argmax")->Get<TensorCPU>();
+  EXPECT_EQ(argmax.dims(), (std::vector<TIndex>{kN, kC, kT, 2, 2}));
+}
+
+TEST(MaxPoolProjectionOpTest, GradientMatchesFiniteDifferences) {
+  Workspace ws;
+  AddInputs(&ws);
+  const auto def = ProjectionDef();
+  ASSERT_TRUE(CreateOperator(def, &ws)->Run());
+  // loss = sum_i sum(Y_i .* dY_i)
+  vector<GradientWrapper> output_grads;
+  for (int i = 0; i < kCout.size(); ++i) {
+    const string name = "Y" + caffe2::to_string(i) + "_grad";
+    AddRandomInput(&ws, name, {kN, kCout[i], kT, 2, 2}, 6 + i);
+    GradientWrapper grad;
+    grad.dense_ = name;
+    output_grads.push_back(grad);
+  }
+  output_grads.push_back(GradientWrapper());
+  const auto meta = GetGradientForOp(def, output_grads);
+  ASSERT_EQ(meta.ops_.size(), 1);
+  ASSERT_TRUE(CreateOperator(meta.ops_[0], &ws)->Run());
+
+  auto inputs = ReadInputs(&ws);
+  auto loss = [&]() {
+    double sum = 0;
+    for (int i = 0; i < kCout.size(); ++i) {
+      const auto y = ReferenceProjection(inputs, i);
+      const float* dy = ws.GetBlob("Y" + caffe2::to_string(i) + "_grad")
+                            ->Get<TensorCPU>()
+                            .data<float>();
+      for (int j = 0; j < y.size(); ++j) {
+        sum += y[j] * dy[j];
+      }
+    }
+    return sum;
+  };
+  const double h = 1e-5;
+  for (const std::string name : {"X", "W0", "b0", "W1", "b1"}) {
+    auto& input = inputs[name];
+    const auto& grad = ws.GetBlob(name + "_grad")->Get<TensorCPU>();
+    ASSERT_EQ(grad.size(), input.size()) << name;
+    for (int j = 0; j < input.size(); ++j) {
+      const double v = input[j];
+      input[j] = v + h;
+      const double up = loss();
+      input[j] = v - h;
+      const double down = loss();
+      input[j] = v;
+      const double numeric = (up - down) / (2 * h);
+      EXPECT_NEAR(grad.data<float>()[j], numeric, 1e-3) << name << " " << j;
+    }
+  }
+}
+
+} // namespace caffe2
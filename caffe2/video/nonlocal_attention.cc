@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/nonlocal_attention.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+namespace {
+
+// A N x C x L blob is, per n, a column-major L x C matrix: row i holds the
+// C features of position i
+using RowBlock = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic>;
+
+} // namespace
+
+void NonLocalAttentionCPU(
+    const int N,
+    const int C,
+    const int Cg,
+    const int Lq,
+    const int Lk,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    float* Y,
+    float* lse,
+    const int query_block) {
+  RowBlock S;
+  for (int n = 0; n < N; ++n) {
+    ConstEigenMatrixMap<float> Q(theta + n * C * Lq, Lq, C);
+    ConstEigenMatrixMap<float> K(phi + n * C * Lk, Lk, C);
+    ConstEigenMatrixMap<float> V(g + n * Cg * Lk, Lk, Cg);
+    EigenMatrixMap<float> O(Y + n * Cg * Lq, Lq, Cg);
+    for (int i0 = 0; i0 < Lq; i0 += query_block) {
+      const int rows = std::min(query_block, Lq - i0);
+      S.noalias() = scale * Q.middleRows(i0, rows) * K.transpose();
+      for (int r = 0; r < rows; ++r) {
+        const float m = S.row(r).maxCoeff();
+        S.row(r) = (S.row(r).array() - m).exp().matrix();
+        const float l = S.row(r).sum();
+        S.row(r) /= l;
+        lse[n * Lq + i0 + r] = m + std::log(l);
+      }
+      O.middleRows(i0, rows).noalias() = S * V;
+    }
+  }
+}
+
+void NonLocalAttentionGradientCPU(
+    const int N,
+    const int C,
+    const int Cg,
+    const int Lq,
+    const int Lk,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    const float* Y,
+    const float* lse,
+    const float* dY,
+    float* dtheta,
+    float* dphi,
+    float* dg,
+    const int query_block) {
+  RowBlock P;
+  RowBlock dS;
+  for (int n = 0; n < N; ++n) {
+    ConstEigenMatrixMap<float> Q(theta + n * C * Lq, Lq, C);
+    ConstEigenMatrixMap<float> K(phi + n * C * Lk, Lk, C);
+    ConstEigenMatrixMap<float> V(g + n * Cg * Lk, Lk, Cg);
+    ConstEigenMatrixMap<float> O(Y + n * Cg * Lq, Lq, Cg);
+    ConstEigenMatrixMap<float> dO(dY + n * Cg * Lq, Lq, Cg);
+    EigenMatrixMap<float> dQ(dtheta + n * C * Lq, Lq, C);
+    EigenMatrixMap<float> dK(dphi + n * C * Lk, Lk, C);
+    EigenMatrixMap<float> dV(dg + n * Cg * Lk, Lk, Cg);
+    dK.setZero();
+    dV.setZero();
+    for (int i0 = 0; i0 < Lq; i0 += query_block) {
+      const int rows = std::min(query_block, Lq - i0);
+      // the softmax of the block again, from the saved log-sum-exp
+      P.noalias() = scale * Q.middleRows(i0, rows) * K.transpose();
+      for (int r = 0; r < rows; ++r) {
+        P.row(r) =
+            (P.row(r).array() - lse[n * Lq + i0 + r]).exp().matrix();
+      }
+      // dS = P .* (dY g^T - rowsum(dY .* Y))
+      dS.noalias() = dO.middleRows(i0, rows) * V.transpose();
+      for (int r = 0; r < rows; ++r) {
+        const float d = dO.row(i0 + r).dot(O.row(i0 + r));
+        dS.row(r) = (P.row(r).array() * (dS.row(r).array() - d)).matrix();
+      }
+      dQ.middleRows(i0, rows).noalias() = scale * dS * K;
+      dK.noalias() += scale * dS.transpose() * Q.middleRows(i0, rows);
+      dV.noalias() += P.transpose() * dO.middleRows(i0, rows);
+    }
+  }
+}
+
+int LocalWindowKeys(const LocalWindow& win, int t, int h, int w, int* keys) {
+  const int ct = t * win.Tk / win.T;
+  const int ch = h * win.Hk / win.H;
+  const int cw = w * win.Wk / win.W;
+  int count = 0;
+  for (int a = 0; a < win.window[0]; ++a) {
+    const int kt = ct + (a - win.window[0] / 2) * win.dilation[0];
+    if (kt < 0 || kt >= win.Tk) {
+      continue;
+    }
+    for (int b = 0; b < win.window[1]; ++b) {
+      const int kh = ch + (b - win.window[1] / 2) * win.dilation[1];
+      if (kh < 0 || kh >= win.Hk) {
+        continue;
+      }
+      for (int c = 0; c < win.window[2]; ++c) {
+        const int kw = cw + (c - win.window[2] / 2) * win.dilation[2];
+        if (kw >= 0 && kw < win.Wk) {
+          keys[count++] = (kt * win.Hk + kh) * win.Wk + kw;
+        }
+      }
+    }
+  }
+  return count;
+}
+
+void LocalNonLocalCPU(
+    const int N,
+    const int C,
+    const int Cg,
+    const LocalWindow& win,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    float* Y,
+    float* lse) {
+  const int Lq = win.T * win.H * win.W;
+  const int Lk = win.Tk * win.Hk * win.Wk;
+  std::vector<int> keys(win.size());
+  std::vector<float> p(win.size());
+  for (int n = 0; n < N; ++n) {
+    const float* theta_n = theta + n * C * Lq;
+    const float* phi_n = phi + n * C * Lk;
+    const float* g_n = g + n * Cg * Lk;
+    float* Y_n = Y + n * Cg * Lq;
+    for (int q = 0; q < Lq; ++q) {
+      const int count = LocalWindowKeys(
+          win, q / (win.H * win.W), q / win.W % win.H, q % win.W,
+          keys.data());
+      float m = -std::numeric_limits<float>::max();
+      for (int k = 0; k < count; ++k) {
+        float s = 0;
+        for (int c = 0; c < C; ++c) {
+          s += theta_n[c * Lq + q] * phi_n[c * Lk + keys[k]];
+        }
+        p[k] = scale * s;
+        m = std::max(m, p[k]);
+      }
+      float l = 0;
+      for (int k = 0; k < count; ++k) {
+        p[k] = std::exp(p[k] - m);
+        l += p[k];
+      }
+      for (int c = 0; c < Cg; ++c) {
+        float y = 0;
+        for (int k = 0; k < count; ++k) {
+          y += p[k] * g_n[c * Lk + keys[k]];
+        }
+        Y_n[c * Lq + q] = y / l;
+      }
+      lse[n * Lq + q] = m + std::log(l);
+    }
+  }
+}
+
+void LocalNonLocalGradientCPU(
+    const int N,
+    const int C,
+    const int Cg,
+    const LocalWindow& win,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    const float* lse,
+    const float* dY,
+    float* dtheta,
+    float* dphi,
+    float* dg) {
+  const int Lq = win.T * win.H * win.W;
+  const int Lk = win.Tk * win.Hk * win.Wk;
+  std::vector<int> keys(win.size());
+  std::vector<float> p(win.size());
+  std::vector<float> dS(win.size());
+  std::fill(dphi, dphi + N * C * Lk, 0.f);
+  std::fill(dg, dg + N * Cg * Lk, 0.f);
+  for (int n = 0; n < N; ++n) {
+    const float* theta_n = theta + n * C * Lq;
+    const float* phi_n = phi + n * C * Lk;
+    const float* g_n = g + n * Cg * Lk;
+    const float* dY_n = dY + n * Cg * Lq;
+    float* dtheta_n = dtheta + n * C * Lq;
+    float* dphi_n = dphi + n * C * Lk;
+    float* dg_n = dg + n * Cg * Lk;
+    for (int q = 0; q < Lq; ++q) {
+      const int count = LocalWindowKeys(
+          win, q / (win.H * win.W), q / win.W % win.H, q % win.W,
+          keys.data());
+      // the softmax again, from the saved log-sum-exp, and
+      // dS = P .* (dY g^T - rowsum(P .* dY g^T))
+      float d = 0;
+      for (int k = 0; k < count; ++k) {
+        float s = 0;
+        for (int c = 0; c < C; ++c) {
+          s += theta_n[c * Lq + q] * phi_n[c * Lk + keys[k]];
+        }
+        p[k] = std::exp(scale * s - lse[n * Lq + q]);
+        float dp = 0;
+        for (int c = 0; c < Cg; ++c) {
+          dp += dY_n[c * Lq + q] * g_n[c * Lk + keys[k]];
+        }
+        dS[k] = dp;
+        d += p[k] * dp;
+      }
+      for (int k = 0; k < count; ++k) {
+        dS[k] = p[k] * (dS[k] - d);
+      }
+      for (int c = 0; c < C; ++c) {
+        float dq = 0;
+        for (int k = 0; k < count; ++k) {
+          dq += dS[k] * phi_n[c * Lk + keys[k]];
+          dphi_n[c * Lk + keys[k]] += scale * dS[k] * theta_n[c * Lq + q];
+        }
+        dtheta_n[c * Lq + q] = scale * dq;
+      }
+      for (int c = 0; c < Cg; ++c) {
+        for (int k = 0; k < count; ++k) {
+          dg_n[c * Lk + keys[k]] += p[k] * dY_n[c * Lq + q];
+        }
+      }
+    }
+  }
+}
+
+} // namespace caffe2
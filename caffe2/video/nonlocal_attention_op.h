@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef NONLOCAL_ATTENTION_OP_H_
+#define NONLOCAL_ATTENTION_OP_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// theta is N x C x (query positions), phi N x C x (key positions) and g
+// N x Cg x (key positions); the positions may span several dims (T x H x W)
+template <class Context>
+void NonLocalAttentionDims(
+    const Tensor<Context>& theta,
+    const Tensor<Context>& phi,
+    const Tensor<Context>& g,
+    int* N,
+    int* C,
+    int* Cg,
+    int* Lq,
+    int* Lk) {
+  CAFFE_ENFORCE_GE(theta.ndim(), 3);
+  CAFFE_ENFORCE_GE(phi.ndim(), 3);
+  CAFFE_ENFORCE_GE(g.ndim(), 3);
+  *N = theta.dim32(0);
+  *C = theta.dim32(1);
+  *Cg = g.dim32(1);
+  *Lq = theta.size_from_dim(2);
+  *Lk = phi.size_from_dim(2);
+  CAFFE_ENFORCE_EQ(phi.dim32(0), *N);
+  CAFFE_ENFORCE_EQ(g.dim32(0), *N);
+  CAFFE_ENFORCE_EQ(phi.dim32(1), *C, "theta and phi need the same channels");
+  CAFFE_ENFORCE_EQ(g.size_from_dim(2), *Lk, "phi and g need the same size");
+}
+
+// Fused non-local block: Y = g * softmax(scale * theta^T * phi)^T over the
+// flattened positions, with the shape of theta but Cg channels. The
+// affinity is formed block by block and never stored; the second output
+// keeps the log-sum-exp of its rows for the gradient.
+// With affinity_tile > 0 the affinity of that many queries at a time is
+// formed with GEMMs in a tile x keys workspace instead of a fused kernel,
+// and the gradient recomputes the tiles the same way.
+template <typename T, class Context>
+class NonLocalAttentionOp final : public Operator<Context> {
+ public:
+  NonLocalAttentionOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        scale_(OperatorBase::GetSingleArgument<float>("scale", 1.f)),
+        affinity_tile_(
+            OperatorBase::GetSingleArgument<int>("affinity_tile", 0)) {}
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  bool RunOnDevice() override;
+
+ protected:
+  float scale_;
+  int affinity_tile_;
+  Tensor<Context> affinity_;
+};
+
+template <typename T, class Context>
+class NonLocalAttentionGradientOp final : public Operator<Context> {
+ public:
+  NonLocalAttentionGradientOp(const OperatorDef& def, Workspace* ws)
+      : Operator<Context>(def, ws),
+        scale_(OperatorBase::GetSingleArgument<float>("scale", 1.f)),
+        affinity_tile_(
+            OperatorBase::GetSingleArgument<int>("affinity_tile", 0)) {}
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  bool RunOnDevice() override;
+
+ protected:
+  float scale_;
+  int affinity_tile_;
+  // rowsum(dY .* Y) of every query position
+  Tensor<Context> dy_dot_y_;
+  // the recomputed affinity tile and its gradient
+  Tensor<Context> affinity_;
+  Tensor<Context> affinity_grad_;
+};
+
+} // namespace caffe2
+
+#endif // NONLOCAL_ATTENTION_OP_H_
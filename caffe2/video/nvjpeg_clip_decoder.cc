@@ -0,0 +1,46 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/nvjpeg_clip_decoder.h"
+
+namespace caffe2 {
+
+template <>
+std::shared_ptr<NvJpegClipDecoder> CreateNvJpegClipDecoder<CPUContext>(
+    const DeviceOption& /* option */) {
+  CAFFE_THROW("use_nvjpeg decodes the frames on the GPU, it needs the CUDA op.");
+}
+
+template <>
+void DecodeJpegClipsOnGPU<CPUContext>(
+    NvJpegClipDecoder* /* decoder */,
+    const JpegClipBatch& /* batch */,
+    const int /* length */,
+    const int /* crop */,
+    TensorCPU* /* clips */,
+    CPUContext* /* context */) {
+  CAFFE_THROW("use_nvjpeg decodes the frames on the GPU, it needs the CUDA op.");
+}
+
+} // namespace caffe2
@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/common_gpu.h"
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/core/macros.h"
+#include "caffe2/video/nvjpeg_clip_decoder.h"
+
+#ifdef CAFFE2_USE_NVJPEG
+#include <nvjpeg.h>
+#endif
+
+namespace caffe2 {
+
+#ifdef CAFFE2_USE_NVJPEG
+
+#define NVJPEG_ENFORCE(condition)     \
+  do {                                \
+    nvjpegStatus_t status = condition; \
+    CAFFE_ENFORCE_EQ(                 \
+        status,                       \
+        NVJPEG_STATUS_SUCCESS,        \
+        "nvJPEG error at: ",          \
+        __FILE__,                     \
+        ":",                          \
+        __LINE__);                    \
+  } while (0)
+
+struct NvJpegClipDecoder {
+  explicit NvJpegClipDecoder(const DeviceOption& option)
+      : gpu_id(option.cuda_gpu_id()) {
+    DeviceGuard guard(gpu_id);
+    NVJPEG_ENFORCE(nvjpegCreateSimple(&handle));
+    NVJPEG_ENFORCE(nvjpegJpegStateCreate(handle, &state));
+    CUDA_ENFORCE(cudaEventCreateWithFlags(&done, cudaEventDisableTiming));
+  }
+
+  ~NvJpegClipDecoder() {
+    DeviceGuard guard(gpu_id);
+    cudaEventSynchronize(done);
+    cudaEventDestroy(done);
+    nvjpegJpegStateDestroy(state);
+    nvjpegDestroy(handle);
+  }
+
+  const int gpu_id;
+  nvjpegHandle_t handle;
+  nvjpegJpegState_t state;
+  // frames of the batch nvjpegDecodeBatchedInitialize was called for
+  int batch_frames = 0;
+  // the host tables are rewritten once the decode of the last batch, which
+  // copies them, is done
+  cudaEvent_t done;
+  TensorCPU frame_offsets;
+  TensorCPU frame_dims;
+  TensorCUDA frame_offsets_on_device;
+  TensorCUDA frame_dims_on_device;
+  TensorCUDA geometry_on_device;
+  // the decoded planar RGB frames of a batch, each of its own size
+  TensorCUDA frames;
+};
+
+template <>
+std::shared_ptr<NvJpegClipDecoder> CreateNvJpegClipDecoder<CUDAContext>(
+    const DeviceOption& option) {
+  return std::make_shared<NvJpegClipDecoder>(option);
+}
+
+template <>
+void DecodeJpegClipsOnGPU<CUDAContext>(
+    NvJpegClipDecoder* decoder,
+    const JpegClipBatch& batch,
+    const int length,
+    const int crop,
+    TensorCUDA* clips,
+    CUDAContext* context) {
+  const int num_clips = batch.geometry.dim32(0);
+  const int num_frames = num_clips * length;
+  CAFFE_ENFORCE_EQ(batch.offsets.size(), num_frames + 1);
+  CUDA_ENFORCE(cudaEventSynchronize(decoder->done));
+
+  // the size of every frame, and its place in the frame buffer
+  const uint8_t* encoded = batch.encoded.data<uint8_t>();
+  const int64_t* offsets = batch.offsets.data<int64_t>();
+  decoder->frame_offsets.Resize(num_frames);
+  decoder->frame_dims.Resize(num_frames, 2);
+  int64_t* frame_offsets = decoder->frame_offsets.mutable_data<int64_t>();
+  int* frame_dims = decoder->frame_dims.mutable_data<int>();
+  std::vector<const unsigned char*> data(num_frames);
+  std::vector<size_t> lengths(num_frames);
+  int64_t frames_size = 0;
+  for (int i = 0; i < num_frames; ++i) {
+    data[i] = encoded + offsets[i];
+    lengths[i] = offsets[i + 1] - offsets[i];
+    int components;
+    nvjpegChromaSubsampling_t subsampling;
+    int widths[NVJPEG_MAX_COMPONENT];
+    int heights[NVJPEG_MAX_COMPONENT];
+    NVJPEG_ENFORCE(nvjpegGetImageInfo(
+        decoder->handle,
+        data[i],
+        lengths[i],
+        &components,
+        &subsampling,
+        widths,
+        heights));
+    frame_dims[2 * i] = heights[0];
+    frame_dims[2 * i + 1] = widths[0];
+    frame_offsets[i] = frames_size;
+    frames_size += 3LL * heights[0] * widths[0];
+  }
+  decoder->frames.Resize(frames_size);
+  uint8_t* frames = decoder->frames.mutable_data<uint8_t>();
+  std::vector<nvjpegImage_t> destinations(num_frames);
+  for (int i = 0; i < num_frames; ++i) {
+    const int64_t plane_size =
+        static_cast<int64_t>(frame_dims[2 * i]) * frame_dims[2 * i + 1];
+    for (int c = 0; c < 3; ++c) {
+      destinations[i].channel[c] = frames + frame_offsets[i] + c * plane_size;
+      destinations[i].pitch[c] = frame_dims[2 * i + 1];
+    }
+  }
+
+  if (decoder->batch_frames != num_frames) {
+    NVJPEG_ENFORCE(nvjpegDecodeBatchedInitialize(
+        decoder->handle, decoder->state, num_frames, 1, NVJPEG_OUTPUT_RGB));
+    decoder->batch_frames = num_frames;
+  }
+  NVJPEG_ENFORCE(nvjpegDecodeBatched(
+      decoder->handle,
+      decoder->state,
+      data.data(),
+      lengths.data(),
+      destinations.data(),
+      context->cuda_stream()));
+
+  decoder->frame_offsets_on_device.CopyFrom(decoder->frame_offsets, context);
+  decoder->frame_dims_on_device.CopyFrom(decoder->frame_dims, context);
+  decoder->geometry_on_device.CopyFrom(batch.geometry, context);
+  clips->Resize(std::vector<TIndex>{num_clips, 3, length, crop, crop});
+  ScaleCropFramesOnGPU(
+      num_clips,
+      length,
+      crop,
+      frames,
+      decoder->frame_offsets_on_device.data<int64_t>(),
+      decoder->frame_dims_on_device.data<int>(),
+      decoder->geometry_on_device.data<int>(),
+      clips->mutable_data<uint8_t>(),
+      context);
+  CUDA_ENFORCE(cudaEventRecord(decoder->done, context->cuda_stream()));
+}
+
+#else // CAFFE2_USE_NVJPEG
+
+struct NvJpegClipDecoder {};
+
+template <>
+std::shared_ptr<NvJpegClipDecoder> CreateNvJpegClipDecoder<CUDAContext>(
+    const DeviceOption& /* option */) {
+  CAFFE_THROW("use_nvjpeg needs Caffe2 built with USE_NVJPEG.");
+}
+
+template <>
+void DecodeJpegClipsOnGPU<CUDAContext>(
+    NvJpegClipDecoder* /* decoder */,
+    const JpegClipBatch& /* batch */,
+    const int /* length */,
+    const int /* crop */,
+    TensorCUDA* /* clips */,
+    CUDAContext* /* context */) {
+  CAFFE_THROW("use_nvjpeg needs Caffe2 built with USE_NVJPEG.");
+}
+
+#endif // CAFFE2_USE_NVJPEG
+
+} // namespace caffe2
@@ -0,0 +1,103 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <algorithm>
+
+#include "caffe2/video/precise_bn_ops.h"
+
+namespace caffe2 {
+
+template <>
+bool AccumulateBNStatsOp<CPUContext>::Accumulate(
+    const int C,
+    const float* mean,
+    const float* inv_std,
+    float* sums) {
+  for (int c = 0; c < C; ++c) {
+    const float var = 1.f / (inv_std[c] * inv_std[c]) - epsilon_;
+    sums[c] += mean[c];
+    sums[C + c] += var + mean[c] * mean[c];
+  }
+  return true;
+}
+
+template <>
+bool FinalizeBNStatsOp<CPUContext>::Finalize(
+    const int C,
+    const float* sums,
+    float* running_mean,
+    float* running_var) {
+  for (int c = 0; c < C; ++c) {
+    const double mean = static_cast<double>(sums[c]) / count_;
+    const double meansq = static_cast<double>(sums[C + c]) / count_;
+    running_mean[c] = mean;
+    running_var[c] = std::max(meansq - mean * mean, 0.);
+  }
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(AccumulateBNStats, AccumulateBNStatsOp<CPUContext>);
+REGISTER_CPU_OPERATOR(FinalizeBNStats, FinalizeBNStatsOp<CPUContext>);
+
+OPERATOR_SCHEMA(AccumulateBNStats)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .EnforceInplace({{2, 0}})
+    .SetDoc(R"DOC(
+Accumulates the precise BN statistics of a layer on the device of the op:
+adds the batch mean of every channel, and its batch mean of the squares
+computed from the saved inverse std of a training SpatialBN, to the running
+sums. The sums are only started from 0 when their size does not match, so
+the caller resets them, e.g. with a ConstantFill, before a new computation.
+)DOC")
+    .Arg("epsilon", "(float, default 1e-5) the epsilon of the SpatialBN")
+    .Input(0, "saved_mean", "The batch mean of the SpatialBN, size C")
+    .Input(1, "saved_inv_std", "The batch inverse std of the SpatialBN, size C")
+    .Input(2, "sums", "The running sums, updated in place")
+    .Output(
+        0,
+        "sums",
+        "1-D tensor of size 2C: the sums of the means, then of the means of "
+        "the squares");
+OPERATOR_SCHEMA(FinalizeBNStats)
+    .NumInputs(3)
+    .NumOutputs(2)
+    .EnforceInplace({{1, 0}, {2, 1}})
+    .SetDoc(R"DOC(
+Writes the precise BN statistics accumulated by AccumulateBNStats, and summed
+over the devices e.g. by an NCCLAllreduce, to the running mean and variance
+of the layer in place. count is the number of batches in the sums. The
+variance is the biased one, clamped at 0.
+)DOC")
+    .Arg("count", "(int, default 1) number of batches accumulated in the sums")
+    .Input(0, "sums", "The sums of AccumulateBNStats, size 2C")
+    .Input(1, "running_mean", "The running mean of the SpatialBN")
+    .Input(2, "running_var", "The running variance of the SpatialBN")
+    .Output(0, "running_mean", "The precise mean, size C")
+    .Output(1, "running_var", "The precise variance, size C");
+
+SHOULD_NOT_DO_GRADIENT(AccumulateBNStats);
+SHOULD_NOT_DO_GRADIENT(FinalizeBNStats);
+
+} // namespace caffe2
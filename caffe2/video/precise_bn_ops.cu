@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/video/precise_bn_ops.h"
+
+namespace caffe2 {
+
+namespace {
+
+__global__ void AccumulateBNStatsKernel(
+    const int C,
+    const float epsilon,
+    const float* mean,
+    const float* inv_std,
+    float* sums) {
+  CUDA_1D_KERNEL_LOOP(c, C) {
+    const float var = 1.f / (inv_std[c] * inv_std[c]) - epsilon;
+    sums[c] += mean[c];
+    sums[C + c] += var + mean[c] * mean[c];
+  }
+}
+
+__global__ void FinalizeBNStatsKernel(
+    const int C,
+    const double count,
+    const float* sums,
+    float* running_mean,
+    float* running_var) {
+  CUDA_1D_KERNEL_LOOP(c, C) {
+    const double mean = sums[c] / count;
+    const double meansq = sums[C + c] / count;
+    running_mean[c] = mean;
+    running_var[c] = fmax(meansq - mean * mean, 0.);
+  }
+}
+
+} // namespace
+
+template <>
+bool AccumulateBNStatsOp<CUDAContext>::Accumulate(
+    const int C,
+    const float* mean,
+    const float* inv_std,
+    float* sums) {
+  AccumulateBNStatsKernel<<<
+      CAFFE_GET_BLOCKS(C),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(C, epsilon_, mean, inv_std, sums);
+  return true;
+}
+
+template <>
+bool FinalizeBNStatsOp<CUDAContext>::Finalize(
+    const int C,
+    const float* sums,
+    float* running_mean,
+    float* running_var) {
+  FinalizeBNStatsKernel<<<
+      CAFFE_GET_BLOCKS(C),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(C, count_, sums, running_mean, running_var);
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(AccumulateBNStats, AccumulateBNStatsOp<CUDAContext>);
+REGISTER_CUDA_OPERATOR(FinalizeBNStats, FinalizeBNStatsOp<CUDAContext>);
+
+} // namespace caffe2
@@ -0,0 +1,133 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/precise_bn_ops.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+constexpr int kBatches = 3;
+constexpr int kN = 2;
+constexpr int kC = 3;
+constexpr int kInner = 8;
+
+void AddInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<TIndex>& dims,
+    const float offset) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  float* data = tensor->mutable_data<float>();
+  for (int i = 0; i < tensor->size(); ++i) {
+    data[i] = std::sin(i * 1.3f + offset) * (1.f + offset) + offset;
+  }
+}
+
+void RunOp(
+    Workspace* ws,
+    const std::string& type,
+    const std::vector<std::string>& inputs,
+    const std::vector<std::string>& outputs,
+    const std::vector<Argument>& args = {}) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  for (const auto& output : outputs) {
+    def.add_output(output);
+  }
+  for (const auto& arg : args) {
+    def.add_arg()->CopyFrom(arg);
+  }
+  auto op = CreateOperator(def, ws);
+  ASSERT_TRUE(op->Run());
+}
+
+} // namespace
+
+// The statistics accumulated over the training SpatialBNs of equal batches
+// are the mean and biased variance of all the batches together.
+TEST(PreciseBNOpsTest, MatchesStatisticsOfAllBatches) {
+  Workspace ws;
+  AddInput(&ws, "scale", {kC}, 1.f);
+  AddInput(&ws, "bias", {kC}, 2.f);
+  // created empty, like the sums blobs of the bn helper
+  ws.CreateBlob("sums");
+  std::vector<double> sum(kC, 0.);
+  std::vector<double> sumsq(kC, 0.);
+  for (int b = 0; b < kBatches; ++b) {
+    AddInput(&ws, "X", {kN, kC, 2, 2, 2}, b * 0.5f);
+    AddInput(&ws, "rm", {kC}, 0.f);
+    AddInput(&ws, "rv", {kC}, 1.f);
+    RunOp(&ws, "SpatialBN",
+          {"X", "scale", "bias", "rm", "rv"},
+          {"Y", "rm", "rv", "sm", "siv"},
+          {MakeArgument<int>("is_test", 0),
+           MakeArgument<float>("epsilon", 1e-5f)});
+    RunOp(&ws, "AccumulateBNStats", {"sm", "siv", "sums"}, {"sums"},
+          {MakeArgument<float>("epsilon", 1e-5f)});
+    const float* X = ws.GetBlob("X")->Get<TensorCPU>().data<float>();
+    for (int n = 0; n < kN; ++n) {
+      for (int c = 0; c < kC; ++c) {
+        for (int i = 0; i < kInner; ++i) {
+          const double x = X[(n * kC + c) * kInner + i];
+          sum[c] += x;
+          sumsq[c] += x * x;
+        }
+      }
+    }
+  }
+
+  RunOp(&ws, "FinalizeBNStats", {"sums", "rm", "rv"}, {"rm", "rv"},
+        {MakeArgument<int>("count", kBatches)});
+  const auto& rm = ws.GetBlob("rm")->Get<TensorCPU>();
+  const auto& rv = ws.GetBlob("rv")->Get<TensorCPU>();
+  ASSERT_EQ(rm.size(), kC);
+  ASSERT_EQ(rv.size(), kC);
+  const double M = kBatches * kN * kInner;
+  for (int c = 0; c < kC; ++c) {
+    const double mean = sum[c] / M;
+    EXPECT_NEAR(rm.data<float>()[c], mean, 1e-4);
+    EXPECT_NEAR(rv.data<float>()[c], sumsq[c] / M - mean * mean, 1e-3);
+  }
+}
+
+// A size mismatch starts the sums over, finalizing leaves them as they are.
+TEST(PreciseBNOpsTest, RestartsOnSizeMismatch) {
+  Workspace ws;
+  AddInput(&ws, "sums", {7}, 5.f);
+  auto* sm = ws.CreateBlob("sm")->GetMutable<TensorCPU>();
+  auto* siv = ws.CreateBlob("siv")->GetMutable<TensorCPU>();
+  sm->Resize(2);
+  siv->Resize(2);
+  for (int c = 0; c < 2; ++c) {
+    sm->mutable_data<float>()[c] = c + 1.f;
+    siv->mutable_data<float>()[c] = 0.5f;
+  }
+  RunOp(&ws, "AccumulateBNStats", {"sm", "siv", "sums"}, {"sums"},
+        {MakeArgument<float>("epsilon", 0.f)});
+  RunOp(&ws, "AccumulateBNStats", {"sm", "siv", "sums"}, {"sums"},
+        {MakeArgument<float>("epsilon", 0.f)});
+  const auto& sums = ws.GetBlob("sums")->Get<TensorCPU>();
+  ASSERT_EQ(sums.size(), 4);
+  const std::vector<float> expected = {2.f, 4.f, 10.f, 16.f};
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_FLOAT_EQ(sums.data<float>()[i], expected[i]);
+  }
+  AddInput(&ws, "rm", {2}, 0.f);
+  AddInput(&ws, "rv", {2}, 0.f);
+  RunOp(&ws, "FinalizeBNStats", {"sums", "rm", "rv"}, {"rm", "rv"},
+        {MakeArgument<int>("count", 2)});
+  EXPECT_FLOAT_EQ(ws.GetBlob("rm")->Get<TensorCPU>().data<float>()[1], 2.f);
+  EXPECT_FLOAT_EQ(ws.GetBlob("rv")->Get<TensorCPU>().data<float>()[1], 4.f);
+  EXPECT_FLOAT_EQ(ws.GetBlob("sums")->Get<TensorCPU>().data<float>()[3], 16.f);
+}
+
+} // namespace caffe2
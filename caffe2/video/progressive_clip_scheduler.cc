@@ -0,0 +1,234 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/progressive_clip_scheduler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <tuple>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/video/video_record.h"
+
+namespace caffe2 {
+
+std::shared_ptr<ClipScoreBoard> ClipScoreBoard::Get(const std::string& name) {
+  static std::mutex boards_mutex;
+  static std::map<std::string, std::weak_ptr<ClipScoreBoard>> boards;
+  std::lock_guard<std::mutex> lock(boards_mutex);
+  std::shared_ptr<ClipScoreBoard> board = boards[name].lock();
+  if (!board) {
+    board = std::make_shared<ClipScoreBoard>();
+    boards[name] = board;
+  }
+  return board;
+}
+
+bool ClipScoreBoard::Claim(const int video_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Video& video = videos_[video_id];
+  if (video.claimed) {
+    return false;
+  }
+  video.claimed = true;
+  return true;
+}
+
+int ClipScoreBoard::Add(
+    const int video_id,
+    const float* scores,
+    const int size,
+    float* average) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Video& video = videos_[video_id];
+  if (video.finished) {
+    return 0;
+  }
+  if (video.sum.empty()) {
+    video.sum.assign(size, 0.f);
+  }
+  CAFFE_ENFORCE_EQ(video.sum.size(), size, "Clips of different classes");
+  ++video.num_clips;
+  for (int i = 0; i < size; ++i) {
+    video.sum[i] += scores[i];
+    average[i] = video.sum[i] / video.num_clips;
+  }
+  return video.num_clips;
+}
+
+void ClipScoreBoard::Finish(const int video_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  videos_[video_id].finished = true;
+}
+
+bool ClipScoreBoard::IsFinished(const int video_id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto it = videos_.find(video_id);
+  return it != videos_.end() && it->second.finished;
+}
+
+void ClipScoreBoard::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  videos_.clear();
+}
+
+std::vector<int> CoverageOrder(const int n) {
+  std::vector<int> order;
+  std::vector<bool> taken(n, false);
+  // the slot farthest from the slots taken so far, the lowest one of a tie
+  for (int k = 0; k < n; ++k) {
+    int best = -1;
+    int best_distance = -1;
+    for (int slot = 0; slot < n; ++slot) {
+      if (taken[slot]) {
+        continue;
+      }
+      int distance = order.empty() ? n - std::abs(2 * slot - (n - 1)) : n;
+      for (const int other : order) {
+        distance = std::min(distance, std::abs(slot - other));
+      }
+      if (distance > best_distance) {
+        best = slot;
+        best_distance = distance;
+      }
+    }
+    taken[best] = true;
+    order.push_back(best);
+  }
+  return order;
+}
+
+int CropRank(const int spatial_pos) {
+  if (spatial_pos < 0) {
+    return 0;
+  }
+  // spatial_pos % 3 is the left / top, center or right / bottom crop
+  static const int kSideRank[3] = {1, 0, 2};
+  return (spatial_pos / 3) * 3 + kSideRank[spatial_pos % 3];
+}
+
+ProgressiveClipScheduler::ProgressiveClipScheduler(
+    const int views_per_video,
+    const int max_videos,
+    std::shared_ptr<ClipScoreBoard> board)
+    : views_per_video_(views_per_video),
+      max_videos_(max_videos),
+      board_(std::move(board)) {
+  CAFFE_ENFORCE_GT(views_per_video_, 0);
+  CAFFE_ENFORCE_GT(max_videos_, 0);
+  CAFFE_ENFORCE(board_);
+}
+
+void ProgressiveClipScheduler::Next(
+    const int n,
+    const ReadFn& read,
+    std::vector<std::string>* records) {
+  records->assign(n, std::string());
+  int filled = 0;
+  while (filled < n) {
+    while ((int)videos_.size() < max_videos_ && !db_done_) {
+      ReadVideo(read);
+    }
+    if (videos_.empty()) {
+      break;
+    }
+    // one view of every video in turn
+    const int num_videos = videos_.size();
+    for (int i = 0; i < num_videos && filled < n; ++i) {
+      Video video = std::move(videos_.front());
+      videos_.pop_front();
+      if (board_->IsFinished(video.id)) {
+        continue;
+      }
+      (*records)[filled++] = std::move(video.views[video.next++]);
+      if (video.next < video.views.size()) {
+        videos_.push_back(std::move(video));
+      }
+    }
+  }
+}
+
+void ProgressiveClipScheduler::ReadVideo(const ReadFn& read) {
+  std::vector<std::string> values;
+  read(views_per_video_, &values);
+  CAFFE_ENFORCE_EQ(values.size(), views_per_video_);
+
+  TensorProtos protos;
+  // (crop rank, start frame, record) of every view
+  std::vector<std::tuple<int, int, std::string>> views;
+  std::vector<int> start_frms;
+  int id = -1;
+  for (auto& value : values) {
+    VideoRecord record;
+    ParseVideoRecord(value.data(), value.size(), &protos, &record);
+    // test dbs store the index of the video as its label
+    if (views.empty()) {
+      id = record.label(0);
+    }
+    CAFFE_ENFORCE_EQ(
+        record.label(0),
+        id,
+        "A progressive test needs the ",
+        views_per_video_,
+        " views of every video in consecutive records.");
+    CAFFE_ENFORCE_GE(record.start_frm, 0, "The record has no start frame.");
+    start_frms.push_back(record.start_frm);
+    views.emplace_back(
+        CropRank(record.spatial_pos), record.start_frm, std::move(value));
+  }
+  if (!board_->Claim(id)) {
+    // the reader is back at the start of the db
+    db_done_ = true;
+    return;
+  }
+
+  std::sort(start_frms.begin(), start_frms.end());
+  start_frms.erase(
+      std::unique(start_frms.begin(), start_frms.end()), start_frms.end());
+  const std::vector<int> order = CoverageOrder(start_frms.size());
+  std::map<int, int> time_rank;
+  for (int k = 0; k < order.size(); ++k) {
+    time_rank[start_frms[order[k]]] = k;
+  }
+  // all the clip slots of the center crop first
+  std::sort(
+      views.begin(),
+      views.end(),
+      [&time_rank](
+          const std::tuple<int, int, std::string>& a,
+          const std::tuple<int, int, std::string>& b) {
+        return std::make_pair(std::get<0>(a), time_rank[std::get<1>(a)]) <
+            std::make_pair(std::get<0>(b), time_rank[std::get<1>(b)]);
+      });
+  Video video;
+  video.id = id;
+  for (auto& view : views) {
+    video.views.push_back(std::move(std::get<2>(view)));
+  }
+  videos_.push_back(std::move(video));
+}
+
+} // namespace caffe2
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_PROGRESSIVE_CLIP_SCHEDULER_H_
+#define CAFFE2_VIDEO_PROGRESSIVE_CLIP_SCHEDULER_H_
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace caffe2 {
+
+// The running scores of the videos of a progressive test, shared by name
+// between the AccumulateClipScores ops, which add the scores of the tested
+// clips and finish the videos that are confidently classified, and the
+// input ops, which stop scheduling the clips of the finished videos.
+class ClipScoreBoard {
+ public:
+  // the board of name, created on first use and kept as long as anyone
+  // holds it
+  static std::shared_ptr<ClipScoreBoard> Get(const std::string& name);
+
+  // Claims video_id for the input op that has read it. Returns false if it
+  // has been claimed before, i.e. once the reader wraps around the db.
+  bool Claim(int video_id);
+
+  // Adds the scores of a clip of video_id and writes the running average of
+  // its clips to average. Returns the number of clips added so far, or 0
+  // for a clip of a finished video, which is not added.
+  int Add(int video_id, const float* scores, int size, float* average);
+
+  void Finish(int video_id);
+  bool IsFinished(int video_id) const;
+
+  // forget all the videos, for another pass over the db
+  void Clear();
+
+ private:
+  struct Video {
+    std::vector<float> sum;
+    int num_clips = 0;
+    bool claimed = false;
+    bool finished = false;
+  };
+
+  mutable std::mutex mutex_;
+  std::unordered_map<int, Video> videos_;
+};
+
+// Returns 0..n-1 in the order in which the clip slots of a video are tested:
+// every prefix is spread over the video as far as it can, the middle first.
+std::vector<int> CoverageOrder(int n);
+
+// Rank of a spatial crop of the multi-crop test: the center crop first, then
+// the two sides, and the mirrored crops (3..5) after the others.
+int CropRank(int spatial_pos);
+
+// Schedules the test views of a progressive test. The db has one record per
+// view, the views of a video in consecutive records, as written by
+// create_video_lmdb_test_multicrop.py. Up to max_videos videos are tested at
+// once; the scheduler gives each of them one view in turn, in the order of
+// CoverageOrder and CropRank, and drops a video as soon as its board says it
+// is finished, so its remaining views go to the next videos of the db.
+class ProgressiveClipScheduler {
+ public:
+  // reads n records of the db, as one batch of the reader
+  using ReadFn = std::function<void(int n, std::vector<std::string>* values)>;
+
+  ProgressiveClipScheduler(
+      int views_per_video,
+      int max_videos,
+      std::shared_ptr<ClipScoreBoard> board);
+
+  // Fills records with the next n views to decode, reading new videos with
+  // read as needed. Once every video of the db is scheduled the remaining
+  // records are empty, padding that carries no clip.
+  void Next(int n, const ReadFn& read, std::vector<std::string>* records);
+
+  // no more views to schedule
+  bool Exhausted() const {
+    return db_done_ && videos_.empty();
+  }
+
+ private:
+  struct Video {
+    int id;
+    // the records of the views in the order they are tested
+    std::vector<std::string> views;
+    std::size_t next = 0;
+  };
+
+  // reads the views of the next video into videos_, or marks the db done
+  void ReadVideo(const ReadFn& read);
+
+  const int views_per_video_;
+  const int max_videos_;
+  std::shared_ptr<ClipScoreBoard> board_;
+  std::deque<Video> videos_;
+  bool db_done_ = false;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_PROGRESSIVE_CLIP_SCHEDULER_H_
@@ -0,0 +1,162 @@
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "caffe2/proto/caffe2.pb.h"
+#include "caffe2/video/progressive_clip_scheduler.h"
+#include "caffe2/video/video_record.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+const std::string kPath = "/data/video.mp4";
+
+std::string MakeView(const int video_id, const int start_frm, const int pos) {
+  const int32_t labels[] = {video_id};
+  VideoRecord record;
+  record.payload = kPath.data();
+  record.payload_size = kPath.size();
+  record.label_data = reinterpret_cast<const char*>(labels);
+  record.num_labels = 1;
+  record.start_frm = start_frm;
+  record.spatial_pos = pos;
+  record.num_frames = -1;
+  record.key_frame_data = nullptr;
+  record.num_key_frames = 0;
+  return SerializeVideoRecord(record);
+}
+
+// (video id, start frame, spatial pos) of a view, or all -1 for padding
+std::tuple<int, int, int> ParseView(const std::string& value) {
+  if (value.empty()) {
+    return std::make_tuple(-1, -1, -1);
+  }
+  TensorProtos protos;
+  VideoRecord record;
+  ParseVideoRecord(value.data(), value.size(), &protos, &record);
+  return std::make_tuple(record.label(0), record.start_frm, record.spatial_pos);
+}
+
+// a test db of num_videos videos of num_slots x 3 crops, spatial crop major
+// as create_video_lmdb_test_multicrop.py writes them, read in a loop
+class FakeTestDB {
+ public:
+  FakeTestDB(const int num_videos, const int num_slots) {
+    for (int video = 0; video < num_videos; ++video) {
+      for (int pos = 0; pos < 3; ++pos) {
+        for (int slot = 0; slot < num_slots; ++slot) {
+          records_.push_back(MakeView(video, slot, pos));
+        }
+      }
+    }
+  }
+
+  ProgressiveClipScheduler::ReadFn Reader() {
+    return [this](const int n, std::vector<std::string>* values) {
+      values->clear();
+      for (int i = 0; i < n; ++i) {
+        values->push_back(records_[next_]);
+        next_ = (next_ + 1) % records_.size();
+      }
+    };
+  }
+
+ private:
+  std::vector<std::string> records_;
+  std::size_t next_ = 0;
+};
+
+} // namespace
+
+TEST(ProgressiveClipSchedulerTest, CoverageOrder) {
+  EXPECT_EQ(CoverageOrder(1), std::vector<int>({0}));
+  EXPECT_EQ(CoverageOrder(3), std::vector<int>({1, 0, 2}));
+  // the middle, the ends, then the gaps between them
+  EXPECT_EQ(CoverageOrder(10), std::vector<int>({4, 9, 0, 2, 6, 1, 3, 5, 7, 8}));
+  EXPECT_EQ(CropRank(1), 0);
+  EXPECT_EQ(CropRank(0), 1);
+  EXPECT_EQ(CropRank(2), 2);
+  EXPECT_EQ(CropRank(4), 3);
+  EXPECT_EQ(CropRank(-1), 0);
+}
+
+TEST(ProgressiveClipSchedulerTest, SchedulesByCoverage) {
+  FakeTestDB db(1, 3);
+  auto board = ClipScoreBoard::Get("SchedulesByCoverage");
+  ProgressiveClipScheduler scheduler(9, 1, board);
+  std::vector<std::string> records;
+  scheduler.Next(9, db.Reader(), &records);
+  std::vector<std::tuple<int, int, int>> views;
+  for (const auto& record : records) {
+    views.push_back(ParseView(record));
+  }
+  // the center crop of all the slots first, then the sides
+  const std::vector<std::tuple<int, int, int>> expected = {
+      std::make_tuple(0, 1, 1),
+      std::make_tuple(0, 0, 1),
+      std::make_tuple(0, 2, 1),
+      std::make_tuple(0, 1, 0),
+      std::make_tuple(0, 0, 0),
+      std::make_tuple(0, 2, 0),
+      std::make_tuple(0, 1, 2),
+      std::make_tuple(0, 0, 2),
+      std::make_tuple(0, 2, 2)};
+  EXPECT_EQ(views, expected);
+}
+
+TEST(ProgressiveClipSchedulerTest, SkipsFinishedVideos) {
+  FakeTestDB db(3, 2);
+  auto board = ClipScoreBoard::Get("SkipsFinishedVideos");
+  ProgressiveClipScheduler scheduler(6, 2, board);
+  const auto reader = db.Reader();
+  std::vector<std::string> records;
+
+  // one view of each of the first two videos
+  scheduler.Next(2, reader, &records);
+  EXPECT_EQ(std::get<0>(ParseView(records[0])), 0);
+  EXPECT_EQ(std::get<0>(ParseView(records[1])), 1);
+
+  // the views of video 0 go to the others
+  board->Finish(0);
+  int num_views = 0;
+  while (!scheduler.Exhausted()) {
+    scheduler.Next(2, reader, &records);
+    for (const auto& record : records) {
+      const int video_id = std::get<0>(ParseView(record));
+      EXPECT_NE(video_id, 0);
+      num_views += video_id >= 0;
+    }
+  }
+  // all the views of videos 1 and 2, without the first one of video 1
+  EXPECT_EQ(num_views, 11);
+
+  // padding once the reader is back at the start of the db
+  scheduler.Next(2, reader, &records);
+  EXPECT_EQ(records, std::vector<std::string>(2));
+  board->Clear();
+}
+
+TEST(ProgressiveClipSchedulerTest, ScoreBoard) {
+  auto board = ClipScoreBoard::Get("ScoreBoard");
+  EXPECT_EQ(board, ClipScoreBoard::Get("ScoreBoard"));
+  EXPECT_TRUE(board->Claim(3));
+  EXPECT_FALSE(board->Claim(3));
+
+  const float first[] = {0.2f, 0.8f};
+  const float second[] = {0.6f, 0.4f};
+  float average[2];
+  EXPECT_EQ(board->Add(3, first, 2, average), 1);
+  EXPECT_EQ(board->Add(3, second, 2, average), 2);
+  EXPECT_FLOAT_EQ(average[0], 0.4f);
+  EXPECT_FLOAT_EQ(average[1], 0.6f);
+  board->Finish(3);
+  EXPECT_TRUE(board->IsFinished(3));
+  EXPECT_FALSE(board->IsFinished(4));
+  EXPECT_EQ(board->Add(3, first, 2, average), 0);
+  board->Clear();
+  EXPECT_TRUE(board->Claim(3));
+}
+
+} // namespace caffe2
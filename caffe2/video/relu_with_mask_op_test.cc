@@ -0,0 +1,87 @@
+#include <cstdint>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/relu_with_mask_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+void AddInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<float>& values) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(1, values.size());
+  std::copy(values.begin(), values.end(), tensor->mutable_data<float>());
+}
+
+void RunOp(
+    Workspace* ws,
+    const std::string& type,
+    const std::vector<std::string>& inputs,
+    const std::vector<std::string>& outputs) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  for (const auto& output : outputs) {
+    def.add_output(output);
+  }
+  auto op = CreateOperator(def, ws);
+  ASSERT_TRUE(op->Run());
+}
+
+} // namespace
+
+// 40 elements, so that the second word of the mask is partial
+TEST(ReluWithMaskOpTest, MatchesReluAndReluGradient) {
+  Workspace ws;
+  std::vector<float> x(40);
+  std::vector<float> dy(40);
+  for (int i = 0; i < x.size(); ++i) {
+    x[i] = (i % 3 == 0 ? -1.f : 1.f) * (i + 1);
+    dy[i] = 0.5f * i - 3.f;
+  }
+  AddInput(&ws, "X", x);
+  AddInput(&ws, "dY", dy);
+  RunOp(&ws, "ReluWithMask", {"X"}, {"Y", "mask"});
+  RunOp(&ws, "ReluWithMaskGradient", {"mask", "dY"}, {"dX"});
+
+  const auto& Y = ws.GetBlob("Y")->Get<TensorCPU>();
+  const auto& mask = ws.GetBlob("mask")->Get<TensorCPU>();
+  const auto& dX = ws.GetBlob("dX")->Get<TensorCPU>();
+  ASSERT_EQ(mask.size(), 2);
+  const uint32_t* bits = reinterpret_cast<const uint32_t*>(mask.data<int>());
+  for (int i = 0; i < x.size(); ++i) {
+    const bool positive = x[i] > 0;
+    EXPECT_EQ(Y.data<float>()[i], positive ? x[i] : 0.f);
+    EXPECT_EQ((bits[i / 32] >> (i % 32)) & 1u, positive ? 1u : 0u);
+    EXPECT_EQ(dX.data<float>()[i], positive ? dy[i] : 0.f);
+  }
+  // the bits past the elements are clear
+  EXPECT_EQ(bits[1] >> 8, 0u);
+}
+
+TEST(ReluWithMaskOpTest, InPlace) {
+  Workspace ws;
+  AddInput(&ws, "X", {-2, 0, 3, -4, 5});
+  AddInput(&ws, "dY", {1, 2, 3, 4, 5});
+  RunOp(&ws, "ReluWithMask", {"X"}, {"X", "mask"});
+  RunOp(&ws, "ReluWithMaskGradient", {"mask", "dY"}, {"dY"});
+
+  const auto& X = ws.GetBlob("X")->Get<TensorCPU>();
+  const auto& dY = ws.GetBlob("dY")->Get<TensorCPU>();
+  const std::vector<float> expected_y = {0, 0, 3, 0, 5};
+  const std::vector<float> expected_dx = {0, 0, 3, 0, 5};
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_EQ(X.data<float>()[i], expected_y[i]);
+    EXPECT_EQ(dY.data<float>()[i], expected_dx[i]);
+  }
+}
+
+} // namespace caffe2
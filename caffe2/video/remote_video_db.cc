@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "caffe2/core/db.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/video/remote_video_store.h"
+#include "caffe2/video/video_record.h"
+
+namespace caffe2 {
+namespace db {
+
+namespace {
+
+typedef std::vector<std::pair<string, string>> Records;
+
+// "<video> <label>[,<label>...]" lines, like the lists of
+// process_data/kinetics, as the records of create_video_lmdb.py
+// --header_records, keyed by their zero padded line index
+void ParseVideoList(const string& list, Records* records) {
+  std::istringstream lines(list);
+  string line;
+  while (std::getline(lines, line)) {
+    std::istringstream tokens(line);
+    string video;
+    string labels;
+    if (!(tokens >> video >> labels)) {
+      continue;
+    }
+    std::vector<int32_t> label_values;
+    std::istringstream label_tokens(labels);
+    string label;
+    while (std::getline(label_tokens, label, ',')) {
+      label_values.push_back(std::stoi(label));
+    }
+    VideoRecord record;
+    record.payload = video.data();
+    record.payload_size = video.size();
+    record.label_data = reinterpret_cast<const char*>(label_values.data());
+    record.num_labels = label_values.size();
+    record.start_frm = -1;
+    record.spatial_pos = -1;
+    record.num_frames = -1;
+    record.fps = -1;
+    record.width = -1;
+    record.height = -1;
+    record.key_frame_data = nullptr;
+    record.num_key_frames = 0;
+    char key[16];
+    snprintf(key, sizeof(key), "%09d", static_cast<int>(records->size()));
+    records->emplace_back(key, SerializeVideoRecord(record));
+  }
+}
+
+} // namespace
+
+class RemoteVideoDBCursor : public Cursor {
+ public:
+  explicit RemoteVideoDBCursor(const Records* records)
+      : records_(records), iter_(records->begin()) {}
+
+  void Seek(const string& key) override {
+    iter_ = std::lower_bound(
+        records_->begin(),
+        records_->end(),
+        key,
+        [](const std::pair<string, string>& record, const string& key) {
+          return record.first < key;
+        });
+  }
+  bool SupportsSeek() override {
+    return true;
+  }
+  void SeekToFirst() override {
+    iter_ = records_->begin();
+  }
+  void Next() override {
+    ++iter_;
+  }
+  string key() override {
+    return iter_->first;
+  }
+  string value() override {
+    return iter_->second;
+  }
+  bool ValueView(const char** data, size_t* size) override {
+    *data = iter_->second.data();
+    *size = iter_->second.size();
+    return true;
+  }
+  bool Valid() override {
+    return iter_ != records_->end();
+  }
+
+ private:
+  const Records* records_;
+  Records::const_iterator iter_;
+};
+
+/**
+ * A read-only db of the videos of a list file, local or at an http:// url,
+ * so that the nodes only need the list and not a db of it on shared
+ * storage. With video urls in the list, the input op reads the videos
+ * through a RemoteVideoStore (remote_files).
+ */
+class RemoteVideoDB : public DB {
+ public:
+  RemoteVideoDB(const string& source, Mode mode) : DB(source, mode) {
+    CAFFE_ENFORCE(mode == READ, "RemoteVideoDB is read only.");
+    string list;
+    if (RemoteVideoStore::IsRemote(source)) {
+      HttpConnectionPool connections(1, 60000);
+      int64_t total;
+      CAFFE_ENFORCE(
+          connections.Get(source, 0, -1, &list, &total),
+          "Cannot fetch the video list ",
+          source);
+    } else {
+      std::ifstream file(source);
+      CAFFE_ENFORCE(file, "Cannot open the video list ", source);
+      std::stringstream contents;
+      contents << file.rdbuf();
+      list = contents.str();
+    }
+    ParseVideoList(list, &records_);
+    LOG(INFO) << "Opened the list of " << records_.size() << " videos "
+              << source;
+  }
+
+  void Close() override {}
+
+  unique_ptr<Cursor> NewCursor() override {
+    return make_unique<RemoteVideoDBCursor>(&records_);
+  }
+  unique_ptr<Transaction> NewTransaction() override {
+    CAFFE_THROW("RemoteVideoDB is read only.");
+  }
+
+ private:
+  Records records_;
+};
+
+REGISTER_CAFFE2_DB(RemoteVideoDB, RemoteVideoDB);
+REGISTER_CAFFE2_DB(remote_video, RemoteVideoDB);
+
+} // namespace db
+} // namespace caffe2
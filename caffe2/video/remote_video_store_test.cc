@@ -0,0 +1,239 @@
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "caffe2/core/db.h"
+#include "caffe2/video/remote_video_store.h"
+#include "caffe2/video/video_record.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// serves the range requests of any path from one object, on keep-alive
+// connections, and counts the requests
+class RangeServer {
+ public:
+  explicit RangeServer(const std::string& object) : object_(object) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    socklen_t size = sizeof(address);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &size);
+    port_ = ntohs(address.sin_port);
+    listen(listen_fd_, 16);
+    thread_ = std::thread([this]() { Serve(); });
+  }
+
+  ~RangeServer() {
+    shutdown(listen_fd_, SHUT_RDWR);
+    close(listen_fd_);
+    thread_.join();
+  }
+
+  std::string url(const std::string& path) const {
+    return "http://127.0.0.1:" + std::to_string(port_) + path;
+  }
+
+  int requests() const {
+    return requests_;
+  }
+
+ private:
+  void Serve() {
+    while (true) {
+      const int fd = accept(listen_fd_, nullptr, nullptr);
+      if (fd < 0) {
+        return;
+      }
+      std::thread([this, fd]() { ServeConnection(fd); }).detach();
+    }
+  }
+
+  void ServeConnection(int fd) {
+    std::string pending;
+    char chunk[4096];
+    while (true) {
+      size_t end;
+      while ((end = pending.find("\r\n\r\n")) == std::string::npos) {
+        const ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+          close(fd);
+          return;
+        }
+        pending.append(chunk, n);
+      }
+      const std::string request = pending.substr(0, end);
+      pending.erase(0, end + 4);
+      ++requests_;
+      long long first = 0;
+      long long last = object_.size() - 1;
+      std::string response;
+      const size_t range = request.find("Range: bytes=");
+      if (range == std::string::npos) {
+        response = "HTTP/1.1 200 OK\r\nContent-Length: " +
+            std::to_string(object_.size()) + "\r\n\r\n" + object_;
+      } else {
+        sscanf(
+            request.c_str() + range, "Range: bytes=%lld-%lld", &first, &last);
+        if (first >= object_.size()) {
+          response = "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: "
+                     "bytes */" +
+              std::to_string(object_.size()) + "\r\nContent-Length: 0\r\n\r\n";
+        } else {
+          last = std::min<long long>(last, object_.size() - 1);
+          response = "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes " +
+              std::to_string(first) + "-" + std::to_string(last) + "/" +
+              std::to_string(object_.size()) + "\r\nContent-Length: " +
+              std::to_string(last - first + 1) + "\r\n\r\n" +
+              object_.substr(first, last - first + 1);
+        }
+      }
+      send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+    }
+  }
+
+  const std::string object_;
+  int listen_fd_;
+  int port_;
+  std::atomic<int> requests_{0};
+  std::thread thread_;
+};
+
+std::string MakeObject(size_t size) {
+  std::string object(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    object[i] = static_cast<char>(i * 7 % 251);
+  }
+  return object;
+}
+
+} // namespace
+
+TEST(RemoteVideoStoreTest, ParsesUrls) {
+  HttpUrl url;
+  ASSERT_TRUE(ParseHttpUrl("http://store:8080/kinetics/a.mp4", &url));
+  EXPECT_EQ(url.host, "store");
+  EXPECT_EQ(url.port, 8080);
+  EXPECT_EQ(url.path, "/kinetics/a.mp4");
+  ASSERT_TRUE(ParseHttpUrl("http://store", &url));
+  EXPECT_EQ(url.port, 80);
+  EXPECT_EQ(url.path, "/");
+  EXPECT_FALSE(ParseHttpUrl("/data/a.mp4", &url));
+  EXPECT_TRUE(RemoteVideoStore::IsRemote("http://store/a.mp4"));
+  EXPECT_FALSE(RemoteVideoStore::IsRemote("/data/a.mp4"));
+}
+
+TEST(RemoteVideoStoreTest, ReusesConnections) {
+  const std::string object = MakeObject(10000);
+  RangeServer server(object);
+  HttpConnectionPool connections(2, 5000);
+  std::string body;
+  int64_t total;
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(connections.Get(server.url("/a"), 100, 50, &body, &total));
+    EXPECT_EQ(body, object.substr(100, 50));
+    EXPECT_EQ(total, object.size());
+  }
+  ASSERT_TRUE(connections.Get(server.url("/a"), 9990, 50, &body, &total));
+  EXPECT_EQ(body, object.substr(9990));
+  ASSERT_TRUE(connections.Get(server.url("/a"), 0, -1, &body, &total));
+  EXPECT_EQ(body, object);
+  EXPECT_EQ(connections.num_connects(), 1);
+}
+
+TEST(RemoteVideoStoreTest, CachesBlocksInMemory) {
+  const std::string object = MakeObject(10000);
+  RangeServer server(object);
+  RemoteVideoStore::Options options;
+  options.block_size = 4096;
+  options.cache_bytes = 2 * 4096;
+  options.prefetch_threads = 0;
+  RemoteVideoStore store(options);
+  const std::string url = server.url("/a.mp4");
+  EXPECT_EQ(store.Size(url), object.size());
+  auto block = store.GetBlock(url, 2);
+  ASSERT_TRUE(block != nullptr);
+  EXPECT_EQ(*block, object.substr(8192));
+  EXPECT_EQ(store.GetBlock(url, 3)->size(), 0);
+  const int requests = server.requests();
+  EXPECT_EQ(*store.GetBlock(url, 2), object.substr(8192));
+  EXPECT_EQ(server.requests(), requests);
+  // block 0 is the least recently used one
+  store.GetBlock(url, 1);
+  EXPECT_GT(store.GetStats().evicted_bytes, 0);
+  store.GetBlock(url, 0);
+  EXPECT_EQ(server.requests(), requests + 2);
+  EXPECT_EQ(store.GetStats().misses, 5);
+}
+
+TEST(RemoteVideoStoreTest, CachesBlocksOnDisk) {
+  const std::string object = MakeObject(10000);
+  RangeServer server(object);
+  char dir[] = "/tmp/remote_video_store_testXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != nullptr);
+  RemoteVideoStore::Options options;
+  options.cache_dir = dir;
+  options.block_size = 4096;
+  options.prefetch_threads = 2;
+  const std::string url = server.url("/a.mp4");
+  {
+    RemoteVideoStore store(options);
+    store.Prefetch(url);
+    for (int i = 0; i < 500 && store.GetStats().misses < 2; ++i) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(*store.GetBlock(url, 1), object.substr(4096, 4096));
+    EXPECT_EQ(store.GetStats().misses, 2);
+  }
+  // a new store finds the blocks of the last one
+  const int requests = server.requests();
+  RemoteVideoStore store(options);
+  EXPECT_EQ(*store.GetBlock(url, 0), object.substr(0, 4096));
+  EXPECT_EQ(*store.GetBlock(url, 1), object.substr(4096, 4096));
+  EXPECT_EQ(store.Size(url), object.size());
+  EXPECT_EQ(server.requests(), requests);
+  EXPECT_EQ(store.GetStats().hits, 2);
+  system((std::string("rm -rf ") + dir).c_str());
+}
+
+TEST(RemoteVideoDBTest, ReadsListFromUrl) {
+  RangeServer server(
+      "http://store/a.mp4 3\nhttp://store/b.mp4 4,7\n\ngarbage\n");
+  std::unique_ptr<db::DB> list(
+      db::CreateDB("remote_video", server.url("/train.txt"), db::READ));
+  auto cursor = list->NewCursor();
+  TensorProtos protos;
+  VideoRecord record;
+  ASSERT_TRUE(cursor->Valid());
+  EXPECT_EQ(cursor->key(), "000000000");
+  const std::string value = cursor->value();
+  ParseVideoRecord(value.data(), value.size(), &protos, &record);
+  EXPECT_EQ(
+      std::string(record.payload, record.payload_size), "http://store/a.mp4");
+  EXPECT_EQ(record.num_labels, 1);
+  EXPECT_EQ(record.label(0), 3);
+
+  cursor->Seek("000000001");
+  const char* data;
+  size_t size;
+  ASSERT_TRUE(cursor->ValueView(&data, &size));
+  ParseVideoRecord(data, size, &protos, &record);
+  EXPECT_EQ(record.num_labels, 2);
+  EXPECT_EQ(record.label(1), 7);
+  cursor->Next();
+  EXPECT_FALSE(cursor->Valid());
+}
+
+} // namespace caffe2
@@ -0,0 +1,78 @@
+#include <cfloat>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/segmented_clip_aggregate_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+void AddBatch(
+    Workspace* ws,
+    const std::vector<float>& scores,
+    const std::vector<int>& ids) {
+  auto* X = ws->CreateBlob("scores")->GetMutable<TensorCPU>();
+  X->Resize(ids.size(), scores.size() / ids.size());
+  std::copy(scores.begin(), scores.end(), X->mutable_data<float>());
+  auto* video_ids = ws->CreateBlob("video_ids")->GetMutable<TensorCPU>();
+  video_ids->Resize(ids.size());
+  std::copy(ids.begin(), ids.end(), video_ids->mutable_data<int>());
+}
+
+template <typename T>
+std::vector<T> GetOutput(Workspace* ws, const std::string& name) {
+  const auto& tensor = ws->GetBlob(name)->Get<TensorCPU>();
+  return std::vector<T>(
+      tensor.data<T>(), tensor.data<T>() + tensor.size());
+}
+
+} // namespace
+
+TEST(SegmentedClipAggregateTest, AggregatesAcrossRuns) {
+  Workspace ws;
+  OperatorDef def;
+  def.set_type("SegmentedClipAggregate");
+  def.add_input("scores");
+  def.add_input("video_ids");
+  def.add_output("sum");
+  def.add_output("max");
+  def.add_output("counts");
+  def.add_arg()->CopyFrom(MakeArgument<int>("num_videos", 3));
+  def.add_arg()->CopyFrom(MakeArgument<int>("max_clips", 2));
+
+  // two clips of video 0 in one batch, and padding
+  AddBatch(&ws, {0.1f, 0.9f, 0.5f, 0.5f, 0.7f, 0.3f, 1.f, 1.f}, {0, 2, 0, -1});
+  auto op = CreateOperator(def, &ws);
+  ASSERT_NE(op, nullptr);
+  ASSERT_TRUE(op->Run());
+  // video 0 is at max_clips, video 1 gets its first
+  AddBatch(&ws, {0.9f, 0.1f, 0.2f, 0.8f}, {0, 1});
+  ASSERT_TRUE(op->Run());
+
+  const std::vector<float> sum = GetOutput<float>(&ws, "sum");
+  EXPECT_EQ(sum.size(), 6);
+  EXPECT_FLOAT_EQ(sum[0], 0.8f);
+  EXPECT_FLOAT_EQ(sum[1], 1.2f);
+  EXPECT_FLOAT_EQ(sum[2], 0.2f);
+  EXPECT_FLOAT_EQ(sum[3], 0.8f);
+  EXPECT_FLOAT_EQ(sum[4], 0.5f);
+  EXPECT_FLOAT_EQ(sum[5], 0.5f);
+  const std::vector<float> max = GetOutput<float>(&ws, "max");
+  EXPECT_FLOAT_EQ(max[0], 0.7f);
+  EXPECT_FLOAT_EQ(max[1], 0.9f);
+  EXPECT_FLOAT_EQ(max[3], 0.8f);
+  EXPECT_EQ(GetOutput<int>(&ws, "counts"), std::vector<int>({2, 1, 1}));
+
+  // emptied outputs start over
+  ws.GetBlob("counts")->GetMutable<TensorCPU>()->Resize(0);
+  AddBatch(&ws, {0.3f, 0.7f}, {1});
+  ASSERT_TRUE(op->Run());
+  EXPECT_EQ(GetOutput<int>(&ws, "counts"), std::vector<int>({0, 1, 0}));
+  EXPECT_FLOAT_EQ(GetOutput<float>(&ws, "sum")[3], 0.7f);
+  EXPECT_FLOAT_EQ(GetOutput<float>(&ws, "max")[0], -FLT_MAX);
+}
+
+} // namespace caffe2
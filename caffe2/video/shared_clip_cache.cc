@@ -0,0 +1,373 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/shared_clip_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/macros.h"
+
+#ifdef CAFFE2_USE_SHM_MUTEX
+#include "caffe2/contrib/shm_mutex/shm_mutex.h"
+#endif
+
+namespace caffe2 {
+
+#ifdef CAFFE2_USE_SHM_MUTEX
+
+struct SharedClipCache::Header {
+  std::atomic<uint32_t> initialized;
+  uint32_t num_slots;
+  uint64_t clip_bytes;
+  // the clock hand
+  uint32_t hand;
+};
+
+struct SharedClipCache::Slot {
+  uint64_t key;
+  // the next slot of the hash bucket + 1, 0 at the end
+  int32_t next;
+  int32_t state;
+  // the readers copying the clip out
+  int32_t pins;
+  int32_t referenced;
+  int32_t height;
+  int32_t width;
+  uint64_t size;
+};
+
+class SharedClipCache::Mutex : public ShmTTSetMutex<ShmBaseHeader> {
+ public:
+  explicit Mutex(const std::string& name)
+      : ShmTTSetMutex<ShmBaseHeader>(name.c_str()) {}
+};
+
+namespace {
+
+// a slot is free, being filled by the process that claimed it (and linked
+// in the table, so that the clip is not inserted twice), or holds a clip
+enum SlotState : int32_t {
+  kFree = 0,
+  kFilling = 1,
+  kValid = 2,
+};
+
+size_t AlignUp(const size_t size) {
+  return (size + 63) / 64 * 64;
+}
+
+// FNV-1a, which is the same in every process unlike std::hash
+uint64_t HashKey(const std::string& key) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char c : key) {
+    hash = (hash ^ (uint8_t)c) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+} // namespace
+
+size_t SharedClipCache::BucketsOffset() {
+  return AlignUp(sizeof(Header));
+}
+
+size_t SharedClipCache::SlotsOffset(const int num_slots) {
+  return BucketsOffset() + AlignUp(num_slots * sizeof(int32_t));
+}
+
+size_t SharedClipCache::DataOffset(const int num_slots) {
+  return SlotsOffset(num_slots) + AlignUp(num_slots * sizeof(Slot));
+}
+
+SharedClipCache::SharedClipCache(
+    const std::string& name,
+    const size_t capacity,
+    const size_t clip_bytes)
+    : name_(name), clip_bytes_(AlignUp(clip_bytes)), stats_(name) {
+  CAFFE_ENFORCE_GT(clip_bytes, 0, "Clip cache slots cannot be empty.");
+  num_slots_ = std::max<size_t>(1, capacity / clip_bytes_);
+  const size_t size = DataOffset(num_slots_) + num_slots_ * clip_bytes_;
+
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  const bool creator = fd != -1;
+  if (!creator) {
+    CAFFE_ENFORCE(
+        errno == EEXIST, "shm_open ", name, " failed: ", strerror(errno));
+    fd = shm_open(name.c_str(), O_RDWR, 0);
+    CAFFE_ENFORCE(fd != -1, "shm_open ", name, " failed: ", strerror(errno));
+    // wait for the creating process to size the segment
+    struct stat st;
+    while (fstat(fd, &st) == 0 && st.st_size == 0) {
+      std::this_thread::yield();
+    }
+    CAFFE_ENFORCE_EQ(
+        (size_t)st.st_size,
+        size,
+        "Clip cache ",
+        name,
+        " exists with a different size.");
+  } else {
+    const int rv = ftruncate(fd, size);
+    CAFFE_ENFORCE(rv != -1, "ftruncate: ", strerror(errno));
+  }
+  void* segment =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  CAFFE_ENFORCE(segment != MAP_FAILED, "mmap: ", strerror(errno));
+  segment_ = static_cast<char*>(segment);
+  segment_size_ = size;
+  header_ = reinterpret_cast<Header*>(segment_);
+
+  if (creator) {
+    // the segment is zero filled, so all buckets are empty and all slots
+    // free already
+    header_->num_slots = num_slots_;
+    header_->clip_bytes = clip_bytes_;
+    header_->initialized.store(1, std::memory_order_release);
+  } else {
+    while (header_->initialized.load(std::memory_order_acquire) == 0) {
+      std::this_thread::yield();
+    }
+    CAFFE_ENFORCE(
+        (int)header_->num_slots == num_slots_ &&
+            header_->clip_bytes == clip_bytes_,
+        "Clip cache ",
+        name,
+        " exists with a different geometry.");
+  }
+  mutex_.reset(new Mutex(name_ + "_mutex"));
+}
+
+SharedClipCache::~SharedClipCache() {
+  mutex_.reset();
+  if (segment_) {
+    munmap(segment_, segment_size_);
+  }
+}
+
+void SharedClipCache::Unlink(const std::string& name) {
+  shm_unlink(name.c_str());
+}
+
+int32_t* SharedClipCache::Buckets() const {
+  return reinterpret_cast<int32_t*>(segment_ + BucketsOffset());
+}
+
+SharedClipCache::Slot* SharedClipCache::Slots() const {
+  return reinterpret_cast<Slot*>(segment_ + SlotsOffset(num_slots_));
+}
+
+unsigned char* SharedClipCache::Data(const int slot) const {
+  return reinterpret_cast<unsigned char*>(
+      segment_ + DataOffset(num_slots_) + slot * clip_bytes_);
+}
+
+void SharedClipCache::Lock() {
+  mutex_->lock();
+  // the mutex orders its owner relaxed, so order the table accesses here
+  std::atomic_thread_fence(std::memory_order_acquire);
+}
+
+void SharedClipCache::Unlock() {
+  std::atomic_thread_fence(std::memory_order_release);
+  mutex_->unlock();
+}
+
+int SharedClipCache::FindSlot(const uint64_t key) const {
+  const Slot* slots = Slots();
+  for (int32_t i = Buckets()[key % num_slots_]; i != 0; i = slots[i - 1].next) {
+    if (slots[i - 1].key == key) {
+      return i - 1;
+    }
+  }
+  return -1;
+}
+
+void SharedClipCache::UnlinkSlot(const int slot) {
+  Slot* slots = Slots();
+  int32_t* link = &Buckets()[slots[slot].key % num_slots_];
+  while (*link != 0) {
+    if (*link - 1 == slot) {
+      *link = slots[slot].next;
+      break;
+    }
+    link = &slots[*link - 1].next;
+  }
+  slots[slot].next = 0;
+}
+
+bool SharedClipCache::Lookup(
+    const std::string& key,
+    std::vector<unsigned char>* clip,
+    int* height,
+    int* width) {
+  const uint64_t hash = HashKey(key);
+  Lock();
+  const int s = FindSlot(hash);
+  if (s < 0 || Slots()[s].state != kValid) {
+    Unlock();
+    CAFFE_EVENT(stats_, misses, 1);
+    return false;
+  }
+  Slot& slot = Slots()[s];
+  slot.referenced = 1;
+  ++slot.pins;
+  *height = slot.height;
+  *width = slot.width;
+  const size_t size = slot.size;
+  Unlock();
+
+  clip->resize(size);
+  memcpy(clip->data(), Data(s), size);
+
+  Lock();
+  --slot.pins;
+  Unlock();
+  CAFFE_EVENT(stats_, hits, 1);
+  return true;
+}
+
+void SharedClipCache::Insert(
+    const std::string& key,
+    const std::vector<unsigned char>& clip,
+    const int height,
+    const int width) {
+  if (clip.size() > clip_bytes_) {
+    CAFFE_EVENT(stats_, rejected, 1);
+    return;
+  }
+  const uint64_t hash = HashKey(key);
+  Lock();
+  if (FindSlot(hash) >= 0) {
+    // another process got here first
+    Unlock();
+    return;
+  }
+  // clock: the first slot from the hand that is free or was not referenced
+  // since the hand last passed it, clearing the reference bits on the way
+  Slot* slots = Slots();
+  int victim = -1;
+  for (int step = 0; step < 2 * num_slots_; ++step) {
+    const int s = header_->hand;
+    header_->hand = (s + 1) % num_slots_;
+    Slot& slot = slots[s];
+    if (slot.state == kFilling || slot.pins > 0) {
+      continue;
+    }
+    if (slot.state == kValid && slot.referenced) {
+      slot.referenced = 0;
+      continue;
+    }
+    victim = s;
+    break;
+  }
+  if (victim < 0) {
+    Unlock();
+    CAFFE_EVENT(stats_, rejected, 1);
+    return;
+  }
+  Slot& slot = slots[victim];
+  if (slot.state == kValid) {
+    UnlinkSlot(victim);
+    CAFFE_EVENT(stats_, evictions, 1);
+  }
+  slot.key = hash;
+  slot.state = kFilling;
+  slot.referenced = 0;
+  slot.height = height;
+  slot.width = width;
+  slot.size = clip.size();
+  int32_t& bucket = Buckets()[hash % num_slots_];
+  slot.next = bucket;
+  bucket = victim + 1;
+  Unlock();
+
+  memcpy(Data(victim), clip.data(), clip.size());
+
+  Lock();
+  slot.state = kValid;
+  Unlock();
+  CAFFE_EVENT(stats_, inserts, 1);
+}
+
+#else // CAFFE2_USE_SHM_MUTEX
+
+class SharedClipCache::Mutex {};
+
+SharedClipCache::SharedClipCache(
+    const std::string& name,
+    const size_t /* capacity */,
+    const size_t /* clip_bytes */)
+    : name_(name), stats_(name) {
+  CAFFE_THROW("clip_cache_name needs Caffe2 built with USE_SHM_MUTEX.");
+}
+
+SharedClipCache::~SharedClipCache() {}
+
+void SharedClipCache::Unlink(const std::string& /* name */) {}
+
+bool SharedClipCache::Lookup(
+    const std::string& /* key */,
+    std::vector<unsigned char>* /* clip */,
+    int* /* height */,
+    int* /* width */) {
+  return false;
+}
+
+void SharedClipCache::Insert(
+    const std::string& /* key */,
+    const std::vector<unsigned char>& /* clip */,
+    const int /* height */,
+    const int /* width */) {}
+
+#endif // CAFFE2_USE_SHM_MUTEX
+
+std::shared_ptr<SharedClipCache> GetSharedClipCache(
+    const std::string& name,
+    const size_t capacity,
+    const size_t clip_bytes) {
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::weak_ptr<SharedClipCache>>
+      caches;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto cache = caches[name].lock();
+  if (!cache) {
+    cache = std::make_shared<SharedClipCache>(name, capacity, clip_bytes);
+    caches[name] = cache;
+  }
+  return cache;
+}
+
+} // namespace caffe2
@@ -0,0 +1,86 @@
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "caffe2/video/shared_clip_cache.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+std::string CacheName(const char* test) {
+  return std::string("/caffe2_clip_cache_") + test + "_" +
+      std::to_string(getpid());
+}
+
+std::vector<unsigned char> MakeClip(unsigned char value) {
+  return std::vector<unsigned char>(48, value);
+}
+
+} // namespace
+
+TEST(SharedClipCacheTest, LooksUpClips) {
+  const std::string name = CacheName("lookup");
+  SharedClipCache::Unlink(name);
+  {
+    auto cache = GetSharedClipCache(name, 1 << 20, 64);
+    // the ops of a process share the mapping
+    EXPECT_EQ(GetSharedClipCache(name, 1 << 20, 64), cache);
+    const std::vector<unsigned char> in = MakeClip(10);
+    cache->Insert("/data/a.mp4:0", in, 4, 4);
+
+    int height = 0;
+    int width = 0;
+    std::vector<unsigned char> out;
+    ASSERT_TRUE(cache->Lookup("/data/a.mp4:0", &out, &height, &width));
+    EXPECT_EQ(height, 4);
+    EXPECT_EQ(width, 4);
+    EXPECT_EQ(out, in);
+    EXPECT_FALSE(cache->Lookup("/data/a.mp4:1", &out, &height, &width));
+
+    // clips too large for a slot are not cached
+    cache->Insert("/data/b.mp4:0", std::vector<unsigned char>(65, 1), 1, 65);
+    EXPECT_FALSE(cache->Lookup("/data/b.mp4:0", &out, &height, &width));
+
+    // a clip cached by another process
+    const pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      cache->Insert("/data/c.mp4:0", MakeClip(20), 4, 4);
+      _exit(0);
+    }
+    int status = -1;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(cache->Lookup("/data/c.mp4:0", &out, &height, &width));
+    EXPECT_EQ(out, MakeClip(20));
+  }
+  SharedClipCache::Unlink(name);
+}
+
+TEST(SharedClipCacheTest, EvictsWithTheClock) {
+  const std::string name = CacheName("clock");
+  SharedClipCache::Unlink(name);
+  {
+    SharedClipCache cache(name, 3 * 64, 64);
+    ASSERT_EQ(cache.num_slots(), 3);
+    cache.Insert("a", MakeClip(1), 4, 4);
+    cache.Insert("b", MakeClip(2), 4, 4);
+    cache.Insert("c", MakeClip(3), 4, 4);
+    int height = 0;
+    int width = 0;
+    std::vector<unsigned char> out;
+    // a was used since the hand passed it, b was not
+    ASSERT_TRUE(cache.Lookup("a", &out, &height, &width));
+    cache.Insert("d", MakeClip(4), 4, 4);
+    EXPECT_TRUE(cache.Lookup("a", &out, &height, &width));
+    EXPECT_FALSE(cache.Lookup("b", &out, &height, &width));
+    EXPECT_TRUE(cache.Lookup("c", &out, &height, &width));
+    ASSERT_TRUE(cache.Lookup("d", &out, &height, &width));
+    EXPECT_EQ(out, MakeClip(4));
+  }
+  SharedClipCache::Unlink(name);
+}
+
+} // namespace caffe2
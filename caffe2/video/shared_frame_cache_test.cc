@@ -0,0 +1,85 @@
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "caffe2/video/shared_frame_cache.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+std::string CacheName(const char* test) {
+  return std::string("/caffe2_frame_cache_") + test + "_" +
+      std::to_string(getpid());
+}
+
+// three 2 x 3 planes filled with value, value + 1 and value + 2
+std::vector<uint8_t> MakePlanes(uint8_t value) {
+  std::vector<uint8_t> planes;
+  for (int c = 0; c < 3; c++) {
+    planes.insert(planes.end(), 6, value + c);
+  }
+  return planes;
+}
+
+} // namespace
+
+TEST(SharedFrameCacheTest, LooksUpFrames) {
+  const std::string name = CacheName("lookup");
+  SharedFrameCache::Unlink(name);
+  {
+    SharedFrameCache cache(name, 1 << 20, 64);
+    const std::vector<uint8_t> in = MakePlanes(10);
+    cache.Insert("/data/a.mp4", 3, 2, 3, in.data(), 6);
+
+    int height = 0;
+    int width = 0;
+    std::vector<uint8_t> out;
+    ASSERT_TRUE(cache.Lookup("/data/a.mp4", 3, &height, &width, &out));
+    EXPECT_EQ(height, 2);
+    EXPECT_EQ(width, 3);
+    EXPECT_EQ(out, in);
+    EXPECT_FALSE(cache.Lookup("/data/a.mp4", 4, &height, &width, &out));
+    EXPECT_FALSE(cache.Lookup("/data/b.mp4", 3, &height, &width, &out));
+
+    // frames too large for a slot are not cached
+    const std::vector<uint8_t> large(3 * 100, 1);
+    cache.Insert("/data/a.mp4", 5, 10, 10, large.data(), 100);
+    EXPECT_FALSE(cache.Lookup("/data/a.mp4", 5, &height, &width, &out));
+
+    // a second mapping of the segment, as in another process, sees it
+    SharedFrameCache other(name, 1 << 20, 64);
+    ASSERT_TRUE(other.Lookup("/data/a.mp4", 3, &height, &width, &out));
+    EXPECT_EQ(out, in);
+  }
+  SharedFrameCache::Unlink(name);
+}
+
+TEST(SharedFrameCacheTest, EvictsLeastRecentlyUsed) {
+  const std::string name = CacheName("evict");
+  SharedFrameCache::Unlink(name);
+  {
+    // a single set
+    SharedFrameCache cache(name, SharedFrameCache::kWays * 64, 64);
+    ASSERT_EQ(cache.num_slots(), SharedFrameCache::kWays);
+    const std::vector<uint8_t> in = MakePlanes(0);
+    for (int frame = 0; frame < SharedFrameCache::kWays; frame++) {
+      cache.Insert("/data/a.mp4", frame, 2, 3, in.data(), 6);
+    }
+    int height;
+    int width;
+    std::vector<uint8_t> out;
+    // frame 0 is used again, so frame 1 is the one to go
+    ASSERT_TRUE(cache.Lookup("/data/a.mp4", 0, &height, &width, &out));
+    cache.Insert(
+        "/data/a.mp4", SharedFrameCache::kWays, 2, 3, in.data(), 6);
+    EXPECT_TRUE(cache.Lookup("/data/a.mp4", 0, &height, &width, &out));
+    EXPECT_FALSE(cache.Lookup("/data/a.mp4", 1, &height, &width, &out));
+    EXPECT_TRUE(cache.Lookup(
+        "/data/a.mp4", SharedFrameCache::kWays, &height, &width, &out));
+  }
+  SharedFrameCache::Unlink(name);
+}
+
+} // namespace caffe2
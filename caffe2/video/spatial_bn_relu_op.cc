@@ -0,0 +1,246 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/spatial_bn_relu_op.h"
+#include "caffe2/utils/parallel_for.h"
+
+namespace caffe2 {
+
+template <>
+bool SpatialBNReluOp<float, CPUContext>::RunOnDevice() {
+  const auto& X = Input(INPUT);
+  const auto& scale = Input(SCALE);
+  const auto& bias = Input(BIAS);
+  auto* Y = Output(OUTPUT);
+
+  CAFFE_ENFORCE_GE(X.ndim(), 3);
+  const int N = X.dim32(0);
+  const int C = X.dim32(1);
+  const int inner = X.size() / N / C; // support TxHxW
+  CAFFE_ENFORCE_EQ(scale.size(), C);
+  CAFFE_ENFORCE_EQ(bias.size(), C);
+  const bool has_residual = InputSize() > RESIDUAL;
+  if (has_residual) {
+    CAFFE_ENFORCE(
+        Input(RESIDUAL).dims() == X.dims(),
+        "the residual needs the shape of X");
+  }
+  // the gradient needs X
+  CAFFE_ENFORCE(
+      is_test_ || Y != &X, "SpatialBNRelu can't run in place in training");
+  Y->ResizeLike(X);
+  const float* X_data = X.data<float>();
+  ConstEigenArrayMap<float> X_arr(X_data, inner, N * C);
+
+  Eigen::Array<float, Eigen::Dynamic, 1> mean(C);
+  Eigen::Array<float, Eigen::Dynamic, 1> inv_std(C);
+  if (is_test_) {
+    mean = ConstEigenVectorArrayMap<float>(Input(EST_MEAN).data<float>(), C);
+    inv_std = (ConstEigenVectorArrayMap<float>(Input(EST_VAR).data<float>(), C) +
+               epsilon_)
+                  .rsqrt();
+  } else {
+    // biased variance, as the CPU SpatialBN
+    Eigen::Array<float, Eigen::Dynamic, 1> var(C);
+    mean.setZero();
+    var.setZero();
+    for (int plane = 0; plane < N * C; ++plane) {
+      mean(plane % C) += X_arr.col(plane).sum();
+    }
+    mean /= N * inner;
+    for (int plane = 0; plane < N * C; ++plane) {
+      var(plane % C) +=
+          (X_arr.col(plane) - mean(plane % C)).matrix().squaredNorm();
+    }
+    var /= N * inner;
+    inv_std = (var + epsilon_).rsqrt();
+
+    Output(SAVED_MEAN)->Resize(C);
+    Output(SAVED_INV_STD)->Resize(C);
+    EigenVectorArrayMap<float>(Output(SAVED_MEAN)->mutable_data<float>(), C) =
+        mean;
+    EigenVectorArrayMap<float>(
+        Output(SAVED_INV_STD)->mutable_data<float>(), C) = inv_std;
+    for (auto* running : {Output(RUNNING_MEAN), Output(RUNNING_VAR)}) {
+      if (!running->size()) {
+        running->Resize(C);
+        math::Set<float, CPUContext>(
+            C, 0.f, running->mutable_data<float>(), &context_);
+      }
+    }
+    EigenVectorArrayMap<float> running_mean(
+        Output(RUNNING_MEAN)->mutable_data<float>(), C);
+    EigenVectorArrayMap<float> running_var(
+        Output(RUNNING_VAR)->mutable_data<float>(), C);
+    running_mean = running_mean * momentum_ + mean * (1.f - momentum_);
+    running_var = running_var * momentum_ + var * (1.f - momentum_);
+  }
+
+  // max(x * a + b [+ r], 0) with a = scale * inv_std, b = bias - mean * a
+  const Eigen::Array<float, Eigen::Dynamic, 1> a =
+      ConstEigenVectorArrayMap<float>(scale.data<float>(), C) * inv_std;
+  const Eigen::Array<float, Eigen::Dynamic, 1> b =
+      ConstEigenVectorArrayMap<float>(bias.data<float>(), C) - mean * a;
+  const float* R_data =
+      has_residual ? Input(RESIDUAL).data<float>() : nullptr;
+  float* Y_data = Y->mutable_data<float>();
+  ParallelFor(
+      N * C, ParallelForGrainSize(inner), [&](int64_t begin, int64_t end) {
+        for (int64_t plane = begin; plane < end; ++plane) {
+          const int c = plane % C;
+          EigenVectorArrayMap<float> y(Y_data + plane * inner, inner);
+          if (has_residual) {
+            y = (X_arr.col(plane) * a(c) + b(c) +
+                 ConstEigenVectorArrayMap<float>(
+                     R_data + plane * inner, inner))
+                    .cwiseMax(0.f);
+          } else {
+            y = (X_arr.col(plane) * a(c) + b(c)).cwiseMax(0.f);
+          }
+        }
+      });
+  return true;
+}
+
+template <>
+bool SpatialBNReluGradientOp<float, CPUContext>::RunOnDevice() {
+  const auto& X = Input(INPUT);
+  const auto& scale = Input(SCALE);
+  const auto& Y = Input(OUTPUT);
+  const auto& dY = Input(OUTPUT_GRAD);
+
+  const int N = X.dim32(0);
+  const int C = X.dim32(1);
+  const int inner = X.size() / N / C;
+  CAFFE_ENFORCE_EQ(Y.size(), X.size());
+  CAFFE_ENFORCE_EQ(dY.size(), X.size());
+  const bool has_residual = OutputSize() > RESIDUAL_GRAD;
+  auto* dX = Output(INPUT_GRAD);
+  auto* dscale = Output(SCALE_GRAD);
+  auto* dbias = Output(BIAS_GRAD);
+  dX->ResizeLike(X);
+  dscale->ResizeLike(scale);
+  dbias->ResizeLike(scale);
+
+  ConstEigenArrayMap<float> X_arr(X.data<float>(), inner, N * C);
+  ConstEigenArrayMap<float> Y_arr(Y.data<float>(), inner, N * C);
+  ConstEigenArrayMap<float> dY_arr(dY.data<float>(), inner, N * C);
+  ConstEigenVectorArrayMap<float> mean(Input(SAVED_MEAN).data<float>(), C);
+  ConstEigenVectorArrayMap<float> inv_std(
+      Input(SAVED_INV_STD).data<float>(), C);
+  EigenVectorArrayMap<float> dscale_arr(dscale->mutable_data<float>(), C);
+  EigenVectorArrayMap<float> dbias_arr(dbias->mutable_data<float>(), C);
+
+  // dscale = sum(g * x_hat), dbias = sum(g) with g = dY * (Y > 0)
+  dscale_arr.setZero();
+  dbias_arr.setZero();
+  for (int plane = 0; plane < N * C; ++plane) {
+    const int c = plane % C;
+    const auto g = (Y_arr.col(plane) > 0.f).select(dY_arr.col(plane), 0.f);
+    dbias_arr(c) += g.sum();
+    dscale_arr(c) += (g * (X_arr.col(plane) - mean(c))).sum() * inv_std(c);
+  }
+
+  // dX = scale * inv_std * (g - (dbias + x_hat * dscale) / M), dR = g
+  const float inv_M = 1.f / (N * inner);
+  ConstEigenVectorArrayMap<float> scale_arr(scale.data<float>(), C);
+  float* dX_data = dX->mutable_data<float>();
+  float* dR_data = nullptr;
+  if (has_residual) {
+    Output(RESIDUAL_GRAD)->ResizeLike(X);
+    dR_data = Output(RESIDUAL_GRAD)->mutable_data<float>();
+  }
+  ParallelFor(
+      N * C, ParallelForGrainSize(inner), [&](int64_t begin, int64_t end) {
+        for (int64_t plane = begin; plane < end; ++plane) {
+          const int c = plane % C;
+          const auto g =
+              (Y_arr.col(plane) > 0.f).select(dY_arr.col(plane), 0.f);
+          const float dx_scale = scale_arr(c) * inv_std(c);
+          const float dx_x = dx_scale * dscale_arr(c) * inv_std(c) * inv_M;
+          const float dx_bias =
+              dx_scale * dbias_arr(c) * inv_M - dx_x * mean(c);
+          EigenVectorArrayMap<float>(dX_data + plane * inner, inner) =
+              g * dx_scale - X_arr.col(plane) * dx_x - dx_bias;
+          if (has_residual) {
+            EigenVectorArrayMap<float>(dR_data + plane * inner, inner) = g;
+          }
+        }
+      });
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(SpatialBNRelu, SpatialBNReluOp<float, CPUContext>);
+REGISTER_CPU_OPERATOR(SpatialBNReluGradient,
+                      SpatialBNReluGradientOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(SpatialBNRelu)
+    .NumInputs(5, 6)
+    .NumOutputs({1, 5})
+    .AllowInplace({{0, 0}, {5, 0}})
+    .EnforceInplace({{3, 1}, {4, 2}})
+    .SetDoc(R"DOC(
+SpatialBN followed by a ReLU, Y = max(SpatialBN(X) + R, 0), with an optional
+residual R added before the ReLU (the tail of a bottleneck block). Inputs,
+outputs and arguments are the ones of SpatialBN, NCHW only; X may have any
+number of spatial dims. In training the running variance is updated with
+the biased batch variance on CPU and the unbiased one on GPU, as SpatialBN
+and the cuDNN SpatialBN do. Y can be written in place of R, and of X at test
+time.
+)DOC")
+    .Arg("is_test", "If set to nonzero, run SpatialBN in test mode.")
+    .Arg("epsilon", "The epsilon value to use to avoid division by zero.")
+    .Arg("momentum", "Factor used in computing the running mean and variance.")
+    .Input(0, "X", "N x C x (spatial dims)")
+    .Input(1, "scale", "The scale as a 1-dimensional tensor of size C")
+    .Input(2, "bias", "The bias as a 1-dimensional tensor of size C")
+    .Input(3, "mean", "The running mean, size C")
+    .Input(4, "var", "The running variance, size C")
+    .Input(5, "R", "Optional residual of the shape of X")
+    .Output(0, "Y", "The output of the shape of X");
+OPERATOR_SCHEMA(SpatialBNReluGradient)
+    .NumInputs(6)
+    .NumOutputs(3, 4);
+
+class GetSpatialBNReluGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    CAFFE_ENFORCE(
+        !ArgumentHelper::GetSingleArgument(def_, "is_test", 0),
+        "SpatialBNRelu has no gradient in test mode");
+    vector<string> grad_outputs{GI(0), GI(1), GI(2)};
+    if (def_.input_size() > 5) {
+      grad_outputs.push_back(GI(5));
+    }
+    return SingleGradientDef(
+        "SpatialBNReluGradient",
+        "",
+        vector<string>{I(0), I(1), O(0), GO(0), O(3), O(4)},
+        grad_outputs);
+  }
+};
+
+REGISTER_GRADIENT(SpatialBNRelu, GetSpatialBNReluGradient);
+
+} // namespace caffe2
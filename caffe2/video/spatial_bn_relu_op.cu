@@ -0,0 +1,355 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <cub/block/block_reduce.cuh>
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/video/spatial_bn_relu_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// The per channel reductions run one block per channel over its N planes.
+// The elementwise passes use the 2D grid of AffineNd: blocks along x walk
+// the N x C planes with the coefficients of their channel in registers and
+// blocks along y split the T x H x W elements of a plane.
+constexpr int kReduceThreads = CAFFE_CUDA_NUM_THREADS;
+constexpr int kThreads = 256;
+constexpr int kMaxBlocksPerPlane = 1024;
+
+using BlockReduce = cub::BlockReduce<float, kReduceThreads>;
+
+dim3 PlaneGrid(const int planes, const int inner) {
+  return dim3(
+      std::min(planes, CAFFE_MAXIMUM_NUM_BLOCKS),
+      std::min((inner + kThreads - 1) / kThreads, kMaxBlocksPerPlane));
+}
+
+// Batch mean and variance of channel c, with the sums shifted by the first
+// element of the channel against cancellation. Writes the saved statistics,
+// updates the running ones (unbiased variance, as cuDNN) and writes the
+// coefficients of the forward pass to affine[c] and affine[C + c].
+__global__ void ChannelMomentsKernel(
+    const int N,
+    const int C,
+    const int inner,
+    const float* X,
+    const float* scale,
+    const float* bias,
+    const float momentum,
+    const float epsilon,
+    float* saved_mean,
+    float* saved_inv_std,
+    float* running_mean,
+    float* running_var,
+    float* affine) {
+  __shared__ typename BlockReduce::TempStorage temp;
+  const int c = blockIdx.x;
+  const float shift = X[c * inner];
+  float sum = 0.f;
+  float sumsq = 0.f;
+  for (int n = 0; n < N; ++n) {
+    const float* x = X + static_cast<size_t>(n * C + c) * inner;
+    for (int i = threadIdx.x; i < inner; i += blockDim.x) {
+      const float d = x[i] - shift;
+      sum += d;
+      sumsq += d * d;
+    }
+  }
+  sum = BlockReduce(temp).Sum(sum);
+  __syncthreads();
+  sumsq = BlockReduce(temp).Sum(sumsq);
+  if (threadIdx.x == 0) {
+    const float M = static_cast<float>(N) * inner;
+    const float shifted_mean = sum / M;
+    const float var = fmaxf(sumsq / M - shifted_mean * shifted_mean, 0.f);
+    const float mean = shift + shifted_mean;
+    const float inv_std = rsqrtf(var + epsilon);
+    saved_mean[c] = mean;
+    saved_inv_std[c] = inv_std;
+    running_mean[c] = running_mean[c] * momentum + mean * (1.f - momentum);
+    running_var[c] = running_var[c] * momentum +
+        var * (M > 1.f ? M / (M - 1.f) : 1.f) * (1.f - momentum);
+    affine[c] = scale[c] * inv_std;
+    affine[C + c] = bias[c] - mean * scale[c] * inv_std;
+  }
+}
+
+__global__ void TestAffineKernel(
+    const int C,
+    const float* scale,
+    const float* bias,
+    const float* mean,
+    const float* var,
+    const float epsilon,
+    float* affine) {
+  CUDA_1D_KERNEL_LOOP(c, C) {
+    const float a = scale[c] * rsqrtf(var[c] + epsilon);
+    affine[c] = a;
+    affine[C + c] = bias[c] - mean[c] * a;
+  }
+}
+
+template <bool kResidual>
+__global__ void BNReluForwardKernel(
+    const int planes,
+    const int C,
+    const int inner,
+    const float* X,
+    const float* R,
+    const float* affine,
+    float* Y) {
+  for (int plane = blockIdx.x; plane < planes; plane += gridDim.x) {
+    const int c = plane % C;
+    const float a = affine[c];
+    const float b = affine[C + c];
+    const size_t offset = static_cast<size_t>(plane) * inner;
+    for (int i = blockIdx.y * blockDim.x + threadIdx.x; i < inner;
+         i += gridDim.y * blockDim.x) {
+      float y = X[offset + i] * a + b;
+      if (kResidual) {
+        y += R[offset + i];
+      }
+      Y[offset + i] = fmaxf(y, 0.f);
+    }
+  }
+}
+
+// dbias[c] = sum(g), dscale[c] = sum(g * x_hat) with g = dY * (Y > 0)
+__global__ void ChannelGradientSumsKernel(
+    const int N,
+    const int C,
+    const int inner,
+    const float* X,
+    const float* Y,
+    const float* dY,
+    const float* mean,
+    const float* inv_std,
+    float* dscale,
+    float* dbias) {
+  __shared__ typename BlockReduce::TempStorage temp;
+  const int c = blockIdx.x;
+  const float m = mean[c];
+  float g_sum = 0.f;
+  float gx_sum = 0.f;
+  for (int n = 0; n < N; ++n) {
+    const size_t offset = static_cast<size_t>(n * C + c) * inner;
+    for (int i = threadIdx.x; i < inner; i += blockDim.x) {
+      const float g = Y[offset + i] > 0.f ? dY[offset + i] : 0.f;
+      g_sum += g;
+      gx_sum += g * (X[offset + i] - m);
+    }
+  }
+  g_sum = BlockReduce(temp).Sum(g_sum);
+  __syncthreads();
+  gx_sum = BlockReduce(temp).Sum(gx_sum);
+  if (threadIdx.x == 0) {
+    dbias[c] = g_sum;
+    dscale[c] = gx_sum * inv_std[c];
+  }
+}
+
+// dX = scale * inv_std * (g - (dbias + x_hat * dscale) / M), dR = g
+template <bool kResidual>
+__global__ void BNReluBackwardKernel(
+    const int planes,
+    const int C,
+    const int inner,
+    const float inv_M,
+    const float* X,
+    const float* Y,
+    const float* dY,
+    const float* scale,
+    const float* mean,
+    const float* inv_std,
+    const float* dscale,
+    const float* dbias,
+    float* dX,
+    float* dR) {
+  for (int plane = blockIdx.x; plane < planes; plane += gridDim.x) {
+    const int c = plane % C;
+    const float dx_scale = scale[c] * inv_std[c];
+    const float dx_x = dx_scale * dscale[c] * inv_std[c] * inv_M;
+    const float dx_bias = dx_scale * dbias[c] * inv_M - dx_x * mean[c];
+    const size_t offset = static_cast<size_t>(plane) * inner;
+    for (int i = blockIdx.y * blockDim.x + threadIdx.x; i < inner;
+         i += gridDim.y * blockDim.x) {
+      const float g = Y[offset + i] > 0.f ? dY[offset + i] : 0.f;
+      dX[offset + i] = g * dx_scale - X[offset + i] * dx_x - dx_bias;
+      if (kResidual) {
+        dR[offset + i] = g;
+      }
+    }
+  }
+}
+
+} // namespace
+
+template <>
+bool SpatialBNReluOp<float, CUDAContext>::RunOnDevice() {
+  const auto& X = Input(INPUT);
+  const auto& scale = Input(SCALE);
+  const auto& bias = Input(BIAS);
+  auto* Y = Output(OUTPUT);
+
+  CAFFE_ENFORCE_GE(X.ndim(), 3);
+  const int N = X.dim32(0);
+  const int C = X.dim32(1);
+  const int inner = X.size() / N / C; // support TxHxW
+  CAFFE_ENFORCE_EQ(scale.size(), C);
+  CAFFE_ENFORCE_EQ(bias.size(), C);
+  const bool has_residual = InputSize() > RESIDUAL;
+  if (has_residual) {
+    CAFFE_ENFORCE(
+        Input(RESIDUAL).dims() == X.dims(),
+        "the residual needs the shape of X");
+  }
+  CAFFE_ENFORCE(
+      is_test_ || Y != &X, "SpatialBNRelu can't run in place in training");
+  affine_.Resize(2 * C);
+  float* affine = affine_.mutable_data<float>();
+
+  if (is_test_) {
+    TestAffineKernel<<<
+        CAFFE_GET_BLOCKS(C),
+        CAFFE_CUDA_NUM_THREADS,
+        0,
+        context_.cuda_stream()>>>(
+        C,
+        scale.data<float>(),
+        bias.data<float>(),
+        Input(EST_MEAN).data<float>(),
+        Input(EST_VAR).data<float>(),
+        epsilon_,
+        affine);
+  } else {
+    for (auto* running : {Output(RUNNING_MEAN), Output(RUNNING_VAR)}) {
+      if (!running->size()) {
+        running->Resize(C);
+        math::Set<float, CUDAContext>(
+            C, 0.f, running->mutable_data<float>(), &context_);
+      }
+    }
+    Output(SAVED_MEAN)->Resize(C);
+    Output(SAVED_INV_STD)->Resize(C);
+    ChannelMomentsKernel<<<C, kReduceThreads, 0, context_.cuda_stream()>>>(
+        N,
+        C,
+        inner,
+        X.data<float>(),
+        scale.data<float>(),
+        bias.data<float>(),
+        momentum_,
+        epsilon_,
+        Output(SAVED_MEAN)->mutable_data<float>(),
+        Output(SAVED_INV_STD)->mutable_data<float>(),
+        Output(RUNNING_MEAN)->mutable_data<float>(),
+        Output(RUNNING_VAR)->mutable_data<float>(),
+        affine);
+  }
+
+  const float* R_data =
+      has_residual ? Input(RESIDUAL).data<float>() : nullptr;
+  const float* X_data = X.data<float>();
+  Y->ResizeLike(X);
+  const dim3 grid = PlaneGrid(N * C, inner);
+  if (has_residual) {
+    BNReluForwardKernel<true>
+        <<<grid, kThreads, 0, context_.cuda_stream()>>>(
+            N * C, C, inner, X_data, R_data, affine,
+            Y->mutable_data<float>());
+  } else {
+    BNReluForwardKernel<false>
+        <<<grid, kThreads, 0, context_.cuda_stream()>>>(
+            N * C, C, inner, X_data, nullptr, affine,
+            Y->mutable_data<float>());
+  }
+  return true;
+}
+
+template <>
+bool SpatialBNReluGradientOp<float, CUDAContext>::RunOnDevice() {
+  const auto& X = Input(INPUT);
+  const auto& scale = Input(SCALE);
+  const auto& Y = Input(OUTPUT);
+  const auto& dY = Input(OUTPUT_GRAD);
+
+  const int N = X.dim32(0);
+  const int C = X.dim32(1);
+  const int inner = X.size() / N / C;
+  CAFFE_ENFORCE_EQ(Y.size(), X.size());
+  CAFFE_ENFORCE_EQ(dY.size(), X.size());
+  const bool has_residual = OutputSize() > RESIDUAL_GRAD;
+  auto* dX = Output(INPUT_GRAD);
+  auto* dscale = Output(SCALE_GRAD);
+  auto* dbias = Output(BIAS_GRAD);
+  dX->ResizeLike(X);
+  dscale->ResizeLike(scale);
+  dbias->ResizeLike(scale);
+  const float* mean = Input(SAVED_MEAN).data<float>();
+  const float* inv_std = Input(SAVED_INV_STD).data<float>();
+
+  ChannelGradientSumsKernel<<<C, kReduceThreads, 0, context_.cuda_stream()>>>(
+      N,
+      C,
+      inner,
+      X.data<float>(),
+      Y.data<float>(),
+      dY.data<float>(),
+      mean,
+      inv_std,
+      dscale->mutable_data<float>(),
+      dbias->mutable_data<float>());
+
+  const float inv_M = 1.f / (static_cast<float>(N) * inner);
+  const dim3 grid = PlaneGrid(N * C, inner);
+  if (has_residual) {
+    Output(RESIDUAL_GRAD)->ResizeLike(X);
+    BNReluBackwardKernel<true>
+        <<<grid, kThreads, 0, context_.cuda_stream()>>>(
+            N * C, C, inner, inv_M,
+            X.data<float>(), Y.data<float>(), dY.data<float>(),
+            scale.data<float>(), mean, inv_std,
+            dscale->data<float>(), dbias->data<float>(),
+            dX->mutable_data<float>(),
+            Output(RESIDUAL_GRAD)->mutable_data<float>());
+  } else {
+    BNReluBackwardKernel<false>
+        <<<grid, kThreads, 0, context_.cuda_stream()>>>(
+            N * C, C, inner, inv_M,
+            X.data<float>(), Y.data<float>(), dY.data<float>(),
+            scale.data<float>(), mean, inv_std,
+            dscale->data<float>(), dbias->data<float>(),
+            dX->mutable_data<float>(), nullptr);
+  }
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(SpatialBNRelu, SpatialBNReluOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR(
+    SpatialBNReluGradient,
+    SpatialBNReluGradientOp<float, CUDAContext>);
+} // namespace caffe2
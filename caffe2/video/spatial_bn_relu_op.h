@@ -0,0 +1,93 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef SPATIAL_BN_RELU_OP_H_
+#define SPATIAL_BN_RELU_OP_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// Y = max(SpatialBN(X) [+ R], 0) for NCHW X of any number of spatial dims
+// (e.g. N x C x T x H x W), with the inputs, outputs and arguments of
+// SpatialBN plus an optional residual R as a sixth input. The BN output,
+// the sum and the ReLU are one pass over the activation; the gradient masks
+// dY with Y > 0 on the fly instead of materializing the ReLU gradient.
+template <typename T, class Context>
+class SpatialBNReluOp final : public Operator<Context> {
+ public:
+  SpatialBNReluOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        is_test_(OperatorBase::template GetSingleArgument<int>(
+            OpSchema::Arg_IsTest,
+            0)),
+        epsilon_(
+            OperatorBase::template GetSingleArgument<float>("epsilon", 1e-5f)),
+        momentum_(
+            OperatorBase::template GetSingleArgument<float>("momentum", 0.9f)) {
+    CAFFE_ENFORCE(
+        (is_test_ && OutputSize() == 1) || (!is_test_ && OutputSize() == 5));
+    CAFFE_ENFORCE_EQ(
+        OperatorBase::template GetSingleArgument<string>("order", "NCHW"),
+        "NCHW",
+        "SpatialBNRelu only supports NCHW");
+    CAFFE_ENFORCE_GT(epsilon_, 0);
+    CAFFE_ENFORCE_GE(momentum_, 0);
+    CAFFE_ENFORCE_LE(momentum_, 1);
+  }
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  bool RunOnDevice() override;
+
+ protected:
+  bool is_test_;
+  float epsilon_;
+  float momentum_;
+  INPUT_TAGS(INPUT, SCALE, BIAS, EST_MEAN, EST_VAR, RESIDUAL);
+  OUTPUT_TAGS(OUTPUT, RUNNING_MEAN, RUNNING_VAR, SAVED_MEAN, SAVED_INV_STD);
+
+  // a and b of Y = max(a[c] * X + b[c] [+ R], 0), on GPU
+  Tensor<Context> affine_;
+};
+
+// Input: X, scale, Y, dY, saved_mean, saved_inv_std
+// Output: dX, dscale, dbias and dR if the forward had a residual
+template <typename T, class Context>
+class SpatialBNReluGradientOp final : public Operator<Context> {
+ public:
+  SpatialBNReluGradientOp(const OperatorDef& def, Workspace* ws)
+      : Operator<Context>(def, ws) {}
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  bool RunOnDevice() override;
+
+ protected:
+  INPUT_TAGS(INPUT, SCALE, OUTPUT, OUTPUT_GRAD, SAVED_MEAN, SAVED_INV_STD);
+  OUTPUT_TAGS(INPUT_GRAD, SCALE_GRAD, BIAS_GRAD, RESIDUAL_GRAD);
+};
+
+} // namespace caffe2
+
+#endif // SPATIAL_BN_RELU_OP_H_
@@ -0,0 +1,140 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/spatial_bn_relu_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+void AddInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<TIndex>& dims,
+    const float offset) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  float* data = tensor->mutable_data<float>();
+  for (int i = 0; i < tensor->size(); ++i) {
+    // deterministic, of both signs and not sorted
+    data[i] = std::sin(i * 1.7f + offset) * (1.f + offset);
+  }
+}
+
+void RunOp(
+    Workspace* ws,
+    const std::string& type,
+    const std::vector<std::string>& inputs,
+    const std::vector<std::string>& outputs,
+    const int is_test = 0) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  for (const auto& output : outputs) {
+    def.add_output(output);
+  }
+  if (type == "SpatialBN" || type == "SpatialBNRelu") {
+    def.add_arg()->CopyFrom(MakeArgument<int>("is_test", is_test));
+    def.add_arg()->CopyFrom(MakeArgument<float>("momentum", 0.5f));
+  }
+  auto op = CreateOperator(def, ws);
+  ASSERT_TRUE(op->Run());
+}
+
+void ExpectNear(Workspace* ws, const std::string& a, const std::string& b) {
+  const auto& A = ws->GetBlob(a)->Get<TensorCPU>();
+  const auto& B = ws->GetBlob(b)->Get<TensorCPU>();
+  ASSERT_EQ(A.size(), B.size());
+  for (int i = 0; i < A.size(); ++i) {
+    EXPECT_NEAR(A.data<float>()[i], B.data<float>()[i], 1e-4)
+        << a << " vs " << b << " at " << i;
+  }
+}
+
+// N x C x T x H x W with its BN params and a residual
+void AddBlobs(Workspace* ws) {
+  const std::vector<TIndex> dims = {2, 3, 2, 3, 4};
+  AddInput(ws, "X", dims, 0.f);
+  AddInput(ws, "R", dims, 0.5f);
+  AddInput(ws, "dY", dims, 0.25f);
+  AddInput(ws, "scale", {3}, 1.f);
+  AddInput(ws, "bias", {3}, 2.f);
+  for (const std::string& prefix : {"ref", "fused"}) {
+    AddInput(ws, prefix + "_rm", {3}, 3.f);
+    AddInput(ws, prefix + "_rv", {3}, 4.f);
+  }
+  // variances must be positive
+  for (const std::string& name : {"ref_rv", "fused_rv"}) {
+    auto* var = ws->GetBlob(name)->GetMutable<TensorCPU>();
+    for (int i = 0; i < 3; ++i) {
+      var->mutable_data<float>()[i] = i + 1.f;
+    }
+  }
+}
+
+} // namespace
+
+TEST(SpatialBNReluOpTest, MatchesSeparateOps) {
+  for (const bool residual : {false, true}) {
+    Workspace ws;
+    AddBlobs(&ws);
+    RunOp(&ws, "SpatialBN",
+          {"X", "scale", "bias", "ref_rm", "ref_rv"},
+          {"bn", "ref_rm", "ref_rv", "ref_sm", "ref_siv"});
+    if (residual) {
+      RunOp(&ws, "Sum", {"bn", "R"}, {"bn"});
+    }
+    RunOp(&ws, "Relu", {"bn"}, {"Y_ref"});
+    std::vector<std::string> inputs = {"X", "scale", "bias", "fused_rm",
+                                       "fused_rv"};
+    if (residual) {
+      inputs.push_back("R");
+    }
+    RunOp(&ws, "SpatialBNRelu", inputs,
+          {"Y", "fused_rm", "fused_rv", "fused_sm", "fused_siv"});
+    ExpectNear(&ws, "Y", "Y_ref");
+    ExpectNear(&ws, "fused_rm", "ref_rm");
+    ExpectNear(&ws, "fused_rv", "ref_rv");
+    ExpectNear(&ws, "fused_sm", "ref_sm");
+    ExpectNear(&ws, "fused_siv", "ref_siv");
+
+    // the gradient of the ReLU feeds both the BN and the residual
+    RunOp(&ws, "ReluGradient", {"Y_ref", "dY"}, {"dbn"});
+    RunOp(&ws, "SpatialBNGradient",
+          {"X", "scale", "dbn", "ref_sm", "ref_siv"},
+          {"dX_ref", "dscale_ref", "dbias_ref"});
+    std::vector<std::string> grads = {"dX", "dscale", "dbias"};
+    if (residual) {
+      grads.push_back("dR");
+    }
+    RunOp(&ws, "SpatialBNReluGradient",
+          {"X", "scale", "Y", "dY", "fused_sm", "fused_siv"}, grads);
+    ExpectNear(&ws, "dX", "dX_ref");
+    ExpectNear(&ws, "dscale", "dscale_ref");
+    ExpectNear(&ws, "dbias", "dbias_ref");
+    if (residual) {
+      ExpectNear(&ws, "dR", "dbn");
+    }
+  }
+}
+
+TEST(SpatialBNReluOpTest, TestMode) {
+  Workspace ws;
+  AddBlobs(&ws);
+  RunOp(&ws, "SpatialBN",
+        {"X", "scale", "bias", "ref_rm", "ref_rv"}, {"bn"}, 1);
+  RunOp(&ws, "Sum", {"bn", "R"}, {"bn"});
+  RunOp(&ws, "Relu", {"bn"}, {"Y_ref"});
+  // in place of the residual
+  RunOp(&ws, "SpatialBNRelu",
+        {"X", "scale", "bias", "fused_rm", "fused_rv", "R"}, {"R"}, 1);
+  ExpectNear(&ws, "R", "Y_ref");
+}
+
+} // namespace caffe2
@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/sum_relu_op.h"
+
+namespace caffe2 {
+
+template <>
+bool SumReluOp<float, CPUContext>::RunOnDevice() {
+  auto& X0 = Input(0);
+  auto* Y = Output(0);
+  for (int i = 1; i < InputSize(); ++i) {
+    CAFFE_ENFORCE(
+        Input(i).dims() == X0.dims(),
+        "SumRelu inputs need the same shape, input ",
+        i,
+        " differs from input 0");
+  }
+  Y->ResizeLike(X0);
+  const int size = X0.size();
+  EigenVectorArrayMap<float> y(Y->mutable_data<float>(), size);
+  ConstEigenVectorArrayMap<float> x0(X0.data<float>(), size);
+  if (InputSize() == 1) {
+    y = x0.cwiseMax(0.f);
+    return true;
+  }
+  // the ReLU goes with the last add, so two inputs (the residual case) are
+  // a single pass
+  for (int i = 1; i < InputSize(); ++i) {
+    ConstEigenVectorArrayMap<float> acc(
+        i == 1 ? X0.data<float>() : Y->data<float>(), size);
+    ConstEigenVectorArrayMap<float> x(Input(i).data<float>(), size);
+    if (i + 1 < InputSize()) {
+      y = acc + x;
+    } else {
+      y = (acc + x).cwiseMax(0.f);
+    }
+  }
+  return true;
+}
+
+template <>
+bool SumReluGradientOp<float, CPUContext>::RunOnDevice() {
+  auto& Y = Input(0);
+  auto& dY = Input(1);
+  CAFFE_ENFORCE_EQ(dY.size(), Y.size());
+  const int size = Y.size();
+  ConstEigenVectorArrayMap<float> y(Y.data<float>(), size);
+  ConstEigenVectorArrayMap<float> dy(dY.data<float>(), size);
+  // the first output may be dY itself, so it is written last
+  for (int i = OutputSize() - 1; i >= 0; --i) {
+    auto* dX = Output(i);
+    dX->ResizeLike(dY);
+    EigenVectorArrayMap<float>(dX->mutable_data<float>(), size) =
+        (y > 0.f).select(dy, 0.f);
+  }
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(SumRelu, SumReluOp<float, CPUContext>);
+REGISTER_CPU_OPERATOR(SumReluGradient,
+                      SumReluGradientOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(SumRelu)
+    .NumInputs(1, INT_MAX)
+    .NumOutputs(1)
+    .AllowInplace({{0, 0}})
+    .IdenticalTypeAndShapeOfInput(0)
+    .SetDoc(R"DOC(
+Element-wise sum of the input tensors followed by a ReLU, computed in one
+pass: Y = max(data_0 + ... + data_{n-1}, 0). All inputs must have the same
+shape; the first one can be used in place as the output. Written by the
+FuseSumRelu transform for Sum -> Relu chains.
+)DOC")
+    .Input(0, "data_0", "First of the input tensors")
+    .Output(0, "Y", "Output tensor, same shape as the inputs");
+// Input: Y, dY; Output: dX_0, ..., dX_{n-1}
+OPERATOR_SCHEMA(SumReluGradient)
+    .NumInputs(2)
+    .NumOutputs(1, INT_MAX)
+    .AllowInplace({{1, 0}});
+
+class GetSumReluGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    vector<string> grad_inputs;
+    for (int i = 0; i < def_.input_size(); ++i) {
+      grad_inputs.push_back(GI(i));
+    }
+    return SingleGradientDef(
+        "SumReluGradient", "", vector<string>{O(0), GO(0)}, grad_inputs);
+  }
+};
+
+REGISTER_GRADIENT(SumRelu, GetSumReluGradient);
+
+} // namespace caffe2
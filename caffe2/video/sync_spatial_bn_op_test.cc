@@ -0,0 +1,175 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/sync_spatial_bn_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+constexpr int kDevices = 2;
+
+void AddInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<TIndex>& dims,
+    const float offset) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  float* data = tensor->mutable_data<float>();
+  for (int i = 0; i < tensor->size(); ++i) {
+    // deterministic, of both signs and not sorted
+    data[i] = std::sin(i * 1.7f + offset) * (1.f + offset);
+  }
+}
+
+// the d-th of kDevices equal slices of the batch of name
+void AddSlice(Workspace* ws, const std::string& name, const int d) {
+  const auto& full = ws->GetBlob(name)->Get<TensorCPU>();
+  auto dims = full.dims();
+  dims[0] /= kDevices;
+  auto* slice = ws->CreateBlob(name + std::to_string(d))
+                    ->GetMutable<TensorCPU>();
+  slice->Resize(dims);
+  const float* src = full.data<float>() + d * slice->size();
+  float* dst = slice->mutable_data<float>();
+  for (int i = 0; i < slice->size(); ++i) {
+    dst[i] = src[i];
+  }
+}
+
+void RunOp(
+    Workspace* ws,
+    const std::string& type,
+    const std::vector<std::string>& inputs,
+    const std::vector<std::string>& outputs) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  for (const auto& output : outputs) {
+    def.add_output(output);
+  }
+  if (type == "SpatialBN") {
+    def.add_arg()->CopyFrom(MakeArgument<int>("is_test", 0));
+  }
+  if (type == "SpatialBN" || type == "SyncSpatialBN") {
+    def.add_arg()->CopyFrom(MakeArgument<float>("momentum", 0.5f));
+  }
+  if (type == "SyncSpatialBN" || type == "SyncSpatialBNGradient") {
+    def.add_arg()->CopyFrom(MakeArgument<int>("num_batches", kDevices));
+  }
+  auto op = CreateOperator(def, ws);
+  ASSERT_TRUE(op->Run());
+}
+
+void CopyBlob(Workspace* ws, const std::string& src, const std::string& dst) {
+  ws->CreateBlob(dst)->GetMutable<TensorCPU>()->CopyFrom(
+      ws->GetBlob(src)->Get<TensorCPU>());
+}
+
+// c = a + b, elementwise
+void AddBlobs(
+    Workspace* ws,
+    const std::string& a,
+    const std::string& b,
+    const std::string& c) {
+  const auto& A = ws->GetBlob(a)->Get<TensorCPU>();
+  const auto& B = ws->GetBlob(b)->Get<TensorCPU>();
+  ASSERT_EQ(A.size(), B.size());
+  auto* C = ws->CreateBlob(c)->GetMutable<TensorCPU>();
+  C->ResizeLike(A);
+  for (int i = 0; i < A.size(); ++i) {
+    C->mutable_data<float>()[i] = A.data<float>()[i] + B.data<float>()[i];
+  }
+}
+
+void ExpectNear(
+    Workspace* ws,
+    const std::string& a,
+    const std::string& b,
+    const int offset = 0) {
+  const auto& A = ws->GetBlob(a)->Get<TensorCPU>();
+  const auto& B = ws->GetBlob(b)->Get<TensorCPU>();
+  ASSERT_LE(A.size() + offset, B.size());
+  for (int i = 0; i < A.size(); ++i) {
+    EXPECT_NEAR(A.data<float>()[i], B.data<float>()[i + offset], 1e-4)
+        << a << " vs " << b << " at " << i;
+  }
+}
+
+} // namespace
+
+// kDevices SyncSpatialBN on the slices of a batch, with the statistics of
+// the slices summed as data_parallel_model does, match SpatialBN on the
+// whole batch.
+TEST(SyncSpatialBNOpTest, MatchesSpatialBNOfTheGroup) {
+  Workspace ws;
+  AddInput(&ws, "X", {4, 3, 2, 3, 4}, 0.f);
+  AddInput(&ws, "dY", {4, 3, 2, 3, 4}, 0.25f);
+  AddInput(&ws, "scale", {3}, 1.f);
+  AddInput(&ws, "bias", {3}, 2.f);
+  AddInput(&ws, "rm", {3}, 3.f);
+  AddInput(&ws, "rv", {3}, 4.f);
+  auto* rv = ws.GetBlob("rv")->GetMutable<TensorCPU>();
+  for (int i = 0; i < 3; ++i) {
+    rv->mutable_data<float>()[i] = i + 1.f;
+  }
+  for (int d = 0; d < kDevices; ++d) {
+    AddSlice(&ws, "X", d);
+    AddSlice(&ws, "dY", d);
+    const std::string dev = std::to_string(d);
+    CopyBlob(&ws, "rm", "rm" + dev);
+    CopyBlob(&ws, "rv", "rv" + dev);
+    RunOp(&ws, "ChannelStats", {"X" + dev}, {"sums" + dev, "sumsq" + dev});
+  }
+  RunOp(&ws, "SpatialBN",
+        {"X", "scale", "bias", "rm", "rv"},
+        {"Y", "rm", "rv", "sm", "siv"});
+  RunOp(&ws, "SpatialBNGradient",
+        {"X", "scale", "dY", "sm", "siv"},
+        {"dX", "dscale", "dbias"});
+
+  AddBlobs(&ws, "sums0", "sums1", "sums");
+  AddBlobs(&ws, "sumsq0", "sumsq1", "sumsq");
+  for (int d = 0; d < kDevices; ++d) {
+    const std::string dev = std::to_string(d);
+    RunOp(&ws, "SyncSpatialBN",
+          {"X" + dev, "scale", "bias", "rm" + dev, "rv" + dev, "sums",
+           "sumsq"},
+          {"Y" + dev, "rm" + dev, "rv" + dev, "sm" + dev, "siv" + dev});
+    ExpectNear(&ws, "Y" + dev, "Y", d * 144);
+    ExpectNear(&ws, "rm" + dev, "rm");
+    ExpectNear(&ws, "rv" + dev, "rv");
+    ExpectNear(&ws, "sm" + dev, "sm");
+    ExpectNear(&ws, "siv" + dev, "siv");
+    RunOp(&ws, "ChannelBackpropStats",
+          {"X" + dev, "sm" + dev, "siv" + dev, "dY" + dev},
+          {"dscale" + dev, "dbias" + dev});
+  }
+
+  AddBlobs(&ws, "dscale0", "dscale1", "dscale_sum");
+  AddBlobs(&ws, "dbias0", "dbias1", "dbias_sum");
+  for (int d = 0; d < kDevices; ++d) {
+    const std::string dev = std::to_string(d);
+    CopyBlob(&ws, "dscale_sum", "dscale" + dev);
+    CopyBlob(&ws, "dbias_sum", "dbias" + dev);
+    RunOp(&ws, "SyncSpatialBNGradient",
+          {"X" + dev, "scale", "dY" + dev, "sm" + dev, "siv" + dev,
+           "dscale" + dev, "dbias" + dev},
+          {"dX" + dev, "dscale" + dev, "dbias" + dev});
+    ExpectNear(&ws, "dX" + dev, "dX", d * 144);
+  }
+  // the parameter gradients add up to the ones of the group
+  AddBlobs(&ws, "dscale0", "dscale1", "dscale_group");
+  AddBlobs(&ws, "dbias0", "dbias1", "dbias_group");
+  ExpectNear(&ws, "dscale_group", "dscale");
+  ExpectNear(&ws, "dbias_group", "dbias");
+}
+
+} // namespace caffe2
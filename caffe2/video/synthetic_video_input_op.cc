@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/synthetic_video_input_op.h"
+
+namespace caffe2 {
+
+REGISTER_CPU_OPERATOR(SyntheticVideoInput, SyntheticVideoInputOp<CPUContext>);
+
+OPERATOR_SCHEMA(SyntheticVideoInput)
+    .NumInputs(0, 1)
+    .NumOutputs({2, 3, 4, 5})
+    .TensorInferenceFunction([](
+        const OperatorDef& def,
+        const vector<TensorShape>& /* unused */ in) {
+      vector<TensorShape> out(def.output_size());
+      ArgumentHelper helper(def);
+      const int batch_size = helper.GetSingleArgument<int>("batch_size", 0);
+      const int length = helper.GetSingleArgument<int>("length", 0);
+      const int crop = helper.GetSingleArgument<int>("crop", -1);
+      const int height = crop > 0
+          ? crop
+          : std::max(helper.GetSingleArgument<int>("height", 0), 224);
+      const int width = crop > 0
+          ? crop
+          : std::max(helper.GetSingleArgument<int>("width", 0), 224);
+      const bool gpu_transform =
+          helper.GetSingleArgument<int>("use_gpu_transform", 0);
+      const bool raw_clips =
+          gpu_transform && def.device_option().device_type() == CPU;
+      const bool nhwc = !raw_clips &&
+          helper.GetSingleArgument<string>("order", "NCHW") == "NHWC";
+      TensorProto::DataType clip_type = TensorProto::FLOAT;
+      if (raw_clips) {
+        clip_type = TensorProto::UINT8;
+      } else if (gpu_transform) {
+        clip_type = cast::GetCastDataType(helper, "output_type");
+      }
+      out[0] = CreateTensorShape(
+          nhwc ? vector<int>{batch_size, length, height, width, 3}
+               : vector<int>{batch_size, 3, length, height, width},
+          clip_type);
+      if (helper.GetSingleArgument<int>("multiple_label", 0)) {
+        out[1] = CreateTensorShape(
+            vector<int>{batch_size,
+                        helper.GetSingleArgument<int>("num_of_labels", 0)},
+            TensorProto::INT32);
+      } else {
+        out[1] = CreateTensorShape(vector<int>{batch_size}, TensorProto::INT32);
+      }
+      if (helper.GetSingleArgument<int>("output_clip_index", 0)) {
+        out[2] =
+            CreateTensorShape(vector<int>{batch_size}, TensorProto::INT32);
+        out[3] =
+            CreateTensorShape(vector<int>{batch_size, 2}, TensorProto::INT32);
+      }
+      if (raw_clips) {
+        out.back() =
+            CreateTensorShape(vector<int>{batch_size}, TensorProto::INT32);
+      }
+      return out;
+    })
+    .SetDoc(R"DOC(
+Outputs what CustomizedVideoInput with the same arguments outputs, generated
+once on the device of the op without reading or decoding any video, so that
+the compute of a net can be timed apart from its input pipeline. Every run
+outputs the same tensors. The clips are random pixels in [0, 255], or `value`
+with `constant`, normalized with `mean` and `std` unless they are uint8. A
+reader input, if given, is not used.
+)DOC")
+    .Arg("batch_size", "clips per batch")
+    .Arg("length", "frames per clip")
+    .Arg("crop", "height and width of the clips; <= 0 for uncropped clips")
+    .Arg("height", "height of the uncropped clips, at least 224")
+    .Arg("width", "width of the uncropped clips, at least 224")
+    .Arg("mean", "mean of the normalization")
+    .Arg("std", "std of the normalization")
+    .Arg("multiple_label", "output a binary vector of labels per clip")
+    .Arg("num_of_labels", "length of the label vectors of multiple_label")
+    .Arg("num_classes", "labels are drawn from [0, num_classes), default 1")
+    .Arg("output_clip_index", "also output video ids and clip indices")
+    .Arg(
+        "use_gpu_transform",
+        "CPU: output uint8 clips and mirror flags; CUDA: clips of output_type")
+    .Arg("output_type", "float, float16 or uint8 clips of use_gpu_transform")
+    .Arg("order", "NCHW or NHWC clips")
+    .Arg("constant", "fill the clips with value, the labels with 0")
+    .Arg("value", "pixel value of constant, default 128")
+    .Arg("seed", "seed of the random tensors")
+    .Output(0, "clips", "N x C x T x H x W, or N x T x H x W x C for NHWC")
+    .Output(1, "labels", "N, or N x num_of_labels with multiple_label");
+
+NO_GRADIENT(SyntheticVideoInput);
+
+} // namespace caffe2
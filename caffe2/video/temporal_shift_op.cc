@@ -0,0 +1,146 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <cstring>
+
+#include "caffe2/video/temporal_shift_op.h"
+
+namespace caffe2 {
+
+template <>
+void TemporalShift<CPUContext>(
+    const int N,
+    const int C,
+    const int T,
+    const int HW,
+    const int fold,
+    const bool reverse,
+    const float* X,
+    float* Y,
+    CPUContext* /*context*/) {
+  // a channel of a clip is T contiguous frames, so its shift is a move of
+  // T - 1 frames by one frame and a frame of zeros; memmove takes the
+  // overlap of the in-place shift
+  const size_t frames = static_cast<size_t>(T - 1) * HW * sizeof(float);
+#pragma omp parallel for
+  for (int nc = 0; nc < N * C; ++nc) {
+    const int offset = TemporalShiftOffset(nc % C, fold, reverse);
+    const float* x = X + static_cast<size_t>(nc) * T * HW;
+    float* y = Y + static_cast<size_t>(nc) * T * HW;
+    if (offset == 0) {
+      if (x != y) {
+        std::memcpy(y, x, static_cast<size_t>(T) * HW * sizeof(float));
+      }
+    } else if (offset > 0) {
+      std::memmove(y, x + HW, frames);
+      std::memset(y + (T - 1) * HW, 0, HW * sizeof(float));
+    } else {
+      std::memmove(y + HW, x, frames);
+      std::memset(y, 0, HW * sizeof(float));
+    }
+  }
+}
+
+REGISTER_CPU_OPERATOR(TemporalShift, TemporalShiftOp<float, CPUContext, false>);
+REGISTER_CPU_OPERATOR(
+    TemporalShiftGradient,
+    TemporalShiftOp<float, CPUContext, true>);
+REGISTER_CPU_OPERATOR(
+    TemporalShiftConv,
+    TemporalShiftConvOp<float, CPUContext>);
+REGISTER_CPU_OPERATOR(
+    TemporalShiftConvGradient,
+    TemporalShiftConvGradientOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(TemporalShift)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .AllowInplace({{0, 0}})
+    .IdenticalTypeAndShape()
+    .SetDoc(R"DOC(
+Shifts the channels of X (N x C x T x H x W) along time, as in temporal shift
+modules: channels [0, C / shift_div) take the next frame, channels
+[C / shift_div, 2 C / shift_div) the previous frame and the others keep their
+own; the frames shifted in from past the ends of the clip are zeros. The 2D
+convs after it then mix neighbouring frames at no cost in FLOPs or params.
+)DOC")
+    .Arg("shift_div", "1 / the fraction of the channels shifted each way "
+                      "(default 8)")
+    .Input(0, "X", "N x C x T x H x W")
+    .Output(0, "Y", "the shifted X, may be X");
+
+OPERATOR_SCHEMA(TemporalShiftGradient)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .AllowInplace({{0, 0}});
+
+OPERATOR_SCHEMA(TemporalShiftConv)
+    .NumInputs(2, 3)
+    .NumOutputs(1)
+    .SetDoc(R"DOC(
+The TemporalShift of X and the 1 x 1 x 1 conv after it in one op,
+Y = W * shift(X) + b. The conv reads X at the shifted frames directly, so the
+shifted X is never made.
+)DOC")
+    .Arg("shift_div", "as in TemporalShift")
+    .Input(0, "X", "N x C x T x H x W")
+    .Input(1, "W", "M x C x 1 x 1 x 1")
+    .Input(2, "b", "optional M biases")
+    .Output(0, "Y", "N x M x T x H x W");
+
+OPERATOR_SCHEMA(TemporalShiftConvGradient)
+    .NumInputs(3)
+    .NumOutputs(2, 3);
+
+class GetTemporalShiftGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    return SingleGradientDef(
+        "TemporalShiftGradient", "",
+        vector<string>{GO(0)},
+        vector<string>{GI(0)});
+  }
+};
+
+class GetTemporalShiftConvGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    if (def_.input_size() == 3) {
+      return SingleGradientDef(
+          "TemporalShiftConvGradient", "",
+          vector<string>{I(0), I(1), GO(0)},
+          vector<string>{GI(0), GI(1), GI(2)});
+    }
+    return SingleGradientDef(
+        "TemporalShiftConvGradient", "",
+        vector<string>{I(0), I(1), GO(0)},
+        vector<string>{GI(0), GI(1)},
+        vector<Argument>{MakeArgument<int>("no_bias", 1)});
+  }
+};
+
+REGISTER_GRADIENT(TemporalShift, GetTemporalShiftGradient);
+REGISTER_GRADIENT(TemporalShiftConv, GetTemporalShiftConvGradient);
+
+} // namespace caffe2
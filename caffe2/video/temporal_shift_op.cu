@@ -0,0 +1,108 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/video/temporal_shift_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// TemporalShiftOffset on the device
+__device__ inline int
+ShiftOffset(const int c, const int fold, const bool reverse) {
+  const int offset = c < fold ? 1 : (c < 2 * fold ? -1 : 0);
+  return reverse ? -offset : offset;
+}
+
+// a thread per (n, c, hw) column, walking its T frames in the order that
+// reads a frame before it is written, so that X may be Y
+__global__ void TemporalShiftKernel(
+    const int count,
+    const int C,
+    const int T,
+    const int HW,
+    const int fold,
+    const bool reverse,
+    const float* X,
+    float* Y) {
+  CUDA_1D_KERNEL_LOOP(index, count) {
+    const int nc = index / HW;
+    const int offset = ShiftOffset(nc % C, fold, reverse);
+    const int base = nc * T * HW + index % HW;
+    if (offset == 0) {
+      if (X != Y) {
+        for (int t = 0; t < T; ++t) {
+          Y[base + t * HW] = X[base + t * HW];
+        }
+      }
+    } else if (offset > 0) {
+      for (int t = 0; t < T - 1; ++t) {
+        Y[base + t * HW] = X[base + (t + 1) * HW];
+      }
+      Y[base + (T - 1) * HW] = 0.f;
+    } else {
+      for (int t = T - 1; t > 0; --t) {
+        Y[base + t * HW] = X[base + (t - 1) * HW];
+      }
+      Y[base] = 0.f;
+    }
+  }
+}
+
+} // namespace
+
+template <>
+void TemporalShift<CUDAContext>(
+    const int N,
+    const int C,
+    const int T,
+    const int HW,
+    const int fold,
+    const bool reverse,
+    const float* X,
+    float* Y,
+    CUDAContext* context) {
+  const int count = N * C * HW;
+  TemporalShiftKernel<<<
+      CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(count, C, T, HW, fold, reverse, X, Y);
+}
+
+REGISTER_CUDA_OPERATOR(
+    TemporalShift,
+    TemporalShiftOp<float, CUDAContext, false>);
+REGISTER_CUDA_OPERATOR(
+    TemporalShiftGradient,
+    TemporalShiftOp<float, CUDAContext, true>);
+REGISTER_CUDA_OPERATOR(
+    TemporalShiftConv,
+    TemporalShiftConvOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR(
+    TemporalShiftConvGradient,
+    TemporalShiftConvGradientOp<float, CUDAContext>);
+
+} // namespace caffe2
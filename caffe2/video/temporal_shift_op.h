@@ -0,0 +1,257 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef TEMPORAL_SHIFT_OP_H_
+#define TEMPORAL_SHIFT_OP_H_
+
+#include <vector>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// The frame offset that channel c of a temporal shift reads: the first fold
+// channels read the next frame, the next fold channels the previous one and
+// the others their own frame. reverse negates it, for the gradient.
+inline int
+TemporalShiftOffset(const int c, const int fold, const bool reverse) {
+  const int offset = c < fold ? 1 : (c < 2 * fold ? -1 : 0);
+  return reverse ? -offset : offset;
+}
+
+// Y[n, c, t] = X[n, c, t + offset(c)], 0 past the ends of the clip, of
+// N x C x T x HW blobs; X may be Y.
+template <class Context>
+void TemporalShift(
+    const int N,
+    const int C,
+    const int T,
+    const int HW,
+    const int fold,
+    const bool reverse,
+    const float* X,
+    float* Y,
+    Context* context);
+
+// Shifts 1/shift_div of the channels of X (N x C x T x H x W) a frame back in
+// time and 1/shift_div a frame forward, with zeros at the ends of the clips,
+// as in temporal shift modules: the 2D convs after it then mix the frames at
+// no cost in FLOPs or params. Works in place. The gradient is the opposite
+// shift.
+template <typename T, class Context, bool kReverse>
+class TemporalShiftOp final : public Operator<Context> {
+ public:
+  TemporalShiftOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        shift_div_(OperatorBase::GetSingleArgument<int>("shift_div", 8)) {
+    CAFFE_ENFORCE_GE(shift_div_, 2, "shift_div needs to be at least 2");
+  }
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+
+  bool RunOnDevice() override {
+    const auto& X = Input(0);
+    auto* Y = Output(0);
+    CAFFE_ENFORCE_EQ(X.ndim(), 5, "TemporalShift needs N x C x T x H x W");
+    Y->ResizeLike(X);
+    TemporalShift<Context>(
+        X.dim32(0), X.dim32(1), X.dim32(2), X.dim32(3) * X.dim32(4),
+        X.dim32(1) / shift_div_, kReverse, X.template data<float>(),
+        Y->template mutable_data<float>(), &context_);
+    return true;
+  }
+
+ protected:
+  int shift_div_;
+};
+
+// The channel ranges [begin, end) of a shift that read the same frame offset,
+// with their offset.
+struct TemporalShiftBlock {
+  int begin, end, offset;
+};
+
+inline std::vector<TemporalShiftBlock> TemporalShiftBlocks(
+    const int C,
+    const int fold) {
+  return {{0, fold, 1}, {fold, 2 * fold, -1}, {2 * fold, C, 0}};
+}
+
+// The temporal shift of X and the 1 x 1 x 1 conv after it in one op:
+//   Y = W * shift(X) + b,
+// with W (M x C x 1 x 1 x 1) and b (M, optional). Every frame of Y is a
+// GEMM per block of channels of the shift that reads X at the shifted
+// frames directly, so the shifted X is never made.
+template <typename T, class Context>
+class TemporalShiftConvOp final : public Operator<Context> {
+ public:
+  TemporalShiftConvOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        shift_div_(OperatorBase::GetSingleArgument<int>("shift_div", 8)) {
+    CAFFE_ENFORCE_GE(shift_div_, 2, "shift_div needs to be at least 2");
+  }
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+
+  bool RunOnDevice() override {
+    const auto& X = Input(0);
+    const auto& W = Input(1);
+    auto* Y = Output(0);
+    CAFFE_ENFORCE_EQ(X.ndim(), 5, "TemporalShiftConv needs N x C x T x H x W");
+    const int N = X.dim32(0);
+    const int C = X.dim32(1);
+    const int Tdim = X.dim32(2);
+    const int HW = X.dim32(3) * X.dim32(4);
+    const int M = W.dim32(0);
+    CAFFE_ENFORCE_EQ(W.size(), M * C, "W needs to be M x C x 1 x 1 x 1");
+    const bool has_bias = InputSize() == 3;
+    Y->Resize(std::vector<TIndex>{N, M, Tdim, X.dim32(3), X.dim32(4)});
+    if (has_bias) {
+      CAFFE_ENFORCE_EQ(Input(2).size(), M);
+      ones_.Resize(HW);
+      math::Set<float, Context>(
+          HW, 1.f, ones_.template mutable_data<float>(), &context_);
+    }
+    const auto blocks = TemporalShiftBlocks(C, C / shift_div_);
+    for (int n = 0; n < N; ++n) {
+      const float* Xn = X.template data<float>() + n * C * Tdim * HW;
+      float* Yn = Y->template mutable_data<float>() + n * M * Tdim * HW;
+      for (int t = 0; t < Tdim; ++t) {
+        float* Yt = Yn + t * HW;
+        bool first = true;
+        for (const auto& block : blocks) {
+          const int t_in = t + block.offset;
+          if (block.end == block.begin || t_in < 0 || t_in >= Tdim) {
+            continue;
+          }
+          math::GemmEx<float, Context>(
+              CblasNoTrans, CblasNoTrans, M, HW, block.end - block.begin,
+              1.f, W.template data<float>() + block.begin, C,
+              Xn + (block.begin * Tdim + t_in) * HW, Tdim * HW,
+              first ? 0.f : 1.f, Yt, Tdim * HW, &context_);
+          first = false;
+        }
+        if (first) {
+          // all the channels read past the ends of the clip
+          for (int m = 0; m < M; ++m) {
+            math::Set<float, Context>(HW, 0.f, Yt + m * Tdim * HW, &context_);
+          }
+        }
+        if (has_bias) {
+          math::GemmEx<float, Context>(
+              CblasNoTrans, CblasNoTrans, M, HW, 1, 1.f,
+              Input(2).template data<float>(), 1, ones_.template data<float>(),
+              HW, 1.f, Yt, Tdim * HW, &context_);
+        }
+      }
+    }
+    return true;
+  }
+
+ protected:
+  int shift_div_;
+  Tensor<Context> ones_;
+};
+
+// Inputs: X, W, dY. Outputs: dX, dW and db (unless no_bias).
+template <typename T, class Context>
+class TemporalShiftConvGradientOp final : public Operator<Context> {
+ public:
+  TemporalShiftConvGradientOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        shift_div_(OperatorBase::GetSingleArgument<int>("shift_div", 8)),
+        no_bias_(OperatorBase::GetSingleArgument<int>("no_bias", 0)) {}
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+
+  bool RunOnDevice() override {
+    const auto& X = Input(0);
+    const auto& W = Input(1);
+    const auto& dY = Input(2);
+    const int N = X.dim32(0);
+    const int C = X.dim32(1);
+    const int Tdim = X.dim32(2);
+    const int HW = X.dim32(3) * X.dim32(4);
+    const int M = W.dim32(0);
+    CAFFE_ENFORCE_EQ(dY.size(), N * M * Tdim * HW);
+    auto* dX = Output(0);
+    auto* dW = Output(1);
+    dX->ResizeLike(X);
+    dW->ResizeLike(W);
+    float* dX_data = dX->template mutable_data<float>();
+    float* dW_data = dW->template mutable_data<float>();
+    math::Set<float, Context>(dX->size(), 0.f, dX_data, &context_);
+    math::Set<float, Context>(dW->size(), 0.f, dW_data, &context_);
+    float* db = nullptr;
+    if (!no_bias_) {
+      auto* dbias = Output(2);
+      dbias->Resize(M);
+      db = dbias->template mutable_data<float>();
+      math::Set<float, Context>(M, 0.f, db, &context_);
+      ones_.Resize(HW);
+      math::Set<float, Context>(
+          HW, 1.f, ones_.template mutable_data<float>(), &context_);
+    }
+    const auto blocks = TemporalShiftBlocks(C, C / shift_div_);
+    for (int n = 0; n < N; ++n) {
+      const float* Xn = X.template data<float>() + n * C * Tdim * HW;
+      float* dXn = dX_data + n * C * Tdim * HW;
+      const float* dYn = dY.template data<float>() + n * M * Tdim * HW;
+      for (int t = 0; t < Tdim; ++t) {
+        const float* dYt = dYn + t * HW;
+        for (const auto& block : blocks) {
+          const int t_in = t + block.offset;
+          const int width = block.end - block.begin;
+          if (width == 0 || t_in < 0 || t_in >= Tdim) {
+            continue;
+          }
+          const int x_offset = (block.begin * Tdim + t_in) * HW;
+          math::GemmEx<float, Context>(
+              CblasNoTrans, CblasTrans, M, width, HW, 1.f, dYt, Tdim * HW,
+              Xn + x_offset, Tdim * HW, 1.f, dW_data + block.begin, C,
+              &context_);
+          math::GemmEx<float, Context>(
+              CblasTrans, CblasNoTrans, width, HW, M, 1.f,
+              W.template data<float>() + block.begin, C, dYt, Tdim * HW, 1.f,
+              dXn + x_offset, Tdim * HW, &context_);
+        }
+        if (db) {
+          math::GemmEx<float, Context>(
+              CblasNoTrans, CblasNoTrans, M, 1, HW, 1.f, dYt, Tdim * HW,
+              ones_.template data<float>(), 1, 1.f, db, 1, &context_);
+        }
+      }
+    }
+    return true;
+  }
+
+ protected:
+  int shift_div_;
+  bool no_bias_;
+  Tensor<Context> ones_;
+};
+
+} // namespace caffe2
+
+#endif // TEMPORAL_SHIFT_OP_H_
@@ -0,0 +1,149 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/operator_gradient.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/temporal_shift_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// a 2 x 8 x 4 x 3 x 2 input, shift_div 4: channels 0-1 read the next frame,
+// 2-3 the previous one
+constexpr int kN = 2;
+constexpr int kC = 8;
+constexpr int kT = 4;
+constexpr int kHW = 6;
+constexpr int kM = 3;
+
+void AddRandomInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<TIndex>& dims,
+    const int seed) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  for (int i = 0; i < tensor->size(); ++i) {
+    tensor->mutable_data<float>()[i] = dist(gen);
+  }
+}
+
+OperatorDef MakeOp(
+    const std::string& type,
+    const std::vector<std::string>& inputs,
+    const std::string& output) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  def.add_output(output);
+  if (type != "Conv") {
+    def.add_arg()->CopyFrom(MakeArgument<int>("shift_div", 4));
+  }
+  return def;
+}
+
+const TensorCPU& Get(Workspace* ws, const std::string& name) {
+  return ws->GetBlob(name)->Get<TensorCPU>();
+}
+
+void ExpectNear(const TensorCPU& actual, const TensorCPU& expected,
+                const std::string& name) {
+  ASSERT_EQ(actual.dims(), expected.dims()) << name;
+  for (int i = 0; i < actual.size(); ++i) {
+    EXPECT_NEAR(actual.data<float>()[i], expected.data<float>()[i], 1e-5)
+        << name << " " << i;
+  }
+}
+
+void RunGradient(Workspace* ws, const OperatorDef& def) {
+  GradientWrapper dY;
+  dY.dense_ = def.output(0) + "_grad";
+  const auto meta = GetGradientForOp(def, {dY});
+  ASSERT_EQ(meta.ops_.size(), 1);
+  ASSERT_TRUE(CreateOperator(meta.ops_[0], ws)->Run());
+}
+
+} // namespace
+
+TEST(TemporalShiftOpTest, ShiftsTheChannelFolds) {
+  Workspace ws;
+  AddRandomInput(&ws, "X", {kN, kC, kT, 3, 2}, 1);
+  ASSERT_TRUE(CreateOperator(MakeOp("TemporalShift", {"X"}, "Y"), &ws)->Run());
+  const float* x = Get(&ws, "X").data<float>();
+  const float* y = Get(&ws, "Y").data<float>();
+  for (int nc = 0; nc < kN * kC; ++nc) {
+    const int c = nc % kC;
+    const int offset = c < 2 ? 1 : (c < 4 ? -1 : 0);
+    for (int t = 0; t < kT; ++t) {
+      for (int i = 0; i < kHW; ++i) {
+        const int t_in = t + offset;
+        const float expected = t_in < 0 || t_in >= kT
+            ? 0.f
+            : x[(nc * kT + t_in) * kHW + i];
+        EXPECT_EQ(y[(nc * kT + t) * kHW + i], expected) << nc << " " << t;
+      }
+    }
+  }
+  // in place
+  ws.CreateBlob("Z")->GetMutable<TensorCPU>()->CopyFrom(Get(&ws, "X"));
+  ASSERT_TRUE(CreateOperator(MakeOp("TemporalShift", {"Z"}, "Z"), &ws)->Run());
+  ExpectNear(Get(&ws, "Z"), Get(&ws, "Y"), "in place");
+}
+
+TEST(TemporalShiftOpTest, GradientIsTheAdjoint) {
+  Workspace ws;
+  AddRandomInput(&ws, "X", {kN, kC, kT, 3, 2}, 1);
+  AddRandomInput(&ws, "Y_grad", {kN, kC, kT, 3, 2}, 2);
+  const auto def = MakeOp("TemporalShift", {"X"}, "Y");
+  ASSERT_TRUE(CreateOperator(def, &ws)->Run());
+  RunGradient(&ws, def);
+  // <shift(X), dY> == <X, dX>
+  const auto& X = Get(&ws, "X");
+  double forward = 0, backward = 0;
+  for (int i = 0; i < X.size(); ++i) {
+    forward += Get(&ws, "Y").data<float>()[i] *
+        Get(&ws, "Y_grad").data<float>()[i];
+    backward += X.data<float>()[i] * Get(&ws, "X_grad").data<float>()[i];
+  }
+  EXPECT_NEAR(forward, backward, 1e-4);
+}
+
+TEST(TemporalShiftOpTest, ShiftConvMatchesShiftAndConv) {
+  Workspace ws;
+  AddRandomInput(&ws, "X", {kN, kC, kT, 3, 2}, 1);
+  AddRandomInput(&ws, "W", {kM, kC, 1, 1, 1}, 2);
+  AddRandomInput(&ws, "b", {kM}, 3);
+  const auto shift = MakeOp("TemporalShift", {"X"}, "shifted");
+  auto conv = MakeOp("Conv", {"shifted", "W", "b"}, "Y_ref");
+  conv.add_arg()->CopyFrom(
+      MakeArgument<std::vector<int>>("kernels", {1, 1, 1}));
+  const auto fused = MakeOp("TemporalShiftConv", {"X", "W", "b"}, "Y");
+  for (const auto& def : {shift, conv, fused}) {
+    ASSERT_TRUE(CreateOperator(def, &ws)->Run());
+  }
+  ExpectNear(Get(&ws, "Y"), Get(&ws, "Y_ref"), "Y");
+
+  AddRandomInput(&ws, "Y_grad", {kN, kM, kT, 3, 2}, 4);
+  ws.CreateBlob("Y_ref_grad")->GetMutable<TensorCPU>()->CopyFrom(
+      Get(&ws, "Y_grad"));
+  RunGradient(&ws, fused);
+  for (const std::string name : {"X", "W", "b"}) {
+    ws.RenameBlob(name + "_grad", name + "_grad_fused");
+  }
+  RunGradient(&ws, conv);
+  RunGradient(&ws, shift);
+  for (const std::string name : {"X", "W", "b"}) {
+    ExpectNear(
+        Get(&ws, name + "_grad_fused"), Get(&ws, name + "_grad"), name);
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+#include "caffe2/video/video_meta_index.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+VideoMetaEntry MakeEntry(int num_frames, float fps) {
+  VideoMetaEntry entry;
+  entry.num_frames = num_frames;
+  entry.fps = fps;
+  entry.width = 340;
+  entry.height = 256;
+  entry.key_frames = {0, num_frames / 2};
+  return entry;
+}
+
+std::string WriteIndex(const std::string& contents) {
+  char name[] = "/tmp/video_meta_index_test_XXXXXX";
+  const int fd = mkstemp(name);
+  close(fd);
+  std::ofstream out(name, std::ios::binary);
+  out.write(contents.data(), contents.size());
+  return name;
+}
+
+} // namespace
+
+TEST(VideoMetaIndexTest, LooksUpVideos) {
+  const std::string filename = WriteIndex(SerializeVideoMetaIndex({
+      {"/data/b.mp4", MakeEntry(300, 30)},
+      {"/data/a.mp4", MakeEntry(250, 25)},
+      {"/data/c.mp4", MakeEntry(100, 29.97f)},
+  }));
+
+  VideoMetaIndex index;
+  ASSERT_TRUE(index.Open(filename));
+  EXPECT_EQ(index.size(), 3);
+
+  VideoMetaEntry entry;
+  ASSERT_TRUE(index.Lookup("/data/a.mp4", &entry));
+  EXPECT_EQ(entry.num_frames, 250);
+  EXPECT_FLOAT_EQ(entry.fps, 25);
+  EXPECT_EQ(entry.width, 340);
+  EXPECT_EQ(entry.height, 256);
+  ASSERT_EQ(entry.key_frames.size(), 2);
+  EXPECT_EQ(entry.key_frames[1], 125);
+
+  ASSERT_TRUE(index.Lookup("/data/c.mp4", &entry));
+  EXPECT_EQ(entry.num_frames, 100);
+  EXPECT_FALSE(index.Lookup("/data/d.mp4", &entry));
+  EXPECT_FALSE(index.Lookup("/data/a.mp", &entry));
+  remove(filename.c_str());
+}
+
+TEST(VideoMetaIndexTest, RejectsOtherFiles) {
+  const std::string filename = WriteIndex("not an index");
+  VideoMetaIndex index;
+  EXPECT_FALSE(index.Open(filename));
+  EXPECT_EQ(index.size(), 0);
+  VideoMetaEntry entry;
+  EXPECT_FALSE(index.Lookup("/data/a.mp4", &entry));
+  remove(filename.c_str());
+}
+
+} // namespace caffe2
@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/video_record.h"
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+namespace {
+
+int32_t ReadInt32(const char* data) {
+  int32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+void AppendInt32(const int32_t value, std::string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool HasMagic(const char* data, const size_t size, const char* magic) {
+  return size >= 4 && memcmp(data, magic, 4) == 0;
+}
+
+void ClearMeta(VideoRecord* record) {
+  record->num_frames = -1;
+  record->fps = -1;
+  record->width = -1;
+  record->height = -1;
+  record->key_frame_data = nullptr;
+  record->num_key_frames = 0;
+}
+
+} // namespace
+
+void ParseVideoRecord(
+    const char* data,
+    const size_t size,
+    TensorProtos* protos,
+    VideoRecord* record) {
+  ClearMeta(record);
+  const bool with_meta = HasMagic(data, size, kVideoRecordWithMetaMagic);
+  if (with_meta || HasMagic(data, size, kVideoRecordMagic)) {
+    const size_t header_size =
+        with_meta ? kVideoRecordWithMetaHeaderSize : kVideoRecordHeaderSize;
+    CAFFE_ENFORCE_GE(size, header_size, "Truncated video record.");
+    const int num_labels = ReadInt32(data + 4);
+    record->start_frm = ReadInt32(data + 8);
+    record->spatial_pos = ReadInt32(data + 12);
+    int num_key_frames = 0;
+    if (with_meta) {
+      record->num_frames = ReadInt32(data + 16);
+      memcpy(&record->fps, data + 20, sizeof(float));
+      record->width = ReadInt32(data + 24);
+      record->height = ReadInt32(data + 28);
+      num_key_frames = ReadInt32(data + 32);
+    }
+    CAFFE_ENFORCE(
+        num_labels >= 0 && num_key_frames >= 0,
+        "Corrupted video record header.");
+    const size_t labels_end = header_size + num_labels * sizeof(int32_t);
+    const size_t key_frames_end =
+        labels_end + num_key_frames * sizeof(int32_t);
+    CAFFE_ENFORCE_LE(key_frames_end, size, "Truncated video record.");
+    record->label_data = data + header_size;
+    record->num_labels = num_labels;
+    record->key_frame_data = data + labels_end;
+    record->num_key_frames = num_key_frames;
+    record->payload = data + key_frames_end;
+    record->payload_size = size - key_frames_end;
+    return;
+  }
+
+  protos->Clear();
+  CAFFE_ENFORCE(protos->ParseFromArray(data, size));
+  CAFFE_ENFORCE_GE(protos->protos_size(), 2, "A video record needs a label.");
+  const TensorProto& video_proto = protos->protos(0);
+  // the encoded video (or the path) is either the first string of the
+  // proto or its byte storage, neither is copied
+  const std::string* payload = nullptr;
+  if (video_proto.data_type() == TensorProto::STRING) {
+    CAFFE_ENFORCE_GT(video_proto.string_data_size(), 0, "Empty video record.");
+    payload = &video_proto.string_data(0);
+  } else {
+    CAFFE_ENFORCE_EQ(
+        video_proto.data_type(),
+        TensorProto::BYTE,
+        "Unknown video data type.");
+    payload = &video_proto.byte_data();
+  }
+  record->payload = payload->data();
+  record->payload_size = payload->size();
+  const TensorProto& label_proto = protos->protos(1);
+  record->label_data =
+      reinterpret_cast<const char*>(label_proto.int32_data().data());
+  record->num_labels = label_proto.int32_data_size();
+  record->start_frm =
+      protos->protos_size() > 2 ? protos->protos(2).int32_data(0) : -1;
+  record->spatial_pos =
+      protos->protos_size() > 3 ? protos->protos(3).int32_data(0) : -1;
+}
+
+std::string SerializeVideoRecord(const VideoRecord& record) {
+  const bool with_meta = record.has_meta();
+  std::string out(
+      with_meta ? kVideoRecordWithMetaMagic : kVideoRecordMagic, 4);
+  AppendInt32(record.num_labels, &out);
+  AppendInt32(record.start_frm, &out);
+  AppendInt32(record.spatial_pos, &out);
+  if (with_meta) {
+    AppendInt32(record.num_frames, &out);
+    out.append(reinterpret_cast<const char*>(&record.fps), sizeof(float));
+    AppendInt32(record.width, &out);
+    AppendInt32(record.height, &out);
+    AppendInt32(record.num_key_frames, &out);
+  }
+  for (int i = 0; i < record.num_labels; ++i) {
+    AppendInt32(record.label(i), &out);
+  }
+  if (with_meta) {
+    for (int i = 0; i < record.num_key_frames; ++i) {
+      AppendInt32(record.key_frame(i), &out);
+    }
+  }
+  out.append(record.payload, record.payload_size);
+  return out;
+}
+
+} // namespace caffe2
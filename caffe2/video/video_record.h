@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_VIDEO_RECORD_H_
+#define CAFFE2_VIDEO_VIDEO_RECORD_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "caffe2/proto/caffe2.pb.h"
+
+namespace caffe2 {
+
+// The fields of a db record of the video input ops, parsed once per record.
+// A record is either a serialized TensorProtos (video as a STRING or BYTE
+// tensor, label, and then the optional start frame and spatial position) or
+// a header record, which is read in place without protobuf. All header
+// fields are little endian int32:
+//
+//   "VREC", num_labels, start_frm, spatial_pos, the num_labels labels, and
+//   the payload up to the end of the record, or
+//   "VRMF", num_labels, start_frm, spatial_pos, num_frames, fps (float32),
+//   width, height, num_key_frames, the labels, the ascending indices of the
+//   key frames of the video, and the payload.
+//
+// The second form carries what the decoder would otherwise have to estimate
+// from the container: with it, selective decoding knows the exact clip
+// window and the key frame to seek to.
+//
+// payload, label_data and key_frame_data point into the record or the
+// TensorProtos it was parsed into, and are only valid as long as those are.
+struct VideoRecord {
+  // absolute path of a local video file, or the encoded video itself
+  const char* payload;
+  size_t payload_size;
+  // num_labels int32 labels, not necessarily aligned
+  const char* label_data;
+  int num_labels;
+  // -1 if the record has none
+  int start_frm;
+  int spatial_pos;
+  // video meta data of "VRMF" records; -1 (and no key frames) otherwise
+  int num_frames;
+  float fps;
+  int width;
+  int height;
+  const char* key_frame_data;
+  int num_key_frames;
+
+  int label(const int i) const {
+    return ReadInt(label_data, i);
+  }
+
+  int key_frame(const int i) const {
+    return ReadInt(key_frame_data, i);
+  }
+
+  bool has_meta() const {
+    return num_frames > 0;
+  }
+
+ private:
+  static int ReadInt(const char* data, const int i) {
+    int32_t value;
+    memcpy(&value, data + i * sizeof(int32_t), sizeof(value));
+    return value;
+  }
+};
+
+constexpr char kVideoRecordMagic[4] = {'V', 'R', 'E', 'C'};
+constexpr size_t kVideoRecordHeaderSize = 16;
+constexpr char kVideoRecordWithMetaMagic[4] = {'V', 'R', 'M', 'F'};
+constexpr size_t kVideoRecordWithMetaHeaderSize = 36;
+
+// Fills record from a db value of size bytes. A record without the header is
+// parsed into protos, which is cleared first and can be reused across
+// records to reuse its buffers.
+void ParseVideoRecord(
+    const char* data,
+    const size_t size,
+    TensorProtos* protos,
+    VideoRecord* record);
+
+// The header record holding the fields of record, "VRMF" if it has meta
+// data and "VREC" otherwise.
+std::string SerializeVideoRecord(const VideoRecord& record);
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_VIDEO_RECORD_H_
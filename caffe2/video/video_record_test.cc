@@ -0,0 +1,111 @@
+#include <string>
+
+#include "caffe2/video/video_record.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+TEST(VideoRecordTest, ParsesHeaderRecord) {
+  const int32_t labels[] = {3, 7};
+  const std::string path = "/data/video.mp4";
+  VideoRecord in;
+  in.payload = path.data();
+  in.payload_size = path.size();
+  in.label_data = reinterpret_cast<const char*>(labels);
+  in.num_labels = 2;
+  in.start_frm = 5;
+  in.spatial_pos = 1;
+  in.num_frames = -1;
+  in.key_frame_data = nullptr;
+  in.num_key_frames = 0;
+  const std::string value = SerializeVideoRecord(in);
+
+  TensorProtos protos;
+  VideoRecord out;
+  ParseVideoRecord(value.data(), value.size(), &protos, &out);
+  EXPECT_EQ(std::string(out.payload, out.payload_size), path);
+  EXPECT_EQ(out.num_labels, 2);
+  EXPECT_EQ(out.label(0), 3);
+  EXPECT_EQ(out.label(1), 7);
+  EXPECT_EQ(out.start_frm, 5);
+  EXPECT_EQ(out.spatial_pos, 1);
+  // read in place
+  EXPECT_EQ(out.payload, value.data() + value.size() - path.size());
+}
+
+TEST(VideoRecordTest, ParsesMetaData) {
+  const int32_t labels[] = {3};
+  const int32_t key_frames[] = {0, 250, 500};
+  const std::string path = "/data/video.mp4";
+  VideoRecord in;
+  in.payload = path.data();
+  in.payload_size = path.size();
+  in.label_data = reinterpret_cast<const char*>(labels);
+  in.num_labels = 1;
+  in.start_frm = -1;
+  in.spatial_pos = -1;
+  in.num_frames = 600;
+  in.fps = 29.97f;
+  in.width = 340;
+  in.height = 256;
+  in.key_frame_data = reinterpret_cast<const char*>(key_frames);
+  in.num_key_frames = 3;
+  const std::string value = SerializeVideoRecord(in);
+
+  TensorProtos protos;
+  VideoRecord out;
+  ParseVideoRecord(value.data(), value.size(), &protos, &out);
+  EXPECT_TRUE(out.has_meta());
+  EXPECT_EQ(std::string(out.payload, out.payload_size), path);
+  EXPECT_EQ(out.label(0), 3);
+  EXPECT_EQ(out.num_frames, 600);
+  EXPECT_FLOAT_EQ(out.fps, 29.97f);
+  EXPECT_EQ(out.width, 340);
+  EXPECT_EQ(out.height, 256);
+  ASSERT_EQ(out.num_key_frames, 3);
+  EXPECT_EQ(out.key_frame(1), 250);
+  EXPECT_EQ(out.key_frame(2), 500);
+}
+
+TEST(VideoRecordTest, ParsesTensorProtos) {
+  TensorProtos in;
+  TensorProto* video = in.add_protos();
+  video->set_data_type(TensorProto::STRING);
+  video->add_string_data("/data/video.mp4");
+  TensorProto* label = in.add_protos();
+  label->set_data_type(TensorProto::INT32);
+  label->add_int32_data(42);
+  const std::string value = in.SerializeAsString();
+
+  TensorProtos protos;
+  VideoRecord out;
+  ParseVideoRecord(value.data(), value.size(), &protos, &out);
+  EXPECT_EQ(std::string(out.payload, out.payload_size), "/data/video.mp4");
+  EXPECT_EQ(out.num_labels, 1);
+  EXPECT_EQ(out.label(0), 42);
+  EXPECT_EQ(out.start_frm, -1);
+  EXPECT_EQ(out.spatial_pos, -1);
+  EXPECT_FALSE(out.has_meta());
+}
+
+TEST(VideoRecordTest, ParsesByteTensorProtos) {
+  const std::string video_data("\x00\x00\x00\x18" "ftypmp42", 12);
+  TensorProtos in;
+  TensorProto* video = in.add_protos();
+  video->set_data_type(TensorProto::BYTE);
+  video->set_byte_data(video_data);
+  TensorProto* label = in.add_protos();
+  label->set_data_type(TensorProto::INT32);
+  label->add_int32_data(7);
+  const std::string value = in.SerializeAsString();
+
+  TensorProtos protos;
+  VideoRecord out;
+  ParseVideoRecord(value.data(), value.size(), &protos, &out);
+  EXPECT_EQ(std::string(out.payload, out.payload_size), video_data);
+  // points into the parsed proto
+  EXPECT_EQ(out.payload, protos.protos(0).byte_data().data());
+  EXPECT_EQ(out.label(0), 7);
+}
+
+} // namespace caffe2
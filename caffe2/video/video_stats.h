@@ -0,0 +1,75 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_VIDEO_STATS_H_
+#define CAFFE2_VIDEO_VIDEO_STATS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/stats.h"
+
+namespace caffe2 {
+
+// Latency histogram of the video input stages, exported as the number of
+// events <name> and the number of events in each log2 millisecond bucket,
+// <name>/lt_1ms, <name>/lt_2ms, ... <name>/lt_1024ms and <name>/ge_1024ms.
+// CAFFE_EVENT(stats, name, nanos) adds an event to its bucket.
+class LatencyHistogramStat : public DetailedExportedStat {
+ public:
+  static constexpr int kNumBuckets = 12;
+
+  LatencyHistogramStat(const std::string& gn, const std::string& n)
+      : DetailedExportedStat(gn, n) {
+    std::vector<std::string> names;
+    for (int i = 0; i + 1 < kNumBuckets; ++i) {
+      names.push_back("lt_" + std::to_string(1 << i) + "ms");
+    }
+    names.push_back("ge_" + std::to_string(1 << (kNumBuckets - 2)) + "ms");
+    setDetails(names);
+  }
+
+  int64_t increment(const float nanos) {
+    return DetailedExportedStat::increment(1, Bucket(nanos));
+  }
+
+  static int Bucket(const float nanos) {
+    int bucket = 0;
+    for (float ms = nanos / 1e6f; ms >= 1.f && bucket + 1 < kNumBuckets;
+         ms /= 2) {
+      ++bucket;
+    }
+    return bucket;
+  }
+};
+
+#define CAFFE_LATENCY_HISTOGRAM_STAT(name) \
+  LatencyHistogramStat name {              \
+    groupName, #name                       \
+  }
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_VIDEO_STATS_H_
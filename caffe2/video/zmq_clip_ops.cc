@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/zmq_clip_ops.h"
+
+namespace caffe2 {
+
+REGISTER_CPU_OPERATOR(ZmqClipSend, ZmqClipSendOp);
+REGISTER_CPU_OPERATOR(ZmqClipInput, ZmqClipInputOp<CPUContext>);
+
+OPERATOR_SCHEMA(ZmqClipSend)
+    .NumInputs(1, INT_MAX)
+    .NumOutputs(0)
+    .SetDoc(R"DOC(
+Sends its inputs, e.g. the outputs of a CPU CustomizedVideoInput on a decode
+node, as one batch to a ZmqClipInput op that has a credit left, waiting until
+one has. Binds a ZMQ ROUTER socket to `address`.
+)DOC")
+    .Arg("address", "zmq address to bind to, default tcp://*:5600");
+
+OPERATOR_SCHEMA(ZmqClipInput)
+    .NumInputs(0)
+    .NumOutputs(1, INT_MAX)
+    .SetDoc(R"DOC(
+Outputs the batches of the ZmqClipSend ops at `addresses`, granting every
+producer `credits` batches ahead of the ones it has taken. With
+use_gpu_transform (CUDA only) the batches are the uint8 clips and mirror
+flags of a CPU CustomizedVideoInput with use_gpu_transform, which the op
+transforms on the GPU into its first output.
+)DOC")
+    .Arg("addresses", "zmq addresses of the producers")
+    .Arg("credits", "batches each producer may send ahead, default 4")
+    .Arg("timeout_ms", "receive timeout, so that the op can quit")
+    .Arg("use_gpu_transform", "transform the uint8 clips on the GPU")
+    .Arg("mean", "mean of the GPU transform")
+    .Arg("std", "std of the GPU transform")
+    .Arg("use_bgr", "reverse the channels in the GPU transform")
+    .Arg("output_type", "float, float16 or uint8 clips of the GPU transform")
+    .Arg("order", "NCHW or NHWC clips of the GPU transform");
+
+SHOULD_NOT_DO_GRADIENT(ZmqClipSend);
+NO_GRADIENT(ZmqClipInput);
+
+} // namespace caffe2
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/video/customized_video_transform_gpu.h"
+#include "caffe2/video/zmq_clip_ops.h"
+
+namespace caffe2 {
+
+template <>
+bool ZmqClipInputOp<CUDAContext>::CopyPrefetched() {
+  auto& tensors = received_on_device_[copy_slot_];
+  int first = 0;
+  if (gpu_transform_) {
+    auto* clip_output = OperatorBase::Output<TensorCUDA>(0);
+    const bool channels_last = order_ == StorageOrder::NHWC;
+    if (output_type_ == "float") {
+      TransformClipsOnGPU<uint8_t, float, CUDAContext>(
+          tensors[0],
+          tensors.back(),
+          clip_output,
+          mean_,
+          1.f / std_,
+          use_bgr_,
+          channels_last,
+          &context_);
+    } else if (output_type_ == "float16") {
+      TransformClipsOnGPU<uint8_t, float16, CUDAContext>(
+          tensors[0],
+          tensors.back(),
+          clip_output,
+          mean_,
+          1.f / std_,
+          use_bgr_,
+          channels_last,
+          &context_);
+    } else {
+      CAFFE_ENFORCE_EQ(output_type_, "uint8");
+      TransformClipsOnGPU<uint8_t, uint8_t, CUDAContext>(
+          tensors[0],
+          tensors.back(),
+          clip_output,
+          0.f,
+          1.f,
+          use_bgr_,
+          channels_last,
+          &context_);
+    }
+    first = 1;
+  }
+  for (int i = first; i < OutputSize(); ++i) {
+    OperatorBase::Output<TensorCUDA>(i)->CopyFrom(tensors[i], &context_);
+  }
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(ZmqClipInput, ZmqClipInputOp<CUDAContext>);
+
+} // namespace caffe2
@@ -218,6 +218,16 @@ if(USE_NUMA)
   endif()
 endif()
 
+# ---[ Shared memory mutex
+if(USE_SHM_MUTEX)
+  if(NOT ${CMAKE_SYSTEM_NAME} STREQUAL "Linux")
+    message(WARNING "The shared memory mutex is currently only supported under Linux.")
+    set(USE_SHM_MUTEX OFF)
+  else()
+    set(CAFFE2_USE_SHM_MUTEX 1)
+  endif()
+endif()
+
 # ---[ ZMQ
 if(USE_ZMQ)
   find_package(ZMQ)
@@ -261,6 +271,24 @@ if(USE_OPENCV)
   endif()
 endif()
 
+# ---[ libjpeg-turbo
+if(USE_LIBJPEG_TURBO)
+  if(NOT USE_OPENCV)
+    message(WARNING "libjpeg-turbo is only used by the image ops, which need OpenCV.")
+    set(USE_LIBJPEG_TURBO OFF)
+  else()
+    find_package(LibJpegTurbo)
+    if(LibJpegTurbo_FOUND)
+      include_directories(${LibJpegTurbo_INCLUDE_DIR})
+      list(APPEND Caffe2_DEPENDENCY_LIBS ${LibJpegTurbo_LIBRARIES})
+      set(CAFFE2_USE_LIBJPEG_TURBO 1)
+    else()
+      message(WARNING "Not compiling with libjpeg-turbo. Suppress this warning with -DUSE_LIBJPEG_TURBO=OFF")
+      set(USE_LIBJPEG_TURBO OFF)
+    endif()
+  endif()
+endif()
+
 # ---[ FFMPEG
 if(USE_FFMPEG)
   find_package(FFmpeg REQUIRED)
@@ -392,6 +420,45 @@ if(USE_NCCL)
   endif()
 endif()
 
+# ---[ TensorRT
+if(USE_TENSORRT)
+  if(NOT USE_CUDA)
+    message(WARNING "If not using cuda, one should not use TensorRT either.")
+    set(USE_TENSORRT OFF)
+  else()
+    find_package(TensorRT)
+    if(TENSORRT_FOUND)
+      include_directories(${TensorRT_INCLUDE_DIR})
+      list(APPEND Caffe2_CUDA_DEPENDENCY_LIBS ${TensorRT_LIBRARIES})
+    else()
+      message(WARNING "Not compiling with TensorRT. Suppress this warning with -DUSE_TENSORRT=OFF")
+      set(USE_TENSORRT OFF)
+    endif()
+  endif()
+endif()
+
+# ---[ nvJPEG, part of the CUDA toolkit from CUDA 10
+if(USE_NVJPEG)
+  if(NOT USE_CUDA)
+    message(WARNING "If not using cuda, one should not use nvJPEG either.")
+    set(USE_NVJPEG OFF)
+  else()
+    find_path(NVJPEG_INCLUDE_DIR nvjpeg.h
+              HINTS ${CUDA_TOOLKIT_ROOT_DIR} PATH_SUFFIXES include)
+    find_library(NVJPEG_LIBRARY nvjpeg
+                 HINTS ${CUDA_TOOLKIT_ROOT_DIR} PATH_SUFFIXES lib64 lib)
+    if(NVJPEG_INCLUDE_DIR AND NVJPEG_LIBRARY)
+      message(STATUS "Found nvJPEG  (include: ${NVJPEG_INCLUDE_DIR}, library: ${NVJPEG_LIBRARY})")
+      include_directories(${NVJPEG_INCLUDE_DIR})
+      list(APPEND Caffe2_CUDA_DEPENDENCY_LIBS ${NVJPEG_LIBRARY})
+      set(CAFFE2_USE_NVJPEG 1)
+    else()
+      message(WARNING "Not compiling with nvJPEG. Suppress this warning with -DUSE_NVJPEG=OFF")
+      set(USE_NVJPEG OFF)
+    endif()
+  endif()
+endif()
+
 # ---[ CUB
 if(USE_CUDA)
   find_package(CUB)
@@ -142,6 +142,24 @@ if (CAFFE2_COMPILER_SUPPORTS_AVX2_EXTENSIONS)
 endif()
 cmake_pop_check_state()
 
+# ---[ Check if the compiler has AVX-512 support, for the Skylake-SP subset
+# (F, BW, DQ and VL) the avx512 perfkernels are written against.
+cmake_push_check_state(RESET)
+set(CMAKE_REQUIRED_FLAGS "-mavx512f -mavx512bw -mavx512dq -mavx512vl")
+CHECK_CXX_SOURCE_COMPILES(
+    "#include <immintrin.h>
+     int main() {
+       __m512i a = _mm512_set1_epi8(1);
+       __m512 b = _mm512_cvtepi32_ps(_mm512_add_epi32(a, a));
+       return _mm512_reduce_add_ps(b) > 0.f ? 0 : 1;
+     }" CAFFE2_COMPILER_SUPPORTS_AVX512_EXTENSIONS)
+if (CAFFE2_COMPILER_SUPPORTS_AVX512_EXTENSIONS AND
+    CAFFE2_COMPILER_SUPPORTS_AVX2_EXTENSIONS AND NOT MSVC)
+  message(STATUS "Current compiler supports avx512 extention. Will build avx512 perfkernels.")
+  set(CAFFE2_PERF_WITH_AVX512 1)
+endif()
+cmake_pop_check_state()
+
 # ---[ Checks if compiler supports -fvisibility=hidden
 check_cxx_compiler_flag("-fvisibility=hidden" COMPILER_SUPPORTS_HIDDEN_VISIBILITY)
 check_cxx_compiler_flag("-fvisibility-inlines-hidden" COMPILER_SUPPORTS_HIDDEN_INLINE_VISIBILITY)
@@ -254,6 +272,12 @@ endif()
 # ---[ Create CAFFE2_BUILD_SHARED_LIBS for macros.h.in usage.
 set(CAFFE2_BUILD_SHARED_LIBS ${BUILD_SHARED_LIBS})
 
+# ---[ Create CAFFE2_ENABLE_SDT for macros.h.in usage. The probes are only
+# emitted on x86 ELF targets, see caffe2/core/static_tracepoint.h.
+if (USE_SDT)
+  set(CAFFE2_ENABLE_SDT 1)
+endif()
+
 # ---[ Check if we will need to include the local Modules_CUDA_fix folder.
 # Add your conditions here if needed.
 if (MSVC)
@@ -0,0 +1,45 @@
+# Find libjpeg-turbo, whose jpeg_crop_scanline and jpeg_skip_scanlines (1.5
+# and above) decode a part of a JPEG only.
+#
+# The following variables are optionally searched for defaults
+#  LibJpegTurbo_ROOT_DIR:    Base directory where all libjpeg-turbo components are found
+#
+# The following are set after configuration is done:
+#  LibJpegTurbo_FOUND
+#  LibJpegTurbo_INCLUDE_DIR
+#  LibJpegTurbo_LIBRARIES
+#  LibJpegTurbo_VERSION
+
+find_path(LibJpegTurbo_INCLUDE_DIR NAMES jpeglib.h
+          PATHS ${LibJpegTurbo_ROOT_DIR} ${LibJpegTurbo_ROOT_DIR}/include
+          $ENV{LIBJPEG_TURBO_DIR}/include /opt/libjpeg-turbo/include)
+
+find_library(LibJpegTurbo_LIBRARIES NAMES jpeg turbojpeg
+             PATHS ${LibJpegTurbo_ROOT_DIR} ${LibJpegTurbo_ROOT_DIR}/lib
+             ${LibJpegTurbo_ROOT_DIR}/lib64 $ENV{LIBJPEG_TURBO_DIR}/lib
+             /opt/libjpeg-turbo/lib64 /opt/libjpeg-turbo/lib)
+
+# jconfig.h is in include/<multiarch> on Debian
+find_file(LibJpegTurbo_CONFIG_HEADER NAMES jconfig.h
+          HINTS ${LibJpegTurbo_INCLUDE_DIR}
+          PATH_SUFFIXES ${CMAKE_LIBRARY_ARCHITECTURE})
+
+if(LibJpegTurbo_CONFIG_HEADER)
+  file(STRINGS "${LibJpegTurbo_CONFIG_HEADER}" LibJpegTurbo_VERSION_LINE
+       REGEX "^#define[ \t]+LIBJPEG_TURBO_VERSION[ \t]+")
+  string(REGEX REPLACE "^#define[ \t]+LIBJPEG_TURBO_VERSION[ \t]+\"?([0-9.]+)\"?.*$" "\\1"
+         LibJpegTurbo_VERSION "${LibJpegTurbo_VERSION_LINE}")
+endif()
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(LibJpegTurbo DEFAULT_MSG LibJpegTurbo_INCLUDE_DIR LibJpegTurbo_LIBRARIES LibJpegTurbo_VERSION)
+
+if(LibJpegTurbo_FOUND)
+  if(${LibJpegTurbo_VERSION} VERSION_LESS "1.5")
+    message(WARNING "Caffe2 requires libjpeg-turbo version 1.5 or above, but found " ${LibJpegTurbo_VERSION} ". Disabling libjpeg-turbo for now.")
+    set(LibJpegTurbo_FOUND)
+  else()
+    message(STATUS "Found libjpeg-turbo  (include: ${LibJpegTurbo_INCLUDE_DIR}, library: ${LibJpegTurbo_LIBRARIES})")
+    mark_as_advanced(LibJpegTurbo_INCLUDE_DIR LibJpegTurbo_LIBRARIES LibJpegTurbo_CONFIG_HEADER)
+  endif()
+endif()
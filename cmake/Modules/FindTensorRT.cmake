@@ -0,0 +1,36 @@
+# Find the TensorRT libraries
+#
+# The following variables are optionally searched for defaults
+#  TENSORRT_ROOT_DIR:    Base directory where all TensorRT components are found
+#
+# The following are set after configuration is done:
+#  TENSORRT_FOUND
+#  TensorRT_INCLUDE_DIR
+#  TensorRT_LIBRARIES
+
+find_path(
+    TensorRT_INCLUDE_DIR NAMES NvInfer.h NvOnnxParser.h
+    PATHS ${TENSORRT_ROOT_DIR} ${TENSORRT_ROOT_DIR}/include)
+
+find_library(
+    TensorRT_INFER_LIBRARY NAMES nvinfer
+    PATHS ${TENSORRT_ROOT_DIR} ${TENSORRT_ROOT_DIR}/lib)
+
+find_library(
+    TensorRT_ONNX_PARSER_LIBRARY NAMES nvonnxparser
+    PATHS ${TENSORRT_ROOT_DIR} ${TENSORRT_ROOT_DIR}/lib)
+
+set(TensorRT_LIBRARIES ${TensorRT_INFER_LIBRARY} ${TensorRT_ONNX_PARSER_LIBRARY})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(
+    TensorRT DEFAULT_MSG TensorRT_INCLUDE_DIR
+    TensorRT_INFER_LIBRARY TensorRT_ONNX_PARSER_LIBRARY)
+
+if(TENSORRT_FOUND)
+  message(
+      STATUS
+      "Found TensorRT  (include: ${TensorRT_INCLUDE_DIR}, library: ${TensorRT_LIBRARIES})")
+  mark_as_advanced(
+      TensorRT_INCLUDE_DIR TensorRT_INFER_LIBRARY TensorRT_ONNX_PARSER_LIBRARY)
+endif()
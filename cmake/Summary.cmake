@@ -58,6 +58,10 @@ function (caffe2_print_configuration_summary)
     message(STATUS "    LevelDB version     : ${LEVELDB_VERSION}")
     message(STATUS "    Snappy version      : ${Snappy_VERSION}")
   endif()
+  message(STATUS "  USE_LIBJPEG_TURBO     : ${USE_LIBJPEG_TURBO}")
+  if(${USE_LIBJPEG_TURBO})
+    message(STATUS "    libjpeg-turbo version: ${LibJpegTurbo_VERSION}")
+  endif()
   message(STATUS "  USE_LITE_PROTO        : ${USE_LITE_PROTO}")
   message(STATUS "  USE_LMDB              : ${USE_LMDB}")
   if(${USE_LMDB})
@@ -73,6 +77,7 @@ function (caffe2_print_configuration_summary)
     message(STATUS "    NERVANA_GPU version : ${NERVANA_GPU_VERSION}")
   endif()
   message(STATUS "  USE_NNPACK            : ${USE_NNPACK}")
+  message(STATUS "  USE_NVJPEG            : ${USE_NVJPEG}")
   message(STATUS "  USE_OBSERVERS         : ${USE_OBSERVERS}")
   message(STATUS "  USE_OPENCV            : ${USE_OPENCV}")
   if(${USE_OPENCV})
@@ -82,5 +87,8 @@ function (caffe2_print_configuration_summary)
   message(STATUS "  USE_PROF              : ${USE_PROF}")
   message(STATUS "  USE_REDIS             : ${USE_REDIS}")
   message(STATUS "  USE_ROCKSDB           : ${USE_ROCKSDB}")
+  message(STATUS "  USE_SDT               : ${USE_SDT}")
+  message(STATUS "  USE_SHM_MUTEX         : ${USE_SHM_MUTEX}")
+  message(STATUS "  USE_TENSORRT          : ${USE_TENSORRT}")
   message(STATUS "  USE_ZMQ               : ${USE_ZMQ}")
 endfunction()
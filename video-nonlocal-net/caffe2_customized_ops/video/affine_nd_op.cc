@@ -23,24 +23,157 @@
   */
 
 #include "caffe2/video/affine_nd_op.h"
+#include "caffe2/perfkernels/affine_nd.h"
+#include "caffe2/utils/parallel_for.h"
+
+#ifdef CAFFE2_USE_MKL
+#include "caffe2/mkl/operators/operator_fallback_mkl.h"
+#endif // CAFFE2_USE_MKL
 
 namespace caffe2 {
 
+// one (n, c) plane of TxHxW per iteration; in NHWC one image of TxHxW
+// pixels per iteration, the iterations split by ParallelFor. The perfkernels
+// pick the widest vectors the cpu has.
+template <>
+bool AffineNdOp<float, CPUContext>::RunOnDevice() {
+  auto& X = Input(0);
+  auto& scale = Input(1);
+  auto& bias = Input(2);
+  auto* Y = Output(0);
+
+  CAFFE_ENFORCE_GE(X.ndim(), 2);
+  const int N = X.dim32(0);
+  const int C =
+      order_ == StorageOrder::NCHW ? X.dim32(1) : X.dim32(X.ndim() - 1);
+  const int inner = X.size() / N / C;  // support TxHxW
+  CAFFE_ENFORCE_EQ(scale.size(), C);
+  CAFFE_ENFORCE_EQ(bias.size(), C);
+  Y->ResizeLike(X);
+  const float* X_data = X.data<float>();
+  const float* scale_data = scale.data<float>();
+  const float* bias_data = bias.data<float>();
+  float* Y_data = Y->mutable_data<float>();
+  if (order_ == StorageOrder::NHWC) {
+    ParallelFor(
+        N, ParallelForGrainSize(C * inner), [&](int64_t begin, int64_t end) {
+          for (int64_t n = begin; n < end; ++n) {
+            AffineNdPixels(
+                X_data + n * C * inner, inner, C, scale_data, bias_data,
+                Y_data + n * C * inner);
+          }
+        });
+    return true;
+  }
+  ParallelFor(
+      N * C, ParallelForGrainSize(inner), [&](int64_t begin, int64_t end) {
+        for (int64_t plane = begin; plane < end; ++plane) {
+          const int c = plane % C;
+          AffineNdPlane(
+              X_data + plane * inner, inner, scale_data[c], bias_data[c],
+              Y_data + plane * inner);
+        }
+      });
+  return true;
+}
+
+template <>
+bool AffineNdGradientOp<float, CPUContext>::RunOnDevice() {
+  auto& scale = Input(0);
+  auto& dY = Input(1);
+  auto* dX = Output(0);
+
+  CAFFE_ENFORCE_GE(dY.ndim(), 2);
+  const int N = dY.dim32(0);
+  const int C =
+      order_ == StorageOrder::NCHW ? dY.dim32(1) : dY.dim32(dY.ndim() - 1);
+  const int inner = dY.size() / N / C;  // support TxHxW
+  CAFFE_ENFORCE_EQ(scale.size(), C);
+  dX->ResizeLike(dY);
+  const float* dY_data = dY.data<float>();
+  const float* scale_data = scale.data<float>();
+  float* dX_data = dX->mutable_data<float>();
+  if (order_ == StorageOrder::NHWC) {
+    ParallelFor(
+        N, ParallelForGrainSize(C * inner), [&](int64_t begin, int64_t end) {
+          for (int64_t n = begin; n < end; ++n) {
+            AffineNdPixels(
+                dY_data + n * C * inner, inner, C, scale_data, nullptr,
+                dX_data + n * C * inner);
+          }
+        });
+    return true;
+  }
+  // x * scale + 0 rounds like x * scale
+  ParallelFor(
+      N * C, ParallelForGrainSize(inner), [&](int64_t begin, int64_t end) {
+        for (int64_t plane = begin; plane < end; ++plane) {
+          AffineNdPlane(
+              dY_data + plane * inner, inner, scale_data[plane % C], 0.f,
+              dX_data + plane * inner);
+        }
+      });
+  return true;
+}
+
 REGISTER_CPU_OPERATOR(AffineNd,
                       AffineNdOp<float, CPUContext>);
 REGISTER_CPU_OPERATOR(AffineNdGradient,
                       AffineNdGradientOp<float, CPUContext>);
 
+#ifdef CAFFE2_HAS_MKL_DNN
+REGISTER_MKL_OPERATOR(
+    AffineNd,
+    mkl::MKLFallbackOp<AffineNdOp<float, CPUContext>>);
+REGISTER_MKL_OPERATOR(
+    AffineNdGradient,
+    mkl::MKLFallbackOp<AffineNdGradientOp<float, CPUContext>>);
+#endif // CAFFE2_HAS_MKL_DNN
+
+namespace {
+
+// a multiply and an add per element; X is read and Y written
+OpSchema::Cost CostInferenceForAffineNd(
+    const OperatorDef& /* unused */,
+    const vector<TensorShape>& in) {
+  struct OpSchema::Cost cost;
+  const uint64_t size = nElemFromDim(in[0]);
+  cost.flops = 2 * size;
+  cost.bytes_moved = 2 * size * sizeof(float);
+  cost.params_bytes = 2 * nElemFromDim(in[1]) * sizeof(float);
+  return cost;
+}
+
+// a multiply per element of dY
+OpSchema::Cost CostInferenceForAffineNdGradient(
+    const OperatorDef& /* unused */,
+    const vector<TensorShape>& in) {
+  struct OpSchema::Cost cost;
+  const uint64_t size = nElemFromDim(in[1]);
+  cost.flops = size;
+  cost.bytes_moved = 2 * size * sizeof(float);
+  cost.params_bytes = nElemFromDim(in[0]) * sizeof(float);
+  return cost;
+}
+
+} // namespace
+
 // Input: X, scale, bias; Output: Y
+// Arg order: NCHW (default) or NHWC, where the channels are the last dim
 OPERATOR_SCHEMA(AffineNd)
     .NumInputs(3)
     .NumOutputs(1)
-    .AllowInplace({{0, 0}});
+    .AllowInplace({{0, 0}})
+    .IdenticalTypeAndShapeOfInput(0)
+    .CostInferenceFunction(CostInferenceForAffineNd)
+    .InheritOnnxSchema("AffineNd");
 // Input: scale, dY; Output: dX
 OPERATOR_SCHEMA(AffineNdGradient)
     .NumInputs(2)
     .NumOutputs(1)
-    .AllowInplace({{1, 0}});
+    .AllowInplace({{1, 0}})
+    .IdenticalTypeAndShapeOfInput(1)
+    .CostInferenceFunction(CostInferenceForAffineNdGradient);
 
 class GetAffineNdGradient : public GradientMakerBase {
   using GradientMakerBase::GradientMakerBase;
@@ -24,85 +24,244 @@
   
 #include "caffe2/video/affine_nd_op.h"
 #include "caffe2/core/context_gpu.h"
+#include "caffe2/utils/conversions.h"
+#include "caffe2/utils/fixed_divisor.h"
 
 namespace caffe2 {
 
 namespace {
+
+// The grid is 2D: blocks along x walk the N x C planes, so the channel of a
+// plane and its scale / bias are fetched once per block and kept in
+// registers, and blocks along y split the T x H x W elements of a plane.
+// When the planes allow it every thread moves four elements per access.
+constexpr int kAffineThreads = 256;
+constexpr int kVecSize = 4;
+constexpr int kMaxBlocksPerPlane = 1024;
+
+template <typename T>
+__device__ void AffineVec(const T* x, T* y, const float s, const float b);
+
+template <>
+__device__ void
+AffineVec<float>(const float* x, float* y, const float s, const float b) {
+  float4 v = *reinterpret_cast<const float4*>(x);
+  v.x = v.x * s + b;
+  v.y = v.y * s + b;
+  v.z = v.z * s + b;
+  v.w = v.w * s + b;
+  *reinterpret_cast<float4*>(y) = v;
+}
+
+// four halfs are one 8 byte access, computed in float
+template <>
+__device__ void AffineVec<float16>(
+    const float16* x,
+    float16* y,
+    const float s,
+    const float b) {
+  float2 raw = *reinterpret_cast<const float2*>(x);
+  half2* h = reinterpret_cast<half2*>(&raw);
+  const float2 lo = __half22float2(h[0]);
+  const float2 hi = __half22float2(h[1]);
+  h[0] = __floats2half2_rn(lo.x * s + b, lo.y * s + b);
+  h[1] = __floats2half2_rn(hi.x * s + b, hi.y * s + b);
+  *reinterpret_cast<float2*>(y) = raw;
+}
+
+// Y = X * scale[c] + bias[c], without bias for the gradient
+template <typename T, bool kVectorized>
+__global__ void AffineNdKernel(
+    const int planes,
+    const int inner,
+    const FixedDivisor<int32_t> channels,
+    const T* X,
+    const T* scale,
+    const T* bias,
+    T* Y) {
+  for (int plane = blockIdx.x; plane < planes; plane += gridDim.x) {
+    const int c = channels.mod(plane);
+    const float s = convert::To<T, float>(scale[c]);
+    const float b = bias ? convert::To<T, float>(bias[c]) : 0.f;
+    const T* x = X + static_cast<size_t>(plane) * inner;
+    T* y = Y + static_cast<size_t>(plane) * inner;
+    const int stride = gridDim.y * blockDim.x;
+    if (kVectorized) {
+      for (int i = (blockIdx.y * blockDim.x + threadIdx.x) * kVecSize;
+           i < inner;
+           i += stride * kVecSize) {
+        AffineVec<T>(x + i, y + i, s, b);
+      }
+    } else {
+      for (int i = blockIdx.y * blockDim.x + threadIdx.x; i < inner;
+           i += stride) {
+        y[i] = convert::To<float, T>(convert::To<T, float>(x[i]) * s + b);
+      }
+    }
+  }
+}
+
+// channels last: consecutive elements are consecutive channels, so every
+// thread looks its channel up
 template <typename T>
-__global__ void ScaleBiasForwardNd(
-    const int n,
-    const T* in,
+__global__ void AffineNdNHWCKernel(
+    const int size,
+    const FixedDivisor<int32_t> channels,
+    const T* X,
     const T* scale,
     const T* bias,
-    const int scale_dim,
-    const int hxw_dim,
-    T* out) {
-  CUDA_1D_KERNEL_LOOP(index, n) {
-    const int scale_index = (index / hxw_dim) % scale_dim;
-    out[index] = in[index] * scale[scale_index] + bias[scale_index];
+    T* Y) {
+  CUDA_1D_KERNEL_LOOP(i, size) {
+    const int c = channels.mod(i);
+    const float b = bias ? convert::To<T, float>(bias[c]) : 0.f;
+    Y[i] = convert::To<float, T>(
+        convert::To<T, float>(X[i]) * convert::To<T, float>(scale[c]) + b);
   }
 }
 
 template <typename T>
-__global__ void ScaleForwardNd(
-    const int n,
-    const T* in,
+void AffineNdNHWCCUDA(
+    const int size,
+    const int C,
+    const T* X,
     const T* scale,
-    const int scale_dim,
-    const int hxw_dim,
-    T* out) {
-  CUDA_1D_KERNEL_LOOP(index, n) {
-    const int scale_index = (index / hxw_dim) % scale_dim;
-    out[index] = in[index] * scale[scale_index];
+    const T* bias,
+    T* Y,
+    CUDAContext* context) {
+  if (size == 0) {
+    return;
   }
+  AffineNdNHWCKernel<T>
+      <<<CAFFE_GET_BLOCKS(size),
+         CAFFE_CUDA_NUM_THREADS,
+         0,
+         context->cuda_stream()>>>(
+          size, FixedDivisor<int32_t>(C), X, scale, bias, Y);
 }
+
+template <typename T>
+bool IsVecAligned(const T* ptr) {
+  return reinterpret_cast<uintptr_t>(ptr) % (kVecSize * sizeof(T)) == 0;
+}
+
+template <typename T>
+void AffineNdCUDA(
+    const int N,
+    const int C,
+    const int inner,
+    const T* X,
+    const T* scale,
+    const T* bias,
+    T* Y,
+    CUDAContext* context) {
+  const int planes = N * C;
+  if (planes == 0 || inner == 0) {
+    return;
+  }
+  const bool vectorized =
+      inner % kVecSize == 0 && IsVecAligned(X) && IsVecAligned(Y);
+  const int work = vectorized ? inner / kVecSize : inner;
+  const dim3 grid(
+      std::min(planes, CAFFE_MAXIMUM_NUM_BLOCKS),
+      std::min(
+          (work + kAffineThreads - 1) / kAffineThreads, kMaxBlocksPerPlane));
+  if (vectorized) {
+    AffineNdKernel<T, true>
+        <<<grid, kAffineThreads, 0, context->cuda_stream()>>>(
+            planes, inner, FixedDivisor<int32_t>(C), X, scale, bias, Y);
+  } else {
+    AffineNdKernel<T, false>
+        <<<grid, kAffineThreads, 0, context->cuda_stream()>>>(
+            planes, inner, FixedDivisor<int32_t>(C), X, scale, bias, Y);
+  }
+}
+
 } // namespace
 
-template <>
-bool AffineNdOp<float, CUDAContext>::RunOnDevice() {
+template <typename T, class Context>
+template <typename U>
+bool AffineNdOp<T, Context>::DoRunWithType() {
   auto& X = Input(0);
   auto& scale = Input(1);
   auto& bias = Input(2);
   auto* Y = Output(0);
 
+  CAFFE_ENFORCE_GE(X.ndim(), 2);
+  const int N = X.dim32(0);
+  const int C =
+      order_ == StorageOrder::NCHW ? X.dim32(1) : X.dim32(X.ndim() - 1);
+  CAFFE_ENFORCE_EQ(scale.size(), C);
+  CAFFE_ENFORCE_EQ(bias.size(), C);
   Y->ResizeLike(X);
-  const int output_size = Y->size();
-  ScaleBiasForwardNd<float>
-      <<<CAFFE_GET_BLOCKS(output_size),
-         CAFFE_CUDA_NUM_THREADS,
-         0,
-         context_.cuda_stream()>>>(
-          output_size,
-          X.data<float>(),
-          scale.data<float>(),
-          bias.data<float>(),
-          X.dim32(1),
-          X.size() / X.dim32(0) / X.dim32(1),  // support TxHxW
-          Y->mutable_data<float>());
+  if (order_ == StorageOrder::NHWC) {
+    AffineNdNHWCCUDA<U>(
+        X.size(),
+        C,
+        X.template data<U>(),
+        scale.template data<U>(),
+        bias.template data<U>(),
+        Y->template mutable_data<U>(),
+        &context_);
+    return true;
+  }
+  AffineNdCUDA<U>(
+      N,
+      C,
+      X.size() / N / C, // support TxHxW
+      X.template data<U>(),
+      scale.template data<U>(),
+      bias.template data<U>(),
+      Y->template mutable_data<U>(),
+      &context_);
   return true;
 }
 
-template <>
-bool AffineNdGradientOp<float, CUDAContext>::RunOnDevice() {
+template <typename T, class Context>
+template <typename U>
+bool AffineNdGradientOp<T, Context>::DoRunWithType() {
   auto& scale = Input(0);
   auto& dY = Input(1);
   auto* dX = Output(0);
 
+  CAFFE_ENFORCE_GE(dY.ndim(), 2);
+  const int N = dY.dim32(0);
+  const int C =
+      order_ == StorageOrder::NCHW ? dY.dim32(1) : dY.dim32(dY.ndim() - 1);
+  CAFFE_ENFORCE_EQ(scale.size(), C);
   dX->ResizeLike(dY);
-  ScaleForwardNd<float>
-      <<<CAFFE_GET_BLOCKS(dY.size()),
-         CAFFE_CUDA_NUM_THREADS,
-         0,
-         context_.cuda_stream()>>>(
-          dY.size(),
-          dY.data<float>(),
-          scale.data<float>(),
-          dY.dim32(1),
-          dY.size() / dY.dim32(0) / dY.dim32(1),  // support TxHxW
-          dX->mutable_data<float>());
+  if (order_ == StorageOrder::NHWC) {
+    AffineNdNHWCCUDA<U>(
+        dY.size(),
+        C,
+        dY.template data<U>(),
+        scale.template data<U>(),
+        nullptr,
+        dX->template mutable_data<U>(),
+        &context_);
+    return true;
+  }
+  AffineNdCUDA<U>(
+      N,
+      C,
+      dY.size() / N / C, // support TxHxW
+      dY.template data<U>(),
+      scale.template data<U>(),
+      nullptr,
+      dX->template mutable_data<U>(),
+      &context_);
   return true;
 }
 
+template <>
+bool AffineNdOp<float, CUDAContext>::RunOnDevice() {
+  return DispatchHelper<TensorTypes<float, float16>>::call(this, Input(0));
+}
+
+template <>
+bool AffineNdGradientOp<float, CUDAContext>::RunOnDevice() {
+  return DispatchHelper<TensorTypes<float, float16>>::call(this, Input(1));
+}
+
 REGISTER_CUDA_OPERATOR(AffineNd, AffineNdOp<float, CUDAContext>);
 REGISTER_CUDA_OPERATOR(
     AffineNdGradient,
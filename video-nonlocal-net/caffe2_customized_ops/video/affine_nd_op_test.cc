@@ -0,0 +1,93 @@
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/operator_schema.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/affine_nd_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+void AddInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<TIndex>& dims,
+    const std::vector<float>& values) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  CAFFE_ENFORCE_EQ(tensor->size(), values.size());
+  std::copy(values.begin(), values.end(), tensor->mutable_data<float>());
+}
+
+std::vector<float> GetOutput(Workspace* ws, const std::string& name) {
+  const auto& tensor = ws->GetBlob(name)->Get<TensorCPU>();
+  return std::vector<float>(
+      tensor.data<float>(), tensor.data<float>() + tensor.size());
+}
+
+void RunOp(
+    Workspace* ws,
+    const std::string& type,
+    const std::vector<std::string>& inputs,
+    const std::string& output,
+    const std::string& order) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  def.add_output(output);
+  auto* arg = def.add_arg();
+  arg->set_name("order");
+  arg->set_s(order);
+  auto op = CreateOperator(def, ws);
+  ASSERT_TRUE(op->Run());
+}
+
+} // namespace
+
+// a 1 x 2 x (2 x 1 x 1) clip, channels first then channels last
+TEST(AffineNdOpTest, AppliesPerChannelInBothOrders) {
+  Workspace ws;
+  AddInput(&ws, "scale", {2}, {2, -1});
+  AddInput(&ws, "bias", {2}, {1, 10});
+  AddInput(&ws, "x_nchw", {1, 2, 2, 1, 1}, {1, 2, 3, 4});
+  AddInput(&ws, "x_nhwc", {1, 2, 1, 1, 2}, {1, 3, 2, 4});
+
+  RunOp(&ws, "AffineNd", {"x_nchw", "scale", "bias"}, "y_nchw", "NCHW");
+  EXPECT_EQ(GetOutput(&ws, "y_nchw"), std::vector<float>({3, 5, 7, 6}));
+  RunOp(&ws, "AffineNd", {"x_nhwc", "scale", "bias"}, "y_nhwc", "NHWC");
+  EXPECT_EQ(GetOutput(&ws, "y_nhwc"), std::vector<float>({3, 7, 5, 6}));
+}
+
+TEST(AffineNdOpTest, GradientScalesChannelsLast) {
+  Workspace ws;
+  AddInput(&ws, "scale", {3}, {1, 2, 3});
+  AddInput(&ws, "dy", {2, 1, 3}, {1, 1, 1, 2, 2, 2});
+
+  RunOp(&ws, "AffineNdGradient", {"scale", "dy"}, "dx", "NHWC");
+  EXPECT_EQ(GetOutput(&ws, "dx"), std::vector<float>({1, 2, 3, 2, 4, 6}));
+}
+
+TEST(AffineNdOpTest, InfersTheShapeOfX) {
+  OperatorDef def;
+  def.set_type("AffineNd");
+  def.add_input("x");
+  def.add_input("scale");
+  def.add_input("bias");
+  def.add_output("y");
+  const auto out = OpSchemaRegistry::Schema("AffineNd")->InferTensor(
+      def,
+      {CreateTensorShape(vector<int>{2, 4, 8, 7, 7}, TensorProto::FLOAT),
+       CreateTensorShape(vector<int>{4}, TensorProto::FLOAT),
+       CreateTensorShape(vector<int>{4}, TensorProto::FLOAT)});
+  ASSERT_EQ(out.size(), 1);
+  EXPECT_EQ(
+      std::vector<int64_t>(out[0].dims().begin(), out[0].dims().end()),
+      std::vector<int64_t>({2, 4, 8, 7, 7}));
+  EXPECT_EQ(out[0].data_type(), TensorProto::FLOAT);
+}
+
+} // namespace caffe2
@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/clip_arena.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "caffe2/core/logging.h"
+#include "caffe2/core/stats.h"
+
+namespace caffe2 {
+
+namespace {
+
+constexpr size_t kClipArenaAlignment = 64;
+// blocks are at least this big, about a 320x240 RGB clip of 32 frames
+constexpr size_t kClipArenaMinBlockSize = 8 << 20;
+
+struct ClipArenaStats {
+  CAFFE_STAT_CTOR(ClipArenaStats);
+  CAFFE_EXPORTED_STAT(clip_arena_reserved_bytes);
+  CAFFE_EXPORTED_STAT(clip_arena_high_water_bytes);
+  CAFFE_AVG_EXPORTED_STAT(clip_arena_bytes_per_clip);
+};
+
+ClipArenaStats& GetClipArenaStats() {
+  static ClipArenaStats stats("video_clip_arena");
+  return stats;
+}
+
+size_t AlignUp(size_t nbytes) {
+  return (nbytes + kClipArenaAlignment - 1) & ~(kClipArenaAlignment - 1);
+}
+
+} // namespace
+
+ClipArena::ClipArena()
+    : current_block_(0), offset_(0), bytes_in_use_(0), high_water_(0) {}
+
+ClipArena::~ClipArena() {
+  CAFFE_EVENT(
+      GetClipArenaStats(),
+      clip_arena_reserved_bytes,
+      -static_cast<int64_t>(capacity()));
+  CAFFE_EVENT(
+      GetClipArenaStats(),
+      clip_arena_high_water_bytes,
+      -static_cast<int64_t>(high_water_));
+  FreeBlocks();
+}
+
+size_t ClipArena::capacity() const {
+  size_t total = 0;
+  for (const auto& block : blocks_) {
+    total += block.size;
+  }
+  return total;
+}
+
+void ClipArena::AddBlock(size_t nbytes) {
+  Block block;
+  block.size = AlignUp(nbytes);
+  void* data = nullptr;
+  CAFFE_ENFORCE_EQ(
+      posix_memalign(&data, kClipArenaAlignment, block.size), 0);
+  block.data = static_cast<uint8_t*>(data);
+  blocks_.push_back(block);
+  CAFFE_EVENT(
+      GetClipArenaStats(),
+      clip_arena_reserved_bytes,
+      static_cast<int64_t>(block.size));
+}
+
+void ClipArena::FreeBlocks() {
+  for (auto& block : blocks_) {
+    free(block.data);
+  }
+  blocks_.clear();
+}
+
+void* ClipArena::Allocate(size_t nbytes) {
+  nbytes = AlignUp(std::max<size_t>(nbytes, 1));
+  while (current_block_ < blocks_.size() &&
+         offset_ + nbytes > blocks_[current_block_].size) {
+    ++current_block_;
+    offset_ = 0;
+  }
+  if (current_block_ == blocks_.size()) {
+    // grow geometrically so that a long video needs few blocks
+    const size_t last_size = blocks_.empty() ? 0 : blocks_.back().size;
+    AddBlock(std::max({nbytes, 2 * last_size, kClipArenaMinBlockSize}));
+    offset_ = 0;
+  }
+  void* ptr = blocks_[current_block_].data + offset_;
+  offset_ += nbytes;
+  bytes_in_use_ += nbytes;
+  if (bytes_in_use_ > high_water_) {
+    CAFFE_EVENT(
+        GetClipArenaStats(),
+        clip_arena_high_water_bytes,
+        static_cast<int64_t>(bytes_in_use_ - high_water_));
+    high_water_ = bytes_in_use_;
+  }
+  return ptr;
+}
+
+void ClipArena::Reset() {
+  if (bytes_in_use_ > 0) {
+    CAFFE_EVENT(
+        GetClipArenaStats(),
+        clip_arena_bytes_per_clip,
+        static_cast<int64_t>(bytes_in_use_));
+  }
+  if (blocks_.size() > 1) {
+    CAFFE_EVENT(
+        GetClipArenaStats(),
+        clip_arena_reserved_bytes,
+        -static_cast<int64_t>(capacity()));
+    FreeBlocks();
+    AddBlock(high_water_);
+  }
+  current_block_ = 0;
+  offset_ = 0;
+  bytes_in_use_ = 0;
+}
+
+ClipArena& ThreadLocalClipArena() {
+  static thread_local ClipArena arena;
+  return arena;
+}
+
+} // namespace caffe2
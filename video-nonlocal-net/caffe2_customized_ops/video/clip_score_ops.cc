@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/clip_score_ops.h"
+
+namespace caffe2 {
+
+REGISTER_CPU_OPERATOR(AccumulateClipScores, AccumulateClipScoresOp);
+
+OPERATOR_SCHEMA(AccumulateClipScores)
+    .NumInputs(2)
+    .NumOutputs(2)
+    .SetDoc(R"DOC(
+Accumulates the scores (e.g. softmax) of the test clips of a batch into the
+running average of their videos on the ClipScoreBoard `board`, which the
+CustomizedVideoInput ops of a progressive test share. A video is finished,
+and gets no more clips from the input ops, once the top two classes of its
+average are `margin` apart after `min_clips` clips, or after `max_clips`
+clips. The clips of finished videos that were already on their way, and the
+padding clips (video id -1), are skipped.
+)DOC")
+    .Arg("board", "name of the ClipScoreBoard of the test")
+    .Arg("margin", "top-1 minus top-2 average score to finish a video at")
+    .Arg("min_clips", "clips of a video before it can be finished, default 1")
+    .Arg("max_clips", "clips that finish a video in any case, 0 for none")
+    .Input(0, "scores", "N x C scores of the clips")
+    .Input(1, "video_ids", "N int video ids of the clips, -1 for padding")
+    .Output(
+        0,
+        "video_scores",
+        "N x C running average of the video of each clip, zeros if skipped")
+    .Output(
+        1,
+        "status",
+        "N int: -1 skipped, 0 added, 1 added and the video finished");
+
+SHOULD_NOT_DO_GRADIENT(AccumulateClipScores);
+
+} // namespace caffe2
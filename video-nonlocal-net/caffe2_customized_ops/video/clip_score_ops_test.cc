@@ -0,0 +1,76 @@
+#include <string>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/clip_score_ops.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+void AddScores(Workspace* ws, const std::vector<std::vector<float>>& scores) {
+  auto* tensor = ws->CreateBlob("scores")->GetMutable<TensorCPU>();
+  tensor->Resize(scores.size(), scores[0].size());
+  float* data = tensor->mutable_data<float>();
+  for (const auto& clip : scores) {
+    data = std::copy(clip.begin(), clip.end(), data);
+  }
+}
+
+void AddVideoIds(Workspace* ws, const std::vector<int>& ids) {
+  auto* tensor = ws->CreateBlob("video_ids")->GetMutable<TensorCPU>();
+  tensor->Resize(ids.size());
+  std::copy(ids.begin(), ids.end(), tensor->mutable_data<int>());
+}
+
+std::vector<int> RunOp(Workspace* ws, const std::string& board) {
+  OperatorDef def;
+  def.set_type("AccumulateClipScores");
+  def.add_input("scores");
+  def.add_input("video_ids");
+  def.add_output("video_scores");
+  def.add_output("status");
+  def.add_arg()->CopyFrom(MakeArgument<std::string>("board", board));
+  def.add_arg()->CopyFrom(MakeArgument<float>("margin", 0.5f));
+  def.add_arg()->CopyFrom(MakeArgument<int>("min_clips", 2));
+  def.add_arg()->CopyFrom(MakeArgument<int>("max_clips", 3));
+  auto op = CreateOperator(def, ws);
+  EXPECT_TRUE(op->Run());
+  const auto& status = ws->GetBlob("status")->Get<TensorCPU>();
+  return std::vector<int>(
+      status.data<int>(), status.data<int>() + status.size());
+}
+
+} // namespace
+
+TEST(AccumulateClipScoresTest, FinishesVideos) {
+  const std::string board = "FinishesVideos";
+  // the board lives as long as someone holds it, not just one op
+  const auto scores = ClipScoreBoard::Get(board);
+  Workspace ws;
+  // video 0 is confident after its second clip, video 1 never is; the
+  // last clip is padding
+  AddScores(
+      &ws,
+      {{0.9f, 0.1f}, {0.5f, 0.5f}, {0.9f, 0.1f}, {0.5f, 0.5f}, {1.f, 0.f}});
+  AddVideoIds(&ws, {0, 1, 0, 1, -1});
+  EXPECT_EQ(
+      RunOp(&ws, board),
+      std::vector<int>(
+          {kClipAdded, kClipAdded, kClipFinished, kClipAdded, kClipSkipped}));
+  const auto& average = ws.GetBlob("video_scores")->Get<TensorCPU>();
+  EXPECT_FLOAT_EQ(average.data<float>()[2 * 2], 0.9f);
+  EXPECT_FLOAT_EQ(average.data<float>()[2 * 3], 0.5f);
+  EXPECT_FLOAT_EQ(average.data<float>()[2 * 4], 0.f);
+
+  // the late clip of video 0 is skipped, video 1 ends at max_clips
+  AddScores(&ws, {{0.9f, 0.1f}, {0.5f, 0.5f}});
+  AddVideoIds(&ws, {0, 1});
+  EXPECT_EQ(
+      RunOp(&ws, board), std::vector<int>({kClipSkipped, kClipFinished}));
+  EXPECT_TRUE(scores->IsFinished(1));
+}
+
+} // namespace caffe2
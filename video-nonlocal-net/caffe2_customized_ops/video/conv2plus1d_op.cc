@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <algorithm>
+
+#include "caffe2/video/conv2plus1d_op.h"
+
+namespace caffe2 {
+
+template <>
+void Conv2Plus1DAffine<CPUContext>(
+    const int C,
+    const int HW,
+    const float* scale,
+    const float* bias,
+    const bool relu,
+    const float* pre,
+    float* mid,
+    CPUContext* /*context*/) {
+  for (int c = 0; c < C; ++c) {
+    const float a = scale[c];
+    const float b = bias[c];
+    const float* x = pre + c * HW;
+    float* y = mid + c * HW;
+    if (relu) {
+      for (int i = 0; i < HW; ++i) {
+        y[i] = std::max(a * x[i] + b, 0.f);
+      }
+    } else {
+      for (int i = 0; i < HW; ++i) {
+        y[i] = a * x[i] + b;
+      }
+    }
+  }
+}
+
+template <>
+void Conv2Plus1DAffineGradient<CPUContext>(
+    const int C,
+    const int HW,
+    const float* scale,
+    const float* bias,
+    const bool relu,
+    const float* pre,
+    float* dmid,
+    float* dscale,
+    float* dbias,
+    CPUContext* /*context*/) {
+  for (int c = 0; c < C; ++c) {
+    const float a = scale[c];
+    const float b = bias[c];
+    const float* x = pre + c * HW;
+    float* dy = dmid + c * HW;
+    float ds = 0.f;
+    float db = 0.f;
+    for (int i = 0; i < HW; ++i) {
+      const float d = (!relu || a * x[i] + b > 0.f) ? dy[i] : 0.f;
+      ds += d * x[i];
+      db += d;
+      dy[i] = d * a;
+    }
+    dscale[c] += ds;
+    dbias[c] += db;
+  }
+}
+
+REGISTER_CPU_OPERATOR(Conv2Plus1D, Conv2Plus1DOp<float, CPUContext>);
+REGISTER_CPU_OPERATOR(
+    Conv2Plus1DGradient,
+    Conv2Plus1DGradientOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(Conv2Plus1D)
+    .NumInputs(5, 6)
+    .NumOutputs(1)
+    .SetDoc(R"DOC(
+A factorized (2+1)D convolution in one op: the temporal kt x 1 x 1 conv of X
+by Wt, a per-channel affine (a frozen or folded BN) and an optional relu,
+then the spatial 1 x kh x kw conv by Ws:
+Y = Ws * relu(scale * (Wt * X) + bias) + bs.
+The intermediate is made one frame at a time and read back right away, so
+it is never written out as a whole blob, neither by the op nor by its
+gradient, which makes it again.
+)DOC")
+    .Arg("temporal_stride", "stride of the temporal conv (default 1)")
+    .Arg("temporal_pad", "frames padded on each end for the temporal conv")
+    .Arg("spatial_strides", "[h, w] strides of the spatial conv")
+    .Arg("spatial_pads", "[h, w, h_end, w_end] pads of the spatial conv")
+    .Arg("relu", "whether the relu follows the affine (default 1)")
+    .Input(0, "X", "N x C x T x H x W")
+    .Input(1, "Wt", "Cm x C x kt x 1 x 1 temporal filters")
+    .Input(2, "scale", "Cm scales of the intermediate")
+    .Input(3, "bias", "Cm biases of the intermediate")
+    .Input(4, "Ws", "M x Cm x 1 x kh x kw spatial filters")
+    .Input(5, "bs", "optional M biases of the output")
+    .Output(0, "Y", "N x M x To x Ho x Wo");
+
+OPERATOR_SCHEMA(Conv2Plus1DGradient)
+    .NumInputs(6, 7)
+    .NumOutputs(5, 6);
+
+class GetConv2Plus1DGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    vector<string> inputs;
+    vector<string> outputs;
+    for (int i = 0; i < def_.input_size(); ++i) {
+      inputs.push_back(I(i));
+      outputs.push_back(GI(i));
+    }
+    inputs.push_back(GO(0));
+    return SingleGradientDef(
+        "Conv2Plus1DGradient", "", inputs, outputs);
+  }
+};
+
+REGISTER_GRADIENT(Conv2Plus1D, GetConv2Plus1DGradient);
+
+} // namespace caffe2
@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <cub/block/block_reduce.cuh>
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/video/conv2plus1d_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+constexpr int kReduceThreads = 128;
+using BlockReduce = cub::BlockReduce<float, kReduceThreads>;
+
+__global__ void Conv2Plus1DAffineKernel(
+    const int count,
+    const int HW,
+    const float* scale,
+    const float* bias,
+    const bool relu,
+    const float* pre,
+    float* mid) {
+  CUDA_1D_KERNEL_LOOP(i, count) {
+    const int c = i / HW;
+    const float y = __ldg(scale + c) * pre[i] + __ldg(bias + c);
+    mid[i] = relu ? fmaxf(y, 0.f) : y;
+  }
+}
+
+// a block per channel
+__global__ void Conv2Plus1DAffineGradientKernel(
+    const int HW,
+    const float* scale,
+    const float* bias,
+    const bool relu,
+    const float* pre,
+    float* dmid,
+    float* dscale,
+    float* dbias) {
+  __shared__ typename BlockReduce::TempStorage reduce_storage;
+  const int c = blockIdx.x;
+  const float a = scale[c];
+  const float b = bias[c];
+  const float* x = pre + c * HW;
+  float* dy = dmid + c * HW;
+  float ds = 0.f;
+  float db = 0.f;
+  for (int i = threadIdx.x; i < HW; i += blockDim.x) {
+    const float d = (!relu || a * x[i] + b > 0.f) ? dy[i] : 0.f;
+    ds += d * x[i];
+    db += d;
+    dy[i] = d * a;
+  }
+  ds = BlockReduce(reduce_storage).Sum(ds);
+  __syncthreads();
+  db = BlockReduce(reduce_storage).Sum(db);
+  if (threadIdx.x == 0) {
+    dscale[c] += ds;
+    dbias[c] += db;
+  }
+}
+
+} // namespace
+
+template <>
+void Conv2Plus1DAffine<CUDAContext>(
+    const int C,
+    const int HW,
+    const float* scale,
+    const float* bias,
+    const bool relu,
+    const float* pre,
+    float* mid,
+    CUDAContext* context) {
+  const int count = C * HW;
+  Conv2Plus1DAffineKernel<<<
+      CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(count, HW, scale, bias, relu, pre, mid);
+}
+
+template <>
+void Conv2Plus1DAffineGradient<CUDAContext>(
+    const int C,
+    const int HW,
+    const float* scale,
+    const float* bias,
+    const bool relu,
+    const float* pre,
+    float* dmid,
+    float* dscale,
+    float* dbias,
+    CUDAContext* context) {
+  Conv2Plus1DAffineGradientKernel<<<
+      C,
+      kReduceThreads,
+      0,
+      context->cuda_stream()>>>(
+      HW, scale, bias, relu, pre, dmid, dscale, dbias);
+}
+
+REGISTER_CUDA_OPERATOR(Conv2Plus1D, Conv2Plus1DOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR(
+    Conv2Plus1DGradient,
+    Conv2Plus1DGradientOp<float, CUDAContext>);
+
+} // namespace caffe2
@@ -23,9 +23,16 @@
   */
   
 #include "caffe2/video/customized_video_decoder.h"
+#include "caffe2/core/context.h"
 #include "caffe2/core/logging.h"
+#include "caffe2/core/stats.h"
+#include "caffe2/core/timer.h"
+#include "caffe2/video/video_stats.h"
 
 #include <stdio.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <mutex>
 #include <random>
 
@@ -39,7 +46,120 @@ extern "C" {
 
 namespace caffe2 {
 
-CustomVideoDecoder::CustomVideoDecoder() {
+namespace {
+
+struct VideoDecoderStats {
+  CAFFE_STAT_CTOR(VideoDecoderStats);
+  // time of converting and scaling the decoded frames, of all decoders
+  CAFFE_AVG_EXPORTED_STAT(sws_time_ns);
+  // time of a decodeLoop, from the seek to the last frame it kept
+  CAFFE_LATENCY_HISTOGRAM_STAT(decode_loop_latency);
+  // bytes of the video packets demuxed
+  CAFFE_EXPORTED_STAT(packet_bytes_read);
+  // frames out of the codec, and the frames of those sampled for clips
+  CAFFE_EXPORTED_STAT(frames_decoded);
+  CAFFE_EXPORTED_STAT(frames_kept);
+  // seeks to a clip start or a rewind that failed
+  CAFFE_EXPORTED_STAT(seek_failures);
+  // opened streams, and those of them that avformat_find_stream_info probed
+  CAFFE_EXPORTED_STAT(streams_opened);
+  CAFFE_EXPORTED_STAT(streams_probed);
+};
+
+VideoDecoderStats& DecoderStats() {
+  static VideoDecoderStats stats("video_decoder");
+  return stats;
+}
+
+// the swscale destination of frame t of a planar buffer of frames frames,
+// in the order of the planes of the output format: GBRP takes them as G, B,
+// R while the clip is laid out as R, G, B, YUV420P as Y, U, V
+void PlanarDestination(
+    const PlanarLayout& layout,
+    uint8_t* buffer,
+    const int frames,
+    const int t,
+    uint8_t* planes[4],
+    int linesizes[4]) {
+  static const int kGbrpPlanes[3] = {1, 2, 0};
+  for (int i = 0; i < 3; i++) {
+    const int c = layout.yuv ? i : kGbrpPlanes[i];
+    planes[i] = buffer + layout.offset(frames, t, c);
+    linesizes[i] = layout.width[c];
+  }
+  planes[3] = nullptr;
+  linesizes[3] = 0;
+}
+
+} // namespace
+
+// the lowres of the FAST_QUALITY decoding of a width x height stream by
+// codec: the most halvings of the frames, up to the max_lowres of codec,
+// that leave them at least the output size of params
+int FastLowres(
+    const Params& params,
+    const AVCodec* codec,
+    const int width,
+    const int height) {
+  int lowres = 0;
+  while (lowres < codec->max_lowres) {
+    const int w = width >> (lowres + 1);
+    const int h = height >> (lowres + 1);
+    bool large = false;
+    if (params.outputShortSide_ > 0) {
+      large = std::min(w, h) >= params.outputShortSide_;
+    } else if (params.outputWidth_ > 0 || params.outputHeight_ > 0) {
+      large = w >= params.outputWidth_ && h >= params.outputHeight_;
+    } else if (params.maxOutputDimension_ > 0) {
+      large = std::max(w, h) >= params.maxOutputDimension_;
+    }
+    if (!large) {
+      break;
+    }
+    ++lowres;
+  }
+  return lowres;
+}
+
+int ClipFrameOffset(int clipFrame, double videoFps, double clipFps) {
+  if (!(videoFps > 0) || !(clipFps > 0)) {
+    return clipFrame;
+  }
+  return (int)round(clipFrame * videoFps / clipFps);
+}
+
+int RandomClipStart(
+    int numFrames,
+    int clipFrames,
+    const VideoStreamInfo& info,
+    PhiloxRandom* randgen) {
+  if (numFrames <= clipFrames) {
+    return 0;
+  }
+  int start = std::uniform_int_distribution<>(
+      0, numFrames - clipFrames)(*randgen);
+  if (info.keyFrameJitter >= 0) {
+    auto keyIter = std::upper_bound(
+        info.keyFrames.begin(), info.keyFrames.end(), start);
+    if (keyIter != info.keyFrames.begin()) {
+      const int keyFrame = *(keyIter - 1);
+      if (start - keyFrame > info.keyFrameJitter) {
+        start = keyFrame +
+            std::uniform_int_distribution<>(0, info.keyFrameJitter)(*randgen);
+      }
+    }
+  }
+  return start;
+}
+
+CustomVideoDecoder::CustomVideoDecoder()
+    : reuseContexts_(false),
+      inputContext_(nullptr),
+      videoStream_(nullptr),
+      videoStreamIndex_(-1),
+      videoCodecContext_(nullptr),
+      scaleContext_(nullptr),
+      randgen_(RandomNumberSeed(), 0, 0) {
   static bool gInitialized = false;
   static std::mutex gMutex;
   std::unique_lock<std::mutex> lock(gMutex);
@@ -51,140 +171,293 @@ CustomVideoDecoder::CustomVideoDecoder() {
   }
 }
 
-void CustomVideoDecoder::decodeLoop(
-    const string& videoName,
-    VideoIOContext& ioctx,
-    const Params& params,
-    std::vector<std::unique_ptr<DecodedFrame>>& sampledFrames,
-    int maxFrames,
-    bool decodeFromStart) {
-  AVPixelFormat pixFormat = params.pixelFormat_;
+CustomVideoDecoder::~CustomVideoDecoder() {
+  closeStream();
+  sws_freeContext(scaleContext_);
+}
 
-  AVFormatContext* inputContext = avformat_alloc_context();
-  AVStream* videoStream_ = nullptr;
-  AVCodecContext* videoCodecContext_ = nullptr;
-  AVFrame* videoStreamFrame_ = nullptr;
-  AVPacket packet;
-  av_init_packet(&packet); // init packet
-  SwsContext* scaleContext_ = nullptr;
-  /* if a valid value is given for maxFrames, then decode only limited frames.
-   * Else decode all the frames */
-  bool mustDecodeAll = (maxFrames <= 0);
-  try {
-    inputContext->pb = ioctx.get_avio();
-    inputContext->flags |= AVFMT_FLAG_CUSTOM_IO;
-    int ret = 0;
+bool CustomVideoDecoder::openStream(
+    const string& videoName,
+    const Params& params) {
+  inputContext_ = avformat_alloc_context();
+  inputContext_->pb = ioctx_->get_avio();
+  inputContext_->flags |= AVFMT_FLAG_CUSTOM_IO;
+  int ret = 0;
 
-    // Determining the input format:
-    int probeSz = 1 * 1024 + AVPROBE_PADDING_SIZE;
-    DecodedFrame::AvDataPtr probe((uint8_t*)av_malloc(probeSz));
+  // Determining the input format:
+  int probeSz = 1 * 1024 + AVPROBE_PADDING_SIZE;
+  DecodedFrame::AvDataPtr probe((uint8_t*)av_malloc(probeSz));
 
-    memset(probe.get(), 0, probeSz);
-    int len = ioctx.read(probe.get(), probeSz - AVPROBE_PADDING_SIZE);
-    if (len < probeSz - AVPROBE_PADDING_SIZE) {
-      LOG(ERROR) << "Insufficient data to determine video format";
-      return;
-    }
+  memset(probe.get(), 0, probeSz);
+  int len = ioctx_->read(probe.get(), probeSz - AVPROBE_PADDING_SIZE);
+  if (len < probeSz - AVPROBE_PADDING_SIZE) {
+    LOG(ERROR) << "Insufficient data to determine video format";
+    return false;
+  }
 
-    // seek back to start of stream
-    ioctx.seek(0, SEEK_SET);
+  // seek back to start of stream
+  ioctx_->seek(0, SEEK_SET);
 
-    unique_ptr<AVProbeData> probeData(new AVProbeData());
-    probeData->buf = probe.get();
-    probeData->buf_size = len;
-    probeData->filename = "";
-    // Determine the input-format:
-    inputContext->iformat = av_probe_input_format(probeData.get(), 1);
+  unique_ptr<AVProbeData> probeData(new AVProbeData());
+  probeData->buf = probe.get();
+  probeData->buf_size = len;
+  probeData->filename = "";
+  // Determine the input-format:
+  inputContext_->iformat = av_probe_input_format(probeData.get(), 1);
 
-    ret = avformat_open_input(&inputContext, "", nullptr, nullptr);
-    if (ret < 0) {
-      LOG(ERROR) << "Unable to open stream " << ffmpegErrorStr(ret);
-      return;
-    }
+  ret = avformat_open_input(&inputContext_, "", nullptr, nullptr);
+  if (ret < 0) {
+    LOG(ERROR) << "Unable to open stream " << ffmpegErrorStr(ret);
+    return false;
+  }
 
-    ret = avformat_find_stream_info(inputContext, nullptr);
+  CAFFE_EVENT(DecoderStats(), streams_opened, 1);
+  // probing decodes the first frames of every stream, a good part of the
+  // time of a short clip. The header of most containers already describes
+  // the streams, so the probe is left out where the meta data of the video
+  // vouches for it, unless the header turns out not to do
+  bool probed = false;
+  auto findStreamInfo = [&]() {
+    CAFFE_EVENT(DecoderStats(), streams_probed, 1);
+    probed = true;
+    ret = avformat_find_stream_info(inputContext_, nullptr);
     if (ret < 0) {
       LOG(ERROR) << "Unable to find stream info in " << videoName << " "
                  << ffmpegErrorStr(ret);
-      return;
+      return false;
     }
-
-    // Decode the first video stream
-    int videoStreamIndex_ = params.streamIndex_;
+    return true;
+  };
+  auto findVideoStream = [&]() {
+    videoStreamIndex_ = params.streamIndex_;
+    videoStream_ = nullptr;
     if (videoStreamIndex_ == -1) {
-      for (int i = 0; i < inputContext->nb_streams; i++) {
-        auto stream = inputContext->streams[i];
+      // Decode the first video stream
+      for (int i = 0; i < inputContext_->nb_streams; i++) {
+        auto stream = inputContext_->streams[i];
         if (stream->codec->codec_type == AVMEDIA_TYPE_VIDEO) {
           videoStreamIndex_ = i;
           videoStream_ = stream;
           break;
         }
       }
+    } else if (
+        videoStreamIndex_ >= 0 &&
+        videoStreamIndex_ < (int)inputContext_->nb_streams) {
+      videoStream_ = inputContext_->streams[videoStreamIndex_];
     }
-
-    if (videoStream_ == nullptr) {
-      LOG(ERROR) << "Unable to find video stream in " << videoName << " "
-                 << ffmpegErrorStr(ret);
-      return;
+  };
+  if (!params.streamInfo_.skipProbe && !findStreamInfo()) {
+    return false;
+  }
+  findVideoStream();
+  if (!probed &&
+      (videoStream_ == nullptr ||
+       videoStream_->codec->codec_id == AV_CODEC_ID_NONE ||
+       videoStream_->codec->width <= 0 || videoStream_->codec->height <= 0)) {
+    if (!findStreamInfo()) {
+      return false;
     }
+    findVideoStream();
+  }
+
+  if (videoStream_ == nullptr) {
+    LOG(ERROR) << "Unable to find video stream in " << videoName << " "
+               << ffmpegErrorStr(ret);
+    return false;
+  }
 
-    // Initialize codec
-    videoCodecContext_ = videoStream_->codec;
+  // the demuxer drops the packets of the other streams, e.g. the audio,
+  // instead of reading them for the decode loops to skip
+  for (int i = 0; i < inputContext_->nb_streams; i++) {
+    if (i != videoStreamIndex_) {
+      inputContext_->streams[i]->discard = AVDISCARD_ALL;
+    }
+  }
 
-    ret = avcodec_open2(
-        videoCodecContext_,
-        avcodec_find_decoder(videoCodecContext_->codec_id),
-        nullptr);
+  // Initialize codec
+  ret = -1;
+  if (params.decodeBackend_ == CUVID_DECODE) {
+    const string cuvidName =
+        string(avcodec_get_name(videoStream_->codec->codec_id)) + "_cuvid";
+    AVCodec* cuvidCodec = avcodec_find_decoder_by_name(cuvidName.c_str());
+    if (cuvidCodec) {
+      ret = avcodec_open2(videoStream_->codec, cuvidCodec, nullptr);
+    }
     if (ret < 0) {
-      LOG(ERROR) << "Cannot open video codec : "
-                 << videoCodecContext_->codec->name;
-      return;
+      LOG(ERROR) << "Cannot open " << cuvidName << " for " << videoName
+                 << ", using software decoding";
     }
+  }
+  if (ret < 0) {
+    // the thread settings only take effect when the codec is opened
+    AVCodec* codec = avcodec_find_decoder(videoStream_->codec->codec_id);
+    videoStream_->codec->thread_count = params.codecThreads_;
+    videoStream_->codec->thread_type = params.codecThreadType_;
+    // as do the shortcuts of the whole decoding
+    if (params.decodeQuality_ == FAST_QUALITY && codec) {
+      videoStream_->codec->flags2 |= AV_CODEC_FLAG2_FAST;
+      videoStream_->codec->lowres = FastLowres(
+          params,
+          codec,
+          videoStream_->codec->width,
+          videoStream_->codec->height);
+    }
+    ret = avcodec_open2(videoStream_->codec, codec, nullptr);
+  }
+  if (ret < 0) {
+    LOG(ERROR) << "Cannot open video codec : "
+               << videoStream_->codec->codec->name;
+    return false;
+  }
+  videoCodecContext_ = videoStream_->codec;
+  return true;
+}
 
-    // Calcuate if we need to rescale the frames
-    int outWidth = videoCodecContext_->width;
-    int outHeight = videoCodecContext_->height;
-
-    if (params.maxOutputDimension_ != -1) {
-      if (videoCodecContext_->width > videoCodecContext_->height) {
-        // dominant width
-        if (params.maxOutputDimension_ < videoCodecContext_->width) {
-          float ratio =
-              (float)params.maxOutputDimension_ / videoCodecContext_->width;
-          outWidth = params.maxOutputDimension_;
-          outHeight = (int)round(videoCodecContext_->height * ratio);
-        }
-      } else {
-        // dominant height
-        if (params.maxOutputDimension_ < videoCodecContext_->height) {
-          float ratio =
-              (float)params.maxOutputDimension_ / videoCodecContext_->height;
-          outWidth = (int)round(videoCodecContext_->width * ratio);
-          outHeight = params.maxOutputDimension_;
-        }
+bool CustomVideoDecoder::rewindStream(const string& videoName) {
+  int ret = av_seek_frame(
+      inputContext_, videoStreamIndex_, 0, AVSEEK_FLAG_BACKWARD);
+  if (ret < 0) {
+    CAFFE_EVENT(DecoderStats(), seek_failures, 1);
+    LOG(ERROR) << "Unable to rewind " << videoName << " "
+               << ffmpegErrorStr(ret);
+    return false;
+  }
+  avcodec_flush_buffers(videoCodecContext_);
+  return true;
+}
+
+void CustomVideoDecoder::closeStream() {
+  if (videoCodecContext_) {
+    avcodec_close(videoCodecContext_);
+  }
+  if (inputContext_) {
+    avformat_close_input(&inputContext_);
+    avformat_free_context(inputContext_);
+  }
+  inputContext_ = nullptr;
+  videoStream_ = nullptr;
+  videoStreamIndex_ = -1;
+  videoCodecContext_ = nullptr;
+  openedFile_.clear();
+  ioctx_.reset();
+}
+
+void CustomVideoDecoder::setDecodeQuality(const Params& params) {
+  // key frames stay exact, the frames predicted from them drift until the
+  // next key frame at most
+  const AVDiscard skip = params.decodeQuality_ == FAST_QUALITY
+      ? AVDISCARD_NONKEY
+      : AVDISCARD_DEFAULT;
+  videoCodecContext_->skip_loop_filter = skip;
+  videoCodecContext_->skip_idct = skip;
+}
+
+void CustomVideoDecoder::getOutputSize(
+    const Params& params,
+    int* outWidth,
+    int* outHeight) {
+  *outWidth = videoCodecContext_->width;
+  *outHeight = videoCodecContext_->height;
+
+  if (params.outputShortSide_ != -1) {
+    // same rounding as GetScaledSize in customized_video_io
+    float ratio = videoCodecContext_->height > videoCodecContext_->width
+        ? (float)params.outputShortSide_ / videoCodecContext_->width
+        : (float)params.outputShortSide_ / videoCodecContext_->height;
+    *outWidth = (int)((float)videoCodecContext_->width * ratio);
+    *outHeight = (int)((float)videoCodecContext_->height * ratio);
+  } else if (params.maxOutputDimension_ != -1) {
+    if (videoCodecContext_->width > videoCodecContext_->height) {
+      // dominant width
+      if (params.maxOutputDimension_ < videoCodecContext_->width) {
+        float ratio =
+            (float)params.maxOutputDimension_ / videoCodecContext_->width;
+        *outWidth = params.maxOutputDimension_;
+        *outHeight = (int)round(videoCodecContext_->height * ratio);
       }
     } else {
-      outWidth = params.outputWidth_ == -1 ? videoCodecContext_->width
-                                           : params.outputWidth_;
-      outHeight = params.outputHeight_ == -1 ? videoCodecContext_->height
-                                             : params.outputHeight_;
-    }
-
-    // Make sure that we have a valid format
-    CAFFE_ENFORCE_NE(videoCodecContext_->pix_fmt, AV_PIX_FMT_NONE);
-
-    // Create a scale context
-    scaleContext_ = sws_getContext(
-        videoCodecContext_->width,
-        videoCodecContext_->height,
-        videoCodecContext_->pix_fmt,
-        outWidth,
-        outHeight,
-        pixFormat,
-        SWS_FAST_BILINEAR,
-        nullptr,
-        nullptr,
-        nullptr);
+      // dominant height
+      if (params.maxOutputDimension_ < videoCodecContext_->height) {
+        float ratio =
+            (float)params.maxOutputDimension_ / videoCodecContext_->height;
+        *outWidth = (int)round(videoCodecContext_->width * ratio);
+        *outHeight = params.maxOutputDimension_;
+      }
+    }
+  } else {
+    *outWidth = params.outputWidth_ == -1 ? videoCodecContext_->width
+                                          : params.outputWidth_;
+    *outHeight = params.outputHeight_ == -1 ? videoCodecContext_->height
+                                            : params.outputHeight_;
+  }
+  if (params.yuvOutput_) {
+    // whole pixels of the chroma planes
+    *outWidth &= ~1;
+    *outHeight &= ~1;
+  }
+}
+
+int CustomVideoDecoder::decodeLoop(
+    const string& videoName,
+    const Params& params,
+    std::vector<std::unique_ptr<DecodedFrame>>& sampledFrames,
+    int maxFrames,
+    bool decodeFromStart) {
+  AVPixelFormat pixFormat =
+      params.yuvOutput_ ? AV_PIX_FMT_YUV420P : params.pixelFormat_;
+  Timer timer;
+  const size_t numFramesBefore = sampledFrames.size();
+  int64_t decodedFrames = 0;
+  int64_t packetBytes = 0;
+
+  AVFrame* videoStreamFrame_ = nullptr;
+  AVPacket packet;
+  av_init_packet(&packet); // init packet
+  /* if a valid value is given for maxFrames, then decode only limited frames.
+   * Else decode all the frames */
+  bool mustDecodeAll = (maxFrames <= 0);
+  try {
+    int ret = 0;
+
+    // Calcuate if we need to rescale the frames
+    int outWidth;
+    int outHeight;
+    getOutputSize(params, &outWidth, &outHeight);
+    setDecodeQuality(params);
+
+    // the planar clip output gets GBRP (or YUV420P) frames straight from
+    // swscale
+    const bool usePlanarOutput = params.planarOutput_ != nullptr &&
+        !params.outputFrameIndices_.empty();
+    const int planarLength = params.outputFrameIndices_.size();
+    const PlanarLayout layout(outWidth, outHeight, params.yuvOutput_);
+    const AVPixelFormat planarFormat =
+        params.yuvOutput_ ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_GBRP;
+    if (usePlanarOutput) {
+      params.planarOutput_->resize(planarLength * layout.frameSize);
+    }
+
+    // Create a scale context for the decoded frame, or reuse the previous
+    // one if it matches. It is made from the frames, as the pixel format of
+    // a stream opened without probing is only known once one is decoded
+    auto scaleContext = [&]() {
+      scaleContext_ = sws_getCachedContext(
+          scaleContext_,
+          videoStreamFrame_->width,
+          videoStreamFrame_->height,
+          (AVPixelFormat)videoStreamFrame_->format,
+          outWidth,
+          outHeight,
+          usePlanarOutput ? planarFormat : pixFormat,
+          // frames resized here replace a bilinear resize done afterwards
+          params.outputShortSide_ != -1 ? SWS_BILINEAR : SWS_FAST_BILINEAR,
+          nullptr,
+          nullptr,
+          nullptr);
+      CAFFE_ENFORCE(scaleContext_, "Cannot scale the frames");
+      return scaleContext_;
+    };
 
     // Getting video meta data
     VideoMeta videoMeta;
@@ -201,7 +474,7 @@ void CustomVideoDecoder::decodeLoop(
 
     if (params.intervals_.size() == 0) {
       LOG(ERROR) << "Empty sampling intervals.";
-      return;
+      return -1;
     }
 
     std::vector<SampleInterval>::const_iterator itvlIter =
@@ -236,40 +509,104 @@ void CustomVideoDecoder::decodeLoop(
     // frame index of outputed frames
     int outputFrameIndex = -1;
 
+    /* with a clip frame rate, the index filter and the window are in clip
+     * frames, which map to the nearest frames of the video */
+    const bool clipRate = params.clipFps_ > 0 && !mustDecodeAll;
+    std::vector<int> videoFrameIndices;
+    if (clipRate) {
+      const double fps =
+          videoMeta.fps > 0 ? videoMeta.fps : params.streamInfo_.fps;
+      for (const int index : params.outputFrameIndices_) {
+        const int offset = ClipFrameOffset(index, fps, params.clipFps_);
+        if (!videoFrameIndices.empty() && offset <= videoFrameIndices.back()) {
+          /* a clip faster than the video repeats frames */
+          mustDecodeAll = true;
+        }
+        videoFrameIndices.push_back(offset);
+      }
+      if (fps <= 0) {
+        mustDecodeAll = true;
+      }
+      maxFrames = ClipFrameOffset(maxFrames - 1, fps, params.clipFps_) + 1;
+    }
+    const std::vector<int>& outputFrameIndices =
+        clipRate ? videoFrameIndices : params.outputFrameIndices_;
+    // next wanted output frame when an index filter is given
+    std::vector<int>::const_iterator wantedIter = outputFrameIndices.begin();
+
     /* identify the starting point from where we must start decoding */
-    std::mt19937 meta_randgen(time(nullptr));
-    int random_ts = -1;
-    if (!decodeFromStart) {
-      if (videoStream_->duration > 0 && videoStream_->nb_frames > 0) {
-        /* we have a valid duration and nb_frames. We can safely
-         * detect an intermediate timestamp to start decoding from. */
-
-        /* estimate the average duration for the maxFrames # of frames */
-        double maxFramesDuration =
-            (videoStream_->duration * maxFrames) / (videoStream_->nb_frames);
-        int start_ts = 0;
-        int end_ts = videoStream_->duration - (int)maxFramesDuration;
-        end_ts = end_ts > 0 ? end_ts : 0;
-        /* pick a random timestamp between start and end timestamps.
-         * End timestamp is selected such that you have sufficient frames
-         * from random timestamp to satisfy the requirement of maxFrames */
-        random_ts =
-            std::uniform_int_distribution<>(start_ts, end_ts)(meta_randgen);
-        /* seek a frame at random_ts */
-        ret = av_seek_frame(
-            inputContext, videoStreamIndex_, random_ts, AVSEEK_FLAG_BACKWARD);
-        if (ret < 0) {
-          LOG(ERROR) << "Unable to decode from a random start point";
-          /* fall back to default decoding of all frames from start */
-          av_seek_frame(
-              inputContext, videoStreamIndex_, 0, AVSEEK_FLAG_BACKWARD);
+    int clipStart = -1;
+    double streamStartTime = 0;
+    if (videoStream_->start_time != AV_NOPTS_VALUE) {
+      streamStartTime =
+          videoStream_->start_time * av_q2d(videoStream_->time_base);
+    }
+    if (!mustDecodeAll && decodeFromStart) {
+      clipStart = 0;
+    } else if (!mustDecodeAll) {
+      /* prefer the frame count and rate recorded with the video, otherwise
+       * estimate the number of frames from the stream meta data */
+      const VideoStreamInfo& info = params.streamInfo_;
+      if (videoMeta.fps <= 0 && info.fps > 0) {
+        videoMeta.fps = info.fps;
+      }
+      int64_t numFrames = videoStream_->nb_frames;
+      if (info.numFrames > 0) {
+        numFrames = info.numFrames;
+      } else if (numFrames <= 0 && videoStream_->duration > 0) {
+        numFrames = (int64_t)(
+            videoStream_->duration * av_q2d(videoStream_->time_base) *
+            videoMeta.fps);
+      }
+
+      if (numFrames >= maxFrames && videoMeta.fps > 0) {
+        int startFrame = 0;
+        if (params.clipStart_ >= 0) {
+          startFrame = params.clipStart_;
+        } else if (params.clipSlot_ < 0) {
+          PhiloxRandom* randgen =
+              params.randgen_ ? params.randgen_ : &randgen_;
+          startFrame =
+              RandomClipStart((int)numFrames, maxFrames, info, randgen);
+        } else {
+          float frameGaps = (float)numFrames / (float)params.clipSampleTimes_;
+          startFrame = ((int)(frameGaps * params.clipSlot_)) % numFrames;
+        }
+
+        if (startFrame + maxFrames <= numFrames) {
+          /* seek to the key frame before the start of the clip window,
+           * exactly to its timestamp if the key frames are known */
+          int seekFrame = startFrame;
+          auto keyIter = std::upper_bound(
+              info.keyFrames.begin(), info.keyFrames.end(), startFrame);
+          if (keyIter != info.keyFrames.begin()) {
+            seekFrame = *(keyIter - 1);
+          }
+          int64_t startTs = (int64_t)(
+              (streamStartTime + seekFrame / videoMeta.fps) /
+              av_q2d(videoStream_->time_base));
+          ret = av_seek_frame(
+              inputContext_, videoStreamIndex_, startTs, AVSEEK_FLAG_BACKWARD);
+          if (ret < 0) {
+            CAFFE_EVENT(DecoderStats(), seek_failures, 1);
+            LOG(ERROR) << "Unable to seek to frame " << startFrame << " in "
+                       << videoName << " " << ffmpegErrorStr(ret);
+            /* fall back to default decoding of all frames from start */
+            av_seek_frame(
+                inputContext_, videoStreamIndex_, 0, AVSEEK_FLAG_BACKWARD);
+            mustDecodeAll = true;
+          } else {
+            avcodec_flush_buffers(videoCodecContext_);
+            clipStart = startFrame;
+          }
+        } else {
+          /* the window wraps around the end of the video, which needs the
+           * frames at the start as well */
           mustDecodeAll = true;
         }
       } else {
         /* we do not have  the necessary metadata to selectively decode frames.
          * Decode all frames as we do in the default case */
-        // LOG(INFO) << " Decoding all frames as we do not have suffiecient"
-        //              " metadata for selective decoding.";
         mustDecodeAll = true;
       }
     }
@@ -277,6 +614,21 @@ void CustomVideoDecoder::decodeLoop(
     int gotPicture = 0;
     int eof = 0;
     int selectiveDecodedFrames = 0;
+    if (mustDecodeAll && maxFrames > 0 && !outputFrameIndices.empty()) {
+      /* the index filter and planar output are relative to the window, so
+       * leave the decoding of the whole video to the caller */
+      eof = 1;
+    }
+
+    // with an index filter, the non-reference frames of packets that hold
+    // no wanted frame need not be decoded. Their output positions are then
+    // filled in when the next frame arrives, and a wanted frame that was
+    // skipped anyway (e.g. for a packet without pts) voids the clip.
+    const bool skipNonRef = params.skipNonRefFrames_ && !mustDecodeAll &&
+        !outputFrameIndices.empty() && !params.keyFrames_ &&
+        params.intervals_.size() == 1 &&
+        params.intervals_[0].fps == SpecialFps::SAMPLE_ALL_FRAMES;
+    bool lostWantedFrame = false;
 
     // There is a delay between reading packets from the
     // transport and getting decoded frames back.
@@ -289,7 +641,7 @@ void CustomVideoDecoder::decodeLoop(
             ((!mustDecodeAll) && (selectiveDecodedFrames < maxFrames)))) {
       try {
         if (!eof) {
-          ret = av_read_frame(inputContext, &packet);
+          ret = av_read_frame(inputContext_, &packet);
 
           if (ret == AVERROR(EAGAIN)) {
             av_free_packet(&packet);
@@ -307,6 +659,23 @@ void CustomVideoDecoder::decodeLoop(
             av_free_packet(&packet);
             continue;
           }
+          packetBytes += packet.size;
+
+          if (skipNonRef) {
+            bool wanted = true;
+            if (packet.pts != AV_NOPTS_VALUE) {
+              const int packetFrame = (int)round(
+                  (packet.pts * av_q2d(videoStream_->time_base) -
+                   streamStartTime) *
+                  videoMeta.fps);
+              wanted = std::binary_search(
+                  outputFrameIndices.begin(),
+                  outputFrameIndices.end(),
+                  packetFrame - clipStart);
+            }
+            videoCodecContext_->skip_frame =
+                wanted ? AVDISCARD_DEFAULT : AVDISCARD_NONREF;
+          }
         }
 
         ret = avcodec_decode_video2(
@@ -321,20 +690,28 @@ void CustomVideoDecoder::decodeLoop(
             av_free_packet(&packet);
             continue;
           }
-
-          frameIndex++;
+          decodedFrames++;
 
           double frame_ts =
               av_frame_get_best_effort_timestamp(videoStreamFrame_);
           timestamp = frame_ts * av_q2d(videoStream_->time_base);
 
-          if ((frame_ts >= random_ts && !mustDecodeAll) || mustDecodeAll) {
+          if (mustDecodeAll) {
+            frameIndex++;
+          } else {
+            /* after seeking, recover the frame index from its timestamp */
+            frameIndex =
+                (int)round((timestamp - streamStartTime) * videoMeta.fps);
+          }
+
+          if (mustDecodeAll || frameIndex >= clipStart) {
             /* process current frame if:
              * 1) We are not doing selective decoding and mustDecodeAll
              *    OR
              * 2) We are doing selective decoding and current frame
-             *   timestamp is >= random_ts from where we start selective
-             *   decoding*/
+             *   is inside the clip window starting at clipStart. Frames
+             *   between the key frame and clipStart are decoded only as
+             *   references */
             // if reaching the next interval, update the current fps
             // and reset lastFrameTimestamp so the current frame could be
             // sampled (unless fps == SpecialFps::SAMPLE_NO_FRAME)
@@ -389,6 +766,31 @@ void CustomVideoDecoder::decodeLoop(
 
             lastFrameTimestamp = timestamp;
 
+            if (skipNonRef) {
+              // placeholders for the frames skipped since the last one
+              while (outputFrameIndex + 1 < frameIndex - clipStart &&
+                     selectiveDecodedFrames < maxFrames) {
+                outputFrameIndex++;
+                if (std::binary_search(
+                        outputFrameIndices.begin(),
+                        outputFrameIndices.end(),
+                        outputFrameIndex)) {
+                  lostWantedFrame = true;
+                }
+                unique_ptr<DecodedFrame> frame = make_unique<DecodedFrame>();
+                frame->width_ = outWidth;
+                frame->height_ = outHeight;
+                frame->index_ = clipStart + outputFrameIndex;
+                frame->outputFrameIndex_ = outputFrameIndex;
+                sampledFrames.push_back(move(frame));
+                selectiveDecodedFrames++;
+              }
+              if (selectiveDecodedFrames >= maxFrames) {
+                av_free_packet(&packet);
+                break;
+              }
+            }
+
             outputFrameIndex++;
             if (params.maximumOutputFrames_ != -1 &&
                 outputFrameIndex >= params.maximumOutputFrames_) {
@@ -397,6 +799,64 @@ void CustomVideoDecoder::decodeLoop(
               break;
             }
 
+            // frames outside of the index filter are still decoded as
+            // references, but get no buffer and no colour conversion
+            while (wantedIter != outputFrameIndices.end() &&
+                   *wantedIter < outputFrameIndex) {
+              wantedIter++;
+            }
+            if (!outputFrameIndices.empty() &&
+                (wantedIter == outputFrameIndices.end() ||
+                 *wantedIter != outputFrameIndex)) {
+              unique_ptr<DecodedFrame> frame = make_unique<DecodedFrame>();
+              frame->width_ = outWidth;
+              frame->height_ = outHeight;
+              frame->index_ = frameIndex;
+              frame->outputFrameIndex_ = outputFrameIndex;
+              frame->timestamp_ = timestamp;
+              frame->keyFrame_ = videoStreamFrame_->key_frame;
+              sampledFrames.push_back(move(frame));
+              selectiveDecodedFrames++;
+              av_free_packet(&packet);
+              continue;
+            }
+
+            if (usePlanarOutput) {
+              const int t = wantedIter - outputFrameIndices.begin();
+              uint8_t* planes[4];
+              int linesizes[4];
+              PlanarDestination(
+                  layout,
+                  params.planarOutput_->data(),
+                  planarLength,
+                  t,
+                  planes,
+                  linesizes);
+              Timer swsTimer;
+              sws_scale(
+                  scaleContext(),
+                  videoStreamFrame_->data,
+                  videoStreamFrame_->linesize,
+                  0,
+                  videoStreamFrame_->height,
+                  planes,
+                  linesizes);
+              CAFFE_EVENT(
+                  DecoderStats(), sws_time_ns, swsTimer.NanoSeconds());
+
+              unique_ptr<DecodedFrame> frame = make_unique<DecodedFrame>();
+              frame->width_ = outWidth;
+              frame->height_ = outHeight;
+              frame->index_ = frameIndex;
+              frame->outputFrameIndex_ = outputFrameIndex;
+              frame->timestamp_ = timestamp;
+              frame->keyFrame_ = videoStreamFrame_->key_frame;
+              sampledFrames.push_back(move(frame));
+              selectiveDecodedFrames++;
+              av_free_packet(&packet);
+              continue;
+            }
+
             AVFrame* rgbFrame = av_frame_alloc();
             if (!rgbFrame) {
               LOG(ERROR) << "Error allocating AVframe";
@@ -405,8 +865,15 @@ void CustomVideoDecoder::decodeLoop(
             try {
               // Determine required buffer size and allocate buffer
               int numBytes = avpicture_get_size(pixFormat, outWidth, outHeight);
-              DecodedFrame::AvDataPtr buffer(
-                  (uint8_t*)av_malloc(numBytes * sizeof(uint8_t)));
+              DecodedFrame::AvDataPtr buffer;
+              if (params.frameArena_) {
+                buffer = DecodedFrame::AvDataPtr(
+                    (uint8_t*)params.frameArena_->Allocate(
+                        numBytes * sizeof(uint8_t)),
+                    DecodedFrame::avDeleter(false));
+              } else {
+                buffer.reset((uint8_t*)av_malloc(numBytes * sizeof(uint8_t)));
+              }
 
               int size = avpicture_fill(
                   (AVPicture*)rgbFrame,
@@ -415,14 +882,17 @@ void CustomVideoDecoder::decodeLoop(
                   outWidth,
                   outHeight);
 
+              Timer swsTimer;
               sws_scale(
-                  scaleContext_,
+                  scaleContext(),
                   videoStreamFrame_->data,
                   videoStreamFrame_->linesize,
                   0,
-                  videoCodecContext_->height,
+                  videoStreamFrame_->height,
                   rgbFrame->data,
                   rgbFrame->linesize);
+              CAFFE_EVENT(
+                  DecoderStats(), sws_time_ns, swsTimer.NanoSeconds());
 
               unique_ptr<DecodedFrame> frame = make_unique<DecodedFrame>();
               frame->width_ = outWidth;
@@ -452,49 +922,353 @@ void CustomVideoDecoder::decodeLoop(
     } // of while loop
 
     // free all stuffs
-    sws_freeContext(scaleContext_);
     av_packet_unref(&packet);
     av_frame_free(&videoStreamFrame_);
-    avcodec_close(videoCodecContext_);
-    avformat_close_input(&inputContext);
-    avformat_free_context(inputContext);
+    if (skipNonRef) {
+      videoCodecContext_->skip_frame = AVDISCARD_DEFAULT;
+      if (lostWantedFrame) {
+        // report it like any short selective decode, so callers fall back
+        sampledFrames.clear();
+      }
+    }
+    if (clipRate && !mustDecodeAll && selectiveDecodedFrames < maxFrames) {
+      // the callers do not know the size of the window in video frames
+      sampledFrames.clear();
+    }
+    if (!reuseContexts_ || openedFile_.empty()) {
+      closeStream();
+    }
+    auto& stats = DecoderStats();
+    CAFFE_EVENT(stats, packet_bytes_read, packetBytes);
+    CAFFE_EVENT(stats, frames_decoded, decodedFrames);
+    // a clip that was voided clears the frames
+    const int64_t keptFrames = sampledFrames.size() > numFramesBefore
+        ? sampledFrames.size() - numFramesBefore
+        : 0;
+    CAFFE_EVENT(stats, frames_kept, keptFrames);
+    CAFFE_EVENT(stats, decode_loop_latency, timer.NanoSeconds());
+    return mustDecodeAll ? -1 : clipStart;
   } catch (const std::exception&) {
     // In case of decoding error
     // free all stuffs
-    sws_freeContext(scaleContext_);
     av_packet_unref(&packet);
     av_frame_free(&videoStreamFrame_);
-    avcodec_close(videoCodecContext_);
-    avformat_close_input(&inputContext);
-    avformat_free_context(inputContext);
+    closeStream();
+  }
+  return -1;
+}
+
+int64_t CustomVideoDecoder::countVideoPackets() {
+  AVPacket packet;
+  av_init_packet(&packet);
+  int64_t numPackets = 0;
+  int ret = 0;
+  while ((ret = av_read_frame(inputContext_, &packet)) >= 0 ||
+         ret == AVERROR(EAGAIN)) {
+    if (ret >= 0 && packet.stream_index == videoStreamIndex_) {
+      numPackets++;
+    }
+    av_free_packet(&packet);
   }
+  return numPackets;
 }
 
-void CustomVideoDecoder::decodeMemory(
+int CustomVideoDecoder::streamLoop(
+    const string& videoName,
+    const Params& params,
+    std::vector<std::unique_ptr<DecodedFrame>>& sampledFrames) {
+  Timer timer;
+  int64_t decodedFrames = 0;
+  int64_t packetBytes = 0;
+  const int length = params.streamLength_;
+  const int samplingRate = params.streamSamplingRate_;
+  sampledFrames.clear();
+
+  AVFrame* videoStreamFrame_ = nullptr;
+  AVPacket packet;
+  av_init_packet(&packet);
+  int clipStart = -1;
+  try {
+    CAFFE_ENFORCE(params.planarOutput_, "Streaming needs a planar output");
+    CAFFE_ENFORCE_GT(length * samplingRate, 0);
+    int outWidth;
+    int outHeight;
+    getOutputSize(params, &outWidth, &outHeight);
+    setDecodeQuality(params);
+    // the offsets of the clip frames in a window of clipFrames video frames
+    double fps = av_q2d(videoStream_->avg_frame_rate);
+    if (!(fps > 0)) {
+      fps = params.streamInfo_.fps;
+    }
+    std::vector<int> offsets;
+    for (int t = 0; t < length; t++) {
+      offsets.push_back(
+          ClipFrameOffset(t * samplingRate, fps, params.clipFps_));
+    }
+    const int clipFrames =
+        ClipFrameOffset(length * samplingRate - 1, fps, params.clipFps_) + 1;
+
+    const PlanarLayout layout(outWidth, outHeight, params.yuvOutput_);
+    params.planarOutput_->resize(length * layout.frameSize);
+    uint8_t* clip = params.planarOutput_->data();
+
+    // frame t of a planar buffer of frames frames, the clip or a ring slot
+    auto scaleFrame = [&](uint8_t* buffer, const int frames, const int t) {
+      uint8_t* planes[4];
+      int linesizes[4];
+      PlanarDestination(layout, buffer, frames, t, planes, linesizes);
+      // from the decoded frame, see decodeLoop
+      scaleContext_ = sws_getCachedContext(
+          scaleContext_,
+          videoStreamFrame_->width,
+          videoStreamFrame_->height,
+          (AVPixelFormat)videoStreamFrame_->format,
+          outWidth,
+          outHeight,
+          params.yuvOutput_ ? AV_PIX_FMT_YUV420P : AV_PIX_FMT_GBRP,
+          params.outputShortSide_ != -1 ? SWS_BILINEAR : SWS_FAST_BILINEAR,
+          nullptr,
+          nullptr,
+          nullptr);
+      CAFFE_ENFORCE(scaleContext_, "Cannot scale the frames");
+      Timer swsTimer;
+      sws_scale(
+          scaleContext_,
+          videoStreamFrame_->data,
+          videoStreamFrame_->linesize,
+          0,
+          videoStreamFrame_->height,
+          planes,
+          linesizes);
+      CAFFE_EVENT(DecoderStats(), sws_time_ns, swsTimer.NanoSeconds());
+    };
+    // frame from of a planar buffer of frames frames to clip frame t
+    auto copyFrame = [&](const uint8_t* buffer,
+                         const int frames,
+                         const int from,
+                         const int t) {
+      for (int c = 0; c < 3; c++) {
+        memcpy(
+            clip + layout.offset(length, t, c),
+            buffer + layout.offset(frames, from, c),
+            layout.size[c]);
+      }
+    };
+
+    /* a random start is drawn over the windows of the frames seen so far,
+     * unless the frame count is known. Any other start needs the frame
+     * count, which a pass over the packets gives otherwise */
+    PhiloxRandom* randgen = params.randgen_ ? params.randgen_ : &randgen_;
+    const bool randomStart = params.clipStart_ < 0 && params.clipSlot_ < 0;
+    int64_t numFrames = params.streamInfo_.numFrames;
+    if (numFrames <= 0 && !randomStart) {
+      numFrames = countVideoPackets();
+      if (!rewindStream(videoName)) {
+        numFrames = 0;
+      }
+    }
+
+    // (frame, clip position) of the clip frames if the start is fixed
+    std::vector<std::pair<int, int>> wanted;
+    if (numFrames > 0) {
+      if (params.clipStart_ >= 0) {
+        clipStart = params.clipStart_ % numFrames;
+      } else if (params.clipSlot_ >= 0) {
+        float frameGaps = (float)numFrames / (float)params.clipSampleTimes_;
+        clipStart = ((int)(frameGaps * params.clipSlot_)) % numFrames;
+      } else {
+        clipStart = RandomClipStart(
+            (int)numFrames, clipFrames, params.streamInfo_, randgen);
+      }
+      for (int t = 0; t < length; t++) {
+        wanted.emplace_back(
+            (int)((clipStart + offsets[t]) % numFrames), t);
+      }
+      std::sort(wanted.begin(), wanted.end());
+    } else if (!randomStart) {
+      LOG(ERROR) << "Unable to count the frames of " << videoName;
+      CAFFE_THROW("Unknown frame count");
+    }
+    // otherwise the last clipFrames frames
+    std::vector<uint8_t> ring;
+    if (wanted.empty()) {
+      ring.resize(clipFrames * layout.frameSize);
+    }
+    std::vector<int> clipIndices(length, -1);
+
+    videoStreamFrame_ = av_frame_alloc();
+    auto wantedIter = wanted.begin();
+    int frameIndex = -1;
+    int gotPicture = 0;
+    int eof = 0;
+    while ((!eof || gotPicture) &&
+           (wanted.empty() || wantedIter != wanted.end())) {
+      if (!eof) {
+        int ret = av_read_frame(inputContext_, &packet);
+        if (ret == AVERROR(EAGAIN)) {
+          av_free_packet(&packet);
+          continue;
+        }
+        // Interpret any other error as EOF
+        if (ret < 0) {
+          eof = 1;
+          av_free_packet(&packet);
+          continue;
+        }
+        if (packet.stream_index != videoStreamIndex_) {
+          av_free_packet(&packet);
+          continue;
+        }
+        packetBytes += packet.size;
+      }
+
+      int ret = avcodec_decode_video2(
+          videoCodecContext_, videoStreamFrame_, &gotPicture, &packet);
+      av_free_packet(&packet);
+      if (ret < 0) {
+        LOG(ERROR) << "Error decoding video frame : " << ffmpegErrorStr(ret);
+      }
+      if (!gotPicture) {
+        continue;
+      }
+      decodedFrames++;
+      frameIndex++;
+
+      if (!wanted.empty()) {
+        // a short video may repeat a frame in the clip
+        const int first = wantedIter->second;
+        for (; wantedIter != wanted.end() && wantedIter->first == frameIndex;
+             wantedIter++) {
+          const int t = wantedIter->second;
+          if (t == first) {
+            scaleFrame(clip, length, t);
+          } else {
+            copyFrame(clip, length, first, t);
+          }
+          clipIndices[t] = frameIndex;
+        }
+      } else {
+        scaleFrame(
+            ring.data() + (frameIndex % clipFrames) * layout.frameSize, 1, 0);
+        // keep the window that ends here with probability 1 / (start + 1),
+        // which leaves each window start equally likely at the end
+        const int start = frameIndex - clipFrames + 1;
+        if (start >= 0 &&
+            std::uniform_int_distribution<>(0, start)(*randgen) == 0) {
+          clipStart = start;
+          for (int t = 0; t < length; t++) {
+            const int index = start + offsets[t];
+            copyFrame(
+                ring.data() + (index % clipFrames) * layout.frameSize,
+                1,
+                0,
+                t);
+            clipIndices[t] = index;
+          }
+        }
+      }
+      av_frame_unref(videoStreamFrame_);
+    }
+
+    if (!wanted.empty() && wantedIter != wanted.end()) {
+      LOG(ERROR) << "Only " << frameIndex + 1 << " of " << numFrames
+                 << " frames decoded from " << videoName;
+      clipStart = -1;
+    } else if (wanted.empty() && clipStart < 0 && frameIndex >= 0) {
+      // fewer frames than a clip window, which all are in the ring
+      clipStart = 0;
+      for (int t = 0; t < length; t++) {
+        const int index = offsets[t] % (frameIndex + 1);
+        copyFrame(ring.data() + index * layout.frameSize, 1, 0, t);
+        clipIndices[t] = index;
+      }
+    }
+    if (clipStart >= 0) {
+      for (int t = 0; t < length; t++) {
+        unique_ptr<DecodedFrame> frame = make_unique<DecodedFrame>();
+        frame->width_ = outWidth;
+        frame->height_ = outHeight;
+        frame->index_ = clipIndices[t];
+        frame->outputFrameIndex_ = t;
+        sampledFrames.push_back(move(frame));
+      }
+    }
+
+    av_packet_unref(&packet);
+    av_frame_free(&videoStreamFrame_);
+    if (!reuseContexts_ || openedFile_.empty()) {
+      closeStream();
+    }
+    auto& stats = DecoderStats();
+    CAFFE_EVENT(stats, packet_bytes_read, packetBytes);
+    CAFFE_EVENT(stats, frames_decoded, decodedFrames);
+    CAFFE_EVENT(stats, frames_kept, sampledFrames.size());
+    CAFFE_EVENT(stats, decode_loop_latency, timer.NanoSeconds());
+    return clipStart;
+  } catch (const std::exception&) {
+    av_packet_unref(&packet);
+    av_frame_free(&videoStreamFrame_);
+    closeStream();
+  }
+  return -1;
+}
+
+int CustomVideoDecoder::decodeMemory(
     const char* buffer,
     const int size,
     const Params& params,
     std::vector<std::unique_ptr<DecodedFrame>>& sampledFrames,
     int maxFrames,
     bool decodeFromStart) {
-  VideoIOContext ioctx(buffer, size);
-  decodeLoop(
-      string("Memory Buffer"),
-      ioctx,
-      params,
-      sampledFrames,
-      maxFrames,
-      decodeFromStart);
+  closeStream();
+  // a buffer larger than the video would only be copied into partly
+  ioctx_.reset(new VideoIOContext(
+      buffer, size, std::max(1, std::min(params.ioBufferSize_, size))));
+  const string videoName("Memory Buffer");
+  if (!openStream(videoName, params)) {
+    closeStream();
+    return -1;
+  }
+  if (params.streamLength_ > 0) {
+    return streamLoop(videoName, params, sampledFrames);
+  }
+  return decodeLoop(
+      videoName, params, sampledFrames, maxFrames, decodeFromStart);
 }
 
-void CustomVideoDecoder::decodeFile(
+int CustomVideoDecoder::decodeFile(
     const string file,
     const Params& params,
     std::vector<std::unique_ptr<DecodedFrame>>& sampledFrames,
     int maxFrames,
     bool decodeFromStart) {
-  VideoIOContext ioctx(file);
-  decodeLoop(file, ioctx, params, sampledFrames, maxFrames, decodeFromStart);
+  if (reuseContexts_ && inputContext_ && openedFile_ == file) {
+    if (!rewindStream(file)) {
+      closeStream();
+    }
+  } else {
+    closeStream();
+  }
+  if (!inputContext_) {
+    if (params.remoteStore_ && RemoteVideoStore::IsRemote(file)) {
+      ioctx_.reset(new VideoIOContext(
+          params.remoteStore_, file, params.ioBufferSize_));
+    } else {
+      ioctx_.reset(new VideoIOContext(
+          file, params.ioBufferSize_, params.mmapInput_));
+    }
+    if (!openStream(file, params)) {
+      closeStream();
+      return -1;
+    }
+    if (reuseContexts_) {
+      openedFile_ = file;
+    }
+  }
+  if (params.streamLength_ > 0) {
+    return streamLoop(file, params, sampledFrames);
+  }
+  return decodeLoop(file, params, sampledFrames, maxFrames, decodeFromStart);
 }
 
 string CustomVideoDecoder::ffmpegErrorStr(int result) {
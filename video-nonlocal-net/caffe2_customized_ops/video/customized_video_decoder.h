@@ -25,15 +25,26 @@
 #ifndef CAFFE2_VIDEO_VIDEO_DECODER_H_
 #define CAFFE2_VIDEO_VIDEO_DECODER_H_
 
+#include <fcntl.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
 #include <memory>
+#include <random>
 #include <string>
 #include <vector>
 #include "caffe2/core/logging.h"
+#include "caffe2/utils/philox_random.h"
+#include "caffe2/video/clip_arena.h"
+#include "caffe2/video/remote_video_store.h"
 
 extern "C" {
 #include <libavformat/avformat.h>
 #include <libavformat/avio.h>
+struct SwsContext;
 }
 
 namespace caffe2 {
@@ -51,6 +62,72 @@ enum SpecialFps {
   SAMPLE_TIMESTAMP_ONLY = -2,
 };
 
+// decoder implementation used for the video stream
+// SOFTWARE_DECODE: FFmpeg's software decoder of the codec
+// CUVID_DECODE: NVDEC through the <codec>_cuvid decoder of FFmpeg, falls
+//   back to software decoding if the codec has none or it cannot be opened.
+//   Frames are downloaded as NV12 and converted by swscale as usual.
+enum DecodeBackend {
+  SOFTWARE_DECODE = 0,
+  CUVID_DECODE = 1,
+};
+
+// exactness of the software decoding. FAST_QUALITY skips the loop filter
+// and the exact IDCT of the frames between key frames, sets
+// AV_CODEC_FLAG2_FAST and, for codecs with lowres support, decodes at a
+// halved size where the output is at most half the size of the video
+enum DecodeQuality {
+  FULL_QUALITY = 0,
+  FAST_QUALITY = 1,
+};
+
+// Layout of the planar clips of width x height frames: the R, G and B
+// planes, or with Params::yuvOutput_ the Y plane and the U and V planes of
+// half the width and height (I420). Each plane of a clip of n frames holds
+// the frames one after the other: plane c of frame t is at offset(n, t, c)
+struct PlanarLayout {
+  bool yuv;
+  int width[3];
+  int height[3];
+  int size[3];
+  int start[3];
+  // all the planes of a frame
+  int frameSize = 0;
+
+  PlanarLayout(const int frameWidth, const int frameHeight, const bool isYuv)
+      : yuv(isYuv) {
+    for (int c = 0; c < 3; c++) {
+      const int shift = yuv && c > 0 ? 1 : 0;
+      width[c] = frameWidth >> shift;
+      height[c] = frameHeight >> shift;
+      size[c] = width[c] * height[c];
+      start[c] = frameSize;
+      frameSize += size[c];
+    }
+  }
+
+  int offset(const int frames, const int t, const int c) const {
+    return frames * start[c] + t * size[c];
+  }
+};
+
+// what the db record of a video knows about its stream (see video_record.h),
+// so selective decoding does not have to rely on the container meta data.
+// numFrames / fps <= 0 mean unknown, keyFrames are ascending frame indices.
+struct VideoStreamInfo {
+  int numFrames = -1;
+  double fps = -1;
+  std::vector<int> keyFrames;
+  // the container header describes the video stream, so opening the video
+  // skips avformat_find_stream_info (unless the header lacks the codec or
+  // the frame size after all)
+  bool skipProbe = false;
+  // with >= 0, a random clip start is moved to within keyFrameJitter frames
+  // after the key frame preceding it, so that selective decoding discards
+  // at most that many frames ahead of the clip instead of up to a GOP
+  int keyFrameJitter = -1;
+};
+
 // sampling interval for fps starting at specified timestamp
 // use enum SpecialFps to set special fps decoding behavior
 // note sampled fps will not always accurately follow the target fps,
@@ -93,12 +170,92 @@ class Params {
   // and the second dimension will be scaled to preserve aspect ratio
   int maxOutputDimension_ = -1;
 
+  // short side of the output, the other side is scaled to keep the aspect
+  // ratio. Takes precedence over the settings above, -1 to disable
+  int outputShortSide_ = -1;
+
   // intervals_ control variable sampling fps between different timestamps
   // intervals_ must be ordered strictly ascending by timestamps
   // the first interval must have a timestamp of zero
   // fps must be either the 3 special fps defined in SpecialFps, or > 0
   std::vector<SampleInterval> intervals_ = {{0, SpecialFps::SAMPLE_ALL_FRAMES}};
 
+  // start of the clip window for selective decoding (decodeFromStart ==
+  // false): -1 picks a random start frame, otherwise the window starts at
+  // slot clipSlot_ out of clipSampleTimes_ evenly spaced positions
+  int clipSlot_ = -1;
+  int clipSampleTimes_ = 1;
+  // a start frame chosen by the caller, overrides clipSlot_ if >= 0
+  int clipStart_ = -1;
+
+  // index filter: ascending outputFrameIndex_ values of the frames that
+  // must be converted to pixelFormat_. Other frames are still decoded and
+  // returned with their meta data, but without a data buffer.
+  // empty to convert all frames
+  std::vector<int> outputFrameIndices_;
+
+  // optional planar destination for the frames in outputFrameIndices_:
+  // the i-th selected frame is converted to planar RGB and written to
+  // temporal position i of this 3 x T x H x W buffer
+  // (T = outputFrameIndices_.size()), which is resized as needed.
+  // The returned sampledFrames then all carry meta data only.
+  std::vector<uint8_t>* planarOutput_ = nullptr;
+
+  // the frames stay in YUV: the planar output is laid out as I420 planes
+  // (see PlanarLayout) and the returned frames are YUV420P instead of
+  // pixelFormat_. The output size is rounded down to even for the chroma
+  // planes, and only the scaling is left for swscale
+  bool yuvOutput_ = false;
+
+  // streaming clip decoding: the video is decoded front to back, but only
+  // the clip of streamLength_ frames streamSamplingRate_ apart is kept and
+  // written to planarOutput_, from clipStart_, slot clipSlot_ or a random
+  // start. At most streamLength_ * streamSamplingRate_ frames are held at a
+  // time, whatever the length of the video, and maximumOutputFrames_ does
+  // not apply. 0 to return the frames instead
+  int streamLength_ = 0;
+  int streamSamplingRate_ = 1;
+
+  // frame rate of the clip window, the index filter and the streamed clip
+  // are in frames of: clip frame t is the video frame nearest to t /
+  // clipFps_ seconds after the window start (see ClipFrameOffset). Unlike
+  // intervals_, this does not drift. 0 for the frames of the video
+  double clipFps_ = 0;
+
+  // random generator used to pick a random clip start, the one of the
+  // decoder is used if not given
+  PhiloxRandom* randgen_ = nullptr;
+
+  DecodeBackend decodeBackend_ = SOFTWARE_DECODE;
+
+  // optional arena for the RGB buffers of the decoded frames. The frames
+  // then must not outlive the next Reset() of the arena.
+  ClipArena* frameArena_ = nullptr;
+
+  // stream meta data known ahead of decoding, used by selective decoding
+  VideoStreamInfo streamInfo_;
+
+  // size of the buffer FFmpeg reads the input through, each read of a
+  // memory buffer copies this much
+  int ioBufferSize_ = VIO_BUFFER_SZ;
+
+  // map local files instead of reading them through stdio
+  bool mmapInput_ = false;
+
+  // store of the remote videos, a path of which is an http:// url
+  RemoteVideoStore* remoteStore_ = nullptr;
+
+  // let the codec skip the non-reference frames that selective decoding
+  // with an index filter does not want
+  bool skipNonRefFrames_ = false;
+
+  // threads of the software codec, 0 lets FFmpeg pick one per core, and
+  // the FF_THREAD_* kinds of threading they may use
+  int codecThreads_ = 1;
+  int codecThreadType_ = FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+  DecodeQuality decodeQuality_ = FULL_QUALITY;
+
   Params() {}
 
   /**
@@ -169,19 +326,192 @@ class Params {
     maxOutputDimension_ = size;
     return *this;
   }
+
+  /**
+   * Scale the shorter side of the frames to this size
+   */
+  Params& outputShortSide(int size) {
+    outputShortSide_ = size;
+    return *this;
+  }
+
+  /**
+   * Where the clip window starts for selective decoding, -1 for random,
+   * otherwise slot out of sampleTimes evenly spaced start frames
+   */
+  Params& clipSlot(int slot, int sampleTimes) {
+    clipSlot_ = slot;
+    clipSampleTimes_ = sampleTimes;
+    return *this;
+  }
+
+  /**
+   * Start the clip window of selective decoding at this frame
+   */
+  Params& clipStart(int startFrame) {
+    clipStart_ = startFrame;
+    return *this;
+  }
+
+  /**
+   * Only convert the output frames with these (ascending) indices
+   */
+  Params& outputFrameIndices(const std::vector<int>& indices) {
+    outputFrameIndices_ = indices;
+    return *this;
+  }
+
+  /**
+   * Write the selected frames into a planar RGB clip buffer
+   */
+  Params& planarOutput(std::vector<uint8_t>* buffer) {
+    planarOutput_ = buffer;
+    return *this;
+  }
+
+  /**
+   * Output the frames as YUV420P / I420 planes instead of RGB
+   */
+  Params& yuvOutput(bool yuv) {
+    yuvOutput_ = yuv;
+    return *this;
+  }
+
+  /**
+   * Decode the video as a stream that only keeps one clip of length frames
+   */
+  Params& streamingClip(int length, int samplingRate) {
+    streamLength_ = length;
+    streamSamplingRate_ = samplingRate;
+    return *this;
+  }
+
+  /**
+   * Sample the clip window at this frame rate instead of the video's
+   */
+  Params& clipFps(double fps) {
+    clipFps_ = fps;
+    return *this;
+  }
+
+  /**
+   * Allocate the frame buffers from an arena instead of av_malloc
+   */
+  Params& frameArena(ClipArena* arena) {
+    frameArena_ = arena;
+    return *this;
+  }
+
+  /**
+   * Frame count, fps and key frames of the stream if known from elsewhere
+   */
+  Params& streamInfo(const VideoStreamInfo& info) {
+    streamInfo_ = info;
+    return *this;
+  }
+
+  /**
+   * Read buffer size of the input, default VIO_BUFFER_SZ
+   */
+  Params& ioBufferSize(int size) {
+    ioBufferSize_ = size;
+    return *this;
+  }
+
+  /**
+   * Read local files through a memory mapping
+   */
+  Params& mmapInput(bool mmapInput) {
+    mmapInput_ = mmapInput;
+    return *this;
+  }
+
+  /**
+   * Read the videos of http:// urls through the blocks of store
+   */
+  Params& remoteStore(RemoteVideoStore* store) {
+    remoteStore_ = store;
+    return *this;
+  }
+
+  /**
+   * Skip decoding unwanted non-reference frames (AVDISCARD_NONREF)
+   */
+  Params& skipNonRefFrames(bool skip) {
+    skipNonRefFrames_ = skip;
+    return *this;
+  }
+
+  /**
+   * Decoder implementation for the video stream
+   */
+  Params& decodeBackend(DecodeBackend backend) {
+    decodeBackend_ = backend;
+    return *this;
+  }
+
+  /**
+   * Decode exactly or fast (see DecodeQuality), e.g. for training clips
+   */
+  Params& decodeQuality(DecodeQuality quality) {
+    decodeQuality_ = quality;
+    return *this;
+  }
+
+  /**
+   * Threads of the software codec (AVCodecContext::thread_count / type)
+   */
+  Params& codecThreads(
+      int count,
+      int type = FF_THREAD_FRAME | FF_THREAD_SLICE) {
+    codecThreads_ = count;
+    codecThreadType_ = type;
+    return *this;
+  }
+
+  /**
+   * Random generator for choosing the clip start in selective decoding
+   */
+  Params& randomGenerator(PhiloxRandom* randgen) {
+    randgen_ = randgen;
+    return *this;
+  }
 };
 
+// offset from the window start of the video frame at clip frame
+// clipFrame, with the clip sampled at clipFps. The clip frame itself if
+// either frame rate is unknown (<= 0)
+int ClipFrameOffset(int clipFrame, double videoFps, double clipFps);
+
+// random start of a window of clipFrames frames in a video of numFrames
+// frames, uniform over the video, then kept within info.keyFrameJitter
+// frames after its key frame if info has key frames and a jitter >= 0.
+// Every GOP keeps the share of the starts its length gives it. 0 if the
+// window does not fit.
+int RandomClipStart(
+    int numFrames,
+    int clipFrames,
+    const VideoStreamInfo& info,
+    PhiloxRandom* randgen);
+
 // data structure for storing decoded video frames
 class DecodedFrame {
  public:
   struct avDeleter {
+    // false for buffers that belong to a ClipArena
+    bool owned;
+    avDeleter() : owned(true) {}
+    explicit avDeleter(bool owned_buffer) : owned(owned_buffer) {}
     void operator()(unsigned char* p) const {
-      av_free(p);
+      if (owned) {
+        av_free(p);
+      }
     }
   };
   typedef std::unique_ptr<uint8_t, avDeleter> AvDataPtr;
 
-  // decoded data buffer
+  // decoded data buffer, null if the frame was left out by
+  // Params::outputFrameIndices_
   AvDataPtr data_;
 
   // size in bytes
@@ -206,15 +536,34 @@ class DecodedFrame {
 
 class VideoIOContext {
  public:
-  explicit VideoIOContext(const std::string fname)
-      : workBuffersize_(VIO_BUFFER_SZ),
+  // with useMmap the file is mapped and read like a memory buffer, straight
+  // from the page cache, unless it cannot be mapped
+  explicit VideoIOContext(
+      const std::string fname,
+      const int bufferSize = VIO_BUFFER_SZ,
+      const bool useMmap = false)
+      : workBuffersize_(bufferSize),
         workBuffer_((uint8_t*)av_malloc(workBuffersize_)),
         inputFile_(nullptr),
         inputBuffer_(nullptr),
         inputBufferSize_(0) {
+    if (useMmap && mapFile(fname)) {
+      ctx_ = avio_alloc_context(
+          static_cast<unsigned char*>(workBuffer_.get()),
+          workBuffersize_,
+          0,
+          this,
+          &VideoIOContext::readMemory,
+          nullptr, // no write function
+          &VideoIOContext::seekMemory);
+      return;
+    }
     inputFile_ = fopen(fname.c_str(), "rb");
     if (inputFile_ == nullptr) {
       LOG(ERROR) << "Error opening video file " << fname;
+    } else {
+      // the file is mostly read front to back, let the kernel read ahead
+      posix_fadvise(fileno(inputFile_), 0, 0, POSIX_FADV_SEQUENTIAL);
     }
     ctx_ = avio_alloc_context(
         static_cast<unsigned char*>(workBuffer_.get()),
@@ -226,8 +575,33 @@ class VideoIOContext {
         &VideoIOContext::seekFile);
   }
 
-  explicit VideoIOContext(const char* buffer, int size)
-      : workBuffersize_(VIO_BUFFER_SZ),
+  // the video of an http:// url, read in the blocks of the store
+  VideoIOContext(
+      RemoteVideoStore* store,
+      const std::string url,
+      const int bufferSize = VIO_BUFFER_SZ)
+      : workBuffersize_(bufferSize),
+        workBuffer_((uint8_t*)av_malloc(workBuffersize_)),
+        inputFile_(nullptr),
+        inputBuffer_(nullptr),
+        inputBufferSize_(0),
+        remoteStore_(store),
+        remoteUrl_(url) {
+    ctx_ = avio_alloc_context(
+        static_cast<unsigned char*>(workBuffer_.get()),
+        workBuffersize_,
+        0,
+        this,
+        &VideoIOContext::readRemote,
+        nullptr, // no write function
+        &VideoIOContext::seekRemote);
+  }
+
+  explicit VideoIOContext(
+      const char* buffer,
+      int size,
+      const int bufferSize = VIO_BUFFER_SZ)
+      : workBuffersize_(bufferSize),
         workBuffer_((uint8_t*)av_malloc(workBuffersize_)),
         inputFile_(nullptr),
         inputBuffer_(buffer),
@@ -247,11 +621,16 @@ class VideoIOContext {
     if (inputFile_) {
       fclose(inputFile_);
     }
+    if (mapped_) {
+      munmap(const_cast<char*>(inputBuffer_), inputBufferSize_);
+    }
   }
 
   int read(unsigned char* buf, int buf_size) {
     if (inputBuffer_) {
       return readMemory(this, buf, buf_size);
+    } else if (remoteStore_) {
+      return readRemote(this, buf, buf_size);
     } else if (inputFile_) {
       return readFile(this, buf, buf_size);
     } else {
@@ -262,6 +641,8 @@ class VideoIOContext {
   int64_t seek(int64_t offset, int whence) {
     if (inputBuffer_) {
       return seekMemory(this, offset, whence);
+    } else if (remoteStore_) {
+      return seekRemote(this, offset, whence);
     } else if (inputFile_) {
       return seekFile(this, offset, whence);
     } else {
@@ -310,7 +691,7 @@ class VideoIOContext {
 
     int reminder = h->inputBufferSize_ - h->offset_;
     int r = buf_size < reminder ? buf_size : reminder;
-    if (r < 0) {
+    if (r <= 0) {
       return AVERROR_EOF;
     }
 
@@ -337,20 +718,94 @@ class VideoIOContext {
     return h->offset_;
   }
 
+  // copies from the block of the read position, fetching only the blocks
+  // that the demuxer reads or seeks to
+  static int readRemote(void* opaque, unsigned char* buf, int buf_size) {
+    VideoIOContext* h = static_cast<VideoIOContext*>(opaque);
+    const int64_t blockSize = h->remoteStore_->block_size();
+    const int64_t index = h->remoteOffset_ / blockSize;
+    if (!h->remoteBlock_ || h->remoteBlockIndex_ != index) {
+      h->remoteBlock_ = h->remoteStore_->GetBlock(h->remoteUrl_, index);
+      h->remoteBlockIndex_ = index;
+      if (!h->remoteBlock_) {
+        return -1;
+      }
+    }
+    const int64_t begin = h->remoteOffset_ - index * blockSize;
+    const int64_t r = std::min<int64_t>(
+        buf_size, static_cast<int64_t>(h->remoteBlock_->size()) - begin);
+    if (r <= 0) {
+      return AVERROR_EOF;
+    }
+    memcpy(buf, h->remoteBlock_->data() + begin, r);
+    h->remoteOffset_ += r;
+    return r;
+  }
+
+  static int64_t seekRemote(void* opaque, int64_t offset, int whence) {
+    VideoIOContext* h = static_cast<VideoIOContext*>(opaque);
+    switch (whence) {
+      case SEEK_CUR: // from current position
+        h->remoteOffset_ += offset;
+        break;
+      case SEEK_END: // from eof
+        h->remoteOffset_ = h->remoteStore_->Size(h->remoteUrl_) + offset;
+        break;
+      case SEEK_SET: // from beginning of file
+        h->remoteOffset_ = offset;
+        break;
+      case AVSEEK_SIZE:
+        return h->remoteStore_->Size(h->remoteUrl_);
+      default:
+        return -1;
+    }
+    return h->remoteOffset_;
+  }
+
   AVIOContext* get_avio() {
     return ctx_;
   }
 
  private:
+  bool mapFile(const std::string& fname) {
+    const int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    // memory mode offsets are ints
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size <= INT_MAX) {
+      data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+      return false;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    inputBuffer_ = static_cast<const char*>(data);
+    inputBufferSize_ = st.st_size;
+    mapped_ = true;
+    return true;
+  }
+
   int workBuffersize_;
   DecodedFrame::AvDataPtr workBuffer_;
   // for file mode
   FILE* inputFile_;
 
-  // for memory mode
+  // for memory mode, and mapped files
   const char* inputBuffer_;
   int inputBufferSize_;
   int offset_ = 0;
+  bool mapped_ = false;
+
+  // for remote mode
+  RemoteVideoStore* remoteStore_ = nullptr;
+  std::string remoteUrl_;
+  int64_t remoteOffset_ = 0;
+  std::shared_ptr<const std::string> remoteBlock_;
+  int64_t remoteBlockIndex_ = -1;
 
   AVIOContext* ctx_;
 };
@@ -372,8 +827,27 @@ struct VideoMeta {
 class CustomVideoDecoder {
  public:
   CustomVideoDecoder();
+  ~CustomVideoDecoder();
+
+  // When enabled, the demuxer, codec and scaler contexts of the last file
+  // passed to decodeFile are kept open after decoding. Decoding the same
+  // file again then only rewinds the stream instead of probing the
+  // container and opening the codec again. Memory buffers are never kept.
+  void reuseContexts(bool reuse) {
+    reuseContexts_ = reuse;
+  }
 
-  void decodeFile(
+  // With decodeFromStart == false and maxFrames > 0, only a window of
+  // maxFrames consecutive frames is decoded: the decoder seeks to the key
+  // frame preceding the window start chosen from params.clipSlot_ and stops
+  // once the window is complete. The return value is the index in the video
+  // of sampledFrames[0] in that case, or -1 if all frames were decoded.
+  // If the window cannot be placed with an index filter, nothing is decoded
+  // and -1 returned.
+  // With params.streamLength_ > 0, the clip goes to params.planarOutput_,
+  // sampledFrames gets the meta data of its frames and the return value is
+  // its start frame, or -1 if it could not be decoded.
+  int decodeFile(
       const std::string filename,
       const Params& params,
       std::vector<std::unique_ptr<DecodedFrame>>& sampledFrames,
@@ -382,7 +856,7 @@ class CustomVideoDecoder {
                                      intermediate frame ? */
       );
 
-  void decodeMemory(
+  int decodeMemory(
       const char* buffer,
       const int size,
       const Params& params,
@@ -395,15 +869,52 @@ class CustomVideoDecoder {
  private:
   std::string ffmpegErrorStr(int result);
 
-  void decodeLoop(
+  // probe the input of ioctx_ and open the codec of its video stream
+  bool openStream(const std::string& videoName, const Params& params);
+
+  // seek back to the first frame of an already opened stream
+  bool rewindStream(const std::string& videoName);
+
+  void closeStream();
+
+  // output size of the frames of the opened stream
+  void getOutputSize(const Params& params, int* outWidth, int* outHeight);
+
+  // number of video packets from the current position to the end of the
+  // stream
+  int64_t countVideoPackets();
+
+  // the per-frame shortcuts of params.decodeQuality_ for the opened codec
+  void setDecodeQuality(const Params& params);
+
+  // the streaming clip decoding of params.streamLength_
+  int streamLoop(
+      const std::string& videoName,
+      const Params& params,
+      std::vector<std::unique_ptr<DecodedFrame>>& sampledFrames);
+
+  int decodeLoop(
       const std::string& videoName,
-      VideoIOContext& ioctx,
       const Params& params,
       std::vector<std::unique_ptr<DecodedFrame>>& sampledFrames,
       int maxFrames = 0, /* max frames we want decoded. 0 implies decode all */
       bool decodeFromStart = true /* decode from start or randomly seek into
                                      intermediate frame ? */
       );
+
+  bool reuseContexts_;
+  // name of the file whose contexts are open, empty for memory buffers
+  std::string openedFile_;
+  std::unique_ptr<VideoIOContext> ioctx_;
+  AVFormatContext* inputContext_;
+  AVStream* videoStream_;
+  int videoStreamIndex_;
+  AVCodecContext* videoCodecContext_;
+  // reused across calls through sws_getCachedContext
+  SwsContext* scaleContext_;
+  // the random clip starts of the calls without Params::randgen_, seeded
+  // once per decoder
+  PhiloxRandom randgen_;
 };
 }
 
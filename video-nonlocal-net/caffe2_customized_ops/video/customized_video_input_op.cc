@@ -26,34 +26,126 @@
 
 namespace caffe2 {
 
+template <>
+int GetDeviceNUMANode<CPUContext>(const DeviceOption& option) {
+  return option.numa_node_id();
+}
+
 REGISTER_CPU_OPERATOR(
     CustomizedVideoInput, CustomizedVideoInputOp<CPUContext>);
 
+namespace {
+
+// The shapes of the outputs of the op, as CopyPrefetched makes them. The
+// clips of uncropped videos (crop <= 0) keep the size of their bucket and
+// the batches of a multigrid schedule (clip_shapes) take turns in their
+// shapes, so those outputs only have their types.
+vector<TensorShape> TensorInferenceForCustomizedVideoInput(
+    const OperatorDef& def,
+    const vector<TensorShape>& /* unused */) {
+  vector<TensorShape> out(def.output_size());
+  ArgumentHelper helper(def);
+  const int batch_size = helper.GetSingleArgument<int>("batch_size", 0);
+  const int crop = helper.GetSingleArgument<int>("crop", -1);
+  const int length = helper.GetSingleArgument<int>("length", -1);
+  const bool nhwc =
+      helper.GetSingleArgument<string>("order", "NCHW") == "NHWC";
+  // the CPU op leaves the transform of use_gpu_transform to the consumer:
+  // the uint8 clips as they are decoded, N x C x T x H x W or the
+  // N x T x 3H/2 x W I420 frames
+  const bool raw_clips =
+      helper.GetSingleArgument<int>("use_gpu_transform", 0) &&
+      def.device_option().device_type() == CPU;
+  const bool yuv = helper.GetSingleArgument<int>("use_gpu_yuv_transform", 0);
+  const bool clip_shapes =
+      !helper.GetRepeatedArgument<int>("clip_shapes").empty();
+  // the clips of the slow / fast pathways, from one decoded clip
+  const auto pathway_lengths =
+      helper.GetRepeatedArgument<int>("pathway_lengths");
+  auto clip_shape = [&](const int frames,
+                        const TensorProto::DataType type) -> TensorShape {
+    if (crop <= 0 || clip_shapes) {
+      TensorShape shape;
+      shape.set_data_type(type);
+      shape.set_unknown_shape(true);
+      return shape;
+    }
+    if (raw_clips) {
+      return yuv
+          ? CreateTensorShape(
+                vector<int>{batch_size, frames, crop * 3 / 2, crop}, type)
+          : CreateTensorShape(
+                vector<int>{batch_size, 3, frames, crop, crop}, type);
+    }
+    return nhwc ? CreateTensorShape(
+                      vector<int>{batch_size, frames, crop, crop, 3}, type)
+                : CreateTensorShape(
+                      vector<int>{batch_size, 3, frames, crop, crop}, type);
+  };
+  out[0] = clip_shape(
+      pathway_lengths.empty() ? length : pathway_lengths[0],
+      raw_clips ? TensorProto::UINT8
+                : cast::GetCastDataType(helper, "output_type"));
+  // a label per clip, or the 0 / 1 vector of the labels of a clip
+  if (!helper.GetSingleArgument<int>("multiple_label", 0)) {
+    out[1] = CreateTensorShape(vector<int>{batch_size}, TensorProto::INT32);
+  } else {
+    const int num_of_labels =
+        helper.GetSingleArgument<int>("num_of_labels", 0);
+    out[1] = CreateTensorShape(
+        vector<int>{batch_size, num_of_labels}, TensorProto::INT32);
+  }
+  const bool output_clip_index =
+      helper.GetSingleArgument<int>("output_clip_index", 0);
+  if (output_clip_index) {
+    out[2] = CreateTensorShape(vector<int>{batch_size}, TensorProto::INT32);
+    out[3] =
+        CreateTensorShape(vector<int>{batch_size, 2}, TensorProto::INT32);
+  }
+  const int first_pathway_output = output_clip_index ? 4 : 2;
+  for (int k = 1; k < pathway_lengths.size(); k++) {
+    out[first_pathway_output + k - 1] =
+        clip_shape(pathway_lengths[k], TensorProto::FLOAT);
+  }
+  if (raw_clips) {
+    // the mirror flags
+    out.back() =
+        CreateTensorShape(vector<int>{batch_size}, TensorProto::INT32);
+  }
+  if (clip_shapes) {
+    for (auto& shape : out) {
+      shape.set_unknown_shape(true);
+    }
+  }
+  return out;
+}
+
+// no arithmetic; the bytes of the outputs that CopyPrefetched writes, for
+// the roofline and memory reports. The decode happens in the prefetch
+// threads, off the net.
+OpSchema::Cost CostInferenceForCustomizedVideoInput(
+    const OperatorDef& def,
+    const vector<TensorShape>& in) {
+  struct OpSchema::Cost cost;
+  cost.flops = 0;
+  cost.bytes_moved = 0;
+  for (const auto& shape : TensorInferenceForCustomizedVideoInput(def, in)) {
+    if (!shape.unknown_shape()) {
+      cost.bytes_moved += nElemFromDim(shape) *
+          DataTypeToTypeMeta(shape.data_type()).itemsize();
+    }
+  }
+  cost.params_bytes = 0;
+  return cost;
+}
+
+} // namespace
+
 OPERATOR_SCHEMA(CustomizedVideoInput)
     .NumInputs(0, 1)
-    .NumOutputs(2)
-    .TensorInferenceFunction([](
-        const OperatorDef& def,
-        const vector<TensorShape>& /* unused */ in) {
-      vector<TensorShape> out(2);
-      ArgumentHelper helper(def);
-      int batch_size = helper.GetSingleArgument<int>("batch_size", 0);
-      int crop = helper.GetSingleArgument<int>("crop", -1);
-      int length = helper.GetSingleArgument<int>("length", -1);
-      int multiple_label = helper.GetSingleArgument<int>("multiple_label", 0);
-      CHECK_GT(crop, 0);
-      out[0] = CreateTensorShape(
-          vector<int>{batch_size, 3, length, crop, crop}, TensorProto::FLOAT);
-      if (!multiple_label) {
-        out[1] =
-            CreateTensorShape(vector<int>{1, batch_size}, TensorProto::INT32);
-      } else {
-        int num_of_labels = helper.GetSingleArgument<int>("num_of_labels", 0);
-        out[1] = CreateTensorShape(
-            vector<int>{batch_size, num_of_labels}, TensorProto::INT32);
-      }
-      return out;
-    });
+    .NumOutputs(2, INT_MAX)
+    .TensorInferenceFunction(TensorInferenceForCustomizedVideoInput)
+    .CostInferenceFunction(CostInferenceForCustomizedVideoInput);
 
 NO_GRADIENT(CustomizedVideoInput);
 
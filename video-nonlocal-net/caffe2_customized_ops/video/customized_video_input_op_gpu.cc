@@ -28,6 +28,15 @@
 
 namespace caffe2 {
 
+template <>
+int GetDeviceNUMANode<CUDAContext>(const DeviceOption& option) {
+  // an explicit numa_node_id in the device option wins
+  if (option.numa_node_id() >= 0) {
+    return option.numa_node_id();
+  }
+  return GetGPUNUMANode(option.cuda_gpu_id());
+}
+
 REGISTER_CUDA_OPERATOR(
   CustomizedVideoInput, CustomizedVideoInputOp<CUDAContext>);
 } // namespace caffe2
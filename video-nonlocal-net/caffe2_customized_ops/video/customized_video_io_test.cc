@@ -0,0 +1,121 @@
+#include <vector>
+
+#include "caffe2/video/customized_video_decoder.h"
+#include "caffe2/video/customized_video_io.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// SOI, an APP0 segment, and a start of frame segment of height x width
+std::vector<unsigned char> JpegHeader(
+    unsigned char sof_marker,
+    int height,
+    int width) {
+  std::vector<unsigned char> data = {0xFF, 0xD8};
+  const unsigned char app0[] = {
+      0xFF, 0xE0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00,
+      0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00};
+  data.insert(data.end(), app0, app0 + sizeof(app0));
+  const unsigned char sof[] = {
+      0xFF,
+      sof_marker,
+      0x00,
+      0x11,
+      0x08,
+      static_cast<unsigned char>(height >> 8),
+      static_cast<unsigned char>(height & 0xFF),
+      static_cast<unsigned char>(width >> 8),
+      static_cast<unsigned char>(width & 0xFF),
+      0x03};
+  data.insert(data.end(), sof, sof + sizeof(sof));
+  return data;
+}
+
+} // namespace
+
+TEST(CustomizedVideoIOTest, GetJpegFrameSizeReadsBaselineHeader) {
+  const std::vector<unsigned char> data = JpegHeader(0xC0, 256, 340);
+  int height = -1;
+  int width = -1;
+  EXPECT_TRUE(GetJpegFrameSize(data.data(), data.size(), &height, &width));
+  EXPECT_EQ(height, 256);
+  EXPECT_EQ(width, 340);
+}
+
+TEST(CustomizedVideoIOTest, GetJpegFrameSizeReadsProgressiveHeader) {
+  const std::vector<unsigned char> data = JpegHeader(0xC2, 720, 1280);
+  int height = -1;
+  int width = -1;
+  EXPECT_TRUE(GetJpegFrameSize(data.data(), data.size(), &height, &width));
+  EXPECT_EQ(height, 720);
+  EXPECT_EQ(width, 1280);
+}
+
+TEST(CustomizedVideoIOTest, GetJpegFrameSizeRejectsOtherData) {
+  std::vector<unsigned char> data = JpegHeader(0xC0, 256, 340);
+  int height = -1;
+  int width = -1;
+  // cut in the start of frame segment
+  EXPECT_FALSE(GetJpegFrameSize(data.data(), data.size() - 4, &height, &width));
+  // not a JPEG
+  data[1] = 0x00;
+  EXPECT_FALSE(GetJpegFrameSize(data.data(), data.size(), &height, &width));
+  // a DHT segment is not a frame header
+  data = JpegHeader(0xC4, 256, 340);
+  EXPECT_FALSE(GetJpegFrameSize(data.data(), data.size(), &height, &width));
+}
+
+TEST(CustomizedVideoIOTest, GetClipCropWindowCentersTestCrops) {
+  PhiloxRandom randgen(0, 0, 0);
+  std::bernoulli_distribution mirror_this_clip(0.5);
+  int h_off = -1;
+  int w_off = -1;
+  int mirror_me = -1;
+  GetClipCropWindow(
+      256,
+      340,
+      224,
+      224,
+      false,
+      &randgen,
+      &mirror_this_clip,
+      true,
+      -1,
+      &h_off,
+      &w_off,
+      &mirror_me);
+  EXPECT_EQ(h_off, 16);
+  EXPECT_EQ(w_off, 58);
+  EXPECT_EQ(mirror_me, 0);
+}
+
+TEST(CustomizedVideoIOTest, RandomClipStartFollowsKeyFrames) {
+  PhiloxRandom randgen(0, 0, 0);
+  VideoStreamInfo info;
+  info.keyFrames = {0, 100, 200};
+  info.keyFrameJitter = 4;
+  bool after_each_key_frame[3] = {false, false, false};
+  for (int i = 0; i < 1000; ++i) {
+    const int start = RandomClipStart(300, 64, info, &randgen);
+    ASSERT_LE(start + 64, 300);
+    // the start is near the key frame before it
+    EXPECT_LE(start % 100, 4);
+    after_each_key_frame[start / 100] = true;
+  }
+  EXPECT_TRUE(after_each_key_frame[0]);
+  EXPECT_TRUE(after_each_key_frame[1]);
+  EXPECT_TRUE(after_each_key_frame[2]);
+
+  // a uniform start without a jitter, and 0 if the clip does not fit
+  info.keyFrameJitter = -1;
+  bool off_key_frames = false;
+  for (int i = 0; i < 100; ++i) {
+    off_key_frames |= RandomClipStart(300, 64, info, &randgen) % 100 > 4;
+  }
+  EXPECT_TRUE(off_key_frames);
+  EXPECT_EQ(RandomClipStart(50, 64, info, &randgen), 0);
+}
+
+} // namespace caffe2
@@ -0,0 +1,52 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CUSTOMIZED_VIDEO_TRANSFORM_GPU_H_
+#define CUSTOMIZED_VIDEO_TRANSFORM_GPU_H_
+
+#include "caffe2/core/context.h"
+
+namespace caffe2 {
+
+// Turns a batch of cropped clips X (N x C x T x H x W) into
+// Y = (X - mean) * inv_std, flipping clip n horizontally if mirror[n] is
+// set and reversing the channel order (RGB -> BGR) with reverse_channels.
+// With channels_last Y is written as N x T x H x W x C instead.
+// X may also hold I420 clips, N x T x (3 * H / 2) x W (the Y plane, then
+// the U and V planes of every frame, see YuvClipCropFlex), which are
+// converted to RGB in the same pass.
+template <typename T_IN, typename T_OUT, class Context>
+bool TransformClipsOnGPU(
+    Tensor<Context>& X,
+    Tensor<Context>& mirror,
+    Tensor<Context>* Y,
+    const float mean,
+    const float inv_std,
+    const bool reverse_channels,
+    const bool channels_last,
+    Context* context);
+
+} // namespace caffe2
+
+#endif // CUSTOMIZED_VIDEO_TRANSFORM_GPU_H_
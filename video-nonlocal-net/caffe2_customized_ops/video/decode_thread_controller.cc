@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/decode_thread_controller.h"
+
+#include <algorithm>
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+DecodeThreadController::DecodeThreadController(
+    const Options& options,
+    int threads,
+    int depth)
+    : options_(options),
+      threads_(std::min(std::max(threads, options.min_threads),
+                        options.max_threads)),
+      depth_(std::min(std::max(depth, options.min_depth), options.max_depth)) {
+  CAFFE_ENFORCE_GE(options_.min_threads, 1);
+  CAFFE_ENFORCE_GE(options_.max_threads, options_.min_threads);
+  CAFFE_ENFORCE_GE(options_.min_depth, 1);
+  CAFFE_ENFORCE_GE(options_.max_depth, options_.min_depth);
+  CAFFE_ENFORCE_GT(options_.window, 0);
+}
+
+bool DecodeThreadController::Observe(
+    float stall_ms,
+    float idle_ms,
+    float cycle_ms) {
+  stall_ms_ += stall_ms;
+  idle_ms_ += idle_ms;
+  cycle_ms_ += cycle_ms;
+  if (++num_batches_ < options_.window) {
+    return false;
+  }
+  const double total_ms = std::max(cycle_ms_, 1e-3);
+  const double stall = stall_ms_ / total_ms;
+  const double idle = idle_ms_ / total_ms;
+  num_batches_ = 0;
+  stall_ms_ = idle_ms_ = cycle_ms_ = 0;
+
+  if (stall > options_.grow_stall) {
+    // bursts a deeper ring absorbs, or a decode stage that is too slow
+    if (depth_ < options_.max_depth &&
+        (idle > 0 || threads_ == options_.max_threads)) {
+      ++depth_;
+      return true;
+    }
+    if (threads_ < options_.max_threads) {
+      ++threads_;
+      return true;
+    }
+    return false;
+  }
+  if (stall == 0 && idle > options_.shrink_idle) {
+    if (threads_ > options_.min_threads) {
+      --threads_;
+      return true;
+    }
+    if (depth_ > options_.min_depth) {
+      --depth_;
+      return true;
+    }
+  }
+  return false;
+}
+
+void DecodeGate::Enter() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [this]() { return running_ < limit_; });
+  ++running_;
+}
+
+void DecodeGate::Leave() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --running_;
+  }
+  cv_.notify_one();
+}
+
+void DecodeGate::SetLimit(int limit) {
+  CAFFE_ENFORCE_GT(limit, 0);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    limit_ = limit;
+  }
+  cv_.notify_all();
+}
+
+} // namespace caffe2
@@ -0,0 +1,313 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/decode_video_clip_op.h"
+
+#include <mutex>
+
+#include "caffe2/video/customized_video_decoder.h"
+#include "caffe2/video/customized_video_io.h"
+
+namespace caffe2 {
+
+DecodeVideoClipOp::DecodeVideoClipOp(
+    const OperatorDef& operator_def,
+    Workspace* ws)
+    : Operator<CPUContext>(operator_def, ws),
+      length_(OperatorBase::GetSingleArgument<int>("length", 0)),
+      sampling_rate_(OperatorBase::GetSingleArgument<int>("sampling_rate", 1)),
+      crop_(OperatorBase::GetSingleArgument<int>("crop", -1)),
+      min_size_(OperatorBase::GetSingleArgument<int>("min_size", 256)),
+      max_size_(OperatorBase::GetSingleArgument<int>("max_size", 256)),
+      mean_(OperatorBase::GetSingleArgument<float>("mean", 0.)),
+      std_(OperatorBase::GetSingleArgument<float>("std", 1.)),
+      use_bgr_(OperatorBase::GetSingleArgument<int>("use_bgr", 0)),
+      use_local_file_(
+          OperatorBase::GetSingleArgument<int>("use_local_file", 0)),
+      sample_times_(OperatorBase::GetSingleArgument<int>("sample_times", 10)),
+      default_start_frm_(
+          OperatorBase::GetSingleArgument<int>("start_frm", 0)),
+      use_selective_decoding_(
+          OperatorBase::GetSingleArgument<int>("use_selective_decoding", 0)),
+      use_decoder_cache_(
+          OperatorBase::GetSingleArgument<int>("use_decoder_cache", 1)),
+      decode_backend_(SOFTWARE_DECODE),
+      codec_threads_(OperatorBase::GetSingleArgument<int>("codec_threads", 1)),
+      random_seed_(
+          operator_def.device_option().has_random_seed()
+              ? operator_def.device_option().random_seed()
+              : RandomNumberSeed()),
+      next_random_index_(0) {
+  CAFFE_ENFORCE_GT(length_, 0, "Must provide the clip length.");
+  CAFFE_ENFORCE_GT(sampling_rate_, 0);
+  CAFFE_ENFORCE_GT(crop_, 0, "Must provide the crop size.");
+  CAFFE_ENFORCE_GT(min_size_, 0);
+  CAFFE_ENFORCE_GE(max_size_, min_size_);
+  CAFFE_ENFORCE_GT(sample_times_, 0);
+  const int num_threads =
+      OperatorBase::GetSingleArgument<int>("decode_threads", 4);
+  CAFFE_ENFORCE_GT(num_threads, 0);
+  if (OperatorBase::GetSingleArgument<int>("use_cpu_budget_pool", 0)) {
+    cpu_budget_pool_ = GetCpuBudgetPool(-1);
+  } else {
+    thread_pool_.reset(new TaskThreadPool(num_threads));
+  }
+  const std::string backend = OperatorBase::GetSingleArgument<std::string>(
+      "decode_backend", "software");
+  if (backend == "cuvid") {
+    decode_backend_ = CUVID_DECODE;
+  } else {
+    CAFFE_ENFORCE_EQ(
+        backend, "software", "Unknown decode_backend, use software or cuvid.");
+  }
+}
+
+void DecodeVideoClipOp::DecodeItems(
+    const std::vector<int>& items,
+    const std::string& video,
+    const int start_frm,
+    const int* spatial_pos,
+    const uint64_t random_index,
+    float* clip_data) {
+  PhiloxRandom randgen(random_seed_, 0, random_index);
+  std::vector<unsigned char> buffer;
+  int height = -1;
+  int width = -1;
+  if (use_local_file_) {
+    DecodeClipFromVideoFileFlex(
+        video,
+        start_frm,
+        length_,
+        height,
+        width,
+        sampling_rate_,
+        buffer,
+        &randgen,
+        sample_times_,
+        use_selective_decoding_,
+        -1,
+        -1,
+        use_decoder_cache_,
+        decode_backend_,
+        false,
+        nullptr,
+        nullptr,
+        0,
+        false,
+        false,
+        codec_threads_);
+  } else {
+    DecodeClipFromMemoryBufferFlex(
+        video.data(),
+        video.size(),
+        start_frm,
+        length_,
+        height,
+        width,
+        sampling_rate_,
+        buffer,
+        &randgen,
+        use_selective_decoding_,
+        -1,
+        -1,
+        decode_backend_,
+        false,
+        nullptr,
+        0,
+        false,
+        codec_threads_);
+  }
+  CAFFE_ENFORCE(
+      height > 0 && width > 0 && !buffer.empty(),
+      "Cannot decode the video of item ",
+      items[0]);
+
+  // the crops of a clip share its scale
+  int scaled_height = -1;
+  int scaled_width = -1;
+  GetScaledSize(
+      height,
+      width,
+      max_size_,
+      min_size_,
+      &randgen,
+      scaled_height,
+      scaled_width);
+  std::bernoulli_distribution no_mirror(0);
+  const int clip_size = 3 * length_ * crop_ * crop_;
+  for (const int item : items) {
+    ScaleCropNormalizeTransform(
+        buffer.data(),
+        3,
+        length_,
+        height,
+        width,
+        scaled_height,
+        scaled_width,
+        crop_,
+        crop_,
+        false,
+        mean_,
+        std_,
+        clip_data + item * clip_size,
+        &randgen,
+        &no_mirror,
+        true,
+        use_bgr_,
+        spatial_pos ? spatial_pos[item] : -1);
+  }
+}
+
+bool DecodeVideoClipOp::RunOnDevice() {
+  const auto& videos = Input(0);
+  const int num_items = videos.size();
+  const int* start_frm = nullptr;
+  const int* spatial_pos = nullptr;
+  if (InputSize() > 1) {
+    CAFFE_ENFORCE_EQ(Input(1).size(), num_items);
+    start_frm = Input(1).data<int>();
+  }
+  if (InputSize() > 2) {
+    CAFFE_ENFORCE_EQ(Input(2).size(), num_items);
+    spatial_pos = Input(2).data<int>();
+  }
+  auto* clip = Output(0);
+  clip->Resize(std::vector<int>{num_items, 3, length_, crop_, crop_});
+  float* clip_data = clip->mutable_data<float>();
+  if (num_items == 0) {
+    return true;
+  }
+  const std::string* video_data = videos.data<std::string>();
+
+  // the items of every distinct (video, start frame), in order; random
+  // windows are drawn per item
+  std::vector<std::vector<int>> groups;
+  std::vector<int> group_starts;
+  for (int i = 0; i < num_items; ++i) {
+    const int start = start_frm ? start_frm[i] : default_start_frm_;
+    bool found = false;
+    for (int g = 0; start >= 0 && g < groups.size(); ++g) {
+      if (group_starts[g] == start &&
+          video_data[groups[g][0]] == video_data[i]) {
+        groups[g].push_back(i);
+        found = true;
+        break;
+      }
+    }
+    if (!found) {
+      groups.push_back({i});
+      group_starts.push_back(start);
+    }
+  }
+
+  std::mutex error_mutex;
+  std::string error;
+  CpuTaskGroup tasks;
+  for (int g = 0; g < groups.size(); ++g) {
+    const uint64_t random_index = next_random_index_ + g;
+    auto task = [&, g, random_index]() {
+      try {
+        DecodeItems(
+            groups[g],
+            video_data[groups[g][0]],
+            group_starts[g],
+            spatial_pos,
+            random_index,
+            clip_data);
+      } catch (const std::exception& e) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        error = e.what();
+      }
+    };
+    if (cpu_budget_pool_) {
+      cpu_budget_pool_->RunTaskWithID(
+          CpuConsumer::kDecode,
+          [task](std::size_t /* index */) { task(); },
+          &tasks);
+    } else {
+      thread_pool_->runTask(task);
+    }
+  }
+  if (cpu_budget_pool_) {
+    tasks.Wait();
+  } else {
+    thread_pool_->waitWorkComplete();
+  }
+  next_random_index_ += groups.size();
+  CAFFE_ENFORCE(error.empty(), error);
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(DecodeVideoClip, DecodeVideoClipOp);
+
+OPERATOR_SCHEMA(DecodeVideoClip)
+    .NumInputs(1, 3)
+    .NumOutputs(1)
+    .SetDoc(R"DOC(
+Decodes one test clip per encoded video, scales its short side to a length
+from [min_size, max_size], crops it and normalizes it as the test clips of
+CustomizedVideoInput, which makes the whole path from the bytes of a video
+to its scores one predict net. The items of a video with the same start
+frame, e.g. its crops, are decoded once.
+)DOC")
+    .Arg("length", "frames of a clip")
+    .Arg("sampling_rate", "temporal stride of the frames of a clip")
+    .Arg("crop", "height and width of the crops")
+    .Arg("min_size", "min short side length of the scaled frames, 256")
+    .Arg("max_size", "max short side length of the scaled frames, 256")
+    .Arg("mean", "subtracted from the pixels")
+    .Arg("std", "the pixels are divided by it")
+    .Arg("use_bgr", "BGR instead of RGB channel order")
+    .Arg("use_local_file", "the items are paths of video files")
+    .Arg("sample_times", "clip slots of a video file, see start_frm")
+    .Arg("start_frm", "start frame of the items without the second input, 0")
+    .Arg("decode_threads", "threads decoding the items, 4")
+    .Arg(
+        "use_cpu_budget_pool",
+        "decode on the process-wide CPU budget pool instead of "
+        "decode_threads threads of our own")
+    .Arg("use_decoder_cache", "keep the file contexts per thread, default 1")
+    .Arg("use_selective_decoding", "only decode the clip window")
+    .Arg("decode_backend", "software (default) or cuvid")
+    .Arg("codec_threads", "threads of the codec, 0 for one per core")
+    .Input(
+        0,
+        "videos",
+        "N strings: the encoded videos, or their paths with use_local_file")
+    .Input(
+        1,
+        "start_frm",
+        "N ints (optional): the first frame of the clip in the encoded video, "
+        "or its slot of sample_times evenly spaced ones in a video file; -1 "
+        "for a random window")
+    .Input(
+        2,
+        "spatial_pos",
+        "N ints (optional): the crop of the multi-crop test, 3 and up "
+        "mirrored; -1 for the center crop")
+    .Output(0, "clip", "N x 3 x length x crop x crop normalized clips");
+
+NO_GRADIENT(DecodeVideoClip);
+
+} // namespace caffe2
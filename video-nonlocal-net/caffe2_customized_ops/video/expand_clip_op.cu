@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/utils/conversions.h"
+#include "caffe2/video/expand_clip_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+template <typename T_OUT>
+__global__ void ExpandClipKernel(
+    const int size,
+    const uint8_t* X,
+    const float mean,
+    const float inv_std,
+    T_OUT* Y) {
+  CUDA_1D_KERNEL_LOOP(i, size) {
+    Y[i] = convert::To<float, T_OUT>((static_cast<float>(X[i]) - mean) *
+                                     inv_std);
+  }
+}
+
+} // namespace
+
+template <typename T_OUT, class Context>
+void ExpandClip(
+    const int size,
+    const uint8_t* X,
+    const float mean,
+    const float inv_std,
+    T_OUT* Y,
+    Context* context) {
+  ExpandClipKernel<T_OUT><<<
+      CAFFE_GET_BLOCKS(size),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(size, X, mean, inv_std, Y);
+}
+
+template void ExpandClip<float, CUDAContext>(
+    const int size,
+    const uint8_t* X,
+    const float mean,
+    const float inv_std,
+    float* Y,
+    CUDAContext* context);
+template void ExpandClip<float16, CUDAContext>(
+    const int size,
+    const uint8_t* X,
+    const float mean,
+    const float inv_std,
+    float16* Y,
+    CUDAContext* context);
+
+REGISTER_CUDA_OPERATOR(ExpandClip, ExpandClipOp<CUDAContext>);
+
+} // namespace caffe2
@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef GLOBAL_AVG_POOL_FC_OP_H_
+#define GLOBAL_AVG_POOL_FC_OP_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// The classification head of the video nets in one op: average pooling of
+// X (N x C x T x H x W) over [kT, kH, kW] windows with stride 1 (the whole
+// clip by default), the FC projection of every window, an optional softmax
+// per window and the mean over the windows. Y is N x K. For inference, the
+// op has no gradient.
+template <typename T, class Context>
+class GlobalAvgPoolFCOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  GlobalAvgPoolFCOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        kernels_(OperatorBase::template GetRepeatedArgument<int>("kernels")),
+        softmax_(OperatorBase::template GetSingleArgument<bool>(
+            "softmax", false)) {}
+
+  bool RunOnDevice() override;
+
+ private:
+  // the window sizes and the number of windows along the spatial axes of X
+  void InferWindows(const Tensor<Context>& X);
+
+  std::vector<int> kernels_;
+  bool softmax_;
+
+  std::vector<int> window_dims_;
+  std::vector<int> window_counts_;
+  int num_windows_ = 1;
+
+  // N x C x windows means, then N x windows x K logits
+  Tensor<Context> pooled_;
+  Tensor<Context> logits_;
+};
+
+template <typename T, class Context>
+void GlobalAvgPoolFCOp<T, Context>::InferWindows(const Tensor<Context>& X) {
+  const int spatial = X.ndim() - 2;
+  CAFFE_ENFORCE_GE(spatial, 1, "GlobalAvgPoolFC needs an N x C x ... input");
+  CAFFE_ENFORCE(
+      kernels_.empty() || kernels_.size() == spatial,
+      "kernels needs one size per spatial axis of X");
+  window_dims_.resize(spatial);
+  window_counts_.resize(spatial);
+  num_windows_ = 1;
+  for (int i = 0; i < spatial; ++i) {
+    const int size = X.dim32(i + 2);
+    window_dims_[i] = kernels_.empty() ? size : kernels_[i];
+    CAFFE_ENFORCE(
+        window_dims_[i] >= 1 && window_dims_[i] <= size,
+        "pooling window ",
+        window_dims_[i],
+        " does not fit into the input size ",
+        size);
+    window_counts_[i] = size - window_dims_[i] + 1;
+    num_windows_ *= window_counts_[i];
+  }
+}
+
+} // namespace caffe2
+
+#endif // GLOBAL_AVG_POOL_FC_OP_H_
@@ -0,0 +1,165 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/global_avg_pool_fc_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+constexpr int kN = 2;
+constexpr int kC = 5;
+constexpr int kK = 7;
+
+void AddRandomInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<int>& dims,
+    const int seed) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  for (int i = 0; i < tensor->size(); ++i) {
+    tensor->mutable_data<float>()[i] = dist(gen);
+  }
+}
+
+std::unique_ptr<OperatorBase> CreateHead(
+    Workspace* ws,
+    const std::vector<int>& kernels,
+    const bool softmax) {
+  OperatorDef def;
+  def.set_type("GlobalAvgPoolFC");
+  def.add_input("X");
+  def.add_input("W");
+  def.add_input("b");
+  def.add_output("Y");
+  if (!kernels.empty()) {
+    auto* arg = def.add_arg();
+    arg->set_name("kernels");
+    for (int k : kernels) {
+      arg->add_ints(k);
+    }
+  }
+  auto* arg = def.add_arg();
+  arg->set_name("softmax");
+  arg->set_i(softmax);
+  return CreateOperator(def, ws);
+}
+
+// AveragePool over the [kT, kH, kW] windows, FC, optional softmax and the
+// mean over the windows, one output at a time
+std::vector<float> ReferenceHead(
+    Workspace* ws,
+    const std::vector<int>& kernels,
+    const bool softmax) {
+  const auto& X = ws->GetBlob("X")->Get<TensorCPU>();
+  const float* x = X.data<float>();
+  const float* w = ws->GetBlob("W")->Get<TensorCPU>().data<float>();
+  const float* b = ws->GetBlob("b")->Get<TensorCPU>().data<float>();
+  const int T = X.dim32(2);
+  const int H = X.dim32(3);
+  const int W = X.dim32(4);
+  const int kT = kernels.empty() ? T : kernels[0];
+  const int kH = kernels.empty() ? H : kernels[1];
+  const int kW = kernels.empty() ? W : kernels[2];
+  const int L = (T - kT + 1) * (H - kH + 1) * (W - kW + 1);
+  std::vector<float> y(kN * kK, 0.f);
+  for (int n = 0; n < kN; ++n) {
+    for (int t = 0; t + kT <= T; ++t) {
+      for (int h = 0; h + kH <= H; ++h) {
+        for (int v = 0; v + kW <= W; ++v) {
+          std::vector<float> pooled(kC, 0.f);
+          for (int c = 0; c < kC; ++c) {
+            for (int i = t; i < t + kT; ++i) {
+              for (int j = h; j < h + kH; ++j) {
+                for (int l = v; l < v + kW; ++l) {
+                  pooled[c] += x[(((n * kC + c) * T + i) * H + j) * W + l];
+                }
+              }
+            }
+            pooled[c] /= kT * kH * kW;
+          }
+          std::vector<float> z(kK);
+          float max = -1e30f;
+          for (int k = 0; k < kK; ++k) {
+            z[k] = b[k];
+            for (int c = 0; c < kC; ++c) {
+              z[k] += w[k * kC + c] * pooled[c];
+            }
+            max = std::max(max, z[k]);
+          }
+          float sum = 0.f;
+          for (int k = 0; k < kK; ++k) {
+            sum += std::exp(z[k] - max);
+          }
+          for (int k = 0; k < kK; ++k) {
+            y[n * kK + k] +=
+                (softmax ? std::exp(z[k] - max) / sum : z[k]) / L;
+          }
+        }
+      }
+    }
+  }
+  return y;
+}
+
+void ExpectNear(Workspace* ws, const std::vector<float>& expected) {
+  const auto& Y = ws->GetBlob("Y")->Get<TensorCPU>();
+  ASSERT_EQ(Y.ndim(), 2);
+  EXPECT_EQ(Y.dim32(0), kN);
+  EXPECT_EQ(Y.dim32(1), kK);
+  for (int i = 0; i < Y.size(); ++i) {
+    EXPECT_NEAR(Y.data<float>()[i], expected[i], 1e-5) << i;
+  }
+}
+
+void AddParams(Workspace* ws, const std::vector<int>& weight_dims) {
+  AddRandomInput(ws, "W", weight_dims, 2);
+  AddRandomInput(ws, "b", {kK}, 3);
+}
+
+} // namespace
+
+TEST(GlobalAvgPoolFCOpTest, MatchesGlobalPoolAndFC) {
+  Workspace ws;
+  AddRandomInput(&ws, "X", {kN, kC, 4, 7, 7}, 1);
+  AddParams(&ws, {kK, kC});
+  for (const bool softmax : {false, true}) {
+    auto op = CreateHead(&ws, {}, softmax);
+    ASSERT_TRUE(op->Run());
+    ExpectNear(&ws, ReferenceHead(&ws, {}, softmax));
+  }
+}
+
+TEST(GlobalAvgPoolFCOpTest, MatchesFullyConvHead) {
+  Workspace ws;
+  AddRandomInput(&ws, "X", {kN, kC, 5, 8, 9}, 1);
+  // the weights of the 1x1x1 conv of the test nets
+  AddParams(&ws, {kK, kC, 1, 1, 1});
+  const std::vector<int> kernels = {4, 7, 7};
+  for (const bool softmax : {false, true}) {
+    auto op = CreateHead(&ws, kernels, softmax);
+    ASSERT_TRUE(op->Run());
+    ExpectNear(&ws, ReferenceHead(&ws, kernels, softmax));
+  }
+}
+
+TEST(GlobalAvgPoolFCOpTest, TakesVariableSizes) {
+  Workspace ws;
+  AddParams(&ws, {kK, kC});
+  AddRandomInput(&ws, "X", {kN, kC, 2, 3, 4}, 1);
+  auto op = CreateHead(&ws, {2, 3, 3}, true);
+  for (const int size : {3, 6, 4}) {
+    AddRandomInput(&ws, "X", {kN, kC, 2 + size % 2, size, size + 1}, size);
+    ASSERT_TRUE(op->Run());
+    ExpectNear(&ws, ReferenceHead(&ws, {2, 3, 3}, true));
+  }
+}
+
+} // namespace caffe2
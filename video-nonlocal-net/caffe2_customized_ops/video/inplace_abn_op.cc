@@ -0,0 +1,233 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/inplace_abn_op.h"
+#include "caffe2/utils/parallel_for.h"
+
+namespace caffe2 {
+
+template <>
+bool InPlaceABNOp<float, CPUContext>::RunOnDevice() {
+  const auto& X = Input(INPUT);
+  const auto& scale = Input(SCALE);
+  const auto& bias = Input(BIAS);
+  auto* Y = Output(OUTPUT);
+
+  CAFFE_ENFORCE_GE(X.ndim(), 3);
+  const int N = X.dim32(0);
+  const int C = X.dim32(1);
+  const int inner = X.size() / N / C; // support TxHxW
+  CAFFE_ENFORCE_EQ(scale.size(), C);
+  CAFFE_ENFORCE_EQ(bias.size(), C);
+  Y->ResizeLike(X);
+  ConstEigenArrayMap<float> X_arr(X.data<float>(), inner, N * C);
+
+  Eigen::Array<float, Eigen::Dynamic, 1> mean(C);
+  Eigen::Array<float, Eigen::Dynamic, 1> inv_std(C);
+  if (is_test_) {
+    mean = ConstEigenVectorArrayMap<float>(Input(EST_MEAN).data<float>(), C);
+    inv_std = (ConstEigenVectorArrayMap<float>(Input(EST_VAR).data<float>(), C) +
+               epsilon_)
+                  .rsqrt();
+  } else {
+    // biased variance, as the CPU SpatialBN
+    Eigen::Array<float, Eigen::Dynamic, 1> var(C);
+    mean.setZero();
+    var.setZero();
+    for (int plane = 0; plane < N * C; ++plane) {
+      mean(plane % C) += X_arr.col(plane).sum();
+    }
+    mean /= N * inner;
+    for (int plane = 0; plane < N * C; ++plane) {
+      var(plane % C) +=
+          (X_arr.col(plane) - mean(plane % C)).matrix().squaredNorm();
+    }
+    var /= N * inner;
+    inv_std = (var + epsilon_).rsqrt();
+
+    Output(SAVED_MEAN)->Resize(C);
+    Output(SAVED_INV_STD)->Resize(C);
+    EigenVectorArrayMap<float>(Output(SAVED_MEAN)->mutable_data<float>(), C) =
+        mean;
+    EigenVectorArrayMap<float>(
+        Output(SAVED_INV_STD)->mutable_data<float>(), C) = inv_std;
+    for (auto* running : {Output(RUNNING_MEAN), Output(RUNNING_VAR)}) {
+      if (!running->size()) {
+        running->Resize(C);
+        math::Set<float, CPUContext>(
+            C, 0.f, running->mutable_data<float>(), &context_);
+      }
+    }
+    EigenVectorArrayMap<float> running_mean(
+        Output(RUNNING_MEAN)->mutable_data<float>(), C);
+    EigenVectorArrayMap<float> running_var(
+        Output(RUNNING_VAR)->mutable_data<float>(), C);
+    running_mean = running_mean * momentum_ + mean * (1.f - momentum_);
+    running_var = running_var * momentum_ + var * (1.f - momentum_);
+  }
+
+  // act(x * a + b) with a = (|scale| + epsilon) * inv_std, b = bias - mean * a
+  const Eigen::Array<float, Eigen::Dynamic, 1> a =
+      (ConstEigenVectorArrayMap<float>(scale.data<float>(), C).abs() +
+       epsilon_) *
+      inv_std;
+  const Eigen::Array<float, Eigen::Dynamic, 1> b =
+      ConstEigenVectorArrayMap<float>(bias.data<float>(), C) - mean * a;
+  float* Y_data = Y->mutable_data<float>();
+  ParallelFor(
+      N * C, ParallelForGrainSize(inner), [&](int64_t begin, int64_t end) {
+        for (int64_t plane = begin; plane < end; ++plane) {
+          const int c = plane % C;
+          EigenVectorArrayMap<float> y(Y_data + plane * inner, inner);
+          y = X_arr.col(plane) * a(c) + b(c);
+          y = (y < 0.f).select(y * alpha_, y);
+        }
+      });
+  return true;
+}
+
+template <>
+bool InPlaceABNGradientOp<float, CPUContext>::RunOnDevice() {
+  const auto& Y = Input(OUTPUT);
+  const auto& scale = Input(SCALE);
+  const auto& bias = Input(BIAS);
+  const auto& dY = Input(OUTPUT_GRAD);
+
+  const int N = Y.dim32(0);
+  const int C = Y.dim32(1);
+  const int inner = Y.size() / N / C;
+  CAFFE_ENFORCE_EQ(dY.size(), Y.size());
+  auto* dX = Output(INPUT_GRAD);
+  auto* dscale = Output(SCALE_GRAD);
+  auto* dbias = Output(BIAS_GRAD);
+  dX->ResizeLike(Y);
+  dscale->ResizeLike(scale);
+  dbias->ResizeLike(scale);
+
+  ConstEigenArrayMap<float> Y_arr(Y.data<float>(), inner, N * C);
+  ConstEigenArrayMap<float> dY_arr(dY.data<float>(), inner, N * C);
+  ConstEigenVectorArrayMap<float> scale_arr(scale.data<float>(), C);
+  ConstEigenVectorArrayMap<float> bias_arr(bias.data<float>(), C);
+  ConstEigenVectorArrayMap<float> inv_std(
+      Input(SAVED_INV_STD).data<float>(), C);
+  const Eigen::Array<float, Eigen::Dynamic, 1> gamma =
+      scale_arr.abs() + epsilon_;
+  EigenVectorArrayMap<float> dscale_arr(dscale->mutable_data<float>(), C);
+  EigenVectorArrayMap<float> dbias_arr(dbias->mutable_data<float>(), C);
+
+  // With z = act^-1(Y), g = dY * act'(z) and x_hat = (z - bias) / gamma:
+  // dgamma = sum(g * x_hat), dbias = sum(g)
+  Eigen::Array<float, Eigen::Dynamic, 1> dgamma(C);
+  dgamma.setZero();
+  dbias_arr.setZero();
+  for (int plane = 0; plane < N * C; ++plane) {
+    const int c = plane % C;
+    const auto negative = Y_arr.col(plane) < 0.f;
+    const auto g = negative.select(dY_arr.col(plane) * alpha_,
+                                   dY_arr.col(plane));
+    const auto z = negative.select(Y_arr.col(plane) / alpha_,
+                                   Y_arr.col(plane));
+    dbias_arr(c) += g.sum();
+    dgamma(c) += (g * (z - bias_arr(c))).sum() / gamma(c);
+  }
+  // gamma = |scale| + epsilon
+  dscale_arr = (scale_arr < 0.f).select(-dgamma, dgamma);
+
+  // dX = gamma * inv_std * (g - (dbias + x_hat * dgamma) / M), in terms of z
+  const float inv_M = 1.f / (N * inner);
+  float* dX_data = dX->mutable_data<float>();
+  ParallelFor(
+      N * C, ParallelForGrainSize(inner), [&](int64_t begin, int64_t end) {
+        for (int64_t plane = begin; plane < end; ++plane) {
+          const int c = plane % C;
+          const float dx_scale = gamma(c) * inv_std(c);
+          const float dx_z = inv_std(c) * dgamma(c) * inv_M;
+          const float dx_bias =
+              dx_scale * dbias_arr(c) * inv_M - dx_z * bias_arr(c);
+          const auto negative = Y_arr.col(plane) < 0.f;
+          const auto g = negative.select(dY_arr.col(plane) * alpha_,
+                                         dY_arr.col(plane));
+          const auto z = negative.select(Y_arr.col(plane) / alpha_,
+                                         Y_arr.col(plane));
+          // dY may be dX: the expression is elementwise
+          EigenVectorArrayMap<float>(dX_data + plane * inner, inner) =
+              g * dx_scale - z * dx_z - dx_bias;
+        }
+      });
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(InPlaceABN, InPlaceABNOp<float, CPUContext>);
+REGISTER_CPU_OPERATOR(InPlaceABNGradient,
+                      InPlaceABNGradientOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(InPlaceABN)
+    .NumInputs(5)
+    .NumOutputs({1, 5})
+    .AllowInplace({{0, 0}})
+    .EnforceInplace({{3, 1}, {4, 2}})
+    .SetDoc(R"DOC(
+In-place activated BN: Y = act(SpatialBN(X)) with the scale |scale| + epsilon
+and act a leaky ReLU of slope alpha (alpha = 1: no activation), meant to be
+written over X. The gradient reads only Y, the params and the saved inverse
+std: it inverts act and the affine transform to recover the normalized
+input, so that X need not be kept for the backward pass. Inputs, outputs and
+the other arguments are the ones of SpatialBN, NCHW only; X may have any
+number of spatial dims. In training the running variance is updated with
+the biased batch variance on CPU and the unbiased one on GPU, as SpatialBN
+and the cuDNN SpatialBN do.
+)DOC")
+    .Arg("is_test", "If set to nonzero, run SpatialBN in test mode.")
+    .Arg("epsilon", "The epsilon value to use to avoid division by zero.")
+    .Arg("momentum", "Factor used in computing the running mean and variance.")
+    .Arg("alpha", "Slope of the activation for negative inputs, in (0, 1]; "
+         "default 0.01")
+    .Input(0, "X", "N x C x (spatial dims)")
+    .Input(1, "scale", "The scale as a 1-dimensional tensor of size C")
+    .Input(2, "bias", "The bias as a 1-dimensional tensor of size C")
+    .Input(3, "mean", "The running mean, size C")
+    .Input(4, "var", "The running variance, size C")
+    .Output(0, "Y", "The output of the shape of X");
+OPERATOR_SCHEMA(InPlaceABNGradient)
+    .NumInputs(5)
+    .NumOutputs(3)
+    .AllowInplace({{3, 0}});
+
+class GetInPlaceABNGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    CAFFE_ENFORCE(
+        !ArgumentHelper::GetSingleArgument(def_, "is_test", 0),
+        "InPlaceABN has no gradient in test mode");
+    return SingleGradientDef(
+        "InPlaceABNGradient",
+        "",
+        vector<string>{O(0), I(1), I(2), GO(0), O(4)},
+        vector<string>{GI(0), GI(1), GI(2)});
+  }
+};
+
+REGISTER_GRADIENT(InPlaceABN, GetInPlaceABNGradient);
+
+} // namespace caffe2
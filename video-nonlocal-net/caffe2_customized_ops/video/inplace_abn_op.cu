@@ -0,0 +1,342 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <cub/block/block_reduce.cuh>
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/video/inplace_abn_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// Same launch shapes as SpatialBNRelu: one block per channel for the
+// reductions, and a 2D grid over the N x C planes and their T x H x W
+// elements for the elementwise passes.
+constexpr int kReduceThreads = CAFFE_CUDA_NUM_THREADS;
+constexpr int kThreads = 256;
+constexpr int kMaxBlocksPerPlane = 1024;
+
+using BlockReduce = cub::BlockReduce<float, kReduceThreads>;
+
+dim3 PlaneGrid(const int planes, const int inner) {
+  return dim3(
+      std::min(planes, CAFFE_MAXIMUM_NUM_BLOCKS),
+      std::min((inner + kThreads - 1) / kThreads, kMaxBlocksPerPlane));
+}
+
+// Batch mean and variance of channel c, shifted by the first element of the
+// channel against cancellation; writes the saved and running statistics and
+// the coefficients of the forward pass to affine[c] and affine[C + c].
+__global__ void ChannelMomentsKernel(
+    const int N,
+    const int C,
+    const int inner,
+    const float* X,
+    const float* scale,
+    const float* bias,
+    const float momentum,
+    const float epsilon,
+    float* saved_mean,
+    float* saved_inv_std,
+    float* running_mean,
+    float* running_var,
+    float* affine) {
+  __shared__ typename BlockReduce::TempStorage temp;
+  const int c = blockIdx.x;
+  const float shift = X[c * inner];
+  float sum = 0.f;
+  float sumsq = 0.f;
+  for (int n = 0; n < N; ++n) {
+    const float* x = X + static_cast<size_t>(n * C + c) * inner;
+    for (int i = threadIdx.x; i < inner; i += blockDim.x) {
+      const float d = x[i] - shift;
+      sum += d;
+      sumsq += d * d;
+    }
+  }
+  sum = BlockReduce(temp).Sum(sum);
+  __syncthreads();
+  sumsq = BlockReduce(temp).Sum(sumsq);
+  if (threadIdx.x == 0) {
+    const float M = static_cast<float>(N) * inner;
+    const float shifted_mean = sum / M;
+    const float var = fmaxf(sumsq / M - shifted_mean * shifted_mean, 0.f);
+    const float mean = shift + shifted_mean;
+    const float inv_std = rsqrtf(var + epsilon);
+    saved_mean[c] = mean;
+    saved_inv_std[c] = inv_std;
+    running_mean[c] = running_mean[c] * momentum + mean * (1.f - momentum);
+    running_var[c] = running_var[c] * momentum +
+        var * (M > 1.f ? M / (M - 1.f) : 1.f) * (1.f - momentum);
+    const float a = (fabsf(scale[c]) + epsilon) * inv_std;
+    affine[c] = a;
+    affine[C + c] = bias[c] - mean * a;
+  }
+}
+
+__global__ void TestAffineKernel(
+    const int C,
+    const float* scale,
+    const float* bias,
+    const float* mean,
+    const float* var,
+    const float epsilon,
+    float* affine) {
+  CUDA_1D_KERNEL_LOOP(c, C) {
+    const float a = (fabsf(scale[c]) + epsilon) * rsqrtf(var[c] + epsilon);
+    affine[c] = a;
+    affine[C + c] = bias[c] - mean[c] * a;
+  }
+}
+
+// X may be Y
+__global__ void ABNForwardKernel(
+    const int planes,
+    const int C,
+    const int inner,
+    const float alpha,
+    const float* X,
+    const float* affine,
+    float* Y) {
+  for (int plane = blockIdx.x; plane < planes; plane += gridDim.x) {
+    const int c = plane % C;
+    const float a = affine[c];
+    const float b = affine[C + c];
+    const size_t offset = static_cast<size_t>(plane) * inner;
+    for (int i = blockIdx.y * blockDim.x + threadIdx.x; i < inner;
+         i += gridDim.y * blockDim.x) {
+      const float z = X[offset + i] * a + b;
+      Y[offset + i] = z < 0.f ? z * alpha : z;
+    }
+  }
+}
+
+// With z = act^-1(Y), g = dY * act'(z) and gamma = |scale| + epsilon:
+// dbias[c] = sum(g), dscale[c] = sign(scale) * sum(g * (z - bias)) / gamma
+__global__ void ChannelGradientSumsKernel(
+    const int N,
+    const int C,
+    const int inner,
+    const float alpha,
+    const float epsilon,
+    const float* Y,
+    const float* dY,
+    const float* scale,
+    const float* bias,
+    float* dscale,
+    float* dbias) {
+  __shared__ typename BlockReduce::TempStorage temp;
+  const int c = blockIdx.x;
+  const float inv_alpha = 1.f / alpha;
+  const float beta = bias[c];
+  float g_sum = 0.f;
+  float gz_sum = 0.f;
+  for (int n = 0; n < N; ++n) {
+    const size_t offset = static_cast<size_t>(n * C + c) * inner;
+    for (int i = threadIdx.x; i < inner; i += blockDim.x) {
+      const float y = Y[offset + i];
+      const bool negative = y < 0.f;
+      const float g = negative ? dY[offset + i] * alpha : dY[offset + i];
+      const float z = negative ? y * inv_alpha : y;
+      g_sum += g;
+      gz_sum += g * (z - beta);
+    }
+  }
+  g_sum = BlockReduce(temp).Sum(g_sum);
+  __syncthreads();
+  gz_sum = BlockReduce(temp).Sum(gz_sum);
+  if (threadIdx.x == 0) {
+    const float dgamma = gz_sum / (fabsf(scale[c]) + epsilon);
+    dbias[c] = g_sum;
+    dscale[c] = scale[c] < 0.f ? -dgamma : dgamma;
+  }
+}
+
+// dX = gamma * inv_std * (g - (dbias + x_hat * dgamma) / M), in terms of z;
+// dY may be dX
+__global__ void ABNBackwardKernel(
+    const int planes,
+    const int C,
+    const int inner,
+    const float inv_M,
+    const float alpha,
+    const float epsilon,
+    const float* Y,
+    const float* dY,
+    const float* scale,
+    const float* bias,
+    const float* inv_std,
+    const float* dscale,
+    const float* dbias,
+    float* dX) {
+  const float inv_alpha = 1.f / alpha;
+  for (int plane = blockIdx.x; plane < planes; plane += gridDim.x) {
+    const int c = plane % C;
+    const float gamma = fabsf(scale[c]) + epsilon;
+    const float dgamma = scale[c] < 0.f ? -dscale[c] : dscale[c];
+    const float dx_scale = gamma * inv_std[c];
+    const float dx_z = inv_std[c] * dgamma * inv_M;
+    const float dx_bias = dx_scale * dbias[c] * inv_M - dx_z * bias[c];
+    const size_t offset = static_cast<size_t>(plane) * inner;
+    for (int i = blockIdx.y * blockDim.x + threadIdx.x; i < inner;
+         i += gridDim.y * blockDim.x) {
+      const float y = Y[offset + i];
+      const bool negative = y < 0.f;
+      const float g = negative ? dY[offset + i] * alpha : dY[offset + i];
+      const float z = negative ? y * inv_alpha : y;
+      dX[offset + i] = g * dx_scale - z * dx_z - dx_bias;
+    }
+  }
+}
+
+} // namespace
+
+template <>
+bool InPlaceABNOp<float, CUDAContext>::RunOnDevice() {
+  const auto& X = Input(INPUT);
+  const auto& scale = Input(SCALE);
+  const auto& bias = Input(BIAS);
+  auto* Y = Output(OUTPUT);
+
+  CAFFE_ENFORCE_GE(X.ndim(), 3);
+  const int N = X.dim32(0);
+  const int C = X.dim32(1);
+  const int inner = X.size() / N / C; // support TxHxW
+  CAFFE_ENFORCE_EQ(scale.size(), C);
+  CAFFE_ENFORCE_EQ(bias.size(), C);
+  affine_.Resize(2 * C);
+  float* affine = affine_.mutable_data<float>();
+
+  if (is_test_) {
+    TestAffineKernel<<<
+        CAFFE_GET_BLOCKS(C),
+        CAFFE_CUDA_NUM_THREADS,
+        0,
+        context_.cuda_stream()>>>(
+        C,
+        scale.data<float>(),
+        bias.data<float>(),
+        Input(EST_MEAN).data<float>(),
+        Input(EST_VAR).data<float>(),
+        epsilon_,
+        affine);
+  } else {
+    for (auto* running : {Output(RUNNING_MEAN), Output(RUNNING_VAR)}) {
+      if (!running->size()) {
+        running->Resize(C);
+        math::Set<float, CUDAContext>(
+            C, 0.f, running->mutable_data<float>(), &context_);
+      }
+    }
+    Output(SAVED_MEAN)->Resize(C);
+    Output(SAVED_INV_STD)->Resize(C);
+    ChannelMomentsKernel<<<C, kReduceThreads, 0, context_.cuda_stream()>>>(
+        N,
+        C,
+        inner,
+        X.data<float>(),
+        scale.data<float>(),
+        bias.data<float>(),
+        momentum_,
+        epsilon_,
+        Output(SAVED_MEAN)->mutable_data<float>(),
+        Output(SAVED_INV_STD)->mutable_data<float>(),
+        Output(RUNNING_MEAN)->mutable_data<float>(),
+        Output(RUNNING_VAR)->mutable_data<float>(),
+        affine);
+  }
+
+  const float* X_data = X.data<float>();
+  Y->ResizeLike(X);
+  ABNForwardKernel<<<
+      PlaneGrid(N * C, inner),
+      kThreads,
+      0,
+      context_.cuda_stream()>>>(
+      N * C, C, inner, alpha_, X_data, affine, Y->mutable_data<float>());
+  return true;
+}
+
+template <>
+bool InPlaceABNGradientOp<float, CUDAContext>::RunOnDevice() {
+  const auto& Y = Input(OUTPUT);
+  const auto& scale = Input(SCALE);
+  const auto& bias = Input(BIAS);
+  const auto& dY = Input(OUTPUT_GRAD);
+
+  const int N = Y.dim32(0);
+  const int C = Y.dim32(1);
+  const int inner = Y.size() / N / C;
+  CAFFE_ENFORCE_EQ(dY.size(), Y.size());
+  auto* dX = Output(INPUT_GRAD);
+  auto* dscale = Output(SCALE_GRAD);
+  auto* dbias = Output(BIAS_GRAD);
+  dX->ResizeLike(Y);
+  dscale->ResizeLike(scale);
+  dbias->ResizeLike(scale);
+
+  ChannelGradientSumsKernel<<<C, kReduceThreads, 0, context_.cuda_stream()>>>(
+      N,
+      C,
+      inner,
+      alpha_,
+      epsilon_,
+      Y.data<float>(),
+      dY.data<float>(),
+      scale.data<float>(),
+      bias.data<float>(),
+      dscale->mutable_data<float>(),
+      dbias->mutable_data<float>());
+
+  const float inv_M = 1.f / (static_cast<float>(N) * inner);
+  const float* dY_data = dY.data<float>();
+  ABNBackwardKernel<<<
+      PlaneGrid(N * C, inner),
+      kThreads,
+      0,
+      context_.cuda_stream()>>>(
+      N * C,
+      C,
+      inner,
+      inv_M,
+      alpha_,
+      epsilon_,
+      Y.data<float>(),
+      dY_data,
+      scale.data<float>(),
+      bias.data<float>(),
+      Input(SAVED_INV_STD).data<float>(),
+      dscale->data<float>(),
+      dbias->data<float>(),
+      dX->mutable_data<float>());
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(InPlaceABN, InPlaceABNOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR(
+    InPlaceABNGradient,
+    InPlaceABNGradientOp<float, CUDAContext>);
+} // namespace caffe2
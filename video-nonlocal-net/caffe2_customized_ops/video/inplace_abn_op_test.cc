@@ -0,0 +1,148 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/inplace_abn_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+constexpr float kAlpha = 0.1f;
+constexpr float kEpsilon = 1e-5f;
+
+void AddInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<TIndex>& dims,
+    const float offset) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  float* data = tensor->mutable_data<float>();
+  for (int i = 0; i < tensor->size(); ++i) {
+    // deterministic, of both signs and not sorted
+    data[i] = std::sin(i * 1.7f + offset) * (1.f + offset);
+  }
+}
+
+void RunOp(
+    Workspace* ws,
+    const std::string& type,
+    const std::vector<std::string>& inputs,
+    const std::vector<std::string>& outputs,
+    const int is_test = 0) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  for (const auto& output : outputs) {
+    def.add_output(output);
+  }
+  if (type == "SpatialBN" || type == "InPlaceABN") {
+    def.add_arg()->CopyFrom(MakeArgument<int>("is_test", is_test));
+    def.add_arg()->CopyFrom(MakeArgument<float>("momentum", 0.5f));
+  }
+  if (type.find("SpatialBN") == 0 || type.find("InPlaceABN") == 0) {
+    def.add_arg()->CopyFrom(MakeArgument<float>("epsilon", kEpsilon));
+  }
+  if (type.find("LeakyRelu") == 0 || type.find("InPlaceABN") == 0) {
+    def.add_arg()->CopyFrom(MakeArgument<float>("alpha", kAlpha));
+  }
+  auto op = CreateOperator(def, ws);
+  ASSERT_TRUE(op->Run());
+}
+
+void ExpectNear(Workspace* ws, const std::string& a, const std::string& b) {
+  const auto& A = ws->GetBlob(a)->Get<TensorCPU>();
+  const auto& B = ws->GetBlob(b)->Get<TensorCPU>();
+  ASSERT_EQ(A.size(), B.size());
+  for (int i = 0; i < A.size(); ++i) {
+    EXPECT_NEAR(A.data<float>()[i], B.data<float>()[i], 1e-4)
+        << a << " vs " << b << " at " << i;
+  }
+}
+
+// N x C x T x H x W with its BN params, one scale of them negative; the
+// scale of the reference ops is |scale| + epsilon
+void AddBlobs(Workspace* ws) {
+  const std::vector<TIndex> dims = {2, 3, 2, 3, 4};
+  AddInput(ws, "X", dims, 0.f);
+  AddInput(ws, "dY", dims, 0.25f);
+  AddInput(ws, "scale", {3}, 1.f);
+  AddInput(ws, "bias", {3}, 2.f);
+  const auto& scale = ws->GetBlob("scale")->Get<TensorCPU>();
+  auto* ref_scale = ws->CreateBlob("ref_scale")->GetMutable<TensorCPU>();
+  ref_scale->Resize(3);
+  for (int i = 0; i < 3; ++i) {
+    ref_scale->mutable_data<float>()[i] =
+        std::fabs(scale.data<float>()[i]) + kEpsilon;
+  }
+  for (const std::string& prefix : {"ref", "abn"}) {
+    AddInput(ws, prefix + "_rm", {3}, 3.f);
+    AddInput(ws, prefix + "_rv", {3}, 4.f);
+    // variances must be positive
+    auto* var = ws->GetBlob(prefix + "_rv")->GetMutable<TensorCPU>();
+    for (int i = 0; i < 3; ++i) {
+      var->mutable_data<float>()[i] = i + 1.f;
+    }
+  }
+}
+
+} // namespace
+
+TEST(InPlaceABNOpTest, MatchesSeparateOps) {
+  Workspace ws;
+  AddBlobs(&ws);
+  ASSERT_LT(ws.GetBlob("scale")->Get<TensorCPU>().data<float>()[2], 0.f);
+  RunOp(&ws, "SpatialBN",
+        {"X", "ref_scale", "bias", "ref_rm", "ref_rv"},
+        {"bn", "ref_rm", "ref_rv", "ref_sm", "ref_siv"});
+  RunOp(&ws, "LeakyRelu", {"bn"}, {"Y_ref"});
+  RunOp(&ws, "Copy", {"X"}, {"Y"});
+  // in place, as in the nets
+  RunOp(&ws, "InPlaceABN",
+        {"Y", "scale", "bias", "abn_rm", "abn_rv"},
+        {"Y", "abn_rm", "abn_rv", "abn_sm", "abn_siv"});
+  ExpectNear(&ws, "Y", "Y_ref");
+  ExpectNear(&ws, "abn_rm", "ref_rm");
+  ExpectNear(&ws, "abn_rv", "ref_rv");
+  ExpectNear(&ws, "abn_sm", "ref_sm");
+  ExpectNear(&ws, "abn_siv", "ref_siv");
+
+  RunOp(&ws, "LeakyReluGradient", {"Y_ref", "dY"}, {"dbn"});
+  RunOp(&ws, "SpatialBNGradient",
+        {"X", "ref_scale", "dbn", "ref_sm", "ref_siv"},
+        {"dX_ref", "dscale_ref", "dbias_ref"});
+  // the gradient of |scale| + epsilon
+  auto* dscale_ref = ws.GetBlob("dscale_ref")->GetMutable<TensorCPU>();
+  const auto& scale = ws.GetBlob("scale")->Get<TensorCPU>();
+  for (int i = 0; i < 3; ++i) {
+    if (scale.data<float>()[i] < 0.f) {
+      dscale_ref->mutable_data<float>()[i] *= -1.f;
+    }
+  }
+  // without X, and in place of dY
+  RunOp(&ws, "InPlaceABNGradient",
+        {"Y", "scale", "bias", "dY", "abn_siv"},
+        {"dY", "dscale", "dbias"});
+  ExpectNear(&ws, "dY", "dX_ref");
+  ExpectNear(&ws, "dscale", "dscale_ref");
+  ExpectNear(&ws, "dbias", "dbias_ref");
+}
+
+TEST(InPlaceABNOpTest, TestMode) {
+  Workspace ws;
+  AddBlobs(&ws);
+  RunOp(&ws, "SpatialBN",
+        {"X", "ref_scale", "bias", "ref_rm", "ref_rv"}, {"bn"}, 1);
+  RunOp(&ws, "LeakyRelu", {"bn"}, {"Y_ref"});
+  RunOp(&ws, "InPlaceABN",
+        {"X", "scale", "bias", "abn_rm", "abn_rv"}, {"X"}, 1);
+  ExpectNear(&ws, "X", "Y_ref");
+}
+
+} // namespace caffe2
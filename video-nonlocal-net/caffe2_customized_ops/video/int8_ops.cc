@@ -0,0 +1,236 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/int8_ops.h"
+
+namespace caffe2 {
+
+bool Int8QuantizeOp::RunOnDevice() {
+  const auto& X = Input(0);
+  auto* Y = Output(0);
+  Y->ResizeLike(X);
+  const float* Xdata = X.data<float>();
+  uint8_t* Ydata = Y->mutable_data<uint8_t>();
+  const float inv_scale = 1.f / Y_scale_;
+#pragma omp parallel for
+  for (int i = 0; i < X.size(); ++i) {
+    Ydata[i] = int8::Quantize(Xdata[i], inv_scale, Y_zero_point_);
+  }
+  return true;
+}
+
+bool Int8DequantizeOp::RunOnDevice() {
+  const auto& X = Input(0);
+  auto* Y = Output(0);
+  CAFFE_ENFORCE(X.IsType<uint8_t>(), "Int8Dequantize takes uint8 inputs");
+  Y->ResizeLike(X);
+  const uint8_t* Xdata = X.data<uint8_t>();
+  float* Ydata = Y->mutable_data<float>();
+#pragma omp parallel for
+  for (int i = 0; i < X.size(); ++i) {
+    Ydata[i] = int8::Dequantize(Xdata[i], X_scale_, X_zero_point_);
+  }
+  return true;
+}
+
+template <bool kMax>
+bool Int8PoolOp<kMax>::RunOnDeviceWithOrderNCHW() {
+  const auto& X = Input(0);
+  auto* Y = Output(0);
+  CAFFE_ENFORCE(X.IsType<uint8_t>(), "Int8 pooling takes uint8 inputs");
+  const int spatial = kernel_.size();
+  CAFFE_ENFORCE_EQ(X.ndim(), spatial + 2);
+  ConvPoolOpBase<CPUContext>::SetOutputSize(X, Y, X.dim32(1));
+
+  // 2D windows are 3D ones over a single frame
+  int dims[3] = {1, 1, 1};
+  int output_dims[3] = {1, 1, 1};
+  int kernel[3] = {1, 1, 1};
+  int stride[3] = {1, 1, 1};
+  int pad[3] = {0, 0, 0};
+  for (int i = 0; i < spatial; ++i) {
+    const int j = 3 - spatial + i;
+    dims[j] = X.dim32(i + 2);
+    output_dims[j] = Y->dim32(i + 2);
+    kernel[j] = kernel_[i];
+    stride[j] = stride_[i];
+    pad[j] = pads_[i];
+  }
+  const int planes = X.dim32(0) * X.dim32(1);
+  const int input_size = dims[0] * dims[1] * dims[2];
+  const int output_size = output_dims[0] * output_dims[1] * output_dims[2];
+  const uint8_t* Xdata = X.data<uint8_t>();
+  uint8_t* Ydata = Y->mutable_data<uint8_t>();
+#pragma omp parallel for
+  for (int plane = 0; plane < planes; ++plane) {
+    const uint8_t* x = Xdata + static_cast<size_t>(plane) * input_size;
+    uint8_t* y = Ydata + static_cast<size_t>(plane) * output_size;
+    for (int t = 0; t < output_dims[0]; ++t) {
+      const int t0 = std::max(t * stride[0] - pad[0], 0);
+      const int t1 = std::min(t * stride[0] - pad[0] + kernel[0], dims[0]);
+      for (int h = 0; h < output_dims[1]; ++h) {
+        const int h0 = std::max(h * stride[1] - pad[1], 0);
+        const int h1 = std::min(h * stride[1] - pad[1] + kernel[1], dims[1]);
+        for (int w = 0; w < output_dims[2]; ++w) {
+          const int w0 = std::max(w * stride[2] - pad[2], 0);
+          const int w1 =
+              std::min(w * stride[2] - pad[2] + kernel[2], dims[2]);
+          int value = 0;
+          for (int i = t0; i < t1; ++i) {
+            for (int j = h0; j < h1; ++j) {
+              const uint8_t* row = x + (i * dims[1] + j) * dims[2];
+              for (int l = w0; l < w1; ++l) {
+                value = kMax ? std::max(value, static_cast<int>(row[l]))
+                             : value + row[l];
+              }
+            }
+          }
+          if (!kMax) {
+            const int count = (t1 - t0) * (h1 - h0) * (w1 - w0);
+            value = (value + count / 2) / count;
+          }
+          y[(t * output_dims[1] + h) * output_dims[2] + w] = value;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool Int8SumReluOp::RunOnDevice() {
+  const auto& A = Input(0);
+  const auto& B = Input(1);
+  auto* Y = Output(0);
+  CAFFE_ENFORCE(
+      A.IsType<uint8_t>() && B.IsType<uint8_t>(),
+      "Int8SumRelu takes uint8 inputs");
+  CAFFE_ENFORCE(A.dims() == B.dims(), "Int8SumRelu inputs differ in shape");
+  Y->ResizeLike(A);
+  const uint8_t* Adata = A.data<uint8_t>();
+  const uint8_t* Bdata = B.data<uint8_t>();
+  uint8_t* Ydata = Y->mutable_data<uint8_t>();
+  // Y = a * A + b * B + offset in units of Y_scale
+  const float a = A_scale_ / Y_scale_;
+  const float b = B_scale_ / Y_scale_;
+  const float offset = -a * A_zero_point_ - b * B_zero_point_;
+  const int min_value = relu_ ? Y_zero_point_ : 0;
+#pragma omp parallel for
+  for (int i = 0; i < A.size(); ++i) {
+    const int q =
+        static_cast<int>(std::nearbyint(a * Adata[i] + b * Bdata[i] + offset)) +
+        Y_zero_point_;
+    Ydata[i] = int8::Saturate(std::max(q, min_value));
+  }
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(Int8Quantize, Int8QuantizeOp);
+REGISTER_CPU_OPERATOR(Int8Dequantize, Int8DequantizeOp);
+REGISTER_CPU_OPERATOR(Int8MaxPool, Int8PoolOp<true>);
+REGISTER_CPU_OPERATOR(Int8AveragePool, Int8PoolOp<false>);
+REGISTER_CPU_OPERATOR(Int8SumRelu, Int8SumReluOp);
+
+OPERATOR_SCHEMA(Int8Quantize)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .TensorInferenceFunction([](const OperatorDef& def,
+                                const vector<TensorShape>& in) {
+      vector<TensorShape> out(1, in[0]);
+      out[0].set_data_type(TensorProto::UINT8);
+      return out;
+    })
+    .SetDoc(R"DOC(
+Quantizes a float tensor to uint8, Y = clamp(round(X / Y_scale) +
+Y_zero_point, 0, 255).
+)DOC")
+    .Arg("Y_scale", "Scale of the output")
+    .Arg("Y_zero_point", "Zero point of the output")
+    .Input(0, "X", "float input")
+    .Output(0, "Y", "uint8 output");
+
+OPERATOR_SCHEMA(Int8Dequantize)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .TensorInferenceFunction([](const OperatorDef& def,
+                                const vector<TensorShape>& in) {
+      vector<TensorShape> out(1, in[0]);
+      out[0].set_data_type(TensorProto::FLOAT);
+      return out;
+    })
+    .SetDoc(R"DOC(
+Dequantizes a uint8 tensor, Y = X_scale * (X - X_zero_point).
+)DOC")
+    .Arg("X_scale", "Scale of the input")
+    .Arg("X_zero_point", "Zero point of the input")
+    .Input(0, "X", "uint8 input")
+    .Output(0, "Y", "float output");
+
+OPERATOR_SCHEMA(Int8MaxPool)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .SetDoc(R"DOC(
+MaxPool of a uint8 NCHW tensor, 2D or 3D. The output has the scale and zero
+point of the input.
+)DOC")
+    .Input(0, "X", "uint8 input")
+    .Output(0, "Y", "uint8 output");
+
+OPERATOR_SCHEMA(Int8AveragePool)
+    .NumInputs(1)
+    .NumOutputs(1)
+    .SetDoc(R"DOC(
+AveragePool of a uint8 NCHW tensor, 2D or 3D, over the windows clipped to
+the input as AveragePool. The output has the scale and zero point of the
+input.
+)DOC")
+    .Input(0, "X", "uint8 input")
+    .Output(0, "Y", "uint8 output");
+
+OPERATOR_SCHEMA(Int8SumRelu)
+    .NumInputs(2)
+    .NumOutputs(1)
+    .IdenticalTypeAndShapeOfInput(0)
+    .SetDoc(R"DOC(
+Sum of two uint8 tensors of the same shape with their own scales and zero
+points, requantized with Y_scale and Y_zero_point after a ReLU if relu is
+set: the residual sum of the quantized bottleneck blocks.
+)DOC")
+    .Arg("A_scale", "Scale of the first input")
+    .Arg("A_zero_point", "Zero point of the first input")
+    .Arg("B_scale", "Scale of the second input")
+    .Arg("B_zero_point", "Zero point of the second input")
+    .Arg("Y_scale", "Scale of the output")
+    .Arg("Y_zero_point", "Zero point of the output")
+    .Arg("relu", "Apply a ReLU before requantizing")
+    .Input(0, "A", "uint8 input")
+    .Input(1, "B", "uint8 input")
+    .Output(0, "Y", "uint8 output");
+
+SHOULD_NOT_DO_GRADIENT(Int8Quantize);
+SHOULD_NOT_DO_GRADIENT(Int8Dequantize);
+SHOULD_NOT_DO_GRADIENT(Int8MaxPool);
+SHOULD_NOT_DO_GRADIENT(Int8AveragePool);
+SHOULD_NOT_DO_GRADIENT(Int8SumRelu);
+
+} // namespace caffe2
@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/max_pool_argmax_op.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+template <>
+bool MaxPoolArgmaxOp<float, CPUContext>::RunOnDeviceWithOrderNCHW() {
+  auto& X = Input(0);
+  auto* Y = Output(0);
+  auto* argmax = Output(1);
+  auto* X_dims = OperatorBase::Output<TensorCPU>(2);
+  ConvPoolOpBase<CPUContext>::SetOutputSize(X, Y, X.dim32(1));
+  argmax->ResizeLike(*Y);
+  X_dims->Resize(X.ndim());
+  std::copy(
+      X.dims().begin(), X.dims().end(), X_dims->mutable_data<TIndex>());
+  const auto g =
+      MakeMaxPoolArgmaxGeometry(X.dims(), Y->dims(), kernel_, stride_, pads_);
+
+  const float* x = X.data<float>();
+  float* y = Y->mutable_data<float>();
+  uint8_t* a = argmax->mutable_data<uint8_t>();
+  const int in_size = g.in[0] * g.in[1] * g.in[2];
+  for (int plane = 0; plane < g.planes; ++plane) {
+    for (int ot = 0; ot < g.out[0]; ++ot) {
+      for (int oh = 0; oh < g.out[1]; ++oh) {
+        for (int ow = 0; ow < g.out[2]; ++ow) {
+          // the window in the coordinates of X, before the clipping
+          const int t0 = ot * g.stride[0] - g.pad[0];
+          const int h0 = oh * g.stride[1] - g.pad[1];
+          const int w0 = ow * g.stride[2] - g.pad[2];
+          float best = std::numeric_limits<float>::lowest();
+          int best_offset = kMaxPoolNoArgmax;
+          for (int kt = std::max(0, -t0);
+               kt < std::min(g.kernel[0], g.in[0] - t0);
+               ++kt) {
+            for (int kh = std::max(0, -h0);
+                 kh < std::min(g.kernel[1], g.in[1] - h0);
+                 ++kh) {
+              for (int kw = std::max(0, -w0);
+                   kw < std::min(g.kernel[2], g.in[2] - w0);
+                   ++kw) {
+                const float value =
+                    x[((t0 + kt) * g.in[1] + h0 + kh) * g.in[2] + w0 + kw];
+                if (best_offset == kMaxPoolNoArgmax || value > best) {
+                  best = value;
+                  best_offset = (kt * g.kernel[1] + kh) * g.kernel[2] + kw;
+                }
+              }
+            }
+          }
+          *y++ = best;
+          *a++ = best_offset;
+        }
+      }
+    }
+    x += in_size;
+  }
+  return true;
+}
+
+template <>
+bool MaxPoolArgmaxGradientOp<float, CPUContext>::RunOnDeviceWithOrderNCHW() {
+  auto& argmax = Input(0);
+  const auto& X_dims = OperatorBase::Input<TensorCPU>(1);
+  auto& dY = Input(2);
+  auto* dX = Output(0);
+  CAFFE_ENFORCE(argmax.dims() == dY.dims());
+  const vector<TIndex> x_dims(
+      X_dims.data<TIndex>(), X_dims.data<TIndex>() + X_dims.size());
+  dX->Resize(x_dims);
+  ConvPoolOpBase<CPUContext>::ComputePads(
+      vector<int>(x_dims.begin() + 2, x_dims.end()));
+  const auto g =
+      MakeMaxPoolArgmaxGeometry(x_dims, dY.dims(), kernel_, stride_, pads_);
+
+  const uint8_t* a = argmax.data<uint8_t>();
+  const float* dy = dY.data<float>();
+  float* dx = dX->mutable_data<float>();
+  math::Set<float, CPUContext>(dX->size(), 0.f, dx, &context_);
+  const int in_size = g.in[0] * g.in[1] * g.in[2];
+  for (int plane = 0; plane < g.planes; ++plane) {
+    for (int ot = 0; ot < g.out[0]; ++ot) {
+      for (int oh = 0; oh < g.out[1]; ++oh) {
+        for (int ow = 0; ow < g.out[2]; ++ow) {
+          const int offset = *a++;
+          const float grad = *dy++;
+          if (offset == kMaxPoolNoArgmax) {
+            continue;
+          }
+          const int kt = offset / (g.kernel[1] * g.kernel[2]);
+          const int kh = offset / g.kernel[2] % g.kernel[1];
+          const int kw = offset % g.kernel[2];
+          const int t = ot * g.stride[0] - g.pad[0] + kt;
+          const int h = oh * g.stride[1] - g.pad[1] + kh;
+          const int w = ow * g.stride[2] - g.pad[2] + kw;
+          dx[(t * g.in[1] + h) * g.in[2] + w] += grad;
+        }
+      }
+    }
+    dx += in_size;
+  }
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(MaxPoolArgmax, MaxPoolArgmaxOp<float, CPUContext>);
+REGISTER_CPU_OPERATOR(
+    MaxPoolArgmaxGradient,
+    MaxPoolArgmaxGradientOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(MaxPoolArgmax)
+    .NumInputs(1)
+    .NumOutputs(3)
+    .TensorInferenceFunction([](const OperatorDef& def,
+                                const vector<TensorShape>& in) {
+      vector<TensorShape> out =
+          ConvPoolOpBase<CPUContext>::TensorInferenceForPool(def, in);
+      TensorShape argmax = out[0];
+      argmax.set_data_type(TensorProto::UINT8);
+      out.push_back(argmax);
+      // the dims of X live on the host: an unknown shape keeps them out of
+      // the activation memory plans of the device
+      TensorShape x_dims;
+      x_dims.set_unknown_shape(true);
+      out.push_back(x_dims);
+      return out;
+    })
+    .SetDoc(R"DOC(
+MaxPool of NCHW tensors with 1 to 3 spatial dims and windows of up to 255
+elements, that also outputs the argmax of every output as the byte offset
+of the max in its window, and the dims of X as a CPU tensor. These are all
+that its gradient reads: unlike the MaxPoolGradient of MaxPool, which keeps
+X and Y alive until the backward pass, MaxPoolArgmaxGradient lets them be
+freed (or shared by the memory plan) after their last forward reader, for
+an argmax of 1/4 of the size of Y. Takes the arguments of MaxPool, without
+dilations. Written by the compact activation rewrite of the video models
+(MODEL.COMPACT_ACTIVATIONS).
+)DOC")
+    .Input(0, "X", "Input tensor, NCHW")
+    .Output(0, "Y", "Output tensor, the one of MaxPool")
+    .Output(1, "argmax", "uint8 offsets of the maxes in their windows")
+    .Output(2, "X_dims", "int64 CPU tensor of the dims of X");
+// Input: argmax, X_dims, dY; Output: dX
+OPERATOR_SCHEMA(MaxPoolArgmaxGradient).NumInputs(3).NumOutputs(1);
+
+class GetMaxPoolArgmaxGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    return SingleGradientDef(
+        "MaxPoolArgmaxGradient",
+        "",
+        vector<string>{O(1), O(2), GO(0)},
+        vector<string>{GI(0)});
+  }
+};
+
+REGISTER_GRADIENT(MaxPoolArgmax, GetMaxPoolArgmaxGradient);
+
+} // namespace caffe2
@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef MAX_POOL_ARGMAX_OP_H_
+#define MAX_POOL_ARGMAX_OP_H_
+
+#include <cstdint>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/operators/conv_pool_op_base.h"
+
+namespace caffe2 {
+
+// The argmax of an output is the offset of the max in its window,
+// (t * kernel_h + h) * kernel_w + w, as a byte; kMaxPoolNoArgmax marks a
+// window that lies in the padding
+constexpr int kMaxPoolNoArgmax = 255;
+constexpr int kMaxPoolArgmaxMaxWindow = kMaxPoolNoArgmax;
+
+// The 1d, 2d and 3d NCHW pools as 3d ones, with leading dims of 1
+struct MaxPoolArgmaxGeometry {
+  int planes; // N * C
+  int in[3];
+  int out[3];
+  int kernel[3];
+  int stride[3];
+  // the head pads, the tail ones only shape the output
+  int pad[3];
+};
+
+inline MaxPoolArgmaxGeometry MakeMaxPoolArgmaxGeometry(
+    const vector<TIndex>& x_dims,
+    const vector<TIndex>& y_dims,
+    const vector<int>& kernel,
+    const vector<int>& stride,
+    const vector<int>& pads) {
+  const int num_dims = x_dims.size() - 2;
+  CAFFE_ENFORCE(
+      num_dims >= 1 && num_dims <= 3,
+      "MaxPoolArgmax pools 1 to 3 spatial dims, not ",
+      num_dims);
+  CAFFE_ENFORCE_EQ(y_dims.size(), x_dims.size());
+  CAFFE_ENFORCE_EQ(kernel.size(), num_dims);
+  MaxPoolArgmaxGeometry geometry;
+  geometry.planes = x_dims[0] * x_dims[1];
+  int window = 1;
+  for (int d = 0; d < 3; ++d) {
+    const int dim = d - (3 - num_dims);
+    const bool pooled = dim >= 0;
+    geometry.in[d] = pooled ? x_dims[2 + dim] : 1;
+    geometry.out[d] = pooled ? y_dims[2 + dim] : 1;
+    geometry.kernel[d] = pooled ? kernel[dim] : 1;
+    geometry.stride[d] = pooled ? stride[dim] : 1;
+    geometry.pad[d] = pooled ? pads[dim] : 0;
+    window *= geometry.kernel[d];
+  }
+  CAFFE_ENFORCE_LE(
+      window,
+      kMaxPoolArgmaxMaxWindow,
+      "The argmax of MaxPoolArgmax is a byte, the window is too large");
+  return geometry;
+}
+
+// MaxPool that also outputs the argmax of every output in its window and
+// the dims of X, which are all that the gradient needs: X and Y can then be
+// freed once their forward readers ran
+template <typename T, class Context>
+class MaxPoolArgmaxOp final : public ConvPoolOpBase<Context> {
+ public:
+  USE_CONV_POOL_BASE_FUNCTIONS(Context);
+  MaxPoolArgmaxOp(const OperatorDef& operator_def, Workspace* ws)
+      : ConvPoolOpBase<Context>(operator_def, ws) {
+    CAFFE_ENFORCE(
+        order_ == StorageOrder::NCHW, "MaxPoolArgmax only supports NCHW");
+    for (const int dilation : dilation_) {
+      CAFFE_ENFORCE_EQ(dilation, 1, "MaxPoolArgmax does not dilate");
+    }
+  }
+
+  bool RunOnDeviceWithOrderNCHW() override;
+
+  // Input: X; Output: Y, argmax, X_dims (a CPU tensor)
+};
+
+// dX from the argmax, the dims of X and dY
+template <typename T, class Context>
+class MaxPoolArgmaxGradientOp final : public ConvPoolOpBase<Context> {
+ public:
+  USE_CONV_POOL_BASE_FUNCTIONS(Context);
+  MaxPoolArgmaxGradientOp(const OperatorDef& operator_def, Workspace* ws)
+      : ConvPoolOpBase<Context>(operator_def, ws) {
+    CAFFE_ENFORCE(
+        order_ == StorageOrder::NCHW, "MaxPoolArgmax only supports NCHW");
+  }
+
+  bool RunOnDeviceWithOrderNCHW() override;
+
+  // Input: argmax, X_dims, dY; Output: dX
+};
+
+} // namespace caffe2
+
+#endif // MAX_POOL_ARGMAX_OP_H_
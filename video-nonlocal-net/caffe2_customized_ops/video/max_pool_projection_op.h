@@ -0,0 +1,264 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef MAX_POOL_PROJECTION_OP_H_
+#define MAX_POOL_PROJECTION_OP_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// The k x k spatial max pooling (stride k, no pads) of the C x T x H x W
+// planes of a clip: pooled is C x (T * Ho * Wo), argmax the position of the
+// max in its window, (h % k) * k + w % k.
+template <class Context>
+void MaxPoolWindows(
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const int k,
+    const float* X,
+    float* pooled,
+    uint8_t* argmax,
+    Context* context);
+
+// pooled again, from X and argmax
+template <class Context>
+void GatherPooled(
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const int k,
+    const float* X,
+    const uint8_t* argmax,
+    float* pooled,
+    Context* context);
+
+// dX of a clip: dpooled at the argmax of every window, 0 elsewhere
+template <class Context>
+void ScatterPooledGradient(
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const int k,
+    const uint8_t* argmax,
+    const float* dpooled,
+    float* dX,
+    Context* context);
+
+// The max pooling of X (N x C x T x H x W) over [1, kernel, kernel] windows
+// with stride kernel, and the 1 x 1 x 1 projections (convs) of the pooled X,
+// e.g. phi and g of a non-local block, in one op:
+//   Y_i = W_i * maxpool(X) + b_i.
+// Inputs: X, then W_i (Cout_i x C x 1 x 1 x 1) and b_i (without no_bias) of
+// every projection. Outputs: the Y_i, then the argmax of every window as
+// uint8. The pooled X only lives in a one clip workspace, and the gradient
+// takes the pooled values from X at the argmax, so the op keeps a quarter of
+// the pooled X (for kernel 2) in bytes instead of the pooled X itself, and
+// routes the gradient to X without comparing the windows again.
+template <typename T, class Context>
+class MaxPoolProjectionOp final : public Operator<Context> {
+ public:
+  MaxPoolProjectionOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        kernel_(OperatorBase::GetSingleArgument<int>("kernel", 2)),
+        no_bias_(OperatorBase::GetSingleArgument<int>("no_bias", 0)) {
+    CAFFE_ENFORCE(
+        kernel_ >= 1 && kernel_ * kernel_ <= 256,
+        "the argmax of a window needs to fit a byte");
+    CAFFE_ENFORCE(
+        InputSize() > 1 && (InputSize() - 1) % (no_bias_ ? 1 : 2) == 0,
+        "MaxPoolProjection needs X and the W_i (and b_i) of a projection");
+    CAFFE_ENFORCE_EQ(OutputSize(), NumProjections() + 1);
+  }
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+
+  int NumProjections() const {
+    return (InputSize() - 1) / (no_bias_ ? 1 : 2);
+  }
+
+  bool RunOnDevice() override {
+    const auto& X = Input(0);
+    CAFFE_ENFORCE_EQ(X.ndim(), 5, "MaxPoolProjection needs N x C x T x H x W");
+    const int N = X.dim32(0);
+    const int C = X.dim32(1);
+    const int Tdim = X.dim32(2);
+    const int H = X.dim32(3);
+    const int W = X.dim32(4);
+    const int Ho = H / kernel_;
+    const int Wo = W / kernel_;
+    CAFFE_ENFORCE(Ho > 0 && Wo > 0, "the input is smaller than a window");
+    const int L = Tdim * Ho * Wo;
+    const int step = no_bias_ ? 1 : 2;
+
+    auto* argmax = Output(NumProjections());
+    argmax->Resize(std::vector<TIndex>{N, C, Tdim, Ho, Wo});
+    uint8_t* argmax_data = argmax->template mutable_data<uint8_t>();
+    pooled_.Resize(C, L);
+    float* pooled = pooled_.template mutable_data<float>();
+    if (!no_bias_) {
+      ones_.Resize(L);
+      math::Set<float, Context>(
+          L, 1.f, ones_.template mutable_data<float>(), &context_);
+    }
+    for (int i = 0; i < NumProjections(); ++i) {
+      const auto& Wi = Input(1 + i * step);
+      CAFFE_ENFORCE_EQ(Wi.size_from_dim(1), C, "W_i needs C inputs");
+      Output(i)->Resize(std::vector<TIndex>{N, Wi.dim32(0), Tdim, Ho, Wo});
+    }
+    for (int n = 0; n < N; ++n) {
+      const float* Xn = X.template data<float>() + n * C * Tdim * H * W;
+      MaxPoolWindows<Context>(
+          C, Tdim, H, W, kernel_, Xn, pooled, argmax_data + n * C * L,
+          &context_);
+      for (int i = 0; i < NumProjections(); ++i) {
+        const auto& Wi = Input(1 + i * step);
+        const int Cout = Wi.dim32(0);
+        float* Yn = Output(i)->template mutable_data<float>() + n * Cout * L;
+        math::Gemm<float, Context>(
+            CblasNoTrans, CblasNoTrans, Cout, L, C, 1.f,
+            Wi.template data<float>(), pooled, 0.f, Yn, &context_);
+        if (!no_bias_) {
+          const auto& bi = Input(2 + i * step);
+          CAFFE_ENFORCE_EQ(bi.size(), Cout);
+          math::Gemm<float, Context>(
+              CblasNoTrans, CblasNoTrans, Cout, L, 1, 1.f,
+              bi.template data<float>(), ones_.template data<float>(), 1.f,
+              Yn, &context_);
+        }
+      }
+    }
+    return true;
+  }
+
+ protected:
+  int kernel_;
+  int no_bias_;
+  // the pooled X of one clip, C x L
+  Tensor<Context> pooled_;
+  Tensor<Context> ones_;
+};
+
+// Inputs: X, argmax, W_i of every projection, dY_i of every projection.
+// Outputs: dX, then dW_i and db_i (without no_bias) of every projection.
+template <typename T, class Context>
+class MaxPoolProjectionGradientOp final : public Operator<Context> {
+ public:
+  MaxPoolProjectionGradientOp(const OperatorDef& def, Workspace* ws)
+      : Operator<Context>(def, ws),
+        kernel_(OperatorBase::GetSingleArgument<int>("kernel", 2)),
+        no_bias_(OperatorBase::GetSingleArgument<int>("no_bias", 0)) {
+    CAFFE_ENFORCE_EQ(InputSize() % 2, 0);
+    CAFFE_ENFORCE_EQ(
+        OutputSize(), 1 + NumProjections() * (no_bias_ ? 1 : 2));
+  }
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+
+  int NumProjections() const {
+    return (InputSize() - 2) / 2;
+  }
+
+  bool RunOnDevice() override {
+    const auto& X = Input(0);
+    const auto& argmax = Input(1);
+    const int N = X.dim32(0);
+    const int C = X.dim32(1);
+    const int Tdim = X.dim32(2);
+    const int H = X.dim32(3);
+    const int W = X.dim32(4);
+    const int L = argmax.size_from_dim(2);
+    const int P = NumProjections();
+    const int step = no_bias_ ? 1 : 2;
+
+    auto* dX = Output(0);
+    dX->ResizeLike(X);
+    pooled_.Resize(C, L);
+    dpooled_.Resize(C, L);
+    float* pooled = pooled_.template mutable_data<float>();
+    float* dpooled = dpooled_.template mutable_data<float>();
+    if (!no_bias_) {
+      ones_.Resize(L);
+      math::Set<float, Context>(
+          L, 1.f, ones_.template mutable_data<float>(), &context_);
+    }
+    for (int i = 0; i < P; ++i) {
+      Output(1 + i * step)->ResizeLike(Input(2 + i));
+      if (!no_bias_) {
+        Output(2 + i * step)->Resize(Input(2 + i).dim32(0));
+      }
+    }
+    for (int n = 0; n < N; ++n) {
+      const float* Xn = X.template data<float>() + n * C * Tdim * H * W;
+      const uint8_t* argmax_n = argmax.template data<uint8_t>() + n * C * L;
+      GatherPooled<Context>(
+          C, Tdim, H, W, kernel_, Xn, argmax_n, pooled, &context_);
+      const float beta = n > 0 ? 1.f : 0.f;
+      for (int i = 0; i < P; ++i) {
+        const auto& Wi = Input(2 + i);
+        const int Cout = Wi.dim32(0);
+        const float* dYn =
+            Input(2 + P + i).template data<float>() + n * Cout * L;
+        CAFFE_ENFORCE_EQ(Input(2 + P + i).size(), N * Cout * L);
+        math::Gemm<float, Context>(
+            CblasNoTrans, CblasTrans, Cout, C, L, 1.f, dYn, pooled, beta,
+            Output(1 + i * step)->template mutable_data<float>(), &context_);
+        if (!no_bias_) {
+          math::Gemv<float, Context>(
+              CblasNoTrans, Cout, L, 1.f, dYn, ones_.template data<float>(),
+              beta, Output(2 + i * step)->template mutable_data<float>(),
+              &context_);
+        }
+        math::Gemm<float, Context>(
+            CblasTrans, CblasNoTrans, C, L, Cout, 1.f,
+            Wi.template data<float>(), dYn, i > 0 ? 1.f : 0.f, dpooled,
+            &context_);
+      }
+      ScatterPooledGradient<Context>(
+          C, Tdim, H, W, kernel_, argmax_n, dpooled,
+          dX->template mutable_data<float>() + n * C * Tdim * H * W,
+          &context_);
+    }
+    return true;
+  }
+
+ protected:
+  int kernel_;
+  int no_bias_;
+  Tensor<Context> pooled_;
+  Tensor<Context> dpooled_;
+  Tensor<Context> ones_;
+};
+
+} // namespace caffe2
+
+#endif // MAX_POOL_PROJECTION_OP_H_
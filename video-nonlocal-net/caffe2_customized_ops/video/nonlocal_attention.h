@@ -0,0 +1,122 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_NONLOCAL_ATTENTION_H_
+#define CAFFE2_VIDEO_NONLOCAL_ATTENTION_H_
+
+namespace caffe2 {
+
+// Y[n] = g[n] * softmax(scale * theta[n]^T * phi[n])^T for every n, with
+//   theta: N x C x Lq, phi: N x C x Lk, g: N x Cg x Lk, Y: N x Cg x Lq.
+// The affinity is formed for query_block positions at a time, never as a
+// whole. lse (N x Lq) gets the log-sum-exp of every affinity row, which the
+// gradient needs to recompute the softmax block by block.
+void NonLocalAttentionCPU(
+    const int N,
+    const int C,
+    const int Cg,
+    const int Lq,
+    const int Lk,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    float* Y,
+    float* lse,
+    const int query_block = 64);
+
+// gradients of NonLocalAttentionCPU with respect to theta, phi and g
+void NonLocalAttentionGradientCPU(
+    const int N,
+    const int C,
+    const int Cg,
+    const int Lq,
+    const int Lk,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    const float* Y,
+    const float* lse,
+    const float* dY,
+    float* dtheta,
+    float* dphi,
+    float* dg,
+    const int query_block = 64);
+
+// The keys of the windowed non-local op: the query at (t, h, w) of a T x H x W
+// grid attends to the keys of a Tk x Hk x Wk grid (phi and g may be pooled)
+// at (t * Tk / T + (a - window[0] / 2) * dilation[0], ...) for
+// 0 <= a < window[0], and so on for h and w. The keys that fall outside the
+// grid are left out of the softmax.
+struct LocalWindow {
+  int T, H, W;
+  int Tk, Hk, Wk;
+  int window[3];
+  int dilation[3];
+
+  int size() const {
+    return window[0] * window[1] * window[2];
+  }
+};
+
+// The positions of the keys of the query at (t, h, w), in keys; returns
+// their count.
+int LocalWindowKeys(const LocalWindow& win, int t, int h, int w, int* keys);
+
+// Y[n][:, q] = g[n][:, keys] * softmax(scale * theta[n][:, q]^T *
+// phi[n][:, keys])^T for the window keys of every query q, with
+//   theta: N x C x THW, phi: N x C x TkHkWk, g: N x Cg x TkHkWk,
+//   Y: N x Cg x THW, lse: N x THW (log-sum-exp of the window affinities).
+void LocalNonLocalCPU(
+    const int N,
+    const int C,
+    const int Cg,
+    const LocalWindow& win,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    float* Y,
+    float* lse);
+
+// gradients of LocalNonLocalCPU with respect to theta, phi and g
+void LocalNonLocalGradientCPU(
+    const int N,
+    const int C,
+    const int Cg,
+    const LocalWindow& win,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    const float* lse,
+    const float* dY,
+    float* dtheta,
+    float* dphi,
+    float* dg);
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_NONLOCAL_ATTENTION_H_
@@ -0,0 +1,121 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/nonlocal_attention_op.h"
+#include "caffe2/video/nonlocal_attention.h"
+
+namespace caffe2 {
+
+template <>
+bool NonLocalAttentionOp<float, CPUContext>::RunOnDevice() {
+  auto& theta = Input(0);
+  auto& phi = Input(1);
+  auto& g = Input(2);
+  auto* Y = Output(0);
+  auto* lse = Output(1);
+
+  int N, C, Cg, Lq, Lk;
+  NonLocalAttentionDims(theta, phi, g, &N, &C, &Cg, &Lq, &Lk);
+  auto dims = theta.dims();
+  dims[1] = Cg;
+  Y->Resize(dims);
+  lse->Resize(N, Lq);
+  NonLocalAttentionCPU(
+      N, C, Cg, Lq, Lk, scale_,
+      theta.data<float>(), phi.data<float>(), g.data<float>(),
+      Y->mutable_data<float>(), lse->mutable_data<float>(),
+      affinity_tile_ > 0 ? affinity_tile_ : 64);
+  return true;
+}
+
+template <>
+bool NonLocalAttentionGradientOp<float, CPUContext>::RunOnDevice() {
+  auto& theta = Input(0);
+  auto& phi = Input(1);
+  auto& g = Input(2);
+  auto& Y = Input(3);
+  auto& lse = Input(4);
+  auto& dY = Input(5);
+  auto* dtheta = Output(0);
+  auto* dphi = Output(1);
+  auto* dg = Output(2);
+
+  int N, C, Cg, Lq, Lk;
+  NonLocalAttentionDims(theta, phi, g, &N, &C, &Cg, &Lq, &Lk);
+  CAFFE_ENFORCE_EQ(dY.size(), N * Cg * Lq);
+  dtheta->ResizeLike(theta);
+  dphi->ResizeLike(phi);
+  dg->ResizeLike(g);
+  NonLocalAttentionGradientCPU(
+      N, C, Cg, Lq, Lk, scale_,
+      theta.data<float>(), phi.data<float>(), g.data<float>(),
+      Y.data<float>(), lse.data<float>(), dY.data<float>(),
+      dtheta->mutable_data<float>(), dphi->mutable_data<float>(),
+      dg->mutable_data<float>(), affinity_tile_ > 0 ? affinity_tile_ : 64);
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(NonLocalAttention,
+                      NonLocalAttentionOp<float, CPUContext>);
+REGISTER_CPU_OPERATOR(NonLocalAttentionGradient,
+                      NonLocalAttentionGradientOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(NonLocalAttention)
+    .NumInputs(3)
+    .NumOutputs(2)
+    .SetDoc(R"DOC(
+Computes the aggregation of a non-local block in one op,
+Y = g * softmax(scale * theta^T * phi, axis=keys)^T, where the positions of
+theta (queries) and of phi and g (keys) are flattened from dim 2 on. The
+affinity matrix is computed a block of queries at a time with an online
+softmax and is never stored, so memory does not grow with queries x keys.
+)DOC")
+    .Arg("scale", "(float) scale of the affinity before the softmax")
+    .Arg("affinity_tile",
+         "(int) if > 0, queries per affinity tile formed with GEMMs, which "
+         "bounds the workspace to affinity_tile x key positions; 0 uses the "
+         "fused kernel on GPU")
+    .Input(0, "theta", "N x C x (query positions)")
+    .Input(1, "phi", "N x C x (key positions)")
+    .Input(2, "g", "N x Cg x (key positions)")
+    .Output(0, "Y", "shape of theta with Cg channels")
+    .Output(1, "lse", "N x (query positions) log-sum-exp of the affinity rows");
+// Input: theta, phi, g, Y, lse, dY; Output: dtheta, dphi, dg
+OPERATOR_SCHEMA(NonLocalAttentionGradient)
+    .NumInputs(6)
+    .NumOutputs(3);
+
+class GetNonLocalAttentionGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    return SingleGradientDef(
+        "NonLocalAttentionGradient", "",
+        vector<string>{I(0), I(1), I(2), O(0), O(1), GO(0)},
+        vector<string>{GI(0), GI(1), GI(2)});
+  }
+};
+
+REGISTER_GRADIENT(NonLocalAttention, GetNonLocalAttentionGradient);
+
+} // namespace caffe2
@@ -0,0 +1,758 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <cfloat>
+#include <cub/block/block_reduce.cuh>
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/video/nonlocal_attention_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// A block of kThreads threads (kWarps warps) owns kRows rows of the affinity
+// (query rows in the forward, key columns in the gradient of phi and g) and
+// walks the other side kCols positions at a time. In every step each warp
+// forms partial dot products with one lane per position, warp r reduces and
+// normalizes row r, then every thread folds the step into the accumulators of
+// its channels c = threadIdx.x + k * kThreads.
+constexpr int kRows = 4;
+constexpr int kCols = 32;
+constexpr int kWarps = kRows;
+constexpr int kThreads = kWarps * kCols;
+constexpr int kChannelsPerThread = 8;
+constexpr int kMaxChannels = kThreads * kChannelsPerThread;
+// queries per GEMM tile when the channels do not fit the fused kernels
+constexpr int kDefaultTile = 1024;
+
+__global__ void NonLocalAttentionKernel(
+    const int C,
+    const int Cg,
+    const int Lq,
+    const int Lk,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    float* Y,
+    float* lse) {
+  // the theta rows of the block's queries
+  extern __shared__ float q_sh[];
+  __shared__ float partial[kWarps][kRows][kCols];
+  __shared__ float p_sh[kRows][kCols];
+  __shared__ float m_sh[kRows];
+  __shared__ float l_sh[kRows];
+  __shared__ float alpha_sh[kRows];
+
+  const int n = blockIdx.y;
+  const int i0 = blockIdx.x * kRows;
+  const int lane = threadIdx.x % kCols;
+  const int warp = threadIdx.x / kCols;
+  theta += n * C * Lq;
+  phi += n * C * Lk;
+  g += n * Cg * Lk;
+  Y += n * Cg * Lq;
+
+  for (int k = threadIdx.x; k < kRows * C; k += kThreads) {
+    const int r = k / C;
+    q_sh[k] = i0 + r < Lq ? theta[(k % C) * Lq + i0 + r] : 0.f;
+  }
+  if (threadIdx.x < kRows) {
+    m_sh[threadIdx.x] = -FLT_MAX;
+    l_sh[threadIdx.x] = 0.f;
+  }
+  float acc[kRows][kChannelsPerThread];
+#pragma unroll
+  for (int r = 0; r < kRows; ++r) {
+#pragma unroll
+    for (int k = 0; k < kChannelsPerThread; ++k) {
+      acc[r][k] = 0.f;
+    }
+  }
+  __syncthreads();
+
+  for (int j0 = 0; j0 < Lk; j0 += kCols) {
+    const int j = j0 + lane;
+    float part[kRows] = {0.f};
+    if (j < Lk) {
+      for (int c = warp; c < C; c += kWarps) {
+        const float k_val = phi[c * Lk + j];
+#pragma unroll
+        for (int r = 0; r < kRows; ++r) {
+          part[r] += q_sh[r * C + c] * k_val;
+        }
+      }
+    }
+#pragma unroll
+    for (int r = 0; r < kRows; ++r) {
+      partial[warp][r][lane] = part[r];
+    }
+    __syncthreads();
+
+    // warp r owns query row r
+    float s = -FLT_MAX;
+    if (j < Lk) {
+      s = 0.f;
+#pragma unroll
+      for (int w = 0; w < kWarps; ++w) {
+        s += partial[w][warp][lane];
+      }
+      s *= scale;
+    }
+    p_sh[warp][lane] = s;
+    __syncthreads();
+    if (lane == 0) {
+      float m = m_sh[warp];
+      for (int jj = 0; jj < kCols; ++jj) {
+        m = fmaxf(m, p_sh[warp][jj]);
+      }
+      alpha_sh[warp] = expf(m_sh[warp] - m);
+      m_sh[warp] = m;
+    }
+    __syncthreads();
+    // positions past Lk come out as 0
+    p_sh[warp][lane] = expf(p_sh[warp][lane] - m_sh[warp]);
+    __syncthreads();
+    if (lane == 0) {
+      float l = 0.f;
+      for (int jj = 0; jj < kCols; ++jj) {
+        l += p_sh[warp][jj];
+      }
+      l_sh[warp] = l_sh[warp] * alpha_sh[warp] + l;
+    }
+
+    const int cols = min(kCols, Lk - j0);
+#pragma unroll
+    for (int k = 0; k < kChannelsPerThread; ++k) {
+      const int c = threadIdx.x + k * kThreads;
+      if (c < Cg) {
+        const float* g_row = g + c * Lk + j0;
+        float v[kRows];
+#pragma unroll
+        for (int r = 0; r < kRows; ++r) {
+          v[r] = acc[r][k] * alpha_sh[r];
+        }
+        for (int jj = 0; jj < cols; ++jj) {
+          const float g_val = g_row[jj];
+#pragma unroll
+          for (int r = 0; r < kRows; ++r) {
+            v[r] += p_sh[r][jj] * g_val;
+          }
+        }
+#pragma unroll
+        for (int r = 0; r < kRows; ++r) {
+          acc[r][k] = v[r];
+        }
+      }
+    }
+    __syncthreads();
+  }
+
+#pragma unroll
+  for (int k = 0; k < kChannelsPerThread; ++k) {
+    const int c = threadIdx.x + k * kThreads;
+    if (c < Cg) {
+#pragma unroll
+      for (int r = 0; r < kRows; ++r) {
+        if (i0 + r < Lq) {
+          Y[c * Lq + i0 + r] = acc[r][k] / l_sh[r];
+        }
+      }
+    }
+  }
+  if (threadIdx.x < kRows && i0 + threadIdx.x < Lq) {
+    lse[n * Lq + i0 + threadIdx.x] =
+        m_sh[threadIdx.x] + logf(l_sh[threadIdx.x]);
+  }
+}
+
+__global__ void DyDotYKernel(
+    const int n_rows,
+    const int Cg,
+    const int Lq,
+    const float* dY,
+    const float* Y,
+    float* out) {
+  CUDA_1D_KERNEL_LOOP(index, n_rows) {
+    const int n = index / Lq;
+    const int i = index % Lq;
+    float sum = 0.f;
+    for (int c = 0; c < Cg; ++c) {
+      const int offset = (n * Cg + c) * Lq + i;
+      sum += dY[offset] * Y[offset];
+    }
+    out[index] = sum;
+  }
+}
+
+// dtheta, with the block over query rows as in the forward:
+// dS = P .* (dY g^T - rowsum(dY .* Y)), dtheta = scale * phi * dS^T
+__global__ void NonLocalAttentionThetaGradientKernel(
+    const int C,
+    const int Cg,
+    const int Lq,
+    const int Lk,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    const float* lse,
+    const float* dy_dot_y,
+    const float* dY,
+    float* dtheta) {
+  // the theta and the dY rows of the block's queries
+  extern __shared__ float rows_sh[];
+  float* q_sh = rows_sh;
+  float* do_sh = rows_sh + kRows * C;
+  __shared__ float partial_s[kWarps][kRows][kCols];
+  __shared__ float partial_dp[kWarps][kRows][kCols];
+  __shared__ float ds_sh[kRows][kCols];
+
+  const int n = blockIdx.y;
+  const int i0 = blockIdx.x * kRows;
+  const int lane = threadIdx.x % kCols;
+  const int warp = threadIdx.x / kCols;
+  theta += n * C * Lq;
+  phi += n * C * Lk;
+  g += n * Cg * Lk;
+  dY += n * Cg * Lq;
+  dtheta += n * C * Lq;
+
+  for (int k = threadIdx.x; k < kRows * C; k += kThreads) {
+    const int r = k / C;
+    q_sh[k] = i0 + r < Lq ? theta[(k % C) * Lq + i0 + r] : 0.f;
+  }
+  for (int k = threadIdx.x; k < kRows * Cg; k += kThreads) {
+    const int r = k / Cg;
+    do_sh[k] = i0 + r < Lq ? dY[(k % Cg) * Lq + i0 + r] : 0.f;
+  }
+  const int i = i0 + warp;
+  const float row_lse = i < Lq ? lse[n * Lq + i] : 0.f;
+  const float row_d = i < Lq ? dy_dot_y[n * Lq + i] : 0.f;
+  float acc[kRows][kChannelsPerThread];
+#pragma unroll
+  for (int r = 0; r < kRows; ++r) {
+#pragma unroll
+    for (int k = 0; k < kChannelsPerThread; ++k) {
+      acc[r][k] = 0.f;
+    }
+  }
+  __syncthreads();
+
+  for (int j0 = 0; j0 < Lk; j0 += kCols) {
+    const int j = j0 + lane;
+    float part_s[kRows] = {0.f};
+    float part_dp[kRows] = {0.f};
+    if (j < Lk) {
+      for (int c = warp; c < C; c += kWarps) {
+        const float k_val = phi[c * Lk + j];
+#pragma unroll
+        for (int r = 0; r < kRows; ++r) {
+          part_s[r] += q_sh[r * C + c] * k_val;
+        }
+      }
+      for (int c = warp; c < Cg; c += kWarps) {
+        const float v_val = g[c * Lk + j];
+#pragma unroll
+        for (int r = 0; r < kRows; ++r) {
+          part_dp[r] += do_sh[r * Cg + c] * v_val;
+        }
+      }
+    }
+#pragma unroll
+    for (int r = 0; r < kRows; ++r) {
+      partial_s[warp][r][lane] = part_s[r];
+      partial_dp[warp][r][lane] = part_dp[r];
+    }
+    __syncthreads();
+
+    float ds = 0.f;
+    if (j < Lk && i < Lq) {
+      float s = 0.f;
+      float dp = 0.f;
+#pragma unroll
+      for (int w = 0; w < kWarps; ++w) {
+        s += partial_s[w][warp][lane];
+        dp += partial_dp[w][warp][lane];
+      }
+      ds = expf(scale * s - row_lse) * (dp - row_d);
+    }
+    ds_sh[warp][lane] = ds;
+    __syncthreads();
+
+    const int cols = min(kCols, Lk - j0);
+#pragma unroll
+    for (int k = 0; k < kChannelsPerThread; ++k) {
+      const int c = threadIdx.x + k * kThreads;
+      if (c < C) {
+        const float* phi_row = phi + c * Lk + j0;
+        for (int jj = 0; jj < cols; ++jj) {
+          const float k_val = phi_row[jj];
+#pragma unroll
+          for (int r = 0; r < kRows; ++r) {
+            acc[r][k] += ds_sh[r][jj] * k_val;
+          }
+        }
+      }
+    }
+    __syncthreads();
+  }
+
+#pragma unroll
+  for (int k = 0; k < kChannelsPerThread; ++k) {
+    const int c = threadIdx.x + k * kThreads;
+    if (c < C) {
+#pragma unroll
+      for (int r = 0; r < kRows; ++r) {
+        if (i0 + r < Lq) {
+          dtheta[c * Lq + i0 + r] = scale * acc[r][k];
+        }
+      }
+    }
+  }
+}
+
+// dphi and dg, with the block over key columns and the queries walked:
+// dg = dY * P, dphi = scale * theta * dS
+__global__ void NonLocalAttentionKeyGradientKernel(
+    const int C,
+    const int Cg,
+    const int Lq,
+    const int Lk,
+    const float scale,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    const float* lse,
+    const float* dy_dot_y,
+    const float* dY,
+    float* dphi,
+    float* dg) {
+  // the phi and the g rows of the block's keys
+  extern __shared__ float rows_sh[];
+  float* k_sh = rows_sh;
+  float* v_sh = rows_sh + kRows * C;
+  __shared__ float partial_s[kWarps][kRows][kCols];
+  __shared__ float partial_dp[kWarps][kRows][kCols];
+  __shared__ float p_sh[kRows][kCols];
+  __shared__ float ds_sh[kRows][kCols];
+
+  const int n = blockIdx.y;
+  const int j0 = blockIdx.x * kRows;
+  const int lane = threadIdx.x % kCols;
+  const int warp = threadIdx.x / kCols;
+  theta += n * C * Lq;
+  phi += n * C * Lk;
+  g += n * Cg * Lk;
+  lse += n * Lq;
+  dy_dot_y += n * Lq;
+  dY += n * Cg * Lq;
+  dphi += n * C * Lk;
+  dg += n * Cg * Lk;
+
+  for (int k = threadIdx.x; k < kRows * C; k += kThreads) {
+    const int r = k / C;
+    k_sh[k] = j0 + r < Lk ? phi[(k % C) * Lk + j0 + r] : 0.f;
+  }
+  for (int k = threadIdx.x; k < kRows * Cg; k += kThreads) {
+    const int r = k / Cg;
+    v_sh[k] = j0 + r < Lk ? g[(k % Cg) * Lk + j0 + r] : 0.f;
+  }
+  float acc_k[kRows][kChannelsPerThread];
+  float acc_v[kRows][kChannelsPerThread];
+#pragma unroll
+  for (int r = 0; r < kRows; ++r) {
+#pragma unroll
+    for (int k = 0; k < kChannelsPerThread; ++k) {
+      acc_k[r][k] = 0.f;
+      acc_v[r][k] = 0.f;
+    }
+  }
+  __syncthreads();
+
+  for (int i0 = 0; i0 < Lq; i0 += kCols) {
+    const int i = i0 + lane;
+    float part_s[kRows] = {0.f};
+    float part_dp[kRows] = {0.f};
+    if (i < Lq) {
+      for (int c = warp; c < C; c += kWarps) {
+        const float q_val = theta[c * Lq + i];
+#pragma unroll
+        for (int r = 0; r < kRows; ++r) {
+          part_s[r] += k_sh[r * C + c] * q_val;
+        }
+      }
+      for (int c = warp; c < Cg; c += kWarps) {
+        const float do_val = dY[c * Lq + i];
+#pragma unroll
+        for (int r = 0; r < kRows; ++r) {
+          part_dp[r] += v_sh[r * Cg + c] * do_val;
+        }
+      }
+    }
+#pragma unroll
+    for (int r = 0; r < kRows; ++r) {
+      partial_s[warp][r][lane] = part_s[r];
+      partial_dp[warp][r][lane] = part_dp[r];
+    }
+    __syncthreads();
+
+    // warp r owns key column r
+    float p = 0.f;
+    float ds = 0.f;
+    if (i < Lq && j0 + warp < Lk) {
+      float s = 0.f;
+      float dp = 0.f;
+#pragma unroll
+      for (int w = 0; w < kWarps; ++w) {
+        s += partial_s[w][warp][lane];
+        dp += partial_dp[w][warp][lane];
+      }
+      p = expf(scale * s - lse[i]);
+      ds = p * (dp - dy_dot_y[i]);
+    }
+    p_sh[warp][lane] = p;
+    ds_sh[warp][lane] = ds;
+    __syncthreads();
+
+    const int cols = min(kCols, Lq - i0);
+#pragma unroll
+    for (int k = 0; k < kChannelsPerThread; ++k) {
+      const int c = threadIdx.x + k * kThreads;
+      if (c < Cg) {
+        const float* do_row = dY + c * Lq + i0;
+        for (int ii = 0; ii < cols; ++ii) {
+          const float do_val = do_row[ii];
+#pragma unroll
+          for (int r = 0; r < kRows; ++r) {
+            acc_v[r][k] += p_sh[r][ii] * do_val;
+          }
+        }
+      }
+      if (c < C) {
+        const float* q_row = theta + c * Lq + i0;
+        for (int ii = 0; ii < cols; ++ii) {
+          const float q_val = q_row[ii];
+#pragma unroll
+          for (int r = 0; r < kRows; ++r) {
+            acc_k[r][k] += ds_sh[r][ii] * q_val;
+          }
+        }
+      }
+    }
+    __syncthreads();
+  }
+
+#pragma unroll
+  for (int k = 0; k < kChannelsPerThread; ++k) {
+    const int c = threadIdx.x + k * kThreads;
+#pragma unroll
+    for (int r = 0; r < kRows; ++r) {
+      if (j0 + r < Lk) {
+        if (c < Cg) {
+          dg[c * Lk + j0 + r] = acc_v[r][k];
+        }
+        if (c < C) {
+          dphi[c * Lk + j0 + r] = scale * acc_k[r][k];
+        }
+      }
+    }
+  }
+}
+
+// softmax of the rows of an affinity tile in place, one block per row
+__global__ void AffinityRowSoftmaxKernel(
+    const int rows,
+    const int Lk,
+    float* S,
+    float* lse) {
+  typedef cub::BlockReduce<float, CAFFE_CUDA_NUM_THREADS> BlockReduce;
+  __shared__ typename BlockReduce::TempStorage temp_storage;
+  __shared__ float row_max;
+  __shared__ float row_sum;
+
+  for (int r = blockIdx.x; r < rows; r += gridDim.x) {
+    float* row = S + r * Lk;
+    float m = -FLT_MAX;
+    for (int j = threadIdx.x; j < Lk; j += blockDim.x) {
+      m = fmaxf(m, row[j]);
+    }
+    m = BlockReduce(temp_storage).Reduce(m, cub::Max());
+    if (threadIdx.x == 0) {
+      row_max = m;
+    }
+    __syncthreads();
+    float l = 0.f;
+    for (int j = threadIdx.x; j < Lk; j += blockDim.x) {
+      const float e = expf(row[j] - row_max);
+      row[j] = e;
+      l += e;
+    }
+    l = BlockReduce(temp_storage).Sum(l);
+    if (threadIdx.x == 0) {
+      row_sum = l;
+      lse[r] = row_max + logf(l);
+    }
+    __syncthreads();
+    const float inv_sum = 1.f / row_sum;
+    for (int j = threadIdx.x; j < Lk; j += blockDim.x) {
+      row[j] *= inv_sum;
+    }
+    __syncthreads();
+  }
+}
+
+// P = exp(S - lse) of a recomputed tile in place
+__global__ void AffinityRecomputeKernel(
+    const int n,
+    const int Lk,
+    const float* lse,
+    float* S) {
+  CUDA_1D_KERNEL_LOOP(index, n) {
+    S[index] = expf(S[index] - lse[index / Lk]);
+  }
+}
+
+// dS = P .* (dP - rowsum(dY .* Y)) in place of dP
+__global__ void AffinityGradientKernel(
+    const int n,
+    const int Lk,
+    const float* P,
+    const float* dy_dot_y,
+    float* dS) {
+  CUDA_1D_KERNEL_LOOP(index, n) {
+    dS[index] = P[index] * (dS[index] - dy_dot_y[index / Lk]);
+  }
+}
+
+// Every n x C x L blob is a row-major C x L matrix per n, so the columns of
+// a tile of queries [i0, i0 + rows) are addressed with leading dim Lq.
+void NonLocalAttentionTiles(
+    const int N,
+    const int C,
+    const int Cg,
+    const int Lq,
+    const int Lk,
+    const float scale,
+    const int tile,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    float* Y,
+    float* lse,
+    Tensor<CUDAContext>* affinity,
+    CUDAContext* context) {
+  affinity->Resize(std::min(tile, Lq), Lk);
+  float* S = affinity->mutable_data<float>();
+  for (int n = 0; n < N; ++n) {
+    const float* theta_n = theta + n * C * Lq;
+    const float* phi_n = phi + n * C * Lk;
+    const float* g_n = g + n * Cg * Lk;
+    for (int i0 = 0; i0 < Lq; i0 += tile) {
+      const int rows = std::min(tile, Lq - i0);
+      // S = scale * theta[:, tile]^T * phi
+      math::GemmEx<float, CUDAContext>(
+          CblasTrans, CblasNoTrans, rows, Lk, C, scale,
+          theta_n + i0, Lq, phi_n, Lk, 0.f, S, Lk, context);
+      AffinityRowSoftmaxKernel<<<
+          std::min(rows, CAFFE_MAXIMUM_NUM_BLOCKS),
+          CAFFE_CUDA_NUM_THREADS,
+          0,
+          context->cuda_stream()>>>(rows, Lk, S, lse + n * Lq + i0);
+      // Y[:, tile] = g * P^T
+      math::GemmEx<float, CUDAContext>(
+          CblasNoTrans, CblasTrans, Cg, rows, Lk, 1.f,
+          g_n, Lk, S, Lk, 0.f, Y + n * Cg * Lq + i0, Lq, context);
+    }
+  }
+}
+
+void NonLocalAttentionGradientTiles(
+    const int N,
+    const int C,
+    const int Cg,
+    const int Lq,
+    const int Lk,
+    const float scale,
+    const int tile,
+    const float* theta,
+    const float* phi,
+    const float* g,
+    const float* lse,
+    const float* dy_dot_y,
+    const float* dY,
+    float* dtheta,
+    float* dphi,
+    float* dg,
+    Tensor<CUDAContext>* affinity,
+    Tensor<CUDAContext>* affinity_grad,
+    CUDAContext* context) {
+  affinity->Resize(std::min(tile, Lq), Lk);
+  affinity_grad->ResizeLike(*affinity);
+  float* P = affinity->mutable_data<float>();
+  float* dS = affinity_grad->mutable_data<float>();
+  for (int n = 0; n < N; ++n) {
+    const float* theta_n = theta + n * C * Lq;
+    const float* phi_n = phi + n * C * Lk;
+    const float* g_n = g + n * Cg * Lk;
+    const float* dY_n = dY + n * Cg * Lq;
+    for (int i0 = 0; i0 < Lq; i0 += tile) {
+      const int rows = std::min(tile, Lq - i0);
+      const float beta = i0 > 0 ? 1.f : 0.f;
+      math::GemmEx<float, CUDAContext>(
+          CblasTrans, CblasNoTrans, rows, Lk, C, scale,
+          theta_n + i0, Lq, phi_n, Lk, 0.f, P, Lk, context);
+      AffinityRecomputeKernel<<<
+          CAFFE_GET_BLOCKS(rows * Lk),
+          CAFFE_CUDA_NUM_THREADS,
+          0,
+          context->cuda_stream()>>>(rows * Lk, Lk, lse + n * Lq + i0, P);
+      // dP = dY[:, tile]^T * g
+      math::GemmEx<float, CUDAContext>(
+          CblasTrans, CblasNoTrans, rows, Lk, Cg, 1.f,
+          dY_n + i0, Lq, g_n, Lk, 0.f, dS, Lk, context);
+      AffinityGradientKernel<<<
+          CAFFE_GET_BLOCKS(rows * Lk),
+          CAFFE_CUDA_NUM_THREADS,
+          0,
+          context->cuda_stream()>>>(
+          rows * Lk, Lk, P, dy_dot_y + n * Lq + i0, dS);
+      // dtheta[:, tile] = scale * phi * dS^T
+      math::GemmEx<float, CUDAContext>(
+          CblasNoTrans, CblasTrans, C, rows, Lk, scale,
+          phi_n, Lk, dS, Lk, 0.f, dtheta + n * C * Lq + i0, Lq, context);
+      // dphi += scale * theta[:, tile] * dS, dg += dY[:, tile] * P
+      math::GemmEx<float, CUDAContext>(
+          CblasNoTrans, CblasNoTrans, C, Lk, rows, scale,
+          theta_n + i0, Lq, dS, Lk, beta, dphi + n * C * Lk, Lk, context);
+      math::GemmEx<float, CUDAContext>(
+          CblasNoTrans, CblasNoTrans, Cg, Lk, rows, 1.f,
+          dY_n + i0, Lq, P, Lk, beta, dg + n * Cg * Lk, Lk, context);
+    }
+  }
+}
+
+} // namespace
+
+template <>
+bool NonLocalAttentionOp<float, CUDAContext>::RunOnDevice() {
+  auto& theta = Input(0);
+  auto& phi = Input(1);
+  auto& g = Input(2);
+  auto* Y = Output(0);
+  auto* lse = Output(1);
+
+  int N, C, Cg, Lq, Lk;
+  NonLocalAttentionDims(theta, phi, g, &N, &C, &Cg, &Lq, &Lk);
+  auto dims = theta.dims();
+  dims[1] = Cg;
+  Y->Resize(dims);
+  lse->Resize(N, Lq);
+  if (affinity_tile_ > 0 || C > kMaxChannels || Cg > kMaxChannels) {
+    NonLocalAttentionTiles(
+        N, C, Cg, Lq, Lk, scale_,
+        affinity_tile_ > 0 ? affinity_tile_ : kDefaultTile,
+        theta.data<float>(), phi.data<float>(), g.data<float>(),
+        Y->mutable_data<float>(), lse->mutable_data<float>(),
+        &affinity_, &context_);
+    return true;
+  }
+  NonLocalAttentionKernel<<<
+      dim3((Lq + kRows - 1) / kRows, N),
+      kThreads,
+      kRows * C * sizeof(float),
+      context_.cuda_stream()>>>(
+      C, Cg, Lq, Lk, scale_,
+      theta.data<float>(), phi.data<float>(), g.data<float>(),
+      Y->mutable_data<float>(), lse->mutable_data<float>());
+  return true;
+}
+
+template <>
+bool NonLocalAttentionGradientOp<float, CUDAContext>::RunOnDevice() {
+  auto& theta = Input(0);
+  auto& phi = Input(1);
+  auto& g = Input(2);
+  auto& Y = Input(3);
+  auto& lse = Input(4);
+  auto& dY = Input(5);
+  auto* dtheta = Output(0);
+  auto* dphi = Output(1);
+  auto* dg = Output(2);
+
+  int N, C, Cg, Lq, Lk;
+  NonLocalAttentionDims(theta, phi, g, &N, &C, &Cg, &Lq, &Lk);
+  CAFFE_ENFORCE_EQ(dY.size(), N * Cg * Lq);
+  dtheta->ResizeLike(theta);
+  dphi->ResizeLike(phi);
+  dg->ResizeLike(g);
+  dy_dot_y_.Resize(N, Lq);
+
+  DyDotYKernel<<<
+      CAFFE_GET_BLOCKS(N * Lq),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(
+      N * Lq, Cg, Lq, dY.data<float>(), Y.data<float>(),
+      dy_dot_y_.mutable_data<float>());
+  if (affinity_tile_ > 0 || C > kMaxChannels || Cg > kMaxChannels) {
+    NonLocalAttentionGradientTiles(
+        N, C, Cg, Lq, Lk, scale_,
+        affinity_tile_ > 0 ? affinity_tile_ : kDefaultTile,
+        theta.data<float>(), phi.data<float>(), g.data<float>(),
+        lse.data<float>(), dy_dot_y_.data<float>(), dY.data<float>(),
+        dtheta->mutable_data<float>(), dphi->mutable_data<float>(),
+        dg->mutable_data<float>(), &affinity_, &affinity_grad_, &context_);
+    return true;
+  }
+  NonLocalAttentionThetaGradientKernel<<<
+      dim3((Lq + kRows - 1) / kRows, N),
+      kThreads,
+      kRows * (C + Cg) * sizeof(float),
+      context_.cuda_stream()>>>(
+      C, Cg, Lq, Lk, scale_,
+      theta.data<float>(), phi.data<float>(), g.data<float>(),
+      lse.data<float>(), dy_dot_y_.data<float>(), dY.data<float>(),
+      dtheta->mutable_data<float>());
+  NonLocalAttentionKeyGradientKernel<<<
+      dim3((Lk + kRows - 1) / kRows, N),
+      kThreads,
+      kRows * (C + Cg) * sizeof(float),
+      context_.cuda_stream()>>>(
+      C, Cg, Lq, Lk, scale_,
+      theta.data<float>(), phi.data<float>(), g.data<float>(),
+      lse.data<float>(), dy_dot_y_.data<float>(), dY.data<float>(),
+      dphi->mutable_data<float>(), dg->mutable_data<float>());
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(
+    NonLocalAttention,
+    NonLocalAttentionOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR(
+    NonLocalAttentionGradient,
+    NonLocalAttentionGradientOp<float, CUDAContext>);
+} // namespace caffe2
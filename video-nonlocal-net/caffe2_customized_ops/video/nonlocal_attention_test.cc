@@ -0,0 +1,327 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "caffe2/video/nonlocal_attention.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// softmax(scale * theta^T phi) g^T with the whole affinity, in double
+std::vector<double> ReferenceAttention(
+    const int N, const int C, const int Cg, const int Lq, const int Lk,
+    const double scale,
+    const std::vector<double>& theta,
+    const std::vector<double>& phi,
+    const std::vector<double>& g) {
+  std::vector<double> Y(N * Cg * Lq, 0);
+  std::vector<double> p(Lk);
+  for (int n = 0; n < N; ++n) {
+    for (int i = 0; i < Lq; ++i) {
+      double m = -1e300;
+      for (int j = 0; j < Lk; ++j) {
+        double s = 0;
+        for (int c = 0; c < C; ++c) {
+          s += theta[(n * C + c) * Lq + i] * phi[(n * C + c) * Lk + j];
+        }
+        p[j] = scale * s;
+        m = std::max(m, p[j]);
+      }
+      double l = 0;
+      for (int j = 0; j < Lk; ++j) {
+        p[j] = std::exp(p[j] - m);
+        l += p[j];
+      }
+      for (int c = 0; c < Cg; ++c) {
+        double y = 0;
+        for (int j = 0; j < Lk; ++j) {
+          y += p[j] / l * g[(n * Cg + c) * Lk + j];
+        }
+        Y[(n * Cg + c) * Lq + i] = y;
+      }
+    }
+  }
+  return Y;
+}
+
+std::vector<float> RandomBlob(const int size, std::mt19937* gen) {
+  std::normal_distribution<float> dist;
+  std::vector<float> blob(size);
+  for (auto& v : blob) {
+    v = dist(*gen);
+  }
+  return blob;
+}
+
+// Y of the windowed non-local op with the keys of LocalWindowKeys, in double
+std::vector<double> ReferenceLocalAttention(
+    const int N, const int C, const int Cg, const LocalWindow& win,
+    const double scale,
+    const std::vector<double>& theta,
+    const std::vector<double>& phi,
+    const std::vector<double>& g) {
+  const int Lq = win.T * win.H * win.W;
+  const int Lk = win.Tk * win.Hk * win.Wk;
+  std::vector<double> Y(N * Cg * Lq, 0);
+  std::vector<int> keys(win.size());
+  std::vector<double> p(win.size());
+  for (int n = 0; n < N; ++n) {
+    for (int i = 0; i < Lq; ++i) {
+      const int count = LocalWindowKeys(
+          win, i / (win.H * win.W), i / win.W % win.H, i % win.W,
+          keys.data());
+      double m = -1e300;
+      for (int k = 0; k < count; ++k) {
+        double s = 0;
+        for (int c = 0; c < C; ++c) {
+          s += theta[(n * C + c) * Lq + i] * phi[(n * C + c) * Lk + keys[k]];
+        }
+        p[k] = scale * s;
+        m = std::max(m, p[k]);
+      }
+      double l = 0;
+      for (int k = 0; k < count; ++k) {
+        p[k] = std::exp(p[k] - m);
+        l += p[k];
+      }
+      for (int c = 0; c < Cg; ++c) {
+        double y = 0;
+        for (int k = 0; k < count; ++k) {
+          y += p[k] / l * g[(n * Cg + c) * Lk + keys[k]];
+        }
+        Y[(n * Cg + c) * Lq + i] = y;
+      }
+    }
+  }
+  return Y;
+}
+
+// a 2 x 3 x 4 grid of queries on a 2 x 2 x 2 grid of keys
+LocalWindow MakeWindow(
+    const int wt, const int wh, const int ww,
+    const int dt, const int dh, const int dw) {
+  LocalWindow win;
+  win.T = 2;
+  win.H = 3;
+  win.W = 4;
+  win.Tk = win.Hk = win.Wk = 2;
+  win.window[0] = wt;
+  win.window[1] = wh;
+  win.window[2] = ww;
+  win.dilation[0] = dt;
+  win.dilation[1] = dh;
+  win.dilation[2] = dw;
+  return win;
+}
+
+// more queries than a block, so the last block is a partial one
+const int N = 2, C = 3, Cg = 4, Lq = 70, Lk = 11;
+const float kScale = 0.5f;
+
+} // namespace
+
+TEST(NonLocalAttentionTest, MatchesFullAffinity) {
+  std::mt19937 gen(1);
+  const auto theta = RandomBlob(N * C * Lq, &gen);
+  const auto phi = RandomBlob(N * C * Lk, &gen);
+  const auto g = RandomBlob(N * Cg * Lk, &gen);
+  std::vector<float> Y(N * Cg * Lq), lse(N * Lq);
+  NonLocalAttentionCPU(
+      N, C, Cg, Lq, Lk, kScale, theta.data(), phi.data(), g.data(),
+      Y.data(), lse.data());
+
+  const auto expected = ReferenceAttention(
+      N, C, Cg, Lq, Lk, kScale,
+      std::vector<double>(theta.begin(), theta.end()),
+      std::vector<double>(phi.begin(), phi.end()),
+      std::vector<double>(g.begin(), g.end()));
+  for (int i = 0; i < Y.size(); ++i) {
+    EXPECT_NEAR(Y[i], expected[i], 1e-5) << i;
+  }
+}
+
+TEST(NonLocalAttentionTest, QueryBlockDoesNotChangeResults) {
+  std::mt19937 gen(3);
+  const auto theta = RandomBlob(N * C * Lq, &gen);
+  const auto phi = RandomBlob(N * C * Lk, &gen);
+  const auto g = RandomBlob(N * Cg * Lk, &gen);
+  const auto dY = RandomBlob(N * Cg * Lq, &gen);
+  std::vector<std::vector<float>> results;
+  for (const int block : {1, 7, 64, Lq}) {
+    std::vector<float> Y(N * Cg * Lq), lse(N * Lq);
+    NonLocalAttentionCPU(
+        N, C, Cg, Lq, Lk, kScale, theta.data(), phi.data(), g.data(),
+        Y.data(), lse.data(), block);
+    std::vector<float> dtheta(theta.size()), dphi(phi.size()), dg(g.size());
+    NonLocalAttentionGradientCPU(
+        N, C, Cg, Lq, Lk, kScale, theta.data(), phi.data(), g.data(),
+        Y.data(), lse.data(), dY.data(), dtheta.data(), dphi.data(),
+        dg.data(), block);
+    std::vector<float> all(Y);
+    all.insert(all.end(), dtheta.begin(), dtheta.end());
+    all.insert(all.end(), dphi.begin(), dphi.end());
+    all.insert(all.end(), dg.begin(), dg.end());
+    results.push_back(all);
+  }
+  for (int k = 1; k < results.size(); ++k) {
+    for (int i = 0; i < results[0].size(); ++i) {
+      EXPECT_NEAR(results[k][i], results[0][i], 1e-5) << k << " " << i;
+    }
+  }
+}
+
+TEST(NonLocalAttentionTest, GradientMatchesFiniteDifferences) {
+  std::mt19937 gen(2);
+  const auto theta = RandomBlob(N * C * Lq, &gen);
+  const auto phi = RandomBlob(N * C * Lk, &gen);
+  const auto g = RandomBlob(N * Cg * Lk, &gen);
+  // loss = sum(Y .* dY)
+  const auto dY = RandomBlob(N * Cg * Lq, &gen);
+  std::vector<float> Y(N * Cg * Lq), lse(N * Lq);
+  NonLocalAttentionCPU(
+      N, C, Cg, Lq, Lk, kScale, theta.data(), phi.data(), g.data(),
+      Y.data(), lse.data());
+  std::vector<float> dtheta(theta.size()), dphi(phi.size()), dg(g.size());
+  NonLocalAttentionGradientCPU(
+      N, C, Cg, Lq, Lk, kScale, theta.data(), phi.data(), g.data(),
+      Y.data(), lse.data(), dY.data(), dtheta.data(), dphi.data(),
+      dg.data());
+
+  std::vector<std::vector<double>> inputs = {
+      std::vector<double>(theta.begin(), theta.end()),
+      std::vector<double>(phi.begin(), phi.end()),
+      std::vector<double>(g.begin(), g.end())};
+  const std::vector<const std::vector<float>*> grads = {&dtheta, &dphi, &dg};
+  auto loss = [&]() {
+    const auto out = ReferenceAttention(
+        N, C, Cg, Lq, Lk, kScale, inputs[0], inputs[1], inputs[2]);
+    double sum = 0;
+    for (int i = 0; i < out.size(); ++i) {
+      sum += out[i] * dY[i];
+    }
+    return sum;
+  };
+  const double h = 1e-5;
+  for (int k = 0; k < inputs.size(); ++k) {
+    for (int i = 0; i < inputs[k].size(); i += 7) {
+      const double v = inputs[k][i];
+      inputs[k][i] = v + h;
+      const double up = loss();
+      inputs[k][i] = v - h;
+      const double down = loss();
+      inputs[k][i] = v;
+      EXPECT_NEAR((*grads[k])[i], (up - down) / (2 * h), 1e-3)
+          << "input " << k << " element " << i;
+    }
+  }
+}
+
+TEST(LocalNonLocalTest, WholeGridWindowMatchesNonLocalAttention) {
+  // from any query, 5 keys along every axis cover the 2 x 2 x 2 keys
+  const auto win = MakeWindow(5, 5, 5, 1, 1, 1);
+  const int Lq = 24, Lk = 8;
+  std::mt19937 gen(4);
+  const auto theta = RandomBlob(N * C * Lq, &gen);
+  const auto phi = RandomBlob(N * C * Lk, &gen);
+  const auto g = RandomBlob(N * Cg * Lk, &gen);
+  std::vector<float> Y(N * Cg * Lq), lse(N * Lq);
+  LocalNonLocalCPU(
+      N, C, Cg, win, kScale, theta.data(), phi.data(), g.data(), Y.data(),
+      lse.data());
+  std::vector<float> expected(N * Cg * Lq), expected_lse(N * Lq);
+  NonLocalAttentionCPU(
+      N, C, Cg, Lq, Lk, kScale, theta.data(), phi.data(), g.data(),
+      expected.data(), expected_lse.data());
+  for (int i = 0; i < Y.size(); ++i) {
+    EXPECT_NEAR(Y[i], expected[i], 1e-5) << i;
+  }
+  for (int i = 0; i < lse.size(); ++i) {
+    EXPECT_NEAR(lse[i], expected_lse[i], 1e-5) << i;
+  }
+}
+
+TEST(LocalNonLocalTest, WindowKeysStayInTheGrid) {
+  // the query (1, 2, 3) is at the key (1, 1, 1): with a dilation of 2 along
+  // h only the keys at h = 1 are left
+  const auto win = MakeWindow(3, 3, 1, 1, 2, 1);
+  std::vector<int> keys(win.size());
+  const int count = LocalWindowKeys(win, 1, 2, 3, keys.data());
+  ASSERT_EQ(count, 2);
+  EXPECT_EQ(keys[0], (0 * 2 + 1) * 2 + 1);
+  EXPECT_EQ(keys[1], (1 * 2 + 1) * 2 + 1);
+}
+
+TEST(LocalNonLocalTest, GradientMatchesFiniteDifferences) {
+  const auto win = MakeWindow(1, 3, 3, 1, 1, 2);
+  const int Lq = 24, Lk = 8;
+  std::mt19937 gen(5);
+  const auto theta = RandomBlob(N * C * Lq, &gen);
+  const auto phi = RandomBlob(N * C * Lk, &gen);
+  const auto g = RandomBlob(N * Cg * Lk, &gen);
+  // loss = sum(Y .* dY)
+  const auto dY = RandomBlob(N * Cg * Lq, &gen);
+  std::vector<float> Y(N * Cg * Lq), lse(N * Lq);
+  LocalNonLocalCPU(
+      N, C, Cg, win, kScale, theta.data(), phi.data(), g.data(), Y.data(),
+      lse.data());
+  std::vector<float> dtheta(theta.size()), dphi(phi.size()), dg(g.size());
+  LocalNonLocalGradientCPU(
+      N, C, Cg, win, kScale, theta.data(), phi.data(), g.data(), lse.data(),
+      dY.data(), dtheta.data(), dphi.data(), dg.data());
+
+  std::vector<std::vector<double>> inputs = {
+      std::vector<double>(theta.begin(), theta.end()),
+      std::vector<double>(phi.begin(), phi.end()),
+      std::vector<double>(g.begin(), g.end())};
+  const std::vector<const std::vector<float>*> grads = {&dtheta, &dphi, &dg};
+  auto loss = [&]() {
+    const auto out = ReferenceLocalAttention(
+        N, C, Cg, win, kScale, inputs[0], inputs[1], inputs[2]);
+    double sum = 0;
+    for (int i = 0; i < out.size(); ++i) {
+      sum += out[i] * dY[i];
+    }
+    return sum;
+  };
+  const double h = 1e-5;
+  for (int k = 0; k < inputs.size(); ++k) {
+    for (int i = 0; i < inputs[k].size(); i += 3) {
+      const double v = inputs[k][i];
+      inputs[k][i] = v + h;
+      const double up = loss();
+      inputs[k][i] = v - h;
+      const double down = loss();
+      inputs[k][i] = v;
+      EXPECT_NEAR((*grads[k])[i], (up - down) / (2 * h), 1e-3)
+          << "input " << k << " element " << i;
+    }
+  }
+}
+
+} // namespace caffe2
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/video/nvjpeg_clip_decoder.h"
+
+namespace caffe2 {
+
+namespace {
+
+// a thread per output pixel of the N x 3 x T x crop x crop clips, with
+// the half pixel centers of cv::resize
+__global__ void ScaleCropFramesKernel(
+    const int count,
+    const int T,
+    const int crop,
+    const uint8_t* frames,
+    const int64_t* frame_offsets,
+    const int* frame_dims,
+    const int* geometry,
+    uint8_t* clips) {
+  CUDA_1D_KERNEL_LOOP(index, count) {
+    const int x = index % crop;
+    const int y = (index / crop) % crop;
+    const int t = (index / (crop * crop)) % T;
+    const int c = (index / (crop * crop * T)) % 3;
+    const int n = index / (crop * crop * T * 3);
+    const int frame = n * T + t;
+    const int height = frame_dims[2 * frame];
+    const int width = frame_dims[2 * frame + 1];
+    const int* clip_geometry = geometry + 4 * n;
+    const float in_y = max(
+        (y + clip_geometry[2] + 0.5f) * height / clip_geometry[0] - 0.5f, 0.f);
+    const float in_x = max(
+        (x + clip_geometry[3] + 0.5f) * width / clip_geometry[1] - 0.5f, 0.f);
+    const int y0 = min(static_cast<int>(in_y), height - 1);
+    const int x0 = min(static_cast<int>(in_x), width - 1);
+    const int y1 = min(y0 + 1, height - 1);
+    const int x1 = min(x0 + 1, width - 1);
+    const float ly = in_y - y0;
+    const float lx = in_x - x0;
+    const uint8_t* plane =
+        frames + frame_offsets[frame] + static_cast<int64_t>(c) * height * width;
+    const float top =
+        (1.f - lx) * plane[y0 * width + x0] + lx * plane[y0 * width + x1];
+    const float bottom =
+        (1.f - lx) * plane[y1 * width + x0] + lx * plane[y1 * width + x1];
+    const float value = (1.f - ly) * top + ly * bottom;
+    clips[index] = static_cast<uint8_t>(min(max(value + 0.5f, 0.f), 255.f));
+  }
+}
+
+} // namespace
+
+void ScaleCropFramesOnGPU(
+    const int N,
+    const int T,
+    const int crop,
+    const uint8_t* frames,
+    const int64_t* frame_offsets,
+    const int* frame_dims,
+    const int* geometry,
+    uint8_t* clips,
+    CUDAContext* context) {
+  const int count = N * 3 * T * crop * crop;
+  ScaleCropFramesKernel<<<
+      CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context->cuda_stream()>>>(
+      count, T, crop, frames, frame_offsets, frame_dims, geometry, clips);
+}
+
+} // namespace caffe2
@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_NVJPEG_CLIP_DECODER_H_
+#define CAFFE2_VIDEO_NVJPEG_CLIP_DECODER_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/tensor.h"
+
+namespace caffe2 {
+
+class CUDAContext;
+
+// The JPEG frames of a batch of N clips of T frames, for the GPU to decode:
+// frame t of clip n is bytes [offsets[n * T + t], offsets[n * T + t + 1]) of
+// encoded (the staging copy, pinned once CUDA is in use), and clip n is cut
+// from its frames scaled to geometry[n] = (scaled height, scaled width, crop
+// offset h, crop offset w).
+struct JpegClipBatch {
+  TensorCPU encoded;
+  TensorCPU offsets;
+  TensorCPU geometry;
+
+  void swap(JpegClipBatch& other) {
+    encoded.swap(other.encoded);
+    offsets.swap(other.offsets);
+    geometry.swap(other.geometry);
+  }
+};
+
+// The nvJPEG handle and decode state of an op on a gpu, and the device
+// buffer its frames are decoded into.
+struct NvJpegClipDecoder;
+
+// The decoder of the gpu of option; the CPU version throws, as does the
+// CUDA one in a build without USE_NVJPEG.
+template <class Context>
+std::shared_ptr<NvJpegClipDecoder> CreateNvJpegClipDecoder(
+    const DeviceOption& option);
+
+template <>
+std::shared_ptr<NvJpegClipDecoder> CreateNvJpegClipDecoder<CPUContext>(
+    const DeviceOption& option);
+
+// Decodes all the frames of batch with one batched nvJPEG call into device
+// memory, and scales and crops them into the N x 3 x T x crop x crop uint8
+// RGB clips, the input of TransformClipsOnGPU. Everything is queued on the
+// stream of context; only the bitstreams are read on the host.
+template <class Context>
+void DecodeJpegClipsOnGPU(
+    NvJpegClipDecoder* decoder,
+    const JpegClipBatch& batch,
+    const int length,
+    const int crop,
+    Tensor<Context>* clips,
+    Context* context);
+
+template <>
+void DecodeJpegClipsOnGPU<CPUContext>(
+    NvJpegClipDecoder* decoder,
+    const JpegClipBatch& batch,
+    const int length,
+    const int crop,
+    TensorCPU* clips,
+    CPUContext* context);
+
+// Clip n x c x t x crop x crop of the planar RGB frames, frame n * T + t at
+// frame_offsets[n * T + t] of frames with the size frame_dims[2 * (n * T +
+// t)], frame_dims[2 * (n * T + t) + 1], bilinearly scaled to geometry[4 * n]
+// x geometry[4 * n + 1] and cropped at geometry[4 * n + 2], geometry[4 * n
+// + 3]; all pointers on the device.
+void ScaleCropFramesOnGPU(
+    const int N,
+    const int T,
+    const int crop,
+    const uint8_t* frames,
+    const int64_t* frame_offsets,
+    const int* frame_dims,
+    const int* geometry,
+    uint8_t* clips,
+    CUDAContext* context);
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_NVJPEG_CLIP_DECODER_H_
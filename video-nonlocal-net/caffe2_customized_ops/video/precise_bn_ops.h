@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_PRECISE_BN_OPS_H_
+#define CAFFE2_VIDEO_PRECISE_BN_OPS_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// Adds the batch mean and the batch mean of the squares of every channel of
+// a training SpatialBN to the running sums of its layer: sums[c] += mean[c]
+// and sums[C + c] += var[c] + mean[c]^2, with var = 1 / inv_std^2 - epsilon
+// from the saved statistics of the op. The sums stay on the device of the op
+// over the precise BN iterations.
+template <class Context>
+class AccumulateBNStatsOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  AccumulateBNStatsOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        epsilon_(
+            OperatorBase::template GetSingleArgument<float>("epsilon", 1e-5f)) {
+    CAFFE_ENFORCE_GE(epsilon_, 0);
+  }
+
+  bool RunOnDevice() override {
+    auto& mean = Input(SAVED_MEAN);
+    auto& inv_std = Input(SAVED_INV_STD);
+    auto* sums = Output(SUMS);
+    const int C = mean.size();
+    CAFFE_ENFORCE_EQ(inv_std.size(), C);
+    if (sums->size() != 2 * C) {
+      // the first batch starts the sums
+      sums->Resize(2 * C);
+      math::Set<float, Context>(
+          2 * C, 0.f, sums->template mutable_data<float>(), &context_);
+    }
+    return Accumulate(
+        C,
+        mean.template data<float>(),
+        inv_std.template data<float>(),
+        sums->template mutable_data<float>());
+  }
+
+ protected:
+  bool Accumulate(
+      const int C,
+      const float* mean,
+      const float* inv_std,
+      float* sums);
+
+  float epsilon_;
+  INPUT_TAGS(SAVED_MEAN, SAVED_INV_STD, SUMS_IN);
+  OUTPUT_TAGS(SUMS);
+};
+
+// Writes the precise statistics of a layer to its running mean and variance
+// in place: mean = sums[c] / count and var = sums[C + c] / count - mean^2,
+// clamped at 0. count is the number of accumulated batches, i.e. iterations
+// times devices once the sums have been allreduced over the devices. The
+// sums are left as they are, so the same statistics can be written again.
+template <class Context>
+class FinalizeBNStatsOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  FinalizeBNStatsOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        count_(OperatorBase::template GetSingleArgument<int>("count", 1)) {
+    CAFFE_ENFORCE_GT(count_, 0);
+  }
+
+  bool RunOnDevice() override {
+    auto& sums = Input(SUMS);
+    const int C = sums.size() / 2;
+    CAFFE_ENFORCE_EQ(sums.size(), 2 * C);
+    auto* running_mean = Output(RUNNING_MEAN);
+    auto* running_var = Output(RUNNING_VAR);
+    running_mean->Resize(C);
+    running_var->Resize(C);
+    return Finalize(
+        C,
+        sums.template data<float>(),
+        running_mean->template mutable_data<float>(),
+        running_var->template mutable_data<float>());
+  }
+
+ protected:
+  bool Finalize(
+      const int C,
+      const float* sums,
+      float* running_mean,
+      float* running_var);
+
+  int count_;
+  INPUT_TAGS(SUMS, RUNNING_MEAN_IN, RUNNING_VAR_IN);
+  OUTPUT_TAGS(RUNNING_MEAN, RUNNING_VAR);
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_PRECISE_BN_OPS_H_
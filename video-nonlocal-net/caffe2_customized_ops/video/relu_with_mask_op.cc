@@ -0,0 +1,134 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/relu_with_mask_op.h"
+
+#include <algorithm>
+
+namespace caffe2 {
+
+template <>
+bool ReluWithMaskOp<float, CPUContext>::RunOnDevice() {
+  auto& X = Input(0);
+  auto* Y = Output(0);
+  auto* mask = Output(1);
+  const TIndex size = X.size();
+  const TIndex num_words = ReluMaskWords(size);
+  Y->ResizeLike(X);
+  mask->Resize(num_words);
+  const float* x = X.data<float>();
+  float* y = Y->mutable_data<float>();
+  uint32_t* m = reinterpret_cast<uint32_t*>(mask->mutable_data<int>());
+  for (TIndex word = 0; word < num_words; ++word) {
+    const TIndex begin = word * kReluMaskBits;
+    const TIndex end = std::min(size, begin + kReluMaskBits);
+    uint32_t bits = 0;
+    for (TIndex i = begin; i < end; ++i) {
+      // x[i] is read before y[i] is written, so Y can be X
+      const float value = x[i];
+      if (value > 0.f) {
+        bits |= 1u << (i - begin);
+        y[i] = value;
+      } else {
+        y[i] = 0.f;
+      }
+    }
+    m[word] = bits;
+  }
+  return true;
+}
+
+template <>
+bool ReluWithMaskGradientOp<float, CPUContext>::RunOnDevice() {
+  auto& mask = Input(0);
+  auto& dY = Input(1);
+  auto* dX = Output(0);
+  const TIndex size = dY.size();
+  CAFFE_ENFORCE_EQ(mask.size(), ReluMaskWords(size));
+  dX->ResizeLike(dY);
+  const uint32_t* m = reinterpret_cast<const uint32_t*>(mask.data<int>());
+  const float* dy = dY.data<float>();
+  float* dx = dX->mutable_data<float>();
+  for (TIndex i = 0; i < size; ++i) {
+    dx[i] = (m[i / kReluMaskBits] >> (i % kReluMaskBits)) & 1u ? dy[i] : 0.f;
+  }
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(ReluWithMask, ReluWithMaskOp<float, CPUContext>);
+REGISTER_CPU_OPERATOR(
+    ReluWithMaskGradient,
+    ReluWithMaskGradientOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(ReluWithMask)
+    .NumInputs(1)
+    .NumOutputs(2)
+    .AllowInplace({{0, 0}})
+    .TensorInferenceFunction([](const OperatorDef& /* unused */,
+                                const vector<TensorShape>& in) {
+      vector<TensorShape> out(2);
+      out[0] = in[0];
+      TIndex size = 1;
+      for (const auto d : in[0].dims()) {
+        size *= d;
+      }
+      out[1].add_dims(ReluMaskWords(size));
+      out[1].set_data_type(TensorProto::INT32);
+      return out;
+    })
+    .SetDoc(R"DOC(
+Relu that also outputs a bit mask of the positive elements of Y, the only
+thing its gradient reads: unlike the ReluGradient of Relu, which keeps the
+whole Y alive until the backward pass, ReluWithMaskGradient lets Y be
+freed (or shared by the memory plan) after its last forward reader, for a
+mask of 1/32 of its size. Written by the compact activation rewrite of the
+video models (MODEL.COMPACT_ACTIVATIONS).
+)DOC")
+    .Input(0, "X", "Input tensor")
+    .Output(0, "Y", "max(X, 0), can be X")
+    .Output(
+        1,
+        "mask",
+        "int32 tensor of ceil(size / 32) words, bit i % 32 of word i / 32 is "
+        "set when Y[i] > 0");
+// Input: mask, dY; Output: dX
+OPERATOR_SCHEMA(ReluWithMaskGradient)
+    .NumInputs(2)
+    .NumOutputs(1)
+    .AllowInplace({{1, 0}});
+
+class GetReluWithMaskGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    return SingleGradientDef(
+        "ReluWithMaskGradient",
+        "",
+        vector<string>{O(1), GO(0)},
+        vector<string>{GI(0)});
+  }
+};
+
+REGISTER_GRADIENT(ReluWithMask, GetReluWithMaskGradient);
+
+} // namespace caffe2
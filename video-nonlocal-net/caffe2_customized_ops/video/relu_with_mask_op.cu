@@ -0,0 +1,125 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/video/relu_with_mask_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// A thread per element, with whole warps in every step of the loop: lane 0
+// writes the bits of the 32 elements of its warp, gathered with a ballot.
+// The loop runs over num_words * 32 elements, a multiple of the warp size,
+// so that the lanes past size vote too.
+__global__ void ReluWithMaskKernel(
+    const int size,
+    const int num_words,
+    const float* X,
+    float* Y,
+    uint32_t* mask) {
+  CUDA_1D_KERNEL_LOOP(i, num_words * kReluMaskBits) {
+    const bool valid = i < size;
+    const float x = valid ? X[i] : 0.f;
+    const bool positive = x > 0.f;
+    if (valid) {
+      Y[i] = positive ? x : 0.f;
+    }
+#if CUDA_VERSION >= 9000
+    const uint32_t bits = __ballot_sync(0xffffffff, positive);
+#else
+    const uint32_t bits = __ballot(positive);
+#endif
+    if ((threadIdx.x & (kReluMaskBits - 1)) == 0) {
+      mask[i / kReluMaskBits] = bits;
+    }
+  }
+}
+
+__global__ void ReluWithMaskGradientKernel(
+    const int size,
+    const uint32_t* mask,
+    const float* dY,
+    float* dX) {
+  CUDA_1D_KERNEL_LOOP(i, size) {
+    dX[i] = (mask[i / kReluMaskBits] >> (i % kReluMaskBits)) & 1u ? dY[i]
+                                                                   : 0.f;
+  }
+}
+
+} // namespace
+
+template <>
+bool ReluWithMaskOp<float, CUDAContext>::RunOnDevice() {
+  auto& X = Input(0);
+  auto* Y = Output(0);
+  auto* mask = Output(1);
+  const int size = X.size();
+  const int num_words = ReluMaskWords(size);
+  Y->ResizeLike(X);
+  mask->Resize(num_words);
+  if (size == 0) {
+    return true;
+  }
+  ReluWithMaskKernel<<<
+      CAFFE_GET_BLOCKS(num_words * kReluMaskBits),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(
+      size,
+      num_words,
+      X.data<float>(),
+      Y->mutable_data<float>(),
+      reinterpret_cast<uint32_t*>(mask->mutable_data<int>()));
+  return true;
+}
+
+template <>
+bool ReluWithMaskGradientOp<float, CUDAContext>::RunOnDevice() {
+  auto& mask = Input(0);
+  auto& dY = Input(1);
+  auto* dX = Output(0);
+  const int size = dY.size();
+  CAFFE_ENFORCE_EQ(mask.size(), ReluMaskWords(size));
+  dX->ResizeLike(dY);
+  if (size == 0) {
+    return true;
+  }
+  ReluWithMaskGradientKernel<<<
+      CAFFE_GET_BLOCKS(size),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(
+      size,
+      reinterpret_cast<const uint32_t*>(mask.data<int>()),
+      dY.data<float>(),
+      dX->mutable_data<float>());
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(ReluWithMask, ReluWithMaskOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR(
+    ReluWithMaskGradient,
+    ReluWithMaskGradientOp<float, CUDAContext>);
+} // namespace caffe2
@@ -0,0 +1,67 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef RELU_WITH_MASK_OP_H_
+#define RELU_WITH_MASK_OP_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+
+namespace caffe2 {
+
+// the mask of a ReLU keeps a bit per element: bit i % 32 of word i / 32 is
+// set when the output i is positive
+constexpr int kReluMaskBits = 32;
+
+inline TIndex ReluMaskWords(const TIndex size) {
+  return (size + kReluMaskBits - 1) / kReluMaskBits;
+}
+
+// Y = max(X, 0), and the mask of the positive outputs, which is all that
+// the gradient needs: Y can then be freed once its forward readers ran
+template <typename T, class Context>
+class ReluWithMaskOp final : public Operator<Context> {
+ public:
+  USE_SIMPLE_CTOR_DTOR(ReluWithMaskOp);
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+
+  bool RunOnDevice() override;
+};
+
+// dX = dY where the mask is set, 0 elsewhere
+template <typename T, class Context>
+class ReluWithMaskGradientOp final : public Operator<Context> {
+ public:
+  USE_SIMPLE_CTOR_DTOR(ReluWithMaskGradientOp);
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+
+  bool RunOnDevice() override;
+
+  // Input: mask, dY; Output: dX
+};
+
+} // namespace caffe2
+
+#endif // RELU_WITH_MASK_OP_H_
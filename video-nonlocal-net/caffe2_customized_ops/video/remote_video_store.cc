@@ -0,0 +1,574 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/remote_video_store.h"
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+namespace {
+
+// bytes of the object size in front of the data of a cached block file
+constexpr size_t kBlockHeaderSize = sizeof(int64_t);
+// queued prefetches beyond which Prefetch() drops its requests
+constexpr size_t kMaxPrefetchQueue = 4096;
+
+std::string ToLower(std::string s) {
+  std::transform(s.begin(), s.end(), s.begin(), ::tolower);
+  return s;
+}
+
+bool SendAll(int fd, const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    const ssize_t n =
+        send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+// reads from fd into buffer until it holds at least size bytes
+bool RecvAtLeast(int fd, size_t size, std::string* buffer) {
+  char chunk[64 << 10];
+  while (buffer->size() < size) {
+    const ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+      return false;
+    }
+    buffer->append(chunk, n);
+  }
+  return true;
+}
+
+uint64_t Fnv1a(const std::string& s) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const unsigned char c : s) {
+    hash = (hash ^ c) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+} // namespace
+
+bool ParseHttpUrl(const std::string& url, HttpUrl* parsed) {
+  const std::string scheme = "http://";
+  if (url.compare(0, scheme.size(), scheme) != 0) {
+    return false;
+  }
+  const size_t host_begin = scheme.size();
+  size_t path_begin = url.find('/', host_begin);
+  if (path_begin == std::string::npos) {
+    path_begin = url.size();
+  }
+  std::string host = url.substr(host_begin, path_begin - host_begin);
+  parsed->port = 80;
+  const size_t colon = host.rfind(':');
+  if (colon != std::string::npos) {
+    parsed->port = atoi(host.c_str() + colon + 1);
+    host.resize(colon);
+  }
+  if (host.empty() || parsed->port <= 0) {
+    return false;
+  }
+  parsed->host = host;
+  parsed->path = path_begin < url.size() ? url.substr(path_begin) : "/";
+  return true;
+}
+
+HttpConnectionPool::HttpConnectionPool(int max_idle_per_host, int timeout_ms)
+    : max_idle_per_host_(max_idle_per_host), timeout_ms_(timeout_ms) {}
+
+HttpConnectionPool::~HttpConnectionPool() {
+  for (auto& host : idle_) {
+    for (const int fd : host.second) {
+      close(fd);
+    }
+  }
+}
+
+int HttpConnectionPool::Connect(const HttpUrl& url) {
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* addresses = nullptr;
+  const std::string port = std::to_string(url.port);
+  if (getaddrinfo(url.host.c_str(), port.c_str(), &hints, &addresses) != 0) {
+    LOG(ERROR) << "Cannot resolve " << url.host;
+    return -1;
+  }
+  int fd = -1;
+  for (auto* address = addresses; address; address = address->ai_next) {
+    fd = socket(address->ai_family, address->ai_socktype, 0);
+    if (fd < 0) {
+      continue;
+    }
+    struct timeval timeout;
+    timeout.tv_sec = timeout_ms_ / 1000;
+    timeout.tv_usec = (timeout_ms_ % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+      break;
+    }
+    close(fd);
+    fd = -1;
+  }
+  freeaddrinfo(addresses);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot connect to " << url.host << ":" << url.port;
+  } else {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++num_connects_;
+  }
+  return fd;
+}
+
+bool HttpConnectionPool::Get(
+    const std::string& url,
+    int64_t offset,
+    int64_t size,
+    std::string* body,
+    int64_t* total) {
+  HttpUrl parsed;
+  if (!ParseHttpUrl(url, &parsed)) {
+    LOG(ERROR) << "Not an http url: " << url;
+    return false;
+  }
+  const std::string host = parsed.host + ":" + std::to_string(parsed.port);
+  // a pooled connection may have been closed by the server in the meantime,
+  // so a failed request on one is retried on a new connection
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    int fd = -1;
+    bool pooled = false;
+    if (attempt == 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto& idle = idle_[host];
+      if (!idle.empty()) {
+        fd = idle.back();
+        idle.pop_back();
+        pooled = true;
+      }
+    }
+    if (fd < 0) {
+      fd = Connect(parsed);
+      if (fd < 0) {
+        return false;
+      }
+    }
+    bool keep_alive = false;
+    const bool ok =
+        Request(fd, parsed, offset, size, body, total, &keep_alive);
+    if (ok && keep_alive) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto& idle = idle_[host];
+      if (static_cast<int>(idle.size()) < max_idle_per_host_) {
+        idle.push_back(fd);
+        fd = -1;
+      }
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (ok || !pooled) {
+      return ok;
+    }
+  }
+  return false;
+}
+
+bool HttpConnectionPool::Request(
+    int fd,
+    const HttpUrl& url,
+    int64_t offset,
+    int64_t size,
+    std::string* body,
+    int64_t* total,
+    bool* keep_alive) {
+  std::string request = "GET " + url.path + " HTTP/1.1\r\nHost: " + url.host +
+      "\r\nConnection: keep-alive\r\n";
+  if (size >= 0) {
+    request += "Range: bytes=" + std::to_string(offset) + "-" +
+        std::to_string(offset + std::max<int64_t>(size, 1) - 1) + "\r\n";
+  }
+  request += "\r\n";
+  if (!SendAll(fd, request)) {
+    return false;
+  }
+
+  std::string response;
+  size_t header_end;
+  while ((header_end = response.find("\r\n\r\n")) == std::string::npos) {
+    if (!RecvAtLeast(fd, response.size() + 1, &response)) {
+      return false;
+    }
+  }
+  int status = 0;
+  if (sscanf(response.c_str(), "HTTP/%*d.%*d %d", &status) != 1) {
+    LOG(ERROR) << "Bad HTTP response for " << url.path;
+    return false;
+  }
+  int64_t content_length = -1;
+  int64_t range_total = -1;
+  *keep_alive = true;
+  size_t line_begin = response.find("\r\n") + 2;
+  while (line_begin < header_end) {
+    const size_t line_end = response.find("\r\n", line_begin);
+    const std::string line =
+        response.substr(line_begin, line_end - line_begin);
+    line_begin = line_end + 2;
+    const size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    const std::string name = ToLower(line.substr(0, colon));
+    std::string value = line.substr(colon + 1);
+    value.erase(0, value.find_first_not_of(' '));
+    if (name == "content-length") {
+      content_length = atoll(value.c_str());
+    } else if (name == "content-range") {
+      const size_t slash = value.rfind('/');
+      if (slash != std::string::npos && value[slash + 1] != '*') {
+        range_total = atoll(value.c_str() + slash + 1);
+      }
+    } else if (name == "connection") {
+      *keep_alive = ToLower(value) != "close";
+    } else if (name == "transfer-encoding" && ToLower(value) != "identity") {
+      LOG(ERROR) << "Unsupported transfer encoding " << value << " of "
+                 << url.path;
+      return false;
+    }
+  }
+  if (content_length < 0) {
+    LOG(ERROR) << "No content length in the response for " << url.path;
+    return false;
+  }
+  const size_t body_begin = header_end + 4;
+  if (!RecvAtLeast(fd, body_begin + content_length, &response)) {
+    return false;
+  }
+  // nothing else was asked for on this connection
+  *keep_alive = *keep_alive && response.size() == body_begin + content_length;
+
+  if (status == 206) {
+    *total = range_total;
+    body->assign(response, body_begin, content_length);
+  } else if (status == 200) {
+    // the server ignored the range
+    *total = content_length;
+    const int64_t begin = std::min(offset, content_length);
+    const int64_t count = size < 0 ? content_length - begin
+                                   : std::min(size, content_length - begin);
+    body->assign(response, body_begin + begin, count);
+  } else if (status == 416) {
+    // a range past the end of the object
+    *total = range_total;
+    body->clear();
+  } else {
+    LOG(ERROR) << "HTTP status " << status << " for " << url.host
+               << url.path;
+    return false;
+  }
+  if (size >= 0 && static_cast<int64_t>(body->size()) > size) {
+    body->resize(size);
+  }
+  return *total >= 0;
+}
+
+bool RemoteVideoStore::IsRemote(const std::string& path) {
+  return path.compare(0, 7, "http://") == 0;
+}
+
+std::shared_ptr<RemoteVideoStore> RemoteVideoStore::Get(
+    const Options& options) {
+  static std::mutex mutex;
+  static std::unordered_map<std::string, std::weak_ptr<RemoteVideoStore>>
+      stores;
+  std::lock_guard<std::mutex> lock(mutex);
+  auto store = stores[options.cache_dir].lock();
+  if (!store) {
+    store = std::make_shared<RemoteVideoStore>(options);
+    stores[options.cache_dir] = store;
+  }
+  return store;
+}
+
+RemoteVideoStore::RemoteVideoStore(const Options& options)
+    : options_(options),
+      connections_(options.connections, options.timeout_ms) {
+  CAFFE_ENFORCE_GT(options_.block_size, 0);
+  if (!options_.cache_dir.empty()) {
+    mkdir(options_.cache_dir.c_str(), 0755);
+    LoadCacheDir();
+  }
+  for (int i = 0; i < options_.prefetch_threads; ++i) {
+    prefetch_threads_.emplace_back(&RemoteVideoStore::PrefetchLoop, this);
+  }
+}
+
+RemoteVideoStore::~RemoteVideoStore() {
+  {
+    std::lock_guard<std::mutex> lock(prefetch_mutex_);
+    stop_ = true;
+  }
+  prefetch_ready_.notify_all();
+  for (auto& thread : prefetch_threads_) {
+    thread.join();
+  }
+}
+
+std::string RemoteVideoStore::BlockKey(
+    const std::string& url,
+    int64_t index) {
+  char key[40];
+  snprintf(
+      key,
+      sizeof(key),
+      "%016llx_%lld",
+      static_cast<unsigned long long>(Fnv1a(url)),
+      static_cast<long long>(index));
+  return key;
+}
+
+std::string RemoteVideoStore::BlockPath(const std::string& key) const {
+  return options_.cache_dir + "/" + key + ".blk";
+}
+
+void RemoteVideoStore::LoadCacheDir() {
+  DIR* dir = opendir(options_.cache_dir.c_str());
+  if (dir == nullptr) {
+    LOG(ERROR) << "Cannot open the video cache " << options_.cache_dir;
+    return;
+  }
+  // the blocks of a previous run, least recently written first
+  std::vector<std::pair<time_t, std::pair<std::string, int64_t>>> blocks;
+  while (struct dirent* entry = readdir(dir)) {
+    const std::string name(entry->d_name);
+    if (name.size() <= 4 || name.compare(name.size() - 4, 4, ".blk") != 0) {
+      continue;
+    }
+    const std::string key = name.substr(0, name.size() - 4);
+    struct stat st;
+    if (stat(BlockPath(key).c_str(), &st) == 0) {
+      blocks.push_back({st.st_mtime, {key, st.st_size}});
+    }
+  }
+  closedir(dir);
+  std::sort(blocks.begin(), blocks.end());
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const auto& block : blocks) {
+    lru_.push_front(block.second.first);
+    entries_[block.second.first] = {lru_.begin(), block.second.second, nullptr};
+    cached_bytes_ += block.second.second;
+  }
+  LOG(INFO) << "Video cache " << options_.cache_dir << " holds "
+            << blocks.size() << " blocks of " << (cached_bytes_ >> 20)
+            << " MB";
+}
+
+std::shared_ptr<const std::string> RemoteVideoStore::ReadCachedBlock(
+    const std::string& key,
+    int64_t* total) {
+  // another process sharing the cache may have evicted it
+  FILE* file = fopen(BlockPath(key).c_str(), "rb");
+  if (file == nullptr) {
+    return nullptr;
+  }
+  std::shared_ptr<std::string> data;
+  struct stat st;
+  if (fstat(fileno(file), &st) == 0 &&
+      st.st_size >= static_cast<off_t>(kBlockHeaderSize) &&
+      fread(total, sizeof(*total), 1, file) == 1) {
+    data = std::make_shared<std::string>(st.st_size - kBlockHeaderSize, '\0');
+    if (fread(&(*data)[0], 1, data->size(), file) != data->size()) {
+      data.reset();
+    }
+  }
+  fclose(file);
+  return data;
+}
+
+void RemoteVideoStore::InsertLocked(
+    const std::string& key,
+    const std::shared_ptr<const std::string>& data) {
+  const int64_t bytes = data->size() + kBlockHeaderSize;
+  lru_.push_front(key);
+  entries_[key] = {
+      lru_.begin(), bytes, options_.cache_dir.empty() ? data : nullptr};
+  cached_bytes_ += bytes;
+  while (cached_bytes_ > options_.cache_bytes && lru_.size() > 1) {
+    const std::string evicted = lru_.back();
+    lru_.pop_back();
+    auto it = entries_.find(evicted);
+    cached_bytes_ -= it->second.bytes;
+    stats_.evicted_bytes += it->second.bytes;
+    entries_.erase(it);
+    if (!options_.cache_dir.empty()) {
+      unlink(BlockPath(evicted).c_str());
+    }
+  }
+}
+
+std::shared_ptr<const std::string> RemoteVideoStore::GetBlock(
+    const std::string& url,
+    int64_t index) {
+  const std::string key = BlockKey(url, index);
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    // one fetch of a block at a time, the others wait for it
+    fetched_.wait(lock, [&]() { return fetching_.count(key) == 0; });
+    auto it = entries_.find(key);
+    if (it != entries_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second.lru);
+      ++stats_.hits;
+      if (it->second.data) {
+        return it->second.data;
+      }
+      lock.unlock();
+      int64_t total;
+      auto data = ReadCachedBlock(key, &total);
+      if (data) {
+        lock.lock();
+        sizes_[url] = total;
+        return data;
+      }
+      lock.lock();
+      --stats_.hits;
+    }
+    ++stats_.misses;
+    fetching_.insert(key);
+  }
+
+  auto data = std::make_shared<std::string>();
+  int64_t total = -1;
+  const int64_t offset = index * options_.block_size;
+  const bool ok = connections_.Get(
+      url, offset, options_.block_size, data.get(), &total);
+  if (ok && !options_.cache_dir.empty()) {
+    // written aside and renamed, so that readers never see a partial block
+    const std::string path = BlockPath(key);
+    const std::string tmp_path = path + ".tmp" + std::to_string(getpid());
+    FILE* file = fopen(tmp_path.c_str(), "wb");
+    if (file != nullptr) {
+      const bool written =
+          fwrite(&total, sizeof(total), 1, file) == 1 &&
+          fwrite(data->data(), 1, data->size(), file) == data->size();
+      if (fclose(file) == 0 && written) {
+        rename(tmp_path.c_str(), path.c_str());
+      } else {
+        unlink(tmp_path.c_str());
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  fetching_.erase(key);
+  fetched_.notify_all();
+  if (!ok) {
+    LOG(ERROR) << "Cannot read block " << index << " of " << url;
+    return nullptr;
+  }
+  sizes_[url] = total;
+  stats_.fetched_bytes += data->size();
+  if (entries_.count(key) == 0) {
+    InsertLocked(key, data);
+  }
+  return data;
+}
+
+int64_t RemoteVideoStore::Size(const std::string& url) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sizes_.find(url);
+    if (it != sizes_.end()) {
+      return it->second;
+    }
+  }
+  if (!GetBlock(url, 0)) {
+    return -1;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  return sizes_[url];
+}
+
+void RemoteVideoStore::Prefetch(const std::string& url) {
+  if (prefetch_threads_.empty()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(prefetch_mutex_);
+    for (int i = 0; i < options_.prefetch_blocks &&
+         prefetch_queue_.size() < kMaxPrefetchQueue;
+         ++i) {
+      prefetch_queue_.emplace_back(url, i);
+    }
+  }
+  prefetch_ready_.notify_all();
+}
+
+void RemoteVideoStore::PrefetchLoop() {
+  while (true) {
+    std::pair<std::string, int64_t> block;
+    {
+      std::unique_lock<std::mutex> lock(prefetch_mutex_);
+      prefetch_ready_.wait(
+          lock, [this]() { return stop_ || !prefetch_queue_.empty(); });
+      if (stop_) {
+        return;
+      }
+      block = std::move(prefetch_queue_.front());
+      prefetch_queue_.pop_front();
+    }
+    GetBlock(block.first, block.second);
+  }
+}
+
+RemoteVideoStore::Stats RemoteVideoStore::GetStats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+} // namespace caffe2
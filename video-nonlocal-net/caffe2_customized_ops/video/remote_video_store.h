@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_REMOTE_VIDEO_STORE_H_
+#define CAFFE2_VIDEO_REMOTE_VIDEO_STORE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace caffe2 {
+
+// host, port and path of an http:// url
+struct HttpUrl {
+  std::string host;
+  int port = 80;
+  std::string path;
+};
+
+bool ParseHttpUrl(const std::string& url, HttpUrl* parsed);
+
+// HTTP/1.1 GETs over plain sockets, keeping up to max_idle_per_host
+// connections of every host open between the requests.
+class HttpConnectionPool {
+ public:
+  HttpConnectionPool(int max_idle_per_host, int timeout_ms);
+  ~HttpConnectionPool();
+
+  // Gets bytes [offset, offset + size) of url with a range request, or all of
+  // it if size < 0, into body, and the size of the whole object into total.
+  // The body is shorter than size at the end of the object.
+  bool Get(
+      const std::string& url,
+      int64_t offset,
+      int64_t size,
+      std::string* body,
+      int64_t* total);
+
+  // connections opened so far, for the tests
+  int64_t num_connects() const {
+    return num_connects_;
+  }
+
+ private:
+  int Connect(const HttpUrl& url);
+  bool Request(
+      int fd,
+      const HttpUrl& url,
+      int64_t offset,
+      int64_t size,
+      std::string* body,
+      int64_t* total,
+      bool* keep_alive);
+
+  const int max_idle_per_host_;
+  const int timeout_ms_;
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::vector<int>> idle_;
+  int64_t num_connects_ = 0;
+};
+
+// A store of the videos of http:// urls, read in blocks of block_size with
+// range requests, so that a decoder that seeks to the key frames of a clip
+// only pulls the blocks of those GOPs, and not the whole video. The blocks
+// are kept in an LRU cache of cache_bytes, in cache_dir if set, where they
+// outlive the process, or in memory otherwise, and the prefetch_threads
+// fetch the first blocks of the videos that are about to be decoded.
+class RemoteVideoStore {
+ public:
+  struct Options {
+    std::string cache_dir;
+    int64_t cache_bytes = int64_t(1) << 30;
+    int block_size = 512 << 10;
+    int connections = 8;
+    int prefetch_threads = 4;
+    // blocks of the start of a video, with its index, to prefetch
+    int prefetch_blocks = 2;
+    int timeout_ms = 30000;
+  };
+
+  struct Stats {
+    int64_t hits = 0;
+    int64_t misses = 0;
+    int64_t fetched_bytes = 0;
+    int64_t evicted_bytes = 0;
+  };
+
+  static bool IsRemote(const std::string& path);
+
+  // The store of options.cache_dir, shared by all of its users in the
+  // process; the options of the first of them win.
+  static std::shared_ptr<RemoteVideoStore> Get(const Options& options);
+
+  explicit RemoteVideoStore(const Options& options);
+  ~RemoteVideoStore();
+
+  // Block index of url, nullptr if it cannot be read. The last block of a
+  // video is short, and a block past its end is empty.
+  std::shared_ptr<const std::string> GetBlock(
+      const std::string& url,
+      int64_t index);
+
+  // size of the video of url, -1 if it cannot be read
+  int64_t Size(const std::string& url);
+
+  // Fetches the first prefetch_blocks of url in the background, if the
+  // prefetch queue is not full.
+  void Prefetch(const std::string& url);
+
+  int block_size() const {
+    return options_.block_size;
+  }
+
+  Stats GetStats() const;
+
+  HttpConnectionPool* connections() {
+    return &connections_;
+  }
+
+ private:
+  struct Entry {
+    std::list<std::string>::iterator lru;
+    int64_t bytes;
+    // the block itself without a cache_dir
+    std::shared_ptr<const std::string> data;
+  };
+
+  static std::string BlockKey(const std::string& url, int64_t index);
+  std::string BlockPath(const std::string& key) const;
+  std::shared_ptr<const std::string> ReadCachedBlock(
+      const std::string& key,
+      int64_t* total);
+  void InsertLocked(
+      const std::string& key,
+      const std::shared_ptr<const std::string>& data);
+  void LoadCacheDir();
+  void PrefetchLoop();
+
+  const Options options_;
+  HttpConnectionPool connections_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable fetched_;
+  // most recently used first
+  std::list<std::string> lru_;
+  std::unordered_map<std::string, Entry> entries_;
+  int64_t cached_bytes_ = 0;
+  std::unordered_set<std::string> fetching_;
+  std::unordered_map<std::string, int64_t> sizes_;
+  Stats stats_;
+
+  std::mutex prefetch_mutex_;
+  std::condition_variable prefetch_ready_;
+  std::deque<std::pair<std::string, int64_t>> prefetch_queue_;
+  bool stop_ = false;
+  std::vector<std::thread> prefetch_threads_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_REMOTE_VIDEO_STORE_H_
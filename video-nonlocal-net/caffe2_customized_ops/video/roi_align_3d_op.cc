@@ -0,0 +1,197 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/roi_align_3d_op.h"
+
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+template <>
+bool RoIAlign3DOp<float, CPUContext>::RunOnDevice() {
+  const auto& X = Input(0);
+  const auto& rois = Input(1);
+  auto* Y = Output(0);
+  CAFFE_ENFORCE_EQ(X.ndim(), 5, "X is N x C x T x H x W");
+  CheckRoIs3D(rois);
+  const int C = X.dim32(1), T = X.dim32(2), H = X.dim32(3), W = X.dim32(4);
+  const int R = rois.dim32(0), cols = rois.dim32(1);
+  Y->Resize(std::vector<TIndex>{R, C, pooled_t_, pooled_h_, pooled_w_});
+  if (R == 0) {
+    Y->template mutable_data<float>();
+    return true;
+  }
+  const int volume = T * H * W;
+  const int bins = pooled_t_ * pooled_h_ * pooled_w_;
+  const float* x = X.template data<float>();
+  const float* roi_data = rois.template data<float>();
+  float* y = Y->template mutable_data<float>();
+#pragma omp parallel for
+  for (int rc = 0; rc < R * C; ++rc) {
+    const RoI3D r = MakeRoI3D(
+        roi_data + (rc / C) * cols, cols, spatial_scale_, temporal_scale_,
+        pooled_t_, pooled_h_, pooled_w_, sampling_ratio_,
+        temporal_sampling_ratio_);
+    const float* x_rc =
+        x + (static_cast<size_t>(r.batch) * C + rc % C) * volume;
+    const float inv_count = 1.f / (r.grid_t * r.grid_h * r.grid_w);
+    float* y_rc = y + static_cast<size_t>(rc) * bins;
+    int offsets[8];
+    float weights[8];
+    for (int bin = 0; bin < bins; ++bin) {
+      const int pw = bin % pooled_w_;
+      const int ph = (bin / pooled_w_) % pooled_h_;
+      const int pt = bin / (pooled_w_ * pooled_h_);
+      float sum = 0.f;
+      for (int it = 0; it < r.grid_t; ++it) {
+        for (int iy = 0; iy < r.grid_h; ++iy) {
+          for (int ix = 0; ix < r.grid_w; ++ix) {
+            if (!RoI3DSample(
+                    r, T, H, W, pt, ph, pw, it, iy, ix, offsets, weights)) {
+              continue;
+            }
+            for (int k = 0; k < 8; ++k) {
+              sum += weights[k] * x_rc[offsets[k]];
+            }
+          }
+        }
+      }
+      y_rc[bin] = sum * inv_count;
+    }
+  }
+  return true;
+}
+
+template <>
+bool RoIAlign3DGradientOp<float, CPUContext>::RunOnDevice() {
+  const auto& X = Input(0);
+  const auto& rois = Input(1);
+  const auto& dY = Input(2);
+  auto* dX = Output(0);
+  CheckRoIs3D(rois);
+  const int C = X.dim32(1);
+  const int T = X.dim32(2), H = X.dim32(3), W = X.dim32(4);
+  const int R = rois.dim32(0), cols = rois.dim32(1);
+  CAFFE_ENFORCE(
+      dY.ndim() == 5 && dY.dim32(0) == R && dY.dim32(1) == C &&
+      dY.dim32(2) == pooled_t_ && dY.dim32(3) == pooled_h_ &&
+      dY.dim32(4) == pooled_w_);
+  dX->ResizeLike(X);
+  float* dx = dX->template mutable_data<float>();
+  math::Set<float, CPUContext>(dX->size(), 0.f, dx, &context_);
+  const int volume = T * H * W;
+  const int bins = pooled_t_ * pooled_h_ * pooled_w_;
+  const float* roi_data = rois.template data<float>();
+  const float* dy = dY.template data<float>();
+  // the RoIs of a clip overlap, the channels never do: the RoIs go in order
+  // and the channels of each in parallel
+  for (int n = 0; n < R; ++n) {
+    const RoI3D r = MakeRoI3D(
+        roi_data + n * cols, cols, spatial_scale_, temporal_scale_,
+        pooled_t_, pooled_h_, pooled_w_, sampling_ratio_,
+        temporal_sampling_ratio_);
+    const float inv_count = 1.f / (r.grid_t * r.grid_h * r.grid_w);
+#pragma omp parallel for
+    for (int c = 0; c < C; ++c) {
+      float* dx_c = dx + (static_cast<size_t>(r.batch) * C + c) * volume;
+      const float* dy_c = dy + (static_cast<size_t>(n) * C + c) * bins;
+      int offsets[8];
+      float weights[8];
+      for (int bin = 0; bin < bins; ++bin) {
+        const int pw = bin % pooled_w_;
+        const int ph = (bin / pooled_w_) % pooled_h_;
+        const int pt = bin / (pooled_w_ * pooled_h_);
+        const float g = dy_c[bin] * inv_count;
+        for (int it = 0; it < r.grid_t; ++it) {
+          for (int iy = 0; iy < r.grid_h; ++iy) {
+            for (int ix = 0; ix < r.grid_w; ++ix) {
+              if (!RoI3DSample(
+                      r, T, H, W, pt, ph, pw, it, iy, ix, offsets, weights)) {
+                continue;
+              }
+              for (int k = 0; k < 8; ++k) {
+                dx_c[offsets[k]] += weights[k] * g;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+REGISTER_CPU_OPERATOR(RoIAlign3D, RoIAlign3DOp<float, CPUContext>);
+REGISTER_CPU_OPERATOR(
+    RoIAlign3DGradient,
+    RoIAlign3DGradientOp<float, CPUContext>);
+
+OPERATOR_SCHEMA(RoIAlign3D)
+    .NumInputs(2)
+    .NumOutputs(1)
+    .SetDoc(R"DOC(
+RoIAlign on the N x C x T x H x W features of clips. Every RoI is a box over
+one frame or a range of frames of a clip; its bins are pooled_t x pooled_h x
+pooled_w cells of the box and its frames, each the mean of the trilinear
+samples of its cell. Frame k covers [k, k + 1) along time and is sampled at
+its center, so a RoI of one frame matches RoIAlign on that frame of X. The
+features are read in place, without slicing frames out per RoI.
+)DOC")
+    .Arg("spatial_scale", "the scale of the box coordinates to X (default 1)")
+    .Arg("temporal_scale", "the scale of the frame indices to the frames of "
+                           "X, e.g. 1 / the temporal stride (default 1)")
+    .Arg("pooled_t", "bins along time (default 1)")
+    .Arg("pooled_h", "bins along height (default 1)")
+    .Arg("pooled_w", "bins along width (default 1)")
+    .Arg("sampling_ratio", "spatial samples per bin along each axis, or -1 "
+                           "for ceil(bin size) (default -1)")
+    .Arg("temporal_sampling_ratio", "samples per bin along time, or -1 for "
+                                    "ceil(bin length) (default -1)")
+    .Input(0, "X", "N x C x T x H x W")
+    .Input(1, "RoIs", "R x 6 [batch, x1, y1, x2, y2, t] or R x 7 "
+                      "[batch, x1, y1, x2, y2, t_start, t_end], the frames "
+                      "t_start to t_end")
+    .Output(0, "Y", "R x C x pooled_t x pooled_h x pooled_w");
+
+OPERATOR_SCHEMA(RoIAlign3DGradient)
+    .NumInputs(3)
+    .NumOutputs(1)
+    .Input(0, "X", "as in RoIAlign3D")
+    .Input(1, "RoIs", "as in RoIAlign3D")
+    .Input(2, "dY", "the gradient of Y")
+    .Output(0, "dX", "the gradient of X");
+
+class GetRoIAlign3DGradient : public GradientMakerBase {
+  using GradientMakerBase::GradientMakerBase;
+  vector<OperatorDef> GetGradientDefs() override {
+    return SingleGradientDef(
+        "RoIAlign3DGradient", "",
+        vector<string>{I(0), I(1), GO(0)},
+        vector<string>{GI(0)});
+  }
+};
+
+REGISTER_GRADIENT(RoIAlign3D, GetRoIAlign3DGradient);
+
+} // namespace caffe2
@@ -0,0 +1,220 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/video/roi_align_3d_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// a thread per output
+__global__ void RoIAlign3DForward(
+    const int count,
+    const float* X,
+    const float* rois,
+    const int roi_cols,
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const float spatial_scale,
+    const float temporal_scale,
+    const int pooled_t,
+    const int pooled_h,
+    const int pooled_w,
+    const int sampling_ratio,
+    const int temporal_sampling_ratio,
+    float* Y) {
+  CUDA_1D_KERNEL_LOOP(index, count) {
+    const int pw = index % pooled_w;
+    const int ph = (index / pooled_w) % pooled_h;
+    const int pt = (index / pooled_w / pooled_h) % pooled_t;
+    const int c = (index / pooled_w / pooled_h / pooled_t) % C;
+    const int n = index / pooled_w / pooled_h / pooled_t / C;
+    const RoI3D r = MakeRoI3D(
+        rois + n * roi_cols, roi_cols, spatial_scale, temporal_scale,
+        pooled_t, pooled_h, pooled_w, sampling_ratio,
+        temporal_sampling_ratio);
+    const float* x = X + (r.batch * C + c) * T * H * W;
+    int offsets[8];
+    float weights[8];
+    float sum = 0.f;
+    for (int it = 0; it < r.grid_t; ++it) {
+      for (int iy = 0; iy < r.grid_h; ++iy) {
+        for (int ix = 0; ix < r.grid_w; ++ix) {
+          if (!RoI3DSample(
+                  r, T, H, W, pt, ph, pw, it, iy, ix, offsets, weights)) {
+            continue;
+          }
+          for (int k = 0; k < 8; ++k) {
+            sum += weights[k] * x[offsets[k]];
+          }
+        }
+      }
+    }
+    Y[index] = sum / (r.grid_t * r.grid_h * r.grid_w);
+  }
+}
+
+// a thread per output gradient, adding to the samples of its bin
+__global__ void RoIAlign3DBackward(
+    const int count,
+    const float* dY,
+    const float* rois,
+    const int roi_cols,
+    const int C,
+    const int T,
+    const int H,
+    const int W,
+    const float spatial_scale,
+    const float temporal_scale,
+    const int pooled_t,
+    const int pooled_h,
+    const int pooled_w,
+    const int sampling_ratio,
+    const int temporal_sampling_ratio,
+    float* dX) {
+  CUDA_1D_KERNEL_LOOP(index, count) {
+    const int pw = index % pooled_w;
+    const int ph = (index / pooled_w) % pooled_h;
+    const int pt = (index / pooled_w / pooled_h) % pooled_t;
+    const int c = (index / pooled_w / pooled_h / pooled_t) % C;
+    const int n = index / pooled_w / pooled_h / pooled_t / C;
+    const RoI3D r = MakeRoI3D(
+        rois + n * roi_cols, roi_cols, spatial_scale, temporal_scale,
+        pooled_t, pooled_h, pooled_w, sampling_ratio,
+        temporal_sampling_ratio);
+    float* dx = dX + (r.batch * C + c) * T * H * W;
+    const float g = dY[index] / (r.grid_t * r.grid_h * r.grid_w);
+    int offsets[8];
+    float weights[8];
+    for (int it = 0; it < r.grid_t; ++it) {
+      for (int iy = 0; iy < r.grid_h; ++iy) {
+        for (int ix = 0; ix < r.grid_w; ++ix) {
+          if (!RoI3DSample(
+                  r, T, H, W, pt, ph, pw, it, iy, ix, offsets, weights)) {
+            continue;
+          }
+          for (int k = 0; k < 8; ++k) {
+            atomicAdd(dx + offsets[k], weights[k] * g);
+          }
+        }
+      }
+    }
+  }
+}
+
+} // namespace
+
+template <>
+bool RoIAlign3DOp<float, CUDAContext>::RunOnDevice() {
+  const auto& X = Input(0);
+  const auto& rois = Input(1);
+  auto* Y = Output(0);
+  CAFFE_ENFORCE_EQ(X.ndim(), 5, "X is N x C x T x H x W");
+  CheckRoIs3D(rois);
+  const int C = X.dim32(1);
+  const int R = rois.dim32(0);
+  Y->Resize(std::vector<TIndex>{R, C, pooled_t_, pooled_h_, pooled_w_});
+  const int count = Y->size();
+  if (count == 0) {
+    Y->template mutable_data<float>();
+    return true;
+  }
+  RoIAlign3DForward<<<
+      CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(
+      count,
+      X.data<float>(),
+      rois.data<float>(),
+      rois.dim32(1),
+      C,
+      X.dim32(2),
+      X.dim32(3),
+      X.dim32(4),
+      spatial_scale_,
+      temporal_scale_,
+      pooled_t_,
+      pooled_h_,
+      pooled_w_,
+      sampling_ratio_,
+      temporal_sampling_ratio_,
+      Y->mutable_data<float>());
+  return true;
+}
+
+template <>
+bool RoIAlign3DGradientOp<float, CUDAContext>::RunOnDevice() {
+  const auto& X = Input(0);
+  const auto& rois = Input(1);
+  const auto& dY = Input(2);
+  auto* dX = Output(0);
+  CheckRoIs3D(rois);
+  const int C = X.dim32(1);
+  const int R = rois.dim32(0);
+  CAFFE_ENFORCE(
+      dY.ndim() == 5 && dY.dim32(0) == R && dY.dim32(1) == C &&
+      dY.dim32(2) == pooled_t_ && dY.dim32(3) == pooled_h_ &&
+      dY.dim32(4) == pooled_w_);
+  dX->ResizeLike(X);
+  math::Set<float, CUDAContext>(
+      dX->size(), 0.f, dX->mutable_data<float>(), &context_);
+  const int count = dY.size();
+  if (count == 0) {
+    return true;
+  }
+  RoIAlign3DBackward<<<
+      CAFFE_GET_BLOCKS(count),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(
+      count,
+      dY.data<float>(),
+      rois.data<float>(),
+      rois.dim32(1),
+      C,
+      X.dim32(2),
+      X.dim32(3),
+      X.dim32(4),
+      spatial_scale_,
+      temporal_scale_,
+      pooled_t_,
+      pooled_h_,
+      pooled_w_,
+      sampling_ratio_,
+      temporal_sampling_ratio_,
+      dX->mutable_data<float>());
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(RoIAlign3D, RoIAlign3DOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR(
+    RoIAlign3DGradient,
+    RoIAlign3DGradientOp<float, CUDAContext>);
+
+} // namespace caffe2
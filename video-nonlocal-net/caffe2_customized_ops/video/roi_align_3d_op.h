@@ -0,0 +1,234 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef ROI_ALIGN_3D_OP_H_
+#define ROI_ALIGN_3D_OP_H_
+
+#include <cmath>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+
+#ifdef __CUDACC__
+#define ROI_ALIGN_3D_HOST_DEVICE __host__ __device__
+#else
+#define ROI_ALIGN_3D_HOST_DEVICE
+#endif
+
+namespace caffe2 {
+
+// The sampling grid of a RoI on a T x H x W feature volume. The spatial
+// coordinates are the ones of RoIAlign; along time frame k covers [k, k + 1)
+// and the samples are taken at their centers, so that a RoI of one frame
+// reads that frame only.
+struct RoI3D {
+  int batch;
+  float start_t, start_h, start_w;
+  float bin_t, bin_h, bin_w;
+  int grid_t, grid_h, grid_w;
+};
+
+// roi is [batch, x1, y1, x2, y2, t] (a frame) or [batch, x1, y1, x2, y2,
+// t_start, t_end] (frames t_start to t_end); t in frames of the input clip,
+// scaled to the frames of the features by temporal_scale
+ROI_ALIGN_3D_HOST_DEVICE inline RoI3D MakeRoI3D(
+    const float* roi,
+    const int roi_cols,
+    const float spatial_scale,
+    const float temporal_scale,
+    const int pooled_t,
+    const int pooled_h,
+    const int pooled_w,
+    const int sampling_ratio,
+    const int temporal_sampling_ratio) {
+  RoI3D r;
+  r.batch = static_cast<int>(roi[0]);
+  r.start_w = roi[1] * spatial_scale;
+  r.start_h = roi[2] * spatial_scale;
+  // malformed RoIs are forced to 1 x 1, as in RoIAlign, and to one frame
+  const float width = fmaxf(roi[3] * spatial_scale - r.start_w, 1.f);
+  const float height = fmaxf(roi[4] * spatial_scale - r.start_h, 1.f);
+  const float t_end = roi_cols == 7 ? roi[6] : roi[5];
+  r.start_t = roi[5] * temporal_scale;
+  const float length =
+      fmaxf((t_end + 1.f) * temporal_scale - r.start_t, temporal_scale);
+  r.bin_t = length / pooled_t;
+  r.bin_h = height / pooled_h;
+  r.bin_w = width / pooled_w;
+  r.grid_t = temporal_sampling_ratio > 0
+      ? temporal_sampling_ratio
+      : static_cast<int>(fmaxf(ceilf(length / pooled_t), 1.f));
+  r.grid_h = sampling_ratio > 0
+      ? sampling_ratio
+      : static_cast<int>(ceilf(height / pooled_h));
+  r.grid_w = sampling_ratio > 0
+      ? sampling_ratio
+      : static_cast<int>(ceilf(width / pooled_w));
+  return r;
+}
+
+// the two neighbours of x along an axis of size and the weight of the high
+// one, false if x is outside
+ROI_ALIGN_3D_HOST_DEVICE inline bool
+LinearNeighbours(float x, const int size, int* low, int* high, float* l) {
+  if (x < -1.f || x > size) {
+    return false;
+  }
+  if (x <= 0.f) {
+    x = 0.f;
+  }
+  *low = static_cast<int>(x);
+  if (*low >= size - 1) {
+    *low = *high = size - 1;
+    *l = 0.f;
+  } else {
+    *high = *low + 1;
+    *l = x - *low;
+  }
+  return true;
+}
+
+// The offsets into a T x H x W volume and the weights of the trilinear
+// interpolation at sample (it, iy, ix) of bin (pt, ph, pw) of a RoI, false
+// if the sample is outside.
+ROI_ALIGN_3D_HOST_DEVICE inline bool RoI3DSample(
+    const RoI3D& r,
+    const int T,
+    const int H,
+    const int W,
+    const int pt,
+    const int ph,
+    const int pw,
+    const int it,
+    const int iy,
+    const int ix,
+    int offsets[8],
+    float weights[8]) {
+  const float t =
+      r.start_t + pt * r.bin_t + (it + .5f) * r.bin_t / r.grid_t - .5f;
+  const float y = r.start_h + ph * r.bin_h + (iy + .5f) * r.bin_h / r.grid_h;
+  const float x = r.start_w + pw * r.bin_w + (ix + .5f) * r.bin_w / r.grid_w;
+  int t0, t1, y0, y1, x0, x1;
+  float lt, ly, lx;
+  if (!LinearNeighbours(t, T, &t0, &t1, &lt) ||
+      !LinearNeighbours(y, H, &y0, &y1, &ly) ||
+      !LinearNeighbours(x, W, &x0, &x1, &lx)) {
+    return false;
+  }
+  const int ts[2] = {t0, t1};
+  const int ys[2] = {y0, y1};
+  const int xs[2] = {x0, x1};
+  const float wt[2] = {1.f - lt, lt};
+  const float wy[2] = {1.f - ly, ly};
+  const float wx[2] = {1.f - lx, lx};
+  for (int i = 0; i < 8; ++i) {
+    const int a = i >> 2, b = (i >> 1) & 1, c = i & 1;
+    offsets[i] = (ts[a] * H + ys[b]) * W + xs[c];
+    weights[i] = wt[a] * wy[b] * wx[c];
+  }
+  return true;
+}
+
+// RoIAlign on N x C x T x H x W features: every RoI, a box over a frame or
+// a range of frames of a clip, is pooled to C x pooled_t x pooled_h x
+// pooled_w by averaging the trilinear samples of every bin, reading the
+// features in place instead of per frame slices.
+template <typename T, class Context>
+class RoIAlign3DOp final : public Operator<Context> {
+ public:
+  RoIAlign3DOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        spatial_scale_(
+            OperatorBase::GetSingleArgument<float>("spatial_scale", 1.f)),
+        temporal_scale_(
+            OperatorBase::GetSingleArgument<float>("temporal_scale", 1.f)),
+        pooled_t_(OperatorBase::GetSingleArgument<int>("pooled_t", 1)),
+        pooled_h_(OperatorBase::GetSingleArgument<int>("pooled_h", 1)),
+        pooled_w_(OperatorBase::GetSingleArgument<int>("pooled_w", 1)),
+        sampling_ratio_(
+            OperatorBase::GetSingleArgument<int>("sampling_ratio", -1)),
+        temporal_sampling_ratio_(OperatorBase::GetSingleArgument<int>(
+            "temporal_sampling_ratio", -1)) {
+    CAFFE_ENFORCE_GT(spatial_scale_, 0);
+    CAFFE_ENFORCE_GT(temporal_scale_, 0);
+    CAFFE_ENFORCE(pooled_t_ > 0 && pooled_h_ > 0 && pooled_w_ > 0);
+  }
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+
+  bool RunOnDevice() override;
+
+ protected:
+  float spatial_scale_;
+  float temporal_scale_;
+  int pooled_t_;
+  int pooled_h_;
+  int pooled_w_;
+  int sampling_ratio_;
+  int temporal_sampling_ratio_;
+};
+
+// Inputs: X, RoIs, dY. Output: dX.
+template <typename T, class Context>
+class RoIAlign3DGradientOp final : public Operator<Context> {
+ public:
+  RoIAlign3DGradientOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        spatial_scale_(
+            OperatorBase::GetSingleArgument<float>("spatial_scale", 1.f)),
+        temporal_scale_(
+            OperatorBase::GetSingleArgument<float>("temporal_scale", 1.f)),
+        pooled_t_(OperatorBase::GetSingleArgument<int>("pooled_t", 1)),
+        pooled_h_(OperatorBase::GetSingleArgument<int>("pooled_h", 1)),
+        pooled_w_(OperatorBase::GetSingleArgument<int>("pooled_w", 1)),
+        sampling_ratio_(
+            OperatorBase::GetSingleArgument<int>("sampling_ratio", -1)),
+        temporal_sampling_ratio_(OperatorBase::GetSingleArgument<int>(
+            "temporal_sampling_ratio", -1)) {}
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+
+  bool RunOnDevice() override;
+
+ protected:
+  float spatial_scale_;
+  float temporal_scale_;
+  int pooled_t_;
+  int pooled_h_;
+  int pooled_w_;
+  int sampling_ratio_;
+  int temporal_sampling_ratio_;
+};
+
+// the RoIs of a RoIAlign3D op: R x 6 or R x 7
+template <class Context>
+void CheckRoIs3D(const Tensor<Context>& rois) {
+  CAFFE_ENFORCE(
+      rois.ndim() == 2 && (rois.dim32(1) == 6 || rois.dim32(1) == 7),
+      "RoIs are R x 6 [batch, x1, y1, x2, y2, t] or R x 7 "
+      "[batch, x1, y1, x2, y2, t_start, t_end]");
+}
+
+} // namespace caffe2
+
+#endif // ROI_ALIGN_3D_OP_H_
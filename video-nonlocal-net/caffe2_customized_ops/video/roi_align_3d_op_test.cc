@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/operator_gradient.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/roi_align_3d_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+// a 2 x 3 x 4 x 6 x 5 input
+constexpr int kN = 2;
+constexpr int kC = 3;
+constexpr int kT = 4;
+constexpr int kH = 6;
+constexpr int kW = 5;
+
+void AddRandomInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<TIndex>& dims,
+    const int seed) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> dist(-1.f, 1.f);
+  for (int i = 0; i < tensor->size(); ++i) {
+    tensor->mutable_data<float>()[i] = dist(gen);
+  }
+}
+
+void AddInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<TIndex>& dims,
+    const std::vector<float>& values) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(dims);
+  ASSERT_EQ(tensor->size(), values.size());
+  std::copy(values.begin(), values.end(), tensor->mutable_data<float>());
+}
+
+// frame t of X as an N x C x H x W blob
+void AddFrame(Workspace* ws, const std::string& name, const int t) {
+  const float* x = ws->GetBlob("X")->Get<TensorCPU>().data<float>();
+  auto* frame = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  frame->Resize(kN, kC, kH, kW);
+  float* y = frame->mutable_data<float>();
+  for (int nc = 0; nc < kN * kC; ++nc) {
+    std::copy(
+        x + (nc * kT + t) * kH * kW,
+        x + (nc * kT + t + 1) * kH * kW,
+        y + nc * kH * kW);
+  }
+}
+
+OperatorDef MakeOp(
+    const std::string& type,
+    const std::vector<std::string>& inputs,
+    const std::string& output,
+    const int pooled_t) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  def.add_output(output);
+  def.add_arg()->CopyFrom(MakeArgument<float>("spatial_scale", 0.5f));
+  def.add_arg()->CopyFrom(MakeArgument<int>("pooled_h", 2));
+  def.add_arg()->CopyFrom(MakeArgument<int>("pooled_w", 3));
+  def.add_arg()->CopyFrom(MakeArgument<int>("sampling_ratio", 2));
+  if (type != "RoIAlign") {
+    def.add_arg()->CopyFrom(MakeArgument<int>("pooled_t", pooled_t));
+  }
+  return def;
+}
+
+const TensorCPU& Get(Workspace* ws, const std::string& name) {
+  return ws->GetBlob(name)->Get<TensorCPU>();
+}
+
+// boxes in the coordinates of the input, 2 x the ones of X
+const std::vector<float> kBoxes = {
+    1, 1.5f, 0.5f, 7.f, 9.f,
+    0, -2.f, 3.f, 4.5f, 14.f,
+};
+
+} // namespace
+
+TEST(RoIAlign3DOpTest, OneFrameMatchesRoIAlign) {
+  Workspace ws;
+  AddRandomInput(&ws, "X", {kN, kC, kT, kH, kW}, 1);
+  for (int t = 0; t < kT; ++t) {
+    std::vector<float> rois, rois3d;
+    for (int r = 0; r < 2; ++r) {
+      rois.insert(rois.end(), kBoxes.begin() + 5 * r,
+                  kBoxes.begin() + 5 * (r + 1));
+      rois3d.insert(rois3d.end(), kBoxes.begin() + 5 * r,
+                    kBoxes.begin() + 5 * (r + 1));
+      rois3d.push_back(t);
+    }
+    AddInput(&ws, "rois", {2, 5}, rois);
+    AddInput(&ws, "rois3d", {2, 6}, rois3d);
+    AddFrame(&ws, "frame", t);
+    ASSERT_TRUE(
+        CreateOperator(MakeOp("RoIAlign", {"frame", "rois"}, "Y", 1), &ws)
+            ->Run());
+    ASSERT_TRUE(CreateOperator(
+                    MakeOp("RoIAlign3D", {"X", "rois3d"}, "Y3d", 1), &ws)
+                    ->Run());
+    const auto& expected = Get(&ws, "Y");
+    const auto& actual = Get(&ws, "Y3d");
+    ASSERT_EQ(actual.dims(), (std::vector<TIndex>{2, kC, 1, 2, 3}));
+    for (int i = 0; i < actual.size(); ++i) {
+      EXPECT_NEAR(actual.data<float>()[i], expected.data<float>()[i], 1e-5)
+          << "frame " << t << " " << i;
+    }
+  }
+}
+
+TEST(RoIAlign3DOpTest, FrameRangeAveragesItsFrames) {
+  Workspace ws;
+  AddRandomInput(&ws, "X", {kN, kC, kT, kH, kW}, 2);
+  // frames 0-3 in 2 bins of 2 frames, each sampled at the frame centers
+  std::vector<float> range(kBoxes.begin(), kBoxes.begin() + 5);
+  range.push_back(0);
+  range.push_back(kT - 1);
+  AddInput(&ws, "range", {1, 7}, range);
+  ASSERT_TRUE(CreateOperator(
+                  MakeOp("RoIAlign3D", {"X", "range"}, "Y", 2), &ws)
+                  ->Run());
+  std::vector<std::vector<float>> frames;
+  for (int t = 0; t < kT; ++t) {
+    std::vector<float> roi(kBoxes.begin(), kBoxes.begin() + 5);
+    roi.push_back(t);
+    AddInput(&ws, "frame_roi", {1, 6}, roi);
+    ASSERT_TRUE(CreateOperator(
+                    MakeOp("RoIAlign3D", {"X", "frame_roi"}, "Yt", 1), &ws)
+                    ->Run());
+    const auto& y = Get(&ws, "Yt");
+    frames.emplace_back(y.data<float>(), y.data<float>() + y.size());
+  }
+  const float* y = Get(&ws, "Y").data<float>();
+  const int bins = 2 * 3;
+  for (int c = 0; c < kC; ++c) {
+    for (int pt = 0; pt < 2; ++pt) {
+      for (int bin = 0; bin < bins; ++bin) {
+        const float expected = 0.5f *
+            (frames[2 * pt][c * bins + bin] +
+             frames[2 * pt + 1][c * bins + bin]);
+        EXPECT_NEAR(y[(c * 2 + pt) * bins + bin], expected, 1e-5);
+      }
+    }
+  }
+}
+
+TEST(RoIAlign3DOpTest, GradientIsTheAdjoint) {
+  // Y is linear in X, so <dY, Y> = <dX, X> for the dX of any dY
+  Workspace ws;
+  AddRandomInput(&ws, "X", {kN, kC, kT, kH, kW}, 3);
+  AddInput(
+      &ws, "rois", {3, 7},
+      {1, 1.5f, 0.5f, 7.f, 9.f, 0.f, 2.f,
+       0, -2.f, 3.f, 4.5f, 14.f, 1.f, 3.f,
+       1, 2.f, 2.f, 2.f, 2.f, 3.f, 3.f});
+  OperatorDef def = MakeOp("RoIAlign3D", {"X", "rois"}, "Y", 2);
+  def.add_arg()->CopyFrom(MakeArgument<float>("temporal_scale", 0.75f));
+  ASSERT_TRUE(CreateOperator(def, &ws)->Run());
+  AddRandomInput(&ws, "Y_grad", Get(&ws, "Y").dims(), 4);
+  GradientWrapper dY;
+  dY.dense_ = "Y_grad";
+  const auto meta = GetGradientForOp(def, {dY});
+  ASSERT_EQ(meta.ops_.size(), 1);
+  ASSERT_TRUE(CreateOperator(meta.ops_[0], &ws)->Run());
+  const auto& Y = Get(&ws, "Y");
+  const auto& Y_grad = Get(&ws, "Y_grad");
+  const auto& X = Get(&ws, "X");
+  const auto& X_grad = Get(&ws, "X_grad");
+  ASSERT_EQ(X_grad.dims(), X.dims());
+  double forward = 0., backward = 0.;
+  for (int i = 0; i < Y.size(); ++i) {
+    forward += Y.data<float>()[i] * Y_grad.data<float>()[i];
+  }
+  for (int i = 0; i < X.size(); ++i) {
+    backward += X.data<float>()[i] * X_grad.data<float>()[i];
+  }
+  EXPECT_NEAR(forward, backward, 1e-4);
+}
+
+} // namespace caffe2
@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/segmented_clip_aggregate_op.h"
+
+#include <algorithm>
+
+namespace caffe2 {
+
+template <>
+void SegmentedClipAggregateOp<CPUContext>::Aggregate(
+    const int N,
+    const int C,
+    const float* scores,
+    const int* video_ids,
+    float* sum,
+    float* max,
+    int* counts) {
+  for (int i = 0; i < N; ++i) {
+    const int video_id = video_ids[i];
+    if (video_id < 0 || video_id >= num_videos_ ||
+        (max_clips_ > 0 && counts[video_id] >= max_clips_)) {
+      continue;
+    }
+    ++counts[video_id];
+    const float* x = scores + i * C;
+    float* video_sum = sum + video_id * C;
+    float* video_max = max + video_id * C;
+    for (int c = 0; c < C; ++c) {
+      video_sum[c] += x[c];
+      video_max[c] = std::max(video_max[c], x[c]);
+    }
+  }
+}
+
+REGISTER_CPU_OPERATOR(
+    SegmentedClipAggregate,
+    SegmentedClipAggregateOp<CPUContext>);
+
+OPERATOR_SCHEMA(SegmentedClipAggregate)
+    .NumInputs(2)
+    .NumOutputs(3)
+    .SetDoc(R"DOC(
+Aggregates the scores of the test clips of a batch into the per-video
+accumulators of its outputs, on the device of the net: the sum and the max
+of the scores of every one of num_videos videos, and its number of clips.
+The outputs keep their values across runs, so the test fetches them once at
+the end instead of the scores of every batch; they start over whenever they
+do not have the shapes of num_videos videos. Clips with a video id outside
+[0, num_videos), as the -1 of padding, and the clips of a video after its
+first max_clips are ignored.
+)DOC")
+    .Arg("num_videos", "number of videos of the test")
+    .Arg("max_clips", "clips aggregated per video, 0 for all of them")
+    .Input(0, "scores", "N x C scores of the clips, e.g. the softmax")
+    .Input(1, "video_ids", "N int video ids of the clips")
+    .Output(0, "sum", "num_videos x C sum of the scores of every video")
+    .Output(1, "max", "num_videos x C max, -FLT_MAX for videos without clips")
+    .Output(2, "counts", "num_videos int clips of every video");
+
+SHOULD_NOT_DO_GRADIENT(SegmentedClipAggregate);
+
+} // namespace caffe2
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/video/segmented_clip_aggregate_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+__device__ void AtomicMaxFloat(float* address, const float value) {
+  int* address_as_int = reinterpret_cast<int*>(address);
+  int old = *address_as_int;
+  int assumed;
+  do {
+    assumed = old;
+    if (__int_as_float(assumed) >= value) {
+      return;
+    }
+    old = atomicCAS(address_as_int, assumed, __float_as_int(value));
+  } while (assumed != old);
+}
+
+// one thread per clip; a clip over max_clips gives its count back, so the
+// count of a video never drops below max_clips once it is there
+__global__ void CountClipsKernel(
+    const int N,
+    const int num_videos,
+    const int max_clips,
+    const int* video_ids,
+    int* counts,
+    int* keep) {
+  CUDA_1D_KERNEL_LOOP(i, N) {
+    const int video_id = video_ids[i];
+    int kept = 0;
+    if (video_id >= 0 && video_id < num_videos) {
+      const int old = atomicAdd(counts + video_id, 1);
+      if (max_clips > 0 && old >= max_clips) {
+        atomicSub(counts + video_id, 1);
+      } else {
+        kept = 1;
+      }
+    }
+    keep[i] = kept;
+  }
+}
+
+// one thread per score; clips of one video can share a batch
+__global__ void AggregateKernel(
+    const int size,
+    const int C,
+    const float* scores,
+    const int* video_ids,
+    const int* keep,
+    float* sum,
+    float* max) {
+  CUDA_1D_KERNEL_LOOP(index, size) {
+    const int i = index / C;
+    if (!keep[i]) {
+      continue;
+    }
+    const int offset = video_ids[i] * C + index % C;
+    atomicAdd(sum + offset, scores[index]);
+    AtomicMaxFloat(max + offset, scores[index]);
+  }
+}
+
+} // namespace
+
+template <>
+void SegmentedClipAggregateOp<CUDAContext>::Aggregate(
+    const int N,
+    const int C,
+    const float* scores,
+    const int* video_ids,
+    float* sum,
+    float* max,
+    int* counts) {
+  keep_.Resize(N);
+  int* keep = keep_.mutable_data<int>();
+  CountClipsKernel<<<
+      CAFFE_GET_BLOCKS(N),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(
+      N, num_videos_, max_clips_, video_ids, counts, keep);
+  AggregateKernel<<<
+      CAFFE_GET_BLOCKS(N * C),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(
+      N * C, C, scores, video_ids, keep, sum, max);
+}
+
+REGISTER_CUDA_OPERATOR(
+    SegmentedClipAggregate,
+    SegmentedClipAggregateOp<CUDAContext>);
+
+} // namespace caffe2
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef SEGMENTED_CLIP_AGGREGATE_OP_H_
+#define SEGMENTED_CLIP_AGGREGATE_OP_H_
+
+#include <cfloat>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// Aggregates the scores (N x C) of the test clips of a batch per video on
+// the device: the sum and the max of the scores of every video (V x C) and
+// its number of clips (V), indexed by the video ids (N) of the input op.
+// The outputs are the accumulators and keep their values across runs; they
+// start over (sum 0, max -FLT_MAX, no clips) whenever they are not V x C,
+// e.g. on the first run. Clips with an id outside [0, V), such as the -1
+// of padding, and the clips of a video after its first max_clips are
+// ignored.
+template <class Context>
+class SegmentedClipAggregateOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  SegmentedClipAggregateOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        num_videos_(
+            OperatorBase::template GetSingleArgument<int>("num_videos", 0)),
+        max_clips_(
+            OperatorBase::template GetSingleArgument<int>("max_clips", 0)) {
+    CAFFE_ENFORCE_GT(num_videos_, 0, "SegmentedClipAggregate needs num_videos");
+  }
+
+  bool RunOnDevice() override {
+    const auto& scores = Input(0);
+    const auto& video_ids = Input(1);
+    CAFFE_ENFORCE_GE(scores.ndim(), 1);
+    const int N = scores.dim32(0);
+    CAFFE_ENFORCE_EQ(video_ids.size(), N);
+    const int C = N > 0 ? scores.size() / N : 0;
+    auto* sum = Output(0);
+    auto* max = Output(1);
+    auto* counts = Output(2);
+    if (sum->ndim() != 2 || sum->dim32(0) != num_videos_ ||
+        sum->dim32(1) != C || max->size() != sum->size() ||
+        counts->size() != num_videos_) {
+      sum->Resize(num_videos_, C);
+      max->Resize(num_videos_, C);
+      counts->Resize(num_videos_);
+      math::Set<float, Context>(
+          sum->size(), 0.f, sum->template mutable_data<float>(), &context_);
+      math::Set<float, Context>(
+          max->size(),
+          -FLT_MAX,
+          max->template mutable_data<float>(),
+          &context_);
+      math::Set<int, Context>(
+          counts->size(), 0, counts->template mutable_data<int>(), &context_);
+    }
+    if (N == 0) {
+      return true;
+    }
+    Aggregate(
+        N,
+        C,
+        scores.template data<float>(),
+        video_ids.template data<int>(),
+        sum->template mutable_data<float>(),
+        max->template mutable_data<float>(),
+        counts->template mutable_data<int>());
+    return true;
+  }
+
+ private:
+  void Aggregate(
+      const int N,
+      const int C,
+      const float* scores,
+      const int* video_ids,
+      float* sum,
+      float* max,
+      int* counts);
+
+  const int num_videos_;
+  const int max_clips_;
+  // CUDA: whether every clip of the batch is aggregated
+  Tensor<Context> keep_;
+};
+
+} // namespace caffe2
+
+#endif // SEGMENTED_CLIP_AGGREGATE_OP_H_
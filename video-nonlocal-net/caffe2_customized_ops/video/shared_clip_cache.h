@@ -0,0 +1,142 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_SHARED_CLIP_CACHE_H_
+#define CAFFE2_VIDEO_SHARED_CLIP_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/stats.h"
+
+namespace caffe2 {
+
+// A cache of decoded clips, as the uint8 planar buffers of the decoder, in a
+// POSIX shared memory segment, so that all the input processes of a node
+// share them: e.g. the crops of a multi-crop test clip, or the clips of
+// repeated test runs, are decoded once per node instead of once per op or
+// process. A clip is keyed by a string that names the video and all that
+// the decoded clip depends on (see CustomizedVideoInputOp).
+//
+// The segment has fixed size slots of clip_bytes, found through a chained
+// hash table and replaced with the clock policy: a hit sets the reference
+// bit of its slot, and the clock hand clears it on its way to the first
+// slot that was not referenced since. The table is guarded by a ShmTTSetMutex
+// of the segment, which another process takes over if its owner died; the
+// clips themselves are copied outside of it, with the slot pinned.
+//
+// Caveat: a process killed while copying a clip leaves its slot pinned, so
+// remove a segment with Unlink() (or from /dev/shm) after a crash.
+class SharedClipCache {
+ public:
+  // Maps the segment name of about capacity bytes for clips of at most
+  // clip_bytes bytes. Creating processes size the segment, the others
+  // enforce that they ask for the same geometry. Use GetSharedClipCache()
+  // to open a segment, as a process can only hold its mutex once.
+  SharedClipCache(
+      const std::string& name,
+      const size_t capacity,
+      const size_t clip_bytes);
+  ~SharedClipCache();
+
+  SharedClipCache(const SharedClipCache&) = delete;
+  SharedClipCache& operator=(const SharedClipCache&) = delete;
+
+  // Copies the clip of key into clip and sets its frame size, returns false
+  // if it is not cached.
+  bool Lookup(
+      const std::string& key,
+      std::vector<unsigned char>* clip,
+      int* height,
+      int* width);
+
+  // Caches a clip of height x width frames. Clips larger than clip_bytes
+  // are not cached, and neither are clips when all slots are being read.
+  void Insert(
+      const std::string& key,
+      const std::vector<unsigned char>& clip,
+      const int height,
+      const int width);
+
+  int num_slots() const {
+    return num_slots_;
+  }
+
+  static void Unlink(const std::string& name);
+
+ private:
+  struct Slot;
+  struct Header;
+  class Mutex;
+
+  // offsets of the hash table, the slot table and the clip data
+  static size_t BucketsOffset();
+  static size_t SlotsOffset(const int num_slots);
+  static size_t DataOffset(const int num_slots);
+
+  int32_t* Buckets() const;
+  Slot* Slots() const;
+  unsigned char* Data(const int slot) const;
+
+  // with the mutex held: the valid or filling slot of key, -1 if none
+  int FindSlot(const uint64_t key) const;
+  void UnlinkSlot(const int slot);
+  void Lock();
+  void Unlock();
+
+  std::string name_;
+  char* segment_ = nullptr;
+  size_t segment_size_ = 0;
+  Header* header_ = nullptr;
+  int num_slots_ = 0;
+  size_t clip_bytes_ = 0;
+  std::unique_ptr<Mutex> mutex_;
+
+  // named after the segment, e.g. /video_nonlocal_clip_cache/hits; the hit
+  // rate of the node is hits / (hits + misses) summed over its processes
+  struct SharedClipCacheStats {
+    CAFFE_STAT_CTOR(SharedClipCacheStats);
+    CAFFE_EXPORTED_STAT(hits);
+    CAFFE_EXPORTED_STAT(misses);
+    CAFFE_EXPORTED_STAT(inserts);
+    CAFFE_EXPORTED_STAT(evictions);
+    // clips not cached as they were too large or all slots were in use
+    CAFFE_EXPORTED_STAT(rejected);
+  } stats_;
+};
+
+// The cache of the segment name of this process, opened with the given
+// geometry by the first op that asks for it, and shared by the ops of the
+// process until the last one lets go of it.
+std::shared_ptr<SharedClipCache> GetSharedClipCache(
+    const std::string& name,
+    const size_t capacity,
+    const size_t clip_bytes);
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_SHARED_CLIP_CACHE_H_
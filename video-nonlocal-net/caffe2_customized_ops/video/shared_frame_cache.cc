@@ -0,0 +1,257 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/shared_frame_cache.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+struct SharedFrameCache::Header {
+  std::atomic<uint32_t> initialized;
+  uint32_t num_sets;
+  uint64_t frame_bytes;
+  std::atomic<uint64_t> tick;
+};
+
+struct SharedFrameCache::Slot {
+  uint64_t key;
+  int32_t frame;
+  int32_t height;
+  int32_t width;
+  int32_t valid;
+  uint64_t last_used;
+};
+
+namespace {
+
+size_t AlignUp(const size_t size) {
+  return (size + 63) / 64 * 64;
+}
+
+// FNV-1a, which is the same in every process unlike std::hash
+uint64_t HashPath(const std::string& path) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char c : path) {
+    hash = (hash ^ (uint8_t)c) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint64_t MixKey(const uint64_t key, const int frame) {
+  uint64_t x = key ^ ((uint64_t)frame * 0x9E3779B97F4A7C15ULL);
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+} // namespace
+
+constexpr int SharedFrameCache::kWays;
+
+size_t SharedFrameCache::SlotsOffset() {
+  return AlignUp(sizeof(Header));
+}
+
+size_t SharedFrameCache::LocksOffset(const int num_sets) {
+  return SlotsOffset() + AlignUp(num_sets * kWays * sizeof(Slot));
+}
+
+size_t SharedFrameCache::DataOffset(const int num_sets) {
+  return LocksOffset(num_sets) +
+      AlignUp(num_sets * sizeof(std::atomic<uint32_t>));
+}
+
+SharedFrameCache::SharedFrameCache(
+    const std::string& name,
+    const size_t capacity,
+    const size_t frame_bytes)
+    : name_(name), frame_bytes_(frame_bytes) {
+  CAFFE_ENFORCE_GT(frame_bytes, 0, "Frame cache slots cannot be empty.");
+  const size_t set_bytes = kWays * frame_bytes;
+  num_sets_ = std::max<size_t>(1, capacity / set_bytes);
+  const size_t size = DataOffset(num_sets_) + num_sets_ * set_bytes;
+
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  const bool creator = fd != -1;
+  if (!creator) {
+    CAFFE_ENFORCE(
+        errno == EEXIST, "shm_open ", name, " failed: ", strerror(errno));
+    fd = shm_open(name.c_str(), O_RDWR, 0);
+    CAFFE_ENFORCE(fd != -1, "shm_open ", name, " failed: ", strerror(errno));
+    // wait for the creating process to size the segment
+    struct stat st;
+    while (fstat(fd, &st) == 0 && st.st_size == 0) {
+      std::this_thread::yield();
+    }
+    CAFFE_ENFORCE_EQ(
+        (size_t)st.st_size,
+        size,
+        "Frame cache ",
+        name,
+        " exists with a different size.");
+  } else {
+    const int rv = ftruncate(fd, size);
+    CAFFE_ENFORCE(rv != -1, "ftruncate: ", strerror(errno));
+  }
+  void* segment =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  CAFFE_ENFORCE(segment != MAP_FAILED, "mmap: ", strerror(errno));
+  segment_ = static_cast<char*>(segment);
+  segment_size_ = size;
+  header_ = reinterpret_cast<Header*>(segment_);
+
+  if (creator) {
+    // the segment is zero filled, so all slots are invalid and all sets
+    // unlocked already
+    header_->num_sets = num_sets_;
+    header_->frame_bytes = frame_bytes;
+    header_->initialized.store(1, std::memory_order_release);
+  } else {
+    while (header_->initialized.load(std::memory_order_acquire) == 0) {
+      std::this_thread::yield();
+    }
+    CAFFE_ENFORCE(
+        header_->num_sets == num_sets_ && header_->frame_bytes == frame_bytes,
+        "Frame cache ",
+        name,
+        " exists with a different geometry.");
+  }
+}
+
+SharedFrameCache::~SharedFrameCache() {
+  if (segment_) {
+    munmap(segment_, segment_size_);
+  }
+}
+
+void SharedFrameCache::Unlink(const std::string& name) {
+  shm_unlink(name.c_str());
+}
+
+SharedFrameCache::Slot*
+SharedFrameCache::LockSet(const uint64_t key, const int frame, int* set) {
+  *set = MixKey(key, frame) % num_sets_;
+  auto* lock =
+      reinterpret_cast<std::atomic<uint32_t>*>(
+          segment_ + LocksOffset(num_sets_)) + *set;
+  while (lock->exchange(1, std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  return reinterpret_cast<Slot*>(segment_ + SlotsOffset()) + *set * kWays;
+}
+
+void SharedFrameCache::UnlockSet(const int set) {
+  auto* lock =
+      reinterpret_cast<std::atomic<uint32_t>*>(
+          segment_ + LocksOffset(num_sets_)) + set;
+  lock->store(0, std::memory_order_release);
+}
+
+bool SharedFrameCache::Lookup(
+    const std::string& video,
+    const int frame,
+    int* height,
+    int* width,
+    std::vector<uint8_t>* planes) {
+  const uint64_t key = HashPath(video);
+  int set;
+  Slot* slots = LockSet(key, frame, &set);
+  bool found = false;
+  for (int way = 0; way < kWays; way++) {
+    Slot& slot = slots[way];
+    if (slot.valid && slot.key == key && slot.frame == frame) {
+      *height = slot.height;
+      *width = slot.width;
+      planes->resize(3 * slot.height * slot.width);
+      memcpy(
+          planes->data(),
+          segment_ + DataOffset(num_sets_) +
+              (set * kWays + way) * frame_bytes_,
+          planes->size());
+      slot.last_used = ++header_->tick;
+      found = true;
+      break;
+    }
+  }
+  UnlockSet(set);
+  return found;
+}
+
+void SharedFrameCache::Insert(
+    const std::string& video,
+    const int frame,
+    const int height,
+    const int width,
+    const uint8_t* planes,
+    const size_t plane_stride) {
+  const size_t plane_size = height * width;
+  if (3 * plane_size > frame_bytes_) {
+    return;
+  }
+  const uint64_t key = HashPath(video);
+  int set;
+  Slot* slots = LockSet(key, frame, &set);
+  int victim = -1;
+  for (int way = 0; way < kWays; way++) {
+    const Slot& slot = slots[way];
+    if (slot.valid && slot.key == key && slot.frame == frame) {
+      // another process got here first
+      UnlockSet(set);
+      return;
+    }
+    // a free slot, or else the least recently used one
+    if (victim < 0 ||
+        (slots[victim].valid &&
+         (!slot.valid || slot.last_used < slots[victim].last_used))) {
+      victim = way;
+    }
+  }
+  Slot& slot = slots[victim];
+  char* data =
+      segment_ + DataOffset(num_sets_) + (set * kWays + victim) * frame_bytes_;
+  for (int c = 0; c < 3; c++) {
+    memcpy(data + c * plane_size, planes + c * plane_stride, plane_size);
+  }
+  slot.key = key;
+  slot.frame = frame;
+  slot.height = height;
+  slot.width = width;
+  slot.valid = 1;
+  slot.last_used = ++header_->tick;
+  UnlockSet(set);
+}
+
+} // namespace caffe2
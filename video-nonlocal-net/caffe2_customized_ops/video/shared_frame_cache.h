@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_SHARED_FRAME_CACHE_H_
+#define CAFFE2_VIDEO_SHARED_FRAME_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace caffe2 {
+
+// A cache of decoded RGB frames keyed by video path and frame index, held in
+// a POSIX shared memory segment so that all the training processes of a
+// node share it. The first process to map a segment name creates it, the
+// others map it as is; the segment outlives the processes until Unlink().
+//
+// The segment has fixed size slots of frame_bytes, grouped into sets of
+// kWays slots. A frame can only live in the set its key hashes to, and the
+// least recently used slot of the set is replaced, so lookups and inserts
+// touch kWays slots under the spin lock of their set only.
+//
+// Caveat: a process killed while copying a frame leaves its set locked, so
+// remove a segment with Unlink() (or from /dev/shm) after a crash.
+class SharedFrameCache {
+ public:
+  static constexpr int kWays = 8;
+
+  // Maps the segment name of about capacity bytes for frames of at most
+  // frame_bytes bytes. Creating processes size the segment, the others
+  // enforce that they ask for the same geometry.
+  SharedFrameCache(
+      const std::string& name,
+      const size_t capacity,
+      const size_t frame_bytes);
+  ~SharedFrameCache();
+
+  SharedFrameCache(const SharedFrameCache&) = delete;
+  SharedFrameCache& operator=(const SharedFrameCache&) = delete;
+
+  // Copies the three planes of the frame into planes and sets its size,
+  // returns false if it is not cached.
+  bool Lookup(
+      const std::string& video,
+      const int frame,
+      int* height,
+      int* width,
+      std::vector<uint8_t>* planes);
+
+  // Caches a frame given as three planes of height x width bytes, each
+  // plane_stride bytes after the previous one. Frames larger than
+  // frame_bytes are not cached.
+  void Insert(
+      const std::string& video,
+      const int frame,
+      const int height,
+      const int width,
+      const uint8_t* planes,
+      const size_t plane_stride);
+
+  int num_slots() const {
+    return num_sets_ * kWays;
+  }
+
+  static void Unlink(const std::string& name);
+
+ private:
+  struct Slot;
+  struct Header;
+
+  // offsets of the slot table, the set locks and the frame data
+  static size_t SlotsOffset();
+  static size_t LocksOffset(const int num_sets);
+  static size_t DataOffset(const int num_sets);
+
+  Slot* LockSet(const uint64_t key, const int frame, int* set);
+  void UnlockSet(const int set);
+
+  std::string name_;
+  char* segment_ = nullptr;
+  size_t segment_size_ = 0;
+  Header* header_ = nullptr;
+  int num_sets_ = 0;
+  size_t frame_bytes_ = 0;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_SHARED_FRAME_CACHE_H_
@@ -0,0 +1,206 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/video/sum_relu_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// pointers of the inputs (or gradient outputs), passed by value
+template <typename P>
+struct SumReluPointers {
+  P ptr[kSumReluMaxInputs];
+};
+
+// V is float or float4, the latter when every tensor allows 16 byte accesses
+__device__ inline float SumReluAdd(const float a, const float b) {
+  return a + b;
+}
+
+__device__ inline float4 SumReluAdd(const float4 a, const float4 b) {
+  return make_float4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w);
+}
+
+__device__ inline float SumReluMax(const float a) {
+  return fmaxf(a, 0.f);
+}
+
+__device__ inline float4 SumReluMax(const float4 a) {
+  return make_float4(
+      fmaxf(a.x, 0.f), fmaxf(a.y, 0.f), fmaxf(a.z, 0.f), fmaxf(a.w, 0.f));
+}
+
+__device__ inline float SumReluMask(const float y, const float dy) {
+  return y > 0.f ? dy : 0.f;
+}
+
+__device__ inline float4 SumReluMask(const float4 y, const float4 dy) {
+  return make_float4(
+      y.x > 0.f ? dy.x : 0.f,
+      y.y > 0.f ? dy.y : 0.f,
+      y.z > 0.f ? dy.z : 0.f,
+      y.w > 0.f ? dy.w : 0.f);
+}
+
+template <typename V>
+__global__ void SumReluKernel(
+    const int n,
+    const int num_inputs,
+    const SumReluPointers<const V*> X,
+    V* Y) {
+  CUDA_1D_KERNEL_LOOP(i, n) {
+    V sum = X.ptr[0][i];
+    for (int k = 1; k < num_inputs; ++k) {
+      sum = SumReluAdd(sum, X.ptr[k][i]);
+    }
+    Y[i] = SumReluMax(sum);
+  }
+}
+
+template <typename V>
+__global__ void SumReluGradientKernel(
+    const int n,
+    const int num_outputs,
+    const V* Y,
+    const V* dY,
+    SumReluPointers<V*> dX) {
+  CUDA_1D_KERNEL_LOOP(i, n) {
+    const V dx = SumReluMask(Y[i], dY[i]);
+    for (int k = 0; k < num_outputs; ++k) {
+      dX.ptr[k][i] = dx;
+    }
+  }
+}
+
+bool IsFloat4Aligned(const void* ptr) {
+  return reinterpret_cast<uintptr_t>(ptr) % sizeof(float4) == 0;
+}
+
+} // namespace
+
+template <>
+bool SumReluOp<float, CUDAContext>::RunOnDevice() {
+  auto& X0 = Input(0);
+  auto* Y = Output(0);
+  CAFFE_ENFORCE_LE(
+      InputSize(),
+      kSumReluMaxInputs,
+      "SumRelu on CUDA takes at most ",
+      kSumReluMaxInputs,
+      " inputs");
+  Y->ResizeLike(X0);
+  const int size = X0.size();
+  SumReluPointers<const float*> X;
+  bool vectorized = size % 4 == 0;
+  for (int i = 0; i < InputSize(); ++i) {
+    CAFFE_ENFORCE(
+        Input(i).dims() == X0.dims(),
+        "SumRelu inputs need the same shape, input ",
+        i,
+        " differs from input 0");
+    X.ptr[i] = Input(i).data<float>();
+    vectorized = vectorized && IsFloat4Aligned(X.ptr[i]);
+  }
+  float* Y_data = Y->mutable_data<float>();
+  vectorized = vectorized && IsFloat4Aligned(Y_data);
+  if (size == 0) {
+    return true;
+  }
+  if (vectorized) {
+    SumReluPointers<const float4*> X4;
+    for (int i = 0; i < InputSize(); ++i) {
+      X4.ptr[i] = reinterpret_cast<const float4*>(X.ptr[i]);
+    }
+    SumReluKernel<float4>
+        <<<CAFFE_GET_BLOCKS(size / 4),
+           CAFFE_CUDA_NUM_THREADS,
+           0,
+           context_.cuda_stream()>>>(
+            size / 4, InputSize(), X4, reinterpret_cast<float4*>(Y_data));
+  } else {
+    SumReluKernel<float>
+        <<<CAFFE_GET_BLOCKS(size),
+           CAFFE_CUDA_NUM_THREADS,
+           0,
+           context_.cuda_stream()>>>(size, InputSize(), X, Y_data);
+  }
+  return true;
+}
+
+template <>
+bool SumReluGradientOp<float, CUDAContext>::RunOnDevice() {
+  auto& Y = Input(0);
+  auto& dY = Input(1);
+  CAFFE_ENFORCE_EQ(dY.size(), Y.size());
+  CAFFE_ENFORCE_LE(
+      OutputSize(),
+      kSumReluMaxInputs,
+      "SumReluGradient on CUDA takes at most ",
+      kSumReluMaxInputs,
+      " outputs");
+  const int size = Y.size();
+  SumReluPointers<float*> dX;
+  bool vectorized = size % 4 == 0 && IsFloat4Aligned(Y.data<float>()) &&
+      IsFloat4Aligned(dY.data<float>());
+  for (int i = 0; i < OutputSize(); ++i) {
+    Output(i)->ResizeLike(dY);
+    dX.ptr[i] = Output(i)->mutable_data<float>();
+    vectorized = vectorized && IsFloat4Aligned(dX.ptr[i]);
+  }
+  if (size == 0) {
+    return true;
+  }
+  if (vectorized) {
+    SumReluPointers<float4*> dX4;
+    for (int i = 0; i < OutputSize(); ++i) {
+      dX4.ptr[i] = reinterpret_cast<float4*>(dX.ptr[i]);
+    }
+    SumReluGradientKernel<float4>
+        <<<CAFFE_GET_BLOCKS(size / 4),
+           CAFFE_CUDA_NUM_THREADS,
+           0,
+           context_.cuda_stream()>>>(
+            size / 4,
+            OutputSize(),
+            reinterpret_cast<const float4*>(Y.data<float>()),
+            reinterpret_cast<const float4*>(dY.data<float>()),
+            dX4);
+  } else {
+    SumReluGradientKernel<float>
+        <<<CAFFE_GET_BLOCKS(size),
+           CAFFE_CUDA_NUM_THREADS,
+           0,
+           context_.cuda_stream()>>>(
+            size, OutputSize(), Y.data<float>(), dY.data<float>(), dX);
+  }
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(SumRelu, SumReluOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR(
+    SumReluGradient,
+    SumReluGradientOp<float, CUDAContext>);
+} // namespace caffe2
@@ -0,0 +1,77 @@
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/video/sum_relu_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+void AddInput(
+    Workspace* ws,
+    const std::string& name,
+    const std::vector<float>& values) {
+  auto* tensor = ws->CreateBlob(name)->GetMutable<TensorCPU>();
+  tensor->Resize(1, values.size());
+  std::copy(values.begin(), values.end(), tensor->mutable_data<float>());
+}
+
+std::vector<float> GetOutput(Workspace* ws, const std::string& name) {
+  const auto& tensor = ws->GetBlob(name)->Get<TensorCPU>();
+  return std::vector<float>(
+      tensor.data<float>(), tensor.data<float>() + tensor.size());
+}
+
+void RunOp(
+    Workspace* ws,
+    const std::string& type,
+    const std::vector<std::string>& inputs,
+    const std::vector<std::string>& outputs) {
+  OperatorDef def;
+  def.set_type(type);
+  for (const auto& input : inputs) {
+    def.add_input(input);
+  }
+  for (const auto& output : outputs) {
+    def.add_output(output);
+  }
+  auto op = CreateOperator(def, ws);
+  ASSERT_TRUE(op->Run());
+}
+
+} // namespace
+
+TEST(SumReluOpTest, SumsAndClamps) {
+  Workspace ws;
+  AddInput(&ws, "a", {1, -2, 3, -4});
+  AddInput(&ws, "b", {-2, 1, 1, 5});
+  AddInput(&ws, "c", {0, 2, -5, 0});
+
+  RunOp(&ws, "SumRelu", {"a", "b"}, {"y2"});
+  EXPECT_EQ(GetOutput(&ws, "y2"), std::vector<float>({0, 0, 4, 1}));
+  RunOp(&ws, "SumRelu", {"a", "b", "c"}, {"y3"});
+  EXPECT_EQ(GetOutput(&ws, "y3"), std::vector<float>({0, 1, 0, 1}));
+  RunOp(&ws, "SumRelu", {"a"}, {"y1"});
+  EXPECT_EQ(GetOutput(&ws, "y1"), std::vector<float>({1, 0, 3, 0}));
+  // in place of the first input
+  RunOp(&ws, "SumRelu", {"a", "b", "c"}, {"a"});
+  EXPECT_EQ(GetOutput(&ws, "a"), std::vector<float>({0, 1, 0, 1}));
+}
+
+TEST(SumReluOpTest, GradientMasksEveryInput) {
+  Workspace ws;
+  AddInput(&ws, "y", {0, 1, 0, 2});
+  AddInput(&ws, "dy", {5, 6, 7, 8});
+
+  RunOp(&ws, "SumReluGradient", {"y", "dy"}, {"da", "db"});
+  EXPECT_EQ(GetOutput(&ws, "da"), std::vector<float>({0, 6, 0, 8}));
+  EXPECT_EQ(GetOutput(&ws, "db"), std::vector<float>({0, 6, 0, 8}));
+  // in place of dy
+  RunOp(&ws, "SumReluGradient", {"y", "dy"}, {"dy", "dc"});
+  EXPECT_EQ(GetOutput(&ws, "dy"), std::vector<float>({0, 6, 0, 8}));
+  EXPECT_EQ(GetOutput(&ws, "dc"), std::vector<float>({0, 6, 0, 8}));
+}
+
+} // namespace caffe2
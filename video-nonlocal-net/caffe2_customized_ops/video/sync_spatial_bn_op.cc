@@ -0,0 +1,77 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/sync_spatial_bn_op.h"
+#include "caffe2/operators/spatial_batch_norm_op.h"
+
+namespace caffe2 {
+
+// SpatialBN and SpatialBNGradient already take the group statistics on CPU
+REGISTER_CPU_OPERATOR(SyncSpatialBN, SpatialBNOp<CPUContext>);
+REGISTER_CPU_OPERATOR(
+    SyncSpatialBNGradient,
+    SpatialBNGradientOp<CPUContext>);
+
+OPERATOR_SCHEMA(SyncSpatialBN)
+    .NumInputs(7)
+    .NumOutputs(5)
+    .EnforceInplace({{3, 1}, {4, 2}})
+    .SetDoc(R"DOC(
+Training SpatialBN of one device of a data parallel group, normalized with
+the batch statistics of the whole group. The sums and sums of squares input
+are the per channel ChannelStats of X summed over the num_batches devices of
+the group, e.g. by an NCCLAllreduce, so that the mean and variance are the
+ones of the group batch; the running statistics are then updated the same
+way on every device. The running variance gets the biased group variance
+on CPU and the unbiased one on GPU, as SpatialBN and the cuDNN SpatialBN do.
+NCHW only, X may have any number of spatial dims. The op and its gradient
+are put in place of SpatialBN by data_parallel_model with
+combine_spatial_bn=True.
+)DOC")
+    .Arg("epsilon", "The epsilon value to use to avoid division by zero.")
+    .Arg("momentum", "Factor used in computing the running mean and variance.")
+    .Arg("num_batches", "Number of devices of the group.")
+    .Input(0, "X", "N x C x (spatial dims)")
+    .Input(1, "scale", "The scale as a 1-dimensional tensor of size C")
+    .Input(2, "bias", "The bias as a 1-dimensional tensor of size C")
+    .Input(3, "mean", "The running mean, size C")
+    .Input(4, "var", "The running variance, size C")
+    .Input(5, "sums", "Sum of the elements of each channel over the group")
+    .Input(6, "sumsq", "Sum of the squares of each channel over the group")
+    .Output(0, "Y", "The output of the shape of X")
+    .Output(1, "mean", "The running mean after the update")
+    .Output(2, "var", "The running variance after the update")
+    .Output(3, "saved_mean", "The group mean")
+    .Output(4, "saved_var", "The inverse standard deviation of the group");
+OPERATOR_SCHEMA(SyncSpatialBNGradient)
+    .NumInputs(7)
+    .NumOutputs(3)
+    .AllowInplace({{5, 1}, {6, 2}});
+
+// Both ops are written over SpatialBN and its gradient once the gradients of
+// the net exist, see _InterDeviceBatchNormalization of data_parallel_model.
+SHOULD_NOT_DO_GRADIENT(SyncSpatialBN);
+SHOULD_NOT_DO_GRADIENT(SyncSpatialBNGradient);
+
+} // namespace caffe2
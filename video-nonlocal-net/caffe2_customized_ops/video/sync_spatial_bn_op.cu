@@ -0,0 +1,272 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/core/context_gpu.h"
+#include "caffe2/utils/math.h"
+#include "caffe2/video/sync_spatial_bn_op.h"
+
+namespace caffe2 {
+
+namespace {
+
+// The per channel passes are one thread per channel; the elementwise ones
+// use the 2D grid of SpatialBNRelu: blocks along x walk the N x C planes
+// with the coefficients of their channel in registers and blocks along y
+// split the T x H x W elements of a plane.
+constexpr int kThreads = 256;
+constexpr int kMaxBlocksPerPlane = 1024;
+
+dim3 PlaneGrid(const int planes, const int inner) {
+  return dim3(
+      std::min(planes, CAFFE_MAXIMUM_NUM_BLOCKS),
+      std::min((inner + kThreads - 1) / kThreads, kMaxBlocksPerPlane));
+}
+
+// Group mean and variance of each channel from the group sums, with
+// sumsq / M - mean^2 taken in double. Writes the saved
+// statistics, updates the running ones (unbiased variance, as cuDNN) and
+// writes the coefficients of the forward pass to affine[c] and
+// affine[C + c].
+__global__ void GroupMomentsKernel(
+    const int C,
+    const double M,
+    const float* sums,
+    const float* sumsq,
+    const float* scale,
+    const float* bias,
+    const float momentum,
+    const float epsilon,
+    float* saved_mean,
+    float* saved_inv_var,
+    float* running_mean,
+    float* running_var,
+    float* affine) {
+  CUDA_1D_KERNEL_LOOP(c, C) {
+    const double mean = sums[c] / M;
+    const double var = fmax(sumsq[c] / M - mean * mean, 0.);
+    const float inv_std = rsqrtf(static_cast<float>(var) + epsilon);
+    saved_mean[c] = mean;
+    saved_inv_var[c] = inv_std;
+    running_mean[c] = running_mean[c] * momentum + mean * (1.f - momentum);
+    running_var[c] = running_var[c] * momentum +
+        var * (M > 1. ? M / (M - 1.) : 1.) * (1.f - momentum);
+    affine[c] = scale[c] * inv_std;
+    affine[C + c] = bias[c] - mean * scale[c] * inv_std;
+  }
+}
+
+__global__ void AffineForwardKernel(
+    const int planes,
+    const int C,
+    const int inner,
+    const float* X,
+    const float* affine,
+    float* Y) {
+  for (int plane = blockIdx.x; plane < planes; plane += gridDim.x) {
+    const int c = plane % C;
+    const float a = affine[c];
+    const float b = affine[C + c];
+    const size_t offset = static_cast<size_t>(plane) * inner;
+    for (int i = blockIdx.y * blockDim.x + threadIdx.x; i < inner;
+         i += gridDim.y * blockDim.x) {
+      Y[offset + i] = X[offset + i] * a + b;
+    }
+  }
+}
+
+// With the group sums dscale and dbias over the M elements of a channel,
+// dX = scale * inv_std * (dY - (dbias + x_hat * dscale) / M), written as
+// coeff[c] * dY + coeff[C + c] * X + coeff[2C + c]. The sums are then
+// divided by num_batches into the parameter gradients, which may be the
+// same blobs.
+__global__ void GroupGradientCoeffKernel(
+    const int C,
+    const float inv_M,
+    const float inv_num_batches,
+    const float* scale,
+    const float* mean,
+    const float* inv_std,
+    const float* dscale_sum,
+    const float* dbias_sum,
+    float* dscale,
+    float* dbias,
+    float* coeff) {
+  CUDA_1D_KERNEL_LOOP(c, C) {
+    const float ds = dscale_sum[c];
+    const float db = dbias_sum[c];
+    const float dx_scale = scale[c] * inv_std[c];
+    const float dx_x = dx_scale * ds * inv_std[c] * inv_M;
+    coeff[c] = dx_scale;
+    coeff[C + c] = -dx_x;
+    coeff[2 * C + c] = dx_x * mean[c] - dx_scale * db * inv_M;
+    dscale[c] = ds * inv_num_batches;
+    dbias[c] = db * inv_num_batches;
+  }
+}
+
+__global__ void AffineBackwardKernel(
+    const int planes,
+    const int C,
+    const int inner,
+    const float* X,
+    const float* dY,
+    const float* coeff,
+    float* dX) {
+  for (int plane = blockIdx.x; plane < planes; plane += gridDim.x) {
+    const int c = plane % C;
+    const float a = coeff[c];
+    const float b = coeff[C + c];
+    const float d = coeff[2 * C + c];
+    const size_t offset = static_cast<size_t>(plane) * inner;
+    for (int i = blockIdx.y * blockDim.x + threadIdx.x; i < inner;
+         i += gridDim.y * blockDim.x) {
+      dX[offset + i] = dY[offset + i] * a + X[offset + i] * b + d;
+    }
+  }
+}
+
+} // namespace
+
+template <>
+bool SyncSpatialBNOp<float, CUDAContext>::RunOnDevice() {
+  const auto& X = Input(INPUT);
+  const auto& scale = Input(SCALE);
+  const auto& bias = Input(BIAS);
+  const auto& sums = Input(SUMS);
+  const auto& sumsq = Input(SUMSQ);
+  auto* Y = Output(OUTPUT);
+
+  CAFFE_ENFORCE_GE(X.ndim(), 3);
+  const int N = X.dim32(0);
+  const int C = X.dim32(1);
+  const int inner = X.size() / N / C; // support TxHxW
+  CAFFE_ENFORCE_EQ(scale.size(), C);
+  CAFFE_ENFORCE_EQ(bias.size(), C);
+  CAFFE_ENFORCE_EQ(sums.size(), C);
+  CAFFE_ENFORCE_EQ(sumsq.size(), C);
+  for (auto* running : {Output(RUNNING_MEAN), Output(RUNNING_VAR)}) {
+    if (!running->size()) {
+      running->Resize(C);
+      math::Set<float, CUDAContext>(
+          C, 0.f, running->mutable_data<float>(), &context_);
+    }
+  }
+  Output(SAVED_MEAN)->Resize(C);
+  Output(SAVED_INV_VAR)->Resize(C);
+  affine_.Resize(2 * C);
+  float* affine = affine_.mutable_data<float>();
+  GroupMomentsKernel<<<
+      CAFFE_GET_BLOCKS(C),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(
+      C,
+      static_cast<double>(N) * inner * num_batches_,
+      sums.data<float>(),
+      sumsq.data<float>(),
+      scale.data<float>(),
+      bias.data<float>(),
+      momentum_,
+      epsilon_,
+      Output(SAVED_MEAN)->mutable_data<float>(),
+      Output(SAVED_INV_VAR)->mutable_data<float>(),
+      Output(RUNNING_MEAN)->mutable_data<float>(),
+      Output(RUNNING_VAR)->mutable_data<float>(),
+      affine);
+
+  const float* X_data = X.data<float>();
+  Y->ResizeLike(X);
+  AffineForwardKernel<<<
+      PlaneGrid(N * C, inner),
+      kThreads,
+      0,
+      context_.cuda_stream()>>>(
+      N * C, C, inner, X_data, affine, Y->mutable_data<float>());
+  return true;
+}
+
+template <>
+bool SyncSpatialBNGradientOp<float, CUDAContext>::RunOnDevice() {
+  const auto& X = Input(INPUT);
+  const auto& scale = Input(SCALE);
+  const auto& dY = Input(OUTPUT_GRAD);
+  CAFFE_ENFORCE_EQ(
+      InputSize(),
+      7,
+      "SyncSpatialBNGradient needs the group dscale and dbias");
+
+  CAFFE_ENFORCE_GE(X.ndim(), 3);
+  const int N = X.dim32(0);
+  const int C = X.dim32(1);
+  const int inner = X.size() / N / C;
+  CAFFE_ENFORCE(dY.dims() == X.dims());
+  CAFFE_ENFORCE_EQ(scale.size(), C);
+  CAFFE_ENFORCE_EQ(Input(AGGREGATE_SCALE_GRAD).size(), C);
+  CAFFE_ENFORCE_EQ(Input(AGGREGATE_BIAS_GRAD).size(), C);
+
+  // the group sums are read before the outputs, which may alias them, are
+  // resized and written
+  const float* dscale_sum = Input(AGGREGATE_SCALE_GRAD).data<float>();
+  const float* dbias_sum = Input(AGGREGATE_BIAS_GRAD).data<float>();
+  auto* dX = Output(INPUT_GRAD);
+  auto* dscale = Output(SCALE_GRAD);
+  auto* dbias = Output(BIAS_GRAD);
+  dscale->Resize(C);
+  dbias->Resize(C);
+  coeff_.Resize(3 * C);
+  float* coeff = coeff_.mutable_data<float>();
+  GroupGradientCoeffKernel<<<
+      CAFFE_GET_BLOCKS(C),
+      CAFFE_CUDA_NUM_THREADS,
+      0,
+      context_.cuda_stream()>>>(
+      C,
+      1.f / (static_cast<float>(N) * inner * num_batches_),
+      1.f / num_batches_,
+      scale.data<float>(),
+      Input(SAVED_MEAN).data<float>(),
+      Input(SAVED_INV_VAR).data<float>(),
+      dscale_sum,
+      dbias_sum,
+      dscale->mutable_data<float>(),
+      dbias->mutable_data<float>(),
+      coeff);
+
+  const float* X_data = X.data<float>();
+  const float* dY_data = dY.data<float>();
+  dX->ResizeLike(X);
+  AffineBackwardKernel<<<
+      PlaneGrid(N * C, inner),
+      kThreads,
+      0,
+      context_.cuda_stream()>>>(
+      N * C, C, inner, X_data, dY_data, coeff, dX->mutable_data<float>());
+  return true;
+}
+
+REGISTER_CUDA_OPERATOR(SyncSpatialBN, SyncSpatialBNOp<float, CUDAContext>);
+REGISTER_CUDA_OPERATOR(
+    SyncSpatialBNGradient,
+    SyncSpatialBNGradientOp<float, CUDAContext>);
+} // namespace caffe2
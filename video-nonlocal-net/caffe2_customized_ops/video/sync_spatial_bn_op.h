@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef SYNC_SPATIAL_BN_OP_H_
+#define SYNC_SPATIAL_BN_OP_H_
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/utils/math.h"
+
+namespace caffe2 {
+
+// SpatialBN of one device of a data parallel group, normalized with the
+// statistics of the whole group. The per channel sums and sums of squares
+// of X are computed by ChannelStats and summed over the group (an
+// NCCLAllreduce on GPU) before the op; num_batches is the size of the
+// group. The inputs, outputs and arguments are the ones of SpatialBN with
+// num_batches > 1, so on CPU the op is SpatialBN itself.
+template <typename T, class Context>
+class SyncSpatialBNOp final : public Operator<Context> {
+ public:
+  SyncSpatialBNOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        epsilon_(
+            OperatorBase::template GetSingleArgument<float>("epsilon", 1e-5f)),
+        momentum_(
+            OperatorBase::template GetSingleArgument<float>("momentum", 0.9f)),
+        num_batches_(
+            OperatorBase::template GetSingleArgument<int>("num_batches", 1)) {
+    CAFFE_ENFORCE(
+        !OperatorBase::template GetSingleArgument<int>(OpSchema::Arg_IsTest, 0),
+        "SyncSpatialBN is for training, use SpatialBN at test time");
+    CAFFE_ENFORCE_EQ(
+        OperatorBase::template GetSingleArgument<string>("order", "NCHW"),
+        "NCHW",
+        "SyncSpatialBN only supports NCHW");
+    CAFFE_ENFORCE_GE(num_batches_, 1);
+    CAFFE_ENFORCE_GT(epsilon_, 0);
+    CAFFE_ENFORCE_GE(momentum_, 0);
+    CAFFE_ENFORCE_LE(momentum_, 1);
+  }
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  bool RunOnDevice() override;
+
+ protected:
+  float epsilon_;
+  float momentum_;
+  int num_batches_;
+  INPUT_TAGS(INPUT, SCALE, BIAS, EST_MEAN, EST_VAR, SUMS, SUMSQ);
+  OUTPUT_TAGS(OUTPUT, RUNNING_MEAN, RUNNING_VAR, SAVED_MEAN, SAVED_INV_VAR);
+
+  // a and b of Y = a[c] * X + b[c], on GPU
+  Tensor<Context> affine_;
+};
+
+// Input: X, scale, dY, saved_mean, saved_inv_var and the dscale and dbias of
+// ChannelBackpropStats summed over the group
+// Output: dX, dscale, dbias
+// As SpatialBNGradient with num_batches > 1, dscale and dbias are the group
+// sums divided by num_batches, so that summing the parameter gradients over
+// the group afterwards gives the group sums back.
+template <typename T, class Context>
+class SyncSpatialBNGradientOp final : public Operator<Context> {
+ public:
+  SyncSpatialBNGradientOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        num_batches_(
+            OperatorBase::template GetSingleArgument<int>("num_batches", 1)) {
+    CAFFE_ENFORCE_EQ(
+        OperatorBase::template GetSingleArgument<string>("order", "NCHW"),
+        "NCHW",
+        "SyncSpatialBNGradient only supports NCHW");
+    CAFFE_ENFORCE_GE(num_batches_, 1);
+  }
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+  bool RunOnDevice() override;
+
+ protected:
+  int num_batches_;
+  INPUT_TAGS(
+      INPUT,
+      SCALE,
+      OUTPUT_GRAD,
+      SAVED_MEAN,
+      SAVED_INV_VAR,
+      AGGREGATE_SCALE_GRAD,
+      AGGREGATE_BIAS_GRAD);
+  OUTPUT_TAGS(INPUT_GRAD, SCALE_GRAD, BIAS_GRAD);
+
+  // the three coefficients of dX = a[c] * dY + b[c] * X + d[c], on GPU
+  Tensor<Context> coeff_;
+};
+
+} // namespace caffe2
+
+#endif // SYNC_SPATIAL_BN_OP_H_
@@ -0,0 +1,233 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_SYNTHETIC_VIDEO_INPUT_OP_H_
+#define CAFFE2_VIDEO_SYNTHETIC_VIDEO_INPUT_OP_H_
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/types.h"
+#include "caffe2/utils/cast.h"
+#include "caffe2/utils/conversions.h"
+
+namespace caffe2 {
+
+// Outputs the tensors CustomizedVideoInput with the same arguments outputs
+// (the clips, the labels, with output_clip_index the video ids and clip
+// indices, and with use_gpu_transform on CPU the raw uint8 clips and the
+// mirror flags), without a reader and without decoding. The tensors are
+// generated on the device of the op by the first run and every run shares
+// them into the outputs, so a net fed by it runs at the speed of its compute.
+template <class Context>
+class SyntheticVideoInputOp final : public Operator<Context> {
+ public:
+  USE_OPERATOR_CONTEXT_FUNCTIONS;
+
+  SyntheticVideoInputOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<Context>(operator_def, ws),
+        batch_size_(
+            OperatorBase::template GetSingleArgument<int>("batch_size", 0)),
+        length_(OperatorBase::template GetSingleArgument<int>("length", 0)),
+        crop_(OperatorBase::template GetSingleArgument<int>("crop", -1)),
+        height_(OperatorBase::template GetSingleArgument<int>("height", 0)),
+        width_(OperatorBase::template GetSingleArgument<int>("width", 0)),
+        mean_(OperatorBase::template GetSingleArgument<float>("mean", 0.)),
+        std_(OperatorBase::template GetSingleArgument<float>("std", 1.)),
+        multiple_label_(
+            OperatorBase::template GetSingleArgument<int>(
+                "multiple_label", 0)),
+        num_of_labels_(
+            OperatorBase::template GetSingleArgument<int>(
+                "num_of_labels", 0)),
+        num_classes_(
+            OperatorBase::template GetSingleArgument<int>("num_classes", 1)),
+        output_clip_index_(
+            OperatorBase::template GetSingleArgument<int>(
+                "output_clip_index", 0)),
+        gpu_transform_(
+            OperatorBase::template GetSingleArgument<int>(
+                "use_gpu_transform", 0)),
+        output_type_(cast::GetCastDataType(
+            ArgumentHelper(operator_def),
+            "output_type")),
+        order_(StringToStorageOrder(
+            OperatorBase::template GetSingleArgument<std::string>(
+                "order", "NCHW"))),
+        constant_(
+            OperatorBase::template GetSingleArgument<int>("constant", 0)),
+        value_(OperatorBase::template GetSingleArgument<float>("value", 128)),
+        seed_(OperatorBase::template GetSingleArgument<int>("seed", 0)) {
+    CAFFE_ENFORCE_GT(batch_size_, 0, "Need a batch_size.");
+    CAFFE_ENFORCE_GT(length_, 0, "Need a length.");
+    CAFFE_ENFORCE_GT(std_, 0);
+    CAFFE_ENFORCE_GT(num_classes_, 0);
+    CAFFE_ENFORCE(
+        !multiple_label_ || num_of_labels_ > 0,
+        "multiple_label needs num_of_labels.");
+    // like CustomizedVideoInput, the CPU op leaves the transform of
+    // use_gpu_transform to the consumer
+    raw_clips_ = gpu_transform_ && std::is_same<Context, CPUContext>::value;
+    if (!gpu_transform_ || raw_clips_) {
+      output_type_ = raw_clips_ ? TensorProto_DataType_UINT8
+                                : TensorProto_DataType_FLOAT;
+    }
+    CAFFE_ENFORCE(
+        output_type_ == TensorProto_DataType_FLOAT ||
+            output_type_ == TensorProto_DataType_FLOAT16 ||
+            output_type_ == TensorProto_DataType_UINT8,
+        "output_type should be float, float16 or uint8.");
+    const int num_outputs =
+        2 + (output_clip_index_ ? 2 : 0) + (raw_clips_ ? 1 : 0);
+    CAFFE_ENFORCE_EQ(
+        OutputSize(),
+        num_outputs,
+        "The outputs do not match output_clip_index and use_gpu_transform.");
+  }
+
+  bool RunOnDevice() override {
+    if (tensors_.empty()) {
+      Generate();
+    }
+    for (int i = 0; i < OutputSize(); ++i) {
+      auto* output = Output(i);
+      output->ResizeLike(tensors_[i]);
+      output->ShareData(tensors_[i]);
+    }
+    return true;
+  }
+
+ private:
+  // the shape of the clips: the crop, or for crop <= 0 the height and width
+  // of the uncropped clips, at least 224 as in CustomizedVideoInput
+  std::vector<TIndex> ClipShape() const {
+    const int height = crop_ > 0 ? crop_ : std::max(height_, 224);
+    const int width = crop_ > 0 ? crop_ : std::max(width_, 224);
+    if (order_ == StorageOrder::NHWC && !raw_clips_) {
+      return {batch_size_, length_, height, width, 3};
+    }
+    return {batch_size_, 3, length_, height, width};
+  }
+
+  template <typename T>
+  void FillClip(TensorCPU* clip, std::mt19937* randgen) {
+    // the pixels before the transform, which uint8 clips keep as they are
+    const bool normalize = output_type_ != TensorProto_DataType_UINT8;
+    const float scale = normalize ? 1.f / std_ : 1.f;
+    const float shift = normalize ? -mean_ / std_ : 0.f;
+    std::uniform_real_distribution<float> pixel(0, 255);
+    T* data = clip->template mutable_data<T>();
+    for (TIndex i = 0; i < clip->size(); ++i) {
+      const float value = constant_ ? value_ : pixel(*randgen);
+      data[i] = convert::To<float, T>(value * scale + shift);
+    }
+  }
+
+  void Generate() {
+    std::mt19937 randgen(seed_);
+    std::vector<TensorCPU> host(OutputSize());
+
+    host[0].Resize(ClipShape());
+    if (output_type_ == TensorProto_DataType_FLOAT16) {
+      FillClip<float16>(&host[0], &randgen);
+    } else if (output_type_ == TensorProto_DataType_UINT8) {
+      FillClip<uint8_t>(&host[0], &randgen);
+    } else {
+      FillClip<float>(&host[0], &randgen);
+    }
+
+    // a class per clip, or a binary vector of the labels present
+    std::uniform_int_distribution<int> label(0, num_classes_ - 1);
+    std::bernoulli_distribution coin(0.5);
+    if (multiple_label_) {
+      host[1].Resize(batch_size_, num_of_labels_);
+    } else {
+      host[1].Resize(batch_size_);
+    }
+    int* label_data = host[1].template mutable_data<int>();
+    for (TIndex i = 0; i < host[1].size(); ++i) {
+      label_data[i] =
+          constant_ ? 0 : (multiple_label_ ? coin(randgen) : label(randgen));
+    }
+
+    if (output_clip_index_) {
+      host[2].Resize(batch_size_);
+      host[3].Resize(batch_size_, 2);
+      int* video_id = host[2].template mutable_data<int>();
+      int* clip_index = host[3].template mutable_data<int>();
+      for (int i = 0; i < batch_size_; ++i) {
+        video_id[i] = i;
+        clip_index[2 * i] = 0;
+        clip_index[2 * i + 1] = 0;
+      }
+    }
+    if (raw_clips_) {
+      auto& mirror = host.back();
+      mirror.Resize(batch_size_);
+      int* mirror_data = mirror.template mutable_data<int>();
+      for (int i = 0; i < batch_size_; ++i) {
+        mirror_data[i] = constant_ ? 0 : coin(randgen);
+      }
+    }
+
+    tensors_.resize(OutputSize());
+    for (int i = 0; i < OutputSize(); ++i) {
+      tensors_[i].CopyFrom(host[i], &context_);
+    }
+    context_.FinishDeviceComputation();
+  }
+
+  const int batch_size_;
+  const int length_;
+  const int crop_;
+  const int height_;
+  const int width_;
+  const float mean_;
+  const float std_;
+  const bool multiple_label_;
+  const int num_of_labels_;
+  // labels are drawn from [0, num_classes)
+  const int num_classes_;
+  const bool output_clip_index_;
+  const bool gpu_transform_;
+  bool raw_clips_;
+  TensorProto_DataType output_type_;
+  const StorageOrder order_;
+  // every pixel is value instead of a random one, every label 0 and no clip
+  // mirrored
+  const bool constant_;
+  const float value_;
+  const int seed_;
+  std::vector<Tensor<Context>> tensors_;
+};
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_SYNTHETIC_VIDEO_INPUT_OP_H_
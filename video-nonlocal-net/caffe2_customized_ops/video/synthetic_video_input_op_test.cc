@@ -0,0 +1,115 @@
+#include <string>
+#include <vector>
+
+#include "caffe2/core/operator.h"
+#include "caffe2/core/workspace.h"
+#include "caffe2/utils/proto_utils.h"
+#include "caffe2/video/synthetic_video_input_op.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+OperatorDef InputDef(const std::vector<std::string>& outputs) {
+  OperatorDef def;
+  def.set_type("SyntheticVideoInput");
+  for (const auto& output : outputs) {
+    def.add_output(output);
+  }
+  def.add_arg()->CopyFrom(MakeArgument<int>("batch_size", 2));
+  def.add_arg()->CopyFrom(MakeArgument<int>("length", 4));
+  def.add_arg()->CopyFrom(MakeArgument<int>("num_classes", 5));
+  return def;
+}
+
+const TensorCPU& GetOutput(Workspace* ws, const std::string& name) {
+  return ws->GetBlob(name)->Get<TensorCPU>();
+}
+
+} // namespace
+
+TEST(SyntheticVideoInputOpTest, OutputsCroppedClipsOnce) {
+  Workspace ws;
+  auto def = InputDef({"data", "labels"});
+  def.add_arg()->CopyFrom(MakeArgument<int>("crop", 8));
+  def.add_arg()->CopyFrom(MakeArgument<float>("mean", 100));
+  def.add_arg()->CopyFrom(MakeArgument<float>("std", 50));
+  auto op = CreateOperator(def, &ws);
+  ASSERT_TRUE(op->Run());
+
+  const auto& data = GetOutput(&ws, "data");
+  EXPECT_EQ(data.dims(), std::vector<TIndex>({2, 3, 4, 8, 8}));
+  ASSERT_TRUE(data.IsType<float>());
+  for (TIndex i = 0; i < data.size(); ++i) {
+    EXPECT_GE(data.data<float>()[i], -2.f);
+    EXPECT_LE(data.data<float>()[i], 3.11f);
+  }
+  const auto& labels = GetOutput(&ws, "labels");
+  EXPECT_EQ(labels.dims(), std::vector<TIndex>({2}));
+  for (TIndex i = 0; i < labels.size(); ++i) {
+    EXPECT_GE(labels.data<int>()[i], 0);
+    EXPECT_LT(labels.data<int>()[i], 5);
+  }
+
+  // later runs output the same tensors
+  const float* clips = data.data<float>();
+  ASSERT_TRUE(op->Run());
+  EXPECT_EQ(GetOutput(&ws, "data").data<float>(), clips);
+}
+
+TEST(SyntheticVideoInputOpTest, OutputsUncroppedMultiLabelClips) {
+  Workspace ws;
+  auto def = InputDef({"data", "labels", "video_ids", "clip_index"});
+  def.add_arg()->CopyFrom(MakeArgument<int>("crop", -1));
+  def.add_arg()->CopyFrom(MakeArgument<int>("height", 256));
+  def.add_arg()->CopyFrom(MakeArgument<int>("width", 100));
+  def.add_arg()->CopyFrom(MakeArgument<int>("multiple_label", 1));
+  def.add_arg()->CopyFrom(MakeArgument<int>("num_of_labels", 7));
+  def.add_arg()->CopyFrom(MakeArgument<int>("output_clip_index", 1));
+  def.add_arg()->CopyFrom(MakeArgument<string>("order", "NHWC"));
+  auto op = CreateOperator(def, &ws);
+  ASSERT_TRUE(op->Run());
+
+  // the width is raised to 224 as CustomizedVideoInput does
+  EXPECT_EQ(
+      GetOutput(&ws, "data").dims(),
+      std::vector<TIndex>({2, 4, 256, 224, 3}));
+  const auto& labels = GetOutput(&ws, "labels");
+  EXPECT_EQ(labels.dims(), std::vector<TIndex>({2, 7}));
+  for (TIndex i = 0; i < labels.size(); ++i) {
+    EXPECT_TRUE(labels.data<int>()[i] == 0 || labels.data<int>()[i] == 1);
+  }
+  EXPECT_EQ(GetOutput(&ws, "video_ids").dims(), std::vector<TIndex>({2}));
+  EXPECT_EQ(GetOutput(&ws, "clip_index").dims(), std::vector<TIndex>({2, 2}));
+}
+
+TEST(SyntheticVideoInputOpTest, OutputsRawClipsForTheGPUTransform) {
+  Workspace ws;
+  auto def = InputDef({"data", "labels", "mirror"});
+  def.add_arg()->CopyFrom(MakeArgument<int>("crop", 8));
+  def.add_arg()->CopyFrom(MakeArgument<int>("use_gpu_transform", 1));
+  def.add_arg()->CopyFrom(MakeArgument<int>("constant", 1));
+  def.add_arg()->CopyFrom(MakeArgument<float>("value", 7));
+  auto op = CreateOperator(def, &ws);
+  ASSERT_TRUE(op->Run());
+
+  const auto& data = GetOutput(&ws, "data");
+  EXPECT_EQ(data.dims(), std::vector<TIndex>({2, 3, 4, 8, 8}));
+  ASSERT_TRUE(data.IsType<uint8_t>());
+  for (TIndex i = 0; i < data.size(); ++i) {
+    EXPECT_EQ(data.data<uint8_t>()[i], 7);
+  }
+  const auto& mirror = GetOutput(&ws, "mirror");
+  EXPECT_EQ(mirror.dims(), std::vector<TIndex>({2}));
+  EXPECT_EQ(mirror.data<int>()[0], 0);
+}
+
+TEST(SyntheticVideoInputOpTest, NeedsTheOutputsOfItsArguments) {
+  Workspace ws;
+  auto def = InputDef({"data", "labels", "video_ids"});
+  def.add_arg()->CopyFrom(MakeArgument<int>("crop", 8));
+  EXPECT_THROW(CreateOperator(def, &ws), EnforceNotMet);
+}
+
+} // namespace caffe2
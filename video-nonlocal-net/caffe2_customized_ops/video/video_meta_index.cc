@@ -0,0 +1,191 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#include "caffe2/video/video_meta_index.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include "caffe2/core/logging.h"
+
+namespace caffe2 {
+
+namespace {
+
+constexpr size_t kHeaderSize = 8;
+constexpr size_t kEntrySize = 32;
+
+int32_t ReadInt32(const char* data) {
+  int32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+void WriteInt32(const int32_t value, char* out) {
+  memcpy(out, &value, sizeof(value));
+}
+
+} // namespace
+
+VideoMetaIndex::~VideoMetaIndex() {
+  Close();
+}
+
+void VideoMetaIndex::Close() {
+  if (data_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  num_entries_ = 0;
+}
+
+bool VideoMetaIndex::Open(const std::string& filename) {
+  Close();
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open video meta index " << filename;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)kHeaderSize) {
+    LOG(ERROR) << "Invalid video meta index " << filename;
+    close(fd);
+    return false;
+  }
+  void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    LOG(ERROR) << "Cannot map video meta index " << filename;
+    return false;
+  }
+  data_ = static_cast<const char*>(data);
+  size_ = st.st_size;
+
+  const int num_entries = ReadInt32(data_ + 4);
+  bool valid = memcmp(data_, kVideoMetaIndexMagic, 4) == 0 &&
+      num_entries >= 0 &&
+      kHeaderSize + (size_t)num_entries * kEntrySize <= size_;
+  // check the offsets once so that Lookup does not have to
+  for (int i = 0; valid && i < num_entries; i++) {
+    const char* entry = data_ + kHeaderSize + i * kEntrySize;
+    const size_t path_offset = (uint32_t)ReadInt32(entry);
+    const size_t path_size = (uint32_t)ReadInt32(entry + 4);
+    const size_t key_frame_offset = (uint32_t)ReadInt32(entry + 24);
+    const size_t num_key_frames = (uint32_t)ReadInt32(entry + 28);
+    valid = path_offset + path_size <= size_ &&
+        key_frame_offset + num_key_frames * sizeof(int32_t) <= size_;
+  }
+  if (!valid) {
+    LOG(ERROR) << "Invalid video meta index " << filename;
+    Close();
+    return false;
+  }
+  num_entries_ = num_entries;
+  return true;
+}
+
+bool VideoMetaIndex::Lookup(
+    const std::string& path,
+    VideoMetaEntry* entry) const {
+  // binary search over the entries, which are sorted by path
+  int lo = 0;
+  int hi = num_entries_;
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    const char* e = data_ + kHeaderSize + mid * kEntrySize;
+    const int cmp = path.compare(
+        0,
+        std::string::npos,
+        data_ + (uint32_t)ReadInt32(e),
+        (uint32_t)ReadInt32(e + 4));
+    if (cmp == 0) {
+      entry->num_frames = ReadInt32(e + 8);
+      memcpy(&entry->fps, e + 12, sizeof(float));
+      entry->width = ReadInt32(e + 16);
+      entry->height = ReadInt32(e + 20);
+      const char* key_frames = data_ + (uint32_t)ReadInt32(e + 24);
+      entry->key_frames.resize((uint32_t)ReadInt32(e + 28));
+      for (size_t i = 0; i < entry->key_frames.size(); i++) {
+        entry->key_frames[i] = ReadInt32(key_frames + i * sizeof(int32_t));
+      }
+      return true;
+    }
+    if (cmp < 0) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  return false;
+}
+
+std::string SerializeVideoMetaIndex(
+    std::vector<std::pair<std::string, VideoMetaEntry>> entries) {
+  std::sort(
+      entries.begin(),
+      entries.end(),
+      [](const std::pair<std::string, VideoMetaEntry>& a,
+         const std::pair<std::string, VideoMetaEntry>& b) {
+        return a.first < b.first;
+      });
+  size_t size = kHeaderSize + entries.size() * kEntrySize;
+  for (const auto& e : entries) {
+    size += e.first.size() + e.second.key_frames.size() * sizeof(int32_t);
+  }
+  CAFFE_ENFORCE_LE(size, UINT32_MAX, "Video meta index too large.");
+
+  std::string out(size, '\0');
+  char* data = &out[0];
+  memcpy(data, kVideoMetaIndexMagic, 4);
+  WriteInt32(entries.size(), data + 4);
+  size_t offset = kHeaderSize + entries.size() * kEntrySize;
+  for (size_t i = 0; i < entries.size(); i++) {
+    const std::string& path = entries[i].first;
+    const VideoMetaEntry& meta = entries[i].second;
+    char* e = data + kHeaderSize + i * kEntrySize;
+    WriteInt32(offset, e);
+    WriteInt32(path.size(), e + 4);
+    memcpy(data + offset, path.data(), path.size());
+    offset += path.size();
+    WriteInt32(meta.num_frames, e + 8);
+    memcpy(e + 12, &meta.fps, sizeof(float));
+    WriteInt32(meta.width, e + 16);
+    WriteInt32(meta.height, e + 20);
+    WriteInt32(offset, e + 24);
+    WriteInt32(meta.key_frames.size(), e + 28);
+    for (const int key_frame : meta.key_frames) {
+      WriteInt32(key_frame, data + offset);
+      offset += sizeof(int32_t);
+    }
+  }
+  return out;
+}
+
+} // namespace caffe2
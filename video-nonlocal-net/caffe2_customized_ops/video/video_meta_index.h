@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_VIDEO_META_INDEX_H_
+#define CAFFE2_VIDEO_VIDEO_META_INDEX_H_
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace caffe2 {
+
+// What the decoder would otherwise have to probe or decode a video for.
+struct VideoMetaEntry {
+  int num_frames = -1;
+  float fps = -1;
+  int width = -1;
+  int height = -1;
+  // ascending frame indices of the key frames
+  std::vector<int> key_frames;
+};
+
+// A read-only index of video meta data keyed by file path, stored in one
+// file that is mapped into memory, so that all decode threads can look up
+// the videos of local file dbs without opening them first. The file is
+// written once by SerializeVideoMetaIndex (or the create_video_meta_index.py
+// tool). All fields are little endian int32 unless noted:
+//
+//   "VMIX", num_entries, then num_entries entries sorted by path of
+//   path_offset, path_size, num_frames, fps (float32), width, height,
+//   key_frame_offset, num_key_frames, followed by the paths and the key
+//   frame indices the offsets (from the start of the file) point to.
+class VideoMetaIndex {
+ public:
+  VideoMetaIndex() {}
+  ~VideoMetaIndex();
+
+  VideoMetaIndex(const VideoMetaIndex&) = delete;
+  VideoMetaIndex& operator=(const VideoMetaIndex&) = delete;
+
+  // Maps the index file. Returns false if it cannot be read or is not an
+  // index, in which case the index stays empty.
+  bool Open(const std::string& filename);
+
+  int size() const {
+    return num_entries_;
+  }
+
+  // Fills entry with the meta data of the video at path, returns false if the
+  // index does not have it.
+  bool Lookup(const std::string& path, VideoMetaEntry* entry) const;
+
+ private:
+  void Close();
+
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  int num_entries_ = 0;
+};
+
+constexpr char kVideoMetaIndexMagic[4] = {'V', 'M', 'I', 'X'};
+
+// The contents of an index file for entries, in any order.
+std::string SerializeVideoMetaIndex(
+    std::vector<std::pair<std::string, VideoMetaEntry>> entries);
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_VIDEO_META_INDEX_H_
@@ -0,0 +1,43 @@
+#include "caffe2/video/video_stats.h"
+#include <gtest/gtest.h>
+
+namespace caffe2 {
+
+namespace {
+
+struct HistogramStats {
+  CAFFE_STAT_CTOR(HistogramStats);
+  CAFFE_LATENCY_HISTOGRAM_STAT(latency);
+};
+
+} // namespace
+
+TEST(LatencyHistogramStatTest, Buckets) {
+  EXPECT_EQ(LatencyHistogramStat::Bucket(0), 0);
+  EXPECT_EQ(LatencyHistogramStat::Bucket(0.99e6), 0);
+  EXPECT_EQ(LatencyHistogramStat::Bucket(1e6), 1);
+  EXPECT_EQ(LatencyHistogramStat::Bucket(3.5e6), 2);
+  EXPECT_EQ(LatencyHistogramStat::Bucket(1023e6), 10);
+  EXPECT_EQ(
+      LatencyHistogramStat::Bucket(1024e6),
+      LatencyHistogramStat::kNumBuckets - 1);
+  EXPECT_EQ(
+      LatencyHistogramStat::Bucket(1e12),
+      LatencyHistogramStat::kNumBuckets - 1);
+}
+
+TEST(LatencyHistogramStatTest, ExportsCounts) {
+  HistogramStats stats("latency_histogram_test");
+  CAFFE_EVENT(stats, latency, 0.5e6);
+  CAFFE_EVENT(stats, latency, 0.7e6);
+  CAFFE_EVENT(stats, latency, 5e6);
+  CAFFE_EVENT(stats, latency, 2e9);
+  auto exported = toMap(StatRegistry::get().publish(true));
+  EXPECT_EQ(exported["latency_histogram_test/latency"], 4);
+  EXPECT_EQ(exported["latency_histogram_test/latency/lt_1ms"], 2);
+  EXPECT_EQ(exported["latency_histogram_test/latency/lt_2ms"], 0);
+  EXPECT_EQ(exported["latency_histogram_test/latency/lt_8ms"], 1);
+  EXPECT_EQ(exported["latency_histogram_test/latency/ge_1024ms"], 1);
+}
+
+} // namespace caffe2
@@ -0,0 +1,270 @@
+/**
+ * Copyright (c) 2017-present, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the license found in the
+ * LICENSE file in the root directory of this source tree.
+ */
+ /**
+  * based on:
+  * Copyright (c) 2016-present, Facebook, Inc.
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  */
+
+#ifndef CAFFE2_VIDEO_ZMQ_CLIP_OPS_H_
+#define CAFFE2_VIDEO_ZMQ_CLIP_OPS_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "caffe2/core/context.h"
+#include "caffe2/core/logging.h"
+#include "caffe2/core/operator.h"
+#include "caffe2/core/types.h"
+#include "caffe2/operators/prefetch_op.h"
+#include "caffe2/utils/zmq_helper.h"
+
+namespace caffe2 {
+
+/**
+ * A decode service moves the decoding of the clips off the GPU nodes: CPU
+ * nodes run the CustomizedVideoInput pipeline and ZmqClipSend, and the GPU
+ * nodes read the batches with ZmqClipInput. A batch is a multipart message
+ * of a TensorProtos with the types and dims of its tensors, followed by the
+ * bytes of every tensor that has any.
+ *
+ * The flow control is credit based: every consumer grants a producer one
+ * credit per batch it has room for, starting with `credits` and returning
+ * one for every batch it takes, and a producer only sends to a consumer
+ * with a credit left. So the producers decode no further ahead than the
+ * consumers can hold, and the consumers that are quickest take the most
+ * batches.
+ */
+
+// the one-frame message of a credit
+constexpr char kZmqClipCredit[] = "c";
+
+// Sends its input tensors as a batch to the next consumer with a credit,
+// waiting for one if none has any.
+class ZmqClipSendOp final : public Operator<CPUContext> {
+ public:
+  USE_OPERATOR_FUNCTIONS(CPUContext);
+
+  ZmqClipSendOp(const OperatorDef& operator_def, Workspace* ws)
+      : Operator<CPUContext>(operator_def, ws),
+        address_(OperatorBase::GetSingleArgument<std::string>(
+            "address", "tcp://*:5600")),
+        socket_(ZMQ_ROUTER) {
+    socket_.Bind(address_);
+  }
+
+  bool RunOnDevice() override {
+    // the ROUTER socket prefixes the credit with the identity of its sender
+    ZmqMessage identity;
+    ZmqMessage credit;
+    socket_.RecvTillSuccess(&identity);
+    CAFFE_ENFORCE(socket_.RecvMore(), "Bad credit message.");
+    socket_.RecvTillSuccess(&credit);
+
+    TensorProtos header;
+    for (int i = 0; i < InputSize(); ++i) {
+      auto* proto = header.add_protos();
+      proto->set_data_type(TypeMetaToDataType(Input(i).meta()));
+      for (const auto d : Input(i).dims()) {
+        proto->add_dims(d);
+      }
+    }
+    int last = -1;
+    for (int i = 0; i < InputSize(); ++i) {
+      if (Input(i).nbytes() > 0) {
+        last = i;
+      }
+    }
+    socket_.SendTillSuccess(identity.data(), identity.size(), ZMQ_SNDMORE);
+    socket_.SendTillSuccess(
+        header.SerializeAsString(), last >= 0 ? ZMQ_SNDMORE : 0);
+    for (int i = 0; i <= last; ++i) {
+      if (Input(i).nbytes() > 0) {
+        socket_.SendTillSuccess(
+            Input(i).raw_data(), Input(i).nbytes(), i < last ? ZMQ_SNDMORE : 0);
+      }
+    }
+    return true;
+  }
+
+ private:
+  std::string address_;
+  ZmqSocket socket_;
+};
+
+// Reads the batches of the producers at `addresses` into its outputs. With
+// use_gpu_transform the batches are the uint8 clips of the CPU
+// CustomizedVideoInput with use_gpu_transform, whose last tensor holds the
+// mirror flags: the CUDA op mirrors, reorders and normalizes the clips like
+// the CUDA CustomizedVideoInput does, and outputs the other tensors as is.
+template <class Context>
+class ZmqClipInputOp final : public PrefetchOperator<Context> {
+ public:
+  using OperatorBase::OutputSize;
+  using PrefetchOperator<Context>::context_;
+  using PrefetchOperator<Context>::prefetch_depth_;
+  using PrefetchOperator<Context>::prefetch_slot_;
+  using PrefetchOperator<Context>::copy_slot_;
+
+  ZmqClipInputOp(const OperatorDef& operator_def, Workspace* ws)
+      : PrefetchOperator<Context>(operator_def, ws),
+        addresses_(
+            OperatorBase::template GetRepeatedArgument<std::string>(
+                "addresses")),
+        credits_(OperatorBase::template GetSingleArgument<int>("credits", 4)),
+        timeout_ms_(
+            OperatorBase::template GetSingleArgument<int>("timeout_ms", 1000)),
+        gpu_transform_(
+            OperatorBase::template GetSingleArgument<int>(
+                "use_gpu_transform", 0)),
+        mean_(OperatorBase::template GetSingleArgument<float>("mean", 0.)),
+        std_(OperatorBase::template GetSingleArgument<float>("std", 1.)),
+        use_bgr_(OperatorBase::template GetSingleArgument<int>("use_bgr", 0)),
+        output_type_(
+            OperatorBase::template GetSingleArgument<std::string>(
+                "output_type", "float")),
+        order_(StringToStorageOrder(
+            OperatorBase::template GetSingleArgument<std::string>(
+                "order", "NCHW"))),
+        socket_(ZMQ_DEALER),
+        received_(prefetch_depth_),
+        received_on_device_(prefetch_depth_) {
+    CAFFE_ENFORCE(!addresses_.empty(), "Need the addresses of producers.");
+    CAFFE_ENFORCE_GT(credits_, 0);
+    CAFFE_ENFORCE(
+        !gpu_transform_ || (!std::is_same<Context, CPUContext>::value),
+        "use_gpu_transform needs the CUDA version of the op.");
+    num_tensors_ = OutputSize() + (gpu_transform_ ? 1 : 0);
+    for (int i = 0; i < prefetch_depth_; ++i) {
+      received_[i].resize(num_tensors_);
+      received_on_device_[i].resize(num_tensors_);
+    }
+    // a receive times out so that the op can quit without a producer
+    socket_.SetOption(ZMQ_RCVTIMEO, timeout_ms_);
+    socket_.SetOption(ZMQ_LINGER, 0);
+    for (const auto& address : addresses_) {
+      socket_.Connect(address);
+    }
+  }
+
+  ~ZmqClipInputOp() {
+    stop_ = true;
+    PrefetchOperator<Context>::Finalize();
+  }
+
+  bool Prefetch() override {
+    if (!credits_granted_) {
+      // the DEALER socket spreads the credits over the producers
+      for (int i = 0; i < credits_ * int(addresses_.size()); ++i) {
+        socket_.SendTillSuccess(kZmqClipCredit, 0);
+      }
+      credits_granted_ = true;
+    }
+    ZmqMessage header_msg;
+    if (!Recv(&header_msg)) {
+      return false;
+    }
+    TensorProtos header;
+    CAFFE_ENFORCE(
+        header.ParseFromArray(header_msg.data(), header_msg.size()),
+        "Bad batch header.");
+    CAFFE_ENFORCE_EQ(
+        header.protos_size(),
+        num_tensors_,
+        "The batches hold another number of tensors than the op expects.");
+    auto& tensors = received_[prefetch_slot_];
+    for (int i = 0; i < num_tensors_; ++i) {
+      const auto& proto = header.protos(i);
+      std::vector<TIndex> dims(proto.dims().begin(), proto.dims().end());
+      tensors[i].Resize(dims);
+      void* data = tensors[i].raw_mutable_data(
+          DataTypeToTypeMeta(proto.data_type()));
+      if (tensors[i].nbytes() == 0) {
+        continue;
+      }
+      ZmqMessage msg;
+      CAFFE_ENFORCE(socket_.RecvMore(), "Batch ended early.");
+      if (!Recv(&msg)) {
+        return false;
+      }
+      CAFFE_ENFORCE_EQ(msg.size(), tensors[i].nbytes());
+      memcpy(data, msg.data(), msg.size());
+    }
+    // the batch is out of the way of the producers
+    socket_.SendTillSuccess(kZmqClipCredit, 0);
+
+    if (!std::is_same<Context, CPUContext>::value) {
+      for (int i = 0; i < num_tensors_; ++i) {
+        received_on_device_[prefetch_slot_][i].CopyFrom(
+            tensors[i], &context_);
+      }
+    }
+    return true;
+  }
+
+  bool CopyPrefetched() override;
+
+ private:
+  // waits for the next message until the op quits
+  bool Recv(ZmqMessage* msg) {
+    int waited_ms = 0;
+    while (socket_.Recv(msg) == 0) {
+      if (stop_) {
+        return false;
+      }
+      waited_ms += timeout_ms_;
+      if (waited_ms % 60000 < timeout_ms_) {
+        LOG(WARNING) << "No batch from the decode service for "
+                     << waited_ms / 1000 << "s";
+      }
+    }
+    return true;
+  }
+
+  std::vector<std::string> addresses_;
+  int credits_;
+  int timeout_ms_;
+  bool gpu_transform_;
+  float mean_;
+  float std_;
+  bool use_bgr_;
+  std::string output_type_;
+  StorageOrder order_;
+  ZmqSocket socket_;
+  int num_tensors_;
+  bool credits_granted_ = false;
+  std::atomic<bool> stop_{false};
+  // the batches of the prefetch slots
+  std::vector<std::vector<TensorCPU>> received_;
+  std::vector<std::vector<Tensor<Context>>> received_on_device_;
+};
+
+template <class Context>
+bool ZmqClipInputOp<Context>::CopyPrefetched() {
+  auto& tensors = received_[copy_slot_];
+  for (int i = 0; i < OutputSize(); ++i) {
+    OperatorBase::Output<Tensor<Context>>(i)->CopyFrom(tensors[i], &context_);
+  }
+  return true;
+}
+
+} // namespace caffe2
+
+#endif // CAFFE2_VIDEO_ZMQ_CLIP_OPS_H_
@@ -49,7 +49,12 @@ __C.DEBUG = False
 
 # Training options
 __C.DATALOADER = AttrDict()
+# videos that may fail to decode in an input op before it fails; training
+# replaces them by the next videos of the db, -1 for no limit
 __C.DATALOADER.MAX_BAD_IMAGES = 100
+# file of the videos that failed to decode, one per line, which are skipped
+# from then on, also by later runs; b'' to keep them in memory only
+__C.DATALOADER.BAD_VIDEO_LIST = b''
 
 
 # Training options
@@ -58,8 +63,15 @@ __C.TRAIN.PARAMS_FILE = b''
 __C.TRAIN.DATA_TYPE = b'train'
 __C.TRAIN.BATCH_SIZE = 64
 
-# cache images in memory
+# cache the decoded frames of the training videos in a shared memory segment
+# of all the processes on a node; clips are only served from it if their
+# start can be chosen before decoding, i.e. with VIDEO_META_INDEX or records
+# with meta data, and not with VIDEO_DECODER_SCALING
 __C.TRAIN.MEM_CACHE = False
+__C.TRAIN.MEM_CACHE_NAME = b'/video_nonlocal_frame_cache'
+__C.TRAIN.MEM_CACHE_SIZE_MB = 16384
+# largest frame (height x width x 3 bytes) the cache holds
+__C.TRAIN.MEM_CACHE_FRAME_BYTES = 640 * 480 * 3
 
 # if the pre-training batchsize does not match the current
 __C.TRAIN.RESUME_FROM_BATCH_SIZE = -1
@@ -72,14 +84,90 @@ __C.TRAIN.CROP_SIZE = 224
 # compute precise bn
 __C.TRAIN.COMPUTE_PRECISE_BN = True
 __C.TRAIN.ITER_COMPUTE_PRECISE_BN = 200
+# accumulate the precise bn statistics on the gpus (AccumulateBNStats) and
+# write them to the running ones there (FinalizeBNStats), instead of fetching
+# the batch statistics of every layer and gpu every iteration
+__C.TRAIN.PRECISE_BN_ON_DEVICE = False
+# normalize with the batch statistics of all the GPUs (SyncSpatialBN), so
+# the running statistics are the ones of the whole batch and precise bn is
+# skipped; the BN and relu of the blocks are then not fused
+__C.TRAIN.SYNC_BN = False
+# activation checkpointing: b'block' or b'stage' keeps only the inputs of
+# every residual block (or res stage) of the training net and runs its
+# forward ops again in the backward pass, trading compute for memory
+__C.TRAIN.RECOMPUTE = b''
+
+# when > 0, the gradients are allreduced in buckets of about this many MB,
+# each as soon as the backward pass has produced its gradients, instead of
+# one NCCL allreduce per parameter
+__C.TRAIN.ALLREDUCE_BUCKET_MB = 0
+
+# move the params of every gpu into one flat buffer and their gradients into
+# another, so that the gradients are allreduced and the params broadcast as
+# one blob
+__C.TRAIN.FLATTEN_PARAMS = False
+# with FLATTEN_PARAMS, keep the momentum of the flat params in shards, one per
+# gpu: the gradients are reduce-scattered instead of allreduced, every gpu
+# updates its 1 / NUM_GPUS of the params, and the updated shards are
+# allgathered. The checkpoints still hold the momentum per param.
+__C.TRAIN.SHARD_OPTIMIZER_STATE = False
 
 # Number of iterations after which model should be tested on test/val data
 __C.TRAIN.EVAL_PERIOD = 5005
+# build the test net of the EVAL_PERIOD tests on the training net: it runs
+# on the params of the training net, without initializing its own, and
+# writes its activations into the blobs of the training net's forward pass
+# of the same names (and so into its MODEL.MEMORY_PLAN arena), instead of
+# its own, so that testing does not add to the peak GPU memory of training.
+# The test clips per gpu must not be larger than the training ones.
+__C.TRAIN.EVAL_SHARES_TRAIN_MEMORY = False
+# run the EVAL_PERIOD tests concurrently with the training, instead of
+# pausing it: the params are copied into spare blobs of the test net, which
+# then runs with its own input op in a thread of its own, and its metrics
+# are logged once it is done, with the iteration of the params. The test net
+# runs on the low priority cuda streams of the training gpus (needs a dag or
+# async NET_TYPE), or, when ASYNC_EVAL_GPU >= 0, on that gpu alone, with the
+# clips per gpu of TEST.BATCH_SIZE.
+__C.TRAIN.ASYNC_EVAL = False
+__C.TRAIN.ASYNC_EVAL_GPU = -1
+# when > 1, run up to this many train iterations per call into caffe2 (one
+# plan with a num_iter step), with the loss and top-k hits summed on the
+# device and fetched once per run; needs SOLVER.LR_IN_GRAPH. The runs end at
+# the iterations of LOG_PERIOD, EVAL_PERIOD, CHECKPOINT_PERIOD etc.
+__C.TRAIN.ITERS_PER_RUN = 1
+# when > 1, every iteration runs the forward and backward passes on this many
+# micro-batches of TRAIN.BATCH_SIZE / MICRO_BATCHES clips in turn, and
+# allreduces the summed gradients and updates once (data_parallel_model
+# micro_batches). The lr schedule and the checkpoints count iterations as
+# before; the BN momentum is taken to the power 1 / MICRO_BATCHES, and precise
+# BN runs MICRO_BATCHES times as many micro-batches.
+__C.TRAIN.MICRO_BATCHES = 1
+# when > 1, the clips of a group of this many consecutive gpus are split
+# along time: every gpu runs the resnet_video model on its VIDEO_LENGTH /
+# TEMPORAL_SHARDS frames, with the frames of its neighbours as the halos of
+# the temporal convs and the keys of all the frames in the non-local blocks
+# (see models/temporal_shard_helper.py). The first gpu of a group reads
+# TEMPORAL_SHARDS times the clips of a gpu, the batch of a gpu without
+# shards; needs SYNC_BN, for the BN statistics of all the frames.
+__C.TRAIN.TEMPORAL_SHARDS = 1
 __C.TRAIN.DATASET_SIZE = 234643
+# read the training db in a new order every epoch, seeded with RNG_SEED,
+# instead of only in the order of the (pre-shuffled, replicated) list it was
+# built from; a db of one copy of the list is then enough
+__C.TRAIN.SHUFFLE_DB = False
 
 __C.TRAIN.VIDEO_LENGTH = 32
 __C.TRAIN.SAMPLE_RATE = 2
+# multigrid training: the training batches take their [batch size, length,
+# crop] from these shapes in turn, each for its MULTIGRID_ITERS batches (or
+# all for one). Shorter clips are sampled at a higher rate, so that every
+# clip spans VIDEO_LENGTH x SAMPLE_RATE frames.
+__C.TRAIN.MULTIGRID_SHAPES = []
+__C.TRAIN.MULTIGRID_ITERS = [1]
 __C.TRAIN.DROPOUT_RATE = 0.0
+# keep only the seed of the dropout mask for the backward pass, which
+# regenerates the mask, instead of the mask itself
+__C.TRAIN.DROPOUT_REGENERATE_MASK = False
 
 __C.TRAIN.TEST_AFTER_TRAIN = False
 
@@ -112,7 +200,44 @@ __C.MODEL.STD = 57.375
 __C.MODEL.ALLOW_INPLACE_SUM = True
 __C.MODEL.ALLOW_INPLACE_RELU = True  # disable inplace relu for collecting stats
 __C.MODEL.ALLOW_INPLACE_RESHAPE = True
+# residual sum and relu of each block as one SumRelu op (one pass less over
+# the block output, forward and backward)
+__C.MODEL.FUSE_SUM_RELU = False
+# BN and relu (and the residual sum of the block tail) of the bottleneck
+# blocks as SpatialBNRelu ops; ignored with USE_AFFINE
+__C.MODEL.FUSE_BN_RELU = False
+# BN and relu of the bottleneck blocks (those without the residual) as
+# InPlaceABN ops written over the conv output, whose gradient recomputes the
+# BN input from the output: one activation kept per pair instead of two.
+# The activation is a leaky relu of slope INPLACE_ABN_SLOPE (the relu is not
+# invertible) and the BN scale is used as |scale| + eps, so this trains a
+# different model. Ignored with USE_AFFINE, SYNC_BN or FP16
+__C.MODEL.INPLACE_ABN = False
+__C.MODEL.INPLACE_ABN_SLOPE = 0.01
+# pool5, pred and softmax of the val / test nets as one GlobalAvgPoolFC op;
+# the nets then have no 'pred' blob, only 'softmax'
+__C.MODEL.FUSED_HEAD = False
+# when > 0, the 1x1 layer of the bottleneck blocks without a temporal conv
+# (e.g. all of them in the c2d models) reads its input shifted along time,
+# 1 / TEMPORAL_SHIFT_DIV of the channels a frame each way (TemporalShift);
+# with FUSE_TEMPORAL_SHIFT the shift and the conv are one TemporalShiftConv
+# op
+__C.MODEL.TEMPORAL_SHIFT_DIV = 0
+__C.MODEL.FUSE_TEMPORAL_SHIFT = True
+# chains of pointwise ops (AffineNd and relu, residual sum and relu) as
+# FusedPointwise ops, one generated kernel each, forward and backward; see
+# CUDA_RTC_CACHE_DIR.
+# The val / test nets with TEST.FOLD_AFFINE fold their AffineNds instead
+__C.MODEL.FUSE_POINTWISE = False
 __C.MODEL.MEMONGER = True
+# instead of the memonger, place the activations and gradients of every gpu
+# into one arena, by their inferred sizes and liveness (needs a crop size)
+__C.MODEL.MEMORY_PLAN = False
+# train with the ReluWithMask and MaxPoolArgmax ops where their gradients,
+# which read a bit mask and byte argmaxes instead of the activations, let
+# the memory plan free an activation after the forward pass, e.g. the stem
+# ReLU and pool1 (see utils/compact_activations.py). Needs MEMORY_PLAN.
+__C.MODEL.COMPACT_ACTIVATIONS = False
 
 __C.MODEL.USE_BGR = False  # default is False for historical reason
 
@@ -128,6 +253,9 @@ __C.RESNETS.NUM_GROUPS = 1
 __C.RESNETS.WIDTH_PER_GROUP = 64
 __C.RESNETS.STRIDE_1X1 = False
 __C.RESNETS.TRANS_FUNC = b'bottleneck_transformation'
+# run the grouped convs (NUM_GROUPS > 1) with the direct grouped 3D conv
+# kernels (Conv engine DIRECT) instead of cudnn or im2col per group
+__C.RESNETS.DIRECT_GROUP_CONV = False
 
 
 # Test
@@ -135,6 +263,14 @@ __C.TEST = AttrDict()
 __C.TEST.PARAMS_FILE = b''
 __C.TEST.DATA_TYPE = b''
 __C.TEST.BATCH_SIZE = 64
+# cache the decoded test clips in a shared memory segment of all the
+# processes on a node, so the crops and repeated runs of a clip, in any of
+# the processes, decode it once; needs local video files and fixed scaling
+__C.TEST.CLIP_CACHE = False
+__C.TEST.CLIP_CACHE_NAME = b'/video_nonlocal_clip_cache'
+__C.TEST.CLIP_CACHE_SIZE_MB = 16384
+# largest clip (length x height x width x 3 bytes) the cache holds
+__C.TEST.CLIP_CACHE_CLIP_BYTES = 32 * 256 * 456 * 3
 __C.TEST.TEN_CROP = False  # used by image classification; deprecated
 __C.TEST.SCALE = 256
 __C.TEST.CROP_SIZE = 224
@@ -143,6 +279,18 @@ __C.TEST.OUTPUT_NAME = b'pred'
 __C.TEST.TEST_FULLY_CONV = False
 __C.TEST.TEST_FULLY_CONV_FLIP = False
 __C.TEST.GLOBAL_AVE = False
+# uncropped (TRAIN.CROP_SIZE <= 0) test clips are batched by size; number of
+# clips that may wait for a full batch before a padded one is emitted (0 for
+# four batches)
+__C.TEST.UNCROPPED_BUCKET_BUFFER = 0
+# the tensors of the test nets grow to size classes above this factor x their
+# capacity and keep their high-water capacity, so that the runs over clips of
+# changing sizes (uncropped clips) stop allocating after the warmup; 0 to
+# reallocate the tensors as they change size
+__C.TEST.TENSOR_GROWTH_FACTOR = 0.
+# have the input op output the video id and the (temporal, spatial) index
+# of each test clip, and collect results by those instead of by db order
+__C.TEST.OUTPUT_CLIP_INDEX = False
 
 __C.TEST.DATASET_SIZE = 19761  # size of kinetics test set
 
@@ -155,6 +303,58 @@ __C.TEST.NUM_TEST_CLIPS = 10
 # __C.TEST.STARTING_CLIP = 0
 
 __C.TEST.USE_MULTI_CROP = 0
+# decode each test clip once and cut all of its spatial crops from it
+__C.TEST.REUSE_MULTI_CROP_CLIPS = False
+# one db record per video, expanded by the input op into all NUM_TEST_CLIPS
+# views (clips x spatial crops) from a single decode; TEST.BATCH_SIZE per gpu
+# must be a multiple of NUM_TEST_CLIPS
+__C.TEST.EXPAND_VIEWS = False
+# fold the AffineNd / frozen SpatialBN ops into the preceding convs once the
+# weights are loaded (saves a pass over every conv output)
+__C.TEST.FOLD_AFFINE = False
+# run all the inference rewrites of the video nets on the loaded test net:
+# the FOLD_AFFINE folds, the non-local block scales folded into their
+# BatchMatMuls, in place reshapes and Relus fused into the ops before them
+__C.TEST.OPTIMIZE_INFERENCE = False
+# progressive test: test the clips of every video in the order of their
+# coverage (the center crop of spread out clips first) and stop once the top
+# two classes of its average softmax are EARLY_EXIT_MARGIN apart, after at
+# least EARLY_EXIT_MIN_CLIPS clips; the clips saved go to the next videos.
+# Needs the one record per clip test db and TEST.OUTPUT_CLIP_INDEX. 0 tests
+# all NUM_TEST_CLIPS clips.
+__C.TEST.EARLY_EXIT_MARGIN = 0.0
+__C.TEST.EARLY_EXIT_MIN_CLIPS = 2
+# videos in flight per gpu, whose next clips wait for the scores of their
+# last ones (0 for four batches)
+__C.TEST.EARLY_EXIT_WINDOW = 0
+# sum up the softmax of the clips per video on the gpus
+# (SegmentedClipAggregate) instead of fetching it every iter; the clip counts
+# are fetched every AGGREGATE_FETCH_PERIOD iters (0: only after the last
+# one), the sums once at the end. Up to NUM_TEST_CLIPS clips per video and
+# gpu are kept.
+__C.TEST.AGGREGATE_ON_DEVICE = False
+__C.TEST.AGGREGATE_FETCH_PERIOD = 0
+# data-parallel test: every gpu of each of the NUM_SHARDS test processes
+# (tools/test_net_video.py on every node, with its SHARD_ID) reads its own
+# shard of the test db, one of NUM_SHARDS x NUM_GPUS, and sums its clip scores
+# on the gpu (needs AGGREGATE_ON_DEVICE). At the end the processes allreduce
+# the sums through gloo, meeting in the shared directory RENDEZVOUS_PATH, and
+# shard 0 evaluates.
+__C.TEST.SHARDED = False
+__C.TEST.NUM_SHARDS = 1
+__C.TEST.SHARD_ID = 0
+__C.TEST.RENDEZVOUS_PATH = b''
+# write WRITE_BLOBS (default: OUTPUT_NAME) of every clip, with its video id,
+# to the db WRITE_DB_gpu_<i> of every gpu (WriteToDB), e.g. to extract
+# features; a writer thread commits WRITE_DB_TRANSACTION_SIZE clips at a time
+__C.TEST.WRITE_DB = b''
+__C.TEST.WRITE_DB_TYPE = b'lmdb'
+__C.TEST.WRITE_DB_TRANSACTION_SIZE = 1000
+__C.TEST.WRITE_BLOBS = []
+# the predictor export (tools/export_predict_net_video.py) rewrites every
+# temporal conv, frozen BN, relu and spatial conv chain (the 3x1x1 and 1x3x3
+# convs of the I3D blocks) to one Conv2Plus1D op (utils/conv_fusion.py)
+__C.TEST.FUSE_CONV2PLUS1D = False
 
 
 # Solver
@@ -163,6 +363,16 @@ __C.SOLVER.NESTEROV = True
 __C.SOLVER.WEIGHT_DECAY = 0.0001
 __C.SOLVER.WEIGHT_DECAY_BN = 0.0001
 __C.SOLVER.MOMENTUM = 0.9
+# update all the params of a gpu, weight decay included, with one
+# MultiTensorMomentumSGDUpdate instead of a WeightedSum and a
+# MomentumSGDUpdate per param
+__C.SOLVER.MULTI_TENSOR_UPDATE = False
+# 'lars' or 'lamb' to scale the lr of every layer but the bn params by its
+# trust ratio, with one MultiTensorLarsUpdate (momentum SGD) or
+# MultiTensorLambUpdate for all the params of a gpu, for large batches
+__C.SOLVER.LAYERWISE = b''
+# the trust coefficient of LARS
+__C.SOLVER.LARS_ETA = 0.001
 
 # Learning rates
 __C.SOLVER.LR_POLICY = b'steps_with_relative_lrs'
@@ -178,6 +388,10 @@ __C.SOLVER.STEPS = None
 __C.SOLVER.GAMMA = 0.1  # for cfg.SOLVER.LR_POLICY = 'steps_with_decay'
 
 __C.SOLVER.SCALE_MOMENTUM = False
+# compute the lr (warmup included) and the SCALE_MOMENTUM correction with a
+# LearningRate op in the train net instead of feeding them from python every
+# iteration; for the steps_with_lrs and steps_with_relative_lrs policies
+__C.SOLVER.LR_IN_GRAPH = False
 
 # warmup hack
 __C.SOLVER.WARMUP = AttrDict()
@@ -191,6 +405,16 @@ __C.CHECKPOINT.CHECKPOINT_MODEL = True
 __C.CHECKPOINT.CHECKPOINT_PERIOD = -1
 __C.CHECKPOINT.RESUME = True
 __C.CHECKPOINT.DIR = b'.'
+# 'pkl' or 'minidb': minidb checkpoints are written by a Checkpoint op from
+# the gpu blobs, with SAVE_THREADS threads serializing them
+__C.CHECKPOINT.FORMAT = b'pkl'
+__C.CHECKPOINT.SAVE_THREADS = 8
+# write a minidb checkpoint from a copy of the blobs while training goes on
+__C.CHECKPOINT.ASYNC_SAVE = False
+# save the position of the train reader (shuffle seed, epoch, offset) with
+# the checkpoints, and resume from it with one seek, so that a resumed job
+# goes on with the clips of the epoch it would have read next
+__C.CHECKPOINT.RESUME_DATA_POSITION = True
 
 
 # Non-local Block
@@ -203,6 +427,26 @@ __C.NONLOCAL.USE_ZERO_INIT_CONV = False
 __C.NONLOCAL.USE_BN = True
 __C.NONLOCAL.USE_SCALE = True
 __C.NONLOCAL.USE_AFFINE = False
+# compute softmax(theta^T phi) g with the NonLocalAttention op, which never
+# stores the affinity matrix (needs USE_SOFTMAX)
+__C.NONLOCAL.USE_FUSED_ATTENTION = False
+# if > 0, the fused op forms the affinity with GEMMs, this many queries at a
+# time, and its gradient recomputes the tiles; 0 for the fused GPU kernels
+__C.NONLOCAL.FUSED_ATTENTION_TILE = 0
+# run the affinity and aggregation GEMMs and the softmax in fp16, with fp32
+# accumulation on tensor cores (needs USE_SOFTMAX); the convs stay fp32
+__C.NONLOCAL.USE_FP16_GEMM = False
+# when set, [t, h, w] (odd sizes): every query attends only to this window of
+# keys around its position on the (pooled) grid of the keys, with the
+# LocalNonLocal op, so the cost grows linearly with the positions (needs
+# USE_SOFTMAX); [] attends to all the keys
+__C.NONLOCAL.WINDOW = []
+# the steps between the keys of a window along t, h, w
+__C.NONLOCAL.WINDOW_DILATION = [1, 1, 1]
+# compute the max pooling (USE_MAXPOOL) and the phi and g projections with
+# one MaxPoolProjection op, which keeps the argmax of the pooling as uint8
+# instead of the pooled input
+__C.NONLOCAL.FUSE_POOL_PROJECTION = False
 
 __C.NONLOCAL.BN_MOMENTUM = 0.9
 __C.NONLOCAL.BN_EPSILON = 1.0000001e-5
@@ -213,6 +457,86 @@ __C.NONLOCAL.CONV3_NONLOCAL = True
 __C.NONLOCAL.CONV4_NONLOCAL = True
 
 
+# Mixed precision training: the trunk (convs, BN, pools, relus, sums and the
+# non-local GEMMs) runs on fp16 activations, from the input to pool5; the
+# params stay fp32 masters, cast to fp16 for every iteration, so the
+# gradients, the checkpoints and the solver are fp32
+__C.FP16 = AttrDict()
+__C.FP16.ENABLED = False
+# the loss is multiplied by this before the backward pass so that small
+# gradients don't flush to zero in fp16, and the gradients divided by it
+__C.FP16.LOSS_SCALE = 128.0
+
+
+# Pipeline parallel training: the res stages of the one model run on
+# consecutive gpus from ROOT_GPU_ID (NUM_GPUS is then 1, the number of model
+# replicas), and every batch is split into TRAIN.MICRO_BATCHES micro-batches
+# whose forward and backward passes go through the gpus in a one forward, one
+# backward order (see models/pipeline_helper.py). The activations and their
+# gradients are copied between the gpus at the stage boundaries.
+__C.PIPELINE = AttrDict()
+__C.PIPELINE.ENABLED = False
+# the prefixes of the blobs that start the stages after the first, one more
+# gpu each, e.g. ['res3', 'res4', 'res5'] for four gpus; the non-local blocks
+# run on the gpu of their res stage
+__C.PIPELINE.STAGE_STARTS = []
+
+
+# Post-training int8 quantization (tools/quantize_net_video.py)
+__C.QUANT = AttrDict()
+# batches of the TEST.DATA_TYPE split that the activation ranges come from
+__C.QUANT.CALIBRATION_ITERS = 20
+# the quantized init and predict nets are written to this directory, or to
+# CHECKPOINT.DIR if empty
+__C.QUANT.OUTPUT_DIR = b''
+
+
+# Videos read from an object store with HTTP range requests, e.g. with
+# REMOTE_VIDEO.DB_LIST, instead of from shared POSIX storage
+__C.REMOTE_VIDEO = AttrDict()
+# read the videos of http:// paths through the remote video store
+__C.REMOTE_VIDEO.ENABLED = False
+# read DATADIR/<split> as a "<video url> <labels>" list (local or http://)
+# instead of an lmdb
+__C.REMOTE_VIDEO.DB_LIST = False
+# on-disk LRU cache of the fetched blocks, shared by the runs of a node;
+# b'' keeps them in memory
+__C.REMOTE_VIDEO.CACHE_DIR = b''
+__C.REMOTE_VIDEO.CACHE_MB = 20480
+# the unit of the range requests; smaller blocks pull less than the GOPs
+# of a clip, larger ones need fewer requests
+__C.REMOTE_VIDEO.BLOCK_KB = 512
+# idle keep-alive connections kept per host
+__C.REMOTE_VIDEO.CONNECTIONS = 8
+# threads fetching the start of the videos of the queued batches
+__C.REMOTE_VIDEO.PREFETCH_THREADS = 4
+__C.REMOTE_VIDEO.PREFETCH_BLOCKS = 2
+
+
+# Feed the nets with SyntheticVideoInput instead of CustomizedVideoInput: the
+# same outputs, generated once on each gpu, without a db or decoding, to time
+# the compute of a config apart from its input pipeline
+__C.SYNTHETIC_INPUT = AttrDict()
+__C.SYNTHETIC_INPUT.ENABLED = False
+# constant clips (every pixel 128) and labels (0) instead of random ones
+__C.SYNTHETIC_INPUT.CONSTANT = False
+
+
+# Training clips decoded on CPU nodes that run tools/decode_server_video.py,
+# which send the uint8 clips over zmq to the training nodes, where the GPU
+# transform normalizes them (VIDEO_GPU_TRANSFORM)
+__C.DECODE_SERVICE = AttrDict()
+__C.DECODE_SERVICE.ENABLED = False
+# zmq addresses of the decode nodes, e.g. [b'tcp://decode0:5600']
+__C.DECODE_SERVICE.ADDRESSES = []
+# batches each decode node may send to a tower ahead of training
+__C.DECODE_SERVICE.CREDITS = 4
+# the input op checks every TIMEOUT_MS whether the net is stopped
+__C.DECODE_SERVICE.TIMEOUT_MS = 1000
+# the address a decode node binds to
+__C.DECODE_SERVICE.BIND = b'tcp://*:5600'
+
+
 # Metrics option
 __C.METRICS = AttrDict()
 # For IN5k, we train with the IN5k training set, but we still eval on IN1k val.
@@ -220,6 +544,10 @@ __C.METRICS = AttrDict()
 # So we use the following options to evaluate the first N-way on val.
 __C.METRICS.EVAL_FIRST_N = False  # deprecated
 __C.METRICS.FIRST_N = 1000
+# Count the top-k hits, and sum the train loss, on the gpus, and fetch them
+# once per LOG_PERIOD instead of the predictions and labels of every gpu every
+# iteration. Always on for train with TRAIN.ITERS_PER_RUN > 1.
+__C.METRICS.ON_DEVICE = False
 
 __C.DATADIR_TRAIN_TIME = \
     b'kinetics/alllist'
@@ -232,10 +560,118 @@ __C.DATADIR = b''
 __C.DATASET = b''
 __C.ROOT_GPU_ID = 0
 __C.CUDNN_WORKSPACE_LIMIT = 256
+# file in which the cudnn exhaustive search results are kept across runs and
+# shared by the processes of a node; empty to search again in every run
+__C.CUDNN_ALGO_CACHE_FILE = ''
+# the most MB of cudnn scratch that the convs of a GPU pick algorithms for,
+# shared by the convs; 0 to only use the per-op CUDNN_WORKSPACE_LIMIT
+__C.CUDNN_WORKSPACE_BUDGET = 0
+# MB of device memory that the cudnn scratch leaves free when it grows, for
+# the blobs allocated after the first iteration; -1 to not check free memory
+__C.CUDNN_WORKSPACE_RESERVE = -1
+# directory in which the PTX of the FusedPointwise kernels is kept across runs
+# and shared by the processes of a node; empty to compile them in every run
+__C.CUDA_RTC_CACHE_DIR = ''
+# gpu memory pool: '' for plain cudaMalloc, 'cub', or 'caching' that splits
+# cached blocks for the changing sizes of the fully convolutional test and
+# reports its stats (misc.log_cuda_memory_stats)
+__C.CUDA_MEMORY_POOL = ''
 __C.RNG_SEED = 2
 __C.NUM_GPUS = 8
 
 __C.VIDEO_DECODER_THREADS = 4
+# grow and shrink the decode threads in use, from VIDEO_DECODER_THREADS and
+# within [VIDEO_DECODER_MIN_THREADS, VIDEO_DECODER_MAX_THREADS], and the
+# prefetched batches within [1, VIDEO_PREFETCH_DEPTH], so that training does
+# not wait for its input on the fewest threads; the input op's
+# active_decode_threads and active_prefetch_depth stats show where it is
+__C.VIDEO_DECODER_ADAPTIVE_THREADS = False
+__C.VIDEO_DECODER_MIN_THREADS = 1
+__C.VIDEO_DECODER_MAX_THREADS = 16
+# run the decoder threads as a work-stealing pool with per-thread queues
+__C.VIDEO_DECODER_WORK_STEALING = False
+# decode on the CPU budget pool that all the input ops of the process share,
+# instead of VIDEO_DECODER_THREADS threads per op (see CPU_BUDGET_THREADS)
+__C.VIDEO_DECODER_CPU_BUDGET_POOL = False
+# bind the decoder threads and their buffers to the NUMA node of the GPU;
+# needs NUMA enabled in caffe2 (--caffe2_cpu_numa_enabled)
+__C.VIDEO_DECODER_NUMA_BIND = False
+# threads of the codec of each video, 0 for one per core
+__C.VIDEO_DECODER_CODEC_THREADS = 1
+# if > 0, the CPU threads shared by the VIDEO_DECODER_THREADS clips in flight;
+# each clip then gets max(1, budget / VIDEO_DECODER_THREADS) codec threads
+__C.VIDEO_DECODER_CPU_BUDGET = 0
+# seek to the sampled clip instead of decoding the whole video
+__C.VIDEO_DECODER_SELECTIVE = False
+# with selective decoding and SAMPLE_RATE > 1, do not decode the
+# non-reference frames that fall between the sampled frames
+__C.VIDEO_DECODER_SKIP_NONREF = False
+# if > 0, sample the clips at this frame rate, so that SAMPLE_RATE spans the
+# same time in every video and high fps videos decode fewer frames
+__C.VIDEO_DECODER_TARGET_FPS = 0.
+# resize frames to the jittered scale while converting them to RGB
+__C.VIDEO_DECODER_SCALING = False
+# keep the last video opened by each decoder thread ready for the next clip
+__C.VIDEO_DECODER_CACHE = False
+# allocate the decoded frames from a per-thread arena reused across clips
+__C.VIDEO_DECODER_FRAME_ARENA = False
+# video decoder implementation: b'software' or b'cuvid' (NVDEC, falls back
+# to software decoding for codecs without a cuvid decoder)
+__C.VIDEO_DECODER_BACKEND = b'software'
+# b'fast' skips the loop filter and the exact IDCT between key frames and
+# decodes at a reduced size where the codec allows it, for the training
+# clips only; b'full' to decode them exactly
+__C.VIDEO_DECODER_QUALITY = b'full'
+# the db records point to folders of extracted frames named
+# <%06d frame index><VIDEO_FRAMES_EXTENSION> instead of video files
+__C.VIDEO_FRAMES_INPUT = False
+__C.VIDEO_FRAMES_EXTENSION = b'.jpg'
+# read buffer size of FFmpeg, 0 for 32 KB
+__C.VIDEO_DECODER_IO_BUFFER = 0
+# read local video files through mmap instead of stdio
+__C.VIDEO_DECODER_MMAP = False
+# start reading the files of a batch into the page cache when it is queued
+__C.VIDEO_DECODER_READAHEAD = False
+# read the records in the decode threads, each with a cursor of its own over
+# a disjoint part of the db, instead of a batch at a time under one lock
+__C.VIDEO_DECODER_PARALLEL_READS = False
+# queue the decode tasks of a batch by decreasing estimated cost (the decode
+# time last observed for the video, or its frames and resolution in its
+# meta data) instead of in db order, so that a batch does not end on one
+# long video; the batches are the same. Not with PARALLEL_READS
+__C.VIDEO_DECODER_SCHEDULE_BY_COST = False
+# meta data index of the local video files written by
+# process_data/kinetics/create_video_meta_index.py, b'' for none
+__C.VIDEO_META_INDEX = b''
+# open the videos with meta data (in their record or VIDEO_META_INDEX)
+# without probing their streams first; for containers whose header
+# describes the video stream, such as mp4
+__C.VIDEO_SKIP_STREAM_INFO = False
+# if >= 0, start the temporally jittered training clips of the videos with
+# key frames in their meta data within this many frames after a key frame,
+# so selective decoding discards at most that many frames before the clip
+# instead of up to a GOP; -1 samples the start uniformly
+__C.VIDEO_KEY_FRAME_JITTER = -1
+# copy cropped clips to the GPU as uint8 and normalize them there; needs
+# VIDEO_DECODER_SCALING
+__C.VIDEO_GPU_TRANSFORM = False
+# with VIDEO_GPU_TRANSFORM, decode the frames to YUV 4:2:0 and convert them
+# to RGB on the GPU, which halves the cropped clips; needs an even crop size
+__C.VIDEO_GPU_YUV_TRANSFORM = False
+# with VIDEO_GPU_TRANSFORM and the frames of DATASET as JPEG files, copy the
+# encoded frames to the GPU and decode them there with nvJPEG; needs Caffe2
+# built with USE_NVJPEG
+__C.VIDEO_NVJPEG_DECODE = False
+# clip type of the GPU transform: b'float', b'float16', or b'uint8' for
+# clips the model normalizes itself, with an ExpandClip op before conv1
+__C.VIDEO_OUTPUT_TYPE = b'float'
+# number of batches the video input op may prefetch ahead of training; with
+# VIDEO_GPU_TRANSFORM the prefetched batches are kept as uint8 (or I420 with
+# VIDEO_GPU_YUV_TRANSFORM), so 4 of them cost about one float batch
+__C.VIDEO_PREFETCH_DEPTH = 1
+# hand the prefetched batches over to the outputs instead of copying them;
+# the op keeps a few more batch buffers on the device for it
+__C.VIDEO_ZERO_COPY_OUTPUT = False
 
 
 """ This dir is to cache shared indexing of the datasets.
@@ -243,8 +679,61 @@ __C.VIDEO_DECODER_THREADS = 4
 __C.OUTPUT_DIR = b'gen'
 
 __C.LOG_PERIOD = 10
+# iterations between two logs of the stage stats of the video input ops and
+# the decoders (latency histograms, bytes read, frames decoded and kept,
+# seek failures); 0 does not log them
+__C.VIDEO_STATS_PERIOD = 0
+
+# Chrome trace (chrome://tracing) of some iterations of the train net: the op
+# spans per thread and CUDA stream, the allreduce spans, the waits of the net
+# on its input ops and the spans of the decode threads
+__C.TIMELINE = AttrDict()
+# the iteration the trace starts at; -1 does not trace
+__C.TIMELINE.START_ITER = -1
+__C.TIMELINE.NUM_ITERS = 10
+# the spans kept; older spans are dropped when there are more
+__C.TIMELINE.CAPACITY = 1000000
+__C.TIMELINE.PATH = b'timeline.json'
+
+# live bytes per device after every op of one iteration of the train net, and
+# the peak of every device by the op and blob that allocated it, to find what
+# runs out of memory and to check the memonger plan against the allocations
+__C.MEMORY_PROFILE = AttrDict()
+# the iteration tracked; -1 does not track. The first iteration allocates the
+# blobs of the net (the parameters are allocated before), later ones only
+# what is reallocated. The report is also written when the iteration fails.
+__C.MEMORY_PROFILE.ITER = -1
+__C.MEMORY_PROFILE.PATH = b'memory.txt'
 
 __C.PROF_DAG = False
+# cuda streams per gpu for the chains of the train and test nets, which then
+# run as async_scheduling nets: independent branches such as the input copy,
+# the theta / phi / g convs of the non-local blocks and the allreduces
+# overlap; 0 runs the nets as dag nets
+__C.NET_STREAMS = 0
+# run the train and test nets as cuda_graph nets: the runs of consecutive
+# CUDA ops of a gpu are captured into CUDA graphs once their tensors keep
+# their shapes, and replayed with one launch each; for small per-gpu batches
+# that are bound by the kernel launches. The ops run in one thread, in order.
+__C.CUDA_GRAPH = False
+# run the train and test nets as compiled nets: the ops run in order in one
+# thread, as a flat loop that syncs a gpu only where a CPU op or another gpu
+# reads its results, instead of after every op; for the many small ops (BN,
+# affine, reshape, param updates) that are bound by the per-op overhead
+__C.COMPILED_NET = False
+# construct the ops of the nets with a thread per gpu, and run the param init
+# nets as dag nets with a worker per gpu, for a faster start of multi-gpu jobs
+__C.PARALLEL_NET_CREATION = False
+# cores of the CPU budget pool that the decoding of the input ops shares with
+# the OpenMP / MKL threads of the CPU ops, 0 for all of them; the shares are
+# the most of it each may take at a time
+__C.CPU_BUDGET_THREADS = 0
+__C.CPU_BUDGET_DECODE_SHARE = 0.75
+__C.CPU_BUDGET_OPERATOR_SHARE = 0.5
+# split the outer loops of the CPU ops (BN, pooling, transpose, relu and the
+# clip transforms of DecodeVideoClip) over the operator share of the CPU
+# budget pool, e.g. for batch-1 CPU inference
+__C.CPU_PARALLEL_FOR = False
 
 
 def print_cfg():
@@ -275,6 +764,191 @@ def assert_and_infer_cfg():
     assert __C.TEST.BATCH_SIZE % __C.NUM_GPUS == 0, \
         "Test batch size should be multiple of num_gpus."
 
+    assert __C.TRAIN.RECOMPUTE in ('', 'block', 'stage'), \
+        "TRAIN.RECOMPUTE should be '', 'block' or 'stage'."
+    # the SyncSpatialBN ops of a segment read the stats of the other gpus
+    assert not (__C.TRAIN.RECOMPUTE and __C.TRAIN.SYNC_BN), \
+        "TRAIN.RECOMPUTE does not support TRAIN.SYNC_BN."
+
+    assert __C.TRAIN.ALLREDUCE_BUCKET_MB >= 0, \
+        "TRAIN.ALLREDUCE_BUCKET_MB should be >= 0."
+    assert not __C.SOLVER.LR_IN_GRAPH or __C.SOLVER.LR_POLICY in (
+        'steps_with_lrs', 'steps_with_relative_lrs'), \
+        "SOLVER.LR_IN_GRAPH needs a steps_with_(relative_)lrs policy."
+    assert __C.TRAIN.ITERS_PER_RUN >= 1, "TRAIN.ITERS_PER_RUN should be >= 1."
+    assert __C.TRAIN.MICRO_BATCHES >= 1, "TRAIN.MICRO_BATCHES should be >= 1."
+    assert __C.TRAIN.MICRO_BATCHES == 1 or __C.TRAIN.BATCH_SIZE % (
+        __C.NUM_GPUS * __C.TRAIN.MICRO_BATCHES) == 0, \
+        "TRAIN.BATCH_SIZE should divide into NUM_GPUS * TRAIN.MICRO_BATCHES."
+    assert __C.TRAIN.MICRO_BATCHES == 1 or not (
+        __C.TRAIN.FLATTEN_PARAMS or __C.TRAIN.ALLREDUCE_BUCKET_MB > 0 or
+        __C.FP16.ENABLED), \
+        "TRAIN.MICRO_BATCHES does not support TRAIN.FLATTEN_PARAMS, " \
+        "TRAIN.ALLREDUCE_BUCKET_MB or FP16."
+    assert not (__C.CUDA_GRAPH and (__C.PROF_DAG or __C.NET_STREAMS > 0)), \
+        "CUDA_GRAPH does not support PROF_DAG or NET_STREAMS."
+    assert not (__C.COMPILED_NET and (
+        __C.PROF_DAG or __C.NET_STREAMS > 0 or __C.CUDA_GRAPH)), \
+        "COMPILED_NET does not support PROF_DAG, NET_STREAMS or CUDA_GRAPH."
+    assert __C.TRAIN.ITERS_PER_RUN == 1 or __C.SOLVER.LR_IN_GRAPH, \
+        "TRAIN.ITERS_PER_RUN > 1 needs SOLVER.LR_IN_GRAPH."
+    assert 0. < __C.MODEL.INPLACE_ABN_SLOPE <= 1., \
+        "MODEL.INPLACE_ABN_SLOPE must be in (0, 1]."
+    assert not __C.MODEL.COMPACT_ACTIVATIONS or (
+        __C.MODEL.MEMORY_PLAN and not __C.FP16.ENABLED), \
+        "MODEL.COMPACT_ACTIVATIONS needs MODEL.MEMORY_PLAN, without FP16."
+    assert not __C.TRAIN.ASYNC_EVAL or not (
+        __C.TRAIN.EVAL_SHARES_TRAIN_MEMORY or __C.PIPELINE.ENABLED or
+        __C.CUDA_GRAPH), \
+        "TRAIN.ASYNC_EVAL does not support TRAIN.EVAL_SHARES_TRAIN_MEMORY, " \
+        "PIPELINE.ENABLED or CUDA_GRAPH."
+    if __C.TRAIN.TEMPORAL_SHARDS > 1:
+        shards = __C.TRAIN.TEMPORAL_SHARDS
+        assert __C.NUM_GPUS % shards == 0 and \
+            __C.TRAIN.BATCH_SIZE % (__C.NUM_GPUS // shards) == 0, \
+            "NUM_GPUS should divide into TRAIN.TEMPORAL_SHARDS groups, " \
+            "TRAIN.BATCH_SIZE into the groups."
+        # pool2 halves the frames of every shard
+        assert __C.TRAIN.VIDEO_LENGTH % (2 * shards) == 0, \
+            "TRAIN.VIDEO_LENGTH should divide into 2 * TRAIN.TEMPORAL_SHARDS."
+        assert __C.TRAIN.SYNC_BN and not __C.DEBUG, \
+            "TRAIN.TEMPORAL_SHARDS needs TRAIN.SYNC_BN and NCCL (no DEBUG)."
+        assert __C.MODEL.MODEL_NAME == 'resnet_video' and not (
+            __C.MODEL.USE_AFFINE or __C.NONLOCAL.USE_FUSED_ATTENTION or
+            len(__C.NONLOCAL.WINDOW) > 0 or
+            __C.MODEL.TEMPORAL_SHIFT_DIV > 0), \
+            "TRAIN.TEMPORAL_SHARDS needs the resnet_video model, without " \
+            "MODEL.USE_AFFINE, NONLOCAL.USE_FUSED_ATTENTION, " \
+            "NONLOCAL.WINDOW or MODEL.TEMPORAL_SHIFT_DIV."
+        # the blobs that the other gpus read are neither shared nor planned
+        assert not (
+            __C.MODEL.MEMONGER or __C.MODEL.MEMORY_PLAN or
+            __C.PIPELINE.ENABLED or __C.DECODE_SERVICE.ENABLED or
+            len(__C.TRAIN.MULTIGRID_SHAPES) > 0), \
+            "TRAIN.TEMPORAL_SHARDS does not support MODEL.MEMONGER, " \
+            "MODEL.MEMORY_PLAN, PIPELINE.ENABLED, DECODE_SERVICE.ENABLED " \
+            "or TRAIN.MULTIGRID_SHAPES."
+    assert not __C.TRAIN.SHARD_OPTIMIZER_STATE or (
+        __C.TRAIN.FLATTEN_PARAMS and not __C.SOLVER.LAYERWISE and
+        __C.TRAIN.ALLREDUCE_BUCKET_MB == 0 and not __C.DEBUG), \
+        "TRAIN.SHARD_OPTIMIZER_STATE needs TRAIN.FLATTEN_PARAMS and NCCL (no " \
+        "DEBUG), and does not support SOLVER.LAYERWISE or " \
+        "TRAIN.ALLREDUCE_BUCKET_MB."
+    if __C.PIPELINE.ENABLED:
+        assert __C.NUM_GPUS == 1, \
+            "PIPELINE.ENABLED needs NUM_GPUS 1, the stages take their gpus."
+        assert len(__C.PIPELINE.STAGE_STARTS) > 0, \
+            "PIPELINE.ENABLED needs PIPELINE.STAGE_STARTS."
+        # the pipeline clones and places the ops as they are built
+        assert not (
+            __C.MODEL.MEMONGER or __C.MODEL.MEMORY_PLAN or
+            __C.TRAIN.RECOMPUTE or __C.TRAIN.FLATTEN_PARAMS or
+            __C.TRAIN.ALLREDUCE_BUCKET_MB > 0 or __C.FP16.ENABLED), \
+            "PIPELINE.ENABLED does not support MODEL.MEMONGER, " \
+            "MODEL.MEMORY_PLAN, TRAIN.RECOMPUTE, TRAIN.FLATTEN_PARAMS, " \
+            "TRAIN.ALLREDUCE_BUCKET_MB or FP16."
+        # the schedule runs on the threads of a dag net
+        assert not (__C.CUDA_GRAPH or __C.NET_STREAMS > 0 or
+                    __C.COMPILED_NET), \
+            "PIPELINE.ENABLED does not support CUDA_GRAPH, NET_STREAMS or " \
+            "COMPILED_NET."
+    if len(__C.NONLOCAL.WINDOW) > 0:
+        assert len(__C.NONLOCAL.WINDOW) == 3 and all(
+            size > 0 and size % 2 == 1 for size in __C.NONLOCAL.WINDOW), \
+            "NONLOCAL.WINDOW should be 3 odd sizes [t, h, w]."
+        assert len(__C.NONLOCAL.WINDOW_DILATION) == 3 and all(
+            step > 0 for step in __C.NONLOCAL.WINDOW_DILATION), \
+            "NONLOCAL.WINDOW_DILATION should be 3 steps > 0 [t, h, w]."
+        assert __C.NONLOCAL.USE_SOFTMAX and \
+            not __C.NONLOCAL.USE_FUSED_ATTENTION, \
+            "NONLOCAL.WINDOW needs NONLOCAL.USE_SOFTMAX, and does not " \
+            "support NONLOCAL.USE_FUSED_ATTENTION."
+    assert not __C.NONLOCAL.FUSE_POOL_PROJECTION or \
+        __C.NONLOCAL.USE_MAXPOOL, \
+        "NONLOCAL.FUSE_POOL_PROJECTION needs NONLOCAL.USE_MAXPOOL."
+    assert __C.SOLVER.LAYERWISE in ('', 'lars', 'lamb'), \
+        "SOLVER.LAYERWISE should be '', 'lars' or 'lamb'."
+
+    assert __C.CHECKPOINT.FORMAT in ('pkl', 'minidb'), \
+        "CHECKPOINT.FORMAT should be 'pkl' or 'minidb'."
+    assert __C.CHECKPOINT.SAVE_THREADS > 0, \
+        "CHECKPOINT.SAVE_THREADS should be > 0."
+    assert not __C.CHECKPOINT.ASYNC_SAVE or \
+        __C.CHECKPOINT.FORMAT == 'minidb', \
+        "CHECKPOINT.ASYNC_SAVE needs CHECKPOINT.FORMAT 'minidb'."
+
+    assert __C.REMOTE_VIDEO.ENABLED or not __C.REMOTE_VIDEO.DB_LIST, \
+        "REMOTE_VIDEO.DB_LIST needs REMOTE_VIDEO.ENABLED."
+    assert __C.REMOTE_VIDEO.BLOCK_KB > 0, \
+        "REMOTE_VIDEO.BLOCK_KB should be > 0."
+    if __C.DECODE_SERVICE.ENABLED:
+        assert len(__C.DECODE_SERVICE.ADDRESSES) > 0, \
+            "DECODE_SERVICE.ENABLED needs DECODE_SERVICE.ADDRESSES."
+        assert __C.VIDEO_GPU_TRANSFORM, \
+            "DECODE_SERVICE.ENABLED needs VIDEO_GPU_TRANSFORM."
+        assert __C.DECODE_SERVICE.CREDITS > 0, \
+            "DECODE_SERVICE.CREDITS should be > 0."
+    assert not (__C.SYNTHETIC_INPUT.ENABLED and __C.DECODE_SERVICE.ENABLED), \
+        "SYNTHETIC_INPUT.ENABLED does not support DECODE_SERVICE.ENABLED."
+
+    if __C.TEST.EARLY_EXIT_MARGIN > 0:
+        assert __C.TEST.OUTPUT_CLIP_INDEX, \
+            "TEST.EARLY_EXIT_MARGIN needs TEST.OUTPUT_CLIP_INDEX."
+        assert not __C.TEST.EXPAND_VIEWS, \
+            "TEST.EARLY_EXIT_MARGIN does not support TEST.EXPAND_VIEWS."
+        assert not __C.VIDEO_DECODER_PARALLEL_READS, \
+            "TEST.EARLY_EXIT_MARGIN does not support " \
+            "VIDEO_DECODER_PARALLEL_READS."
+
+    assert not (__C.VIDEO_DECODER_SCHEDULE_BY_COST and
+                __C.VIDEO_DECODER_PARALLEL_READS), \
+        "VIDEO_DECODER_SCHEDULE_BY_COST does not support " \
+        "VIDEO_DECODER_PARALLEL_READS."
+    assert not (__C.TEST.AGGREGATE_ON_DEVICE and
+                __C.TEST.EARLY_EXIT_MARGIN > 0), \
+        "TEST.AGGREGATE_ON_DEVICE does not support TEST.EARLY_EXIT_MARGIN."
+    if __C.TEST.SHARDED:
+        assert __C.TEST.AGGREGATE_ON_DEVICE, \
+            "TEST.SHARDED needs TEST.AGGREGATE_ON_DEVICE."
+        assert 0 <= __C.TEST.SHARD_ID < __C.TEST.NUM_SHARDS, \
+            "TEST.SHARD_ID should be in [0, TEST.NUM_SHARDS)."
+        assert __C.TEST.NUM_SHARDS == 1 or __C.TEST.RENDEZVOUS_PATH, \
+            "TEST.NUM_SHARDS > 1 needs TEST.RENDEZVOUS_PATH."
+
+    assert 0 < __C.CPU_BUDGET_DECODE_SHARE <= 1 and \
+        0 < __C.CPU_BUDGET_OPERATOR_SHARE <= 1, \
+        "CPU_BUDGET_DECODE_SHARE and CPU_BUDGET_OPERATOR_SHARE should be " \
+        "in (0, 1]."
+    assert __C.CUDA_MEMORY_POOL in ('', 'cub', 'caching'), \
+        "CUDA_MEMORY_POOL should be '', 'cub' or 'caching'."
+    assert __C.TEST.TENSOR_GROWTH_FACTOR == 0 or \
+        __C.TEST.TENSOR_GROWTH_FACTOR >= 1, \
+        "TEST.TENSOR_GROWTH_FACTOR should be 0 or at least 1."
+
+    # the recompute segments are ranges of the ops as they are built
+    assert not (__C.MODEL.FUSE_POINTWISE and __C.TRAIN.RECOMPUTE), \
+        "MODEL.FUSE_POINTWISE does not support TRAIN.RECOMPUTE."
+
+    if __C.FP16.ENABLED:
+        # ops without an fp16 version
+        assert not __C.MODEL.FUSE_POINTWISE, \
+            "FP16 does not support MODEL.FUSE_POINTWISE."
+        assert not __C.TRAIN.SYNC_BN, "FP16 does not support TRAIN.SYNC_BN."
+        assert not (
+            __C.NONLOCAL.USE_FUSED_ATTENTION or
+            len(__C.NONLOCAL.WINDOW) > 0 or
+            __C.NONLOCAL.FUSE_POOL_PROJECTION or
+            __C.RESNETS.DIRECT_GROUP_CONV or
+            __C.MODEL.TEMPORAL_SHIFT_DIV > 0), \
+            "FP16 does not support NONLOCAL.USE_FUSED_ATTENTION, " \
+            "NONLOCAL.WINDOW, NONLOCAL.FUSE_POOL_PROJECTION, " \
+            "RESNETS.DIRECT_GROUP_CONV or MODEL.TEMPORAL_SHIFT_DIV."
+        # the folds need the conv params as net inputs, not casts
+        assert not __C.TEST.FOLD_AFFINE, \
+            "FP16 does not support TEST.FOLD_AFFINE."
+        assert not __C.TEST.OPTIMIZE_INFERENCE, \
+            "FP16 does not support TEST.OPTIMIZE_INFERENCE."
+
 
 def merge_dicts(dict_a, dict_b):
     from ast import literal_eval
@@ -36,13 +36,17 @@ import logging
 
 from caffe2.proto import caffe2_pb2
 from caffe2.python import \
-    workspace, scope, core, cnn, data_parallel_model
+    workspace, scope, core, cnn, brew, data_parallel_model
 
 from models import (
+    pipeline_helper,
     resnet_video,
     resnet_video_org,
+    temporal_shard_helper,
 )
 
+import utils.compact_activations as compact_activations
+import utils.metrics as metrics
 import utils.misc as misc
 import utils.lr_policy as lr_policy
 
@@ -65,6 +69,9 @@ class ModelBuilder(cnn.CNNModelHelper):
         self.split = kwargs.get('split', 'train')
         self.use_mem_cache = kwargs.get('use_mem_cache', False)
         self.force_fw_only = kwargs.get('force_fw_only', False)
+        # a test model that runs on the blobs of the train model, see
+        # TRAIN.EVAL_SHARES_TRAIN_MEMORY
+        self.share_train_memory = kwargs.get('share_train_memory', False)
 
         if 'train' in kwargs:
             del kwargs['train']
@@ -74,6 +81,8 @@ class ModelBuilder(cnn.CNNModelHelper):
             del kwargs['use_mem_cache']
         if 'force_fw_only' in kwargs:
             del kwargs['force_fw_only']
+        if 'share_train_memory' in kwargs:
+            del kwargs['share_train_memory']
 
         super(ModelBuilder, self).__init__(**kwargs)
         # Keeping this here in case we have some other params in future to try
@@ -86,6 +95,18 @@ class ModelBuilder(cnn.CNNModelHelper):
         self.SetCurrentLr(0)
 
         self.model_name = kwargs.get('name')
+        # the blobs built between StartFP16 and StopFP16 are fp16
+        self.fp16 = False
+        # the op counts of the net when the gradient and the update ops were
+        # added, for PIPELINE.ENABLED
+        self._pipeline_forward_ops = None
+        self._pipeline_update_ops = None
+        # the gpus that share the frames of the clips, TRAIN.TEMPORAL_SHARDS,
+        # and the copies between them (see temporal_shard_helper)
+        self.temporal_shards = (
+            cfg.TRAIN.TEMPORAL_SHARDS
+            if self.train and not self.force_fw_only else 1)
+        self._shard_links = {}
 
     def TrainableParams(self, scope=''):
         return [
@@ -100,15 +121,21 @@ class ModelBuilder(cnn.CNNModelHelper):
 
     def build_model(self, node_id=0):
 
-        # use lmdb
+        # use lmdb, or a list of remote videos; synthetic clips need no db.
+        # A sharded test opens a reader per gpu instead, see
+        # create_shard_reader
         dirname = cfg.DATADIR
-        self.data_loader = self.CreateDB(
-            "reader_" + self.split,
-            db=dirname + '/' + self.split + '',
-            db_type="lmdb",
-            num_shards=1,
-            shard_id=node_id,
-        )
+        if not cfg.SYNTHETIC_INPUT.ENABLED and not self.sharded_test():
+            self.data_loader = self.CreateDB(
+                "reader_" + self.split,
+                db=dirname + '/' + self.split + '',
+                db_type=(
+                    'remote_video' if cfg.REMOTE_VIDEO.DB_LIST else 'lmdb'),
+                num_shards=1,
+                shard_id=node_id,
+                shuffle=self.train and cfg.TRAIN.SHUFFLE_DB,
+                shuffle_seed=cfg.RNG_SEED,
+            )
 
         self.create_data_parallel_model(
             model=self, db_loader=self.data_loader,
@@ -125,74 +152,17 @@ class ModelBuilder(cnn.CNNModelHelper):
         # we use TRAIN.BATCH_SIZE or TEST.BATCH_SIZE as in original img cls code
         batch_size = misc.get_batch_size(self.split)
 
-        # ------- AddVideoInput
-        def AddVideoInput(model, reader, batch_size):
-
-            now_height = cfg.TRAIN.JITTER_SCALES[0]
-            now_width = int(now_height * 340.0 / 256.0)
-
-            use_mirror = 1
-            use_temporal_jitter = 1
-            min_size = cfg.TRAIN.JITTER_SCALES[0]
-            max_size = cfg.TRAIN.JITTER_SCALES[1]
-            is_test = 0
-            decode_threads = cfg.VIDEO_DECODER_THREADS
-            print(self.model_name)
-            if '_bn_aux' in self.model_name:
-                decode_threads = 1
-            if self.split == 'val':
-                decode_threads = 1
-            if self.split == 'test':
-                use_mirror = 0
-                use_temporal_jitter = 0
-                min_size = cfg.TEST.SCALE
-                max_size = cfg.TEST.SCALE
-                is_test = 1
-
-            sample_times = cfg.TEST.NUM_TEST_CLIPS
-            # multi crop testing
-            if cfg.TEST.USE_MULTI_CROP == 1:
-                sample_times = int(sample_times / 3)
-            elif cfg.TEST.USE_MULTI_CROP == 2:
-                sample_times = int(sample_times / 6)
-
-            data, label = model.net.CustomizedVideoInput(
-                reader,
-                ["data", "labels"],
-                name="data",
-                batch_size=batch_size,
-                width=now_width,
-                height=now_height,
-                crop=cfg.TRAIN.CROP_SIZE,  # e.g., 224
-                decode_threads=decode_threads,  # e.g., 4
-                length=cfg.TRAIN.VIDEO_LENGTH,  # e.g., 32
-                sampling_rate=cfg.TRAIN.SAMPLE_RATE,  # e.g., 2
-                mirror=use_mirror,
-                mean=cfg.MODEL.MEAN,
-                std=cfg.MODEL.STD,
-                use_local_file=1,
-                # for training, we need to random clip
-                temporal_jitter=use_temporal_jitter,
-                # Note: we set use_scale_augmentaiton = 1 but the range
-                # can be fixed, e.g., [256, 256]
-                use_scale_augmentaiton=1,
-                min_size=min_size,  # e.g., 256
-                max_size=max_size,  # e.g., 260
-                is_test=is_test,  # make it explicit
-                use_bgr=cfg.MODEL.USE_BGR,
-                sample_times=sample_times,
-                use_multi_crop=cfg.TEST.USE_MULTI_CROP
-            )
-
-            data = model.StopGradient(data, data)
-        # ------- end of AddVideoInput
-
         def add_video_input(model):
-            AddVideoInput(
-                model,
-                db_loader,
-                batch_size=batch_size,
-            )
+            # the first gpu of a group of temporal shards reads the clips of
+            # the group
+            if temporal_shard_helper.shard_id(model) > 0:
+                temporal_shard_helper.copy_clips(model)
+                return
+            reader = db_loader
+            if self.sharded_test() and not cfg.SYNTHETIC_INPUT.ENABLED:
+                reader = self.create_shard_reader(model)
+            self.add_video_input(
+                model, reader, batch_size * self.temporal_shards)
 
         input_builder_fun = add_video_input
 
@@ -213,10 +183,370 @@ class ModelBuilder(cnn.CNNModelHelper):
             devices=gpus,
             rendezvous=rendezvous_ctx,
             broadcast_computed_params=False,
-            optimize_gradient_memory=cfg.MODEL.MEMONGER,
+            optimize_gradient_memory=(
+                cfg.MODEL.MEMONGER and not cfg.MODEL.MEMORY_PLAN),
             use_nccl=not cfg.DEBUG,  # org: True
+            combine_spatial_bn=(
+                cfg.TRAIN.SYNC_BN and train and not force_fw_only),
+            allreduce_bucket_mb=cfg.TRAIN.ALLREDUCE_BUCKET_MB,
+            flatten_params=cfg.TRAIN.FLATTEN_PARAMS,
+            # the pipeline runs its own micro-batches
+            micro_batches=(
+                cfg.TRAIN.MICRO_BATCHES
+                if train and not force_fw_only and not cfg.PIPELINE.ENABLED
+                else 1),
+            shard_optimizer_state=(
+                cfg.TRAIN.SHARD_OPTIMIZER_STATE and train and
+                not force_fw_only),
+            link_devices_fun=(
+                temporal_shard_helper.link_shards
+                if self.temporal_shards > 1 else None),
         )
 
+        if cfg.PIPELINE.ENABLED:
+            pipeline_helper.pipeline_model(
+                model, cfg.TRAIN.MICRO_BATCHES
+                if train and not force_fw_only else 1)
+
+        # a shared test net uses the arena of the train net: an arena of its
+        # own would move the blobs of the train net
+        if cfg.MODEL.MEMORY_PLAN and not self.share_train_memory:
+            self.plan_activation_memory(batch_size)
+
+    def sharded_test(self):
+        return self.split == 'test' and cfg.TEST.SHARDED
+
+    # The reader of the shard of the test db of the current gpu, one of
+    # TEST.NUM_SHARDS x NUM_GPUS, so that the gpus of all the test processes
+    # read disjoint records without sharing a reader.
+    def create_shard_reader(self, model):
+        gpu_index = scope.CurrentDeviceScope().cuda_gpu_id - cfg.ROOT_GPU_ID
+        return model.CreateDB(
+            "reader_" + self.split,
+            db=cfg.DATADIR + '/' + self.split,
+            db_type=(
+                'remote_video' if cfg.REMOTE_VIDEO.DB_LIST else 'lmdb'),
+            num_shards=cfg.TEST.NUM_SHARDS * cfg.NUM_GPUS,
+            shard_id=cfg.TEST.SHARD_ID * cfg.NUM_GPUS + gpu_index,
+        )
+
+    # The clips of a tower, or, with decode_server, the uint8 clips, labels
+    # and mirror flags that tools/decode_server_video.py sends to the
+    # training nodes.
+    def add_video_input(self, model, reader, batch_size, decode_server=False):
+
+        # the training clips come decoded from the nodes that run
+        # tools/decode_server_video.py, see DECODE_SERVICE
+        if self.train and cfg.DECODE_SERVICE.ENABLED and not decode_server:
+            data, _ = model.net.ZmqClipInput(
+                [],
+                ["data", "labels"],
+                name="data",
+                addresses=cfg.DECODE_SERVICE.ADDRESSES,
+                credits=cfg.DECODE_SERVICE.CREDITS,
+                timeout_ms=cfg.DECODE_SERVICE.TIMEOUT_MS,
+                use_gpu_transform=1,
+                mean=cfg.MODEL.MEAN,
+                std=cfg.MODEL.STD,
+                use_bgr=cfg.MODEL.USE_BGR,
+                output_type=cfg.VIDEO_OUTPUT_TYPE,
+            )
+            model.StopGradient(data, data)
+            return
+
+        now_height = cfg.TRAIN.JITTER_SCALES[0]
+        now_width = int(now_height * 340.0 / 256.0)
+
+        use_mirror = 1
+        use_temporal_jitter = 1
+        min_size = cfg.TRAIN.JITTER_SCALES[0]
+        max_size = cfg.TRAIN.JITTER_SCALES[1]
+        is_test = 0
+        decode_threads = cfg.VIDEO_DECODER_THREADS
+        print(self.model_name)
+        if '_bn_aux' in self.model_name:
+            decode_threads = 1
+        if self.split == 'val':
+            decode_threads = 1
+        if self.split == 'test':
+            use_mirror = 0
+            use_temporal_jitter = 0
+            min_size = cfg.TEST.SCALE
+            max_size = cfg.TEST.SCALE
+            is_test = 1
+
+        sample_times = cfg.TEST.NUM_TEST_CLIPS
+        # multi crop testing
+        if cfg.TEST.USE_MULTI_CROP == 1:
+            sample_times = int(sample_times / 3)
+        elif cfg.TEST.USE_MULTI_CROP == 2:
+            sample_times = int(sample_times / 6)
+
+        # the test net can also output which video and clip every slot
+        # holds, see TEST.OUTPUT_CLIP_INDEX
+        output_clip_index = \
+            self.split == 'test' and cfg.TEST.OUTPUT_CLIP_INDEX
+        outputs = ["data", "labels"]
+        if output_clip_index:
+            outputs += ["video_ids", "clip_index"]
+        if decode_server:
+            outputs += ["mirror"]
+
+        # the outputs of the video input op, generated once without a db
+        if cfg.SYNTHETIC_INPUT.ENABLED and not decode_server:
+            blobs_out = model.net.SyntheticVideoInput(
+                [],
+                outputs,
+                name="data",
+                batch_size=batch_size,
+                height=now_height,
+                width=now_width,
+                crop=cfg.TRAIN.CROP_SIZE,
+                length=cfg.TRAIN.VIDEO_LENGTH,
+                mean=cfg.MODEL.MEAN,
+                std=cfg.MODEL.STD,
+                num_classes=max(cfg.MODEL.NUM_CLASSES, 1),
+                use_gpu_transform=int(cfg.VIDEO_GPU_TRANSFORM),
+                output_type=cfg.VIDEO_OUTPUT_TYPE,
+                output_clip_index=int(output_clip_index),
+                constant=int(cfg.SYNTHETIC_INPUT.CONSTANT),
+            )
+            model.StopGradient(blobs_out[0], blobs_out[0])
+            return
+
+        # the shapes of the training batches, see TRAIN.MULTIGRID_SHAPES
+        multigrid_args = {}
+        if self.train and len(cfg.TRAIN.MULTIGRID_SHAPES) > 0:
+            multigrid_args = dict(
+                clip_shapes=[
+                    int(v) for shape in cfg.TRAIN.MULTIGRID_SHAPES
+                    for v in shape],
+                clip_shape_iters=[int(n) for n in cfg.TRAIN.MULTIGRID_ITERS],
+            )
+
+        blobs_out = model.net.CustomizedVideoInput(
+            reader,
+            outputs,
+            name="data",
+            batch_size=batch_size,
+            width=now_width,
+            height=now_height,
+            crop=cfg.TRAIN.CROP_SIZE,  # e.g., 224
+            decode_threads=decode_threads,  # e.g., 4
+            adaptive_decode_threads=int(
+                cfg.VIDEO_DECODER_ADAPTIVE_THREADS and decode_threads > 1),
+            min_decode_threads=cfg.VIDEO_DECODER_MIN_THREADS,
+            max_decode_threads=cfg.VIDEO_DECODER_MAX_THREADS,
+            length=cfg.TRAIN.VIDEO_LENGTH,  # e.g., 32
+            sampling_rate=cfg.TRAIN.SAMPLE_RATE,  # e.g., 2
+            mirror=use_mirror,
+            mean=cfg.MODEL.MEAN,
+            std=cfg.MODEL.STD,
+            use_local_file=1,
+            use_image=int(cfg.VIDEO_FRAMES_INPUT),
+            im_extension=cfg.VIDEO_FRAMES_EXTENSION,
+            # for training, we need to random clip
+            temporal_jitter=use_temporal_jitter,
+            # Note: we set use_scale_augmentaiton = 1 but the range
+            # can be fixed, e.g., [256, 256]
+            use_scale_augmentaiton=1,
+            min_size=min_size,  # e.g., 256
+            max_size=max_size,  # e.g., 260
+            is_test=is_test,  # make it explicit
+            use_bgr=cfg.MODEL.USE_BGR,
+            sample_times=sample_times,
+            use_multi_crop=cfg.TEST.USE_MULTI_CROP,
+            use_selective_decoding=cfg.VIDEO_DECODER_SELECTIVE,
+            skip_nonref_frames=int(cfg.VIDEO_DECODER_SKIP_NONREF),
+            target_fps=float(cfg.VIDEO_DECODER_TARGET_FPS),
+            codec_threads=cfg.VIDEO_DECODER_CODEC_THREADS,
+            decode_cpu_budget=cfg.VIDEO_DECODER_CPU_BUDGET,
+            use_decoder_scaling=cfg.VIDEO_DECODER_SCALING,
+            use_decoder_cache=cfg.VIDEO_DECODER_CACHE,
+            use_frame_arena=int(cfg.VIDEO_DECODER_FRAME_ARENA),
+            io_buffer_size=cfg.VIDEO_DECODER_IO_BUFFER,
+            use_mmap=int(cfg.VIDEO_DECODER_MMAP),
+            readahead_files=int(cfg.VIDEO_DECODER_READAHEAD),
+            parallel_reads=int(cfg.VIDEO_DECODER_PARALLEL_READS),
+            schedule_by_cost=int(cfg.VIDEO_DECODER_SCHEDULE_BY_COST),
+            remote_files=int(cfg.REMOTE_VIDEO.ENABLED),
+            remote_cache_dir=cfg.REMOTE_VIDEO.CACHE_DIR,
+            remote_cache_mb=cfg.REMOTE_VIDEO.CACHE_MB,
+            remote_block_kb=cfg.REMOTE_VIDEO.BLOCK_KB,
+            remote_connections=cfg.REMOTE_VIDEO.CONNECTIONS,
+            remote_prefetch_threads=cfg.REMOTE_VIDEO.PREFETCH_THREADS,
+            remote_prefetch_blocks=cfg.REMOTE_VIDEO.PREFETCH_BLOCKS,
+            reuse_multi_crop_clips=int(
+                is_test == 1 and cfg.TEST.USE_MULTI_CROP > 0 and
+                cfg.TEST.REUSE_MULTI_CROP_CLIPS),
+            expand_test_views=int(is_test == 1 and cfg.TEST.EXPAND_VIEWS),
+            decode_backend=cfg.VIDEO_DECODER_BACKEND,
+            decode_quality=cfg.VIDEO_DECODER_QUALITY,
+            video_meta_index=cfg.VIDEO_META_INDEX,
+            skip_stream_info=int(cfg.VIDEO_SKIP_STREAM_INFO),
+            key_frame_jitter=cfg.VIDEO_KEY_FRAME_JITTER,
+            bad_video_list=cfg.DATALOADER.BAD_VIDEO_LIST,
+            max_bad_videos=cfg.DATALOADER.MAX_BAD_IMAGES,
+            frame_cache_name=(
+                cfg.TRAIN.MEM_CACHE_NAME
+                if self.train and self.use_mem_cache else b''),
+            frame_cache_size_mb=cfg.TRAIN.MEM_CACHE_SIZE_MB,
+            frame_cache_frame_bytes=cfg.TRAIN.MEM_CACHE_FRAME_BYTES,
+            clip_cache_name=(
+                cfg.TEST.CLIP_CACHE_NAME
+                if is_test == 1 and cfg.TEST.CLIP_CACHE else b''),
+            clip_cache_size_mb=cfg.TEST.CLIP_CACHE_SIZE_MB,
+            clip_cache_clip_bytes=cfg.TEST.CLIP_CACHE_CLIP_BYTES,
+            use_gpu_transform=int(cfg.VIDEO_GPU_TRANSFORM or decode_server),
+            use_gpu_yuv_transform=int(cfg.VIDEO_GPU_YUV_TRANSFORM),
+            use_nvjpeg=int(cfg.VIDEO_NVJPEG_DECODE),
+            output_type=cfg.VIDEO_OUTPUT_TYPE,
+            bucket_buffer_size=cfg.TEST.UNCROPPED_BUCKET_BUFFER,
+            prefetch_depth=cfg.VIDEO_PREFETCH_DEPTH,
+            zero_copy_output=int(cfg.VIDEO_ZERO_COPY_OUTPUT),
+            use_work_stealing_pool=int(cfg.VIDEO_DECODER_WORK_STEALING),
+            use_cpu_budget_pool=int(cfg.VIDEO_DECODER_CPU_BUDGET_POOL),
+            bind_to_device_numa=int(cfg.VIDEO_DECODER_NUMA_BIND),
+            output_clip_index=int(output_clip_index),
+            progressive_test=int(
+                is_test == 1 and cfg.TEST.EARLY_EXIT_MARGIN > 0),
+            score_board=early_exit_board(),
+            progressive_window=cfg.TEST.EARLY_EXIT_WINDOW,
+            **multigrid_args
+        )
+        if decode_server:
+            return blobs_out
+        data = blobs_out[0]
+
+        data = model.StopGradient(data, data)
+
+    # Static memory plan of the nets of every gpu: the shapes follow from
+    # the input clips, which needs a fixed crop size.
+    def plan_activation_memory(self, batch_size):
+        if cfg.TRAIN.CROP_SIZE <= 0:
+            logger.warning('No memory plan for uncropped clips.')
+            return
+        if self.train and len(cfg.TRAIN.MULTIGRID_SHAPES) > 0:
+            logger.warning('No memory plan for multigrid clip shapes.')
+            return
+        crop = cfg.TRAIN.CROP_SIZE
+        input_shapes = {
+            'data': [batch_size, 3, cfg.TRAIN.VIDEO_LENGTH, crop, crop],
+            'labels': [batch_size],
+        }
+        # the blobs that the tools and the metrics fetch
+        excluded_blobs = [
+            'pred', 'softmax', 'loss', 'lr', 'video_ids', 'clip_index',
+            'clip_status', 'clip_counts', cfg.TEST.OUTPUT_NAME,
+            cfg.TEST.OUTPUT_NAME + '_video', cfg.TEST.OUTPUT_NAME + '_sum',
+            cfg.TEST.OUTPUT_NAME + '_max']
+        data_parallel_model.PlanActivationMemory(
+            self, input_shapes, excluded_blobs)
+
+    # Whether the input op outputs its clips as uint8, unnormalized: with
+    # VIDEO_OUTPUT_TYPE b'uint8' and a GPU transform, i.e. VIDEO_GPU_TRANSFORM
+    # or the clips of the decode service.
+    def _uint8_clips(self):
+        return cfg.VIDEO_OUTPUT_TYPE == b'uint8' and (
+            cfg.VIDEO_GPU_TRANSFORM or
+            (self.train and cfg.DECODE_SERVICE.ENABLED))
+
+    # Normalizes the uint8 clips of blob_in with a single ExpandClip op, to
+    # fp16 with FP16.ENABLED and to float otherwise; the other clips are
+    # normalized by the input op already.
+    def ExpandClips(self, blob_in):
+        if not self._uint8_clips():
+            return blob_in
+        blob_out = self.net.ExpandClip(
+            blob_in, blob_in + '_expanded',
+            mean=cfg.MODEL.MEAN,
+            std=cfg.MODEL.STD,
+            output_type=b'float16' if cfg.FP16.ENABLED else b'float',
+        )
+        return self.StopGradient(blob_out, blob_out)
+
+    # ----------------------------
+    # mixed precision
+    # ----------------------------
+    # With FP16.ENABLED, casts blob_in (the clips) to fp16 unless the input
+    # op, or ExpandClips, outputs fp16 already, and builds the following
+    # convs and affines on fp16 copies of their params.
+    def StartFP16(self, blob_in):
+        if not cfg.FP16.ENABLED:
+            return blob_in
+        self.fp16 = True
+        if self._uint8_clips() or (
+                cfg.VIDEO_GPU_TRANSFORM and
+                cfg.VIDEO_OUTPUT_TYPE == b'float16'):
+            return blob_in
+        blob_out = self.net.FloatToHalf(blob_in, blob_in + '_fp16')
+        return self.StopGradient(blob_out, blob_out)
+
+    def StopFP16(self, blob_in):
+        if not self.fp16:
+            return blob_in
+        self.fp16 = False
+        return self.net.HalfToFloat(blob_in, blob_in + '_fp32')
+
+    # The param stays the fp32 master: the cast is part of the net, so its
+    # gradient (HalfToFloat) gives the fp32 gradient of the param.
+    def _ParamsToFP16(self, params):
+        return [self.net.FloatToHalf(param, str(param) + '_fp16')
+                for param in params]
+
+    def ConvNd(self, *args, **kwargs):
+        temporal_shift = kwargs.pop('temporal_shift', 0)
+        if temporal_shift > 0:
+            return self._TemporalShiftConvNd(temporal_shift, *args, **kwargs)
+        if self.fp16:
+            def transform_inputs(model, blob_out, inputs):
+                inputs[1:] = self._ParamsToFP16(inputs[1:])
+            kwargs['transform_inputs'] = transform_inputs
+        if self.temporal_shards > 1 and args[4][0] > 1:
+            # the frames of the neighbouring shards instead of the temporal
+            # pads
+            blob_in, kwargs['pads'] = temporal_shard_helper.exchange_halo(
+                self, args[0], args[4], kwargs.get('strides'), kwargs['pads'])
+            args = (blob_in,) + args[1:]
+        if kwargs.get('group', 1) > 1 and cfg.RESNETS.DIRECT_GROUP_CONV:
+            # the direct grouped conv kernels of the DIRECT engine
+            return brew.conv_nd(
+                self, *args, use_cudnn=False, order=self.order,
+                engine='DIRECT', **kwargs)
+        return super(ModelBuilder, self).ConvNd(*args, **kwargs)
+
+    # ConvNd of blob_in shifted along time (TemporalShift), with the 1x1x1
+    # convs as one TemporalShiftConv op with the params of the ConvNd
+    def _TemporalShiftConvNd(
+            self, shift_div, blob_in, blob_out, dim_in, dim_out, kernels,
+            **kwargs):
+        pointwise = list(kernels) == [1, 1, 1] and \
+            list(kwargs.get('strides', [1, 1, 1])) == [1, 1, 1] and \
+            kwargs.get('group', 1) == 1
+        if not (cfg.MODEL.FUSE_TEMPORAL_SHIFT and pointwise):
+            shifted = self.net.TemporalShift(
+                blob_in, blob_in + '_shift', shift_div=shift_div)
+            return self.ConvNd(
+                shifted, blob_out, dim_in, dim_out, kernels, **kwargs)
+        weight_init = kwargs.get('weight_init', ('XavierFill', {}))
+        weight = self.param_init_net.__getattr__(weight_init[0])(
+            [], blob_out + '_w', shape=[dim_out, dim_in, 1, 1, 1],
+            **weight_init[1])
+        inputs = [blob_in, weight]
+        self.net.Proto().external_input.append(str(weight))
+        self.params.append(weight)
+        self.weights.append(weight)
+        if not kwargs.get('no_bias', 0):
+            bias_init = kwargs.get('bias_init', ('ConstantFill', {}))
+            bias = self.param_init_net.__getattr__(bias_init[0])(
+                [], blob_out + '_b', shape=[dim_out, ], **bias_init[1])
+            inputs.append(bias)
+            self.net.Proto().external_input.append(str(bias))
+            self.params.append(bias)
+            self.biases.append(bias)
+        return self.net.TemporalShiftConv(
+            inputs, blob_out, shift_div=shift_div)
+
     # ----------------------------
     # customized layers
     # ----------------------------
@@ -236,11 +566,12 @@ class ModelBuilder(cnn.CNNModelHelper):
             blob_in, prefix, dim_in, dim_out, kernels, strides=strides,
             pads=pads, group=group,
             weight_init=("MSRAFill", {}),
-            bias_init=('ConstantFill', {'value': 0.}), no_bias=1)
+            bias_init=('ConstantFill', {'value': 0.}), no_bias=1,
+            temporal_shift=kwargs.get('temporal_shift', 0))
         blob_out = self.SpatialBN(
             conv_blob, prefix + "_bn", dim_out,
             epsilon=cfg.MODEL.BN_EPSILON,
-            momentum=cfg.MODEL.BN_MOMENTUM,
+            momentum=misc.get_bn_momentum(cfg.MODEL.BN_MOMENTUM),
             is_test=self.split in ['test', 'val'])
 
         # set bn init if specified
@@ -251,6 +582,49 @@ class ModelBuilder(cnn.CNNModelHelper):
 
         return blob_out
 
+    # Conv3dBN + Relu_, optionally adding residual before the relu, with the
+    # BN, the sum and the relu as one SpatialBNRelu op; same params and
+    # output name as the separate ops
+    def Conv3dBNRelu(
+        self, blob_in, prefix, dim_in, dim_out, kernels, strides, pads,
+        group=1, bn_init=None, residual=None,
+        **kwargs
+    ):
+        bn_blob = self.Conv3dBN(
+            blob_in, prefix, dim_in, dim_out, kernels, strides, pads,
+            group=group, bn_init=bn_init,
+            temporal_shift=kwargs.get('temporal_shift', 0))
+        bn_op = self.net.Proto().op[-1]
+        assert bn_op.type == 'SpatialBN'
+        bn_op.type = 'SpatialBNRelu'
+        if residual is not None:
+            bn_op.input.extend([str(residual)])
+        blob_out = bn_blob if cfg.MODEL.ALLOW_INPLACE_RELU \
+            else bn_blob + "_relu"
+        bn_op.output[0] = str(blob_out)
+        return blob_out
+
+    # Conv3dBN + a leaky relu as one InPlaceABN op written over the conv
+    # output (MODEL.INPLACE_ABN); same params as Conv3dBN, and the output is
+    # the conv blob
+    def Conv3dInPlaceABN(
+        self, blob_in, prefix, dim_in, dim_out, kernels, strides, pads,
+        group=1, bn_init=None,
+        **kwargs
+    ):
+        self.Conv3dBN(
+            blob_in, prefix, dim_in, dim_out, kernels, strides, pads,
+            group=group, bn_init=bn_init,
+            temporal_shift=kwargs.get('temporal_shift', 0))
+        bn_op = self.net.Proto().op[-1]
+        assert bn_op.type == 'SpatialBN'
+        bn_op.type = 'InPlaceABN'
+        bn_op.output[0] = bn_op.input[0]
+        alpha = bn_op.arg.add()
+        alpha.name = 'alpha'
+        alpha.f = cfg.MODEL.INPLACE_ABN_SLOPE
+        return bn_op.output[0]
+
     # Conv + Affine wrapper
     def Conv3dAffine(  # args in the same order of Conv3d()
         self, blob_in, prefix, dim_in, dim_out, kernels, strides, pads,
@@ -263,7 +637,8 @@ class ModelBuilder(cnn.CNNModelHelper):
             blob_in, prefix, dim_in, dim_out, kernels, strides=strides,
             pads=pads, group=group,
             weight_init=("MSRAFill", {}),
-            bias_init=('ConstantFill', {'value': 0.}), no_bias=1)
+            bias_init=('ConstantFill', {'value': 0.}), no_bias=1,
+            temporal_shift=kwargs.get('temporal_shift', 0))
         blob_out = self.AffineNd(
             conv_blob, prefix + suffix, dim_out, inplace=inplace_affine)
 
@@ -294,11 +669,57 @@ class ModelBuilder(cnn.CNNModelHelper):
             self.params.extend([scale, bias])
             self.weights.append(scale)
             self.biases.append(bias)
+        # the CUDA op takes scale and bias of the type of its input
+        if self.fp16:
+            scale, bias = self._ParamsToFP16([scale, bias])
         if inplace:
             return self.net.AffineNd([blob_in, scale, bias], blob_in)
         else:
             return self.net.AffineNd([blob_in, scale, bias], blob_out)
 
+    # average pooling, fc and softmax of the val / test heads in one op
+    def GlobalAvgPoolFC(
+            self, blob_in, blob_out, dim_in, dim_out, kernels, softmax=True):
+        weight = self.param_init_net.GaussianFill(
+            [], blob_out + '_w', shape=[dim_out, dim_in],
+            std=cfg.MODEL.FC_INIT_STD)
+        bias = self.param_init_net.ConstantFill(
+            [], blob_out + '_b', shape=[dim_out, ], value=0.)
+        self.net.Proto().external_input.extend([str(weight), str(bias)])
+        self.params.extend([weight, bias])
+        self.weights.append(weight)
+        self.biases.append(bias)
+        return self.net.GlobalAvgPoolFC(
+            [blob_in, weight, bias], 'softmax' if softmax else blob_out,
+            kernels=kernels, softmax=softmax)
+
+    # the spatial max pooling of blob_in and the 1x1x1 convs of the pooled
+    # blob_in to blobs_out (e.g. phi and g of a non-local block) in one op,
+    # with the params of the convs
+    def MaxPoolProjection(
+            self, blob_in, blobs_out, dim_in, dim_out, kernel,
+            weight_std, no_bias=0):
+        inputs = [blob_in]
+        for blob_out in blobs_out:
+            weight = self.param_init_net.GaussianFill(
+                [], blob_out + '_w', shape=[dim_out, dim_in, 1, 1, 1],
+                std=weight_std)
+            self.net.Proto().external_input.append(str(weight))
+            self.params.append(weight)
+            self.weights.append(weight)
+            inputs.append(weight)
+            if not no_bias:
+                bias = self.param_init_net.ConstantFill(
+                    [], blob_out + '_b', shape=[dim_out, ], value=0.)
+                self.net.Proto().external_input.append(str(bias))
+                self.params.append(bias)
+                self.biases.append(bias)
+                inputs.append(bias)
+        outputs = self.net.MaxPoolProjection(
+            inputs, list(blobs_out) + [blob_in + '_pool_argmax'],
+            kernel=kernel, no_bias=no_bias)
+        return outputs[:-1]
+
     # ----------------------------
     # learning rate utils
     # ----------------------------
@@ -353,36 +774,117 @@ class ModelBuilder(cnn.CNNModelHelper):
 
         root_gpu_id = cfg.ROOT_GPU_ID
         num_gpus = cfg.NUM_GPUS
+        sharded = set(sharded_params(self))
         for i in range(root_gpu_id, root_gpu_id + num_gpus):
             with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, i)):
                 with core.NameScope("gpu_{}".format(i)):
+                    momentum_blobs = [SHARD_MOMENTUM] if sharded else []
                     params = self.GetParams()
                     for param in params:
-                        if param in self.TrainableParams():
-                            op = core.CreateOperator(
-                                'Scale', [param + '_momentum'],
-                                [param + '_momentum'],
-                                scale=correction)
-                            workspace.RunOperatorOnce(op)
+                        if param in self.TrainableParams() and \
+                                misc.unscope_name(str(param)) not in sharded:
+                            momentum_blobs.append(param + '_momentum')
+                    for blob in momentum_blobs:
+                        op = core.CreateOperator(
+                            'Scale', [blob], [blob], scale=correction)
+                        workspace.RunOperatorOnce(op)
 
 
 # ----------------------------
 # model utils
 # ----------------------------
+def early_exit_board():
+    """The ClipScoreBoard that the input ops and the AccumulateClipScores ops
+    of all the gpus of a progressive test share."""
+    return '{}_early_exit'.format(cfg.MODEL.MODEL_NAME)
+
+
 def create_model(model, split):
     model_name = cfg.MODEL.MODEL_NAME
     assert model_name in model_creator_map.keys(), \
         'Unknown model_type {}'.format(model_name)
 
     def model_creator(model, loss_scale):
+        data = "data"
+        if temporal_shard_helper.num_shards(model) > 1:
+            data = temporal_shard_helper.shard_clip(model, data)
         model, softmax, loss = model_creator_map[model_name].create_model(
-            model=model, data="data", labels="labels", split=split,
+            model=model, data=data, labels="labels", split=split,
         )
+        if cfg.MODEL.FUSE_POINTWISE and (
+                split == 'train' or not (
+                    cfg.TEST.FOLD_AFFINE or cfg.TEST.OPTIMIZE_INFERENCE)):
+            # before the gradient ops, which then come from the fused ops
+            fused = workspace.ApplyTransform(
+                'FusePointwise', model.net.Proto())
+            logger.info('Fused {} pointwise ops'.format(
+                len(model.net.Proto().op) - len(fused.op)))
+            model.net.Proto().CopyFrom(fused)
+        if cfg.MODEL.COMPACT_ACTIVATIONS and model.train and \
+                not model.force_fw_only:
+            # before the gradient ops, which then read the masks and argmaxes
+            compact_activations.compact_activations(model.net.Proto())
+        if split == 'test' and cfg.TEST.EARLY_EXIT_MARGIN > 0:
+            # the running average of the video of every clip, and whether
+            # the clip has finished it (see tools/test_net_video.py)
+            model.net.AccumulateClipScores(
+                [cfg.TEST.OUTPUT_NAME, 'video_ids'],
+                [cfg.TEST.OUTPUT_NAME + '_video', 'clip_status'],
+                board=early_exit_board(),
+                margin=cfg.TEST.EARLY_EXIT_MARGIN,
+                min_clips=cfg.TEST.EARLY_EXIT_MIN_CLIPS,
+                max_clips=cfg.TEST.NUM_TEST_CLIPS)
+        if split == 'test' and cfg.TEST.AGGREGATE_ON_DEVICE:
+            # test dbs store the index of the video as its label
+            model.net.SegmentedClipAggregate(
+                [cfg.TEST.OUTPUT_NAME,
+                 'video_ids' if cfg.TEST.OUTPUT_CLIP_INDEX else 'labels'],
+                [cfg.TEST.OUTPUT_NAME + '_sum', cfg.TEST.OUTPUT_NAME + '_max',
+                 'clip_counts'],
+                num_videos=cfg.TEST.DATASET_SIZE,
+                max_clips=cfg.TEST.NUM_TEST_CLIPS)
+        if split == 'test' and cfg.TEST.WRITE_DB:
+            # the outputs of every clip to a db per gpu, written by a thread
+            # of the op, see TEST.WRITE_DB
+            model.net.WriteToDB(
+                ['video_ids' if cfg.TEST.OUTPUT_CLIP_INDEX else 'labels'] +
+                (cfg.TEST.WRITE_BLOBS or [cfg.TEST.OUTPUT_NAME]), [],
+                db='{}_{}'.format(
+                    cfg.TEST.WRITE_DB, scope.CurrentNameScope().rstrip('/')),
+                db_type=cfg.TEST.WRITE_DB_TYPE, absolute_path=1,
+                transaction_size=cfg.TEST.WRITE_DB_TRANSACTION_SIZE)
+        if metrics.metrics_on_device(split):
+            add_metric_counts(model, split, loss)
+        # keep 'loss' for the logs, back propagate the scaled one
+        if cfg.FP16.ENABLED and loss is not None:
+            loss = model.Scale(
+                loss, loss + '_scaled', scale=cfg.FP16.LOSS_SCALE)
+        model._pipeline_forward_ops = len(model.net.Proto().op)
         return [loss]
 
     return model_creator
 
 
+def add_metric_counts(model, split, loss):
+    """Counts the top-k hits of the iterations into topk_counts and, for
+    train, sums the loss into loss_sum on the device, so that
+    metrics.MetricsCalculator fetches them once per LOG_PERIOD instead of
+    pred and labels every iteration. Its reduce net sets them back to 0.
+    """
+    counts = model.param_init_net.ConstantFill(
+        [], 'topk_counts', shape=[metrics.num_topk_counts(split)], value=0.0)
+    # the conv fc of some models leaves 1 x 1 x 1 dims after the classes
+    pred = model.net.Flatten('pred', 'pred_2d', axis=1)
+    model.net.AccumulateTopKAccuracy(
+        [pred, 'labels', counts], counts,
+        top_k=metrics.TOP_K,
+        first_n=cfg.METRICS.FIRST_N if metrics.eval_first_n(split) else 0)
+    if split == 'train':
+        loss_sum = model.param_init_net.ConstantFill(
+            [], 'loss_sum', shape=[1], value=0.0)
+        model.net.Add([loss_sum, loss], loss_sum, broadcast=1)
+
+
 def add_inputs(model, data_loader):
     blob_names = data_loader.get_blob_names()
     queue_name = data_loader._blobs_queue_name
@@ -396,8 +898,57 @@ def add_inputs(model, data_loader):
     return input_fn
 
 
+# the blob of the momentum of the shard of the flat params of a gpu, with
+# TRAIN.SHARD_OPTIMIZER_STATE
+SHARD_MOMENTUM = 'flat_momentum_shard'
+
+
+def sharded_params(model):
+    """The unscoped names of the params whose momentum is sharded over the
+    gpus with TRAIN.SHARD_OPTIMIZER_STATE, in the order of the flat params
+    (see data_parallel_model.GetParamShard)."""
+    if getattr(model, '_param_shards', None) is None:
+        return []
+    return [name for name, _, _ in model._flat_param_layout]
+
+
+def add_learning_rate_op(model, lr, momentum_blobs):
+    """Sets lr by the cfg.SOLVER policy from the iteration counter lr_iter in
+    the net, which also scales the momentum blobs for SCALE_MOMENTUM, see
+    ModelBuilder._CorrectMomentum. lr_iter holds the next iteration and is
+    fed once before training (see feed_lr_iter).
+    """
+    relative = cfg.SOLVER.LR_POLICY == 'steps_with_relative_lrs'
+    base_lr = cfg.SOLVER.BASE_LR if relative else 1.0
+    warmup = cfg.SOLVER.WARMUP.WARMUP_ON
+    with core.DeviceScope(core.DeviceOption(caffe2_pb2.CPU)):
+        iteration = model.param_init_net.ConstantFill(
+            [], 'lr_iter', shape=[1], value=0, dtype=core.DataType.INT64)
+    if not cfg.SOLVER.SCALE_MOMENTUM:
+        momentum_blobs = []
+    model.net.LearningRate(
+        [iteration] + momentum_blobs, [lr] + momentum_blobs,
+        policy='stepsWithRelativeLrs',
+        base_lr=base_lr,
+        steps=cfg.SOLVER.STEPS,
+        lrs=[float(x) for x in cfg.SOLVER.LRS],
+        num_iter=cfg.SOLVER.WARMUP.WARMUP_END_ITER if warmup else 0,
+        start_multiplier=cfg.SOLVER.WARMUP.WARMUP_START_LR / base_lr)
+    with core.DeviceScope(core.DeviceOption(caffe2_pb2.CPU)):
+        model.net.Iter(iteration, iteration)
+
+
+def feed_lr_iter(cur_iter):
+    """Starts the lr_iter counters of add_learning_rate_op at cur_iter."""
+    root_gpu_id = cfg.ROOT_GPU_ID
+    for i in range(root_gpu_id, root_gpu_id + cfg.NUM_GPUS):
+        workspace.FeedBlob(
+            'gpu_{}/lr_iter'.format(i), np.array([cur_iter], dtype=np.int64))
+
+
 def add_parameter_update_ops(model):
     def param_update_ops(model):
+        model._pipeline_update_ops = len(model.net.Proto().op)
         lr = model.param_init_net.ConstantFill(
             [], 'lr', shape=[1], value=model.current_lr)
         weight_decay = model.param_init_net.ConstantFill(
@@ -409,11 +960,120 @@ def add_parameter_update_ops(model):
         one = model.param_init_net.ConstantFill(
             [], "ONE", shape=[1], value=1.0
         )
+        # the gradients come out FP16.LOSS_SCALE times too large, the weight
+        # decay sums undo it
+        if cfg.FP16.ENABLED:
+            one = model.param_init_net.ConstantFill(
+                [], "inv_loss_scale", shape=[1],
+                value=1.0 / cfg.FP16.LOSS_SCALE
+            )
         params = model.GetParams()
         curr_scope = scope.CurrentNameScope()
         # scope is of format 'gpu_{}/'.format(gpu_id), so remove the separator
         trainable_params = model.TrainableParams(curr_scope[:-1])
         assert len(params) > 0, 'No trainable params found in model'
+        # with TRAIN.SHARD_OPTIMIZER_STATE the gpu updates its shard of the
+        # flat params, with its shard of the momentum, and the others as
+        # usual
+        shard = data_parallel_model.GetParamShard(model)
+        momentum_blobs = []
+        if shard is not None:
+            shard_momenta = data_parallel_model.AddParamShardState(
+                model, 'momentum')
+            sharded = set(sharded_params(model))
+            params = [
+                param for param in params
+                if misc.unscope_name(str(param)) not in sharded]
+            momentum_blobs.append(
+                core.ScopedBlobReference(SHARD_MOMENTUM))
+        if cfg.SOLVER.LR_IN_GRAPH:
+            add_learning_rate_op(model, lr, momentum_blobs + [
+                param + '_momentum' for param in params
+                if param in trainable_params])
+        if shard:
+            update_inputs = [lr]
+            for (_, param, grad), momentum in zip(shard, shard_momenta):
+                update_inputs += [grad, momentum, param]
+            model.net.MultiTensorMomentumSGDUpdate(
+                update_inputs,
+                update_inputs[1:],
+                momentum=cfg.SOLVER.MOMENTUM,
+                nesterov=cfg.SOLVER.NESTEROV,
+                grad_scale=(
+                    1.0 / cfg.FP16.LOSS_SCALE if cfg.FP16.ENABLED else 1.0),
+                weight_decay=[
+                    cfg.SOLVER.WEIGHT_DECAY, cfg.SOLVER.WEIGHT_DECAY_BN],
+                groups=[
+                    1 if '_bn' in str(param) else 0 for param, _, _ in shard],
+            )
+        if len(params) == 0:
+            return
+        if cfg.SOLVER.LAYERWISE:
+            # group 1 (bn) keeps the global lr
+            lamb = cfg.SOLVER.LAYERWISE == 'lamb'
+            update_inputs = [lr]
+            if lamb:
+                with core.DeviceScope(core.DeviceOption(caffe2_pb2.CPU)):
+                    iteration = model.param_init_net.ConstantFill(
+                        [], 'layerwise_iter', shape=[1], value=0,
+                        dtype=core.DataType.INT64)
+                    model.net.Iter(iteration, iteration)
+                update_inputs.append(iteration)
+            groups = []
+            for param in params:
+                if param not in trainable_params:
+                    continue
+                update_inputs += [
+                    model.param_to_grad[param],
+                    model.param_init_net.ConstantFill(
+                        [param], param + '_momentum', value=0.0)]
+                if lamb:
+                    update_inputs.append(model.param_init_net.ConstantFill(
+                        [param], param + '_moment2', value=0.0))
+                update_inputs.append(param)
+                groups.append(1 if '_bn' in str(param) else 0)
+            kwargs = dict(
+                grad_scale=(
+                    1.0 / cfg.FP16.LOSS_SCALE if cfg.FP16.ENABLED else 1.0),
+                weight_decay=[
+                    cfg.SOLVER.WEIGHT_DECAY, cfg.SOLVER.WEIGHT_DECAY_BN],
+                trust=[1, 0],
+                groups=groups,
+            )
+            if lamb:
+                model.net.MultiTensorLambUpdate(
+                    update_inputs, update_inputs[2:], **kwargs)
+            else:
+                model.net.MultiTensorLarsUpdate(
+                    update_inputs, update_inputs[1:],
+                    momentum=cfg.SOLVER.MOMENTUM, eta=cfg.SOLVER.LARS_ETA,
+                    **kwargs)
+            return
+        if cfg.SOLVER.MULTI_TENSOR_UPDATE:
+            # group 0 decays with WEIGHT_DECAY, group 1 (bn) with
+            # WEIGHT_DECAY_BN
+            update_inputs = [lr]
+            groups = []
+            for param in params:
+                if param not in trainable_params:
+                    continue
+                param_momentum = model.param_init_net.ConstantFill(
+                    [param], param + '_momentum', value=0.0)
+                update_inputs += [
+                    model.param_to_grad[param], param_momentum, param]
+                groups.append(1 if '_bn' in str(param) else 0)
+            model.net.MultiTensorMomentumSGDUpdate(
+                update_inputs,
+                update_inputs[1:],
+                momentum=cfg.SOLVER.MOMENTUM,
+                nesterov=cfg.SOLVER.NESTEROV,
+                grad_scale=(
+                    1.0 / cfg.FP16.LOSS_SCALE if cfg.FP16.ENABLED else 1.0),
+                weight_decay=[
+                    cfg.SOLVER.WEIGHT_DECAY, cfg.SOLVER.WEIGHT_DECAY_BN],
+                groups=groups,
+            )
+            return
         for param in params:
             # only update trainable params
             if param in trainable_params:
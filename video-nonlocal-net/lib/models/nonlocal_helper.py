@@ -10,12 +10,18 @@ from __future__ import print_function
 from __future__ import unicode_literals
 
 from core.config import config as cfg
+import models.temporal_shard_helper as temporal_shard_helper
+import utils.misc as misc
 
 
 # 3d spacetime nonlocal (v1: spatial downsample)
+# with group_num > 1 the temporal axis is divided into group_num groups and
+# the non-local operation runs inside each group: (8, 1024, 8, 14, 14) is
+# viewed as (8, 1024, 2, 4 * 14 * 14), and BatchMatMul takes the
+# (8, 2, 1024, 784) matrices through its axes, without transposes
 def spacetime_nonlocal(
         model, blob_in, dim_in, dim_out, batch_size, prefix, dim_inner,
-        is_test, max_pool_stride=2):
+        is_test, max_pool_stride=2, group_num=1):
     # ---------------------
     cur = blob_in
     # we do projection to convert each spacetime location to a feature
@@ -34,53 +40,122 @@ def spacetime_nonlocal(
 
     # phi and g: half spatial size
     # e.g., (8, 1024, 4, 14, 14) => (8, 1024, 4, 7, 7)
-    if cfg.NONLOCAL.USE_MAXPOOL is True:
-        max_pool = model.MaxPool(
-            cur, prefix + '_pool',
-            kernels=[1, max_pool_stride, max_pool_stride],
-            strides=[1, max_pool_stride, max_pool_stride],
-            pads=[0, 0, 0] * 2,
-        )
+    if cfg.NONLOCAL.FUSE_POOL_PROJECTION is True:
+        # the pooled blob is not stored, the op keeps its argmax
+        phi, g = model.MaxPoolProjection(
+            cur, [prefix + '_phi', prefix + '_g'], dim_in, dim_inner,
+            kernel=max_pool_stride, weight_std=cfg.NONLOCAL.CONV_INIT_STD,
+            no_bias=cfg.NONLOCAL.NO_BIAS)
     else:
-        max_pool = cur
+        if cfg.NONLOCAL.USE_MAXPOOL is True:
+            max_pool = model.MaxPool(
+                cur, prefix + '_pool',
+                kernels=[1, max_pool_stride, max_pool_stride],
+                strides=[1, max_pool_stride, max_pool_stride],
+                pads=[0, 0, 0] * 2,
+            )
+        else:
+            max_pool = cur
 
-    phi = model.ConvNd(
-        max_pool, prefix + '_phi',
-        dim_in,
-        dim_inner,
-        [1, 1, 1],
-        strides=[1, 1, 1],
-        pads=[0, 0, 0] * 2,
-        weight_init=('GaussianFill', {'std': cfg.NONLOCAL.CONV_INIT_STD}),
-        bias_init=('ConstantFill', {'value': 0.}), no_bias=cfg.NONLOCAL.NO_BIAS)
+        phi = model.ConvNd(
+            max_pool, prefix + '_phi',
+            dim_in,
+            dim_inner,
+            [1, 1, 1],
+            strides=[1, 1, 1],
+            pads=[0, 0, 0] * 2,
+            weight_init=('GaussianFill', {'std': cfg.NONLOCAL.CONV_INIT_STD}),
+            bias_init=('ConstantFill', {'value': 0.}),
+            no_bias=cfg.NONLOCAL.NO_BIAS)
 
-    g = model.ConvNd(
-        max_pool, prefix + '_g',
-        dim_in,
-        dim_inner,
-        [1, 1, 1],
-        strides=[1, 1, 1],
-        pads=[0, 0, 0] * 2,
-        weight_init=('GaussianFill', {'std': cfg.NONLOCAL.CONV_INIT_STD}),
-        bias_init=('ConstantFill', {'value': 0.}), no_bias=cfg.NONLOCAL.NO_BIAS)
+        g = model.ConvNd(
+            max_pool, prefix + '_g',
+            dim_in,
+            dim_inner,
+            [1, 1, 1],
+            strides=[1, 1, 1],
+            pads=[0, 0, 0] * 2,
+            weight_init=('GaussianFill', {'std': cfg.NONLOCAL.CONV_INIT_STD}),
+            bias_init=('ConstantFill', {'value': 0.}),
+            no_bias=cfg.NONLOCAL.NO_BIAS)
+
+    if cfg.NONLOCAL.USE_FUSED_ATTENTION is True:
+        assert cfg.NONLOCAL.USE_SOFTMAX is True
+        assert group_num == 1
+        # e.g., theta (8, 512, 4, 14, 14), phi/g (8, 512, 4, 7, 7)
+        # => (8, 512, 4, 14, 14), flattening spacetime inside the op
+        blob_out, _ = model.net.NonLocalAttention(
+            [theta, phi, g], [prefix + '_y', prefix + '_y_lse'],
+            scale=dim_inner**-.5 if cfg.NONLOCAL.USE_SCALE is True else 1.,
+            affinity_tile=cfg.NONLOCAL.FUSED_ATTENTION_TILE)
+        return _nonlocal_output(
+            model, blob_out, dim_inner, dim_out, prefix, is_test)
+
+    if len(cfg.NONLOCAL.WINDOW) > 0:
+        assert group_num == 1
+        # e.g., theta (8, 512, 4, 14, 14), phi/g (8, 512, 4, 7, 7)
+        # => (8, 512, 4, 14, 14), every query attending to the window of
+        # keys around it
+        blob_out, _ = model.net.LocalNonLocal(
+            [theta, phi, g], [prefix + '_y', prefix + '_y_lse'],
+            scale=dim_inner**-.5 if cfg.NONLOCAL.USE_SCALE is True else 1.,
+            window=cfg.NONLOCAL.WINDOW,
+            dilation=cfg.NONLOCAL.WINDOW_DILATION)
+        return _nonlocal_output(
+            model, blob_out, dim_inner, dim_out, prefix, is_test)
 
     # we have to use explicit batch size (to support arbitrary spacetime size)
     # e.g., (8, 1024, 4, 14, 14) => (8, 1024, 784)
+    # or (8, 1024, group_num, -1) for groups
+    shape = (batch_size, dim_inner, -1) if group_num == 1 else \
+        (batch_size, dim_inner, group_num, -1)
+    # with groups, the (N, C, G, L) blobs multiply as (N, G, C, L)
+    group_axes = (0, 2, 1, 3)
     theta, theta_shape_5d = model.Reshape(
         theta, [theta + '_re' if not cfg.MODEL.ALLOW_INPLACE_RESHAPE else theta,
             theta + '_shape5d'],
-        shape=(batch_size, dim_inner, -1))
+        shape=shape)
     phi, phi_shape_5d = model.Reshape(
         phi, [phi + '_re' if not cfg.MODEL.ALLOW_INPLACE_RESHAPE else phi,
             phi + '_shape5d'],
-        shape=(batch_size, dim_inner, -1))
+        shape=shape)
     g, g_shape_5d = model.Reshape(
         g, [g + '_re' if not cfg.MODEL.ALLOW_INPLACE_RESHAPE else g,
             g + '_shape5d'],
-        shape=(batch_size, dim_inner, -1))
+        shape=shape)
+
+    # with TRAIN.TEMPORAL_SHARDS the queries of the frames of the shard
+    # attend to the keys of the frames of all the shards
+    if temporal_shard_helper.num_shards(model) > 1:
+        assert group_num == 1
+        phi = temporal_shard_helper.gather_shards(
+            model, phi, phi + '_shards', axis=2)
+        g = temporal_shard_helper.gather_shards(
+            model, g, g + '_shards', axis=2)
+
+    # fp16 inputs for the tensor core GEMMs, back to fp32 after the
+    # aggregation; with FP16 the blobs are fp16 already
+    use_fp16_gemm = cfg.NONLOCAL.USE_FP16_GEMM is True and \
+        not cfg.FP16.ENABLED
+    if use_fp16_gemm:
+        assert cfg.NONLOCAL.USE_SOFTMAX is True
+        theta = model.net.FloatToHalf(theta, theta + '_fp16')
+        phi = model.net.FloatToHalf(phi, phi + '_fp16')
+        g = model.net.FloatToHalf(g, g + '_fp16')
+    if use_fp16_gemm or cfg.FP16.ENABLED:
+        affinity_args = {'engine': 'TENSORCORE'}
+    else:
+        affinity_args = {}
+    aggregation_args = dict(affinity_args)
+    if group_num > 1:
+        affinity_args.update(axes_a=group_axes, axes_b=group_axes)
+        aggregation_args.update(axes_a=group_axes, axes_y=group_axes)
 
     # e.g., (8, 1024, 784) * (8, 1024, 784) => (8, 784, 784)
-    theta_phi = model.net.BatchMatMul([theta, phi], prefix + '_affinity', trans_a=1)
+    # or (8, 1024, G, 784) * (8, 1024, G, 784) => (8, G, 784, 784)
+    theta_phi = model.net.BatchMatMul(
+        [theta, phi], prefix + '_affinity', trans_a=1, **affinity_args)
+    softmax_axis = 2 if group_num == 1 else 3
     if cfg.NONLOCAL.USE_SOFTMAX is True:
         if cfg.NONLOCAL.USE_SCALE is True:
             theta_phi_sc = model.Scale(theta_phi, theta_phi, scale=dim_inner**-.5)
@@ -88,21 +163,23 @@ def spacetime_nonlocal(
             theta_phi_sc = theta_phi
         # softmax
         # sum(p[i, j, :]) == 1, for any i, j
-        p = model.Softmax(theta_phi_sc, theta_phi + '_prob', engine='CUDNN', axis=2)
+        p = model.Softmax(
+            theta_phi_sc, theta_phi + '_prob', engine='CUDNN',
+            axis=softmax_axis)
     else:
-        ones = model.net.ConstantFill([theta_phi], [theta_phi + '_ones'], value=1.)
-        ones = model.net.ReduceBackSum([ones], [theta_phi + '_const'])
-
-        zeros = model.net.ConstantFill([theta_phi], [theta_phi + '_zeros'], value=0.)
-        denom = model.net.Add(
-            [zeros, ones], [theta_phi + '_denom'], broadcast=1, axis=0)
-
-        model.StopGradient(denom, denom)
-        p = model.net.Div([theta_phi, denom], [theta_phi + '_sc'])
+        # divide by the length of the rows, known only at run time in the
+        # fully convolutional test
+        p = model.net.ScaleByInverseCount(
+            [theta_phi], [theta_phi + '_sc'], axis=-1)
 
     # note: g's axis[2] corresponds to p's axis[2]
     # e.g., g(8, 1024, 784_2) * p(8, 784_1, 784_2) => (8, 1024, 784_1)
-    t = model.net.BatchMatMul([g, p], prefix + '_y', trans_b=1)
+    # with groups the (8, G, 1024, 784_1) product is written as
+    # (8, 1024, G, 784_1), the layout of theta
+    t = model.net.BatchMatMul(
+        [g, p], prefix + '_y', trans_b=1, **aggregation_args)
+    if use_fp16_gemm:
+        t = model.net.HalfToFloat(t, t + '_fp32')
 
     # reshape back:
     # e.g., (8, 1024, 784) => (8, 1024, 4, 14, 14)
@@ -110,8 +187,11 @@ def spacetime_nonlocal(
         [t, theta_shape_5d],
         [t + '_re' if not cfg.MODEL.ALLOW_INPLACE_RESHAPE else t,
             t + '_shape3d'])
-    blob_out = t_re
+    return _nonlocal_output(model, t_re, dim_inner, dim_out, prefix, is_test)
+
 
+# output projection (and normalization) of the aggregated features
+def _nonlocal_output(model, blob_out, dim_inner, dim_out, prefix, is_test):
     blob_out = model.ConvNd(
         blob_out, prefix + '_out',
         dim_inner,
@@ -127,7 +207,8 @@ def spacetime_nonlocal(
     if cfg.NONLOCAL.USE_BN is True:
         blob_out = model.SpatialBN(
             blob_out, prefix + "_bn", dim_out,
-            epsilon=cfg.NONLOCAL.BN_EPSILON, momentum=cfg.NONLOCAL.BN_MOMENTUM,
+            epsilon=cfg.NONLOCAL.BN_EPSILON,
+            momentum=misc.get_bn_momentum(cfg.NONLOCAL.BN_MOMENTUM),
             is_test=is_test
         )
         model.param_init_net.ConstantFill(
@@ -157,6 +238,18 @@ def add_nonlocal_group(
 
     group_num = int(pool_stride / group_size)
     assert(pool_stride % group_size == 0)
+    # the windows bound the attention already
+    if len(cfg.NONLOCAL.WINDOW) > 0:
+        group_num = 1
+
+    # the convs and pools of the non-local op are per frame, so only the
+    # fused attention, which flattens spacetime itself, needs the groups
+    # in the batch
+    if group_num > 1 and cfg.NONLOCAL.USE_FUSED_ATTENTION is not True:
+        blob_out = spacetime_nonlocal(
+            model, blob_in, dim_in, dim_out, batch_size,
+            prefix, dim_inner, is_test, group_num=group_num)
+        return model.net.Sum([blob_in, blob_out], prefix + "_sum")
 
     if group_num > 1:
         blob_in = model.Transpose(blob_in, blob_in + '_trans', axes=(0, 2, 1, 3, 4))
@@ -0,0 +1,333 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+"""
+Pipeline parallel execution of a model built for one gpu (PIPELINE.ENABLED):
+the ops of the res stages go to consecutive gpus, and the forward and backward
+passes of the micro-batches of a batch run through them in a one forward, one
+backward (1F1B) order, so that all the gpus but the first and last ones of a
+pass are busy, and a gpu keeps the activations of at most as many
+micro-batches as there are stages after it.
+"""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+import copy
+import logging
+
+from caffe2.proto import caffe2_pb2
+from caffe2.python import core, workspace
+
+from core.config import config as cfg
+import utils.misc as misc
+
+logger = logging.getLogger(__name__)
+
+
+def num_stages():
+    return len(cfg.PIPELINE.STAGE_STARTS) + 1
+
+
+def stage_gpu(stage):
+    return cfg.ROOT_GPU_ID + stage
+
+
+def one_f_one_b(stage, micro_batches):
+    """The forward ('F', m) and backward ('B', m) passes of the micro-batches
+    m that a stage runs, in order: as many forward passes as there are stages
+    after it to fill the pipeline, then one forward and one backward pass in
+    turn, and the backward passes left to drain it."""
+    warmup = min(num_stages() - stage - 1, micro_batches)
+    order = [('F', m) for m in range(warmup)]
+    for m in range(micro_batches - warmup):
+        order += [('F', warmup + m), ('B', m)]
+    order += [('B', m) for m in range(micro_batches - warmup, micro_batches)]
+    return order
+
+
+def _gradient_base(blob):
+    # the forward blob of a gradient, gpu_0/x of gpu_0/x_grad(_autosplit_0)
+    pos = blob.find('_grad')
+    return blob if pos < 0 else blob[:pos]
+
+
+def _forward_stages(ops):
+    """The stage of every forward op and the stage of the blobs it reads and
+    writes: a new stage starts at the first op writing a blob with the next
+    prefix of PIPELINE.STAGE_STARTS, a param is in the stage of its first
+    op."""
+    starts = cfg.PIPELINE.STAGE_STARTS
+    stage = 0
+    op_stages = []
+    blob_stages = {}
+    for op in ops:
+        while stage < len(starts) and any(
+                misc.unscope_name(blob).startswith(starts[stage])
+                for blob in op.output):
+            stage += 1
+        op_stages.append(stage)
+        for blob in op.input:
+            blob_stages.setdefault(blob, stage)
+        for blob in op.output:
+            blob_stages[blob] = stage
+    assert stage == len(starts), \
+        'The model has no blob starting with {} of PIPELINE.STAGE_STARTS' \
+        .format(starts[stage])
+    return op_stages, blob_stages
+
+
+def _stage_of(op, blob_stages, default):
+    # the gradient op of a forward op reads the gradient of its outputs, which
+    # are in the stage of the forward op, and the blobs of earlier stages
+    stages = [
+        blob_stages[_gradient_base(blob)]
+        for blob in list(op.input) + list(op.output)
+        if _gradient_base(blob) in blob_stages]
+    return max(stages) if stages else default
+
+
+def _place(op, stage):
+    op = copy.deepcopy(op)
+    if op.device_option.device_type == caffe2_pb2.CUDA:
+        op.device_option.cuda_gpu_id = stage_gpu(stage)
+    return op
+
+
+class _Renamer(object):
+    """The blobs of micro-batch m > 0: the activations and their gradients get
+    a _mb<m> suffix, the param gradients of a micro-batch are written to
+    <grad>_micro and summed into the gradients of micro-batch 0."""
+
+    def __init__(self, micro_batch, local_blobs, param_grads):
+        self.micro_batch = micro_batch
+        self.local_blobs = local_blobs
+        self.param_grads = param_grads
+
+    def __call__(self, blob):
+        if self.micro_batch == 0:
+            return blob
+        if blob in self.param_grads:
+            return blob + '_micro'
+        if blob in self.local_blobs:
+            return '{}_mb{}'.format(blob, self.micro_batch)
+        return blob
+
+    def clone(self, ops):
+        clones = []
+        for op in ops:
+            op = copy.deepcopy(op)
+            op.input[:] = [self(blob) for blob in op.input]
+            op.output[:] = [self(blob) for blob in op.output]
+            clones.append(op)
+        if self.micro_batch > 0:
+            # after the last op writing a param gradient of the micro-batch
+            last_writer = {}
+            for i, op in enumerate(clones):
+                for blob in op.output:
+                    if blob[:-len('_micro')] in self.param_grads and \
+                            blob.endswith('_micro'):
+                        last_writer[blob] = i
+            for blob, i in sorted(
+                    last_writer.items(), key=lambda item: -item[1]):
+                grad = blob[:-len('_micro')]
+                acc = core.CreateOperator(
+                    'Sum', [grad, blob], [grad],
+                    device_option=clones[i].device_option)
+                clones.insert(i + 1, acc)
+        return clones
+
+
+def _add_copies(ops, blob_devices, copies):
+    """Reads the CUDA blobs of another gpu through a Copy to the gpu of the
+    op, made once per gpu after every write of the blob. blob_devices holds
+    the gpu of every CUDA blob written so far, copies the copies that are
+    still valid."""
+    placed = []
+    for op in ops:
+        if op.device_option.device_type == caffe2_pb2.CUDA:
+            gpu = op.device_option.cuda_gpu_id
+            for i, blob in enumerate(op.input):
+                src = blob_devices.get(blob, gpu)
+                # the blobs written in place are read where they are
+                if src == gpu or blob in op.output:
+                    continue
+                if (blob, gpu) not in copies:
+                    copied = '{}_gpu{}'.format(blob, gpu)
+                    device = core.DeviceOption(caffe2_pb2.CUDA, gpu)
+                    placed.append(core.CreateOperator(
+                        'Copy', [blob], [copied], device_option=device))
+                    copies[(blob, gpu)] = copied
+                    blob_devices[copied] = gpu
+                op.input[i] = copies[(blob, gpu)]
+        for blob in op.output:
+            for key in [key for key in copies if key[0] == blob]:
+                del copies[key]
+            if blob in op.input:
+                continue
+            if op.device_option.device_type == caffe2_pb2.CUDA:
+                blob_devices[blob] = op.device_option.cuda_gpu_id
+            else:
+                blob_devices.pop(blob, None)
+        placed.append(op)
+    return placed
+
+
+def _schedule(micro_batches, has_backward):
+    """The passes (kind, stage, micro-batch) in an order of the proto that
+    follows the 1F1B order of every stage and the data dependencies."""
+    stages = num_stages()
+    if not has_backward:
+        return [('F', s, m) for m in range(micro_batches)
+                for s in range(stages)]
+    queues = [one_f_one_b(s, micro_batches) for s in range(stages)]
+    done = set()
+    order = []
+    while any(queues):
+        progress = False
+        for s in range(stages):
+            if not queues[s]:
+                continue
+            kind, m = queues[s][0]
+            if kind == 'F':
+                ready = s == 0 or ('F', s - 1, m) in done
+            else:
+                ready = ('F', s, m) in done and (
+                    s == stages - 1 or ('B', s + 1, m) in done)
+            if ready:
+                queues[s].pop(0)
+                done.add((kind, s, m))
+                order.append((kind, s, m))
+                progress = True
+        assert progress, 'The 1F1B schedule has a cycle'
+    return order
+
+
+def pipeline_model(model, micro_batches):
+    """Places the ops of model.net, built for ROOT_GPU_ID, and the blobs of
+    model.param_init_net on the gpus of the stages, with micro_batches clones
+    of the forward and backward ops. model._pipeline_forward_ops and
+    model._pipeline_update_ops (None without updates) are the op counts when
+    the gradient ops and the update ops were added."""
+    net = model.net.Proto()
+    ops = list(net.op)
+    # the test and precise BN models have no backward pass
+    num_forward = (
+        model._pipeline_forward_ops if model.param_to_grad else len(ops))
+    num_backward = (
+        len(ops) if model._pipeline_update_ops is None
+        else model._pipeline_update_ops)
+    forward = ops[:num_forward]
+    backward = ops[num_forward:num_backward]
+    updates = ops[num_backward:]
+    stages = num_stages()
+
+    op_stages, blob_stages = _forward_stages(forward)
+    last_stage = stages - 1
+    forward_by_stage = [[] for _ in range(stages)]
+    for op, stage in zip(forward, op_stages):
+        forward_by_stage[stage].append(_place(op, stage))
+    backward_by_stage = [[] for _ in range(stages)]
+    for op in backward:
+        stage = _stage_of(op, blob_stages, last_stage)
+        backward_by_stage[stage].append(_place(op, stage))
+
+    if backward and micro_batches > 1:
+        # the gradient of the loss of a micro-batch, so that the gradients
+        # sum to the mean over the batch
+        loss_grad = backward_by_stage[last_stage][0]
+        assert loss_grad.type == 'ConstantFill', \
+            'The backward pass should start with the loss gradient'
+        for arg in loss_grad.arg:
+            if arg.name == 'value':
+                arg.f /= micro_batches
+
+    init_blobs = set(
+        blob for op in model.param_init_net.Proto().op for blob in op.output)
+    param_grads = set(
+        str(grad) for grad in model.param_to_grad.values())
+    local_blobs = set(
+        blob for op in forward + backward for blob in op.output
+        if blob not in init_blobs and blob not in param_grads)
+
+    passes = {}
+    for m in range(micro_batches):
+        renamer = _Renamer(m, local_blobs, param_grads)
+        for s in range(stages):
+            passes[('F', s, m)] = renamer.clone(forward_by_stage[s])
+            passes[('B', s, m)] = renamer.clone(backward_by_stage[s])
+
+    blob_devices = {}
+    for op in model.param_init_net.Proto().op:
+        if op.device_option.device_type == caffe2_pb2.CUDA:
+            for blob in op.output:
+                blob_devices[blob] = op.device_option.cuda_gpu_id
+    # the params and their momentum are kept on the gpu of their stage; the
+    # blobs that are only read by the updates (lr, which is fed from python)
+    # stay on ROOT_GPU_ID
+    update_stages = [_stage_of(op, blob_stages, 0) for op in updates]
+    for op, stage in zip(updates, update_stages):
+        for blob in op.output:
+            if blob in blob_devices and blob not in blob_stages:
+                blob_devices[blob] = stage_gpu(stage)
+    for blob, stage in blob_stages.items():
+        if blob in blob_devices:
+            blob_devices[blob] = stage_gpu(stage)
+    placed_init = dict(blob_devices)
+
+    copies = {}
+    new_ops = []
+    last_pass_op = {}
+    for key in _schedule(micro_batches, len(backward) > 0):
+        pass_ops = _add_copies(passes[key], blob_devices, copies)
+        if not pass_ops:
+            continue
+        stage = key[1]
+        prev = last_pass_op.get(stage)
+        if prev is not None:
+            # the previous pass of the stage first, in the 1F1B order
+            for op in pass_ops:
+                op.control_input.append(prev.output[0])
+        last_pass_op[stage] = pass_ops[-1]
+        new_ops += pass_ops
+    for op, stage in zip(updates, update_stages):
+        new_ops += _add_copies([_place(op, stage)], blob_devices, copies)
+
+    del net.op[:]
+    net.op.extend(new_ops)
+    # the threads of a gpu, times the gpus
+    net.num_workers *= stages
+
+    for op in model.param_init_net.Proto().op:
+        if op.device_option.device_type == caffe2_pb2.CUDA and \
+                op.output[0] in placed_init:
+            op.device_option.cuda_gpu_id = placed_init[op.output[0]]
+    model._pipeline_blob_gpus = dict(
+        (blob, gpu) for blob, gpu in placed_init.items()
+        if gpu != cfg.ROOT_GPU_ID)
+    logger.info(
+        'Pipelined {} ops into {} ops over {} gpus with {} micro-batches'
+        .format(len(ops), len(new_ops), stages, micro_batches))
+
+
+def place_blobs(model):
+    """Moves the params of model that were initialized, loaded or fed on
+    another gpu (a feed keeps the buffer of a blob of the same size) to the
+    gpus of their stages."""
+    blob_gpus = getattr(model, '_pipeline_blob_gpus', {})
+    for blob, gpu in blob_gpus.items():
+        if not workspace.HasBlob(blob):
+            continue
+        value = workspace.FetchBlob(blob)
+        workspace.RunOperatorOnce(core.CreateOperator('Free', [], [blob]))
+        workspace.FeedBlob(
+            blob, value,
+            device_option=core.DeviceOption(caffe2_pb2.CUDA, gpu))
+    if blob_gpus:
+        logger.info('Placed {} blobs on the gpus of their stages'.format(
+            len(blob_gpus)))
@@ -14,6 +14,7 @@ from __future__ import print_function
 from __future__ import division
 
 from core.config import config as cfg
+import contextlib
 import numpy as np
 import models.nonlocal_helper as nonlocal_helper
 
@@ -22,38 +23,57 @@ import models.nonlocal_helper as nonlocal_helper
 # 3d conv in the first conv (3x1x1)
 def bottleneck_transformation_3d(
         model, blob_in, dim_in, dim_out, stride, prefix, dim_inner, group=1,
-        use_temp_conv=1, temp_stride=1):
+        use_temp_conv=1, temp_stride=1, residual=None):
 
     conv_op = model.Conv3dAffine if cfg.MODEL.USE_AFFINE else model.Conv3dBN
 
-    # 1x1 layer
-    blob_out = conv_op(
+    def conv_relu(*args, **kwargs):
+        if _inplace_abn():
+            return model.Conv3dInPlaceABN(*args, **kwargs)
+        if _fuse_bn_relu():
+            return model.Conv3dBNRelu(*args, **kwargs)
+        return model.Relu_(conv_op(*args, **kwargs))
+
+    # 1x1 layer, reading its input shifted along time in the blocks without
+    # a temporal conv (MODEL.TEMPORAL_SHIFT_DIV)
+    blob_out = conv_relu(
         blob_in, prefix + "_branch2a", dim_in, dim_inner,
         [1 + use_temp_conv * 2, 1, 1],
         strides=[temp_stride, 1, 1], pads=[use_temp_conv, 0, 0] * 2,
         inplace_affine=False,
+        temporal_shift=0 if use_temp_conv else cfg.MODEL.TEMPORAL_SHIFT_DIV,
     )
-    blob_out = model.Relu_(blob_out)
 
     # 3x3 layer
-    blob_out = conv_op(
+    blob_out = conv_relu(
         blob_out, prefix + "_branch2b", dim_inner, dim_inner, [1, 3, 3],
         strides=[1, stride, stride], pads=[0, 1, 1] * 2,
         group=group,
         inplace_affine=False,
     )
-    blob_out = model.Relu_(blob_out)
 
-    # 1x1 layer (no relu)
-    blob_out = conv_op(
+    # 1x1 layer (no relu, unless the residual is fused in)
+    blob_out = (model.Conv3dBNRelu if residual is not None else conv_op)(
         blob_out, prefix + "_branch2c", dim_inner, dim_out, [1, 1, 1],
         strides=[1, 1, 1], pads=[0, 0, 0] * 2,
         inplace_affine=False,  # must be False
-        bn_init=cfg.MODEL.BN_INIT_GAMMA)  # revise BN init of the last block
+        bn_init=cfg.MODEL.BN_INIT_GAMMA,  # revise BN init of the last block
+        residual=residual)
 
     return blob_out
 
 
+# the fused ops are fp32 only
+def _fuse_bn_relu():
+    return cfg.MODEL.FUSE_BN_RELU and not cfg.MODEL.USE_AFFINE \
+        and not cfg.TRAIN.SYNC_BN and not cfg.FP16.ENABLED
+
+
+def _inplace_abn():
+    return cfg.MODEL.INPLACE_ABN and not cfg.MODEL.USE_AFFINE \
+        and not cfg.TRAIN.SYNC_BN and not cfg.FP16.ENABLED
+
+
 # shortcut type B
 def _add_shortcut_3d(
         model, blob_in, prefix, dim_in, dim_out, stride, temp_stride=1):
@@ -70,6 +90,18 @@ def _add_shortcut_3d(
             inplace_affine=False,)
 
 
+# activation checkpointing of the training net at the given level ('block'
+# or 'stage', see TRAIN.RECOMPUTE): the ops in the scope keep only their
+# inputs and are run again in the backward pass
+@contextlib.contextmanager
+def _recompute_segment(model, level):
+    if cfg.TRAIN.RECOMPUTE == level and model.split == 'train':
+        with model.net.RecomputeSegment():
+            yield
+    else:
+        yield
+
+
 # residual block abstraction: x + F(x)
 def _generic_residual_block_3d(
         model, blob_in, dim_in, dim_out, stride, prefix, dim_inner,
@@ -78,6 +110,17 @@ def _generic_residual_block_3d(
     if trans_func is None:
         trans_func = globals()[cfg.RESNETS.TRANS_FUNC]
 
+    if _fuse_bn_relu():
+        # "relu(x + F(x))" in the last BN of F, given the shortcut first
+        sc_blob = _add_shortcut_3d(
+            model, blob_in, prefix + "_branch1",
+            dim_in, dim_out, stride, temp_stride=temp_stride)
+        return trans_func(
+            model, blob_in, dim_in, dim_out, stride, prefix,
+            dim_inner,
+            group=group, use_temp_conv=use_temp_conv, temp_stride=temp_stride,
+            residual=sc_blob)
+
     tr_blob = trans_func(
         model, blob_in, dim_in, dim_out, stride, prefix,
         dim_inner,
@@ -89,9 +132,16 @@ def _generic_residual_block_3d(
         dim_in, dim_out, stride, temp_stride=temp_stride)
 
     # addition, namely, "x + F(x)"
+    sum_name = tr_blob if cfg.MODEL.ALLOW_INPLACE_SUM else prefix + "_sum"
+    if cfg.MODEL.FUSE_SUM_RELU and not cfg.FP16.ENABLED:
+        # same output name as the Relu_ below
+        return model.net.SumRelu(
+            [tr_blob, sc_blob],
+            sum_name if cfg.MODEL.ALLOW_INPLACE_RELU
+            else sum_name + "_relu")
     sum_blob = model.net.Sum(
         [tr_blob, sc_blob],  # "tr_blob" goes first to enable inplace
-        tr_blob if cfg.MODEL.ALLOW_INPLACE_SUM else prefix + "_sum")
+        sum_name)
 
     # relu after addition
     blob_out = model.Relu_(sum_blob)
@@ -117,18 +167,21 @@ def res_stage_nonlocal(
             use_temp_convs.append(0)
             temp_strides.append(1)
 
-    for idx in range(num_blocks):
-        block_prefix = "{}_{}".format(prefix, idx)
-        block_stride = 2 if (idx == 0 and stride == 2) else 1
-        blob_in = _generic_residual_block_3d(
-            model, blob_in, dim_in, dim_out, block_stride, block_prefix,
-            dim_inner, group, use_temp_convs[idx], temp_strides[idx])
-        dim_in = dim_out
-
-        if idx % nonlocal_mod == nonlocal_mod - 1:
-            blob_in = nonlocal_helper.add_nonlocal(
-                model, blob_in, dim_in, dim_in, batch_size,
-                nonlocal_name + '_{}'.format(idx), int(dim_in / 2))
+    with _recompute_segment(model, 'stage'):
+        for idx in range(num_blocks):
+            block_prefix = "{}_{}".format(prefix, idx)
+            block_stride = 2 if (idx == 0 and stride == 2) else 1
+            with _recompute_segment(model, 'block'):
+                blob_in = _generic_residual_block_3d(
+                    model, blob_in, dim_in, dim_out, block_stride,
+                    block_prefix, dim_inner, group, use_temp_convs[idx],
+                    temp_strides[idx])
+            dim_in = dim_out
+
+            if idx % nonlocal_mod == nonlocal_mod - 1:
+                blob_in = nonlocal_helper.add_nonlocal(
+                    model, blob_in, dim_in, dim_in, batch_size,
+                    nonlocal_name + '_{}'.format(idx), int(dim_in / 2))
 
     return blob_in, dim_in
 
@@ -153,18 +206,21 @@ def res_stage_nonlocal_group(
             use_temp_convs.append(0)
             temp_strides.append(1)
 
-    for idx in range(num_blocks):
-        block_prefix = "{}_{}".format(prefix, idx)
-        block_stride = 2 if (idx == 0 and stride == 2) else 1
-        blob_in = _generic_residual_block_3d(
-            model, blob_in, dim_in, dim_out, block_stride, block_prefix,
-            dim_inner, group, use_temp_convs[idx], temp_strides[idx])
-        dim_in = dim_out
-
-        if idx % nonlocal_mod == nonlocal_mod - 1:
-            blob_in = nonlocal_helper.add_nonlocal_group(
-                model, blob_in, dim_in, dim_in, batch_size,
-                pool_stride, spatial_dim, spatial_dim, group_size,
-                nonlocal_name + '_{}'.format(idx), int(dim_in / 2))
+    with _recompute_segment(model, 'stage'):
+        for idx in range(num_blocks):
+            block_prefix = "{}_{}".format(prefix, idx)
+            block_stride = 2 if (idx == 0 and stride == 2) else 1
+            with _recompute_segment(model, 'block'):
+                blob_in = _generic_residual_block_3d(
+                    model, blob_in, dim_in, dim_out, block_stride,
+                    block_prefix, dim_inner, group, use_temp_convs[idx],
+                    temp_strides[idx])
+            dim_in = dim_out
+
+            if idx % nonlocal_mod == nonlocal_mod - 1:
+                blob_in = nonlocal_helper.add_nonlocal_group(
+                    model, blob_in, dim_in, dim_in, batch_size,
+                    pool_stride, spatial_dim, spatial_dim, group_size,
+                    nonlocal_name + '_{}'.format(idx), int(dim_in / 2))
 
     return blob_in, dim_in
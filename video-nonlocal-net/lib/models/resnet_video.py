@@ -16,6 +16,8 @@ from __future__ import print_function
 from __future__ import division
 
 import models.resnet_helper as resnet_helper
+import models.temporal_shard_helper as temporal_shard_helper
+import utils.misc as misc
 from core.config import config as cfg
 
 import logging
@@ -117,6 +119,11 @@ def create_model(model, data, labels, split):
     group = cfg.RESNETS.NUM_GROUPS
     width_per_group = cfg.RESNETS.WIDTH_PER_GROUP
     batch_size = int(cfg.TRAIN.BATCH_SIZE / cfg.NUM_GPUS)
+    shards = temporal_shard_helper.num_shards(model)
+    if split == 'train':
+        # the clips of a (micro-)batch, whose frames the gpus of a group of
+        # temporal shards share
+        batch_size = misc.get_batch_size(split) * shards
 
     logger.info(
         '--------------- ResNet-{} {}x{}d-{}, {} ---------------'.format(
@@ -137,6 +144,8 @@ def create_model(model, data, labels, split):
     print(temp_strides_set)
 
 
+    data = model.ExpandClips(data)
+    data = model.StartFP16(data)
     conv_blob = model.ConvNd(
         data, 'conv1', 3, 64, [1 + use_temp_convs_set[0][0] * 2, 7, 7], strides=[temp_strides_set[0][0], 2, 2],
         pads=[use_temp_convs_set[0][0], 3, 3] * 2,
@@ -148,7 +157,7 @@ def create_model(model, data, labels, split):
     if cfg.MODEL.USE_AFFINE is False:
         bn_blob = model.SpatialBN(
             conv_blob, 'res_conv1_bn', 64, epsilon=cfg.MODEL.BN_EPSILON,
-            momentum=cfg.MODEL.BN_MOMENTUM, is_test=test_mode,
+            momentum=misc.get_bn_momentum(cfg.MODEL.BN_MOMENTUM), is_test=test_mode,
         )
     else:
         bn_blob = model.AffineNd(conv_blob, 'res_conv1_bn', 64)
@@ -207,11 +216,30 @@ def create_model(model, data, labels, split):
     else:
         raise Exception("Unsupported network settings.")
 
-    blob_out = model.AveragePool(blob_in, 'pool5', kernels=[pool_stride, 7, 7], strides=[1, 1, 1], pads=[0, 0, 0] * 2)
+    if cfg.MODEL.FUSED_HEAD and split in ['val', 'test']:
+        # pool5, pred, softmax (and the spatial averaging of the fully
+        # convolutional test) as one op
+        blob_in = model.StopFP16(blob_in)
+        softmax = model.GlobalAvgPoolFC(
+            blob_in, 'pred', dim_in, cfg.MODEL.NUM_CLASSES,
+            kernels=[pool_stride, 7, 7])
+        return model, softmax, None
+
+    blob_out = model.AveragePool(blob_in, 'pool5', kernels=[pool_stride // shards, 7, 7], strides=[1, 1, 1], pads=[0, 0, 0] * 2)
+    if shards > 1:
+        # the average of the averages of the shards
+        blob_out = temporal_shard_helper.gather_shards(
+            model, blob_out, 'pool5_shards', axis=2)
+        blob_out = model.AveragePool(
+            blob_out, 'pool5_clip', kernels=[shards, 1, 1],
+            strides=[1, 1, 1], pads=[0, 0, 0] * 2)
+    # the classifier and the loss run in fp32
+    blob_out = model.StopFP16(blob_out)
 
     if cfg.TRAIN.DROPOUT_RATE > 0 and test_mode is False:
         blob_out = model.Dropout(
-            blob_out, blob_out + '_dropout', ratio=cfg.TRAIN.DROPOUT_RATE, is_test=False)
+            blob_out, blob_out + '_dropout', ratio=cfg.TRAIN.DROPOUT_RATE, is_test=False,
+            regenerate_mask=int(cfg.TRAIN.DROPOUT_REGENERATE_MASK))
 
     if split in ['train', 'val']:
         blob_out = model.FC(
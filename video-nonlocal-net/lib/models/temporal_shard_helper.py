@@ -0,0 +1,171 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+"""
+Temporal sharding of the train clips (TRAIN.TEMPORAL_SHARDS): the gpus of a
+group of TEMPORAL_SHARDS consecutive gpus each take their range of the frames
+of the same clips. The temporal convs read kernel_t // 2 frames of the
+neighbouring shards (halos), the non-local blocks attend to the keys of all
+the shards, the BN statistics are the ones of all the gpus (TRAIN.SYNC_BN)
+and pool5 averages over all the shards, so every gpu of a group computes the
+loss of the whole clips.
+
+The ops that read the blobs of another gpu can only be added once the forward
+passes of all the gpus are built and interleaved: the builders record them in
+model._shard_links, and link_shards (data_parallel_model link_devices_fun)
+adds them. Every blob with a gradient is read by one gpu other than its own
+at most, so that the gradients of the copies need no sums across gpus.
+"""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+from caffe2.python import core, scope
+
+from core.config import config as cfg
+import utils.misc as misc
+
+
+def num_shards(model):
+    return getattr(model, 'temporal_shards', 1)
+
+
+def current_gpu():
+    return scope.CurrentDeviceScope().cuda_gpu_id
+
+
+def shard_id(model, gpu=None):
+    gpu = current_gpu() if gpu is None else gpu
+    return (gpu - cfg.ROOT_GPU_ID) % num_shards(model)
+
+
+def _shard_gpu(model, shard):
+    # the gpu of a shard of the group of the current gpu, cyclic
+    gpu = current_gpu()
+    shards = num_shards(model)
+    return gpu - shard_id(model, gpu) + shard % shards
+
+
+def _on_gpu(blob, gpu):
+    return core.BlobReference(
+        'gpu_{}/{}'.format(gpu, misc.unscope_name(str(blob))))
+
+
+def _scoped(blob):
+    if isinstance(blob, core.BlobReference):
+        return blob
+    return core.ScopedBlobReference(blob)
+
+
+def _add_link(model, before, src, dst, scale=None):
+    """Copies src of another gpu to dst of the current gpu, and scales it,
+    right before the op of the current gpu whose first output is before."""
+    links = model._shard_links.setdefault(str(before), [])
+    links.append((str(src), str(dst), scale))
+
+
+def copy_clips(model):
+    """The input ops of the gpus of a group but the first: the clips and
+    labels that the first gpu reads."""
+    leader = _shard_gpu(model, 0)
+    for blob in ['data', 'labels']:
+        model.net.Copy(_on_gpu(blob, leader), blob)
+
+
+def shard_clip(model, data):
+    """The frames of the clips of the shard of the current gpu."""
+    length = cfg.TRAIN.VIDEO_LENGTH // num_shards(model)
+    start = shard_id(model) * length
+    shard = model.net.Slice(
+        data, data + '_shard',
+        starts=[0, 0, start], ends=[-1, -1, start + length])
+    return model.StopGradient(shard, shard)
+
+
+def exchange_halo(model, blob_in, kernels, strides, pads):
+    """blob_in with the kernels[0] // 2 frames of the shards before and after
+    it (zeros at the ends of the clips), and the pads of the conv on it, which
+    then pads no frames."""
+    halo = kernels[0] // 2
+    dims = len(pads) // 2
+    assert strides is None or strides[0] == 1, \
+        'TRAIN.TEMPORAL_SHARDS does not support temporal strides of ' \
+        'temporal convs'
+    assert pads[0] == halo and pads[dims] == halo, \
+        'TRAIN.TEMPORAL_SHARDS needs the temporal convs to pad ' \
+        'kernel_t // 2 frames'
+    blob_in = _scoped(blob_in)
+    # the frames that the neighbours read, one reader each
+    head = model.net.Slice(
+        blob_in, blob_in + '_halo_head',
+        starts=[0, 0, 0], ends=[-1, -1, halo])
+    tail = model.net.Slice(
+        blob_in, blob_in + '_halo_tail',
+        starts=[0, 0, -halo - 1], ends=[-1, -1, -1])
+    prev_halo = blob_in + '_halo_prev'
+    next_halo = blob_in + '_halo_next'
+    padded, _ = model.net.Concat(
+        [prev_halo, blob_in, next_halo],
+        [blob_in + '_halo', blob_in + '_halo_split'], axis=2)
+    shard = shard_id(model)
+    last = num_shards(model) - 1
+    # zeros before the first and after the last frame of the clips
+    _add_link(
+        model, padded, _on_gpu(tail, _shard_gpu(model, shard - 1)),
+        prev_halo, scale=0.0 if shard == 0 else 1.0)
+    _add_link(
+        model, padded, _on_gpu(head, _shard_gpu(model, shard + 1)),
+        next_halo, scale=0.0 if shard == last else 1.0)
+    pads = list(pads)
+    pads[0] = pads[dims] = 0
+    return padded, pads
+
+
+def gather_shards(model, blob_in, blob_out, axis):
+    """The blob_in of all the shards of the group, in their order, concatenated
+    along axis. They go around the group in a ring, so that every copy has one
+    reader on another gpu."""
+    blob_in = _scoped(blob_in)
+    blob_out = _scoped(blob_out)
+    shards = num_shards(model)
+    shard = shard_id(model)
+    prev_gpu = _shard_gpu(model, shard - 1)
+    sends = [blob_in + '_ring_send{}'.format(k) for k in range(shards - 1)]
+    received = [blob_in]
+    for k in range(1, shards):
+        model.net.Copy(received[-1], sends[k - 1])
+        received.append(blob_in + '_ring{}'.format(k))
+    gathered, _ = model.net.Concat(
+        [received[(shard - j) % shards] for j in range(shards)],
+        [blob_out, blob_out + '_split'], axis=axis)
+    # ring<k> from the send of the previous gpu before it is sent on, the
+    # last one before the concat
+    for k in range(1, shards):
+        before = sends[k] if k < shards - 1 else gathered
+        _add_link(
+            model, before, _on_gpu(sends[k - 1], prev_gpu), received[k])
+    return gathered
+
+
+def link_shards(model):
+    """Adds the copies (and scales) of model._shard_links to model.net, whose
+    forward passes are interleaved."""
+    ops = list(model.net.Proto().op)
+    del model.net.Proto().op[:]
+    new_ops = []
+    for op in ops:
+        for src, dst, scale in model._shard_links.get(
+                op.output[0] if op.output else None, []):
+            new_ops.append(core.CreateOperator(
+                'Copy', [src], [dst], device_option=op.device_option))
+            if scale is not None:
+                new_ops.append(core.CreateOperator(
+                    'Scale', [dst], [dst], scale=scale,
+                    device_option=op.device_option))
+        new_ops.append(op)
+    model.net.Proto().op.extend(new_ops)
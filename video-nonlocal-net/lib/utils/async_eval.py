@@ -0,0 +1,195 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+
+"""Evaluation concurrent with the training, see TRAIN.ASYNC_EVAL.
+
+The test net and its init net are built like the ones of create_wrapper,
+but with all their blobs renamed to eval/<name>, so that they neither read
+nor write a blob of the train net. At an EVAL_PERIOD, a snapshot net copies
+the params of the train net into the eval/ ones (device to device, between
+two train runs), and a thread runs the test iterations on them and computes
+the metrics, while the main thread goes on training. The nets are all
+created up front, so that the two threads only run nets and fetch blobs of
+the workspace.
+"""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+import logging
+import math
+import threading
+
+from caffe2.proto import caffe2_pb2
+from caffe2.python import core, utils, workspace
+
+from core.config import config as cfg
+from models import model_builder_video
+import utils.metrics as metrics
+import utils.misc as misc
+from utils.timer import Timer
+
+logger = logging.getLogger(__name__)
+
+EVAL_PREFIX = 'eval/'
+
+
+def _prefix_names(names, prefix):
+    renamed = [prefix + name for name in names]
+    del names[:]
+    names.extend(renamed)
+
+
+def prefix_blob_names(net_proto, prefix):
+    """Renames every blob of net_proto to prefix + name."""
+    for op in net_proto.op:
+        _prefix_names(op.input, prefix)
+        _prefix_names(op.output, prefix)
+    _prefix_names(net_proto.external_input, prefix)
+    _prefix_names(net_proto.external_output, prefix)
+
+
+class AsyncEvaluator(object):
+
+    def __init__(self, split):
+        self.dedicated_gpu = cfg.TRAIN.ASYNC_EVAL_GPU >= 0
+        if self.dedicated_gpu:
+            self.gpus = [cfg.TRAIN.ASYNC_EVAL_GPU]
+            batch_size = cfg.TEST.BATCH_SIZE // cfg.NUM_GPUS
+        else:
+            self.gpus = list(metrics.default_gpus())
+            batch_size = cfg.TEST.BATCH_SIZE
+        self.total_iters = int(
+            math.ceil(cfg.TEST.DATASET_SIZE / float(batch_size)))
+
+        startup_timer = Timer()
+        startup_timer.tic()
+        saved = (cfg.ROOT_GPU_ID, cfg.NUM_GPUS, cfg.TEST.BATCH_SIZE)
+        if self.dedicated_gpu:
+            cfg.ROOT_GPU_ID, cfg.NUM_GPUS, cfg.TEST.BATCH_SIZE = \
+                cfg.TRAIN.ASYNC_EVAL_GPU, 1, batch_size
+        try:
+            self.model = model_builder_video.ModelBuilder(
+                name=cfg.MODEL.MODEL_NAME + '_async_test',
+                train=False,
+                use_cudnn=True,
+                cudnn_exhaustive_search=True,
+                ws_nbytes_limit=(cfg.CUDNN_WORKSPACE_LIMIT * 1024 * 1024),
+                split=split,
+                use_mem_cache=True,
+            )
+            self.model.build_model()
+            self.meter = metrics.MetricsCalculator(
+                model=self.model, split=split, gpus=self.gpus,
+                prefix=EVAL_PREFIX)
+        finally:
+            cfg.ROOT_GPU_ID, cfg.NUM_GPUS, cfg.TEST.BATCH_SIZE = saved
+
+        net = self.model.net.Proto()
+        net.type = misc.get_net_type()
+        misc.set_test_tensor_growth(self.model.net)
+        if not self.dedicated_gpu:
+            # the ops of the test net queue behind those of the train net
+            net.arg.extend([utils.MakeArgument(
+                'stream_offset', misc.ASYNC_EVAL_STREAM_OFFSET)])
+        prefix_blob_names(net, EVAL_PREFIX)
+        prefix_blob_names(self.model.param_init_net.Proto(), EVAL_PREFIX)
+        # the spare blobs of the params, overwritten by every snapshot
+        workspace.RunNetOnce(self.model.param_init_net)
+        workspace.CreateNet(self.model.net)
+        self.snapshot_net = self._create_snapshot_net()
+        logger.info(
+            'Startup of {} on gpus {}: {:.2f}s, {} test iters'.format(
+                net.name, self.gpus, startup_timer.toc(), self.total_iters))
+
+        self.timer = Timer()
+        self.thread = None
+        self.result = None
+        self.error = None
+
+    def _train_blob(self, name):
+        """The blob of the train net that the eval/ blob of name copies: the
+        one of the same gpu, or of ROOT_GPU_ID for a dedicated gpu."""
+        if not self.dedicated_gpu:
+            return name
+        blob = name.split('/', 1)[1]
+        return 'gpu_{}/{}'.format(cfg.ROOT_GPU_ID, blob)
+
+    def _create_snapshot_net(self):
+        net = core.Net(self.model.net.Proto().name + '_snapshot')
+        num_params = 0
+        for param in self.model.GetAllParams():
+            name = str(param)
+            source = self._train_blob(name)
+            if not workspace.HasBlob(source):
+                continue
+            gpu = int(name.split('/', 1)[0][len('gpu_'):])
+            with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, gpu)):
+                net.Copy(source, EVAL_PREFIX + name)
+            num_params += 1
+        assert num_params > 0, \
+            'The test net shares no param with the train net'
+        workspace.CreateNet(net)
+        return net
+
+    def start(self, curr_iter, json_stats):
+        """Snapshots the params of the train net after curr_iter and starts
+        the test on them; json_stats are the train stats of the interval,
+        logged with the test metrics once they are computed."""
+        if self.busy():
+            logger.info('=> Waiting for the test of iter {}'.format(
+                self.result['currentIter']))
+        self.join()
+        self.log_result()
+        workspace.RunNet(self.snapshot_net.Proto().name)
+        self.result = dict(json_stats)
+        self.error = None
+        self.thread = threading.Thread(
+            target=self._run, args=(curr_iter,), name='async_eval')
+        self.thread.daemon = True
+        self.thread.start()
+        logger.info('=> Testing model of iter {} concurrently'.format(
+            curr_iter + 1))
+
+    def _run(self, curr_iter):
+        try:
+            self.meter.reset()
+            for test_iter in range(self.total_iters):
+                self.timer.tic()
+                workspace.RunNet(self.model.net.Proto().name)
+                self.timer.toc()
+                self.meter.calculate_and_log_all_metrics_test(
+                    test_iter, self.timer, self.total_iters)
+            self.meter.finalize_metrics()
+            self.meter.compute_and_log_best()
+            self.meter.log_final_metrics(curr_iter)
+            self.result.update(self.meter.get_computed_metrics())
+        except Exception as e:
+            logger.exception(
+                'The test of iter {} failed'.format(curr_iter + 1))
+            self.error = e
+
+    def busy(self):
+        return self.thread is not None and self.thread.is_alive()
+
+    def join(self):
+        if self.thread is not None:
+            self.thread.join()
+
+    def log_result(self):
+        """Logs the json stats of a finished test once; raises the error of a
+        failed one. Returns whether there was one to log."""
+        if self.thread is None or self.busy():
+            return False
+        self.thread = None
+        if self.error is not None:
+            error, self.error = self.error, None
+            raise error
+        misc.log_json_stats(self.result)
+        return True
@@ -51,6 +51,11 @@ from models import model_builder_video
 logger = logging.getLogger(__name__)
 
 
+def _num_bn_iters():
+    # the BN model runs micro-batches with TRAIN.MICRO_BATCHES
+    return cfg.TRAIN.ITER_COMPUTE_PRECISE_BN * cfg.TRAIN.MICRO_BATCHES
+
+
 class BatchNormHelper():
 
     def __init__(self):
@@ -64,6 +69,11 @@ class BatchNormHelper():
 
         self._last_update_iter = -1  # log the last update iter
 
+        # the nets of TRAIN.PRECISE_BN_ON_DEVICE
+        self._reset_net = None
+        self._reduce_net = None
+        self._finalize_net = None
+
     def create_bn_aux_model(self, node_id):
         """
         bn_aux_model:
@@ -84,13 +94,17 @@ class BatchNormHelper():
             force_fw_only=True,
         )
         self._model.build_model(node_id=node_id)
+        self._find_bn_layers()
+        if cfg.TRAIN.PRECISE_BN_ON_DEVICE:
+            self._add_accumulate_ops()
 
         workspace.CreateNet(self._model.net)
         # self._model.start_data_loader()
 
         misc.save_net_proto(self._model.net)
 
-        self._find_bn_layers()
+        if cfg.TRAIN.PRECISE_BN_ON_DEVICE:
+            self._create_device_nets()
         self._clean_and_reset_buffer()
         return
 
@@ -107,26 +121,39 @@ class BatchNormHelper():
                 curr_iter + 1))
 
             self._last_update_iter = curr_iter
-            self._clean_and_reset_buffer()
+            on_device = cfg.TRAIN.PRECISE_BN_ON_DEVICE
+            if on_device:
+                workspace.RunNet(self._reset_net.Proto().name)
+            else:
+                self._clean_and_reset_buffer()
 
             timer = Timer()
-            for i in range(cfg.TRAIN.ITER_COMPUTE_PRECISE_BN):
+            for i in range(_num_bn_iters()):
                 timer.tic()
                 workspace.RunNet(self._model.net.Proto().name)
-                self._collect_bn_stats()
+                if not on_device:
+                    self._collect_bn_stats()
                 timer.toc()
 
                 if (i + 1) % cfg.LOG_PERIOD == 0:
                     logger.info('Computing BN [{}/{}]: {:.3}s'.format(
-                        i + 1, cfg.TRAIN.ITER_COMPUTE_PRECISE_BN, timer.diff))
-
-            self._finalize_bn_stats()
-            self._update_bn_stats_gpu()
+                        i + 1, _num_bn_iters(), timer.diff))
+
+            if on_device:
+                workspace.RunNet(self._reduce_net.Proto().name)
+                workspace.RunNet(self._finalize_net.Proto().name)
+            else:
+                self._finalize_bn_stats()
+                self._update_bn_stats_gpu()
         else:
             # use the last compute
             logger.info('BN of iter {} computed. Update to GPU only.'.format(
                 curr_iter + 1))
-            self._update_bn_stats_gpu()
+            if cfg.TRAIN.PRECISE_BN_ON_DEVICE:
+                # the reduced sums are kept on the gpus
+                workspace.RunNet(self._finalize_net.Proto().name)
+            else:
+                self._update_bn_stats_gpu()
 
     def _find_bn_layers(self):
         self._bn_layers = []
@@ -139,6 +166,57 @@ class BatchNormHelper():
 
         return
 
+    def _add_accumulate_ops(self):
+        """
+        each gpu adds sm and the mean of x ** 2 derived from siv of every bn
+        layer to <bn_layer>_bn_stats_sum, on the gpu
+        """
+        root_gpu_id = cfg.ROOT_GPU_ID
+        for i in range(root_gpu_id, root_gpu_id + cfg.NUM_GPUS):
+            with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, i)):
+                for bn_layer in self._bn_layers:
+                    layername = 'gpu_{}/'.format(i) + bn_layer
+                    # sized by the first run, see _create_device_nets
+                    workspace.CreateBlob(layername + '_bn_stats_sum')
+                    self._model.net.AccumulateBNStats(
+                        [layername + '_bn_sm', layername + '_bn_siv',
+                         layername + '_bn_stats_sum'],
+                        layername + '_bn_stats_sum',
+                        epsilon=cfg.MODEL.BN_EPSILON)
+
+    def _create_device_nets(self):
+        """
+        reset net: zeroes the sums before a new compute
+        reduce net: allreduces the sums of every layer over the gpus
+        finalize net: writes the stats of the reduced sums to "rm" and "riv"
+        """
+        name = self._model.net.Proto().name
+        self._reset_net = core.Net(name + '_reset')
+        self._reduce_net = core.Net(name + '_reduce')
+        self._finalize_net = core.Net(name + '_finalize')
+        root_gpu_id = cfg.ROOT_GPU_ID
+        gpus = range(root_gpu_id, root_gpu_id + cfg.NUM_GPUS)
+        count = _num_bn_iters() * cfg.NUM_GPUS
+        for bn_layer in self._bn_layers:
+            sums = ['gpu_{}/'.format(i) + bn_layer + '_bn_stats_sum'
+                    for i in gpus]
+            for i, blob in zip(gpus, sums):
+                layername = 'gpu_{}/'.format(i) + bn_layer
+                with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, i)):
+                    # empty, so the first AccumulateBNStats starts from 0
+                    self._reset_net.ConstantFill([], blob, shape=[0])
+                    self._finalize_net.FinalizeBNStats(
+                        [blob, layername + '_bn_rm', layername + '_bn_riv'],
+                        [layername + '_bn_rm', layername + '_bn_riv'],
+                        count=count)
+            if len(sums) > 1:
+                with core.DeviceScope(
+                        core.DeviceOption(caffe2_pb2.CUDA, root_gpu_id)):
+                    self._reduce_net.NCCLAllreduce(sums, sums)
+        for net in [self._reset_net, self._reduce_net, self._finalize_net]:
+            workspace.CreateNet(net)
+        return
+
     def _clean_and_reset_buffer(self):
         self._meanX_dict = {}
         self._meanX2_dict = {}
@@ -164,14 +242,17 @@ class BatchNormHelper():
         bn_eps = cfg.MODEL.BN_EPSILON
         num_gpus = cfg.NUM_GPUS
         root_gpu_id = cfg.ROOT_GPU_ID
+        # all the copies are started at once
+        names = [
+            'gpu_{}/{}{}'.format(i, bn_layer, suffix)
+            for i in range(root_gpu_id, root_gpu_id + num_gpus)
+            for bn_layer in self._bn_layers
+            for suffix in ['_bn_sm', '_bn_siv']]
+        fetched = iter(workspace.FetchBlobs(names))
         for i in range(root_gpu_id, root_gpu_id + num_gpus):
             for bn_layer in self._bn_layers:
-                layername = 'gpu_{}/'.format(i) + bn_layer
-
-                single_batch_meanX = workspace.FetchBlob(
-                    layername + '_bn_sm')
-                single_batch_inv_std = workspace.FetchBlob(
-                    layername + '_bn_siv')
+                single_batch_meanX = next(fetched)
+                single_batch_inv_std = next(fetched)
 
                 single_batch_var = (1. / single_batch_inv_std) ** 2 - bn_eps
                 # var = mean(x ** 2) - mean(x) ** 2
@@ -187,7 +268,7 @@ class BatchNormHelper():
         update the CPU cache
         """
 
-        normalize = cfg.TRAIN.ITER_COMPUTE_PRECISE_BN * cfg.NUM_GPUS
+        normalize = _num_bn_iters() * cfg.NUM_GPUS
 
         self._var_dict = {}
 
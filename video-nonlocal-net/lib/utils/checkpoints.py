@@ -33,6 +33,7 @@ from collections import OrderedDict
 import cPickle as pickle
 
 import utils.misc as misc
+from models import model_builder_video, pipeline_helper
 
 from core.config import config as cfg
 from caffe2.python import workspace, core
@@ -41,36 +42,92 @@ from caffe2.proto import caffe2_pb2
 logger = logging.getLogger(__name__)
 
 
+CHECKPOINT_EXTENSIONS = ('.pkl', '.minidb')
+
+
+def get_checkpoint_file(checkpoint_dir, model_iter):
+    return os.path.join(checkpoint_dir, 'c2_model_iter{}.{}'.format(
+        model_iter, cfg.CHECKPOINT.FORMAT))
+
+
+# map from the iters checkpointed to their files
+def get_checkpoint_iters(checkpoint_dir):
+    checkpoint_iters = {}
+    for f in os.listdir(checkpoint_dir):
+        name, ext = os.path.splitext(f)
+        if ext in CHECKPOINT_EXTENSIONS and name.startswith('c2_model_iter'):
+            iter_num = int(name.replace('c2_model_iter', ''))
+            checkpoint_iters[iter_num] = os.path.join(checkpoint_dir, f)
+    return checkpoint_iters
+
+
 # This function looks at all the iters checkpointed and returns latest iter file
 def get_checkpoint_resume_file():
-    checkpoint_dir = get_checkpoint_directory()
-    all_files = os.listdir(checkpoint_dir)
-    all_iters = []
-    for f in all_files:
-        if f.endswith('.pkl') and f.startswith('c2_model_iter'):
-            iter_num = int(f.replace('.pkl', '').replace('c2_model_iter', ''))
-            all_iters.append(iter_num)
-    if len(all_iters) > 0:
-        all_iters.sort(reverse=True)
-        last_iter = int(all_iters[0])
-        filepath = os.path.join(
-            checkpoint_dir, 'c2_model_iter{}.pkl'.format(last_iter)
-        )
-        return filepath
+    checkpoint_iters = get_checkpoint_iters(get_checkpoint_directory())
+    if len(checkpoint_iters) > 0:
+        return checkpoint_iters[max(checkpoint_iters)]
     else:
         return None
 
 
 # find whether checkpoint exist
 def find_checkpoint():
-    checkpoint_dir = get_checkpoint_directory()
-    checkpointed_files = os.listdir(checkpoint_dir)
-    checkpoint_exists = False
-    for f in checkpointed_files:
-        if f.endswith('.pkl') and f.startswith('c2_model_iter'):
-            checkpoint_exists = True
-            break
-    return checkpoint_exists
+    return len(get_checkpoint_iters(get_checkpoint_directory())) > 0
+
+
+# the blob of the position of the train reader in the checkpoints, see
+# CHECKPOINT.RESUME_DATA_POSITION
+DATA_POSITION = 'data_position'
+
+
+# the reader whose position the checkpoints of model keep, if any
+def get_data_reader(model):
+    if not cfg.CHECKPOINT.RESUME_DATA_POSITION or \
+            cfg.DECODE_SERVICE.ENABLED or 'test' in model.net.Name():
+        return None
+    return model.data_loader
+
+
+def seek_data_reader(model, position, start_model_iter):
+    """Moves the train reader to the position of a checkpoint, before the
+    input ops start to prefetch; the positions of the next checkpoints are
+    counted from there."""
+    reader = get_data_reader(model)
+    if reader is None:
+        return
+    if position is None:
+        logger.info('No data position in the checkpoint; reading the db '
+                    'from the start')
+        return
+    start = str(reader) + '_start'
+    workspace.FeedBlob(
+        start, np.array(position, dtype=np.int64).reshape(3),
+        device_option=core.DeviceOption(caffe2_pb2.CPU))
+    workspace.RunOperatorOnce(core.CreateOperator(
+        'SeekDBReader', [reader, start], [],
+        device_option=core.DeviceOption(caffe2_pb2.CPU)))
+    logger.info('Resuming the reader at epoch {}, record {}'.format(
+        position[1], position[2]))
+    model._data_position_start = (start, start_model_iter)
+
+
+def feed_data_position(model, model_iter):
+    """Feeds DATA_POSITION with the position of the train reader after the
+    batches of the iterations up to model_iter, which the input ops have
+    read ahead of. Returns whether there is one."""
+    reader = get_data_reader(model)
+    if reader is None:
+        return False
+    inputs = [reader]
+    records = (model_iter + 1) * cfg.TRAIN.BATCH_SIZE
+    start = getattr(model, '_data_position_start', None)
+    if start is not None:
+        inputs.append(start[0])
+        records = (model_iter + 1 - start[1]) * cfg.TRAIN.BATCH_SIZE
+    workspace.RunOperatorOnce(core.CreateOperator(
+        'DBReaderPosition', inputs, [DATA_POSITION], records=records,
+        device_option=core.DeviceOption(caffe2_pb2.CPU)))
+    return True
 
 
 def load_model_from_params_file_for_test(model, weights_file):
@@ -79,6 +136,62 @@ def load_model_from_params_file_for_test(model, weights_file):
     return
 
 
+def _rewrite_with_params(model, rewrite):
+    """Runs rewrite(net) on model.net in a scratch workspace holding the
+    parameters of its convs and affine ops, which the rewrite works on as CPU
+    tensors, then feeds back the new conv parameters with the device of the
+    conv they belong to. Returns the rewritten net."""
+    net = model.net.Proto()
+    params = set()
+    for op in net.op:
+        if op.type in ('Conv', 'AffineNd', 'SpatialBN'):
+            params.update(
+                blob for blob in op.input[1:] if workspace.HasBlob(blob))
+    params = list(params)
+    values = dict(zip(params, workspace.FetchBlobs(params)))
+
+    current_ws = workspace.CurrentWorkspace()
+    workspace.SwitchWorkspace('rewrite_params', True)
+    for blob, value in values.items():
+        workspace.FeedBlob(blob, value)
+    rewritten = rewrite(net)
+    new_blobs = {}
+    for op in rewritten.op:
+        if op.type in ('Conv', 'ConvRelu'):
+            for blob in op.input[1:]:
+                if blob not in values:
+                    new_blobs[blob] = (
+                        workspace.FetchBlob(blob), op.device_option)
+    workspace.ResetWorkspace()
+    workspace.SwitchWorkspace(current_ws)
+
+    for blob, (value, device_option) in new_blobs.items():
+        workspace.FeedBlob(blob, value, device_option)
+    return rewritten
+
+
+def fold_affine_into_conv(model):
+    """Folds the AffineNd and test mode SpatialBN ops of model.net into the
+    Conv ops before them."""
+    net = model.net.Proto()
+    folded = _rewrite_with_params(
+        model, lambda net: workspace.ApplyTransform('FoldAffineIntoConv', net))
+    logger.info('Folded {} affine ops into convs'.format(
+        len(net.op) - len(folded.op)))
+    net.CopyFrom(folded)
+
+
+def optimize_video_inference(model):
+    """Folds the affine ops of model.net into its convs and the scales of the
+    non-local blocks into their BatchMatMuls, simplifies the reshapes around
+    them and fuses the Relus into the Sums (and the CPU convs) before them."""
+    net = model.net.Proto()
+    optimized = _rewrite_with_params(model, workspace.OptimizeVideoInference)
+    logger.info('Optimized the test net from {} to {} ops'.format(
+        len(net.op), len(optimized.op)))
+    net.CopyFrom(optimized)
+
+
 def load_model_from_params_file(model):
     """
     case 1: CHECKPOINT.RESUME = False and TRAIN.PARAMS_FILE is not none:
@@ -121,6 +234,9 @@ def load_model_from_params_file(model):
         logger.info(('Loaded: start_model_iter: {}; prev_lr: {:.8f}').format(
             start_model_iter, prev_lr))
         model.current_lr = prev_lr
+        seek_data_reader(
+            model, getattr(model, '_checkpoint_data_position', None),
+            start_model_iter)
     else:  # no checkpoint, no params_file
         # Do nothing and return 0
         start_model_iter = 0
@@ -154,22 +270,139 @@ def create_and_get_checkpoint_directory():
     return checkpoint_dir
 
 
+# the unscoped names of the blobs that are loaded into the model
+# the blobs the solver keeps per trainable param, '_momentum' and for LAMB
+# the second moment
+def get_param_state_suffixes():
+    if cfg.SOLVER.LAYERWISE == 'lamb':
+        return ['_momentum', '_moment2']
+    return ['_momentum']
+
+
+def get_blob_names_to_load(model, load_momentum):
+    unscoped_blob_names = OrderedDict()
+    # the momentum of sharded params is scattered over the gpus instead
+    sharded = set(model_builder_video.sharded_params(model))
+    if 'test' not in model.net.Name() and load_momentum:
+        for param in model.params:
+            if param in model.TrainableParams() and \
+                    misc.unscope_name(str(param)) not in sharded:
+                for suffix in get_param_state_suffixes():
+                    unscoped_blob_names[misc.unscope_name(
+                        str(param) + suffix)] = True
+    for blob in model.GetAllParams():
+        unscoped_blob_names[misc.unscope_name(str(blob))] = True
+    return list(unscoped_blob_names.keys())
+
+
+# with TRAIN.SHARD_OPTIMIZER_STATE, the momentum of the flat params is kept
+# in a shard per gpu (see model_builder_video.SHARD_MOMENTUM); the
+# checkpoints hold it per param as usual, assembled on the host
+def sharded_momentum_names(model):
+    return [
+        name + '_momentum'
+        for name in model_builder_video.sharded_params(model)]
+
+
+def gather_sharded_momentum(model):
+    """The momentum of the sharded params, by unscoped blob name."""
+    root_gpu_id = cfg.ROOT_GPU_ID
+    shards = workspace.FetchBlobs([
+        'gpu_{}/{}'.format(i, model_builder_video.SHARD_MOMENTUM)
+        for i in range(root_gpu_id, root_gpu_id + cfg.NUM_GPUS)])
+    flat = np.concatenate(shards)
+    shapes = dict(
+        (misc.unscope_name(str(p)), workspace.FetchBlob(str(p)).shape)
+        for p in model.GetParams('gpu_{}'.format(root_gpu_id)))
+    return OrderedDict(
+        (name + '_momentum',
+         flat[start:start + size].reshape(shapes[name]))
+        for name, start, size in model._flat_param_layout)
+
+
+def scatter_sharded_momentum(model, momenta):
+    """Feeds the shards of the momentum of the sharded params to the gpus,
+    from the momenta by unscoped blob name; the missing ones are zero."""
+    flat = np.zeros(model._flat_param_size, dtype=np.float32)
+    num_loaded = 0
+    for name, start, size in model._flat_param_layout:
+        momentum = momenta.get(name + '_momentum')
+        if momentum is not None and momentum.size == size:
+            flat[start:start + size] = momentum.ravel()
+            num_loaded += 1
+    logger.info('Scattering the momentum of {}/{} sharded params'.format(
+        num_loaded, len(model._flat_param_layout)))
+    root_gpu_id = cfg.ROOT_GPU_ID
+    for i, shard in enumerate(np.split(flat, cfg.NUM_GPUS)):
+        gpu_id = root_gpu_id + i
+        workspace.FeedBlob(
+            'gpu_{}/{}'.format(gpu_id, model_builder_video.SHARD_MOMENTUM),
+            shard, device_option=core.DeviceOption(caffe2_pb2.CUDA, gpu_id))
+
+
+# load a minidb checkpoint straight into the blobs of the root gpu; unlike
+# the pkl files, they are never inflated
+def initialize_master_gpu_model_params_from_minidb(
+        model, weights_file, load_momentum=True):
+    root_gpu_id = cfg.ROOT_GPU_ID
+    prefix = 'gpu_{}/'.format(root_gpu_id)
+    blob_names = get_blob_names_to_load(model, load_momentum)
+    blob_names += ['lr', 'checkpoint_iter']
+    with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, root_gpu_id)):
+        op = core.CreateOperator(
+            'Load', [], [prefix + name for name in blob_names],
+            db=weights_file, db_type='minidb', absolute_path=1,
+            add_prefix=prefix, allow_incomplete=1)
+    workspace.RunOperatorOnce(op)
+    model_iter = int(workspace.FetchBlob(prefix + 'checkpoint_iter')[0])
+    prev_lr = float(workspace.FetchBlob(prefix + 'lr'))
+    if get_data_reader(model) is not None:
+        workspace.RunOperatorOnce(core.CreateOperator(
+            'Load', [], [DATA_POSITION],
+            db=weights_file, db_type='minidb', absolute_path=1,
+            allow_incomplete=1,
+            device_option=core.DeviceOption(caffe2_pb2.CPU)))
+        if workspace.HasBlob(DATA_POSITION):
+            model._checkpoint_data_position = workspace.FetchBlob(
+                DATA_POSITION)
+    momentum_names = sharded_momentum_names(model)
+    if momentum_names and load_momentum:
+        # to the host, and from there to the shards of the gpus
+        op = core.CreateOperator(
+            'Load', [], [prefix + name for name in momentum_names],
+            db=weights_file, db_type='minidb', absolute_path=1,
+            add_prefix=prefix, allow_incomplete=1)
+        workspace.RunOperatorOnce(op)
+        scatter_sharded_momentum(model, dict(
+            (name, workspace.FetchBlob(prefix + name))
+            for name in momentum_names
+            if workspace.HasBlob(prefix + name)))
+    return model_iter, prev_lr
+
+
 # initialize from ImageNet pre-trained weights, and ***inflate*** if necessary
 def initialize_master_gpu_model_params(
         model, weights_file, load_momentum=True):
+    if weights_file.endswith('.minidb'):
+        model_iter, prev_lr = initialize_master_gpu_model_params_from_minidb(
+            model, weights_file, load_momentum)
+        feed_lr(prev_lr)
+        return model_iter, prev_lr
+
     ws_blobs = workspace.Blobs()
     logger.info("Initializing model params from file: {}".format(weights_file))
     with open(weights_file, 'r') as fopen:
         blobs = pickle.load(fopen)
     if 'blobs' in blobs:
         blobs = blobs['blobs']
-    unscoped_blob_names = OrderedDict()
 
     # Return the model iter from which training should start
     model_iter = 0
     if 'model_iter' in blobs:
         model_iter = blobs['model_iter']
 
+    model._checkpoint_data_position = blobs.get(DATA_POSITION)
+
     if 'lr' in blobs:
         prev_lr = float(blobs['lr'])
     elif cfg.TRAIN.RESET_START_ITER:
@@ -178,18 +411,15 @@ def initialize_master_gpu_model_params(
         raise Exception('No lr blob found.')
 
     # initialize params, params momentum, computed params
-    if 'test' not in model.net.Name() and load_momentum:
-        for param in model.params:
-            if param in model.TrainableParams():
-                unscoped_blob_names[misc.unscope_name(
-                    str(param) + '_momentum')] = True
-    for blob in model.GetAllParams():
-        unscoped_blob_names[misc.unscope_name(str(blob))] = True
+    unscoped_blob_names = get_blob_names_to_load(model, load_momentum)
+    if 'test' not in model.net.Name() and load_momentum and \
+            sharded_momentum_names(model):
+        scatter_sharded_momentum(model, blobs)
 
     root_gpu_id = cfg.ROOT_GPU_ID
     with core.NameScope('gpu_{}'.format(root_gpu_id)):
         with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, root_gpu_id)):
-            for unscoped_blob_name in unscoped_blob_names.keys():
+            for unscoped_blob_name in unscoped_blob_names:
                 scoped_blob_name = misc.scoped_name(unscoped_blob_name)
                 if unscoped_blob_name not in blobs:
                     logger.info('{:s} not found'.format(unscoped_blob_name))
@@ -254,13 +484,16 @@ def initialize_master_gpu_model_params(
                 data = blobs[unscoped_blob_name].astype(np.float32, copy=False)
                 workspace.FeedBlob(scoped_blob_name, data)
 
-    # hack fix: load and broadcast lr to all gpus
+    feed_lr(prev_lr)
+    return model_iter, prev_lr
+
+
+# hack fix: load and broadcast lr to all gpus
+def feed_lr(lr):
     for i in range(cfg.NUM_GPUS):
         with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, i)):
             workspace.FeedBlob(
-                'gpu_{}/lr'.format(i), np.array(prev_lr, dtype=np.float32))
-
-    return model_iter, prev_lr
+                'gpu_{}/lr'.format(i), np.array(lr, dtype=np.float32))
 
 
 def broadcast_parameters(model):
@@ -270,21 +503,33 @@ def broadcast_parameters(model):
     root_gpu_id = cfg.ROOT_GPU_ID
     all_model_params = model.GetAllParams('gpu_{}'.format(root_gpu_id))
     all_params_momentum = []
+    sharded = set(model_builder_video.sharded_params(model))
     if 'test' not in model.net.Name():
         for param in model.GetParams('gpu_{}'.format(root_gpu_id)):
-            if param in model.TrainableParams():
-                all_params_momentum.append(str(param) + '_momentum')
+            if param in model.TrainableParams() and \
+                    misc.unscope_name(str(param)) not in sharded:
+                for suffix in get_param_state_suffixes():
+                    all_params_momentum.append(str(param) + suffix)
+    # with TRAIN.FLATTEN_PARAMS the flattened params are one blob to copy
+    views = getattr(model, '_flat_views', set())
+    if views:
+        prefix = 'gpu_{}/'.format(root_gpu_id)
+        all_model_params = [
+            p for p in all_model_params
+            if str(p)[len(prefix):] not in views] + [prefix + 'flat_params']
     all_params = all_model_params + all_params_momentum
-    for param in all_params:
-        data = workspace.FetchBlob(str(param))
-        unscoped_param_name = misc.unscope_name(str(param))
-        logger.info('Broadcasting {} to'.format(str(param)))
-        for idx in range(root_gpu_id + 1, root_gpu_id + num_gpus):
-            with core.NameScope('gpu_{}'.format(idx)):
-                with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, idx)):
-                    gpu_scoped_name = misc.scoped_name(unscoped_param_name)
-                    logger.info(' |-> {}'.format(gpu_scoped_name))
-                    workspace.FeedBlob(gpu_scoped_name, data)
+    # gpu to gpu copies, instead of a round trip through numpy per gpu
+    net = core.Net('broadcast_parameters')
+    for idx in range(root_gpu_id + 1, root_gpu_id + num_gpus):
+        with core.NameScope('gpu_{}'.format(idx)):
+            with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, idx)):
+                for param in all_params:
+                    net.Copy(
+                        str(param),
+                        misc.scoped_name(misc.unscope_name(str(param))))
+    logger.info('Broadcasting {} blobs to {} gpus'.format(
+        len(all_params), num_gpus - 1))
+    workspace.RunNetOnce(net)
 
 
 # initialize the model from a file and broadcast the parameters to all_gpus
@@ -295,9 +540,44 @@ def initialize_params_from_file(model, weights_file, load_momentum=True):
         model, weights_file, load_momentum
     )
     broadcast_parameters(model)
+    pipeline_helper.place_blobs(model)
     return model_iter, prev_lr
 
 
+# the net of the Checkpoint op that writes the minidb checkpoints of model;
+# it keeps the last (async) save going until the next one or until
+# wait_for_checkpoint
+def get_checkpoint_net(model, save_blobs, params_file):
+    net = getattr(model, '_checkpoint_net', None)
+    if net is not None:
+        return net
+    root_gpu_id = cfg.ROOT_GPU_ID
+    db = os.path.join(
+        os.path.dirname(os.path.abspath(params_file)),
+        'c2_model_iter%d.minidb')
+    net = core.Net('{}_checkpoint'.format(model.net.Name()))
+    with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, root_gpu_id)):
+        net.Checkpoint(
+            ['checkpoint_iter'] + save_blobs +
+            ['gpu_{}/lr'.format(root_gpu_id)], [],
+            db=db, db_type='minidb', absolute_path=1, every=1,
+            strip_prefix='gpu_{}/'.format(root_gpu_id),
+            num_threads=cfg.CHECKPOINT.SAVE_THREADS,
+            async_save=int(cfg.CHECKPOINT.ASYNC_SAVE))
+    workspace.FeedBlob('checkpoint_iter', np.array([0], dtype=np.int64))
+    workspace.CreateNet(net)
+    model._checkpoint_net = net
+    return net
+
+
+# finish the minidb checkpoint of model that is still being written
+def wait_for_checkpoint(model):
+    net = getattr(model, '_checkpoint_net', None)
+    if net is not None:
+        workspace.C.delete_net(net.Proto().name)
+        model._checkpoint_net = None
+
+
 def save_model_params(model, params_file, model_iter):
     logger.info("Saving model params to weights file {}".format(params_file))
     root_gpu_id = cfg.ROOT_GPU_ID
@@ -306,36 +586,63 @@ def save_model_params(model, params_file, model_iter):
     save_computed_params = [
         str(param) for param in model.GetComputedParams('gpu_{}'.format(
             root_gpu_id))]
+    momenta = {}
+    if sharded_momentum_names(model):
+        momenta = gather_sharded_momentum(model)
+    if params_file.endswith('.minidb'):
+        if momenta:
+            # the Checkpoint op saves them from host blobs, which the last
+            # save may still be reading
+            wait_for_checkpoint(model)
+            for name, momentum in momenta.items():
+                workspace.FeedBlob(
+                    'gpu_{}/{}'.format(root_gpu_id, name), momentum,
+                    device_option=core.DeviceOption(caffe2_pb2.CPU))
+        save_blobs = OrderedDict()
+        for param in save_params:
+            if param in model.TrainableParams():
+                for suffix in get_param_state_suffixes():
+                    save_blobs[param + suffix] = True
+        for param in save_params + save_computed_params:
+            save_blobs[param] = True
+        if feed_data_position(model, model_iter):
+            save_blobs[DATA_POSITION] = True
+        net = get_checkpoint_net(model, list(save_blobs.keys()), params_file)
+        # also save total model iterations so far
+        workspace.FeedBlob(
+            'checkpoint_iter', np.array([model_iter + 1], dtype=np.int64))
+        workspace.RunNet(net.Proto().name)
+        return
+
     save_blobs = {}
     # also save total model iterations so far
     save_blobs['model_iter'] = model_iter + 1
     save_blobs['lr'] = workspace.FetchBlob('gpu_{}/lr'.format(root_gpu_id))
+    save_blobs.update(momenta)
+    if feed_data_position(model, model_iter):
+        save_blobs[DATA_POSITION] = workspace.FetchBlob(DATA_POSITION)
+    # the scoped names to fetch, all at once, by unscoped name
+    scoped_blob_names = {}
     # save param momentum as well
     for param in save_params:
-        if param in model.TrainableParams():
-            scoped_blob_name = str(param) + '_momentum'
+        if param not in model.TrainableParams():
+            continue
+        for suffix in get_param_state_suffixes():
+            scoped_blob_name = str(param) + suffix
             unscoped_blob_name = misc.unscope_name(scoped_blob_name)
             if unscoped_blob_name not in save_blobs:
-                data = workspace.FetchBlob(scoped_blob_name)
-                save_blobs[unscoped_blob_name] = data
-                # logger.info(
-                #     '{:s} {} -> {:s}'.format(
-                #         scoped_blob_name, data.shape,
-                #         unscoped_blob_name)
-                # )
+                scoped_blob_names.setdefault(
+                    unscoped_blob_name, scoped_blob_name)
 
     for param in save_params + save_computed_params:
         scoped_blob_name = str(param)
         unscoped_blob_name = misc.unscope_name(scoped_blob_name)
         if unscoped_blob_name not in save_blobs:
-            data = workspace.FetchBlob(
-                scoped_blob_name
-            )
-            save_blobs[unscoped_blob_name] = data
-            # logger.info(
-            #     '{:s} {} -> {:s}'.format(
-            #         scoped_blob_name, data.shape,
-            #         unscoped_blob_name)
-            # )
+            scoped_blob_names.setdefault(unscoped_blob_name, scoped_blob_name)
+
+    unscoped_blob_names = list(scoped_blob_names.keys())
+    fetched = workspace.FetchBlobs(
+        [scoped_blob_names[name] for name in unscoped_blob_names])
+    save_blobs.update(zip(unscoped_blob_names, fetched))
     with open(params_file, 'w') as fwrite:
         pickle.dump(dict(blobs=save_blobs), fwrite, pickle.HIGHEST_PROTOCOL)
@@ -0,0 +1,127 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+
+"""Rewrites the Relu and MaxPool ops of the forward pass of a training net,
+before its gradient ops are added, to the ReluWithMask and MaxPoolArgmax ops
+of caffe2/video, whose gradients read a bit mask and byte argmaxes instead
+of the activations, see MODEL.COMPACT_ACTIVATIONS.
+
+An op is only rewritten when that lets one of its activations go, i.e. when
+no other gradient op reads it: then the activation lives until its last
+forward reader in the memory plan (memonger.plan_activation_memory) instead
+of until the backward pass. In the I3D nets these are the stem ReLU and the
+pool1 reading it, and the last ReLU of res2 and pool2. The ReLUs that feed
+convs and the pools of the non-local blocks keep their ops, as the conv
+gradients read those activations anyway, and a mask or an argmax would only
+add to the memory.
+"""
+
+from __future__ import print_function
+from __future__ import unicode_literals
+from __future__ import division
+from __future__ import absolute_import
+
+import logging
+
+from caffe2.python import core
+
+logger = logging.getLogger(__name__)
+
+
+def _args(op):
+    return {arg.name: arg for arg in op.arg}
+
+
+def _saved_blobs(op):
+    """The inputs and outputs of the forward op op that its gradient ops
+    read."""
+    try:
+        grad_ops, _ = core.GradientRegistry.GetGradientForOp(
+            op, [blob + '_grad' for blob in op.output])
+    except Exception:
+        # an op without gradient, e.g. the input ops
+        return set()
+    forward = set(op.input) | set(op.output)
+    return set(blob for grad_op in grad_ops for blob in grad_op.input
+               if blob in forward)
+
+
+def _window(op):
+    args = _args(op)
+    if 'kernels' in args:
+        kernels = list(args['kernels'].ints)
+    elif 'kernel' in args:
+        kernels = [args['kernel'].i] * 2
+    else:
+        kernels = [args[name].i for name in ('kernel_h', 'kernel_w')
+                   if name in args]
+    window = 1
+    for kernel in kernels:
+        window *= kernel
+    return window
+
+
+def _compactable(op):
+    if op.type == 'Relu':
+        return True
+    if op.type != 'MaxPool':
+        return False
+    args = _args(op)
+    # NCHW, no dilation, and an argmax that fits a byte (see
+    # max_pool_argmax_op.h)
+    return (
+        ('order' not in args or args['order'].s == b'NCHW') and
+        'global_pooling' not in args and
+        all(d == 1 for d in (
+            args['dilations'].ints if 'dilations' in args else [])) and
+        0 < _window(op) <= 255)
+
+
+def _compact_op(op):
+    compact = core.CreateOperator(
+        'ReluWithMask' if op.type == 'Relu' else 'MaxPoolArgmax',
+        list(op.input),
+        list(op.output) + (
+            [op.output[0] + '_mask'] if op.type == 'Relu' else
+            [op.output[0] + '_argmax', op.output[0] + '_xdims']),
+        name=op.name,
+        device_option=op.device_option,
+    )
+    # without the engine of op: cudnn has no such ops
+    compact.arg.extend(op.arg)
+    return compact
+
+
+def compact_activations(net_proto):
+    """Rewrites the ops of net_proto, a forward pass, in place. Returns the
+    number of rewritten ops."""
+    ops = list(net_proto.op)
+    candidates = set(i for i, op in enumerate(ops) if _compactable(op))
+    saved = [_saved_blobs(op) for op in ops]
+    keep = set(net_proto.external_output)
+
+    # Start from rewriting all the candidates and drop those that free
+    # nothing, until none is left to drop: dropping a candidate keeps its
+    # saved blobs alive, which can make another one useless.
+    rewritten = set(candidates)
+    while True:
+        needed = set(keep)
+        for i in range(len(ops)):
+            if i not in rewritten:
+                needed.update(saved[i])
+        useless = [i for i in rewritten if not saved[i] - needed]
+        if not useless:
+            break
+        rewritten.difference_update(useless)
+
+    for i in rewritten:
+        ops[i] = _compact_op(ops[i])
+    del net_proto.op[:]
+    net_proto.op.extend(ops)
+    logger.info('Rewrote {} of {} Relu and MaxPool ops to compact ones'
+                .format(len(rewritten), len(candidates)))
+    return len(rewritten)
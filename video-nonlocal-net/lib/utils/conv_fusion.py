@@ -0,0 +1,176 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+
+"""Rewrites the factorized I3D convs of an inference net, a temporal
+kt x 1 x 1 Conv, its frozen BN (AffineNd, or SpatialBN / SpatialBNRelu in
+test mode, folded to a scale and bias), the Relu and the spatial 1 x kh x kw
+Conv reading it, to one Conv2Plus1D op of caffe2/video, which never writes
+the intermediate out as a blob.
+"""
+
+from __future__ import print_function
+from __future__ import unicode_literals
+from __future__ import division
+from __future__ import absolute_import
+
+import numpy as np
+import logging
+
+from caffe2.python import core
+
+logger = logging.getLogger(__name__)
+
+
+def _args(op):
+    return {arg.name: arg for arg in op.arg}
+
+
+def _ints(args, name, default):
+    return list(args[name].ints) if name in args else default
+
+
+def _conv_geometry(op):
+    """kernels, strides, pads of a 3D Conv without group, dilation or bias,
+    or None."""
+    if op.type != 'Conv':
+        return None
+    args = _args(op)
+    kernels = _ints(args, 'kernels', [])
+    if len(kernels) != 3 or (
+            'group' in args and args['group'].i != 1) or \
+            any(d != 1 for d in _ints(args, 'dilations', [1, 1, 1])):
+        return None
+    return (kernels, _ints(args, 'strides', [1, 1, 1]),
+            _ints(args, 'pads', [0] * 6))
+
+
+def _readers(ops, start, blob):
+    """The indices of the ops after start that read blob, up to the first
+    one that writes it again."""
+    readers = []
+    for j in range(start + 1, len(ops)):
+        if blob in ops[j].input:
+            readers.append(j)
+        if blob in ops[j].output:
+            break
+    return readers
+
+
+def _only_reader(ops, start, blob, outputs):
+    readers = _readers(ops, start, blob)
+    if len(readers) != 1 or blob in outputs:
+        return None
+    return readers[0]
+
+
+def _affine(op, params):
+    """The scale and bias blobs of a frozen BN op, whether it has the relu,
+    and the new params that fold a SpatialBN into a scale and bias, or
+    None."""
+    if op.type == 'AffineNd':
+        return op.input[1], op.input[2], False, {}
+    args = _args(op)
+    if op.type not in ('SpatialBN', 'SpatialBNRelu') or \
+            len(op.input) != 5 or 'is_test' not in args or \
+            not args['is_test'].i or \
+            any(blob not in params for blob in op.input[1:]):
+        return None
+    epsilon = args['epsilon'].f if 'epsilon' in args else 1e-5
+    gamma, beta, mean, var = [params[blob] for blob in op.input[1:]]
+    scale = gamma / np.sqrt(var + epsilon)
+    prefix = op.input[1][:-len('_s')] if op.input[1].endswith('_s') \
+        else op.input[1]
+    folded = {
+        prefix + '_folded_s': scale.astype(np.float32),
+        prefix + '_folded_b': (beta - mean * scale).astype(np.float32)}
+    return prefix + '_folded_s', prefix + '_folded_b', \
+        op.type == 'SpatialBNRelu', folded
+
+
+def _match(ops, i, params, outputs):
+    """The indices of the ops of the pattern starting at the temporal conv
+    ops[i], the Conv2Plus1D op that replaces them and its new params, or
+    None."""
+    temporal = _conv_geometry(ops[i])
+    if temporal is None or len(ops[i].input) != 2:
+        return None
+    kernels, strides, pads = temporal
+    if kernels[1:] != [1, 1] or strides[1:] != [1, 1] or \
+            pads[1:3] + pads[4:] != [0] * 4 or pads[0] != pads[3]:
+        return None
+    j = _only_reader(ops, i, ops[i].output[0], outputs)
+    if j is None:
+        return None
+    affine = _affine(ops[j], params)
+    if affine is None:
+        return None
+    scale, bias, has_relu, folded = affine
+    matched = [i, j]
+    mid = ops[j].output[0]
+    if not has_relu:
+        k = _only_reader(ops, j, mid, outputs)
+        if k is None or ops[k].type != 'Relu':
+            return None
+        matched.append(k)
+        mid = ops[k].output[0]
+    last = _only_reader(ops, matched[-1], mid, outputs)
+    spatial = None if last is None else _conv_geometry(ops[last])
+    if spatial is None or ops[last].input[0] != mid:
+        return None
+    spatial_kernels, spatial_strides, spatial_pads = spatial
+    if spatial_kernels[0] != 1 or spatial_strides[0] != 1 or \
+            spatial_pads[0] != 0 or spatial_pads[3] != 0:
+        return None
+    matched.append(last)
+    fused = core.CreateOperator(
+        'Conv2Plus1D',
+        [ops[i].input[0], ops[i].input[1], scale, bias] +
+        list(ops[last].input[1:]),
+        [ops[last].output[0]],
+        temporal_stride=strides[0],
+        temporal_pad=pads[0],
+        spatial_strides=spatial_strides[1:],
+        spatial_pads=spatial_pads[1:3] + spatial_pads[4:],
+        relu=1)
+    return matched, fused, folded
+
+
+def fuse_conv2plus1d(predict_net, params):
+    """Rewrites the (2+1)D patterns of predict_net, an inference net (e.g. of
+    onnx_export.inference_net), in place, and adds the folded BN params to
+    and drops the unused ones from params, a dict of blob -> array."""
+    ops = list(predict_net.op)
+    outputs = set(predict_net.external_output)
+    fused_at = {}
+    removed = set()
+    for i in range(len(ops)):
+        if i in removed:
+            continue
+        match = _match(ops, i, params, outputs)
+        if match is None:
+            continue
+        matched, fused, folded = match
+        params.update(folded)
+        removed.update(matched)
+        fused_at[matched[-1]] = fused
+    if not fused_at:
+        return predict_net, params
+    new_ops = [
+        fused_at[i] if i in fused_at else op
+        for i, op in enumerate(ops) if i not in removed or i in fused_at]
+    del predict_net.op[:]
+    predict_net.op.extend(new_ops)
+    read = set(blob for op in new_ops for blob in op.input)
+    params = dict(
+        (name, value) for name, value in params.items() if name in read)
+    inputs = [blob for blob in predict_net.external_input
+              if blob in read and blob not in params] + sorted(params.keys())
+    del predict_net.external_input[:]
+    predict_net.external_input.extend(inputs)
+    logger.info('Fused {} (2+1)D convs into Conv2Plus1D ops'.format(
+        len(fused_at)))
+    return predict_net, params
@@ -31,7 +31,8 @@ import datetime
 import logging
 
 from core.config import config as cfg
-from caffe2.python import workspace
+from caffe2.proto import caffe2_pb2
+from caffe2.python import core, workspace
 
 import utils.misc as misc
 
@@ -40,15 +41,26 @@ logger = logging.getLogger(__name__)
 
 class MetricsCalculator():
 
-    def __init__(self, model, split):
+    def __init__(self, model, split, gpus=None, prefix=''):
         self.model = model
         self.split = split  # 'train', 'val', 'test'
+        # the gpus of the net and the prefix of its blob names, other than
+        # the ones of the config for the concurrent evaluation, see
+        # utils/async_eval.py
+        self.gpus = default_gpus() if gpus is None else list(gpus)
+        self.prefix = prefix
         self.best_top1 = float('inf')
         self.best_top5 = float('inf')
         self.lr = 0  # only used by train
         if cfg.METRICS.EVAL_FIRST_N and split in ['test', 'val']:
             self.best_top1_N_way = float('inf')
             self.best_top5_N_way = float('inf')
+        self.on_device = metrics_on_device(split)
+        if self.on_device:
+            self.reduce_net = create_metrics_reduce_net(
+                split, self.gpus, prefix)
+            # the iterations the gpus counted since the last fetch
+            self.device_iters = 0
         self.reset()
 
     def reset(self):
@@ -64,6 +76,8 @@ class MetricsCalculator():
             self.aggr_err5_N_way = 0.0
 
     def finalize_metrics(self):
+        if self.on_device and self.device_iters > 0:
+            self.fetch_device_metrics()
         self.avg_err = self.aggr_err / self.aggr_batch_size
         self.avg_err5 = self.aggr_err5 / self.aggr_batch_size
         self.avg_loss = self.aggr_loss / self.aggr_batch_size
@@ -121,14 +135,25 @@ class MetricsCalculator():
                         .format(self.best_top1_N_way, self.best_top5_N_way))
 
     def calculate_and_log_all_metrics_train(
-            self, curr_iter, timer):
+            self, curr_iter, timer, num_iters=1):
+        """Logs the metrics of the num_iters iterations ending at curr_iter,
+        or, on the device, those since the last log.
+        """
+        if self.on_device:
+            self.device_iters += num_iters
+            if (curr_iter + 1) % cfg.LOG_PERIOD == 0:
+                interval = self.fetch_device_metrics()
+                self.log_train(
+                    curr_iter, timer, interval['loss'], interval['err'],
+                    interval['err5'])
+            return
 
         # as sanity check, we always read lr from workspace
         self.lr = float(
             workspace.FetchBlob('gpu_{}/lr'.format(cfg.ROOT_GPU_ID)))
 
         # as sanity, we only trust what we loaded from workspace
-        cur_batch_size = get_batch_size_from_workspace()
+        cur_batch_size = get_batch_size_from_workspace(self.gpus, self.prefix)
 
         # we only compute loss for train
         cur_loss = sum_multi_gpu_blob('loss')
@@ -137,9 +162,9 @@ class MetricsCalculator():
         self.aggr_batch_size += cur_batch_size
 
         accuracy_metrics = compute_multi_gpu_topk_accuracy(
-            top_k=1, split=self.split)
+            top_k=1, split=self.split, gpus=self.gpus, prefix=self.prefix)
         accuracy5_metrics = compute_multi_gpu_topk_accuracy(
-            top_k=5, split=self.split)
+            top_k=5, split=self.split, gpus=self.gpus, prefix=self.prefix)
 
         cur_err = (1.0 - accuracy_metrics['topk_accuracy']) * 100
         cur_err5 = (1.0 - accuracy5_metrics['topk_accuracy']) * 100
@@ -147,6 +172,39 @@ class MetricsCalculator():
         self.aggr_err += cur_err * cur_batch_size
         self.aggr_err5 += cur_err5 * cur_batch_size
 
+        self.log_train(curr_iter, timer, cur_loss, cur_err, cur_err5)
+
+    def fetch_device_metrics(self):
+        """Adds the hits and the losses that the gpus counted since the last
+        fetch (see model_builder_video.add_metric_counts) to the aggregated
+        metrics, and returns the metrics of those iterations.
+        """
+        workspace.RunNet(self.reduce_net.Proto().name)
+        root = '{}gpu_{}/'.format(self.prefix, self.gpus[0])
+        # the hits of every k of TOP_K, the N-way ones, and the batch size
+        counts = workspace.FetchBlob(root + 'topk_counts_all')
+        batch_size = float(counts[-1])
+        errs = [(1.0 - hits / batch_size) * 100 for hits in counts[:-1]]
+        interval = {
+            'err': errs[0], 'err5': errs[1], 'batch_size': int(batch_size)}
+        self.aggr_err += errs[0] * batch_size
+        self.aggr_err5 += errs[1] * batch_size
+        if eval_first_n(self.split):
+            interval['err_N_way'], interval['err5_N_way'] = errs[2:4]
+            self.aggr_err_N_way += errs[2] * batch_size
+            self.aggr_err5_N_way += errs[3] * batch_size
+        if self.split == 'train':
+            self.lr = float(workspace.FetchBlob(root + 'lr'))
+            # summed over the gpus, per micro-batch of an iteration
+            interval['loss'] = float(
+                workspace.FetchBlob(root + 'loss_sum_all')) / (
+                    self.device_iters * cfg.TRAIN.MICRO_BATCHES)
+            self.aggr_loss += interval['loss'] * batch_size
+        self.aggr_batch_size += batch_size
+        self.device_iters = 0
+        return interval
+
+    def log_train(self, curr_iter, timer, cur_loss, cur_err, cur_err5):
         if (curr_iter + 1) % cfg.LOG_PERIOD == 0:
             rem_iters = cfg.SOLVER.MAX_ITER - curr_iter - 1
             eta_seconds = timer.average_time * rem_iters
@@ -173,15 +231,28 @@ class MetricsCalculator():
 
     def calculate_and_log_all_metrics_test(self, curr_iter, timer, total_iters):
 
+        log = (curr_iter + 1) % cfg.LOG_PERIOD == 0 \
+            or curr_iter + 1 == total_iters  # we check the last iter
+        if self.on_device:
+            # the current batch is the one of the iterations since the log
+            self.device_iters += 1
+            if log:
+                interval = self.fetch_device_metrics()
+                self.log_test(
+                    curr_iter, timer, total_iters, interval['err'],
+                    interval['err5'], interval.get('err_N_way'),
+                    interval.get('err5_N_way'), interval['batch_size'])
+            return
+
         # as sanity, we only trust what we loaded from workspace
-        cur_batch_size = get_batch_size_from_workspace()
+        cur_batch_size = get_batch_size_from_workspace(self.gpus, self.prefix)
 
         self.aggr_batch_size += cur_batch_size
 
         accuracy_metrics = compute_multi_gpu_topk_accuracy(
-            top_k=1, split=self.split)
+            top_k=1, split=self.split, gpus=self.gpus, prefix=self.prefix)
         accuracy5_metrics = compute_multi_gpu_topk_accuracy(
-            top_k=5, split=self.split)
+            top_k=5, split=self.split, gpus=self.gpus, prefix=self.prefix)
 
         cur_err = (1.0 - accuracy_metrics['topk_accuracy']) * 100
         cur_err5 = (1.0 - accuracy5_metrics['topk_accuracy']) * 100
@@ -197,51 +268,108 @@ class MetricsCalculator():
                 1.0 - accuracy5_metrics['topk_N_way_accuracy']) * 100
             self.aggr_err_N_way += cur_err_N_way * cur_batch_size
             self.aggr_err5_N_way += cur_err5_N_way * cur_batch_size
+        else:
+            cur_err_N_way = cur_err5_N_way = None
 
-        if (curr_iter + 1) % cfg.LOG_PERIOD == 0 \
-                or curr_iter + 1 == total_iters:  # we check the last iter
+        if log:
+            self.log_test(
+                curr_iter, timer, total_iters, cur_err, cur_err5,
+                cur_err_N_way, cur_err5_N_way, cur_batch_size)
 
-            if cfg.METRICS.EVAL_FIRST_N:
-                test_str = ' '.join((
-                    '| Test: [{}/{}]',
-                    ' Time {:0.3f}',
-                    ' top1 {:7.3f} ({:7.3f})',
-                    ' top5 {:7.3f} ({:7.3f})'
-                    ' top1_N_way {:7.3f} ({:7.3f})',
-                    ' top5_N_way {:7.3f} ({:7.3f})',
-                    ' current batch {}',
-                    ' aggregated batch {}',
-                ))
-                print(test_str.format(
-                    curr_iter + 1, total_iters,
-                    timer.diff,
-                    cur_err, self.aggr_err / self.aggr_batch_size,
-                    cur_err5, self.aggr_err5 / self.aggr_batch_size,
-                    cur_err_N_way, self.aggr_err_N_way / self.aggr_batch_size,
-                    cur_err5_N_way, self.aggr_err5_N_way / self.aggr_batch_size,
-                    cur_batch_size, self.aggr_batch_size
-                ))
-            else:
-                test_str = ' '.join((
-                    '| Test: [{}/{}]',
-                    ' Time {:0.3f}',
-                    ' top1 {:7.3f} ({:7.3f})',
-                    ' top5 {:7.3f} ({:7.3f})',
-                    ' current batch {}',
-                    ' aggregated batch {}',
-                ))
-                print(test_str.format(
-                    curr_iter + 1, total_iters,
-                    timer.diff,
-                    cur_err, self.aggr_err / self.aggr_batch_size,
-                    cur_err5, self.aggr_err5 / self.aggr_batch_size,
-                    cur_batch_size, self.aggr_batch_size
-                ))
+    def log_test(
+            self, curr_iter, timer, total_iters, cur_err, cur_err5,
+            cur_err_N_way, cur_err5_N_way, cur_batch_size):
+        if cfg.METRICS.EVAL_FIRST_N:
+            test_str = ' '.join((
+                '| Test: [{}/{}]',
+                ' Time {:0.3f}',
+                ' top1 {:7.3f} ({:7.3f})',
+                ' top5 {:7.3f} ({:7.3f})'
+                ' top1_N_way {:7.3f} ({:7.3f})',
+                ' top5_N_way {:7.3f} ({:7.3f})',
+                ' current batch {}',
+                ' aggregated batch {}',
+            ))
+            print(test_str.format(
+                curr_iter + 1, total_iters,
+                timer.diff,
+                cur_err, self.aggr_err / self.aggr_batch_size,
+                cur_err5, self.aggr_err5 / self.aggr_batch_size,
+                cur_err_N_way, self.aggr_err_N_way / self.aggr_batch_size,
+                cur_err5_N_way, self.aggr_err5_N_way / self.aggr_batch_size,
+                cur_batch_size, self.aggr_batch_size
+            ))
+        else:
+            test_str = ' '.join((
+                '| Test: [{}/{}]',
+                ' Time {:0.3f}',
+                ' top1 {:7.3f} ({:7.3f})',
+                ' top5 {:7.3f} ({:7.3f})',
+                ' current batch {}',
+                ' aggregated batch {}',
+            ))
+            print(test_str.format(
+                curr_iter + 1, total_iters,
+                timer.diff,
+                cur_err, self.aggr_err / self.aggr_batch_size,
+                cur_err5, self.aggr_err5 / self.aggr_batch_size,
+                cur_batch_size, self.aggr_batch_size
+            ))
 
 
 # ----------------------------------------------
 # other utils
 # ----------------------------------------------
+# the ks of the hits that the gpus count, see metrics_on_device
+TOP_K = [1, 5]
+
+
+def default_gpus():
+    return range(cfg.ROOT_GPU_ID, cfg.ROOT_GPU_ID + cfg.NUM_GPUS)
+
+
+def metrics_on_device(split):
+    """Whether the nets of split count the hits and sum the loss on the gpus,
+    see model_builder_video.add_metric_counts."""
+    return cfg.METRICS.ON_DEVICE or (
+        split == 'train' and cfg.TRAIN.ITERS_PER_RUN > 1)
+
+
+def eval_first_n(split):
+    return cfg.METRICS.EVAL_FIRST_N and split in ['test', 'val']
+
+
+def num_topk_counts(split):
+    """The hits of every k of TOP_K, those of the first METRICS.FIRST_N
+    classes with eval_first_n, and the batch size."""
+    return len(TOP_K) * (2 if eval_first_n(split) else 1) + 1
+
+
+def create_metrics_reduce_net(split, gpus=None, prefix=''):
+    """Sums the counts of all the gpus into <name>_all on the root gpu, the
+    only blobs fetched, and sets the ones of the gpus back to 0."""
+    net = core.Net('{}{}_metrics_reduce'.format(
+        prefix.replace('/', '_'), split))
+    gpus = default_gpus() if gpus is None else list(gpus)
+    root_gpu_id = gpus[0]
+    names = ['topk_counts'] + (['loss_sum'] if split == 'train' else [])
+    for name in names:
+        with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, root_gpu_id)):
+            blobs = [
+                net.Copy(
+                    '{}gpu_{}/{}'.format(prefix, i, name),
+                    '{}gpu_{}/{}_gpu_{}'.format(prefix, root_gpu_id, name, i))
+                if i != root_gpu_id else '{}gpu_{}/{}'.format(prefix, i, name)
+                for i in gpus]
+            net.Sum(blobs, '{}gpu_{}/{}_all'.format(prefix, root_gpu_id, name))
+        for i in gpus:
+            with core.DeviceScope(core.DeviceOption(caffe2_pb2.CUDA, i)):
+                blob = '{}gpu_{}/{}'.format(prefix, i, name)
+                net.ConstantFill(blob, blob, value=0.0)
+    workspace.CreateNet(net)
+    return net
+
+
 def compute_topk_correct_hits(top_k, preds, labels):
     '''Compute the number of corret hits'''
     batch_size = preds.shape[0]
@@ -259,7 +387,7 @@ def compute_topk_correct_hits(top_k, preds, labels):
     return correct_hits
 
 
-def compute_multi_gpu_topk_accuracy(top_k, split):
+def compute_multi_gpu_topk_accuracy(top_k, split, gpus=None, prefix=''):
 
     aggr_batch_size = 0
     aggr_top_k_correct_hits = 0
@@ -269,12 +397,12 @@ def compute_multi_gpu_topk_accuracy(top_k, split):
 
     computed_metrics = {}
 
-    for idx in range(cfg.ROOT_GPU_ID, cfg.ROOT_GPU_ID + cfg.NUM_GPUS):
+    for idx in default_gpus() if gpus is None else gpus:
 
-        softmax = workspace.FetchBlob('gpu_{}/pred'.format(idx))
+        softmax = workspace.FetchBlob('{}gpu_{}/pred'.format(prefix, idx))
         # remove the last two dimensions if we use conv as the output fc
         softmax = softmax.reshape((softmax.shape[0], -1))
-        labels = workspace.FetchBlob('gpu_{}/labels'.format(idx))
+        labels = workspace.FetchBlob('{}gpu_{}/labels'.format(prefix, idx))
 
         assert labels.shape[0] == softmax.shape[0], "Batch size mismatch."
 
@@ -306,13 +434,12 @@ def sum_multi_gpu_blob(blob_name):
     return value
 
 
-def get_batch_size_from_workspace():
+def get_batch_size_from_workspace(gpus=None, prefix=''):
     """Summed values of batch size on each gpu"""
     value = 0
-    num_gpus = cfg.NUM_GPUS
-    root_gpu_id = cfg.ROOT_GPU_ID
-    for idx in range(root_gpu_id, root_gpu_id + num_gpus):
-        value += workspace.FetchBlob('gpu_{}/{}'.format(idx, 'pred')).shape[0]
+    for idx in default_gpus() if gpus is None else gpus:
+        value += workspace.FetchBlob(
+            '{}gpu_{}/{}'.format(prefix, idx, 'softmax')).shape[0]
     return value
 
 
@@ -33,17 +33,146 @@ import math
 import numpy as np
 import subprocess
 # import fbcaffe2.tensorboard as tb
-from caffe2.python import workspace, scope
+from caffe2.python import workspace, scope, utils
+from caffe2.proto import caffe2_pb2
 from core.config import config as cfg
 
 logger = logging.getLogger(__name__)
 
 
-def check_nan_losses():
+def global_init():
+    """Initializes caffe2 with the flags that the config asks for."""
+    init_args = ['caffe2', '--caffe2_log_level=0']
+    if cfg.CUDNN_ALGO_CACHE_FILE:
+        init_args.append(
+            '--caffe2_cudnn_algo_cache_file=' + cfg.CUDNN_ALGO_CACHE_FILE)
+    if cfg.CUDNN_WORKSPACE_BUDGET > 0:
+        init_args.append(
+            '--caffe2_cudnn_ws_budget_mb={}'.format(cfg.CUDNN_WORKSPACE_BUDGET))
+    if cfg.CUDNN_WORKSPACE_RESERVE >= 0:
+        init_args.append(
+            '--caffe2_cudnn_ws_reserve_mb={}'.format(
+                cfg.CUDNN_WORKSPACE_RESERVE))
+    if cfg.CUDA_RTC_CACHE_DIR:
+        init_args.append(
+            '--caffe2_cuda_rtc_cache_dir=' + cfg.CUDA_RTC_CACHE_DIR)
+    if cfg.NET_STREAMS > 0:
+        init_args.append(
+            '--caffe2_net_async_stream_pool_size={}'.format(cfg.NET_STREAMS))
+    if cfg.CUDA_MEMORY_POOL:
+        init_args.append(
+            '--caffe2_cuda_memory_pool=' + cfg.CUDA_MEMORY_POOL)
+    if cfg.PARALLEL_NET_CREATION:
+        init_args.append('--caffe2_net_parallel_op_creation=1')
+    if cfg.CPU_BUDGET_THREADS > 0:
+        init_args.append(
+            '--caffe2_cpu_budget_threads={}'.format(cfg.CPU_BUDGET_THREADS))
+    init_args += [
+        '--caffe2_cpu_budget_decode_share={}'.format(
+            cfg.CPU_BUDGET_DECODE_SHARE),
+        '--caffe2_cpu_budget_operator_share={}'.format(
+            cfg.CPU_BUDGET_OPERATOR_SHARE)]
+    if cfg.CPU_PARALLEL_FOR:
+        init_args.append('--caffe2_cpu_parallel_for=1')
+    if cfg.TRAIN.ASYNC_EVAL and cfg.TRAIN.ASYNC_EVAL_GPU < 0:
+        init_args.append('--caffe2_cuda_low_priority_stream_base={}'.format(
+            ASYNC_EVAL_STREAM_OFFSET))
+    workspace.GlobalInit(init_args)
+
+
+# the first stream of the test net of TRAIN.ASYNC_EVAL on the training gpus,
+# above those of the train net (NET_STREAMS); created with a low priority
+ASYNC_EVAL_STREAM_OFFSET = 32
+
+
+def get_net_type():
+    """The type of the train and test nets."""
+    if cfg.PROF_DAG:
+        return 'prof_dag'
+    if cfg.NET_STREAMS > 0:
+        return 'async_scheduling'
+    if cfg.CUDA_GRAPH:
+        return 'cuda_graph'
+    if cfg.COMPILED_NET:
+        return 'compiled'
+    return 'dag'
+
+
+def set_test_tensor_growth(net):
+    """Has the tensors of the test net net grow by TEST.TENSOR_GROWTH_FACTOR
+    (caffe2 TensorGrowthPolicy); before the net is created."""
+    if cfg.TEST.TENSOR_GROWTH_FACTOR > 0:
+        net.Proto().arg.extend([utils.MakeArgument(
+            'tensor_growth_factor', cfg.TEST.TENSOR_GROWTH_FACTOR)])
+
+
+def run_param_init_net(model):
+    """Runs the param init net of model; with PARALLEL_NET_CREATION, the
+    fills of the gpus run in parallel."""
+    if cfg.PARALLEL_NET_CREATION:
+        model.param_init_net.Proto().type = 'dag'
+        model.param_init_net.Proto().num_workers = cfg.NUM_GPUS
+    workspace.RunNetOnce(model.param_init_net)
+
+
+def run_shared_param_init_net(model):
+    """Runs the ops of the param init net of a test model that shares the
+    blobs of the train model (TRAIN.EVAL_SHARES_TRAIN_MEMORY) whose outputs
+    the train model has not created, e.g. the reader of the test db, so that
+    the params are neither initialized again nor copied. Raises if the test
+    net reads a blob that is still missing then."""
+    init_net = caffe2_pb2.NetDef()
+    init_net.CopyFrom(model.param_init_net.Proto())
+    init_net.name += '_shared'
+    num_shared = 0
+    del init_net.op[:]
+    for op in model.param_init_net.Proto().op:
+        if all(workspace.HasBlob(b) for b in op.output):
+            num_shared += len(op.output)
+        else:
+            init_net.op.extend([op])
+    if len(init_net.op) > 0:
+        workspace.RunNetOnce(init_net)
+    logger.info('{}: shares {} blobs of the train model, initialized {}'.format(
+        model.net.Name(), num_shared,
+        sum(len(op.output) for op in init_net.op)))
+
+    missing = [b for b in model.net.Proto().external_input
+               if not workspace.HasBlob(b)]
+    assert not missing, \
+        'The shared test net reads blobs that the train net does not ' \
+        'have: {}'.format(missing[:10])
+
+
+def get_peak_gpu_memory():
+    """The peak bytes of every gpu of the caching gpu memory pool, None for
+    the other pools."""
+    if cfg.CUDA_MEMORY_POOL != 'caching':
+        return None
+    return [workspace.GetCUDAMemoryStats(cfg.ROOT_GPU_ID + i)[
+        'peak_allocated_bytes'] for i in range(cfg.NUM_GPUS)]
+
+
+def check_peak_gpu_memory(peak_before, what):
+    """Warns if the peak gpu memory grew since get_peak_gpu_memory returned
+    peak_before, e.g. while testing on a net that shares the memory of the
+    train net."""
+    if peak_before is None:
+        return
+    for i, (before, after) in enumerate(
+            zip(peak_before, get_peak_gpu_memory())):
+        if after > before:
+            logger.warning(
+                '{} raised the peak memory of GPU {} by {:.0f} MB'.format(
+                    what, cfg.ROOT_GPU_ID + i, (after - before) / 1024. ** 2))
+
+
+def check_nan_losses(loss_name='loss'):
     num_gpus = cfg.NUM_GPUS
     # if any of the losses is NaN, raise exception
     for idx in range(num_gpus):
-        loss = workspace.FetchBlob('gpu_{}/loss'.format(idx + cfg.ROOT_GPU_ID))
+        loss = workspace.FetchBlob(
+            'gpu_{}/{}'.format(idx + cfg.ROOT_GPU_ID, loss_name))
         if math.isnan(loss):
             logger.error("ERROR: NaN losses on gpu_{}".format(idx))
             os._exit(0)
@@ -67,6 +196,13 @@ def get_num_test_iter(db):
     return test_epoch_iter
 
 
+def get_bn_momentum(momentum):
+    """The momentum of the running BN statistics, per micro-batch with
+    TRAIN.MICRO_BATCHES, so that they average over as many clips as with
+    whole batches."""
+    return momentum ** (1.0 / cfg.TRAIN.MICRO_BATCHES)
+
+
 def get_batch_size(split):
     if split in ['test', 'val']:
         if cfg.TEST.TEN_CROP:
@@ -77,7 +213,7 @@ def get_batch_size(split):
         return batch_size
     elif split == 'train':
         batch_size = int(
-            cfg.TRAIN.BATCH_SIZE / cfg.NUM_GPUS
+            cfg.TRAIN.BATCH_SIZE / cfg.NUM_GPUS / cfg.TRAIN.MICRO_BATCHES
         )
         return batch_size
 
@@ -201,6 +337,25 @@ def get_gpu_stats():
     return used_gpu_memory
 
 
+def log_cuda_memory_stats():
+    """Logs the allocated, cached and peak MB and the fragmentation of the
+    caching gpu memory pool, e.g. to size the clips of a fully convolutional
+    test; a no-op for the other pools."""
+    if cfg.CUDA_MEMORY_POOL != 'caching':
+        return
+    for i in range(cfg.NUM_GPUS):
+        gpu = cfg.ROOT_GPU_ID + i
+        stats = workspace.GetCUDAMemoryStats(gpu)
+        logger.info(
+            ('GPU {}: {:.0f} MB allocated (peak {:.0f} MB), {:.0f} MB cached '
+             '(peak {:.0f} MB), fragmentation {:.2f}, {} cudaMallocs').format(
+                gpu, stats['allocated_bytes'] / 1024. ** 2,
+                stats['peak_allocated_bytes'] / 1024. ** 2,
+                stats['cached_bytes'] / 1024. ** 2,
+                stats['peak_cached_bytes'] / 1024. ** 2,
+                stats['fragmentation'], stats['num_raw_allocs']))
+
+
 def show_flops_params(model):
     model_flops, model_params = get_flops_params(model)
     logger.info('Total conv/fc/matMul FLOPs: {}(e9)'.format(model_flops / 1e9))
@@ -0,0 +1,94 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+
+"""ONNX export of the test net, e.g. for TensorRT.
+
+The test net reads its clips through CustomizedVideoInput and ends in the
+loss and accuracy ops; the exported graph is only the ops between a clean
+'data' input (N x C x T x H x W) and TEST.OUTPUT_NAME, on CPU, with the
+params of the current workspace as its initializers.
+"""
+
+from __future__ import print_function
+from __future__ import unicode_literals
+from __future__ import division
+from __future__ import absolute_import
+
+import logging
+
+from caffe2.python import core, workspace
+from caffe2.proto import caffe2_pb2
+
+import utils.quantization as quantization
+
+logger = logging.getLogger(__name__)
+
+# ops that only feed or guard the input of the test net
+INPUT_TYPES = ('CustomizedVideoInput', 'SyntheticVideoInput', 'StopGradient')
+
+
+def inference_net(net, input_blob, output_blob, prefix='gpu_0/'):
+    """Returns the CPU predict net of net from input_blob to output_blob and
+    a dict of its params, read from the current workspace. The blob names
+    lose prefix."""
+    net = net.Proto() if isinstance(net, core.Net) else net
+    # the ops output_blob depends on, back to the input
+    needed = {output_blob}
+    ops = []
+    for op in reversed(net.op):
+        if op.type in INPUT_TYPES or not needed.intersection(op.output):
+            continue
+        ops.append(op)
+        needed.update(op.input)
+    ops.reverse()
+
+    predict_net = caffe2_pb2.NetDef()
+    predict_net.name = quantization.strip_prefix(net.name, prefix)
+    written = set()
+    params = {}
+    for op in ops:
+        new_op = caffe2_pb2.OperatorDef()
+        new_op.CopyFrom(op)
+        new_op.ClearField('device_option')
+        new_op.ClearField('engine')
+        del new_op.arg[:]
+        new_op.arg.extend(quantization._copy_args(op))
+        new_op.input[:] = [
+            quantization.strip_prefix(blob, prefix) for blob in op.input]
+        new_op.output[:] = [
+            quantization.strip_prefix(blob, prefix) for blob in op.output]
+        for blob, name in zip(op.input, new_op.input):
+            if blob != input_blob and name not in written and \
+                    name not in params:
+                params[name] = workspace.FetchBlob(blob)
+        written.update(new_op.output)
+        predict_net.op.extend([new_op])
+    predict_net.external_input.extend(
+        [quantization.strip_prefix(input_blob, prefix)] +
+        sorted(params.keys()))
+    predict_net.external_output.extend(
+        [quantization.strip_prefix(output_blob, prefix)])
+    logger.info('Inference net has {} of the {} ops'.format(
+        len(predict_net.op), len(net.op)))
+    return predict_net, params
+
+
+def export_onnx_model(predict_net, params, input_shape):
+    """The ONNX model of a net from inference_net, taking its input of
+    input_shape as float."""
+    # imported here, as only the export needs the onnx package
+    import onnx
+    import caffe2.python.onnx.frontend as c2_onnx
+
+    init_net = quantization.make_init_net(
+        params, predict_net.name + '_init')
+    return c2_onnx.caffe2_net_to_onnx_model(
+        predict_net=predict_net,
+        init_net=init_net,
+        value_info={
+            predict_net.external_input[0]:
+                (onnx.TensorProto.FLOAT, tuple(input_shape))})
@@ -0,0 +1,312 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+
+"""Post-training int8 quantization of the test net.
+
+The activations are uint8 with a per-blob scale and zero point that come
+from the ranges seen on calibration batches, the conv weights are int8 with
+a scale per output channel and the biases stay float. Conv (+ Relu), Sum
+(+ Relu) and the pools are rewritten to the Int8 ops of caffe2/video; every
+other op, e.g. the non-local affinity and softmax and the classifier, stays
+fp32 behind an Int8Dequantize.
+"""
+
+from __future__ import print_function
+from __future__ import unicode_literals
+from __future__ import division
+from __future__ import absolute_import
+
+import numpy as np
+import logging
+from collections import defaultdict
+
+from caffe2.python import workspace, core, utils
+from caffe2.proto import caffe2_pb2
+
+logger = logging.getLogger(__name__)
+
+QUANTIZED_TYPES = ('Conv', 'Relu', 'Sum', 'SumRelu', 'MaxPool', 'AveragePool')
+# args of the float ops that only mean something to their CUDA engines
+ENGINE_ARGS = ('exhaustive_search', 'ws_nbytes_limit', 'shared_buffer')
+
+
+def strip_prefix(name, prefix):
+    return name[len(prefix):] if name.startswith(prefix) else name
+
+
+def observed_blobs(net):
+    blobs = set()
+    for op in net.op:
+        if op.type in QUANTIZED_TYPES:
+            blobs.add(op.input[0])
+            if op.type in ('Sum', 'SumRelu'):
+                blobs.update(op.input)
+            blobs.add(op.output[0])
+    return blobs
+
+
+def collect_ranges(net, num_iters):
+    """Runs the net num_iters times and returns the (min, max) of the blobs
+    around its quantizable ops. The net must not run anything in place, or
+    the ranges of the overwritten blobs are lost."""
+    blobs = observed_blobs(net.Proto())
+    ranges = {}
+    for i in range(num_iters):
+        workspace.RunNet(net.Proto().name)
+        for blob in blobs:
+            value = workspace.FetchBlob(blob)
+            lo, hi = float(np.min(value)), float(np.max(value))
+            if blob in ranges:
+                lo = min(lo, ranges[blob][0])
+                hi = max(hi, ranges[blob][1])
+            ranges[blob] = (lo, hi)
+        logger.info('Calibration batch {}/{}'.format(i + 1, num_iters))
+    return ranges
+
+
+def choose_qparams(lo, hi):
+    """Asymmetric uint8 params whose range includes 0, so that the zero
+    padding of the convs is exact."""
+    lo, hi = min(lo, 0.), max(hi, 0.)
+    scale = (hi - lo) / 255. if hi > lo else 1.
+    zero_point = int(np.clip(np.round(-lo / scale), 0, 255))
+    return scale, zero_point
+
+
+def quantize_weights(weights):
+    """Symmetric int8 weights with one scale per output channel."""
+    flat = weights.reshape(weights.shape[0], -1)
+    scales = np.abs(flat).max(axis=1) / 127.
+    scales[scales == 0] = 1.
+    quantized = np.round(flat / scales[:, None]).clip(-127, 127)
+    return (quantized.astype(np.int8).reshape(weights.shape),
+            scales.astype(np.float32))
+
+
+def _copy_args(op):
+    return [arg for arg in op.arg if arg.name not in ENGINE_ARGS]
+
+
+class _Rewriter(object):
+    """Builds the quantized predict net and its params, in CPU tensors."""
+
+    def __init__(self, net, ranges, prefix):
+        self.ranges = ranges
+        self.prefix = prefix
+        self.net = caffe2_pb2.NetDef()
+        self.net.name = strip_prefix(net.name, prefix) + '_int8'
+        self.params = {}
+        # blob -> (scale, zero_point) of its uint8 version, blob + '_int8'
+        self.qparams = {}
+        self.float_blobs = set()
+        # blobs written by the ops of the net, i.e. not params
+        self.produced = set()
+        self.consumers = defaultdict(list)
+        for op in net.op:
+            for blob in op.input:
+                self.consumers[blob].append(op)
+
+    def name(self, blob):
+        return strip_prefix(blob, self.prefix)
+
+    def add_op(self, op_type, inputs, outputs, args=()):
+        op = core.CreateOperator(op_type, inputs, outputs)
+        op.arg.extend(args)
+        self.net.op.extend([op])
+        return op
+
+    def quantized_input(self, blob):
+        """Name of the uint8 version of blob, quantizing it if needed."""
+        if blob not in self.qparams:
+            scale, zero_point = choose_qparams(*self.ranges[blob])
+            self.add_op(
+                'Int8Quantize', [self.name(blob)], [self.name(blob) + '_int8'],
+                [utils.MakeArgument('Y_scale', scale),
+                 utils.MakeArgument('Y_zero_point', zero_point)])
+            self.qparams[blob] = (scale, zero_point)
+        return self.name(blob) + '_int8'
+
+    def float_input(self, blob):
+        """Name of the float version of blob, dequantizing it if needed."""
+        if blob not in self.float_blobs and blob in self.qparams:
+            scale, zero_point = self.qparams[blob]
+            self.add_op(
+                'Int8Dequantize',
+                [self.name(blob) + '_int8'], [self.name(blob)],
+                [utils.MakeArgument('X_scale', scale),
+                 utils.MakeArgument('X_zero_point', zero_point)])
+            self.float_blobs.add(blob)
+        return self.name(blob)
+
+    def fused_relu(self, op):
+        """The Relu that is the only consumer of the output of op, if any."""
+        consumers = self.consumers[op.output[0]]
+        if len(consumers) == 1 and consumers[0].type == 'Relu':
+            return consumers[0]
+        return None
+
+    def quantizable(self, op):
+        args = {arg.name: arg for arg in op.arg}
+        if any(blob not in self.ranges for blob in op.input[:1]):
+            return False
+        if op.type == 'Conv':
+            dilations = [args[name].i for name in
+                         ('dilation', 'dilation_h', 'dilation_w')
+                         if name in args]
+            if 'dilations' in args:
+                dilations += list(args['dilations'].ints)
+            return all(d == 1 for d in dilations) and workspace.HasBlob(
+                op.input[1])
+        if op.type in ('Sum', 'SumRelu'):
+            return len(op.input) == 2 and all(
+                blob in self.ranges for blob in op.input)
+        if op.type in ('MaxPool', 'AveragePool'):
+            # the uint8 pools take plain kernels and no global pooling
+            return 'global_pooling' not in args and op.input[0] in self.qparams
+        return False
+
+    def output_qparams(self, op, relu):
+        out = relu.output[0] if relu is not None else op.output[0]
+        scale, zero_point = choose_qparams(*self.ranges[out])
+        self.qparams[out] = (scale, zero_point)
+        return out, scale, zero_point
+
+    def rewrite_conv(self, op, relu):
+        X = self.quantized_input(op.input[0])
+        X_scale, X_zero_point = self.qparams[op.input[0]]
+        out, scale, zero_point = self.output_qparams(op, relu)
+        weights = workspace.FetchBlob(op.input[1])
+        W, W_scale = quantize_weights(weights)
+        if len(op.input) > 2:
+            b = workspace.FetchBlob(op.input[2]).astype(np.float32)
+        else:
+            b = np.zeros(weights.shape[0], dtype=np.float32)
+        name = self.name(op.input[1])
+        self.params[name + '_int8'] = W
+        self.params[name + '_int8_scale'] = W_scale
+        self.params[name + '_int8_b'] = b
+        self.add_op(
+            'Int8ConvNd',
+            [X, name + '_int8', name + '_int8_scale', name + '_int8_b'],
+            [self.name(out) + '_int8'],
+            _copy_args(op) + [
+                utils.MakeArgument('X_scale', X_scale),
+                utils.MakeArgument('X_zero_point', X_zero_point),
+                utils.MakeArgument('Y_scale', scale),
+                utils.MakeArgument('Y_zero_point', zero_point),
+                utils.MakeArgument('relu', int(relu is not None))])
+
+    def rewrite_sum(self, op, relu):
+        A = self.quantized_input(op.input[0])
+        B = self.quantized_input(op.input[1])
+        A_scale, A_zero_point = self.qparams[op.input[0]]
+        B_scale, B_zero_point = self.qparams[op.input[1]]
+        out, scale, zero_point = self.output_qparams(op, relu)
+        self.add_op(
+            'Int8SumRelu', [A, B], [self.name(out) + '_int8'],
+            [utils.MakeArgument('A_scale', A_scale),
+             utils.MakeArgument('A_zero_point', A_zero_point),
+             utils.MakeArgument('B_scale', B_scale),
+             utils.MakeArgument('B_zero_point', B_zero_point),
+             utils.MakeArgument('Y_scale', scale),
+             utils.MakeArgument('Y_zero_point', zero_point),
+             utils.MakeArgument(
+                 'relu', int(relu is not None or op.type == 'SumRelu'))])
+
+    def rewrite_pool(self, op):
+        # the pools keep the params of their input
+        self.qparams[op.output[0]] = self.qparams[op.input[0]]
+        self.add_op(
+            'Int8' + op.type, [self.quantized_input(op.input[0])],
+            [self.name(op.output[0]) + '_int8'], _copy_args(op))
+
+    def rewrite(self, ops):
+        fused = set()
+        for op in ops:
+            if id(op) in fused:
+                continue
+            if self.quantizable(op):
+                relu = None
+                if op.type in ('Conv', 'Sum'):
+                    relu = self.fused_relu(op)
+                    if relu is not None:
+                        fused.add(id(relu))
+                if op.type == 'Conv':
+                    self.rewrite_conv(op, relu)
+                elif op.type in ('Sum', 'SumRelu'):
+                    self.rewrite_sum(op, relu)
+                else:
+                    self.rewrite_pool(op)
+                continue
+            new_op = self.add_op(
+                op.type, [self.float_input(blob) for blob in op.input],
+                [self.name(blob) for blob in op.output], _copy_args(op))
+            new_op.name = op.name
+            for blob in op.input:
+                if blob not in self.produced and workspace.HasBlob(blob):
+                    self.params[self.name(blob)] = workspace.FetchBlob(blob)
+            for blob in op.output:
+                self.float_blobs.add(blob)
+                self.qparams.pop(blob, None)
+            self.produced.update(op.output)
+
+    def run(self, net, input_blob, output_blob):
+        self.produced.add(input_blob)
+        self.float_blobs.add(input_blob)
+        self.rewrite(net.op)
+        self.float_input(output_blob)
+        self.net.external_input.extend(
+            [self.name(input_blob)] + sorted(self.params.keys()))
+        self.net.external_output.extend([self.name(output_blob)])
+        return self.net, self.params
+
+
+def quantize_net(net, ranges, input_blob, output_blob, prefix='gpu_0/',
+                 skip_types=('CustomizedVideoInput', 'StopGradient')):
+    """Returns the quantized CPU predict net of net, from input_blob to
+    output_blob, and a dict of its params. The params of net are read from
+    the current workspace; the blob names lose prefix."""
+    net = net.Proto() if isinstance(net, core.Net) else net
+    ops = [op for op in net.op if op.type not in skip_types]
+    source = caffe2_pb2.NetDef()
+    source.CopyFrom(net)
+    del source.op[:]
+    source.op.extend(ops)
+    rewriter = _Rewriter(source, ranges, prefix)
+    quantized, params = rewriter.run(source, input_blob, output_blob)
+    num_int8 = len([op for op in quantized.op if op.type.startswith('Int8')])
+    logger.info('Quantized net has {} ops, {} of them int8'.format(
+        len(quantized.op), num_int8))
+    return quantized, params
+
+
+def make_init_net(params, name):
+    """Fill ops for params; int8 tensors go through an int32 fill and a
+    Cast, as there is no int8 GivenTensorFill."""
+    init_net = caffe2_pb2.NetDef()
+    init_net.name = name
+    for blob, value in sorted(params.items()):
+        if value.dtype == np.int8:
+            ops = [
+                core.CreateOperator(
+                    'GivenTensorIntFill', [], [blob + '_int32'],
+                    arg=[utils.MakeArgument('shape', value.shape),
+                         utils.MakeArgument(
+                             'values', value.astype(np.int32).flatten())]),
+                core.CreateOperator(
+                    'Cast', [blob + '_int32'], [blob],
+                    to=caffe2_pb2.TensorProto.INT8),
+            ]
+        else:
+            fill = 'GivenTensorIntFill' if value.dtype == np.int32 \
+                else 'GivenTensorFill'
+            ops = [core.CreateOperator(
+                fill, [], [blob],
+                arg=[utils.MakeArgument('shape', value.shape),
+                     utils.MakeArgument('values', value.flatten())])]
+        init_net.op.extend(ops)
+    return init_net
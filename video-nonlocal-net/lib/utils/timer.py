@@ -53,10 +53,13 @@ class Timer(object):
     def tic(self):
         self.start_time = time.time()
 
-    def toc(self, average=False):
-        self.diff = time.time() - self.start_time
-        self.calls += 1
-        self.total_time += self.diff
+    def toc(self, average=False, calls=1):
+        """calls is the number of calls timed since tic(); diff is the time
+        of one of them."""
+        elapsed = time.time() - self.start_time
+        self.diff = elapsed / calls
+        self.calls += calls
+        self.total_time += elapsed
         self.average_time = self.total_time / self.calls
         if average:
             return self.average_time
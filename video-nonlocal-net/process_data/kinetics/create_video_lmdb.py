@@ -12,18 +12,48 @@ from __future__ import unicode_literals
 import sys
 import lmdb
 import random
+import struct
 import argparse
 
 from caffe2.proto import caffe2_pb2
 from caffe2.python import workspace
 
+from create_video_meta_index import probe_video_meta
+
 # this tool allows to create an lmdb database of videos
 # which can be loaded from caffe2 VideoInputOp
 # INPUT: a list_file contains a list of videos and their labels
 # OUTPUT: an lmdb database of videos
 
 
-def create_an_lmdb_database(list_file, output_file, use_local_file=True):
+def serialize_header_record(
+    video_data, labels, start_frm=-1, spatial_pos=-1, meta=None
+):
+    """
+    The fixed-layout record of caffe2/video/video_record.h, which the input
+    op reads without protobuf: "VREC", int32 num_labels, start_frm and
+    spatial_pos, the labels, then the video (or its path). With meta (see
+    probe_video_meta) the record is a "VRMF" one, which also carries the
+    frame count, fps, frame size and key frame indices of the video.
+    """
+    if not isinstance(video_data, bytes):
+        video_data = video_data.encode('utf-8')
+    if meta is None:
+        return b'VREC' + struct.pack(
+            '<iii{}i'.format(len(labels)),
+            len(labels), start_frm, spatial_pos, *labels) + video_data
+    key_frames = meta['key_frames']
+    return b'VRMF' + struct.pack(
+        '<iiiifiii{}i{}i'.format(len(labels), len(key_frames)),
+        len(labels), start_frm, spatial_pos, meta['num_frames'],
+        meta['fps'], meta['width'], meta['height'], len(key_frames),
+        *(labels + key_frames)) + video_data
+
+
+def create_an_lmdb_database(
+    list_file, output_file, use_local_file=True, header_records=False,
+    with_meta=False
+):
     print("Write video to a lmdb...")
     LMDB_MAP_SIZE = 1 << 40   # MODIFY
     env = lmdb.open(output_file, map_size=LMDB_MAP_SIZE)
@@ -63,6 +93,22 @@ def create_an_lmdb_database(list_file, output_file, use_local_file=True):
             if i % 100000 == 0:
                 print(i)
 
+            if header_records:
+                labels = [
+                    int(label)
+                    for label in list_label_strings[list_idx[i]].split(',')]
+                meta = None
+                if with_meta:
+                    meta = probe_video_meta(list_file_name[list_idx[i]])
+                nowindex = '%09d' % index
+                txn.put(
+                    nowindex.encode('ascii'),
+                    serialize_header_record(video_data, labels, meta=meta)
+                )
+                index = index + 1
+                total_size = total_size + len(video_data) + sys.getsizeof(int)
+                continue
+
             tensor_protos = caffe2_pb2.TensorProtos()
             video_tensor = tensor_protos.protos.add()
             video_tensor.data_type = 4  # string data
@@ -106,8 +152,18 @@ def main():
                         help="List file pointing to videos and labels",
                         required=True)
 
+    parser.add_argument("--header_records", action="store_true",
+                        help="Write fixed-layout records that the input op "
+                        "reads without protobuf")
+    parser.add_argument("--with_meta", action="store_true",
+                        help="Probe the videos with ffprobe and store frame "
+                        "count, fps and key frames in the header records")
+
     args = parser.parse_args()
-    create_an_lmdb_database(args.list_file, args.dataset_dir)
+    create_an_lmdb_database(
+        args.list_file, args.dataset_dir,
+        header_records=args.header_records or args.with_meta,
+        with_meta=args.with_meta)
 
 
 if __name__ == '__main__':
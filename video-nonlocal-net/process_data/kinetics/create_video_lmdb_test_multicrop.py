@@ -23,7 +23,9 @@ from caffe2.python import workspace
 # OUTPUT: an lmdb database of videos
 
 
-def create_an_lmdb_database(list_file, output_file, use_local_file=True):
+def create_an_lmdb_database(
+    list_file, output_file, use_local_file=True, views_in_op=False
+):
     print("Write video to a lmdb...")
     LMDB_MAP_SIZE = 1 << 40   # MODIFY
     env = lmdb.open(output_file, map_size=LMDB_MAP_SIZE)
@@ -33,6 +35,11 @@ def create_an_lmdb_database(list_file, output_file, use_local_file=True):
     index = 0
     test_start_frame_num = 10
     crop_times = 3
+    if views_in_op:
+        # one record per video, the input op expands it into all the views
+        # (TEST.EXPAND_VIEWS)
+        test_start_frame_num = 1
+        crop_times = 1
 
     # initialize empty lists
     list_idx = []
@@ -115,9 +122,12 @@ def main():
     parser.add_argument("--list_file", type=str, default=None,
                         help="List file pointing to videos and labels",
                         required=True)
+    parser.add_argument("--views_in_op", type=int, default=0,
+                        help="Write one record per video for TEST.EXPAND_VIEWS")
 
     args = parser.parse_args()
-    create_an_lmdb_database(args.list_file, args.dataset_dir)
+    create_an_lmdb_database(
+        args.list_file, args.dataset_dir, views_in_op=bool(args.views_in_op))
 
 
 if __name__ == '__main__':
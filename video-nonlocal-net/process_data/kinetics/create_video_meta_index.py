@@ -0,0 +1,102 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+import json
+import struct
+import argparse
+import subprocess
+
+# this tool writes the meta data index of caffe2/video/video_meta_index.h,
+# which the video input op (video_meta_index) uses to place clips in local
+# video files without probing them
+# INPUT: a list_file with one video path (and anything else) per line
+# OUTPUT: the index file
+
+
+def probe_video_meta(filename):
+    """
+    Frame count, fps, width, height and key frame indices of the first video
+    stream, as ffprobe sees them after reading every packet.
+    """
+    output = subprocess.check_output([
+        'ffprobe', '-v', 'error', '-select_streams', 'v:0',
+        '-show_entries', 'stream=width,height,avg_frame_rate:packet=flags',
+        '-of', 'json', filename])
+    info = json.loads(output.decode('utf-8'))
+    stream = info['streams'][0]
+    num, den = stream['avg_frame_rate'].split('/')
+    fps = float(num) / float(den) if float(den) > 0 else 0.0
+    packets = info.get('packets', [])
+    key_frames = [
+        i for i, packet in enumerate(packets)
+        if 'K' in packet.get('flags', '')]
+    return {
+        'num_frames': len(packets),
+        'fps': fps,
+        'width': int(stream['width']),
+        'height': int(stream['height']),
+        'key_frames': key_frames,
+    }
+
+
+def serialize_video_meta_index(metas):
+    """
+    The index file for a dict of path to probe_video_meta() results: "VMIX",
+    the entries sorted by path, then the paths and key frame tables.
+    """
+    header_size = 8
+    entry_size = 32
+    paths = sorted(metas.keys())
+    encoded = [p.encode('utf-8') for p in paths]
+    entries = b''
+    data = b''
+    offset = header_size + entry_size * len(paths)
+    for path, name in zip(paths, encoded):
+        meta = metas[path]
+        key_frames = meta['key_frames']
+        path_offset = offset
+        key_frame_offset = path_offset + len(name)
+        entries += struct.pack(
+            '<iiifiiii', path_offset, len(name), meta['num_frames'],
+            meta['fps'], meta['width'], meta['height'], key_frame_offset,
+            len(key_frames))
+        data += name + struct.pack('<{}i'.format(len(key_frames)), *key_frames)
+        offset = key_frame_offset + 4 * len(key_frames)
+    return b'VMIX' + struct.pack('<i', len(paths)) + entries + data
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Caffe2: create the meta data index of local videos"
+    )
+    parser.add_argument("--list_file", type=str, default=None,
+                        help="List file pointing to videos and labels",
+                        required=True)
+    parser.add_argument("--output_file", type=str, default=None,
+                        help="Path to write the index to",
+                        required=True)
+
+    args = parser.parse_args()
+    metas = {}
+    with open(args.list_file, 'r') as data:
+        for i, line in enumerate(data):
+            filename = line.split()[0]
+            if filename not in metas:
+                metas[filename] = probe_video_meta(filename)
+            if i % 10000 == 0:
+                print(i)
+    with open(args.output_file, 'wb') as output:
+        output.write(serialize_video_meta_index(metas))
+    print("Done writing the meta data of {} videos".format(len(metas)))
+
+
+if __name__ == '__main__':
+    main()
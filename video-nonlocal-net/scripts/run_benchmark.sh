@@ -0,0 +1,9 @@
+# Compares the canonical configs to a baseline run on the same machine, e.g.
+# one of the commit before a change:
+#   bash run_benchmark.sh --baseline ../data/benchmark/baseline.json
+mkdir -p ../data/benchmark
+
+python ../tools/benchmark_video.py \
+--output ../data/benchmark/benchmark_$(git rev-parse --short HEAD).json \
+"$@" \
+2>&1 | tee ../data/benchmark/log.txt
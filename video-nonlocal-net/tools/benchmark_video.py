@@ -0,0 +1,321 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+
+"""Regression benchmark of the canonical Kinetics configs: runs a short,
+fixed-seed slice of each case of CASES, from random weights, on synthetic
+and on real inputs, and writes a json of its step time, data-stall
+fraction, peak GPU memory, startup time and test clips/s of the
+multi-crop path. With --baseline, the metrics are compared to those of an
+earlier run on the same hardware, and the run fails if one of them got
+worse by more than --tolerance.
+
+Every case runs in a process of its own, as caffe2 and the config are
+initialized once per process; see scripts/run_benchmark.sh."""
+
+from __future__ import division
+from __future__ import absolute_import
+from __future__ import unicode_literals
+from __future__ import print_function
+
+import argparse
+import json
+import logging
+import numpy as np
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+import time
+
+# the startup time of a case counts from here
+PROCESS_START = time.time()
+
+FORMAT = '[%(levelname)s: %(filename)s: %(lineno)4d]: %(message)s'
+logging.basicConfig(level=logging.INFO, format=FORMAT, stream=sys.stdout)
+logger = logging.getLogger(__name__)
+
+# The shapes of run_c2d_baseline_400k.sh, run_i3d_nlnet_400k.sh and
+# run_i3d_nlnet_affine_400k_128f.sh, with paths relative to scripts/.
+CASES = [
+    {
+        'name': 'c2d_baseline_400k',
+        'config_file':
+            '../configs/DBG_kinetics_resnet_8gpu_c2d_nonlocal_400k.yaml',
+        'opts': [
+            'VIDEO_DECODER_THREADS', '5',
+            'NONLOCAL.CONV3_NONLOCAL', 'False',
+            'NONLOCAL.CONV4_NONLOCAL', 'False',
+            'MODEL.VIDEO_ARC_CHOICE', '1',
+            'TRAIN.DROPOUT_RATE', '0.5',
+        ],
+    },
+    {
+        'name': 'i3d_nlnet_400k',
+        'config_file':
+            '../configs/DBG_kinetics_resnet_8gpu_c2d_nonlocal_400k.yaml',
+        'opts': [
+            'VIDEO_DECODER_THREADS', '5',
+            'NONLOCAL.CONV3_NONLOCAL', 'True',
+            'NONLOCAL.CONV4_NONLOCAL', 'True',
+            'MODEL.VIDEO_ARC_CHOICE', '2',
+            'TRAIN.DROPOUT_RATE', '0.5',
+        ],
+    },
+    {
+        'name': 'i3d_nlnet_affine_400k_128f',
+        'config_file':
+            '../configs/DBG_kinetics_resnet_8gpu_c2d_nonlocal_affine_400k.yaml',
+        'opts': [
+            'VIDEO_DECODER_THREADS', '2',
+            'NONLOCAL.CONV3_NONLOCAL', 'True',
+            'NONLOCAL.CONV4_NONLOCAL', 'True',
+            'TRAIN.VIDEO_LENGTH', '128',
+            'TRAIN.SAMPLE_RATE', '1',
+            'TEST.VIDEO_LENGTH', '128',
+            'TEST.SAMPLE_RATE', '1',
+            'MODEL.MODEL_NAME', 'resnet_video_org',
+            'MODEL.VIDEO_ARC_CHOICE', '2',
+            'TRAIN.DROPOUT_RATE', '0.5',
+        ],
+    },
+]
+
+INPUTS = ['synthetic', 'real']
+
+# metric: True if higher is better
+METRICS = {
+    'train_step_time_ms': False,
+    'train_step_time_p90_ms': False,
+    'data_stall_fraction': False,
+    'peak_gpu_memory_mb': False,
+    'startup_time_s': False,
+    'test_clips_per_s': True,
+}
+
+# the stall fractions of the synthetic input are close to 0, so they are
+# compared by difference instead of by ratio
+STALL_TOLERANCE = 0.02
+
+
+def benchmark_opts(case, inputs):
+    """The config of a slice of a case: fixed seed, random weights, and no
+    logging, testing or checkpointing in between."""
+    opts = list(case['opts']) + [
+        'RNG_SEED', '2',
+        'CUDA_MEMORY_POOL', 'caching',
+        'LOG_PERIOD', '1000000',
+        'TRAIN.EVAL_PERIOD', '1000000',
+        'TRAIN.ITERS_PER_RUN', '1',
+        'TRAIN.COMPUTE_PRECISE_BN', 'False',
+        'CHECKPOINT.CHECKPOINT_PERIOD', '-1',
+        'CHECKPOINT.DIR', tempfile.gettempdir(),
+        'SYNTHETIC_INPUT.ENABLED', str(inputs == 'synthetic'),
+    ]
+    if inputs == 'real':
+        opts += [
+            'DATADIR', '../data/lmdb/kinetics_lmdb_multicrop/',
+            'FILENAME_GT', '../process_data/kinetics/vallist.txt',
+        ]
+    return opts
+
+
+def peak_gpu_memory_mb(cfg, workspace):
+    peak = 0
+    for i in range(cfg.NUM_GPUS):
+        stats = workspace.GetCUDAMemoryStats(cfg.ROOT_GPU_ID + i)
+        if stats is not None:
+            peak = max(peak, stats['peak_allocated_bytes'])
+    return peak / 1024. ** 2
+
+
+def run_case(args):
+    """Runs one case in this process and writes its metrics to
+    args.result_file."""
+    from caffe2.python import workspace
+    from core.config import config as cfg
+    from core.config import cfg_from_file, cfg_from_list, assert_and_infer_cfg
+    import utils.misc as misc
+    from models import model_builder_video
+    from train_net_video import create_wrapper, run_train_net
+
+    case = [c for c in CASES if c['name'] == args.run_case][0]
+    cfg_from_file(case['config_file'])
+    cfg_from_list(benchmark_opts(case, args.inputs) + args.opts)
+    assert_and_infer_cfg()
+
+    misc.global_init()
+    np.random.seed(cfg.RNG_SEED)
+    result = {}
+
+    # ---- train: the first iteration ends the startup
+    model, _, _ = create_wrapper(is_train=True)
+    if cfg.SOLVER.LR_IN_GRAPH:
+        model_builder_video.feed_lr_iter(0)
+    else:
+        model.UpdateWorkspaceLr(0)
+    input_wait = model.net.AddObserver('PrefetchWaitObserver')
+    run_train_net(model, 1)
+    result['startup_time_s'] = time.time() - PROCESS_START
+    run_train_net(model, args.warmup)
+    input_wait.reset()
+    step_times = []
+    for _ in range(args.iters):
+        start = time.time()
+        run_train_net(model, 1)
+        step_times.append((time.time() - start) * 1000.)
+    result['train_step_time_ms'] = float(np.mean(step_times))
+    result['train_step_time_p90_ms'] = float(np.percentile(step_times, 90))
+    result['train_clips_per_s'] = \
+        cfg.TRAIN.BATCH_SIZE * 1000. / result['train_step_time_ms']
+    result['data_stall_fraction'] = float(input_wait.stall_fraction())
+    result['peak_gpu_memory_mb'] = peak_gpu_memory_mb(cfg, workspace)
+
+    # ---- test: the multi-crop path of test_net, see test_net_video.py
+    workspace.ResetWorkspace()
+    cfg.TEST.DATA_TYPE = 'test'
+    cfg.TRAIN.CROP_SIZE = cfg.TRAIN.JITTER_SCALES[0]
+    cfg.TEST.USE_MULTI_CROP = 1
+    test_model, _, _ = create_wrapper(is_train=False)
+    test_name = test_model.net.Proto().name
+    for _ in range(args.warmup):
+        workspace.RunNet(test_name)
+    start = time.time()
+    for _ in range(args.test_iters):
+        workspace.RunNet(test_name)
+    result['test_clips_per_s'] = \
+        args.test_iters * cfg.TEST.BATCH_SIZE / (time.time() - start)
+
+    result['num_gpus'] = cfg.NUM_GPUS
+    result['train_batch_size'] = cfg.TRAIN.BATCH_SIZE
+    result['test_batch_size'] = cfg.TEST.BATCH_SIZE
+    with open(args.result_file, 'w') as f:
+        json.dump(result, f)
+
+
+def git_commit():
+    try:
+        return subprocess.check_output(
+            ['git', 'rev-parse', 'HEAD'],
+            cwd=os.path.dirname(os.path.abspath(__file__))).decode().strip()
+    except Exception:
+        return None
+
+
+def compare(results, baseline, tolerance):
+    """Logs the change of every metric against the baseline and returns the
+    regressions."""
+    regressions = []
+    for key in sorted(results):
+        if key not in baseline:
+            logger.info('{}: no baseline'.format(key))
+            continue
+        for metric, higher_is_better in sorted(METRICS.items()):
+            new = results[key].get(metric)
+            old = baseline[key].get(metric)
+            if new is None or old is None:
+                continue
+            if metric == 'data_stall_fraction':
+                worse = new - old > STALL_TOLERANCE
+                change = '{:+.3f}'.format(new - old)
+            else:
+                ratio = new / old if old > 0 else 1.
+                worse = (ratio < 1. - tolerance if higher_is_better
+                         else ratio > 1. + tolerance)
+                change = '{:+.1f}%'.format((ratio - 1.) * 100)
+            logger.info('{} {}: {:.3f} -> {:.3f} ({}){}'.format(
+                key, metric, old, new, change,
+                ' REGRESSION' if worse else ''))
+            if worse:
+                regressions.append((key, metric))
+    return regressions
+
+
+def run_all(args):
+    cases = args.cases.split(',') if args.cases else \
+        [c['name'] for c in CASES]
+    results = {}
+    for name in cases:
+        for inputs in args.inputs.split(','):
+            key = '{}/{}'.format(name, inputs)
+            logger.info('Benchmarking {}'.format(key))
+            with tempfile.NamedTemporaryFile(suffix='.json') as f:
+                returncode = subprocess.call(
+                    [sys.executable, os.path.abspath(__file__),
+                     '--run_case', name, '--inputs', inputs,
+                     '--result_file', f.name,
+                     '--iters', str(args.iters),
+                     '--warmup', str(args.warmup),
+                     '--test_iters', str(args.test_iters)] + args.opts)
+                if returncode != 0:
+                    logger.error('{} failed with {}'.format(key, returncode))
+                    results[key] = {'failed': True}
+                    continue
+                with open(f.name) as result_file:
+                    results[key] = json.load(result_file)
+            logger.info('{}: {}'.format(key, json.dumps(results[key])))
+
+    output = {
+        'host': platform.node(),
+        'commit': git_commit(),
+        'time': time.strftime('%Y-%m-%d %H:%M:%S'),
+        'iters': args.iters,
+        'opts': args.opts,
+        'results': results,
+    }
+    with open(args.output, 'w') as f:
+        json.dump(output, f, indent=2, sort_keys=True)
+    logger.info('Wrote the results to {}'.format(args.output))
+
+    failed = [key for key in results if results[key].get('failed')]
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f)['results']
+        regressions = compare(results, baseline, args.tolerance)
+        if regressions:
+            logger.error('{} regressions against {}'.format(
+                len(regressions), args.baseline))
+            return 1
+    return 1 if failed else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Regression benchmark of the video models')
+    parser.add_argument('--output', type=str, default='benchmark.json',
+                        help='json file of the results')
+    parser.add_argument('--baseline', type=str, default=None,
+                        help='json file of an earlier run to compare to')
+    parser.add_argument('--tolerance', type=float, default=0.05,
+                        help='relative change of a metric that is a '
+                        'regression')
+    parser.add_argument('--cases', type=str, default=None,
+                        help='comma separated names of CASES, all if unset')
+    parser.add_argument('--inputs', type=str, default=','.join(INPUTS),
+                        help='comma separated inputs: synthetic, real')
+    parser.add_argument('--iters', type=int, default=50,
+                        help='timed train iterations of a case')
+    parser.add_argument('--warmup', type=int, default=10,
+                        help='train and test iterations before the timed ones')
+    parser.add_argument('--test_iters', type=int, default=20,
+                        help='timed test iterations of a case')
+    parser.add_argument('--run_case', type=str, default=None,
+                        help=argparse.SUPPRESS)
+    parser.add_argument('--result_file', type=str, default=None,
+                        help=argparse.SUPPRESS)
+    parser.add_argument('opts', help='config options for all the cases, '
+                        'see config.py', default=[], nargs=argparse.REMAINDER)
+    args = parser.parse_args()
+
+    if args.run_case:
+        run_case(args)
+        return 0
+    return run_all(args)
+
+
+if __name__ == '__main__':
+    sys.exit(main())
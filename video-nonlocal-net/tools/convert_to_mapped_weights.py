@@ -0,0 +1,81 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+
+"""Converts the weights of a .pkl checkpoint, or of a predictor init_net.pb,
+into a mapped weights file for the Predictor constructor that takes a
+weights file, so that the processes of the CPU inference workers share one
+read-only copy of the weights instead of parsing their own."""
+
+from __future__ import division
+from __future__ import absolute_import
+from __future__ import unicode_literals
+from __future__ import print_function
+
+import argparse
+import cPickle as pickle
+import logging
+import numpy as np
+import sys
+
+from caffe2.python import workspace
+from caffe2.proto import caffe2_pb2
+
+FORMAT = '[%(levelname)s: %(filename)s: %(lineno)4d]: %(message)s'
+logging.basicConfig(level=logging.INFO, format=FORMAT, stream=sys.stdout)
+logger = logging.getLogger(__name__)
+
+
+def feed_pkl(params_file, prefix, skip_momentum):
+    with open(params_file, 'r') as fopen:
+        blobs = pickle.load(fopen)
+    if 'blobs' in blobs:
+        blobs = blobs['blobs']
+    names = []
+    for name, value in sorted(blobs.items()):
+        # model_iter, lr and the momentum are only needed to resume training
+        if not isinstance(value, np.ndarray) or name == 'lr' or \
+                (skip_momentum and name.endswith('_momentum')):
+            continue
+        if np.issubdtype(value.dtype, np.floating):
+            # as initialize_master_gpu_model_params loads them
+            value = value.astype(np.float32, copy=False)
+        workspace.FeedBlob(prefix + name, value)
+        names.append(prefix + name)
+    return names
+
+
+def feed_init_net(init_net_file):
+    init_net = caffe2_pb2.NetDef()
+    with open(init_net_file, 'rb') as f:
+        init_net.ParseFromString(f.read())
+    workspace.RunNetOnce(init_net)
+    return workspace.Blobs()
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Convert weights to a mapped weights file')
+    parser.add_argument('--input', type=str, required=True,
+                        help='a .pkl checkpoint or an init_net .pb')
+    parser.add_argument('--output', type=str, required=True,
+                        help='the mapped weights file to write')
+    parser.add_argument('--prefix', type=str, default='',
+                        help='prefix of the blob names of a .pkl, e.g. gpu_0/')
+    parser.add_argument('--keep_momentum', action='store_true',
+                        help='keep the momentum blobs of a .pkl')
+    args = parser.parse_args()
+
+    if args.input.endswith('.pkl'):
+        names = feed_pkl(args.input, args.prefix, not args.keep_momentum)
+    else:
+        names = feed_init_net(args.input)
+    workspace.C.save_mapped_weights(args.output, names)
+    logger.info('Wrote {} tensors to {}'.format(len(names), args.output))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,96 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+
+"""Decodes training clips on a CPU node and serves them, as uint8 clips,
+labels and mirror flags, to the ZmqClipInput ops of the training nodes
+that list DECODE_SERVICE.BIND of this node in DECODE_SERVICE.ADDRESSES.
+Each batch goes to a tower that has a credit left, so the decode nodes
+never run ahead of the GPUs by more than DECODE_SERVICE.CREDITS batches."""
+
+from __future__ import division
+from __future__ import absolute_import
+from __future__ import unicode_literals
+from __future__ import print_function
+
+import argparse
+import logging
+import numpy as np
+import sys
+
+from caffe2.python import workspace
+
+from core.config import config as cfg
+from core.config import (
+    cfg_from_file, cfg_from_list, assert_and_infer_cfg, print_cfg)
+from models import model_builder_video
+
+import utils.misc as misc
+
+FORMAT = '[%(levelname)s: %(filename)s: %(lineno)4d]: %(message)s'
+logging.basicConfig(level=logging.INFO, format=FORMAT, stream=sys.stdout)
+logger = logging.getLogger(__name__)
+
+
+def serve(shard_id, num_shards):
+    misc.global_init()
+    np.random.seed(cfg.RNG_SEED + shard_id)
+    print_cfg()
+
+    workspace.ResetWorkspace()
+    model = model_builder_video.ModelBuilder(
+        name='{}_decode'.format(cfg.MODEL.MODEL_NAME), train=True,
+        split='train')
+    # every decode node reads a shard of its own
+    reader = model.CreateDB(
+        'reader_train',
+        db=cfg.DATADIR + '/train',
+        db_type='remote_video' if cfg.REMOTE_VIDEO.DB_LIST else 'lmdb',
+        num_shards=num_shards,
+        shard_id=shard_id,
+        shuffle=cfg.TRAIN.SHUFFLE_DB,
+        shuffle_seed=cfg.RNG_SEED,
+    )
+    blobs = model.add_video_input(
+        model, reader, misc.get_batch_size('train'), decode_server=True)
+    model.net.ZmqClipSend(blobs, [], address=cfg.DECODE_SERVICE.BIND)
+
+    workspace.RunNetOnce(model.param_init_net)
+    workspace.CreateNet(model.net)
+    logger.info('Serving clips on {}'.format(cfg.DECODE_SERVICE.BIND))
+    while True:
+        workspace.RunNet(model.net.Proto().name)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Video decode server')
+    parser.add_argument('--config_file', type=str, default=None,
+                        help='Optional config file for params')
+    parser.add_argument('--shard_id', type=int, default=0,
+                        help='the shard of the train db of this node')
+    parser.add_argument('--num_shards', type=int, default=1,
+                        help='the number of decode nodes')
+    parser.add_argument('opts', help='see configs.py for all options',
+                        default=None, nargs=argparse.REMAINDER)
+    if len(sys.argv) == 1:
+        parser.print_help()
+        sys.exit(1)
+
+    args = parser.parse_args()
+    if args.config_file is not None:
+        cfg_from_file(args.config_file)
+    if args.opts is not None:
+        cfg_from_list(args.opts)
+
+    assert_and_infer_cfg()
+    assert 0 <= args.shard_id < args.num_shards, \
+        '--shard_id should be in [0, --num_shards).'
+
+    serve(args.shard_id, args.num_shards)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,107 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+
+"""Writes the test net of TEST.PARAMS_FILE as an ONNX model, model.onnx,
+that maps a 'data' clip of 1 x 3 x TEST.VIDEO_LENGTH x TEST.CROP_SIZE x
+TEST.CROP_SIZE to TEST.OUTPUT_NAME, without the video input op."""
+
+from __future__ import division
+from __future__ import absolute_import
+from __future__ import unicode_literals
+from __future__ import print_function
+
+import logging
+import numpy as np
+import argparse
+import sys
+import os
+
+from caffe2.python import workspace
+
+from core.config import config as cfg
+from core.config import (
+    cfg_from_file, cfg_from_list, assert_and_infer_cfg, print_cfg)
+from models import model_builder_video
+
+import utils.misc as misc
+import utils.checkpoints as checkpoints
+import utils.onnx_export as onnx_export
+
+FORMAT = '[%(levelname)s: %(filename)s: %(lineno)4d]: %(message)s'
+logging.basicConfig(level=logging.INFO, format=FORMAT, stream=sys.stdout)
+logger = logging.getLogger(__name__)
+
+
+def export_net():
+    misc.global_init()
+    np.random.seed(cfg.RNG_SEED)
+
+    # one tower of plain ops, which export one to one
+    cfg.NUM_GPUS = 1
+    cfg.MODEL.FUSE_POINTWISE = False
+    cfg.NONLOCAL.USE_FUSED_ATTENTION = False
+    if not cfg.TEST.DATA_TYPE:
+        cfg.TEST.DATA_TYPE = 'val'
+    print_cfg()
+
+    workspace.ResetWorkspace()
+    model = model_builder_video.ModelBuilder(
+        name='{}_test'.format(cfg.MODEL.MODEL_NAME), train=False,
+        use_cudnn=True, cudnn_exhaustive_search=True,
+        split=cfg.TEST.DATA_TYPE)
+    model.build_model()
+
+    workspace.RunNetOnce(model.param_init_net)
+    if not cfg.TEST.PARAMS_FILE:
+        raise Exception('No params files specified for the export.')
+    checkpoints.load_model_from_params_file_for_test(
+        model, cfg.TEST.PARAMS_FILE)
+    if cfg.TEST.FOLD_AFFINE:
+        # the AffineNds export as a Mul and an Add otherwise
+        checkpoints.fold_affine_into_conv(model)
+
+    prefix = 'gpu_{}/'.format(cfg.ROOT_GPU_ID)
+    predict_net, params = onnx_export.inference_net(
+        model.net, prefix + 'data', prefix + cfg.TEST.OUTPUT_NAME,
+        prefix=prefix)
+    onnx_model = onnx_export.export_onnx_model(
+        predict_net, params,
+        (1, 3, cfg.TEST.VIDEO_LENGTH, cfg.TEST.CROP_SIZE, cfg.TEST.CROP_SIZE))
+
+    output_dir = cfg.CHECKPOINT.DIR
+    if not os.path.exists(output_dir):
+        os.makedirs(output_dir)
+    path = os.path.join(output_dir, 'model.onnx')
+    with open(path, 'wb') as f:
+        f.write(onnx_model.SerializeToString())
+    logger.info('ONNX model saved to: {}'.format(path))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='ONNX model export')
+    parser.add_argument('--config_file', type=str, default=None,
+                        help='Optional config file for params')
+    parser.add_argument('opts', help='see configs.py for all options',
+                        default=None, nargs=argparse.REMAINDER)
+    if len(sys.argv) == 1:
+        parser.print_help()
+        sys.exit(1)
+
+    args = parser.parse_args()
+    if args.config_file is not None:
+        cfg_from_file(args.config_file)
+    if args.opts is not None:
+        cfg_from_list(args.opts)
+
+    assert_and_infer_cfg()
+    assert not cfg.FP16.ENABLED, 'Export the fp32 model.'
+
+    export_net()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,139 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+
+"""Writes the test net of TEST.PARAMS_FILE as a Caffe2 predictor,
+init_net.pb and predict_net.pb, that maps the encoded bytes of videos
+('encoded_videos', N strings), the start frames of their clips ('start_frm',
+N ints) and their crops ('spatial_pos', N ints) to TEST.OUTPUT_NAME. The
+DecodeVideoClip op at its head decodes, scales, crops and normalizes the
+clips as the CustomizedVideoInput op of the test does."""
+
+from __future__ import division
+from __future__ import absolute_import
+from __future__ import unicode_literals
+from __future__ import print_function
+
+import logging
+import numpy as np
+import argparse
+import sys
+import os
+
+from caffe2.proto import caffe2_pb2
+from caffe2.python import core, workspace
+
+from core.config import config as cfg
+from core.config import (
+    cfg_from_file, cfg_from_list, assert_and_infer_cfg, print_cfg)
+from models import model_builder_video
+
+import utils.misc as misc
+import utils.checkpoints as checkpoints
+import utils.conv_fusion as conv_fusion
+import utils.onnx_export as onnx_export
+import utils.quantization as quantization
+
+FORMAT = '[%(levelname)s: %(filename)s: %(lineno)4d]: %(message)s'
+logging.basicConfig(level=logging.INFO, format=FORMAT, stream=sys.stdout)
+logger = logging.getLogger(__name__)
+
+INPUT_BLOBS = ['encoded_videos', 'start_frm', 'spatial_pos']
+
+
+def decode_clip_op():
+    return core.CreateOperator(
+        'DecodeVideoClip', INPUT_BLOBS, ['data'],
+        length=cfg.TEST.VIDEO_LENGTH,
+        sampling_rate=cfg.TEST.SAMPLE_RATE,
+        crop=cfg.TEST.CROP_SIZE,
+        min_size=cfg.TEST.SCALE,
+        max_size=cfg.TEST.SCALE,
+        mean=cfg.MODEL.MEAN,
+        std=cfg.MODEL.STD,
+        use_bgr=int(cfg.MODEL.USE_BGR),
+        decode_threads=cfg.VIDEO_DECODER_THREADS,
+        use_selective_decoding=int(cfg.VIDEO_DECODER_SELECTIVE),
+        codec_threads=cfg.VIDEO_DECODER_CODEC_THREADS,
+        decode_backend=cfg.VIDEO_DECODER_BACKEND)
+
+
+def export_net():
+    misc.global_init()
+    np.random.seed(cfg.RNG_SEED)
+
+    cfg.NUM_GPUS = 1
+    if not cfg.TEST.DATA_TYPE:
+        cfg.TEST.DATA_TYPE = 'test'
+    print_cfg()
+
+    workspace.ResetWorkspace()
+    model = model_builder_video.ModelBuilder(
+        name='{}_test'.format(cfg.MODEL.MODEL_NAME), train=False,
+        use_cudnn=True, cudnn_exhaustive_search=True,
+        split=cfg.TEST.DATA_TYPE)
+    model.build_model()
+
+    workspace.RunNetOnce(model.param_init_net)
+    if not cfg.TEST.PARAMS_FILE:
+        raise Exception('No params files specified for the export.')
+    checkpoints.load_model_from_params_file_for_test(
+        model, cfg.TEST.PARAMS_FILE)
+
+    prefix = 'gpu_{}/'.format(cfg.ROOT_GPU_ID)
+    predict_net, params = onnx_export.inference_net(
+        model.net, prefix + 'data', prefix + cfg.TEST.OUTPUT_NAME,
+        prefix=prefix)
+    if cfg.TEST.FUSE_CONV2PLUS1D:
+        predict_net, params = conv_fusion.fuse_conv2plus1d(
+            predict_net, params)
+    # the clips come from the decode op instead of the caller
+    decode_net = caffe2_pb2.NetDef()
+    decode_net.CopyFrom(predict_net)
+    del decode_net.op[:]
+    decode_net.op.extend([decode_clip_op()])
+    decode_net.op.extend(predict_net.op)
+    del decode_net.external_input[:]
+    decode_net.external_input.extend(INPUT_BLOBS + [
+        blob for blob in predict_net.external_input if blob != 'data'])
+    predict_net = decode_net
+    init_net = quantization.make_init_net(params, predict_net.name + '_init')
+
+    output_dir = cfg.CHECKPOINT.DIR
+    if not os.path.exists(output_dir):
+        os.makedirs(output_dir)
+    for net, filename in ((init_net, 'init_net.pb'),
+                          (predict_net, 'predict_net.pb')):
+        path = os.path.join(output_dir, filename)
+        with open(path, 'wb') as f:
+            f.write(net.SerializeToString())
+        logger.info('{} saved to: {}'.format(net.name, path))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Predictor export')
+    parser.add_argument('--config_file', type=str, default=None,
+                        help='Optional config file for params')
+    parser.add_argument('opts', help='see configs.py for all options',
+                        default=None, nargs=argparse.REMAINDER)
+    if len(sys.argv) == 1:
+        parser.print_help()
+        sys.exit(1)
+
+    args = parser.parse_args()
+    if args.config_file is not None:
+        cfg_from_file(args.config_file)
+    if args.opts is not None:
+        cfg_from_list(args.opts)
+
+    assert_and_infer_cfg()
+    assert not cfg.FP16.ENABLED, 'Export the fp32 model.'
+
+    export_net()
+
+
+if __name__ == '__main__':
+    main()
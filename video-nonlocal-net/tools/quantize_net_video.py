@@ -0,0 +1,114 @@
+# Copyright (c) 2017-present, Facebook, Inc.
+# All rights reserved.
+#
+# This source code is licensed under the license found in the
+# LICENSE file in the root directory of this source tree.
+#
+
+"""Calibrates the test net of TEST.PARAMS_FILE on QUANT.CALIBRATION_ITERS
+batches of the TEST.DATA_TYPE split and writes an int8 CPU predictor,
+int8_init_net.pb and int8_predict_net.pb, that maps 'data' to
+TEST.OUTPUT_NAME."""
+
+from __future__ import division
+from __future__ import absolute_import
+from __future__ import unicode_literals
+from __future__ import print_function
+
+import logging
+import numpy as np
+import argparse
+import sys
+import os
+
+from caffe2.python import workspace
+
+from core.config import config as cfg
+from core.config import (
+    cfg_from_file, cfg_from_list, assert_and_infer_cfg, print_cfg)
+from models import model_builder_video
+
+import utils.misc as misc
+import utils.checkpoints as checkpoints
+import utils.quantization as quantization
+
+FORMAT = '[%(levelname)s: %(filename)s: %(lineno)4d]: %(message)s'
+logging.basicConfig(level=logging.INFO, format=FORMAT, stream=sys.stdout)
+logger = logging.getLogger(__name__)
+
+
+def quantize_net():
+    misc.global_init()
+    np.random.seed(cfg.RNG_SEED)
+
+    # one tower, and no in-place ops so that every blob keeps its range
+    cfg.NUM_GPUS = 1
+    cfg.MODEL.ALLOW_INPLACE_SUM = False
+    cfg.MODEL.ALLOW_INPLACE_RELU = False
+    cfg.MODEL.ALLOW_INPLACE_RESHAPE = False
+    cfg.TRAIN.CROP_SIZE = 224
+    if not cfg.TEST.DATA_TYPE:
+        cfg.TEST.DATA_TYPE = 'val'
+    print_cfg()
+
+    workspace.ResetWorkspace()
+    model = model_builder_video.ModelBuilder(
+        name='{}_test'.format(cfg.MODEL.MODEL_NAME), train=False,
+        use_cudnn=True, cudnn_exhaustive_search=True,
+        split=cfg.TEST.DATA_TYPE)
+    model.build_model()
+    model.net.Proto().type = 'dag'
+
+    workspace.RunNetOnce(model.param_init_net)
+    workspace.CreateNet(model.net)
+    if not cfg.TEST.PARAMS_FILE:
+        raise Exception('No params files specified for quantization.')
+    checkpoints.load_model_from_params_file_for_test(
+        model, cfg.TEST.PARAMS_FILE)
+    # the int8 convs take the folded weights and biases
+    checkpoints.fold_affine_into_conv(model)
+    workspace.CreateNet(model.net, overwrite=True)
+
+    prefix = 'gpu_{}/'.format(cfg.ROOT_GPU_ID)
+    ranges = quantization.collect_ranges(
+        model.net, cfg.QUANT.CALIBRATION_ITERS)
+    predict_net, params = quantization.quantize_net(
+        model.net, ranges, prefix + 'data', prefix + cfg.TEST.OUTPUT_NAME,
+        prefix=prefix)
+    init_net = quantization.make_init_net(params, predict_net.name + '_init')
+
+    output_dir = cfg.QUANT.OUTPUT_DIR or cfg.CHECKPOINT.DIR
+    if not os.path.exists(output_dir):
+        os.makedirs(output_dir)
+    for net, filename in ((init_net, 'int8_init_net.pb'),
+                          (predict_net, 'int8_predict_net.pb')):
+        path = os.path.join(output_dir, filename)
+        with open(path, 'wb') as f:
+            f.write(net.SerializeToString())
+        logger.info('{} saved to: {}'.format(net.name, path))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Int8 model quantization')
+    parser.add_argument('--config_file', type=str, default=None,
+                        help='Optional config file for params')
+    parser.add_argument('opts', help='see configs.py for all options',
+                        default=None, nargs=argparse.REMAINDER)
+    if len(sys.argv) == 1:
+        parser.print_help()
+        sys.exit(1)
+
+    args = parser.parse_args()
+    if args.config_file is not None:
+        cfg_from_file(args.config_file)
+    if args.opts is not None:
+        cfg_from_list(args.opts)
+
+    assert_and_infer_cfg()
+    assert not cfg.FP16.ENABLED, 'Quantize the fp32 model.'
+
+    quantize_net()
+
+
+if __name__ == '__main__':
+    main()
@@ -21,7 +21,7 @@ import cv2
 from sets import Set
 from collections import defaultdict
 
-from caffe2.python import workspace
+from caffe2.python import core, workspace
 
 from core.config import config as cfg
 from core.config import (
@@ -45,6 +45,13 @@ def test_net_one_section():
     timer = Timer()
     results = []
     seen_inds = defaultdict(int)
+    # (video id, temporal index, spatial index) with TEST.OUTPUT_CLIP_INDEX
+    seen_clips = set()
+    # progressive test: the videos that AccumulateClipScores has finished
+    early_exit = cfg.TEST.EARLY_EXIT_MARGIN > 0
+    finished_videos = set()
+    # the per-video sums stay on the gpus (SegmentedClipAggregate)
+    on_device = cfg.TEST.AGGREGATE_ON_DEVICE
 
     logger.warning('Testing started...')  # for monitoring cluster jobs
     test_model = model_builder_video.ModelBuilder(
@@ -54,12 +61,10 @@ def test_net_one_section():
 
     test_model.build_model()
 
-    if cfg.PROF_DAG:
-        test_model.net.Proto().type = 'prof_dag'
-    else:
-        test_model.net.Proto().type = 'dag'
+    test_model.net.Proto().type = misc.get_net_type()
+    misc.set_test_tensor_growth(test_model.net)
 
-    workspace.RunNetOnce(test_model.param_init_net)
+    misc.run_param_init_net(test_model)
     workspace.CreateNet(test_model.net)
 
     misc.save_net_proto(test_model.net)
@@ -67,6 +72,17 @@ def test_net_one_section():
 
     total_test_net_iters = int(
         math.ceil(float(cfg.TEST.DATASET_SIZE * cfg.TEST.NUM_TEST_CLIPS) / cfg.TEST.BATCH_SIZE))
+    # data-parallel test: every gpu goes once through its shard of the db
+    sharded = cfg.TEST.SHARDED
+    if sharded:
+        num_readers = cfg.TEST.NUM_SHARDS * cfg.NUM_GPUS
+        clips_per_gpu = math.ceil(
+            float(cfg.TEST.DATASET_SIZE * cfg.TEST.NUM_TEST_CLIPS) /
+            num_readers)
+        total_test_net_iters = int(math.ceil(
+            clips_per_gpu / (cfg.TEST.BATCH_SIZE // cfg.NUM_GPUS)))
+        logger.info('Testing shard {} of {}: {} iters'.format(
+            cfg.TEST.SHARD_ID, cfg.TEST.NUM_SHARDS, total_test_net_iters))
 
     if cfg.TEST.PARAMS_FILE:
         checkpoints.load_model_from_params_file_for_test(
@@ -74,7 +90,32 @@ def test_net_one_section():
     else:
         raise Exception('No params files specified for testing model.')
 
-    for test_iter in range(total_test_net_iters):
+    if cfg.TEST.OPTIMIZE_INFERENCE:
+        checkpoints.optimize_video_inference(test_model)
+        workspace.CreateNet(test_model.net, overwrite=True)
+    elif cfg.TEST.FOLD_AFFINE:
+        checkpoints.fold_affine_into_conv(test_model)
+        workspace.CreateNet(test_model.net, overwrite=True)
+
+    # uncropped clips are batched by size, so batches can come out padded
+    # and out of order; keep going until every clip has been seen
+    bucketed = cfg.TRAIN.CROP_SIZE <= 0 and cfg.TEST.BATCH_SIZE > 1
+    num_test_clips = cfg.TEST.DATASET_SIZE * cfg.TEST.NUM_TEST_CLIPS
+
+    def all_clips_seen():
+        if early_exit:
+            return len(finished_videos) >= cfg.TEST.DATASET_SIZE
+        if cfg.TEST.OUTPUT_CLIP_INDEX and not on_device:
+            return len(seen_clips) >= num_test_clips
+        return sum(min(n, cfg.TEST.NUM_TEST_CLIPS)
+                   for n in seen_inds.values()) >= num_test_clips
+
+    test_iter = 0
+    # a progressive test ends once every video is finished, usually well
+    # before total_test_net_iters
+    while (test_iter < total_test_net_iters and not early_exit) or (
+            (bucketed or cfg.TEST.OUTPUT_CLIP_INDEX) and not sharded and
+            not all_clips_seen()):
         timer.tic()
         workspace.RunNet(test_model.net.Proto().name)
         timer.toc()
@@ -82,6 +123,7 @@ def test_net_one_section():
         if test_iter == 0:
             misc.print_net(test_model)
             os.system('nvidia-smi')
+            misc.log_cuda_memory_stats()
 
         test_debug = False
         if test_debug is True:
@@ -99,7 +141,28 @@ def test_net_one_section():
                         + '_' + str(i) + '_' + str(j) + '.jpg'
                     cv2.imwrite(fname, temp_img)
 
+        if on_device:
+            # fetch the clip counts every AGGREGATE_FETCH_PERIOD iters, and
+            # after the last iter, to see whether more clips are needed
+            period = cfg.TEST.AGGREGATE_FETCH_PERIOD
+            if test_iter + 1 >= total_test_net_iters or (
+                    period > 0 and (test_iter + 1) % period == 0):
+                counts = fetch_clip_aggregates()[2]
+                seen_inds = {
+                    vid: n for vid, n in enumerate(counts) if n > 0}
+            eta = timer.average_time * max(
+                total_test_net_iters - test_iter - 1, 0)
+            eta = str(datetime.timedelta(seconds=int(eta)))
+            logger.info(('{}/{} iter ({}/{} videos):' +
+                        ' Time: {:.3f} (ETA: {})').format(
+                            test_iter, total_test_net_iters,
+                            len(seen_inds), cfg.TEST.DATASET_SIZE,
+                            timer.diff, eta))
+            test_iter += 1
+            continue
+
         video_ids_list = []  # for logging
+        num_clips = 0
         for gpu_id in range(cfg.NUM_GPUS):
             prefix = 'gpu_{}/'.format(gpu_id)
 
@@ -108,8 +171,40 @@ def test_net_one_section():
             # This is the index of the video for recording results, not the actual class label for the video 
             video_id_gpu = workspace.FetchBlob(prefix + 'labels')
 
+            if cfg.TEST.OUTPUT_CLIP_INDEX:
+                video_id_gpu = workspace.FetchBlob(prefix + 'video_ids')
+                clip_index_gpu = workspace.FetchBlob(prefix + 'clip_index')
+                if early_exit:
+                    status_gpu = workspace.FetchBlob(prefix + 'clip_status')
+                for i in range(softmax_gpu.shape[0]):
+                    vid = video_id_gpu[i]
+                    # -1 marks a padding clip of a bucketed batch
+                    if vid < 0:
+                        continue
+                    num_clips += 1
+                    if early_exit:
+                        # -1: a clip of a finished video that was already
+                        # on its way, 1: the clip that finished its video
+                        if status_gpu[i] < 0:
+                            continue
+                        if status_gpu[i] > 0:
+                            finished_videos.add(vid)
+                    clip_key = (vid, clip_index_gpu[i][0],
+                                clip_index_gpu[i][1])
+                    if clip_key in seen_clips:
+                        logger.warning('Clip {} has been seen. Skip.'.format(
+                            clip_key,))
+                        continue
+                    seen_clips.add(clip_key)
+                    seen_inds[vid] += 1
+                    results.append([vid, softmax_gpu[i].tolist()])
+                video_ids_list.append(video_id_gpu[0])
+                continue
+
             for i in range(len(video_id_gpu)):
-                seen_inds[video_id_gpu[i]] += 1
+                # -1 marks a padding clip of a bucketed batch
+                if video_id_gpu[i] >= 0:
+                    seen_inds[video_id_gpu[i]] += 1
 
             video_ids_list.append(video_id_gpu[0])
             # print(video_id_gpu)
@@ -118,6 +213,8 @@ def test_net_one_section():
             for i in range(softmax_gpu.shape[0]):
                 probs = softmax_gpu[i].tolist()
                 vid = video_id_gpu[i]
+                if vid < 0:
+                    continue
                 if seen_inds[vid] > cfg.TEST.NUM_TEST_CLIPS:
                     logger.warning('Video id {} have been seen. Skip.'.format(
                         vid,))
@@ -127,7 +224,8 @@ def test_net_one_section():
                 results.append(save_pairs)
 
         # ---- log
-        eta = timer.average_time * (total_test_net_iters - test_iter - 1)
+        eta = timer.average_time * max(
+            total_test_net_iters - test_iter - 1, 0)
         eta = str(datetime.timedelta(seconds=int(eta)))
         logger.info(('{}/{} iter ({}/{} videos):' +
                     ' Time: {:.3f} (ETA: {}). ID: {}').format(
@@ -135,12 +233,86 @@ def test_net_one_section():
                         len(seen_inds), cfg.TEST.DATASET_SIZE,
                         timer.diff, eta,
                         video_ids_list,))
-
+        test_iter += 1
+        if early_exit and num_clips == 0:
+            # the input ops only pad once every video has been scheduled
+            logger.warning('{} of {} videos finished, no clips left.'.format(
+                len(finished_videos), cfg.TEST.DATASET_SIZE))
+            break
+
+    if early_exit:
+        logger.info('Tested {} of {} clips'.format(
+            len(results), num_test_clips))
+    if on_device:
+        # one entry per video: [vid, mean, clips, max] of its clip scores
+        sums, maxes, counts = fetch_clip_aggregates()
+        if sharded and cfg.TEST.NUM_SHARDS > 1:
+            sums, maxes, counts = allreduce_clip_aggregates(
+                sums, maxes, counts)
+        results = [
+            [vid, (sums[vid] / counts[vid]).tolist(), int(counts[vid]),
+             maxes[vid].tolist()]
+            for vid in range(len(counts)) if counts[vid] > 0]
+    misc.log_cuda_memory_stats()
+    if cfg.TEST.WRITE_DB:
+        # the WriteToDB ops commit their last clips when they are destroyed
+        workspace.C.delete_net(test_model.net.Proto().name)
+        logger.info('Wrote the test outputs to {}_gpu_*'.format(
+            cfg.TEST.WRITE_DB))
     return results
 
 
+def fetch_clip_aggregates():
+    """The score sums and maxes (videos x classes) and the clip counts of the
+    SegmentedClipAggregate ops of all the gpus."""
+    sums, maxes, counts = None, None, None
+    for gpu_id in range(cfg.NUM_GPUS):
+        prefix = 'gpu_{}/'.format(gpu_id)
+        gpu_sum = workspace.FetchBlob(prefix + cfg.TEST.OUTPUT_NAME + '_sum')
+        gpu_max = workspace.FetchBlob(prefix + cfg.TEST.OUTPUT_NAME + '_max')
+        gpu_counts = workspace.FetchBlob(prefix + 'clip_counts')
+        if sums is None:
+            sums, maxes, counts = gpu_sum, gpu_max, gpu_counts
+        else:
+            sums = sums + gpu_sum
+            maxes = np.maximum(maxes, gpu_max)
+            counts = counts + gpu_counts
+    return sums, maxes, counts
+
+
+def allreduce_clip_aggregates(sums, maxes, counts):
+    """The score sums and maxes and the clip counts of all the
+    TEST.NUM_SHARDS test processes, from the ones of this process: the sums
+    and counts are allreduced through gloo, and the maxes allgathered."""
+    net = core.Net('allreduce_clip_aggregates')
+    store_handler = net.FileStoreHandlerCreate(
+        [], 'test_store_handler', path=cfg.TEST.RENDEZVOUS_PATH,
+        prefix='test_aggregates')
+    world = net.CreateCommonWorld(
+        [store_handler], 'test_common_world', size=cfg.TEST.NUM_SHARDS,
+        rank=cfg.TEST.SHARD_ID, engine='GLOO')
+    # gloo reduces floats; the counts are exact in them
+    workspace.FeedBlob('test_score_sums', sums.astype(np.float32))
+    workspace.FeedBlob('test_clip_counts', counts.astype(np.float32))
+    workspace.FeedBlob('test_score_maxes', maxes.astype(np.float32))
+    # one op per blob, as gloo reduces the inputs of an op together
+    for blob in ['test_score_sums', 'test_clip_counts']:
+        net.Allreduce([world, blob], [blob], engine='GLOO')
+    net.Allgather(
+        [world, 'test_score_maxes'], ['test_score_all_maxes'], engine='GLOO')
+    workspace.RunNetOnce(net)
+    all_maxes = workspace.FetchBlob('test_score_all_maxes').reshape(
+        (cfg.TEST.NUM_SHARDS,) + maxes.shape)
+    logger.info('Gathered the scores of {} test shards'.format(
+        cfg.TEST.NUM_SHARDS))
+    return (
+        workspace.FetchBlob('test_score_sums'),
+        all_maxes.max(axis=0),
+        workspace.FetchBlob('test_clip_counts').astype(counts.dtype))
+
+
 def test_net():
-    workspace.GlobalInit(['caffe2', '--caffe2_log_level=0'])
+    misc.global_init()
     np.random.seed(cfg.RNG_SEED)
 
     cfg.TEST.DATA_TYPE = 'test'
@@ -165,10 +337,13 @@ def test_net():
     logger.info("Done ResetWorkspace...")
 
     results = test_net_one_section()
+    if cfg.TEST.SHARDED and cfg.TEST.SHARD_ID > 0:
+        # shard 0 evaluates the results of all the shards
+        return
 
     # evaluate
     if cfg.FILENAME_GT is not None:
-        evaluate_result(results)
+        evaluate_result(results, per_video=cfg.TEST.AGGREGATE_ON_DEVICE)
 
     # save temporary file
     pkl_path = os.path.join(cfg.CHECKPOINT.DIR, "results_probs.pkl")
@@ -188,7 +363,9 @@ def read_groundtruth(filename_gt):
     return labels
 
 
-def evaluate_result(results):
+def evaluate_result(results, per_video=False):
+    """results are [vid, probs] of every clip, or, per_video, [vid, mean
+    probs, clips, max probs] of every video."""
     gt_labels = read_groundtruth(cfg.FILENAME_GT)
 
     sample_num = cfg.TEST.DATASET_SIZE
@@ -213,7 +390,7 @@ def evaluate_result(results):
         vid = entry[0]
         prob = np.array(entry[1])
         probs[vid] += prob[0: class_num]
-        counts[vid] += 1
+        counts[vid] += entry[2] if per_video else 1
 
         idx = prob.argmax()
         if idx == gt_labels[vid]:
@@ -235,7 +412,9 @@ def evaluate_result(results):
     for i in range(sample_num):
         max_clips = max(max_clips, counts[i])
         min_clips = min(min_clips, counts[i])
-        if counts[i] != sample_video_times:
+        # a progressive test stops most videos early
+        if counts[i] != sample_video_times and (
+                cfg.TEST.EARLY_EXIT_MARGIN <= 0 or counts[i] == 0):
             count_corrupted += 1
             logger.warning('Id: {} count: {}'.format(i, counts[i]))
         if counts[i] == 0:
@@ -245,14 +424,25 @@ def evaluate_result(results):
     logger.info('Num of corrupted videos: {}'.format(count_corrupted))
     logger.info('Max num of clips in a video: {}'.format(max_clips))
     logger.info('Min num of clips in a video: {}'.format(min_clips))
-
-    # clip1 accuracy for sanity (# print clip1 first as it is lowest)
-    logger.info('Clip1 accuracy: {:.2f} percent ({}/{})'.format(
-        100. * clip1_accuracy / clip1_count, clip1_accuracy, clip1_count))
-
-    # clip accuracy for sanity
-    logger.info('Clip accuracy: {:.2f} percent ({}/{})'.format(
-        100. * clip_accuracy / len(results), clip_accuracy, len(results)))
+    logger.info('Mean num of clips in a video: {:.2f}'.format(counts.mean()))
+
+    if per_video:
+        # the scores of the clips themselves stayed on the gpus
+        max_accuracy = sum(
+            1 for entry in results
+            if np.argmax(entry[3][0: class_num]) == gt_labels[entry[0]])
+        logger.info('Max-pooled top-1 accuracy: {:.2f} percent'.format(
+            100. * max_accuracy / sample_num))
+    else:
+        # clip1 accuracy for sanity (# print clip1 first as it is lowest)
+        logger.info('Clip1 accuracy: {:.2f} percent ({}/{})'.format(
+            100. * clip1_accuracy / clip1_count, clip1_accuracy,
+            clip1_count))
+
+        # clip accuracy for sanity
+        logger.info('Clip accuracy: {:.2f} percent ({}/{})'.format(
+            100. * clip_accuracy / len(results), clip_accuracy,
+            len(results)))
 
     # compute accuracy
     accuracy = 0
@@ -18,19 +18,21 @@ import math
 import numpy as np
 import cv2
 
-from caffe2.python import workspace
+from caffe2.python import core, workspace
+from caffe2.proto import caffe2_pb2
 
 from core.config import config as cfg
 from core.config import (
     cfg_from_file, cfg_from_list, assert_and_infer_cfg, print_cfg)
 
+import utils.async_eval as async_eval
 import utils.checkpoints as checkpoints
 import utils.metrics as metrics
 import utils.misc as misc
 import utils.bn_helper as bn_helper
 from utils.timer import Timer
 
-from models import model_builder_video
+from models import model_builder_video, pipeline_helper
 from test_net_video import test_net
 
 FORMAT = '[%(levelname)s: %(filename)s: %(lineno)4d]: %(message)s'
@@ -38,9 +40,11 @@ logging.basicConfig(level=logging.INFO, format=FORMAT, stream=sys.stdout)
 logger = logging.getLogger(__name__)
 
 
-def create_wrapper(is_train):
+def create_wrapper(is_train, shared_with=None):
     """
-    a simpler wrapper that creates the elements for train/test models
+    a simpler wrapper that creates the elements for train/test models;
+    a test model shared_with a train model runs on its blobs, see
+    TRAIN.EVAL_SHARES_TRAIN_MEMORY
     """
     if is_train:
         suffix = '_train'
@@ -51,6 +55,10 @@ def create_wrapper(is_train):
         split = cfg.TEST.DATA_TYPE
         use_mem_cache = True  # we always cache for test
 
+    # the startup phases are timed, as they take minutes for large multi-gpu
+    # models
+    startup_timer = Timer()
+    startup_timer.tic()
     model = model_builder_video.ModelBuilder(
         name=cfg.MODEL.MODEL_NAME + suffix,
         train=is_train,
@@ -59,16 +67,36 @@ def create_wrapper(is_train):
         ws_nbytes_limit=(cfg.CUDNN_WORKSPACE_LIMIT * 1024 * 1024),
         split=split,
         use_mem_cache=use_mem_cache,
+        share_train_memory=shared_with is not None,
     )
     model.build_model()
 
-    if cfg.PROF_DAG:
-        model.net.Proto().type = 'prof_dag'
+    model.net.Proto().type = misc.get_net_type()
+    # the blobs of a shared net keep the sizes of the train net
+    if not is_train and shared_with is None:
+        misc.set_test_tensor_growth(model.net)
+    build_time = startup_timer.toc()
+
+    startup_timer.tic()
+    if shared_with is not None:
+        misc.run_shared_param_init_net(model)
     else:
-        model.net.Proto().type = 'dag'
+        misc.run_param_init_net(model)
+        # also when the test model initialized the params on ROOT_GPU_ID
+        pipeline_helper.place_blobs(model)
+    init_time = startup_timer.toc()
 
-    workspace.RunNetOnce(model.param_init_net)
+    startup_timer.tic()
     workspace.CreateNet(model.net)
+    # the forward and backward passes of all but the last micro-batch
+    if getattr(model, '_micro_batch_net', None) is not None:
+        model._micro_batch_net.Proto().type = misc.get_net_type()
+        workspace.CreateNet(model._micro_batch_net)
+    logger.info(
+        'Startup of {}: build {:.2f}s, param init {:.2f}s, '
+        'create nets {:.2f}s'.format(
+            model.net.Proto().name, build_time, init_time,
+            startup_timer.toc()))
 
     # model.start_data_loader()
 
@@ -81,8 +109,53 @@ def create_wrapper(is_train):
     return model, timer, meter
 
 
+def get_num_iters_of_run(start_iter):
+    """The number of train iterations to run from start_iter in one call into
+    caffe2: at most TRAIN.ITERS_PER_RUN, ending at every iteration after which
+    the train loop logs, tests, checkpoints or profiles.
+    """
+    end_iter = min(
+        start_iter + cfg.TRAIN.ITERS_PER_RUN, cfg.SOLVER.MAX_ITER)
+    for period in [cfg.LOG_PERIOD, cfg.TRAIN.EVAL_PERIOD,
+                   cfg.CHECKPOINT.CHECKPOINT_PERIOD, cfg.VIDEO_STATS_PERIOD]:
+        if period > 0:
+            end_iter = min(end_iter, (start_iter // period + 1) * period)
+    # the profiled iterations run on their own
+    for it in [cfg.TIMELINE.START_ITER,
+               cfg.TIMELINE.START_ITER + cfg.TIMELINE.NUM_ITERS,
+               cfg.MEMORY_PROFILE.ITER, cfg.MEMORY_PROFILE.ITER + 1]:
+        if it > start_iter:
+            end_iter = min(end_iter, it)
+    return end_iter - start_iter
+
+
+def run_train_net(model, num_iters):
+    """Runs num_iters iterations of the train model in C++, as one plan of the
+    created nets. With TRAIN.MICRO_BATCHES, an iteration runs the micro-batch
+    net MICRO_BATCHES - 1 times and then the net.
+    """
+    net_name = model.net.Proto().name
+    micro_net = getattr(model, '_micro_batch_net', None)
+    if num_iters == 1 and micro_net is None:
+        workspace.RunNet(net_name)
+        return
+    plan = caffe2_pb2.PlanDef(name=net_name + '_run')
+    step = plan.execution_step.add(name=net_name, num_iter=num_iters)
+    if micro_net is None:
+        step.network.append(net_name)
+    else:
+        step.substep.add(
+            name=micro_net.Proto().name,
+            num_iter=cfg.TRAIN.MICRO_BATCHES - 1,
+            network=[micro_net.Proto().name])
+        step.substep.add(name=net_name, network=[net_name])
+    workspace.RunPlan(plan)
+
+
 def train(opts):
-    workspace.GlobalInit(['caffe2', '--caffe2_log_level=0'])
+    startup_timer = Timer()
+    startup_timer.tic()
+    misc.global_init()
     logging.getLogger(__name__)
 
     assert opts.test_net, "opts.test_net == False is not implemented."
@@ -96,9 +169,14 @@ def train(opts):
 
     # -------------------------------------------------------------------------
     # build test_model
-    # we build test_model first, as we don't want to overwrite init (if any)
+    # we build test_model first, as we don't want to overwrite init (if any);
+    # a test model that shares the blobs of the train model has no init of
+    # its own and comes after it
     # -------------------------------------------------------------------------
-    test_model, test_timer, test_meter = create_wrapper(is_train=False)
+    shared_eval = cfg.TRAIN.EVAL_SHARES_TRAIN_MEMORY
+    async_eval_on = cfg.TRAIN.ASYNC_EVAL
+    if not shared_eval and not async_eval_on:
+        test_model, test_timer, test_meter = create_wrapper(is_train=False)
     total_test_iters = int(
         math.ceil(cfg.TEST.DATASET_SIZE / float(cfg.TEST.BATCH_SIZE)))
     logger.info('Test iters: {}'.format(total_test_iters))
@@ -107,11 +185,21 @@ def train(opts):
     # now, build train_model
     # -------------------------------------------------------------------------
     train_model, train_timer, train_meter = create_wrapper(is_train=True)
+    if shared_eval:
+        test_model, test_timer, test_meter = create_wrapper(
+            is_train=False, shared_with=train_model)
+    # the test net of the concurrent evaluation copies the params of the
+    # train model, so it comes after it
+    if async_eval_on:
+        evaluator = async_eval.AsyncEvaluator(cfg.TEST.DATA_TYPE)
 
     # -------------------------------------------------------------------------
     # build the bn auxilary model (BN, always BN!)
     # -------------------------------------------------------------------------
-    if cfg.TRAIN.COMPUTE_PRECISE_BN:
+    # with synchronized BN the running statistics are already the ones of
+    # the whole batch
+    compute_precise_bn = cfg.TRAIN.COMPUTE_PRECISE_BN and not cfg.TRAIN.SYNC_BN
+    if compute_precise_bn:
         bn_aux = bn_helper.BatchNormHelper()
         bn_aux.create_bn_aux_model(node_id=opts.node_id)
 
@@ -126,16 +214,62 @@ def train(opts):
     # -------------------------------------------------------------------------
     logger.info("------------- Training model... -------------")
     train_meter.reset()
+    # the time the train net is stalled on its input ops
+    input_wait = train_model.net.AddObserver('PrefetchWaitObserver')
+    if cfg.VIDEO_STATS_PERIOD > 0:
+        # the stats of the input ops are named after their data outputs
+        stats_net = core.Net('video_stats')
+        stats_net.StatRegistryDump(
+            [], [], prefixes=['gpu_{}/data/'.format(i)
+                              for i in range(cfg.NUM_GPUS)] +
+            ['video_decoder/'])
+        workspace.CreateNet(stats_net)
+    if cfg.TIMELINE.START_ITER >= 0:
+        train_model.net.AddObserver('TimelineObserver')
+    if cfg.MEMORY_PROFILE.ITER >= 0:
+        memory_ob = train_model.net.AddObserver('MemoryObserver')
     last_checkpoint = checkpoints.get_checkpoint_resume_file()
 
-    for curr_iter in range(start_model_iter, cfg.SOLVER.MAX_ITER):
-        # set lr
-        train_model.UpdateWorkspaceLr(curr_iter)
+    if cfg.SOLVER.LR_IN_GRAPH:
+        model_builder_video.feed_lr_iter(start_model_iter)
+    curr_iter = start_model_iter - 1
+    while curr_iter + 1 < cfg.SOLVER.MAX_ITER:
+        # run the iterations [run_start_iter, curr_iter], and act after the
+        # last one, like for a run of one iteration
+        run_start_iter = curr_iter + 1
+        num_iters = get_num_iters_of_run(run_start_iter)
+        curr_iter = run_start_iter + num_iters - 1
 
-        # do SGD on 1 training mini-batch
+        # set lr, unless the net does
+        if not cfg.SOLVER.LR_IN_GRAPH:
+            train_model.UpdateWorkspaceLr(curr_iter)
+
+        if run_start_iter == cfg.TIMELINE.START_ITER:
+            workspace.TimelineStart(cfg.TIMELINE.CAPACITY)
+
+        track_memory = curr_iter == cfg.MEMORY_PROFILE.ITER
+        if track_memory:
+            workspace.MemoryTrackingStart()
+
+        # do SGD on num_iters training mini-batches
         train_timer.tic()
-        workspace.RunNet(train_model.net.Proto().name)
-        train_timer.toc()
+        try:
+            run_train_net(train_model, num_iters)
+        finally:
+            # also when it runs out of memory
+            if track_memory:
+                workspace.MemoryTrackingStop()
+                with open(cfg.MEMORY_PROFILE.PATH, 'w') as f:
+                    f.write(memory_ob.debug_info())
+                logger.info('Wrote the memory profile to {}'.format(
+                    cfg.MEMORY_PROFILE.PATH))
+        train_timer.toc(calls=num_iters)
+
+        if cfg.TIMELINE.START_ITER >= 0 and curr_iter + 1 == \
+                cfg.TIMELINE.START_ITER + cfg.TIMELINE.NUM_ITERS:
+            workspace.TimelineStop()
+            workspace.TimelineWrite(cfg.TIMELINE.PATH)
+            logger.info('Wrote the timeline to {}'.format(cfg.TIMELINE.PATH))
 
         test_debug = False
         if test_debug is True:
@@ -156,42 +290,66 @@ def train(opts):
                     cv2.imwrite(fname, temp_img)
 
         # show info after iter 1
-        if curr_iter == start_model_iter:
+        if run_start_iter == start_model_iter:
+            logger.info(
+                'Startup: first train run {:.2f}s, {:.2f}s in total'.format(
+                    train_timer.diff * num_iters, startup_timer.toc()))
             misc.print_net(train_model)
             os.system('nvidia-smi')
             misc.show_flops_params(train_model)
 
         # check nan
-        misc.check_nan_losses()
+        misc.check_nan_losses(
+            'loss_sum' if metrics.metrics_on_device('train') else 'loss')
 
         if (curr_iter + 1) % cfg.CHECKPOINT.CHECKPOINT_PERIOD == 0 \
                 or curr_iter + 1 == cfg.SOLVER.MAX_ITER:
             # --------------------------------------------------------
             # we update bn before testing or checkpointing
-            if cfg.TRAIN.COMPUTE_PRECISE_BN:
+            if compute_precise_bn:
                 bn_aux.compute_and_update_bn_stats(curr_iter)
             # --------------------------------------------------------
-            last_checkpoint = os.path.join(
-                checkpoint_dir,
-                'c2_model_iter{}.pkl'.format(curr_iter + 1))
+            last_checkpoint = checkpoints.get_checkpoint_file(
+                checkpoint_dir, curr_iter + 1)
             checkpoints.save_model_params(
                 model=train_model,
                 params_file=last_checkpoint,
                 model_iter=curr_iter)
 
-        train_meter.calculate_and_log_all_metrics_train(curr_iter, train_timer)
+        train_meter.calculate_and_log_all_metrics_train(
+            curr_iter, train_timer, num_iters)
+        if (curr_iter + 1) % cfg.LOG_PERIOD == 0:
+            print('| Train data loading bound {:.2f}% wait {:0.3f}'.format(
+                input_wait.stall_fraction() * 100,
+                input_wait.average_wait_time() / 1000.))
+            input_wait.reset()
+        if cfg.VIDEO_STATS_PERIOD > 0 and \
+                (curr_iter + 1) % cfg.VIDEO_STATS_PERIOD == 0:
+            workspace.RunNet(stats_net.Proto().name)
+        if async_eval_on:
+            evaluator.log_result()
 
         # --------------------------------------------------------
         # test model
         # --------------------------------------------------------
         if (curr_iter + 1) % cfg.TRAIN.EVAL_PERIOD == 0:
             # we update bn before testing or checkpointing
-            if cfg.TRAIN.COMPUTE_PRECISE_BN:
+            if compute_precise_bn:
                 bn_aux.compute_and_update_bn_stats(curr_iter)
 
+            if async_eval_on:
+                # the train stats are logged with the test ones once the
+                # test of the params of curr_iter is done
+                train_meter.finalize_metrics()
+                evaluator.start(curr_iter, metrics.get_json_stats_dict(
+                    train_meter, None, curr_iter))
+                train_meter.reset()
+                continue
+
             # start test
             test_meter.reset()
             logger.info("=> Testing model")
+            peak_memory = misc.get_peak_gpu_memory() if shared_eval else None
             for test_iter in range(0, total_test_iters):
                 test_timer.tic()
                 workspace.RunNet(test_model.net.Proto().name)
@@ -200,6 +358,8 @@ def train(opts):
                 test_meter.calculate_and_log_all_metrics_test(
                     test_iter, test_timer, total_test_iters)
 
+            misc.check_peak_gpu_memory(peak_memory, 'Testing')
+
             # finishing test
             test_meter.finalize_metrics()
             test_meter.compute_and_log_best()
@@ -215,6 +375,11 @@ def train(opts):
 
             train_meter.reset()
 
+    if async_eval_on:
+        evaluator.join()
+        evaluator.log_result()
+    checkpoints.wait_for_checkpoint(train_model)
+
     if cfg.TRAIN.TEST_AFTER_TRAIN is True:
 
         # -------------------------------------------------------------------------